@@ -24,7 +24,9 @@
 // clang-format: do not reorder the above include.
 
 #include <stddef.h>
+#include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
 #include <limits>
 #include <memory>
@@ -38,6 +40,7 @@
 #include "absl/types/span.h"
 #include "python/riegeli/base/utils.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/errno_mapping.h"
 #include "riegeli/bytes/buffered_reader.h"
 
 namespace riegeli {
@@ -79,12 +82,103 @@ PythonReader::PythonReader(PyObject* src, Options options)
     }
     set_limit_pos(*file_pos);
     supports_random_access_ = true;
+    FindDirectSource();
   }
 }
 
+void PythonReader::FindDirectSource() {
+  PythonLock::AssertHeld();
+  // Only exact types are recognized, because a subclass could override reading
+  // functions.
+  static constexpr ImportedConstant kBytesIO("io", "BytesIO");
+  if (ABSL_PREDICT_FALSE(!kBytesIO.Verify())) {
+    PyErr_Clear();
+    return;
+  }
+  if (Py_TYPE(src_.get()) ==
+      reinterpret_cast<PyTypeObject*>(kBytesIO.get())) {
+    static constexpr Identifier id_getbuffer("getbuffer");
+    PythonPtrLocking buffer_object(
+        PyObject_CallMethodObjArgs(src_.get(), id_getbuffer.get(), nullptr));
+    if (ABSL_PREDICT_FALSE(buffer_object == nullptr)) {
+      PyErr_Clear();
+      return;
+    }
+    Py_buffer buffer;
+    if (ABSL_PREDICT_FALSE(PyObject_GetBuffer(buffer_object.get(), &buffer,
+                                              PyBUF_CONTIG_RO) < 0)) {
+      PyErr_Clear();
+      return;
+    }
+    // The data stay valid while `buffer_object` is alive, because it keeps
+    // the buffer of `src_` exported, which prevents resizing it.
+    bytes_io_data_ = absl::string_view(static_cast<const char*>(buffer.buf),
+                                       IntCast<size_t>(buffer.len));
+    PyBuffer_Release(&buffer);
+    bytes_io_buffer_ = std::move(buffer_object);
+    return;
+  }
+  static constexpr ImportedConstant kFileIO("io", "FileIO");
+  static constexpr ImportedConstant kBufferedReader("io", "BufferedReader");
+  static constexpr ImportedConstant kBufferedRandom("io", "BufferedRandom");
+  if (ABSL_PREDICT_FALSE(!kFileIO.Verify() || !kBufferedReader.Verify() ||
+                         !kBufferedRandom.Verify())) {
+    PyErr_Clear();
+    return;
+  }
+  if (Py_TYPE(src_.get()) != reinterpret_cast<PyTypeObject*>(kFileIO.get()) &&
+      Py_TYPE(src_.get()) !=
+          reinterpret_cast<PyTypeObject*>(kBufferedReader.get()) &&
+      Py_TYPE(src_.get()) !=
+          reinterpret_cast<PyTypeObject*>(kBufferedRandom.get())) {
+    return;
+  }
+  // Pending writes of `io.BufferedRandom` must reach the file before it is
+  // read with `pread()`.
+  static constexpr Identifier id_flush("flush");
+  const PythonPtr flush_result(
+      PyObject_CallMethodObjArgs(src_.get(), id_flush.get(), nullptr));
+  if (ABSL_PREDICT_FALSE(flush_result == nullptr)) {
+    PyErr_Clear();
+    return;
+  }
+  static constexpr Identifier id_fileno("fileno");
+  const PythonPtr fileno_result(
+      PyObject_CallMethodObjArgs(src_.get(), id_fileno.get(), nullptr));
+  if (ABSL_PREDICT_FALSE(fileno_result == nullptr)) {
+    PyErr_Clear();
+    return;
+  }
+  const int fd = PyObject_AsFileDescriptor(fileno_result.get());
+  if (ABSL_PREDICT_FALSE(fd < 0)) {
+    PyErr_Clear();
+    return;
+  }
+  fd_ = fd;
+}
+
 void PythonReader::Done() {
   BufferedReader::Done();
-  if (owns_src_ && src_ != nullptr) {
+  if (src_ == nullptr) return;
+  if (fd_ >= 0 || bytes_io_buffer_ != nullptr) {
+    PythonLock lock;
+    // Release the buffer of an `io.BytesIO` before accessing the stream,
+    // because the stream cannot be closed while its buffer is exported.
+    bytes_io_buffer_.reset();
+    bytes_io_data_ = absl::string_view();
+    fd_ = -1;
+    // Make the stream position reflect what has been read.
+    const PythonPtr file_pos = PositionToPython(limit_pos());
+    if (ABSL_PREDICT_FALSE(file_pos == nullptr)) {
+      FailOperation("PositionToPython()");
+    } else {
+      static constexpr Identifier id_seek("seek");
+      const PythonPtr seek_result(PyObject_CallMethodObjArgs(
+          src_.get(), id_seek.get(), file_pos.get(), nullptr));
+      if (ABSL_PREDICT_FALSE(seek_result == nullptr)) FailOperation("seek()");
+    }
+  }
+  if (owns_src_) {
     PythonLock lock;
     static constexpr Identifier id_close("close");
     const PythonPtr close_result(
@@ -122,6 +216,10 @@ bool PythonReader::ReadInternal(size_t min_length, size_t max_length,
                          std::numeric_limits<Position>::max() - limit_pos())) {
     return FailOverflow();
   }
+  if (fd_ >= 0) return ReadFromFd(min_length, max_length, dest);
+  if (bytes_io_buffer_ != nullptr) {
+    return ReadFromBytesIO(min_length, max_length, dest);
+  }
   PythonLock lock;
   // Find a read function to use, preferring in order: `readinto1()`,
   // `readinto()`, `read1()`, `read()`.
@@ -234,6 +332,46 @@ bool PythonReader::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+inline bool PythonReader::ReadFromFd(size_t min_length, size_t max_length,
+                                     char* dest) {
+  if (ABSL_PREDICT_FALSE(max_length >
+                         Position{std::numeric_limits<off_t>::max()} -
+                             limit_pos())) {
+    return FailOverflow();
+  }
+  for (;;) {
+  again:
+    const ssize_t length_read =
+        pread(fd_, dest,
+              UnsignedMin(max_length,
+                          size_t{std::numeric_limits<ssize_t>::max()}),
+              IntCast<off_t>(limit_pos()));
+    if (ABSL_PREDICT_FALSE(length_read < 0)) {
+      if (errno == EINTR) goto again;
+      return Fail(ErrnoToCanonicalStatus(errno, "pread() failed"));
+    }
+    if (ABSL_PREDICT_FALSE(length_read == 0)) return false;
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_read), max_length)
+        << "pread() read more than requested";
+    move_limit_pos(IntCast<size_t>(length_read));
+    if (IntCast<size_t>(length_read) >= min_length) return true;
+    dest += length_read;
+    min_length -= IntCast<size_t>(length_read);
+    max_length -= IntCast<size_t>(length_read);
+  }
+}
+
+inline bool PythonReader::ReadFromBytesIO(size_t min_length, size_t max_length,
+                                          char* dest) {
+  if (ABSL_PREDICT_FALSE(limit_pos() >= bytes_io_data_.size())) return false;
+  const size_t length_read = UnsignedMin(
+      max_length, bytes_io_data_.size() - IntCast<size_t>(limit_pos()));
+  std::memcpy(dest, bytes_io_data_.data() + IntCast<size_t>(limit_pos()),
+              length_read);
+  move_limit_pos(length_read);
+  return length_read >= min_length;
+}
+
 bool PythonReader::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT(new_pos < start_pos() || new_pos > limit_pos())
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
@@ -124,6 +124,12 @@ class PythonReader : public BufferedReader {
   PythonReader& operator=(PythonReader&& that) noexcept;
 
   // Returns a borrowed reference to the stream being read from.
+  //
+  // If the stream is an `io.FileIO`, `io.BufferedReader`, `io.BufferedRandom`,
+  // or `io.BytesIO`, and random access is supported, then the underlying file
+  // descriptor or the `io.BytesIO` buffer is read directly, without holding
+  // the GIL. The stream position is updated when the `PythonReader` is closed,
+  // and the stream must not be accessed before that.
   PyObject* src() const { return src_.get(); }
 
   const Exception& exception() const { return exception_; }
@@ -141,6 +147,9 @@ class PythonReader : public BufferedReader {
 
  private:
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+  void FindDirectSource();
+  bool ReadFromFd(size_t min_length, size_t max_length, char* dest);
+  bool ReadFromBytesIO(size_t min_length, size_t max_length, char* dest);
   absl::optional<Position> SizeInternal();
 
   PythonPtrLocking src_;
@@ -150,6 +159,13 @@ class PythonReader : public BufferedReader {
   PythonPtrLocking read_function_;
   absl::string_view read_function_name_;
   bool use_bytes_ = false;
+  // If not negative, the file descriptor underlying `src_`, read with
+  // `pread()`.
+  int fd_ = -1;
+  // If not `nullptr`, a `memoryview` exporting the buffer of an `io.BytesIO`
+  // `src_`, which keeps `bytes_io_data_` valid.
+  PythonPtrLocking bytes_io_buffer_;
+  absl::string_view bytes_io_data_;
 };
 
 inline PythonReader::PythonReader(PythonReader&& that) noexcept
@@ -162,7 +178,10 @@ inline PythonReader::PythonReader(PythonReader&& that) noexcept
       exception_(std::move(that.exception_)),
       read_function_(std::move(that.read_function_)),
       read_function_name_(that.read_function_name_),
-      use_bytes_(that.use_bytes_) {}
+      use_bytes_(that.use_bytes_),
+      fd_(that.fd_),
+      bytes_io_buffer_(std::move(that.bytes_io_buffer_)),
+      bytes_io_data_(that.bytes_io_data_) {}
 
 inline PythonReader& PythonReader::operator=(PythonReader&& that) noexcept {
   BufferedReader::operator=(std::move(that));
@@ -175,12 +194,16 @@ inline PythonReader& PythonReader::operator=(PythonReader&& that) noexcept {
   read_function_ = std::move(that.read_function_);
   read_function_name_ = that.read_function_name_;
   use_bytes_ = that.use_bytes_;
+  fd_ = that.fd_;
+  bytes_io_buffer_ = std::move(that.bytes_io_buffer_);
+  bytes_io_data_ = that.bytes_io_data_;
   return *this;
 }
 
 inline int PythonReader::Traverse(visitproc visit, void* arg) {
   Py_VISIT(src_.get());
   Py_VISIT(read_function_.get());
+  Py_VISIT(bytes_io_buffer_.get());
   return exception_.Traverse(visit, arg);
 }
 
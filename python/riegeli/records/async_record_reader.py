@@ -0,0 +1,145 @@
+# Copyright 2021 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Reads records from a Riegeli/records file without blocking asyncio."""
+
+import asyncio
+import collections
+
+from riegeli.records import record_reader
+
+__all__ = ('AsyncRecordReader',)
+
+
+class AsyncRecordReader:
+  """Reads records from a Riegeli/records file without blocking asyncio.
+
+  AsyncRecordReader wraps a RecordReader. Records are read in batches by
+  RecordReader.read_record_batch() called in an executor, which releases the
+  GIL once per batch while records are read and decoded. Awaiting a record
+  taken from an already read batch does not leave the event loop.
+
+  Executor threads are not dedicated to a reader: many AsyncRecordReaders can
+  share the default executor of the event loop, or a given executor. With
+  parallelism > 0, chunks are additionally read ahead and decoded in parallel in
+  background threads of RecordReader.
+
+  Operations of a single AsyncRecordReader are serialized, so it can be used by
+  concurrent tasks, but the order in which they get records is unspecified.
+
+  Example:
+    async with riegeli.AsyncRecordReader(io.FileIO(filename, 'rb')) as reader:
+      async for record in reader:
+        ...
+  """
+
+  __slots__ = ('_reader', '_batch_size', '_executor', '_records', '_lock')
+
+  def __init__(self, src, *, batch_size=256, executor=None, **kwargs):
+    """Will read from the given file.
+
+    Args:
+      src: Binary IO stream to read from, like for RecordReader.
+      batch_size: The maximum number of records read together by the executor.
+        Larger batches reduce the overhead of switching threads; smaller
+        batches reduce latency and memory usage.
+      executor: The concurrent.futures.Executor to read in, or None for the
+        default executor of the event loop.
+      **kwargs: Other arguments of RecordReader, e.g. owns_src, assumed_pos,
+        field_projection, recovery, parallelism.
+    """
+    if batch_size <= 0:
+      raise ValueError(f'Non-positive batch_size: {batch_size}')
+    self._batch_size = batch_size
+    self._executor = executor
+    self._records = collections.deque()
+    self._lock = asyncio.Lock()
+    # Opening reads only the beginning of src, so it is done synchronously,
+    # which reports failures in the constructor like for RecordReader.
+    self._reader = record_reader.RecordReader(src, **kwargs)
+
+  @property
+  def reader(self):
+    """The underlying RecordReader.
+
+    It must not be used while an operation of AsyncRecordReader is pending.
+    Records already read into a batch are not visible to it.
+    """
+    return self._reader
+
+  def __repr__(self):
+    return f'<riegeli.AsyncRecordReader reader={self._reader!r}>'
+
+  async def _run(self, function, *args):
+    loop = asyncio.get_running_loop()
+    return await loop.run_in_executor(self._executor, function, *args)
+
+  async def __aenter__(self):
+    return self
+
+  async def __aexit__(self, exc_type, exc_value, traceback):
+    await self.close()
+
+  async def close(self):
+    """Closes the AsyncRecordReader, dropping records already read ahead."""
+    async with self._lock:
+      self._records.clear()
+      await self._run(self._reader.close)
+
+  async def read_record(self):
+    """Reads the next record.
+
+    Returns:
+      The record read as bytes, or None at end of file.
+    """
+    if self._records:
+      return self._records.popleft()
+    async with self._lock:
+      # Another task could have read a batch while this one was waiting.
+      if not self._records:
+        self._records.extend(await self._run(self._reader.read_record_batch,
+                                             self._batch_size))
+        if not self._records:
+          return None
+      return self._records.popleft()
+
+  async def read_record_batch(self, max_records=None):
+    """Reads up to max_records next records.
+
+    Args:
+      max_records: The maximum number of records to read, or None for
+        batch_size.
+
+    Returns:
+      The records read as a list of bytes. It is empty at end of file.
+    """
+    if max_records is None:
+      max_records = self._batch_size
+    if max_records < 0:
+      raise ValueError(f'Negative max_records: {max_records}')
+    async with self._lock:
+      records = []
+      while self._records and len(records) < max_records:
+        records.append(self._records.popleft())
+      if not records and max_records > 0:
+        records = await self._run(self._reader.read_record_batch, max_records)
+      return records
+
+  def __aiter__(self):
+    return self
+
+  async def __anext__(self):
+    record = await self.read_record()
+    if record is None:
+      raise StopAsyncIteration
+    return record
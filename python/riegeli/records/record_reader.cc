@@ -23,11 +23,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/compare.h"
 #include "absl/types/optional.h"
 #include "python/riegeli/base/utils.h"
@@ -35,6 +39,7 @@
 #include "python/riegeli/records/record_position.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/chunk_encoding/column_type.h"
 #include "riegeli/chunk_encoding/field_projection.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/record_reader.h"
@@ -51,17 +56,18 @@ constexpr ImportedCapsule<RecordPositionApi> kRecordPositionApi(
 // `extern "C"` sets the C calling convention for compatibility with the Python
 // API. Functions are marked `static` to avoid making their symbols public, as
 // `extern "C"` trumps anonymous namespace.
-extern "C" {
-
-static PyObject* GetRecordType(PyObject* self, PyObject* args,
-                               PyObject* kwargs) {
-  static constexpr const char* keywords[] = {"metadata", nullptr};
-  PyObject* metadata_arg;
-  if (ABSL_PREDICT_FALSE(!PyArg_ParseTupleAndKeywords(
-          args, kwargs, "O:get_record_type", const_cast<char**>(keywords),
-          &metadata_arg))) {
-    return nullptr;
-  }
+// Record types returned by `get_record_type()`, keyed by serialized metadata.
+//
+// Reading many files written with the same metadata would otherwise build a
+// new `DescriptorPool` and a new message class for each file. The cache is
+// cleared when it reaches `kMaxRecordTypeCacheSize` entries. It is protected
+// by the GIL and never freed.
+constexpr Py_ssize_t kMaxRecordTypeCacheSize = 64;
+PyObject* record_type_cache = nullptr;
+
+// Returns a new reference to the record type, or `None`, or `nullptr` with a
+// Python exception set.
+PyObject* RecordTypeFromMetadata(PyObject* metadata_arg) {
   // record_type_name = metadata.record_type_name
   static constexpr Identifier id_record_type_name("record_type_name");
   const PythonPtr record_type_name(
@@ -117,6 +123,45 @@ static PyObject* GetRecordType(PyObject* self, PyObject* args,
                                     message_descriptor.get(), nullptr);
 }
 
+extern "C" {
+
+static PyObject* GetRecordType(PyObject* self, PyObject* args,
+                               PyObject* kwargs) {
+  static constexpr const char* keywords[] = {"metadata", nullptr};
+  PyObject* metadata_arg;
+  if (ABSL_PREDICT_FALSE(!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "O:get_record_type", const_cast<char**>(keywords),
+          &metadata_arg))) {
+    return nullptr;
+  }
+  // key = metadata.SerializeToString()
+  static constexpr Identifier id_SerializeToString("SerializeToString");
+  const PythonPtr key(PyObject_CallMethodObjArgs(
+      metadata_arg, id_SerializeToString.get(), nullptr));
+  if (ABSL_PREDICT_FALSE(key == nullptr)) return nullptr;
+  if (ABSL_PREDICT_FALSE(record_type_cache == nullptr)) {
+    record_type_cache = PyDict_New();
+    if (ABSL_PREDICT_FALSE(record_type_cache == nullptr)) return nullptr;
+  }
+  PyObject* const cached_record_type =
+      PyDict_GetItemWithError(record_type_cache, key.get());
+  if (cached_record_type != nullptr) {
+    Py_INCREF(cached_record_type);
+    return cached_record_type;
+  }
+  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) return nullptr;
+  PythonPtr record_type(RecordTypeFromMetadata(metadata_arg));
+  if (ABSL_PREDICT_FALSE(record_type == nullptr)) return nullptr;
+  if (PyDict_Size(record_type_cache) >= kMaxRecordTypeCacheSize) {
+    PyDict_Clear(record_type_cache);
+  }
+  if (ABSL_PREDICT_FALSE(PyDict_SetItem(record_type_cache, key.get(),
+                                        record_type.get()) < 0)) {
+    return nullptr;
+  }
+  return record_type.release();
+}
+
 }  // extern "C"
 
 struct PyRecordReaderObject {
@@ -145,6 +190,21 @@ struct PyRecordIterObject {
 
 extern PyTypeObject PyRecordIter_Type;
 
+// Owns a record returned by `RecordReader.read_record_view()` and exports it
+// through the buffer protocol.
+struct PyRecordBufferObject {
+  // clang-format off
+  PyObject_HEAD
+  static_assert(true, "");  // clang-format workaround.
+  // clang-format on
+
+  PythonWrapped<Chain> record;
+  // Flat contents of `record`.
+  absl::string_view data;
+};
+
+extern PyTypeObject PyRecordBuffer_Type;
+
 bool RecordReaderHasException(PyRecordReaderObject* self) {
   return self->recovery_exception.has_value() ||
          !self->record_reader->healthy();
@@ -213,6 +273,108 @@ absl::optional<FieldProjection> FieldProjectionFromPython(PyObject* object) {
   return field_projection;
 }
 
+absl::optional<ColumnType> ColumnTypeFromPython(PyObject* object) {
+  static constexpr struct {
+    absl::string_view name;
+    ColumnType type;
+  } kColumnTypes[] = {
+      {"int64", ColumnType::kInt64},       {"sint64", ColumnType::kSInt64},
+      {"fixed32", ColumnType::kFixed32},   {"sfixed32", ColumnType::kSFixed32},
+      {"fixed64", ColumnType::kFixed64},   {"float", ColumnType::kFloat},
+      {"double", ColumnType::kDouble},     {"bytes", ColumnType::kBytes},
+  };
+  StrOrBytes name;
+  if (ABSL_PREDICT_FALSE(!name.FromPython(object))) return absl::nullopt;
+  for (const auto& column_type : kColumnTypes) {
+    if (absl::string_view(name) == column_type.name) return column_type.type;
+  }
+  PyErr_Format(PyExc_ValueError, "Unknown column type: %s",
+               std::string(absl::string_view(name)).c_str());
+  return absl::nullopt;
+}
+
+absl::optional<std::vector<ColumnSpec>> ColumnsFromPython(PyObject* object) {
+  std::vector<ColumnSpec> columns;
+  const PythonPtr column_iter(PyObject_GetIter(object));
+  if (ABSL_PREDICT_FALSE(column_iter == nullptr)) return absl::nullopt;
+  while (const PythonPtr column_object{PyIter_Next(column_iter.get())}) {
+    PyObject* field_path_arg;
+    PyObject* column_type_arg;
+    if (ABSL_PREDICT_FALSE(!PyTuple_Check(column_object.get()) ||
+                           !PyArg_ParseTuple(column_object.get(),
+                                             "OO:read_columns", &field_path_arg,
+                                             &column_type_arg))) {
+      if (PyErr_Occurred() == nullptr) {
+        PyErr_Format(PyExc_TypeError, "Expected tuple, not %s",
+                     Py_TYPE(column_object.get())->tp_name);
+      }
+      return absl::nullopt;
+    }
+    ColumnSpec column;
+    const PythonPtr field_number_iter(PyObject_GetIter(field_path_arg));
+    if (ABSL_PREDICT_FALSE(field_number_iter == nullptr)) return absl::nullopt;
+    while (const PythonPtr field_number_object{
+        PyIter_Next(field_number_iter.get())}) {
+      const absl::optional<int> field_number =
+          FieldNumberFromPython(field_number_object.get());
+      if (ABSL_PREDICT_FALSE(field_number == absl::nullopt)) {
+        return absl::nullopt;
+      }
+      if (ABSL_PREDICT_FALSE(*field_number == Field::kExistenceOnly)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "EXISTENCE_ONLY is not applicable to a column");
+        return absl::nullopt;
+      }
+      column.field.AddFieldNumber(*field_number);
+    }
+    if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) return absl::nullopt;
+    if (ABSL_PREDICT_FALSE(column.field.path().empty())) {
+      PyErr_SetString(PyExc_ValueError, "Empty field path of a column");
+      return absl::nullopt;
+    }
+    const absl::optional<ColumnType> column_type =
+        ColumnTypeFromPython(column_type_arg);
+    if (ABSL_PREDICT_FALSE(column_type == absl::nullopt)) return absl::nullopt;
+    column.type = *column_type;
+    columns.push_back(std::move(column));
+  }
+  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) return absl::nullopt;
+  return columns;
+}
+
+// Values of one column of records read by `read_columns()`.
+struct ReadColumn {
+  std::vector<int64_t> int64_values;
+  std::vector<double> double_values;
+  // Concatenated values of a bytes column, delimited by `value_offsets`.
+  std::string bytes_data;
+  std::vector<int64_t> value_offsets = {0};
+  // Values of record `i` are between `record_offsets[i]` and
+  // `record_offsets[i + 1]`.
+  std::vector<int64_t> record_offsets = {0};
+};
+
+// Converts raw values to a new writable NumPy array of the given `dtype`.
+//
+// Returns `nullptr` on failure (with Python exception set).
+PythonPtr ArrayToPython(absl::string_view data, const char* dtype) {
+  static constexpr ImportedConstant kFromBuffer("numpy", "frombuffer");
+  if (ABSL_PREDICT_FALSE(!kFromBuffer.Verify())) return nullptr;
+  const PythonPtr buffer(PyByteArray_FromStringAndSize(
+      data.data(), IntCast<Py_ssize_t>(data.size())));
+  if (ABSL_PREDICT_FALSE(buffer == nullptr)) return nullptr;
+  return PythonPtr(
+      PyObject_CallFunction(kFromBuffer.get(), "Os", buffer.get(), dtype));
+}
+
+template <typename T>
+PythonPtr ArrayToPython(const std::vector<T>& values, const char* dtype) {
+  return ArrayToPython(
+      absl::string_view(reinterpret_cast<const char*>(values.data()),
+                        values.size() * sizeof(T)),
+      dtype);
+}
+
 extern "C" {
 
 static void RecordReaderDestructor(PyRecordReaderObject* self) {
@@ -251,18 +413,22 @@ static int RecordReaderClear(PyRecordReaderObject* self) {
 static int RecordReaderInit(PyRecordReaderObject* self, PyObject* args,
                             PyObject* kwargs) {
   static constexpr const char* keywords[] = {
-      "src",      "owns_src", "assumed_pos", "buffer_size", "field_projection",
-      "recovery", nullptr};
+      "src",         "owns_src",          "assumed_pos",
+      "buffer_size", "field_projection",  "recovery",
+      "parallelism", "max_decoded_bytes", nullptr};
   PyObject* src_arg;
   PyObject* owns_src_arg = nullptr;
   PyObject* assumed_pos_arg = nullptr;
   PyObject* buffer_size_arg = nullptr;
   PyObject* field_projection_arg = nullptr;
   PyObject* recovery_arg = nullptr;
+  PyObject* parallelism_arg = nullptr;
+  PyObject* max_decoded_bytes_arg = nullptr;
   if (ABSL_PREDICT_FALSE(!PyArg_ParseTupleAndKeywords(
-          args, kwargs, "O|$OOOOO:RecordReader", const_cast<char**>(keywords),
-          &src_arg, &owns_src_arg, &assumed_pos_arg, &buffer_size_arg,
-          &field_projection_arg, &recovery_arg))) {
+          args, kwargs, "O|$OOOOOOO:RecordReader",
+          const_cast<char**>(keywords), &src_arg, &owns_src_arg,
+          &assumed_pos_arg, &buffer_size_arg, &field_projection_arg,
+          &recovery_arg, &parallelism_arg, &max_decoded_bytes_arg))) {
     return -1;
   }
 
@@ -285,6 +451,23 @@ static int RecordReaderInit(PyRecordReaderObject* self, PyObject* args,
   }
 
   RecordReaderBase::Options record_reader_options;
+  if (parallelism_arg != nullptr) {
+    const absl::optional<size_t> parallelism = SizeFromPython(parallelism_arg);
+    if (ABSL_PREDICT_FALSE(parallelism == absl::nullopt)) return -1;
+    if (ABSL_PREDICT_FALSE(*parallelism >
+                           size_t{std::numeric_limits<int>::max()})) {
+      PyErr_Format(PyExc_OverflowError, "Parallelism out of range: %zu",
+                   *parallelism);
+      return -1;
+    }
+    record_reader_options.set_parallelism(IntCast<int>(*parallelism));
+  }
+  if (max_decoded_bytes_arg != nullptr && max_decoded_bytes_arg != Py_None) {
+    const absl::optional<Position> max_decoded_bytes =
+        PositionFromPython(max_decoded_bytes_arg);
+    if (ABSL_PREDICT_FALSE(max_decoded_bytes == absl::nullopt)) return -1;
+    record_reader_options.set_max_decoded_bytes(*max_decoded_bytes);
+  }
   if (field_projection_arg != nullptr && field_projection_arg != Py_None) {
     absl::optional<FieldProjection> field_projection =
         FieldProjectionFromPython(field_projection_arg);
@@ -484,6 +667,174 @@ static PyObject* RecordReaderReadRecord(PyRecordReaderObject* self,
   return ChainToPython(record).release();
 }
 
+static PyObject* RecordReaderReadRecordView(PyRecordReaderObject* self,
+                                            PyObject* args) {
+  if (ABSL_PREDICT_FALSE(!self->record_reader.Verify())) return nullptr;
+  Chain record;
+  const bool ok = PythonUnlocked([&] {
+    if (ABSL_PREDICT_FALSE(!self->record_reader->ReadRecord(record))) {
+      return false;
+    }
+    // Blocks of `record` are shared with decoded chunk data. Flattening is a
+    // no-op unless the record spans several blocks.
+    record.Flatten();
+    return true;
+  });
+  if (ABSL_PREDICT_FALSE(!ok)) {
+    if (ABSL_PREDICT_FALSE(RecordReaderHasException(self))) {
+      SetExceptionFromRecordReader(self);
+      return nullptr;
+    }
+    Py_RETURN_NONE;
+  }
+  PythonPtr buffer(PyRecordBuffer_Type.tp_alloc(&PyRecordBuffer_Type, 0));
+  if (ABSL_PREDICT_FALSE(buffer == nullptr)) return nullptr;
+  PyRecordBufferObject* const buffer_object =
+      reinterpret_cast<PyRecordBufferObject*>(buffer.get());
+  buffer_object->record.emplace(std::move(record));
+  // The record is already flat. Its data may be stored inline in the `Chain`,
+  // hence `data` is taken after moving it to its final place.
+  buffer_object->data = buffer_object->record->Flatten();
+  return PyMemoryView_FromObject(buffer.get());
+}
+
+static PyObject* RecordReaderReadRecordBatch(PyRecordReaderObject* self,
+                                             PyObject* args, PyObject* kwargs) {
+  static constexpr const char* keywords[] = {"max_records", nullptr};
+  Py_ssize_t max_records;
+  if (ABSL_PREDICT_FALSE(!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "n:read_record_batch", const_cast<char**>(keywords),
+          &max_records))) {
+    return nullptr;
+  }
+  if (ABSL_PREDICT_FALSE(max_records < 0)) {
+    PyErr_Format(PyExc_ValueError, "Negative max_records: %zd", max_records);
+    return nullptr;
+  }
+  if (ABSL_PREDICT_FALSE(!self->record_reader.Verify())) return nullptr;
+  // Read all records with the GIL released once, then convert them.
+  std::vector<Chain> records;
+  PythonUnlocked([&] {
+    Chain record;
+    while (records.size() < IntCast<size_t>(max_records) &&
+           self->record_reader->ReadRecord(record)) {
+      records.push_back(std::move(record));
+    }
+  });
+  if (ABSL_PREDICT_FALSE(records.empty() && RecordReaderHasException(self))) {
+    // If some records were read before a failure, they are returned, and the
+    // failure is reported by the next read.
+    SetExceptionFromRecordReader(self);
+    return nullptr;
+  }
+  PythonPtr list(PyList_New(IntCast<Py_ssize_t>(records.size())));
+  if (ABSL_PREDICT_FALSE(list == nullptr)) return nullptr;
+  for (size_t i = 0; i < records.size(); ++i) {
+    PythonPtr record_object = ChainToPython(records[i]);
+    if (ABSL_PREDICT_FALSE(record_object == nullptr)) return nullptr;
+    PyList_SET_ITEM(list.get(), IntCast<Py_ssize_t>(i),
+                    record_object.release());
+  }
+  return list.release();
+}
+
+static PyObject* RecordReaderReadColumns(PyRecordReaderObject* self,
+                                         PyObject* args, PyObject* kwargs) {
+  static constexpr const char* keywords[] = {"columns", "max_records",
+                                             nullptr};
+  PyObject* columns_arg;
+  Py_ssize_t max_records;
+  if (ABSL_PREDICT_FALSE(!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "On:read_columns", const_cast<char**>(keywords),
+          &columns_arg, &max_records))) {
+    return nullptr;
+  }
+  absl::optional<std::vector<ColumnSpec>> column_specs =
+      ColumnsFromPython(columns_arg);
+  if (ABSL_PREDICT_FALSE(column_specs == absl::nullopt)) return nullptr;
+  if (ABSL_PREDICT_FALSE(max_records < 0)) {
+    PyErr_Format(PyExc_ValueError, "Negative max_records: %zd", max_records);
+    return nullptr;
+  }
+  if (ABSL_PREDICT_FALSE(!self->record_reader.Verify())) return nullptr;
+  // Read records and decode their columns with the GIL released once, then
+  // convert the columns.
+  std::vector<ReadColumn> columns(column_specs->size());
+  size_t num_records = 0;
+  PythonUnlocked([&] {
+    absl::string_view record;
+    while (num_records < IntCast<size_t>(max_records) &&
+           self->record_reader->ReadRecord(record)) {
+      ++num_records;
+      for (size_t i = 0; i < column_specs->size(); ++i) {
+        const ColumnSpec& column_spec = (*column_specs)[i];
+        ReadColumn& column = columns[i];
+        riegeli::internal::ForEachColumnValue(
+            column_spec.field.path(), column_spec.type, record,
+            [&](const riegeli::internal::ColumnValue& value) {
+              if (IsInt64ColumnType(column_spec.type)) {
+                column.int64_values.push_back(value.int64_value);
+              } else if (IsDoubleColumnType(column_spec.type)) {
+                column.double_values.push_back(value.double_value);
+              } else {
+                column.bytes_data.append(value.bytes_value.data(),
+                                         value.bytes_value.size());
+                column.value_offsets.push_back(
+                    IntCast<int64_t>(column.bytes_data.size()));
+              }
+              return false;
+            });
+        size_t num_values;
+        if (IsInt64ColumnType(column_spec.type)) {
+          num_values = column.int64_values.size();
+        } else if (IsDoubleColumnType(column_spec.type)) {
+          num_values = column.double_values.size();
+        } else {
+          num_values = column.value_offsets.size() - 1;
+        }
+        column.record_offsets.push_back(IntCast<int64_t>(num_values));
+      }
+    }
+  });
+  if (ABSL_PREDICT_FALSE(num_records == 0 && RecordReaderHasException(self))) {
+    // If some records were read before a failure, they are returned, and the
+    // failure is reported by the next read.
+    SetExceptionFromRecordReader(self);
+    return nullptr;
+  }
+  PythonPtr list(PyList_New(IntCast<Py_ssize_t>(columns.size())));
+  if (ABSL_PREDICT_FALSE(list == nullptr)) return nullptr;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    const ColumnType type = (*column_specs)[i].type;
+    const ReadColumn& column = columns[i];
+    const PythonPtr record_offsets =
+        ArrayToPython(column.record_offsets, "int64");
+    if (ABSL_PREDICT_FALSE(record_offsets == nullptr)) return nullptr;
+    PythonPtr column_object;
+    if (IsInt64ColumnType(type) || IsDoubleColumnType(type)) {
+      const PythonPtr values =
+          IsInt64ColumnType(type)
+              ? ArrayToPython(column.int64_values, "int64")
+              : ArrayToPython(column.double_values, "float64");
+      if (ABSL_PREDICT_FALSE(values == nullptr)) return nullptr;
+      column_object.reset(
+          PyTuple_Pack(2, values.get(), record_offsets.get()));
+    } else {
+      const PythonPtr data = ArrayToPython(column.bytes_data, "uint8");
+      if (ABSL_PREDICT_FALSE(data == nullptr)) return nullptr;
+      const PythonPtr value_offsets =
+          ArrayToPython(column.value_offsets, "int64");
+      if (ABSL_PREDICT_FALSE(value_offsets == nullptr)) return nullptr;
+      column_object.reset(PyTuple_Pack(3, data.get(), value_offsets.get(),
+                                       record_offsets.get()));
+    }
+    if (ABSL_PREDICT_FALSE(column_object == nullptr)) return nullptr;
+    PyList_SET_ITEM(list.get(), IntCast<Py_ssize_t>(i),
+                    column_object.release());
+  }
+  return list.release();
+}
+
 static PyObject* RecordReaderReadMessage(PyRecordReaderObject* self,
                                          PyObject* args, PyObject* kwargs) {
   static constexpr const char* keywords[] = {"message_type", nullptr};
@@ -916,6 +1267,77 @@ Reads the next record.
 
 Returns:
   The record read as bytes, or None at end of file.
+)doc"},
+    {"read_record_view",
+     reinterpret_cast<PyCFunction>(RecordReaderReadRecordView), METH_NOARGS,
+     R"doc(
+read_record_view(self) -> Optional[memoryview]
+
+Reads the next record.
+
+This is like read_record(), but the record is not copied to bytes. The returned
+read-only memoryview shares memory with decoded chunk data, which is kept alive
+as long as the memoryview is referenced. A record spanning several blocks of
+decoded data is first made contiguous. This is faster for large records
+consumed by libraries supporting the buffer protocol, like NumPy.
+
+Returns:
+  The record read as memoryview, or None at end of file.
+)doc"},
+    {"read_record_batch",
+     reinterpret_cast<PyCFunction>(RecordReaderReadRecordBatch),
+     METH_VARARGS | METH_KEYWORDS, R"doc(
+read_record_batch(self, max_records: int) -> List[bytes]
+
+Reads up to max_records next records.
+
+This is like calling read_record() repeatedly, but the GIL is released once for
+the whole batch, which is faster for small records.
+
+Args:
+  max_records: The maximum number of records to read.
+
+Returns:
+  The records read as a list of bytes. It is shorter than max_records only at
+  end of file or before a failure, which is reported by the next read. It is
+  empty at end of file.
+)doc"},
+    {"read_columns", reinterpret_cast<PyCFunction>(RecordReaderReadColumns),
+     METH_VARARGS | METH_KEYWORDS, R"doc(
+read_columns(
+    self, columns: Sequence[Tuple[Iterable[int], str]], max_records: int
+) -> List[Tuple[numpy.ndarray, ...]]
+
+Reads selected fields of up to max_records next records as NumPy arrays.
+
+Field values are taken from serialized records directly, with the GIL released
+once, without parsing records to messages. For a file written with "transpose"
+in RecordWriter options, set field_projection to the fields of the columns to
+avoid decoding remaining fields.
+
+Args:
+  columns: Columns to read. A column is specified as a pair of a field path and
+    a column type. A field path is an iterable of proto field numbers
+    descending from the root message. A column type is one of "int64" (for
+    int32, int64, uint32, uint64, bool, and enum fields), "sint64" (for sint32
+    and sint64), "fixed32", "sfixed32", "fixed64" (for fixed64 and sfixed64),
+    "float", "double", or "bytes" (for string and bytes). Since records do not
+    carry the proto schema, every field of the path can be repeated, and values
+    of the wrong wire type are skipped.
+  max_records: The maximum number of records to read.
+
+Returns:
+  A list parallel to columns. For a column of type "float" or "double" the
+  element is a pair (values, record_offsets) where values is a float64 array;
+  for "bytes" it is a triple (data, value_offsets, record_offsets) where data
+  is a uint8 array of concatenated values and value i is
+  data[value_offsets[i]:value_offsets[i + 1]]; for other types it is a pair
+  (values, record_offsets) where values is an int64 array. Values of record i
+  are those with indices from record_offsets[i] to record_offsets[i + 1].
+  record_offsets is an int64 array whose length is one more than the number of
+  records read, which is smaller than max_records only at end of file or before
+  a failure, which is reported by the next read. No records are read at end of
+  file.
 )doc"},
     {"read_message", reinterpret_cast<PyCFunction>(RecordReaderReadMessage),
      METH_VARARGS | METH_KEYWORDS, R"doc(
@@ -1180,7 +1602,9 @@ RecordReader(
     assumed_pos: Optional[int] = None,
     buffer_size: int = 64 << 10,
     field_projection: Optional[Iterable[Iterable[int]]] = None,
-    recovery: Optional[Callable[[SkippedRegion], Any]] = None) -> RecordReader
+    recovery: Optional[Callable[[SkippedRegion], Any]] = None,
+    parallelism: int = 0,
+    max_decoded_bytes: Optional[int] = None) -> RecordReader
 
 Will read from the given file.
 
@@ -1210,6 +1634,20 @@ Args:
     reading continues. If the recovery function raises StopIteration, reading
     ends. If close() is called and file contents were truncated, the recovery
     function is called if set; the RecordReader remains closed.
+  parallelism: If positive, the maximum number of chunks being read ahead and
+    decoded in parallel in background threads, without holding the GIL. The GIL
+    is taken only for reading from src. Records of decoded chunks are then ready
+    when they are requested. Larger parallelism can increase throughput, up to a
+    point where it no longer matters; smaller parallelism reduces memory usage.
+    If positive, src can be positioned further than pos implies; it is moved
+    back to the chunk following the current one by seek(), search(),
+    set_field_projection(), and close(). If parallelism is positive, the
+    recovery function is called from background threads.
+  max_decoded_bytes: If not None and parallelism is positive, the maximum total
+    decoded size of chunks read ahead and not consumed yet. Reading ahead waits
+    for records to be consumed rather than exceeding it, which bounds memory
+    usage when records are consumed slower than they are decoded. At least one
+    chunk is read ahead even if it is larger.
 
 The src argument should be a binary IO stream which supports:
  * close()          - for close() or __exit__() if owns_src
@@ -1348,6 +1786,84 @@ PyTypeObject PyRecordIter_Type = {
     nullptr,                                             // tp_finalize
 };
 
+extern "C" {
+
+static void RecordBufferDestructor(PyRecordBufferObject* self) {
+  self->record.reset();
+  Py_TYPE(self)->tp_free(self);
+}
+
+static int RecordBufferGetBuffer(PyRecordBufferObject* self, Py_buffer* buffer,
+                                 int flags) {
+  return PyBuffer_FillInfo(buffer, reinterpret_cast<PyObject*>(self),
+                           const_cast<char*>(self->data.data()),
+                           IntCast<Py_ssize_t>(self->data.size()), 1, flags);
+}
+
+}  // extern "C"
+
+const PyBufferProcs kRecordBufferBufferProcs = {
+    reinterpret_cast<getbufferproc>(RecordBufferGetBuffer),  // bf_getbuffer
+    nullptr,                                                 // bf_releasebuffer
+};
+
+PyTypeObject PyRecordBuffer_Type = {
+    // clang-format off
+    PyVarObject_HEAD_INIT(&PyType_Type, 0)
+    // clang-format on
+    "RecordBuffer",                                         // tp_name
+    sizeof(PyRecordBufferObject),                           // tp_basicsize
+    0,                                                      // tp_itemsize
+    reinterpret_cast<destructor>(RecordBufferDestructor),   // tp_dealloc
+#if PY_VERSION_HEX >= 0x03080000
+    0,  // tp_vectorcall_offset
+#else
+    nullptr,  // tp_print
+#endif
+    nullptr,                                                // tp_getattr
+    nullptr,                                                // tp_setattr
+    nullptr,                                                // tp_as_async
+    nullptr,                                                // tp_repr
+    nullptr,                                                // tp_as_number
+    nullptr,                                                // tp_as_sequence
+    nullptr,                                                // tp_as_mapping
+    nullptr,                                                // tp_hash
+    nullptr,                                                // tp_call
+    nullptr,                                                // tp_str
+    nullptr,                                                // tp_getattro
+    nullptr,                                                // tp_setattro
+    const_cast<PyBufferProcs*>(&kRecordBufferBufferProcs),  // tp_as_buffer
+    Py_TPFLAGS_DEFAULT,                                     // tp_flags
+    nullptr,                                                // tp_doc
+    nullptr,                                                // tp_traverse
+    nullptr,                                                // tp_clear
+    nullptr,                                                // tp_richcompare
+    0,                                                      // tp_weaklistoffset
+    nullptr,                                                // tp_iter
+    nullptr,                                                // tp_iternext
+    nullptr,                                                // tp_methods
+    nullptr,                                                // tp_members
+    nullptr,                                                // tp_getset
+    nullptr,                                                // tp_base
+    nullptr,                                                // tp_dict
+    nullptr,                                                // tp_descr_get
+    nullptr,                                                // tp_descr_set
+    0,                                                      // tp_dictoffset
+    nullptr,                                                // tp_init
+    nullptr,                                                // tp_alloc
+    nullptr,                                                // tp_new
+    nullptr,                                                // tp_free
+    nullptr,                                                // tp_is_gc
+    nullptr,                                                // tp_bases
+    nullptr,                                                // tp_mro
+    nullptr,                                                // tp_cache
+    nullptr,                                                // tp_subclasses
+    nullptr,                                                // tp_weaklist
+    nullptr,                                                // tp_del
+    0,                                                      // tp_version_tag
+    nullptr,                                                // tp_finalize
+};
+
 const char* const kModuleName = "riegeli.records.record_reader";
 const char kModuleDoc[] = R"doc(Reads records from a Riegeli/records file.)doc";
 
@@ -1365,7 +1881,8 @@ Args:
 
 Returns:
   A generated message type corresponding to the type of records, or None if that
-  information is not available in metadata.
+  information is not available in metadata. Calls with equal metadata return
+  the same type.
 )doc"},
     {nullptr, nullptr, 0, nullptr},
 };
@@ -1389,6 +1906,9 @@ PyObject* InitModule() {
   if (ABSL_PREDICT_FALSE(PyType_Ready(&PyRecordIter_Type) < 0)) {
     return nullptr;
   }
+  if (ABSL_PREDICT_FALSE(PyType_Ready(&PyRecordBuffer_Type) < 0)) {
+    return nullptr;
+  }
   PythonPtr module(PyModule_Create(&kModuleDef));
   if (ABSL_PREDICT_FALSE(module == nullptr)) return nullptr;
   PythonPtr existence_only = IntToPython(Field::kExistenceOnly);
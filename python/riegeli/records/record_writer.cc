@@ -22,6 +22,7 @@
 
 #include <stddef.h>
 
+#include <deque>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -431,6 +432,49 @@ static PyObject* RecordWriterWriteMessage(PyRecordWriterObject* self,
   Py_RETURN_NONE;
 }
 
+// Records gathered by `write_records()` and `write_messages()` are written
+// with the GIL released once per batch of up to this many records or bytes,
+// whichever limit is reached first.
+constexpr size_t kMaxBatchRecords = 1024;
+constexpr size_t kMaxBatchBytes = size_t{1} << 20;
+
+// Writes `records` with the GIL released, and clears `records`.
+//
+// Returns `false` on failure (with Python exception set).
+static bool RecordWriterWriteBatch(PyRecordWriterObject* self,
+                                   std::deque<BytesLike>& records) {
+  if (records.empty()) return true;
+  if (ABSL_PREDICT_FALSE(!self->record_writer.Verify())) return false;
+  const bool ok = PythonUnlocked([&] {
+    for (const BytesLike& record : records) {
+      if (ABSL_PREDICT_FALSE(!self->record_writer->WriteRecord(
+              absl::string_view(record)))) {
+        return false;
+      }
+    }
+    return true;
+  });
+  records.clear();
+  if (ABSL_PREDICT_FALSE(!ok)) {
+    SetExceptionFromRecordWriter(self);
+    return false;
+  }
+  return true;
+}
+
+// Writes records gathered so far, then restores the active Python exception
+// which stopped gathering, unless writing failed.
+//
+// Returns `nullptr` (with Python exception set).
+static PyObject* RecordWriterWriteBatchAndFail(PyRecordWriterObject* self,
+                                               std::deque<BytesLike>& records) {
+  Exception exception = Exception::Fetch();
+  if (ABSL_PREDICT_FALSE(!RecordWriterWriteBatch(self, records))) {
+    return nullptr;
+  }
+  return std::move(exception).Restore();
+}
+
 static PyObject* RecordWriterWriteRecords(PyRecordWriterObject* self,
                                           PyObject* args, PyObject* kwargs) {
   static constexpr const char* keywords[] = {"records", nullptr};
@@ -444,21 +488,30 @@ static PyObject* RecordWriterWriteRecords(PyRecordWriterObject* self,
   //   self.write_record(record)
   const PythonPtr iter(PyObject_GetIter(records_arg));
   if (ABSL_PREDICT_FALSE(iter == nullptr)) return nullptr;
+  // Buffers of records are kept until the batch is written, so that they are
+  // not copied.
+  std::deque<BytesLike> records;
+  size_t batch_bytes = 0;
   while (const PythonPtr record_object{PyIter_Next(iter.get())}) {
-    BytesLike record;
-    if (ABSL_PREDICT_FALSE(!record.FromPython(record_object.get()))) {
-      return nullptr;
+    records.emplace_back();
+    if (ABSL_PREDICT_FALSE(!records.back().FromPython(record_object.get()))) {
+      records.pop_back();
+      return RecordWriterWriteBatchAndFail(self, records);
     }
-    if (ABSL_PREDICT_FALSE(!self->record_writer.Verify())) return nullptr;
-    const bool ok = PythonUnlocked([&] {
-      return self->record_writer->WriteRecord(absl::string_view(record));
-    });
-    if (ABSL_PREDICT_FALSE(!ok)) {
-      SetExceptionFromRecordWriter(self);
-      return nullptr;
+    batch_bytes += absl::string_view(records.back()).size();
+    if (records.size() >= kMaxBatchRecords || batch_bytes >= kMaxBatchBytes) {
+      if (ABSL_PREDICT_FALSE(!RecordWriterWriteBatch(self, records))) {
+        return nullptr;
+      }
+      batch_bytes = 0;
     }
   }
-  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) return nullptr;
+  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) {
+    return RecordWriterWriteBatchAndFail(self, records);
+  }
+  if (ABSL_PREDICT_FALSE(!RecordWriterWriteBatch(self, records))) {
+    return nullptr;
+  }
   Py_RETURN_NONE;
 }
 
@@ -475,25 +528,38 @@ static PyObject* RecordWriterWriteMessages(PyRecordWriterObject* self,
   //   self.write_record(record.SerializeToString())
   const PythonPtr iter(PyObject_GetIter(records_arg));
   if (ABSL_PREDICT_FALSE(iter == nullptr)) return nullptr;
+  // `BytesLike` keeps a reference to the serialized message.
+  std::deque<BytesLike> serialized_records;
+  size_t batch_bytes = 0;
   while (const PythonPtr record_object{PyIter_Next(iter.get())}) {
     static constexpr Identifier id_SerializeToString("SerializeToString");
     const PythonPtr serialized_object(PyObject_CallMethodObjArgs(
         record_object.get(), id_SerializeToString.get(), nullptr));
-    if (ABSL_PREDICT_FALSE(serialized_object == nullptr)) return nullptr;
-    BytesLike serialized;
-    if (ABSL_PREDICT_FALSE(!serialized.FromPython(serialized_object.get()))) {
-      return nullptr;
+    if (ABSL_PREDICT_FALSE(serialized_object == nullptr)) {
+      return RecordWriterWriteBatchAndFail(self, serialized_records);
     }
-    if (ABSL_PREDICT_FALSE(!self->record_writer.Verify())) return nullptr;
-    const bool ok = PythonUnlocked([&] {
-      return self->record_writer->WriteRecord(absl::string_view(serialized));
-    });
-    if (ABSL_PREDICT_FALSE(!ok)) {
-      SetExceptionFromRecordWriter(self);
-      return nullptr;
+    serialized_records.emplace_back();
+    if (ABSL_PREDICT_FALSE(!serialized_records.back().FromPython(
+            serialized_object.get()))) {
+      serialized_records.pop_back();
+      return RecordWriterWriteBatchAndFail(self, serialized_records);
+    }
+    batch_bytes += absl::string_view(serialized_records.back()).size();
+    if (serialized_records.size() >= kMaxBatchRecords ||
+        batch_bytes >= kMaxBatchBytes) {
+      if (ABSL_PREDICT_FALSE(
+              !RecordWriterWriteBatch(self, serialized_records))) {
+        return nullptr;
+      }
+      batch_bytes = 0;
     }
   }
-  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) return nullptr;
+  if (ABSL_PREDICT_FALSE(PyErr_Occurred() != nullptr)) {
+    return RecordWriterWriteBatchAndFail(self, serialized_records);
+  }
+  if (ABSL_PREDICT_FALSE(!RecordWriterWriteBatch(self, serialized_records))) {
+    return nullptr;
+  }
   Py_RETURN_NONE;
 }
 
@@ -608,6 +674,11 @@ write_records(
 
 Writes a number of records.
 
+Records are gathered in batches and each batch is written with the GIL
+released once, which is faster than calling write_record() for each record.
+Records can be any objects supporting the buffer protocol with contiguous
+memory, like NumPy arrays; they are not copied before being written.
+
 Args:
   records: Records to write as an iterable of bytes-like objects.
 )doc"},
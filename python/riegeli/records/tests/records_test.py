@@ -13,6 +13,7 @@
 # limitations under the License.
 
 import abc
+import asyncio
 import contextlib
 from enum import Enum
 import io
@@ -21,6 +22,7 @@ import itertools
 from absl import logging
 from absl.testing import absltest
 from absl.testing import parameterized
+import numpy as np
 import riegeli
 import tensorflow as tf
 
@@ -399,6 +401,148 @@ class RecordsTest(parameterized.TestCase):
             list(reader.read_records()),
             [sample_string(i, 10000) for i in range(23)])
 
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_records_from_buffers(self, file_spec, random_access,
+                                           parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(
+            (memoryview, bytearray)[i % 2](sample_string(i, 1000))
+            for i in range(2000))
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos) as reader:
+        self.assertEqual(
+            list(reader.read_records()),
+            [sample_string(i, 1000) for i in range(2000)])
+
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_records_in_parallel(self, file_spec, random_access,
+                                          parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(sample_string(i, 10000) for i in range(23))
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos,
+          parallelism=4) as reader:
+        self.assertEqual(
+            list(reader.read_records()),
+            [sample_string(i, 10000) for i in range(23)])
+
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_records_with_max_decoded_bytes(self, file_spec,
+                                                     random_access,
+                                                     parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(sample_string(i, 10000) for i in range(23))
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos,
+          parallelism=4,
+          max_decoded_bytes=100000) as reader:
+        self.assertEqual(
+            list(reader.read_records()),
+            [sample_string(i, 10000) for i in range(23)])
+
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_record_batch(self, file_spec, random_access,
+                                   parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(sample_string(i, 10000) for i in range(23))
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos) as reader:
+        self.assertEqual(reader.read_record_batch(0), [])
+        self.assertEqual(
+            reader.read_record_batch(10),
+            [sample_string(i, 10000) for i in range(10)])
+        self.assertEqual(
+            reader.read_record_batch(20),
+            [sample_string(i, 10000) for i in range(10, 23)])
+        self.assertEqual(reader.read_record_batch(10), [])
+
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_records_async(self, file_spec, random_access,
+                                    parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(sample_string(i, 1000) for i in range(2000))
+
+      async def read_records():
+        async with riegeli.AsyncRecordReader(
+            files.reading_open(),
+            batch_size=300,
+            owns_src=files.reading_should_close,
+            assumed_pos=files.reading_assumed_pos,
+            parallelism=parallelism) as reader:
+          first = await reader.read_record()
+          batch = await reader.read_record_batch(10)
+          rest = [record async for record in reader]
+          self.assertIsNone(await reader.read_record())
+          self.assertEqual(await reader.read_record_batch(), [])
+          return [first] + batch + rest
+
+      self.assertEqual(
+          asyncio.run(read_records()),
+          [sample_string(i, 1000) for i in range(2000)])
+
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_record_view(self, file_spec, random_access, parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism)) as writer:
+        writer.write_records(sample_string(i, 10000) for i in range(23))
+      views = []
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos) as reader:
+        for i in range(23):
+          view = reader.read_record_view()
+          self.assertIsInstance(view, memoryview)
+          self.assertTrue(view.readonly)
+          views.append(view)
+        self.assertIsNone(reader.read_record_view())
+      # Views remain valid after the reader is closed.
+      self.assertEqual([bytes(view) for view in views],
+                       [sample_string(i, 10000) for i in range(23)])
+
   @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
   def test_write_read_messages(self, file_spec, random_access, parallelism):
     with contextlib.closing(file_spec(self.create_tempfile,
@@ -441,6 +585,42 @@ class RecordsTest(parameterized.TestCase):
             list(reader.read_messages(records_test_pb2.SimpleMessage)),
             [sample_message_id_only(i) for i in range(23)])
 
+  @_PARAMETERIZE_BY_FILE_SPEC_AND_RANDOM_ACCESS_AND_PARALLELISM
+  def test_write_read_columns(self, file_spec, random_access, parallelism):
+    with contextlib.closing(file_spec(self.create_tempfile,
+                                      random_access)) as files:
+      with riegeli.RecordWriter(
+          files.writing_open(),
+          owns_dest=files.writing_should_close,
+          assumed_pos=files.writing_assumed_pos,
+          options=record_writer_options(parallelism, transpose=True)) as writer:
+        writer.write_messages(sample_message(i, 100) for i in range(23))
+      id_field = records_test_pb2.SimpleMessage.DESCRIPTOR.fields_by_name['id']
+      payload_field = (
+          records_test_pb2.SimpleMessage.DESCRIPTOR.fields_by_name['payload'])
+      with riegeli.RecordReader(
+          files.reading_open(),
+          owns_src=files.reading_should_close,
+          assumed_pos=files.reading_assumed_pos,
+          field_projection=[[id_field.number],
+                            [payload_field.number]]) as reader:
+        columns = [((id_field.number,), 'int64'),
+                   ((payload_field.number,), 'bytes')]
+        (ids, id_offsets), (data, value_offsets, payload_offsets) = (
+            reader.read_columns(columns, 20))
+        np.testing.assert_array_equal(ids, np.arange(20))
+        np.testing.assert_array_equal(id_offsets, np.arange(21))
+        np.testing.assert_array_equal(payload_offsets, np.arange(21))
+        self.assertEqual([
+            data[value_offsets[i]:value_offsets[i + 1]].tobytes()
+            for i in range(20)
+        ], [sample_string(i, 100) for i in range(20)])
+        (ids, id_offsets), _ = reader.read_columns(columns, 20)
+        np.testing.assert_array_equal(ids, np.arange(20, 23))
+        (ids, id_offsets), _ = reader.read_columns(columns, 20)
+        self.assertEqual(len(ids), 0)
+        np.testing.assert_array_equal(id_offsets, [0])
+
   @_PARAMETERIZE_BY_FILE_SPEC_AND_PARALLELISM
   def test_write_read_messages_with_field_projection_later(
       self, file_spec, parallelism):
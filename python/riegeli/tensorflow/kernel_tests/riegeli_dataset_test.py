@@ -238,6 +238,79 @@ class RiegeliDatasetTest(DatasetTestBase):
           [self._record(j, i) for i in range(self._num_records)])
     self.assertDatasetProduces(dataset, expected_output=expected_output * 10)
 
+  def test_read_batch_dataset(self):
+    # Batches do not span files, hence the last batch of each file is smaller.
+    dataset = riegeli_dataset_ops.RiegeliBatchDataset(
+        self.test_filenames, batch_size=3)
+    expected_output = []
+    for j in range(self._num_files):
+      records = [self._record(j, i) for i in range(self._num_records)]
+      expected_output.extend(
+          records[i:i + 3] for i in range(0, self._num_records, 3))
+    self.assertDatasetProduces(dataset, expected_output=expected_output)
+
+  def test_read_with_max_decoded_bytes(self):
+    # A budget smaller than a chunk still reads one chunk at a time.
+    dataset = riegeli_dataset_ops.RiegeliDataset(
+        self.test_filenames, parallelism=4, max_decoded_bytes=1)
+    expected_output = []
+    for j in range(self._num_files):
+      expected_output.extend(
+          [self._record(j, i) for i in range(self._num_records)])
+    self.assertDatasetProduces(dataset, expected_output=expected_output)
+
+  def test_read_parallel_dataset(self):
+    # Deterministic order interleaves records of files in turn.
+    dataset = riegeli_dataset_ops.RiegeliParallelDataset(
+        self.test_filenames, cycle_length=self._num_files, prefetch_size=2)
+    expected_output = []
+    for i in range(self._num_records):
+      expected_output.extend(
+          [self._record(j, i) for j in range(self._num_files)])
+    self.assertDatasetProduces(dataset, expected_output=expected_output)
+
+    # Sloppy order emits the same records in some order.
+    dataset = riegeli_dataset_ops.RiegeliParallelDataset(
+        self.test_filenames,
+        cycle_length=self._num_files,
+        prefetch_size=2,
+        deterministic=False)
+    self.assertDatasetProduces(
+        dataset, expected_output=expected_output, assert_items_equal=True)
+
+  def test_read_shuffle_dataset(self):
+    dataset = riegeli_dataset_ops.RiegeliShuffleDataset(
+        self.test_filenames, window_size=3, seed=42, range_size=1)
+    expected_output = []
+    for j in range(self._num_files):
+      expected_output.extend(
+          [self._record(j, i) for i in range(self._num_records)])
+    self.assertDatasetProduces(
+        dataset, expected_output=expected_output, assert_items_equal=True)
+
+  def test_write_dataset(self):
+    records = [self._record(0, i) for i in range(self._num_records)]
+    filename = os.path.join(self.get_temp_dir(), 'riegeli.written')
+    self.evaluate(
+        riegeli_dataset_ops.write_riegeli_dataset(
+            tf.data.Dataset.from_tensor_slices(records),
+            filename,
+            options='parallelism:2'))
+    self.assertDatasetProduces(
+        riegeli_dataset_ops.RiegeliDataset(filename), expected_output=records)
+
+    # Shards get records in turn.
+    self.evaluate(
+        riegeli_dataset_ops.write_riegeli_dataset(
+            tf.data.Dataset.from_tensor_slices(records),
+            filename,
+            num_shards=2))
+    for shard in range(2):
+      shard_filename = f'{filename}-{shard:05d}-of-00002'
+      self.assertDatasetProduces(
+          riegeli_dataset_ops.RiegeliDataset(shard_filename),
+          expected_output=records[shard::2])
+
 
 if __name__ == '__main__':
   tf.test.main()
@@ -23,9 +23,33 @@ from tensorflow.python.platform import resource_loader
 gen_riegeli_dataset_ops = load_library.load_op_library(
     resource_loader.get_path_to_datafile('_riegeli_dataset_ops.so'))
 
-__all__ = ('RiegeliDataset',)
+__all__ = ('RiegeliDataset', 'RiegeliBatchDataset',
+           'RiegeliParallelDataset', 'RiegeliShuffleDataset',
+           'write_riegeli_dataset')
 
 _DEFAULT_BUFFER_SIZE = 64 << 10
+_DEFAULT_PREFETCH_SIZE = 1024
+_DEFAULT_RANGE_SIZE = 1 << 20
+_DEFAULT_NUM_PARALLEL_READS = 4
+
+
+def _field_paths(field_projection):
+  """Converts a field projection to the `field_projection` attr of an op."""
+  if field_projection is None:
+    return []
+  return [
+      '.'.join(str(field_number) for field_number in field_path)
+      for field_path in field_projection
+  ]
+
+
+def _max_decoded_bytes(max_decoded_bytes):
+  """Converts max_decoded_bytes to the `max_decoded_bytes` attr of an op."""
+  if max_decoded_bytes is None:
+    return -1
+  if max_decoded_bytes < 0:
+    raise ValueError(f'Negative max_decoded_bytes: {max_decoded_bytes}')
+  return max_decoded_bytes
 
 
 class RiegeliDataset(dataset_ops.DatasetSource):
@@ -33,21 +57,250 @@ class RiegeliDataset(dataset_ops.DatasetSource):
 
   __slots__ = ('_filenames', '_buffer_size')
 
-  def __init__(self, filenames, buffer_size=None):
+  def __init__(self,
+               filenames,
+               buffer_size=None,
+               field_projection=None,
+               parallelism=0,
+               max_decoded_bytes=None):
     """Creates a `RiegeliDataset`.
 
     Args:
       filenames: A `tf.string` tensor containing one or more filenames.
       buffer_size: A `tf.int64` scalar which tunes how much data is buffered
         after reading from the file. Default: 64K.
+      field_projection: If not None, the set of fields to be included in
+        returned records, allowing to exclude the remaining fields (but does
+        not guarantee that they will be excluded). Excluding data makes reading
+        faster. Projection is effective if the files have been written with
+        "transpose" in RecordWriter options. A field projection is specified as
+        an iterable of field paths. A field path is specified as an iterable of
+        proto field numbers descending from the root message. A special field
+        number riegeli.EXISTENCE_ONLY (0) can be added to the end of the path;
+        it preserves field existence but ignores its value.
+      parallelism: If positive, the maximum number of chunks of each file read
+        ahead and decoded in parallel in background threads. This overlaps
+        decoding with consuming records. Default: 0.
+      max_decoded_bytes: If not None and parallelism is positive, the maximum
+        total decoded size of chunks of each file read ahead and not emitted
+        yet. Reading ahead waits for records to be consumed rather than
+        exceeding it, which bounds memory usage of a consumer slower than
+        decoding. At least one chunk is read ahead even if it is larger.
     """
     self._filenames = tf.convert_to_tensor(filenames, name='filenames')
     self._buffer_size = convert.optional_param_to_tensor(
         'buffer_size', buffer_size, argument_default=_DEFAULT_BUFFER_SIZE)
     variant_tensor = gen_riegeli_dataset_ops.riegeli_dataset(
-        self._filenames, self._buffer_size)
+        self._filenames,
+        self._buffer_size,
+        field_projection=_field_paths(field_projection),
+        parallelism=parallelism,
+        max_decoded_bytes=_max_decoded_bytes(max_decoded_bytes))
     super(RiegeliDataset, self).__init__(variant_tensor)
 
   @property
   def element_spec(self):
     return tf.TensorSpec([], tf.dtypes.string)
+
+
+class RiegeliBatchDataset(dataset_ops.DatasetSource):
+  """A `Dataset` comprising batches of records from Riegeli/records files.
+
+  Each element is a `tf.string` vector of up to `batch_size` records. This is
+  like `RiegeliDataset(filenames).batch(batch_size)`, except that a batch does
+  not span files, but is faster for small records.
+  """
+
+  __slots__ = ('_filenames', '_buffer_size', '_batch_size')
+
+  def __init__(self,
+               filenames,
+               batch_size,
+               buffer_size=None,
+               field_projection=None,
+               parallelism=0,
+               max_decoded_bytes=None):
+    """Creates a `RiegeliBatchDataset`.
+
+    Args:
+      filenames: A `tf.string` tensor containing one or more filenames.
+      batch_size: A `tf.int64` scalar with the maximum number of records in a
+        batch.
+      buffer_size: A `tf.int64` scalar which tunes how much data is buffered
+        after reading from the file. Default: 64K.
+      field_projection: If not None, the set of fields to be included in
+        returned records, allowing to exclude the remaining fields (but does
+        not guarantee that they will be excluded). Excluding data makes reading
+        faster. Projection is effective if the files have been written with
+        "transpose" in RecordWriter options. A field projection is specified as
+        an iterable of field paths. A field path is specified as an iterable of
+        proto field numbers descending from the root message. A special field
+        number riegeli.EXISTENCE_ONLY (0) can be added to the end of the path;
+        it preserves field existence but ignores its value.
+      parallelism: If positive, the maximum number of chunks of each file read
+        ahead and decoded in parallel in background threads. This overlaps
+        decoding with consuming records. Default: 0.
+      max_decoded_bytes: If not None and parallelism is positive, the maximum
+        total decoded size of chunks of each file read ahead and not emitted
+        yet. Reading ahead waits for records to be consumed rather than
+        exceeding it, which bounds memory usage of a consumer slower than
+        decoding. At least one chunk is read ahead even if it is larger.
+    """
+    self._filenames = tf.convert_to_tensor(filenames, name='filenames')
+    self._batch_size = convert.optional_param_to_tensor(
+        'batch_size', batch_size)
+    self._buffer_size = convert.optional_param_to_tensor(
+        'buffer_size', buffer_size, argument_default=_DEFAULT_BUFFER_SIZE)
+    variant_tensor = gen_riegeli_dataset_ops.riegeli_batch_dataset(
+        self._filenames,
+        self._buffer_size,
+        self._batch_size,
+        field_projection=_field_paths(field_projection),
+        parallelism=parallelism,
+        max_decoded_bytes=_max_decoded_bytes(max_decoded_bytes))
+    super(RiegeliBatchDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return tf.TensorSpec([None], tf.dtypes.string)
+
+
+class RiegeliParallelDataset(dataset_ops.DatasetSource):
+  """A `Dataset` comprising records from Riegeli/records files read in parallel.
+
+  This is like
+  `tf.data.Dataset.from_tensor_slices(filenames).interleave(RiegeliDataset,
+  cycle_length)`, but keeps the readers in one dataset, and reads ahead from
+  each file in the background.
+  """
+
+  __slots__ = ('_filenames', '_buffer_size', '_cycle_length', '_prefetch_size',
+               '_deterministic')
+
+  def __init__(self,
+               filenames,
+               cycle_length,
+               prefetch_size=None,
+               deterministic=True,
+               buffer_size=None):
+    """Creates a `RiegeliParallelDataset`.
+
+    Args:
+      filenames: A `tf.string` tensor containing one or more filenames.
+      cycle_length: A `tf.int64` scalar with the number of files read
+        concurrently.
+      prefetch_size: A `tf.int64` scalar with the maximum number of records
+        read ahead from each file. Default: 1024.
+      deterministic: A `tf.bool` scalar. If `True`, records of files are
+        interleaved in turn. If `False`, the next available record is
+        returned, which avoids waiting for a slow file. Default: `True`.
+      buffer_size: A `tf.int64` scalar which tunes how much data is buffered
+        after reading from the file. Default: 64K.
+    """
+    self._filenames = tf.convert_to_tensor(filenames, name='filenames')
+    self._buffer_size = convert.optional_param_to_tensor(
+        'buffer_size', buffer_size, argument_default=_DEFAULT_BUFFER_SIZE)
+    self._cycle_length = convert.optional_param_to_tensor(
+        'cycle_length', cycle_length)
+    self._prefetch_size = convert.optional_param_to_tensor(
+        'prefetch_size', prefetch_size,
+        argument_default=_DEFAULT_PREFETCH_SIZE)
+    self._deterministic = tf.convert_to_tensor(
+        deterministic, dtype=tf.dtypes.bool, name='deterministic')
+    variant_tensor = gen_riegeli_dataset_ops.riegeli_parallel_dataset(
+        self._filenames, self._buffer_size, self._cycle_length,
+        self._prefetch_size, self._deterministic)
+    super(RiegeliParallelDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return tf.TensorSpec([], tf.dtypes.string)
+
+
+class RiegeliShuffleDataset(dataset_ops.DatasetSource):
+  """A `Dataset` comprising records from Riegeli/records files, shuffled.
+
+  Shuffling is approximate: ranges of about `range_size` bytes of the files are
+  read in a random order, and records are shuffled within a window of
+  `window_size` records. Memory is bounded by the window and by ranges being
+  read, independently of the size of the files.
+  """
+
+  __slots__ = ('_filenames', '_buffer_size', '_range_size', '_window_size',
+               '_num_parallel_reads', '_seed')
+
+  def __init__(self,
+               filenames,
+               window_size,
+               seed=None,
+               range_size=None,
+               num_parallel_reads=None,
+               buffer_size=None):
+    """Creates a `RiegeliShuffleDataset`.
+
+    Args:
+      filenames: A `tf.string` tensor containing one or more filenames.
+      window_size: A `tf.int64` scalar with the number of records to choose the
+        next record from.
+      seed: A `tf.int64` scalar with the seed of the random order. Default: 0.
+      range_size: A `tf.int64` scalar with the approximate size of a range of
+        a file in bytes. Smaller ranges make shuffling closer to global, at the
+        cost of more seeks. Default: 1M.
+      num_parallel_reads: A `tf.int64` scalar with the number of ranges read
+        ahead concurrently. Default: 4.
+      buffer_size: A `tf.int64` scalar which tunes how much data is buffered
+        after reading from the file. Default: 64K.
+    """
+    self._filenames = tf.convert_to_tensor(filenames, name='filenames')
+    self._buffer_size = convert.optional_param_to_tensor(
+        'buffer_size', buffer_size, argument_default=_DEFAULT_BUFFER_SIZE)
+    self._range_size = convert.optional_param_to_tensor(
+        'range_size', range_size, argument_default=_DEFAULT_RANGE_SIZE)
+    self._window_size = convert.optional_param_to_tensor(
+        'window_size', window_size)
+    self._num_parallel_reads = convert.optional_param_to_tensor(
+        'num_parallel_reads',
+        num_parallel_reads,
+        argument_default=_DEFAULT_NUM_PARALLEL_READS)
+    self._seed = convert.optional_param_to_tensor('seed', seed)
+    variant_tensor = gen_riegeli_dataset_ops.riegeli_shuffle_dataset(
+        self._filenames, self._buffer_size, self._range_size,
+        self._window_size, self._num_parallel_reads, self._seed)
+    super(RiegeliShuffleDataset, self).__init__(variant_tensor)
+
+  @property
+  def element_spec(self):
+    return tf.TensorSpec([], tf.dtypes.string)
+
+
+def write_riegeli_dataset(dataset, filename, options='', num_shards=1):
+  """Writes records of a dataset to Riegeli/records files.
+
+  Records are written by a C++ kernel as they are produced by the dataset,
+  without passing through Python. With `num_shards > 1`, records are
+  distributed in turn among files named `filename-SSSSS-of-NNNNN`.
+
+  Args:
+    dataset: A `tf.data.Dataset` of `tf.string` scalars.
+    filename: A `tf.string` scalar with the name of the file to be written, or
+      the prefix of shard names.
+    options: A `tf.string` scalar with RecordWriter options in the text format,
+      e.g. 'transpose,parallelism:4'. With parallelism, each shard encodes
+      chunks in the background while the next records are taken from the
+      dataset. Default: ''.
+    num_shards: A `tf.int64` scalar with the number of files to write.
+      Default: 1.
+
+  Returns:
+    In graph mode, the op which writes the files when run. In eager mode, the
+    files are written before returning.
+  """
+  if not dataset.element_spec.is_compatible_with(
+      tf.TensorSpec([], tf.dtypes.string)):
+    raise TypeError('dataset must contain tf.string scalars, not '
+                    f'{dataset.element_spec}')
+  return gen_riegeli_dataset_ops.write_riegeli_dataset(
+      dataset._variant_tensor,  # pylint: disable=protected-access
+      tf.convert_to_tensor(filename, tf.dtypes.string, name='filename'),
+      tf.convert_to_tensor(options, tf.dtypes.string, name='options'),
+      tf.convert_to_tensor(num_shards, tf.dtypes.int64, name='num_shards'))
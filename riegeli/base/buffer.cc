@@ -14,15 +14,116 @@
 
 #include "riegeli/base/buffer.h"
 
+#include <stddef.h>
+
 #include <functional>
 #include <utility>
 
+#include "absl/base/attributes.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/huge_pages.h"
+#include "riegeli/base/memory.h"
+#include "riegeli/base/memory_budget.h"
 
 namespace riegeli {
 
+#if !__cpp_inline_variables
+constexpr size_t Buffer::kMinRecycledCapacity;
+#endif
+
+namespace {
+
+// A buffer freed by the current thread, kept for reuse.
+struct CachedBuffer {
+  char* data;
+  size_t capacity;
+};
+
+constexpr size_t kMaxCachedBuffers = 4;
+constexpr size_t kMaxCachedCapacity = size_t{1} << 20;
+constexpr size_t kMaxCachedBytes = size_t{2} << 20;
+
+// The cache is trivially destructible, so that it remains usable by `Buffer`
+// destructors running during thread exit. `BufferCacheCleanup` frees the cached
+// buffers at thread exit and disables further caching.
+ABSL_CONST_INIT thread_local CachedBuffer cached_buffers[kMaxCachedBuffers] =
+    {};
+ABSL_CONST_INIT thread_local size_t num_cached_buffers = 0;
+ABSL_CONST_INIT thread_local size_t cached_bytes = 0;
+ABSL_CONST_INIT thread_local bool buffer_cache_disabled = false;
+
+void FreeBuffer(char* data, size_t capacity) {
+  internal::ReportFreed(capacity);
+#if __cpp_sized_deallocation || __GXX_DELETE_WITH_SIZE__
+  operator delete(data, capacity);
+#else
+  operator delete(data);
+#endif
+}
+
+class BufferCacheCleanup {
+ public:
+  BufferCacheCleanup() noexcept {}
+
+  BufferCacheCleanup(const BufferCacheCleanup&) = delete;
+  BufferCacheCleanup& operator=(const BufferCacheCleanup&) = delete;
+
+  ~BufferCacheCleanup() {
+    buffer_cache_disabled = true;
+    while (num_cached_buffers > 0) {
+      const CachedBuffer& cached = cached_buffers[--num_cached_buffers];
+      FreeBuffer(cached.data, cached.capacity);
+    }
+    cached_bytes = 0;
+  }
+
+  // Ensures that the destructor is registered for the current thread.
+  void Register() {}
+};
+
+thread_local BufferCacheCleanup buffer_cache_cleanup;
+
+}  // namespace
+
+void Buffer::AllocateRecycled(size_t min_capacity) {
+  // Take the smallest cached buffer which fits and would not be wasteful.
+  size_t best = num_cached_buffers;
+  for (size_t i = 0; i < num_cached_buffers; ++i) {
+    const size_t capacity = cached_buffers[i].capacity;
+    if (capacity >= min_capacity && !Wasteful(capacity, min_capacity) &&
+        (best == num_cached_buffers ||
+         capacity < cached_buffers[best].capacity)) {
+      best = i;
+    }
+  }
+  if (best != num_cached_buffers) {
+    data_ = cached_buffers[best].data;
+    capacity_ = cached_buffers[best].capacity;
+    cached_bytes -= capacity_;
+    cached_buffers[best] = cached_buffers[--num_cached_buffers];
+    return;
+  }
+  const size_t capacity = EstimatedAllocatedSize(min_capacity);
+  data_ = static_cast<char*>(operator new(capacity));
+  capacity_ = capacity;
+  internal::ReportAllocated(capacity_);
+  internal::MaybeAdviseHugePages(data_, capacity_);
+}
+
+void Buffer::DeleteRecycled() {
+  if (capacity_ <= kMaxCachedCapacity && !buffer_cache_disabled &&
+      num_cached_buffers < kMaxCachedBuffers &&
+      capacity_ <= kMaxCachedBytes - cached_bytes) {
+    buffer_cache_cleanup.Register();
+    cached_buffers[num_cached_buffers++] = CachedBuffer{data_, capacity_};
+    cached_bytes += capacity_;
+    return;
+  }
+  FreeBuffer(data_, capacity_);
+}
+
 absl::Cord Buffer::ToCord(absl::string_view substr) {
   RIEGELI_ASSERT(std::greater_equal<>()(substr.data(), data()))
       << "Failed precondition of Buffer::ToCord(): "
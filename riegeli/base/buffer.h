@@ -23,10 +23,17 @@
 #include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/memory.h"
+#include "riegeli/base/memory_budget.h"
 
 namespace riegeli {
 
 // Dynamically allocated byte buffer.
+//
+// Buffers of at least `kMinRecycledCapacity` are recycled: when such a buffer
+// is freed, it is kept in a small per-thread cache, and a later allocation by
+// the same thread reuses it if it fits. This avoids heap operations and
+// faulting in pages again when short-lived readers and writers are opened
+// repeatedly.
 class Buffer {
  public:
   Buffer() noexcept {}
@@ -51,6 +58,7 @@ class Buffer {
 
   // Returns the data pointer, releasing its ownership; the `Buffer` is left
   // deallocated. The returned pointer must be deleted using `DeleteReleased()`.
+  // The memory is no longer accounted in `GlobalMemoryBudget()`.
   //
   // If the returned pointer is `nullptr`, it allowed but not required to call
   // `DeleteReleased()`.
@@ -66,8 +74,14 @@ class Buffer {
   absl::Cord ToCord(absl::string_view substr);
 
  private:
+  static constexpr size_t kMinRecycledCapacity = size_t{4} << 10;
+
   void AllocateInternal(size_t min_capacity);
   void DeleteInternal();
+  // Implementation of `AllocateInternal()` and `DeleteInternal()` for buffers
+  // which are recycled.
+  void AllocateRecycled(size_t min_capacity);
+  void DeleteRecycled();
 
   char* data_ = nullptr;
   size_t capacity_ = 0;
@@ -100,20 +114,32 @@ inline void Buffer::Reset(size_t min_capacity) {
 }
 
 inline void Buffer::AllocateInternal(size_t min_capacity) {
+  if (min_capacity >= kMinRecycledCapacity) {
+    AllocateRecycled(min_capacity);
+    return;
+  }
   const size_t capacity = EstimatedAllocatedSize(min_capacity);
   data_ = static_cast<char*>(operator new(capacity));
   capacity_ = capacity;
+  internal::ReportAllocated(capacity_);
 }
 
 inline void Buffer::DeleteInternal() {
+  if (capacity_ >= kMinRecycledCapacity) {
+    DeleteRecycled();
+    return;
+  }
+  if (data_ == nullptr) return;
+  internal::ReportFreed(capacity_);
 #if __cpp_sized_deallocation || __GXX_DELETE_WITH_SIZE__
-  if (data_ != nullptr) operator delete(data_, capacity_);
+  operator delete(data_, capacity_);
 #else
-  if (data_ != nullptr) operator delete(data_);
+  operator delete(data_);
 #endif
 }
 
 inline char* Buffer::Release() {
+  if (data_ != nullptr) internal::ReportFreed(capacity_);
   capacity_ = 0;
   return std::exchange(data_, nullptr);
 }
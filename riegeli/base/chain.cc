@@ -29,15 +29,20 @@
 #include <type_traits>
 #include <utility>
 
+#include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/compare.h"
 #include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/huge_pages.h"
 #include "riegeli/base/intrusive_ref_count.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/memory.h"
+#include "riegeli/base/memory_budget.h"
 #include "riegeli/base/memory_estimator.h"
 
 namespace riegeli {
@@ -60,6 +65,9 @@ constexpr size_t ChainBlock::kAnyLength;
 
 namespace {
 
+// The `ChainBlockPool` used by the current thread, or `nullptr`.
+ABSL_CONST_INIT thread_local ChainBlockPool* current_chain_block_pool = nullptr;
+
 void WritePadding(std::ostream& out, size_t pad) {
   char buf[64];
   std::memset(buf, out.fill(), sizeof(buf));
@@ -293,8 +301,30 @@ inline Chain::RawBlock* Chain::RawBlock::NewInternal(size_t min_capacity) {
   RIEGELI_ASSERT_GT(min_capacity, 0u)
       << "Failed precondition of Chain::RawBlock::NewInternal(): zero capacity";
   size_t raw_capacity;
-  return SizeReturningNewAligned<RawBlock>(
+  if (ChainBlockPool* const pool = current_chain_block_pool) {
+    RawBlock* const block = pool->TakeBlock(min_capacity, &raw_capacity);
+    if (block != nullptr) {
+      raw_capacity += kInternalAllocatedOffset();
+      return new (block) RawBlock(&raw_capacity);
+    }
+  }
+  RawBlock* const block = SizeReturningNewAligned<RawBlock>(
       kInternalAllocatedOffset() + min_capacity, &raw_capacity, &raw_capacity);
+  internal::ReportAllocated(raw_capacity);
+  internal::MaybeAdviseHugePages(block, raw_capacity);
+  return block;
+}
+
+void Chain::RawBlock::DeleteInternal(RawBlock* block) {
+  RIEGELI_ASSERT(block->is_internal())
+      << "Failed precondition of Chain::RawBlock::DeleteInternal(): "
+         "block not internal";
+  if (ChainBlockPool* const pool = current_chain_block_pool) {
+    if (pool->PutBlock(block, block->capacity())) return;
+  }
+  const size_t raw_capacity = kInternalAllocatedOffset() + block->capacity();
+  internal::ReportFreed(raw_capacity);
+  DeleteAligned<RawBlock>(block, raw_capacity);
 }
 
 inline Chain::RawBlock::RawBlock(const size_t* raw_capacity)
@@ -585,16 +615,20 @@ inline void Chain::RawBlock::AppendSubstrTo(absl::string_view substr,
          "Chain size overflow";
   if (substr.size() == size()) {
     if (wasteful()) {
+      internal::CountCopied(substr.size());
       dest.Append(substr, options);
       return;
     }
+    internal::CountShared(substr.size());
     dest.AppendRawBlock(this, options);
     return;
   }
   if (substr.size() <= kMaxBytesToCopy || wasteful()) {
+    internal::CountCopied(substr.size());
     dest.Append(substr, options);
     return;
   }
+  internal::CountShared(substr.size());
   dest.Append(
       ChainBlock::FromExternal<BlockRef>(
           std::forward_as_tuple(
@@ -616,9 +650,11 @@ inline void Chain::RawBlock::AppendSubstrTo(absl::string_view substr,
       << "Failed precondition of Chain::RawBlock::AppendSubstrTo(Cord&): "
          "Cord size overflow";
   if (substr.size() <= MaxBytesToCopyToCord(dest) || wasteful()) {
+    internal::CountCopied(substr.size());
     AppendToCord(substr, dest);
     return;
   }
+  internal::CountShared(substr.size());
   if (const FlatCordRef* const cord_ref =
           checked_external_object<FlatCordRef>()) {
     cord_ref->AppendSubstrTo(substr, dest);
@@ -827,6 +863,7 @@ absl::string_view Chain::FlattenSlow() {
   RIEGELI_ASSERT_GT(end_ - begin_, 1)
       << "Failed precondition of Chain::FlattenSlow(): "
          "contents already flat, use Flatten() instead";
+  internal::CountChainFlatten(size_);
   RawBlock* const block =
       RawBlock::NewInternal(NewBlockCapacity(0, size_, size_, Options()));
   const BlockPtr* iter = begin_;
@@ -2719,4 +2756,57 @@ Chain ChainOfZeros(size_t length) {
   return result;
 }
 
+ChainBlockPool::~ChainBlockPool() { Clear(); }
+
+void ChainBlockPool::Clear() {
+  for (std::vector<CachedBlock>& size_class : size_classes_) {
+    for (const CachedBlock& cached : size_class) {
+      const size_t raw_capacity =
+          Chain::RawBlock::kInternalAllocatedOffset() + cached.capacity;
+      internal::ReportFreed(raw_capacity);
+      DeleteAligned<Chain::RawBlock>(cached.block, raw_capacity);
+    }
+    size_class.clear();
+  }
+  cached_bytes_ = 0;
+}
+
+inline Chain::RawBlock* ChainBlockPool::TakeBlock(size_t min_capacity,
+                                                  size_t* capacity) {
+  // Blocks in `size_classes_[index]` have at least `min_capacity`, blocks in
+  // `size_classes_[index - 1]` might have. A block with more capacity than
+  // `min_capacity` is taken only if it would not be wasteful when filled.
+  const size_t index = IntCast<size_t>(absl::bit_width(min_capacity - 1));
+  for (size_t i = index == 0 ? 0 : index - 1;
+       i <= index && i < kNumSizeClasses; ++i) {
+    std::vector<CachedBlock>& size_class = size_classes_[i];
+    if (size_class.empty()) continue;
+    const CachedBlock cached = size_class.back();
+    if (cached.capacity < min_capacity ||
+        Wasteful(cached.capacity, min_capacity)) {
+      continue;
+    }
+    size_class.pop_back();
+    cached_bytes_ -= cached.capacity;
+    *capacity = cached.capacity;
+    return cached.block;
+  }
+  return nullptr;
+}
+
+inline bool ChainBlockPool::PutBlock(Chain::RawBlock* block, size_t capacity) {
+  if (capacity > max_cached_bytes_ - cached_bytes_) return false;
+  const size_t index = IntCast<size_t>(absl::bit_width(capacity)) - 1;
+  size_classes_[index].push_back(CachedBlock{block, capacity});
+  cached_bytes_ += capacity;
+  return true;
+}
+
+ScopedChainBlockPool::ScopedChainBlockPool(ChainBlockPool* pool)
+    : previous_pool_(std::exchange(current_chain_block_pool, pool)) {}
+
+ScopedChainBlockPool::~ScopedChainBlockPool() {
+  current_chain_block_pool = previous_pool_;
+}
+
 }  // namespace riegeli
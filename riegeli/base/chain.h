@@ -28,6 +28,7 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -155,6 +156,13 @@ class ChainBlock;
 //
 // A `Chain` is implemented with a sequence of blocks holding flat data
 // fragments.
+//
+// Block pointers are kept in an array with free space on both sides, which
+// grows geometrically and is recentered when one side runs out of space. Hence
+// appending, prepending, and removing a block from either end take amortized
+// constant time, even for a very large number of blocks. Blocks are
+// additionally indexed by their starting positions, so that
+// `BlockAndCharIndex()` takes logarithmic time in the number of blocks.
 class Chain {
  public:
   using Options = internal::ChainOptions;
@@ -408,6 +416,7 @@ class Chain {
 
  private:
   friend class ChainBlock;
+  friend class ChainBlockPool;
 
   struct ExternalMethods;
   template <typename T>
@@ -936,6 +945,80 @@ class ChainBlock {
 // Returns the given number of zero bytes.
 Chain ChainOfZeros(size_t length);
 
+// A cache of internal `Chain` blocks which are reused instead of being freed
+// and allocated again. This reduces the memory allocator overhead when many
+// short-lived `Chain`s are built, e.g. in request-scoped encoders.
+//
+// A `ChainBlockPool` is used by a thread while a `ScopedChainBlockPool` is
+// active on that thread: internal blocks allocated by the thread are taken
+// from the pool if possible, and internal blocks freed by the thread are
+// returned to the pool while it has space. Blocks are not tied to the pool,
+// so they can outlive the scope, and they can be freed by other threads.
+//
+// The cached blocks are freed by `Clear()` and by the destructor.
+//
+// `ChainBlockPool` is thread-compatible: it must be active on at most one
+// thread at a time.
+class ChainBlockPool {
+ public:
+  // Creates an empty `ChainBlockPool` caching up to `max_cached_bytes` of block
+  // capacity.
+  explicit ChainBlockPool(size_t max_cached_bytes = size_t{1} << 20) noexcept
+      : max_cached_bytes_(max_cached_bytes) {}
+
+  ChainBlockPool(const ChainBlockPool&) = delete;
+  ChainBlockPool& operator=(const ChainBlockPool&) = delete;
+
+  // Precondition: no `ScopedChainBlockPool` using this pool is active.
+  ~ChainBlockPool();
+
+  // Frees the cached blocks.
+  void Clear();
+
+  // Returns the maximum total capacity of the cached blocks.
+  size_t max_cached_bytes() const { return max_cached_bytes_; }
+
+  // Returns the total capacity of the cached blocks.
+  size_t cached_bytes() const { return cached_bytes_; }
+
+ private:
+  friend class Chain;
+
+  struct CachedBlock {
+    Chain::RawBlock* block;
+    size_t capacity;
+  };
+
+  // Blocks with capacity in [2^i, 2^(i + 1)) are cached in `size_classes_[i]`.
+  static constexpr size_t kNumSizeClasses = std::numeric_limits<size_t>::digits;
+
+  // Returns a cached block with capacity at least `min_capacity`, or `nullptr`
+  // if there is none. `*capacity` is set to its capacity.
+  Chain::RawBlock* TakeBlock(size_t min_capacity, size_t* capacity);
+
+  // Caches `block` with `capacity` if there is space, returning `true`.
+  bool PutBlock(Chain::RawBlock* block, size_t capacity);
+
+  size_t max_cached_bytes_;
+  size_t cached_bytes_ = 0;
+  std::vector<CachedBlock> size_classes_[kNumSizeClasses];
+};
+
+// Makes a `ChainBlockPool` used by the current thread in the constructor, and
+// restores the previously used pool, if any, in the destructor.
+class ScopedChainBlockPool {
+ public:
+  explicit ScopedChainBlockPool(ChainBlockPool* pool);
+
+  ScopedChainBlockPool(const ScopedChainBlockPool&) = delete;
+  ScopedChainBlockPool& operator=(const ScopedChainBlockPool&) = delete;
+
+  ~ScopedChainBlockPool();
+
+ private:
+  ChainBlockPool* previous_pool_;
+};
+
 // Implementation details follow.
 
 // `Chain` representation consists of blocks.
@@ -966,6 +1049,9 @@ class Chain::RawBlock {
   // Creates an internal block.
   static RawBlock* NewInternal(size_t min_capacity);
 
+  // Frees an internal block, or returns it to the current `ChainBlockPool`.
+  static void DeleteInternal(RawBlock* block);
+
   // Constructs an internal block. This constructor is public for
   // `SizeReturningNewAligned()`.
   explicit RawBlock(const size_t* raw_capacity);
@@ -1360,7 +1446,7 @@ void Chain::RawBlock::Unref() {
       (has_unique_owner() ||
        ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)) {
     if (is_internal()) {
-      DeleteAligned<RawBlock>(this, kInternalAllocatedOffset() + capacity());
+      DeleteInternal(this);
     } else {
       external_.methods->delete_block(this);
     }
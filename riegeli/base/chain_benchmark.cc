@@ -0,0 +1,95 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/base/chain.h"
+
+namespace riegeli {
+namespace {
+
+// The amount of data appended or prepended by one iteration.
+constexpr size_t kTotalSize = size_t{1} << 20;
+
+// Appends pieces of `state.range(0)` bytes to an empty `Chain` until it holds
+// `kTotalSize` bytes.
+void BM_ChainAppend(benchmark::State& state) {
+  const std::string piece(static_cast<size_t>(state.range(0)), 'x');
+  for (auto _ : state) {
+    Chain chain;
+    for (size_t size = 0; size < kTotalSize; size += piece.size()) {
+      chain.Append(piece);
+    }
+    benchmark::DoNotOptimize(chain);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kTotalSize));
+}
+BENCHMARK(BM_ChainAppend)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+// Like `BM_ChainAppend`, but prepends.
+void BM_ChainPrepend(benchmark::State& state) {
+  const std::string piece(static_cast<size_t>(state.range(0)), 'x');
+  for (auto _ : state) {
+    Chain chain;
+    for (size_t size = 0; size < kTotalSize; size += piece.size()) {
+      chain.Prepend(piece);
+    }
+    benchmark::DoNotOptimize(chain);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kTotalSize));
+}
+BENCHMARK(BM_ChainPrepend)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+// Appends `Chain`s of `state.range(0)` bytes, which shares their blocks
+// if they are large enough.
+void BM_ChainAppendChain(benchmark::State& state) {
+  const Chain piece(std::string(static_cast<size_t>(state.range(0)), 'x'));
+  for (auto _ : state) {
+    Chain chain;
+    for (size_t size = 0; size < kTotalSize; size += piece.size()) {
+      chain.Append(piece);
+    }
+    benchmark::DoNotOptimize(chain);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kTotalSize));
+}
+BENCHMARK(BM_ChainAppendChain)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+// Flattens a `Chain` made of pieces of `state.range(0)` bytes.
+void BM_ChainFlatten(benchmark::State& state) {
+  const std::string piece(static_cast<size_t>(state.range(0)), 'x');
+  Chain source;
+  for (size_t size = 0; size < kTotalSize; size += piece.size()) {
+    source.Append(Chain(piece));
+  }
+  for (auto _ : state) {
+    Chain chain = source;
+    const absl::string_view flat = chain.Flatten();
+    benchmark::DoNotOptimize(flat.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_ChainFlatten)->RangeMultiplier(8)->Range(64, 64 << 10);
+
+}  // namespace
+}  // namespace riegeli
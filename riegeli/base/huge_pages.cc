@@ -0,0 +1,68 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/base/huge_pages.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+#include <limits>
+
+#include "absl/base/attributes.h"
+#include "absl/types/optional.h"
+
+namespace riegeli {
+
+namespace internal {
+
+ABSL_CONST_INIT std::atomic<size_t> huge_pages_min_size(
+    std::numeric_limits<size_t>::max());
+
+void AdviseHugePagesSlow(void* ptr, size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+  // Rounding `begin` up does not overflow because the allocation extends by at
+  // least `kHugePageSize` from there.
+  if (size < kHugePageSize) return;
+  const uintptr_t aligned_begin =
+      (begin + (kHugePageSize - 1)) & ~uintptr_t{kHugePageSize - 1};
+  const uintptr_t aligned_end = (begin + size) & ~uintptr_t{kHugePageSize - 1};
+  if (aligned_begin >= aligned_end) return;
+  // Failure is ignored: this is only a hint.
+  madvise(reinterpret_cast<void*>(aligned_begin), aligned_end - aligned_begin,
+          MADV_HUGEPAGE);
+#endif
+}
+
+}  // namespace internal
+
+void SetHugePagesMinSize(absl::optional<size_t> min_size) {
+  internal::huge_pages_min_size.store(
+      min_size == absl::nullopt ? std::numeric_limits<size_t>::max()
+                                : *min_size,
+      std::memory_order_relaxed);
+}
+
+absl::optional<size_t> HugePagesMinSize() {
+  const size_t min_size =
+      internal::huge_pages_min_size.load(std::memory_order_relaxed);
+  if (min_size == std::numeric_limits<size_t>::max()) return absl::nullopt;
+  return min_size;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,74 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_HUGE_PAGES_H_
+#define RIEGELI_BASE_HUGE_PAGES_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// The size of a huge page assumed by `SetHugePagesMinSize()`.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kHugePageSize, size_t{2} << 20);
+
+// If not `absl::nullopt`, newly allocated `Buffer`s (backing buffers of
+// buffered readers and writers, e.g. compressor windows) and internal `Chain`
+// blocks (e.g. decoded chunk data) of at least `*min_size` bytes are advised
+// to be backed by transparent huge pages, which reduces TLB pressure when they
+// are accessed.
+//
+// Only whole huge pages aligned to `kHugePageSize` inside an allocation are
+// affected, so this is effective for allocations spanning several huge pages.
+// A reasonable value is `2 * kHugePageSize`. Internal `Chain` blocks are that
+// large only if `Chain::Options::set_max_block_size()` or
+// `ChainWriterBase::Options::set_max_block_size()` allows it.
+//
+// This is a hint: it has effect on Linux if transparent huge pages are
+// configured as `madvise` or `always`, and it is ignored elsewhere.
+//
+// Default: `absl::nullopt`.
+void SetHugePagesMinSize(absl::optional<size_t> min_size);
+
+// Returns the value set by `SetHugePagesMinSize()`.
+absl::optional<size_t> HugePagesMinSize();
+
+// Implementation details follow.
+
+namespace internal {
+
+ABSL_CONST_INIT extern std::atomic<size_t> huge_pages_min_size;
+
+void AdviseHugePagesSlow(void* ptr, size_t size);
+
+// Advises that `size` bytes at `ptr` be backed by huge pages if
+// `SetHugePagesMinSize()` applies to them.
+inline void MaybeAdviseHugePages(void* ptr, size_t size) {
+  if (ABSL_PREDICT_FALSE(
+          size >= huge_pages_min_size.load(std::memory_order_relaxed))) {
+    AdviseHugePagesSlow(ptr, size);
+  }
+}
+
+}  // namespace internal
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_HUGE_PAGES_H_
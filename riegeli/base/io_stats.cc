@@ -0,0 +1,122 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/base/io_stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t IoStats::kNumSyscalls;
+constexpr size_t IoStats::SyscallCounts::kNumBuckets;
+#endif
+
+namespace internal {
+
+ABSL_CONST_INIT std::atomic<IoStats*> global_io_stats(nullptr);
+
+}  // namespace internal
+
+absl::string_view IoStats::SyscallName(Syscall syscall) {
+  switch (syscall) {
+    case Syscall::kRead:
+      return "read";
+    case Syscall::kWrite:
+      return "write";
+    case Syscall::kSeek:
+      return "seek";
+    case Syscall::kStat:
+      return "stat";
+    case Syscall::kSync:
+      return "sync";
+    case Syscall::kTruncate:
+      return "truncate";
+    case Syscall::kCopy:
+      return "copy";
+    case Syscall::kAllocate:
+      return "allocate";
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown syscall: " << static_cast<int>(syscall);
+}
+
+void IoStats::AddShared(size_t length) {
+  Increment(shared_transfers_);
+  Increment(shared_bytes_, length);
+}
+
+void IoStats::AddCopied(size_t length) {
+  Increment(copied_transfers_);
+  Increment(copied_bytes_, length);
+}
+
+void IoStats::AddChainFlatten(size_t length) {
+  Increment(chain_flattens_);
+  Increment(chain_flattened_bytes_, length);
+}
+
+void IoStats::AddSyscall(Syscall syscall, size_t length) {
+  AtomicSyscallCounts& counts = syscalls_[static_cast<size_t>(syscall)];
+  Increment(counts.calls);
+  if (syscall == Syscall::kRead || syscall == Syscall::kWrite ||
+      syscall == Syscall::kCopy) {
+    Increment(counts.bytes, length);
+    const size_t bucket =
+        UnsignedMin(IntCast<size_t>(absl::bit_width(length)),
+                    SyscallCounts::kNumBuckets - 1);
+    Increment(counts.length_histogram[bucket]);
+  }
+}
+
+IoStats::Snapshot IoStats::snapshot() const {
+  Snapshot snapshot;
+  snapshot.reader_pull_slow = reader_pull_slow_.load(std::memory_order_relaxed);
+  snapshot.writer_push_slow = writer_push_slow_.load(std::memory_order_relaxed);
+  snapshot.shared_transfers = shared_transfers_.load(std::memory_order_relaxed);
+  snapshot.shared_bytes = shared_bytes_.load(std::memory_order_relaxed);
+  snapshot.copied_transfers = copied_transfers_.load(std::memory_order_relaxed);
+  snapshot.copied_bytes = copied_bytes_.load(std::memory_order_relaxed);
+  snapshot.chain_flattens = chain_flattens_.load(std::memory_order_relaxed);
+  snapshot.chain_flattened_bytes =
+      chain_flattened_bytes_.load(std::memory_order_relaxed);
+  for (size_t syscall = 0; syscall < kNumSyscalls; ++syscall) {
+    const AtomicSyscallCounts& src = syscalls_[syscall];
+    SyscallCounts& dest = snapshot.syscalls[syscall];
+    dest.calls = src.calls.load(std::memory_order_relaxed);
+    dest.bytes = src.bytes.load(std::memory_order_relaxed);
+    for (size_t bucket = 0; bucket < SyscallCounts::kNumBuckets; ++bucket) {
+      dest.length_histogram[bucket] =
+          src.length_histogram[bucket].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+void SetGlobalIoStats(IoStats* stats) {
+  internal::global_io_stats.store(stats, std::memory_order_release);
+}
+
+}  // namespace riegeli
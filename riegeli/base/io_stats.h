@@ -0,0 +1,198 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_IO_STATS_H_
+#define RIEGELI_BASE_IO_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+
+namespace riegeli {
+
+// Counts events on slow paths of byte `Reader`s and `Writer`s, transfers of
+// `Chain` data, and system calls made by `FdReader`, `FdWriter`,
+// `SocketReader`, and `SocketWriter`.
+//
+// This helps to find buffer sizing mistakes: many `PullSlow()` or `PushSlow()`
+// calls or small system calls suggest a too small buffer, many copied or
+// flattened bytes suggest that data which could be shared is copied.
+//
+// While an `IoStats` is installed with `SetGlobalIoStats()`, each event costs
+// relaxed atomic increments. While none is installed, each event costs only
+// checking that.
+//
+// `IoStats` is thread-safe.
+class IoStats {
+ public:
+  // A kind of system call.
+  enum class Syscall {
+    kRead,      // `read()`, `pread()`, `recvmsg()`
+    kWrite,     // `write()`, `pwrite()`, `writev()`, `pwritev()`, `send()`
+    kSeek,      // `lseek()`
+    kStat,      // `fstat()`
+    kSync,      // `fsync()`
+    kTruncate,  // `ftruncate()`
+    kCopy,      // `copy_file_range()`, `sendfile()`, `splice()`
+    kAllocate,  // `fallocate()`
+  };
+  static constexpr size_t kNumSyscalls = 8;
+
+  // Returns a name of `syscall` suitable as a metric label, e.g. "read".
+  static absl::string_view SyscallName(Syscall syscall);
+
+  // Counters of a kind of system calls.
+  struct SyscallCounts {
+    // The number of buckets of `length_histogram`.
+    static constexpr size_t kNumBuckets = 40;
+
+    // The number of calls. For `kRead`, `kWrite`, and `kCopy`, only
+    // successful calls are counted, and retries after `EINTR` are not.
+    uint64_t calls = 0;
+    // The number of bytes transferred, for `kRead`, `kWrite`, and `kCopy`.
+    uint64_t bytes = 0;
+    // For `kRead`, `kWrite`, and `kCopy`, `length_histogram[i]` is the number
+    // of calls which transferred `[2^(i - 1)..2^i)` bytes, with 0 bytes
+    // counted in bucket 0, and larger lengths counted in the last bucket.
+    std::array<uint64_t, kNumBuckets> length_histogram{};
+  };
+
+  // Values of all counters at some point in time.
+  struct Snapshot {
+    const SyscallCounts& syscall(Syscall syscall) const {
+      return syscalls[static_cast<size_t>(syscall)];
+    }
+
+    // Calls to `Reader::PullSlow()` from `Reader::Pull()`.
+    uint64_t reader_pull_slow = 0;
+    // Calls to `Writer::PushSlow()` from `Writer::Push()`.
+    uint64_t writer_push_slow = 0;
+    // Transfers of `Chain` data to a `Chain` or `absl::Cord` which share the
+    // memory, e.g. `Reader::Read(Chain&)` from a `ChainReader` or with a
+    // large enough length from a `BufferedReader`.
+    uint64_t shared_transfers = 0;
+    uint64_t shared_bytes = 0;
+    // Transfers of data to a `Chain` which copy it, e.g. `Reader::Read(Chain&)`
+    // with a small length, or from a `Reader` which does not share its data.
+    uint64_t copied_transfers = 0;
+    uint64_t copied_bytes = 0;
+    // `Chain::Flatten()` calls which had to copy the data, and its size.
+    uint64_t chain_flattens = 0;
+    uint64_t chain_flattened_bytes = 0;
+    std::array<SyscallCounts, kNumSyscalls> syscalls;
+  };
+
+  IoStats() noexcept {}
+
+  IoStats(const IoStats&) = delete;
+  IoStats& operator=(const IoStats&) = delete;
+
+  void AddPullSlow() { Increment(reader_pull_slow_); }
+  void AddPushSlow() { Increment(writer_push_slow_); }
+  void AddShared(size_t length);
+  void AddCopied(size_t length);
+  void AddChainFlatten(size_t length);
+  void AddSyscall(Syscall syscall, size_t length = 0);
+
+  // Returns current values of counters. Values added concurrently with taking
+  // the snapshot may be partially included.
+  Snapshot snapshot() const;
+
+ private:
+  struct AtomicSyscallCounts {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> bytes{0};
+    std::array<std::atomic<uint64_t>, SyscallCounts::kNumBuckets>
+        length_histogram{};
+  };
+
+  static void Increment(std::atomic<uint64_t>& counter, uint64_t delta = 1) {
+    counter.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> reader_pull_slow_{0};
+  std::atomic<uint64_t> writer_push_slow_{0};
+  std::atomic<uint64_t> shared_transfers_{0};
+  std::atomic<uint64_t> shared_bytes_{0};
+  std::atomic<uint64_t> copied_transfers_{0};
+  std::atomic<uint64_t> copied_bytes_{0};
+  std::atomic<uint64_t> chain_flattens_{0};
+  std::atomic<uint64_t> chain_flattened_bytes_{0};
+  std::array<AtomicSyscallCounts, kNumSyscalls> syscalls_;
+};
+
+// Installs `stats` as the process-wide `IoStats`, or uninstalls the current
+// one if `nullptr`.
+//
+// `*stats` must outlive its installation.
+void SetGlobalIoStats(IoStats* stats);
+
+// Returns the process-wide `IoStats`, or `nullptr` if none is installed.
+IoStats* GlobalIoStats();
+
+// Implementation details follow.
+
+namespace internal {
+
+ABSL_CONST_INIT extern std::atomic<IoStats*> global_io_stats;
+
+}  // namespace internal
+
+inline IoStats* GlobalIoStats() {
+  return internal::global_io_stats.load(std::memory_order_acquire);
+}
+
+namespace internal {
+
+inline void CountPullSlow() {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddPullSlow();
+}
+
+inline void CountPushSlow() {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddPushSlow();
+}
+
+inline void CountShared(size_t length) {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddShared(length);
+}
+
+inline void CountCopied(size_t length) {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddCopied(length);
+}
+
+inline void CountChainFlatten(size_t length) {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddChainFlatten(length);
+}
+
+inline void CountSyscall(IoStats::Syscall syscall, size_t length = 0) {
+  IoStats* const stats = GlobalIoStats();
+  if (ABSL_PREDICT_FALSE(stats != nullptr)) stats->AddSyscall(syscall, length);
+}
+
+}  // namespace internal
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_IO_STATS_H_
@@ -0,0 +1,62 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/base/memory_budget.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+namespace internal {
+
+ABSL_CONST_INIT std::atomic<MemoryBudget*> global_memory_budget(nullptr);
+
+}  // namespace internal
+
+void MemoryBudget::Allocate(size_t size) {
+  const int64_t allocated =
+      allocated_bytes_.fetch_add(IntCast<int64_t>(size),
+                                 std::memory_order_relaxed) +
+      IntCast<int64_t>(size);
+  int64_t peak = peak_bytes_.load(std::memory_order_relaxed);
+  while (allocated > peak &&
+         !peak_bytes_.compare_exchange_weak(peak, allocated,
+                                            std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryBudget::Free(size_t size) {
+  allocated_bytes_.fetch_sub(IntCast<int64_t>(size), std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::allocated_bytes() const {
+  const int64_t allocated = allocated_bytes_.load(std::memory_order_relaxed);
+  return allocated > 0 ? IntCast<size_t>(allocated) : 0;
+}
+
+size_t MemoryBudget::peak_bytes() const {
+  return IntCast<size_t>(peak_bytes_.load(std::memory_order_relaxed));
+}
+
+void SetGlobalMemoryBudget(MemoryBudget* budget) {
+  internal::global_memory_budget.store(budget, std::memory_order_release);
+}
+
+}  // namespace riegeli
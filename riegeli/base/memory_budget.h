@@ -0,0 +1,122 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_MEMORY_BUDGET_H_
+#define RIEGELI_BASE_MEMORY_BUDGET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+
+namespace riegeli {
+
+// Accounts for memory allocated by Riegeli, and optionally limits it.
+//
+// While a `MemoryBudget` is installed with `SetGlobalMemoryBudget()`, it is
+// told about allocations of `Buffer`s (backing buffers of buffered readers and
+// writers) and of internal `Chain` blocks, including blocks and buffers kept in
+// caches for reuse. Memory of external objects attached to a `Chain`, e.g. of a
+// `std::string` moved into it, and memory of compressor contexts are not
+// accounted.
+//
+// If `limit()` is set and exceeded, `RecordWriter` with `parallelism() > 0`
+// waits until the chunks already queued in background are written before
+// accepting another chunk, instead of letting the queue grow.
+//
+// The budget should be installed before Riegeli objects are created. Memory
+// allocated before installing the budget and freed afterwards makes
+// `allocated_bytes()` lower than the truth.
+//
+// `MemoryBudget` is thread-safe.
+class MemoryBudget {
+ public:
+  // Creates a `MemoryBudget` with the given limit, or without a limit if
+  // `absl::nullopt`.
+  explicit MemoryBudget(absl::optional<size_t> limit = absl::nullopt) noexcept
+      : limit_(limit) {}
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  // Records that `size` bytes were allocated.
+  void Allocate(size_t size);
+
+  // Records that `size` bytes were freed.
+  void Free(size_t size);
+
+  // Returns the number of bytes currently allocated.
+  size_t allocated_bytes() const;
+
+  // Returns the maximum of `allocated_bytes()` observed so far.
+  size_t peak_bytes() const;
+
+  // Returns the limit, or `absl::nullopt` if there is none.
+  absl::optional<size_t> limit() const { return limit_; }
+
+  // Returns `true` if `allocated_bytes()` is above `limit()`.
+  bool exceeded() const {
+    return limit_ != absl::nullopt && allocated_bytes() > *limit_;
+  }
+
+ private:
+  absl::optional<size_t> limit_;
+  // Signed because memory allocated before the budget was installed can be
+  // freed afterwards.
+  std::atomic<int64_t> allocated_bytes_{0};
+  std::atomic<int64_t> peak_bytes_{0};
+};
+
+// Installs `budget` as the process-wide `MemoryBudget`, or uninstalls the
+// current one if `nullptr`.
+//
+// `*budget` must outlive its installation.
+void SetGlobalMemoryBudget(MemoryBudget* budget);
+
+// Returns the process-wide `MemoryBudget`, or `nullptr` if none is installed.
+MemoryBudget* GlobalMemoryBudget();
+
+// Implementation details follow.
+
+namespace internal {
+
+ABSL_CONST_INIT extern std::atomic<MemoryBudget*> global_memory_budget;
+
+// Tells the global `MemoryBudget`, if any, about allocating `size` bytes.
+inline void ReportAllocated(size_t size) {
+  MemoryBudget* const budget =
+      global_memory_budget.load(std::memory_order_acquire);
+  if (ABSL_PREDICT_FALSE(budget != nullptr)) budget->Allocate(size);
+}
+
+// Tells the global `MemoryBudget`, if any, about freeing `size` bytes.
+inline void ReportFreed(size_t size) {
+  MemoryBudget* const budget =
+      global_memory_budget.load(std::memory_order_acquire);
+  if (ABSL_PREDICT_FALSE(budget != nullptr)) budget->Free(size);
+}
+
+}  // namespace internal
+
+inline MemoryBudget* GlobalMemoryBudget() {
+  return internal::global_memory_budget.load(std::memory_order_acquire);
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_MEMORY_BUDGET_H_
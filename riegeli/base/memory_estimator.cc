@@ -23,20 +23,25 @@
 namespace riegeli {
 
 MemoryEstimator::MemoryEstimator(const MemoryEstimator& that)
-    : total_memory_(that.total_memory_), objects_seen_(that.objects_seen_) {}
+    : deduplicate_(that.deduplicate_),
+      total_memory_(that.total_memory_),
+      objects_seen_(that.objects_seen_) {}
 
 MemoryEstimator& MemoryEstimator::operator=(const MemoryEstimator& that) {
+  deduplicate_ = that.deduplicate_;
   total_memory_ = that.total_memory_;
   objects_seen_ = that.objects_seen_;
   return *this;
 }
 
 MemoryEstimator::MemoryEstimator(MemoryEstimator&& that) noexcept
-    : total_memory_(std::exchange(that.total_memory_, 0)),
+    : deduplicate_(that.deduplicate_),
+      total_memory_(std::exchange(that.total_memory_, 0)),
       objects_seen_(std::exchange(that.objects_seen_,
                                   absl::flat_hash_set<const void*>())) {}
 
 MemoryEstimator& MemoryEstimator::operator=(MemoryEstimator&& that) noexcept {
+  deduplicate_ = that.deduplicate_;
   total_memory_ = std::exchange(that.total_memory_, 0);
   objects_seen_ =
       std::exchange(that.objects_seen_, absl::flat_hash_set<const void*>());
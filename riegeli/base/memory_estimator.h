@@ -69,10 +69,21 @@ namespace riegeli {
 // For objects which do not support these conventions, their owner estimates
 // their memory usage and possible sharing with whatever means have been found.
 // The estimation can thus be inexact.
+//
+// Tracking objects seen costs a hash set insertion per shared object, which
+// dominates when many objects are estimated often, e.g. for periodic reporting
+// of memory used by thousands of open readers. If the objects rarely share
+// their subobjects, or an upper bound is good enough, this can be disabled
+// with `MemoryEstimator(false)`.
 class MemoryEstimator {
  public:
   MemoryEstimator() {}
 
+  // If `deduplicate` is `false`, objects seen are not tracked and
+  // `RegisterNode()` always returns `true`, so an object shared by several
+  // owners is counted once per owner.
+  explicit MemoryEstimator(bool deduplicate) : deduplicate_(deduplicate) {}
+
   MemoryEstimator(const MemoryEstimator& that);
   MemoryEstimator& operator=(const MemoryEstimator& that);
 
@@ -94,7 +105,8 @@ class MemoryEstimator {
   // possible if the object is not public and is registered by code external
   // to it, in which case some proxy is needed.
   //
-  // Returns true if this object was not seen yet; only in this case the caller
+  // Returns true if this object was not seen yet (or if `MemoryEstimator` was
+  // constructed with `deduplicate == false`); only in this case the caller
   // should register its memory and subobjects.
   bool RegisterNode(const void* ptr);
 
@@ -102,6 +114,7 @@ class MemoryEstimator {
   size_t TotalMemory() const { return total_memory_; }
 
  private:
+  bool deduplicate_ = true;
   size_t total_memory_ = 0;
   absl::flat_hash_set<const void*> objects_seen_;
 };
@@ -117,6 +130,7 @@ inline void MemoryEstimator::RegisterDynamicMemory(size_t memory) {
 }
 
 inline bool MemoryEstimator::RegisterNode(const void* ptr) {
+  if (!deduplicate_) return true;
   return objects_seen_.insert(ptr).second;
 }
 
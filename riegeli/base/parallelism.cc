@@ -14,60 +14,334 @@
 
 #include "riegeli/base/parallelism.h"
 
+#ifdef __linux__
+#include <sched.h>
+#endif
 #include <stddef.h>
+#include <stdio.h>
 
+#include <atomic>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
 #include "absl/base/thread_annotations.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/memory.h"
 
 namespace riegeli {
+
+Executor::~Executor() {}
+
 namespace internal {
 
+namespace {
+
+// The `ThreadPool` whose worker thread is the current thread, and the index of
+// its home queue.
+ABSL_CONST_INIT thread_local ThreadPool* current_thread_pool = nullptr;
+ABSL_CONST_INIT thread_local size_t current_home_queue = 0;
+
+size_t DefaultMaxThreads() {
+  return UnsignedMax(size_t{std::thread::hardware_concurrency()}, size_t{1});
+}
+
+// NUMA nodes which have CPUs usable by this process. Empty unless there are at
+// least two such nodes.
+struct NumaTopology {
+#ifdef __linux__
+  // `cpu_nodes[cpu]` is the index of the node of `cpu` in `node_cpus`, or 0 if
+  // `cpu` is not usable.
+  std::vector<size_t> cpu_nodes;
+  // Usable CPUs of each node.
+  std::vector<cpu_set_t> node_cpus;
+#endif
+};
+
+#ifdef __linux__
+
+bool ReadSysFile(const std::string& path, std::string& contents) {
+  FILE* const file = fopen(path.c_str(), "r");
+  if (file == nullptr) return false;
+  contents.clear();
+  char buffer[256];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents.append(buffer, length);
+  }
+  fclose(file);
+  return true;
+}
+
+// Parses a list like "0-3,8,10-11", as used in sysfs for sets of CPUs and
+// nodes.
+bool ParseSysList(absl::string_view list, std::vector<size_t>& values) {
+  values.clear();
+  list = absl::StripAsciiWhitespace(list);
+  if (list.empty()) return true;
+  for (const absl::string_view range : absl::StrSplit(list, ',')) {
+    const std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    size_t first, last;
+    if (ABSL_PREDICT_FALSE(!absl::SimpleAtoi(bounds.first, &first))) {
+      return false;
+    }
+    if (bounds.second.empty()) {
+      last = first;
+    } else if (ABSL_PREDICT_FALSE(!absl::SimpleAtoi(bounds.second, &last) ||
+                                  last < first)) {
+      return false;
+    }
+    for (size_t value = first; value <= last; ++value) values.push_back(value);
+  }
+  return true;
+}
+
+#endif
+
+NumaTopology DetectNumaTopology() {
+  NumaTopology topology;
+#ifdef __linux__
+  cpu_set_t usable_cpus;
+  CPU_ZERO(&usable_cpus);
+  if (sched_getaffinity(0, sizeof(usable_cpus), &usable_cpus) != 0) {
+    return topology;
+  }
+  std::string contents;
+  std::vector<size_t> nodes;
+  if (!ReadSysFile("/sys/devices/system/node/online", contents) ||
+      !ParseSysList(contents, nodes)) {
+    return topology;
+  }
+  std::vector<size_t> cpus;
+  for (const size_t node : nodes) {
+    if (!ReadSysFile(absl::StrCat("/sys/devices/system/node/node", node,
+                                  "/cpulist"),
+                     contents) ||
+        !ParseSysList(contents, cpus)) {
+      return NumaTopology();
+    }
+    cpu_set_t node_cpus;
+    CPU_ZERO(&node_cpus);
+    bool has_usable_cpus = false;
+    for (const size_t cpu : cpus) {
+      if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &usable_cpus)) continue;
+      CPU_SET(cpu, &node_cpus);
+      has_usable_cpus = true;
+      if (cpu >= topology.cpu_nodes.size()) {
+        topology.cpu_nodes.resize(cpu + 1, 0);
+      }
+      topology.cpu_nodes[cpu] = topology.node_cpus.size();
+    }
+    if (has_usable_cpus) topology.node_cpus.push_back(node_cpus);
+  }
+  if (topology.node_cpus.size() < 2) return NumaTopology();
+#endif
+  return topology;
+}
+
+const NumaTopology& GetNumaTopology() {
+  static const NoDestructor<NumaTopology> kNumaTopology(DetectNumaTopology());
+  return *kNumaTopology;
+}
+
+size_t NumNumaNodes() {
+#ifdef __linux__
+  return UnsignedMax(GetNumaTopology().node_cpus.size(), size_t{1});
+#else
+  return 1;
+#endif
+}
+
+// Returns the index of the NUMA node of the CPU running the current thread.
+size_t CurrentNumaNode() {
+#ifdef __linux__
+  const NumaTopology& topology = GetNumaTopology();
+  const int cpu = sched_getcpu();
+  if (ABSL_PREDICT_FALSE(cpu < 0) ||
+      IntCast<size_t>(cpu) >= topology.cpu_nodes.size()) {
+    return 0;
+  }
+  return topology.cpu_nodes[IntCast<size_t>(cpu)];
+#else
+  return 0;
+#endif
+}
+
+// Makes the current thread run on CPUs of the NUMA node with index `node`.
+void BindToNumaNode(size_t node) {
+#ifdef __linux__
+  // Failure is ignored: this affects only performance.
+  sched_setaffinity(0, sizeof(cpu_set_t), &GetNumaTopology().node_cpus[node]);
+#endif
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t max_threads)
+    : max_threads_(max_threads == 0 ? DefaultMaxThreads() : max_threads),
+      num_nodes_(NumNumaNodes()) {
+  const size_t num_queues = UnsignedMax(DefaultMaxThreads(), num_nodes_);
+  queues_.reserve(num_queues);
+  for (size_t i = 0; i < num_queues; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+}
+
 ThreadPool::~ThreadPool() {
   absl::MutexLock lock(&mutex_);
   exiting_ = true;
+  wake_up_.SignalAll();
   mutex_.Await(absl::Condition(
-      +[](size_t* num_threads) { return *num_threads == 0; }, &num_threads_));
+      +[](size_t* num_running_threads) { return *num_running_threads == 0; },
+      &num_running_threads_));
+}
+
+void ThreadPool::SetMaxThreads(size_t max_threads) {
+  max_threads_.store(max_threads == 0 ? DefaultMaxThreads() : max_threads,
+                     std::memory_order_relaxed);
 }
 
 void ThreadPool::Schedule(std::function<void()> task) {
+  // A task scheduled from a worker thread likely uses data recently used by
+  // that thread, so prefer running it there.
+  const size_t queue_index =
+      current_thread_pool == this ? current_home_queue : ChooseQueue();
+  Queue& queue = *queues_[queue_index];
   {
+    absl::MutexLock lock(&queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  // Incrementing `num_pending_` before reading `num_idle_threads_`, together
+  // with a worker thread updating them in the opposite order, ensures that
+  // either the task is noticed by an idle thread, or another thread is
+  // started.
+  const size_t num_pending = num_pending_.fetch_add(1) + 1;
+  const size_t num_idle_threads = num_idle_threads_.load();
+  if (num_idle_threads > 0) {
     absl::MutexLock lock(&mutex_);
     RIEGELI_ASSERT(!exiting_)
-        << "Failed precondition of ThreadPool::Schedule(): no new threads may "
+        << "Failed precondition of ThreadPool::Schedule(): no new tasks may "
            "be scheduled while the thread pool is exiting";
-    tasks_.push_back(std::move(task));
-    if (num_idle_threads_ >= tasks_.size()) return;
-    ++num_threads_;
+    wake_up_.Signal();
+  }
+  if (num_pending > num_idle_threads && TryAddThread()) {
+    StartThread(queue_index);
   }
-  std::thread([this] {
+}
+
+void ThreadPool::ScheduleBlocking(std::function<void()> task) {
+  {
+    absl::MutexLock lock(&mutex_);
+    RIEGELI_ASSERT(!exiting_)
+        << "Failed precondition of ThreadPool::ScheduleBlocking(): "
+           "no new tasks may be scheduled while the thread pool is exiting";
+    ++num_running_threads_;
+  }
+  std::thread([this, task = std::move(task)] {
+    task();
+    absl::MutexLock lock(&mutex_);
+    --num_running_threads_;
+  }).detach();
+}
+
+inline size_t ThreadPool::ChooseQueue() {
+  // Queues of a node have indices congruent to the node modulo `num_nodes_`.
+  const size_t node = num_nodes_ == 1 ? 0 : CurrentNumaNode();
+  const size_t num_node_queues =
+      (queues_.size() - node + num_nodes_ - 1) / num_nodes_;
+  return node +
+         num_nodes_ * (next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                       num_node_queues);
+}
+
+inline bool ThreadPool::TryAddThread() {
+  size_t num_threads = num_threads_.load();
+  do {
+    if (num_threads >= max_threads_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+  } while (!num_threads_.compare_exchange_weak(num_threads, num_threads + 1));
+  return true;
+}
+
+inline bool ThreadPool::TakeTask(size_t home_queue,
+                                 std::function<void()>& task) {
+  if (num_pending_.load() == 0) return false;
+  // With several nodes, the first pass visits queues of the home node, and the
+  // second pass visits the remaining queues.
+  const size_t home_node = QueueNode(home_queue);
+  const size_t num_passes = num_nodes_ == 1 ? 1 : 2;
+  for (size_t pass = 0; pass < num_passes; ++pass) {
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      const size_t index = (home_queue + i) % queues_.size();
+      if (num_passes > 1 && (QueueNode(index) == home_node) != (pass == 0)) {
+        continue;
+      }
+      Queue& queue = *queues_[index];
+      absl::MutexLock lock(&queue.mutex);
+      if (!queue.tasks.empty()) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        num_pending_.fetch_sub(1);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::StartThread(size_t home_queue) {
+  {
+    absl::MutexLock lock(&mutex_);
+    ++num_running_threads_;
+  }
+  std::thread([this, home_queue] {
+    if (num_nodes_ > 1) BindToNumaNode(QueueNode(home_queue));
+    current_thread_pool = this;
+    current_home_queue = home_queue;
+    std::function<void()> task;
     for (;;) {
-      absl::ReleasableMutexLock lock(&mutex_);
-      ++num_idle_threads_;
-      mutex_.AwaitWithTimeout(
-          absl::Condition(
-              +[](ThreadPool* self) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-                return !self->tasks_.empty() || self->exiting_;
-              },
-              this),
-          absl::Seconds(1));
-      --num_idle_threads_;
-      if (tasks_.empty() || exiting_) {
-        --num_threads_;
-        return;
+      if (TakeTask(home_queue, task)) {
+        task();
+        task = nullptr;
+        continue;
+      }
+      absl::MutexLock lock(&mutex_);
+      num_idle_threads_.fetch_add(1);
+      const absl::Time deadline = absl::Now() + absl::Seconds(1);
+      while (num_pending_.load() == 0 && !exiting_) {
+        if (wake_up_.WaitWithDeadline(&mutex_, deadline)) break;
+      }
+      num_idle_threads_.fetch_sub(1);
+      if (exiting_) break;
+      if (num_pending_.load() > 0) continue;
+      // Idle for too long. Stop counting this thread before checking for tasks
+      // again, so that either `Schedule()` starts another thread, or the task
+      // is noticed here. If counting this thread again fails, another thread
+      // was started meanwhile.
+      num_threads_.fetch_sub(1);
+      if (ABSL_PREDICT_TRUE(num_pending_.load() == 0) || !TryAddThread()) {
+        break;
       }
-      const std::function<void()> task = std::move(tasks_.front());
-      tasks_.pop_front();
-      lock.Release();
-      task();
     }
+    current_thread_pool = nullptr;
+    absl::MutexLock lock(&mutex_);
+    --num_running_threads_;
   }).detach();
 }
 
@@ -76,5 +350,79 @@ ThreadPool& ThreadPool::global() {
   return *kStaticThreadPool;
 }
 
+BlockingExecutor& BlockingExecutor::global() {
+  static NoDestructor<BlockingExecutor> kStaticBlockingExecutor;
+  return *kStaticBlockingExecutor;
+}
+
+void BlockingExecutor::Schedule(std::function<void()> task) {
+  ThreadPool::global().ScheduleBlocking(std::move(task));
+}
+
+namespace {
+
+// State of `ParallelFor()` shared with tasks it schedules, which can start
+// running after `ParallelFor()` returned.
+class ParallelForState {
+ public:
+  explicit ParallelForState(size_t size, std::function<void(size_t)> function)
+      : size_(size), function_(std::move(function)) {}
+
+  // Claims and performs calls until all calls are claimed.
+  void Run();
+
+  // Waits until all calls returned.
+  void Wait();
+
+ private:
+  const size_t size_;
+  const std::function<void(size_t)> function_;
+  std::atomic<size_t> next_index_{0};
+  absl::Mutex mutex_;
+  size_t num_done_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+void ParallelForState::Run() {
+  for (;;) {
+    const size_t index = next_index_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= size_) return;
+    function_(index);
+    absl::MutexLock lock(&mutex_);
+    ++num_done_;
+  }
+}
+
+void ParallelForState::Wait() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](ParallelForState* self) ABSL_EXCLUSIVE_LOCKS_REQUIRED(self->mutex_) {
+        return self->num_done_ == self->size_;
+      },
+      this));
+}
+
+}  // namespace
+
+void ParallelFor(Executor& executor, size_t size,
+                 std::function<void(size_t)> function) {
+  ParallelFor(executor, size, DefaultMaxThreads(), std::move(function));
+}
+
+void ParallelFor(Executor& executor, size_t size, size_t max_concurrency,
+                 std::function<void(size_t)> function) {
+  if (size <= 1 || max_concurrency <= 1) {
+    for (size_t index = 0; index < size; ++index) function(index);
+    return;
+  }
+  const std::shared_ptr<ParallelForState> state =
+      std::make_shared<ParallelForState>(size, std::move(function));
+  const size_t num_tasks = UnsignedMin(size, max_concurrency) - 1;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    executor.Schedule([state] { state->Run(); });
+  }
+  state->Run();
+  state->Wait();
+}
+
 }  // namespace internal
 }  // namespace riegeli
@@ -17,38 +17,156 @@
 
 #include <stddef.h>
 
+#include <atomic>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 
 namespace riegeli {
-namespace internal {
 
-// A thread pool with lazily created worker threads, without a thread count
-// limit. Worker threads exit after being idle for one minute.
-class ThreadPool {
+// An interface for running tasks in background.
+//
+// Tasks scheduled on an `Executor` must not block waiting for other tasks
+// scheduled on the same `Executor`, because the `Executor` may run a bounded
+// number of tasks at a time.
+class Executor {
  public:
-  ThreadPool() {}
+  Executor() noexcept {}
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  virtual ~Executor();
+
+  // Schedules `task` to be run. Tasks can run concurrently and in any order.
+  virtual void Schedule(std::function<void()> task) = 0;
+};
+
+namespace internal {
 
-  ThreadPool(const ThreadPool&) = delete;
-  ThreadPool& operator=(const ThreadPool&) = delete;
+// A thread pool with lazily created worker threads, with a bounded number of
+// threads. Worker threads exit after being idle for one second.
+//
+// Tasks are kept in several queues, each guarded by its own mutex, to reduce
+// contention between threads scheduling and running tasks. A worker thread
+// takes tasks from its own queue first, and steals tasks from other queues if
+// its own queue is empty.
+//
+// On Linux hosts with several NUMA nodes, each queue belongs to a node, and
+// its worker threads run on CPUs of that node. A task is queued on the node of
+// the scheduling thread, and worker threads steal tasks from their own node
+// before other nodes. Data prepared by the scheduling thread is then mostly
+// processed, and memory allocated by tasks is mostly placed, on the same node.
+class ThreadPool : public Executor {
+ public:
+  // Creates a `ThreadPool` running at most `max_threads` tasks at a time.
+  //
+  // `max_threads == 0` means `std::thread::hardware_concurrency()`.
+  explicit ThreadPool(size_t max_threads = 0);
 
   ~ThreadPool();
 
+  // Returns the thread pool shared by all parallel operations of Riegeli.
   static ThreadPool& global();
 
-  void Schedule(std::function<void()> task);
+  // Changes the maximum number of tasks running at a time. Currently running
+  // threads are not interrupted if there are more of them.
+  //
+  // `max_threads == 0` means `std::thread::hardware_concurrency()`.
+  void SetMaxThreads(size_t max_threads);
+
+  // Returns the maximum number of tasks running at a time.
+  size_t max_threads() const {
+    return max_threads_.load(std::memory_order_relaxed);
+  }
+
+  void Schedule(std::function<void()> task) override;
+
+  // Runs `task` in its own thread, not counted against `max_threads()`.
+  //
+  // This is meant for long-lived tasks which block waiting for other tasks,
+  // e.g. for the results of tasks run by `Schedule()`.
+  void ScheduleBlocking(std::function<void()> task);
 
  private:
+  struct Queue {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+  };
+
+  // Returns the NUMA node of queue `index`.
+  size_t QueueNode(size_t index) const { return index % num_nodes_; }
+  // Chooses a queue for a task scheduled from outside of this pool.
+  size_t ChooseQueue();
+  // Increments `num_threads_` unless this would exceed `max_threads()`.
+  bool TryAddThread();
+  // Starts a worker thread with the home queue `home_queue`, already counted
+  // in `num_threads_`.
+  void StartThread(size_t home_queue);
+  // Takes a task from the queue with index `home_queue`, or from another
+  // queue if that queue is empty, preferring queues of the same NUMA node.
+  bool TakeTask(size_t home_queue, std::function<void()>& task);
+
+  std::atomic<size_t> max_threads_;
+  // The number of NUMA nodes queues are distributed over, 1 if NUMA is not
+  // taken into account.
+  size_t num_nodes_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::atomic<size_t> next_queue_{0};
+  // The number of tasks in `queues_`, incremented after adding a task and
+  // decremented after taking a task.
+  std::atomic<size_t> num_pending_{0};
+  std::atomic<size_t> num_threads_{0};
+  std::atomic<size_t> num_idle_threads_{0};
+
   absl::Mutex mutex_;
+  // Signalled when a task is added or when exiting.
+  absl::CondVar wake_up_;
   bool exiting_ ABSL_GUARDED_BY(mutex_) = false;
-  size_t num_threads_ ABSL_GUARDED_BY(mutex_) = 0;
-  size_t num_idle_threads_ ABSL_GUARDED_BY(mutex_) = 0;
-  std::deque<std::function<void()>> tasks_ ABSL_GUARDED_BY(mutex_);
+  // The number of threads started by `StartThread()` or `ScheduleBlocking()`
+  // which did not exit yet.
+  size_t num_running_threads_ ABSL_GUARDED_BY(mutex_) = 0;
 };
 
+// An `Executor` running each task in its own thread, using
+// `ThreadPool::global().ScheduleBlocking()`.
+//
+// This is meant for tasks which block on I/O, so that they do not take threads
+// of the pool used for computation.
+class BlockingExecutor : public Executor {
+ public:
+  // Returns the `BlockingExecutor` shared by all parallel operations of
+  // Riegeli.
+  static BlockingExecutor& global();
+
+  void Schedule(std::function<void()> task) override;
+};
+
+// Calls `function(index)` for each `index` in [0..`size`), possibly
+// concurrently using tasks scheduled on `executor`. Returns when all calls
+// returned.
+//
+// The current thread takes part in the work, and waits only for calls which
+// already started running in other threads. Hence `ParallelFor()` can be
+// called from a task running on `executor` without a risk of deadlock, even if
+// `executor` runs a bounded number of tasks at a time.
+void ParallelFor(Executor& executor, size_t size,
+                 std::function<void(size_t)> function);
+
+// Like above, but at most `max_concurrency` calls run at a time, including the
+// calls made by the current thread, instead of the number of hardware threads.
+//
+// This is meant for an `executor` whose tasks block on I/O, like
+// `BlockingExecutor`, whose concurrency is not bounded by CPUs.
+//
+// `max_concurrency == 0` is treated like 1.
+void ParallelFor(Executor& executor, size_t size, size_t max_concurrency,
+                 std::function<void(size_t)> function);
+
 }  // namespace internal
 }  // namespace riegeli
 
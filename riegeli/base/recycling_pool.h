@@ -21,6 +21,7 @@
 #include <deque>
 #include <list>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -28,11 +29,39 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/memory.h"
 
 namespace riegeli {
 
+// The default maximum number of idle objects kept by a `RecyclingPool` or
+// `KeyedRecyclingPool`.
+constexpr size_t kDefaultRecyclingPoolMaxSize = 16;
+
+namespace internal {
+
+// Returns the number of shards of a `RecyclingPool`.
+inline size_t RecyclingPoolNumShards() {
+  static const size_t kNumShards =
+      UnsignedMax(UnsignedMin(size_t{std::thread::hardware_concurrency()},
+                              size_t{64}),
+                  size_t{1});
+  return kNumShards;
+}
+
+// Returns a number identifying the current thread, assigned sequentially on
+// first use, which selects its home shard of a `RecyclingPool`.
+inline size_t RecyclingPoolThreadIndex() {
+  static std::atomic<size_t> next_index(0);
+  thread_local const size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+}  // namespace internal
+
 // `RecyclingPool<T, Deleter>` keeps a pool of idle objects of type `T`, so that
 // instead of creating a new object of type `T`, an existing object can be
 // recycled. This is helpful if constructing a new object is more expensive than
@@ -41,6 +70,12 @@ namespace riegeli {
 // Deleter specifies how an object should be eventually deleted, like in
 // `std::unique_ptr<T, Deleter>`.
 //
+// Idle objects are kept in shards, one of which is the home shard of a given
+// thread, so that threads using the pool concurrently rarely contend. An
+// object is returned to the home shard of the thread which returns it.
+// `Get()` prefers the home shard and falls back to taking an object from
+// another shard which is not locked at the moment.
+//
 // `RecyclingPool` is thread-safe.
 template <typename T, typename Deleter = std::default_delete<T>>
 class RecyclingPool {
@@ -60,11 +95,17 @@ class RecyclingPool {
   };
 
   // The default value of the constructor argument.
-  static constexpr size_t kDefaultMaxSize = 16;
+  static constexpr size_t kDefaultMaxSize = kDefaultRecyclingPoolMaxSize;
 
   // Creates a pool with the given maximum number of objects to keep.
-  explicit RecyclingPool(size_t max_size = kDefaultMaxSize)
-      : max_size_(max_size) {}
+  //
+  // The maximum applies to all shards together. When it would be exceeded,
+  // the oldest objects of the shard an object is returned to are evicted.
+  //
+  // If `max_age` is finite, objects which stayed idle longer than `max_age` are
+  // evicted when another object is returned to their shard.
+  explicit RecyclingPool(size_t max_size = kDefaultMaxSize,
+                         absl::Duration max_age = absl::InfiniteDuration());
 
   RecyclingPool(const RecyclingPool&) = delete;
   RecyclingPool& operator=(const RecyclingPool&) = delete;
@@ -87,14 +128,35 @@ class RecyclingPool {
   Handle Get(Factory factory, Refurbisher refurbisher = DefaultRefurbisher());
 
  private:
+  struct Entry {
+    explicit Entry(std::unique_ptr<T, Deleter> object, absl::Time idle_since)
+        : object(std::move(object)), idle_since(idle_since) {}
+
+    std::unique_ptr<T, Deleter> object;
+    // The time when the object was returned, or `absl::InfinitePast()` if
+    // `max_age_` is infinite.
+    absl::Time idle_since;
+  };
+
+  struct Shard {
+    absl::Mutex mutex;
+    // Objects of this shard, ordered by freshness (older to newer).
+    std::deque<Entry> by_freshness ABSL_GUARDED_BY(mutex);
+    // `by_freshness.size()`, readable without locking `mutex` for skipping
+    // empty shards.
+    std::atomic<size_t> num_objects{0};
+  };
+
   void set_max_size(size_t max_size);
 
   void Put(std::unique_ptr<T, Deleter> object);
 
   std::atomic<size_t> max_size_;
-  absl::Mutex mutex_;
-  // All objects, ordered by freshness (older to newer).
-  std::deque<std::unique_ptr<T, Deleter>> by_freshness_ ABSL_GUARDED_BY(mutex_);
+  absl::Duration max_age_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // The number of objects in all shards, incremented after adding an object
+  // and decremented after removing an object.
+  std::atomic<size_t> num_objects_{0};
 };
 
 // `KeyedRecyclingPool<T, Key, Deleter>` keeps a pool of idle objects of type
@@ -129,7 +191,7 @@ class KeyedRecyclingPool {
   };
 
   // The default value of the constructor argument.
-  static constexpr size_t kDefaultMaxSize = 16;
+  static constexpr size_t kDefaultMaxSize = kDefaultRecyclingPoolMaxSize;
 
   // Creates a pool with the given maximum number of objects to keep.
   explicit KeyedRecyclingPool(size_t max_size = kDefaultMaxSize)
@@ -233,6 +295,17 @@ RecyclingPool<T, Deleter>& RecyclingPool<T, Deleter>::global(size_t max_size) {
   return *kStaticRecyclingPool;
 }
 
+template <typename T, typename Deleter>
+RecyclingPool<T, Deleter>::RecyclingPool(size_t max_size,
+                                         absl::Duration max_age)
+    : max_size_(max_size), max_age_(max_age) {
+  const size_t num_shards = internal::RecyclingPoolNumShards();
+  shards_.reserve(num_shards);
+  for (size_t i = 0; i < num_shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>());
+  }
+}
+
 template <typename T, typename Deleter>
 inline void RecyclingPool<T, Deleter>::set_max_size(size_t max_size) {
   max_size_.store(max_size, std::memory_order_relaxed);
@@ -243,13 +316,27 @@ template <typename Factory, typename Refurbisher>
 typename RecyclingPool<T, Deleter>::Handle RecyclingPool<T, Deleter>::Get(
     Factory factory, Refurbisher refurbisher) {
   std::unique_ptr<T, Deleter> returned;
-  {
-    absl::MutexLock lock(&mutex_);
-    if (ABSL_PREDICT_TRUE(!by_freshness_.empty())) {
+  const size_t home_shard =
+      internal::RecyclingPoolThreadIndex() % shards_.size();
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    Shard& shard = *shards_[(home_shard + i) % shards_.size()];
+    if (shard.num_objects.load(std::memory_order_relaxed) == 0) continue;
+    if (i == 0) {
+      shard.mutex.Lock();
+    } else if (!shard.mutex.TryLock()) {
+      // Do not wait for another shard.
+      continue;
+    }
+    if (ABSL_PREDICT_TRUE(!shard.by_freshness.empty())) {
       // Return the newest entry.
-      returned = std::move(by_freshness_.back());
-      by_freshness_.pop_back();
+      returned = std::move(shard.by_freshness.back().object);
+      shard.by_freshness.pop_back();
+      shard.num_objects.store(shard.by_freshness.size(),
+                              std::memory_order_relaxed);
+      num_objects_.fetch_sub(1, std::memory_order_relaxed);
     }
+    shard.mutex.Unlock();
+    if (returned != nullptr) break;
   }
   if (ABSL_PREDICT_TRUE(returned != nullptr)) {
     refurbisher(returned.get());
@@ -262,17 +349,28 @@ typename RecyclingPool<T, Deleter>::Handle RecyclingPool<T, Deleter>::Get(
 
 template <typename T, typename Deleter>
 void RecyclingPool<T, Deleter>::Put(std::unique_ptr<T, Deleter> object) {
+  const size_t max_size = max_size_.load(std::memory_order_relaxed);
+  const absl::Time now =
+      max_age_ == absl::InfiniteDuration() ? absl::InfinitePast() : absl::Now();
   std::vector<std::unique_ptr<T, Deleter>> evicted;
-  absl::MutexLock lock(&mutex_);
+  Shard& shard =
+      *shards_[internal::RecyclingPoolThreadIndex() % shards_.size()];
+  absl::MutexLock lock(&shard.mutex);
   // Add a newest entry.
-  by_freshness_.push_back(std::move(object));
-  while (ABSL_PREDICT_FALSE(by_freshness_.size() >
-                            max_size_.load(std::memory_order_relaxed))) {
-    // Evict the oldest entry.
-    evicted.push_back(std::move(by_freshness_.front()));
-    by_freshness_.pop_front();
+  shard.by_freshness.emplace_back(std::move(object), now);
+  size_t num_objects = num_objects_.fetch_add(1, std::memory_order_relaxed) + 1;
+  while (ABSL_PREDICT_FALSE(num_objects > max_size) ||
+         shard.by_freshness.front().idle_since < now - max_age_) {
+    // Evict the oldest entry. If this shard becomes empty, then at least the
+    // entry just added was evicted, so the total does not grow.
+    evicted.push_back(std::move(shard.by_freshness.front().object));
+    shard.by_freshness.pop_front();
+    num_objects = num_objects_.fetch_sub(1, std::memory_order_relaxed) - 1;
+    if (shard.by_freshness.empty()) break;
   }
-  // Destroy `evicted` after releasing `mutex_`.
+  shard.num_objects.store(shard.by_freshness.size(),
+                          std::memory_order_relaxed);
+  // Destroy `evicted` after releasing `shard.mutex`.
 }
 
 template <typename T, typename Key, typename Deleter>
@@ -0,0 +1,157 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_SHARED_CACHE_H_
+#define RIEGELI_BASE_SHARED_CACHE_H_
+
+#include <memory>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/memory.h"
+
+namespace riegeli {
+
+// `SharedCache<Key, T>` keeps immutable objects of type `T` which are expensive
+// to create, so that users which need an object with the same key share it
+// instead of creating it again.
+//
+// An object stays in the cache as long as a `std::shared_ptr` returned by
+// `Get()` refers to it. It is removed when the last reference is released, so
+// the cache holds only objects which are in use.
+//
+// `T` must provide a `Key key() const` member function, which returns the key
+// of the object. The key may refer to data owned by the object, e.g. be an
+// `absl::string_view`; it is not used after the object is destroyed. The `Key`
+// type must be equality comparable, hashable (by `absl::Hash`), and copyable.
+//
+// `SharedCache` is thread-safe.
+template <typename Key, typename T>
+class SharedCache {
+ public:
+  SharedCache() noexcept {}
+
+  SharedCache(const SharedCache&) = delete;
+  SharedCache& operator=(const SharedCache&) = delete;
+
+  // Returns a default global cache specific to template parameters of
+  // `SharedCache`.
+  static SharedCache& global();
+
+  // Returns an object with the given key, creating it if it is not present.
+  //
+  // `factory` takes no arguments and returns `std::unique_ptr<T>`, whose
+  // `key()` must be equal to `key`. It is called without holding a lock, so
+  // concurrent callers with the same key might create the object more than
+  // once; only one of them is kept. If `factory` returns `nullptr`, `Get()`
+  // returns `nullptr` and nothing is cached.
+  template <typename Factory>
+  std::shared_ptr<const T> Get(const Key& key, Factory factory);
+
+ private:
+  class Deleter;
+
+  struct Entry {
+    explicit Entry(const std::shared_ptr<const T>& shared)
+        : object(shared.get()), weak(shared) {}
+
+    // The identity of the object, used to recognize whether this entry still
+    // refers to an object which is being deleted.
+    const T* object;
+    std::weak_ptr<const T> weak;
+  };
+
+  void Remove(const T* object);
+
+  absl::Mutex mutex_;
+  // Keys refer to data owned by the objects. An entry is erased before its
+  // object is destroyed.
+  absl::flat_hash_map<Key, Entry> by_key_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Implementation details follow.
+
+template <typename Key, typename T>
+class SharedCache<Key, T>::Deleter {
+ public:
+  explicit Deleter(SharedCache* cache) : cache_(cache) {}
+
+  void operator()(const T* ptr) const {
+    cache_->Remove(ptr);
+    delete ptr;
+  }
+
+ private:
+  SharedCache* cache_;
+};
+
+template <typename Key, typename T>
+SharedCache<Key, T>& SharedCache<Key, T>::global() {
+  static NoDestructor<SharedCache> kStaticSharedCache;
+  return *kStaticSharedCache;
+}
+
+template <typename Key, typename T>
+template <typename Factory>
+std::shared_ptr<const T> SharedCache<Key, T>::Get(const Key& key,
+                                                  Factory factory) {
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto iter = by_key_.find(key);
+    if (iter != by_key_.end()) {
+      std::shared_ptr<const T> found = iter->second.weak.lock();
+      if (ABSL_PREDICT_TRUE(found != nullptr)) return found;
+    }
+  }
+  std::unique_ptr<T> created = factory();
+  if (ABSL_PREDICT_FALSE(created == nullptr)) return nullptr;
+  std::shared_ptr<const T> shared(created.release(), Deleter(this));
+  std::shared_ptr<const T> found;
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto iter = by_key_.find(shared->key());
+    if (iter != by_key_.end()) {
+      found = iter->second.weak.lock();
+      if (found == nullptr) {
+        // The previous object is being deleted. Erase its entry instead of
+        // assigning to it, because the key refers to data of that object.
+        by_key_.erase(iter);
+      }
+    }
+    if (found == nullptr) {
+      by_key_.emplace(shared->key(), Entry(shared));
+      return shared;
+    }
+  }
+  // Another caller created the object concurrently. Destroy `shared` after
+  // releasing `mutex_`.
+  return found;
+}
+
+template <typename Key, typename T>
+void SharedCache<Key, T>::Remove(const T* object) {
+  absl::MutexLock lock(&mutex_);
+  const auto iter = by_key_.find(object->key());
+  if (iter != by_key_.end() && iter->second.object == object) {
+    by_key_.erase(iter);
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_SHARED_CACHE_H_
@@ -15,6 +15,16 @@
 #include "riegeli/brotli/brotli_allocator.h"
 
 #include <stddef.h>
+#include <stdlib.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/intrusive_ref_count.h"
 
 namespace riegeli {
 
@@ -30,6 +40,98 @@ void RiegeliBrotliFreeFunc(void* opaque, void* ptr) {
 
 }  // namespace internal
 
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t BrotliAllocator::kDefaultMaxIdleSize;
+constexpr size_t BrotliAllocator::kMinRecycledBlockSize;
+#endif
+
 BrotliAllocator::Interface::~Interface() {}
 
+// Each block is preceded by a header which stores the size requested by
+// Brotli, so that `Free()` knows which blocks it can be reused for. The header
+// is as large as the alignment guaranteed by `malloc()`, to keep the block
+// aligned.
+class BrotliAllocator::RecyclingImplementation : public Interface {
+ public:
+  explicit RecyclingImplementation(size_t max_idle_size)
+      : max_idle_size_(max_idle_size) {}
+
+  RecyclingImplementation(const RecyclingImplementation&) = delete;
+  RecyclingImplementation& operator=(const RecyclingImplementation&) = delete;
+
+  ~RecyclingImplementation();
+
+  void* Alloc(size_t size) const override;
+  void Free(void* ptr) const override;
+
+ private:
+  static constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+  static void* BlockFromHeader(void* header) {
+    return static_cast<char*>(header) + kHeaderSize;
+  }
+  static void* HeaderFromBlock(void* block) {
+    return static_cast<char*>(block) - kHeaderSize;
+  }
+
+  size_t max_idle_size_;
+  mutable absl::Mutex mutex_;
+  // Headers of idle blocks, keyed by block size.
+  mutable absl::flat_hash_map<size_t, std::vector<void*>> idle_blocks_
+      ABSL_GUARDED_BY(mutex_);
+  // Total size of idle blocks, excluding headers.
+  mutable size_t idle_size_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+#if __cplusplus < 201703
+constexpr size_t BrotliAllocator::RecyclingImplementation::kHeaderSize;
+#endif
+
+BrotliAllocator::RecyclingImplementation::~RecyclingImplementation() {
+  for (const auto& entry : idle_blocks_) {
+    for (void* const header : entry.second) free(header);
+  }
+}
+
+void* BrotliAllocator::RecyclingImplementation::Alloc(size_t size) const {
+  if (size >= kMinRecycledBlockSize) {
+    absl::MutexLock lock(&mutex_);
+    const auto iter = idle_blocks_.find(size);
+    if (iter != idle_blocks_.end() && !iter->second.empty()) {
+      void* const header = iter->second.back();
+      iter->second.pop_back();
+      idle_size_ -= size;
+      return BlockFromHeader(header);
+    }
+  }
+  if (ABSL_PREDICT_FALSE(size > size_t(-1) - kHeaderSize)) return nullptr;
+  void* const header = malloc(kHeaderSize + size);
+  if (ABSL_PREDICT_FALSE(header == nullptr)) return nullptr;
+  *static_cast<size_t*>(header) = size;
+  return BlockFromHeader(header);
+}
+
+void BrotliAllocator::RecyclingImplementation::Free(void* ptr) const {
+  if (ptr == nullptr) return;
+  void* const header = HeaderFromBlock(ptr);
+  const size_t size = *static_cast<const size_t*>(header);
+  if (size >= kMinRecycledBlockSize) {
+    absl::MutexLock lock(&mutex_);
+    if (size <= max_idle_size_ - idle_size_) {
+      idle_blocks_[size].push_back(header);
+      idle_size_ += size;
+      return;
+    }
+  }
+  free(header);
+}
+
+BrotliAllocator BrotliAllocator::Recycling(size_t max_idle_size) {
+  return BrotliAllocator(RefCountedPtr<const Interface>(
+      new RecyclingImplementation(max_idle_size)));
+}
+
 }  // namespace riegeli
@@ -52,6 +52,31 @@ class BrotliAllocator {
   explicit BrotliAllocator(AllocFunctor&& alloc_functor,
                            FreeFunctor&& free_functor);
 
+  // The default `max_idle_size` of `Recycling()`.
+  static constexpr size_t kDefaultMaxIdleSize = size_t{64} << 20;
+
+  // The minimum size of a block kept for reuse by `Recycling()`. Smaller
+  // blocks are cheap to allocate anyway.
+  static constexpr size_t kMinRecycledBlockSize = size_t{64} << 10;
+
+  // Specifies an allocator which keeps freed blocks of at least
+  // `kMinRecycledBlockSize` and reuses them for later allocations of the same
+  // size, instead of returning them to the system.
+  //
+  // The Brotli encoder allocates large hash tables and ring buffers for each
+  // stream, whose sizes depend only on compression parameters and the size
+  // hint. Sharing a recycling allocator among `BrotliWriter`s, e.g. among
+  // chunks written by `RecordWriter`, avoids paying for fresh memory for each
+  // of them, which dominates compression time of small chunks at high
+  // compression levels.
+  //
+  // Copies of the returned `BrotliAllocator` share idle blocks. They are
+  // thread-safe. Idle blocks are freed when the last copy is destroyed.
+  //
+  // At most `max_idle_size` bytes are kept in idle blocks; a freed block which
+  // does not fit is returned to the system.
+  static BrotliAllocator Recycling(size_t max_idle_size = kDefaultMaxIdleSize);
+
   // Returns parameters for `Brotli{Encoder,Decoder}CreateInstance()`.
   brotli_alloc_func alloc_func() const;
   brotli_free_func free_func() const;
@@ -66,6 +91,11 @@ class BrotliAllocator {
   template <typename AllocFunctor, typename FreeFunctor>
   class Implementation;
 
+  class RecyclingImplementation;
+
+  explicit BrotliAllocator(RefCountedPtr<const Interface> impl) noexcept
+      : impl_(std::move(impl)) {}
+
   RefCountedPtr<const Interface> impl_;
 };
 
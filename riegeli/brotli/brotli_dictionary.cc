@@ -19,13 +19,16 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/call_once.h"
+#include "absl/base/optimization.h"
 #include "absl/strings/string_view.h"
 #include "brotli/encode.h"
 #include "brotli/shared_dictionary.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/intrusive_ref_count.h"
+#include "riegeli/base/shared_cache.h"
 
 namespace riegeli {
 
@@ -44,6 +47,54 @@ struct BrotliEncoderDictionaryDeleter {
   }
 };
 
+// Identifies a prepared dictionary chunk in the process-wide cache.
+struct ChunkKey {
+  friend bool operator==(const ChunkKey& a, const ChunkKey& b) {
+    return a.type == b.type && a.data == b.data;
+  }
+
+  template <typename HashState>
+  friend HashState AbslHashValue(HashState hash_state, const ChunkKey& self) {
+    return HashState::combine(std::move(hash_state), self.type, self.data);
+  }
+
+  BrotliSharedDictionaryType type;
+  absl::string_view data;
+};
+
+// A prepared dictionary chunk shared by all `BrotliDictionary::Chunk` objects
+// with the same contents. It owns a copy of the data it was prepared from,
+// because the prepared form may refer to the data and may outlive the
+// `BrotliDictionary::Chunk` which requested it.
+class SharedCompressionDictionary {
+ public:
+  explicit SharedCompressionDictionary(BrotliSharedDictionaryType type,
+                                       absl::string_view data)
+      : type_(type), data_(data) {}
+
+  SharedCompressionDictionary(const SharedCompressionDictionary&) = delete;
+  SharedCompressionDictionary& operator=(const SharedCompressionDictionary&) =
+      delete;
+
+  ChunkKey key() const { return ChunkKey{type_, data_}; }
+
+  absl::string_view data() const { return data_; }
+
+  void set_prepared(BrotliEncoderPreparedDictionary* prepared) {
+    prepared_.reset(prepared);
+  }
+  const BrotliEncoderPreparedDictionary* prepared() const {
+    return prepared_.get();
+  }
+
+ private:
+  BrotliSharedDictionaryType type_;
+  std::string data_;
+  std::unique_ptr<BrotliEncoderPreparedDictionary,
+                  BrotliEncoderDictionaryDeleter>
+      prepared_;
+};
+
 }  // namespace
 
 std::shared_ptr<const BrotliEncoderPreparedDictionary>
@@ -55,14 +106,30 @@ BrotliDictionary::Chunk::PrepareCompressionDictionary() const {
              "unprepared native chunk";
       return;
     }
-    compression_dictionary_ = std::unique_ptr<BrotliEncoderPreparedDictionary,
-                                              BrotliEncoderDictionaryDeleter>(
-        BrotliEncoderPrepareDictionary(
-            static_cast<BrotliSharedDictionaryType>(type_), data_.size(),
-            reinterpret_cast<const uint8_t*>(data_.data()), BROTLI_MAX_QUALITY,
-            // `BrotliAllocator` is not supported here because the prepared
-            // dictionary may easily outlive the allocator.
-            nullptr, nullptr, nullptr));
+    const BrotliSharedDictionaryType type =
+        static_cast<BrotliSharedDictionaryType>(type_);
+    const std::shared_ptr<const SharedCompressionDictionary> shared =
+        SharedCache<ChunkKey, SharedCompressionDictionary>::global().Get(
+            ChunkKey{type, data_},
+            [&]() -> std::unique_ptr<SharedCompressionDictionary> {
+              std::unique_ptr<SharedCompressionDictionary> dictionary =
+                  std::make_unique<SharedCompressionDictionary>(type, data_);
+              dictionary->set_prepared(BrotliEncoderPrepareDictionary(
+                  type, dictionary->data().size(),
+                  reinterpret_cast<const uint8_t*>(dictionary->data().data()),
+                  BROTLI_MAX_QUALITY,
+                  // `BrotliAllocator` is not supported here because the
+                  // prepared dictionary may easily outlive the allocator.
+                  nullptr, nullptr, nullptr));
+              if (ABSL_PREDICT_FALSE(dictionary->prepared() == nullptr)) {
+                return nullptr;
+              }
+              return dictionary;
+            });
+    if (ABSL_PREDICT_FALSE(shared == nullptr)) return;
+    compression_dictionary_ =
+        std::shared_ptr<const BrotliEncoderPreparedDictionary>(
+            shared, shared->prepared());
   });
   return compression_dictionary_;
 }
@@ -50,6 +50,9 @@ namespace riegeli {
 // compression or decompression sessions, the `BrotliDictionary` object can be
 // reused to avoid preparing them again for compression.
 //
+// Prepared chunks for compression are also shared process-wide between chunks
+// with the same contents, as long as any of them is in use.
+//
 // Copying a `BrotliDictionary` object is cheap, sharing the actual
 // dictionary.
 class BrotliDictionary {
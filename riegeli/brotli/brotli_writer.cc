@@ -45,6 +45,7 @@ constexpr int BrotliWriterBase::Options::kMinCompressionLevel;
 constexpr int BrotliWriterBase::Options::kMaxCompressionLevel;
 constexpr int BrotliWriterBase::Options::kDefaultCompressionLevel;
 constexpr int BrotliWriterBase::Options::kMinWindowLog;
+constexpr int BrotliWriterBase::Options::kMaxStandardWindowLog;
 constexpr int BrotliWriterBase::Options::kMaxWindowLog;
 constexpr int BrotliWriterBase::Options::kDefaultWindowLog;
 #endif
@@ -102,7 +103,7 @@ void BrotliWriterBase::Initialize(Writer* dest, int compression_level,
   }
   if (ABSL_PREDICT_FALSE(!BrotliEncoderSetParameter(
           compressor_.get(), BROTLI_PARAM_LARGE_WINDOW,
-          uint32_t{window_log > BROTLI_MAX_WINDOW_BITS}))) {
+          uint32_t{window_log > Options::kMaxStandardWindowLog}))) {
     Fail(absl::InternalError(
         "BrotliEncoderSetParameter(BROTLI_PARAM_LARGE_WINDOW) failed"));
     return;
@@ -77,9 +77,16 @@ class BrotliWriterBase : public BufferedWriter {
     // between compression density and memory usage (higher = better density but
     // more memory).
     //
+    // If `window_log` is above `kMaxStandardWindowLog` (24), the large-window
+    // mode of Brotli is used. It is not a part of the standard Brotli format
+    // (RFC 7932), so it requires a decoder which enables it; `BrotliReader`
+    // always does. If `size_hint()` indicates that data will be small enough,
+    // `window_log` is reduced, and the standard format is used.
+    //
     // `window_log` must be between `kMinWindowLog` (10) and `kMaxWindowLog`
     // (30). Default: `kDefaultWindowLog` (22).
     static constexpr int kMinWindowLog = BROTLI_MIN_WINDOW_BITS;
+    static constexpr int kMaxStandardWindowLog = BROTLI_MAX_WINDOW_BITS;
     static constexpr int kMaxWindowLog = BROTLI_LARGE_MAX_WINDOW_BITS;
     static constexpr int kDefaultWindowLog = BROTLI_DEFAULT_WINDOW;
     Options& set_window_log(int window_log) & {
@@ -56,7 +56,7 @@ void BufferedReader::VerifyEnd() {
   Reader::VerifyEnd();
 }
 
-inline void BufferedReader::SyncBuffer() {
+void BufferedReader::SyncBuffer() {
   set_buffer();
   buffer_.Clear();
 }
@@ -127,13 +127,16 @@ class BufferedReader : public Reader {
   bool SyncImpl(SyncType sync_type) override;
   bool SeekSlow(Position new_pos) override;
 
- private:
   // Discards buffer contents and sets buffer pointers to `nullptr`.
   //
   // This can move `pos()` forwards to account for skipping over previously
   // buffered data. `limit_pos()` remains unchanged.
+  //
+  // This can be used by derived classes which read some data directly, e.g.
+  // copy them to a `Writer` in the kernel, bypassing the buffer.
   void SyncBuffer();
 
+ private:
   // Minimum length for which it is better to append current contents of
   // `buffer_` and read the remaining data directly than to read the data
   // through `buffer_`.
@@ -54,7 +54,7 @@ bool BufferedWriter::SyncBuffer() {
   return WriteInternal(data);
 }
 
-inline size_t BufferedWriter::LengthToWriteDirectly() const {
+size_t BufferedWriter::LengthToWriteDirectly() const {
   // Write directly at least `buffer_size_` of data. Even if the buffer is
   // partially full, this ensures that at least every other write has length at
   // least `buffer_size_`.
@@ -87,6 +87,13 @@ bool BufferedWriter::PushSlow(size_t min_length, size_t recommended_length) {
   return true;
 }
 
+void BufferedWriter::SetWriteSizeHintImpl(
+    absl::optional<Position> write_size_hint) {
+  size_hint_ = write_size_hint == absl::nullopt
+                   ? 0
+                   : SaturatingAdd(pos(), *write_size_hint);
+}
+
 bool BufferedWriter::FlushBehindBuffer(absl::string_view src,
                                        FlushType flush_type) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
@@ -124,18 +124,23 @@ class BufferedWriter : public Writer {
   bool WriteSlow(absl::string_view src) override;
   bool WriteZerosSlow(Position length) override;
   bool FlushImpl(FlushType flush_type) override;
+  void SetWriteSizeHintImpl(absl::optional<Position> write_size_hint) override;
   bool SeekSlow(Position new_pos) override;
   absl::optional<Position> SizeImpl() override;
   bool TruncateImpl(Position new_size) override;
   Reader* ReadModeImpl(Position initial_pos) override;
 
- private:
+  // Writes buffered data to the destination and discards the buffer.
+  //
+  // This can be used by derived classes which write some data directly, e.g.
+  // from a `Chain`, bypassing the buffer.
   bool SyncBuffer();
 
   // Minimum length for which it is better to push current contents of `buffer_`
   // and write the data directly than to write the data through `buffer_`.
   size_t LengthToWriteDirectly() const;
 
+ private:
   // Invariant: if `is_open()` then `buffer_size_ > 0`
   size_t buffer_size_ = 0;
   Position size_hint_ = 0;
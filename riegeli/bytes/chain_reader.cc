@@ -233,10 +233,31 @@ bool ChainReaderBase::SeekBehindScratch(Position new_pos) {
     set_buffer();
     return new_pos == src.size();
   }
-  const Chain::BlockAndChar block_and_char =
-      src.BlockAndCharIndex(IntCast<size_t>(new_pos));
-  iter_ = block_and_char.block_iter;
-  set_buffer(iter_->data(), iter_->size(), block_and_char.char_index);
+  // Seeking to an adjacent block is common, e.g. when skipping or rereading a
+  // small amount of data, and does not need searching for the block.
+  Chain::BlockIterator block_iter = iter_;
+  size_t char_index;
+  if (new_pos > limit_pos()) {
+    if (block_iter != src.blocks().cend() &&
+        ++block_iter != src.blocks().cend() &&
+        new_pos - limit_pos() < block_iter->size()) {
+      char_index = IntCast<size_t>(new_pos - limit_pos());
+      goto found;
+    }
+  } else if (block_iter != src.blocks().cbegin() &&
+             start_pos() - new_pos <= (--block_iter)->size()) {
+    char_index = block_iter->size() - IntCast<size_t>(start_pos() - new_pos);
+    goto found;
+  }
+  {
+    const Chain::BlockAndChar block_and_char =
+        src.BlockAndCharIndex(IntCast<size_t>(new_pos));
+    block_iter = block_and_char.block_iter;
+    char_index = block_and_char.char_index;
+  }
+found:
+  iter_ = block_iter;
+  set_buffer(iter_->data(), iter_->size(), char_index);
   set_limit_pos(new_pos + available());
   return true;
 }
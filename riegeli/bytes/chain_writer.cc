@@ -158,6 +158,14 @@ bool ChainWriterBase::FlushImpl(FlushType flush_type) {
   return true;
 }
 
+void ChainWriterBase::SetWriteSizeHintImpl(
+    absl::optional<Position> write_size_hint) {
+  options_.set_size_hint(
+      write_size_hint == absl::nullopt
+          ? 0
+          : SaturatingIntCast<size_t>(SaturatingAdd(pos(), *write_size_hint)));
+}
+
 absl::optional<Position> ChainWriterBase::SizeImpl() {
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
   return pos();
@@ -101,6 +101,9 @@ class CordReaderBase : public PullableReader {
 //
 // It supports random access and `NewReader()`.
 //
+// Reading to a `Chain` or `absl::Cord`, and copying to a `Writer` which shares
+// such data, shares large fragments of the source instead of copying them.
+//
 // The `Src` template parameter specifies the type of the object providing and
 // possibly owning the `absl::Cord` being read from. `Src` must support
 // `Dependency<const absl::Cord*, Src>`, e.g.
@@ -174,6 +174,11 @@ class CordWriterBase : public Writer {
 //
 // It supports `ReadMode()`.
 //
+// Data are not copied again when they reach the `absl::Cord`: a filled buffer
+// becomes an external `absl::Cord` fragment, unless it holds only little data
+// or is mostly unused, and large `Chain` or `absl::Cord` fragments written to
+// the `CordWriter` are shared with the destination.
+//
 // The `Dest` template parameter specifies the type of the object providing and
 // possibly owning the `absl::Cord` being written to. `Dest` must support
 // `Dependency<absl::Cord*, Dest>`, e.g. `absl::Cord*` (not owned, default),
@@ -0,0 +1,131 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/bytes/crc32c_digester.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "crc32c/crc32c.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+
+namespace riegeli {
+
+namespace {
+
+// The CRC32C polynomial, with bits reversed like in CRC32C values: the
+// coefficient of x^0 is the highest bit.
+constexpr uint32_t kPolynomial = 0x82f63b78;
+
+// Returns `a * b mod kPolynomial`, with bits reversed.
+uint32_t MultiplyModPolynomial(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t mask = uint32_t{1} << 31; mask != 0; mask >>= 1) {
+    if ((a & mask) != 0) product ^= b;
+    b = (b & 1) != 0 ? (b >> 1) ^ kPolynomial : b >> 1;
+  }
+  return product;
+}
+
+// Returns `x^(8 * length) mod kPolynomial`, with bits reversed.
+uint32_t PowerOfXForBytes(Position length) {
+  uint32_t power = uint32_t{1} << 31;         // x^0
+  uint32_t square = uint32_t{1} << (31 - 8);  // x^8
+  for (;;) {
+    if ((length & 1) != 0) power = MultiplyModPolynomial(square, power);
+    length >>= 1;
+    if (length == 0) return power;
+    square = MultiplyModPolynomial(square, square);
+  }
+}
+
+// The amount of data digested by one task, large enough to amortize
+// scheduling it.
+constexpr size_t kSegmentSize = size_t{1} << 20;
+
+struct Segment {
+  std::vector<absl::string_view> fragments;
+  size_t length = 0;
+  uint32_t crc = 0;
+};
+
+// Splits `fragment` into pieces of at most `kSegmentSize`, appending them to
+// `segments`, starting a new `Segment` whenever the last one reaches
+// `kSegmentSize`.
+void AddFragment(absl::string_view fragment, std::vector<Segment>& segments) {
+  while (!fragment.empty()) {
+    if (segments.empty() || segments.back().length >= kSegmentSize) {
+      segments.emplace_back();
+    }
+    Segment& segment = segments.back();
+    const absl::string_view piece =
+        fragment.substr(0, kSegmentSize - segment.length);
+    segment.fragments.push_back(piece);
+    segment.length += piece.size();
+    fragment.remove_prefix(piece.size());
+  }
+}
+
+void DigestSegment(Segment& segment) {
+  uint32_t crc = 0;
+  for (const absl::string_view fragment : segment.fragments) {
+    crc = crc32c::Extend(crc, reinterpret_cast<const uint8_t*>(fragment.data()),
+                         fragment.size());
+  }
+  segment.crc = crc;
+}
+
+uint32_t DigestSegments(std::vector<Segment>& segments, Executor* executor) {
+  if (segments.empty()) return 0;
+  if (segments.size() > 1) {
+    internal::ParallelFor(
+        executor == nullptr ? internal::ThreadPool::global() : *executor,
+        segments.size(),
+        [&segments](size_t index) { DigestSegment(segments[index]); });
+  } else {
+    DigestSegment(segments[0]);
+  }
+  uint32_t crc = segments[0].crc;
+  for (size_t index = 1; index < segments.size(); ++index) {
+    crc = Crc32cCombine(crc, segments[index].crc, segments[index].length);
+  }
+  return crc;
+}
+
+}  // namespace
+
+uint32_t Crc32cCombine(uint32_t crc_a, uint32_t crc_b, Position length_b) {
+  return MultiplyModPolynomial(PowerOfXForBytes(length_b), crc_a) ^ crc_b;
+}
+
+uint32_t ParallelCrc32c(absl::string_view src, Executor* executor) {
+  std::vector<Segment> segments;
+  AddFragment(src, segments);
+  return DigestSegments(segments, executor);
+}
+
+uint32_t ParallelCrc32c(const Chain& src, Executor* executor) {
+  std::vector<Segment> segments;
+  for (const absl::string_view fragment : src.blocks()) {
+    AddFragment(fragment, segments);
+  }
+  return DigestSegments(segments, executor);
+}
+
+}  // namespace riegeli
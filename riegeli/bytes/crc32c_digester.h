@@ -0,0 +1,84 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_CRC32C_DIGESTER_H_
+#define RIEGELI_BYTES_CRC32C_DIGESTER_H_
+
+#include <stdint.h>
+
+#include "absl/strings/string_view.h"
+#include "crc32c/crc32c.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+
+namespace riegeli {
+
+// A `Digester` for `DigestingReader` and `DigestingWriter` which computes
+// CRC32C (Castagnoli).
+//
+// The computation uses the SSE4.2 or ARMv8 CRC32 instructions when the CPU
+// supports them, with a portable fallback otherwise.
+//
+// `Chain` and `absl::Cord` data are digested fragment by fragment, without
+// being flattened.
+//
+// Example:
+//
+// ```
+//   riegeli::DigestingWriter<riegeli::Crc32cDigester, riegeli::Writer*>
+//       writer(&dest);
+//   ... Write to writer.
+//   if (!writer.Close()) ... Failed with reason: writer.status()
+//   const uint32_t crc = writer.Digest();
+// ```
+class Crc32cDigester {
+ public:
+  // Creates a `Crc32cDigester` continuing from `seed`, which is the CRC32C of
+  // data preceding the data to be digested, or 0 if there are none.
+  explicit Crc32cDigester(uint32_t seed = 0) : crc_(seed) {}
+
+  void Reset(uint32_t seed = 0) { crc_ = seed; }
+
+  void Write(absl::string_view src) {
+    crc_ = crc32c::Extend(crc_, reinterpret_cast<const uint8_t*>(src.data()),
+                          src.size());
+  }
+
+  uint32_t Digest() { return crc_; }
+
+ private:
+  uint32_t crc_;
+};
+
+// Returns the CRC32C of the concatenation of data `a` and `b`, given
+// `crc_a = CRC32C(a)`, `crc_b = CRC32C(b)`, and `length_b = b.size()`.
+//
+// This takes time logarithmic in `length_b`, which lets CRC32Cs of adjacent
+// ranges be computed independently, e.g. in parallel, and then combined.
+uint32_t Crc32cCombine(uint32_t crc_a, uint32_t crc_b, Position length_b);
+
+// Returns the CRC32C of `src`, digesting ranges of about 1 MiB in parallel
+// using tasks scheduled on `executor` (or the thread pool shared by all
+// parallel operations of Riegeli if `nullptr`), and combining the results with
+// `Crc32cCombine()`. Small data are digested by the calling thread.
+//
+// The calling thread takes part in the work, hence this can be called from a
+// task scheduled on the same `Executor`.
+uint32_t ParallelCrc32c(absl::string_view src, Executor* executor = nullptr);
+uint32_t ParallelCrc32c(const Chain& src, Executor* executor = nullptr);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_CRC32C_DIGESTER_H_
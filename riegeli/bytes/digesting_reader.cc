@@ -131,6 +131,19 @@ void DigestingReaderBase::ReadHintSlow(size_t length) {
   MakeBuffer(src);
 }
 
+void DigestingReaderBase::SetAccessPatternImpl(AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  src_reader()->SetAccessPattern(access_pattern);
+}
+
+void DigestingReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  SyncBuffer(src);
+  src.WillNeed(length);
+  MakeBuffer(src);
+}
+
 bool DigestingReaderBase::SupportsSize() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsSize();
@@ -68,6 +68,8 @@ class DigestingReaderBase : public Reader {
   bool ReadSlow(size_t length, Chain& dest) override;
   bool ReadSlow(size_t length, absl::Cord& dest) override;
   void ReadHintSlow(size_t length) override;
+  void SetAccessPatternImpl(AccessPattern access_pattern) override;
+  void WillNeedImpl(Position length) override;
   absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
@@ -0,0 +1,129 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make `splice()` available.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "riegeli/bytes/fd_copy.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "absl/base/optimization.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+
+namespace riegeli {
+namespace internal {
+
+TypeId FdCopyWriterBase::GetTypeId() const {
+  return TypeId::For<FdCopyWriterBase>();
+}
+
+#ifdef __linux__
+
+namespace {
+
+// Returns `true` if `error_code` from a kernel copying system call means that
+// the system call does not support these fds, rather than a failure.
+inline bool KernelCopyUnsupported(int error_code) {
+  return error_code == ENOSYS || error_code == EINVAL || error_code == EXDEV ||
+         error_code == EOPNOTSUPP || error_code == ENOTSUP ||
+         error_code == EBADF || error_code == ESPIPE || error_code == EPERM;
+}
+
+}  // namespace
+
+ssize_t KernelCopy(int src, Position* src_offset, int dest,
+                   Position* dest_offset, size_t length,
+                   KernelCopyMethod& method) {
+  length = UnsignedMin(length, size_t{0x7ffff000});
+  for (;;) {
+    off_t src_off = src_offset == nullptr ? 0 : IntCast<off_t>(*src_offset);
+    off_t dest_off = dest_offset == nullptr ? 0 : IntCast<off_t>(*dest_offset);
+    ssize_t length_copied = -1;
+    switch (method) {
+      case KernelCopyMethod::kCopyFileRange:
+#ifdef SYS_copy_file_range
+        length_copied = static_cast<ssize_t>(
+            syscall(SYS_copy_file_range, src,
+                    src_offset == nullptr ? nullptr : &src_off, dest,
+                    dest_offset == nullptr ? nullptr : &dest_off, length, 0u));
+#else
+        length_copied = -1;
+        errno = ENOSYS;
+#endif
+        break;
+      case KernelCopyMethod::kSendfile:
+        if (dest_offset != nullptr) {
+          length_copied = -1;
+          errno = EINVAL;
+          break;
+        }
+        length_copied = sendfile(
+            dest, src, src_offset == nullptr ? nullptr : &src_off, length);
+        break;
+      case KernelCopyMethod::kSplice:
+        length_copied =
+            splice(src, src_offset == nullptr ? nullptr : &src_off, dest,
+                   dest_offset == nullptr ? nullptr : &dest_off, length, 0u);
+        break;
+      case KernelCopyMethod::kNone:
+        errno = ENOSYS;
+        return -1;
+      default:
+        RIEGELI_ASSERT_UNREACHABLE()
+            << "Unknown kernel copy method: " << static_cast<int>(method);
+    }
+    if (ABSL_PREDICT_FALSE(length_copied < 0)) {
+      if (errno == EINTR) continue;
+      if (KernelCopyUnsupported(errno)) {
+        method = static_cast<KernelCopyMethod>(static_cast<int>(method) + 1);
+        continue;
+      }
+      return -1;
+    }
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_copied), length)
+        << "Kernel copy copied more than requested";
+    if (src_offset != nullptr) *src_offset += IntCast<size_t>(length_copied);
+    if (dest_offset != nullptr) *dest_offset += IntCast<size_t>(length_copied);
+    return length_copied;
+  }
+}
+
+#else  // !__linux__
+
+ssize_t KernelCopy(int src, Position* src_offset, int dest,
+                   Position* dest_offset, size_t length,
+                   KernelCopyMethod& method) {
+  method = KernelCopyMethod::kNone;
+  errno = ENOSYS;
+  return -1;
+}
+
+#endif  // !__linux__
+
+}  // namespace internal
+}  // namespace riegeli
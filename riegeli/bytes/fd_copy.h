@@ -0,0 +1,96 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_FD_COPY_H_
+#define RIEGELI_BYTES_FD_COPY_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <utility>
+
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/buffered_writer.h"
+
+namespace riegeli {
+
+class FdReaderBase;
+
+namespace internal {
+
+// The part of `FdWriterBase` and `SocketWriterBase` which lets
+// `FdReaderBase::Copy()` copy data to the destination fd in the kernel. It is
+// separate from `FdWriterBase` because `FdWriterBase` depends on
+// `FdReaderBase`.
+class FdCopyWriterBase : public BufferedWriter {
+ public:
+  TypeId GetTypeId() const override;
+
+ protected:
+  using BufferedWriter::BufferedWriter;
+
+  FdCopyWriterBase(FdCopyWriterBase&& that) noexcept
+      : BufferedWriter(std::move(that)) {}
+  FdCopyWriterBase& operator=(FdCopyWriterBase&& that) noexcept {
+    BufferedWriter::operator=(std::move(that));
+    return *this;
+  }
+
+  // Prepares for copying data to the fd in the kernel: writes buffered data
+  // to the fd and discards the buffer.
+  //
+  // Returns the fd, with `dest_offset` set to the position to write at if the
+  // fd position must not be used, or -1 if data cannot be copied in the kernel
+  // now, e.g. because writes are in flight with io_uring or direct I/O is used.
+  virtual int BeginKernelCopy(absl::optional<Position>& dest_offset) = 0;
+
+  // Accounts for `length` bytes copied to the fd in the kernel after
+  // `BeginKernelCopy()`.
+  virtual void EndKernelCopy(Position length) = 0;
+
+ private:
+  friend class riegeli::FdReaderBase;  // For `{Begin,End}KernelCopy()`.
+};
+
+// System calls used by `KernelCopy()`, in the order they are tried.
+enum class KernelCopyMethod { kCopyFileRange, kSendfile, kSplice, kNone };
+
+// Copies up to `length` bytes from `src` to `dest` in the kernel, without
+// passing them through user space.
+//
+// If `src_offset` (`dest_offset`) is not `nullptr`, data are read (written) at
+// `*src_offset` (`*dest_offset`), which is advanced, and the fd position is
+// unchanged. Otherwise the fd position is used and advanced.
+//
+// `copy_file_range()` is tried first, which lets file systems share extents
+// (reflinks) or copy on a server. Then `sendfile()` is tried if `dest_offset`
+// is `nullptr`, and `splice()` if one of the fds is a pipe. `method` should
+// be initially `KernelCopyMethod::kCopyFileRange`, and is advanced past
+// methods which are not supported for these fds.
+//
+// Return values:
+//  * positive - the number of bytes copied
+//  * 0        - the end of `src` was reached
+//  * -1       - failure (`errno` is set), or `method` became
+//               `KernelCopyMethod::kNone`
+ssize_t KernelCopy(int src, Position* src_offset, int dest,
+                   Position* dest_offset, size_t length,
+                   KernelCopyMethod& method);
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_FD_COPY_H_
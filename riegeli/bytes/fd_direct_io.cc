@@ -0,0 +1,51 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make `O_DIRECT` available.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "riegeli/bytes/fd_direct_io.h"
+
+#include <fcntl.h>
+
+#include <cerrno>
+
+#include "absl/base/optimization.h"
+
+namespace riegeli {
+namespace internal {
+
+int SetDirectIo(int fd, bool direct_io) {
+#ifdef O_DIRECT
+  const int flags = fcntl(fd, F_GETFL);
+  if (ABSL_PREDICT_FALSE(flags < 0)) return -1;
+  const bool was_direct_io = (flags & O_DIRECT) != 0;
+  if (direct_io != was_direct_io) {
+    if (ABSL_PREDICT_FALSE(
+            fcntl(fd, F_SETFL, direct_io ? flags | O_DIRECT
+                                         : flags & ~O_DIRECT) < 0)) {
+      return -1;
+    }
+  }
+  return was_direct_io ? 1 : 0;
+#else
+  errno = EINVAL;
+  return -1;
+#endif
+}
+
+}  // namespace internal
+}  // namespace riegeli
@@ -0,0 +1,100 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_FD_DIRECT_IO_H_
+#define RIEGELI_BYTES_FD_DIRECT_IO_H_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "riegeli/base/base.h"
+#include "riegeli/base/memory.h"
+
+namespace riegeli {
+namespace internal {
+
+// Alignment of buffer addresses, file positions, and lengths of reads and
+// writes with `O_DIRECT`. This is a multiple of logical block sizes of common
+// devices.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kDirectIoAlignment, 4096);
+
+// Sets or clears `O_DIRECT` of `fd`.
+//
+// Return values:
+//  * 1  - success, `O_DIRECT` was set before
+//  * 0  - success, `O_DIRECT` was cleared before
+//  * -1 - failure (`errno` is set), e.g. `O_DIRECT` is not supported
+int SetDirectIo(int fd, bool direct_io);
+
+// A buffer with address and capacity aligned to `kDirectIoAlignment`.
+class DirectIoBuffer {
+ public:
+  DirectIoBuffer() noexcept {}
+
+  // Ensures at least `min_capacity` of space.
+  explicit DirectIoBuffer(size_t min_capacity);
+
+  // The source `DirectIoBuffer` is left deallocated.
+  DirectIoBuffer(DirectIoBuffer&& that) noexcept;
+  DirectIoBuffer& operator=(DirectIoBuffer&& that) noexcept;
+
+  ~DirectIoBuffer() { DeleteInternal(); }
+
+  // Returns the data pointer, or `nullptr` if deallocated.
+  char* data() const { return data_; }
+
+  // Returns the usable data size, a multiple of `kDirectIoAlignment`.
+  size_t capacity() const { return capacity_; }
+
+ private:
+  void DeleteInternal();
+
+  char* data_ = nullptr;
+  size_t capacity_ = 0;
+  // Invariant: if `data_ == nullptr` then `capacity_ == 0`
+};
+
+// Implementation details follow.
+
+inline DirectIoBuffer::DirectIoBuffer(size_t min_capacity)
+    : capacity_(RoundUp<kDirectIoAlignment>(
+          UnsignedMax(min_capacity, size_t{1}))) {
+  data_ = NewAligned<char, kDirectIoAlignment>(capacity_);
+}
+
+inline DirectIoBuffer::DirectIoBuffer(DirectIoBuffer&& that) noexcept
+    : data_(std::exchange(that.data_, nullptr)),
+      capacity_(std::exchange(that.capacity_, 0)) {}
+
+inline DirectIoBuffer& DirectIoBuffer::operator=(
+    DirectIoBuffer&& that) noexcept {
+  // Exchange `that.data_` early to support self-assignment.
+  char* const data = std::exchange(that.data_, nullptr);
+  DeleteInternal();
+  data_ = data;
+  capacity_ = std::exchange(that.capacity_, 0);
+  return *this;
+}
+
+inline void DirectIoBuffer::DeleteInternal() {
+  if (data_ != nullptr) {
+    DeleteAligned<char, kDirectIoAlignment>(data_, capacity_);
+  }
+}
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_FD_DIRECT_IO_H_
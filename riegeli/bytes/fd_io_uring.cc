@@ -0,0 +1,335 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/bytes/fd_io_uring.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define RIEGELI_INTERNAL_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef RIEGELI_INTERNAL_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/fd_dependency.h"
+
+namespace riegeli {
+namespace internal {
+
+#ifdef RIEGELI_INTERNAL_HAVE_IO_URING
+
+struct FdIoUring::Ring {
+  Ring() noexcept {}
+
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  ~Ring();
+
+  int ring_fd = -1;
+  int fd = -1;
+  // If `true`, buffers are registered with the kernel, otherwise they are
+  // passed with each request through `iovecs`.
+  bool fixed_buffers = false;
+
+  void* sq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0;
+  void* cq_ring = MAP_FAILED;
+  size_t cq_ring_size = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_size = 0;
+
+  unsigned* sq_tail = nullptr;
+  unsigned sq_mask = 0;
+  unsigned* sq_array = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  // The number of requests prepared but not submitted yet.
+  unsigned num_prepared = 0;
+  std::vector<iovec> iovecs;
+};
+
+FdIoUring::Ring::~Ring() {
+  if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+  if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+    munmap(cq_ring, cq_ring_size);
+  }
+  if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+  if (ring_fd >= 0) CloseFd(ring_fd);
+}
+
+namespace {
+
+template <typename T>
+T* AtOffset(void* base, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                 unsigned flags) {
+  return IntCast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                              min_complete, flags, nullptr, 0));
+}
+
+}  // namespace
+
+FdIoUring::FdIoUring() noexcept {}
+
+FdIoUring::~FdIoUring() {
+  // The kernel may use buffers until requests in flight complete.
+  while (num_in_flight_ > 0) {
+    size_t index;
+    ssize_t result;
+    if (ABSL_PREDICT_FALSE(!WaitForCompletion(index, result))) break;
+  }
+  ring_.reset();
+}
+
+bool FdIoUring::Initialize(int fd, size_t num_buffers, size_t buffer_size) {
+  RIEGELI_ASSERT(ring_ == nullptr)
+      << "Failed precondition of FdIoUring::Initialize(): "
+         "already initialized";
+  RIEGELI_ASSERT_GT(num_buffers, 0u)
+      << "Failed precondition of FdIoUring::Initialize(): no buffers";
+  RIEGELI_ASSERT_GT(buffer_size, 0u)
+      << "Failed precondition of FdIoUring::Initialize(): zero buffer size";
+  // `io_uring_sqe::buf_index` has 16 bits, and `io_uring_cqe::res` must be
+  // able to represent `buffer_size`.
+  if (ABSL_PREDICT_FALSE(
+          num_buffers > std::numeric_limits<uint16_t>::max() ||
+          buffer_size >
+              IntCast<size_t>(std::numeric_limits<int32_t>::max()))) {
+    errno = EINVAL;
+    return false;
+  }
+  std::unique_ptr<Ring> ring = std::make_unique<Ring>();
+  const auto fail = [&ring] {
+    const int error_number = errno;
+    ring.reset();
+    errno = error_number;
+    return false;
+  };
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->ring_fd = IntCast<int>(syscall(
+      __NR_io_uring_setup, IntCast<unsigned>(num_buffers), &params));
+  if (ABSL_PREDICT_FALSE(ring->ring_fd < 0)) return fail();
+  ring->fd = fd;
+
+  ring->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->sq_ring_size = UnsignedMax(ring->sq_ring_size, ring->cq_ring_size);
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                       IORING_OFF_SQ_RING);
+  if (ABSL_PREDICT_FALSE(ring->sq_ring == MAP_FAILED)) return fail();
+  if (single_mmap) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->ring_fd,
+                         IORING_OFF_CQ_RING);
+    if (ABSL_PREDICT_FALSE(ring->cq_ring == MAP_FAILED)) return fail();
+  }
+  ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void* const sqes =
+      mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+  if (ABSL_PREDICT_FALSE(sqes == MAP_FAILED)) return fail();
+  ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+  ring->sq_tail = AtOffset<unsigned>(ring->sq_ring, params.sq_off.tail);
+  ring->sq_mask = *AtOffset<unsigned>(ring->sq_ring, params.sq_off.ring_mask);
+  ring->sq_array = AtOffset<unsigned>(ring->sq_ring, params.sq_off.array);
+  ring->cq_head = AtOffset<unsigned>(ring->cq_ring, params.cq_off.head);
+  ring->cq_tail = AtOffset<unsigned>(ring->cq_ring, params.cq_off.tail);
+  ring->cq_mask = *AtOffset<unsigned>(ring->cq_ring, params.cq_off.ring_mask);
+  ring->cqes = AtOffset<io_uring_cqe>(ring->cq_ring, params.cq_off.cqes);
+
+  std::vector<std::unique_ptr<char[]>> buffers;
+  buffers.reserve(num_buffers);
+  ring->iovecs.reserve(num_buffers);
+  for (size_t i = 0; i < num_buffers; ++i) {
+    buffers.emplace_back(new char[buffer_size]);
+    ring->iovecs.push_back(iovec{buffers.back().get(), buffer_size});
+  }
+  // Registering buffers avoids mapping them for each request. This can fail,
+  // e.g. because of `RLIMIT_MEMLOCK`, then buffers are passed with each
+  // request.
+  ring->fixed_buffers =
+      syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS,
+              ring->iovecs.data(), IntCast<unsigned>(num_buffers)) == 0;
+
+  ring_ = std::move(ring);
+  buffer_size_ = buffer_size;
+  buffers_ = std::move(buffers);
+  return true;
+}
+
+inline void FdIoUring::Prepare(bool write, size_t index, size_t offset,
+                               size_t length, Position pos) {
+  RIEGELI_ASSERT(ring_ != nullptr)
+      << "Failed precondition of FdIoUring: not initialized";
+  RIEGELI_ASSERT_LT(index, num_buffers())
+      << "Failed precondition of FdIoUring: buffer index out of range";
+  RIEGELI_ASSERT_LE(offset, buffer_size_)
+      << "Failed precondition of FdIoUring: offset out of range";
+  RIEGELI_ASSERT_LE(length, buffer_size_ - offset)
+      << "Failed precondition of FdIoUring: length out of range";
+  RIEGELI_ASSERT_LT(num_in_flight_, num_buffers())
+      << "Failed precondition of FdIoUring: too many requests in flight";
+  Ring& ring = *ring_;
+  // Only this thread writes `*ring.sq_tail`.
+  const unsigned tail = *ring.sq_tail;
+  const unsigned sq_index = tail & ring.sq_mask;
+  io_uring_sqe& sqe = ring.sqes[sq_index];
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.fd = ring.fd;
+  sqe.off = pos;
+  sqe.user_data = index;
+  if (ring.fixed_buffers) {
+    sqe.opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe.addr = reinterpret_cast<uintptr_t>(buffer(index) + offset);
+    sqe.len = IntCast<uint32_t>(length);
+    sqe.buf_index = IntCast<uint16_t>(index);
+  } else {
+    iovec& iov = ring.iovecs[index];
+    iov.iov_base = buffer(index) + offset;
+    iov.iov_len = length;
+    sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.addr = reinterpret_cast<uintptr_t>(&iov);
+    sqe.len = 1;
+  }
+  ring.sq_array[sq_index] = sq_index;
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++ring.num_prepared;
+  ++num_in_flight_;
+}
+
+void FdIoUring::PrepareRead(size_t index, size_t offset, size_t length,
+                            Position pos) {
+  Prepare(false, index, offset, length, pos);
+}
+
+void FdIoUring::PrepareWrite(size_t index, size_t offset, size_t length,
+                             Position pos) {
+  Prepare(true, index, offset, length, pos);
+}
+
+bool FdIoUring::Submit() {
+  RIEGELI_ASSERT(ring_ != nullptr)
+      << "Failed precondition of FdIoUring::Submit(): not initialized";
+  Ring& ring = *ring_;
+  while (ring.num_prepared > 0) {
+    const int num_submitted =
+        IoUringEnter(ring.ring_fd, ring.num_prepared, 0, 0);
+    if (ABSL_PREDICT_FALSE(num_submitted < 0)) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    ring.num_prepared -= IntCast<unsigned>(num_submitted);
+  }
+  return true;
+}
+
+bool FdIoUring::WaitForCompletion(size_t& index, ssize_t& result) {
+  RIEGELI_ASSERT_GT(num_in_flight_, 0u)
+      << "Failed precondition of FdIoUring::WaitForCompletion(): "
+         "no requests in flight";
+  if (ABSL_PREDICT_FALSE(!Submit())) return false;
+  Ring& ring = *ring_;
+  for (;;) {
+    // Only this thread writes `*ring.cq_head`.
+    const unsigned head = *ring.cq_head;
+    if (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe& cqe = ring.cqes[head & ring.cq_mask];
+      index = IntCast<size_t>(cqe.user_data);
+      result = cqe.res;
+      __atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+      --num_in_flight_;
+      return true;
+    }
+    if (ABSL_PREDICT_FALSE(
+            IoUringEnter(ring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0) &&
+        errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+#else  // !RIEGELI_INTERNAL_HAVE_IO_URING
+
+struct FdIoUring::Ring {};
+
+FdIoUring::FdIoUring() noexcept {}
+
+FdIoUring::~FdIoUring() {}
+
+bool FdIoUring::Initialize(int fd, size_t num_buffers, size_t buffer_size) {
+  errno = ENOSYS;
+  return false;
+}
+
+void FdIoUring::PrepareRead(size_t index, size_t offset, size_t length,
+                            Position pos) {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of FdIoUring: not initialized";
+}
+
+void FdIoUring::PrepareWrite(size_t index, size_t offset, size_t length,
+                             Position pos) {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of FdIoUring: not initialized";
+}
+
+bool FdIoUring::Submit() {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of FdIoUring: not initialized";
+}
+
+bool FdIoUring::WaitForCompletion(size_t& index, ssize_t& result) {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of FdIoUring: not initialized";
+}
+
+#endif  // !RIEGELI_INTERNAL_HAVE_IO_URING
+
+}  // namespace internal
+}  // namespace riegeli
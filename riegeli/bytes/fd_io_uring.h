@@ -0,0 +1,113 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_FD_IO_URING_H_
+#define RIEGELI_BYTES_FD_IO_URING_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <vector>
+
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+namespace internal {
+
+// A minimal wrapper of Linux io_uring, which reads and writes a fd at given
+// positions, keeping several requests in flight.
+//
+// Each request uses one of `num_buffers()` buffers owned by `FdIoUring`, which
+// are registered with the kernel if possible. At most one request per buffer
+// may be in flight.
+//
+// If io_uring is not supported, `Initialize()` fails, and the caller is
+// expected to fall back to `pread()` and `pwrite()`.
+class FdIoUring {
+ public:
+  FdIoUring() noexcept;
+
+  FdIoUring(const FdIoUring&) = delete;
+  FdIoUring& operator=(const FdIoUring&) = delete;
+
+  // Waits for requests in flight before destroying the ring.
+  ~FdIoUring();
+
+  // Sets up the ring for `fd`, with `num_buffers` buffers of `buffer_size`
+  // bytes each.
+  //
+  // Preconditions:
+  //   `num_buffers > 0`
+  //   `buffer_size > 0`
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - failure (`errno` is set)
+  bool Initialize(int fd, size_t num_buffers, size_t buffer_size);
+
+  size_t num_buffers() const { return buffers_.size(); }
+  size_t buffer_size() const { return buffer_size_; }
+  char* buffer(size_t index) { return buffers_[index].get(); }
+
+  // Returns the number of requests prepared or submitted, whose completion
+  // was not returned by `WaitForCompletion()` yet.
+  size_t num_in_flight() const { return num_in_flight_; }
+
+  // Prepares reading up to `length` bytes at position `pos` into
+  // `buffer(index) + offset`.
+  //
+  // Precondition: `offset + length <= buffer_size()`
+  void PrepareRead(size_t index, size_t offset, size_t length, Position pos);
+
+  // Prepares writing `length` bytes from `buffer(index) + offset` at position
+  // `pos`.
+  //
+  // Precondition: `offset + length <= buffer_size()`
+  void PrepareWrite(size_t index, size_t offset, size_t length, Position pos);
+
+  // Submits prepared requests without waiting for their completion.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - failure (`errno` is set)
+  bool Submit();
+
+  // Submits prepared requests and waits for the completion of any request.
+  // Sets `index` to its buffer index, and `result` to the number of bytes
+  // transferred, or to `-errno` if the request failed.
+  //
+  // Precondition: `num_in_flight() > 0`
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - failure (`errno` is set)
+  bool WaitForCompletion(size_t& index, ssize_t& result);
+
+ private:
+  struct Ring;
+
+  void Prepare(bool write, size_t index, size_t offset, size_t length,
+               Position pos);
+
+  std::unique_ptr<Ring> ring_;
+  size_t buffer_size_ = 0;
+  std::vector<std::unique_ptr<char[]>> buffers_;
+  size_t num_in_flight_ = 0;
+};
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_FD_IO_URING_H_
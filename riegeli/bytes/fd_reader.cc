@@ -26,6 +26,7 @@
 
 #include <fcntl.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -33,12 +34,15 @@
 #include <unistd.h>
 
 #include <cerrno>
+#include <cstring>
 #include <limits>
+#include <memory>
 #include <string>
 #include <tuple>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -46,19 +50,26 @@
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/errno_mapping.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/memory_estimator.h"
+#include "riegeli/base/object.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/fd_copy.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_direct_io.h"
+#include "riegeli/bytes/fd_io_uring.h"
+#include "riegeli/bytes/writer.h"
 
 namespace riegeli {
 
 namespace {
 
+// Owns a mapping which begins `page_offset` bytes before the data.
 class MMapRef {
  public:
-  MMapRef() noexcept {}
+  explicit MMapRef(size_t page_offset) noexcept : page_offset_(page_offset) {}
 
   MMapRef(const MMapRef&) = delete;
   MMapRef& operator=(const MMapRef&) = delete;
@@ -66,10 +77,15 @@ class MMapRef {
   void operator()(absl::string_view data) const;
   void RegisterSubobjects(MemoryEstimator& memory_estimator) const;
   void DumpStructure(std::ostream& out) const;
+
+ private:
+  size_t page_offset_;
 };
 
 void MMapRef::operator()(absl::string_view data) const {
-  RIEGELI_CHECK_EQ(munmap(const_cast<char*>(data.data()), data.size()), 0)
+  RIEGELI_CHECK_EQ(munmap(const_cast<char*>(data.data()) - page_offset_,
+                          data.size() + page_offset_),
+                   0)
       << ErrnoToCanonicalStatus(errno, "munmap() failed").message();
 }
 
@@ -77,6 +93,19 @@ void MMapRef::RegisterSubobjects(MemoryEstimator& memory_estimator) const {}
 
 void MMapRef::DumpStructure(std::ostream& out) const { out << "[mmap] { }"; }
 
+size_t PageSize() {
+  static const size_t kPageSize = IntCast<size_t>(sysconf(_SC_PAGESIZE));
+  return kPageSize;
+}
+
+// Advises the kernel about mapped `data`, extending them to page boundaries
+// as required by `madvise()`.
+void AdviseMapping(const char* data, size_t length, int advice) {
+  const size_t page_offset = reinterpret_cast<uintptr_t>(data) % PageSize();
+  // Advice is only a hint, so failures are ignored.
+  madvise(const_cast<char*>(data) - page_offset, length + page_offset, advice);
+}
+
 }  // namespace
 
 void FdReaderBase::Initialize(int src,
@@ -136,6 +165,7 @@ void FdReaderBase::InitializePos(int src, absl::optional<Position> assumed_pos,
     }
     set_limit_pos(*independent_pos);
   } else {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     const off_t file_pos = lseek(src, 0, SEEK_CUR);
     if (file_pos < 0) {
       // Random access is not supported. Assume 0 as the initial position.
@@ -148,7 +178,26 @@ void FdReaderBase::InitializePos(int src, absl::optional<Position> assumed_pos,
 }
 
 void FdReaderBase::Done() {
+  if (access_pattern_ != AccessPattern::kNormal) {
+    // Restore the default advice, which persists in the open file description.
+    Advise(0, 0, POSIX_FADV_NORMAL);
+    access_pattern_ = AccessPattern::kNormal;
+  }
+  StopReadingAhead();
   BufferedReader::Done();
+  io_uring_.reset();
+  io_uring_reads_.clear();
+  io_uring_free_buffers_.clear();
+  if (direct_io_buffer_.data() != nullptr) {
+    direct_io_buffer_ = internal::DirectIoBuffer();
+    if (!fd_had_direct_io_) {
+      const int src = src_fd();
+      if (ABSL_PREDICT_FALSE(internal::SetDirectIo(src, false) < 0) &&
+          ABSL_PREDICT_TRUE(healthy())) {
+        FailOperation("fcntl()");
+      }
+    }
+  }
   // If `supports_random_access_` is still `LazyBoolState::kUnknown`, change it
   // to `LazyBoolState::kFalse`, because trying to resolve it later might access
   // a closed stream. The resolution is no longer interesting anyway.
@@ -192,7 +241,9 @@ bool FdReaderBase::supports_random_access() {
     // recognized by a failing `lseek(SEEK_END)`.
   } else {
     const int src = src_fd();
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     if (lseek(src, 0, SEEK_END) >= 0) {
+      internal::CountSyscall(IoStats::Syscall::kSeek);
       if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(limit_pos()), SEEK_SET) <
                              0)) {
         FailOperation("lseek()");
@@ -222,6 +273,14 @@ bool FdReaderBase::ReadInternal(size_t min_length, size_t max_length,
                              limit_pos())) {
     return FailOverflow();
   }
+  if (direct_io_buffer_.data() != nullptr || (direct_io_ && StartDirectIo())) {
+    return ReadWithDirectIo(min_length, max_length, dest);
+  }
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (io_uring_ != nullptr || (io_uring_depth_ > 0 && StartIoUring())) {
+    return ReadWithIoUring(min_length, max_length, dest);
+  }
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
   for (;;) {
   again:
     const ssize_t length_read =
@@ -237,6 +296,8 @@ bool FdReaderBase::ReadInternal(size_t min_length, size_t max_length,
       if (errno == EINTR) goto again;
       return FailOperation(has_independent_pos_ ? "pread()" : "read()");
     }
+    internal::CountSyscall(IoStats::Syscall::kRead,
+                           IntCast<size_t>(length_read));
     if (ABSL_PREDICT_FALSE(length_read == 0)) return false;
     RIEGELI_ASSERT_LE(IntCast<size_t>(length_read), max_length)
         << (has_independent_pos_ ? "pread()" : "read()")
@@ -249,6 +310,314 @@ bool FdReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+bool FdReaderBase::CopySlow(Position length, Writer& dest) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), length)
+      << "Failed precondition of Reader::CopySlow(Writer&): "
+         "enough data available, use Copy(Writer&) instead";
+  if (length > available() && length - available() >= buffer_size() &&
+      dest.GetTypeId() == TypeId::For<internal::FdCopyWriterBase>()) {
+    if (ABSL_PREDICT_FALSE(!CopyInKernel(
+            length, static_cast<internal::FdCopyWriterBase&>(dest)))) {
+      return false;
+    }
+    if (length == 0) return true;
+  }
+  return BufferedReader::CopySlow(length, dest);
+}
+
+bool FdReaderBase::CopyInKernel(Position& length,
+                                internal::FdCopyWriterBase& dest) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return true;
+  if (io_uring_ != nullptr || direct_io_buffer_.data() != nullptr) return true;
+  if (available() > 0) {
+    const size_t available_length = available();
+    const bool write_ok =
+        dest.Write(absl::string_view(cursor(), available_length));
+    move_cursor(available_length);
+    length -= available_length;
+    if (ABSL_PREDICT_FALSE(!write_ok)) return false;
+  }
+  absl::optional<Position> dest_offset;
+  const int dest_fd = dest.BeginKernelCopy(dest_offset);
+  if (dest_fd < 0) return true;
+  SyncBuffer();
+  const int src = src_fd();
+  Position src_offset = limit_pos();
+  internal::KernelCopyMethod method =
+      internal::KernelCopyMethod::kCopyFileRange;
+  while (length > 0) {
+    // Errors are not reported here. Copying continues through the buffer,
+    // which either succeeds or reports the error by the appropriate object.
+    const Position max_length =
+        UnsignedMin(length,
+                    Position{std::numeric_limits<off_t>::max()} - limit_pos(),
+                    Position{std::numeric_limits<off_t>::max()} - dest.pos());
+    if (max_length == 0) break;
+    const ssize_t length_copied = internal::KernelCopy(
+        src, has_independent_pos_ ? &src_offset : nullptr, dest_fd,
+        dest_offset == absl::nullopt ? nullptr : &*dest_offset,
+        IntCast<size_t>(UnsignedMin(
+            max_length, size_t{std::numeric_limits<ssize_t>::max()})),
+        method);
+    if (length_copied <= 0) break;
+    internal::CountSyscall(IoStats::Syscall::kCopy,
+                           IntCast<size_t>(length_copied));
+    move_limit_pos(IntCast<size_t>(length_copied));
+    dest.EndKernelCopy(IntCast<size_t>(length_copied));
+    length -= IntCast<size_t>(length_copied);
+  }
+  return true;
+}
+
+bool FdReaderBase::StartIoUring() {
+  RIEGELI_ASSERT(io_uring_ == nullptr)
+      << "Failed precondition of FdReaderBase::StartIoUring(): "
+         "io_uring already started";
+  if (supports_random_access()) {
+    std::unique_ptr<internal::FdIoUring> io_uring =
+        std::make_unique<internal::FdIoUring>();
+    if (io_uring->Initialize(src_fd(), io_uring_depth_, buffer_size())) {
+      io_uring_free_buffers_.clear();
+      for (size_t index = io_uring->num_buffers(); index > 0; --index) {
+        io_uring_free_buffers_.push_back(index - 1);
+      }
+      io_uring_ = std::move(io_uring);
+      return true;
+    }
+  }
+  // io_uring is not applicable, fall back to `read()` or `pread()`.
+  io_uring_depth_ = 0;
+  return false;
+}
+
+inline bool FdReaderBase::ReadWithIoUring(size_t min_length, size_t max_length,
+                                          char* dest) {
+  if (!io_uring_reads_.empty() &&
+      io_uring_reads_.front().pos + io_uring_reads_.front().consumed !=
+          limit_pos()) {
+    // The position was changed by seeking, data read ahead are not useful.
+    if (ABSL_PREDICT_FALSE(!DiscardIoUringReads())) return false;
+  }
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!ReadAheadWithIoUring())) return false;
+    IoUringRead& read = io_uring_reads_.front();
+    while (!read.done) {
+      if (ABSL_PREDICT_FALSE(!WaitForIoUringRead())) return false;
+    }
+    if (ABSL_PREDICT_FALSE(read.result < 0)) {
+      if (read.result == -EINTR || read.result == -EAGAIN) {
+        read.done = false;
+        io_uring_->PrepareRead(read.index, 0, read.length, read.pos);
+        continue;
+      }
+      const int error_number = IntCast<int>(-read.result);
+      DiscardIoUringReads();
+      errno = error_number;
+      return FailOperation("io_uring read");
+    }
+    const size_t length_read = IntCast<size_t>(read.result);
+    RIEGELI_ASSERT_LE(length_read, read.length)
+        << "io_uring read more than requested";
+    if (ABSL_PREDICT_FALSE(length_read == 0)) {
+      // The file ends. Do not keep reads beyond the end, the file can grow.
+      DiscardIoUringReads();
+      return false;
+    }
+    const size_t length = UnsignedMin(length_read - read.consumed, max_length);
+    std::memcpy(dest, io_uring_->buffer(read.index) + read.consumed, length);
+    read.consumed += length;
+    move_limit_pos(length);
+    if (read.consumed == length_read) {
+      if (length_read < read.length) {
+        // A short read. Following reads do not continue at the right position.
+        if (ABSL_PREDICT_FALSE(!DiscardIoUringReads())) return false;
+      } else {
+        io_uring_free_buffers_.push_back(read.index);
+        io_uring_reads_.pop_front();
+      }
+    }
+    if (length >= min_length) return true;
+    dest += length;
+    min_length -= length;
+    max_length -= length;
+  }
+}
+
+inline bool FdReaderBase::ReadAheadWithIoUring() {
+  Position pos = io_uring_reads_.empty() ? limit_pos()
+                                         : io_uring_reads_.back().pos +
+                                               io_uring_reads_.back().length;
+  while (!io_uring_free_buffers_.empty()) {
+    const size_t length =
+        UnsignedMin(io_uring_->buffer_size(),
+                    Position{std::numeric_limits<off_t>::max()} - pos);
+    if (length == 0) break;
+    const size_t index = io_uring_free_buffers_.back();
+    io_uring_free_buffers_.pop_back();
+    io_uring_->PrepareRead(index, 0, length, pos);
+    io_uring_reads_.push_back(IoUringRead{index, pos, length});
+    pos += length;
+  }
+  if (ABSL_PREDICT_FALSE(!io_uring_->Submit())) {
+    return FailOperation("io_uring_enter()");
+  }
+  return true;
+}
+
+inline bool FdReaderBase::WaitForIoUringRead() {
+  size_t index;
+  ssize_t result;
+  if (ABSL_PREDICT_FALSE(!io_uring_->WaitForCompletion(index, result))) {
+    return FailOperation("io_uring_enter()");
+  }
+  for (IoUringRead& read : io_uring_reads_) {
+    if (read.index == index) {
+      RIEGELI_ASSERT(!read.done) << "io_uring read completed twice";
+      read.done = true;
+      read.result = result;
+      break;
+    }
+  }
+  return true;
+}
+
+bool FdReaderBase::DiscardIoUringReads() {
+  while (io_uring_->num_in_flight() > 0) {
+    if (ABSL_PREDICT_FALSE(!WaitForIoUringRead())) return false;
+  }
+  for (const IoUringRead& read : io_uring_reads_) {
+    io_uring_free_buffers_.push_back(read.index);
+  }
+  io_uring_reads_.clear();
+  return true;
+}
+
+bool FdReaderBase::StartDirectIo() {
+  RIEGELI_ASSERT(direct_io_buffer_.data() == nullptr)
+      << "Failed precondition of FdReaderBase::StartDirectIo(): "
+         "direct I/O already started";
+  if (supports_random_access()) {
+    const int src = src_fd();
+    const int had_direct_io = internal::SetDirectIo(src, true);
+    if (had_direct_io >= 0) {
+      fd_had_direct_io_ = had_direct_io > 0;
+      direct_io_buffer_ = internal::DirectIoBuffer(buffer_size());
+      direct_io_buffer_pos_ = 0;
+      direct_io_buffered_ = 0;
+      return true;
+    }
+  }
+  // Direct I/O is not applicable, fall back to reading through the page cache.
+  direct_io_ = false;
+  return false;
+}
+
+inline bool FdReaderBase::ReadWithDirectIo(size_t min_length,
+                                           size_t max_length, char* dest) {
+  for (;;) {
+    if (limit_pos() < direct_io_buffer_pos_ ||
+        limit_pos() - direct_io_buffer_pos_ >= direct_io_buffered_) {
+      // Read the aligned block containing `limit_pos()` and blocks following
+      // it.
+      direct_io_buffer_pos_ =
+          RoundDown<internal::kDirectIoAlignment>(limit_pos());
+      direct_io_buffered_ = 0;
+      const int src = src_fd();
+    again:
+      const ssize_t length_read =
+          pread(src, direct_io_buffer_.data(), direct_io_buffer_.capacity(),
+                IntCast<off_t>(direct_io_buffer_pos_));
+      if (ABSL_PREDICT_FALSE(length_read < 0)) {
+        if (errno == EINTR) goto again;
+        return FailOperation("pread()");
+      }
+      internal::CountSyscall(IoStats::Syscall::kRead,
+                             IntCast<size_t>(length_read));
+      RIEGELI_ASSERT_LE(IntCast<size_t>(length_read),
+                        direct_io_buffer_.capacity())
+          << "pread() read more than requested";
+      direct_io_buffered_ = IntCast<size_t>(length_read);
+      if (ABSL_PREDICT_FALSE(limit_pos() - direct_io_buffer_pos_ >=
+                             direct_io_buffered_)) {
+        // The file ends.
+        return false;
+      }
+    }
+    const size_t offset = IntCast<size_t>(limit_pos() - direct_io_buffer_pos_);
+    const size_t length =
+        UnsignedMin(direct_io_buffered_ - offset, max_length);
+    std::memcpy(dest, direct_io_buffer_.data() + offset, length);
+    move_limit_pos(length);
+    if (length >= min_length) return true;
+    dest += length;
+    min_length -= length;
+    max_length -= length;
+  }
+}
+
+bool FdReaderBase::StopReadingAhead() {
+  if (io_uring_ != nullptr) {
+    if (ABSL_PREDICT_FALSE(!DiscardIoUringReads())) return false;
+  } else if (direct_io_buffer_.data() != nullptr) {
+    direct_io_buffered_ = 0;
+  } else {
+    return true;
+  }
+  if (!has_independent_pos_ && ABSL_PREDICT_TRUE(healthy())) {
+    // Reading with io_uring or direct I/O did not move the fd position.
+    const int src = src_fd();
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(limit_pos()), SEEK_SET) <
+                           0)) {
+      return FailOperation("lseek()");
+    }
+  }
+  return true;
+}
+
+inline void FdReaderBase::Advise(Position pos, Position length, int advice) {
+  // Advice is only a hint, so failures are ignored.
+  posix_fadvise(src_fd(), IntCast<off_t>(pos), IntCast<off_t>(length), advice);
+}
+
+void FdReaderBase::SetAccessPatternImpl(AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  if (access_pattern == access_pattern_) return;
+  if (ABSL_PREDICT_FALSE(!supports_random_access())) return;
+  switch (access_pattern) {
+    case AccessPattern::kNormal:
+      Advise(0, 0, POSIX_FADV_NORMAL);
+      break;
+    case AccessPattern::kSequential:
+      Advise(0, 0, POSIX_FADV_SEQUENTIAL);
+      break;
+    case AccessPattern::kRandom:
+      Advise(0, 0, POSIX_FADV_RANDOM);
+      random_read_start_ = limit_pos();
+      break;
+  }
+  access_pattern_ = access_pattern;
+}
+
+void FdReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  if (ABSL_PREDICT_FALSE(!supports_random_access())) return;
+  // Data in the buffer are already read from the fd.
+  const Position begin = UnsignedMax(limit_pos(), will_need_end_);
+  const Position end =
+      pos() + UnsignedMin(length, IntCast<Position>(
+                                      std::numeric_limits<off_t>::max()) -
+                                      pos());
+  if (begin >= end) return;
+  Advise(begin, end - begin, POSIX_FADV_WILLNEED);
+  will_need_end_ = end;
+}
+
+bool FdReaderBase::SyncImpl(SyncType sync_type) {
+  if (ABSL_PREDICT_FALSE(!StopReadingAhead())) return false;
+  return BufferedReader::SyncImpl(sync_type);
+}
+
 inline bool FdReaderBase::SeekInternal(int src, Position new_pos) {
   RIEGELI_ASSERT_EQ(available(), 0u)
       << "Failed precondition of FdReaderBase::SeekInternal(): "
@@ -257,6 +626,7 @@ inline bool FdReaderBase::SeekInternal(int src, Position new_pos) {
       << "Failed precondition of FdReaderBase::SeekInternal(): "
          "random access not supported";
   if (!has_independent_pos_) {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(new_pos), SEEK_SET) < 0)) {
       return FailOperation("lseek()");
     }
@@ -277,9 +647,19 @@ bool FdReaderBase::SeekBehindBuffer(Position new_pos) {
   }
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   const int src = src_fd();
+  if (access_pattern_ == AccessPattern::kRandom) {
+    // Data read since the last seek are unlikely to be read again soon.
+    if (limit_pos() > random_read_start_) {
+      Advise(random_read_start_, limit_pos() - random_read_start_,
+             POSIX_FADV_DONTNEED);
+    }
+    random_read_start_ = new_pos;
+  }
+  will_need_end_ = 0;
   if (new_pos > limit_pos()) {
     // Seeking forwards.
     struct stat stat_info;
+    internal::CountSyscall(IoStats::Syscall::kStat);
     if (ABSL_PREDICT_FALSE(fstat(src, &stat_info) < 0)) {
       return FailOperation("fstat()");
     }
@@ -301,6 +681,7 @@ absl::optional<Position> FdReaderBase::SizeImpl() {
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
   const int src = src_fd();
   struct stat stat_info;
+  internal::CountSyscall(IoStats::Syscall::kStat);
   if (ABSL_PREDICT_FALSE(fstat(src, &stat_info) < 0)) {
     FailOperation("fstat()");
     return absl::nullopt;
@@ -320,16 +701,17 @@ std::unique_ptr<Reader> FdReaderBase::NewReaderImpl(Position initial_pos) {
       src, FdReaderBase::Options()
                .set_assumed_filename(filename())
                .set_independent_pos(initial_pos)
-               .set_buffer_size(buffer_size()));
+               .set_buffer_size(buffer_size())
+               .set_io_uring_depth(io_uring_depth_)
+               .set_direct_io(direct_io_));
 }
 
-void FdMMapReaderBase::Initialize(
-    int src, absl::optional<std::string>&& assumed_filename,
-    absl::optional<Position> independent_pos) {
+void FdMMapReaderBase::Initialize(int src, Options&& options) {
   RIEGELI_ASSERT_GE(src, 0)
       << "Failed precondition of FdMMapReader: negative file descriptor";
-  filename_ = internal::ResolveFilename(src, std::move(assumed_filename));
-  InitializePos(src, independent_pos);
+  filename_ =
+      internal::ResolveFilename(src, std::move(options.assumed_filename()));
+  InitializePos(src, options);
 }
 
 int FdMMapReaderBase::OpenFd(absl::string_view filename, int flags) {
@@ -350,43 +732,68 @@ again:
   return src;
 }
 
-void FdMMapReaderBase::InitializePos(int src,
-                                     absl::optional<Position> independent_pos) {
+void FdMMapReaderBase::InitializePos(int src, const Options& options) {
   struct stat stat_info;
+  internal::CountSyscall(IoStats::Syscall::kStat);
   if (ABSL_PREDICT_FALSE(fstat(src, &stat_info) < 0)) {
     FailOperation("fstat()");
     return;
   }
-  if (ABSL_PREDICT_FALSE(IntCast<Position>(stat_info.st_size) >
-                         std::numeric_limits<size_t>::max())) {
+  base_pos_ = options.window_begin();
+  const Position file_size = IntCast<Position>(stat_info.st_size);
+  Position length = file_size - UnsignedMin(base_pos_, file_size);
+  if (options.window_length() != absl::nullopt) {
+    length = UnsignedMin(length, *options.window_length());
+  }
+  if (ABSL_PREDICT_FALSE(length > std::numeric_limits<size_t>::max())) {
     Fail(absl::OutOfRangeError(absl::StrCat("mmap() cannot be used reading ",
                                             filename_, ": File too large")));
     return;
   }
-  if (stat_info.st_size == 0) return;
-  void* const data = mmap(nullptr, IntCast<size_t>(stat_info.st_size),
-                          PROT_READ, MAP_SHARED, src, 0);
-  if (ABSL_PREDICT_FALSE(data == MAP_FAILED)) {
+  if (length == 0) return;
+  // The offset of the mapping must be aligned to the page size.
+  const size_t page_offset = IntCast<size_t>(base_pos_ % PageSize());
+  const size_t mapping_size = page_offset + IntCast<size_t>(length);
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (options.populate()) flags |= MAP_POPULATE;
+#endif
+  void* const mapping =
+      mmap(nullptr, mapping_size, PROT_READ, flags, src,
+           IntCast<off_t>(base_pos_ - page_offset));
+  if (ABSL_PREDICT_FALSE(mapping == MAP_FAILED)) {
     FailOperation("mmap()");
     return;
   }
+#ifdef MADV_HUGEPAGE
+  // Advice is only a hint, so failures are ignored.
+  if (options.huge_pages()) madvise(mapping, mapping_size, MADV_HUGEPAGE);
+#endif
+  if (options.will_need()) madvise(mapping, mapping_size, MADV_WILLNEED);
   // `FdMMapReaderBase` derives from `ChainReader<Chain>` but the `Chain` to
   // read from was not known in `FdMMapReaderBase` constructor. This sets the
   // `Chain` and updates the `ChainReader` to read from it.
   ChainReader::Reset(std::forward_as_tuple(ChainBlock::FromExternal<MMapRef>(
-      std::forward_as_tuple(),
-      absl::string_view(static_cast<const char*>(data),
-                        IntCast<size_t>(stat_info.st_size)))));
-  if (independent_pos != absl::nullopt) {
-    move_cursor(UnsignedMin(*independent_pos, available()));
+      std::forward_as_tuple(page_offset),
+      absl::string_view(static_cast<const char*>(mapping) + page_offset,
+                        IntCast<size_t>(length)))));
+  if (options.access_pattern() != AccessPattern::kNormal) {
+    SetAccessPattern(options.access_pattern());
+  }
+  Position initial_pos;
+  if (options.independent_pos() != absl::nullopt) {
+    initial_pos = *options.independent_pos();
   } else {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     const off_t file_pos = lseek(src, 0, SEEK_CUR);
     if (ABSL_PREDICT_FALSE(file_pos < 0)) {
       FailOperation("lseek()");
       return;
     }
-    move_cursor(UnsignedMin(IntCast<Position>(file_pos), available()));
+    initial_pos = IntCast<Position>(file_pos);
   }
+  move_cursor(UnsignedMin(initial_pos - UnsignedMin(initial_pos, base_pos_),
+                          available()));
 }
 
 void FdMMapReaderBase::InitializeWithExistingData(int src,
@@ -420,11 +827,39 @@ absl::Status FdMMapReaderBase::AnnotateStatusImpl(absl::Status status) {
   return ChainReader::AnnotateStatusImpl(std::move(status));
 }
 
+void FdMMapReaderBase::SetAccessPatternImpl(AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  // The whole mapping is the only block of the source, so it is the buffer.
+  if (start() == nullptr) return;
+  int advice = MADV_NORMAL;
+  switch (access_pattern) {
+    case AccessPattern::kNormal:
+      break;
+    case AccessPattern::kSequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case AccessPattern::kRandom:
+      advice = MADV_RANDOM;
+      break;
+  }
+  AdviseMapping(start(), start_to_limit(), advice);
+}
+
+void FdMMapReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  if (available() == 0) return;
+  AdviseMapping(cursor(),
+                IntCast<size_t>(UnsignedMin(length, Position{available()})),
+                MADV_WILLNEED);
+}
+
 bool FdMMapReaderBase::SyncImpl(SyncType sync_type) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   const int src = src_fd();
   if (!has_independent_pos_) {
-    if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(pos()), SEEK_SET) < 0)) {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(base_pos_ + pos()),
+                               SEEK_SET) < 0)) {
       return FailOperation("lseek()");
     }
   }
@@ -441,4 +876,235 @@ std::unique_ptr<Reader> FdMMapReaderBase::NewReaderImpl(Position initial_pos) {
   return reader;
 }
 
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t FdMMapWindowReaderBase::kWindowAlignment;
+constexpr size_t FdMMapWindowReaderBase::Options::kDefaultWindowSize;
+#endif
+
+void FdMMapWindowReaderBase::Initialize(
+    int src, absl::optional<std::string>&& assumed_filename,
+    absl::optional<Position> independent_pos) {
+  RIEGELI_ASSERT_GE(src, 0)
+      << "Failed precondition of FdMMapWindowReader: negative file descriptor";
+  filename_ = internal::ResolveFilename(src, std::move(assumed_filename));
+  InitializePos(src, independent_pos);
+}
+
+int FdMMapWindowReaderBase::OpenFd(absl::string_view filename, int flags) {
+  RIEGELI_ASSERT((flags & O_ACCMODE) == O_RDONLY ||
+                 (flags & O_ACCMODE) == O_RDWR)
+      << "Failed precondition of FdMMapWindowReader: "
+         "flags must include either O_RDONLY or O_RDWR";
+  // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+  // `filename_ = filename`
+  filename_.assign(filename.data(), filename.size());
+again:
+  const int src = open(filename_.c_str(), flags, 0666);
+  if (ABSL_PREDICT_FALSE(src < 0)) {
+    if (errno == EINTR) goto again;
+    FailOperation("open()");
+    return -1;
+  }
+  return src;
+}
+
+void FdMMapWindowReaderBase::InitializePos(
+    int src, absl::optional<Position> independent_pos) {
+  struct stat stat_info;
+  internal::CountSyscall(IoStats::Syscall::kStat);
+  if (ABSL_PREDICT_FALSE(fstat(src, &stat_info) < 0)) {
+    FailOperation("fstat()");
+    return;
+  }
+  size_ = IntCast<Position>(stat_info.st_size);
+  if (independent_pos != absl::nullopt) {
+    set_limit_pos(UnsignedMin(*independent_pos, size_));
+  } else {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    const off_t file_pos = lseek(src, 0, SEEK_CUR);
+    if (ABSL_PREDICT_FALSE(file_pos < 0)) {
+      FailOperation("lseek()");
+      return;
+    }
+    set_limit_pos(UnsignedMin(IntCast<Position>(file_pos), size_));
+  }
+}
+
+void FdMMapWindowReaderBase::Done() {
+  FdMMapWindowReaderBase::SyncImpl(SyncType::kFromObject);
+  Reader::Done();
+  window_ = ChainBlock();
+}
+
+bool FdMMapWindowReaderBase::FailOperation(absl::string_view operation) {
+  const int error_number = errno;
+  RIEGELI_ASSERT_NE(error_number, 0)
+      << "Failed precondition of FdMMapWindowReaderBase::FailOperation(): "
+         "zero errno";
+  return Fail(
+      ErrnoToCanonicalStatus(error_number, absl::StrCat(operation, " failed")));
+}
+
+absl::Status FdMMapWindowReaderBase::AnnotateStatusImpl(absl::Status status) {
+  status = Annotate(status, absl::StrCat("reading ", filename_));
+  return Reader::AnnotateStatusImpl(std::move(status));
+}
+
+inline bool FdMMapWindowReaderBase::MapWindow(Position new_pos,
+                                              size_t length) {
+  RIEGELI_ASSERT_LT(new_pos, size_)
+      << "Failed precondition of FdMMapWindowReaderBase::MapWindow(): "
+         "position at or after the end of file";
+  const Position window_begin = RoundDown<kWindowAlignment>(new_pos);
+  const Position window_end = UnsignedMin(
+      UnsignedMax(SaturatingAdd(window_begin, Position{window_size_}),
+                  SaturatingAdd(new_pos, Position{length})),
+      size_);
+  if (ABSL_PREDICT_FALSE(window_end - window_begin >
+                         std::numeric_limits<size_t>::max())) {
+    return Fail(absl::OutOfRangeError(
+        absl::StrCat("mmap() cannot be used reading ", filename_,
+                     ": Window too large")));
+  }
+  const size_t window_size = IntCast<size_t>(window_end - window_begin);
+  // Release the previous window before mapping the next one, so that unless
+  // data read from it are still referenced, at most one window is mapped.
+  window_ = ChainBlock();
+  set_buffer();
+  void* const mapping = mmap(nullptr, window_size, PROT_READ, MAP_SHARED,
+                             src_fd(), IntCast<off_t>(window_begin));
+  if (ABSL_PREDICT_FALSE(mapping == MAP_FAILED)) {
+    set_limit_pos(new_pos);
+    return FailOperation("mmap()");
+  }
+  window_ = ChainBlock::FromExternal<MMapRef>(
+      std::forward_as_tuple(0),
+      absl::string_view(static_cast<const char*>(mapping), window_size));
+  if (access_pattern_ != AccessPattern::kNormal) {
+    FdMMapWindowReaderBase::SetAccessPatternImpl(access_pattern_);
+  }
+  set_buffer(window_.data(), window_.size(),
+             IntCast<size_t>(new_pos - window_begin));
+  set_limit_pos(window_end);
+  return true;
+}
+
+bool FdMMapWindowReaderBase::PullSlow(size_t min_length,
+                                      size_t recommended_length) {
+  RIEGELI_ASSERT_LT(available(), min_length)
+      << "Failed precondition of Reader::PullSlow(): "
+         "enough data available, use Pull() instead";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const Position new_pos = pos();
+  if (ABSL_PREDICT_FALSE(new_pos >= size_)) return false;
+  if (ABSL_PREDICT_FALSE(!MapWindow(new_pos, min_length))) return false;
+  return available() >= min_length;
+}
+
+template <typename Dest>
+inline bool FdMMapWindowReaderBase::ReadShared(size_t length, Dest& dest) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), length)
+      << "Failed precondition of Reader::ReadSlow(): "
+         "enough data available, use Read() instead";
+  RIEGELI_ASSERT_LE(length, std::numeric_limits<size_t>::max() - dest.size())
+      << "Failed precondition of Reader::ReadSlow(): size overflow";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  for (;;) {
+    const size_t length_to_read = UnsignedMin(length, available());
+    if (length_to_read > 0) {
+      window_.AppendSubstrTo(absl::string_view(cursor(), length_to_read),
+                             dest);
+      move_cursor(length_to_read);
+      length -= length_to_read;
+      if (length == 0) return true;
+    }
+    if (ABSL_PREDICT_FALSE(!PullSlow(1, length))) return false;
+  }
+}
+
+bool FdMMapWindowReaderBase::ReadSlow(size_t length, Chain& dest) {
+  return ReadShared(length, dest);
+}
+
+bool FdMMapWindowReaderBase::ReadSlow(size_t length, absl::Cord& dest) {
+  return ReadShared(length, dest);
+}
+
+void FdMMapWindowReaderBase::SetAccessPatternImpl(
+    AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  access_pattern_ = access_pattern;
+  if (window_.empty()) return;
+  int advice = MADV_NORMAL;
+  switch (access_pattern) {
+    case AccessPattern::kNormal:
+      break;
+    case AccessPattern::kSequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case AccessPattern::kRandom:
+      advice = MADV_RANDOM;
+      break;
+  }
+  AdviseMapping(window_.data(), window_.size(), advice);
+}
+
+void FdMMapWindowReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  const Position begin = pos();
+  if (begin >= size_) return;
+  // Advice is only a hint, so failures are ignored.
+  posix_fadvise(src_fd(), IntCast<off_t>(begin),
+                IntCast<off_t>(UnsignedMin(length, size_ - begin)),
+                POSIX_FADV_WILLNEED);
+}
+
+bool FdMMapWindowReaderBase::SyncImpl(SyncType sync_type) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const int src = src_fd();
+  if (!has_independent_pos_) {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    if (ABSL_PREDICT_FALSE(lseek(src, IntCast<off_t>(pos()), SEEK_SET) < 0)) {
+      return FailOperation("lseek()");
+    }
+  }
+  return true;
+}
+
+bool FdMMapWindowReaderBase::SeekSlow(Position new_pos) {
+  RIEGELI_ASSERT(new_pos < start_pos() || new_pos > limit_pos())
+      << "Failed precondition of Reader::SeekSlow(): "
+         "position in the buffer, use Seek() instead";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  // The window containing `new_pos` is mapped by the next `PullSlow()`.
+  window_ = ChainBlock();
+  set_buffer();
+  if (ABSL_PREDICT_FALSE(new_pos > size_)) {
+    // File ends.
+    set_limit_pos(size_);
+    return false;
+  }
+  set_limit_pos(new_pos);
+  return true;
+}
+
+absl::optional<Position> FdMMapWindowReaderBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  return size_;
+}
+
+std::unique_ptr<Reader> FdMMapWindowReaderBase::NewReaderImpl(
+    Position initial_pos) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  const int src = src_fd();
+  return std::make_unique<FdMMapWindowReader<UnownedFd>>(
+      src, FdMMapWindowReaderBase::Options()
+               .set_assumed_filename(filename())
+               .set_independent_pos(initial_pos)
+               .set_window_size(window_size_));
+}
+
 }  // namespace riegeli
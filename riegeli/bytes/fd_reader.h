@@ -17,15 +17,19 @@
 
 #include <fcntl.h>
 #include <stddef.h>
+#include <sys/types.h>
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
@@ -34,7 +38,10 @@
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/fd_copy.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_direct_io.h"
+#include "riegeli/bytes/fd_io_uring.h"
 #include "riegeli/bytes/reader.h"
 
 namespace riegeli {
@@ -137,11 +144,57 @@ class FdReaderBase : public BufferedReader {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // If positive, `FdReader` keeps up to this many reads of `buffer_size()`
+    // bytes in flight ahead of the current position, using Linux io_uring with
+    // buffers registered with the kernel. This reduces the number of system
+    // calls and raises the device queue depth for sequential reading, at the
+    // cost of copying data from io_uring buffers.
+    //
+    // io_uring is used only if random access is supported and io_uring is
+    // available, otherwise `FdReader` silently falls back to `read()` or
+    // `pread()`.
+    //
+    // Default: 0 (io_uring is not used).
+    Options& set_io_uring_depth(size_t io_uring_depth) & {
+      io_uring_depth_ = io_uring_depth;
+      return *this;
+    }
+    Options&& set_io_uring_depth(size_t io_uring_depth) && {
+      return std::move(set_io_uring_depth(io_uring_depth));
+    }
+    size_t io_uring_depth() const { return io_uring_depth_; }
+
+    // If `true`, `O_DIRECT` is set for the fd, so that reading bypasses the
+    // page cache. This avoids evicting useful data from the page cache and
+    // copying data through it when a file is read once.
+    //
+    // Reads have file positions and lengths aligned to 4096 bytes, use a
+    // buffer of `buffer_size()` rounded up to a multiple of 4096 bytes, and
+    // data are copied from that buffer.
+    //
+    // Direct I/O is used only if random access is supported and the file
+    // system supports `O_DIRECT`, otherwise `FdReader` silently reads through
+    // the page cache. If direct I/O is used, `io_uring_depth()` is ignored.
+    //
+    // `O_DIRECT` is cleared by `Close()` unless it was already set.
+    //
+    // Default: `false`.
+    Options& set_direct_io(bool direct_io) & {
+      direct_io_ = direct_io;
+      return *this;
+    }
+    Options&& set_direct_io(bool direct_io) && {
+      return std::move(set_direct_io(direct_io));
+    }
+    bool direct_io() const { return direct_io_; }
+
    private:
     absl::optional<std::string> assumed_filename_;
     absl::optional<Position> assumed_pos_;
     absl::optional<Position> independent_pos_;
     size_t buffer_size_ = kDefaultBufferSize;
+    size_t io_uring_depth_ = 0;
+    bool direct_io_ = false;
   };
 
   // Returns the fd being read from. If the fd is owned then changed to -1 by
@@ -158,13 +211,14 @@ class FdReaderBase : public BufferedReader {
  protected:
   explicit FdReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
-  explicit FdReaderBase(size_t buffer_size);
+  explicit FdReaderBase(size_t buffer_size, size_t io_uring_depth,
+                        bool direct_io);
 
   FdReaderBase(FdReaderBase&& that) noexcept;
   FdReaderBase& operator=(FdReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(size_t buffer_size);
+  void Reset(size_t buffer_size, size_t io_uring_depth, bool direct_io);
   void Initialize(int src, absl::optional<std::string>&& assumed_filename,
                   absl::optional<Position> assumed_pos,
                   absl::optional<Position> independent_pos);
@@ -177,6 +231,11 @@ class FdReaderBase : public BufferedReader {
   void Done() override;
   absl::Status AnnotateStatusImpl(absl::Status status) override;
   bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
+  using BufferedReader::CopySlow;
+  bool CopySlow(Position length, Writer& dest) override;
+  void SetAccessPatternImpl(AccessPattern access_pattern) override;
+  void WillNeedImpl(Position length) override;
+  bool SyncImpl(SyncType sync_type) override;
   bool SeekBehindBuffer(Position new_pos) override;
   absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
@@ -185,7 +244,29 @@ class FdReaderBase : public BufferedReader {
   // Encodes a `bool` or a marker that the value is not fully resolved yet.
   enum class LazyBoolState { kFalse, kTrue, kUnknown };
 
+  // A read submitted to `io_uring_`.
+  struct IoUringRead {
+    size_t index;
+    Position pos;
+    size_t length;
+    bool done = false;
+    // The number of bytes read, or `-errno`. Valid if `done`.
+    ssize_t result = 0;
+    // The number of bytes already returned from the buffer. Valid if `done`.
+    size_t consumed = 0;
+  };
+
   bool SeekInternal(int src, Position new_pos);
+  bool StartIoUring();
+  bool ReadWithIoUring(size_t min_length, size_t max_length, char* dest);
+  bool ReadAheadWithIoUring();
+  bool WaitForIoUringRead();
+  bool DiscardIoUringReads();
+  bool StartDirectIo();
+  bool ReadWithDirectIo(size_t min_length, size_t max_length, char* dest);
+  bool StopReadingAhead();
+  bool CopyInKernel(Position& length, internal::FdCopyWriterBase& dest);
+  void Advise(Position pos, Position length, int advice);
 
   std::string filename_;
   // Invariant:
@@ -193,6 +274,40 @@ class FdReaderBase : public BufferedReader {
   LazyBoolState supports_random_access_ = LazyBoolState::kFalse;
   bool has_independent_pos_ = false;
 
+  // If 0, `io_uring_` is not used and will not be created.
+  size_t io_uring_depth_ = 0;
+  // If not `nullptr`, reading uses `io_uring_` instead of `read()` or
+  // `pread()`. Then if `!has_independent_pos_`, the fd position is
+  // synchronized only by `Close()` and `Sync()`.
+  std::unique_ptr<internal::FdIoUring> io_uring_;
+  // Reads in flight or not consumed yet, at consecutive positions.
+  std::deque<IoUringRead> io_uring_reads_;
+  // Indices of `io_uring_` buffers not used by `io_uring_reads_`.
+  std::vector<size_t> io_uring_free_buffers_;
+
+  // If `false`, direct I/O is not used and will not be started.
+  bool direct_io_ = false;
+  // If `true`, `O_DIRECT` was set for the fd before direct I/O was started.
+  bool fd_had_direct_io_ = false;
+  // If not deallocated, reading uses `pread()` with `O_DIRECT` into
+  // `direct_io_buffer_` instead of `read()` or `pread()` into the destination.
+  // Then if `!has_independent_pos_`, the fd position is synchronized only by
+  // `Close()` and `Sync()`.
+  internal::DirectIoBuffer direct_io_buffer_;
+  // Data read into `direct_io_buffer_` start at this position.
+  Position direct_io_buffer_pos_ = 0;
+  // The amount of data read into `direct_io_buffer_`.
+  size_t direct_io_buffered_ = 0;
+
+  // The access pattern advised for the fd with `posix_fadvise()`.
+  AccessPattern access_pattern_ = AccessPattern::kNormal;
+  // If `access_pattern_ == AccessPattern::kRandom`, reading since the last seek
+  // started at this position. Data read since then are advised as no longer
+  // needed when seeking again.
+  Position random_read_start_ = 0;
+  // Data up to this position were already advised as needed soon.
+  Position will_need_end_ = 0;
+
   // Invariant: `limit_pos() <= std::numeric_limits<off_t>::max()`
 };
 
@@ -257,9 +372,111 @@ class FdMMapReaderBase : public ChainReader<Chain> {
       return independent_pos_;
     }
 
+    // The position in the file where the mapped window begins. Only the window
+    // is mapped, and `FdMMapReader` reads it as if it was the whole source:
+    // positions of `FdMMapReader` are relative to `window_begin()`.
+    //
+    // The initial position, i.e. `independent_pos()` or the current fd
+    // position, is still a position in the file. If it is before the window,
+    // reading starts at the beginning of the window.
+    //
+    // Default: 0.
+    Options& set_window_begin(Position window_begin) & {
+      window_begin_ = window_begin;
+      return *this;
+    }
+    Options&& set_window_begin(Position window_begin) && {
+      return std::move(set_window_begin(window_begin));
+    }
+    Position window_begin() const { return window_begin_; }
+
+    // If not `absl::nullopt`, the maximum length of the mapped window. The
+    // window ends earlier if the file ends earlier.
+    //
+    // If `absl::nullopt`, the window extends until the end of the file.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_window_length(absl::optional<Position> window_length) & {
+      window_length_ = window_length;
+      return *this;
+    }
+    Options&& set_window_length(absl::optional<Position> window_length) && {
+      return std::move(set_window_length(window_length));
+    }
+    absl::optional<Position> window_length() const { return window_length_; }
+
+    // If `true`, the whole window is read into memory when the file is mapped
+    // (`MAP_POPULATE`), instead of page by page when it is first accessed. This
+    // moves the cost of page faults to opening, making the latency of later
+    // accesses predictable.
+    //
+    // This is effective on Linux.
+    //
+    // Default: `false`.
+    Options& set_populate(bool populate) & {
+      populate_ = populate;
+      return *this;
+    }
+    Options&& set_populate(bool populate) && {
+      return std::move(set_populate(populate));
+    }
+    bool populate() const { return populate_; }
+
+    // If `true`, the kernel is advised to back the mapping with huge pages
+    // (`MADV_HUGEPAGE`), which reduces TLB misses when a large file is
+    // accessed randomly.
+    //
+    // This is effective on Linux if transparent huge pages are supported for
+    // the file system.
+    //
+    // Default: `false`.
+    Options& set_huge_pages(bool huge_pages) & {
+      huge_pages_ = huge_pages;
+      return *this;
+    }
+    Options&& set_huge_pages(bool huge_pages) && {
+      return std::move(set_huge_pages(huge_pages));
+    }
+    bool huge_pages() const { return huge_pages_; }
+
+    // If `true`, the kernel is advised that the whole window will be needed
+    // soon (`MADV_WILLNEED`), so that it is read in background. Unlike
+    // `set_populate()`, this does not make opening wait for reading.
+    //
+    // Default: `false`.
+    Options& set_will_need(bool will_need) & {
+      will_need_ = will_need;
+      return *this;
+    }
+    Options&& set_will_need(bool will_need) && {
+      return std::move(set_will_need(will_need));
+    }
+    bool will_need() const { return will_need_; }
+
+    // The access pattern advised for the mapping when the file is mapped, as
+    // if by `SetAccessPattern()`. E.g. `AccessPattern::kRandom` (`MADV_RANDOM`)
+    // avoids reading ahead around each page fault, which is wasteful for
+    // `RecordReader::Search()`.
+    //
+    // Default: `AccessPattern::kNormal`.
+    Options& set_access_pattern(AccessPattern access_pattern) & {
+      access_pattern_ = access_pattern;
+      return *this;
+    }
+    Options&& set_access_pattern(AccessPattern access_pattern) && {
+      return std::move(set_access_pattern(access_pattern));
+    }
+    AccessPattern access_pattern() const { return access_pattern_; }
+
    private:
     absl::optional<std::string> assumed_filename_;
     absl::optional<Position> independent_pos_;
+    Position window_begin_ = 0;
+    absl::optional<Position> window_length_;
+    bool populate_ = false;
+    bool huge_pages_ = false;
+    bool will_need_ = false;
+    AccessPattern access_pattern_ = AccessPattern::kNormal;
   };
 
   // Returns the fd being read from. If the fd is owned then changed to -1 by
@@ -283,21 +500,187 @@ class FdMMapReaderBase : public ChainReader<Chain> {
 
   void Reset(Closed);
   void Reset(bool has_independent_pos);
+  void Initialize(int src, Options&& options);
+  int OpenFd(absl::string_view filename, int flags);
+  void InitializePos(int src, const Options& options);
+  void InitializeWithExistingData(int src, absl::string_view filename,
+                                  Position independent_pos, const Chain& data);
+  ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+
+  void Done() override;
+  void SetAccessPatternImpl(AccessPattern access_pattern) override;
+  void WillNeedImpl(Position length) override;
+  bool SyncImpl(SyncType sync_type) override;
+  std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
+
+ private:
+  std::string filename_;
+  bool has_independent_pos_ = false;
+  // The position in the file corresponding to position 0 of the
+  // `FdMMapReader`.
+  Position base_pos_ = 0;
+};
+
+// Template parameter independent part of `FdMMapWindowReader`.
+class FdMMapWindowReaderBase : public Reader {
+ public:
+  // Windows begin at multiples of this alignment. This is a multiple of the
+  // page size, as required by `mmap()`, and matches the Riegeli/records block
+  // size, so that a window of a Riegeli/records file begins at a block
+  // boundary.
+  static constexpr size_t kWindowAlignment = size_t{64} << 10;
+
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `FdMMapWindowReader` reads from an already open fd,
+    // `set_assumed_filename()` allows to override the filename which is
+    // included in failure messages and returned by `filename()`.
+    //
+    // If this is `absl::nullopt`, then "/dev/stdin", "/dev/stdout",
+    // "/dev/stderr", or "/proc/self/fd/<fd>" is assumed.
+    //
+    // If `FdMMapWindowReader` reads from a filename, `set_assumed_filename()`
+    // has no effect.
+    //
+    // Default: `absl::nullopt`
+    Options& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) & {
+      if (assumed_filename == absl::nullopt) {
+        assumed_filename_ = absl::nullopt;
+      } else {
+        // TODO: When `absl::string_view` becomes C++17
+        // `std::string_view`: `assumed_filename_.emplace(*assumed_filename)`
+        assumed_filename_.emplace(assumed_filename->data(),
+                                  assumed_filename->size());
+      }
+      return *this;
+    }
+    Options&& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) && {
+      return std::move(set_assumed_filename(assumed_filename));
+    }
+    absl::optional<std::string>& assumed_filename() {
+      return assumed_filename_;
+    }
+    const absl::optional<std::string>& assumed_filename() const {
+      return assumed_filename_;
+    }
+
+    // If `absl::nullopt`, `FdMMapWindowReader` reads starting from the current
+    // fd position. The `FdMMapWindowReader` position is synchronized back to
+    // the fd by `Close()` and `Sync()`.
+    //
+    // If not `absl::nullopt`, `FdMMapWindowReader` reads starting from this
+    // position, without disturbing the current fd position. This is useful for
+    // multiple readers concurrently reading from the same fd.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_independent_pos(absl::optional<Position> independent_pos) & {
+      independent_pos_ = independent_pos;
+      return *this;
+    }
+    Options&& set_independent_pos(absl::optional<Position> independent_pos) && {
+      return std::move(set_independent_pos(independent_pos));
+    }
+    absl::optional<Position> independent_pos() const {
+      return independent_pos_;
+    }
+
+    // The size of a window mapped at a time, rounded up to a multiple of
+    // `kWindowAlignment`. A window can be larger if a single `Pull()` needs
+    // more data.
+    //
+    // This bounds the address space used by the `FdMMapWindowReader` itself.
+    // Data read to a `Chain` or `absl::Cord` keep their window mapped while
+    // they are referenced.
+    //
+    // Default: `kDefaultWindowSize` (64M).
+    static constexpr size_t kDefaultWindowSize = size_t{64} << 20;
+    Options& set_window_size(size_t window_size) & {
+      RIEGELI_ASSERT_GT(window_size, 0u)
+          << "Failed precondition of "
+             "FdMMapWindowReaderBase::Options::set_window_size(): "
+             "zero window size";
+      window_size_ = window_size;
+      return *this;
+    }
+    Options&& set_window_size(size_t window_size) && {
+      return std::move(set_window_size(window_size));
+    }
+    size_t window_size() const { return window_size_; }
+
+   private:
+    absl::optional<std::string> assumed_filename_;
+    absl::optional<Position> independent_pos_;
+    size_t window_size_ = kDefaultWindowSize;
+  };
+
+  // Returns the fd being read from. If the fd is owned then changed to -1 by
+  // `Close()`, otherwise unchanged.
+  virtual int src_fd() const = 0;
+
+  // Returns the original name of the file being read from. Unchanged by
+  // `Close()`.
+  const std::string& filename() const { return filename_; }
+
+  absl::Status AnnotateStatusImpl(absl::Status status) override;
+  bool SupportsRandomAccess() override { return true; }
+  bool SupportsNewReader() override { return true; }
+
+ protected:
+  explicit FdMMapWindowReaderBase(Closed) noexcept : Reader(kClosed) {}
+
+  explicit FdMMapWindowReaderBase(bool has_independent_pos,
+                                  size_t window_size);
+
+  FdMMapWindowReaderBase(FdMMapWindowReaderBase&& that) noexcept;
+  FdMMapWindowReaderBase& operator=(FdMMapWindowReaderBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(bool has_independent_pos, size_t window_size);
   void Initialize(int src, absl::optional<std::string>&& assumed_filename,
                   absl::optional<Position> independent_pos);
   int OpenFd(absl::string_view filename, int flags);
   void InitializePos(int src, absl::optional<Position> independent_pos);
-  void InitializeWithExistingData(int src, absl::string_view filename,
-                                  Position independent_pos, const Chain& data);
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
 
   void Done() override;
+  bool PullSlow(size_t min_length, size_t recommended_length) override;
+  using Reader::ReadSlow;
+  bool ReadSlow(size_t length, Chain& dest) override;
+  bool ReadSlow(size_t length, absl::Cord& dest) override;
+  void SetAccessPatternImpl(AccessPattern access_pattern) override;
+  void WillNeedImpl(Position length) override;
   bool SyncImpl(SyncType sync_type) override;
+  bool SeekSlow(Position new_pos) override;
+  absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
+  // Maps a window containing `length` bytes at `new_pos`, or less if the file
+  // ends earlier, and points the buffer to it.
+  //
+  // Precondition: `new_pos < size_`
+  bool MapWindow(Position new_pos, size_t length);
+
+  template <typename Dest>
+  bool ReadShared(size_t length, Dest& dest);
+
   std::string filename_;
   bool has_independent_pos_ = false;
+  size_t window_size_ = 0;
+  // The size of the file when it was opened.
+  Position size_ = 0;
+  // The access pattern advised for each window.
+  AccessPattern access_pattern_ = AccessPattern::kNormal;
+  // The current window, or empty if none is mapped.
+  //
+  // Invariants:
+  //   `start() == (window_.empty() ? nullptr : window_.data())`
+  //   `start_to_limit() == window_.size()`
+  ChainBlock window_;
 };
 
 // A `Reader` which reads from a file descriptor.
@@ -311,6 +694,10 @@ class FdMMapReaderBase : public ChainReader<Chain> {
 //                if `Options::independent_pos() == absl::nullopt`
 //  * `fstat()` - for `Seek()` or `Size()`
 //
+// `SetAccessPattern()` and `WillNeed()` are translated to `posix_fadvise()`
+// calls. Since the advice applies to the open file description, it affects
+// also other users of the fd while the `FdReader` is open.
+//
 // `FdReader` supports random access if
 // `Options::assumed_pos() == absl::nullopt` and the fd supports random access
 // (this is assumed if `Options::independent_pos() != absl::nullopt`, otherwise
@@ -429,6 +816,10 @@ explicit FdReader(absl::string_view filename, int flags,
 //  * `mmap()`
 //  * `lseek()` - if `Options::independent_pos() == absl::nullopt`
 //
+// `SetAccessPattern()` and `WillNeed()` are translated to `madvise()` calls.
+// Since the mapping is shared with readers returned by `NewReader()`, the
+// advice affects them too.
+//
 // `FdMMapReader` supports random access and `NewReader()`.
 //
 // The `Src` template parameter specifies the type of the object providing and
@@ -529,10 +920,133 @@ explicit FdMMapReader(
     ->FdMMapReader<>;
 #endif
 
+// A `Reader` which reads from a file descriptor by mapping consecutive windows
+// of the file to memory, one at a time.
+//
+// Unlike `FdMMapReader`, this is suitable for files larger than the available
+// address space. Data within a window are read without a memory copy, like
+// with `FdMMapReader`; reading to a `Chain` or `absl::Cord` keeps referring to
+// the mapping.
+//
+// A window is mapped by `Pull()` or `Read()` when the position reaches its
+// beginning, e.g. after `Seek()`.
+//
+// The fd must support:
+//  * `close()` - if the fd is owned
+//  * `fstat()`
+//  * `mmap()`
+//  * `lseek()` - if `Options::independent_pos() == absl::nullopt`
+//
+// `SetAccessPattern()` is translated to `madvise()` calls for each window,
+// and `WillNeed()` to `posix_fadvise()` calls.
+//
+// `FdMMapWindowReader` supports random access and `NewReader()`.
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the fd being read from. `Src` must support
+// `Dependency<int, Src>`, e.g. `OwnedFd` (owned, default), `UnownedFd`
+// (not owned).
+//
+// By relying on CTAD the template argument can be deduced as `OwnedFd` if the
+// first constructor argument is a filename or an `int`, otherwise as the value
+// type of the first constructor argument. This requires C++17.
+//
+// The fd must not be closed until the `FdMMapWindowReader` is closed or no
+// longer used. `File` contents must not be changed while data read from the
+// file are accessed without a memory copy. The file size is determined when
+// the file is opened.
+template <typename Src = OwnedFd>
+class FdMMapWindowReader : public FdMMapWindowReaderBase {
+ public:
+  // Creates a closed `FdMMapWindowReader`.
+  explicit FdMMapWindowReader(Closed) noexcept
+      : FdMMapWindowReaderBase(kClosed) {}
+
+  // Will read from the fd provided by `src`.
+  explicit FdMMapWindowReader(const Src& src, Options options = Options());
+  explicit FdMMapWindowReader(Src&& src, Options options = Options());
+
+  // Will read from the fd provided by a `Src` constructed from elements of
+  // `src_args`. This avoids constructing a temporary `Src` and moving from it.
+  template <typename... SrcArgs>
+  explicit FdMMapWindowReader(std::tuple<SrcArgs...> src_args,
+                              Options options = Options());
+
+  // Opens a file for reading.
+  //
+  // `flags` is the second argument of `open()`, typically `O_RDONLY`.
+  //
+  // `flags` must include either `O_RDONLY` or `O_RDWR`.
+  //
+  // If opening the file fails, `FdMMapWindowReader` will be failed and closed.
+  explicit FdMMapWindowReader(absl::string_view filename, int flags,
+                              Options options = Options());
+
+  FdMMapWindowReader(FdMMapWindowReader&& that) noexcept;
+  FdMMapWindowReader& operator=(FdMMapWindowReader&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `FdMMapWindowReader`. This
+  // avoids constructing a temporary `FdMMapWindowReader` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+  void Reset(absl::string_view filename, int flags,
+             Options options = Options());
+
+  // Returns the object providing and possibly owning the fd being read from. If
+  // the fd is owned then changed to -1 by `Close()`, otherwise unchanged.
+  Src& src() { return src_.manager(); }
+  const Src& src() const { return src_.manager(); }
+  int src_fd() const override { return src_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  using FdMMapWindowReaderBase::Initialize;
+  void Initialize(absl::string_view filename, int flags, Options&& options);
+
+  // The object providing and possibly owning the fd being read from.
+  Dependency<int, Src> src_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit FdMMapWindowReader(Closed)->FdMMapWindowReader<DeleteCtad<Closed>>;
+template <typename Src>
+explicit FdMMapWindowReader(const Src& src,
+                            FdMMapWindowReaderBase::Options options =
+                                FdMMapWindowReaderBase::Options())
+    -> FdMMapWindowReader<
+        std::conditional_t<std::is_convertible<const Src&, int>::value, OwnedFd,
+                           std::decay_t<Src>>>;
+template <typename Src>
+explicit FdMMapWindowReader(Src&& src,
+                            FdMMapWindowReaderBase::Options options =
+                                FdMMapWindowReaderBase::Options())
+    -> FdMMapWindowReader<
+        std::conditional_t<std::is_convertible<Src&&, int>::value, OwnedFd,
+                           std::decay_t<Src>>>;
+template <typename... SrcArgs>
+explicit FdMMapWindowReader(std::tuple<SrcArgs...> src_args,
+                            FdMMapWindowReaderBase::Options options =
+                                FdMMapWindowReaderBase::Options())
+    -> FdMMapWindowReader<DeleteCtad<std::tuple<SrcArgs...>>>;
+explicit FdMMapWindowReader(absl::string_view filename, int flags,
+                            FdMMapWindowReaderBase::Options options =
+                                FdMMapWindowReaderBase::Options())
+    ->FdMMapWindowReader<>;
+#endif
+
 // Implementation details follow.
 
-inline FdReaderBase::FdReaderBase(size_t buffer_size)
-    : BufferedReader(buffer_size) {}
+inline FdReaderBase::FdReaderBase(size_t buffer_size, size_t io_uring_depth,
+                                  bool direct_io)
+    : BufferedReader(buffer_size),
+      io_uring_depth_(io_uring_depth),
+      direct_io_(direct_io) {}
 
 inline FdReaderBase::FdReaderBase(FdReaderBase&& that) noexcept
     : BufferedReader(std::move(that)),
@@ -540,7 +1054,19 @@ inline FdReaderBase::FdReaderBase(FdReaderBase&& that) noexcept
       // part was moved.
       filename_(std::move(that.filename_)),
       supports_random_access_(that.supports_random_access_),
-      has_independent_pos_(that.has_independent_pos_) {}
+      has_independent_pos_(that.has_independent_pos_),
+      io_uring_depth_(that.io_uring_depth_),
+      io_uring_(std::move(that.io_uring_)),
+      io_uring_reads_(std::move(that.io_uring_reads_)),
+      io_uring_free_buffers_(std::move(that.io_uring_free_buffers_)),
+      direct_io_(that.direct_io_),
+      fd_had_direct_io_(that.fd_had_direct_io_),
+      direct_io_buffer_(std::move(that.direct_io_buffer_)),
+      direct_io_buffer_pos_(that.direct_io_buffer_pos_),
+      direct_io_buffered_(that.direct_io_buffered_),
+      access_pattern_(that.access_pattern_),
+      random_read_start_(that.random_read_start_),
+      will_need_end_(that.will_need_end_) {}
 
 inline FdReaderBase& FdReaderBase::operator=(FdReaderBase&& that) noexcept {
   BufferedReader::operator=(std::move(that));
@@ -549,6 +1075,18 @@ inline FdReaderBase& FdReaderBase::operator=(FdReaderBase&& that) noexcept {
   filename_ = std::move(that.filename_);
   supports_random_access_ = that.supports_random_access_;
   has_independent_pos_ = that.has_independent_pos_;
+  io_uring_depth_ = that.io_uring_depth_;
+  io_uring_ = std::move(that.io_uring_);
+  io_uring_reads_ = std::move(that.io_uring_reads_);
+  io_uring_free_buffers_ = std::move(that.io_uring_free_buffers_);
+  direct_io_ = that.direct_io_;
+  fd_had_direct_io_ = that.fd_had_direct_io_;
+  direct_io_buffer_ = std::move(that.direct_io_buffer_);
+  direct_io_buffer_pos_ = that.direct_io_buffer_pos_;
+  direct_io_buffered_ = that.direct_io_buffered_;
+  access_pattern_ = that.access_pattern_;
+  random_read_start_ = that.random_read_start_;
+  will_need_end_ = that.will_need_end_;
   return *this;
 }
 
@@ -557,13 +1095,38 @@ inline void FdReaderBase::Reset(Closed) {
   filename_ = std::string();
   supports_random_access_ = LazyBoolState::kFalse;
   has_independent_pos_ = false;
+  io_uring_depth_ = 0;
+  io_uring_.reset();
+  io_uring_reads_.clear();
+  io_uring_free_buffers_.clear();
+  direct_io_ = false;
+  fd_had_direct_io_ = false;
+  direct_io_buffer_ = internal::DirectIoBuffer();
+  direct_io_buffer_pos_ = 0;
+  direct_io_buffered_ = 0;
+  access_pattern_ = AccessPattern::kNormal;
+  random_read_start_ = 0;
+  will_need_end_ = 0;
 }
 
-inline void FdReaderBase::Reset(size_t buffer_size) {
+inline void FdReaderBase::Reset(size_t buffer_size, size_t io_uring_depth,
+                                bool direct_io) {
   BufferedReader::Reset(buffer_size);
   // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
   supports_random_access_ = LazyBoolState::kFalse;
   has_independent_pos_ = false;
+  io_uring_depth_ = io_uring_depth;
+  io_uring_.reset();
+  io_uring_reads_.clear();
+  io_uring_free_buffers_.clear();
+  direct_io_ = direct_io;
+  fd_had_direct_io_ = false;
+  direct_io_buffer_ = internal::DirectIoBuffer();
+  direct_io_buffer_pos_ = 0;
+  direct_io_buffered_ = 0;
+  access_pattern_ = AccessPattern::kNormal;
+  random_read_start_ = 0;
+  will_need_end_ = 0;
 }
 
 inline FdMMapReaderBase::FdMMapReaderBase(bool has_independent_pos)
@@ -577,7 +1140,8 @@ inline FdMMapReaderBase::FdMMapReaderBase(FdMMapReaderBase&& that) noexcept
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       filename_(std::move(that.filename_)),
-      has_independent_pos_(that.has_independent_pos_) {}
+      has_independent_pos_(that.has_independent_pos_),
+      base_pos_(that.base_pos_) {}
 
 inline FdMMapReaderBase& FdMMapReaderBase::operator=(
     FdMMapReaderBase&& that) noexcept {
@@ -586,6 +1150,7 @@ inline FdMMapReaderBase& FdMMapReaderBase::operator=(
   // was moved.
   filename_ = std::move(that.filename_);
   has_independent_pos_ = that.has_independent_pos_;
+  base_pos_ = that.base_pos_;
   return *this;
 }
 
@@ -593,6 +1158,7 @@ inline void FdMMapReaderBase::Reset(Closed) {
   ChainReader::Reset(kClosed);
   filename_ = std::string();
   has_independent_pos_ = false;
+  base_pos_ = 0;
 }
 
 inline void FdMMapReaderBase::Reset(bool has_independent_pos) {
@@ -601,18 +1167,75 @@ inline void FdMMapReaderBase::Reset(bool has_independent_pos) {
   ChainReader::Reset(std::forward_as_tuple());
   // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
   has_independent_pos_ = has_independent_pos;
+  base_pos_ = 0;
+}
+
+inline FdMMapWindowReaderBase::FdMMapWindowReaderBase(bool has_independent_pos,
+                                                      size_t window_size)
+    : has_independent_pos_(has_independent_pos),
+      window_size_(RoundUp<kWindowAlignment>(window_size)) {}
+
+inline FdMMapWindowReaderBase::FdMMapWindowReaderBase(
+    FdMMapWindowReaderBase&& that) noexcept
+    : Reader(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      filename_(std::move(that.filename_)),
+      has_independent_pos_(that.has_independent_pos_),
+      window_size_(that.window_size_),
+      size_(that.size_),
+      access_pattern_(that.access_pattern_),
+      window_(std::move(that.window_)) {}
+
+inline FdMMapWindowReaderBase& FdMMapWindowReaderBase::operator=(
+    FdMMapWindowReaderBase&& that) noexcept {
+  Reader::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  filename_ = std::move(that.filename_);
+  has_independent_pos_ = that.has_independent_pos_;
+  window_size_ = that.window_size_;
+  size_ = that.size_;
+  access_pattern_ = that.access_pattern_;
+  window_ = std::move(that.window_);
+  return *this;
+}
+
+inline void FdMMapWindowReaderBase::Reset(Closed) {
+  Reader::Reset(kClosed);
+  filename_ = std::string();
+  has_independent_pos_ = false;
+  window_size_ = 0;
+  size_ = 0;
+  access_pattern_ = AccessPattern::kNormal;
+  window_ = ChainBlock();
+}
+
+inline void FdMMapWindowReaderBase::Reset(bool has_independent_pos,
+                                          size_t window_size) {
+  Reader::Reset();
+  // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
+  has_independent_pos_ = has_independent_pos;
+  window_size_ = RoundUp<kWindowAlignment>(window_size);
+  size_ = 0;
+  access_pattern_ = AccessPattern::kNormal;
+  window_ = ChainBlock();
 }
 
 template <typename Src>
 inline FdReader<Src>::FdReader(const Src& src, Options options)
-    : FdReaderBase(options.buffer_size()), src_(src) {
+    : FdReaderBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io()),
+      src_(src) {
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
 
 template <typename Src>
 inline FdReader<Src>::FdReader(Src&& src, Options options)
-    : FdReaderBase(options.buffer_size()), src_(std::move(src)) {
+    : FdReaderBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io()),
+      src_(std::move(src)) {
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -620,7 +1243,9 @@ inline FdReader<Src>::FdReader(Src&& src, Options options)
 template <typename Src>
 template <typename... SrcArgs>
 inline FdReader<Src>::FdReader(std::tuple<SrcArgs...> src_args, Options options)
-    : FdReaderBase(options.buffer_size()), src_(std::move(src_args)) {
+    : FdReaderBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io()),
+      src_(std::move(src_args)) {
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -656,7 +1281,8 @@ inline void FdReader<Src>::Reset(Closed) {
 
 template <typename Src>
 inline void FdReader<Src>::Reset(const Src& src, Options options) {
-  FdReaderBase::Reset(options.buffer_size());
+  FdReaderBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io());
   src_.Reset(src);
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -664,7 +1290,8 @@ inline void FdReader<Src>::Reset(const Src& src, Options options) {
 
 template <typename Src>
 inline void FdReader<Src>::Reset(Src&& src, Options options) {
-  FdReaderBase::Reset(options.buffer_size());
+  FdReaderBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io());
   src_.Reset(std::move(src));
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -674,7 +1301,8 @@ template <typename Src>
 template <typename... SrcArgs>
 inline void FdReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                  Options options) {
-  FdReaderBase::Reset(options.buffer_size());
+  FdReaderBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io());
   src_.Reset(std::move(src_args));
   Initialize(src_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -692,7 +1320,8 @@ void FdReader<Src>::Initialize(absl::string_view filename, int flags,
                                Options&& options) {
   const int src = OpenFd(filename, flags);
   if (ABSL_PREDICT_FALSE(src < 0)) return;
-  FdReaderBase::Reset(options.buffer_size());
+  FdReaderBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io());
   src_.Reset(std::forward_as_tuple(src));
   InitializePos(src_.get(), options.assumed_pos(), options.independent_pos());
 }
@@ -712,16 +1341,14 @@ void FdReader<Src>::Done() {
 template <typename Src>
 inline FdMMapReader<Src>::FdMMapReader(const Src& src, Options options)
     : FdMMapReaderBase(options.independent_pos() != absl::nullopt), src_(src) {
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
 inline FdMMapReader<Src>::FdMMapReader(Src&& src, Options options)
     : FdMMapReaderBase(options.independent_pos() != absl::nullopt),
       src_(std::move(src)) {
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -730,8 +1357,7 @@ inline FdMMapReader<Src>::FdMMapReader(std::tuple<SrcArgs...> src_args,
                                        Options options)
     : FdMMapReaderBase(options.independent_pos() != absl::nullopt),
       src_(std::move(src_args)) {
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -768,16 +1394,14 @@ template <typename Src>
 inline void FdMMapReader<Src>::Reset(const Src& src, Options options) {
   FdMMapReaderBase::Reset(options.independent_pos() != absl::nullopt);
   src_.Reset(src);
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
 inline void FdMMapReader<Src>::Reset(Src&& src, Options options) {
   FdMMapReaderBase::Reset(options.independent_pos() != absl::nullopt);
   src_.Reset(std::move(src));
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -786,8 +1410,7 @@ inline void FdMMapReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                      Options options) {
   FdMMapReaderBase::Reset(options.independent_pos() != absl::nullopt);
   src_.Reset(std::move(src_args));
-  Initialize(src_.get(), std::move(options.assumed_filename()),
-             options.independent_pos());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -804,7 +1427,7 @@ void FdMMapReader<Src>::Initialize(absl::string_view filename, int flags,
   if (ABSL_PREDICT_FALSE(src < 0)) return;
   FdMMapReaderBase::Reset(options.independent_pos() != absl::nullopt);
   src_.Reset(std::forward_as_tuple(src));
-  InitializePos(src_.get(), options.independent_pos());
+  InitializePos(src_.get(), options);
 }
 
 template <typename Src>
@@ -830,6 +1453,126 @@ void FdMMapReader<Src>::Done() {
   }
 }
 
+template <typename Src>
+inline FdMMapWindowReader<Src>::FdMMapWindowReader(const Src& src,
+                                                   Options options)
+    : FdMMapWindowReaderBase(options.independent_pos() != absl::nullopt,
+                             options.window_size()),
+      src_(src) {
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+inline FdMMapWindowReader<Src>::FdMMapWindowReader(Src&& src, Options options)
+    : FdMMapWindowReaderBase(options.independent_pos() != absl::nullopt,
+                             options.window_size()),
+      src_(std::move(src)) {
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline FdMMapWindowReader<Src>::FdMMapWindowReader(
+    std::tuple<SrcArgs...> src_args, Options options)
+    : FdMMapWindowReaderBase(options.independent_pos() != absl::nullopt,
+                             options.window_size()),
+      src_(std::move(src_args)) {
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+inline FdMMapWindowReader<Src>::FdMMapWindowReader(absl::string_view filename,
+                                                   int flags, Options options)
+    : FdMMapWindowReaderBase(kClosed) {
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Src>
+inline FdMMapWindowReader<Src>::FdMMapWindowReader(
+    FdMMapWindowReader&& that) noexcept
+    : FdMMapWindowReaderBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      src_(std::move(that.src_)) {}
+
+template <typename Src>
+inline FdMMapWindowReader<Src>& FdMMapWindowReader<Src>::operator=(
+    FdMMapWindowReader&& that) noexcept {
+  FdMMapWindowReaderBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  src_ = std::move(that.src_);
+  return *this;
+}
+
+template <typename Src>
+inline void FdMMapWindowReader<Src>::Reset(Closed) {
+  FdMMapWindowReaderBase::Reset(kClosed);
+  src_.Reset();
+}
+
+template <typename Src>
+inline void FdMMapWindowReader<Src>::Reset(const Src& src, Options options) {
+  FdMMapWindowReaderBase::Reset(options.independent_pos() != absl::nullopt,
+                                options.window_size());
+  src_.Reset(src);
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+inline void FdMMapWindowReader<Src>::Reset(Src&& src, Options options) {
+  FdMMapWindowReaderBase::Reset(options.independent_pos() != absl::nullopt,
+                                options.window_size());
+  src_.Reset(std::move(src));
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void FdMMapWindowReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                           Options options) {
+  FdMMapWindowReaderBase::Reset(options.independent_pos() != absl::nullopt,
+                                options.window_size());
+  src_.Reset(std::move(src_args));
+  Initialize(src_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Src>
+inline void FdMMapWindowReader<Src>::Reset(absl::string_view filename,
+                                           int flags, Options options) {
+  Reset(kClosed);
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Src>
+void FdMMapWindowReader<Src>::Initialize(absl::string_view filename, int flags,
+                                         Options&& options) {
+  const int src = OpenFd(filename, flags);
+  if (ABSL_PREDICT_FALSE(src < 0)) return;
+  FdMMapWindowReaderBase::Reset(options.independent_pos() != absl::nullopt,
+                                options.window_size());
+  src_.Reset(std::forward_as_tuple(src));
+  InitializePos(src_.get(), options.independent_pos());
+}
+
+template <typename Src>
+void FdMMapWindowReader<Src>::Done() {
+  FdMMapWindowReaderBase::Done();
+  if (src_.is_owning()) {
+    const int src = src_.Release();
+    if (ABSL_PREDICT_FALSE(internal::CloseFd(src) < 0) &&
+        ABSL_PREDICT_TRUE(healthy())) {
+      FailOperation(internal::kCloseFunctionName);
+    }
+  }
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_BYTES_FD_READER_H_
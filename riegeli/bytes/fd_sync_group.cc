@@ -0,0 +1,127 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make `syncfs()` available.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "riegeli/bytes/fd_sync_group.h"
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "riegeli/base/errno_mapping.h"
+#include "riegeli/base/parallelism.h"
+
+namespace riegeli {
+
+FdSyncGroup::FdSyncGroup(Options options) : options_(std::move(options)) {}
+
+FdSyncGroup::~FdSyncGroup() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](bool* running) { return !*running; }, &running_));
+}
+
+std::shared_future<absl::Status> FdSyncGroup::Sync(int fd) {
+  std::promise<absl::Status> done;
+  std::shared_future<absl::Status> result = done.get_future();
+  bool start = false;
+  {
+    absl::MutexLock lock(&mutex_);
+    pending_.push_back(Request{fd, std::move(done)});
+    if (!running_) {
+      running_ = true;
+      start = true;
+    }
+  }
+  if (start) internal::ThreadPool::global().ScheduleBlocking([this] { Run(); });
+  return result;
+}
+
+void FdSyncGroup::Run() {
+  std::vector<Request> batch;
+  for (;;) {
+    // Let more requests arrive, so that they are served by the same pass.
+    absl::SleepFor(options_.window());
+    {
+      absl::MutexLock lock(&mutex_);
+      if (pending_.empty()) {
+        running_ = false;
+        return;
+      }
+      // Requests received during the pass below are served by the next pass,
+      // because data written after syncing started might not be covered.
+      batch.swap(pending_);
+    }
+    SyncBatch(batch);
+    batch.clear();
+  }
+}
+
+inline bool FdSyncGroup::UseSyncfs() const {
+#ifdef __linux__
+  return options_.syncfs();
+#else
+  return false;
+#endif
+}
+
+void FdSyncGroup::SyncBatch(std::vector<Request>& batch) const {
+  // Maps a synced fd, or the device of a synced filesystem, to the result.
+  absl::flat_hash_map<uint64_t, absl::Status> synced;
+  for (Request& request : batch) {
+    uint64_t key = static_cast<uint64_t>(request.fd);
+    if (UseSyncfs()) {
+      struct stat stat_info;
+      if (ABSL_PREDICT_FALSE(fstat(request.fd, &stat_info) < 0)) {
+        request.done.set_value(ErrnoToCanonicalStatus(errno, "fstat() failed"));
+        continue;
+      }
+      key = static_cast<uint64_t>(stat_info.st_dev);
+    }
+    const auto inserted = synced.try_emplace(key);
+    if (inserted.second) inserted.first->second = SyncFd(request.fd);
+    request.done.set_value(inserted.first->second);
+  }
+}
+
+absl::Status FdSyncGroup::SyncFd(int fd) const {
+#ifdef __linux__
+  if (options_.syncfs()) {
+    if (ABSL_PREDICT_FALSE(syncfs(fd) < 0)) {
+      return ErrnoToCanonicalStatus(errno, "syncfs() failed");
+    }
+    return absl::OkStatus();
+  }
+#endif
+  if (ABSL_PREDICT_FALSE(fsync(fd) < 0)) {
+    return ErrnoToCanonicalStatus(errno, "fsync() failed");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
@@ -0,0 +1,118 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_FD_SYNC_GROUP_H_
+#define RIEGELI_BYTES_FD_SYNC_GROUP_H_
+
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace riegeli {
+
+// `FdSyncGroup` makes data written to many fds durable with group commit:
+// requests for syncing received within a short window are served by one pass
+// of syncing in a background thread, where each distinct fd is synced once,
+// or with `Options::set_syncfs(true)` each distinct filesystem is synced once.
+//
+// This helps if many writers in a process flush with
+// `FlushType::kFromMachine`, e.g. many `RecordWriter`s with `FdWriter`
+// destinations using `FdWriterBase::Options::set_sync_group()`.
+//
+// `FdSyncGroup` is thread-safe.
+class FdSyncGroup {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // How long to collect requests after the first one before syncing. Longer
+    // windows serve more requests by one pass, at the cost of latency.
+    //
+    // Default: 1ms.
+    Options& set_window(absl::Duration window) & {
+      window_ = window;
+      return *this;
+    }
+    Options&& set_window(absl::Duration window) && {
+      return std::move(set_window(window));
+    }
+    absl::Duration window() const { return window_; }
+
+    // If `false`, each distinct fd is synced with `fsync()`.
+    //
+    // If `true`, each distinct filesystem is synced with `syncfs()`, which
+    // also syncs data of other files on that filesystem. This is cheaper if
+    // many files of the same filesystem are synced together. `syncfs()` is
+    // used only on Linux, otherwise this is ignored.
+    //
+    // Default: `false`.
+    Options& set_syncfs(bool syncfs) & {
+      syncfs_ = syncfs;
+      return *this;
+    }
+    Options&& set_syncfs(bool syncfs) && {
+      return std::move(set_syncfs(syncfs));
+    }
+    bool syncfs() const { return syncfs_; }
+
+   private:
+    absl::Duration window_ = absl::Milliseconds(1);
+    bool syncfs_ = false;
+  };
+
+  // Creates an `FdSyncGroup`.
+  explicit FdSyncGroup(Options options = Options());
+
+  FdSyncGroup(const FdSyncGroup&) = delete;
+  FdSyncGroup& operator=(const FdSyncGroup&) = delete;
+
+  // Waits for pending requests to be served.
+  ~FdSyncGroup();
+
+  // Requests that data written to `fd` so far become durable. Returns a future
+  // which becomes ready when this is done, with `absl::OkStatus()` on success.
+  //
+  // `fd` must be kept open until the future becomes ready.
+  std::shared_future<absl::Status> Sync(int fd);
+
+ private:
+  struct Request {
+    int fd;
+    std::promise<absl::Status> done;
+  };
+
+  // Serves requests until there are none.
+  void Run();
+  // Serves `batch`, syncing each distinct fd or filesystem once.
+  void SyncBatch(std::vector<Request>& batch) const;
+  bool UseSyncfs() const;
+  absl::Status SyncFd(int fd) const;
+
+  Options options_;
+
+  absl::Mutex mutex_;
+  std::vector<Request> pending_ ABSL_GUARDED_BY(mutex_);
+  // If `true`, a background thread runs `Run()`.
+  bool running_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_FD_SYNC_GROUP_H_
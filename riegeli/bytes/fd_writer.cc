@@ -18,6 +18,16 @@
 #define _XOPEN_SOURCE 500
 #endif
 
+// Make `pwritev()` available.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+// Make `fallocate()` and `mremap()` available.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 // Make `off_t` 64-bit even on 32-bit systems.
 #undef _FILE_OFFSET_BITS
 #define _FILE_OFFSET_BITS 64
@@ -25,28 +35,40 @@
 #include "riegeli/bytes/fd_writer.h"
 
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <cerrno>
+#include <cstring>
 #include <limits>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/errno_mapping.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_direct_io.h"
+#include "riegeli/bytes/fd_io_uring.h"
 #include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_sync_group.h"
 #include "riegeli/bytes/reader.h"
 
 namespace riegeli {
@@ -130,6 +152,12 @@ void FdWriterBase::InitializePos(int dest, int flags,
     }
     set_start_pos(*independent_pos);
   } else {
+    if ((flags & O_APPEND) != 0) {
+      // Writes at explicit positions would not append.
+      io_uring_depth_ = 0;
+      direct_io_ = false;
+    }
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     const off_t file_pos =
         lseek(dest, 0, (flags & O_APPEND) != 0 ? SEEK_END : SEEK_CUR);
     if (file_pos < 0) {
@@ -147,12 +175,31 @@ void FdWriterBase::InitializePos(int dest, int flags,
 
 void FdWriterBase::Done() {
   BufferedWriter::Done();
+  if (io_uring_ != nullptr) {
+    StopIoUring();
+    io_uring_.reset();
+    io_uring_writes_.clear();
+    io_uring_free_buffers_.clear();
+  }
+  if (direct_io_buffer_.data() != nullptr) {
+    if (ABSL_PREDICT_TRUE(healthy())) SyncDirectIo();
+    direct_io_buffer_ = internal::DirectIoBuffer();
+    direct_io_buffered_ = 0;
+    if (!fd_had_direct_io_) {
+      const int dest = dest_fd();
+      if (ABSL_PREDICT_FALSE(internal::SetDirectIo(dest, false) < 0) &&
+          ABSL_PREDICT_TRUE(healthy())) {
+        FailOperation("fcntl()");
+      }
+    }
+  }
   // If `supports_random_access_` is still `LazyBoolState::kUnknown`, change it
   // to `LazyBoolState::kFalse`, because trying to resolve it later might access
   // a closed stream. The resolution is no longer interesting anyway.
   if (supports_random_access_ == LazyBoolState::kUnknown) {
     supports_random_access_ = LazyBoolState::kFalse;
   }
+  if (preallocated_end_ > 0) ReleasePreallocated();
   associated_reader_.Reset();
 }
 
@@ -191,7 +238,9 @@ bool FdWriterBase::supports_random_access() {
     // recognized by a failing `lseek(SEEK_END)`.
   } else {
     const int dest = dest_fd();
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     if (lseek(dest, 0, SEEK_END) >= 0) {
+      internal::CountSyscall(IoStats::Syscall::kSeek);
       if (ABSL_PREDICT_FALSE(
               lseek(dest, IntCast<off_t>(start_pos()), SEEK_SET) < 0)) {
         FailOperation("lseek()");
@@ -226,6 +275,15 @@ bool FdWriterBase::WriteInternal(absl::string_view src) {
                              start_pos())) {
     return FailOverflow();
   }
+  MaybePreallocate(start_pos() + src.size());
+  if (direct_io_buffer_.data() != nullptr || (direct_io_ && StartDirectIo())) {
+    return WriteWithDirectIo(src);
+  }
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (io_uring_ != nullptr || (io_uring_depth_ > 0 && StartIoUring())) {
+    return WriteWithIoUring(src);
+  }
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
   do {
   again:
     const ssize_t length_written =
@@ -241,6 +299,8 @@ bool FdWriterBase::WriteInternal(absl::string_view src) {
       if (errno == EINTR) goto again;
       return FailOperation(has_independent_pos_ ? "pwrite()" : "write()");
     }
+    internal::CountSyscall(IoStats::Syscall::kWrite,
+                           IntCast<size_t>(length_written));
     RIEGELI_ASSERT_GT(length_written, 0)
         << (has_independent_pos_ ? "pwrite()" : "write()") << " returned 0";
     RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), src.size())
@@ -252,14 +312,405 @@ bool FdWriterBase::WriteInternal(absl::string_view src) {
   return true;
 }
 
+bool FdWriterBase::WriteSlow(const Chain& src) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), src.size())
+      << "Failed precondition of Writer::WriteSlow(Chain): "
+         "enough space available, use Write(Chain) instead";
+  return WriteSlowImpl(src);
+}
+
+bool FdWriterBase::WriteSlow(const absl::Cord& src) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), src.size())
+      << "Failed precondition of Writer::WriteSlow(Cord): "
+         "enough space available, use Write(Cord) instead";
+  return WriteSlowImpl(src);
+}
+
+namespace {
+
+// The maximum number of fragments written by one `writev()` or `pwritev()`.
+constexpr int kMaxIovecs = IOV_MAX < 256 ? IOV_MAX : 256;
+
+inline Chain::Blocks Fragments(const Chain& src) { return src.blocks(); }
+
+inline absl::Cord::ChunkRange Fragments(const absl::Cord& src) {
+  return src.Chunks();
+}
+
+}  // namespace
+
+template <typename Src>
+inline bool FdWriterBase::WriteSlowImpl(const Src& src) {
+  // With direct I/O or io_uring data must be copied to their buffers anyway.
+  if (src.size() < LengthToWriteDirectly() || direct_io_ ||
+      io_uring_depth_ > 0) {
+    return BufferedWriter::WriteSlow(src);
+  }
+  if (ABSL_PREDICT_FALSE(!SyncBuffer())) return false;
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!WriteMode())) return false;
+  if (ABSL_PREDICT_FALSE(src.size() >
+                         Position{std::numeric_limits<off_t>::max()} -
+                             start_pos())) {
+    return FailOverflow();
+  }
+  MaybePreallocate(start_pos() + src.size());
+  return WriteVectored(Fragments(src), src.size());
+}
+
+template <typename Fragments>
+inline bool FdWriterBase::WriteVectored(const Fragments& fragments,
+                                        Position length) {
+  const int dest = dest_fd();
+  auto iter = fragments.begin();
+  // The length of the prefix of `*iter` which was already written.
+  size_t offset = 0;
+  while (length > 0) {
+    struct iovec iov[kMaxIovecs];
+    int iov_count = 0;
+    size_t iov_length = 0;
+    for (auto fill_iter = iter;
+         fill_iter != fragments.end() && iov_count < kMaxIovecs; ++fill_iter) {
+      absl::string_view fragment = *fill_iter;
+      if (fill_iter == iter) fragment.remove_prefix(offset);
+      if (fragment.empty()) continue;
+      const size_t fragment_length = UnsignedMin(
+          fragment.size(),
+          size_t{std::numeric_limits<ssize_t>::max()} - iov_length);
+      if (fragment_length == 0) break;
+      iov[iov_count].iov_base = const_cast<char*>(fragment.data());
+      iov[iov_count].iov_len = fragment_length;
+      ++iov_count;
+      iov_length += fragment_length;
+    }
+  again:
+    const ssize_t length_written =
+        has_independent_pos_
+            ? pwritev(dest, iov, iov_count, IntCast<off_t>(start_pos()))
+            : writev(dest, iov, iov_count);
+    if (ABSL_PREDICT_FALSE(length_written < 0)) {
+      if (errno == EINTR) goto again;
+      return FailOperation(has_independent_pos_ ? "pwritev()" : "writev()");
+    }
+    internal::CountSyscall(IoStats::Syscall::kWrite,
+                           IntCast<size_t>(length_written));
+    RIEGELI_ASSERT_GT(length_written, 0)
+        << (has_independent_pos_ ? "pwritev()" : "writev()") << " returned 0";
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), iov_length)
+        << (has_independent_pos_ ? "pwritev()" : "writev()")
+        << " wrote more than requested";
+    move_start_pos(IntCast<size_t>(length_written));
+    length -= IntCast<size_t>(length_written);
+    size_t remaining = IntCast<size_t>(length_written);
+    while (remaining > 0) {
+      const size_t fragment_remaining = (*iter).size() - offset;
+      if (remaining < fragment_remaining) {
+        offset += remaining;
+        break;
+      }
+      remaining -= fragment_remaining;
+      ++iter;
+      offset = 0;
+    }
+  }
+  return true;
+}
+
+bool FdWriterBase::StartIoUring() {
+  RIEGELI_ASSERT(io_uring_ == nullptr)
+      << "Failed precondition of FdWriterBase::StartIoUring(): "
+         "io_uring already started";
+  if (supports_random_access()) {
+    std::unique_ptr<internal::FdIoUring> io_uring =
+        std::make_unique<internal::FdIoUring>();
+    if (io_uring->Initialize(dest_fd(), io_uring_depth_, buffer_size())) {
+      io_uring_writes_.assign(io_uring->num_buffers(), IoUringWrite());
+      io_uring_free_buffers_.clear();
+      for (size_t index = io_uring->num_buffers(); index > 0; --index) {
+        io_uring_free_buffers_.push_back(index - 1);
+      }
+      io_uring_ = std::move(io_uring);
+      return true;
+    }
+  }
+  // io_uring is not applicable, fall back to `write()` or `pwrite()`.
+  io_uring_depth_ = 0;
+  return false;
+}
+
+inline bool FdWriterBase::WriteWithIoUring(absl::string_view src) {
+  do {
+    if (io_uring_free_buffers_.empty()) {
+      if (ABSL_PREDICT_FALSE(!WaitForIoUringWrite())) return false;
+      continue;
+    }
+    const size_t index = io_uring_free_buffers_.back();
+    io_uring_free_buffers_.pop_back();
+    const size_t length = UnsignedMin(src.size(), io_uring_->buffer_size());
+    std::memcpy(io_uring_->buffer(index), src.data(), length);
+    io_uring_writes_[index] = IoUringWrite{start_pos(), 0, length};
+    io_uring_->PrepareWrite(index, 0, length, start_pos());
+    move_start_pos(length);
+    src.remove_prefix(length);
+  } while (!src.empty());
+  if (ABSL_PREDICT_FALSE(!io_uring_->Submit())) {
+    return FailOperation("io_uring_enter()");
+  }
+  return true;
+}
+
+inline bool FdWriterBase::WaitForIoUringWrite() {
+  size_t index;
+  ssize_t result;
+  if (ABSL_PREDICT_FALSE(!io_uring_->WaitForCompletion(index, result))) {
+    return FailOperation("io_uring_enter()");
+  }
+  IoUringWrite& write = io_uring_writes_[index];
+  if (ABSL_PREDICT_FALSE(result < 0)) {
+    if (result == -EINTR || result == -EAGAIN) {
+      io_uring_->PrepareWrite(index, write.offset, write.length, write.pos);
+      return true;
+    }
+    io_uring_free_buffers_.push_back(index);
+    errno = IntCast<int>(-result);
+    return FailOperation("io_uring write");
+  }
+  RIEGELI_ASSERT_GT(result, 0) << "io_uring write returned 0";
+  RIEGELI_ASSERT_LE(IntCast<size_t>(result), write.length)
+      << "io_uring wrote more than requested";
+  if (ABSL_PREDICT_FALSE(IntCast<size_t>(result) < write.length)) {
+    // A short write. Write the remaining part.
+    write.pos += IntCast<size_t>(result);
+    write.offset += IntCast<size_t>(result);
+    write.length -= IntCast<size_t>(result);
+    io_uring_->PrepareWrite(index, write.offset, write.length, write.pos);
+    return true;
+  }
+  io_uring_free_buffers_.push_back(index);
+  return true;
+}
+
+bool FdWriterBase::StopIoUring() {
+  while (io_uring_->num_in_flight() > 0) {
+    if (ABSL_PREDICT_FALSE(!WaitForIoUringWrite())) return false;
+  }
+  if (!has_independent_pos_ && ABSL_PREDICT_TRUE(healthy())) {
+    // Writing with `io_uring_` did not move the fd position.
+    const int dest = dest_fd();
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    if (ABSL_PREDICT_FALSE(lseek(dest, IntCast<off_t>(start_pos()), SEEK_SET) <
+                           0)) {
+      return FailOperation("lseek()");
+    }
+  }
+  return true;
+}
+
+bool FdWriterBase::StartDirectIo() {
+  RIEGELI_ASSERT(direct_io_buffer_.data() == nullptr)
+      << "Failed precondition of FdWriterBase::StartDirectIo(): "
+         "direct I/O already started";
+  if (supports_random_access()) {
+    const int dest = dest_fd();
+    const int had_direct_io = internal::SetDirectIo(dest, true);
+    if (had_direct_io >= 0) {
+      fd_had_direct_io_ = had_direct_io > 0;
+      direct_io_buffer_ = internal::DirectIoBuffer(buffer_size());
+      direct_io_buffered_ = 0;
+      return true;
+    }
+  }
+  // Direct I/O is not applicable, fall back to writing through the page cache.
+  direct_io_ = false;
+  return false;
+}
+
+inline bool FdWriterBase::WriteWithDirectIo(absl::string_view src) {
+  if (direct_io_buffered_ == 0) {
+    const size_t misalignment =
+        IntCast<size_t>(start_pos() % internal::kDirectIoAlignment);
+    if (misalignment > 0) {
+      // The block containing `start_pos()` begins with data which are not
+      // known. Write up to the block boundary without `O_DIRECT`.
+      const size_t length = UnsignedMin(
+          src.size(), internal::kDirectIoAlignment - misalignment);
+      if (ABSL_PREDICT_FALSE(
+              !WriteWithoutDirectIo(src.data(), length, start_pos()))) {
+        return false;
+      }
+      move_start_pos(length);
+      src.remove_prefix(length);
+    }
+  }
+  while (!src.empty()) {
+    const size_t length =
+        UnsignedMin(src.size(), direct_io_buffer_.capacity() -
+                                    direct_io_buffered_);
+    std::memcpy(direct_io_buffer_.data() + direct_io_buffered_, src.data(),
+                length);
+    direct_io_buffered_ += length;
+    move_start_pos(length);
+    src.remove_prefix(length);
+    if (direct_io_buffered_ == direct_io_buffer_.capacity()) {
+      if (ABSL_PREDICT_FALSE(!WriteFully(direct_io_buffer_.data(),
+                                         direct_io_buffered_,
+                                         start_pos() - direct_io_buffered_))) {
+        return false;
+      }
+      direct_io_buffered_ = 0;
+    }
+  }
+  return true;
+}
+
+bool FdWriterBase::WriteFully(const char* src, size_t length, Position pos) {
+  const int dest = dest_fd();
+  while (length > 0) {
+    const ssize_t length_written =
+        pwrite(dest, src,
+               UnsignedMin(length, size_t{std::numeric_limits<ssize_t>::max()}),
+               IntCast<off_t>(pos));
+    if (ABSL_PREDICT_FALSE(length_written < 0)) {
+      if (errno == EINTR) continue;
+      return FailOperation("pwrite()");
+    }
+    internal::CountSyscall(IoStats::Syscall::kWrite,
+                           IntCast<size_t>(length_written));
+    RIEGELI_ASSERT_GT(length_written, 0) << "pwrite() returned 0";
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), length)
+        << "pwrite() wrote more than requested";
+    src += length_written;
+    length -= IntCast<size_t>(length_written);
+    pos += IntCast<size_t>(length_written);
+  }
+  return true;
+}
+
+bool FdWriterBase::WriteWithoutDirectIo(const char* src, size_t length,
+                                        Position pos) {
+  const int dest = dest_fd();
+  if (ABSL_PREDICT_FALSE(internal::SetDirectIo(dest, false) < 0)) {
+    return FailOperation("fcntl()");
+  }
+  if (ABSL_PREDICT_FALSE(!WriteFully(src, length, pos))) return false;
+  if (ABSL_PREDICT_FALSE(internal::SetDirectIo(dest, true) < 0)) {
+    return FailOperation("fcntl()");
+  }
+  return true;
+}
+
+bool FdWriterBase::SyncDirectIo() {
+  const Position buffer_pos = start_pos() - direct_io_buffered_;
+  const size_t aligned_length =
+      RoundDown<internal::kDirectIoAlignment>(direct_io_buffered_);
+  if (aligned_length > 0) {
+    if (ABSL_PREDICT_FALSE(!WriteFully(direct_io_buffer_.data(),
+                                       aligned_length, buffer_pos))) {
+      return false;
+    }
+  }
+  const size_t tail_length = direct_io_buffered_ - aligned_length;
+  if (tail_length > 0) {
+    // Write the unaligned tail without `O_DIRECT`. Keep it in the buffer, so
+    // that its block can be written again with `O_DIRECT` when it is complete.
+    if (ABSL_PREDICT_FALSE(!WriteWithoutDirectIo(
+            direct_io_buffer_.data() + aligned_length, tail_length,
+            buffer_pos + aligned_length))) {
+      return false;
+    }
+    if (aligned_length > 0) {
+      std::memmove(direct_io_buffer_.data(),
+                   direct_io_buffer_.data() + aligned_length, tail_length);
+    }
+  }
+  direct_io_buffered_ = tail_length;
+  if (!has_independent_pos_) {
+    // Writing with direct I/O did not move the fd position.
+    const int dest = dest_fd();
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    if (ABSL_PREDICT_FALSE(lseek(dest, IntCast<off_t>(start_pos()), SEEK_SET) <
+                           0)) {
+      return FailOperation("lseek()");
+    }
+  }
+  return true;
+}
+
+namespace {
+
+// The maximum length of a preallocation, unless the initial length is larger.
+constexpr Position kMaxPreallocate = Position{1} << 30;
+
+}  // namespace
+
+inline void FdWriterBase::MaybePreallocate(Position end) {
+  if (preallocate_ > 0 && end > preallocated_end_) Preallocate(end);
+}
+
+void FdWriterBase::Preallocate(Position end) {
+#ifdef FALLOC_FL_KEEP_SIZE
+  const int dest = dest_fd();
+  const Position begin = UnsignedMax(preallocated_end_, start_pos());
+  const Position length =
+      UnsignedMin(UnsignedMax(end - begin, preallocate_),
+                  Position{std::numeric_limits<off_t>::max()} - begin);
+  internal::CountSyscall(IoStats::Syscall::kAllocate);
+again:
+  if (ABSL_PREDICT_FALSE(fallocate(dest, FALLOC_FL_KEEP_SIZE,
+                                   IntCast<off_t>(begin),
+                                   IntCast<off_t>(length)) < 0)) {
+    if (errno == EINTR) goto again;
+    // Preallocation is only an optimization, e.g. the file system might not
+    // support it. Do not try again.
+    preallocate_ = 0;
+    return;
+  }
+  preallocated_end_ = begin + length;
+  preallocate_ = UnsignedMax(preallocate_,
+                             UnsignedMin(SaturatingAdd(preallocate_,
+                                                       preallocate_),
+                                         kMaxPreallocate));
+#else
+  preallocate_ = 0;
+#endif
+}
+
+void FdWriterBase::ReleasePreallocated() {
+  const int dest = dest_fd();
+  struct stat stat_info;
+  internal::CountSyscall(IoStats::Syscall::kStat);
+  if (fstat(dest, &stat_info) == 0 &&
+      preallocated_end_ > IntCast<Position>(stat_info.st_size)) {
+    // Truncating to the current size releases blocks allocated beyond it.
+    // Failing to release them wastes space but does not affect the data, so it
+    // is not reported.
+    internal::CountSyscall(IoStats::Syscall::kTruncate);
+    ftruncate(dest, stat_info.st_size);
+  }
+  preallocated_end_ = 0;
+}
+
+inline bool FdWriterBase::SyncPendingWrites() {
+  if (io_uring_ != nullptr) return StopIoUring();
+  if (direct_io_buffer_.data() != nullptr) return SyncDirectIo();
+  return true;
+}
+
 bool FdWriterBase::FlushImpl(FlushType flush_type) {
   if (ABSL_PREDICT_FALSE(!BufferedWriter::FlushImpl(flush_type))) return false;
+  if (ABSL_PREDICT_FALSE(!SyncPendingWrites())) return false;
   switch (flush_type) {
     case FlushType::kFromObject:
     case FlushType::kFromProcess:
       return true;
     case FlushType::kFromMachine: {
       const int dest = dest_fd();
+      if (sync_group_ != nullptr) {
+        absl::Status status = sync_group_->Sync(dest).get();
+        if (ABSL_PREDICT_FALSE(!status.ok())) return Fail(std::move(status));
+        return true;
+      }
+      internal::CountSyscall(IoStats::Syscall::kSync);
       if (ABSL_PREDICT_FALSE(fsync(dest) < 0)) {
         return FailOperation("fsync()");
       }
@@ -286,6 +737,7 @@ inline bool FdWriterBase::SeekInternal(int dest, Position new_pos) {
   RIEGELI_ASSERT(healthy())
       << "Failed precondition of FdWriterBase::SeekInternal(): " << status();
   if (!has_independent_pos_) {
+    internal::CountSyscall(IoStats::Syscall::kSeek);
     if (ABSL_PREDICT_FALSE(lseek(dest, IntCast<off_t>(new_pos), SEEK_SET) <
                            0)) {
       return FailOperation("lseek()");
@@ -308,10 +760,14 @@ bool FdWriterBase::SeekBehindBuffer(Position new_pos) {
     return BufferedWriter::SeekBehindBuffer(new_pos);
   }
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!SyncPendingWrites())) return false;
+  // Data kept for direct I/O do not precede the new position.
+  direct_io_buffered_ = 0;
   const int dest = dest_fd();
   if (new_pos > start_pos()) {
     // Seeking forwards.
     struct stat stat_info;
+    internal::CountSyscall(IoStats::Syscall::kStat);
     if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
       return FailOperation("fstat()");
     }
@@ -334,8 +790,10 @@ absl::optional<Position> FdWriterBase::SizeBehindBuffer() {
     return BufferedWriter::SizeBehindBuffer();
   }
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!SyncPendingWrites())) return absl::nullopt;
   const int dest = dest_fd();
   struct stat stat_info;
+  internal::CountSyscall(IoStats::Syscall::kStat);
   if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
     FailOperation("fstat()");
     return absl::nullopt;
@@ -348,10 +806,14 @@ bool FdWriterBase::TruncateBehindBuffer(Position new_size) {
       << "Failed precondition of BufferedWriter::TruncateBehindBuffer(): "
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!SyncPendingWrites())) return false;
+  // Data kept for direct I/O do not precede the new position.
+  direct_io_buffered_ = 0;
   const int dest = dest_fd();
   if (new_size >= start_pos()) {
     // Seeking forwards.
     struct stat stat_info;
+    internal::CountSyscall(IoStats::Syscall::kStat);
     if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
       return FailOperation("fstat()");
     }
@@ -362,6 +824,7 @@ bool FdWriterBase::TruncateBehindBuffer(Position new_size) {
     }
   }
 again:
+  internal::CountSyscall(IoStats::Syscall::kTruncate);
   if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(new_size)) < 0)) {
     if (errno == EINTR) goto again;
     return FailOperation("ftruncate()");
@@ -379,6 +842,7 @@ Reader* FdWriterBase::ReadModeBehindBuffer(Position initial_pos) {
     return BufferedWriter::ReadModeBehindBuffer(initial_pos);
   }
   if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  if (ABSL_PREDICT_FALSE(!SyncPendingWrites())) return nullptr;
   const int dest = dest_fd();
   FdReader<UnownedFd>* const reader = associated_reader_.ResetReader(
       dest, FdReaderBase::Options()
@@ -386,10 +850,272 @@ Reader* FdWriterBase::ReadModeBehindBuffer(Position initial_pos) {
                 .set_independent_pos(has_independent_pos_
                                          ? absl::make_optional(initial_pos)
                                          : absl::nullopt)
-                .set_buffer_size(buffer_size()));
+                .set_buffer_size(buffer_size())
+                .set_direct_io(direct_io_));
   read_mode_ = true;
   if (!has_independent_pos_) reader->Seek(initial_pos);
   return reader;
 }
 
+int FdWriterBase::BeginKernelCopy(absl::optional<Position>& dest_offset) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return -1;
+  if (io_uring_ != nullptr || direct_io_buffer_.data() != nullptr ||
+      direct_io_) {
+    return -1;
+  }
+  if (ABSL_PREDICT_FALSE(!SyncBuffer())) return -1;
+  if (ABSL_PREDICT_FALSE(!WriteMode())) return -1;
+  dest_offset =
+      has_independent_pos_ ? absl::make_optional(start_pos()) : absl::nullopt;
+  return dest_fd();
+}
+
+void FdWriterBase::EndKernelCopy(Position length) { move_start_pos(length); }
+
+namespace {
+
+size_t PageSize() {
+  static const size_t kPageSize = IntCast<size_t>(sysconf(_SC_PAGESIZE));
+  return kPageSize;
+}
+
+}  // namespace
+
+void FdMMapWriterBase::Initialize(int dest, Options&& options) {
+  RIEGELI_ASSERT_GE(dest, 0)
+      << "Failed precondition of FdMMapWriter: negative file descriptor";
+  filename_ =
+      internal::ResolveFilename(dest, std::move(options.assumed_filename()));
+  InitializePos(dest, options);
+}
+
+int FdMMapWriterBase::OpenFd(absl::string_view filename, int flags,
+                             mode_t permissions) {
+  RIEGELI_ASSERT((flags & O_ACCMODE) == O_RDWR)
+      << "Failed precondition of FdMMapWriter: flags must include O_RDWR";
+  // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+  // `filename_ = filename`
+  filename_.assign(filename.data(), filename.size());
+again:
+  const int dest = open(filename_.c_str(), flags, permissions);
+  if (ABSL_PREDICT_FALSE(dest < 0)) {
+    if (errno == EINTR) goto again;
+    FailOperation("open()");
+    return -1;
+  }
+  return dest;
+}
+
+void FdMMapWriterBase::InitializePos(int dest, const Options& options) {
+  Position initial_pos;
+  if (options.independent_pos() != absl::nullopt) {
+    initial_pos = *options.independent_pos();
+    if (ABSL_PREDICT_FALSE(initial_pos >
+                           Position{std::numeric_limits<off_t>::max()})) {
+      FailOverflow();
+      return;
+    }
+  } else {
+    const int flags = fcntl(dest, F_GETFL);
+    if (ABSL_PREDICT_FALSE(flags < 0)) {
+      FailOperation("fcntl()");
+      return;
+    }
+    internal::CountSyscall(IoStats::Syscall::kSeek);
+    const off_t file_pos =
+        lseek(dest, 0, (flags & O_APPEND) != 0 ? SEEK_END : SEEK_CUR);
+    if (ABSL_PREDICT_FALSE(file_pos < 0)) {
+      FailOperation("lseek()");
+      return;
+    }
+    initial_pos = IntCast<Position>(file_pos);
+  }
+  set_start_pos(initial_pos);
+}
+
+void FdMMapWriterBase::Done() {
+  if (ABSL_PREDICT_TRUE(healthy())) {
+    const Position end = pos();
+    Unmap();
+    set_start_pos(end);
+    const int dest = dest_fd();
+    internal::CountSyscall(IoStats::Syscall::kTruncate);
+    if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(end)) < 0)) {
+      FailOperation("ftruncate()");
+    } else {
+      SyncPos();
+    }
+  }
+  Unmap();
+  Writer::Done();
+}
+
+bool FdMMapWriterBase::FailOperation(absl::string_view operation) {
+  const int error_number = errno;
+  RIEGELI_ASSERT_NE(error_number, 0)
+      << "Failed precondition of FdMMapWriterBase::FailOperation(): "
+         "zero errno";
+  return Fail(
+      ErrnoToCanonicalStatus(error_number, absl::StrCat(operation, " failed")));
+}
+
+absl::Status FdMMapWriterBase::AnnotateStatusImpl(absl::Status status) {
+  status = Annotate(status, absl::StrCat("writing ", filename_));
+  return Writer::AnnotateStatusImpl(std::move(status));
+}
+
+void FdMMapWriterBase::Unmap() {
+  if (mapping_size_ == 0) return;
+  // `munmap()` fails only for invalid arguments, and mapped data are already
+  // in the file.
+  munmap(start(), mapping_size_);
+  mapping_size_ = 0;
+  set_buffer();
+}
+
+inline bool FdMMapWriterBase::SyncPos() {
+  if (has_independent_pos_) return true;
+  const int dest = dest_fd();
+  internal::CountSyscall(IoStats::Syscall::kSeek);
+  if (ABSL_PREDICT_FALSE(lseek(dest, IntCast<off_t>(pos()), SEEK_SET) < 0)) {
+    return FailOperation("lseek()");
+  }
+  return true;
+}
+
+bool FdMMapWriterBase::PushSlow(size_t min_length, size_t recommended_length) {
+  RIEGELI_ASSERT_LT(available(), min_length)
+      << "Failed precondition of Writer::PushSlow(): "
+         "enough space available, use Push() instead";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const int dest = dest_fd();
+  if (ABSL_PREDICT_FALSE(min_length >
+                         Position{std::numeric_limits<off_t>::max()} -
+                             pos())) {
+    return FailOverflow();
+  }
+  // The beginning of the mapping must be aligned to the page size.
+  const size_t cursor_index = mapping_size_ == 0
+                                  ? IntCast<size_t>(pos() % PageSize())
+                                  : start_to_cursor();
+  const Position mapping_pos = pos() - cursor_index;
+  Position new_size = UnsignedMax(
+      Position{cursor_index} + min_length,
+      Position{cursor_index} +
+          UnsignedMin(recommended_length,
+                      std::numeric_limits<size_t>::max() - cursor_index),
+      Position{mapping_size_} +
+          UnsignedMax(Position{mapping_size_}, min_growth_));
+  new_size = UnsignedMin(
+      SaturatingAdd(new_size, Position{PageSize() - 1}) / PageSize() *
+          PageSize(),
+      Position{std::numeric_limits<off_t>::max()} - mapping_pos,
+      Position{std::numeric_limits<size_t>::max()});
+  if (ABSL_PREDICT_FALSE(new_size < Position{cursor_index} + min_length)) {
+    return FailOverflow();
+  }
+  internal::CountSyscall(IoStats::Syscall::kTruncate);
+  if (ABSL_PREDICT_FALSE(
+          ftruncate(dest, IntCast<off_t>(mapping_pos + new_size)) < 0)) {
+    return FailOperation("ftruncate()");
+  }
+  void* mapping;
+  if (mapping_size_ == 0) {
+    mapping = mmap(nullptr, IntCast<size_t>(new_size), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, dest, IntCast<off_t>(mapping_pos));
+    if (ABSL_PREDICT_FALSE(mapping == MAP_FAILED)) {
+      return FailOperation("mmap()");
+    }
+  } else {
+#ifdef MREMAP_MAYMOVE
+    mapping = mremap(start(), mapping_size_, IntCast<size_t>(new_size),
+                     MREMAP_MAYMOVE);
+    if (ABSL_PREDICT_FALSE(mapping == MAP_FAILED)) {
+      return FailOperation("mremap()");
+    }
+#else
+    mapping = mmap(nullptr, IntCast<size_t>(new_size), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, dest, IntCast<off_t>(mapping_pos));
+    if (ABSL_PREDICT_FALSE(mapping == MAP_FAILED)) {
+      return FailOperation("mmap()");
+    }
+    munmap(start(), mapping_size_);
+#endif
+  }
+  mapping_size_ = IntCast<size_t>(new_size);
+  set_start_pos(mapping_pos);
+  set_buffer(static_cast<char*>(mapping), mapping_size_, cursor_index);
+  return true;
+}
+
+bool FdMMapWriterBase::FlushImpl(FlushType flush_type) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const int dest = dest_fd();
+  // Shrink the mapping to end at `pos()` before truncating the file there, so
+  // that no pages beyond the end of the file remain mapped.
+  if (mapping_size_ > 0) {
+    const size_t length = start_to_cursor();
+    if (length == 0) {
+      const Position end = pos();
+      Unmap();
+      set_start_pos(end);
+    } else {
+      const size_t mapped_length =
+          (length + PageSize() - 1) / PageSize() * PageSize();
+      if (mapped_length < mapping_size_) {
+        munmap(start() + mapped_length, mapping_size_ - mapped_length);
+      }
+      mapping_size_ = length;
+      set_buffer(start(), length, length);
+    }
+  }
+  internal::CountSyscall(IoStats::Syscall::kTruncate);
+  if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(pos())) < 0)) {
+    return FailOperation("ftruncate()");
+  }
+  if (ABSL_PREDICT_FALSE(!SyncPos())) return false;
+  switch (flush_type) {
+    case FlushType::kFromObject:
+    case FlushType::kFromProcess:
+      return true;
+    case FlushType::kFromMachine:
+      if (mapping_size_ > 0) {
+        internal::CountSyscall(IoStats::Syscall::kSync);
+        if (ABSL_PREDICT_FALSE(msync(start(), mapping_size_, MS_SYNC) < 0)) {
+          return FailOperation("msync()");
+        }
+      }
+      internal::CountSyscall(IoStats::Syscall::kSync);
+      if (ABSL_PREDICT_FALSE(fsync(dest) < 0)) {
+        return FailOperation("fsync()");
+      }
+      return true;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown flush type: " << static_cast<int>(flush_type);
+}
+
+absl::optional<Position> FdMMapWriterBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  return pos();
+}
+
+bool FdMMapWriterBase::TruncateImpl(Position new_size) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(new_size > pos())) return false;
+  if (mapping_size_ > 0 && new_size >= start_pos()) {
+    // The file is truncated by `Flush()` or `Close()`.
+    set_cursor(start() + IntCast<size_t>(new_size - start_pos()));
+    return true;
+  }
+  const int dest = dest_fd();
+  Unmap();
+  set_start_pos(new_size);
+  internal::CountSyscall(IoStats::Syscall::kTruncate);
+  if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(new_size)) < 0)) {
+    return FailOperation("ftruncate()");
+  }
+  return true;
+}
+
 }  // namespace riegeli
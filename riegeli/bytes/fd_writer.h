@@ -19,21 +19,30 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+#include <memory>
 #include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/buffered_writer.h"
+#include "riegeli/bytes/fd_copy.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_direct_io.h"
+#include "riegeli/bytes/fd_io_uring.h"
+#include "riegeli/bytes/fd_sync_group.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
 
 namespace riegeli {
 
@@ -41,7 +50,7 @@ template <typename Src>
 class FdReader;
 
 // Template parameter independent part of `FdWriter`.
-class FdWriterBase : public BufferedWriter {
+class FdWriterBase : public internal::FdCopyWriterBase {
  public:
   class Options {
    public:
@@ -138,6 +147,10 @@ class FdWriterBase : public BufferedWriter {
 
     // Tunes how much data is buffered before writing to the file.
     //
+    // A `Chain` or `absl::Cord` at least this long is written directly from
+    // its fragments with `writev()` or `pwritev()`, unless direct I/O or
+    // io_uring is used.
+    //
     // Default: `kDefaultBufferSize` (64K).
     Options& set_buffer_size(size_t buffer_size) & {
       RIEGELI_ASSERT_GT(buffer_size, 0u)
@@ -151,12 +164,106 @@ class FdWriterBase : public BufferedWriter {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // If positive, `FdWriter` keeps up to this many writes of up to
+    // `buffer_size()` bytes in flight, using Linux io_uring with buffers
+    // registered with the kernel. This reduces the number of system calls and
+    // raises the device queue depth for sequential writing, at the cost of
+    // copying data to io_uring buffers. Failures of writes in flight are
+    // reported by a later operation.
+    //
+    // io_uring is used only if random access is supported, the fd was not
+    // opened with `O_APPEND`, and io_uring is available, otherwise `FdWriter`
+    // silently falls back to `write()` or `pwrite()`.
+    //
+    // Default: 0 (io_uring is not used).
+    Options& set_io_uring_depth(size_t io_uring_depth) & {
+      io_uring_depth_ = io_uring_depth;
+      return *this;
+    }
+    Options&& set_io_uring_depth(size_t io_uring_depth) && {
+      return std::move(set_io_uring_depth(io_uring_depth));
+    }
+    size_t io_uring_depth() const { return io_uring_depth_; }
+
+    // If `true`, `O_DIRECT` is set for the fd, so that writing bypasses the
+    // page cache. This avoids evicting useful data from the page cache and
+    // copying data through it when a file is written once.
+    //
+    // Data are collected in a buffer of `buffer_size()` rounded up to a
+    // multiple of 4096 bytes, and written with file positions and lengths
+    // aligned to 4096 bytes. An unaligned beginning and an unaligned end of
+    // written data are written without `O_DIRECT`. The unaligned end is written
+    // by `Flush()` and `Close()`; if writing continues after `Flush()`, its
+    // block is written again with `O_DIRECT` when it is complete.
+    //
+    // `RecordWriterBase::Options::set_pad_to_block_boundary(true)` makes files
+    // written from the beginning be written wholly with `O_DIRECT`.
+    //
+    // Direct I/O is used only if random access is supported, the fd was not
+    // opened with `O_APPEND`, and the file system supports `O_DIRECT`,
+    // otherwise `FdWriter` silently writes through the page cache. If direct
+    // I/O is used, `io_uring_depth()` is ignored.
+    //
+    // `O_DIRECT` is cleared by `Close()` unless it was already set.
+    //
+    // Default: `false`.
+    Options& set_direct_io(bool direct_io) & {
+      direct_io_ = direct_io;
+      return *this;
+    }
+    Options&& set_direct_io(bool direct_io) && {
+      return std::move(set_direct_io(direct_io));
+    }
+    bool direct_io() const { return direct_io_; }
+
+    // If not `nullptr`, `Flush(FlushType::kFromMachine)` writes data to the fd
+    // and then waits until `sync_group` makes them durable together with data
+    // of other fds synced at about the same time, instead of calling `fsync()`
+    // itself.
+    //
+    // `sync_group` must outlive the `FdWriter`.
+    //
+    // Default: `nullptr`.
+    Options& set_sync_group(FdSyncGroup* sync_group) & {
+      sync_group_ = sync_group;
+      return *this;
+    }
+    Options&& set_sync_group(FdSyncGroup* sync_group) && {
+      return std::move(set_sync_group(sync_group));
+    }
+    FdSyncGroup* sync_group() const { return sync_group_; }
+
+    // If positive, disk space is preallocated with
+    // `fallocate(FALLOC_FL_KEEP_SIZE)` ahead of data being written, in
+    // increments starting from `preallocate` and doubling up to 1G. This lets
+    // the file system allocate contiguous extents for a file growing slowly,
+    // e.g. written by a long-lived `RecordWriter`, and update its metadata
+    // less often. Preallocated space beyond the file size is released by
+    // `Close()`.
+    //
+    // Preallocation is used only if the file system supports `fallocate()`,
+    // otherwise `FdWriter` silently writes without it.
+    //
+    // Default: 0 (no preallocation).
+    Options& set_preallocate(Position preallocate) & {
+      preallocate_ = preallocate;
+      return *this;
+    }
+    Options&& set_preallocate(Position preallocate) && {
+      return std::move(set_preallocate(preallocate));
+    }
+    Position preallocate() const { return preallocate_; }
+
    private:
     absl::optional<std::string> assumed_filename_;
     mode_t permissions_ = 0666;
     absl::optional<Position> assumed_pos_;
     absl::optional<Position> independent_pos_;
     size_t buffer_size_ = kDefaultBufferSize;
+    size_t io_uring_depth_ = 0;
+    bool direct_io_ = false;
+    FdSyncGroup* sync_group_ = nullptr;
+    Position preallocate_ = 0;
   };
 
   // Returns the fd being written to. If the fd is owned then changed to -1 by
@@ -173,15 +280,19 @@ class FdWriterBase : public BufferedWriter {
   }
 
  protected:
-  explicit FdWriterBase(Closed) noexcept : BufferedWriter(kClosed) {}
+  explicit FdWriterBase(Closed) noexcept
+      : internal::FdCopyWriterBase(kClosed) {}
 
-  explicit FdWriterBase(size_t buffer_size);
+  explicit FdWriterBase(size_t buffer_size, size_t io_uring_depth,
+                        bool direct_io, FdSyncGroup* sync_group,
+                        Position preallocate);
 
   FdWriterBase(FdWriterBase&& that) noexcept;
   FdWriterBase& operator=(FdWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(size_t buffer_size);
+  void Reset(size_t buffer_size, size_t io_uring_depth, bool direct_io,
+             FdSyncGroup* sync_group, Position preallocate);
   void Initialize(int dest, absl::optional<std::string>&& assumed_filename,
                   absl::optional<Position> assumed_pos,
                   absl::optional<Position> independent_pos);
@@ -196,19 +307,49 @@ class FdWriterBase : public BufferedWriter {
   void Done() override;
   absl::Status AnnotateStatusImpl(absl::Status status) override;
   bool WriteInternal(absl::string_view src) override;
+  using BufferedWriter::WriteSlow;
+  bool WriteSlow(const Chain& src) override;
+  bool WriteSlow(const absl::Cord& src) override;
   bool FlushImpl(FlushType flush_type) override;
   bool FlushBehindBuffer(absl::string_view src, FlushType flush_type) override;
   bool SeekBehindBuffer(Position new_pos) override;
   absl::optional<Position> SizeBehindBuffer() override;
   bool TruncateBehindBuffer(Position new_size) override;
   Reader* ReadModeBehindBuffer(Position initial_pos) override;
+  int BeginKernelCopy(absl::optional<Position>& dest_offset) override;
+  void EndKernelCopy(Position length) override;
 
  private:
   // Encodes a `bool` or a marker that the value is not fully resolved yet.
   enum class LazyBoolState { kFalse, kTrue, kUnknown };
 
+  // A write submitted to `io_uring_`.
+  struct IoUringWrite {
+    Position pos = 0;
+    size_t offset = 0;
+    size_t length = 0;
+  };
+
   bool WriteMode();
   bool SeekInternal(int dest, Position new_pos);
+  // These templates are defined and used only in fd_writer.cc.
+  template <typename Src>
+  bool WriteSlowImpl(const Src& src);
+  template <typename Fragments>
+  bool WriteVectored(const Fragments& fragments, Position length);
+  bool StartIoUring();
+  bool WriteWithIoUring(absl::string_view src);
+  bool WaitForIoUringWrite();
+  bool StopIoUring();
+  bool StartDirectIo();
+  bool WriteWithDirectIo(absl::string_view src);
+  bool WriteFully(const char* src, size_t length, Position pos);
+  bool WriteWithoutDirectIo(const char* src, size_t length, Position pos);
+  bool SyncDirectIo();
+  bool SyncPendingWrites();
+  void MaybePreallocate(Position end);
+  void Preallocate(Position end);
+  void ReleasePreallocated();
 
   std::string filename_;
   // Invariant:
@@ -220,6 +361,39 @@ class FdWriterBase : public BufferedWriter {
   AssociatedReader<FdReader<UnownedFd>> associated_reader_;
   bool read_mode_ = false;
 
+  // If 0, `io_uring_` is not used and will not be created.
+  size_t io_uring_depth_ = 0;
+  // If not `nullptr`, writing uses `io_uring_` instead of `write()` or
+  // `pwrite()`. Then if `!has_independent_pos_`, the fd position is
+  // synchronized only when writes in flight are waited for.
+  std::unique_ptr<internal::FdIoUring> io_uring_;
+  // Writes in flight, indexed by buffer index.
+  std::vector<IoUringWrite> io_uring_writes_;
+  // Indices of `io_uring_` buffers without writes in flight.
+  std::vector<size_t> io_uring_free_buffers_;
+
+  // If `false`, direct I/O is not used and will not be started.
+  bool direct_io_ = false;
+  // If `true`, `O_DIRECT` was set for the fd before direct I/O was started.
+  bool fd_had_direct_io_ = false;
+  // If not deallocated, writing collects data in `direct_io_buffer_` and uses
+  // `pwrite()` with `O_DIRECT` instead of `write()` or `pwrite()` from the
+  // source. Then if `!has_independent_pos_`, the fd position is synchronized
+  // only when data are synchronized.
+  internal::DirectIoBuffer direct_io_buffer_;
+  // The amount of data in `direct_io_buffer_`. They are written starting from
+  // the aligned position `start_pos() - direct_io_buffered_`.
+  size_t direct_io_buffered_ = 0;
+
+  // If not `nullptr`, `Flush(FlushType::kFromMachine)` uses `sync_group_`
+  // instead of `fsync()`.
+  FdSyncGroup* sync_group_ = nullptr;
+
+  // The length of the next preallocation, or 0 if space is not preallocated.
+  Position preallocate_ = 0;
+  // Space up to this position was preallocated.
+  Position preallocated_end_ = 0;
+
   // Invariant: `start_pos() <= std::numeric_limits<off_t>::max()`
 };
 
@@ -356,13 +530,275 @@ explicit FdWriter(absl::string_view filename, int flags,
     ->FdWriter<>;
 #endif
 
+// Template parameter independent part of `FdMMapWriter`.
+class FdMMapWriterBase : public Writer {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `FdMMapWriter` writes to an already open fd, `set_assumed_filename()`
+    // allows to override the filename which is included in failure messages and
+    // returned by `filename()`.
+    //
+    // If this is `absl::nullopt`, then "/dev/stdin", "/dev/stdout",
+    // "/dev/stderr", or "/proc/self/fd/<fd>" is assumed.
+    //
+    // If `FdMMapWriter` writes to a filename, `set_assumed_filename()` has no
+    // effect.
+    //
+    // Default: `absl::nullopt`
+    Options& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) & {
+      if (assumed_filename == absl::nullopt) {
+        assumed_filename_ = absl::nullopt;
+      } else {
+        // TODO: When `absl::string_view` becomes C++17
+        // `std::string_view`: `assumed_filename_.emplace(*assumed_filename)`
+        assumed_filename_.emplace(assumed_filename->data(),
+                                  assumed_filename->size());
+      }
+      return *this;
+    }
+    Options&& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) && {
+      return std::move(set_assumed_filename(assumed_filename));
+    }
+    absl::optional<std::string>& assumed_filename() {
+      return assumed_filename_;
+    }
+    const absl::optional<std::string>& assumed_filename() const {
+      return assumed_filename_;
+    }
+
+    // If `absl::nullopt`, `FdMMapWriter` writes starting from the current fd
+    // position, or from the end of the file if the fd was opened with
+    // `O_APPEND`. The `FdMMapWriter` position is synchronized back to the fd by
+    // `Flush()` and `Close()`.
+    //
+    // If not `absl::nullopt`, `FdMMapWriter` writes starting from this
+    // position, without disturbing the current fd position.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_independent_pos(absl::optional<Position> independent_pos) & {
+      independent_pos_ = independent_pos;
+      return *this;
+    }
+    Options&& set_independent_pos(absl::optional<Position> independent_pos) && {
+      return std::move(set_independent_pos(independent_pos));
+    }
+    absl::optional<Position> independent_pos() const {
+      return independent_pos_;
+    }
+
+    // Tunes the minimum amount by which the file and the mapping grow when
+    // more space is needed. Later they grow by at least their current length,
+    // so that the number of `ftruncate()` and `mremap()` calls is logarithmic.
+    //
+    // Default: `kDefaultBufferSize` (64K).
+    Options& set_min_growth(Position min_growth) & {
+      min_growth_ = min_growth;
+      return *this;
+    }
+    Options&& set_min_growth(Position min_growth) && {
+      return std::move(set_min_growth(min_growth));
+    }
+    Position min_growth() const { return min_growth_; }
+
+   private:
+    absl::optional<std::string> assumed_filename_;
+    absl::optional<Position> independent_pos_;
+    Position min_growth_ = kDefaultBufferSize;
+  };
+
+  // Unmaps the file if the `FdMMapWriter` was not closed.
+  ~FdMMapWriterBase();
+
+  // Returns the fd being written to. If the fd is owned then changed to -1 by
+  // `Close()`, otherwise unchanged.
+  virtual int dest_fd() const = 0;
+
+  // Returns the original name of the file being written to. Unchanged by
+  // `Close()`.
+  const std::string& filename() const { return filename_; }
+
+  bool SupportsSize() override { return true; }
+  bool SupportsTruncate() override { return true; }
+
+ protected:
+  explicit FdMMapWriterBase(Closed) noexcept : Writer(kClosed) {}
+
+  explicit FdMMapWriterBase(bool has_independent_pos, Position min_growth);
+
+  FdMMapWriterBase(FdMMapWriterBase&& that) noexcept;
+  FdMMapWriterBase& operator=(FdMMapWriterBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(bool has_independent_pos, Position min_growth);
+  void Initialize(int dest, Options&& options);
+  int OpenFd(absl::string_view filename, int flags, mode_t permissions);
+  void InitializePos(int dest, const Options& options);
+  ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+
+  void Done() override;
+  absl::Status AnnotateStatusImpl(absl::Status status) override;
+  bool PushSlow(size_t min_length, size_t recommended_length) override;
+  bool FlushImpl(FlushType flush_type) override;
+  absl::optional<Position> SizeImpl() override;
+  bool TruncateImpl(Position new_size) override;
+
+ private:
+  // Resizes the file and the mapping so that they end at `new_end`, which must
+  // not be before `start_pos()`. Keeps `pos()` unchanged if possible.
+  void Unmap();
+  bool SyncPos();
+
+  std::string filename_;
+  bool has_independent_pos_ = false;
+  Position min_growth_ = kDefaultBufferSize;
+  // Length of the mapping beginning at `start()`, or 0 if nothing is mapped.
+  //
+  // The file ends at `start_pos() + mapping_size_` while the mapping exists,
+  // and at `pos()` otherwise.
+  size_t mapping_size_ = 0;
+
+  // Invariants if `is_open()`:
+  //   if `mapping_size_ == 0` then `start() == nullptr`
+  //   if `mapping_size_ > 0` then `start_to_limit() == mapping_size_`
+  //   `start_pos() % page size == 0` if `mapping_size_ > 0`
+};
+
+// A `Writer` which writes to a file descriptor by mapping the file to memory
+// and writing directly to the mapped pages. This avoids `write()` system calls
+// and copying, which is useful e.g. for handing data over to another process
+// through a file in "/dev/shm", to be read by `FdMMapReader`.
+//
+// The file grows in increments with `ftruncate()`, and the mapping grows with
+// `mremap()` (on Linux, otherwise it is mapped again). `Flush()` and `Close()`
+// truncate the file to the current position, so that data written after the
+// current position can be discarded with `Truncate()`, and data which were in
+// the file after the initial position are discarded.
+//
+// The fd must support:
+//  * `close()`     - if the fd is owned
+//  * `lseek()`     - if `Options::independent_pos() == absl::nullopt`
+//  * `ftruncate()`
+//  * `mmap()` with `PROT_WRITE` and `MAP_SHARED`
+//                    (fd must be opened with `O_RDWR`)
+//  * `msync()`     - for `Flush(FlushType::kFromMachine)`
+//  * `fsync()`     - for `Flush(FlushType::kFromMachine)`
+//
+// `FdMMapWriter` supports `Size()` and `Truncate()`, but not `Seek()` nor
+// `ReadMode()`.
+//
+// The `Dest` template parameter specifies the type of the object providing and
+// possibly owning the fd being written to. `Dest` must support
+// `Dependency<int, Dest>`, e.g. `OwnedFd` (owned, default), `UnownedFd`
+// (not owned).
+//
+// By relying on CTAD the template argument can be deduced as `OwnedFd` if the
+// first constructor argument is a filename or an `int`, otherwise as the value
+// type of the first constructor argument. This requires C++17.
+//
+// Until the `FdMMapWriter` is closed or no longer used, the fd must not be
+// closed, and the file must not be truncated by others: accessing a mapped
+// page beyond the end of the file raises `SIGBUS`.
+template <typename Dest = OwnedFd>
+class FdMMapWriter : public FdMMapWriterBase {
+ public:
+  // Creates a closed `FdMMapWriter`.
+  explicit FdMMapWriter(Closed) noexcept : FdMMapWriterBase(kClosed) {}
+
+  // Will write to the fd provided by `dest`.
+  explicit FdMMapWriter(const Dest& dest, Options options = Options());
+  explicit FdMMapWriter(Dest&& dest, Options options = Options());
+
+  // Will write to the fd provided by a `Dest` constructed from elements of
+  // `dest_args`. This avoids constructing a temporary `Dest` and moving from
+  // it.
+  template <typename... DestArgs>
+  explicit FdMMapWriter(std::tuple<DestArgs...> dest_args,
+                        Options options = Options());
+
+  // Opens a file for writing.
+  //
+  // `flags` is the second argument of `open()`, typically
+  // `O_RDWR | O_CREAT | O_TRUNC`.
+  //
+  // `flags` must include `O_RDWR`, because `mmap()` requires a readable fd.
+  //
+  // If opening the file fails, `FdMMapWriter` will be failed and closed.
+  explicit FdMMapWriter(absl::string_view filename, int flags,
+                        Options options = Options());
+
+  FdMMapWriter(FdMMapWriter&& that) noexcept;
+  FdMMapWriter& operator=(FdMMapWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `FdMMapWriter`. This avoids
+  // constructing a temporary `FdMMapWriter` and moving from it.
+  void Reset(Closed);
+  void Reset(const Dest& dest, Options options = Options());
+  void Reset(Dest&& dest, Options options = Options());
+  template <typename... DestArgs>
+  void Reset(std::tuple<DestArgs...> dest_args, Options options = Options());
+  void Reset(absl::string_view filename, int flags,
+             Options options = Options());
+
+  // Returns the object providing and possibly owning the fd being written to.
+  // If the fd is owned then changed to -1 by `Close()`, otherwise unchanged.
+  Dest& dest() { return dest_.manager(); }
+  const Dest& dest() const { return dest_.manager(); }
+  int dest_fd() const override { return dest_.get(); }
+
+ protected:
+  using FdMMapWriterBase::Initialize;
+  void Initialize(absl::string_view filename, int flags, Options&& options);
+
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the fd being written to.
+  Dependency<int, Dest> dest_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit FdMMapWriter(Closed)->FdMMapWriter<DeleteCtad<Closed>>;
+template <typename Dest>
+explicit FdMMapWriter(const Dest& dest, FdMMapWriterBase::Options options =
+                                            FdMMapWriterBase::Options())
+    -> FdMMapWriter<
+        std::conditional_t<std::is_convertible<const Dest&, int>::value,
+                           OwnedFd, std::decay_t<Dest>>>;
+template <typename Dest>
+explicit FdMMapWriter(Dest&& dest, FdMMapWriterBase::Options options =
+                                       FdMMapWriterBase::Options())
+    -> FdMMapWriter<std::conditional_t<std::is_convertible<Dest&&, int>::value,
+                                       OwnedFd, std::decay_t<Dest>>>;
+template <typename... DestArgs>
+explicit FdMMapWriter(
+    std::tuple<DestArgs...> dest_args,
+    FdMMapWriterBase::Options options = FdMMapWriterBase::Options())
+    -> FdMMapWriter<DeleteCtad<std::tuple<DestArgs...>>>;
+explicit FdMMapWriter(
+    absl::string_view filename, int flags,
+    FdMMapWriterBase::Options options = FdMMapWriterBase::Options())
+    ->FdMMapWriter<>;
+#endif
+
 // Implementation details follow.
 
-inline FdWriterBase::FdWriterBase(size_t buffer_size)
-    : BufferedWriter(buffer_size) {}
+inline FdWriterBase::FdWriterBase(size_t buffer_size, size_t io_uring_depth,
+                                  bool direct_io, FdSyncGroup* sync_group,
+                                  Position preallocate)
+    : internal::FdCopyWriterBase(buffer_size),
+      io_uring_depth_(io_uring_depth),
+      direct_io_(direct_io),
+      sync_group_(sync_group),
+      preallocate_(preallocate) {}
 
 inline FdWriterBase::FdWriterBase(FdWriterBase&& that) noexcept
-    : BufferedWriter(std::move(that)),
+    : internal::FdCopyWriterBase(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       filename_(std::move(that.filename_)),
@@ -370,10 +806,21 @@ inline FdWriterBase::FdWriterBase(FdWriterBase&& that) noexcept
       has_independent_pos_(that.has_independent_pos_),
       supports_read_mode_(that.supports_read_mode_),
       associated_reader_(std::move(that.associated_reader_)),
-      read_mode_(that.read_mode_) {}
+      read_mode_(that.read_mode_),
+      io_uring_depth_(that.io_uring_depth_),
+      io_uring_(std::move(that.io_uring_)),
+      io_uring_writes_(std::move(that.io_uring_writes_)),
+      io_uring_free_buffers_(std::move(that.io_uring_free_buffers_)),
+      direct_io_(that.direct_io_),
+      fd_had_direct_io_(that.fd_had_direct_io_),
+      direct_io_buffer_(std::move(that.direct_io_buffer_)),
+      direct_io_buffered_(that.direct_io_buffered_),
+      sync_group_(that.sync_group_),
+      preallocate_(that.preallocate_),
+      preallocated_end_(that.preallocated_end_) {}
 
 inline FdWriterBase& FdWriterBase::operator=(FdWriterBase&& that) noexcept {
-  BufferedWriter::operator=(std::move(that));
+  internal::FdCopyWriterBase::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   filename_ = std::move(that.filename_);
@@ -382,6 +829,17 @@ inline FdWriterBase& FdWriterBase::operator=(FdWriterBase&& that) noexcept {
   supports_read_mode_ = that.supports_read_mode_;
   associated_reader_ = std::move(that.associated_reader_);
   read_mode_ = that.read_mode_;
+  io_uring_depth_ = that.io_uring_depth_;
+  io_uring_ = std::move(that.io_uring_);
+  io_uring_writes_ = std::move(that.io_uring_writes_);
+  io_uring_free_buffers_ = std::move(that.io_uring_free_buffers_);
+  direct_io_ = that.direct_io_;
+  fd_had_direct_io_ = that.fd_had_direct_io_;
+  direct_io_buffer_ = std::move(that.direct_io_buffer_);
+  direct_io_buffered_ = that.direct_io_buffered_;
+  sync_group_ = that.sync_group_;
+  preallocate_ = that.preallocate_;
+  preallocated_end_ = that.preallocated_end_;
   return *this;
 }
 
@@ -393,9 +851,22 @@ inline void FdWriterBase::Reset(Closed) {
   supports_read_mode_ = false;
   associated_reader_.Reset();
   read_mode_ = false;
+  io_uring_depth_ = 0;
+  io_uring_.reset();
+  io_uring_writes_.clear();
+  io_uring_free_buffers_.clear();
+  direct_io_ = false;
+  fd_had_direct_io_ = false;
+  direct_io_buffer_ = internal::DirectIoBuffer();
+  direct_io_buffered_ = 0;
+  sync_group_ = nullptr;
+  preallocate_ = 0;
+  preallocated_end_ = 0;
 }
 
-inline void FdWriterBase::Reset(size_t buffer_size) {
+inline void FdWriterBase::Reset(size_t buffer_size, size_t io_uring_depth,
+                                bool direct_io, FdSyncGroup* sync_group,
+                                Position preallocate) {
   BufferedWriter::Reset(buffer_size);
   // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
   supports_random_access_ = LazyBoolState::kFalse;
@@ -403,18 +874,35 @@ inline void FdWriterBase::Reset(size_t buffer_size) {
   supports_read_mode_ = false;
   associated_reader_.Reset();
   read_mode_ = false;
+  io_uring_depth_ = io_uring_depth;
+  io_uring_.reset();
+  io_uring_writes_.clear();
+  io_uring_free_buffers_.clear();
+  direct_io_ = direct_io;
+  fd_had_direct_io_ = false;
+  direct_io_buffer_ = internal::DirectIoBuffer();
+  direct_io_buffered_ = 0;
+  sync_group_ = sync_group;
+  preallocate_ = preallocate;
+  preallocated_end_ = 0;
 }
 
 template <typename Dest>
 inline FdWriter<Dest>::FdWriter(const Dest& dest, Options options)
-    : FdWriterBase(options.buffer_size()), dest_(dest) {
+    : FdWriterBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io(), options.sync_group(),
+                   options.preallocate()),
+      dest_(dest) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
 
 template <typename Dest>
 inline FdWriter<Dest>::FdWriter(Dest&& dest, Options options)
-    : FdWriterBase(options.buffer_size()), dest_(std::move(dest)) {
+    : FdWriterBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io(), options.sync_group(),
+                   options.preallocate()),
+      dest_(std::move(dest)) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -423,7 +911,10 @@ template <typename Dest>
 template <typename... DestArgs>
 inline FdWriter<Dest>::FdWriter(std::tuple<DestArgs...> dest_args,
                                 Options options)
-    : FdWriterBase(options.buffer_size()), dest_(std::move(dest_args)) {
+    : FdWriterBase(options.buffer_size(), options.io_uring_depth(),
+                   options.direct_io(), options.sync_group(),
+                   options.preallocate()),
+      dest_(std::move(dest_args)) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -459,7 +950,9 @@ inline void FdWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void FdWriter<Dest>::Reset(const Dest& dest, Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io(), options.sync_group(),
+                      options.preallocate());
   dest_.Reset(dest);
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -467,7 +960,9 @@ inline void FdWriter<Dest>::Reset(const Dest& dest, Options options) {
 
 template <typename Dest>
 inline void FdWriter<Dest>::Reset(Dest&& dest, Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io(), options.sync_group(),
+                      options.preallocate());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -477,7 +972,9 @@ template <typename Dest>
 template <typename... DestArgs>
 inline void FdWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                   Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io(), options.sync_group(),
+                      options.preallocate());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -495,7 +992,9 @@ void FdWriter<Dest>::Initialize(absl::string_view filename, int flags,
                                 Options&& options) {
   const int dest = OpenFd(filename, flags, options.permissions());
   if (ABSL_PREDICT_FALSE(dest < 0)) return;
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.io_uring_depth(),
+                      options.direct_io(), options.sync_group(),
+                      options.preallocate());
   dest_.Reset(std::forward_as_tuple(dest));
   InitializePos(dest_.get(), flags, options.assumed_pos(),
                 options.independent_pos());
@@ -513,6 +1012,163 @@ void FdWriter<Dest>::Done() {
   }
 }
 
+inline FdMMapWriterBase::FdMMapWriterBase(bool has_independent_pos,
+                                          Position min_growth)
+    : has_independent_pos_(has_independent_pos), min_growth_(min_growth) {}
+
+inline FdMMapWriterBase::~FdMMapWriterBase() { Unmap(); }
+
+inline FdMMapWriterBase::FdMMapWriterBase(FdMMapWriterBase&& that) noexcept
+    : Writer(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      filename_(std::move(that.filename_)),
+      has_independent_pos_(that.has_independent_pos_),
+      min_growth_(that.min_growth_),
+      mapping_size_(std::exchange(that.mapping_size_, 0)) {}
+
+inline FdMMapWriterBase& FdMMapWriterBase::operator=(
+    FdMMapWriterBase&& that) noexcept {
+  Unmap();
+  Writer::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  filename_ = std::move(that.filename_);
+  has_independent_pos_ = that.has_independent_pos_;
+  min_growth_ = that.min_growth_;
+  mapping_size_ = std::exchange(that.mapping_size_, 0);
+  return *this;
+}
+
+inline void FdMMapWriterBase::Reset(Closed) {
+  Unmap();
+  Writer::Reset(kClosed);
+  filename_ = std::string();
+  has_independent_pos_ = false;
+  min_growth_ = kDefaultBufferSize;
+}
+
+inline void FdMMapWriterBase::Reset(bool has_independent_pos,
+                                    Position min_growth) {
+  Unmap();
+  Writer::Reset();
+  // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
+  has_independent_pos_ = has_independent_pos;
+  min_growth_ = min_growth;
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(const Dest& dest, Options options)
+    : FdMMapWriterBase(options.independent_pos() != absl::nullopt,
+                       options.min_growth()),
+      dest_(dest) {
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(Dest&& dest, Options options)
+    : FdMMapWriterBase(options.independent_pos() != absl::nullopt,
+                       options.min_growth()),
+      dest_(std::move(dest)) {
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline FdMMapWriter<Dest>::FdMMapWriter(std::tuple<DestArgs...> dest_args,
+                                        Options options)
+    : FdMMapWriterBase(options.independent_pos() != absl::nullopt,
+                       options.min_growth()),
+      dest_(std::move(dest_args)) {
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(absl::string_view filename, int flags,
+                                        Options options)
+    : FdMMapWriterBase(kClosed) {
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(FdMMapWriter&& that) noexcept
+    : FdMMapWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      dest_(std::move(that.dest_)) {}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>& FdMMapWriter<Dest>::operator=(
+    FdMMapWriter&& that) noexcept {
+  FdMMapWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  dest_ = std::move(that.dest_);
+  return *this;
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(Closed) {
+  FdMMapWriterBase::Reset(kClosed);
+  dest_.Reset();
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(const Dest& dest, Options options) {
+  FdMMapWriterBase::Reset(options.independent_pos() != absl::nullopt,
+                          options.min_growth());
+  dest_.Reset(dest);
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(Dest&& dest, Options options) {
+  FdMMapWriterBase::Reset(options.independent_pos() != absl::nullopt,
+                          options.min_growth());
+  dest_.Reset(std::move(dest));
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline void FdMMapWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
+                                      Options options) {
+  FdMMapWriterBase::Reset(options.independent_pos() != absl::nullopt,
+                          options.min_growth());
+  dest_.Reset(std::move(dest_args));
+  Initialize(dest_.get(), std::move(options));
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(absl::string_view filename, int flags,
+                                      Options options) {
+  Reset(kClosed);
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Dest>
+void FdMMapWriter<Dest>::Initialize(absl::string_view filename, int flags,
+                                    Options&& options) {
+  const int dest = OpenFd(filename, flags, 0666);
+  if (ABSL_PREDICT_FALSE(dest < 0)) return;
+  FdMMapWriterBase::Reset(options.independent_pos() != absl::nullopt,
+                          options.min_growth());
+  dest_.Reset(std::forward_as_tuple(dest));
+  InitializePos(dest_.get(), options);
+}
+
+template <typename Dest>
+void FdMMapWriter<Dest>::Done() {
+  FdMMapWriterBase::Done();
+  if (dest_.is_owning()) {
+    const int dest = dest_.Release();
+    if (ABSL_PREDICT_FALSE(internal::CloseFd(dest) < 0) &&
+        ABSL_PREDICT_TRUE(healthy())) {
+      FailOperation(internal::kCloseFunctionName);
+    }
+  }
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_BYTES_FD_WRITER_H_
@@ -17,7 +17,11 @@
 
 #include <stddef.h>
 
+#include <deque>
+#include <functional>
+#include <future>
 #include <limits>
+#include <utility>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -27,6 +31,7 @@
 #include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -35,11 +40,70 @@ namespace riegeli {
 
 // Template parameter independent part of `JoiningReader`.
 class JoiningReaderBase : public PullableReader {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Maximum number of following shards being opened ahead at a time.
+    //
+    // If 0, each shard is opened when the previous shard is exhausted.
+    //
+    // If greater than 0, following shards are opened, and their first buffer
+    // is read, using tasks scheduled on `executor()` while the current shard
+    // is being read. This hides the latency of opening shards, e.g. of many
+    // small files on remote storage, at the cost of more open shards and
+    // their buffers.
+    //
+    // This applies to shards opened by `JoiningReader::ShardOpener()`.
+    //
+    // Default: 0.
+    Options& set_shards_ahead(size_t shards_ahead) & {
+      shards_ahead_ = shards_ahead;
+      return *this;
+    }
+    Options&& set_shards_ahead(size_t shards_ahead) && {
+      return std::move(set_shards_ahead(shards_ahead));
+    }
+    size_t shards_ahead() const { return shards_ahead_; }
+
+    // The `Executor` opening shards ahead if `shards_ahead() > 0`, or
+    // `nullptr` for the thread pool shared by all parallel operations of
+    // Riegeli.
+    //
+    // The `Executor` must outlive the `JoiningReader`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+   private:
+    size_t shards_ahead_ = 0;
+    Executor* executor_ = nullptr;
+  };
+
  protected:
-  using PullableReader::PullableReader;
+  explicit JoiningReaderBase(Closed) noexcept : PullableReader(kClosed) {}
+
+  explicit JoiningReaderBase(const Options& options = Options());
+
+  void Reset(Closed);
+  void Reset(const Options& options = Options());
 
   void Done() override;
 
+  // Returns `Options::shards_ahead()`.
+  size_t shards_ahead() const { return shards_ahead_; }
+
+  // Returns the `Executor` opening shards ahead.
+  Executor& executor() const;
+
   // Returns the shard `Reader`.
   virtual Reader* shard_reader() = 0;
   virtual const Reader* shard_reader() const = 0;
@@ -55,9 +119,14 @@ class JoiningReaderBase : public PullableReader {
   //  * `false` (when `healthy()`)  - there is no next shard
   //  * `false` (when `!healthy()`) - failure
   //
-  // `OpenShardImpl()` must be overridden but should not be called directly
-  // because it does not synchronize buffer pointers of `*this` with
-  // `*shard_reader()`. See `OpenShard()` for that.
+  // `JoiningReader::OpenShardImpl()` opens shards returned by
+  // `JoiningReader::ShardOpener()`. `OpenShardImpl()` can be overridden instead
+  // of that, e.g. if shards are not known ahead, but then shards are not
+  // opened ahead.
+  //
+  // `OpenShardImpl()` should not be called directly because it does not
+  // synchronize buffer pointers of `*this` with `*shard_reader()`. See
+  // `OpenShard()` for that.
   virtual bool OpenShardImpl() = 0;
 
   // Closes `shard()`.
@@ -138,6 +207,9 @@ class JoiningReaderBase : public PullableReader {
   template <typename Dest>
   bool ReadInternal(size_t length, Dest& dest);
 
+  size_t shards_ahead_ = 0;
+  Executor* executor_ = nullptr;
+
   // Invariants if `is_open()` and scratch is not used:
   //   `start() == (shard_is_open() ? shard_reader()->cursor() : nullptr)`
   //   `limit() <= (shard_is_open() ? shard_reader()->limit() : nullptr)`
@@ -162,10 +234,27 @@ class JoiningReader : public JoiningReaderBase {
   // Derived classes which override `Reset()` should include a call to
   // `JoiningReader::Reset()`.
   void Reset(Closed);
-  void Reset();
+  void Reset(const Options& options = Options());
 
   void Done() override;
 
+  // Returns a function opening the shard with the given `index`, counting
+  // from 0, or `nullptr` if there is no such shard.
+  //
+  // Unless `OpenShardImpl()` is overridden, the returned function is called
+  // to open the shard, in the current thread if `shards_ahead() == 0`,
+  // otherwise ahead in a task scheduled on `executor()`. Hence the function
+  // must not refer to `*this`. A failure to open the shard should be reported
+  // by returning a failed `Reader`, like a constructor of a `Reader` does.
+  //
+  // `ShardOpener()` itself is called in the current thread, for consecutive
+  // indices.
+  //
+  // The default implementation returns `nullptr`.
+  virtual std::function<Shard()> ShardOpener(size_t index);
+
+  bool OpenShardImpl() override;
+
   // Returns the object providing and possibly owning the shard `Reader`.
   Shard& shard() { return shard_.manager(); }
   const Shard& shard() const { return shard_.manager(); }
@@ -175,12 +264,40 @@ class JoiningReader : public JoiningReaderBase {
  private:
   void MoveShard(JoiningReader&& that);
 
+  // Schedules opening shards ahead until `shards_ahead()` shards are pending,
+  // or there are no more shards.
+  void ScheduleShardsAhead();
+
   // The object providing and possibly owning the shard `Reader`.
   Dependency<Reader*, Shard> shard_;
+  // The index of the next shard to pass to `ShardOpener()`.
+  size_t next_shard_index_ = 0;
+  // Shards being opened ahead or waiting to be read, in order, if
+  // `shards_ahead() > 0`.
+  std::deque<std::future<Dependency<Reader*, Shard>>> shards_opened_ahead_;
 };
 
 // Implementation details follow.
 
+inline JoiningReaderBase::JoiningReaderBase(const Options& options)
+    : shards_ahead_(options.shards_ahead()), executor_(options.executor()) {}
+
+inline void JoiningReaderBase::Reset(Closed) {
+  PullableReader::Reset(kClosed);
+  shards_ahead_ = 0;
+  executor_ = nullptr;
+}
+
+inline void JoiningReaderBase::Reset(const Options& options) {
+  PullableReader::Reset();
+  shards_ahead_ = options.shards_ahead();
+  executor_ = options.executor();
+}
+
+inline Executor& JoiningReaderBase::executor() const {
+  return executor_ == nullptr ? internal::ThreadPool::global() : *executor_;
+}
+
 inline bool JoiningReaderBase::shard_is_open() const {
   return shard_is_open(shard_reader());
 }
@@ -213,9 +330,11 @@ inline void JoiningReaderBase::MakeBuffer(Reader& shard) {
 
 template <typename Shard>
 inline JoiningReader<Shard>::JoiningReader(JoiningReader&& that) noexcept
-    : JoiningReaderBase(std::move(that)) {
-  // Using `that` after it was moved is correct because only the base class part
-  // was moved.
+    : JoiningReaderBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      next_shard_index_(std::exchange(that.next_shard_index_, 0)),
+      shards_opened_ahead_(std::move(that.shards_opened_ahead_)) {
   MoveShard(std::move(that));
 }
 
@@ -226,6 +345,8 @@ inline JoiningReader<Shard>& JoiningReader<Shard>::operator=(
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   MoveShard(std::move(that));
+  next_shard_index_ = std::exchange(that.next_shard_index_, 0);
+  shards_opened_ahead_ = std::move(that.shards_opened_ahead_);
   return *this;
 }
 
@@ -233,18 +354,74 @@ template <typename Shard>
 inline void JoiningReader<Shard>::Reset(Closed) {
   JoiningReaderBase::Reset(kClosed);
   shard_.Reset();
+  next_shard_index_ = 0;
+  shards_opened_ahead_.clear();
 }
 
 template <typename Shard>
-inline void JoiningReader<Shard>::Reset() {
-  JoiningReaderBase::Reset();
+inline void JoiningReader<Shard>::Reset(const Options& options) {
+  JoiningReaderBase::Reset(options);
   shard_.Reset();
+  next_shard_index_ = 0;
+  shards_opened_ahead_.clear();
 }
 
 template <typename Shard>
 void JoiningReader<Shard>::Done() {
   JoiningReaderBase::Done();
   shard_.Reset();
+  // Shards still being opened ahead are closed by their tasks.
+  shards_opened_ahead_.clear();
+}
+
+template <typename Shard>
+std::function<Shard()> JoiningReader<Shard>::ShardOpener(
+    ABSL_ATTRIBUTE_UNUSED size_t index) {
+  return nullptr;
+}
+
+template <typename Shard>
+bool JoiningReader<Shard>::OpenShardImpl() {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of JoiningReaderBase::OpenShardImpl(): "
+      << status();
+  RIEGELI_ASSERT(!shard_is_open())
+      << "Failed precondition of JoiningReaderBase::OpenShardImpl(): "
+         "shard already opened";
+  if (shards_ahead() == 0) {
+    const std::function<Shard()> opener = ShardOpener(next_shard_index_);
+    if (opener == nullptr) return false;
+    ++next_shard_index_;
+    shard_.Reset(opener());
+    return true;
+  }
+  ScheduleShardsAhead();
+  if (shards_opened_ahead_.empty()) return false;
+  shard_ = shards_opened_ahead_.front().get();
+  shards_opened_ahead_.pop_front();
+  // Keep opening shards ahead while the current shard is being read.
+  ScheduleShardsAhead();
+  return true;
+}
+
+template <typename Shard>
+void JoiningReader<Shard>::ScheduleShardsAhead() {
+  while (shards_opened_ahead_.size() < shards_ahead()) {
+    std::function<Shard()> opener = ShardOpener(next_shard_index_);
+    if (opener == nullptr) return;
+    ++next_shard_index_;
+    std::promise<Dependency<Reader*, Shard>>* const shard_promise =
+        new std::promise<Dependency<Reader*, Shard>>();
+    shards_opened_ahead_.push_back(shard_promise->get_future());
+    executor().Schedule([shard_promise, opener = std::move(opener)] {
+      Dependency<Reader*, Shard> shard(opener());
+      // Read the first buffer ahead too. A failure is reported when the shard
+      // is read.
+      shard.get()->Pull();
+      shard_promise->set_value(std::move(shard));
+      delete shard_promise;
+    });
+  }
 }
 
 template <typename Shard>
@@ -192,6 +192,22 @@ void LimitingReaderBase::ReadHintSlow(size_t length) {
   MakeBuffer(src);
 }
 
+void LimitingReaderBase::SetAccessPatternImpl(AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  src_reader()->SetAccessPattern(access_pattern);
+}
+
+void LimitingReaderBase::WillNeedImpl(Position length) {
+  RIEGELI_ASSERT_LE(pos(), max_pos_)
+      << "Failed invariant of LimitingReaderBase: "
+         "position already exceeds its limit";
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  SyncBuffer(src);
+  src.WillNeed(UnsignedMin(length, max_pos_ - pos()));
+  MakeBuffer(src);
+}
+
 bool LimitingReaderBase::SupportsRandomAccess() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRandomAccess();
@@ -151,6 +151,20 @@ bool LimitingWriterBase::WriteZerosSlow(Position length) {
   return ok;
 }
 
+void LimitingWriterBase::SetWriteSizeHintImpl(
+    absl::optional<Position> write_size_hint) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Writer& dest = *dest_writer();
+  if (ABSL_PREDICT_FALSE(!SyncBuffer(dest))) return;
+  if (write_size_hint != absl::nullopt) {
+    write_size_hint = UnsignedMin(*write_size_hint, max_pos_ - pos());
+  } else if (exact_) {
+    write_size_hint = max_pos_ - pos();
+  }
+  dest.SetWriteSizeHint(write_size_hint);
+  MakeBuffer(dest);
+}
+
 bool LimitingWriterBase::SupportsRandomAccess() {
   Writer* const dest = dest_writer();
   return dest != nullptr && dest->SupportsRandomAccess();
@@ -170,6 +170,7 @@ class LimitingWriterBase : public Writer {
   bool WriteSlow(const absl::Cord& src) override;
   bool WriteSlow(absl::Cord&& src) override;
   bool WriteZerosSlow(Position length) override;
+  void SetWriteSizeHintImpl(absl::optional<Position> write_size_hint) override;
   bool SeekSlow(Position new_pos) override;
   absl::optional<Position> SizeImpl() override;
   bool TruncateImpl(Position new_size) override;
@@ -151,6 +151,20 @@ void PrefixLimitingReaderBase::ReadHintSlow(size_t length) {
   MakeBuffer(src);
 }
 
+void PrefixLimitingReaderBase::SetAccessPatternImpl(
+    AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  src_reader()->SetAccessPattern(access_pattern);
+}
+
+void PrefixLimitingReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  SyncBuffer(src);
+  src.WillNeed(length);
+  MakeBuffer(src);
+}
+
 bool PrefixLimitingReaderBase::SupportsRandomAccess() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRandomAccess();
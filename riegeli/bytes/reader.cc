@@ -32,6 +32,7 @@
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/writer.h"
@@ -136,6 +137,7 @@ bool Reader::ReadSlow(size_t length, Chain& dest) {
          "Chain size overflow";
   do {
     const absl::Span<char> buffer = dest.AppendBuffer(1, length, length);
+    internal::CountCopied(buffer.size());
     const Position pos_before = pos();
     if (ABSL_PREDICT_FALSE(!Read(buffer.size(), buffer.data()))) {
       RIEGELI_ASSERT_GE(pos(), pos_before)
@@ -162,6 +164,7 @@ bool Reader::ReadSlow(size_t length, absl::Cord& dest) {
   do {
     buffer.Reset(UnsignedMin(length, kMaxBufferSize));
     const size_t length_to_read = UnsignedMin(length, buffer.capacity());
+    internal::CountCopied(length_to_read);
     const Position pos_before = pos();
     if (ABSL_PREDICT_FALSE(!Read(length_to_read, buffer.data()))) {
       RIEGELI_ASSERT_GE(pos(), pos_before)
@@ -234,6 +237,10 @@ void Reader::ReadHintSlow(size_t length) {
          "enough data available, use ReadHint() instead";
 }
 
+void Reader::SetAccessPatternImpl(AccessPattern access_pattern) {}
+
+void Reader::WillNeedImpl(Position length) {}
+
 bool Reader::ReadAll(absl::string_view& dest, size_t max_length) {
   max_length = UnsignedMin(max_length, dest.max_size());
   if (SupportsSize()) {
@@ -31,6 +31,7 @@
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/object.h"
 
 namespace riegeli {
@@ -38,6 +39,20 @@ namespace riegeli {
 class BackwardWriter;
 class Writer;
 
+// The expected pattern of reading from a `Reader`, as hinted by
+// `Reader::SetAccessPattern()`.
+enum class AccessPattern {
+  // No particular pattern. This is the default.
+  kNormal,
+  // Data will be read sequentially, mostly without seeking. Data far ahead of
+  // the current position are worth prefetching, and data behind the current
+  // position are unlikely to be needed again.
+  kSequential,
+  // Data will be read after seeking to unpredictable positions. Prefetching
+  // data ahead of the current position is likely wasteful.
+  kRandom,
+};
+
 // Abstract class `Reader` reads sequences of bytes from a source. The nature of
 // the source depends on the particular class derived from `Reader`.
 //
@@ -47,6 +62,13 @@ class Writer;
 // by allocating the buffer in a way which fits the source, e.g. pointing it to
 // a fragment of the source itself.
 //
+// Reading functions like `Pull()`, `ReadByte()`, and `Read()` are inline and
+// non-virtual: while the buffer suffices they only compare and advance
+// pointers, whatever the class derived from `Reader` is. Virtual functions like
+// `PullSlow()` are called only when the buffer is exhausted, which for
+// `StringReader` and for `ChainReader` happens at most once per string or per
+// `Chain` block.
+//
 // All `Reader`s support reading data sequentially and querying for the current
 // position. Some `Reader`s also support random access: changing the position
 // backwards for subsequent operations and querying for the total size of the
@@ -197,6 +219,20 @@ class Reader : public Object {
   // into an internal buffer.
   void ReadHint(size_t length);
 
+  // Hints the expected pattern of subsequent reading.
+  //
+  // This does not change the results of reading, but can make it faster, e.g.
+  // by advising the kernel how to cache the file being read.
+  void SetAccessPattern(AccessPattern access_pattern);
+
+  // Hints that `length` bytes following the current position will be needed
+  // soon.
+  //
+  // Unlike `ReadHint()`, this does not wait for the data nor hold them in an
+  // internal buffer. It can make later reading faster by starting to prefetch
+  // the data in the background, e.g. by the kernel.
+  void WillNeed(Position length);
+
   // Reads all remaining bytes from the buffer and/or the source to `dest`,
   // clearing any existing data in `dest`.
   //
@@ -457,6 +493,16 @@ class Reader : public Object {
   // Precondition: `length > available()`
   virtual void ReadHintSlow(size_t length);
 
+  // Implementation of `SetAccessPattern()`.
+  //
+  // By default does nothing.
+  virtual void SetAccessPatternImpl(AccessPattern access_pattern);
+
+  // Implementation of `WillNeed()`.
+  //
+  // By default does nothing.
+  virtual void WillNeedImpl(Position length);
+
   // Implementation of `Sync()`, except that the parameter is not defaulted,
   // which is problematic for virtual functions.
   //
@@ -547,6 +593,7 @@ inline bool Reader::VerifyEndAndClose() {
 
 inline bool Reader::Pull(size_t min_length, size_t recommended_length) {
   if (ABSL_PREDICT_TRUE(available() >= min_length)) return true;
+  internal::CountPullSlow();
   if (ABSL_PREDICT_FALSE(!PullSlow(min_length, recommended_length))) {
     return false;
   }
@@ -630,6 +677,7 @@ inline bool Reader::Read(size_t length, std::string& dest) {
 inline bool Reader::Read(size_t length, Chain& dest) {
   dest.Clear();
   if (ABSL_PREDICT_TRUE(available() >= length && length <= kMaxBytesToCopy)) {
+    internal::CountCopied(length);
     dest.Append(absl::string_view(cursor(), length));
     move_cursor(length);
     return true;
@@ -664,6 +712,7 @@ inline bool Reader::ReadAndAppend(size_t length, Chain& dest) {
       << "Failed precondition of Reader::ReadAndAppend(Chain*): "
          "Chain size overflow";
   if (ABSL_PREDICT_TRUE(available() >= length && length <= kMaxBytesToCopy)) {
+    internal::CountCopied(length);
     dest.Append(absl::string_view(cursor(), length));
     move_cursor(length);
     return true;
@@ -688,6 +737,15 @@ inline void Reader::ReadHint(size_t length) {
   ReadHintSlow(length);
 }
 
+inline void Reader::SetAccessPattern(AccessPattern access_pattern) {
+  SetAccessPatternImpl(access_pattern);
+}
+
+inline void Reader::WillNeed(Position length) {
+  if (length == 0) return;
+  WillNeedImpl(length);
+}
+
 inline bool Reader::Sync(SyncType sync_type) { return SyncImpl(sync_type); }
 
 inline Position Reader::pos() const {
@@ -0,0 +1,98 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/string_reader.h"
+
+namespace riegeli {
+namespace {
+
+// The amount of data read by one iteration.
+constexpr size_t kTotalSize = size_t{1} << 20;
+
+// Reads all of `src` in pieces of `length` bytes with `Pull()`.
+void PullAll(Reader& src, size_t length) {
+  while (src.Pull(length)) {
+    benchmark::DoNotOptimize(*src.cursor());
+    src.move_cursor(length);
+  }
+}
+
+// Pulls pieces of `state.range(0)` bytes from a flat `StringReader`, where
+// `Pull()` is served from the buffer.
+void BM_StringReaderPull(benchmark::State& state) {
+  const size_t length = static_cast<size_t>(state.range(0));
+  const std::string data(kTotalSize, 'x');
+  for (auto _ : state) {
+    StringReader<> reader(data);
+    PullAll(reader, length);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kTotalSize));
+}
+BENCHMARK(BM_StringReaderPull)->RangeMultiplier(4)->Range(1, 4 << 10);
+
+// Pulls pieces of `state.range(0)` bytes from a `ChainReader` over blocks of
+// `state.range(1)` bytes. Pieces crossing block boundaries go through
+// `PullSlow()`, which copies them to a scratch buffer.
+void BM_ChainReaderPull(benchmark::State& state) {
+  const size_t length = static_cast<size_t>(state.range(0));
+  const size_t block_size = static_cast<size_t>(state.range(1));
+  Chain data;
+  const std::string block(block_size, 'x');
+  for (size_t size = 0; size < kTotalSize; size += block_size) {
+    // Appending a `Chain` keeps block boundaries for blocks which are not
+    // tiny.
+    data.Append(Chain(block));
+  }
+  for (auto _ : state) {
+    ChainReader<> reader(&data);
+    PullAll(reader, length);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(data.size()));
+}
+BENCHMARK(BM_ChainReaderPull)
+    ->ArgsProduct({{1, 16, 256, 4 << 10}, {4 << 10, 64 << 10}});
+
+// Reads pieces of `state.range(0)` bytes with `Read()` as `absl::string_view`
+// from a `ChainReader` over blocks of 4K.
+void BM_ChainReaderReadStringView(benchmark::State& state) {
+  const size_t length = static_cast<size_t>(state.range(0));
+  Chain data;
+  const std::string block(4 << 10, 'x');
+  for (size_t size = 0; size < kTotalSize; size += block.size()) {
+    data.Append(Chain(block));
+  }
+  for (auto _ : state) {
+    ChainReader<> reader(&data);
+    absl::string_view piece;
+    while (reader.Read(length, piece)) benchmark::DoNotOptimize(piece.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(data.size()));
+}
+BENCHMARK(BM_ChainReaderReadStringView)->RangeMultiplier(4)->Range(1, 4 << 10);
+
+}  // namespace
+}  // namespace riegeli
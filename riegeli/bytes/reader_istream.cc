@@ -96,6 +96,28 @@ std::streamsize ReaderStreambuf::xsgetn(char* dest, std::streamsize length) {
   return length;
 }
 
+int ReaderStreambuf::pbackfail(int ch) {
+  // The get area is the buffer of `*reader_`, so `unget()` and `putback()` at
+  // its beginning step back in `*reader_`, which works if the previous data
+  // are still buffered or `reader_->SupportsRewind()`.
+  if (ABSL_PREDICT_FALSE(!healthy())) return traits_type::eof();
+  BufferSync buffer_sync(this);
+  const Position pos = reader_->pos();
+  if (ABSL_PREDICT_FALSE(pos == 0)) return traits_type::eof();
+  if (ABSL_PREDICT_FALSE(!reader_->Seek(pos - 1) || !reader_->Pull())) {
+    if (ABSL_PREDICT_FALSE(!reader_->healthy())) Fail();
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof()) &&
+      ABSL_PREDICT_FALSE(!traits_type::eq_int_type(
+          ch, traits_type::to_int_type(*reader_->cursor())))) {
+    // The data are read-only, so a different character cannot be put back.
+    reader_->move_cursor(1);
+    return traits_type::eof();
+  }
+  return traits_type::to_int_type(*reader_->cursor());
+}
+
 std::streampos ReaderStreambuf::seekoff(std::streamoff off,
                                         std::ios_base::seekdir dir,
                                         std::ios_base::openmode which) {
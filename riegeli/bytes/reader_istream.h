@@ -58,6 +58,7 @@ class ReaderStreambuf : public std::streambuf {
   std::streamsize showmanyc() override;
   int underflow() override;
   std::streamsize xsgetn(char* dest, std::streamsize length) override;
+  int pbackfail(int ch) override;
   std::streampos seekoff(std::streamoff off, std::ios_base::seekdir dir,
                          std::ios_base::openmode which) override;
   std::streampos seekpos(std::streampos pos,
@@ -0,0 +1,119 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/bytes/socket_reader.h"
+
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <limits>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/errno_mapping.h"
+#include "riegeli/base/io_stats.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t SocketReaderBase::kDefaultSocketBufferSize;
+#endif
+
+void SocketReaderBase::Initialize(int src) {
+  RIEGELI_ASSERT_GE(src, 0)
+      << "Failed precondition of SocketReader: negative file descriptor";
+}
+
+bool SocketReaderBase::FailOperation(absl::string_view operation) {
+  const int error_number = errno;
+  RIEGELI_ASSERT_NE(error_number, 0)
+      << "Failed precondition of SocketReaderBase::FailOperation(): "
+         "zero errno";
+  return Fail(
+      ErrnoToCanonicalStatus(error_number, absl::StrCat(operation, " failed")));
+}
+
+SocketReaderBase::PullResult SocketReaderBase::TryPull(
+    size_t min_length, size_t recommended_length) {
+  if (ABSL_PREDICT_TRUE(available() >= min_length)) return PullResult::kReady;
+  non_blocking_ = true;
+  would_block_ = false;
+  const bool ok = Pull(min_length, recommended_length);
+  non_blocking_ = false;
+  if (ABSL_PREDICT_TRUE(ok)) return PullResult::kReady;
+  if (would_block_) {
+    would_block_ = false;
+    return PullResult::kWouldBlock;
+  }
+  return PullResult::kEnd;
+}
+
+bool SocketReaderBase::ReadInternal(size_t min_length, size_t max_length,
+                                    char* dest) {
+  RIEGELI_ASSERT_GT(min_length, 0u)
+      << "Failed precondition of BufferedReader::ReadInternal(): "
+         "nothing to read";
+  RIEGELI_ASSERT_GE(max_length, min_length)
+      << "Failed precondition of BufferedReader::ReadInternal(): "
+         "max_length < min_length";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of BufferedReader::ReadInternal(): " << status();
+  const int src = src_fd();
+  if (ABSL_PREDICT_FALSE(max_length >
+                         std::numeric_limits<Position>::max() - limit_pos())) {
+    return FailOverflow();
+  }
+  for (;;) {
+    struct iovec iov;
+    iov.iov_base = dest;
+    iov.iov_len =
+        UnsignedMin(max_length, size_t{std::numeric_limits<ssize_t>::max()});
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+  again:
+    const ssize_t length_read =
+        recvmsg(src, &message, non_blocking_ ? MSG_DONTWAIT : 0);
+    if (ABSL_PREDICT_FALSE(length_read < 0)) {
+      if (errno == EINTR) goto again;
+      if (non_blocking_ && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Not a failure: keep data received so far and let the caller wait.
+        would_block_ = true;
+        return false;
+      }
+      return FailOperation("recvmsg()");
+    }
+    internal::CountSyscall(IoStats::Syscall::kRead,
+                           IntCast<size_t>(length_read));
+    if (ABSL_PREDICT_FALSE(length_read == 0)) return false;
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_read), max_length)
+        << "recvmsg() read more than requested";
+    move_limit_pos(IntCast<size_t>(length_read));
+    if (IntCast<size_t>(length_read) >= min_length) return true;
+    dest += length_read;
+    min_length -= IntCast<size_t>(length_read);
+    max_length -= IntCast<size_t>(length_read);
+  }
+}
+
+}  // namespace riegeli
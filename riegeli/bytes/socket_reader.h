@@ -0,0 +1,302 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_SOCKET_READER_H_
+#define RIEGELI_BYTES_SOCKET_READER_H_
+
+#include <stddef.h>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/buffered_reader.h"
+#include "riegeli/bytes/fd_dependency.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `SocketReader`.
+class SocketReaderBase : public BufferedReader {
+ public:
+  // The default buffer size of `SocketReader`. It is larger than
+  // `kDefaultBufferSize` because a single `recvmsg()` from a fast connection
+  // can return more data than a file read is typically asked for.
+  static constexpr size_t kDefaultSocketBufferSize = size_t{256} << 10;
+
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Tunes how much data is buffered after receiving from the socket.
+    //
+    // Each `recvmsg()` receives whatever data arrived, up to the free space in
+    // the buffer, so a large buffer lets a busy connection be drained with few
+    // system calls. Reading a large enough array bypasses the buffer.
+    //
+    // Default: `kDefaultSocketBufferSize` (256K).
+    Options& set_buffer_size(size_t buffer_size) & {
+      RIEGELI_ASSERT_GT(buffer_size, 0u)
+          << "Failed precondition of "
+             "SocketReaderBase::Options::set_buffer_size(): "
+             "zero buffer size";
+      buffer_size_ = buffer_size;
+      return *this;
+    }
+    Options&& set_buffer_size(size_t buffer_size) && {
+      return std::move(set_buffer_size(buffer_size));
+    }
+    size_t buffer_size() const { return buffer_size_; }
+
+   private:
+    size_t buffer_size_ = kDefaultSocketBufferSize;
+  };
+
+  // Result of `TryPull()`.
+  enum class PullResult {
+    // `available() >= min_length`.
+    kReady,
+    // Not enough data has arrived yet. Data received so far are kept in the
+    // buffer. Wait until `src_fd()` is readable, e.g. with `poll()` or by
+    // registering it with an event loop, and call `TryPull()` again.
+    kWouldBlock,
+    // `Pull()` would return `false`: the source ends before `min_length`
+    // (if `healthy()`) or the `SocketReader` failed (if `!healthy()`).
+    kEnd,
+  };
+
+  // Like `Pull()`, but does not wait for data to arrive.
+  //
+  // This lets a single thread serve many connections from an event loop or
+  // a coroutine scheduler: await readability of `src_fd()` until `TryPull()`
+  // returns `kReady` with enough data buffered for a unit of work (e.g. a
+  // whole message), then parse it with ordinary blocking reads, which are
+  // satisfied from the buffer without system calls.
+  //
+  // The socket itself does not need to be in non-blocking mode; other
+  // operations keep waiting for data as usual.
+  PullResult TryPull(size_t min_length = 1, size_t recommended_length = 0);
+
+  // Returns the socket being read from. If the socket is owned then changed to
+  // -1 by `Close()`, otherwise unchanged.
+  virtual int src_fd() const = 0;
+
+ protected:
+  explicit SocketReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
+
+  explicit SocketReaderBase(size_t buffer_size);
+
+  SocketReaderBase(SocketReaderBase&& that) noexcept;
+  SocketReaderBase& operator=(SocketReaderBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(size_t buffer_size);
+  void Initialize(int src);
+  ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+
+  bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
+
+ private:
+  // Set during `TryPull()`: `ReadInternal()` receives with `MSG_DONTWAIT`.
+  bool non_blocking_ = false;
+  // Set by `ReadInternal()` if it stopped because no data were available.
+  bool would_block_ = false;
+};
+
+// A `Reader` which reads from a connected stream socket, typically TCP.
+//
+// Compared to `FdReader`, `SocketReader` receives with `recvmsg()` into a
+// larger buffer by default, and does not try to seek or to find the size of
+// the source. The end of the source is reached when the peer shuts down its
+// side of the connection.
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the socket being read from. `Src` must support
+// `Dependency<int, Src>`, e.g. `OwnedFd` (owned, default), `UnownedFd` (not
+// owned).
+//
+// By relying on CTAD the template argument can be deduced as `OwnedFd` if the
+// first constructor argument is an `int`, otherwise as the value type of the
+// first constructor argument. This requires C++17.
+//
+// The socket must not be closed until the `SocketReader` is closed or no
+// longer used.
+template <typename Src = OwnedFd>
+class SocketReader : public SocketReaderBase {
+ public:
+  // Creates a closed `SocketReader`.
+  explicit SocketReader(Closed) noexcept : SocketReaderBase(kClosed) {}
+
+  // Will read from the socket provided by `src`.
+  explicit SocketReader(const Src& src, Options options = Options());
+  explicit SocketReader(Src&& src, Options options = Options());
+
+  // Will read from the socket provided by a `Src` constructed from elements of
+  // `src_args`. This avoids constructing a temporary `Src` and moving from it.
+  template <typename... SrcArgs>
+  explicit SocketReader(std::tuple<SrcArgs...> src_args,
+                        Options options = Options());
+
+  SocketReader(SocketReader&& that) noexcept;
+  SocketReader& operator=(SocketReader&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `SocketReader`. This
+  // avoids constructing a temporary `SocketReader` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the socket being read
+  // from. If the socket is owned then changed to -1 by `Close()`, otherwise
+  // unchanged.
+  Src& src() { return src_.manager(); }
+  const Src& src() const { return src_.manager(); }
+  int src_fd() const override { return src_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the socket being read from.
+  Dependency<int, Src> src_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit SocketReader(Closed)->SocketReader<DeleteCtad<Closed>>;
+template <typename Src>
+explicit SocketReader(const Src& src, SocketReaderBase::Options options =
+                                          SocketReaderBase::Options())
+    -> SocketReader<
+        std::conditional_t<std::is_convertible<const Src&, int>::value,
+                           OwnedFd, std::decay_t<Src>>>;
+template <typename Src>
+explicit SocketReader(Src&& src, SocketReaderBase::Options options =
+                                     SocketReaderBase::Options())
+    -> SocketReader<std::conditional_t<std::is_convertible<Src&&, int>::value,
+                                       OwnedFd, std::decay_t<Src>>>;
+template <typename... SrcArgs>
+explicit SocketReader(
+    std::tuple<SrcArgs...> src_args,
+    SocketReaderBase::Options options = SocketReaderBase::Options())
+    -> SocketReader<DeleteCtad<std::tuple<SrcArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline SocketReaderBase::SocketReaderBase(size_t buffer_size)
+    : BufferedReader(buffer_size) {}
+
+inline SocketReaderBase::SocketReaderBase(SocketReaderBase&& that) noexcept
+    : BufferedReader(std::move(that)) {}
+
+inline SocketReaderBase& SocketReaderBase::operator=(
+    SocketReaderBase&& that) noexcept {
+  BufferedReader::operator=(std::move(that));
+  return *this;
+}
+
+inline void SocketReaderBase::Reset(Closed) { BufferedReader::Reset(kClosed); }
+
+inline void SocketReaderBase::Reset(size_t buffer_size) {
+  BufferedReader::Reset(buffer_size);
+}
+
+template <typename Src>
+inline SocketReader<Src>::SocketReader(const Src& src, Options options)
+    : SocketReaderBase(options.buffer_size()), src_(src) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline SocketReader<Src>::SocketReader(Src&& src, Options options)
+    : SocketReaderBase(options.buffer_size()), src_(std::move(src)) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline SocketReader<Src>::SocketReader(std::tuple<SrcArgs...> src_args,
+                                       Options options)
+    : SocketReaderBase(options.buffer_size()), src_(std::move(src_args)) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline SocketReader<Src>::SocketReader(SocketReader&& that) noexcept
+    : SocketReaderBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      src_(std::move(that.src_)) {}
+
+template <typename Src>
+inline SocketReader<Src>& SocketReader<Src>::operator=(
+    SocketReader&& that) noexcept {
+  SocketReaderBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  src_ = std::move(that.src_);
+  return *this;
+}
+
+template <typename Src>
+inline void SocketReader<Src>::Reset(Closed) {
+  SocketReaderBase::Reset(kClosed);
+  src_.Reset();
+}
+
+template <typename Src>
+inline void SocketReader<Src>::Reset(const Src& src, Options options) {
+  SocketReaderBase::Reset(options.buffer_size());
+  src_.Reset(src);
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline void SocketReader<Src>::Reset(Src&& src, Options options) {
+  SocketReaderBase::Reset(options.buffer_size());
+  src_.Reset(std::move(src));
+  Initialize(src_.get());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void SocketReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                     Options options) {
+  SocketReaderBase::Reset(options.buffer_size());
+  src_.Reset(std::move(src_args));
+  Initialize(src_.get());
+}
+
+template <typename Src>
+void SocketReader<Src>::Done() {
+  SocketReaderBase::Done();
+  if (src_.is_owning()) {
+    const int src = src_.Release();
+    if (ABSL_PREDICT_FALSE(internal::CloseFd(src) < 0) &&
+        ABSL_PREDICT_TRUE(healthy())) {
+      FailOperation(internal::kCloseFunctionName);
+    }
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_SOCKET_READER_H_
@@ -0,0 +1,326 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make `MSG_MORE` available.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "riegeli/bytes/socket_writer.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <cerrno>
+#include <limits>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/errno_mapping.h"
+#include "riegeli/base/io_stats.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t SocketWriterBase::kMinZerocopyLength;
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define RIEGELI_INTERNAL_HAVE_MSG_ZEROCOPY 1
+#endif
+
+#ifdef MSG_MORE
+#define RIEGELI_INTERNAL_MSG_MORE MSG_MORE
+#else
+#define RIEGELI_INTERNAL_MSG_MORE 0
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define RIEGELI_INTERNAL_MSG_NOSIGNAL MSG_NOSIGNAL
+#else
+#define RIEGELI_INTERNAL_MSG_NOSIGNAL 0
+#endif
+
+void SocketWriterBase::Initialize(int dest, bool zerocopy) {
+  RIEGELI_ASSERT_GE(dest, 0)
+      << "Failed precondition of SocketWriter: negative file descriptor";
+#ifdef RIEGELI_INTERNAL_HAVE_MSG_ZEROCOPY
+  if (zerocopy) {
+    const int one = 1;
+    // If `SO_ZEROCOPY` is not supported by this socket, `Chain` blocks are
+    // copied.
+    zerocopy_ = setsockopt(dest, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) ==
+                0;
+  }
+#endif
+}
+
+void SocketWriterBase::Done() {
+  BufferedWriter::Done();
+  // Blocks sent with `MSG_ZEROCOPY` must stay unchanged until the kernel no
+  // longer needs them, and the socket might be closed after this.
+  while (!pending_zerocopy_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ReapZerocopy(true))) break;
+  }
+  pending_zerocopy_.clear();
+}
+
+bool SocketWriterBase::FailOperation(absl::string_view operation) {
+  const int error_number = errno;
+  RIEGELI_ASSERT_NE(error_number, 0)
+      << "Failed precondition of SocketWriterBase::FailOperation(): "
+         "zero errno";
+  return Fail(
+      ErrnoToCanonicalStatus(error_number, absl::StrCat(operation, " failed")));
+}
+
+bool SocketWriterBase::WriteInternal(absl::string_view src) {
+  RIEGELI_ASSERT(!src.empty())
+      << "Failed precondition of BufferedWriter::WriteInternal(): "
+         "nothing to write";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of BufferedWriter::WriteInternal(): " << status();
+  if (ABSL_PREDICT_FALSE(src.size() >
+                         std::numeric_limits<Position>::max() - start_pos())) {
+    return FailOverflow();
+  }
+  return Send(src, batch_writes_ && !flushing_ ? RIEGELI_INTERNAL_MSG_MORE : 0);
+}
+
+inline bool SocketWriterBase::Send(absl::string_view src, int flags) {
+  const int dest = dest_fd();
+  do {
+  again:
+    const ssize_t length_written =
+        send(dest, src.data(),
+             UnsignedMin(src.size(),
+                         size_t{std::numeric_limits<ssize_t>::max()}),
+             flags | RIEGELI_INTERNAL_MSG_NOSIGNAL);
+    if (ABSL_PREDICT_FALSE(length_written < 0)) {
+      if (errno == EINTR) goto again;
+      return FailOperation("send()");
+    }
+    internal::CountSyscall(IoStats::Syscall::kWrite,
+                           IntCast<size_t>(length_written));
+    RIEGELI_ASSERT_GT(length_written, 0) << "send() returned 0";
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), src.size())
+        << "send() wrote more than requested";
+    move_start_pos(IntCast<size_t>(length_written));
+    src.remove_prefix(IntCast<size_t>(length_written));
+  } while (!src.empty());
+  corked_ = (flags & RIEGELI_INTERNAL_MSG_MORE) != 0;
+  return true;
+}
+
+bool SocketWriterBase::FlushBehindBuffer(absl::string_view src,
+                                         FlushType flush_type) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedWriter::FlushBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (!src.empty()) {
+    flushing_ = true;
+    const bool write_ok = FdCopyWriterBase::FlushBehindBuffer(src, flush_type);
+    flushing_ = false;
+    return write_ok;
+  }
+  if (corked_) return Uncork();
+  return true;
+}
+
+bool SocketWriterBase::Uncork() {
+  corked_ = false;
+#ifdef TCP_CORK
+  // Clearing `TCP_CORK` pushes pending data even if `TCP_CORK` was not set.
+  // This fails for sockets other than TCP, which do not hold back data sent
+  // with `MSG_MORE` anyway.
+  const int zero = 0;
+  setsockopt(dest_fd(), IPPROTO_TCP, TCP_CORK, &zero, sizeof(zero));
+#endif
+  return true;
+}
+
+bool SocketWriterBase::WriteSlow(const Chain& src) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), src.size())
+      << "Failed precondition of Writer::WriteSlow(Chain): "
+         "enough space available, use Write(Chain) instead";
+  if (!zerocopy_ || src.size() < LengthToWriteDirectly()) {
+    return FdCopyWriterBase::WriteSlow(src);
+  }
+  for (Chain::BlockIterator iter = src.blocks().cbegin();
+       iter != src.blocks().cend(); ++iter) {
+    if (iter->size() < kMinZerocopyLength) {
+      if (ABSL_PREDICT_FALSE(!Write(*iter))) return false;
+      continue;
+    }
+    if (ABSL_PREDICT_FALSE(!SyncBuffer())) return false;
+    if (ABSL_PREDICT_FALSE(!healthy())) return false;
+    if (ABSL_PREDICT_FALSE(iter->size() >
+                           std::numeric_limits<Position>::max() -
+                               start_pos())) {
+      return FailOverflow();
+    }
+    if (ABSL_PREDICT_FALSE(!SendZerocopy(iter.Pin()))) return false;
+  }
+  return true;
+}
+
+#ifdef RIEGELI_INTERNAL_HAVE_MSG_ZEROCOPY
+
+bool SocketWriterBase::SendZerocopy(const ChainBlock& block) {
+  const int dest = dest_fd();
+  absl::string_view src(block);
+  const int flags = MSG_ZEROCOPY | RIEGELI_INTERNAL_MSG_NOSIGNAL |
+                    (batch_writes_ ? RIEGELI_INTERNAL_MSG_MORE : 0);
+  do {
+  again:
+    const ssize_t length_written =
+        send(dest, src.data(),
+             UnsignedMin(src.size(),
+                         size_t{std::numeric_limits<ssize_t>::max()}),
+             flags);
+    if (ABSL_PREDICT_FALSE(length_written < 0)) {
+      if (errno == EINTR) goto again;
+      if (errno == ENOBUFS) {
+        // The limit of memory pinned for the socket was reached. Wait for
+        // pending blocks to be released, or copy if nothing is pending.
+        if (!pending_zerocopy_.empty()) {
+          if (ABSL_PREDICT_FALSE(!ReapZerocopy(true))) return false;
+          goto again;
+        }
+        return Send(src, batch_writes_ ? RIEGELI_INTERNAL_MSG_MORE : 0);
+      }
+      return FailOperation("send()");
+    }
+    internal::CountSyscall(IoStats::Syscall::kWrite,
+                           IntCast<size_t>(length_written));
+    RIEGELI_ASSERT_GT(length_written, 0) << "send() returned 0";
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), src.size())
+        << "send() wrote more than requested";
+    // Each successful `send()` with `MSG_ZEROCOPY` gets the next sequence
+    // number. A block sent in several pieces is pinned by each of them.
+    pending_zerocopy_.emplace_back(block);
+    move_start_pos(IntCast<size_t>(length_written));
+    src.remove_prefix(IntCast<size_t>(length_written));
+  } while (!src.empty());
+  corked_ = batch_writes_;
+  return ReapZerocopy(false);
+}
+
+bool SocketWriterBase::ReapZerocopy(bool wait) {
+  const int dest = dest_fd();
+  for (;;) {
+    alignas(struct cmsghdr) char control[128];
+    struct msghdr message = {};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(dest, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return FailOperation("recvmsg()");
+      }
+      if (!wait || pending_zerocopy_.empty()) return true;
+      // The error queue is never waited for by `recvmsg()`, but it is
+      // reported by `poll()` as `POLLERR`.
+      struct pollfd poll_fd = {};
+      poll_fd.fd = dest;
+      const int result = poll(&poll_fd, 1, -1);
+      if (ABSL_PREDICT_FALSE(result < 0)) {
+        if (errno == EINTR) continue;
+        return FailOperation("poll()");
+      }
+      if (ABSL_PREDICT_FALSE((poll_fd.revents & POLLERR) == 0)) {
+        // The connection was closed without completions being reported. The
+        // kernel does not send the data anymore.
+        pending_zerocopy_.clear();
+        return true;
+      }
+      continue;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+            (cmsg->cmsg_level == SOL_IPV6 &&
+             cmsg->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      const struct sock_extended_err* const error =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cmsg));
+      if (error->ee_errno != 0 ||
+          error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // Sequence numbers in the range [`ee_info`..`ee_data`] are completed.
+      // They wrap around at 2^32.
+      for (uint32_t seq = error->ee_info;; ++seq) {
+        const uint32_t index = seq - first_zerocopy_seq_;
+        if (index < pending_zerocopy_.size()) {
+          pending_zerocopy_[index].completed = true;
+        }
+        if (seq == error->ee_data) break;
+      }
+    }
+    while (!pending_zerocopy_.empty() && pending_zerocopy_.front().completed) {
+      pending_zerocopy_.pop_front();
+      ++first_zerocopy_seq_;
+    }
+    // A notification arrived. Process any others which are ready, but do not
+    // wait for them.
+    wait = false;
+  }
+}
+
+#else  // !RIEGELI_INTERNAL_HAVE_MSG_ZEROCOPY
+
+bool SocketWriterBase::SendZerocopy(const ChainBlock& block) {
+  return Send(absl::string_view(block),
+              batch_writes_ ? RIEGELI_INTERNAL_MSG_MORE : 0);
+}
+
+bool SocketWriterBase::ReapZerocopy(bool wait) { return true; }
+
+#endif  // !RIEGELI_INTERNAL_HAVE_MSG_ZEROCOPY
+
+int SocketWriterBase::BeginKernelCopy(absl::optional<Position>& dest_offset) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return -1;
+  if (ABSL_PREDICT_FALSE(!SyncBuffer())) return -1;
+  dest_offset = absl::nullopt;
+  return dest_fd();
+}
+
+void SocketWriterBase::EndKernelCopy(Position length) {
+  move_start_pos(length);
+  // `sendfile()` and `splice()` do not use `MSG_MORE`.
+  if (length > 0) corked_ = false;
+}
+
+}  // namespace riegeli
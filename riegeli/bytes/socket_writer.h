@@ -0,0 +1,394 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_SOCKET_WRITER_H_
+#define RIEGELI_BYTES_SOCKET_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/fd_copy.h"
+#include "riegeli/bytes/fd_dependency.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `SocketWriter`.
+class SocketWriterBase : public internal::FdCopyWriterBase {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Tunes how much data is buffered before sending it to the socket.
+    //
+    // Default: `kDefaultBufferSize` (64K).
+    Options& set_buffer_size(size_t buffer_size) & {
+      RIEGELI_ASSERT_GT(buffer_size, 0u)
+          << "Failed precondition of "
+             "SocketWriterBase::Options::set_buffer_size(): "
+             "zero buffer size";
+      buffer_size_ = buffer_size;
+      return *this;
+    }
+    Options&& set_buffer_size(size_t buffer_size) && {
+      return std::move(set_buffer_size(buffer_size));
+    }
+    size_t buffer_size() const { return buffer_size_; }
+
+    // If `true`, data are sent with `MSG_MORE` except by `Flush()` and
+    // `Close()`, like with `TCP_CORK`. This lets TCP send full segments when
+    // the buffer is pushed in small pieces, e.g. by a `Chain` with many small
+    // blocks or by `FdReader::Copy()`. `Flush()` sends any partial segment.
+    //
+    // Default: `true`.
+    Options& set_batch_writes(bool batch_writes) & {
+      batch_writes_ = batch_writes;
+      return *this;
+    }
+    Options&& set_batch_writes(bool batch_writes) && {
+      return std::move(set_batch_writes(batch_writes));
+    }
+    bool batch_writes() const { return batch_writes_; }
+
+    // If `true`, `Chain` blocks of at least `kMinZerocopyLength` are sent with
+    // `MSG_ZEROCOPY` instead of being copied to the kernel. The blocks are kept
+    // alive, and thus unchanged, until the kernel reports that it no longer
+    // needs them; `Close()` waits for that.
+    //
+    // This requires Linux and a socket which supports `SO_ZEROCOPY`, typically
+    // TCP, and is ignored otherwise. The socket must not be used with
+    // `MSG_ZEROCOPY` by other code while the `SocketWriter` is open, because
+    // completions are matched by their sequence numbers.
+    //
+    // Zerocopy pays off for large blocks, because page pinning and completion
+    // notifications have a fixed cost, and for long lived connections, because
+    // completions arrive only after the data are acknowledged by the peer.
+    //
+    // Default: `false`.
+    Options& set_zerocopy(bool zerocopy) & {
+      zerocopy_ = zerocopy;
+      return *this;
+    }
+    Options&& set_zerocopy(bool zerocopy) && {
+      return std::move(set_zerocopy(zerocopy));
+    }
+    bool zerocopy() const { return zerocopy_; }
+
+   private:
+    size_t buffer_size_ = kDefaultBufferSize;
+    bool batch_writes_ = true;
+    bool zerocopy_ = false;
+  };
+
+  // The minimum length of a `Chain` block sent with `MSG_ZEROCOPY` if
+  // `Options::zerocopy()`. Shorter blocks are copied.
+  static constexpr size_t kMinZerocopyLength = size_t{16} << 10;
+
+  // Returns the socket being written to. If the socket is owned then changed
+  // to -1 by `Close()`, otherwise unchanged.
+  virtual int dest_fd() const = 0;
+
+ protected:
+  explicit SocketWriterBase(Closed) noexcept : FdCopyWriterBase(kClosed) {}
+
+  explicit SocketWriterBase(size_t buffer_size, bool batch_writes);
+
+  SocketWriterBase(SocketWriterBase&& that) noexcept;
+  SocketWriterBase& operator=(SocketWriterBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(size_t buffer_size, bool batch_writes);
+  void Initialize(int dest, bool zerocopy);
+  ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+
+  void Done() override;
+  bool WriteInternal(absl::string_view src) override;
+  bool FlushBehindBuffer(absl::string_view src, FlushType flush_type) override;
+  using FdCopyWriterBase::WriteSlow;
+  bool WriteSlow(const Chain& src) override;
+  int BeginKernelCopy(absl::optional<Position>& dest_offset) override;
+  void EndKernelCopy(Position length) override;
+
+ private:
+  // A `Chain` block sent with `MSG_ZEROCOPY`, pinned until the kernel reports
+  // completion of the send with the corresponding sequence number.
+  struct PendingZerocopy {
+    explicit PendingZerocopy(const ChainBlock& block) : block(block) {}
+
+    ChainBlock block;
+    bool completed = false;
+  };
+
+  // Sends `src` with `flags`, looping until it is all sent.
+  bool Send(absl::string_view src, int flags);
+
+  // Sends `block` with `MSG_ZEROCOPY`, and keeps it pinned until completion.
+  bool SendZerocopy(const ChainBlock& block);
+
+  // Processes pending completion notifications of `MSG_ZEROCOPY`.
+  //
+  // If `wait` is `true`, waits until at least one notification arrives, unless
+  // nothing is pending.
+  bool ReapZerocopy(bool wait);
+
+  // Pushes a partial segment held back by `MSG_MORE`.
+  bool Uncork();
+
+  bool batch_writes_ = false;
+  bool zerocopy_ = false;
+  // If `true`, the last data were sent with `MSG_MORE`, and `Flush()` must
+  // push them even if nothing is buffered.
+  bool corked_ = false;
+  // If `true`, `WriteInternal()` is called by `Flush()` or `Close()`, so
+  // `MSG_MORE` is not used.
+  bool flushing_ = false;
+  // Blocks sent with `MSG_ZEROCOPY` whose completion was not processed yet.
+  // `pending_zerocopy_[i]` corresponds to the sequence number
+  // `first_zerocopy_seq_ + i`.
+  std::deque<PendingZerocopy> pending_zerocopy_;
+  uint32_t first_zerocopy_seq_ = 0;
+};
+
+// A `Writer` which writes to a connected stream socket, typically TCP.
+//
+// Compared to `FdWriter`, `SocketWriter` uses `send()` with `MSG_NOSIGNAL`,
+// so a broken connection fails the `SocketWriter` instead of raising
+// `SIGPIPE`, can batch small writes with `MSG_MORE`, and can send large `Chain`
+// blocks with `MSG_ZEROCOPY`. It does not support random access.
+//
+// `FdReader::Copy()` to a `SocketWriter` copies data in the kernel with
+// `sendfile()` or `splice()`.
+//
+// The `Dest` template parameter specifies the type of the object providing and
+// possibly owning the socket being written to. `Dest` must support
+// `Dependency<int, Dest>`, e.g. `OwnedFd` (owned, default), `UnownedFd` (not
+// owned).
+//
+// By relying on CTAD the template argument can be deduced as `OwnedFd` if the
+// first constructor argument is an `int`, otherwise as the value type of the
+// first constructor argument. This requires C++17.
+//
+// The socket must not be closed until the `SocketWriter` is closed or no
+// longer used.
+template <typename Dest = OwnedFd>
+class SocketWriter : public SocketWriterBase {
+ public:
+  // Creates a closed `SocketWriter`.
+  explicit SocketWriter(Closed) noexcept : SocketWriterBase(kClosed) {}
+
+  // Will write to the socket provided by `dest`.
+  explicit SocketWriter(const Dest& dest, Options options = Options());
+  explicit SocketWriter(Dest&& dest, Options options = Options());
+
+  // Will write to the socket provided by a `Dest` constructed from elements of
+  // `dest_args`. This avoids constructing a temporary `Dest` and moving from
+  // it.
+  template <typename... DestArgs>
+  explicit SocketWriter(std::tuple<DestArgs...> dest_args,
+                        Options options = Options());
+
+  SocketWriter(SocketWriter&& that) noexcept;
+  SocketWriter& operator=(SocketWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `SocketWriter`. This
+  // avoids constructing a temporary `SocketWriter` and moving from it.
+  void Reset(Closed);
+  void Reset(const Dest& dest, Options options = Options());
+  void Reset(Dest&& dest, Options options = Options());
+  template <typename... DestArgs>
+  void Reset(std::tuple<DestArgs...> dest_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the socket being written
+  // to. If the socket is owned then changed to -1 by `Close()`, otherwise
+  // unchanged.
+  Dest& dest() { return dest_.manager(); }
+  const Dest& dest() const { return dest_.manager(); }
+  int dest_fd() const override { return dest_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the socket being written to.
+  Dependency<int, Dest> dest_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit SocketWriter(Closed)->SocketWriter<DeleteCtad<Closed>>;
+template <typename Dest>
+explicit SocketWriter(const Dest& dest, SocketWriterBase::Options options =
+                                            SocketWriterBase::Options())
+    -> SocketWriter<
+        std::conditional_t<std::is_convertible<const Dest&, int>::value,
+                           OwnedFd, std::decay_t<Dest>>>;
+template <typename Dest>
+explicit SocketWriter(Dest&& dest, SocketWriterBase::Options options =
+                                       SocketWriterBase::Options())
+    -> SocketWriter<std::conditional_t<std::is_convertible<Dest&&, int>::value,
+                                       OwnedFd, std::decay_t<Dest>>>;
+template <typename... DestArgs>
+explicit SocketWriter(
+    std::tuple<DestArgs...> dest_args,
+    SocketWriterBase::Options options = SocketWriterBase::Options())
+    -> SocketWriter<DeleteCtad<std::tuple<DestArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline SocketWriterBase::SocketWriterBase(size_t buffer_size,
+                                          bool batch_writes)
+    : FdCopyWriterBase(buffer_size), batch_writes_(batch_writes) {}
+
+inline SocketWriterBase::SocketWriterBase(SocketWriterBase&& that) noexcept
+    : FdCopyWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      batch_writes_(that.batch_writes_),
+      zerocopy_(that.zerocopy_),
+      corked_(std::exchange(that.corked_, false)),
+      flushing_(std::exchange(that.flushing_, false)),
+      pending_zerocopy_(std::exchange(that.pending_zerocopy_, {})),
+      first_zerocopy_seq_(std::exchange(that.first_zerocopy_seq_, 0)) {}
+
+inline SocketWriterBase& SocketWriterBase::operator=(
+    SocketWriterBase&& that) noexcept {
+  FdCopyWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  batch_writes_ = that.batch_writes_;
+  zerocopy_ = that.zerocopy_;
+  corked_ = std::exchange(that.corked_, false);
+  flushing_ = std::exchange(that.flushing_, false);
+  pending_zerocopy_ = std::exchange(that.pending_zerocopy_, {});
+  first_zerocopy_seq_ = std::exchange(that.first_zerocopy_seq_, 0);
+  return *this;
+}
+
+inline void SocketWriterBase::Reset(Closed) {
+  FdCopyWriterBase::Reset(kClosed);
+  batch_writes_ = false;
+  zerocopy_ = false;
+  corked_ = false;
+  flushing_ = false;
+  pending_zerocopy_.clear();
+  first_zerocopy_seq_ = 0;
+}
+
+inline void SocketWriterBase::Reset(size_t buffer_size, bool batch_writes) {
+  FdCopyWriterBase::Reset(buffer_size);
+  batch_writes_ = batch_writes;
+  zerocopy_ = false;
+  corked_ = false;
+  flushing_ = false;
+  pending_zerocopy_.clear();
+  first_zerocopy_seq_ = 0;
+}
+
+template <typename Dest>
+inline SocketWriter<Dest>::SocketWriter(const Dest& dest, Options options)
+    : SocketWriterBase(options.buffer_size(), options.batch_writes()),
+      dest_(dest) {
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+inline SocketWriter<Dest>::SocketWriter(Dest&& dest, Options options)
+    : SocketWriterBase(options.buffer_size(), options.batch_writes()),
+      dest_(std::move(dest)) {
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline SocketWriter<Dest>::SocketWriter(std::tuple<DestArgs...> dest_args,
+                                        Options options)
+    : SocketWriterBase(options.buffer_size(), options.batch_writes()),
+      dest_(std::move(dest_args)) {
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+inline SocketWriter<Dest>::SocketWriter(SocketWriter&& that) noexcept
+    : SocketWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      dest_(std::move(that.dest_)) {}
+
+template <typename Dest>
+inline SocketWriter<Dest>& SocketWriter<Dest>::operator=(
+    SocketWriter&& that) noexcept {
+  SocketWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  dest_ = std::move(that.dest_);
+  return *this;
+}
+
+template <typename Dest>
+inline void SocketWriter<Dest>::Reset(Closed) {
+  SocketWriterBase::Reset(kClosed);
+  dest_.Reset();
+}
+
+template <typename Dest>
+inline void SocketWriter<Dest>::Reset(const Dest& dest, Options options) {
+  SocketWriterBase::Reset(options.buffer_size(), options.batch_writes());
+  dest_.Reset(dest);
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+inline void SocketWriter<Dest>::Reset(Dest&& dest, Options options) {
+  SocketWriterBase::Reset(options.buffer_size(), options.batch_writes());
+  dest_.Reset(std::move(dest));
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline void SocketWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
+                                      Options options) {
+  SocketWriterBase::Reset(options.buffer_size(), options.batch_writes());
+  dest_.Reset(std::move(dest_args));
+  Initialize(dest_.get(), options.zerocopy());
+}
+
+template <typename Dest>
+void SocketWriter<Dest>::Done() {
+  SocketWriterBase::Done();
+  if (dest_.is_owning()) {
+    const int dest = dest_.Release();
+    if (ABSL_PREDICT_FALSE(internal::CloseFd(dest) < 0) &&
+        ABSL_PREDICT_TRUE(healthy())) {
+      FailOperation(internal::kCloseFunctionName);
+    }
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_SOCKET_WRITER_H_
@@ -16,6 +16,7 @@
 
 #include <stddef.h>
 
+#include <functional>
 #include <limits>
 #include <string>
 #include <utility>
@@ -28,6 +29,7 @@
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/cord_reader.h"
@@ -148,12 +150,23 @@ absl::Status SplittingWriterBase::AnnotateStatusImpl(absl::Status status) {
 }
 
 absl::Status SplittingWriterBase::AnnotateOverShard(absl::Status status) {
-  if (is_open()) {
-    return Annotate(status, absl::StrCat("across shards at byte ", pos()));
-  }
+  if (is_open()) return AnnotateOverShard(std::move(status), pos());
   return status;
 }
 
+absl::Status SplittingWriterBase::AnnotateOverShard(absl::Status status,
+                                                    Position pos) {
+  return Annotate(status, absl::StrCat("across shards at byte ", pos));
+}
+
+void SplittingWriterBase::ScheduleClosingShard(std::function<void()> task) {
+  if (executor_ == nullptr) {
+    internal::ThreadPool::global().ScheduleBlocking(std::move(task));
+  } else {
+    executor_->Schedule(std::move(task));
+  }
+}
+
 bool SplittingWriterBase::PushBehindScratch() {
   RIEGELI_ASSERT_EQ(available(), 0u)
       << "Failed precondition of PushableWriter::PushBehindScratch(): "
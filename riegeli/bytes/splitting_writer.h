@@ -17,6 +17,10 @@
 
 #include <stddef.h>
 
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
 #include <utility>
 
 #include "absl/base/attributes.h"
@@ -29,6 +33,7 @@
 #include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/pushable_writer.h"
 #include "riegeli/bytes/writer.h"
 
@@ -36,17 +41,80 @@ namespace riegeli {
 
 // Template parameter independent part of `SplittingWriter`.
 class SplittingWriterBase : public PushableWriter {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Maximum number of previous shards being closed at a time.
+    //
+    // If 0, each shard is closed before the next shard is opened.
+    //
+    // If greater than 0, a shard is closed in background (see `executor()`)
+    // while the next shard receives data. This hides latency of
+    // closing shards, e.g. of flushing a compressor or of `fsync()`. A failure
+    // of closing a shard in background is reported when the following shard is
+    // closed, or by `Flush()` or `Close()`, which wait for all previous shards
+    // to be closed.
+    //
+    // This applies to shards closed by `SplittingWriter::CloseShardImpl()`
+    // or `SplittingWriter::CloseShardInBackground()`.
+    //
+    // Default: 0.
+    Options& set_shards_closing(size_t shards_closing) & {
+      shards_closing_ = shards_closing;
+      return *this;
+    }
+    Options&& set_shards_closing(size_t shards_closing) && {
+      return std::move(set_shards_closing(shards_closing));
+    }
+    size_t shards_closing() const { return shards_closing_; }
+
+    // The `Executor` closing shards if `shards_closing() > 0`, or `nullptr`
+    // to close each shard in its own thread.
+    //
+    // Closing a shard can block, e.g. on I/O, or on tasks of a parallel
+    // compressor like `GzipWriter` with `parallelism() > 0`. Hence the
+    // `Executor` must not be used by the shards themselves, in particular it
+    // must not be the thread pool shared by all parallel operations of Riegeli.
+    //
+    // The `Executor` must outlive the `SplittingWriter`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+   private:
+    size_t shards_closing_ = 0;
+    Executor* executor_ = nullptr;
+  };
+
  protected:
-  using PushableWriter::PushableWriter;
+  explicit SplittingWriterBase(Closed) noexcept : PushableWriter(kClosed) {}
+
+  explicit SplittingWriterBase(const Options& options = Options());
 
   SplittingWriterBase(SplittingWriterBase&& that) noexcept;
   SplittingWriterBase& operator=(SplittingWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset();
+  void Reset(const Options& options = Options());
 
   void DoneBehindScratch() override;
 
+  // Returns `Options::shards_closing()`.
+  size_t shards_closing() const { return shards_closing_; }
+
+  // Runs `task` closing a shard in background: on `Options::executor()`, or
+  // in its own thread if that is `nullptr`.
+  void ScheduleClosingShard(std::function<void()> task);
+
   // Returns the shard `Writer`.
   virtual Writer* shard_writer() = 0;
   virtual const Writer* shard_writer() const = 0;
@@ -123,6 +191,9 @@ class SplittingWriterBase : public PushableWriter {
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
       absl::Status status) override;
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverShard(absl::Status status);
+  // Like `AnnotateOverShard(status)`, but for a shard which ended at `pos`.
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverShard(absl::Status status,
+                                                     Position pos);
 
   // Sets cursor of `shard` to cursor of `*this`. Sets buffer pointers of
   // `*this` to `nullptr`.
@@ -152,6 +223,8 @@ class SplittingWriterBase : public PushableWriter {
   template <typename SrcReader, typename Src>
   bool WriteInternal(Src&& src);
 
+  size_t shards_closing_ = 0;
+  Executor* executor_ = nullptr;
   // The limit of `pos()` for data written to the current shard.
   Position shard_pos_limit_ = 0;
 
@@ -181,10 +254,45 @@ class SplittingWriter : public SplittingWriterBase {
   // Derived classes which override `Reset()` should include a call to
   // `SplittingWriter::Reset()`.
   void Reset(Closed);
-  void Reset();
+  void Reset(const Options& options = Options());
 
   void Done() override;
 
+  // If `shards_closing() > 0`, closes `shard()` in background using
+  // `CloseShardInBackground()`. Otherwise calls `shard_writer()->Close()` and
+  // propagates failures from that.
+  bool CloseShardImpl() override;
+
+  // Moves `shard()` to a task in background, which closes it and
+  // then calls `finish_shard` unless it is `nullptr`, e.g. to move a
+  // temporary destination to the final destination. `finish_shard` is called
+  // in background, so it must not refer to `*this`.
+  //
+  // If the maximum number of shards are already being closed, waits for the
+  // oldest of them first.
+  //
+  // This can be used by an override of `CloseShardImpl()`.
+  //
+  // Preconditions:
+  //   `healthy()`
+  //   `shard_is_open()`
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`, `!shard_is_open()`)
+  //  * `false` - failure (`!healthy()`, `!shard_is_open()`)
+  bool CloseShardInBackground(
+      std::function<absl::Status()> finish_shard = nullptr);
+
+  // Waits for all shards being closed in background. Propagates their
+  // failures.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool WaitForClosingShards();
+
+  bool FlushBehindScratch(FlushType flush_type) override;
+
   // Returns the object providing and possibly owning the shard `Writer`.
   Shard& shard() { return shard_.manager(); }
   const Shard& shard() const { return shard_.manager(); }
@@ -194,17 +302,38 @@ class SplittingWriter : public SplittingWriterBase {
  private:
   void MoveShard(SplittingWriter&& that);
 
+  // A shard being closed in background.
+  struct ClosingShard {
+    std::future<absl::Status> status;
+    // The position across shards at the end of the shard, for annotating its
+    // failure.
+    Position pos;
+  };
+
+  // Waits for the oldest shard being closed in background. Propagates its
+  // failure.
+  bool WaitForOldestClosingShard();
+
   // The object providing and possibly owning the shard `Writer`.
   Dependency<Writer*, Shard> shard_;
+  // Previous shards being closed in background, in order, if
+  // `shards_closing() > 0`.
+  std::deque<ClosingShard> closing_shards_;
 };
 
 // Implementation details follow.
 
+inline SplittingWriterBase::SplittingWriterBase(const Options& options)
+    : shards_closing_(options.shards_closing()),
+      executor_(options.executor()) {}
+
 inline SplittingWriterBase::SplittingWriterBase(
     SplittingWriterBase&& that) noexcept
     : PushableWriter(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
+      shards_closing_(that.shards_closing_),
+      executor_(that.executor_),
       shard_pos_limit_(that.shard_pos_limit_) {}
 
 inline SplittingWriterBase& SplittingWriterBase::operator=(
@@ -212,17 +341,23 @@ inline SplittingWriterBase& SplittingWriterBase::operator=(
   PushableWriter::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
+  shards_closing_ = that.shards_closing_;
+  executor_ = that.executor_;
   shard_pos_limit_ = that.shard_pos_limit_;
   return *this;
 }
 
 inline void SplittingWriterBase::Reset(Closed) {
   PushableWriter::Reset(kClosed);
+  shards_closing_ = 0;
+  executor_ = nullptr;
   shard_pos_limit_ = 0;
 }
 
-inline void SplittingWriterBase::Reset() {
+inline void SplittingWriterBase::Reset(const Options& options) {
   PushableWriter::Reset();
+  shards_closing_ = options.shards_closing();
+  executor_ = options.executor();
   shard_pos_limit_ = 0;
 }
 
@@ -259,38 +394,113 @@ inline void SplittingWriterBase::MakeBuffer(Writer& shard) {
 
 template <typename Shard>
 inline SplittingWriter<Shard>::SplittingWriter(SplittingWriter&& that) noexcept
-    : SplittingWriterBase(std::move(that)) {
-  // Using `that` after it was moved is correct because only the base class part
-  // was moved.
+    : SplittingWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      closing_shards_(std::move(that.closing_shards_)) {
   MoveShard(std::move(that));
 }
 
 template <typename Shard>
 inline SplittingWriter<Shard>& SplittingWriter<Shard>::operator=(
     SplittingWriter&& that) noexcept {
+  // Finish closing shards of `*this` before their destinations can be reused.
+  WaitForClosingShards();
   SplittingWriterBase::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   MoveShard(std::move(that));
+  closing_shards_ = std::move(that.closing_shards_);
   return *this;
 }
 
 template <typename Shard>
 inline void SplittingWriter<Shard>::Reset(Closed) {
+  WaitForClosingShards();
   SplittingWriterBase::Reset(kClosed);
   shard_.Reset();
+  closing_shards_.clear();
 }
 
 template <typename Shard>
-inline void SplittingWriter<Shard>::Reset() {
-  SplittingWriterBase::Reset();
+inline void SplittingWriter<Shard>::Reset(const Options& options) {
+  WaitForClosingShards();
+  SplittingWriterBase::Reset(options);
   shard_.Reset();
+  closing_shards_.clear();
 }
 
 template <typename Shard>
 void SplittingWriter<Shard>::Done() {
   SplittingWriterBase::Done();
   shard_.Reset();
+  WaitForClosingShards();
+}
+
+template <typename Shard>
+bool SplittingWriter<Shard>::CloseShardImpl() {
+  if (shards_closing() == 0) return SplittingWriterBase::CloseShardImpl();
+  return CloseShardInBackground();
+}
+
+template <typename Shard>
+bool SplittingWriter<Shard>::CloseShardInBackground(
+    std::function<absl::Status()> finish_shard) {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of SplittingWriter::CloseShardInBackground(): "
+      << status();
+  RIEGELI_ASSERT(shard_is_open())
+      << "Failed precondition of SplittingWriter::CloseShardInBackground(): "
+         "shard already closed";
+  std::promise<absl::Status>* const status_promise =
+      new std::promise<absl::Status>();
+  closing_shards_.push_back(
+      ClosingShard{status_promise->get_future(), pos()});
+  // A moved-from `Dependency` is closed. `std::function` requires a copyable
+  // function object, hence `std::shared_ptr`.
+  const std::shared_ptr<Dependency<Writer*, Shard>> shard =
+      std::make_shared<Dependency<Writer*, Shard>>(std::move(shard_));
+  ScheduleClosingShard([status_promise, shard,
+                        finish_shard = std::move(finish_shard)] {
+    absl::Status status;
+    if (ABSL_PREDICT_FALSE(!shard->get()->Close())) {
+      status = shard->get()->status();
+    } else if (finish_shard != nullptr) {
+      status = finish_shard();
+    }
+    status_promise->set_value(std::move(status));
+    delete status_promise;
+  });
+  while (closing_shards_.size() > shards_closing()) {
+    if (ABSL_PREDICT_FALSE(!WaitForOldestClosingShard())) return false;
+  }
+  return true;
+}
+
+template <typename Shard>
+bool SplittingWriter<Shard>::WaitForClosingShards() {
+  bool ok = true;
+  while (!closing_shards_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WaitForOldestClosingShard())) ok = false;
+  }
+  return ok;
+}
+
+template <typename Shard>
+bool SplittingWriter<Shard>::WaitForOldestClosingShard() {
+  const absl::Status status = closing_shards_.front().status.get();
+  const Position pos = closing_shards_.front().pos;
+  closing_shards_.pop_front();
+  if (ABSL_PREDICT_FALSE(!status.ok())) {
+    return FailWithoutAnnotation(AnnotateOverShard(status, pos));
+  }
+  return healthy();
+}
+
+template <typename Shard>
+bool SplittingWriter<Shard>::FlushBehindScratch(FlushType flush_type) {
+  const bool ok = SplittingWriterBase::FlushBehindScratch(flush_type);
+  return WaitForClosingShards() && ok;
 }
 
 template <typename Shard>
@@ -138,6 +138,19 @@ void WrappedReaderBase::ReadHintSlow(size_t length) {
   MakeBuffer(src);
 }
 
+void WrappedReaderBase::SetAccessPatternImpl(AccessPattern access_pattern) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  src_reader()->SetAccessPattern(access_pattern);
+}
+
+void WrappedReaderBase::WillNeedImpl(Position length) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  SyncBuffer(src);
+  src.WillNeed(length);
+  MakeBuffer(src);
+}
+
 bool WrappedReaderBase::SupportsRandomAccess() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRandomAccess();
@@ -69,6 +69,8 @@ class WrappedReaderBase : public Reader {
   bool CopySlow(Position length, Writer& dest) override;
   bool CopySlow(size_t length, BackwardWriter& dest) override;
   void ReadHintSlow(size_t length) override;
+  void SetAccessPatternImpl(AccessPattern access_pattern) override;
+  void WillNeedImpl(Position length) override;
   bool SeekSlow(Position new_pos) override;
   absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
@@ -117,6 +117,15 @@ bool WrappedWriterBase::WriteZerosSlow(Position length) {
   return ok;
 }
 
+void WrappedWriterBase::SetWriteSizeHintImpl(
+    absl::optional<Position> write_size_hint) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Writer& dest = *dest_writer();
+  SyncBuffer(dest);
+  dest.SetWriteSizeHint(write_size_hint);
+  MakeBuffer(dest);
+}
+
 bool WrappedWriterBase::SupportsRandomAccess() {
   Writer* const dest = dest_writer();
   return dest != nullptr && dest->SupportsRandomAccess();
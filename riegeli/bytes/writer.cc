@@ -147,6 +147,8 @@ bool Writer::WriteCharsSlow(Position length, char src) {
 
 bool Writer::FlushImpl(FlushType flush_type) { return healthy(); }
 
+void Writer::SetWriteSizeHintImpl(absl::optional<Position> write_size_hint) {}
+
 bool Writer::SeekSlow(Position new_pos) {
   RIEGELI_ASSERT_NE(new_pos, pos())
       << "Failed precondition of Writer::SeekSlow(): "
@@ -32,6 +32,7 @@
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/io_stats.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/reader.h"
 
@@ -164,6 +165,14 @@ class Writer : public Object {
   // implemented in terms of `WriteSlow(absl::string_view)` anyway.
   virtual bool PrefersCopying() const { return false; }
 
+  // Hints that about `write_size_hint` more bytes are expected to be written
+  // from the current position, or that this is unknown if `absl::nullopt`.
+  //
+  // This lets buffers be sized so that the remaining data fit, instead of
+  // growing the buffer gradually or allocating a larger buffer than useful.
+  // An inaccurate hint affects only performance.
+  void SetWriteSizeHint(absl::optional<Position> write_size_hint);
+
   // Pushes buffered data to the destination.
   //
   // This makes data written so far visible, but in contrast to `Close()`,
@@ -382,6 +391,11 @@ class Writer : public Object {
   // By default does nothing and returns `healthy()`.
   virtual bool FlushImpl(FlushType flush_type);
 
+  // Implementation of `SetWriteSizeHint()`.
+  //
+  // By default does nothing.
+  virtual void SetWriteSizeHintImpl(absl::optional<Position> write_size_hint);
+
   // Increments the value of `start_pos()`.
   void move_start_pos(Position length);
 
@@ -496,6 +510,7 @@ inline void Writer::Done() {
 
 inline bool Writer::Push(size_t min_length, size_t recommended_length) {
   if (ABSL_PREDICT_TRUE(available() >= min_length)) return true;
+  internal::CountPushSlow();
   if (ABSL_PREDICT_FALSE(!PushSlow(min_length, recommended_length))) {
     return false;
   }
@@ -647,6 +662,11 @@ inline bool Writer::WriteBytes(Position length, uint8_t src) {
   return WriteChars(length, static_cast<char>(src));
 }
 
+inline void Writer::SetWriteSizeHint(
+    absl::optional<Position> write_size_hint) {
+  SetWriteSizeHintImpl(write_size_hint);
+}
+
 inline bool Writer::Flush(FlushType flush_type) {
   return FlushImpl(flush_type);
 }
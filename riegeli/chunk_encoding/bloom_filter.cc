@@ -0,0 +1,111 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/bloom_filter.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+namespace {
+
+constexpr uint32_t kMaxNumProbes = 30;
+
+// Probes are derived from one hash by double hashing.
+inline uint64_t ProbeDelta(uint64_t key_hash) {
+  return (key_hash >> 17) | (key_hash << 47);
+}
+
+}  // namespace
+
+BloomFilter::BloomFilter(const std::vector<uint64_t>& key_hashes,
+                         size_t bits_per_key) {
+  if (key_hashes.empty()) return;
+  bits_per_key = UnsignedMin(UnsignedMax(bits_per_key, size_t{1}), size_t{100});
+  // ln(2) * `bits_per_key` probes minimize the false positive rate.
+  num_probes_ = UnsignedMin(
+      UnsignedMax(IntCast<uint32_t>(bits_per_key * 69 / 100), uint32_t{1}),
+      kMaxNumProbes);
+  // A small number of bits would have a high false positive rate, the minimum
+  // keeps it bounded for chunks with few keys.
+  const size_t num_bits =
+      UnsignedMax(key_hashes.size() * bits_per_key, size_t{64});
+  bits_.resize((num_bits + 7) / 8);
+  const uint64_t actual_num_bits = IntCast<uint64_t>(bits_.size()) * 8;
+  for (uint64_t key_hash : key_hashes) {
+    const uint64_t delta = ProbeDelta(key_hash);
+    for (uint32_t i = 0; i < num_probes_; ++i) {
+      const uint64_t bit = key_hash % actual_num_bits;
+      bits_[IntCast<size_t>(bit / 8)] |= static_cast<char>(1 << (bit % 8));
+      key_hash += delta;
+    }
+  }
+}
+
+bool BloomFilter::MayContainHash(uint64_t key_hash) const {
+  if (bits_.empty()) return false;
+  const uint64_t num_bits = IntCast<uint64_t>(bits_.size()) * 8;
+  const uint64_t delta = ProbeDelta(key_hash);
+  for (uint32_t i = 0; i < num_probes_; ++i) {
+    const uint64_t bit = key_hash % num_bits;
+    if ((static_cast<unsigned char>(bits_[IntCast<size_t>(bit / 8)]) &
+         (1 << (bit % 8))) == 0) {
+      return false;
+    }
+    key_hash += delta;
+  }
+  return true;
+}
+
+// Format:
+//  * number of probes (varint32), 0 if there are no keys
+//  * length of bits (varint64)
+//  * bits
+bool BloomFilter::Encode(Writer& dest) const {
+  return WriteVarint32(num_probes_, dest) &&
+         WriteVarint64(IntCast<uint64_t>(bits_.size()), dest) &&
+         dest.Write(bits_);
+}
+
+bool BloomFilter::Decode(Reader& src) {
+  num_probes_ = 0;
+  bits_.clear();
+  uint32_t num_probes;
+  uint64_t length;
+  if (ABSL_PREDICT_FALSE(!ReadVarint32(src, num_probes) ||
+                         num_probes > kMaxNumProbes ||
+                         !ReadVarint64(src, length) ||
+                         (num_probes == 0) != (length == 0) ||
+                         length > std::numeric_limits<size_t>::max() ||
+                         !src.Read(IntCast<size_t>(length), bits_))) {
+    bits_.clear();
+    return false;
+  }
+  num_probes_ = num_probes;
+  return true;
+}
+
+}  // namespace riegeli
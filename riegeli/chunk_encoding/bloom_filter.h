@@ -0,0 +1,112 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_BLOOM_FILTER_H_
+#define RIEGELI_CHUNK_ENCODING_BLOOM_FILTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/hash.h"
+
+namespace riegeli {
+
+// A set of keys with a compact representation, which can tell that a key is
+// not present, and otherwise that it may be present.
+//
+// Keys are given by their hashes, computed by `HashKey()`. With
+// `bits_per_key == 10` the probability that a key which is not present is
+// reported as possibly present is about 1%.
+class BloomFilter {
+ public:
+  // The default number of bits per key.
+  static constexpr size_t kDefaultBitsPerKey = 10;
+
+  // Creates a `BloomFilter` with no keys.
+  BloomFilter() noexcept {}
+
+  // Creates a `BloomFilter` with keys of the given hashes.
+  explicit BloomFilter(const std::vector<uint64_t>& key_hashes,
+                       size_t bits_per_key = kDefaultBitsPerKey);
+
+  BloomFilter(const BloomFilter& that);
+  BloomFilter& operator=(const BloomFilter& that);
+
+  BloomFilter(BloomFilter&& that) noexcept;
+  BloomFilter& operator=(BloomFilter&& that) noexcept;
+
+  // Returns the hash of a key.
+  static uint64_t HashKey(absl::string_view key) {
+    return internal::Hash(key);
+  }
+
+  // Returns `false` if the key of the given hash is not present.
+  bool MayContainHash(uint64_t key_hash) const;
+
+  // Returns `false` if the key is not present.
+  bool MayContain(absl::string_view key) const {
+    return MayContainHash(HashKey(key));
+  }
+
+  // Appends the serialized `BloomFilter` to `dest`.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - failure (`!dest.healthy()`)
+  bool Encode(Writer& dest) const;
+
+  // Reads a serialized `BloomFilter` from `src`.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - failure (`*this` has no keys)
+  bool Decode(Reader& src);
+
+ private:
+  uint32_t num_probes_ = 0;
+  // Bits are numbered from the least significant bit of `bits_[0]`.
+  std::string bits_;
+};
+
+// Implementation details follow.
+
+inline BloomFilter::BloomFilter(const BloomFilter& that)
+    : num_probes_(that.num_probes_), bits_(that.bits_) {}
+
+inline BloomFilter& BloomFilter::operator=(const BloomFilter& that) {
+  num_probes_ = that.num_probes_;
+  bits_ = that.bits_;
+  return *this;
+}
+
+inline BloomFilter::BloomFilter(BloomFilter&& that) noexcept
+    : num_probes_(std::exchange(that.num_probes_, 0)),
+      bits_(std::move(that.bits_)) {}
+
+inline BloomFilter& BloomFilter::operator=(BloomFilter&& that) noexcept {
+  num_probes_ = std::exchange(that.num_probes_, 0);
+  bits_ = std::move(that.bits_);
+  return *this;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_BLOOM_FILTER_H_
@@ -0,0 +1,317 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/buffer_transform.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+namespace internal {
+
+namespace {
+
+// Dictionaries with more values are not worth their memory and lookups.
+constexpr size_t kMaxDictionarySize = size_t{1} << 16;
+
+inline uint64_t EncodeZigZag64(uint64_t value) {
+  return (value << 1) ^ (uint64_t{0} - (value >> 63));
+}
+
+inline uint64_t DecodeZigZag64(uint64_t repr) {
+  return (repr >> 1) ^ (uint64_t{0} - (repr & 1));
+}
+
+absl::Status UntransformDelta(BufferTransform transform, const Chain& src,
+                              Chain& dest) {
+  ChainReader<> reader(&src);
+  // Values usually take more bytes than their small differences.
+  ChainWriter<Chain> writer(
+      ChainWriterBase::Options().set_size_hint(src.size() * 2));
+  uint64_t previous_value = 0;
+  uint64_t previous_delta = 0;
+  while (reader.Pull()) {
+    uint64_t repr;
+    if (ABSL_PREDICT_FALSE(!ReadCanonicalVarint64(reader, repr))) {
+      return absl::InvalidArgumentError("Reading transformed varint failed");
+    }
+    uint64_t delta = DecodeZigZag64(repr);
+    if (transform == BufferTransform::kDeltaOfDelta) delta += previous_delta;
+    uint64_t value = previous_value + delta;
+    previous_value = value;
+    previous_delta = delta;
+    if (ABSL_PREDICT_FALSE(!writer.Push(kMaxLengthVarint64))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "A ChainWriter has no reason to fail: " << writer.status();
+    }
+    // Write the varint with the highest bit of each byte cleared.
+    char* cursor = writer.cursor();
+    do {
+      *cursor++ = static_cast<char>(value & 0x7f);
+      value >>= 7;
+    } while (value != 0);
+    writer.set_cursor(cursor);
+  }
+  if (ABSL_PREDICT_FALSE(!writer.Close())) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << writer.status();
+  }
+  dest = std::move(writer.dest());
+  return absl::OkStatus();
+}
+
+absl::Status UntransformDictionary(const Chain& src, Chain& dest) {
+  ChainReader<> reader(&src);
+  uint32_t dictionary_size;
+  if (ABSL_PREDICT_FALSE(!ReadVarint32(reader, dictionary_size))) {
+    return absl::InvalidArgumentError("Reading dictionary size failed");
+  }
+  // Each value takes at least one byte.
+  if (ABSL_PREDICT_FALSE(dictionary_size > src.size())) {
+    return absl::InvalidArgumentError("Dictionary size too large");
+  }
+  std::vector<std::string> dictionary(dictionary_size);
+  for (std::string& value : dictionary) {
+    const Position value_pos = reader.pos();
+    uint32_t length;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(reader, length))) {
+      return absl::InvalidArgumentError("Reading dictionary value failed");
+    }
+    const Position length_size = reader.pos() - value_pos;
+    if (ABSL_PREDICT_FALSE(!reader.Seek(value_pos) ||
+                           !reader.Read(IntCast<size_t>(length_size) + length,
+                                        value))) {
+      return absl::InvalidArgumentError("Reading dictionary value failed");
+    }
+  }
+  ChainWriter<Chain> writer;
+  while (reader.Pull()) {
+    uint32_t index;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(reader, index))) {
+      return absl::InvalidArgumentError("Reading dictionary index failed");
+    }
+    if (ABSL_PREDICT_FALSE(index >= dictionary.size())) {
+      return absl::InvalidArgumentError("Dictionary index out of range");
+    }
+    if (ABSL_PREDICT_FALSE(!writer.Write(dictionary[index]))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "A ChainWriter has no reason to fail: " << writer.status();
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!writer.Close())) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << writer.status();
+  }
+  dest = std::move(writer.dest());
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+BufferTransform TransformVarintBuffer(const Chain& buffer,
+                                      const std::vector<uint8_t>& value_lengths,
+                                      Chain& dest) {
+  std::vector<uint64_t> values;
+  values.reserve(value_lengths.size());
+  ChainReader<> reader(&buffer);
+  for (const uint8_t length : value_lengths) {
+    if (ABSL_PREDICT_FALSE(!reader.Pull(length))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Value lengths do not match the buffer: " << reader.status();
+    }
+    const unsigned char* const cursor =
+        reinterpret_cast<const unsigned char*>(reader.cursor());
+    if (length == kMaxLengthVarint64 && cursor[length - 1] > 1) {
+      // The value does not fit in `uint64_t`.
+      return BufferTransform::kNone;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; ++i) {
+      value |= uint64_t{cursor[i]} << (7 * i);
+    }
+    if (LengthVarint64(value) != length) {
+      // The value does not have its shortest representation.
+      return BufferTransform::kNone;
+    }
+    reader.move_cursor(length);
+    values.push_back(value);
+  }
+  RIEGELI_ASSERT(!reader.Pull())
+      << "Value lengths do not match the buffer: more data follow";
+
+  size_t delta_size = 0;
+  size_t delta_of_delta_size = 0;
+  uint64_t previous_value = 0;
+  uint64_t previous_delta = 0;
+  for (const uint64_t value : values) {
+    const uint64_t delta = value - previous_value;
+    delta_size += LengthVarint64(EncodeZigZag64(delta));
+    delta_of_delta_size +=
+        LengthVarint64(EncodeZigZag64(delta - previous_delta));
+    previous_value = value;
+    previous_delta = delta;
+  }
+  BufferTransform transform;
+  size_t transformed_size;
+  if (delta_of_delta_size < delta_size) {
+    transform = BufferTransform::kDeltaOfDelta;
+    transformed_size = delta_of_delta_size;
+  } else {
+    transform = BufferTransform::kDelta;
+    transformed_size = delta_size;
+  }
+  if (transformed_size >= buffer.size()) return BufferTransform::kNone;
+
+  ChainWriter<Chain> writer(
+      ChainWriterBase::Options().set_size_hint(transformed_size));
+  previous_value = 0;
+  previous_delta = 0;
+  for (const uint64_t value : values) {
+    const uint64_t delta = value - previous_value;
+    const uint64_t repr = EncodeZigZag64(
+        transform == BufferTransform::kDelta ? delta
+                                                   : delta - previous_delta);
+    if (ABSL_PREDICT_FALSE(!WriteVarint64(repr, writer))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "A ChainWriter has no reason to fail: " << writer.status();
+    }
+    previous_value = value;
+    previous_delta = delta;
+  }
+  if (ABSL_PREDICT_FALSE(!writer.Close())) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << writer.status();
+  }
+  dest = std::move(writer.dest());
+  return transform;
+}
+
+BufferTransform TransformStringBuffer(const Chain& buffer, Chain& dest) {
+  std::string flat_copy;
+  absl::optional<absl::string_view> flat = buffer.TryFlat();
+  if (flat == absl::nullopt) {
+    flat_copy = std::string(buffer);
+    flat = flat_copy;
+  }
+  // Indices of distinct values are assigned in the order of first occurrence,
+  // and renumbered by decreasing frequency later.
+  absl::flat_hash_map<absl::string_view, uint32_t> indices;
+  std::vector<absl::string_view> distinct_values;
+  std::vector<size_t> counts;
+  std::vector<uint32_t> values;
+  const char* cursor = flat->data();
+  const char* const limit = flat->data() + flat->size();
+  while (cursor < limit) {
+    uint32_t length;
+    const absl::optional<const char*> next =
+        ReadVarint32(cursor, limit, length);
+    if (ABSL_PREDICT_FALSE(next == absl::nullopt ||
+                           length > PtrDistance(*next, limit))) {
+      RIEGELI_ASSERT_UNREACHABLE() << "Invalid string buffer";
+    }
+    const absl::string_view value(cursor, PtrDistance(cursor, *next) + length);
+    cursor = *next + length;
+    const std::pair<absl::flat_hash_map<absl::string_view, uint32_t>::iterator,
+                    bool>
+        insert_result =
+            indices.emplace(value, IntCast<uint32_t>(distinct_values.size()));
+    if (insert_result.second) {
+      if (distinct_values.size() == kMaxDictionarySize) {
+        return BufferTransform::kNone;
+      }
+      distinct_values.push_back(value);
+      counts.push_back(0);
+    }
+    ++counts[insert_result.first->second];
+    values.push_back(insert_result.first->second);
+  }
+  if (distinct_values.size() == values.size()) return BufferTransform::kNone;
+
+  std::vector<uint32_t> order(distinct_values.size());
+  for (uint32_t index = 0; index < order.size(); ++index) order[index] = index;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return counts[a] > counts[b];
+  });
+  std::vector<uint32_t> new_indices(distinct_values.size());
+  size_t transformed_size =
+      LengthVarint32(IntCast<uint32_t>(distinct_values.size()));
+  for (uint32_t rank = 0; rank < order.size(); ++rank) {
+    new_indices[order[rank]] = rank;
+    transformed_size += distinct_values[order[rank]].size() +
+                        counts[order[rank]] * LengthVarint32(rank);
+  }
+  if (transformed_size >= buffer.size()) return BufferTransform::kNone;
+
+  ChainWriter<Chain> writer(
+      ChainWriterBase::Options().set_size_hint(transformed_size));
+  if (ABSL_PREDICT_FALSE(!WriteVarint32(
+          IntCast<uint32_t>(distinct_values.size()), writer))) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << writer.status();
+  }
+  for (const uint32_t index : order) {
+    if (ABSL_PREDICT_FALSE(!writer.Write(distinct_values[index]))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "A ChainWriter has no reason to fail: " << writer.status();
+    }
+  }
+  for (const uint32_t index : values) {
+    if (ABSL_PREDICT_FALSE(!WriteVarint32(new_indices[index], writer))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "A ChainWriter has no reason to fail: " << writer.status();
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!writer.Close())) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << writer.status();
+  }
+  dest = std::move(writer.dest());
+  return BufferTransform::kDictionary;
+}
+
+absl::Status UntransformBuffer(BufferTransform transform, const Chain& src,
+                               Chain& dest) {
+  switch (transform) {
+    case BufferTransform::kDelta:
+    case BufferTransform::kDeltaOfDelta:
+      return UntransformDelta(transform, src, dest);
+    case BufferTransform::kDictionary:
+      return UntransformDictionary(src, dest);
+    case BufferTransform::kNone:
+      break;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of UntransformBuffer(): unknown transform: "
+      << static_cast<uint32_t>(transform);
+}
+
+}  // namespace internal
+}  // namespace riegeli
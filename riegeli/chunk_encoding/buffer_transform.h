@@ -0,0 +1,91 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_BUFFER_TRANSFORM_H_
+#define RIEGELI_CHUNK_ENCODING_BUFFER_TRANSFORM_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "absl/status/status.h"
+#include "riegeli/base/chain.h"
+
+namespace riegeli {
+namespace internal {
+
+// How a data buffer of a transposed chunk is stored.
+enum class BufferTransform : uint8_t {
+  // The buffer is stored unchanged.
+  kNone = 0,
+
+  // Transforms of varint data buffers, which contain values of varint fields
+  // as varints with the highest bit of each byte cleared. A transformed buffer
+  // contains varints (with the highest bits kept) of the following values,
+  // zigzag encoded, starting from 0:
+
+  // Differences of consecutive values.
+  kDelta = 1,
+  // Differences of consecutive differences of consecutive values.
+  kDeltaOfDelta = 2,
+
+  // Transforms of string data buffers, which contain values of length
+  // delimited fields, each as a varint length followed by contents:
+
+  // Distinct values as a dictionary, followed by indices of values in the
+  // dictionary. The format:
+  //  * Number of values in the dictionary (varint32)
+  //  * Values in the dictionary, each in its original representation
+  //  * Indices of consecutive values (varint32)
+  //
+  // Values in the dictionary are sorted by decreasing frequency, so that
+  // frequent values have short indices.
+  kDictionary = 3,
+};
+
+// Transforms a varint data buffer if this makes it smaller.
+//
+// `value_lengths` are lengths of consecutive values in `buffer`.
+//
+// Values must have their shortest representation, so that the transform can be
+// undone without `value_lengths`. Otherwise `buffer` is not transformed.
+//
+// Returns the transform applied, writing the transformed buffer to `dest`,
+// or `BufferTransform::kNone`, leaving `dest` unchanged.
+BufferTransform TransformVarintBuffer(const Chain& buffer,
+                                      const std::vector<uint8_t>& value_lengths,
+                                      Chain& dest);
+
+// Transforms a string data buffer with `BufferTransform::kDictionary` if it has
+// few distinct values, so that this makes it smaller.
+//
+// Returns the transform applied, writing the transformed buffer to `dest`,
+// or `BufferTransform::kNone`, leaving `dest` unchanged.
+BufferTransform TransformStringBuffer(const Chain& buffer, Chain& dest);
+
+// Undoes `TransformVarintBuffer()` or `TransformStringBuffer()`, writing the
+// original buffer to `dest`.
+//
+// Precondition: `transform != BufferTransform::kNone`
+//
+// Returns status:
+//  * `status.ok()`  - success
+//  * `!status.ok()` - failure (`src` is not a valid transformed buffer)
+absl::Status UntransformBuffer(BufferTransform transform, const Chain& src,
+                               Chain& dest);
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_BUFFER_TRANSFORM_H_
@@ -18,23 +18,31 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+#include "riegeli/chunk_encoding/field_predicate.h"
 #include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/chunk_encoding/simple_decoder.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -68,8 +76,112 @@ class ChunkDecoder : public Object {
       return field_projection_;
     }
 
+    // If not `nullptr`, buckets of transposed chunks are decompressed in
+    // parallel using tasks scheduled on `executor`.
+    //
+    // The `Executor` is not owned and must outlive the `ChunkDecoder`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+    // Zstd dictionary for chunks compressed with
+    // `CompressionType::kZstdWithDictionary`, usually read from the
+    // `ChunkType::kZstdDictionary` chunk of the file.
+    //
+    // Default: `ZstdDictionary()`.
+    Options& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) & {
+      zstd_dictionary_ = zstd_dictionary;
+      return *this;
+    }
+    Options& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) & {
+      zstd_dictionary_ = std::move(zstd_dictionary);
+      return *this;
+    }
+    Options&& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(zstd_dictionary));
+    }
+    Options&& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(std::move(zstd_dictionary)));
+    }
+    ZstdDictionary& zstd_dictionary() { return zstd_dictionary_; }
+    const ZstdDictionary& zstd_dictionary() const { return zstd_dictionary_; }
+
+    // If not `absl::nullopt`, values of simple chunks whose decoded data size
+    // is at least `*streaming_min_size` are decompressed incrementally while
+    // records are read, instead of all at once by `Decode()`. Memory usage is
+    // then bounded by the record size rather than by the chunk size.
+    //
+    // In this mode corrupted values are detected when reading records rather
+    // than by `Decode()`, and seeking backwards within the chunk decompresses
+    // it again from the beginning.
+    //
+    // Transposed chunks are always decoded at once.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_streaming_min_size(
+        absl::optional<uint64_t> streaming_min_size) & {
+      streaming_min_size_ = streaming_min_size;
+      return *this;
+    }
+    Options&& set_streaming_min_size(
+        absl::optional<uint64_t> streaming_min_size) && {
+      return std::move(set_streaming_min_size(streaming_min_size));
+    }
+    absl::optional<uint64_t> streaming_min_size() const {
+      return streaming_min_size_;
+    }
+
+    // If not `absl::nullopt`, only records matching `*record_filter` are
+    // returned. Records which do not match are skipped, but they are still
+    // counted by `index()` and `num_records()`.
+    //
+    // For a transposed chunk, the filter is first evaluated on records decoded
+    // with only the field it tests. If no record matches, the chunk is not
+    // decoded further.
+    //
+    // With a filter, simple chunks are always decoded at once, ignoring
+    // `set_streaming_min_size()`.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_record_filter(absl::optional<FieldPredicate> record_filter) & {
+      record_filter_ = std::move(record_filter);
+      return *this;
+    }
+    Options&& set_record_filter(
+        absl::optional<FieldPredicate> record_filter) && {
+      return std::move(set_record_filter(std::move(record_filter)));
+    }
+    absl::optional<FieldPredicate>& record_filter() { return record_filter_; }
+    const absl::optional<FieldPredicate>& record_filter() const {
+      return record_filter_;
+    }
+
    private:
     FieldProjection field_projection_ = FieldProjection::All();
+    Executor* executor_ = nullptr;
+    ZstdDictionary zstd_dictionary_;
+    absl::optional<uint64_t> streaming_min_size_;
+    absl::optional<FieldPredicate> record_filter_;
+  };
+
+  // Records of a chunk decoded in memory, exported by `ExportRecords()` so
+  // that a `ChunkDecoder` can be restored by `ImportRecords()` without decoding
+  // the chunk again.
+  struct DecodedRecords {
+    // Returns the approximate memory usage, excluding `sizeof(DecodedRecords)`.
+    size_t MemoryUsage() const;
+
+    Chain values;
+    std::vector<size_t> limits;
+    std::vector<bool> record_matches;
+    std::vector<uint32_t> skipped_buckets;
   };
 
   // Creates an empty `ChunkDecoder`.
@@ -85,20 +197,108 @@ class ChunkDecoder : public Object {
   // Resets the `ChunkDecoder` to an empty chunk. Keeps options unchanged.
   void Clear();
 
+  // Changes the Zstd dictionary for chunks decoded later. Keeps other options
+  // unchanged.
+  void set_zstd_dictionary(ZstdDictionary zstd_dictionary) {
+    zstd_dictionary_ = std::move(zstd_dictionary);
+  }
+  const ZstdDictionary& zstd_dictionary() const { return zstd_dictionary_; }
+
+  // Returns the field projection, as given by
+  // `Options::set_field_projection()`.
+  const FieldProjection& field_projection() const { return field_projection_; }
+
+  // Returns the threshold of decoded data size for decompressing simple chunks
+  // incrementally, as given by `Options::set_streaming_min_size()`.
+  absl::optional<uint64_t> streaming_min_size() const {
+    return streaming_min_size_;
+  }
+
+  // Returns the filter of returned records, as given by
+  // `Options::set_record_filter()`.
+  const absl::optional<FieldPredicate>& record_filter() const {
+    return record_filter_;
+  }
+
   // Resets the `ChunkDecoder` and parses the chunk. Keeps options unchanged.
   //
+  // If `statistics` is not `nullptr` and it shows that no record matches
+  // `record_filter()`, the chunk is not decoded and all its records are
+  // skipped. `statistics` must describe this chunk.
+  //
   // Return values:
   //  * `true`  - success (`healthy()`)
   //  * `false` - failure (`!healthy()`)
   bool Decode(const Chunk& chunk);
+  bool Decode(const Chunk& chunk, const ChunkStatistics* statistics);
+
+  // Like `Decode()` followed by `SetIndex(index)`, but if the chunk is
+  // transposed and there is no record filter, records before `index` are not
+  // reconstructed. This makes seeking into a transposed chunk cheaper, because
+  // its records are reconstructed from the last one.
+  //
+  // If `SetIndex()` later moves before `index`, the chunk is decoded again.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Decode(const Chunk& chunk, const ChunkStatistics* statistics,
+              uint64_t index);
+
+  // Like `Decode(chunk, statistics, index)`, but if `verify_data_hash` is
+  // `true`, also verifies the chunk data hash, like `DefaultChunkReader` does,
+  // before any records are available.
+  //
+  // If possible, chunk data are hashed while they are decompressed, so that
+  // they are read from memory once. This pays off for chunks larger than CPU
+  // caches. See `internal::HashDigester` for the performance caveat.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Decode(const Chunk& chunk, const ChunkStatistics* statistics,
+              uint64_t index, bool verify_data_hash);
+
+  // Like `Decode(chunk, nullptr, index)`, but reads chunk data from `data`
+  // instead of holding them in memory. All records are reconstructed.
+  //
+  // If the chunk is transposed, `field_projection()` does not include all
+  // fields, and `data` supports random access, then buckets which the
+  // projection does not need are not read from `data`.
+  //
+  // Precondition: `record_filter() == absl::nullopt`
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Decode(const ChunkHeader& header, Reader& data, uint64_t index);
+
+  // If all records of the current chunk are decoded in memory, stores them in
+  // `dest`, sharing memory of values, and returns `true`.
+  //
+  // Returns `false` if values of the chunk are being decompressed
+  // incrementally, if records before some index were not reconstructed by
+  // `Decode()`, or if `!healthy()`.
+  bool ExportRecords(DecodedRecords& dest) const;
+
+  // Resets the `ChunkDecoder` to records exported by `ExportRecords()`, then
+  // sets the current record index to `index`. Keeps options unchanged.
+  //
+  // The records must have been exported by a `ChunkDecoder` with the same
+  // field projection and record filter.
+  void ImportRecords(const DecodedRecords& src, uint64_t index = 0);
 
   // Reads the next record.
   //
   // `ReadRecord(google::protobuf::MessageLite&)` parses raw bytes to a proto
   // message after reading. The remaining overloads read raw bytes (they never
-  // generate a new failure). For `ReadRecord(absl::string_view&)` the
-  // `absl::string_view` is valid until the next non-const operation on this
-  // `ChunkDecoder`.
+  // generate a new failure, unless values of the chunk are being decompressed
+  // incrementally, see `Options::set_streaming_min_size()`). For
+  // `ReadRecord(absl::string_view&)` the `absl::string_view` is valid until the
+  // next non-const operation on this `ChunkDecoder`. `ReadRecord(Chain&)` and
+  // `ReadRecord(absl::Cord&)` share memory with the decoded chunk instead of
+  // copying it, except for short records which are copied because this is
+  // cheaper.
   //
   // Return values:
   //  * `true`                      - success (`record` is set, `healthy()`)
@@ -110,6 +310,33 @@ class ChunkDecoder : public Object {
   bool ReadRecord(Chain& record);
   bool ReadRecord(absl::Cord& record);
 
+  // Reads the next record as a `Reader` of its value, without materializing
+  // the record if values of the chunk are being decompressed incrementally
+  // (see `Options::set_streaming_min_size()`). Otherwise the `Reader` shares
+  // memory with the decoded chunk.
+  //
+  // The `Reader` is valid until the next non-const operation on this
+  // `ChunkDecoder`. It does not need to be read until its end.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set, `healthy()`)
+  //  * `false` (when `healthy()`)  - chunk ends
+  //  * `false` (when `!healthy()`) - failure
+  bool ReadRecord(std::unique_ptr<Reader>& record);
+
+  // Reads all remaining records of the chunk at once, replacing the contents
+  // of `records`. This avoids per-record overhead of `ReadRecord()`.
+  //
+  // The `absl::string_view`s are valid until the next non-const operation on
+  // this `ChunkDecoder`.
+  //
+  // Return values:
+  //  * `true`                      - success (`records` is non-empty,
+  //                                  `healthy()`)
+  //  * `false` (when `healthy()`)  - chunk ends (`records` is empty)
+  //  * `false` (when `!healthy()`) - failure (`records` is empty)
+  bool ReadRecords(std::vector<absl::string_view>& records);
+
   // If `!healthy()` and the failure was caused by an unparsable message, then
   // `Recover()` allows reading again by skipping the unparsable message.
   //
@@ -128,27 +355,106 @@ class ChunkDecoder : public Object {
   //
   // If `index > num_records()`, the current index is set to `num_records()`.
   //
+  // If values of the chunk are being decompressed incrementally, seeking is
+  // deferred until the next record is read.
+  //
+  // If records before `index` were not reconstructed by `Decode()`, the chunk
+  // is decoded again, which can fail (then `!healthy()`).
+  //
   // Precondition: `healthy()`
   void SetIndex(uint64_t index);
 
   // Returns the number of records. Unchanged by `Close()`.
   uint64_t num_records() const { return IntCast<uint64_t>(limits_.size()); }
 
+  // Returns indices of buckets of a transposed chunk which were not
+  // decompressed by the last `Decode()`, because the field projection did not
+  // need them. Unchanged by `Close()`.
+  const std::vector<uint32_t>& skipped_buckets() const {
+    return skipped_buckets_;
+  }
+
  protected:
   void Done() override;
 
  private:
-  bool Parse(const ChunkHeader& header, Reader& src, Chain& dest);
+  // Source and decoder of a simple chunk whose values are decompressed while
+  // records are read.
+  struct StreamedValues {
+    explicit StreamedValues(const Chain& chunk_data,
+                            const ZstdDictionary& zstd_dictionary)
+        : data(chunk_data), data_reader(&data), decoder(zstd_dictionary) {}
+
+    Chain data;
+    ChainReader<> data_reader;
+    SimpleDecoder decoder;
+    // Position of `decoder.reader()` corresponding to the beginning of values.
+    Position values_start = 0;
+  };
+
+  // Records before `first_record_index` of a transposed chunk are not
+  // reconstructed.
+  bool Parse(const ChunkHeader& header, const FieldProjection& field_projection,
+             Reader& src, Chain& dest, uint64_t first_record_index = 0);
+  // Like `Parse(chunk.header, field_projection_, ...)` with chunk data read
+  // from `chunk.data`, hashing them on the way and verifying the hash.
+  bool ParseAndVerifyDataHash(const Chunk& chunk, Chain& dest,
+                              uint64_t first_record_index);
+  bool VerifyDataHash(const ChunkHeader& header, uint64_t computed_data_hash);
+  // Sets `record_matches_` by evaluating `*record_filter_` on records with
+  // values `values` and end positions `limits_`.
+  void MatchRecords(const Chain& values);
+  // Moves `index_` to the next record matching `*record_filter_`, or to
+  // `num_records()` if there are none.
+  //
+  // Precondition: `!record_matches_.empty()`
+  void SkipUnmatchedRecords();
+  bool DecodeStreamed(const Chunk& chunk);
+  // Decodes `skipped_chunk_` again with all records, then sets the current
+  // index.
+  //
+  // Precondition: `first_decoded_index_ > 0`
+  void DecodeSkippedRecords(uint64_t index);
+
+  bool ReadStreamedRecord(absl::string_view& record);
+  bool ReadStreamedRecord(std::string& record);
+  bool ReadStreamedRecord(Chain& record);
+  bool ReadStreamedRecord(absl::Cord& record);
+  // Seeks `streamed_values_->decoder.reader()` to the beginning of the current
+  // record, setting `start` and `limit` to its bounds relative to values.
+  bool SeekStreamed(Reader& values, size_t& start, size_t& limit);
+  ABSL_ATTRIBUTE_COLD bool FailReadingValues(Reader& values);
 
   FieldProjection field_projection_;
+  Executor* executor_;
+  ZstdDictionary zstd_dictionary_;
+  absl::optional<uint64_t> streaming_min_size_;
+  absl::optional<FieldPredicate> record_filter_;
   // Invariants if `healthy()`:
   //   `limits_` are sorted
   //   `(limits_.empty() ? 0 : limits_.back())` == size of `values_reader_`
-  //   `(index_ == 0 ? 0 : limits_[index_ - 1]) == values_reader_.pos()`
+  //       or of values of `streamed_values_`
+  //   if `streamed_values_ == nullptr` then
+  //       `(index_ == 0 ? 0 : limits_[index_ - 1]) == values_reader_.pos()`
   std::vector<size_t> limits_;
   ChainReader<Chain> values_reader_;
+  // If not `nullptr`, values are read from `streamed_values_->decoder` instead
+  // of `values_reader_`.
+  std::unique_ptr<StreamedValues> streamed_values_;
   // Invariant: if `healthy()` then `index_ <= num_records()`
   uint64_t index_ = 0;
+  // Records before `first_decoded_index_` were not reconstructed by
+  // `Decode()`. They are represented as empty.
+  //
+  // Invariant: if `healthy()` then `first_decoded_index_ <= index_`
+  uint64_t first_decoded_index_ = 0;
+  // If `first_decoded_index_ > 0`, the chunk to decode again if records before
+  // `first_decoded_index_` are needed.
+  Chunk skipped_chunk_;
+  std::vector<uint32_t> skipped_buckets_;
+  // If `record_filter_ != absl::nullopt`, whether each record matches it,
+  // otherwise empty.
+  std::vector<bool> record_matches_;
   // Whether `Recover()` is applicable.
   //
   // Invariant: if `recoverable_` then `!healthy()`
@@ -159,6 +465,10 @@ class ChunkDecoder : public Object {
 
 inline ChunkDecoder::ChunkDecoder(Options options)
     : field_projection_(std::move(options.field_projection())),
+      executor_(options.executor()),
+      zstd_dictionary_(std::move(options.zstd_dictionary())),
+      streaming_min_size_(options.streaming_min_size()),
+      record_filter_(std::move(options.record_filter())),
       values_reader_(std::forward_as_tuple()) {}
 
 inline ChunkDecoder::ChunkDecoder(ChunkDecoder&& that) noexcept
@@ -166,9 +476,18 @@ inline ChunkDecoder::ChunkDecoder(ChunkDecoder&& that) noexcept
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       field_projection_(std::move(that.field_projection_)),
+      executor_(that.executor_),
+      zstd_dictionary_(std::move(that.zstd_dictionary_)),
+      streaming_min_size_(that.streaming_min_size_),
+      record_filter_(std::move(that.record_filter_)),
       limits_(std::move(that.limits_)),
       values_reader_(std::move(that.values_reader_)),
+      streamed_values_(std::move(that.streamed_values_)),
       index_(that.index_),
+      first_decoded_index_(std::exchange(that.first_decoded_index_, 0)),
+      skipped_chunk_(std::move(that.skipped_chunk_)),
+      skipped_buckets_(std::move(that.skipped_buckets_)),
+      record_matches_(std::move(that.record_matches_)),
       recoverable_(std::exchange(that.recoverable_, false)) {}
 
 inline ChunkDecoder& ChunkDecoder::operator=(ChunkDecoder&& that) noexcept {
@@ -176,15 +495,28 @@ inline ChunkDecoder& ChunkDecoder::operator=(ChunkDecoder&& that) noexcept {
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   field_projection_ = std::move(that.field_projection_);
+  executor_ = that.executor_;
+  zstd_dictionary_ = std::move(that.zstd_dictionary_);
+  streaming_min_size_ = that.streaming_min_size_;
+  record_filter_ = std::move(that.record_filter_);
   limits_ = std::move(that.limits_);
   values_reader_ = std::move(that.values_reader_);
+  streamed_values_ = std::move(that.streamed_values_);
   index_ = that.index_;
+  first_decoded_index_ = std::exchange(that.first_decoded_index_, 0);
+  skipped_chunk_ = std::move(that.skipped_chunk_);
+  skipped_buckets_ = std::move(that.skipped_buckets_);
+  record_matches_ = std::move(that.record_matches_);
   recoverable_ = std::exchange(that.recoverable_, false);
   return *this;
 }
 
 inline void ChunkDecoder::Reset(Options options) {
   field_projection_ = std::move(options.field_projection());
+  executor_ = options.executor();
+  zstd_dictionary_ = std::move(options.zstd_dictionary());
+  streaming_min_size_ = options.streaming_min_size();
+  record_filter_ = std::move(options.record_filter());
   Clear();
 }
 
@@ -192,15 +524,24 @@ inline void ChunkDecoder::Clear() {
   Object::Reset();
   limits_.clear();
   values_reader_.Reset(std::forward_as_tuple());
+  streamed_values_.reset();
   index_ = 0;
+  first_decoded_index_ = 0;
+  skipped_chunk_.Clear();
+  skipped_buckets_.clear();
+  record_matches_.clear();
   recoverable_ = false;
 }
 
 inline bool ChunkDecoder::ReadRecord(absl::string_view& record) {
+  if (ABSL_PREDICT_FALSE(!record_matches_.empty())) SkipUnmatchedRecords();
   if (ABSL_PREDICT_FALSE(!healthy() || index() == num_records())) {
     record = absl::string_view();
     return false;
   }
+  if (ABSL_PREDICT_FALSE(streamed_values_ != nullptr)) {
+    return ReadStreamedRecord(record);
+  }
   const size_t start = IntCast<size_t>(values_reader_.pos());
   const size_t limit = limits_[IntCast<size_t>(index_)];
   RIEGELI_ASSERT_LE(start, limit)
@@ -214,10 +555,14 @@ inline bool ChunkDecoder::ReadRecord(absl::string_view& record) {
 }
 
 inline bool ChunkDecoder::ReadRecord(std::string& record) {
+  if (ABSL_PREDICT_FALSE(!record_matches_.empty())) SkipUnmatchedRecords();
   if (ABSL_PREDICT_FALSE(!healthy() || index() == num_records())) {
     record.clear();
     return false;
   }
+  if (ABSL_PREDICT_FALSE(streamed_values_ != nullptr)) {
+    return ReadStreamedRecord(record);
+  }
   const size_t start = IntCast<size_t>(values_reader_.pos());
   const size_t limit = limits_[IntCast<size_t>(index_)];
   RIEGELI_ASSERT_LE(start, limit)
@@ -231,10 +576,14 @@ inline bool ChunkDecoder::ReadRecord(std::string& record) {
 }
 
 inline bool ChunkDecoder::ReadRecord(Chain& record) {
+  if (ABSL_PREDICT_FALSE(!record_matches_.empty())) SkipUnmatchedRecords();
   if (ABSL_PREDICT_FALSE(!healthy() || index() == num_records())) {
     record.Clear();
     return false;
   }
+  if (ABSL_PREDICT_FALSE(streamed_values_ != nullptr)) {
+    return ReadStreamedRecord(record);
+  }
   const size_t start = IntCast<size_t>(values_reader_.pos());
   const size_t limit = limits_[IntCast<size_t>(index_)];
   RIEGELI_ASSERT_LE(start, limit)
@@ -248,10 +597,14 @@ inline bool ChunkDecoder::ReadRecord(Chain& record) {
 }
 
 inline bool ChunkDecoder::ReadRecord(absl::Cord& record) {
+  if (ABSL_PREDICT_FALSE(!record_matches_.empty())) SkipUnmatchedRecords();
   if (ABSL_PREDICT_FALSE(!healthy() || index() == num_records())) {
     record.Clear();
     return false;
   }
+  if (ABSL_PREDICT_FALSE(streamed_values_ != nullptr)) {
+    return ReadStreamedRecord(record);
+  }
   const size_t start = IntCast<size_t>(values_reader_.pos());
   const size_t limit = limits_[IntCast<size_t>(index_)];
   RIEGELI_ASSERT_LE(start, limit)
@@ -267,7 +620,12 @@ inline bool ChunkDecoder::ReadRecord(absl::Cord& record) {
 inline void ChunkDecoder::SetIndex(uint64_t index) {
   RIEGELI_ASSERT(healthy())
       << "Failed precondition of ChunkDecoder::SetIndex(): " << status();
+  if (ABSL_PREDICT_FALSE(index < first_decoded_index_)) {
+    DecodeSkippedRecords(index);
+    return;
+  }
   index_ = UnsignedMin(index, num_records());
+  if (ABSL_PREDICT_FALSE(streamed_values_ != nullptr)) return;
   const size_t start =
       index_ == 0 ? size_t{0} : limits_[IntCast<size_t>(index_ - 1)];
   if (!values_reader_.Seek(start)) {
@@ -276,6 +634,15 @@ inline void ChunkDecoder::SetIndex(uint64_t index) {
   }
 }
 
+inline void ChunkDecoder::SkipUnmatchedRecords() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  uint64_t index = index_;
+  while (index < num_records() && !record_matches_[IntCast<size_t>(index)]) {
+    ++index;
+  }
+  if (index != index_) SetIndex(index);
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_CHUNK_ENCODING_CHUNK_DECODER_H_
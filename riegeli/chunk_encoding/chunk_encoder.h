@@ -31,6 +31,7 @@
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/messages/message_serialize.h"
 
@@ -100,6 +101,13 @@ class ChunkEncoder : public Object {
                               uint64_t& num_records,
                               uint64_t& decoded_data_size) = 0;
 
+  // Returns statistics of values of selected columns across the records of the
+  // chunk, or `nullptr` if the encoder does not compute them.
+  //
+  // The statistics are complete after a successful `EncodeAndClose()`, and
+  // valid until `Clear()`.
+  virtual const ChunkStatistics* statistics() const { return nullptr; }
+
  protected:
   void Done() override;
 
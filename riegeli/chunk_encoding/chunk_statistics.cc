@@ -0,0 +1,351 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/bloom_filter.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+namespace {
+
+constexpr uint32_t kMaxFieldNumber = (uint32_t{1} << 29) - 1;
+
+void WriteBytes(absl::string_view value, Writer& dest) {
+  WriteVarint64(IntCast<uint64_t>(value.size()), dest);
+  dest.Write(value);
+}
+
+bool ReadBytes(Reader& src, std::string& value) {
+  uint64_t length;
+  return ReadVarint64(src, length) &&
+         length <= std::numeric_limits<size_t>::max() &&
+         src.Read(IntCast<size_t>(length), value);
+}
+
+bool ReadDouble(Reader& src, double& value) {
+  uint64_t repr;
+  if (ABSL_PREDICT_FALSE(!ReadLittleEndian64(src, repr))) return false;
+  value = DecodeDouble(repr);
+  return true;
+}
+
+}  // namespace
+
+ChunkStatistics::ChunkStatistics(
+    const std::vector<ColumnSpec>& columns,
+    const std::vector<ColumnSpec>& bloom_filter_columns) {
+  columns_.resize(columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    columns_[i].column = columns[i];
+    ClearColumn(columns_[i]);
+  }
+  for (const ColumnSpec& column : bloom_filter_columns) {
+    size_t column_index = 0;
+    while (column_index < columns_.size() &&
+           !(columns_[column_index].column.type == column.type &&
+             columns_[column_index].column.field.path() ==
+                 column.field.path())) {
+      ++column_index;
+    }
+    if (column_index == columns_.size()) {
+      columns_.emplace_back();
+      columns_.back().column = column;
+      ClearColumn(columns_.back());
+    }
+    bool duplicate = false;
+    for (const BloomFilterKeys& keys : bloom_filter_keys_) {
+      if (keys.column_index == column_index) duplicate = true;
+    }
+    if (!duplicate) {
+      bloom_filter_keys_.push_back(BloomFilterKeys{column_index, {}});
+    }
+  }
+}
+
+void ChunkStatistics::Clear() {
+  num_records_ = 0;
+  for (ColumnStatistics& statistics : columns_) ClearColumn(statistics);
+  for (BloomFilterKeys& keys : bloom_filter_keys_) keys.key_hashes.clear();
+}
+
+inline void ChunkStatistics::ClearColumn(ColumnStatistics& statistics) {
+  statistics.num_values = 0;
+  statistics.num_records_without_values = 0;
+  statistics.min_int64 = std::numeric_limits<int64_t>::max();
+  statistics.max_int64 = std::numeric_limits<int64_t>::min();
+  statistics.min_double = std::numeric_limits<double>::infinity();
+  statistics.max_double = -std::numeric_limits<double>::infinity();
+  statistics.min_bytes.clear();
+  statistics.max_bytes.clear();
+  statistics.bloom_filter = absl::nullopt;
+}
+
+void ChunkStatistics::AddRecord(absl::string_view record) {
+  ++num_records_;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    ColumnStatistics& statistics = columns_[i];
+    const ColumnType type = statistics.column.type;
+    const uint64_t num_values_before = statistics.num_values;
+    std::vector<uint64_t>* key_hashes = nullptr;
+    for (BloomFilterKeys& keys : bloom_filter_keys_) {
+      if (keys.column_index == i) key_hashes = &keys.key_hashes;
+    }
+    internal::ForEachColumnValue(
+        statistics.column.field.path(), type, record,
+        [&](const internal::ColumnValue& value) {
+          if (key_hashes != nullptr) {
+            key_hashes->push_back(internal::ColumnValueHash(type, value));
+          }
+          if (IsInt64ColumnType(type)) {
+            statistics.min_int64 =
+                SignedMin(statistics.min_int64, value.int64_value);
+            statistics.max_int64 =
+                SignedMax(statistics.max_int64, value.int64_value);
+          } else if (IsDoubleColumnType(type)) {
+            // Comparisons with NaN are `false`, so NaN is not reflected.
+            if (value.double_value < statistics.min_double) {
+              statistics.min_double = value.double_value;
+            }
+            if (value.double_value > statistics.max_double) {
+              statistics.max_double = value.double_value;
+            }
+          } else if (statistics.num_values == 0) {
+            statistics.min_bytes = std::string(value.bytes_value);
+            statistics.max_bytes = std::string(value.bytes_value);
+          } else if (value.bytes_value < statistics.min_bytes) {
+            statistics.min_bytes = std::string(value.bytes_value);
+          } else if (value.bytes_value > statistics.max_bytes) {
+            statistics.max_bytes = std::string(value.bytes_value);
+          }
+          ++statistics.num_values;
+          return false;
+        });
+    if (statistics.num_values == num_values_before) {
+      ++statistics.num_records_without_values;
+    }
+  }
+}
+
+void ChunkStatistics::BuildBloomFilters() {
+  for (const BloomFilterKeys& keys : bloom_filter_keys_) {
+    // Repeated values would only make the filter larger.
+    std::vector<uint64_t> key_hashes = keys.key_hashes;
+    std::sort(key_hashes.begin(), key_hashes.end());
+    key_hashes.erase(std::unique(key_hashes.begin(), key_hashes.end()),
+                     key_hashes.end());
+    columns_[keys.column_index].bloom_filter.emplace(key_hashes);
+  }
+}
+
+const ColumnStatistics* ChunkStatistics::Find(const Field& field,
+                                              ColumnType type) const {
+  for (const ColumnStatistics& statistics : columns_) {
+    if (statistics.column.type == type &&
+        statistics.column.field.path() == field.path()) {
+      return &statistics;
+    }
+  }
+  return nullptr;
+}
+
+// Format of column statistics chunk data, integers are varint64 unless
+// indicated otherwise:
+//  * `num_records`
+//  * `num_columns`
+//  * for each column:
+//    * length of the field path
+//    * field numbers (varint32)
+//    * column type (byte)
+//    * `num_values`
+//    * `num_records_without_values`
+//    * if `num_values > 0`, minimum and maximum value:
+//      * for types decoded as `int64_t`: ZigZag varint64
+//      * for types decoded as `double`: 8 bytes little endian
+//      * for `ColumnType::kBytes`: length and bytes
+//    * whether there is a Bloom filter (byte: 0 or 1)
+//    * if there is a Bloom filter, `BloomFilter::Encode()`
+void ChunkStatistics::Encode(Chunk& chunk) const {
+  chunk.Clear();
+  ChainWriter<> data_writer(&chunk.data);
+  WriteVarint64(num_records_, data_writer);
+  WriteVarint64(IntCast<uint64_t>(columns_.size()), data_writer);
+  for (const ColumnStatistics& statistics : columns_) {
+    const Field::Path& path = statistics.column.field.path();
+    WriteVarint64(IntCast<uint64_t>(path.size()), data_writer);
+    for (const int field_number : path) {
+      WriteVarint32(IntCast<uint32_t>(field_number), data_writer);
+    }
+    const ColumnType type = statistics.column.type;
+    data_writer.WriteByte(static_cast<uint8_t>(type));
+    WriteVarint64(statistics.num_values, data_writer);
+    WriteVarint64(statistics.num_records_without_values, data_writer);
+    if (statistics.num_values > 0) {
+      if (IsInt64ColumnType(type)) {
+        WriteVarint64(EncodeSint64(statistics.min_int64), data_writer);
+        WriteVarint64(EncodeSint64(statistics.max_int64), data_writer);
+      } else if (IsDoubleColumnType(type)) {
+        WriteLittleEndian64(EncodeDouble(statistics.min_double), data_writer);
+        WriteLittleEndian64(EncodeDouble(statistics.max_double), data_writer);
+      } else {
+        WriteBytes(statistics.min_bytes, data_writer);
+        WriteBytes(statistics.max_bytes, data_writer);
+      }
+    }
+    if (statistics.bloom_filter == absl::nullopt) {
+      data_writer.WriteByte(0);
+    } else {
+      data_writer.WriteByte(1);
+      statistics.bloom_filter->Encode(data_writer);
+    }
+  }
+  if (!data_writer.Close()) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << data_writer.status();
+  }
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kColumnStatistics, 0, 0);
+}
+
+bool ChunkStatistics::Decode(const Chunk& chunk) {
+  num_records_ = 0;
+  columns_.clear();
+  if (ABSL_PREDICT_FALSE(
+          chunk.header.chunk_type() != ChunkType::kColumnStatistics ||
+          chunk.header.num_records() != 0)) {
+    return false;
+  }
+  ChainReader<> data_reader(&chunk.data);
+  uint64_t num_records;
+  uint64_t num_columns;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, num_records) ||
+                         !ReadVarint64(data_reader, num_columns))) {
+    return false;
+  }
+  if (ABSL_PREDICT_FALSE(num_columns > data_reader.Size().value_or(0) / 6)) {
+    // Each column is encoded by at least six bytes.
+    return false;
+  }
+  std::vector<ColumnStatistics> columns(IntCast<size_t>(num_columns));
+  for (ColumnStatistics& statistics : columns) {
+    uint64_t path_size;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, path_size) ||
+                           path_size == 0 ||
+                           path_size > data_reader.Size().value_or(0))) {
+      return false;
+    }
+    for (uint64_t i = 0; i < path_size; ++i) {
+      uint32_t field_number;
+      if (ABSL_PREDICT_FALSE(!ReadVarint32(data_reader, field_number) ||
+                             field_number == 0 ||
+                             field_number > kMaxFieldNumber)) {
+        return false;
+      }
+      statistics.column.field.AddFieldNumber(IntCast<int>(field_number));
+    }
+    uint8_t type;
+    if (ABSL_PREDICT_FALSE(
+            !data_reader.ReadByte(type) ||
+            type > static_cast<uint8_t>(ColumnType::kBytes) ||
+            !ReadVarint64(data_reader, statistics.num_values) ||
+            !ReadVarint64(data_reader, statistics.num_records_without_values) ||
+            statistics.num_records_without_values > num_records)) {
+      return false;
+    }
+    statistics.column.type = static_cast<ColumnType>(type);
+    if (statistics.num_values == 0) {
+      // No minimum and maximum value.
+    } else if (IsInt64ColumnType(statistics.column.type)) {
+      uint64_t min_repr;
+      uint64_t max_repr;
+      if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, min_repr) ||
+                             !ReadVarint64(data_reader, max_repr))) {
+        return false;
+      }
+      statistics.min_int64 = DecodeSint64(min_repr);
+      statistics.max_int64 = DecodeSint64(max_repr);
+    } else if (IsDoubleColumnType(statistics.column.type)) {
+      if (ABSL_PREDICT_FALSE(!ReadDouble(data_reader, statistics.min_double) ||
+                             !ReadDouble(data_reader, statistics.max_double))) {
+        return false;
+      }
+    } else {
+      if (ABSL_PREDICT_FALSE(!ReadBytes(data_reader, statistics.min_bytes) ||
+                             !ReadBytes(data_reader, statistics.max_bytes))) {
+        return false;
+      }
+    }
+    uint8_t has_bloom_filter;
+    if (ABSL_PREDICT_FALSE(!data_reader.ReadByte(has_bloom_filter) ||
+                           has_bloom_filter > 1)) {
+      return false;
+    }
+    if (has_bloom_filter == 1) {
+      statistics.bloom_filter.emplace();
+      if (ABSL_PREDICT_FALSE(!statistics.bloom_filter->Decode(data_reader))) {
+        return false;
+      }
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!data_reader.VerifyEndAndClose())) return false;
+  num_records_ = num_records;
+  columns_ = std::move(columns);
+  return true;
+}
+
+namespace internal {
+
+uint64_t ColumnValueHash(ColumnType type, const ColumnValue& value) {
+  char repr[sizeof(uint64_t)];
+  if (IsInt64ColumnType(type)) {
+    WriteLittleEndian64(static_cast<uint64_t>(value.int64_value), repr);
+  } else if (IsDoubleColumnType(type)) {
+    // -0.0 compares equal to 0.0, hence it must have the same hash.
+    WriteLittleEndian64(
+        EncodeDouble(value.double_value == 0.0 ? 0.0 : value.double_value),
+        repr);
+  } else {
+    return BloomFilter::HashKey(value.bytes_value);
+  }
+  return BloomFilter::HashKey(absl::string_view(repr, sizeof(repr)));
+}
+
+}  // namespace internal
+
+}  // namespace riegeli
@@ -0,0 +1,173 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_CHUNK_STATISTICS_H_
+#define RIEGELI_CHUNK_ENCODING_CHUNK_STATISTICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/chunk_encoding/bloom_filter.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+
+namespace riegeli {
+
+// Statistics of values of one column across the records of a chunk.
+struct ColumnStatistics {
+  ColumnSpec column;
+  // The number of values, counting each value of a repeated or packed field.
+  uint64_t num_values = 0;
+  // The number of records which have no values.
+  uint64_t num_records_without_values = 0;
+  // The minimum and maximum value, meaningful if `num_values > 0`. Only the
+  // members corresponding to how `column.type` is decoded are used.
+  //
+  // NaN values are not reflected in `min_double` and `max_double`. If all
+  // values are NaN, then `min_double > max_double`.
+  int64_t min_int64 = 0;
+  int64_t max_int64 = 0;
+  double min_double = 0.0;
+  double max_double = 0.0;
+  std::string min_bytes;
+  std::string max_bytes;
+  // If present, a Bloom filter of values hashed by
+  // `internal::ColumnValueHash()`, which allows to tell that no record of the
+  // chunk has a given value.
+  //
+  // When records are being added, it is present after `BuildBloomFilters()`.
+  absl::optional<BloomFilter> bloom_filter;
+};
+
+// Statistics of values of selected columns across the records of a chunk,
+// which allow to skip chunks with no records matching a `FieldPredicate`
+// without decoding them, like zone maps of columnar formats.
+//
+// `RecordWriter` writes them in a column statistics chunk following each
+// chunk with records if `RecordWriterBase::Options::column_statistics()` is
+// not empty. `RecordReader` uses them if a record filter is set.
+//
+// Values are taken from records as by `FieldPredicate`, so that a predicate
+// can match only records contributing to the statistics of its column.
+class ChunkStatistics {
+ public:
+  // Creates an empty `ChunkStatistics` with no columns.
+  ChunkStatistics() noexcept {}
+
+  // Creates an empty `ChunkStatistics` of the given columns.
+  //
+  // Columns in `bloom_filter_columns` also have Bloom filters of their values.
+  // They are added to `columns` if they are not already there.
+  explicit ChunkStatistics(
+      const std::vector<ColumnSpec>& columns,
+      const std::vector<ColumnSpec>& bloom_filter_columns = {});
+
+  ChunkStatistics(const ChunkStatistics& that);
+  ChunkStatistics& operator=(const ChunkStatistics& that);
+
+  ChunkStatistics(ChunkStatistics&& that) noexcept;
+  ChunkStatistics& operator=(ChunkStatistics&& that) noexcept;
+
+  // Resets statistics of all columns as if no records were added. Keeps the
+  // columns unchanged.
+  void Clear();
+
+  // Updates statistics with values of the next record.
+  void AddRecord(absl::string_view record);
+
+  // Builds Bloom filters of values of records added so far. This should be
+  // called after the last `AddRecord()`, before `Encode()`.
+  void BuildBloomFilters();
+
+  // Returns the number of records added.
+  uint64_t num_records() const { return num_records_; }
+
+  // Returns statistics of all columns.
+  const std::vector<ColumnStatistics>& columns() const { return columns_; }
+
+  // Returns statistics of the given column, or `nullptr` if it is not
+  // present.
+  const ColumnStatistics* Find(const Field& field, ColumnType type) const;
+
+  // Encodes statistics as a column statistics chunk.
+  void Encode(Chunk& chunk) const;
+
+  // Decodes statistics from a column statistics chunk.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - the chunk is not a valid column statistics chunk
+  //              (`*this` is cleared to no columns)
+  bool Decode(const Chunk& chunk);
+
+ private:
+  // Hashes of values of a column with a Bloom filter.
+  struct BloomFilterKeys {
+    size_t column_index;
+    std::vector<uint64_t> key_hashes;
+  };
+
+  void ClearColumn(ColumnStatistics& statistics);
+
+  uint64_t num_records_ = 0;
+  std::vector<ColumnStatistics> columns_;
+  std::vector<BloomFilterKeys> bloom_filter_keys_;
+};
+
+namespace internal {
+
+// Returns the hash of a value, as included in `ColumnStatistics::bloom_filter`.
+// Values which compare equal have the same hash.
+uint64_t ColumnValueHash(ColumnType type, const ColumnValue& value);
+
+}  // namespace internal
+
+// Implementation details follow.
+
+inline ChunkStatistics::ChunkStatistics(const ChunkStatistics& that)
+    : num_records_(that.num_records_),
+      columns_(that.columns_),
+      bloom_filter_keys_(that.bloom_filter_keys_) {}
+
+inline ChunkStatistics& ChunkStatistics::operator=(
+    const ChunkStatistics& that) {
+  num_records_ = that.num_records_;
+  columns_ = that.columns_;
+  bloom_filter_keys_ = that.bloom_filter_keys_;
+  return *this;
+}
+
+inline ChunkStatistics::ChunkStatistics(ChunkStatistics&& that) noexcept
+    : num_records_(std::exchange(that.num_records_, 0)),
+      columns_(std::move(that.columns_)),
+      bloom_filter_keys_(std::move(that.bloom_filter_keys_)) {}
+
+inline ChunkStatistics& ChunkStatistics::operator=(
+    ChunkStatistics&& that) noexcept {
+  num_records_ = std::exchange(that.num_records_, 0);
+  columns_ = std::move(that.columns_);
+  bloom_filter_keys_ = std::move(that.bloom_filter_keys_);
+  return *this;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_CHUNK_STATISTICS_H_
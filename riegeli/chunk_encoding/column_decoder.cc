@@ -0,0 +1,222 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/column_decoder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+
+namespace {
+
+FieldProjection ColumnsFieldProjection(const std::vector<ColumnSpec>& columns) {
+  FieldProjection field_projection;
+  for (const ColumnSpec& column : columns) {
+    field_projection.AddField(column.field);
+  }
+  return field_projection;
+}
+
+void AppendValue(ColumnType type, const internal::ColumnValue& value,
+                 Column& column) {
+  if (IsInt64ColumnType(type)) {
+    column.int64_values.push_back(value.int64_value);
+  } else if (IsDoubleColumnType(type)) {
+    column.double_values.push_back(value.double_value);
+  } else {
+    column.bytes_values.push_back(value.bytes_value);
+  }
+}
+
+}  // namespace
+
+ColumnDecoder::ColumnDecoder(Options options)
+    : column_specs_(std::move(options.columns())),
+      chunk_decoder_(
+          ChunkDecoder::Options()
+              .set_field_projection(ColumnsFieldProjection(column_specs_))
+              .set_executor(options.executor())
+              .set_zstd_dictionary(std::move(options.zstd_dictionary()))) {}
+
+void ColumnDecoder::Done() {
+  chunk_decoder_.Close();
+  columns_ = std::vector<Column>();
+}
+
+bool ColumnDecoder::Decode(const Chunk& chunk) {
+  Object::Reset();
+  num_records_ = 0;
+  columns_.clear();
+  for (const ColumnSpec& column_spec : column_specs_) {
+    const Field::Path& path = column_spec.field.path();
+    if (ABSL_PREDICT_FALSE(path.empty())) {
+      return Fail(absl::InvalidArgumentError("Empty column field path"));
+    }
+    for (const int field_number : path) {
+      if (ABSL_PREDICT_FALSE(field_number == Field::kExistenceOnly)) {
+        return Fail(absl::InvalidArgumentError(
+            "Column field path must not contain Field::kExistenceOnly"));
+      }
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_decoder_.Decode(chunk))) {
+    return Fail(chunk_decoder_.status());
+  }
+  std::vector<absl::string_view> records;
+  if (ABSL_PREDICT_FALSE(!chunk_decoder_.ReadRecords(records)) &&
+      ABSL_PREDICT_FALSE(!chunk_decoder_.healthy())) {
+    return Fail(chunk_decoder_.status());
+  }
+  columns_.resize(column_specs_.size());
+  for (size_t i = 0; i < column_specs_.size(); ++i) {
+    for (const absl::string_view record : records) {
+      if (ABSL_PREDICT_FALSE(
+              !DecodeMessage(column_specs_[i], record, 0, 0, columns_[i]))) {
+        return false;
+      }
+    }
+  }
+  num_records_ = IntCast<uint64_t>(records.size());
+  return true;
+}
+
+bool ColumnDecoder::DecodeMessage(const ColumnSpec& column_spec,
+                                  absl::string_view message, uint32_t depth,
+                                  uint32_t repetition_level, Column& column) {
+  const Field::Path& path = column_spec.field.path();
+  const char* cursor = message.data();
+  const char* const limit = message.data() + message.size();
+  bool found = false;
+  while (cursor < limit) {
+    uint32_t tag;
+    const absl::optional<const char*> tag_end =
+        ReadVarint32(cursor, limit, tag);
+    if (ABSL_PREDICT_FALSE(tag_end == absl::nullopt)) {
+      return Fail(absl::InvalidArgumentError("Invalid field tag"));
+    }
+    cursor = *tag_end;
+    if (GetTagFieldNumber(tag) != path[depth]) {
+      const absl::optional<const char*> value_end =
+          internal::SkipFieldValue(tag, cursor, limit);
+      if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) {
+        return Fail(absl::InvalidArgumentError(
+            absl::StrCat("Invalid value of field ", GetTagFieldNumber(tag))));
+      }
+      cursor = *value_end;
+      continue;
+    }
+    // The first occurrence inherits the repetition level of the parent, further
+    // occurrences repeat this field.
+    const uint32_t level = found ? depth + 1 : repetition_level;
+    const size_t num_entries = column.definition_levels.size();
+    if (depth + 1 < path.size()) {
+      if (ABSL_PREDICT_FALSE(GetTagWireType(tag) !=
+                             WireType::kLengthDelimited)) {
+        return Fail(absl::InvalidArgumentError(
+            absl::StrCat("Field ", path[depth], " is not a submessage")));
+      }
+      uint32_t length;
+      const absl::optional<const char*> submessage =
+          internal::ReadFieldLength(cursor, limit, length);
+      if (ABSL_PREDICT_FALSE(submessage == absl::nullopt)) {
+        return Fail(absl::InvalidArgumentError(
+            absl::StrCat("Invalid value of field ", path[depth])));
+      }
+      cursor = *submessage;
+      if (ABSL_PREDICT_FALSE(
+              !DecodeMessage(column_spec, absl::string_view(cursor, length),
+                             depth + 1, level, column))) {
+        return false;
+      }
+      cursor += length;
+    } else {
+      if (ABSL_PREDICT_FALSE(!DecodeValue(column_spec, GetTagWireType(tag),
+                                          cursor, limit, level, column))) {
+        return false;
+      }
+    }
+    // An empty packed field contributes no entries.
+    if (column.definition_levels.size() != num_entries) found = true;
+  }
+  if (!found) {
+    column.repetition_levels.push_back(repetition_level);
+    column.definition_levels.push_back(depth);
+  }
+  return true;
+}
+
+bool ColumnDecoder::DecodeValue(const ColumnSpec& column_spec,
+                                WireType wire_type, const char*& cursor,
+                                const char* limit, uint32_t repetition_level,
+                                Column& column) {
+  const Field::Path& path = column_spec.field.path();
+  const uint32_t max_level = IntCast<uint32_t>(path.size());
+  const char* value_limit = limit;
+  bool packed = false;
+  if (wire_type != internal::ColumnWireType(column_spec.type)) {
+    if (ABSL_PREDICT_FALSE(wire_type != WireType::kLengthDelimited ||
+                           column_spec.type == ColumnType::kBytes)) {
+      return Fail(absl::InvalidArgumentError(
+          absl::StrCat("Unexpected wire type of field ", path.back(), ": ",
+                       static_cast<uint32_t>(wire_type))));
+    }
+    uint32_t length;
+    const absl::optional<const char*> values =
+        internal::ReadFieldLength(cursor, limit, length);
+    if (ABSL_PREDICT_FALSE(values == absl::nullopt)) {
+      return Fail(absl::InvalidArgumentError(
+          absl::StrCat("Invalid value of field ", path.back())));
+    }
+    cursor = *values;
+    value_limit = cursor + length;
+    packed = true;
+  }
+  // A non-packed field has one value, a packed field has any number of values
+  // until `value_limit`.
+  while (!packed || cursor < value_limit) {
+    internal::ColumnValue value;
+    const absl::optional<const char*> value_end =
+        internal::ReadColumnValue(column_spec.type, cursor, value_limit, value);
+    if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) {
+      return Fail(absl::InvalidArgumentError(
+          absl::StrCat("Invalid value of field ", path.back())));
+    }
+    cursor = *value_end;
+    AppendValue(column_spec.type, value, column);
+    column.repetition_levels.push_back(repetition_level);
+    column.definition_levels.push_back(max_level);
+    if (!packed) break;
+    repetition_level = max_level;
+  }
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,177 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_COLUMN_DECODER_H_
+#define RIEGELI_CHUNK_ENCODING_COLUMN_DECODER_H_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/zstd/zstd_dictionary.h"
+
+namespace riegeli {
+
+// Values of one column across the records of a chunk, in the repetition and
+// definition level representation of Dremel.
+//
+// For each occurrence of the leaf field, and for each place where a field of
+// the path is absent, there is an entry in `repetition_levels` and
+// `definition_levels`:
+//  * The repetition level is 0 for the first entry of a record, and otherwise
+//    the number of path elements down to the field which repeated.
+//  * The definition level is the number of path elements present. Only
+//    entries with the definition level equal to the path length have a value,
+//    stored in the next element of `int64_values`, `double_values`, or
+//    `bytes_values`, depending on how the `ColumnType` is decoded.
+//
+// A chunk does not carry the proto schema, hence each field of the path is
+// treated as possibly repeated. For a singular field its repetition is never
+// observed, so the result is the same as with the schema.
+struct Column {
+  std::vector<uint32_t> repetition_levels;
+  std::vector<uint32_t> definition_levels;
+  std::vector<int64_t> int64_values;
+  std::vector<double> double_values;
+  // Valid until the next non-const operation on the `ColumnDecoder`.
+  std::vector<absl::string_view> bytes_values;
+};
+
+// Decodes selected fields of records of a chunk as columns of typed values.
+//
+// The chunk is decoded with a field projection including only the selected
+// fields, so that buckets of a transposed chunk not needed for them are not
+// decompressed. Values are then taken from the serialized records directly,
+// without parsing them to proto messages.
+class ColumnDecoder : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Columns to decode.
+    //
+    // Default: no columns.
+    Options& set_columns(const std::vector<ColumnSpec>& columns) & {
+      columns_ = columns;
+      return *this;
+    }
+    Options& set_columns(std::vector<ColumnSpec>&& columns) & {
+      columns_ = std::move(columns);
+      return *this;
+    }
+    Options&& set_columns(const std::vector<ColumnSpec>& columns) && {
+      return std::move(set_columns(columns));
+    }
+    Options&& set_columns(std::vector<ColumnSpec>&& columns) && {
+      return std::move(set_columns(std::move(columns)));
+    }
+    std::vector<ColumnSpec>& columns() { return columns_; }
+    const std::vector<ColumnSpec>& columns() const { return columns_; }
+
+    // If not `nullptr`, buckets of transposed chunks are decompressed in
+    // parallel using tasks scheduled on `executor`.
+    //
+    // The `Executor` is not owned and must outlive the `ColumnDecoder`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+    // Zstd dictionary for chunks compressed with
+    // `CompressionType::kZstdWithDictionary`.
+    //
+    // Default: `ZstdDictionary()`.
+    Options& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) & {
+      zstd_dictionary_ = zstd_dictionary;
+      return *this;
+    }
+    Options& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) & {
+      zstd_dictionary_ = std::move(zstd_dictionary);
+      return *this;
+    }
+    Options&& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(zstd_dictionary));
+    }
+    Options&& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(std::move(zstd_dictionary)));
+    }
+    ZstdDictionary& zstd_dictionary() { return zstd_dictionary_; }
+    const ZstdDictionary& zstd_dictionary() const { return zstd_dictionary_; }
+
+   private:
+    std::vector<ColumnSpec> columns_;
+    Executor* executor_ = nullptr;
+    ZstdDictionary zstd_dictionary_;
+  };
+
+  // Creates an empty `ColumnDecoder`.
+  explicit ColumnDecoder(Options options = Options());
+
+  ColumnDecoder(const ColumnDecoder&) = delete;
+  ColumnDecoder& operator=(const ColumnDecoder&) = delete;
+
+  // Resets the `ColumnDecoder` and decodes the columns of the chunk. Keeps
+  // options unchanged.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Decode(const Chunk& chunk);
+
+  // Returns the number of records of the last decoded chunk.
+  uint64_t num_records() const { return num_records_; }
+
+  // Returns decoded columns, parallel to `Options::columns()`.
+  const std::vector<Column>& columns() const { return columns_; }
+
+ protected:
+  void Done() override;
+
+ private:
+  // Appends entries for fields of `column_spec.field.path()` starting from
+  // `depth` found in `message`, which is at `depth`.
+  bool DecodeMessage(const ColumnSpec& column_spec, absl::string_view message,
+                     uint32_t depth, uint32_t repetition_level,
+                     Column& column);
+  // Appends the value of the leaf field, or values if it is packed, reading
+  // them from `cursor` and advancing it.
+  bool DecodeValue(const ColumnSpec& column_spec, WireType wire_type,
+                   const char*& cursor, const char* limit,
+                   uint32_t repetition_level, Column& column);
+
+  std::vector<ColumnSpec> column_specs_;
+  ChunkDecoder chunk_decoder_;
+  uint64_t num_records_ = 0;
+  std::vector<Column> columns_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_COLUMN_DECODER_H_
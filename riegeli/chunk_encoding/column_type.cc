@@ -0,0 +1,170 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/column_type.h"
+
+#include <stdint.h>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+namespace internal {
+
+WireType ColumnWireType(ColumnType type) {
+  switch (type) {
+    case ColumnType::kInt64:
+    case ColumnType::kSInt64:
+      return WireType::kVarint;
+    case ColumnType::kFixed32:
+    case ColumnType::kSFixed32:
+    case ColumnType::kFloat:
+      return WireType::kFixed32;
+    case ColumnType::kFixed64:
+    case ColumnType::kDouble:
+      return WireType::kFixed64;
+    case ColumnType::kBytes:
+      return WireType::kLengthDelimited;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown column type: " << static_cast<int>(type);
+}
+
+absl::optional<const char*> ReadFieldLength(const char* src, const char* limit,
+                                            uint32_t& length) {
+  const absl::optional<const char*> cursor = ReadVarint32(src, limit, length);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(length > PtrDistance(*cursor, limit))) {
+    return absl::nullopt;
+  }
+  return *cursor;
+}
+
+absl::optional<const char*> ReadColumnValue(ColumnType type, const char* src,
+                                            const char* limit,
+                                            ColumnValue& value) {
+  switch (type) {
+    case ColumnType::kInt64:
+    case ColumnType::kSInt64: {
+      uint64_t repr;
+      const absl::optional<const char*> cursor = ReadVarint64(src, limit, repr);
+      if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+      value.int64_value = type == ColumnType::kSInt64
+                              ? DecodeSint64(repr)
+                              : static_cast<int64_t>(repr);
+      return *cursor;
+    }
+    case ColumnType::kFixed32:
+    case ColumnType::kSFixed32:
+    case ColumnType::kFloat: {
+      if (ABSL_PREDICT_FALSE(PtrDistance(src, limit) < sizeof(uint32_t))) {
+        return absl::nullopt;
+      }
+      const uint32_t repr = ReadLittleEndian32(src);
+      switch (type) {
+        case ColumnType::kFixed32:
+          value.int64_value = int64_t{repr};
+          break;
+        case ColumnType::kSFixed32:
+          value.int64_value = int64_t{static_cast<int32_t>(repr)};
+          break;
+        default:
+          value.double_value = double{DecodeFloat(repr)};
+          break;
+      }
+      return src + sizeof(uint32_t);
+    }
+    case ColumnType::kFixed64:
+    case ColumnType::kDouble: {
+      if (ABSL_PREDICT_FALSE(PtrDistance(src, limit) < sizeof(uint64_t))) {
+        return absl::nullopt;
+      }
+      const uint64_t repr = ReadLittleEndian64(src);
+      if (type == ColumnType::kDouble) {
+        value.double_value = DecodeDouble(repr);
+      } else {
+        value.int64_value = static_cast<int64_t>(repr);
+      }
+      return src + sizeof(uint64_t);
+    }
+    case ColumnType::kBytes: {
+      uint32_t length;
+      const absl::optional<const char*> cursor =
+          ReadFieldLength(src, limit, length);
+      if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+      value.bytes_value = absl::string_view(*cursor, length);
+      return *cursor + length;
+    }
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown column type: " << static_cast<int>(type);
+}
+
+absl::optional<const char*> SkipFieldValue(uint32_t tag, const char* src,
+                                           const char* limit) {
+  switch (GetTagWireType(tag)) {
+    case WireType::kVarint: {
+      uint64_t value;
+      return ReadVarint64(src, limit, value);
+    }
+    case WireType::kFixed32:
+      if (ABSL_PREDICT_FALSE(PtrDistance(src, limit) < sizeof(uint32_t))) {
+        return absl::nullopt;
+      }
+      return src + sizeof(uint32_t);
+    case WireType::kFixed64:
+      if (ABSL_PREDICT_FALSE(PtrDistance(src, limit) < sizeof(uint64_t))) {
+        return absl::nullopt;
+      }
+      return src + sizeof(uint64_t);
+    case WireType::kLengthDelimited: {
+      uint32_t length;
+      const absl::optional<const char*> cursor =
+          ReadFieldLength(src, limit, length);
+      if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+      return *cursor + length;
+    }
+    case WireType::kStartGroup:
+      for (;;) {
+        uint32_t inner_tag;
+        const absl::optional<const char*> cursor =
+            ReadVarint32(src, limit, inner_tag);
+        if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+        src = *cursor;
+        if (GetTagWireType(inner_tag) == WireType::kEndGroup) {
+          if (ABSL_PREDICT_FALSE(GetTagFieldNumber(inner_tag) !=
+                                 GetTagFieldNumber(tag))) {
+            return absl::nullopt;
+          }
+          return src;
+        }
+        const absl::optional<const char*> value_end =
+            SkipFieldValue(inner_tag, src, limit);
+        if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) {
+          return absl::nullopt;
+        }
+        src = *value_end;
+      }
+    default:
+      return absl::nullopt;
+  }
+}
+
+}  // namespace internal
+}  // namespace riegeli
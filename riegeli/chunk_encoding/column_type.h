@@ -0,0 +1,216 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_COLUMN_TYPE_H_
+#define RIEGELI_CHUNK_ENCODING_COLUMN_TYPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+
+// How values of a field are represented in the serialized proto, which
+// determines how they are decoded. A chunk does not carry the proto schema,
+// hence the type must be given by the caller.
+//
+// These values are frozen in the file format of column statistics chunks.
+enum class ColumnType : uint8_t {
+  // Varint: `int32`, `int64`, `uint32`, `uint64`, `bool`, enum. Decoded as
+  // `int64_t`.
+  kInt64 = 0,
+  // ZigZag varint: `sint32`, `sint64`. Decoded as `int64_t`.
+  kSInt64 = 1,
+  // `fixed32`, zero-extended. Decoded as `int64_t`.
+  kFixed32 = 2,
+  // `sfixed32`, sign-extended. Decoded as `int64_t`.
+  kSFixed32 = 3,
+  // `fixed64`, `sfixed64`. Decoded as `int64_t`.
+  kFixed64 = 4,
+  // `float`. Decoded as `double`.
+  kFloat = 5,
+  // `double`. Decoded as `double`.
+  kDouble = 6,
+  // `string`, `bytes`. Decoded as `absl::string_view`.
+  kBytes = 7,
+};
+
+// Specifies a column: a field path and the type of its values.
+//
+// All fields of the path except the last one must be submessages (not
+// groups). The path must not be empty nor end with `Field::kExistenceOnly`.
+struct ColumnSpec {
+  Field field;
+  ColumnType type;
+};
+
+// Returns `true` if values of `type` are decoded as `int64_t`.
+bool IsInt64ColumnType(ColumnType type);
+
+// Returns `true` if values of `type` are decoded as `double`.
+bool IsDoubleColumnType(ColumnType type);
+
+namespace internal {
+
+// A decoded value of a field. The member which is set depends on the
+// `ColumnType`.
+struct ColumnValue {
+  int64_t int64_value = 0;
+  double double_value = 0.0;
+  absl::string_view bytes_value;
+};
+
+// Returns the wire type of a non-packed field of the given type.
+WireType ColumnWireType(ColumnType type);
+
+// Reads the length of a length-delimited field value, and checks that the
+// value fits before `limit`.
+//
+// Returns the position after the length, or `absl::nullopt` if the data are
+// invalid.
+absl::optional<const char*> ReadFieldLength(const char* src, const char* limit,
+                                            uint32_t& length);
+
+// Reads one value of a field of the given type. For `ColumnType::kBytes` this
+// includes the length.
+//
+// Returns the position after the value, or `absl::nullopt` if the data are
+// invalid.
+absl::optional<const char*> ReadColumnValue(ColumnType type, const char* src,
+                                            const char* limit,
+                                            ColumnValue& value);
+
+// Skips the value of a field with the given tag.
+//
+// Returns the position after the value, or `absl::nullopt` if the data are
+// invalid.
+absl::optional<const char*> SkipFieldValue(uint32_t tag, const char* src,
+                                           const char* limit);
+
+// Calls `action(value)` for each value of the field with the given `path` of
+// the given `type` in `message`, including each value of a packed field.
+// Values of an unexpected wire type are skipped. Stops early if `action`
+// returns `true`.
+//
+// Returns `true` if `action` returned `true`, or `false` if there are no
+// more values or `message` is invalid.
+template <typename Action>
+bool ForEachColumnValue(const Field::Path& path, ColumnType type,
+                        absl::string_view message, Action&& action);
+
+}  // namespace internal
+
+// Implementation details follow.
+
+inline bool IsInt64ColumnType(ColumnType type) {
+  switch (type) {
+    case ColumnType::kInt64:
+    case ColumnType::kSInt64:
+    case ColumnType::kFixed32:
+    case ColumnType::kSFixed32:
+    case ColumnType::kFixed64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+inline bool IsDoubleColumnType(ColumnType type) {
+  return type == ColumnType::kFloat || type == ColumnType::kDouble;
+}
+
+namespace internal {
+
+template <typename Action>
+bool ForEachColumnValueImpl(const Field::Path& path, size_t depth,
+                            ColumnType type, absl::string_view message,
+                            Action& action) {
+  const char* cursor = message.data();
+  const char* const limit = message.data() + message.size();
+  while (cursor < limit) {
+    uint32_t tag;
+    const absl::optional<const char*> tag_end =
+        ReadVarint32(cursor, limit, tag);
+    if (ABSL_PREDICT_FALSE(tag_end == absl::nullopt)) return false;
+    cursor = *tag_end;
+    const WireType wire_type = GetTagWireType(tag);
+    if (GetTagFieldNumber(tag) == path[depth]) {
+      if (depth + 1 < path.size()) {
+        if (wire_type == WireType::kLengthDelimited) {
+          uint32_t length;
+          const absl::optional<const char*> submessage =
+              ReadFieldLength(cursor, limit, length);
+          if (ABSL_PREDICT_FALSE(submessage == absl::nullopt)) return false;
+          cursor = *submessage;
+          if (ForEachColumnValueImpl(path, depth + 1, type,
+                                     absl::string_view(cursor, length),
+                                     action)) {
+            return true;
+          }
+          cursor += length;
+          continue;
+        }
+      } else if (wire_type == ColumnWireType(type)) {
+        ColumnValue value;
+        const absl::optional<const char*> value_end =
+            ReadColumnValue(type, cursor, limit, value);
+        if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) return false;
+        if (action(value)) return true;
+        cursor = *value_end;
+        continue;
+      } else if (wire_type == WireType::kLengthDelimited) {
+        // Packed repeated field.
+        uint32_t length;
+        const absl::optional<const char*> values =
+            ReadFieldLength(cursor, limit, length);
+        if (ABSL_PREDICT_FALSE(values == absl::nullopt)) return false;
+        cursor = *values;
+        const char* const values_limit = cursor + length;
+        while (cursor < values_limit) {
+          ColumnValue value;
+          const absl::optional<const char*> value_end =
+              ReadColumnValue(type, cursor, values_limit, value);
+          if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) return false;
+          if (action(value)) return true;
+          cursor = *value_end;
+        }
+        continue;
+      }
+      // A value of an unexpected wire type is skipped.
+    }
+    const absl::optional<const char*> value_end =
+        SkipFieldValue(tag, cursor, limit);
+    if (ABSL_PREDICT_FALSE(value_end == absl::nullopt)) return false;
+    cursor = *value_end;
+  }
+  return false;
+}
+
+template <typename Action>
+inline bool ForEachColumnValue(const Field::Path& path, ColumnType type,
+                               absl::string_view message, Action&& action) {
+  return ForEachColumnValueImpl(path, 0, type, message, action);
+}
+
+}  // namespace internal
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_COLUMN_TYPE_H_
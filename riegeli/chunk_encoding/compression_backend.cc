@@ -0,0 +1,91 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/compression_backend.h"
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/memory.h"
+#include "riegeli/chunk_encoding/constants.h"
+
+namespace riegeli {
+
+namespace {
+
+class CompressionBackendRegistry {
+ public:
+  static CompressionBackendRegistry& global() {
+    static NoDestructor<CompressionBackendRegistry> kStaticRegistry;
+    return *kStaticRegistry;
+  }
+
+  void Register(CompressionType compression_type,
+                std::shared_ptr<CompressionBackend> backend) {
+    // Destroy the previous backend after releasing `mutex_`.
+    std::shared_ptr<CompressionBackend> previous;
+    absl::MutexLock lock(&mutex_);
+    std::shared_ptr<CompressionBackend>& entry =
+        backends_[static_cast<size_t>(compression_type)];
+    if (entry == nullptr) {
+      if (backend != nullptr) ++num_registered_;
+    } else if (backend == nullptr) {
+      --num_registered_;
+    }
+    previous = std::exchange(entry, std::move(backend));
+    any_registered_.store(num_registered_ > 0, std::memory_order_release);
+  }
+
+  std::shared_ptr<CompressionBackend> Get(CompressionType compression_type) {
+    // Avoid taking `mutex_` in the common case when no backend is registered.
+    if (ABSL_PREDICT_TRUE(!any_registered_.load(std::memory_order_acquire))) {
+      return nullptr;
+    }
+    absl::MutexLock lock(&mutex_);
+    return backends_[static_cast<size_t>(compression_type)];
+  }
+
+ private:
+  std::atomic<bool> any_registered_{false};
+  absl::Mutex mutex_;
+  size_t num_registered_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Indexed by `CompressionType`, which is a byte.
+  std::shared_ptr<CompressionBackend> backends_[256] ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace
+
+void RegisterCompressionBackend(CompressionType compression_type,
+                                std::shared_ptr<CompressionBackend> backend) {
+  RIEGELI_ASSERT(compression_type != CompressionType::kNone)
+      << "Failed precondition of RegisterCompressionBackend(): "
+         "uncompressed data need no backend";
+  CompressionBackendRegistry::global().Register(compression_type,
+                                                std::move(backend));
+}
+
+std::shared_ptr<CompressionBackend> GetCompressionBackend(
+    CompressionType compression_type) {
+  if (compression_type == CompressionType::kNone) return nullptr;
+  return CompressionBackendRegistry::global().Get(compression_type);
+}
+
+}  // namespace riegeli
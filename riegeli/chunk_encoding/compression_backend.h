@@ -0,0 +1,109 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_COMPRESSION_BACKEND_H_
+#define RIEGELI_CHUNK_ENCODING_COMPRESSION_BACKEND_H_
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/zstd/zstd_dictionary.h"
+
+namespace riegeli {
+
+// A `CompressionBackend` serves a `CompressionType` by means other than the
+// software libraries linked with Riegeli, e.g. by offloading compression to a
+// hardware accelerator.
+//
+// A backend must produce and consume the same stream format as the software
+// implementation of its `CompressionType`, so that files remain readable with
+// or without the backend. A backend may decline any request, in which case the
+// software implementation is used instead.
+//
+// Member functions may be called concurrently from multiple threads.
+class CompressionBackend {
+ public:
+  virtual ~CompressionBackend() = default;
+
+  // Returns a `Writer` which compresses data written to it, and which writes
+  // the compressed stream to `*dest` when closed or earlier. `*dest` is
+  // initially empty and must not be accessed by the caller until the `Writer`
+  // is closed.
+  //
+  // `pledged_size`, if not `absl::nullopt`, is the exact uncompressed size.
+  // `size_hint`, if not `absl::nullopt`, is the expected uncompressed size.
+  //
+  // Returns `nullptr` to fall back to software compression, e.g. if the
+  // accelerator is not available or does not support these options.
+  virtual std::unique_ptr<Writer> NewCompressor(
+      Chain* dest, const CompressorOptions& compressor_options,
+      absl::optional<Position> pledged_size,
+      absl::optional<Position> size_hint) = 0;
+
+  // Returns `true` if `NewDecompressor()` should be used for
+  // `compression_type`, or `false` to fall back to software decompression.
+  //
+  // The default implementation returns `false`.
+  virtual bool SupportsDecompression(CompressionType compression_type,
+                                     const ZstdDictionary& zstd_dictionary) {
+    return false;
+  }
+
+  // Returns a `Reader` which decompresses the compressed stream read from
+  // `*src`. The `Reader` takes ownership of `src`, closes it when closed, and
+  // its `VerifyEnd()` also verifies that `*src` ends after the compressed
+  // stream.
+  //
+  // `uncompressed_size` is the uncompressed size stored before the compressed
+  // stream. `zstd_dictionary` is given for
+  // `CompressionType::kZstdWithDictionary`.
+  //
+  // Called only if `SupportsDecompression()` returned `true`. Failures should
+  // be reported by the returned `Reader`; returning `nullptr` fails the
+  // decompression.
+  //
+  // The default implementation returns `nullptr`.
+  virtual std::unique_ptr<Reader> NewDecompressor(
+      std::unique_ptr<Reader> src, CompressionType compression_type,
+      const ZstdDictionary& zstd_dictionary, uint64_t uncompressed_size) {
+    return nullptr;
+  }
+};
+
+// Makes `backend` serve `compression_type` for `Compressor` and `Decompressor`
+// objects created later, replacing any previously registered backend for this
+// `compression_type`. If `backend` is `nullptr`, unregisters the backend.
+//
+// Objects which already use a backend keep using it.
+//
+// Precondition: `compression_type != CompressionType::kNone`
+void RegisterCompressionBackend(CompressionType compression_type,
+                                std::shared_ptr<CompressionBackend> backend);
+
+// Returns the backend registered for `compression_type`, or `nullptr` if the
+// software implementation should be used.
+std::shared_ptr<CompressionBackend> GetCompressionBackend(
+    CompressionType compression_type);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_COMPRESSION_BACKEND_H_
@@ -14,24 +14,34 @@
 
 #include "riegeli/chunk_encoding/compressor.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <cmath>
 #include <memory>
+#include <string>
 #include <tuple>
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
 #include "riegeli/brotli/brotli_writer.h"
+#include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/compression_backend.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/lz4/lz4_writer.h"
 #include "riegeli/snappy/snappy_writer.h"
 #include "riegeli/varint/varint_writing.h"
+#include "riegeli/zlib/zlib_writer.h"
 #include "riegeli/zstd/zstd_writer.h"
+#include "snappy.h"
 
 namespace riegeli {
 namespace internal {
@@ -54,6 +64,15 @@ void Compressor::Clear() {
 }
 
 void Compressor::Initialize() {
+  backend_ = GetCompressionBackend(compressor_options_.compression_type());
+  if (backend_ != nullptr) {
+    compressed_.Clear();
+    writer_ = backend_->NewCompressor(&compressed_, compressor_options_,
+                                      tuning_options_.pledged_size(),
+                                      tuning_options_.size_hint());
+    if (writer_ != nullptr) return;
+    backend_.reset();
+  }
   switch (compressor_options_.compression_type()) {
     case CompressionType::kNone:
       writer_ = std::make_unique<ChainWriter<>>(
@@ -68,16 +87,22 @@ void Compressor::Initialize() {
           BrotliWriterBase::Options()
               .set_compression_level(compressor_options_.compression_level())
               .set_window_log(compressor_options_.brotli_window_log())
+              .set_allocator(compressor_options_.brotli_allocator())
               .set_size_hint(tuning_options_.pledged_size() != absl::nullopt
                                  ? tuning_options_.pledged_size()
                                  : tuning_options_.size_hint()));
       return;
     case CompressionType::kZstd:
+    case CompressionType::kZstdWithDictionary:
       writer_ = std::make_unique<ZstdWriter<ChainWriter<>>>(
           std::forward_as_tuple(&compressed_),
           ZstdWriterBase::Options()
               .set_compression_level(compressor_options_.compression_level())
               .set_window_log(compressor_options_.zstd_window_log())
+              .set_long_distance_matching(
+                  compressor_options_.zstd_long_distance_matching())
+              .set_num_workers(compressor_options_.zstd_num_workers())
+              .set_dictionary(compressor_options_.zstd_dictionary())
               .set_pledged_size(tuning_options_.pledged_size())
               .set_size_hint(tuning_options_.size_hint()));
       return;
@@ -87,6 +112,25 @@ void Compressor::Initialize() {
           SnappyWriterBase::Options().set_size_hint(
               tuning_options_.size_hint()));
       return;
+    case CompressionType::kLz4:
+      writer_ = std::make_unique<Lz4Writer<ChainWriter<>>>(
+          std::forward_as_tuple(&compressed_),
+          Lz4WriterBase::Options()
+              .set_compression_level(compressor_options_.compression_level())
+              .set_pledged_size(tuning_options_.pledged_size())
+              .set_size_hint(tuning_options_.size_hint()));
+      return;
+    case CompressionType::kZlib:
+      writer_ = std::make_unique<ZlibWriter<ChainWriter<>>>(
+          std::forward_as_tuple(&compressed_),
+          ZlibWriterBase::Options()
+              .set_compression_level(compressor_options_.compression_level())
+              .set_window_log(compressor_options_.zlib_window_log())
+              .set_header(ZlibWriterBase::Header::kZlib)
+              .set_size_hint(tuning_options_.pledged_size() != absl::nullopt
+                                 ? tuning_options_.pledged_size()
+                                 : tuning_options_.size_hint()));
+      return;
   }
   RIEGELI_ASSERT_UNREACHABLE()
       << "Unknown compression type: "
@@ -132,5 +176,72 @@ bool Compressor::LengthPrefixedEncodeAndClose(Writer& dest) {
   return Close();
 }
 
+namespace {
+
+// `WorthCompressing()` examines up to `kNumSamples` fragments of `kSampleSize`
+// bytes each, spread evenly over the data.
+constexpr size_t kNumSamples = 4;
+constexpr size_t kSampleSize = size_t{16} << 10;
+
+std::string Sample(const Chain& src) {
+  std::string sample;
+  ChainReader<> reader(&src);
+  if (src.size() <= kNumSamples * kSampleSize) {
+    reader.ReadAndAppend(src.size(), sample);
+    return sample;
+  }
+  sample.reserve(kNumSamples * kSampleSize);
+  const Position stride = src.size() / kNumSamples;
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    reader.Seek(i * stride);
+    reader.ReadAndAppend(kSampleSize, sample);
+  }
+  return sample;
+}
+
+// Estimates the fraction of the size of `sample` which could be saved by
+// entropy coding of individual bytes.
+double EntropyGain(absl::string_view sample) {
+  size_t counts[256] = {};
+  for (const char byte : sample) ++counts[static_cast<unsigned char>(byte)];
+  double entropy = 0.0;
+  for (const size_t count : counts) {
+    if (count == 0) continue;
+    const double probability =
+        static_cast<double>(count) / static_cast<double>(sample.size());
+    entropy -= probability * std::log2(probability);
+  }
+  return 1.0 - entropy / 8.0;
+}
+
+// Estimates the fraction of the size of `sample` which could be saved by
+// removing repeated strings.
+double SnappyGain(absl::string_view sample) {
+  std::string compressed;
+  snappy::Compress(sample.data(), sample.size(), &compressed);
+  return 1.0 - static_cast<double>(compressed.size()) /
+                   static_cast<double>(sample.size());
+}
+
+}  // namespace
+
+bool WorthCompressing(const Chain& src,
+                      const CompressorOptions& compressor_options) {
+  if (compressor_options.min_compression_gain() == absl::nullopt ||
+      compressor_options.compression_type() == CompressionType::kNone ||
+      src.empty()) {
+    return true;
+  }
+  const std::string sample = Sample(src);
+  const double min_gain = *compressor_options.min_compression_gain();
+  // Compression algorithms other than Snappy also use entropy coding, so for
+  // them it is enough that either estimate is large.
+  if (compressor_options.compression_type() != CompressionType::kSnappy &&
+      EntropyGain(sample) >= min_gain) {
+    return true;
+  }
+  return SnappyGain(sample) >= min_gain;
+}
+
 }  // namespace internal
 }  // namespace riegeli
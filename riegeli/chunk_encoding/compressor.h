@@ -24,6 +24,7 @@
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/compression_backend.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 
 namespace riegeli {
@@ -117,9 +118,19 @@ class Compressor : public Object {
   CompressorOptions compressor_options_;
   TuningOptions tuning_options_;
   Chain compressed_;
+  // The backend serving `writer_`, or `nullptr` for software compression.
+  std::shared_ptr<CompressionBackend> backend_;
   std::unique_ptr<Writer> writer_;
 };
 
+// Returns `false` if `compressor_options.min_compression_gain()` is set and
+// compressing `src` is estimated to save less than that fraction of its size,
+// in which case the data should be stored uncompressed instead.
+//
+// The estimate is cheap: it examines only a sample of `src`.
+bool WorthCompressing(const Chain& src,
+                      const CompressorOptions& compressor_options);
+
 // Implementation details follow.
 
 inline Writer& Compressor::writer() {
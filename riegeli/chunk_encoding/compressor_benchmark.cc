@@ -0,0 +1,198 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/null_writer.h"
+#include "riegeli/chunk_encoding/compressor.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/decompressor.h"
+
+namespace riegeli {
+namespace {
+
+// The amount of data compressed by one iteration.
+constexpr size_t kTotalSize = size_t{1} << 20;
+
+// Returns text of pseudo-random words from a small vocabulary, which
+// compresses to roughly a third of its size.
+Chain SampleText() {
+  std::mt19937 random(1);
+  std::vector<std::string> words;
+  std::uniform_int_distribution<size_t> length_distribution(1, 12);
+  std::uniform_int_distribution<int> letter_distribution('a', 'z');
+  for (size_t i = 0; i < 2000; ++i) {
+    std::string word(length_distribution(random), ' ');
+    for (char& letter : word) {
+      letter = static_cast<char>(letter_distribution(random));
+    }
+    words.push_back(std::move(word));
+  }
+  std::uniform_int_distribution<size_t> word_distribution(0, words.size() - 1);
+  std::string text;
+  while (text.size() < kTotalSize) {
+    text.append(words[word_distribution(random)]);
+    text.push_back(' ');
+  }
+  text.resize(kTotalSize);
+  return Chain(text);
+}
+
+CompressorOptions MakeCompressorOptions(CompressionType compression_type,
+                                        int compression_level) {
+  switch (compression_type) {
+    case CompressionType::kBrotli:
+      return CompressorOptions().set_brotli(compression_level);
+    case CompressionType::kZstd:
+      return CompressorOptions().set_zstd(compression_level);
+    case CompressionType::kSnappy:
+      return CompressorOptions().set_snappy();
+    case CompressionType::kLz4:
+      return CompressorOptions().set_lz4(compression_level);
+    case CompressionType::kZlib:
+      return CompressorOptions().set_zlib(compression_level);
+    default:
+      return CompressorOptions().set_uncompressed();
+  }
+}
+
+absl::string_view CompressionTypeName(CompressionType compression_type) {
+  switch (compression_type) {
+    case CompressionType::kBrotli:
+      return "brotli";
+    case CompressionType::kZstd:
+      return "zstd";
+    case CompressionType::kSnappy:
+      return "snappy";
+    case CompressionType::kLz4:
+      return "lz4";
+    case CompressionType::kZlib:
+      return "zlib";
+    default:
+      return "uncompressed";
+  }
+}
+
+// Benchmarks each compression type at each of its compression levels. Very
+// fast negative levels of zstd and lz4 are represented by a few samples.
+void CompressionLevels(benchmark::internal::Benchmark* benchmark) {
+  const auto add = [&](CompressionType compression_type, int min_level,
+                       int max_level) {
+    for (int level = min_level; level <= max_level; ++level) {
+      benchmark->Args({static_cast<int64_t>(compression_type), level});
+    }
+  };
+  add(CompressionType::kNone, 0, 0);
+  add(CompressionType::kBrotli, CompressorOptions::kMinBrotli,
+      CompressorOptions::kMaxBrotli);
+  for (const int level : {-100, -10, -1}) {
+    benchmark->Args({static_cast<int64_t>(CompressionType::kZstd), level});
+  }
+  add(CompressionType::kZstd, 1, CompressorOptions::kMaxZstd);
+  add(CompressionType::kSnappy, 0, 0);
+  for (const int level : {-100, -10, -1}) {
+    benchmark->Args({static_cast<int64_t>(CompressionType::kLz4), level});
+  }
+  add(CompressionType::kLz4, 0, CompressorOptions::kMaxLz4);
+  add(CompressionType::kZlib, CompressorOptions::kMinZlib,
+      CompressorOptions::kMaxZlib);
+}
+
+void SetLabel(benchmark::State& state) {
+  const CompressionType compression_type =
+      static_cast<CompressionType>(state.range(0));
+  state.SetLabel(
+      compression_type == CompressionType::kNone ||
+              compression_type == CompressionType::kSnappy
+          ? std::string(CompressionTypeName(compression_type))
+          : absl::StrCat(CompressionTypeName(compression_type), ":",
+                         state.range(1)));
+}
+
+Chain Compress(const Chain& data, const CompressorOptions& compressor_options) {
+  internal::Compressor compressor(compressor_options);
+  compressor.writer().Write(data);
+  Chain compressed;
+  ChainWriter<> writer(&compressed);
+  compressor.EncodeAndClose(writer);
+  writer.Close();
+  return compressed;
+}
+
+// Compresses the sample text with the compression type `state.range(0)` at
+// the compression level `state.range(1)`. Reports the compression ratio.
+void BM_Compress(benchmark::State& state) {
+  const CompressorOptions compressor_options =
+      MakeCompressorOptions(static_cast<CompressionType>(state.range(0)),
+                            static_cast<int>(state.range(1)));
+  const Chain data = SampleText();
+  internal::Compressor compressor(compressor_options);
+  size_t compressed_size = 0;
+  for (auto _ : state) {
+    compressor.Clear();
+    compressor.writer().Write(data);
+    NullWriter writer;
+    if (!compressor.EncodeAndClose(writer)) {
+      state.SkipWithError("Compressor failed");
+      break;
+    }
+    compressed_size = static_cast<size_t>(writer.pos());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(data.size()));
+  state.counters["ratio"] = static_cast<double>(compressed_size) /
+                            static_cast<double>(data.size());
+  SetLabel(state);
+}
+BENCHMARK(BM_Compress)->Apply(CompressionLevels);
+
+// Decompresses the sample text compressed like in `BM_Compress`.
+void BM_Decompress(benchmark::State& state) {
+  const CompressionType compression_type =
+      static_cast<CompressionType>(state.range(0));
+  const Chain data = SampleText();
+  const Chain compressed = Compress(
+      data, MakeCompressorOptions(compression_type,
+                                  static_cast<int>(state.range(1))));
+  for (auto _ : state) {
+    internal::Decompressor<ChainReader<>> decompressor(
+        std::forward_as_tuple(&compressed), compression_type);
+    NullWriter writer;
+    if (!decompressor.reader().CopyAll(writer) ||
+        !decompressor.VerifyEndAndClose()) {
+      state.SkipWithError("Decompressor failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(data.size()));
+  SetLabel(state);
+}
+BENCHMARK(BM_Decompress)->Apply(CompressionLevels);
+
+}  // namespace
+}  // namespace riegeli
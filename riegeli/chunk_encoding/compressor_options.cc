@@ -23,8 +23,11 @@
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/options_parser.h"
+#include "riegeli/brotli/brotli_allocator.h"
 #include "riegeli/brotli/brotli_writer.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/lz4/lz4_writer.h"
+#include "riegeli/zlib/zlib_writer.h"
 #include "riegeli/zstd/zstd_writer.h"
 
 namespace riegeli {
@@ -39,6 +42,12 @@ constexpr int CompressorOptions::kDefaultBrotli;
 constexpr int CompressorOptions::kMinZstd;
 constexpr int CompressorOptions::kMaxZstd;
 constexpr int CompressorOptions::kDefaultZstd;
+constexpr int CompressorOptions::kMinLz4;
+constexpr int CompressorOptions::kMaxLz4;
+constexpr int CompressorOptions::kDefaultLz4;
+constexpr int CompressorOptions::kMinZlib;
+constexpr int CompressorOptions::kMaxZlib;
+constexpr int CompressorOptions::kDefaultZlib;
 constexpr int CompressorOptions::kMinWindowLog;
 constexpr int CompressorOptions::kMaxWindowLog;
 #endif
@@ -50,44 +59,89 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
     OptionsParser options_parser;
     options_parser.AddOption(
         "uncompressed",
-        ValueParser::And(ValueParser::FailIfSeen("brotli", "zstd", "snappy"),
+        ValueParser::And(ValueParser::FailIfSeen("brotli", "zstd", "snappy",
+                                                 "lz4", "zlib"),
                          [this](ValueParser& value_parser) {
                            compression_type_ = CompressionType::kNone;
                            return true;
                          }));
     options_parser.AddOption(
-        "brotli", ValueParser::And(
-                      ValueParser::FailIfSeen("uncompressed", "zstd", "snappy"),
-                      [this](ValueParser& value_parser) {
-                        compression_type_ = CompressionType::kBrotli;
-                        return true;
-                      }));
+        "brotli",
+        ValueParser::And(ValueParser::FailIfSeen("uncompressed", "zstd",
+                                                 "snappy", "lz4", "zlib"),
+                         [this](ValueParser& value_parser) {
+                           compression_type_ = CompressionType::kBrotli;
+                           return true;
+                         }));
+    options_parser.AddOption(
+        "zstd",
+        ValueParser::And(ValueParser::FailIfSeen("uncompressed", "brotli",
+                                                 "snappy", "lz4", "zlib"),
+                         [this](ValueParser& value_parser) {
+                           compression_type_ = CompressionType::kZstd;
+                           return true;
+                         }));
+    options_parser.AddOption(
+        "snappy",
+        ValueParser::And(ValueParser::FailIfSeen("uncompressed", "brotli",
+                                                 "zstd", "lz4", "zlib"),
+                         [this](ValueParser& value_parser) {
+                           compression_type_ = CompressionType::kSnappy;
+                           return true;
+                         }));
     options_parser.AddOption(
-        "zstd", ValueParser::And(
-                    ValueParser::FailIfSeen("uncompressed", "brotli", "snappy"),
-                    [this](ValueParser& value_parser) {
-                      compression_type_ = CompressionType::kZstd;
-                      return true;
-                    }));
+        "lz4",
+        ValueParser::And(ValueParser::FailIfSeen("uncompressed", "brotli",
+                                                 "zstd", "snappy", "zlib"),
+                         [this](ValueParser& value_parser) {
+                           compression_type_ = CompressionType::kLz4;
+                           return true;
+                         }));
     options_parser.AddOption(
-        "snappy", ValueParser::And(
-                      ValueParser::FailIfSeen("uncompressed", "brotli", "zstd"),
-                      [this](ValueParser& value_parser) {
-                        compression_type_ = CompressionType::kSnappy;
-                        return true;
-                      }));
+        "zlib",
+        ValueParser::And(ValueParser::FailIfSeen("uncompressed", "brotli",
+                                                 "zstd", "snappy", "lz4"),
+                         [this](ValueParser& value_parser) {
+                           compression_type_ = CompressionType::kZlib;
+                           return true;
+                         }));
+    options_parser.AddOption("adaptive",
+                             [](ValueParser& value_parser) { return true; });
+    options_parser.AddOption("min_gain",
+                             [](ValueParser& value_parser) { return true; });
     options_parser.AddOption("window_log",
                              [](ValueParser& value_parser) { return true; });
+    options_parser.AddOption("long_distance_matching",
+                             [](ValueParser& value_parser) { return true; });
+    options_parser.AddOption("zstd_workers",
+                             [](ValueParser& value_parser) { return true; });
+    options_parser.AddOption("brotli_recycling",
+                             [](ValueParser& value_parser) { return true; });
     if (ABSL_PREDICT_FALSE(!options_parser.FromString(text))) {
       return options_parser.status();
     }
   }
+  int adaptive_min_level;
+  const auto adaptive_min_level_parser = [this, &adaptive_min_level](
+                                             int default_level, int min_level,
+                                             int max_level) {
+    return ValueParser::And(
+        ValueParser::Or(
+            ValueParser::Empty(default_level, &adaptive_min_level),
+            ValueParser::Int(min_level, max_level, &adaptive_min_level)),
+        [this, &adaptive_min_level](ValueParser& value_parser) {
+          adaptive_min_level_ = adaptive_min_level;
+          return true;
+        });
+  };
+  double min_compression_gain;
   int window_log;
   OptionsParser options_parser;
   options_parser.AddOption(
       "uncompressed",
-      ValueParser::And(ValueParser::FailIfSeen("window_log"),
-                       ValueParser::Empty(0, &compression_level_)));
+      ValueParser::And(
+          ValueParser::FailIfSeen("window_log", "adaptive", "min_gain"),
+          ValueParser::Empty(0, &compression_level_)));
   options_parser.AddOption(
       "brotli",
       ValueParser::Or(
@@ -106,8 +160,66 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
                            ZstdWriterBase::Options::kMaxCompressionLevel,
                            &compression_level_)));
   options_parser.AddOption(
-      "snappy", ValueParser::And(ValueParser::FailIfSeen("window_log"),
-                                 ValueParser::Empty(0, &compression_level_)));
+      "snappy",
+      ValueParser::And(ValueParser::FailIfSeen("window_log", "adaptive"),
+                       ValueParser::Empty(0, &compression_level_)));
+  options_parser.AddOption(
+      "lz4",
+      ValueParser::And(
+          ValueParser::FailIfSeen("window_log"),
+          ValueParser::Or(
+              ValueParser::Empty(
+                  Lz4WriterBase::Options::kDefaultCompressionLevel,
+                  &compression_level_),
+              ValueParser::Int(Lz4WriterBase::Options::kMinCompressionLevel,
+                               Lz4WriterBase::Options::kMaxCompressionLevel,
+                               &compression_level_))));
+  options_parser.AddOption(
+      "zlib",
+      ValueParser::Or(
+          ValueParser::Empty(ZlibWriterBase::Options::kDefaultCompressionLevel,
+                             &compression_level_),
+          ValueParser::Int(ZlibWriterBase::Options::kMinCompressionLevel,
+                           ZlibWriterBase::Options::kMaxCompressionLevel,
+                           &compression_level_)));
+  options_parser.AddOption("adaptive", [&] {
+    switch (compression_type_) {
+      case CompressionType::kNone:
+        return ValueParser::FailIfSeen("uncompressed");
+      case CompressionType::kBrotli:
+        return adaptive_min_level_parser(
+            0, BrotliWriterBase::Options::kMinCompressionLevel,
+            BrotliWriterBase::Options::kMaxCompressionLevel);
+      case CompressionType::kZstd:
+      case CompressionType::kZstdWithDictionary:
+        return adaptive_min_level_parser(
+            1, ZstdWriterBase::Options::kMinCompressionLevel,
+            ZstdWriterBase::Options::kMaxCompressionLevel);
+      case CompressionType::kSnappy:
+        return ValueParser::FailIfSeen("snappy");
+      case CompressionType::kLz4:
+        return adaptive_min_level_parser(
+            0, Lz4WriterBase::Options::kMinCompressionLevel,
+            Lz4WriterBase::Options::kMaxCompressionLevel);
+      case CompressionType::kZlib:
+        return adaptive_min_level_parser(
+            1, ZlibWriterBase::Options::kMinCompressionLevel,
+            ZlibWriterBase::Options::kMaxCompressionLevel);
+    }
+    RIEGELI_ASSERT_UNREACHABLE() << "Unknown compression type: "
+                                 << static_cast<unsigned>(compression_type_);
+  }());
+  options_parser.AddOption("min_gain", [&] {
+    if (compression_type_ == CompressionType::kNone) {
+      return ValueParser::FailIfSeen("uncompressed");
+    }
+    return ValueParser::And(
+        ValueParser::Real(0.0, 1.0, &min_compression_gain),
+        [this, &min_compression_gain](ValueParser& value_parser) {
+          min_compression_gain_ = min_compression_gain;
+          return true;
+        });
+  }());
   options_parser.AddOption("window_log", [&] {
     switch (compression_type_) {
       case CompressionType::kNone:
@@ -124,6 +236,7 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
                   return true;
                 }));
       case CompressionType::kZstd:
+      case CompressionType::kZstdWithDictionary:
         return ValueParser::Or(
             ValueParser::Enum({{"auto", absl::nullopt}}, &window_log_),
             ValueParser::And(
@@ -136,10 +249,43 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
                 }));
       case CompressionType::kSnappy:
         return ValueParser::FailIfSeen("snappy");
+      case CompressionType::kLz4:
+        return ValueParser::FailIfSeen("lz4");
+      case CompressionType::kZlib:
+        return ValueParser::Or(
+            ValueParser::Enum({{"auto", absl::nullopt}}, &window_log_),
+            ValueParser::And(
+                ValueParser::Int(ZlibWriterBase::Options::kMinWindowLog,
+                                 ZlibWriterBase::Options::kMaxWindowLog,
+                                 &window_log),
+                [this, &window_log](ValueParser& value_parser) {
+                  window_log_ = window_log;
+                  return true;
+                }));
     }
     RIEGELI_ASSERT_UNREACHABLE() << "Unknown compression type: "
                                  << static_cast<unsigned>(compression_type_);
   }());
+  options_parser.AddOption(
+      "long_distance_matching",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &zstd_long_distance_matching_));
+  options_parser.AddOption(
+      "zstd_workers",
+      ValueParser::Int(0, ZstdWriterBase::Options::kMaxNumWorkers,
+                       &zstd_num_workers_));
+  bool brotli_recycling;
+  options_parser.AddOption(
+      "brotli_recycling",
+      ValueParser::And(
+          ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                            &brotli_recycling),
+          [this, &brotli_recycling](ValueParser& value_parser) {
+            brotli_allocator_ = brotli_recycling
+                                    ? BrotliAllocator::Recycling()
+                                    : BrotliAllocator();
+            return true;
+          }));
   if (ABSL_PREDICT_FALSE(!options_parser.FromString(text))) {
     return options_parser.status();
   }
@@ -178,4 +324,21 @@ absl::optional<int> CompressorOptions::zstd_window_log() const {
   return window_log_;
 }
 
+int CompressorOptions::zlib_window_log() const {
+  RIEGELI_ASSERT(compression_type_ == CompressionType::kZlib)
+      << "Failed precodition of CompressorOptions::zlib_window_log(): "
+         "compression type must be Zlib";
+  if (window_log_ == absl::nullopt) {
+    return ZlibWriterBase::Options::kDefaultWindowLog;
+  } else {
+    RIEGELI_ASSERT_GE(*window_log_, ZlibWriterBase::Options::kMinWindowLog)
+        << "Failed precondition of CompressorOptions::set_window_log(): "
+           "window log out of range for Zlib";
+    RIEGELI_ASSERT_LE(*window_log_, ZlibWriterBase::Options::kMaxWindowLog)
+        << "Failed precondition of CompressorOptions::set_window_log(): "
+           "window log out of range for Zlib";
+    return *window_log_;
+  }
+}
+
 }  // namespace riegeli
@@ -21,8 +21,12 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/brotli/brotli_allocator.h"
 #include "riegeli/brotli/brotli_writer.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/lz4/lz4_writer.h"
+#include "riegeli/zlib/zlib_writer.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 #include "riegeli/zstd/zstd_writer.h"
 
 namespace riegeli {
@@ -39,12 +43,29 @@ class CompressorOptions {
   //     "brotli" (":" brotli_level)? |
   //     "zstd" (":" zstd_level)? |
   //     "snappy" |
-  //     "window_log" ":" window_log
+  //     "lz4" (":" lz4_level)? |
+  //     "zlib" (":" zlib_level)? |
+  //     "adaptive" (":" adaptive_min_level)? |
+  //     "min_gain" ":" min_gain |
+  //     "window_log" ":" window_log |
+  //     "long_distance_matching" (":" ("true" | "false"))? |
+  //     "zstd_workers" ":" zstd_workers |
+  //     "brotli_recycling" (":" ("true" | "false"))?
   //   brotli_level ::= integer in the range [0..11] (default 6)
   //   zstd_level ::= integer in the range [-131072..22] (default 3)
-  //   window_log ::= "auto" or integer in the range [10..31]
+  //   lz4_level ::= integer in the range [-65537..12] (default 0)
+  //   zlib_level ::= integer in the range [0..9] (default 6)
+  //   adaptive_min_level ::= brotli_level (default 0) or zstd_level
+  //     (default 1) or lz4_level (default 0) or zlib_level (default 1),
+  //     depending on the algorithm
+  //   min_gain ::= real in the range [0..1]
+  //   window_log ::= "auto" or integer in the range [9..31]
+  //   zstd_workers ::= integer in the range [0..256]
   // ```
   //
+  // "brotli_recycling" sets `brotli_allocator()` to
+  // `BrotliAllocator::Recycling()`.
+  //
   // Returns status:
   //  * `status.ok()`  - success
   //  * `!status.ok()` - failure
@@ -125,32 +146,237 @@ class CompressorOptions {
   }
   CompressorOptions&& set_snappy() && { return std::move(set_snappy()); }
 
+  // Changes compression algorithm to LZ4. Sets compression level which tunes
+  // the tradeoff between compression density and compression speed (higher =
+  // better density but slower).
+  //
+  // LZ4 decompresses faster than Snappy, at similar compression density.
+  //
+  // `compression_level` must be between `kMinLz4` (-65537) and `kMaxLz4` (12).
+  // Levels below 3 use the fast LZ4 compressor, with negative levels trading
+  // density for more speed. Levels from 3 use the LZ4HC compressor.
+  // Default: `kDefaultLz4` (0).
+  static constexpr int kMinLz4 = Lz4WriterBase::Options::kMinCompressionLevel;
+  static constexpr int kMaxLz4 = Lz4WriterBase::Options::kMaxCompressionLevel;
+  static constexpr int kDefaultLz4 =
+      Lz4WriterBase::Options::kDefaultCompressionLevel;
+  CompressorOptions& set_lz4(int compression_level = kDefaultLz4) & {
+    RIEGELI_ASSERT_GE(compression_level, kMinLz4)
+        << "Failed precondition of CompressorOptions::set_lz4(): "
+           "compression level out of range";
+    RIEGELI_ASSERT_LE(compression_level, kMaxLz4)
+        << "Failed precondition of CompressorOptions::set_lz4(): "
+           "compression level out of range";
+    compression_type_ = CompressionType::kLz4;
+    compression_level_ = compression_level;
+    return *this;
+  }
+  CompressorOptions&& set_lz4(int compression_level = kDefaultLz4) && {
+    return std::move(set_lz4(compression_level));
+  }
+
+  // Changes compression algorithm to Zlib (Deflate with the zlib header). Sets
+  // compression level which tunes the tradeoff between compression density
+  // and compression speed (higher = better density but slower).
+  //
+  // Zlib is less dense and slower than Brotli and Zstd, but its decoders are
+  // widely available, including hardware accelerated ones.
+  //
+  // `compression_level` must be between `kMinZlib` (0) and `kMaxZlib` (9).
+  // Default: `kDefaultZlib` (6).
+  static constexpr int kMinZlib = ZlibWriterBase::Options::kMinCompressionLevel;
+  static constexpr int kMaxZlib = ZlibWriterBase::Options::kMaxCompressionLevel;
+  static constexpr int kDefaultZlib =
+      ZlibWriterBase::Options::kDefaultCompressionLevel;
+  CompressorOptions& set_zlib(int compression_level = kDefaultZlib) & {
+    RIEGELI_ASSERT_GE(compression_level, kMinZlib)
+        << "Failed precondition of CompressorOptions::set_zlib(): "
+           "compression level out of range";
+    RIEGELI_ASSERT_LE(compression_level, kMaxZlib)
+        << "Failed precondition of CompressorOptions::set_zlib(): "
+           "compression level out of range";
+    compression_type_ = CompressionType::kZlib;
+    compression_level_ = compression_level;
+    return *this;
+  }
+  CompressorOptions&& set_zlib(int compression_level = kDefaultZlib) && {
+    return std::move(set_zlib(compression_level));
+  }
+
   CompressionType compression_type() const { return compression_type_; }
 
   int compression_level() const { return compression_level_; }
 
+  // Changes the compression level without changing the compression algorithm.
+  //
+  // `compression_level` must be in the range valid for `compression_type()`,
+  // as documented for `set_brotli()`, `set_zstd()`, `set_lz4()`, and
+  // `set_zlib()`.
+  // Uncompressed and Snappy accept only 0.
+  CompressorOptions& set_compression_level(int compression_level) & {
+    compression_level_ = compression_level;
+    return *this;
+  }
+  CompressorOptions&& set_compression_level(int compression_level) && {
+    return std::move(set_compression_level(compression_level));
+  }
+
+  // Makes the compression level adaptive. If not `absl::nullopt`, a writer
+  // which can observe its backlog of chunks waiting to be encoded compresses
+  // each chunk with a level between `*adaptive_min_level()` and
+  // `compression_level()`: it lowers the level one step at a time while the
+  // backlog is nearly full, and raises it back while the backlog is nearly
+  // empty. This keeps write throughput during bursts and density when the
+  // writer is idle. Decompression does not depend on the level.
+  //
+  // Currently `RecordWriter` with `parallelism() > 0` adapts the level; other
+  // writers use `compression_level()`.
+  //
+  // `adaptive_min_level` applies only to Brotli, Zstd, LZ4, and Zlib, and must
+  // be in the range valid for the compression algorithm. If it is greater than
+  // `compression_level()`, the level is not adapted.
+  //
+  // Default: `absl::nullopt`.
+  CompressorOptions& set_adaptive_min_level(
+      absl::optional<int> adaptive_min_level) & {
+    adaptive_min_level_ = adaptive_min_level;
+    return *this;
+  }
+  CompressorOptions&& set_adaptive_min_level(
+      absl::optional<int> adaptive_min_level) && {
+    return std::move(set_adaptive_min_level(adaptive_min_level));
+  }
+  absl::optional<int> adaptive_min_level() const { return adaptive_min_level_; }
+
+  // Stores incompressible chunks uncompressed. If not `absl::nullopt`, before
+  // compressing a chunk, the fraction of its size which compression would save
+  // is estimated from a sample of its data, using byte entropy and a trial
+  // Snappy compression. If the estimate is less than `*min_compression_gain()`,
+  // the chunk is stored uncompressed. This avoids spending CPU time on data
+  // which are already compressed, e.g. images, both when writing and when
+  // reading them.
+  //
+  // `min_compression_gain` applies to all compression algorithms except
+  // Uncompressed, and must be between 0 and 1.
+  //
+  // Default: `absl::nullopt`.
+  CompressorOptions& set_min_compression_gain(
+      absl::optional<double> min_compression_gain) & {
+    if (min_compression_gain != absl::nullopt) {
+      RIEGELI_ASSERT_GE(*min_compression_gain, 0.0)
+          << "Failed precondition of "
+             "CompressorOptions::set_min_compression_gain(): "
+             "gain out of range";
+      RIEGELI_ASSERT_LE(*min_compression_gain, 1.0)
+          << "Failed precondition of "
+             "CompressorOptions::set_min_compression_gain(): "
+             "gain out of range";
+    }
+    min_compression_gain_ = min_compression_gain;
+    return *this;
+  }
+  CompressorOptions&& set_min_compression_gain(
+      absl::optional<double> min_compression_gain) && {
+    return std::move(set_min_compression_gain(min_compression_gain));
+  }
+  absl::optional<double> min_compression_gain() const {
+    return min_compression_gain_;
+  }
+
+  // Zstd dictionary. This makes small chunks denser, at the cost of making the
+  // dictionary necessary for decompressing them.
+  //
+  // If Zstd is used with a non-empty dictionary, compressed data are marked
+  // with `CompressionType::kZstdWithDictionary` instead of
+  // `CompressionType::kZstd`, and the same dictionary must be provided for
+  // decompression.
+  //
+  // For compression algorithms other than Zstd, the dictionary is ignored.
+  //
+  // Default: `ZstdDictionary()`.
+  CompressorOptions& set_zstd_dictionary(const ZstdDictionary& dictionary) & {
+    zstd_dictionary_ = dictionary;
+    return *this;
+  }
+  CompressorOptions& set_zstd_dictionary(ZstdDictionary&& dictionary) & {
+    zstd_dictionary_ = std::move(dictionary);
+    return *this;
+  }
+  CompressorOptions&& set_zstd_dictionary(
+      const ZstdDictionary& dictionary) && {
+    return std::move(set_zstd_dictionary(dictionary));
+  }
+  CompressorOptions&& set_zstd_dictionary(ZstdDictionary&& dictionary) && {
+    return std::move(set_zstd_dictionary(std::move(dictionary)));
+  }
+  ZstdDictionary& zstd_dictionary() { return zstd_dictionary_; }
+  const ZstdDictionary& zstd_dictionary() const { return zstd_dictionary_; }
+
+  // Memory allocator used by the Brotli engine. The allocator is shared by all
+  // chunks compressed with these options, so
+  // `BrotliAllocator::Recycling()` lets them reuse large tables of the
+  // encoder.
+  //
+  // For compression algorithms other than Brotli, this is ignored.
+  //
+  // Default: `BrotliAllocator()`.
+  CompressorOptions& set_brotli_allocator(const BrotliAllocator& allocator) & {
+    brotli_allocator_ = allocator;
+    return *this;
+  }
+  CompressorOptions& set_brotli_allocator(BrotliAllocator&& allocator) & {
+    brotli_allocator_ = std::move(allocator);
+    return *this;
+  }
+  CompressorOptions&& set_brotli_allocator(
+      const BrotliAllocator& allocator) && {
+    return std::move(set_brotli_allocator(allocator));
+  }
+  CompressorOptions&& set_brotli_allocator(BrotliAllocator&& allocator) && {
+    return std::move(set_brotli_allocator(std::move(allocator)));
+  }
+  BrotliAllocator& brotli_allocator() { return brotli_allocator_; }
+  const BrotliAllocator& brotli_allocator() const { return brotli_allocator_; }
+
+  // Returns the compression type to be stored with compressed data. This is
+  // `compression_type()`, except that Zstd with a non-empty dictionary is
+  // `CompressionType::kZstdWithDictionary`.
+  CompressionType stored_compression_type() const {
+    return compression_type_ == CompressionType::kZstd &&
+                   !zstd_dictionary_.empty()
+               ? CompressionType::kZstdWithDictionary
+               : compression_type_;
+  }
+
   // Logarithm of the LZ77 sliding window size. This tunes the tradeoff
   // between compression density and memory usage (higher = better density but
   // more memory).
   //
   // Special value `absl::nullopt` means to keep the default (Brotli: 22,
-  // Zstd: derived from compression level and chunk size).
+  // Zstd: derived from compression level and chunk size, Zlib: 15).
   //
-  // For Uncompressed and Snappy, `window_log` must be `absl::nullopt`.
+  // For Uncompressed, Snappy, and LZ4, `window_log` must be `absl::nullopt`.
   //
   // For Brotli, `window_log` must be `absl::nullopt` or between
   // `BrotliWriterBase::Options::kMinWindowLog` (10) and
   // `BrotliWriterBase::Options::kMaxWindowLog` (30).
+  // Above `BrotliWriterBase::Options::kMaxStandardWindowLog` (24) the
+  // large-window mode of Brotli is used, unless the chunk is small enough.
   //
   // For Zstd, `window_log` must be `absl::nullopt` or between
   // `ZstdWriterBase::Options::kMinWindowLog` (10) and
   // `ZstdWriterBase::Options::kMaxWindowLog` (30 in 32-bit build,
   // 31 in 64-bit build).
   //
+  // For Zlib, `window_log` must be `absl::nullopt` or between
+  // `ZlibWriterBase::Options::kMinWindowLog` (9) and
+  // `ZlibWriterBase::Options::kMaxWindowLog` (15).
+  //
   // Default: `absl::nullopt`.
   static constexpr int kMinWindowLog =
       SignedMin(BrotliWriterBase::Options::kMinWindowLog,
-                ZstdWriterBase::Options::kMinWindowLog);
+                ZstdWriterBase::Options::kMinWindowLog,
+                ZlibWriterBase::Options::kMinWindowLog);
   static constexpr int kMaxWindowLog =
       SignedMax(BrotliWriterBase::Options::kMaxWindowLog,
                 ZstdWriterBase::Options::kMaxWindowLog);
@@ -171,6 +397,52 @@ class CompressorOptions {
   }
   absl::optional<int> window_log() const { return window_log_; }
 
+  // If `true`, Zstd finds matches further than the usual window, which
+  // improves density of large chunks with long repetitions, at the cost of
+  // memory usage and compression speed.
+  //
+  // For compression algorithms other than Zstd, this is ignored.
+  //
+  // Default: `false`.
+  CompressorOptions& set_zstd_long_distance_matching(
+      bool zstd_long_distance_matching) & {
+    zstd_long_distance_matching_ = zstd_long_distance_matching;
+    return *this;
+  }
+  CompressorOptions&& set_zstd_long_distance_matching(
+      bool zstd_long_distance_matching) && {
+    return std::move(
+        set_zstd_long_distance_matching(zstd_long_distance_matching));
+  }
+  bool zstd_long_distance_matching() const {
+    return zstd_long_distance_matching_;
+  }
+
+  // Number of background threads which Zstd uses to compress parts of a chunk
+  // in parallel. Unlike writing several chunks in parallel, this speeds up
+  // compression of a single large chunk. 0 compresses in the calling thread.
+  //
+  // For compression algorithms other than Zstd, this is ignored.
+  //
+  // `zstd_num_workers` must be between 0 and
+  // `ZstdWriterBase::Options::kMaxNumWorkers` (64 in 32-bit build, 256 in
+  // 64-bit build). Default: 0.
+  CompressorOptions& set_zstd_num_workers(int zstd_num_workers) & {
+    RIEGELI_ASSERT_GE(zstd_num_workers, 0)
+        << "Failed precondition of CompressorOptions::set_zstd_num_workers(): "
+           "number of workers out of range";
+    RIEGELI_ASSERT_LE(zstd_num_workers,
+                      ZstdWriterBase::Options::kMaxNumWorkers)
+        << "Failed precondition of CompressorOptions::set_zstd_num_workers(): "
+           "number of workers out of range";
+    zstd_num_workers_ = zstd_num_workers;
+    return *this;
+  }
+  CompressorOptions&& set_zstd_num_workers(int zstd_num_workers) && {
+    return std::move(set_zstd_num_workers(zstd_num_workers));
+  }
+  int zstd_num_workers() const { return zstd_num_workers_; }
+
   // Returns `window_log()` translated for `BrotliWriter`.
   //
   // Precondition: `compression_type() == CompressionType::kBrotli`
@@ -181,10 +453,21 @@ class CompressorOptions {
   // Precondition: `compression_type() == CompressionType::kZstd`
   absl::optional<int> zstd_window_log() const;
 
+  // Returns `window_log()` translated for `ZlibWriter`.
+  //
+  // Precondition: `compression_type() == CompressionType::kZlib`
+  int zlib_window_log() const;
+
  private:
   CompressionType compression_type_ = CompressionType::kBrotli;
   int compression_level_ = kDefaultBrotli;
+  absl::optional<int> adaptive_min_level_;
+  absl::optional<double> min_compression_gain_;
   absl::optional<int> window_log_;
+  bool zstd_long_distance_matching_ = false;
+  int zstd_num_workers_ = 0;
+  ZstdDictionary zstd_dictionary_;
+  BrotliAllocator brotli_allocator_;
 };
 
 }  // namespace riegeli
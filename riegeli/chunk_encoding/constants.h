@@ -30,6 +30,12 @@ enum class ChunkType : uint8_t {
   kPadding = 'p',
   kSimple = 'r',
   kTransposed = 't',
+  kChunkIndex = 'i',
+  kZstdDictionary = 'd',
+  kColumnStatistics = 'c',
+  kTuples = 'u',
+  kKeyIndex = 'k',
+  kTimeIndex = 'w',
 };
 
 // These values are frozen in the file format.
@@ -38,6 +44,10 @@ enum class CompressionType : uint8_t {
   kBrotli = 'b',
   kZstd = 'z',
   kSnappy = 's',
+  kLz4 = '4',
+  kZlib = 'l',
+  // Zstd using the dictionary from the `kZstdDictionary` chunk of the file.
+  kZstdWithDictionary = 'Z',
 };
 
 RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint64_t, kMaxNumRecords,
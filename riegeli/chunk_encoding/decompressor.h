@@ -33,9 +33,13 @@
 #include "riegeli/brotli/brotli_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/wrapped_reader.h"
+#include "riegeli/chunk_encoding/compression_backend.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/lz4/lz4_reader.h"
 #include "riegeli/snappy/snappy_reader.h"
 #include "riegeli/varint/varint_reading.h"
+#include "riegeli/zlib/zlib_reader.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 #include "riegeli/zstd/zstd_reader.h"
 
 namespace riegeli {
@@ -62,15 +66,20 @@ class Decompressor : public Object {
   explicit Decompressor(Closed) noexcept : Object(kClosed) {}
 
   // Will read from the compressed stream provided by `src`.
-  explicit Decompressor(const Src& src, CompressionType compression_type);
-  explicit Decompressor(Src&& src, CompressionType compression_type);
+  //
+  // `zstd_dictionary` is used if `compression_type` is `kZstdWithDictionary`.
+  explicit Decompressor(const Src& src, CompressionType compression_type,
+                        ZstdDictionary zstd_dictionary = ZstdDictionary());
+  explicit Decompressor(Src&& src, CompressionType compression_type,
+                        ZstdDictionary zstd_dictionary = ZstdDictionary());
 
   // Will read from the compressed stream provided by a `Src` constructed from
   // elements of `src_args`. This avoids constructing a temporary `Src` and
   // moving from it.
   template <typename... SrcArgs>
   explicit Decompressor(std::tuple<SrcArgs...> src_args,
-                        CompressionType compression_type);
+                        CompressionType compression_type,
+                        ZstdDictionary zstd_dictionary = ZstdDictionary());
 
   Decompressor(Decompressor&& that) noexcept;
   Decompressor& operator=(Decompressor&& that) noexcept;
@@ -78,10 +87,13 @@ class Decompressor : public Object {
   // Makes `*this` equivalent to a newly constructed `Decompressor`. This avoids
   // constructing a temporary `Decompressor` and moving from it.
   void Reset(Closed);
-  void Reset(const Src& src, CompressionType compression_type);
-  void Reset(Src&& src, CompressionType compression_type);
+  void Reset(const Src& src, CompressionType compression_type,
+             ZstdDictionary zstd_dictionary = ZstdDictionary());
+  void Reset(Src&& src, CompressionType compression_type,
+             ZstdDictionary zstd_dictionary = ZstdDictionary());
   template <typename... SrcArgs>
-  void Reset(std::tuple<SrcArgs...> src_args, CompressionType compression_type);
+  void Reset(std::tuple<SrcArgs...> src_args, CompressionType compression_type,
+             ZstdDictionary zstd_dictionary = ZstdDictionary());
 
   // Returns the `Reader` from which uncompressed data should be read.
   //
@@ -109,8 +121,11 @@ class Decompressor : public Object {
 
  private:
   template <typename SrcInit>
-  void Initialize(SrcInit&& src_init, CompressionType compression_type);
+  void Initialize(SrcInit&& src_init, CompressionType compression_type,
+                  ZstdDictionary&& zstd_dictionary);
 
+  // The backend serving `reader_`, or `nullptr` for software decompression.
+  std::shared_ptr<CompressionBackend> backend_;
   std::unique_ptr<Reader> reader_;
 };
 
@@ -118,21 +133,25 @@ class Decompressor : public Object {
 
 template <typename Src>
 inline Decompressor<Src>::Decompressor(const Src& src,
-                                       CompressionType compression_type) {
-  Initialize(src, compression_type);
+                                       CompressionType compression_type,
+                                       ZstdDictionary zstd_dictionary) {
+  Initialize(src, compression_type, std::move(zstd_dictionary));
 }
 
 template <typename Src>
 inline Decompressor<Src>::Decompressor(Src&& src,
-                                       CompressionType compression_type) {
-  Initialize(std::move(src), compression_type);
+                                       CompressionType compression_type,
+                                       ZstdDictionary zstd_dictionary) {
+  Initialize(std::move(src), compression_type, std::move(zstd_dictionary));
 }
 
 template <typename Src>
 template <typename... SrcArgs>
 inline Decompressor<Src>::Decompressor(std::tuple<SrcArgs...> src_args,
-                                       CompressionType compression_type) {
-  Initialize(std::move(src_args), compression_type);
+                                       CompressionType compression_type,
+                                       ZstdDictionary zstd_dictionary) {
+  Initialize(std::move(src_args), compression_type,
+             std::move(zstd_dictionary));
 }
 
 template <typename Src>
@@ -140,6 +159,7 @@ inline Decompressor<Src>::Decompressor(Decompressor&& that) noexcept
     : Object(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
+      backend_(std::move(that.backend_)),
       reader_(std::move(that.reader_)) {}
 
 template <typename Src>
@@ -149,6 +169,7 @@ inline Decompressor<Src>& Decompressor<Src>::operator=(
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   reader_ = std::move(that.reader_);
+  backend_ = std::move(that.backend_);
   return *this;
 }
 
@@ -156,34 +177,42 @@ template <typename Src>
 inline void Decompressor<Src>::Reset(Closed) {
   Object::Reset(kClosed);
   reader_.reset();
+  backend_.reset();
 }
 
 template <typename Src>
 inline void Decompressor<Src>::Reset(const Src& src,
-                                     CompressionType compression_type) {
+                                     CompressionType compression_type,
+                                     ZstdDictionary zstd_dictionary) {
   Object::Reset();
-  Initialize(src, compression_type);
+  Initialize(src, compression_type, std::move(zstd_dictionary));
 }
 
 template <typename Src>
 inline void Decompressor<Src>::Reset(Src&& src,
-                                     CompressionType compression_type) {
+                                     CompressionType compression_type,
+                                     ZstdDictionary zstd_dictionary) {
   Object::Reset();
-  Initialize(std::move(src), compression_type);
+  Initialize(std::move(src), compression_type, std::move(zstd_dictionary));
 }
 
 template <typename Src>
 template <typename... SrcArgs>
 inline void Decompressor<Src>::Reset(std::tuple<SrcArgs...> src_args,
-                                     CompressionType compression_type) {
+                                     CompressionType compression_type,
+                                     ZstdDictionary zstd_dictionary) {
   Object::Reset();
-  Initialize(std::move(src_args), compression_type);
+  Initialize(std::move(src_args), compression_type,
+             std::move(zstd_dictionary));
 }
 
 template <typename Src>
 template <typename SrcInit>
 void Decompressor<Src>::Initialize(SrcInit&& src_init,
-                                   CompressionType compression_type) {
+                                   CompressionType compression_type,
+                                   ZstdDictionary&& zstd_dictionary) {
+  reader_.reset();
+  backend_.reset();
   if (compression_type == CompressionType::kNone) {
     reader_ =
         std::make_unique<WrappedReader<Src>>(std::forward<SrcInit>(src_init));
@@ -197,6 +226,23 @@ void Decompressor<Src>::Initialize(SrcInit&& src_init,
         absl::InvalidArgumentError("Reading uncompressed size failed")));
     return;
   }
+  backend_ = GetCompressionBackend(compression_type);
+  if (backend_ != nullptr) {
+    if (backend_->SupportsDecompression(compression_type, zstd_dictionary)) {
+      reader_ = backend_->NewDecompressor(
+          std::make_unique<WrappedReader<Src>>(
+              std::move(compressed_reader.manager())),
+          compression_type, zstd_dictionary, uncompressed_size);
+      if (ABSL_PREDICT_FALSE(reader_ == nullptr)) {
+        Fail(absl::InternalError(absl::StrCat(
+            "Compression backend failed to create a decompressor for "
+            "compression type: ",
+            static_cast<unsigned>(compression_type))));
+      }
+      return;
+    }
+    backend_.reset();
+  }
   switch (compression_type) {
     case CompressionType::kNone:
       RIEGELI_ASSERT_UNREACHABLE() << "kNone handled above";
@@ -209,10 +255,34 @@ void Decompressor<Src>::Initialize(SrcInit&& src_init,
           std::move(compressed_reader.manager()),
           ZstdReaderBase::Options().set_size_hint(uncompressed_size));
       return;
+    case CompressionType::kZstdWithDictionary:
+      if (ABSL_PREDICT_FALSE(zstd_dictionary.empty())) {
+        Fail(absl::FailedPreconditionError(
+            "Zstd dictionary is required for decompression but not available"));
+        return;
+      }
+      reader_ = std::make_unique<ZstdReader<Src>>(
+          std::move(compressed_reader.manager()),
+          ZstdReaderBase::Options()
+              .set_dictionary(std::move(zstd_dictionary))
+              .set_size_hint(uncompressed_size));
+      return;
     case CompressionType::kSnappy:
       reader_ = std::make_unique<SnappyReader<Src>>(
           std::move(compressed_reader.manager()));
       return;
+    case CompressionType::kLz4:
+      reader_ = std::make_unique<Lz4Reader<Src>>(
+          std::move(compressed_reader.manager()),
+          Lz4ReaderBase::Options().set_size_hint(uncompressed_size));
+      return;
+    case CompressionType::kZlib:
+      reader_ = std::make_unique<ZlibReader<Src>>(
+          std::move(compressed_reader.manager()),
+          ZlibReaderBase::Options()
+              .set_header(ZlibReaderBase::Header::kZlib)
+              .set_size_hint(uncompressed_size));
+      return;
   }
   Fail(absl::UnimplementedError(absl::StrCat(
       "Unknown compression type: ", static_cast<unsigned>(compression_type))));
@@ -227,6 +297,7 @@ inline Reader& Decompressor<Src>::reader() {
 
 template <typename Src>
 void Decompressor<Src>::Done() {
+  if (reader_ == nullptr) return;
   if (ABSL_PREDICT_FALSE(!reader_->Close())) Fail(reader_->status());
 }
 
@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <tuple>
@@ -42,6 +43,7 @@ void DeferredEncoder::Clear() {
   ChunkEncoder::Clear();
   base_encoder_->Clear();
   records_writer_.Reset();
+  records_writer_.SetWriteSizeHint(size_hint_);
   limits_.clear();
 }
 
@@ -143,6 +145,9 @@ bool DeferredEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
   if (ABSL_PREDICT_FALSE(!records_writer_.Close())) {
     return Fail(records_writer_.status());
   }
+  if (reorder_key_ != nullptr) {
+    ReorderRecords(records_writer_.dest(), limits_);
+  }
   if (ABSL_PREDICT_FALSE(!base_encoder_->AddRecords(
           std::move(records_writer_.dest()), std::move(limits_))) ||
       ABSL_PREDICT_FALSE(!base_encoder_->EncodeAndClose(
@@ -152,4 +157,38 @@ bool DeferredEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
   return Close();
 }
 
+void DeferredEncoder::ReorderRecords(Chain& records,
+                                     std::vector<size_t>& limits) const {
+  // Keys may point into `flat`, which stays valid until `records` is replaced.
+  const absl::string_view flat = records.Flatten();
+  std::vector<absl::string_view> keys;
+  keys.reserve(limits.size());
+  size_t start = 0;
+  for (const size_t limit : limits) {
+    keys.push_back(reorder_key_(flat.substr(start, limit - start)));
+    start = limit;
+  }
+  std::vector<size_t> order(limits.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keys[a] < keys[b];
+  });
+  Chain reordered;
+  std::vector<size_t> reordered_limits;
+  reordered_limits.reserve(limits.size());
+  {
+    ChainWriter<> reordered_writer(
+        &reordered, ChainWriterBase::Options().set_size_hint(flat.size()));
+    for (const size_t index : order) {
+      const size_t record_start = index == 0 ? 0 : limits[index - 1];
+      reordered_writer.Write(
+          flat.substr(record_start, limits[index] - record_start));
+      reordered_limits.push_back(IntCast<size_t>(reordered_writer.pos()));
+    }
+    reordered_writer.Close();
+  }
+  records = std::move(reordered);
+  limits = std::move(reordered_limits);
+}
+
 }  // namespace riegeli
@@ -18,6 +18,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
 #include <memory>
 #include <tuple>
 #include <utility>
@@ -25,11 +26,14 @@
 
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "google/protobuf/message_lite.h"
+#include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/messages/message_serialize.h"
 
@@ -40,7 +44,20 @@ namespace riegeli {
 // It does more memory copying than the base encoder though.
 class DeferredEncoder : public ChunkEncoder {
  public:
-  explicit DeferredEncoder(std::unique_ptr<ChunkEncoder> base_encoder);
+  // Creates a `DeferredEncoder` which delegates encoding to `base_encoder`.
+  //
+  // `size_hint` is the expected total size of records of a chunk, used to size
+  // the buffer collecting them, or `absl::nullopt` if unknown.
+  //
+  // If `reorder_key` is not `nullptr`, records are stably sorted by keys it
+  // computes before they are passed to `base_encoder`, so that similar records
+  // are adjacent. The key may point into the record. The original order is not
+  // stored.
+  explicit DeferredEncoder(
+      std::unique_ptr<ChunkEncoder> base_encoder,
+      absl::optional<Position> size_hint = absl::nullopt,
+      std::function<absl::string_view(absl::string_view record)> reorder_key =
+          nullptr);
 
   void Clear() override;
 
@@ -59,12 +76,21 @@ class DeferredEncoder : public ChunkEncoder {
                       uint64_t& num_records,
                       uint64_t& decoded_data_size) override;
 
+  const ChunkStatistics* statistics() const override {
+    return base_encoder_->statistics();
+  }
+
  private:
   // This template is defined and used only in deferred_encoder.cc.
   template <typename Record>
   bool AddRecordImpl(Record&& record);
 
+  // Sorts records by `reorder_key_`.
+  void ReorderRecords(Chain& records, std::vector<size_t>& limits) const;
+
   std::unique_ptr<ChunkEncoder> base_encoder_;
+  absl::optional<Position> size_hint_;
+  std::function<absl::string_view(absl::string_view record)> reorder_key_;
   // `Writer` of concatenated record values.
   ChainWriter<Chain> records_writer_;
   // Sorted record end positions.
@@ -79,8 +105,14 @@ class DeferredEncoder : public ChunkEncoder {
 // Implementation details follow.
 
 inline DeferredEncoder::DeferredEncoder(
-    std::unique_ptr<ChunkEncoder> base_encoder)
-    : base_encoder_(std::move(base_encoder)) {}
+    std::unique_ptr<ChunkEncoder> base_encoder,
+    absl::optional<Position> size_hint,
+    std::function<absl::string_view(absl::string_view record)> reorder_key)
+    : base_encoder_(std::move(base_encoder)),
+      size_hint_(size_hint),
+      reorder_key_(std::move(reorder_key)) {
+  records_writer_.SetWriteSizeHint(size_hint_);
+}
 
 }  // namespace riegeli
 
@@ -0,0 +1,84 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/field_predicate.h"
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+
+namespace riegeli {
+
+void FieldPredicate::AssertValid(const Field& field) {
+  RIEGELI_ASSERT(!field.path().empty())
+      << "Failed precondition of FieldPredicate: empty field path";
+  for (const int field_number : field.path()) {
+    RIEGELI_ASSERT_NE(field_number, Field::kExistenceOnly)
+        << "Failed precondition of FieldPredicate: "
+           "field path contains Field::kExistenceOnly";
+  }
+}
+
+inline bool FieldPredicate::MatchesValue(
+    const internal::ColumnValue& value) const {
+  if (IsInt64ColumnType(type_)) return int64_test_(value.int64_value);
+  if (IsDoubleColumnType(type_)) return double_test_(value.double_value);
+  return bytes_test_(value.bytes_value);
+}
+
+bool FieldPredicate::Matches(absl::string_view record) const {
+  return internal::ForEachColumnValue(
+      field_.path(), type_, record,
+      [this](const internal::ColumnValue& value) {
+        return MatchesValue(value);
+      });
+}
+
+bool FieldPredicate::MayMatch(const ChunkStatistics& statistics) const {
+  const ColumnStatistics* const column = statistics.Find(field_, type_);
+  if (column == nullptr) return true;
+  if (column->num_values == 0) return false;
+  if (!has_range_) return true;
+  internal::ColumnValue point;
+  if (IsInt64ColumnType(type_)) {
+    if (column->min_int64 > int64_max_ || column->max_int64 < int64_min_) {
+      return false;
+    }
+    if (int64_min_ != int64_max_) return true;
+    point.int64_value = int64_min_;
+  } else if (IsDoubleColumnType(type_)) {
+    if (!(column->min_double <= double_max_ &&
+          column->max_double >= double_min_)) {
+      return false;
+    }
+    if (double_min_ != double_max_) return true;
+    point.double_value = double_min_;
+  } else {
+    if (column->min_bytes > bytes_max_ || column->max_bytes < bytes_min_) {
+      return false;
+    }
+    if (bytes_min_ != bytes_max_) return true;
+    point.bytes_value = bytes_min_;
+  }
+  // A range with equal bounds is a point lookup, which can be answered by the
+  // Bloom filter.
+  return column->bloom_filter == absl::nullopt ||
+         column->bloom_filter->MayContainHash(
+             internal::ColumnValueHash(type_, point));
+}
+
+}  // namespace riegeli
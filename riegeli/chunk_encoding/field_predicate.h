@@ -0,0 +1,282 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_FIELD_PREDICATE_H_
+#define RIEGELI_CHUNK_ENCODING_FIELD_PREDICATE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+#include "riegeli/chunk_encoding/column_type.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+
+namespace riegeli {
+
+// A condition on values of a scalar field, used to select records.
+//
+// A record matches if some value of the field satisfies the test. If the field
+// or one of its enclosing submessages is repeated, or the field is packed, each
+// value is tested. A record which does not contain the field, or which cannot
+// be parsed as a proto message, does not match.
+//
+// All fields of the path except the last one must be submessages (not groups).
+class FieldPredicate {
+ public:
+  // Tests values of a field decoded as `int64_t`.
+  //
+  // Precondition: `IsInt64ColumnType(type)`
+  static FieldPredicate Int64(Field field, ColumnType type,
+                              std::function<bool(int64_t)> test);
+
+  // Tests values of a field decoded as `double`.
+  //
+  // Precondition: `IsDoubleColumnType(type)`
+  static FieldPredicate Double(Field field, ColumnType type,
+                               std::function<bool(double)> test);
+
+  // Tests values of a `string` or `bytes` field.
+  static FieldPredicate Bytes(Field field,
+                              std::function<bool(absl::string_view)> test);
+
+  // Tests whether values of a field decoded as `int64_t` are in the range
+  // [`min`..`max`].
+  //
+  // Unlike a test given as a function, a range can be compared with
+  // `ChunkStatistics`, which allows to skip chunks without decoding them.
+  //
+  // Precondition: `IsInt64ColumnType(type)`
+  static FieldPredicate Int64Range(Field field, ColumnType type, int64_t min,
+                                   int64_t max);
+
+  // Tests whether values of a field decoded as `double` are in the range
+  // [`min`..`max`].
+  //
+  // Precondition: `IsDoubleColumnType(type)`
+  static FieldPredicate DoubleRange(Field field, ColumnType type, double min,
+                                    double max);
+
+  // Tests whether values of a `string` or `bytes` field are in the range
+  // [`min`..`max`], compared lexicographically.
+  static FieldPredicate BytesRange(Field field, absl::string_view min,
+                                   absl::string_view max);
+
+  // Tests whether values of a field decoded as `int64_t` are equal to `value`.
+  //
+  // This is a range with equal bounds. It can be also compared with a Bloom
+  // filter in `ChunkStatistics`, which is effective for point lookups of keys
+  // which are not sorted.
+  //
+  // Precondition: `IsInt64ColumnType(type)`
+  static FieldPredicate Int64Equals(Field field, ColumnType type,
+                                    int64_t value);
+
+  // Tests whether values of a `string` or `bytes` field are equal to `value`.
+  //
+  // This is a range with equal bounds, which can be also compared with a Bloom
+  // filter in `ChunkStatistics`.
+  static FieldPredicate BytesEquals(Field field, absl::string_view value);
+
+  FieldPredicate(const FieldPredicate& that);
+  FieldPredicate& operator=(const FieldPredicate& that);
+
+  FieldPredicate(FieldPredicate&& that) noexcept;
+  FieldPredicate& operator=(FieldPredicate&& that) noexcept;
+
+  // Returns the field whose values are tested.
+  const Field& field() const { return field_; }
+
+  // Returns `true` if `record` matches.
+  bool Matches(absl::string_view record) const;
+
+  // Returns `false` if `statistics` show that no record of the chunk matches.
+  //
+  // This is effective if `statistics` include the column tested by the
+  // predicate: a record without values does not match, a range is compared
+  // with the minimum and maximum value, and a range with equal bounds is
+  // looked up in the Bloom filter if there is one.
+  bool MayMatch(const ChunkStatistics& statistics) const;
+
+ private:
+  explicit FieldPredicate(Field field, ColumnType type);
+
+  static void AssertValid(const Field& field);
+
+  bool MatchesValue(const internal::ColumnValue& value) const;
+
+  Field field_;
+  ColumnType type_;
+  // Exactly one of the tests is set, depending on how `type_` is decoded.
+  std::function<bool(int64_t)> int64_test_;
+  std::function<bool(double)> double_test_;
+  std::function<bool(absl::string_view)> bytes_test_;
+  // If `true`, the test is a range, and the members below corresponding to how
+  // `type_` is decoded are its bounds.
+  bool has_range_ = false;
+  int64_t int64_min_ = 0;
+  int64_t int64_max_ = 0;
+  double double_min_ = 0.0;
+  double double_max_ = 0.0;
+  std::string bytes_min_;
+  std::string bytes_max_;
+};
+
+// Implementation details follow.
+
+inline FieldPredicate::FieldPredicate(Field field, ColumnType type)
+    : field_(std::move(field)), type_(type) {
+  AssertValid(field_);
+}
+
+inline FieldPredicate FieldPredicate::Int64(Field field, ColumnType type,
+                                            std::function<bool(int64_t)> test) {
+  RIEGELI_ASSERT(IsInt64ColumnType(type))
+      << "Failed precondition of FieldPredicate::Int64(): "
+         "column type not decoded as int64_t";
+  FieldPredicate predicate(std::move(field), type);
+  predicate.int64_test_ = std::move(test);
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::Double(Field field, ColumnType type,
+                                             std::function<bool(double)> test) {
+  RIEGELI_ASSERT(IsDoubleColumnType(type))
+      << "Failed precondition of FieldPredicate::Double(): "
+         "column type not decoded as double";
+  FieldPredicate predicate(std::move(field), type);
+  predicate.double_test_ = std::move(test);
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::Bytes(
+    Field field, std::function<bool(absl::string_view)> test) {
+  FieldPredicate predicate(std::move(field), ColumnType::kBytes);
+  predicate.bytes_test_ = std::move(test);
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::Int64Range(Field field, ColumnType type,
+                                                 int64_t min, int64_t max) {
+  FieldPredicate predicate = Int64(
+      std::move(field), type,
+      [min, max](int64_t value) { return value >= min && value <= max; });
+  predicate.has_range_ = true;
+  predicate.int64_min_ = min;
+  predicate.int64_max_ = max;
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::DoubleRange(Field field, ColumnType type,
+                                                  double min, double max) {
+  FieldPredicate predicate = Double(
+      std::move(field), type,
+      [min, max](double value) { return value >= min && value <= max; });
+  predicate.has_range_ = true;
+  predicate.double_min_ = min;
+  predicate.double_max_ = max;
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::BytesRange(Field field,
+                                                 absl::string_view min,
+                                                 absl::string_view max) {
+  FieldPredicate predicate = Bytes(
+      std::move(field),
+      [min = std::string(min), max = std::string(max)](
+          absl::string_view value) { return value >= min && value <= max; });
+  predicate.has_range_ = true;
+  predicate.bytes_min_ = std::string(min);
+  predicate.bytes_max_ = std::string(max);
+  return predicate;
+}
+
+inline FieldPredicate FieldPredicate::Int64Equals(Field field, ColumnType type,
+                                                  int64_t value) {
+  return Int64Range(std::move(field), type, value, value);
+}
+
+inline FieldPredicate FieldPredicate::BytesEquals(Field field,
+                                                  absl::string_view value) {
+  return BytesRange(std::move(field), value, value);
+}
+
+inline FieldPredicate::FieldPredicate(const FieldPredicate& that)
+    : field_(that.field_),
+      type_(that.type_),
+      int64_test_(that.int64_test_),
+      double_test_(that.double_test_),
+      bytes_test_(that.bytes_test_),
+      has_range_(that.has_range_),
+      int64_min_(that.int64_min_),
+      int64_max_(that.int64_max_),
+      double_min_(that.double_min_),
+      double_max_(that.double_max_),
+      bytes_min_(that.bytes_min_),
+      bytes_max_(that.bytes_max_) {}
+
+inline FieldPredicate& FieldPredicate::operator=(const FieldPredicate& that) {
+  field_ = that.field_;
+  type_ = that.type_;
+  int64_test_ = that.int64_test_;
+  double_test_ = that.double_test_;
+  bytes_test_ = that.bytes_test_;
+  has_range_ = that.has_range_;
+  int64_min_ = that.int64_min_;
+  int64_max_ = that.int64_max_;
+  double_min_ = that.double_min_;
+  double_max_ = that.double_max_;
+  bytes_min_ = that.bytes_min_;
+  bytes_max_ = that.bytes_max_;
+  return *this;
+}
+
+inline FieldPredicate::FieldPredicate(FieldPredicate&& that) noexcept
+    : field_(std::move(that.field_)),
+      type_(that.type_),
+      int64_test_(std::move(that.int64_test_)),
+      double_test_(std::move(that.double_test_)),
+      bytes_test_(std::move(that.bytes_test_)),
+      has_range_(that.has_range_),
+      int64_min_(that.int64_min_),
+      int64_max_(that.int64_max_),
+      double_min_(that.double_min_),
+      double_max_(that.double_max_),
+      bytes_min_(std::move(that.bytes_min_)),
+      bytes_max_(std::move(that.bytes_max_)) {}
+
+inline FieldPredicate& FieldPredicate::operator=(
+    FieldPredicate&& that) noexcept {
+  field_ = std::move(that.field_);
+  type_ = that.type_;
+  int64_test_ = std::move(that.int64_test_);
+  double_test_ = std::move(that.double_test_);
+  bytes_test_ = std::move(that.bytes_test_);
+  has_range_ = that.has_range_;
+  int64_min_ = that.int64_min_;
+  int64_max_ = that.int64_max_;
+  double_min_ = that.double_min_;
+  double_max_ = that.double_max_;
+  bytes_min_ = std::move(that.bytes_min_);
+  bytes_max_ = std::move(that.bytes_max_);
+  return *this;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_FIELD_PREDICATE_H_
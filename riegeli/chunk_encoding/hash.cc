@@ -14,14 +14,21 @@
 
 #include "riegeli/chunk_encoding/hash.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <memory>
+
 #include "absl/container/inlined_vector.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "highwayhash/arch_specific.h"
 #include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
 #include "highwayhash/highwayhash_target.h"
 #include "highwayhash/instruction_sets.h"
+#include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 
 namespace riegeli {
@@ -36,6 +43,19 @@ const highwayhash::HHKey kHashKey HH_ALIGNAS(32) = {
     0x0a7364726f636572,  // 'records\n'
 };
 
+// Like `highwayhash::HighwayHash`, but hashes `size` buffers with the same
+// instruction set.
+template <highwayhash::TargetBits Target>
+struct HighwayHashBatch {
+  void operator()(const highwayhash::HHKey& key, const absl::string_view* data,
+                  size_t size, highwayhash::HHResult64* hashes) const {
+    for (size_t i = 0; i < size; ++i) {
+      highwayhash::HighwayHash<Target>()(key, data[i].data(), data[i].size(),
+                                         &hashes[i]);
+    }
+  }
+};
+
 }  // namespace
 
 uint64_t Hash(absl::string_view data) {
@@ -61,5 +81,38 @@ uint64_t Hash(const Chain& data) {
   return result;
 }
 
+void HashBatch(absl::Span<const absl::string_view> data,
+               absl::Span<uint64_t> hashes) {
+  RIEGELI_ASSERT_EQ(data.size(), hashes.size())
+      << "Failed precondition of HashBatch(): sizes differ";
+  if (data.empty()) return;
+  highwayhash::InstructionSets::Run<HighwayHashBatch>(
+      kHashKey, data.data(), data.size(), hashes.data());
+}
+
+struct HashDigester::State {
+  highwayhash::HighwayHashCatT<HH_TARGET_PREFERRED> cat{kHashKey};
+};
+
+HashDigester::HashDigester() : state_(std::make_unique<State>()) {}
+
+HashDigester::HashDigester(HashDigester&& that) noexcept = default;
+
+HashDigester& HashDigester::operator=(HashDigester&& that) noexcept = default;
+
+HashDigester::~HashDigester() = default;
+
+void HashDigester::Write(absl::string_view src) {
+  state_->cat.Append(src.data(), src.size());
+}
+
+uint64_t HashDigester::Digest() {
+  // Finalize a copy, so that more data can be written afterwards.
+  State state = *state_;
+  highwayhash::HHResult64 result;
+  state.cat.Finalize(&result);
+  return result;
+}
+
 }  // namespace internal
 }  // namespace riegeli
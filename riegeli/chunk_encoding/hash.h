@@ -17,7 +17,10 @@
 
 #include <stdint.h>
 
+#include <memory>
+
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "riegeli/base/chain.h"
 
 namespace riegeli {
@@ -26,6 +29,41 @@ namespace internal {
 uint64_t Hash(absl::string_view data);
 uint64_t Hash(const Chain& data);
 
+// Computes `Hash()` of each element of `data`, storing the results in the
+// corresponding elements of `hashes`.
+//
+// This is faster than calling `Hash()` for each element when there are many
+// short elements, because the instruction set is dispatched once.
+//
+// Precondition: `data.size() == hashes.size()`
+void HashBatch(absl::Span<const absl::string_view> data,
+               absl::Span<uint64_t> hashes);
+
+// A `Digester` for `DigestingReader` which computes `Hash()` of data read.
+//
+// This lets data be hashed while they are consumed for another purpose, e.g.
+// decompressed, instead of in a separate pass. Unlike `Hash()`, the instruction
+// set is chosen at compile time, so this is slower than `Hash()` unless the
+// code is compiled for a CPU supporting vector instructions, e.g. with
+// `-mavx2`.
+class HashDigester {
+ public:
+  HashDigester();
+
+  HashDigester(HashDigester&& that) noexcept;
+  HashDigester& operator=(HashDigester&& that) noexcept;
+
+  ~HashDigester();
+
+  void Write(absl::string_view src);
+  uint64_t Digest();
+
+ private:
+  struct State;
+
+  std::unique_ptr<State> state_;
+};
+
 }  // namespace internal
 }  // namespace riegeli
 
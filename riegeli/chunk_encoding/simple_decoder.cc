@@ -23,16 +23,98 @@
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/limiting_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/decompressor.h"
+#include "riegeli/endian/endian_reading.h"
 #include "riegeli/varint/varint_reading.h"
 
 namespace riegeli {
 
+namespace {
+
+enum class ReadLimitsResult { kOk, kReadFailed, kTooLarge };
+
+// Reads `num_sizes` record sizes and appends to `dest` limits of records, i.e.
+// running sums of sizes starting from `limit`, which is updated to the last
+// limit.
+//
+// Decoding varints is fused with computing the sums. Sizes shorter than 128,
+// which are typical for tiny records, are processed 8 at a time.
+//
+// Returns `kTooLarge` if a limit would exceed `max_limit`.
+ReadLimitsResult ReadLimits(Reader& src, size_t num_sizes, size_t max_limit,
+                            size_t& limit, std::vector<size_t>& dest) {
+  // Grow `dest` geometrically, because `num_sizes` is a part of all sizes.
+  if (dest.capacity() - dest.size() < num_sizes) {
+    dest.reserve(
+        UnsignedMax(dest.size() + num_sizes,
+                    UnsignedMin(dest.capacity() * 2, dest.max_size())));
+  }
+  while (num_sizes > 0) {
+    uint64_t size;
+    if (src.available() < kMaxLengthVarint64) {
+      src.Pull(kMaxLengthVarint64,
+               UnsignedMin(num_sizes,
+                           std::numeric_limits<size_t>::max() /
+                               kMaxLengthVarint64) *
+                   kMaxLengthVarint64);
+      if (src.available() < kMaxLengthVarint64) {
+        // Near the end of the source.
+        if (ABSL_PREDICT_FALSE(!ReadVarint64(src, size))) {
+          return ReadLimitsResult::kReadFailed;
+        }
+        if (ABSL_PREDICT_FALSE(size > max_limit - limit)) {
+          return ReadLimitsResult::kTooLarge;
+        }
+        limit += IntCast<size_t>(size);
+        dest.push_back(limit);
+        --num_sizes;
+        continue;
+      }
+    }
+    // A varint which begins before `safe_limit` ends before `src.limit()`
+    // unless it is invalid.
+    const char* cursor = src.cursor();
+    const char* const safe_limit = src.limit() - (kMaxLengthVarint64 - 1);
+    do {
+      // 8 sizes shorter than 128 add at most 8 * 127 to the limit.
+      while (PtrDistance(cursor, src.limit()) >= 8 && num_sizes >= 8 &&
+             max_limit - limit >= size_t{8 * 127}) {
+        const uint64_t sizes = ReadLittleEndian64(cursor);
+        if ((sizes & uint64_t{0x8080808080808080}) != 0) break;
+        for (size_t i = 0; i < 8; ++i) {
+          limit += IntCast<size_t>((sizes >> (i * 8)) & 0x7f);
+          dest.push_back(limit);
+        }
+        cursor += 8;
+        num_sizes -= 8;
+      }
+      if (num_sizes == 0 || cursor >= safe_limit) break;
+      const absl::optional<const char*> next =
+          ReadVarint64(cursor, src.limit(), size);
+      if (ABSL_PREDICT_FALSE(next == absl::nullopt)) {
+        return ReadLimitsResult::kReadFailed;
+      }
+      cursor = *next;
+      if (ABSL_PREDICT_FALSE(size > max_limit - limit)) {
+        return ReadLimitsResult::kTooLarge;
+      }
+      limit += IntCast<size_t>(size);
+      dest.push_back(limit);
+      --num_sizes;
+    } while (num_sizes > 0 && cursor < safe_limit);
+    src.set_cursor(cursor);
+  }
+  return ReadLimitsResult::kOk;
+}
+
+}  // namespace
+
 void SimpleDecoder::Done() {
   if (ABSL_PREDICT_FALSE(!values_decompressor_.Close())) {
     Fail(values_decompressor_.status());
@@ -68,24 +150,29 @@ bool SimpleDecoder::Decode(Reader* src, uint64_t num_records,
   internal::Decompressor<LimitingReader<>> sizes_decompressor(
       std::forward_as_tuple(
           src, LimitingReaderBase::Options().set_exact_length(sizes_size)),
-      compression_type);
+      compression_type, zstd_dictionary_);
   if (ABSL_PREDICT_FALSE(!sizes_decompressor.healthy())) {
     return Fail(sizes_decompressor.status());
   }
   limits.clear();
   size_t limit = 0;
+  // Record sizes are decoded in batches of bounded size, because
+  // `num_records` is not trusted yet.
+  constexpr size_t kMaxBatchSize = 4096;
   while (limits.size() != num_records) {
-    uint64_t size;
-    if (ABSL_PREDICT_FALSE(!ReadVarint64(sizes_decompressor.reader(), size))) {
-      return Fail(sizes_decompressor.reader().StatusOrAnnotate(
-          absl::InvalidArgumentError("Reading record size failed")));
-    }
-    if (ABSL_PREDICT_FALSE(size > decoded_data_size - limit)) {
-      return Fail(
-          absl::InvalidArgumentError("Decoded data size larger than expected"));
+    const size_t batch_size =
+        UnsignedMin(num_records - limits.size(), kMaxBatchSize);
+    switch (ReadLimits(sizes_decompressor.reader(), batch_size,
+                       IntCast<size_t>(decoded_data_size), limit, limits)) {
+      case ReadLimitsResult::kOk:
+        break;
+      case ReadLimitsResult::kReadFailed:
+        return Fail(sizes_decompressor.reader().StatusOrAnnotate(
+            absl::InvalidArgumentError("Reading record size failed")));
+      case ReadLimitsResult::kTooLarge:
+        return Fail(absl::InvalidArgumentError(
+            "Decoded data size larger than expected"));
     }
-    limit += IntCast<size_t>(size);
-    limits.push_back(limit);
   }
   if (ABSL_PREDICT_FALSE(!sizes_decompressor.VerifyEndAndClose())) {
     return Fail(sizes_decompressor.status());
@@ -95,7 +182,7 @@ bool SimpleDecoder::Decode(Reader* src, uint64_t num_records,
         absl::InvalidArgumentError("Decoded data size smaller than expected"));
   }
 
-  values_decompressor_.Reset(src, compression_type);
+  values_decompressor_.Reset(src, compression_type, zstd_dictionary_);
   if (ABSL_PREDICT_FALSE(!values_decompressor_.healthy())) {
     return Fail(values_decompressor_.status());
   }
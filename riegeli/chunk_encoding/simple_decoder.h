@@ -18,6 +18,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
@@ -25,13 +26,21 @@
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/decompressor.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
 class SimpleDecoder : public Object {
  public:
   // Creates a closed `SimpleDecoder`.
-  SimpleDecoder() noexcept : Object(kClosed), values_decompressor_(kClosed) {}
+  //
+  // `zstd_dictionary` is used for chunks compressed with
+  // `CompressionType::kZstdWithDictionary`.
+  explicit SimpleDecoder(
+      ZstdDictionary zstd_dictionary = ZstdDictionary()) noexcept
+      : Object(kClosed),
+        zstd_dictionary_(std::move(zstd_dictionary)),
+        values_decompressor_(kClosed) {}
 
   SimpleDecoder(const SimpleDecoder&) = delete;
   SimpleDecoder& operator=(const SimpleDecoder&) = delete;
@@ -70,6 +79,7 @@ class SimpleDecoder : public Object {
   void Done() override;
 
  private:
+  ZstdDictionary zstd_dictionary_;
   internal::Decompressor<> values_decompressor_;
 };
 
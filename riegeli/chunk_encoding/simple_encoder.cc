@@ -25,9 +25,11 @@
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
 #include "riegeli/chunk_encoding/compressor.h"
@@ -38,17 +40,28 @@
 
 namespace riegeli {
 
+namespace {
+
+// Returns compressor options for collecting data before the chunk is encoded.
+CompressorOptions CollectingOptions(const CompressorOptions& options) {
+  if (options.min_compression_gain() == absl::nullopt) return options;
+  return CompressorOptions().set_uncompressed();
+}
+
+}  // namespace
+
 SimpleEncoder::SimpleEncoder(CompressorOptions options, uint64_t size_hint)
-    : compression_type_(options.compression_type()),
-      sizes_compressor_(options),
+    : compressor_options_(std::move(options)),
+      sizes_compressor_(CollectingOptions(compressor_options_)),
       values_compressor_(
-          options,
+          CollectingOptions(compressor_options_),
           internal::Compressor::TuningOptions().set_size_hint(size_hint)) {}
 
 void SimpleEncoder::Clear() {
   ChunkEncoder::Clear();
   sizes_compressor_.Clear();
   values_compressor_.Clear();
+  record_begin_ = 0;
 }
 
 bool SimpleEncoder::AddRecord(const google::protobuf::MessageLite& record,
@@ -156,6 +169,38 @@ bool SimpleEncoder::AddRecords(Chain records, std::vector<size_t> limits) {
   return true;
 }
 
+Writer* SimpleEncoder::BeginRecord() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  if (ABSL_PREDICT_FALSE(num_records_ == kMaxNumRecords)) {
+    Fail(absl::ResourceExhaustedError("Too many records"));
+    return nullptr;
+  }
+  record_begin_ = values_compressor_.writer().pos();
+  return &values_compressor_.writer();
+}
+
+bool SimpleEncoder::EndRecord() {
+  if (ABSL_PREDICT_FALSE(!values_compressor_.writer().healthy())) {
+    return Fail(values_compressor_.writer().status());
+  }
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  RIEGELI_ASSERT_GE(values_compressor_.writer().pos(), record_begin_)
+      << "Failed precondition of SimpleEncoder::EndRecord(): "
+         "record writer moved backwards";
+  const Position size = values_compressor_.writer().pos() - record_begin_;
+  if (ABSL_PREDICT_FALSE(size > std::numeric_limits<uint64_t>::max() -
+                                    decoded_data_size_)) {
+    return Fail(absl::ResourceExhaustedError("Decoded data size too large"));
+  }
+  ++num_records_;
+  decoded_data_size_ += IntCast<uint64_t>(size);
+  if (ABSL_PREDICT_FALSE(!WriteVarint64(IntCast<uint64_t>(size),
+                                        sizes_compressor_.writer()))) {
+    return Fail(sizes_compressor_.writer().status());
+  }
+  return true;
+}
+
 bool SimpleEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
                                    uint64_t& num_records,
                                    uint64_t& decoded_data_size) {
@@ -164,20 +209,75 @@ bool SimpleEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
   num_records = num_records_;
   decoded_data_size = decoded_data_size_;
 
+  if (compressor_options_.min_compression_gain() == absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(
+            !WriteChunk(compressor_options_.stored_compression_type(),
+                        sizes_compressor_, values_compressor_, dest))) {
+      return false;
+    }
+    return Close();
+  }
+
+  // `sizes_compressor_` and `values_compressor_` collected uncompressed data.
+  // Compress them now, unless record values are incompressible.
+  ChainWriter<Chain> sizes_writer;
+  if (ABSL_PREDICT_FALSE(!sizes_compressor_.EncodeAndClose(sizes_writer))) {
+    return Fail(sizes_compressor_.status());
+  }
+  if (ABSL_PREDICT_FALSE(!sizes_writer.Close())) {
+    return Fail(sizes_writer.status());
+  }
+  ChainWriter<Chain> values_writer;
+  if (ABSL_PREDICT_FALSE(!values_compressor_.EncodeAndClose(values_writer))) {
+    return Fail(values_compressor_.status());
+  }
+  if (ABSL_PREDICT_FALSE(!values_writer.Close())) {
+    return Fail(values_writer.status());
+  }
+  const CompressorOptions chunk_options =
+      internal::WorthCompressing(values_writer.dest(), compressor_options_)
+          ? compressor_options_
+          : CompressorOptions().set_uncompressed();
+  internal::Compressor sizes_compressor(
+      chunk_options, internal::Compressor::TuningOptions().set_pledged_size(
+                         sizes_writer.dest().size()));
+  if (ABSL_PREDICT_FALSE(
+          !sizes_compressor.writer().Write(std::move(sizes_writer.dest())))) {
+    return Fail(sizes_compressor.writer().status());
+  }
+  internal::Compressor values_compressor(
+      chunk_options, internal::Compressor::TuningOptions().set_pledged_size(
+                         values_writer.dest().size()));
+  if (ABSL_PREDICT_FALSE(
+          !values_compressor.writer().Write(std::move(values_writer.dest())))) {
+    return Fail(values_compressor.writer().status());
+  }
+  if (ABSL_PREDICT_FALSE(!WriteChunk(chunk_options.stored_compression_type(),
+                                     sizes_compressor, values_compressor,
+                                     dest))) {
+    return false;
+  }
+  return Close();
+}
+
+inline bool SimpleEncoder::WriteChunk(CompressionType compression_type,
+                                      internal::Compressor& sizes_compressor,
+                                      internal::Compressor& values_compressor,
+                                      Writer& dest) {
   if (ABSL_PREDICT_FALSE(
-          !dest.WriteByte(static_cast<uint8_t>(compression_type_)))) {
+          !dest.WriteByte(static_cast<uint8_t>(compression_type)))) {
     return Fail(dest.status());
   }
 
   if (ABSL_PREDICT_FALSE(
-          !sizes_compressor_.LengthPrefixedEncodeAndClose(dest))) {
-    return Fail(sizes_compressor_.status());
+          !sizes_compressor.LengthPrefixedEncodeAndClose(dest))) {
+    return Fail(sizes_compressor.status());
   }
 
-  if (ABSL_PREDICT_FALSE(!values_compressor_.EncodeAndClose(dest))) {
-    return Fail(values_compressor_.status());
+  if (ABSL_PREDICT_FALSE(!values_compressor.EncodeAndClose(dest))) {
+    return Fail(values_compressor.status());
   }
-  return Close();
+  return true;
 }
 
 }  // namespace riegeli
@@ -23,6 +23,7 @@
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "google/protobuf/message_lite.h"
+#include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
@@ -43,6 +44,10 @@ namespace riegeli {
 //
 // If compression is used, a compressed block is prefixed by its varint-encoded
 // uncompressed size.
+//
+// If `CompressorOptions::min_compression_gain()` is set, record sizes and
+// values are collected uncompressed, and compressed only when the chunk is
+// encoded, unless record values are found incompressible.
 class SimpleEncoder : public ChunkEncoder {
  public:
   // Creates an empty `SimpleEncoder`.
@@ -61,6 +66,25 @@ class SimpleEncoder : public ChunkEncoder {
 
   bool AddRecords(Chain records, std::vector<size_t> limits) override;
 
+  // Begins a record whose value is written incrementally to the returned
+  // `Writer`, instead of being materialized beforehand. This allows records
+  // larger than memory if compression is applied on the fly, i.e.
+  // `CompressorOptions::min_compression_gain() == absl::nullopt`.
+  //
+  // The returned `Writer` is valid until `EndRecord()`. It must not be closed.
+  // Other records must not be added meanwhile.
+  //
+  // Returns `nullptr` on failure (`!healthy()`).
+  Writer* BeginRecord();
+
+  // Finishes the record begun by `BeginRecord()`. Its size is the number of
+  // bytes written to the `Writer` returned by `BeginRecord()`.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool EndRecord();
+
   bool EncodeAndClose(Writer& dest, ChunkType& chunk_type,
                       uint64_t& num_records,
                       uint64_t& decoded_data_size) override;
@@ -70,9 +94,18 @@ class SimpleEncoder : public ChunkEncoder {
   template <typename Record>
   bool AddRecordImpl(Record&& record);
 
-  CompressionType compression_type_;
+  // Writes the compression type, then record sizes and values taken from
+  // `sizes_compressor` and `values_compressor`, which must use compression
+  // options with `compression_type` as `stored_compression_type()`.
+  bool WriteChunk(CompressionType compression_type,
+                  internal::Compressor& sizes_compressor,
+                  internal::Compressor& values_compressor, Writer& dest);
+
+  CompressorOptions compressor_options_;
   internal::Compressor sizes_compressor_;
   internal::Compressor values_compressor_;
+  // The position of `values_compressor_.writer()` at `BeginRecord()`.
+  Position record_begin_ = 0;
 };
 
 }  // namespace riegeli
@@ -0,0 +1,184 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_backward_writer.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/chunk_encoding/transpose_decoder.h"
+#include "riegeli/chunk_encoding/transpose_encoder.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+namespace {
+
+constexpr size_t kNumRecords = 10000;
+
+void WriteVarintField(int field_number, uint64_t value, std::string& dest) {
+  StringWriter<> writer(&dest, StringWriterBase::Options().set_append(true));
+  WriteVarint32(MakeTag(field_number, WireType::kVarint), writer);
+  WriteVarint64(value, writer);
+  writer.Close();
+}
+
+void WriteStringField(int field_number, absl::string_view value,
+                      std::string& dest) {
+  StringWriter<> writer(&dest, StringWriterBase::Options().set_append(true));
+  WriteVarint32(MakeTag(field_number, WireType::kLengthDelimited), writer);
+  WriteVarint64(value.size(), writer);
+  writer.Write(value);
+  writer.Close();
+}
+
+// Returns serialized messages with a structure like:
+// ```
+//   message Sample {
+//     optional int64 id = 1;
+//     optional string name = 2;
+//     repeated int64 values = 3;
+//     message Nested {
+//       optional int32 kind = 1;
+//       optional bytes payload = 2;
+//     }
+//     optional Nested nested = 4;
+//   }
+// ```
+std::vector<std::string> SampleRecords() {
+  std::mt19937_64 random(1);
+  std::uniform_int_distribution<int> name_distribution(0, 99);
+  std::uniform_int_distribution<int> count_distribution(0, 8);
+  std::uniform_int_distribution<uint64_t> value_distribution(0, 1 << 20);
+  std::uniform_int_distribution<size_t> length_distribution(0, 200);
+  std::vector<std::string> records;
+  records.reserve(kNumRecords);
+  for (size_t i = 0; i < kNumRecords; ++i) {
+    std::string record;
+    WriteVarintField(1, i, record);
+    WriteStringField(
+        2, std::string("name_") + std::to_string(name_distribution(random)),
+        record);
+    for (int j = count_distribution(random); j > 0; --j) {
+      WriteVarintField(3, value_distribution(random), record);
+    }
+    std::string nested;
+    WriteVarintField(1, count_distribution(random), nested);
+    WriteStringField(2, std::string(length_distribution(random), 'p'), nested);
+    WriteStringField(4, nested, record);
+    records.push_back(std::move(record));
+  }
+  return records;
+}
+
+size_t TotalSize(const std::vector<std::string>& records) {
+  size_t size = 0;
+  for (const std::string& record : records) size += record.size();
+  return size;
+}
+
+// Encodes the sample records, with buckets of `bucket_size` bytes.
+void BM_TransposeEncode(benchmark::State& state) {
+  const uint64_t bucket_size = static_cast<uint64_t>(state.range(0));
+  const std::vector<std::string> records = SampleRecords();
+  for (auto _ : state) {
+    TransposeEncoder encoder(CompressorOptions().set_zstd(), bucket_size);
+    for (const std::string& record : records) encoder.AddRecord(record);
+    Chain encoded;
+    ChainWriter<> writer(&encoded);
+    ChunkType chunk_type;
+    uint64_t num_records, decoded_data_size;
+    if (!encoder.EncodeAndClose(writer, chunk_type, num_records,
+                                decoded_data_size) ||
+        !writer.Close()) {
+      state.SkipWithError("TransposeEncoder failed");
+      break;
+    }
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(TotalSize(records)));
+}
+BENCHMARK(BM_TransposeEncode)
+    ->Arg(64 << 10)
+    ->Arg(std::numeric_limits<int64_t>::max());
+
+// Decodes the sample records encoded with buckets of 64K, with the field
+// projection selected by `state.range(0)`:
+//  * 0 - all fields
+//  * 1 - only `id`, so that buckets of the other fields are skipped
+//  * 2 - only `nested.kind`
+void BM_TransposeDecode(benchmark::State& state) {
+  FieldProjection field_projection;
+  switch (state.range(0)) {
+    case 0:
+      field_projection = FieldProjection::All();
+      state.SetLabel("all");
+      break;
+    case 1:
+      field_projection = FieldProjection({Field({1})});
+      state.SetLabel("id");
+      break;
+    default:
+      field_projection = FieldProjection({Field({4, 1})});
+      state.SetLabel("nested.kind");
+      break;
+  }
+  const std::vector<std::string> records = SampleRecords();
+  TransposeEncoder encoder(CompressorOptions().set_zstd(), 64 << 10);
+  for (const std::string& record : records) encoder.AddRecord(record);
+  Chain encoded;
+  ChainWriter<> writer(&encoded);
+  ChunkType chunk_type;
+  uint64_t num_records, decoded_data_size;
+  if (!encoder.EncodeAndClose(writer, chunk_type, num_records,
+                              decoded_data_size) ||
+      !writer.Close()) {
+    state.SkipWithError("TransposeEncoder failed");
+    return;
+  }
+  TransposeDecoder decoder;
+  std::vector<size_t> limits;
+  for (auto _ : state) {
+    ChainReader<> src(&encoded);
+    Chain decoded;
+    ChainBackwardWriter<> dest(&decoded);
+    if (!decoder.Decode(num_records, decoded_data_size, field_projection, src,
+                        dest, limits) ||
+        !dest.Close()) {
+      state.SkipWithError("TransposeDecoder failed");
+      break;
+    }
+    benchmark::DoNotOptimize(decoded);
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(decoded_data_size));
+}
+BENCHMARK(BM_TransposeDecode)->DenseRange(0, 2);
+
+}  // namespace
+}  // namespace riegeli
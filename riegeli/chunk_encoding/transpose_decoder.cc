@@ -29,18 +29,22 @@
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/memory.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/limiting_backward_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/string_reader.h"
+#include "riegeli/chunk_encoding/buffer_transform.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/decompressor.h"
 #include "riegeli/chunk_encoding/field_projection.h"
@@ -48,6 +52,7 @@
 #include "riegeli/messages/message_wire_format.h"
 #include "riegeli/varint/varint_reading.h"
 #include "riegeli/varint/varint_writing.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -64,12 +69,19 @@ constexpr uint32_t kInvalidPos = std::numeric_limits<uint32_t>::max();
 
 // Information about one data bucket used in projection.
 struct DataBucket {
+  // If not `absl::nullopt`, the position of raw bucket data in the source,
+  // which were not read yet. Their length is `compressed_size`.
+  absl::optional<Position> pending_pos;
+  size_t compressed_size = 0;
   // Raw bucket data, valid if not all buffers are already decompressed,
   // otherwise empty.
   Chain compressed_data;
   // Sizes of data buffers in the bucket, valid if not all buffers are already
   // decompressed, otherwise empty.
   std::vector<size_t> buffer_sizes;
+  // Transforms of data buffers in the bucket, parallel to `buffer_sizes`, or
+  // empty if the chunk has no transformed buffers.
+  std::vector<internal::BufferTransform> buffer_transforms;
   // Decompressor for the remaining data, valid if some but not all buffers are
   // already decompressed, otherwise closed.
   internal::Decompressor<ChainReader<>> decompressor{kClosed};
@@ -77,6 +89,53 @@ struct DataBucket {
   std::vector<ChainReader<Chain>> buffers;
 };
 
+// Decompresses buffers of `bucket` until at least `num_buffers` of them are
+// decompressed.
+absl::Status DecompressBuffers(CompressionType compression_type,
+                               const ZstdDictionary& zstd_dictionary,
+                               DataBucket& bucket, size_t num_buffers) {
+  while (bucket.buffers.size() < num_buffers) {
+    if (bucket.buffers.empty()) {
+      // This is the first buffer to be decompressed from this bucket.
+      bucket.decompressor.Reset(std::forward_as_tuple(&bucket.compressed_data),
+                                compression_type, zstd_dictionary);
+      if (ABSL_PREDICT_FALSE(!bucket.decompressor.healthy())) {
+        return bucket.decompressor.status();
+      }
+      // Important to prevent invalidating pointers by `emplace_back()`.
+      bucket.buffers.reserve(bucket.buffer_sizes.size());
+    }
+    Chain buffer;
+    if (ABSL_PREDICT_FALSE(!bucket.decompressor.reader().Read(
+            bucket.buffer_sizes[bucket.buffers.size()], buffer))) {
+      return bucket.decompressor.reader().StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading buffer failed"));
+    }
+    if (!bucket.buffer_transforms.empty() &&
+        bucket.buffer_transforms[bucket.buffers.size()] !=
+            internal::BufferTransform::kNone) {
+      Chain untransformed;
+      const absl::Status status = internal::UntransformBuffer(
+          bucket.buffer_transforms[bucket.buffers.size()], buffer,
+          untransformed);
+      if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      buffer = std::move(untransformed);
+    }
+    bucket.buffers.emplace_back(std::move(buffer));
+    if (bucket.buffers.size() == bucket.buffer_sizes.size()) {
+      // This was the last decompressed buffer from this bucket.
+      if (ABSL_PREDICT_FALSE(!bucket.decompressor.VerifyEndAndClose())) {
+        return bucket.decompressor.status();
+      }
+      // Free memory of fields which are no longer needed.
+      bucket.compressed_data = Chain();
+      bucket.buffer_sizes = std::vector<size_t>();
+      bucket.buffer_transforms = std::vector<internal::BufferTransform>();
+    }
+  }
+  return absl::OkStatus();
+}
+
 // Should the data content of the field be decoded?
 enum class FieldIncluded {
   kYes,
@@ -368,6 +427,10 @@ inline bool IsImplicit(CallbackType callback_type) {
 struct TransposeDecoder::Context {
   // Compression type of the input.
   CompressionType compression_type = CompressionType::kNone;
+  // Transforms of data buffers, as pairs of buffer index and transform,
+  // sorted by buffer index.
+  std::vector<std::pair<uint32_t, internal::BufferTransform>>
+      buffer_transforms;
   // Buffer containing all the data.
   // Note: Used only when projection is disabled.
   std::vector<ChainReader<Chain>> buffers;
@@ -379,6 +442,13 @@ struct TransposeDecoder::Context {
   uint32_t first_node = 0;
   // State machine transitions. One byte = one transition.
   internal::Decompressor<> transitions{kClosed};
+  // If buckets are read from the source on demand, the source of buckets,
+  // otherwise `nullptr`.
+  Reader* bucket_src = nullptr;
+  // If `bucket_src != nullptr`, the source of `transitions`, read after
+  // buckets, so that reading buckets does not interfere with reading
+  // transitions.
+  ChainReader<Chain> transitions_src{kClosed};
 
   enum class IncludeType : uint8_t {
     // Field is included.
@@ -411,11 +481,13 @@ struct TransposeDecoder::Context {
 bool TransposeDecoder::Decode(uint64_t num_records, uint64_t decoded_data_size,
                               const FieldProjection& field_projection,
                               Reader& src, BackwardWriter& dest,
-                              std::vector<size_t>& limits) {
+                              std::vector<size_t>& limits,
+                              uint64_t first_record_index) {
   RIEGELI_ASSERT_EQ(dest.pos(), 0u)
       << "Failed precondition of TransposeDecoder::Reset(): "
          "non-zero destination position";
   Object::Reset();
+  skipped_buckets_.clear();
   if (ABSL_PREDICT_FALSE(num_records > limits.max_size())) {
     return Fail(absl::ResourceExhaustedError("Too many records"));
   }
@@ -423,21 +495,29 @@ bool TransposeDecoder::Decode(uint64_t num_records, uint64_t decoded_data_size,
                          std::numeric_limits<size_t>::max())) {
     return Fail(absl::ResourceExhaustedError("Records too large"));
   }
+  first_record_index = UnsignedMin(first_record_index, num_records);
 
   Context context;
   if (ABSL_PREDICT_FALSE(!Parse(context, src, field_projection))) return false;
   LimitingBackwardWriter<> limiting_dest(
       &dest, LimitingBackwardWriterBase::Options()
                  .set_max_length(decoded_data_size)
-                 .set_exact(field_projection.includes_all()));
-  if (ABSL_PREDICT_FALSE(
-          !Decode(context, num_records, limiting_dest, limits))) {
+                 .set_exact(field_projection.includes_all() &&
+                            first_record_index == 0));
+  if (ABSL_PREDICT_FALSE(!Decode(context, num_records, first_record_index,
+                                 limiting_dest, limits))) {
     limiting_dest.Close();
     return false;
   }
   if (ABSL_PREDICT_FALSE(!limiting_dest.Close())) {
     return Fail(limiting_dest.status());
   }
+  for (uint32_t bucket_index = 0; bucket_index < context.buckets.size();
+       ++bucket_index) {
+    if (context.buckets[bucket_index].buffers.empty()) {
+      skipped_buckets_.push_back(bucket_index);
+    }
+  }
   return true;
 }
 
@@ -488,8 +568,10 @@ inline bool TransposeDecoder::Parse(Context& context, Reader& src,
     return Fail(src.StatusOrAnnotate(
         absl::InvalidArgumentError("Reading compression type failed")));
   }
-  context.compression_type =
-      static_cast<CompressionType>(compression_type_byte);
+  const bool has_buffer_transforms =
+      (compression_type_byte & internal::kBufferTransformsFlag) != 0;
+  context.compression_type = static_cast<CompressionType>(
+      compression_type_byte & ~internal::kBufferTransformsFlag);
 
   uint64_t header_size;
   Chain header;
@@ -499,11 +581,19 @@ inline bool TransposeDecoder::Parse(Context& context, Reader& src,
         absl::InvalidArgumentError("Reading header failed")));
   }
   internal::Decompressor<ChainReader<>> header_decompressor(
-      std::forward_as_tuple(&header), context.compression_type);
+      std::forward_as_tuple(&header), context.compression_type,
+      zstd_dictionary_);
   if (ABSL_PREDICT_FALSE(!header_decompressor.healthy())) {
     return Fail(header_decompressor.status());
   }
 
+  if (has_buffer_transforms) {
+    if (ABSL_PREDICT_FALSE(
+            !ParseBufferTransforms(context, header_decompressor.reader()))) {
+      return false;
+    }
+  }
+
   uint32_t num_buffers;
   std::vector<uint32_t> first_buffer_indices;
   std::vector<uint32_t> bucket_indices;
@@ -744,13 +834,69 @@ inline bool TransposeDecoder::Parse(Context& context, Reader& src,
   if (ABSL_PREDICT_FALSE(!header_decompressor.VerifyEndAndClose())) {
     return Fail(header_decompressor.status());
   }
-  context.transitions.Reset(&src, context.compression_type);
+  if (projection_enabled && executor_ != nullptr) {
+    if (ABSL_PREDICT_FALSE(!PrefetchBuckets(context))) return false;
+  }
+  if (context.bucket_src != nullptr) {
+    Chain transitions;
+    if (ABSL_PREDICT_FALSE(!src.ReadAll(transitions))) {
+      return Fail(src.StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading transitions failed")));
+    }
+    context.transitions_src.Reset(std::move(transitions));
+    context.transitions.Reset(&context.transitions_src,
+                              context.compression_type, zstd_dictionary_);
+  } else {
+    context.transitions.Reset(&src, context.compression_type, zstd_dictionary_);
+  }
   if (ABSL_PREDICT_FALSE(!context.transitions.healthy())) {
     return Fail(context.transitions.status());
   }
   return true;
 }
 
+inline bool TransposeDecoder::ParseBufferTransforms(Context& context,
+                                                    Reader& header_reader) {
+  uint32_t num_transforms;
+  if (ABSL_PREDICT_FALSE(!ReadVarint32(header_reader, num_transforms))) {
+    return Fail(header_reader.StatusOrAnnotate(absl::InvalidArgumentError(
+        "Reading number of buffer transforms failed")));
+  }
+  if (ABSL_PREDICT_FALSE(num_transforms == 0)) {
+    return Fail(absl::InvalidArgumentError("No buffer transforms"));
+  }
+  if (ABSL_PREDICT_FALSE(num_transforms >
+                         context.buffer_transforms.max_size())) {
+    return Fail(absl::ResourceExhaustedError("Too many buffer transforms"));
+  }
+  context.buffer_transforms.reserve(num_transforms);
+  for (uint32_t i = 0; i < num_transforms; ++i) {
+    uint32_t buffer_index;
+    uint8_t transform_byte;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(header_reader, buffer_index) ||
+                           !header_reader.ReadByte(transform_byte))) {
+      return Fail(header_reader.StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading buffer transform failed")));
+    }
+    if (ABSL_PREDICT_FALSE(!context.buffer_transforms.empty() &&
+                           buffer_index <=
+                               context.buffer_transforms.back().first)) {
+      return Fail(absl::InvalidArgumentError("Buffer transforms not sorted"));
+    }
+    const internal::BufferTransform transform =
+        static_cast<internal::BufferTransform>(transform_byte);
+    if (ABSL_PREDICT_FALSE(
+            transform != internal::BufferTransform::kDelta &&
+            transform != internal::BufferTransform::kDeltaOfDelta &&
+            transform != internal::BufferTransform::kDictionary)) {
+      return Fail(absl::InvalidArgumentError(absl::StrCat(
+          "Unknown buffer transform: ", unsigned{transform_byte})));
+    }
+    context.buffer_transforms.emplace_back(buffer_index, transform);
+  }
+  return true;
+}
+
 inline bool TransposeDecoder::ParseBuffers(Context& context,
                                            Reader& header_reader, Reader& src) {
   uint32_t num_buckets;
@@ -794,12 +940,55 @@ inline bool TransposeDecoder::ParseBuffers(Context& context,
           absl::InvalidArgumentError("Reading bucket failed")));
     }
     bucket_decompressors.emplace_back(std::forward_as_tuple(std::move(bucket)),
-                                      context.compression_type);
+                                      context.compression_type,
+                                      zstd_dictionary_);
     if (ABSL_PREDICT_FALSE(!bucket_decompressors.back().healthy())) {
       return Fail(bucket_decompressors.back().status());
     }
   }
 
+  std::vector<Reader*> bucket_readers;
+  bucket_readers.reserve(num_buckets);
+  std::vector<ChainReader<Chain>> decompressed_buckets;
+  if (executor_ != nullptr && num_buckets > 1) {
+    // Decompress all buckets in parallel, then split them into buffers.
+    std::vector<Chain> decompressed(num_buckets);
+    std::vector<absl::Status> statuses(num_buckets);
+    internal::ParallelFor(*executor_, num_buckets, [&](size_t index) {
+      internal::Decompressor<ChainReader<Chain>>& bucket_decompressor =
+          bucket_decompressors[index];
+      if (ABSL_PREDICT_FALSE(
+              !bucket_decompressor.reader().ReadAll(decompressed[index]))) {
+        statuses[index] = bucket_decompressor.reader().status();
+        return;
+      }
+      if (ABSL_PREDICT_FALSE(!bucket_decompressor.VerifyEndAndClose())) {
+        statuses[index] = bucket_decompressor.status();
+      }
+    });
+    decompressed_buckets.reserve(num_buckets);
+    for (uint32_t bucket_index = 0; bucket_index < num_buckets;
+         ++bucket_index) {
+      if (ABSL_PREDICT_FALSE(!statuses[bucket_index].ok())) {
+        return Fail(std::move(statuses[bucket_index]));
+      }
+      decompressed_buckets.emplace_back(std::move(decompressed[bucket_index]));
+      bucket_readers.push_back(&decompressed_buckets.back());
+    }
+  } else {
+    for (internal::Decompressor<ChainReader<Chain>>& bucket_decompressor :
+         bucket_decompressors) {
+      bucket_readers.push_back(&bucket_decompressor.reader());
+    }
+  }
+
+  if (ABSL_PREDICT_FALSE(!context.buffer_transforms.empty() &&
+                         context.buffer_transforms.back().first >=
+                             num_buffers)) {
+    return Fail(absl::InvalidArgumentError("Buffer index out of range"));
+  }
+  std::vector<std::pair<uint32_t, internal::BufferTransform>>::
+      const_iterator next_transform = context.buffer_transforms.cbegin();
   uint32_t bucket_index = 0;
   for (size_t buffer_index = 0; buffer_index < num_buffers; ++buffer_index) {
     uint64_t buffer_length;
@@ -812,17 +1001,26 @@ inline bool TransposeDecoder::ParseBuffers(Context& context,
       return Fail(absl::ResourceExhaustedError("Buffer too large"));
     }
     Chain buffer;
-    if (ABSL_PREDICT_FALSE(!bucket_decompressors[bucket_index].reader().Read(
+    if (ABSL_PREDICT_FALSE(!bucket_readers[bucket_index]->Read(
             IntCast<size_t>(buffer_length), buffer))) {
-      return Fail(bucket_decompressors[bucket_index].reader().StatusOrAnnotate(
+      return Fail(bucket_readers[bucket_index]->StatusOrAnnotate(
           absl::InvalidArgumentError("Reading buffer failed")));
     }
+    if (next_transform != context.buffer_transforms.cend() &&
+        next_transform->first == buffer_index) {
+      Chain untransformed;
+      const absl::Status status = internal::UntransformBuffer(
+          next_transform->second, buffer, untransformed);
+      if (ABSL_PREDICT_FALSE(!status.ok())) return Fail(status);
+      buffer = std::move(untransformed);
+      ++next_transform;
+    }
     context.buffers.emplace_back(std::move(buffer));
-    while (!bucket_decompressors[bucket_index].reader().Pull() &&
+    while (!bucket_readers[bucket_index]->Pull() &&
            bucket_index + 1 < num_buckets) {
       if (ABSL_PREDICT_FALSE(
-              !bucket_decompressors[bucket_index].VerifyEndAndClose())) {
-        return Fail(bucket_decompressors[bucket_index].status());
+              !bucket_readers[bucket_index]->VerifyEndAndClose())) {
+        return Fail(bucket_readers[bucket_index]->status());
       }
       ++bucket_index;
     }
@@ -830,9 +1028,8 @@ inline bool TransposeDecoder::ParseBuffers(Context& context,
   if (ABSL_PREDICT_FALSE(bucket_index + 1 < num_buckets)) {
     return Fail(absl::InvalidArgumentError("Too few buckets"));
   }
-  if (ABSL_PREDICT_FALSE(
-          !bucket_decompressors[bucket_index].VerifyEndAndClose())) {
-    return Fail(bucket_decompressors[bucket_index].status());
+  if (ABSL_PREDICT_FALSE(!bucket_readers[bucket_index]->VerifyEndAndClose())) {
+    return Fail(bucket_readers[bucket_index]->status());
   }
   return true;
 }
@@ -866,6 +1063,14 @@ inline bool TransposeDecoder::ParseBuffersForFiltering(
   first_buffer_indices.reserve(num_buckets);
   bucket_indices.reserve(num_buffers);
   context.buckets.reserve(num_buckets);
+  // With random access, buckets are read on demand, so that buckets which are
+  // not needed are not read from the source at all. Only uncompressed sizes
+  // of buckets are read now.
+  if (src.SupportsRandomAccess()) context.bucket_src = &src;
+  std::vector<uint64_t> uncompressed_bucket_sizes;
+  if (context.bucket_src != nullptr) {
+    uncompressed_bucket_sizes.reserve(num_buckets);
+  }
   for (uint32_t bucket_index = 0; bucket_index < num_buckets; ++bucket_index) {
     uint64_t bucket_length;
     if (ABSL_PREDICT_FALSE(!ReadVarint64(header_reader, bucket_length))) {
@@ -877,17 +1082,53 @@ inline bool TransposeDecoder::ParseBuffersForFiltering(
       return Fail(absl::ResourceExhaustedError("Bucket too large"));
     }
     context.buckets.emplace_back();
-    if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(bucket_length),
-                                     context.buckets.back().compressed_data))) {
+    DataBucket& bucket = context.buckets.back();
+    if (context.bucket_src != nullptr) {
+      bucket.pending_pos = src.pos();
+      bucket.compressed_size = IntCast<size_t>(bucket_length);
+      uint64_t uncompressed_size = bucket_length;
+      if (context.compression_type != CompressionType::kNone) {
+        if (ABSL_PREDICT_FALSE(!ReadVarint64(src, uncompressed_size))) {
+          return Fail(src.StatusOrAnnotate(
+              absl::InvalidArgumentError("Reading uncompressed size failed")));
+        }
+        if (ABSL_PREDICT_FALSE(src.pos() > *bucket.pending_pos +
+                                               bucket_length)) {
+          return Fail(
+              absl::InvalidArgumentError("Reading uncompressed size failed"));
+        }
+      }
+      uncompressed_bucket_sizes.push_back(uncompressed_size);
+      if (ABSL_PREDICT_FALSE(!src.Seek(*bucket.pending_pos + bucket_length))) {
+        return Fail(src.StatusOrAnnotate(
+            absl::InvalidArgumentError("Reading bucket failed")));
+      }
+    } else if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(bucket_length),
+                                            bucket.compressed_data))) {
       return Fail(src.StatusOrAnnotate(
           absl::InvalidArgumentError("Reading bucket failed")));
     }
   }
+  const auto uncompressed_bucket_size =
+      [&](uint32_t bucket_index) -> absl::optional<uint64_t> {
+    if (context.bucket_src != nullptr) {
+      return uncompressed_bucket_sizes[bucket_index];
+    }
+    return internal::UncompressedSize(
+        context.buckets[bucket_index].compressed_data,
+        context.compression_type);
+  };
 
+  if (ABSL_PREDICT_FALSE(!context.buffer_transforms.empty() &&
+                         context.buffer_transforms.back().first >=
+                             num_buffers)) {
+    return Fail(absl::InvalidArgumentError("Buffer index out of range"));
+  }
+  std::vector<std::pair<uint32_t, internal::BufferTransform>>::
+      const_iterator next_transform = context.buffer_transforms.cbegin();
   uint32_t bucket_index = 0;
   first_buffer_indices.push_back(0);
-  absl::optional<uint64_t> remaining_bucket_size = internal::UncompressedSize(
-      context.buckets[0].compressed_data, context.compression_type);
+  absl::optional<uint64_t> remaining_bucket_size = uncompressed_bucket_size(0);
   if (ABSL_PREDICT_FALSE(remaining_bucket_size == absl::nullopt)) {
     return Fail(absl::InvalidArgumentError("Reading uncompressed size failed"));
   }
@@ -903,6 +1144,16 @@ inline bool TransposeDecoder::ParseBuffersForFiltering(
     }
     context.buckets[bucket_index].buffer_sizes.push_back(
         IntCast<size_t>(buffer_length));
+    if (!context.buffer_transforms.empty()) {
+      internal::BufferTransform transform =
+          internal::BufferTransform::kNone;
+      if (next_transform != context.buffer_transforms.cend() &&
+          next_transform->first == buffer_index) {
+        transform = next_transform->second;
+        ++next_transform;
+      }
+      context.buckets[bucket_index].buffer_transforms.push_back(transform);
+    }
     if (ABSL_PREDICT_FALSE(buffer_length > *remaining_bucket_size)) {
       return Fail(absl::InvalidArgumentError("Buffer does not fit in bucket"));
     }
@@ -911,9 +1162,7 @@ inline bool TransposeDecoder::ParseBuffersForFiltering(
     while (*remaining_bucket_size == 0 && bucket_index + 1 < num_buckets) {
       ++bucket_index;
       first_buffer_indices.push_back(buffer_index + 1);
-      remaining_bucket_size = internal::UncompressedSize(
-          context.buckets[bucket_index].compressed_data,
-          context.compression_type);
+      remaining_bucket_size = uncompressed_bucket_size(bucket_index);
       if (ABSL_PREDICT_FALSE(remaining_bucket_size == absl::nullopt)) {
         return Fail(
             absl::InvalidArgumentError("Reading uncompressed size failed"));
@@ -939,38 +1188,76 @@ inline Reader* TransposeDecoder::GetBuffer(Context& context,
                                              ? bucket.buffer_sizes.size()
                                              : bucket.buffers.size())
       << "Index within bucket out of range";
-  while (index_within_bucket >= bucket.buffers.size()) {
-    if (bucket.buffers.empty()) {
-      // This is the first buffer to be decompressed from this bucket.
-      bucket.decompressor.Reset(std::forward_as_tuple(&bucket.compressed_data),
-                                context.compression_type);
-      if (ABSL_PREDICT_FALSE(!bucket.decompressor.healthy())) {
-        Fail(bucket.decompressor.status());
-        return nullptr;
-      }
-      // Important to prevent invalidating pointers by `emplace_back()`.
-      bucket.buffers.reserve(bucket.buffer_sizes.size());
-    }
-    Chain buffer;
-    if (ABSL_PREDICT_FALSE(!bucket.decompressor.reader().Read(
-            bucket.buffer_sizes[bucket.buffers.size()], buffer))) {
-      Fail(bucket.decompressor.reader().StatusOrAnnotate(
-          absl::InvalidArgumentError("Reading buffer failed")));
-      return nullptr;
+  if (ABSL_PREDICT_FALSE(!FetchBucket(context, bucket_index))) return nullptr;
+  const absl::Status status =
+      DecompressBuffers(context.compression_type, zstd_dictionary_, bucket,
+                        size_t{index_within_bucket} + 1);
+  if (ABSL_PREDICT_FALSE(!status.ok())) {
+    Fail(status);
+    return nullptr;
+  }
+  return &bucket.buffers[index_within_bucket];
+}
+
+inline bool TransposeDecoder::FetchBucket(Context& context,
+                                          uint32_t bucket_index) {
+  DataBucket& bucket = context.buckets[bucket_index];
+  if (bucket.pending_pos == absl::nullopt) return true;
+  Reader& src = *context.bucket_src;
+  const Position pos_before = src.pos();
+  if (ABSL_PREDICT_FALSE(!src.Seek(*bucket.pending_pos) ||
+                         !src.Read(bucket.compressed_size,
+                                   bucket.compressed_data) ||
+                         !src.Seek(pos_before))) {
+    return Fail(src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Reading bucket failed")));
+  }
+  bucket.pending_pos = absl::nullopt;
+  return true;
+}
+
+inline bool TransposeDecoder::PrefetchBuckets(Context& context) {
+  // A bucket is likely needed if it contains a buffer of a field whose number
+  // is included at some level of nesting. Buckets needed only for fields of
+  // fully included submessages are decompressed on demand.
+  absl::flat_hash_set<int> included_field_numbers;
+  for (const std::pair<const std::pair<uint32_t, int>, Context::IncludedField>&
+           include_field : context.include_fields) {
+    if (include_field.second.include_type !=
+        Context::IncludeType::kExistenceOnly) {
+      included_field_numbers.insert(include_field.first.second);
     }
-    bucket.buffers.emplace_back(std::move(buffer));
-    if (bucket.buffers.size() == bucket.buffer_sizes.size()) {
-      // This was the last decompressed buffer from this bucket.
-      if (ABSL_PREDICT_FALSE(!bucket.decompressor.VerifyEndAndClose())) {
-        Fail(bucket.decompressor.status());
-        return nullptr;
-      }
-      // Free memory of fields which are no longer needed.
-      bucket.compressed_data = Chain();
-      bucket.buffer_sizes = std::vector<size_t>();
+  }
+  std::vector<bool> prefetched(context.buckets.size(), false);
+  std::vector<uint32_t> bucket_indices;
+  for (const StateMachineNodeTemplate& node_template : context.node_templates) {
+    // Templates of nodes without a data buffer have `bucket_index` set to
+    // `kInvalidPos`, or field number 0 which is never included.
+    if (node_template.bucket_index == kInvalidPos ||
+        prefetched[node_template.bucket_index] ||
+        !included_field_numbers.contains(
+            GetTagFieldNumber(node_template.tag))) {
+      continue;
     }
+    prefetched[node_template.bucket_index] = true;
+    bucket_indices.push_back(node_template.bucket_index);
   }
-  return &bucket.buffers[index_within_bucket];
+  if (bucket_indices.size() <= 1) return true;
+
+  for (const uint32_t bucket_index : bucket_indices) {
+    if (ABSL_PREDICT_FALSE(!FetchBucket(context, bucket_index))) return false;
+  }
+  std::vector<absl::Status> statuses(bucket_indices.size());
+  internal::ParallelFor(*executor_, bucket_indices.size(), [&](size_t index) {
+    DataBucket& bucket = context.buckets[bucket_indices[index]];
+    statuses[index] =
+        DecompressBuffers(context.compression_type, zstd_dictionary_, bucket,
+                          bucket.buffer_sizes.size());
+  });
+  for (absl::Status& status : statuses) {
+    if (ABSL_PREDICT_FALSE(!status.ok())) return Fail(std::move(status));
+  }
+  return true;
 }
 
 inline bool TransposeDecoder::ContainsImplicitLoop(
@@ -1075,13 +1362,42 @@ inline bool TransposeDecoder::ContainsImplicitLoop(
     }                                                                          \
   } while (false)
 
+// With computed goto, each callback of `TransposeDecoder::Decode()` ends with
+// its own indirect jump to the next callback. Such jumps are predicted better
+// than the single indirect jump of a `switch`, because the next state of the
+// state machine is correlated with the current one.
+#if defined(__GNUC__) || defined(__clang__)
+#define RIEGELI_INTERNAL_TRANSPOSE_DECODER_COMPUTED_GOTO 1
+#else
+#define RIEGELI_INTERNAL_TRANSPOSE_DECODER_COMPUTED_GOTO 0
+#endif
+
+#if RIEGELI_INTERNAL_TRANSPOSE_DECODER_COMPUTED_GOTO
+// A `case` of the `switch` in `TransposeDecoder::Decode()`, also labeled for
+// computed goto.
+#define CALLBACK_CASE(callback_type)          \
+  case internal::CallbackType::callback_type: \
+  callback_##callback_type
+#else
+#define CALLBACK_CASE(callback_type) case internal::CallbackType::callback_type
+#endif
+
 inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
+                                     uint64_t first_record_index,
                                      BackwardWriter& dest,
                                      std::vector<size_t>& limits) {
   // For now positions reported by `dest` are pushed to `limits` directly.
   // Later `limits` will be reversed and complemented.
   limits.clear();
   limits.reserve(num_records);
+  // Records are reconstructed from the last one. After reconstructing
+  // `num_records_to_decode` records, the remaining ones can be skipped.
+  const size_t num_records_to_decode =
+      IntCast<size_t>(num_records - first_record_index);
+  if (num_records_to_decode == 0 && first_record_index > 0) {
+    limits.resize(IntCast<size_t>(num_records));
+    return true;
+  }
 
   // Set current node to the initial node.
   StateMachineNode* node = &context.state_machine_nodes[context.first_node];
@@ -1097,23 +1413,75 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
   // without reading transition byte.
   int num_iters = 0;
 
+#if RIEGELI_INTERNAL_TRANSPOSE_DECODER_COMPUTED_GOTO
+#define CALLBACKS_FOR_TAG_LEN(tag_length)            \
+  &&callback_kCopyTag_##tag_length,                  \
+      &&callback_kVarint_1_##tag_length,             \
+      &&callback_kVarint_2_##tag_length,             \
+      &&callback_kVarint_3_##tag_length,             \
+      &&callback_kVarint_4_##tag_length,             \
+      &&callback_kVarint_5_##tag_length,             \
+      &&callback_kVarint_6_##tag_length,             \
+      &&callback_kVarint_7_##tag_length,             \
+      &&callback_kVarint_8_##tag_length,             \
+      &&callback_kVarint_9_##tag_length,             \
+      &&callback_kVarint_10_##tag_length,            \
+      &&callback_kFixed32_##tag_length,              \
+      &&callback_kFixed64_##tag_length,              \
+      &&callback_kFixed32Existence_##tag_length,     \
+      &&callback_kFixed64Existence_##tag_length,     \
+      &&callback_kString_##tag_length,               \
+      &&callback_kStartProjectionGroup_##tag_length, \
+      &&callback_kEndProjectionGroup_##tag_length
+
+  // Targets of computed goto, indexed by `CallbackType` without `kImplicit`.
+  static const void* const kCallbacks[] = {
+      &&callback_kNoOp,
+      &&callback_kMessageStart,
+      &&callback_kSubmessageStart,
+      &&callback_kSubmessageEnd,
+      &&callback_kSelectCallback,
+      &&callback_kSkippedSubmessageStart,
+      &&callback_kSkippedSubmessageEnd,
+      &&callback_kNonProto,
+      &&callback_kFailure,
+      CALLBACKS_FOR_TAG_LEN(1),
+      CALLBACKS_FOR_TAG_LEN(2),
+      CALLBACKS_FOR_TAG_LEN(3),
+      CALLBACKS_FOR_TAG_LEN(4),
+      CALLBACKS_FOR_TAG_LEN(5),
+      &&callback_kCopyTag_6,
+      &&callback_kUnknown,
+  };
+#undef CALLBACKS_FOR_TAG_LEN
+  static_assert(sizeof(kCallbacks) / sizeof(kCallbacks[0]) ==
+                    static_cast<size_t>(internal::CallbackType::kUnknown) + 1,
+                "kCallbacks must cover all callback types");
+  // Jumps to the callback of `node`.
+#define NEXT_CALLBACK()                                                      \
+  goto* kCallbacks[static_cast<uint8_t>(node->callback_type) &               \
+                   ~static_cast<uint8_t>(internal::CallbackType::kImplicit)]
+#else
+#define NEXT_CALLBACK() continue
+#endif
+
   if (internal::IsImplicit(node->callback_type)) ++num_iters;
   for (;;) {
     switch (static_cast<internal::CallbackType>(
         static_cast<uint8_t>(node->callback_type) &
         ~static_cast<uint8_t>(internal::CallbackType::kImplicit))) {
-      case internal::CallbackType::kSelectCallback:
+      CALLBACK_CASE(kSelectCallback):
         if (ABSL_PREDICT_FALSE(!SetCallbackType(
                 context, skipped_submessage_level, submessage_stack, *node))) {
           return false;
         }
-        continue;
+        NEXT_CALLBACK();
 
-      case internal::CallbackType::kSkippedSubmessageEnd:
+      CALLBACK_CASE(kSkippedSubmessageEnd):
         ++skipped_submessage_level;
         goto do_transition;
 
-      case internal::CallbackType::kSkippedSubmessageStart:
+      CALLBACK_CASE(kSkippedSubmessageStart):
         if (ABSL_PREDICT_FALSE(skipped_submessage_level == 0)) {
           return Fail(
               absl::InvalidArgumentError("Skipped submessage stack underflow"));
@@ -1121,12 +1489,12 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
         --skipped_submessage_level;
         goto do_transition;
 
-      case internal::CallbackType::kSubmessageEnd:
+      CALLBACK_CASE(kSubmessageEnd):
         submessage_stack.push_back(
             {IntCast<size_t>(dest.pos()), node->tag_data});
         goto do_transition;
 
-      case internal::CallbackType::kSubmessageStart: {
+      CALLBACK_CASE(kSubmessageStart): {
         if (ABSL_PREDICT_FALSE(submessage_stack.empty())) {
           return Fail(absl::InvalidArgumentError("Submessage stack underflow"));
         }
@@ -1151,62 +1519,62 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
         goto do_transition;
 
 #define ACTIONS_FOR_TAG_LEN(tag_length)                                        \
-  case internal::CallbackType::kCopyTag_##tag_length:                          \
+  CALLBACK_CASE(kCopyTag_##tag_length):                                        \
     COPY_TAG_CALLBACK(tag_length);                                             \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_1_##tag_length:                         \
+  CALLBACK_CASE(kVarint_1_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 1);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_2_##tag_length:                         \
+  CALLBACK_CASE(kVarint_2_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 2);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_3_##tag_length:                         \
+  CALLBACK_CASE(kVarint_3_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 3);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_4_##tag_length:                         \
+  CALLBACK_CASE(kVarint_4_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 4);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_5_##tag_length:                         \
+  CALLBACK_CASE(kVarint_5_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 5);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_6_##tag_length:                         \
+  CALLBACK_CASE(kVarint_6_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 6);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_7_##tag_length:                         \
+  CALLBACK_CASE(kVarint_7_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 7);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_8_##tag_length:                         \
+  CALLBACK_CASE(kVarint_8_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 8);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_9_##tag_length:                         \
+  CALLBACK_CASE(kVarint_9_##tag_length):                                       \
     VARINT_CALLBACK(tag_length, 9);                                            \
     goto do_transition;                                                        \
-  case internal::CallbackType::kVarint_10_##tag_length:                        \
+  CALLBACK_CASE(kVarint_10_##tag_length):                                      \
     VARINT_CALLBACK(tag_length, 10);                                           \
     goto do_transition;                                                        \
-  case internal::CallbackType::kFixed32_##tag_length:                          \
+  CALLBACK_CASE(kFixed32_##tag_length):                                        \
     FIXED_CALLBACK(tag_length, 4);                                             \
     goto do_transition;                                                        \
-  case internal::CallbackType::kFixed64_##tag_length:                          \
+  CALLBACK_CASE(kFixed64_##tag_length):                                        \
     FIXED_CALLBACK(tag_length, 8);                                             \
     goto do_transition;                                                        \
-  case internal::CallbackType::kFixed32Existence_##tag_length:                 \
+  CALLBACK_CASE(kFixed32Existence_##tag_length):                               \
     FIXED_EXISTENCE_CALLBACK(tag_length, 4);                                   \
     goto do_transition;                                                        \
-  case internal::CallbackType::kFixed64Existence_##tag_length:                 \
+  CALLBACK_CASE(kFixed64Existence_##tag_length):                               \
     FIXED_EXISTENCE_CALLBACK(tag_length, 8);                                   \
     goto do_transition;                                                        \
-  case internal::CallbackType::kString_##tag_length:                           \
+  CALLBACK_CASE(kString_##tag_length):                                         \
     STRING_CALLBACK(tag_length);                                               \
     goto do_transition;                                                        \
-  case internal::CallbackType::kStartProjectionGroup_##tag_length:             \
+  CALLBACK_CASE(kStartProjectionGroup_##tag_length):                           \
     if (ABSL_PREDICT_FALSE(submessage_stack.empty())) {                        \
       return Fail(absl::InvalidArgumentError("Submessage stack underflow"));   \
     }                                                                          \
     submessage_stack.pop_back();                                               \
     COPY_TAG_CALLBACK(tag_length);                                             \
     goto do_transition;                                                        \
-  case internal::CallbackType::kEndProjectionGroup_##tag_length:               \
+  CALLBACK_CASE(kEndProjectionGroup_##tag_length):                             \
     submessage_stack.push_back({IntCast<size_t>(dest.pos()), node->tag_data}); \
     COPY_TAG_CALLBACK(tag_length);                                             \
     goto do_transition
@@ -1218,15 +1586,15 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
         ACTIONS_FOR_TAG_LEN(5);
 #undef ACTIONS_FOR_TAG_LEN
 
-      case internal::CallbackType::kCopyTag_6:
+      CALLBACK_CASE(kCopyTag_6):
         COPY_TAG_CALLBACK(6);
         goto do_transition;
 
-      case internal::CallbackType::kUnknown:
-      case internal::CallbackType::kFailure:
+      CALLBACK_CASE(kUnknown):
+      CALLBACK_CASE(kFailure):
         return Fail(absl::InvalidArgumentError("Invalid node index"));
 
-      case internal::CallbackType::kNonProto: {
+      CALLBACK_CASE(kNonProto): {
         uint32_t length;
         if (ABSL_PREDICT_FALSE(
                 !ReadVarint32(*context.nonproto_lengths, length))) {
@@ -1242,7 +1610,7 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
       }
         ABSL_FALLTHROUGH_INTENDED;
 
-      case internal::CallbackType::kMessageStart:
+      CALLBACK_CASE(kMessageStart):
         if (ABSL_PREDICT_FALSE(!submessage_stack.empty())) {
           return Fail(absl::InvalidArgumentError("Submessages still open"));
         }
@@ -1250,9 +1618,13 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
           return Fail(absl::InvalidArgumentError("Too many records"));
         }
         limits.push_back(IntCast<size_t>(dest.pos()));
+        if (ABSL_PREDICT_FALSE(limits.size() == num_records_to_decode) &&
+            first_record_index > 0) {
+          goto records_decoded;
+        }
         ABSL_FALLTHROUGH_INTENDED;
 
-      case internal::CallbackType::kNoOp:
+      CALLBACK_CASE(kNoOp):
       do_transition:
         node = node->next_node;
         if (num_iters == 0) {
@@ -1267,12 +1639,13 @@ inline bool TransposeDecoder::Decode(Context& context, uint64_t num_records,
         } else {
           if (!internal::IsImplicit(node->callback_type)) --num_iters;
         }
-        continue;
+        NEXT_CALLBACK();
 
       case internal::CallbackType::kImplicit:
         RIEGELI_ASSERT_UNREACHABLE() << "kImplicit is masked out";
     }
   }
+#undef NEXT_CALLBACK
 
 done:
   if (ABSL_PREDICT_FALSE(!context.transitions.VerifyEndAndClose())) {
@@ -1287,6 +1660,8 @@ done:
   if (ABSL_PREDICT_FALSE(limits.size() != num_records)) {
     return Fail(absl::InvalidArgumentError("Too few records"));
   }
+
+records_decoded:
   const size_t size = limits.empty() ? size_t{0} : limits.back();
   if (ABSL_PREDICT_FALSE(size != dest.pos())) {
     return Fail(absl::InvalidArgumentError("Unfinished message"));
@@ -1308,6 +1683,8 @@ done:
       ++first;
     }
   }
+  // Skipped records are represented as empty.
+  limits.insert(limits.begin(), IntCast<size_t>(first_record_index), 0);
   return true;
 }
 
@@ -18,14 +18,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utility>
 #include <vector>
 
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/field_projection.h"
 #include "riegeli/chunk_encoding/transpose_internal.h"
 #include "riegeli/varint/varint_writing.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -36,7 +39,18 @@ enum class CallbackType : uint8_t;
 class TransposeDecoder : public Object {
  public:
   // Creates a closed `TransposeDecoder`.
-  TransposeDecoder() noexcept : Object(kClosed) {}
+  //
+  // If `executor` is not `nullptr`, buckets are decompressed in parallel using
+  // tasks scheduled on `executor`. It must outlive the `TransposeDecoder`.
+  //
+  // `zstd_dictionary` is used for chunks compressed with
+  // `CompressionType::kZstdWithDictionary`.
+  explicit TransposeDecoder(
+      Executor* executor = nullptr,
+      ZstdDictionary zstd_dictionary = ZstdDictionary()) noexcept
+      : Object(kClosed),
+        executor_(executor),
+        zstd_dictionary_(std::move(zstd_dictionary)) {}
 
   TransposeDecoder(const TransposeDecoder&) = delete;
   TransposeDecoder& operator=(const TransposeDecoder&) = delete;
@@ -46,6 +60,15 @@ class TransposeDecoder : public Object {
   // Writes concatenated record values to `dest`. Sets `limits` to sorted
   // record end positions.
   //
+  // Records are reconstructed from the last one, so the state machine can stop
+  // early: records before `first_record_index` are not reconstructed and they
+  // are represented as empty.
+  //
+  // If `field_projection` does not include all fields and `src` supports
+  // random access, buckets are read from `src` only when they are needed, so
+  // a `src` which reads from a file on demand saves I/O for buckets which the
+  // projection skips.
+  //
   // Precondition: `dest.pos() == 0`
   //
   // Return values:
@@ -54,7 +77,15 @@ class TransposeDecoder : public Object {
   //              if `!dest.healthy()` then the problem was at `dest`
   bool Decode(uint64_t num_records, uint64_t decoded_data_size,
               const FieldProjection& field_projection, Reader& src,
-              BackwardWriter& dest, std::vector<size_t>& limits);
+              BackwardWriter& dest, std::vector<size_t>& limits,
+              uint64_t first_record_index = 0);
+
+  // Returns indices of buckets which were not decompressed by the last
+  // successful `Decode()`, because `field_projection` or the reconstructed
+  // records did not need them.
+  const std::vector<uint32_t>& skipped_buckets() const {
+    return skipped_buckets_;
+  }
 
  private:
   // Information about one proto tag.
@@ -119,6 +150,10 @@ class TransposeDecoder : public Object {
   bool Parse(Context& context, Reader& src,
              const FieldProjection& field_projection);
 
+  // Parse transforms of data buffers in `header_reader` into
+  // `context.buffer_transforms`.
+  bool ParseBufferTransforms(Context& context, Reader& header_reader);
+
   // Parse data buffers in `header_reader` and `src` into `context.buffers`.
   // This method is used when projection is disabled and all buffers are
   // initially decompressed.
@@ -133,14 +168,24 @@ class TransposeDecoder : public Object {
                                 std::vector<uint32_t>& first_buffer_indices,
                                 std::vector<uint32_t>& bucket_indices);
 
+  // Reads the given bucket from `context.bucket_src` if it was not read yet.
+  bool FetchBucket(Context& context, uint32_t bucket_index);
+
   // Precondition: `projection_enabled`.
   Reader* GetBuffer(Context& context, uint32_t bucket_index,
                     uint32_t index_within_bucket);
 
+  // Decompresses in parallel buckets which are likely needed for the field
+  // projection, so that `GetBuffer()` finds them ready.
+  //
+  // Precondition: `projection_enabled && executor_ != nullptr`.
+  bool PrefetchBuckets(Context& context);
+
   static bool ContainsImplicitLoop(
       std::vector<StateMachineNode>* state_machine_nodes);
 
-  bool Decode(Context& context, uint64_t num_records, BackwardWriter& dest,
+  bool Decode(Context& context, uint64_t num_records,
+              uint64_t first_record_index, BackwardWriter& dest,
               std::vector<size_t>& limits);
 
   // Set `callback_type` in `node` based on `skipped_submessage_level`,
@@ -149,6 +194,10 @@ class TransposeDecoder : public Object {
       Context& context, int skipped_submessage_level,
       const std::vector<SubmessageStackElement>& submessage_stack,
       StateMachineNode& node);
+
+  Executor* executor_;
+  ZstdDictionary zstd_dictionary_;
+  std::vector<uint32_t> skipped_buckets_;
 };
 
 }  // namespace riegeli
@@ -34,8 +34,12 @@
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/memory.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/chain_reader.h"
@@ -45,11 +49,15 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/string_reader.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/buffer_transform.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+#include "riegeli/chunk_encoding/column_type.h"
 #include "riegeli/chunk_encoding/compressor.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/transpose_internal.h"
+#include "riegeli/messages/message_serialize.h"
 #include "riegeli/messages/message_wire_format.h"
 #include "riegeli/varint/varint_reading.h"
 #include "riegeli/varint/varint_writing.h"
@@ -176,15 +184,44 @@ inline TransposeEncoder::EncodedTagInfo::EncodedTagInfo(
       public_list_noop_pos(kInvalidPos),
       base(kInvalidPos) {}
 
-inline TransposeEncoder::BufferWithMetadata::BufferWithMetadata(NodeId node_id)
-    : buffer(std::make_unique<Chain>()), node_id(node_id) {}
-
-TransposeEncoder::TransposeEncoder(CompressorOptions options,
-                                   uint64_t bucket_size)
+inline TransposeEncoder::BufferWithMetadata::BufferWithMetadata(
+    std::unique_ptr<Chain> buffer, NodeId node_id)
+    : buffer(std::move(buffer)), node_id(node_id) {}
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr uint32_t TransposeEncoder::kMaxTransition;
+constexpr uint32_t TransposeEncoder::kDefaultMinCountForState;
+#endif
+
+TransposeEncoder::TransposeEncoder(
+    CompressorOptions options, uint64_t bucket_size, Executor* executor,
+    std::vector<ColumnSpec> statistics_columns,
+    std::vector<ColumnSpec> bloom_filter_columns,
+    const google::protobuf::Descriptor* descriptor, bool delta_encoding,
+    bool dictionary_encoding, uint32_t max_transition,
+    absl::optional<uint32_t> min_count_for_state)
     : compressor_options_(std::move(options)),
       bucket_size_(options.compression_type() == CompressionType::kNone
                        ? std::numeric_limits<uint64_t>::max()
-                       : bucket_size) {}
+                       : bucket_size),
+      executor_(executor),
+      descriptor_(descriptor),
+      delta_encoding_(delta_encoding),
+      dictionary_encoding_(dictionary_encoding),
+      max_transition_(max_transition),
+      min_count_for_state_(min_count_for_state) {
+  RIEGELI_ASSERT_GT(max_transition_, 0u)
+      << "Failed precondition of TransposeEncoder: zero maximum transition";
+  RIEGELI_ASSERT_LE(max_transition_, kMaxTransition)
+      << "Failed precondition of TransposeEncoder: "
+         "maximum transition too large to encode";
+  if (!statistics_columns.empty() || !bloom_filter_columns.empty()) {
+    statistics_.emplace(statistics_columns, bloom_filter_columns);
+  }
+}
 
 TransposeEncoder::~TransposeEncoder() {}
 
@@ -192,11 +229,41 @@ void TransposeEncoder::Clear() {
   ChunkEncoder::Clear();
   tags_list_.clear();
   encoded_tags_.clear();
-  for (std::vector<BufferWithMetadata>& buffers : data_) buffers.clear();
+  // Writers and buffers are kept for the next chunk.
+  for (size_t i = 0; i < num_node_writers_; ++i) {
+    node_writers_[i]->Reset(kClosed);
+  }
+  num_node_writers_ = 0;
+  for (std::vector<BufferWithMetadata>& buffers : data_) {
+    for (BufferWithMetadata& buffer : buffers) {
+      buffer.buffer->Clear();
+      free_buffers_.push_back(std::move(buffer.buffer));
+    }
+    buffers.clear();
+  }
   group_stack_.clear();
   message_nodes_.clear();
+  direct_nodes_.clear();
   nonproto_lengths_writer_.Reset();
+  store_uncompressed_ = false;
   next_message_id_ = internal::MessageId::kRoot + 1;
+  if (statistics_ != absl::nullopt) statistics_->Clear();
+}
+
+bool TransposeEncoder::AddRecord(const google::protobuf::MessageLite& record,
+                                 SerializeOptions serialize_options) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  {
+    // Serialize to a flat buffer, which is then parsed without crossing
+    // fragment boundaries.
+    absl::Status status = SerializeToString(record, serialized_record_,
+                                            std::move(serialize_options));
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      return Fail(std::move(status));
+    }
+  }
+  StringReader<> reader(serialized_record_);
+  return AddRecordInternal(reader);
 }
 
 bool TransposeEncoder::AddRecord(absl::string_view record) {
@@ -258,6 +325,14 @@ inline bool TransposeEncoder::AddRecordInternal(Reader& record) {
   }
   ++num_records_;
   decoded_data_size_ += IntCast<uint64_t>(*size);
+  if (statistics_ != absl::nullopt) {
+    if (!record.Pull(IntCast<size_t>(*size))) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Pulling record failed: " << record.status();
+    }
+    statistics_->AddRecord(
+        absl::string_view(record.cursor(), IntCast<size_t>(*size)));
+  }
   const bool is_proto = IsProtoMessage(record);
   if (!record.Seek(pos_before)) {
     RIEGELI_ASSERT_UNREACHABLE()
@@ -267,8 +342,15 @@ inline bool TransposeEncoder::AddRecordInternal(Reader& record) {
     encoded_tags_.push_back(GetPosInTagsList(
         GetNode(NodeId(internal::MessageId::kStartOfMessage, 0)),
         internal::Subtype::kTrivial));
+    if (record.available() >= *size) {
+      // The record is contiguous in memory, which is the common case. Parse it
+      // without wrapping a `Reader` at each submessage level.
+      const absl::string_view message(record.cursor(), IntCast<size_t>(*size));
+      record.move_cursor(message.size());
+      return AddMessage(message, internal::MessageId::kRoot, descriptor_, 0);
+    }
     LimitingReader<> message(&record);
-    return AddMessage(message, internal::MessageId::kRoot, 0);
+    return AddMessage(message, internal::MessageId::kRoot, descriptor_, 0);
   } else {
     Node* node = GetNode(NodeId(internal::MessageId::kNonProto, 0));
     encoded_tags_.push_back(
@@ -287,14 +369,25 @@ inline bool TransposeEncoder::AddRecordInternal(Reader& record) {
 
 inline BackwardWriter* TransposeEncoder::GetBuffer(Node* node,
                                                    BufferType type) {
-  if (!node->second.writer) {
-    std::vector<BufferWithMetadata>& buffers =
-        data_[static_cast<uint32_t>(type)];
-    buffers.emplace_back(node->first);
-    node->second.writer =
-        std::make_unique<ChainBackwardWriter<>>(buffers.back().buffer.get());
-  }
-  return node->second.writer.get();
+  if (node->second.writer == nullptr) {
+    std::unique_ptr<Chain> buffer;
+    if (free_buffers_.empty()) {
+      buffer = std::make_unique<Chain>();
+    } else {
+      buffer = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+    }
+    Chain* const dest = buffer.get();
+    data_[static_cast<uint32_t>(type)].emplace_back(std::move(buffer),
+                                                    node->first);
+    if (num_node_writers_ == node_writers_.size()) {
+      node_writers_.push_back(std::make_unique<ChainBackwardWriter<>>(dest));
+    } else {
+      node_writers_[num_node_writers_]->Reset(dest);
+    }
+    node->second.writer = node_writers_[num_node_writers_++].get();
+  }
+  return node->second.writer;
 }
 
 inline uint32_t TransposeEncoder::GetPosInTagsList(Node* node,
@@ -313,6 +406,23 @@ inline uint32_t TransposeEncoder::GetPosInTagsList(Node* node,
 }
 
 inline TransposeEncoder::Node* TransposeEncoder::GetNode(NodeId node_id) {
+  if (ABSL_PREDICT_FALSE(node_id.tag >= kMaxDirectTag)) {
+    return GetNodeSlow(node_id);
+  }
+  const size_t parent_index = static_cast<size_t>(node_id.parent_message_id);
+  if (ABSL_PREDICT_FALSE(parent_index >= direct_nodes_.size())) {
+    direct_nodes_.resize(parent_index + 1);
+  }
+  std::vector<Node*>& children = direct_nodes_[parent_index];
+  if (ABSL_PREDICT_FALSE(node_id.tag >= children.size())) {
+    children.resize(size_t{node_id.tag} + 1, nullptr);
+  }
+  Node*& node = children[node_id.tag];
+  if (ABSL_PREDICT_FALSE(node == nullptr)) node = GetNodeSlow(node_id);
+  return node;
+}
+
+TransposeEncoder::Node* TransposeEncoder::GetNodeSlow(NodeId node_id) {
   auto it = message_nodes_.find(node_id);
   if (it == message_nodes_.end()) {
     it = message_nodes_.emplace(node_id, next_message_id_).first;
@@ -321,12 +431,24 @@ inline TransposeEncoder::Node* TransposeEncoder::GetNode(NodeId node_id) {
   return &*it;
 }
 
+inline const google::protobuf::FieldDescriptor* TransposeEncoder::GetField(
+    Node* node, const google::protobuf::Descriptor* parent_descriptor) {
+  if (!node->second.field_resolved) {
+    node->second.field_resolved = true;
+    if (parent_descriptor != nullptr) {
+      node->second.field = parent_descriptor->FindFieldByNumber(
+          GetTagFieldNumber(node->first.tag));
+    }
+  }
+  return node->second.field;
+}
+
 // Precondition: `IsProtoMessage` returns `true` for this record.
 // Note: Encoded tags are appended into `encoded_tags_` but data is prepended
 // into respective buffers. `encoded_tags_` will be later traversed backwards.
-inline bool TransposeEncoder::AddMessage(LimitingReaderBase& record,
-                                         internal::MessageId parent_message_id,
-                                         int depth) {
+inline bool TransposeEncoder::AddMessage(
+    LimitingReaderBase& record, internal::MessageId parent_message_id,
+    const google::protobuf::Descriptor* descriptor, int depth) {
   while (record.Pull()) {
     uint32_t tag;
     if (!ReadVarint32(record, tag)) {
@@ -388,9 +510,16 @@ inline bool TransposeEncoder::AddMessage(LimitingReaderBase& record,
         const Position value_pos = record.pos();
         ScopedLimiter limiter(&record,
                               ScopedLimiter::Options().set_max_length(length));
+        const google::protobuf::FieldDescriptor* const field =
+            GetField(node, descriptor);
         // Non-toplevel empty strings are treated as strings, not messages.
         // They have a simpler encoding this way (one node instead of two).
+        // Fields declared as neither submessages nor groups are treated as
+        // strings without trying to parse them.
         if (depth < kMaxRecursionDepth && length != 0 &&
+            (field == nullptr ||
+             field->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE ||
+             field->type() == google::protobuf::FieldDescriptor::TYPE_GROUP) &&
             IsProtoMessage(record)) {
           encoded_tags_.push_back(GetPosInTagsList(
               node, internal::Subtype::kLengthDelimitedStartOfSubmessage));
@@ -400,12 +529,12 @@ inline bool TransposeEncoder::AddMessage(LimitingReaderBase& record,
           }
           auto end_of_submessage_pos = GetPosInTagsList(
               node, internal::Subtype::kLengthDelimitedEndOfSubmessage);
-          if (ABSL_PREDICT_FALSE(
-                  !AddMessage(record, node->second.message_id, depth + 1))) {
+          if (ABSL_PREDICT_FALSE(!AddMessage(
+                  record, node->second.message_id,
+                  field == nullptr ? nullptr : field->message_type(),
+                  depth + 1))) {
             return false;
           }
-          // Call to `AddMessage()` invalidates `node`.
-          node = nullptr;
           encoded_tags_.push_back(end_of_submessage_pos);
         } else {
           encoded_tags_.push_back(GetPosInTagsList(
@@ -424,12 +553,16 @@ inline bool TransposeEncoder::AddMessage(LimitingReaderBase& record,
       case WireType::kStartGroup: {
         encoded_tags_.push_back(
             GetPosInTagsList(node, internal::Subtype::kTrivial));
-        group_stack_.push_back(parent_message_id);
+        group_stack_.push_back(OpenGroup{parent_message_id, descriptor});
         ++depth;
         parent_message_id = node->second.message_id;
+        const google::protobuf::FieldDescriptor* const field =
+            GetField(node, descriptor);
+        descriptor = field == nullptr ? nullptr : field->message_type();
       } break;
       case WireType::kEndGroup:
-        parent_message_id = group_stack_.back();
+        parent_message_id = group_stack_.back().parent_message_id;
+        descriptor = group_stack_.back().parent_descriptor;
         group_stack_.pop_back();
         --depth;
         // Note that `parent_message_id` was updated above so the `node` does
@@ -450,14 +583,177 @@ inline bool TransposeEncoder::AddMessage(LimitingReaderBase& record,
   return true;
 }
 
-inline bool TransposeEncoder::AddBuffer(
-    absl::optional<size_t> new_uncompressed_bucket_size, const Chain& buffer,
-    internal::Compressor& bucket_compressor, Writer& data_writer,
-    std::vector<size_t>& compressed_bucket_sizes,
-    std::vector<size_t>& buffer_sizes) {
-  buffer_sizes.push_back(buffer.size());
-  if (new_uncompressed_bucket_size != absl::nullopt) {
-    if (bucket_compressor.writer().pos() > 0) {
+// Precondition: `IsProtoMessage` returns `true` for this record.
+//
+// This mirrors `AddMessage(LimitingReaderBase&)`, which is the reference for
+// the encoding.
+bool TransposeEncoder::AddMessage(
+    absl::string_view record, internal::MessageId parent_message_id,
+    const google::protobuf::Descriptor* descriptor, int depth) {
+  const char* cursor = record.data();
+  const char* const limit = record.data() + record.size();
+  while (cursor < limit) {
+    uint32_t tag;
+    {
+      const absl::optional<const char*> next =
+          ReadVarint32(cursor, limit, tag);
+      if (next == absl::nullopt) RIEGELI_ASSERT_UNREACHABLE() << "Invalid tag";
+      cursor = *next;
+    }
+    Node* node = GetNode(NodeId(parent_message_id, tag));
+    switch (GetTagWireType(tag)) {
+      case WireType::kVarint: {
+        // Storing value as `uint64_t[2]` instead of `uint8_t[10]` lets Clang
+        // and GCC generate better code for clearing high bit of each byte.
+        uint64_t value[2];
+        static_assert(sizeof(value) >= kMaxLengthVarint64,
+                      "value too small to hold a varint64");
+        const absl::optional<size_t> value_length =
+            CopyVarint64(cursor, limit, reinterpret_cast<char*>(value));
+        if (value_length == absl::nullopt) {
+          RIEGELI_ASSERT_UNREACHABLE() << "Invalid varint";
+        }
+        cursor += *value_length;
+        if (reinterpret_cast<const unsigned char*>(value)[0] <=
+            kMaxVarintInline) {
+          encoded_tags_.push_back(GetPosInTagsList(
+              node, internal::Subtype::kVarintInline0 +
+                        reinterpret_cast<const unsigned char*>(value)[0]));
+        } else {
+          encoded_tags_.push_back(
+              GetPosInTagsList(node, internal::Subtype::kVarint1 +
+                                         IntCast<uint8_t>(*value_length - 1)));
+          // Clear high bit of each byte.
+          for (uint64_t& word : value) word &= ~uint64_t{0x8080808080808080};
+          BackwardWriter* const buffer = GetBuffer(node, BufferType::kVarint);
+          if (ABSL_PREDICT_FALSE(!buffer->Write(
+                  reinterpret_cast<const char*>(value), *value_length))) {
+            return Fail(buffer->status());
+          }
+        }
+      } break;
+      case WireType::kFixed32: {
+        encoded_tags_.push_back(
+            GetPosInTagsList(node, internal::Subtype::kTrivial));
+        BackwardWriter* const buffer = GetBuffer(node, BufferType::kFixed32);
+        if (ABSL_PREDICT_FALSE(!buffer->Write(cursor, sizeof(uint32_t)))) {
+          return Fail(buffer->status());
+        }
+        cursor += sizeof(uint32_t);
+      } break;
+      case WireType::kFixed64: {
+        encoded_tags_.push_back(
+            GetPosInTagsList(node, internal::Subtype::kTrivial));
+        BackwardWriter* const buffer = GetBuffer(node, BufferType::kFixed64);
+        if (ABSL_PREDICT_FALSE(!buffer->Write(cursor, sizeof(uint64_t)))) {
+          return Fail(buffer->status());
+        }
+        cursor += sizeof(uint64_t);
+      } break;
+      case WireType::kLengthDelimited: {
+        const char* const length_ptr = cursor;
+        uint32_t length;
+        {
+          const absl::optional<const char*> next =
+              ReadVarint32(cursor, limit, length);
+          if (next == absl::nullopt) {
+            RIEGELI_ASSERT_UNREACHABLE() << "Invalid length";
+          }
+          cursor = *next;
+        }
+        RIEGELI_ASSERT_LE(length, PtrDistance(cursor, limit))
+            << "Length-delimited field exceeds the message";
+        const absl::string_view value(cursor, length);
+        cursor += length;
+        const google::protobuf::FieldDescriptor* const field =
+            GetField(node, descriptor);
+        // Non-toplevel empty strings are treated as strings, not messages.
+        // They have a simpler encoding this way (one node instead of two).
+        // Fields declared as neither submessages nor groups are treated as
+        // strings without trying to parse them.
+        bool is_submessage = false;
+        if (depth < kMaxRecursionDepth && length != 0 &&
+            (field == nullptr ||
+             field->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE ||
+             field->type() == google::protobuf::FieldDescriptor::TYPE_GROUP)) {
+          StringReader<> value_reader(value);
+          is_submessage = IsProtoMessage(value_reader);
+        }
+        if (is_submessage) {
+          encoded_tags_.push_back(GetPosInTagsList(
+              node, internal::Subtype::kLengthDelimitedStartOfSubmessage));
+          auto end_of_submessage_pos = GetPosInTagsList(
+              node, internal::Subtype::kLengthDelimitedEndOfSubmessage);
+          if (ABSL_PREDICT_FALSE(!AddMessage(
+                  value, node->second.message_id,
+                  field == nullptr ? nullptr : field->message_type(),
+                  depth + 1))) {
+            return false;
+          }
+          encoded_tags_.push_back(end_of_submessage_pos);
+        } else {
+          encoded_tags_.push_back(GetPosInTagsList(
+              node, internal::Subtype::kLengthDelimitedString));
+          BackwardWriter* const buffer = GetBuffer(node, BufferType::kString);
+          if (ABSL_PREDICT_FALSE(!buffer->Write(absl::string_view(
+                  length_ptr, PtrDistance(length_ptr, cursor))))) {
+            return Fail(buffer->status());
+          }
+        }
+      } break;
+      case WireType::kStartGroup: {
+        encoded_tags_.push_back(
+            GetPosInTagsList(node, internal::Subtype::kTrivial));
+        group_stack_.push_back(OpenGroup{parent_message_id, descriptor});
+        ++depth;
+        parent_message_id = node->second.message_id;
+        const google::protobuf::FieldDescriptor* const field =
+            GetField(node, descriptor);
+        descriptor = field == nullptr ? nullptr : field->message_type();
+      } break;
+      case WireType::kEndGroup:
+        parent_message_id = group_stack_.back().parent_message_id;
+        descriptor = group_stack_.back().parent_descriptor;
+        group_stack_.pop_back();
+        --depth;
+        // See `AddMessage(LimitingReaderBase&)` about reusing `node`.
+        encoded_tags_.push_back(
+            GetPosInTagsList(node, internal::Subtype::kTrivial));
+        break;
+      default:
+        RIEGELI_ASSERT_UNREACHABLE()
+            << "Invalid wire type: "
+            << static_cast<uint32_t>(GetTagWireType(tag));
+    }
+  }
+  return true;
+}
+
+inline const CompressorOptions& TransposeEncoder::chunk_compressor_options()
+    const {
+  if (ABSL_PREDICT_FALSE(store_uncompressed_)) {
+    static const NoDestructor<CompressorOptions> kUncompressedOptions(
+        CompressorOptions().set_uncompressed());
+    return *kUncompressedOptions;
+  }
+  return compressor_options_;
+}
+
+inline bool TransposeEncoder::CompressBuckets(
+    const std::vector<Bucket>& buckets, Writer& data_writer,
+    std::vector<size_t>& compressed_bucket_sizes) {
+  compressed_bucket_sizes.reserve(buckets.size());
+  if (executor_ == nullptr || buckets.size() <= 1) {
+    internal::Compressor bucket_compressor(chunk_compressor_options());
+    for (const Bucket& bucket : buckets) {
+      bucket_compressor.Clear(
+          internal::Compressor::TuningOptions().set_pledged_size(
+              bucket.uncompressed_size));
+      for (const Chain* buffer : bucket.buffers) {
+        if (ABSL_PREDICT_FALSE(!bucket_compressor.writer().Write(*buffer))) {
+          return Fail(bucket_compressor.status());
+        }
+      }
       const Position pos_before = data_writer.pos();
       if (ABSL_PREDICT_FALSE(!bucket_compressor.EncodeAndClose(data_writer))) {
         return Fail(bucket_compressor.status());
@@ -467,16 +763,114 @@ inline bool TransposeEncoder::AddBuffer(
       compressed_bucket_sizes.push_back(
           IntCast<size_t>(data_writer.pos() - pos_before));
     }
-    bucket_compressor.Clear(
-        internal::Compressor::TuningOptions().set_pledged_size(
-            *new_uncompressed_bucket_size));
+    return true;
   }
-  if (ABSL_PREDICT_FALSE(!bucket_compressor.writer().Write(buffer))) {
-    return Fail(bucket_compressor.status());
+
+  // Buckets are compressed independently, so they can be compressed in
+  // parallel, each to its own `Chain`.
+  std::vector<Chain> compressed_buckets(buckets.size());
+  std::vector<absl::Status> statuses(buckets.size());
+  internal::ParallelFor(*executor_, buckets.size(), [&](size_t index) {
+    const Bucket& bucket = buckets[index];
+    internal::Compressor bucket_compressor(
+        chunk_compressor_options(),
+        internal::Compressor::TuningOptions().set_pledged_size(
+            bucket.uncompressed_size));
+    for (const Chain* buffer : bucket.buffers) {
+      if (ABSL_PREDICT_FALSE(!bucket_compressor.writer().Write(*buffer))) {
+        statuses[index] = bucket_compressor.status();
+        return;
+      }
+    }
+    ChainWriter<> compressed_writer(&compressed_buckets[index]);
+    if (ABSL_PREDICT_FALSE(
+            !bucket_compressor.EncodeAndClose(compressed_writer))) {
+      statuses[index] = bucket_compressor.status();
+      return;
+    }
+    if (ABSL_PREDICT_FALSE(!compressed_writer.Close())) {
+      RIEGELI_ASSERT_UNREACHABLE() << "A ChainWriter has no reason to fail: "
+                                   << compressed_writer.status();
+    }
+  });
+  for (size_t index = 0; index < buckets.size(); ++index) {
+    if (ABSL_PREDICT_FALSE(!statuses[index].ok())) {
+      return Fail(std::move(statuses[index]));
+    }
+    compressed_bucket_sizes.push_back(compressed_buckets[index].size());
+    if (ABSL_PREDICT_FALSE(
+            !data_writer.Write(std::move(compressed_buckets[index])))) {
+      return Fail(data_writer.status());
+    }
   }
   return true;
 }
 
+inline bool TransposeEncoder::TransformBuffers() {
+  bool transformed = false;
+  if (delta_encoding_ && TransformVarintBuffers()) transformed = true;
+  if (dictionary_encoding_ && TransformStringBuffers()) transformed = true;
+  return transformed;
+}
+
+inline bool TransposeEncoder::TransformVarintBuffers() {
+  std::vector<BufferWithMetadata>& buffers =
+      data_[static_cast<size_t>(BufferType::kVarint)];
+  if (buffers.empty()) return false;
+  absl::flat_hash_map<NodeId, size_t> buffer_indices;
+  buffer_indices.reserve(buffers.size());
+  for (size_t index = 0; index < buffers.size(); ++index) {
+    buffer_indices.emplace(buffers[index].node_id, index);
+  }
+  // Values are prepended to buffers, so `encoded_tags_` traversed backwards
+  // visits them in the order of buffer contents.
+  std::vector<std::vector<uint8_t>> value_lengths(buffers.size());
+  for (std::vector<uint32_t>::const_reverse_iterator iter =
+           encoded_tags_.crbegin();
+       iter != encoded_tags_.crend(); ++iter) {
+    const EncodedTagInfo& tag_info = tags_list_[*iter];
+    if (tag_info.node_id.parent_message_id < internal::MessageId::kRoot ||
+        GetTagWireType(tag_info.node_id.tag) != WireType::kVarint ||
+        tag_info.subtype >= internal::Subtype::kVarintInline0) {
+      continue;
+    }
+    const absl::flat_hash_map<NodeId, size_t>::const_iterator index_iter =
+        buffer_indices.find(tag_info.node_id);
+    RIEGELI_ASSERT(index_iter != buffer_indices.end())
+        << "Varint field has no buffer: "
+        << static_cast<uint32_t>(tag_info.node_id.parent_message_id) << "/"
+        << tag_info.node_id.tag;
+    value_lengths[index_iter->second].push_back(
+        IntCast<uint8_t>(tag_info.subtype - internal::Subtype::kVarint1 + 1));
+  }
+  bool transformed = false;
+  for (size_t index = 0; index < buffers.size(); ++index) {
+    Chain transformed_buffer;
+    buffers[index].transform = internal::TransformVarintBuffer(
+        *buffers[index].buffer, value_lengths[index], transformed_buffer);
+    if (buffers[index].transform != internal::BufferTransform::kNone) {
+      *buffers[index].buffer = std::move(transformed_buffer);
+      transformed = true;
+    }
+  }
+  return transformed;
+}
+
+inline bool TransposeEncoder::TransformStringBuffers() {
+  bool transformed = false;
+  for (BufferWithMetadata& buffer :
+       data_[static_cast<size_t>(BufferType::kString)]) {
+    Chain transformed_buffer;
+    buffer.transform =
+        internal::TransformStringBuffer(*buffer.buffer, transformed_buffer);
+    if (buffer.transform != internal::BufferTransform::kNone) {
+      *buffer.buffer = std::move(transformed_buffer);
+      transformed = true;
+    }
+  }
+  return transformed;
+}
+
 inline bool TransposeEncoder::WriteBuffers(
     Writer& header_writer, Writer& data_writer,
     absl::flat_hash_map<NodeId, uint32_t>* buffer_pos) {
@@ -499,11 +893,12 @@ inline bool TransposeEncoder::WriteBuffers(
   const Chain& nonproto_lengths = nonproto_lengths_writer_.dest();
   if (!nonproto_lengths.empty()) ++num_buffers;
 
-  std::vector<size_t> compressed_bucket_sizes;
+  std::vector<Bucket> buckets;
   std::vector<size_t> buffer_sizes;
   buffer_sizes.reserve(num_buffers);
+  std::vector<std::pair<uint32_t, internal::BufferTransform>>
+      buffer_transforms;
 
-  internal::Compressor bucket_compressor(compressor_options_);
   for (const std::vector<BufferWithMetadata>& buffers : data_) {
     // Split data into buckets.
     size_t remaining_buffers_size = 0;
@@ -535,22 +930,22 @@ inline bool TransposeEncoder::WriteBuffers(
 
     current_bucket_size = 0;
     for (const BufferWithMetadata& buffer : buffers) {
-      absl::optional<size_t> new_uncompressed_bucket_size;
       if (current_bucket_size == 0) {
         RIEGELI_ASSERT(!uncompressed_bucket_sizes.empty())
             << "Bucket sizes and buffer sizes do not match";
         current_bucket_size = uncompressed_bucket_sizes.back();
         uncompressed_bucket_sizes.pop_back();
-        new_uncompressed_bucket_size = current_bucket_size;
+        buckets.emplace_back(current_bucket_size);
       }
       RIEGELI_ASSERT_GE(current_bucket_size, buffer.buffer->size())
           << "Bucket sizes and buffer sizes do not match";
       current_bucket_size -= buffer.buffer->size();
-      if (ABSL_PREDICT_FALSE(!AddBuffer(
-              new_uncompressed_bucket_size, *buffer.buffer, bucket_compressor,
-              data_writer, compressed_bucket_sizes, buffer_sizes))) {
-        return false;
+      buckets.back().buffers.push_back(buffer.buffer.get());
+      if (buffer.transform != internal::BufferTransform::kNone) {
+        buffer_transforms.emplace_back(IntCast<uint32_t>(buffer_sizes.size()),
+                                       buffer.transform);
       }
+      buffer_sizes.push_back(buffer.buffer->size());
       const std::pair<absl::flat_hash_map<NodeId, uint32_t>::iterator, bool>
           insert_result = buffer_pos->emplace(
               buffer.node_id, IntCast<uint32_t>(buffer_pos->size()));
@@ -566,26 +961,33 @@ inline bool TransposeEncoder::WriteBuffers(
   }
   if (!nonproto_lengths.empty()) {
     // `nonproto_lengths` is the last buffer if non-empty.
-    if (ABSL_PREDICT_FALSE(!AddBuffer(nonproto_lengths.size(), nonproto_lengths,
-                                      bucket_compressor, data_writer,
-                                      compressed_bucket_sizes, buffer_sizes))) {
-      return false;
-    }
+    buckets.emplace_back(nonproto_lengths.size());
+    buckets.back().buffers.push_back(&nonproto_lengths);
+    buffer_sizes.push_back(nonproto_lengths.size());
     // Note: `nonproto_lengths` needs no `buffer_pos`.
   }
 
-  if (bucket_compressor.writer().pos() > 0) {
-    // Last bucket.
-    const Position pos_before = data_writer.pos();
-    if (ABSL_PREDICT_FALSE(!bucket_compressor.EncodeAndClose(data_writer))) {
-      return Fail(bucket_compressor.status());
-    }
-    RIEGELI_ASSERT_GE(data_writer.pos(), pos_before)
-        << "Data writer position decreased";
-    compressed_bucket_sizes.push_back(
-        IntCast<size_t>(data_writer.pos() - pos_before));
+  std::vector<size_t> compressed_bucket_sizes;
+  if (ABSL_PREDICT_FALSE(
+          !CompressBuckets(buckets, data_writer, compressed_bucket_sizes))) {
+    return false;
   }
 
+  if (!buffer_transforms.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteVarint32(
+            IntCast<uint32_t>(buffer_transforms.size()), header_writer))) {
+      return Fail(header_writer.status());
+    }
+    for (const std::pair<uint32_t, internal::BufferTransform>&
+             buffer_transform : buffer_transforms) {
+      if (ABSL_PREDICT_FALSE(
+              !WriteVarint32(buffer_transform.first, header_writer) ||
+              !header_writer.WriteByte(
+                  static_cast<uint8_t>(buffer_transform.second)))) {
+        return Fail(header_writer.status());
+      }
+    }
+  }
   if (ABSL_PREDICT_FALSE(!WriteVarint32(
           IntCast<uint32_t>(compressed_bucket_sizes.size()), header_writer)) ||
       ABSL_PREDICT_FALSE(!WriteVarint32(IntCast<uint32_t>(buffer_sizes.size()),
@@ -725,18 +1127,15 @@ inline bool TransposeEncoder::WriteStatesAndData(
       base_to_write.push_back(0);
     }
   }
-  for (const uint32_t value : base_to_write) {
-    if (ABSL_PREDICT_FALSE(!WriteVarint32(value, header_writer))) {
-      return Fail(header_writer.status());
-    }
+  if (ABSL_PREDICT_FALSE(!WriteVarints32(base_to_write, header_writer))) {
+    return Fail(header_writer.status());
   }
   if (ABSL_PREDICT_FALSE(!header_writer.Write(std::move(subtype_to_write)))) {
     return Fail(header_writer.status());
   }
-  for (const uint32_t value : buffer_index_to_write) {
-    if (ABSL_PREDICT_FALSE(!WriteVarint32(value, header_writer))) {
-      return Fail(header_writer.status());
-    }
+  if (ABSL_PREDICT_FALSE(
+          !WriteVarints32(buffer_index_to_write, header_writer))) {
+    return Fail(header_writer.status());
   }
 
   // Find the smallest index that has first tag.
@@ -752,7 +1151,7 @@ inline bool TransposeEncoder::WriteStatesAndData(
     return Fail(header_writer.status());
   }
 
-  internal::Compressor transitions_compressor(compressor_options_);
+  internal::Compressor transitions_compressor(chunk_compressor_options());
   if (ABSL_PREDICT_FALSE(!WriteTransitions(max_transition, state_machine,
                                            transitions_compressor.writer()))) {
     return false;
@@ -1057,9 +1456,39 @@ inline void TransposeEncoder::ComputeBaseIndices(
   }
 }
 
+inline uint32_t TransposeEncoder::AutoMinCountForState() const {
+  // Transitions not covered by private lists cost an additional `kNoOp`
+  // transition each, so leaving out up to 1/`kUncoveredFraction` of them makes
+  // the transition stream at most that much longer.
+  constexpr size_t kUncoveredFraction = 100;
+  std::vector<size_t> counts;
+  size_t total_transitions = 0;
+  for (const EncodedTagInfo& tag_info : tags_list_) {
+    for (const std::pair<const uint32_t, DestInfo>& dest_and_count :
+         tag_info.dest_info) {
+      counts.push_back(dest_and_count.second.num_transitions);
+      total_transitions += dest_and_count.second.num_transitions;
+    }
+  }
+  std::sort(counts.begin(), counts.end());
+  // Find the largest count such that transitions with smaller counts sum up
+  // to at most `total_transitions / kUncoveredFraction`.
+  const size_t max_uncovered = total_transitions / kUncoveredFraction;
+  size_t uncovered = 0;
+  size_t min_count = kDefaultMinCountForState;
+  for (const size_t count : counts) {
+    if (count > max_uncovered - uncovered) {
+      min_count = UnsignedMax(min_count, count);
+      break;
+    }
+    uncovered += count;
+  }
+  return SaturatingIntCast<uint32_t>(min_count);
+}
+
 inline std::vector<TransposeEncoder::StateInfo>
-TransposeEncoder::CreateStateMachine(uint32_t max_transition,
-                                     uint32_t min_count_for_state) {
+TransposeEncoder::CreateStateMachine(
+    uint32_t max_transition, absl::optional<uint32_t> min_count_for_state) {
   std::vector<StateInfo> state_machine;
   if (encoded_tags_.empty()) {
     state_machine.emplace_back(kInvalidPos, 0);
@@ -1067,6 +1496,9 @@ TransposeEncoder::CreateStateMachine(uint32_t max_transition,
   }
 
   CollectTransitionStatistics();
+  if (min_count_for_state == absl::nullopt) {
+    min_count_for_state = AutoMinCountForState();
+  }
 
   // Go through all the tag infos and update transitions that will be included
   // in the private list for the node.
@@ -1074,7 +1506,7 @@ TransposeEncoder::CreateStateMachine(uint32_t max_transition,
   for (EncodedTagInfo& tag_info : tags_list_) {
     for (std::pair<const uint32_t, DestInfo>& dest_and_count :
          tag_info.dest_info) {
-      if (dest_and_count.second.num_transitions >= min_count_for_state) {
+      if (dest_and_count.second.num_transitions >= *min_count_for_state) {
         // Subtract transitions so we have the right estimate of the remaining
         // transitions into each node.
         tags_list_[dest_and_count.first].num_incoming_transitions -=
@@ -1273,45 +1705,53 @@ TransposeEncoder::CreateStateMachine(uint32_t max_transition,
   return state_machine;
 }
 
-// Maximum transition number. Transitions are encoded as values in the range
-// [0..`kMaxTransition`].
-constexpr uint32_t kMaxTransition = 63;
-// Minimum number of transitions between nodes A and B for state for node B to
-// appear in the private state list for node A.
-constexpr uint32_t kMinCountForState = 10;
-
 bool TransposeEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
                                       uint64_t& num_records,
                                       uint64_t& decoded_data_size) {
   chunk_type = ChunkType::kTransposed;
-  return EncodeAndCloseInternal(kMaxTransition, kMinCountForState, dest,
+  if (statistics_ != absl::nullopt) statistics_->BuildBloomFilters();
+  return EncodeAndCloseInternal(max_transition_, min_count_for_state_, dest,
                                 num_records, decoded_data_size);
 }
 
-bool TransposeEncoder::EncodeAndCloseInternal(uint32_t max_transition,
-                                              uint32_t min_count_for_state,
-                                              Writer& dest,
-                                              uint64_t& num_records,
-                                              uint64_t& decoded_data_size) {
+bool TransposeEncoder::EncodeAndCloseInternal(
+    uint32_t max_transition, absl::optional<uint32_t> min_count_for_state,
+    Writer& dest, uint64_t& num_records, uint64_t& decoded_data_size) {
   RIEGELI_ASSERT_LE(max_transition, 63u)
       << "Failed precondition of TransposeEncoder::EncodeAndCloseInternal(): "
          "maximum transition too large to encode";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   num_records = num_records_;
   decoded_data_size = decoded_data_size_;
-  for (const std::pair<const NodeId, MessageNode>& entry : message_nodes_) {
-    if (entry.second.writer != nullptr) {
-      if (ABSL_PREDICT_FALSE(!entry.second.writer->Close())) {
-        return Fail(entry.second.writer->status());
-      }
+  for (size_t i = 0; i < num_node_writers_; ++i) {
+    if (ABSL_PREDICT_FALSE(!node_writers_[i]->Close())) {
+      return Fail(node_writers_[i]->status());
     }
   }
   if (ABSL_PREDICT_FALSE(!nonproto_lengths_writer_.Close())) {
     return Fail(nonproto_lengths_writer_.status());
   }
 
-  if (ABSL_PREDICT_FALSE(!dest.WriteByte(
-          static_cast<uint8_t>(compressor_options_.compression_type())))) {
+  const bool has_buffer_transforms = TransformBuffers();
+
+  if (compressor_options_.min_compression_gain() != absl::nullopt) {
+    Chain data;
+    for (const std::vector<BufferWithMetadata>& buffers : data_) {
+      for (const BufferWithMetadata& buffer : buffers) {
+        data.Append(*buffer.buffer);
+      }
+    }
+    data.Append(nonproto_lengths_writer_.dest());
+    store_uncompressed_ =
+        !internal::WorthCompressing(data, compressor_options_);
+  }
+
+  uint8_t compression_type_byte = static_cast<uint8_t>(
+      chunk_compressor_options().stored_compression_type());
+  if (has_buffer_transforms) {
+    compression_type_byte |= internal::kBufferTransformsFlag;
+  }
+  if (ABSL_PREDICT_FALSE(!dest.WriteByte(compression_type_byte))) {
     return Fail(dest.status());
   }
 
@@ -1332,7 +1772,7 @@ bool TransposeEncoder::EncodeAndCloseInternal(uint32_t max_transition,
   }
 
   internal::Compressor header_compressor(
-      compressor_options_,
+      chunk_compressor_options(),
       internal::Compressor::TuningOptions().set_pledged_size(
           header_writer.dest().size()));
   if (ABSL_PREDICT_FALSE(
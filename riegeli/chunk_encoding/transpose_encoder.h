@@ -19,20 +19,28 @@
 #include <stdint.h>
 
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message_lite.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/buffer_transform.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
+#include "riegeli/chunk_encoding/column_type.h"
 #include "riegeli/chunk_encoding/compressor.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
@@ -43,9 +51,15 @@ namespace riegeli {
 class LimitingReaderBase;
 
 // Format (values are varint encoded unless indicated otherwise):
-//  - Compression type
+//  - Compression type (byte), with `internal::kBufferTransformsFlag` if
+//    any data buffer is transformed
 //  - Header length (compressed length if applicable)
 //  - Header (possibly compressed):
+//    - If `internal::kBufferTransformsFlag` is set:
+//      - Number of transformed data buffers [`num_transforms`]
+//      - `num_transforms` pairs, sorted by buffer index:
+//        - Index of a data buffer
+//        - `internal::BufferTransform` (byte)
 //    - Number of separately compressed buckets that data buffers are split into
 //      [`num_buckets`]
 //    - Number of data buffers [`num_buffers`]
@@ -66,8 +80,55 @@ class LimitingReaderBase;
 //    - State machine transitions (bytes)
 class TransposeEncoder : public ChunkEncoder {
  public:
+  // Maximum transition number. Transitions are encoded as values in the range
+  // [0..`max_transition`]. A smaller `max_transition` needs more `kNoOp` states
+  // for nodes with many destinations.
+  static constexpr uint32_t kMaxTransition = 63;
+
+  // Default minimum number of transitions between nodes A and B for a state
+  // for node B to appear in the private state list for node A. Rarer
+  // transitions go through the public list, costing an additional transition
+  // each. A larger value makes the state machine smaller, which speeds up
+  // decoding of chunks with many rare fields, at the cost of a longer
+  // transition stream.
+  static constexpr uint32_t kDefaultMinCountForState = 10;
+
   // Creates an empty `TransposeEncoder`.
-  explicit TransposeEncoder(CompressorOptions options, uint64_t bucket_size);
+  //
+  // If `executor` is not `nullptr`, buckets are compressed in parallel using
+  // tasks scheduled on `executor`. It must outlive the `TransposeEncoder`.
+  //
+  // If `statistics_columns` or `bloom_filter_columns` is not empty,
+  // statistics of their values are computed, available as `statistics()`.
+  // Columns in `bloom_filter_columns` also have Bloom filters of their values.
+  //
+  // If `descriptor` is not `nullptr`, it is the expected type of records.
+  // Fields which it declares as neither submessages nor groups are encoded as
+  // strings without checking whether they could be parsed as submessages. The
+  // result is still correct for records of a different type, but might be
+  // compressed worse. It must outlive the `TransposeEncoder`.
+  //
+  // If `delta_encoding` is `true`, varint data buffers may be stored as
+  // differences of consecutive values, see `internal::BufferTransform`,
+  // for each buffer where this makes it smaller.
+  //
+  // If `dictionary_encoding` is `true`, string data buffers with few distinct
+  // values may be stored as a dictionary of values and their indices, for
+  // each buffer where this makes it smaller.
+  //
+  // `max_transition` and `min_count_for_state` tune the state machine, see
+  // `kMaxTransition` and `kDefaultMinCountForState`. If `min_count_for_state`
+  // is `absl::nullopt`, it is chosen for each chunk from its transition
+  // statistics.
+  explicit TransposeEncoder(
+      CompressorOptions options, uint64_t bucket_size,
+      Executor* executor = nullptr,
+      std::vector<ColumnSpec> statistics_columns = {},
+      std::vector<ColumnSpec> bloom_filter_columns = {},
+      const google::protobuf::Descriptor* descriptor = nullptr,
+      bool delta_encoding = false, bool dictionary_encoding = false,
+      uint32_t max_transition = kMaxTransition,
+      absl::optional<uint32_t> min_count_for_state = kDefaultMinCountForState);
 
   ~TransposeEncoder();
 
@@ -78,6 +139,8 @@ class TransposeEncoder : public ChunkEncoder {
   // string. Such records are internally stored separately -- these are not
   // broken down into columns.
   using ChunkEncoder::AddRecord;
+  bool AddRecord(const google::protobuf::MessageLite& record,
+                 SerializeOptions serialize_options) override;
   bool AddRecord(absl::string_view record) override;
   bool AddRecord(const Chain& record) override;
   bool AddRecord(const absl::Cord& record) override;
@@ -88,14 +151,18 @@ class TransposeEncoder : public ChunkEncoder {
                       uint64_t& num_records,
                       uint64_t& decoded_data_size) override;
 
+  const ChunkStatistics* statistics() const override {
+    return statistics_ == absl::nullopt ? nullptr : &*statistics_;
+  }
+
  private:
   bool AddRecordInternal(Reader& record);
 
   // Encode messages added with `AddRecord()` calls and write the result to
   // `dest`.
   bool EncodeAndCloseInternal(uint32_t max_transition,
-                              uint32_t min_count_for_state, Writer& dest,
-                              uint64_t& num_records,
+                              absl::optional<uint32_t> min_count_for_state,
+                              Writer& dest, uint64_t& num_records,
                               uint64_t& decoded_data_size);
 
   // Types of data buffers protocol buffer fields are split into.
@@ -123,13 +190,27 @@ class TransposeEncoder : public ChunkEncoder {
   struct MessageNode {
     explicit MessageNode(internal::MessageId message_id);
     // Some nodes (such as `kStartGroup`) contain no data. Buffer is assigned in
-    // the first `GetBuffer()` call when we have data to write.
-    std::unique_ptr<BackwardWriter> writer;
+    // the first `GetBuffer()` call when we have data to write. The writer is
+    // owned by `node_writers_`.
+    ChainBackwardWriter<>* writer = nullptr;
     // Unique ID for every instance of this class within `TransposeEncoder`.
     internal::MessageId message_id;
     // Position of encoded tag in `tags_list_` per subtype.
     // Size 14 works well with `kMaxVarintInline == 3`.
     absl::InlinedVector<uint32_t, 14> encoded_tag_pos;
+    // Whether `field` has been looked up in the descriptor of the parent.
+    bool field_resolved = false;
+    // Descriptor of the field, or `nullptr` if the parent has no descriptor or
+    // the field is not declared there.
+    const google::protobuf::FieldDescriptor* field = nullptr;
+  };
+
+  // A group which has been started but not ended yet.
+  struct OpenGroup {
+    // Message ID enclosing the group.
+    internal::MessageId parent_message_id;
+    // Descriptor of the message enclosing the group, or `nullptr` if unknown.
+    const google::protobuf::Descriptor* parent_descriptor;
   };
 
   // We build a tree structure of protocol buffer tags. `NodeId` uniquely
@@ -153,9 +234,25 @@ class TransposeEncoder : public ChunkEncoder {
   // Add message recursively to the internal data structures.
   // Precondition: `message` is a valid proto message, i.e. `IsProtoMessage()`
   // on this message returns `true`.
+  // `descriptor` is the descriptor of the message, or `nullptr` if unknown.
   // `depth` is the recursion depth.
   bool AddMessage(LimitingReaderBase& record,
-                  internal::MessageId parent_message_id, int depth);
+                  internal::MessageId parent_message_id,
+                  const google::protobuf::Descriptor* descriptor, int depth);
+
+  // Like `AddMessage(LimitingReaderBase&)`, for a message contiguous in memory.
+  // Submessages are parsed as subranges of `record` instead of through nested
+  // limits of a `Reader`.
+  bool AddMessage(absl::string_view record,
+                  internal::MessageId parent_message_id,
+                  const google::protobuf::Descriptor* descriptor, int depth);
+
+  // Transforms varint data buffers in `data_` if `delta_encoding_` is `true`,
+  // and string data buffers if `dictionary_encoding_` is `true`. Returns
+  // `true` if any buffer was transformed.
+  bool TransformBuffers();
+  bool TransformVarintBuffers();
+  bool TransformStringBuffers();
 
   // Write all buffer lengths to `header_writer` and data buffers in `data_` to
   // `data_writer` (compressed using `compressor_`). Fill map with the
@@ -180,14 +277,24 @@ class TransposeEncoder : public ChunkEncoder {
     uint32_t canonical_source;
   };
 
-  // Add `buffer` to `bucket_compressor.writer()`.
-  // If `new_uncompressed_bucket_size` is not `absl::nullopt`, flush the current
-  // bucket to `data_writer` first and create a new bucket of that size.
-  bool AddBuffer(absl::optional<size_t> new_uncompressed_bucket_size,
-                 const Chain& buffer, internal::Compressor& bucket_compressor,
-                 Writer& data_writer,
-                 std::vector<size_t>& compressed_bucket_sizes,
-                 std::vector<size_t>& buffer_sizes);
+  // Data buffers which are compressed together.
+  struct Bucket {
+    explicit Bucket(size_t uncompressed_size)
+        : uncompressed_size(uncompressed_size) {}
+
+    // Total size of `buffers`.
+    size_t uncompressed_size;
+    // Buffers in this bucket, in their order in the chunk.
+    std::vector<const Chain*> buffers;
+  };
+
+  // Compress each of `buckets` separately to `data_writer`, appending their
+  // compressed sizes to `compressed_bucket_sizes`.
+  // Returns compressor options for the chunk being encoded.
+  const CompressorOptions& chunk_compressor_options() const;
+
+  bool CompressBuckets(const std::vector<Bucket>& buckets, Writer& data_writer,
+                       std::vector<size_t>& compressed_bucket_sizes);
 
   // Compute base indices for states in `state_machine` that don't have one yet.
   // `public_list_base` is the index of the start of the public list.
@@ -202,9 +309,17 @@ class TransposeEncoder : public ChunkEncoder {
   // `dest_info` in `tags_list_` based on transition distribution.
   void CollectTransitionStatistics();
 
+  // Chooses `min_count_for_state` from transition statistics collected by
+  // `CollectTransitionStatistics()`: the largest count such that transitions
+  // which would get their own states cover almost all transitions, but at
+  // least `kDefaultMinCountForState`. This trims the long tail of states for
+  // rare fields, which make the header larger and decoding slower, while
+  // keeping the transition stream almost as short.
+  uint32_t AutoMinCountForState() const;
+
   // Create a state machine for `encoded_tags_`.
-  std::vector<StateInfo> CreateStateMachine(uint32_t max_transition,
-                                            uint32_t min_count_for_state);
+  std::vector<StateInfo> CreateStateMachine(
+      uint32_t max_transition, absl::optional<uint32_t> min_count_for_state);
 
   // Write state machine states into `header_writer` and all data buffers and
   // transitions into `data_writer` (compressed using `compressor_`).
@@ -219,10 +334,21 @@ class TransposeEncoder : public ChunkEncoder {
                         Writer& transitions_writer);
 
   // Value type of node in Nodes map.
-  using Node = absl::flat_hash_map<NodeId, MessageNode>::value_type;
+  using Node = absl::node_hash_map<NodeId, MessageNode>::value_type;
+
+  // Tags below this value are looked up in `direct_nodes_`. This covers field
+  // numbers below 64, which are common and cheaper to encode.
+  static constexpr uint32_t kMaxDirectTag = 64 << 3;
 
   // Returns node pointer from `node_id`.
   Node* GetNode(NodeId node_id);
+  // Returns node pointer from `node_id`, looking it up in `message_nodes_`.
+  Node* GetNodeSlow(NodeId node_id);
+
+  // Returns the descriptor of the field of `node`, looking it up in
+  // `parent_descriptor` on first use.
+  static const google::protobuf::FieldDescriptor* GetField(
+      Node* node, const google::protobuf::Descriptor* parent_descriptor);
 
   // Get possition of the (`node`, `subtype`) pair in `tags_list_`, adding it
   // if not in the list yet.
@@ -267,12 +393,15 @@ class TransposeEncoder : public ChunkEncoder {
 
   // Information about the data buffer.
   struct BufferWithMetadata {
-    explicit BufferWithMetadata(NodeId node_id);
+    explicit BufferWithMetadata(std::unique_ptr<Chain> buffer, NodeId node_id);
     // Buffer itself, wrapped in `std::unique_ptr` so that its address remains
     // constant when additional buffers are added.
     std::unique_ptr<Chain> buffer;
     // `NodeId` this buffer belongs to.
     NodeId node_id;
+    // How `buffer` is transformed.
+    internal::BufferTransform transform =
+        internal::BufferTransform::kNone;
   };
 
   CompressorOptions compressor_options_;
@@ -280,6 +409,18 @@ class TransposeEncoder : public ChunkEncoder {
   // Finer bucket granularity (i.e. smaller size) worsens compression density
   // but makes field projection more effective.
   uint64_t bucket_size_;
+  // If not `nullptr`, buckets are compressed in parallel.
+  Executor* executor_;
+  const google::protobuf::Descriptor* descriptor_;
+  bool delta_encoding_;
+  bool dictionary_encoding_;
+  uint32_t max_transition_;
+  absl::optional<uint32_t> min_count_for_state_;
+  // If not `absl::nullopt`, statistics of selected columns of records added.
+  absl::optional<ChunkStatistics> statistics_;
+  // If `true`, data of the chunk being encoded were found incompressible, so
+  // the chunk is stored uncompressed regardless of `compressor_options_`.
+  bool store_uncompressed_ = false;
 
   // List of all distinct Encoded tags.
   std::vector<EncodedTagInfo> tags_list_;
@@ -289,10 +430,26 @@ class TransposeEncoder : public ChunkEncoder {
   std::vector<BufferWithMetadata> data_[kNumBufferTypes];
   // Every group creates a new message ID. We keep track of open groups in this
   // vector.
-  std::vector<internal::MessageId> group_stack_;
-  // Tree of message nodes.
-  absl::flat_hash_map<NodeId, MessageNode> message_nodes_;
+  std::vector<OpenGroup> group_stack_;
+  // Writers of buffers of message nodes, kept across chunks to avoid
+  // allocating them again. The first `num_node_writers_` are assigned to nodes
+  // of the current chunk.
+  std::vector<std::unique_ptr<ChainBackwardWriter<>>> node_writers_;
+  size_t num_node_writers_ = 0;
+  // Empty buffers released by `Clear()`, to be reused by `GetBuffer()`. They
+  // keep their first block if possible.
+  std::vector<std::unique_ptr<Chain>> free_buffers_;
+  // Tree of message nodes. Pointers to nodes are stable.
+  absl::node_hash_map<NodeId, MessageNode> message_nodes_;
+  // Nodes from `message_nodes_` with tags below `kMaxDirectTag`, indexed by
+  // parent message ID and by tag, or `nullptr` if not looked up yet. Message
+  // IDs are assigned sequentially, and field numbers are usually small and
+  // dense, so this avoids hashing for most fields.
+  std::vector<std::vector<Node*>> direct_nodes_;
   ChainBackwardWriter<Chain> nonproto_lengths_writer_;
+  // Buffer for serializing a message added with `AddRecord()`, reused between
+  // records to avoid allocating it for each of them.
+  std::string serialized_record_;
   // Counter used to assign unique IDs to the message nodes.
   internal::MessageId next_message_id_ = internal::MessageId::kRoot + 1;
 };
@@ -49,6 +49,11 @@ static_assert(static_cast<uint32_t>(MessageId::kRoot) <= 8,
 RIEGELI_INTERNAL_INLINE_CONSTEXPR(WireType, kSubmessageWireType,
                                   static_cast<WireType>(6));
 
+// If set in the compression type byte of a transposed chunk, the header begins
+// with transforms of data buffers. Readers which do not support them
+// reject the chunk as having an unknown compression type.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint8_t, kBufferTransformsFlag, 0x80);
+
 enum class Subtype : uint8_t {
   kTrivial = 0,
 
@@ -0,0 +1,266 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/tuple_decoder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/limiting_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/decompressor.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/varint/varint_reading.h"
+
+namespace riegeli {
+
+namespace {
+
+// Sizes and decoded contents of a column.
+struct Column {
+  uint64_t compressed_lengths_size = 0;
+  uint64_t compressed_values_size = 0;
+  // Number of records which have the field.
+  uint64_t num_values = 0;
+  // Whether the column is selected by the field projection.
+  bool included = false;
+  // If `included`, field lengths and concatenated field values.
+  std::vector<size_t> lengths;
+  Chain values;
+};
+
+}  // namespace
+
+bool TupleDecoder::Decode(uint64_t num_records, uint64_t decoded_data_size,
+                          const FieldProjection& field_projection, Reader& src,
+                          Writer& dest, std::vector<size_t>& limits) {
+  RIEGELI_ASSERT_EQ(dest.pos(), 0u)
+      << "Failed precondition of TupleDecoder::Decode(): "
+         "non-zero destination position";
+  Object::Reset();
+  if (ABSL_PREDICT_FALSE(num_records > limits.max_size())) {
+    return Fail(absl::ResourceExhaustedError("Too many records"));
+  }
+  if (ABSL_PREDICT_FALSE(decoded_data_size >
+                         std::numeric_limits<size_t>::max())) {
+    return Fail(absl::ResourceExhaustedError("Records too large"));
+  }
+
+  uint8_t compression_type_byte;
+  if (ABSL_PREDICT_FALSE(!src.ReadByte(compression_type_byte))) {
+    return Fail(src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Reading compression type failed")));
+  }
+  const CompressionType compression_type =
+      static_cast<CompressionType>(compression_type_byte);
+
+  uint64_t header_size;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, header_size))) {
+    return Fail(src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Reading header size failed")));
+  }
+  internal::Decompressor<LimitingReader<>> header_decompressor(
+      std::forward_as_tuple(
+          &src, LimitingReaderBase::Options().set_exact_length(header_size)),
+      compression_type, zstd_dictionary_);
+  if (ABSL_PREDICT_FALSE(!header_decompressor.healthy())) {
+    return Fail(header_decompressor.status());
+  }
+  Reader& header_reader = header_decompressor.reader();
+  uint8_t separated;
+  if (ABSL_PREDICT_FALSE(!header_reader.ReadByte(separated))) {
+    return Fail(header_reader.StatusOrAnnotate(
+        absl::InvalidArgumentError("Reading separator flag failed")));
+  }
+  if (ABSL_PREDICT_FALSE(separated > 1)) {
+    return Fail(absl::InvalidArgumentError("Invalid separator flag"));
+  }
+  char separator = '\0';
+  if (separated == 1) {
+    if (ABSL_PREDICT_FALSE(!header_reader.ReadChar(separator))) {
+      return Fail(header_reader.StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading separator failed")));
+    }
+  }
+  uint32_t num_columns;
+  if (ABSL_PREDICT_FALSE(!ReadVarint32(header_reader, num_columns))) {
+    return Fail(header_reader.StatusOrAnnotate(
+        absl::InvalidArgumentError("Reading number of columns failed")));
+  }
+  // `num_columns` is not trusted yet, hence columns are added as their sizes
+  // are read.
+  std::vector<Column> columns;
+  while (columns.size() != num_columns) {
+    Column column;
+    if (ABSL_PREDICT_FALSE(
+            !ReadVarint64(header_reader, column.compressed_lengths_size) ||
+            !ReadVarint64(header_reader, column.compressed_values_size))) {
+      return Fail(header_reader.StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading column sizes failed")));
+    }
+    columns.push_back(std::move(column));
+  }
+  std::vector<uint32_t> num_fields;
+  // Numbers of records with the given number of fields.
+  std::vector<uint64_t> num_records_with_fields(columns.size() + 1);
+  while (num_fields.size() != num_records) {
+    uint32_t record_num_fields;
+    if (ABSL_PREDICT_FALSE(!ReadVarint32(header_reader, record_num_fields))) {
+      return Fail(header_reader.StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading number of fields failed")));
+    }
+    if (ABSL_PREDICT_FALSE(record_num_fields > columns.size())) {
+      return Fail(absl::InvalidArgumentError("Number of fields out of range"));
+    }
+    num_fields.push_back(record_num_fields);
+    ++num_records_with_fields[record_num_fields];
+  }
+  if (ABSL_PREDICT_FALSE(!header_decompressor.VerifyEndAndClose())) {
+    return Fail(header_decompressor.status());
+  }
+
+  uint64_t num_values = 0;
+  for (size_t index = columns.size(); index > 0; --index) {
+    num_values += num_records_with_fields[index];
+    columns[index - 1].num_values = num_values;
+  }
+  // Total size of decoded records, checked against `decoded_data_size` before
+  // writing them. Each record with fields has one separator less than fields.
+  uint64_t decoded_size = 0;
+  if (separated == 1) {
+    for (const Column& column : columns) decoded_size += column.num_values;
+    decoded_size -= num_records - num_records_with_fields[0];
+    if (ABSL_PREDICT_FALSE(decoded_size > decoded_data_size)) {
+      return Fail(absl::InvalidArgumentError(
+          "Decoded data size larger than expected"));
+    }
+  }
+  bool includes_all = false;
+  for (const Field& field : field_projection.fields()) {
+    if (field.path().empty()) {
+      includes_all = true;
+      break;
+    }
+    const int field_number = field.path()[0];
+    if (field_number > 0 && IntCast<size_t>(field_number) <= columns.size()) {
+      columns[IntCast<size_t>(field_number - 1)].included = true;
+    }
+  }
+
+  for (Column& column : columns) {
+    if (includes_all) column.included = true;
+    if (!column.included) {
+      if (ABSL_PREDICT_FALSE(
+              column.compressed_lengths_size >
+                  std::numeric_limits<Position>::max() -
+                      column.compressed_values_size ||
+              !src.Skip(column.compressed_lengths_size +
+                        column.compressed_values_size))) {
+        return Fail(src.StatusOrAnnotate(
+            absl::InvalidArgumentError("Skipping column failed")));
+      }
+      continue;
+    }
+    internal::Decompressor<LimitingReader<>> lengths_decompressor(
+        std::forward_as_tuple(&src,
+                              LimitingReaderBase::Options().set_exact_length(
+                                  column.compressed_lengths_size)),
+        compression_type, zstd_dictionary_);
+    if (ABSL_PREDICT_FALSE(!lengths_decompressor.healthy())) {
+      return Fail(lengths_decompressor.status());
+    }
+    // `column.num_values` is bounded by `num_records`, which is bounded by
+    // `limits.max_size()`.
+    column.lengths.reserve(IntCast<size_t>(column.num_values));
+    size_t values_size = 0;
+    while (column.lengths.size() != column.num_values) {
+      uint64_t length;
+      if (ABSL_PREDICT_FALSE(
+              !ReadVarint64(lengths_decompressor.reader(), length))) {
+        return Fail(lengths_decompressor.reader().StatusOrAnnotate(
+            absl::InvalidArgumentError("Reading field length failed")));
+      }
+      if (ABSL_PREDICT_FALSE(length > decoded_data_size - decoded_size)) {
+        return Fail(absl::InvalidArgumentError(
+            "Decoded data size larger than expected"));
+      }
+      decoded_size += length;
+      values_size += IntCast<size_t>(length);
+      column.lengths.push_back(IntCast<size_t>(length));
+    }
+    if (ABSL_PREDICT_FALSE(!lengths_decompressor.VerifyEndAndClose())) {
+      return Fail(lengths_decompressor.status());
+    }
+    internal::Decompressor<LimitingReader<>> values_decompressor(
+        std::forward_as_tuple(&src,
+                              LimitingReaderBase::Options().set_exact_length(
+                                  column.compressed_values_size)),
+        compression_type, zstd_dictionary_);
+    if (ABSL_PREDICT_FALSE(!values_decompressor.healthy())) {
+      return Fail(values_decompressor.status());
+    }
+    if (ABSL_PREDICT_FALSE(
+            !values_decompressor.reader().Read(values_size, column.values))) {
+      return Fail(values_decompressor.reader().StatusOrAnnotate(
+          absl::InvalidArgumentError("Reading field values failed")));
+    }
+    if (ABSL_PREDICT_FALSE(!values_decompressor.VerifyEndAndClose())) {
+      return Fail(values_decompressor.status());
+    }
+  }
+  if (includes_all && ABSL_PREDICT_FALSE(decoded_size != decoded_data_size)) {
+    return Fail(
+        absl::InvalidArgumentError("Decoded data size smaller than expected"));
+  }
+
+  std::vector<ChainReader<>> values_readers;
+  values_readers.reserve(columns.size());
+  for (const Column& column : columns) {
+    values_readers.emplace_back(&column.values);
+  }
+  std::vector<size_t> value_indices(columns.size());
+  limits.clear();
+  limits.reserve(IntCast<size_t>(num_records));
+  for (const uint32_t record_num_fields : num_fields) {
+    for (size_t index = 0; index < record_num_fields; ++index) {
+      if (index > 0 && separated == 1) {
+        if (ABSL_PREDICT_FALSE(!dest.WriteChar(separator))) {
+          return Fail(dest.status());
+        }
+      }
+      const Column& column = columns[index];
+      if (!column.included) continue;
+      const size_t length = column.lengths[value_indices[index]++];
+      if (ABSL_PREDICT_FALSE(!values_readers[index].Copy(length, dest))) {
+        return Fail(dest.status());
+      }
+    }
+    limits.push_back(IntCast<size_t>(dest.pos()));
+  }
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,70 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_TUPLE_DECODER_H_
+#define RIEGELI_CHUNK_ENCODING_TUPLE_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/zstd/zstd_dictionary.h"
+
+namespace riegeli {
+
+// Decodes a tuple chunk, in the format described by `TupleEncoder`.
+class TupleDecoder : public Object {
+ public:
+  // Creates a closed `TupleDecoder`.
+  //
+  // `zstd_dictionary` is used for chunks compressed with
+  // `CompressionType::kZstdWithDictionary`.
+  explicit TupleDecoder(
+      ZstdDictionary zstd_dictionary = ZstdDictionary()) noexcept
+      : Object(kClosed), zstd_dictionary_(std::move(zstd_dictionary)) {}
+
+  TupleDecoder(const TupleDecoder&) = delete;
+  TupleDecoder& operator=(const TupleDecoder&) = delete;
+
+  // Resets the `TupleDecoder` and parses the chunk.
+  //
+  // Writes concatenated record values to `dest`. Sets `limits` to sorted
+  // record end positions.
+  //
+  // Columns not selected by `field_projection` are not decompressed, and their
+  // fields are decoded as empty.
+  //
+  // Precondition: `dest.pos() == 0`
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`);
+  //              if `!dest.healthy()` then the problem was at `dest`
+  bool Decode(uint64_t num_records, uint64_t decoded_data_size,
+              const FieldProjection& field_projection, Reader& src,
+              Writer& dest, std::vector<size_t>& limits);
+
+ private:
+  ZstdDictionary zstd_dictionary_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_TUPLE_DECODER_H_
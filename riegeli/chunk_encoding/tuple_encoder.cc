@@ -0,0 +1,288 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/chunk_encoding/tuple_encoder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/compressor.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+TupleLayout TupleLayout::Separated(char separator) {
+  TupleLayout layout;
+  layout.separated_ = true;
+  layout.separator_ = separator;
+  return layout;
+}
+
+TupleLayout TupleLayout::FixedWidths(std::vector<size_t> widths) {
+  TupleLayout layout;
+  layout.widths_ = std::move(widths);
+  return layout;
+}
+
+TupleEncoder::TupleEncoder(CompressorOptions options, TupleLayout layout)
+    : compressor_options_(std::move(options)), layout_(std::move(layout)) {}
+
+void TupleEncoder::Clear() {
+  ChunkEncoder::Clear();
+  num_fields_writer_.Reset();
+  columns_.clear();
+}
+
+bool TupleEncoder::AddRecord(absl::string_view record) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(num_records_ == kMaxNumRecords)) {
+    return Fail(absl::ResourceExhaustedError("Too many records"));
+  }
+  if (ABSL_PREDICT_FALSE(record.size() > std::numeric_limits<uint64_t>::max() -
+                                             decoded_data_size_)) {
+    return Fail(absl::ResourceExhaustedError("Decoded data size too large"));
+  }
+  ++num_records_;
+  decoded_data_size_ += IntCast<uint64_t>(record.size());
+  return AddFields(record);
+}
+
+bool TupleEncoder::AddRecord(const Chain& record) {
+  const absl::optional<absl::string_view> flat = record.TryFlat();
+  if (flat != absl::nullopt) return AddRecord(*flat);
+  return AddRecord(absl::string_view(std::string(record)));
+}
+
+bool TupleEncoder::AddRecord(const absl::Cord& record) {
+  const absl::optional<absl::string_view> flat = record.TryFlat();
+  if (flat != absl::nullopt) return AddRecord(*flat);
+  return AddRecord(absl::string_view(std::string(record)));
+}
+
+bool TupleEncoder::AddRecords(Chain records, std::vector<size_t> limits) {
+  RIEGELI_ASSERT_EQ(limits.empty() ? size_t{0} : limits.back(), records.size())
+      << "Failed precondition of ChunkEncoder::AddRecords(): "
+         "record end positions do not match concatenated record values";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(limits.size() > kMaxNumRecords - num_records_)) {
+    return Fail(absl::ResourceExhaustedError("Too many records"));
+  }
+  if (ABSL_PREDICT_FALSE(records.size() > std::numeric_limits<uint64_t>::max() -
+                                              decoded_data_size_)) {
+    return Fail(absl::ResourceExhaustedError("Decoded data size too large"));
+  }
+  num_records_ += IntCast<uint64_t>(limits.size());
+  decoded_data_size_ += IntCast<uint64_t>(records.size());
+  ChainReader<> records_reader(&records);
+  size_t start = 0;
+  for (const size_t limit : limits) {
+    RIEGELI_ASSERT_GE(limit, start)
+        << "Failed precondition of ChunkEncoder::AddRecords(): "
+           "record end positions not sorted";
+    absl::string_view record;
+    if (!records_reader.Read(limit - start, record)) {
+      RIEGELI_ASSERT_UNREACHABLE() << "Failed reading record from records: "
+                                   << records_reader.status();
+    }
+    if (ABSL_PREDICT_FALSE(!AddFields(record))) return false;
+    start = limit;
+  }
+  return true;
+}
+
+inline bool TupleEncoder::AddFields(absl::string_view record) {
+  uint32_t num_fields = 0;
+  if (layout_.separated()) {
+    for (;;) {
+      const char* const separator = static_cast<const char*>(
+          memchr(record.data(), layout_.separator(), record.size()));
+      if (separator == nullptr) break;
+      const size_t length = PtrDistance(record.data(), separator);
+      if (ABSL_PREDICT_FALSE(!AddField(num_fields, record.substr(0, length)))) {
+        return false;
+      }
+      ++num_fields;
+      record.remove_prefix(length + 1);
+    }
+    if (ABSL_PREDICT_FALSE(!AddField(num_fields, record))) return false;
+    ++num_fields;
+  } else {
+    for (const size_t width : layout_.widths()) {
+      if (record.empty()) break;
+      const size_t length = UnsignedMin(width, record.size());
+      if (ABSL_PREDICT_FALSE(!AddField(num_fields, record.substr(0, length)))) {
+        return false;
+      }
+      ++num_fields;
+      record.remove_prefix(length);
+    }
+    if (!record.empty()) {
+      if (ABSL_PREDICT_FALSE(!AddField(num_fields, record))) return false;
+      ++num_fields;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!WriteVarint32(num_fields, num_fields_writer_))) {
+    return Fail(num_fields_writer_.status());
+  }
+  return true;
+}
+
+inline bool TupleEncoder::AddField(size_t index, absl::string_view field) {
+  if (ABSL_PREDICT_FALSE(index == std::numeric_limits<uint32_t>::max())) {
+    return Fail(absl::ResourceExhaustedError("Too many fields"));
+  }
+  if (index == columns_.size()) columns_.emplace_back();
+  Column& column = columns_[index];
+  if (ABSL_PREDICT_FALSE(!WriteVarint64(IntCast<uint64_t>(field.size()),
+                                        column.lengths_writer))) {
+    return Fail(column.lengths_writer.status());
+  }
+  if (ABSL_PREDICT_FALSE(!column.values_writer.Write(field))) {
+    return Fail(column.values_writer.status());
+  }
+  return true;
+}
+
+bool TupleEncoder::EncodeAndClose(Writer& dest, ChunkType& chunk_type,
+                                  uint64_t& num_records,
+                                  uint64_t& decoded_data_size) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  chunk_type = ChunkType::kTuples;
+  num_records = num_records_;
+  decoded_data_size = decoded_data_size_;
+
+  if (ABSL_PREDICT_FALSE(!num_fields_writer_.Close())) {
+    return Fail(num_fields_writer_.status());
+  }
+  for (Column& column : columns_) {
+    if (ABSL_PREDICT_FALSE(!column.lengths_writer.Close())) {
+      return Fail(column.lengths_writer.status());
+    }
+    if (ABSL_PREDICT_FALSE(!column.values_writer.Close())) {
+      return Fail(column.values_writer.status());
+    }
+  }
+
+  CompressorOptions chunk_options = compressor_options_;
+  if (compressor_options_.min_compression_gain() != absl::nullopt) {
+    Chain data;
+    for (const Column& column : columns_) {
+      data.Append(column.values_writer.dest());
+    }
+    if (!internal::WorthCompressing(data, compressor_options_)) {
+      chunk_options = CompressorOptions().set_uncompressed();
+    }
+  }
+
+  if (ABSL_PREDICT_FALSE(!dest.WriteByte(
+          static_cast<uint8_t>(chunk_options.stored_compression_type())))) {
+    return Fail(dest.status());
+  }
+
+  ChainWriter<Chain> header_writer;
+  if (ABSL_PREDICT_FALSE(!header_writer.WriteByte(
+          static_cast<uint8_t>(layout_.separated() ? 1 : 0)))) {
+    return Fail(header_writer.status());
+  }
+  if (layout_.separated()) {
+    if (ABSL_PREDICT_FALSE(!header_writer.WriteChar(layout_.separator()))) {
+      return Fail(header_writer.status());
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!WriteVarint32(IntCast<uint32_t>(columns_.size()),
+                                        header_writer))) {
+    return Fail(header_writer.status());
+  }
+  Chain data;
+  for (Column& column : columns_) {
+    const Position data_size_before = data.size();
+    if (ABSL_PREDICT_FALSE(!Compress(std::move(column.lengths_writer.dest()),
+                                     chunk_options, data))) {
+      return false;
+    }
+    const Position lengths_size = data.size() - data_size_before;
+    if (ABSL_PREDICT_FALSE(!Compress(std::move(column.values_writer.dest()),
+                                     chunk_options, data))) {
+      return false;
+    }
+    const Position values_size =
+        data.size() - data_size_before - lengths_size;
+    if (ABSL_PREDICT_FALSE(!WriteVarint64(lengths_size, header_writer) ||
+                           !WriteVarint64(values_size, header_writer))) {
+      return Fail(header_writer.status());
+    }
+  }
+  if (ABSL_PREDICT_FALSE(
+          !header_writer.Write(std::move(num_fields_writer_.dest())))) {
+    return Fail(header_writer.status());
+  }
+  if (ABSL_PREDICT_FALSE(!header_writer.Close())) {
+    return Fail(header_writer.status());
+  }
+
+  internal::Compressor header_compressor(
+      chunk_options, internal::Compressor::TuningOptions().set_pledged_size(
+                         header_writer.dest().size()));
+  if (ABSL_PREDICT_FALSE(
+          !header_compressor.writer().Write(std::move(header_writer.dest())))) {
+    return Fail(header_compressor.writer().status());
+  }
+  if (ABSL_PREDICT_FALSE(
+          !header_compressor.LengthPrefixedEncodeAndClose(dest))) {
+    return Fail(header_compressor.status());
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Write(std::move(data)))) {
+    return Fail(dest.status());
+  }
+  return Close();
+}
+
+inline bool TupleEncoder::Compress(Chain&& src,
+                                   const CompressorOptions& compressor_options,
+                                   Chain& dest) {
+  internal::Compressor compressor(
+      compressor_options,
+      internal::Compressor::TuningOptions().set_pledged_size(src.size()));
+  if (ABSL_PREDICT_FALSE(!compressor.writer().Write(std::move(src)))) {
+    return Fail(compressor.writer().status());
+  }
+  ChainWriter<> dest_writer(&dest, ChainWriterBase::Options().set_append(true));
+  if (ABSL_PREDICT_FALSE(!compressor.EncodeAndClose(dest_writer))) {
+    return Fail(compressor.status());
+  }
+  if (ABSL_PREDICT_FALSE(!dest_writer.Close())) {
+    return Fail(dest_writer.status());
+  }
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,132 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CHUNK_ENCODING_TUPLE_ENCODER_H_
+#define RIEGELI_CHUNK_ENCODING_TUPLE_ENCODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+
+namespace riegeli {
+
+// Specifies how records of a tuple chunk are split into fields.
+class TupleLayout {
+ public:
+  // Fields are separated by `separator`, e.g. ',' for CSV lines without
+  // quoting. A record always has at least one field.
+  static TupleLayout Separated(char separator);
+
+  // Fields have the given widths, e.g. members of a fixed layout struct. If a
+  // record is shorter than the sum of widths, its last field is shorter and
+  // the following fields are absent. If it is longer, the remaining bytes form
+  // one more field.
+  static TupleLayout FixedWidths(std::vector<size_t> widths);
+
+  // Returns `true` if fields are separated by `separator()`, or `false` if
+  // they have `widths()`.
+  bool separated() const { return separated_; }
+  char separator() const { return separator_; }
+  const std::vector<size_t>& widths() const { return widths_; }
+
+ private:
+  TupleLayout() noexcept {}
+
+  bool separated_ = false;
+  char separator_ = '\0';
+  std::vector<size_t> widths_;
+};
+
+// Format:
+//  - Compression type
+//  - Header size (compressed size if applicable)
+//  - Header (possibly compressed):
+//    - Separator flag (byte): 1 if fields are separated, 0 if they are
+//      concatenated
+//    - Separator (byte), present if the separator flag is 1
+//    - Number of columns (varint32)
+//    - For each column:
+//      - Size of field lengths (compressed size if applicable, varint64)
+//      - Size of field values (compressed size if applicable, varint64)
+//    - Array of `num_records` varint32s: numbers of fields of records
+//  - For each column:
+//    - Field lengths (possibly compressed): array of varint64s, one for each
+//      record which has the field
+//    - Field values (possibly compressed): concatenated field data
+//
+// Column `i` holds the field `i` of each record which has more than `i`
+// fields. A record is the concatenation of its fields, with the separator
+// between them if fields are separated.
+//
+// If compression is used, a compressed block is prefixed by its varint-encoded
+// uncompressed size.
+//
+// Field numbers of a `FieldProjection` select columns: field number `i + 1`
+// corresponds to column `i`. When decoding with a projection, excluded fields
+// are decoded as empty, keeping separators.
+class TupleEncoder : public ChunkEncoder {
+ public:
+  // Creates an empty `TupleEncoder`.
+  explicit TupleEncoder(CompressorOptions options, TupleLayout layout);
+
+  void Clear() override;
+
+  using ChunkEncoder::AddRecord;
+  bool AddRecord(absl::string_view record) override;
+  bool AddRecord(const Chain& record) override;
+  bool AddRecord(const absl::Cord& record) override;
+
+  bool AddRecords(Chain records, std::vector<size_t> limits) override;
+
+  bool EncodeAndClose(Writer& dest, ChunkType& chunk_type,
+                      uint64_t& num_records,
+                      uint64_t& decoded_data_size) override;
+
+ private:
+  // Field lengths and values of a column, collected uncompressed.
+  struct Column {
+    ChainWriter<Chain> lengths_writer;
+    ChainWriter<Chain> values_writer;
+  };
+
+  // Splits `record` into fields and appends them to columns. Does not update
+  // `num_records_` and `decoded_data_size_`.
+  bool AddFields(absl::string_view record);
+  bool AddField(size_t index, absl::string_view field);
+
+  // Compresses `src` with `compressor_options`, appending the result to
+  // `dest`.
+  bool Compress(Chain&& src, const CompressorOptions& compressor_options,
+                Chain& dest);
+
+  CompressorOptions compressor_options_;
+  TupleLayout layout_;
+  ChainWriter<Chain> num_fields_writer_;
+  std::vector<Column> columns_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CHUNK_ENCODING_TUPLE_ENCODER_H_
@@ -0,0 +1,123 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/csv/csv_columns.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <system_error>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/charconv.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+absl::string_view CsvColumnTypeName(CsvColumnType type) {
+  switch (type) {
+    case CsvColumnType::kSkipped:
+      return "skipped";
+    case CsvColumnType::kString:
+      return "string";
+    case CsvColumnType::kInt64:
+      return "int64";
+    case CsvColumnType::kDouble:
+      return "double";
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown CSV column type: " << static_cast<int>(type);
+}
+
+void CsvColumns::Clear() {
+  for (Column& column : columns_) {
+    column.string_values.clear();
+    column.int64_values.clear();
+    column.double_values.clear();
+  }
+  num_records_ = 0;
+}
+
+void CsvColumns::CancelRecord() {
+  for (Column& column : columns_) {
+    if (column.string_values.size() > num_records_) {
+      column.string_values.resize(num_records_);
+    }
+    if (column.int64_values.size() > num_records_) {
+      column.int64_values.resize(num_records_);
+    }
+    if (column.double_values.size() > num_records_) {
+      column.double_values.resize(num_records_);
+    }
+  }
+}
+
+namespace internal {
+
+bool ParseCsvInt64(absl::string_view text, int64_t& value) {
+  const char* ptr = text.data();
+  const char* const limit = ptr + text.size();
+  bool negative = false;
+  if (ptr != limit && (*ptr == '-' || *ptr == '+')) {
+    negative = *ptr == '-';
+    ++ptr;
+  }
+  if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+  uint64_t magnitude = 0;
+  // Up to 19 digits cannot overflow `uint64_t`, so they are accumulated
+  // without checking for overflow, which covers all values except those with
+  // leading zeros.
+  const char* const fast_limit =
+      ptr + UnsignedMin(PtrDistance(ptr, limit), size_t{19});
+  do {
+    const uint64_t digit = static_cast<unsigned char>(*ptr) - '0';
+    if (ABSL_PREDICT_FALSE(digit > 9)) return false;
+    magnitude = magnitude * 10 + digit;
+    ++ptr;
+  } while (ptr != fast_limit);
+  for (; ptr != limit; ++ptr) {
+    const uint64_t digit = static_cast<unsigned char>(*ptr) - '0';
+    if (ABSL_PREDICT_FALSE(digit > 9)) return false;
+    if (ABSL_PREDICT_FALSE(magnitude >
+                           (std::numeric_limits<uint64_t>::max() - digit) /
+                               10)) {
+      return false;
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  const uint64_t max_magnitude =
+      uint64_t{std::numeric_limits<int64_t>::max()} + (negative ? 1 : 0);
+  if (ABSL_PREDICT_FALSE(magnitude > max_magnitude)) return false;
+  value = negative ? -static_cast<int64_t>(magnitude - 1) - 1
+                   : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+bool ParseCsvDouble(absl::string_view text, double& value) {
+  const char* ptr = text.data();
+  const char* const limit = ptr + text.size();
+  // `absl::from_chars()` accepts '-' but not '+'.
+  if (ptr != limit && *ptr == '+') {
+    ++ptr;
+    if (ABSL_PREDICT_FALSE(ptr != limit && *ptr == '-')) return false;
+  }
+  const absl::from_chars_result result = absl::from_chars(ptr, limit, value);
+  return ABSL_PREDICT_TRUE(result.ec == std::errc() && result.ptr == limit);
+}
+
+}  // namespace internal
+
+}  // namespace riegeli
@@ -0,0 +1,217 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_CSV_COLUMNS_H_
+#define RIEGELI_CSV_CSV_COLUMNS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// The type of values of a column read by `CsvReaderBase::ReadColumns()`.
+enum class CsvColumnType : uint8_t {
+  // The field is ignored.
+  kSkipped,
+  // The field is kept as `std::string`.
+  kString,
+  // The field is parsed as a decimal `int64_t`, with an optional sign.
+  kInt64,
+  // The field is parsed as a `double`, in the format of `strtod()` in the C
+  // locale, with an optional sign, and without surrounding whitespace.
+  kDouble,
+};
+
+// Returns the name of `type`, e.g. "int64".
+absl::string_view CsvColumnTypeName(CsvColumnType type);
+
+// Values of consecutive records of a CSV file, stored by column as vectors of
+// the column type, as read by `CsvReaderBase::ReadColumns()`.
+//
+// Fields are converted straight from the buffer of the source when possible,
+// without materializing them as strings first.
+class CsvColumns {
+ public:
+  // Creates `CsvColumns` with no columns.
+  CsvColumns() noexcept {}
+
+  // Creates empty `CsvColumns` with the given column types. A record must
+  // have `types.size()` fields.
+  explicit CsvColumns(std::vector<CsvColumnType> types);
+  /*implicit*/ CsvColumns(std::initializer_list<CsvColumnType> types)
+      : CsvColumns(std::vector<CsvColumnType>(types)) {}
+
+  CsvColumns(const CsvColumns& that) = default;
+  CsvColumns& operator=(const CsvColumns& that) = default;
+
+  CsvColumns(CsvColumns&& that) noexcept;
+  CsvColumns& operator=(CsvColumns&& that) noexcept;
+
+  // Removes all values, keeping column types. Their memory is kept for reuse.
+  void Clear();
+
+  // Makes `*this` equivalent to newly constructed `CsvColumns`.
+  void Reset(std::vector<CsvColumnType> types);
+
+  // Returns column types.
+  const std::vector<CsvColumnType>& types() const { return types_; }
+
+  // Returns the number of columns, i.e. the number of fields of a record.
+  size_t num_columns() const { return types_.size(); }
+
+  // Returns the number of records read so far.
+  size_t num_records() const { return num_records_; }
+
+  // Returns values of column `index` read so far.
+  //
+  // Preconditions:
+  //   `index < num_columns()`
+  //   `types()[index]` is the corresponding type
+  const std::vector<std::string>& string_values(size_t index) const;
+  const std::vector<int64_t>& int64_values(size_t index) const;
+  const std::vector<double>& double_values(size_t index) const;
+
+ private:
+  friend class CsvReaderBase;
+
+  struct Column {
+    std::vector<std::string> string_values;
+    std::vector<int64_t> int64_values;
+    std::vector<double> double_values;
+  };
+
+  // Appends `field` as a value of column `index`.
+  //
+  // Returns `false` if `field` is not a valid value of the column type.
+  bool AppendField(size_t index, absl::string_view field);
+
+  // Finishes a record whose fields were appended.
+  void FinishRecord() { ++num_records_; }
+
+  // Removes fields appended after the last `FinishRecord()`.
+  void CancelRecord();
+
+  std::vector<CsvColumnType> types_;
+  std::vector<Column> columns_;
+  size_t num_records_ = 0;
+};
+
+namespace internal {
+
+// Parses `text` like `CsvColumnType::kInt64` and `CsvColumnType::kDouble`.
+//
+// Returns `false` if `text` is invalid or out of range.
+bool ParseCsvInt64(absl::string_view text, int64_t& value);
+bool ParseCsvDouble(absl::string_view text, double& value);
+
+}  // namespace internal
+
+// Implementation details follow.
+
+inline CsvColumns::CsvColumns(std::vector<CsvColumnType> types)
+    : types_(std::move(types)), columns_(types_.size()) {}
+
+inline CsvColumns::CsvColumns(CsvColumns&& that) noexcept
+    : types_(std::move(that.types_)),
+      columns_(std::move(that.columns_)),
+      num_records_(std::exchange(that.num_records_, 0)) {}
+
+inline CsvColumns& CsvColumns::operator=(CsvColumns&& that) noexcept {
+  types_ = std::move(that.types_);
+  columns_ = std::move(that.columns_);
+  num_records_ = std::exchange(that.num_records_, 0);
+  return *this;
+}
+
+inline void CsvColumns::Reset(std::vector<CsvColumnType> types) {
+  types_ = std::move(types);
+  columns_.clear();
+  columns_.resize(types_.size());
+  num_records_ = 0;
+}
+
+inline const std::vector<std::string>& CsvColumns::string_values(
+    size_t index) const {
+  RIEGELI_ASSERT_LT(index, num_columns())
+      << "Failed precondition of CsvColumns::string_values(): "
+         "index out of range";
+  RIEGELI_ASSERT(types_[index] == CsvColumnType::kString)
+      << "Failed precondition of CsvColumns::string_values(): "
+         "column has a different type";
+  return columns_[index].string_values;
+}
+
+inline const std::vector<int64_t>& CsvColumns::int64_values(
+    size_t index) const {
+  RIEGELI_ASSERT_LT(index, num_columns())
+      << "Failed precondition of CsvColumns::int64_values(): "
+         "index out of range";
+  RIEGELI_ASSERT(types_[index] == CsvColumnType::kInt64)
+      << "Failed precondition of CsvColumns::int64_values(): "
+         "column has a different type";
+  return columns_[index].int64_values;
+}
+
+inline const std::vector<double>& CsvColumns::double_values(
+    size_t index) const {
+  RIEGELI_ASSERT_LT(index, num_columns())
+      << "Failed precondition of CsvColumns::double_values(): "
+         "index out of range";
+  RIEGELI_ASSERT(types_[index] == CsvColumnType::kDouble)
+      << "Failed precondition of CsvColumns::double_values(): "
+         "column has a different type";
+  return columns_[index].double_values;
+}
+
+inline bool CsvColumns::AppendField(size_t index, absl::string_view field) {
+  Column& column = columns_[index];
+  switch (types_[index]) {
+    case CsvColumnType::kSkipped:
+      return true;
+    case CsvColumnType::kString:
+      column.string_values.emplace_back(field);
+      return true;
+    case CsvColumnType::kInt64: {
+      int64_t value;
+      if (ABSL_PREDICT_FALSE(!internal::ParseCsvInt64(field, value))) {
+        return false;
+      }
+      column.int64_values.push_back(value);
+      return true;
+    }
+    case CsvColumnType::kDouble: {
+      double value;
+      if (ABSL_PREDICT_FALSE(!internal::ParseCsvDouble(field, value))) {
+        return false;
+      }
+      column.double_values.push_back(value);
+      return true;
+    }
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown CSV column type: " << static_cast<int>(types_[index]);
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_CSV_COLUMNS_H_
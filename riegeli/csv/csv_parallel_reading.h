@@ -0,0 +1,192 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_CSV_PARALLEL_READING_H_
+#define RIEGELI_CSV_CSV_PARALLEL_READING_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/reader_factory.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+
+// Options for `ReadCsvInParallel()`.
+class CsvParallelReadingOptions {
+ public:
+  CsvParallelReadingOptions() noexcept {}
+
+  // Options for parsing the CSV file.
+  //
+  // `csv_reader_options().read_header()` is required.
+  //
+  // Default: `CsvReaderBase::Options().set_read_header(true)`.
+  CsvParallelReadingOptions& set_csv_reader_options(
+      CsvReaderBase::Options csv_reader_options) & {
+    csv_reader_options_ = std::move(csv_reader_options);
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_csv_reader_options(
+      CsvReaderBase::Options csv_reader_options) && {
+    return std::move(set_csv_reader_options(std::move(csv_reader_options)));
+  }
+  CsvReaderBase::Options& csv_reader_options() { return csv_reader_options_; }
+  const CsvReaderBase::Options& csv_reader_options() const {
+    return csv_reader_options_;
+  }
+
+  // The size of a byte range parsed by one task.
+  //
+  // Default: 1M.
+  CsvParallelReadingOptions& set_range_size(Position range_size) & {
+    RIEGELI_ASSERT_GT(range_size, 0u)
+        << "Failed precondition of "
+           "CsvParallelReadingOptions::set_range_size(): "
+           "zero range size";
+    range_size_ = range_size;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_range_size(Position range_size) && {
+    return std::move(set_range_size(range_size));
+  }
+  Position range_size() const { return range_size_; }
+
+  // The number of ranges parsed concurrently before their records are
+  // delivered. This bounds the number of records held in memory to about
+  // `range_size() * num_ranges_in_flight()` bytes of source data.
+  //
+  // Default: 64.
+  CsvParallelReadingOptions& set_num_ranges_in_flight(
+      size_t num_ranges_in_flight) & {
+    RIEGELI_ASSERT_GT(num_ranges_in_flight, 0u)
+        << "Failed precondition of "
+           "CsvParallelReadingOptions::set_num_ranges_in_flight(): "
+           "zero number of ranges";
+    num_ranges_in_flight_ = num_ranges_in_flight;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_num_ranges_in_flight(
+      size_t num_ranges_in_flight) && {
+    return std::move(set_num_ranges_in_flight(num_ranges_in_flight));
+  }
+  size_t num_ranges_in_flight() const { return num_ranges_in_flight_; }
+
+  // If `true`, records are delivered in the order of the file, one at a time,
+  // from the calling thread.
+  //
+  // If `false`, records are delivered in an unspecified order, possibly
+  // concurrently from several threads, as soon as they are parsed. The
+  // callback must then be thread-safe.
+  //
+  // Default: `true`.
+  CsvParallelReadingOptions& set_ordered(bool ordered) & {
+    ordered_ = ordered;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_ordered(bool ordered) && {
+    return std::move(set_ordered(ordered));
+  }
+  bool ordered() const { return ordered_; }
+
+  // The `Executor` running parsing tasks. `nullptr` means the thread pool
+  // shared by all parallel operations of Riegeli.
+  //
+  // Default: `nullptr`.
+  CsvParallelReadingOptions& set_executor(Executor* executor) & {
+    executor_ = executor;
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_executor(Executor* executor) && {
+    return std::move(set_executor(executor));
+  }
+  Executor* executor() const { return executor_; }
+
+  // Options for `ReaderFactory` which provides byte `Reader`s for ranges.
+  //
+  // Default: `ReaderFactoryBase::Options()`.
+  CsvParallelReadingOptions& set_reader_factory_options(
+      ReaderFactoryBase::Options reader_factory_options) & {
+    reader_factory_options_ = std::move(reader_factory_options);
+    return *this;
+  }
+  CsvParallelReadingOptions&& set_reader_factory_options(
+      ReaderFactoryBase::Options reader_factory_options) && {
+    return std::move(
+        set_reader_factory_options(std::move(reader_factory_options)));
+  }
+  ReaderFactoryBase::Options& reader_factory_options() {
+    return reader_factory_options_;
+  }
+  const ReaderFactoryBase::Options& reader_factory_options() const {
+    return reader_factory_options_;
+  }
+
+ private:
+  CsvReaderBase::Options csv_reader_options_ =
+      CsvReaderBase::Options().set_read_header(true);
+  Position range_size_ = Position{1} << 20;
+  size_t num_ranges_in_flight_ = 64;
+  bool ordered_ = true;
+  Executor* executor_ = nullptr;
+  ReaderFactoryBase::Options reader_factory_options_;
+};
+
+// Reads records of a CSV file, parsing byte ranges of `src` in parallel, and
+// calls `record_callback` for each record.
+//
+// After the header is read, the rest of the file is split into ranges of
+// `options.range_size()`. Each range is first scanned for quote characters and
+// line terminators. Since a quote inside a quoted field is written twice, the
+// parity of the number of quotes preceding a position tells whether the
+// position is inside quotes, and thus where the first record of each range
+// begins. Ranges are then parsed concurrently, each one from its first record
+// to the first record beginning at or after the end of the range.
+//
+// This splitting is valid for CSV files which can be read by `CsvReader`. For
+// invalid files a reported failure can differ from the failure which
+// `CsvReader` would report, but records preceding the failure are the same.
+//
+// If `record_callback` returns a failed status, reading ends and that status
+// is returned. Otherwise returns a failure of reading, or `absl::OkStatus()`
+// after delivering all records.
+//
+// `src` must support random access for parsing in parallel. Otherwise, and
+// also if `options.csv_reader_options()` set a comment character, an escape
+// character, or a recovery function, which make the state of a position depend
+// on more than the parity of quotes, records are read sequentially with
+// `CsvReader`, and delivered in order from the calling thread.
+//
+// `src` must not be accessed until `ReadCsvInParallel()` returns. Its position
+// is then unspecified.
+//
+// The calling thread takes part in parsing, hence this can be called from a
+// task running on `options.executor()`.
+//
+// Precondition: `options.csv_reader_options().read_header()`
+absl::Status ReadCsvInParallel(
+    Reader& src,
+    const std::function<absl::Status(CsvRecord record)>& record_callback,
+    CsvParallelReadingOptions options = CsvParallelReadingOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_CSV_PARALLEL_READING_H_
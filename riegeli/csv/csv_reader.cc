@@ -25,6 +25,7 @@
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
@@ -33,6 +34,7 @@
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/string_reader.h"
+#include "riegeli/csv/csv_columns.h"
 #include "riegeli/csv/csv_record.h"
 
 namespace riegeli {
@@ -468,6 +470,71 @@ try_again:
   return true;
 }
 
+bool CsvReaderBase::ReadRecord(FlatCsvRecord& record) {
+  RIEGELI_CHECK(has_header())
+      << "Failed precondition of CsvReaderBase::ReadRecord(FlatCsvRecord&): "
+         "CsvReaderBase::Options::read_header() is required";
+  if (ABSL_PREDICT_FALSE(!healthy())) {
+    record.Reset();
+    return false;
+  }
+try_again:
+  if (ABSL_PREDICT_FALSE(!ReadRecord(field_views_))) {
+    record.Reset();
+    return false;
+  }
+  if (ABSL_PREDICT_FALSE(field_views_.size() != header_.size())) {
+    --record_index_;
+    record.Reset();
+    FailAtPreviousRecord(absl::InvalidArgumentError(
+        absl::StrCat("Mismatched number of CSV fields: header has ",
+                     header_.size(), ", record has ", field_views_.size())));
+    if (recovery_ != nullptr) {
+      absl::Status status = this->status();
+      MarkNotFailed();
+      if (recovery_(std::move(status))) goto try_again;
+    }
+    return false;
+  }
+  record.Reset(header_, field_views_);
+  return true;
+}
+
+bool CsvReaderBase::ReadColumns(CsvColumns& columns, size_t max_records) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  for (size_t num_records = 0; num_records < max_records;) {
+    if (ABSL_PREDICT_FALSE(!ReadRecord(field_views_))) return false;
+    if (ABSL_PREDICT_FALSE(field_views_.size() != columns.num_columns())) {
+      --record_index_;
+      FailAtPreviousRecord(absl::InvalidArgumentError(absl::StrCat(
+          "Mismatched number of CSV fields: columns have ",
+          columns.num_columns(), ", record has ", field_views_.size())));
+    } else {
+      size_t index = 0;
+      while (index < field_views_.size() &&
+             columns.AppendField(index, field_views_[index])) {
+        ++index;
+      }
+      if (ABSL_PREDICT_TRUE(index == field_views_.size())) {
+        columns.FinishRecord();
+        ++num_records;
+        continue;
+      }
+      columns.CancelRecord();
+      --record_index_;
+      FailAtPreviousRecord(absl::InvalidArgumentError(absl::StrCat(
+          "Invalid CSV field for ", CsvColumnTypeName(columns.types()[index]),
+          " column ", index, ": \"", absl::CHexEscape(field_views_[index]),
+          "\"")));
+    }
+    if (recovery_ == nullptr) return false;
+    absl::Status status = this->status();
+    MarkNotFailed();
+    if (!recovery_(std::move(status))) return false;
+  }
+  return true;
+}
+
 namespace internal {
 
 inline bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
@@ -476,6 +543,11 @@ inline bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
   return csv_reader.ReadRecordInternal(record);
 }
 
+void SetCsvLineNumber(CsvReaderBase& csv_reader, int64_t line_number) {
+  csv_reader.last_line_number_ = line_number;
+  csv_reader.line_number_ = line_number;
+}
+
 }  // namespace internal
 
 bool CsvReaderBase::ReadRecord(std::vector<std::string>& record) {
@@ -527,6 +599,71 @@ try_again:
   return true;
 }
 
+bool CsvReaderBase::ReadRecord(std::vector<absl::string_view>& record) {
+  record.clear();
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Reader& src = *src_reader();
+  if (ABSL_PREDICT_TRUE(TryReadFieldViews(src, record))) return true;
+  record.clear();
+  if (ABSL_PREDICT_FALSE(!ReadRecordInternal(copied_fields_))) return false;
+  record.assign(copied_fields_.begin(), copied_fields_.end());
+  return true;
+}
+
+inline bool CsvReaderBase::TryReadFieldViews(
+    Reader& src, std::vector<absl::string_view>& record) {
+  // Cases which need more data, unquoting, unescaping, skipping a comment, or
+  // failing, are left for `ReadRecordInternal()`.
+  const char* field_begin = src.cursor();
+  const char* ptr = field_begin;
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(ptr == src.limit())) return false;
+    const CharClass char_class =
+        char_classes_[static_cast<unsigned char>(*ptr)];
+    if (ABSL_PREDICT_TRUE(char_class == CharClass::kOther)) {
+      ++ptr;
+      continue;
+    }
+    switch (char_class) {
+      case CharClass::kOther:
+        RIEGELI_ASSERT_UNREACHABLE() << "Handled before switch";
+      case CharClass::kComment:
+        if (ABSL_PREDICT_FALSE(ptr == src.cursor())) return false;
+        ++ptr;
+        continue;
+      case CharClass::kQuote:
+      case CharClass::kEscape:
+        return false;
+      case CharClass::kFieldSeparator:
+      case CharClass::kLf:
+      case CharClass::kCr: {
+        const size_t length = PtrDistance(field_begin, ptr);
+        if (ABSL_PREDICT_FALSE(record.size() == max_num_fields_ ||
+                               length > max_field_length_)) {
+          return false;
+        }
+        record.emplace_back(field_begin, length);
+        ++ptr;
+        if (char_class == CharClass::kFieldSeparator) {
+          field_begin = ptr;
+          continue;
+        }
+        if (char_class == CharClass::kCr) {
+          if (ABSL_PREDICT_FALSE(ptr == src.limit())) return false;
+          if (*ptr == '\n') ++ptr;
+        }
+        src.set_cursor(ptr);
+        last_line_number_ = line_number_;
+        ++line_number_;
+        ++record_index_;
+        return true;
+      }
+    }
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "Unknown character class: " << static_cast<int>(char_class);
+  }
+}
+
 absl::Status ReadCsvRecordFromString(absl::string_view src,
                                      std::vector<std::string>& record,
                                      CsvReaderBase::Options options) {
@@ -36,6 +36,7 @@
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/csv/csv_columns.h"
 #include "riegeli/csv/csv_record.h"
 
 namespace riegeli {
@@ -45,6 +46,9 @@ class CsvReaderBase;
 namespace internal {
 bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
                           std::vector<std::string>& record);
+// Sets `line_number()` of a `CsvReader` which starts reading in the middle of
+// a CSV file, so that errors are attributed to lines of the whole file.
+void SetCsvLineNumber(CsvReaderBase& csv_reader, int64_t line_number);
 }  // namespace internal
 
 // Template parameter independent part of `CsvReader`.
@@ -285,6 +289,20 @@ class CsvReaderBase : public Object {
   //  * `false` (when `!healthy()`) - failure (`record` is empty)
   bool ReadRecord(CsvRecord& record);
 
+  // Reads the next record expressed as `FlatCsvRecord`, with named fields.
+  //
+  // This is like `ReadRecord(CsvRecord&)`, but reading a sequence of records
+  // into the same `FlatCsvRecord` does not allocate memory per field.
+  //
+  // Precondition:
+  //   `has_header()`, i.e. `Options::read_header()`
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends (`record` is empty)
+  //  * `false` (when `!healthy()`) - failure (`record` is empty)
+  bool ReadRecord(FlatCsvRecord& record);
+
   // Reads the next record expressed as a vector of fields.
   //
   // By a common convention each record should consist of the same number of
@@ -296,6 +314,42 @@ class CsvReaderBase : public Object {
   //  * `false` (when `!healthy()`) - failure (`record` is empty)
   bool ReadRecord(std::vector<std::string>& record);
 
+  // Reads the next record expressed as a vector of fields, without copying
+  // them if possible.
+  //
+  // If the record is complete in the buffer of the source and contains no
+  // quote or escape characters, `record` points into the buffer. It is then
+  // valid until the next non-const operation on the `CsvReader` or on the
+  // source. Otherwise fields are read like by
+  // `ReadRecord(std::vector<std::string>&)` into storage kept by the
+  // `CsvReader`, and `record` points there, valid until the next non-const
+  // operation on the `CsvReader`.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends (`record` is empty)
+  //  * `false` (when `!healthy()`) - failure (`record` is empty)
+  bool ReadRecord(std::vector<absl::string_view>& record);
+
+  // Reads up to `max_records` next records, appending their fields converted to
+  // `columns.types()` to `columns`.
+  //
+  // This is faster than converting fields of records read by `ReadRecord()`
+  // one at a time, because fields are converted straight from the buffer of
+  // the source when possible, and values of a column are stored together.
+  //
+  // Each record must have `columns.num_columns()` fields, and each field must
+  // be valid for its column type, otherwise `CsvReader` fails, or the record
+  // is skipped if the recovery function is set. `columns` then keeps records
+  // read before.
+  //
+  // Return values:
+  //  * `true`                      - success (`max_records` records appended)
+  //  * `false` (when `healthy()`)  - source ends (fewer records appended)
+  //  * `false` (when `!healthy()`) - failure (fewer records appended)
+  bool ReadColumns(CsvColumns& columns,
+                   size_t max_records = std::numeric_limits<size_t>::max());
+
   // The index of the most recently read record, starting from 0.
   //
   // The record count does not include any header read with
@@ -350,6 +404,8 @@ class CsvReaderBase : public Object {
  private:
   friend bool internal::ReadStandaloneRecord(CsvReaderBase& csv_reader,
                                              std::vector<std::string>& record);
+  friend void internal::SetCsvLineNumber(CsvReaderBase& csv_reader,
+                                         int64_t line_number);
 
   enum class CharClass : uint8_t {
     kOther,
@@ -367,11 +423,20 @@ class CsvReaderBase : public Object {
   bool ReadFields(Reader& src, std::vector<std::string>& fields,
                   size_t& field_index);
   bool ReadRecordInternal(std::vector<std::string>& record);
+  // Reads a record into `record` without copying if it is complete in the
+  // buffer of `src` and needs no unquoting or unescaping. Otherwise returns
+  // `false` and leaves `src` unchanged.
+  bool TryReadFieldViews(Reader& src, std::vector<absl::string_view>& record);
 
   bool standalone_record_ = false;
   bool has_header_ = false;
   CsvHeader header_;
   // Lookup table for interpreting source characters.
+  //
+  // Ordinary characters cost one load and one well predicted branch each. This
+  // is faster than checking 8 characters at a time, either by combining their
+  // classes or by comparing a word with each special character, because
+  // fields are usually short enough that the word check rarely skips anything.
   std::array<CharClass, std::numeric_limits<unsigned char>::max() + 1>
       char_classes_{};
   // Meaningful if `char_classes_` contains `CharClass::kQuote`.
@@ -383,6 +448,11 @@ class CsvReaderBase : public Object {
   int64_t last_line_number_ = 1;
   int64_t line_number_ = 1;
   bool recoverable_ = false;
+  // Fields pointed to by the result of `ReadRecord(std::vector<string_view>&)`
+  // when they could not point into the buffer of the source.
+  std::vector<std::string> copied_fields_;
+  // Fields read by `ReadRecord(FlatCsvRecord&)` before they are copied.
+  std::vector<absl::string_view> field_views_;
 };
 
 // `CsvReader` reads records of a CSV (comma-separated values) file.
@@ -517,7 +587,9 @@ inline CsvReaderBase::CsvReaderBase(CsvReaderBase&& that) noexcept
       record_index_(std::exchange(that.record_index_, 0)),
       last_line_number_(std::exchange(that.last_line_number_, 1)),
       line_number_(std::exchange(that.line_number_, 1)),
-      recoverable_(std::exchange(that.recoverable_, false)) {}
+      recoverable_(std::exchange(that.recoverable_, false)),
+      copied_fields_(std::move(that.copied_fields_)),
+      field_views_(std::move(that.field_views_)) {}
 
 inline CsvReaderBase& CsvReaderBase::operator=(CsvReaderBase&& that) noexcept {
   Object::operator=(std::move(that));
@@ -535,6 +607,8 @@ inline CsvReaderBase& CsvReaderBase::operator=(CsvReaderBase&& that) noexcept {
   last_line_number_ = std::exchange(that.last_line_number_, 1);
   line_number_ = std::exchange(that.line_number_, 1);
   recoverable_ = std::exchange(that.recoverable_, false);
+  copied_fields_ = std::move(that.copied_fields_);
+  field_views_ = std::move(that.field_views_);
   return *this;
 }
 
@@ -548,6 +622,8 @@ inline void CsvReaderBase::Reset(Closed) {
   last_line_number_ = 1;
   line_number_ = 1;
   recoverable_ = false;
+  copied_fields_ = std::vector<std::string>();
+  field_views_ = std::vector<absl::string_view>();
 }
 
 inline void CsvReaderBase::Reset() {
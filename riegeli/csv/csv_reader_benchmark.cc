@@ -0,0 +1,123 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/csv/csv_parallel_reading.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+namespace {
+
+// The amount of data parsed by one iteration.
+constexpr size_t kTotalSize = size_t{4} << 20;
+
+constexpr size_t kNumFields = 8;
+
+// Returns a CSV file with a header and records of `kNumFields` fields with
+// pseudo-random lengths averaging `average_length`. `quoted_percent` percent
+// of fields are quoted and contain a comma, a quote, and a newline.
+std::string SampleCsv(size_t average_length, int quoted_percent) {
+  std::mt19937 random(static_cast<uint32_t>(average_length));
+  std::uniform_int_distribution<size_t> length_distribution(
+      0, 2 * average_length);
+  std::uniform_int_distribution<int> percent_distribution(0, 99);
+  std::string csv;
+  for (size_t i = 0; i < kNumFields; ++i) {
+    if (i > 0) csv.push_back(',');
+    csv.append("field");
+    csv.push_back(static_cast<char>('a' + i));
+  }
+  csv.push_back('\n');
+  while (csv.size() < kTotalSize) {
+    for (size_t i = 0; i < kNumFields; ++i) {
+      if (i > 0) csv.push_back(',');
+      if (percent_distribution(random) < quoted_percent) {
+        csv.append("\"x,\"\"\n");
+        csv.append(length_distribution(random), 'x');
+        csv.push_back('"');
+      } else {
+        csv.append(length_distribution(random), 'x');
+      }
+    }
+    csv.push_back('\n');
+  }
+  return csv;
+}
+
+// Parses records with fields averaging `state.range(0)` bytes, of which
+// `state.range(1)` percent are quoted, as `std::vector<std::string>`.
+void BM_CsvReaderReadRecord(benchmark::State& state) {
+  const std::string csv = SampleCsv(static_cast<size_t>(state.range(0)),
+                                    static_cast<int>(state.range(1)));
+  for (auto _ : state) {
+    CsvReader<StringReader<>> reader(std::forward_as_tuple(csv));
+    std::vector<std::string> record;
+    while (reader.ReadRecord(record)) benchmark::DoNotOptimize(record.data());
+    if (!reader.Close()) state.SkipWithError("CsvReader failed");
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(csv.size()));
+}
+BENCHMARK(BM_CsvReaderReadRecord)->ArgsProduct({{4, 32, 256}, {0, 10}});
+
+// Like `BM_CsvReaderReadRecord`, but fields are read as `absl::string_view`.
+void BM_CsvReaderReadRecordStringView(benchmark::State& state) {
+  const std::string csv = SampleCsv(static_cast<size_t>(state.range(0)),
+                                    static_cast<int>(state.range(1)));
+  for (auto _ : state) {
+    CsvReader<StringReader<>> reader(std::forward_as_tuple(csv));
+    std::vector<absl::string_view> record;
+    while (reader.ReadRecord(record)) benchmark::DoNotOptimize(record.data());
+    if (!reader.Close()) state.SkipWithError("CsvReader failed");
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(csv.size()));
+}
+BENCHMARK(BM_CsvReaderReadRecordStringView)
+    ->ArgsProduct({{4, 32, 256}, {0, 10}});
+
+// Parses records with a header, as `CsvRecord`, with `ReadCsvInParallel()`.
+void BM_ReadCsvInParallel(benchmark::State& state) {
+  const std::string csv = SampleCsv(static_cast<size_t>(state.range(0)),
+                                    static_cast<int>(state.range(1)));
+  for (auto _ : state) {
+    StringReader<> reader(csv);
+    const absl::Status status = ReadCsvInParallel(
+        reader, [](CsvRecord record) {
+          benchmark::DoNotOptimize(record);
+          return absl::OkStatus();
+        });
+    if (!status.ok()) state.SkipWithError("ReadCsvInParallel() failed");
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(csv.size()));
+}
+BENCHMARK(BM_ReadCsvInParallel)
+    ->ArgsProduct({{4, 32, 256}, {0, 10}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace riegeli
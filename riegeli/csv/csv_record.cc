@@ -382,4 +382,71 @@ std::ostream& operator<<(std::ostream& out, const CsvRecord& record) {
   return out << record.DebugString();
 }
 
+void FlatCsvRecord::Reset() {
+  header_.Reset();
+  values_.clear();
+  limits_.clear();
+}
+
+void FlatCsvRecord::Reset(CsvHeader header,
+                          std::initializer_list<absl::string_view> fields) {
+  Reset<std::initializer_list<absl::string_view>>(std::move(header), fields);
+}
+
+absl::Status FlatCsvRecord::TryReset(
+    CsvHeader header, std::initializer_list<absl::string_view> fields) {
+  return TryReset<std::initializer_list<absl::string_view>>(std::move(header),
+                                                            fields);
+}
+
+absl::Status FlatCsvRecord::FailMismatchedSize(size_t header_size) {
+  const size_t num_fields = limits_.size();
+  Reset();
+  return absl::FailedPreconditionError(
+      absl::StrCat("Mismatched number of CSV fields: header has ", header_size,
+                   ", record has ", num_fields));
+}
+
+absl::string_view FlatCsvRecord::operator[](absl::string_view name) const {
+  const CsvHeader::iterator name_iter = header_.find(name);
+  RIEGELI_CHECK(name_iter != header_.end())
+      << "Failed precondition of FlatCsvRecord::operator[](): "
+         "unknown field name: "
+      << DebugQuotedIfNeeded(name) << "; existing fields: " << header_;
+  return field(IntCast<size_t>(name_iter - header_.begin()));
+}
+
+bool FlatCsvRecord::contains(absl::string_view name) const {
+  return header_.contains(name);
+}
+
+CsvRecord FlatCsvRecord::ToCsvRecord() const {
+  std::vector<std::string> fields;
+  fields.reserve(limits_.size());
+  for (size_t index = 0; index < limits_.size(); ++index) {
+    fields.emplace_back(field(index));
+  }
+  return CsvRecord(header_, std::move(fields));
+}
+
+std::string FlatCsvRecord::DebugString() const {
+  RIEGELI_ASSERT_EQ(header_.size(), limits_.size())
+      << "Failed invariant of FlatCsvRecord: "
+         "mismatched length of CSV header and fields";
+  std::string result;
+  StringWriter<> writer(&result);
+  for (size_t index = 0; index < limits_.size(); ++index) {
+    if (index > 0) writer.WriteChar(',');
+    WriteDebugQuotedIfNeeded(header_.names()[index], writer);
+    writer.WriteChar(':');
+    WriteDebugQuotedIfNeeded(field(index), writer);
+  }
+  writer.Close();
+  return result;
+}
+
+std::ostream& operator<<(std::ostream& out, const FlatCsvRecord& record) {
+  return out << record.DebugString();
+}
+
 }  // namespace riegeli
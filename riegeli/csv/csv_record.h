@@ -601,6 +601,111 @@ class CsvRecord {
   std::vector<std::string> fields_;
 };
 
+// A read-only alternative to `CsvRecord`, with field values stored in a single
+// `std::string` instead of a `std::string` per field.
+//
+// Setting field values of an existing `FlatCsvRecord` reuses its storage, so
+// reading a sequence of records into the same `FlatCsvRecord` allocates only
+// when a record is larger than any before. Field names are shared with the
+// `CsvHeader`.
+class FlatCsvRecord {
+ public:
+  // Creates a `FlatCsvRecord` with no fields.
+  FlatCsvRecord() noexcept {}
+
+  // Creates a `FlatCsvRecord` with the given field names and field values in
+  // the corresponding order.
+  //
+  // Precondition: `header.size() == fields.size()`
+  template <
+      typename Fields,
+      std::enable_if_t<internal::IsIterableOf<Fields, absl::string_view>::value,
+                       int> = 0>
+  explicit FlatCsvRecord(CsvHeader header, const Fields& fields);
+  explicit FlatCsvRecord(CsvHeader header,
+                         std::initializer_list<absl::string_view> fields);
+
+  FlatCsvRecord(const FlatCsvRecord& that) = default;
+  FlatCsvRecord& operator=(const FlatCsvRecord& that) = default;
+
+  // The source `FlatCsvRecord` is left empty.
+  FlatCsvRecord(FlatCsvRecord&& that) noexcept;
+  FlatCsvRecord& operator=(FlatCsvRecord&& that) noexcept;
+
+  // Returns the set of field names.
+  const CsvHeader& header() const { return header_; }
+
+  // Makes `*this` equivalent to a newly constructed `FlatCsvRecord`.
+  //
+  // Precondition: like for the corresponding constructor
+  void Reset();
+  template <
+      typename Fields,
+      std::enable_if_t<internal::IsIterableOf<Fields, absl::string_view>::value,
+                       int> = 0>
+  void Reset(CsvHeader header, const Fields& fields);
+  void Reset(CsvHeader header, std::initializer_list<absl::string_view> fields);
+
+  // Makes `*this` equivalent to a newly constructed `FlatCsvRecord`, reporting
+  // whether construction was successful.
+  //
+  // Return values:
+  //  * `absl::OkStatus()`                 - `FlatCsvRecord` is set to `header`
+  //                                         and `fields`
+  //  * `absl::FailedPreconditionError(_)` - lengths of `header` and `fields`
+  //                                         do not match, `FlatCsvRecord` is
+  //                                         empty
+  template <
+      typename Fields,
+      std::enable_if_t<internal::IsIterableOf<Fields, absl::string_view>::value,
+                       int> = 0>
+  absl::Status TryReset(CsvHeader header, const Fields& fields);
+  absl::Status TryReset(CsvHeader header,
+                        std::initializer_list<absl::string_view> fields);
+
+  // Returns `true` if there are no fields.
+  bool empty() const { return limits_.empty(); }
+
+  // Returns the number of field names, which is the same as the number of field
+  // values.
+  size_t size() const { return limits_.size(); }
+
+  // Returns the field value with the given index, in the order corresponding
+  // to the order of field names in the header.
+  //
+  // Precondition: `index < size()`
+  absl::string_view field(size_t index) const;
+
+  // Returns the field value corresponding to the given field `name`.
+  //
+  // Precondition: `name` is present
+  absl::string_view operator[](absl::string_view name) const;
+
+  // Returns `true` if `name` is present.
+  bool contains(absl::string_view name) const;
+
+  // Returns a `CsvRecord` with the same field names and field values.
+  CsvRecord ToCsvRecord() const;
+
+  // Renders contents in a human-readable way.
+  std::string DebugString() const;
+
+  // Same as: `out << record.DebugString()`
+  friend std::ostream& operator<<(std::ostream& out,
+                                  const FlatCsvRecord& record);
+
+ private:
+  // Makes `*this` empty and returns a failure for `TryReset()`.
+  absl::Status FailMismatchedSize(size_t header_size);
+
+  // Invariant: `header_.size() == limits_.size()`
+  CsvHeader header_;
+  // Concatenated field values.
+  std::string values_;
+  // End positions of field values in `values_`.
+  std::vector<size_t> limits_;
+};
+
 // Implementation details follow.
 
 inline typename CsvHeader::iterator::reference CsvHeader::iterator::operator*()
@@ -929,6 +1034,63 @@ inline CsvRecord::const_iterator CsvRecord::end() const {
   return const_iterator(header_.end(), fields_.end());
 }
 
+template <typename Fields,
+          std::enable_if_t<
+              internal::IsIterableOf<Fields, absl::string_view>::value, int>>
+inline FlatCsvRecord::FlatCsvRecord(CsvHeader header, const Fields& fields) {
+  Reset(std::move(header), fields);
+}
+
+inline FlatCsvRecord::FlatCsvRecord(
+    CsvHeader header, std::initializer_list<absl::string_view> fields) {
+  Reset(std::move(header), fields);
+}
+
+inline FlatCsvRecord::FlatCsvRecord(FlatCsvRecord&& that) noexcept
+    : header_(std::move(that.header_)),  // Leaves `that.header_` empty.
+      values_(std::exchange(that.values_, std::string())),
+      limits_(std::exchange(that.limits_, std::vector<size_t>())) {}
+
+inline FlatCsvRecord& FlatCsvRecord::operator=(FlatCsvRecord&& that) noexcept {
+  header_ = std::move(that.header_);  // Leaves `that.header_` empty.
+  values_ = std::exchange(that.values_, std::string());
+  limits_ = std::exchange(that.limits_, std::vector<size_t>());
+  return *this;
+}
+
+template <typename Fields,
+          std::enable_if_t<
+              internal::IsIterableOf<Fields, absl::string_view>::value, int>>
+void FlatCsvRecord::Reset(CsvHeader header, const Fields& fields) {
+  const absl::Status status = TryReset(std::move(header), fields);
+  RIEGELI_CHECK(status.ok())
+      << "Failed precondition of FlatCsvRecord::Reset(): " << status.message();
+}
+
+template <typename Fields,
+          std::enable_if_t<
+              internal::IsIterableOf<Fields, absl::string_view>::value, int>>
+absl::Status FlatCsvRecord::TryReset(CsvHeader header, const Fields& fields) {
+  values_.clear();
+  limits_.clear();
+  for (const absl::string_view field : fields) {
+    values_.append(field.data(), field.size());
+    limits_.push_back(values_.size());
+  }
+  if (ABSL_PREDICT_FALSE(header.size() != limits_.size())) {
+    return FailMismatchedSize(header.size());
+  }
+  header_ = std::move(header);
+  return absl::OkStatus();
+}
+
+inline absl::string_view FlatCsvRecord::field(size_t index) const {
+  RIEGELI_ASSERT_LT(index, limits_.size())
+      << "Failed precondition of FlatCsvRecord::field(): index out of range";
+  const size_t begin = index == 0 ? 0 : limits_[index - 1];
+  return absl::string_view(values_.data() + begin, limits_[index] - begin);
+}
+
 template <typename Src,
           std::enable_if_t<
               internal::IsIterableOf<
@@ -30,6 +30,7 @@
 #include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/csv/csv_record.h"
@@ -62,6 +63,7 @@ void CsvWriterBase::Initialize(Writer* dest, Options&& options) {
     quotes_needed_[static_cast<unsigned char>(*options.quote())] = true;
   }
   newline_ = options.newline();
+  comment_ = options.comment();
   field_separator_ = options.field_separator();
   quote_ = options.quote();
 
@@ -147,4 +149,27 @@ bool CsvWriterBase::WriteRecord(const CsvRecord& record) {
   return WriteRecord(record.fields());
 }
 
+bool CsvWriterBase::WriteRecords(absl::Span<const CsvRecord> records,
+                                 Executor* executor) {
+  RIEGELI_CHECK(has_header_)
+      << "Failed precondition of CsvWriterBase::WriteRecords(CsvRecord): "
+         "CsvWriterBase::Options::header() is required";
+  if (healthy()) {
+    for (const CsvRecord& record : records) {
+      RIEGELI_CHECK_EQ(record.header(), header_)
+          << "Failed precondition of CsvWriterBase::WriteRecords(CsvRecord): "
+          << "mismatched CSV header and record";
+    }
+  }
+  return WriteRecordsInternal(records, executor);
+}
+
+CsvWriterBase::Options CsvWriterBase::FormattingOptions() const {
+  return Options()
+      .set_newline(newline_)
+      .set_comment(comment_)
+      .set_field_separator(field_separator_)
+      .set_quote(quote_);
+}
+
 }  // namespace riegeli
@@ -26,15 +26,20 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/string_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/csv/containers.h"
@@ -217,6 +222,40 @@ class CsvWriterBase : public Object {
   bool WriteRecord(const Record& record);
   bool WriteRecord(std::initializer_list<absl::string_view> record);
 
+  // Writes a batch of records, formatting them in parallel.
+  //
+  // Records are split into groups of about 256K of field data. Groups are
+  // formatted into `Chain`s concurrently by tasks scheduled on `executor` (or
+  // the thread pool shared by all parallel operations of Riegeli if
+  // `nullptr`), and the `Chain`s are written to the byte `Writer` in order.
+  // A batch which forms a single group is written by the calling thread.
+  //
+  // The effect is the same as of calling `WriteRecord()` for each record,
+  // including the record at which a failure is reported.
+  //
+  // The calling thread takes part in formatting, hence this can be called from
+  // a task running on `executor`.
+  //
+  // The type of `Record` must support iteration yielding `absl::string_view`,
+  // e.g. `std::vector<std::string>`. A `std::vector` of records can be passed
+  // as `absl::MakeConstSpan(records)`.
+  //
+  // Preconditions for `WriteRecords(absl::Span<const CsvRecord>)`:
+  //  * `has_header()`, i.e. `Options::header() != absl::nullopt`
+  //  * `record.header() == header()` for each record
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool WriteRecords(absl::Span<const CsvRecord> records,
+                    Executor* executor = nullptr);
+  template <
+      typename Record,
+      std::enable_if_t<internal::IsIterableOf<Record, absl::string_view>::value,
+                       int> = 0>
+  bool WriteRecords(absl::Span<const Record> records,
+                    Executor* executor = nullptr);
+
   // The index of the most recently written record, starting from 0.
   //
   // The record count does not include any header written with
@@ -259,6 +298,20 @@ class CsvWriterBase : public Object {
   bool WriteField(Writer& dest, absl::string_view field);
   template <typename Record>
   bool WriteRecordInternal(const Record& record);
+  template <typename Record>
+  bool WriteRecordsInternal(absl::Span<const Record> records,
+                            Executor* executor);
+  // Returns options which make another `CsvWriter` format records like this
+  // one, without a header.
+  Options FormattingOptions() const;
+
+  static absl::Span<const std::string> FieldsOf(const CsvRecord& record) {
+    return record.fields();
+  }
+  template <typename Record>
+  static const Record& FieldsOf(const Record& record) {
+    return record;
+  }
 
   bool standalone_record_ = false;
   bool has_header_ = false;
@@ -271,6 +324,7 @@ class CsvWriterBase : public Object {
   std::array<bool, std::numeric_limits<unsigned char>::max() + 1>
       quotes_needed_{};
   Newline newline_ = Newline::kLf;
+  absl::optional<char> comment_;
   char field_separator_ = '\0';
   absl::optional<char> quote_;
   uint64_t record_index_ = 0;
@@ -406,6 +460,7 @@ inline CsvWriterBase::CsvWriterBase(CsvWriterBase&& that) noexcept
       header_(std::move(that.header_)),
       quotes_needed_(that.quotes_needed_),
       newline_(that.newline_),
+      comment_(that.comment_),
       field_separator_(that.field_separator_),
       quote_(that.quote_),
       record_index_(std::exchange(that.record_index_, 0)) {}
@@ -419,6 +474,7 @@ inline CsvWriterBase& CsvWriterBase::operator=(CsvWriterBase&& that) noexcept {
   header_ = std::move(that.header_);
   quotes_needed_ = that.quotes_needed_;
   newline_ = that.newline_;
+  comment_ = that.comment_;
   field_separator_ = that.field_separator_;
   quote_ = that.quote_;
   record_index_ = std::exchange(that.record_index_, 0);
@@ -581,6 +637,84 @@ void CsvWriter<Dest>::Done() {
   }
 }
 
+template <typename Record,
+          std::enable_if_t<
+              internal::IsIterableOf<Record, absl::string_view>::value, int>>
+inline bool CsvWriterBase::WriteRecords(absl::Span<const Record> records,
+                                        Executor* executor) {
+  return WriteRecordsInternal(records, executor);
+}
+
+template <typename Record>
+bool CsvWriterBase::WriteRecordsInternal(absl::Span<const Record> records,
+                                         Executor* executor) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  // Splitting into groups costs one pass over field sizes, which is cheap
+  // compared with formatting.
+  constexpr size_t kGroupSize = size_t{256} << 10;
+  std::vector<size_t> group_limits;
+  size_t group_size = 0;
+  for (size_t index = 0; index < records.size(); ++index) {
+    for (const absl::string_view field : FieldsOf(records[index])) {
+      group_size += field.size() + 1;
+    }
+    if (group_size >= kGroupSize) {
+      group_limits.push_back(index + 1);
+      group_size = 0;
+    }
+  }
+  if (group_size > 0) group_limits.push_back(records.size());
+  if (group_limits.size() <= 1) {
+    for (const Record& record : records) {
+      if (ABSL_PREDICT_FALSE(!WriteRecordInternal(FieldsOf(record)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<Chain> formatted(group_limits.size());
+  // `std::vector<bool>` would not allow setting elements concurrently.
+  std::vector<char> formatting_failed(group_limits.size());
+  internal::ParallelFor(
+      executor == nullptr ? internal::ThreadPool::global() : *executor,
+      group_limits.size(), [&](size_t group) {
+        CsvWriter<ChainWriter<>> csv_writer(
+            std::forward_as_tuple(&formatted[group]), FormattingOptions());
+        for (size_t index = group == 0 ? 0 : group_limits[group - 1];
+             index < group_limits[group]; ++index) {
+          if (ABSL_PREDICT_FALSE(
+                  !csv_writer.WriteRecord(FieldsOf(records[index])))) {
+            formatting_failed[group] = 1;
+            return;
+          }
+        }
+        if (ABSL_PREDICT_FALSE(!csv_writer.Close())) {
+          formatting_failed[group] = 1;
+        }
+      });
+  Writer& dest = *dest_writer();
+  for (size_t group = 0; group < group_limits.size(); ++group) {
+    const size_t group_begin = group == 0 ? 0 : group_limits[group - 1];
+    if (ABSL_PREDICT_FALSE(formatting_failed[group] != 0)) {
+      // Write the group again sequentially, to report the failure at the
+      // right record.
+      for (size_t index = group_begin; index < group_limits[group]; ++index) {
+        if (ABSL_PREDICT_FALSE(
+                !WriteRecordInternal(FieldsOf(records[index])))) {
+          return false;
+        }
+      }
+      continue;
+    }
+    if (ABSL_PREDICT_FALSE(!dest.Write(std::move(formatted[group])))) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+    record_index_ += group_limits[group] - group_begin;
+  }
+  return true;
+}
+
 template <typename Record,
           std::enable_if_t<
               internal::IsIterableOf<Record, absl::string_view>::value, int>>
@@ -15,11 +15,13 @@
 #ifndef RIEGELI_ENDIAN_ENDIAN_READING_H_
 #define RIEGELI_ENDIAN_ENDIAN_READING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <cstring>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_internal.h"
@@ -328,17 +330,33 @@ inline bool ReadBigEndian<int64_t>(Reader& src, int64_t& dest) {
   return ReadBigEndianSigned64(src, dest);
 }
 
+namespace internal {
+
+// Reads numbers in batches which fit in the buffer of `src`, decoding each
+// batch with `read_array`, so that byte swapping is vectorized instead of
+// checking the buffer for each number.
+template <typename T, void (*read_array)(const char*, absl::Span<T>)>
+inline bool ReadInBatches(Reader& src, absl::Span<T> dest) {
+  while (!dest.empty()) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(T), dest.size() * sizeof(T)))) {
+      return false;
+    }
+    const size_t length = UnsignedMin(src.available() / sizeof(T), dest.size());
+    read_array(src.cursor(), dest.subspan(0, length));
+    src.move_cursor(length * sizeof(T));
+    dest.remove_prefix(length);
+  }
+  return true;
+}
+
+}  // namespace internal
+
 inline bool ReadLittleEndian16s(Reader& src, absl::Span<uint16_t> dest) {
   if (internal::IsLittleEndian()) {
     return src.Read(dest.size() * sizeof(uint16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian16(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<uint16_t, ReadLittleEndian16s>(src, dest);
   }
 }
 
@@ -347,12 +365,7 @@ inline bool ReadLittleEndian32s(Reader& src, absl::Span<uint32_t> dest) {
     return src.Read(dest.size() * sizeof(uint32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<uint32_t, ReadLittleEndian32s>(src, dest);
   }
 }
 
@@ -361,12 +374,7 @@ inline bool ReadLittleEndian64s(Reader& src, absl::Span<uint64_t> dest) {
     return src.Read(dest.size() * sizeof(uint64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian64(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<uint64_t, ReadLittleEndian64s>(src, dest);
   }
 }
 
@@ -375,12 +383,8 @@ inline bool ReadLittleEndianSigned16s(Reader& src, absl::Span<int16_t> dest) {
     return src.Read(dest.size() * sizeof(int16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndianSigned16(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<int16_t, ReadLittleEndianSigned16s>(
+        src, dest);
   }
 }
 
@@ -389,12 +393,8 @@ inline bool ReadLittleEndianSigned32s(Reader& src, absl::Span<int32_t> dest) {
     return src.Read(dest.size() * sizeof(int32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndianSigned32(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<int32_t, ReadLittleEndianSigned32s>(
+        src, dest);
   }
 }
 
@@ -403,12 +403,8 @@ inline bool ReadLittleEndianSigned64s(Reader& src, absl::Span<int64_t> dest) {
     return src.Read(dest.size() * sizeof(int64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndianSigned64(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadInBatches<int64_t, ReadLittleEndianSigned64s>(
+        src, dest);
   }
 }
 
@@ -417,10 +413,7 @@ inline bool ReadBigEndian16s(Reader& src, absl::Span<uint16_t> dest) {
     return src.Read(dest.size() * sizeof(uint16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian16(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadInBatches<uint16_t, ReadBigEndian16s>(src, dest);
   }
 }
 
@@ -429,10 +422,7 @@ inline bool ReadBigEndian32s(Reader& src, absl::Span<uint32_t> dest) {
     return src.Read(dest.size() * sizeof(uint32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian32(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadInBatches<uint32_t, ReadBigEndian32s>(src, dest);
   }
 }
 
@@ -441,10 +431,7 @@ inline bool ReadBigEndian64s(Reader& src, absl::Span<uint64_t> dest) {
     return src.Read(dest.size() * sizeof(uint64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian64(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadInBatches<uint64_t, ReadBigEndian64s>(src, dest);
   }
 }
 
@@ -453,11 +440,7 @@ inline bool ReadBigEndianSigned16s(Reader& src, absl::Span<int16_t> dest) {
     return src.Read(dest.size() * sizeof(int16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndianSigned16(src, dest_value)))
-        return false;
-    }
-    return true;
+    return internal::ReadInBatches<int16_t, ReadBigEndianSigned16s>(src, dest);
   }
 }
 
@@ -466,11 +449,7 @@ inline bool ReadBigEndianSigned32s(Reader& src, absl::Span<int32_t> dest) {
     return src.Read(dest.size() * sizeof(int32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndianSigned32(src, dest_value)))
-        return false;
-    }
-    return true;
+    return internal::ReadInBatches<int32_t, ReadBigEndianSigned32s>(src, dest);
   }
 }
 
@@ -479,11 +458,7 @@ inline bool ReadBigEndianSigned64s(Reader& src, absl::Span<int64_t> dest) {
     return src.Read(dest.size() * sizeof(int64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (int64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndianSigned64(src, dest_value)))
-        return false;
-    }
-    return true;
+    return internal::ReadInBatches<int64_t, ReadBigEndianSigned64s>(src, dest);
   }
 }
 
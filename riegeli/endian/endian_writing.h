@@ -15,6 +15,7 @@
 #ifndef RIEGELI_ENDIAN_ENDIAN_WRITING_H_
 #define RIEGELI_ENDIAN_ENDIAN_WRITING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <cstring>
@@ -366,16 +367,35 @@ inline bool WriteBigEndian<int64_t>(int64_t data, Writer& dest) {
   return WriteBigEndianSigned64(data, dest);
 }
 
+namespace internal {
+
+// Writes numbers in batches which fit in the buffer of `dest`, encoding each
+// batch with `write_array`, so that byte swapping is vectorized instead of
+// checking the buffer for each number.
+template <typename T, void (*write_array)(absl::Span<const T>, char*)>
+inline bool WriteInBatches(absl::Span<const T> data, Writer& dest) {
+  while (!data.empty()) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(sizeof(T), data.size() * sizeof(T)))) {
+      return false;
+    }
+    const size_t length =
+        UnsignedMin(dest.available() / sizeof(T), data.size());
+    write_array(data.subspan(0, length), dest.cursor());
+    dest.move_cursor(length * sizeof(T));
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
+}  // namespace internal
+
 inline bool WriteLittleEndian16s(absl::Span<const uint16_t> data,
                                  Writer& dest) {
   if (internal::IsLittleEndian()) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint16_t));
   } else {
-    for (const uint16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian16(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint16_t, WriteLittleEndian16s>(data, dest);
   }
 }
 
@@ -385,10 +405,7 @@ inline bool WriteLittleEndian32s(absl::Span<const uint32_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint32_t));
   } else {
-    for (const uint32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian32(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint32_t, WriteLittleEndian32s>(data, dest);
   }
 }
 
@@ -398,10 +415,7 @@ inline bool WriteLittleEndian64s(absl::Span<const uint64_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint64_t));
   } else {
-    for (const uint64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian64(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint64_t, WriteLittleEndian64s>(data, dest);
   }
 }
 
@@ -411,12 +425,8 @@ inline bool WriteLittleEndianSigned16s(absl::Span<const int16_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int16_t));
   } else {
-    for (const int16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndianSigned16(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int16_t, WriteLittleEndianSigned16s>(
+        data, dest);
   }
 }
 
@@ -426,12 +436,8 @@ inline bool WriteLittleEndianSigned32s(absl::Span<const int32_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int32_t));
   } else {
-    for (const int32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndianSigned32(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int32_t, WriteLittleEndianSigned32s>(
+        data, dest);
   }
 }
 
@@ -441,12 +447,8 @@ inline bool WriteLittleEndianSigned64s(absl::Span<const int64_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int64_t));
   } else {
-    for (const int64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndianSigned64(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int64_t, WriteLittleEndianSigned64s>(
+        data, dest);
   }
 }
 
@@ -455,10 +457,7 @@ inline bool WriteBigEndian16s(absl::Span<const uint16_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint16_t));
   } else {
-    for (const uint16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian16(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint16_t, WriteBigEndian16s>(data, dest);
   }
 }
 
@@ -467,10 +466,7 @@ inline bool WriteBigEndian32s(absl::Span<const uint32_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint32_t));
   } else {
-    for (const uint32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian32(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint32_t, WriteBigEndian32s>(data, dest);
   }
 }
 
@@ -479,10 +475,7 @@ inline bool WriteBigEndian64s(absl::Span<const uint64_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint64_t));
   } else {
-    for (const uint64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian64(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteInBatches<uint64_t, WriteBigEndian64s>(data, dest);
   }
 }
 
@@ -492,12 +485,8 @@ inline bool WriteBigEndianSigned16s(absl::Span<const int16_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int16_t));
   } else {
-    for (const int16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndianSigned16(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int16_t, WriteBigEndianSigned16s>(
+        data, dest);
   }
 }
 
@@ -507,12 +496,8 @@ inline bool WriteBigEndianSigned32s(absl::Span<const int32_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int32_t));
   } else {
-    for (const int32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndianSigned32(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int32_t, WriteBigEndianSigned32s>(
+        data, dest);
   }
 }
 
@@ -522,12 +507,8 @@ inline bool WriteBigEndianSigned64s(absl::Span<const int64_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(int64_t));
   } else {
-    for (const int64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndianSigned64(value, dest))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::WriteInBatches<int64_t, WriteBigEndianSigned64s>(
+        data, dest);
   }
 }
 
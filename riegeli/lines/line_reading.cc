@@ -15,9 +15,11 @@
 #include "riegeli/lines/line_reading.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -33,6 +35,40 @@ namespace riegeli {
 
 namespace {
 
+// Returns a pointer to the first LF or CR in [`ptr`, `limit`), or `nullptr` if
+// there is none.
+//
+// Eight bytes are checked at a time, with the classic test for a zero byte
+// applied to the word XORed with each of the characters.
+inline const char* FindLfOrCr(const char* ptr, const char* limit) {
+  constexpr uint64_t kLowBits = 0x0101010101010101;
+  constexpr uint64_t kHighBits = 0x8080808080808080;
+  while (PtrDistance(ptr, limit) >= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, ptr, sizeof(uint64_t));
+    const uint64_t lf = word ^ (kLowBits * uint64_t{'\n'});
+    const uint64_t cr = word ^ (kLowBits * uint64_t{'\r'});
+    if ((((lf - kLowBits) & ~lf) | ((cr - kLowBits) & ~cr)) & kHighBits) break;
+    ptr += sizeof(uint64_t);
+  }
+  for (; ptr < limit; ++ptr) {
+    if (*ptr == '\n' || *ptr == '\r') return ptr;
+  }
+  return nullptr;
+}
+
+// Returns the length of the line terminator found by `FindLfOrCr()` at
+// `src.cursor() + length`: 2 for CR LF, otherwise 1.
+//
+// For CR, this reads ahead one character.
+inline size_t NewlineLength(Reader& src, size_t length) {
+  if (src.cursor()[length] == '\n') return 1;
+  return ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
+                 src.cursor()[length + 1] == '\n'
+             ? size_t{2}
+             : size_t{1};
+}
+
 // Reads `length_to_read` bytes from `src`, writes their prefix of
 // `length_to_write` bytes to `dest`, appending to existing contents
 // (unless `Dest` is `absl::string_view`).
@@ -115,23 +151,15 @@ inline bool ReadLineInternal(Reader& src, Dest& dest, ReadLineOptions options) {
         }
         goto continue_reading;
       }
-      case ReadLineOptions::Newline::kAny:
-        for (const char* newline = src.cursor(); newline < src.limit();
-             ++newline) {
-          if (ABSL_PREDICT_FALSE(*newline == '\n')) {
-            return FoundNewline(src, dest, options,
-                                PtrDistance(src.cursor(), newline), 1);
-          }
-          if (ABSL_PREDICT_FALSE(*newline == '\r')) {
-            const size_t length = PtrDistance(src.cursor(), newline);
-            return FoundNewline(src, dest, options, length,
-                                ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
-                                        src.cursor()[length + 1] == '\n'
-                                    ? size_t{2}
-                                    : size_t{1});
-          }
+      case ReadLineOptions::Newline::kAny: {
+        const char* const newline = FindLfOrCr(src.cursor(), src.limit());
+        if (ABSL_PREDICT_TRUE(newline != nullptr)) {
+          const size_t length = PtrDistance(src.cursor(), newline);
+          return FoundNewline(src, dest, options, length,
+                              NewlineLength(src, length));
         }
         goto continue_reading;
+      }
     }
     RIEGELI_ASSERT_UNREACHABLE()
         << "Unknown newline: " << static_cast<int>(options.newline());
@@ -165,23 +193,16 @@ bool ReadLine(Reader& src, absl::string_view& dest, ReadLineOptions options) {
         }
         goto continue_reading;
       }
-      case ReadLineOptions::Newline::kAny:
-        for (const char* newline = src.cursor() + length; newline < src.limit();
-             ++newline) {
-          if (ABSL_PREDICT_FALSE(*newline == '\n')) {
-            return FoundNewline(src, dest, options,
-                                PtrDistance(src.cursor(), newline), 1);
-          }
-          if (ABSL_PREDICT_FALSE(*newline == '\r')) {
-            length = PtrDistance(src.cursor(), newline);
-            return FoundNewline(src, dest, options, length,
-                                ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
-                                        src.cursor()[length + 1] == '\n'
-                                    ? size_t{2}
-                                    : size_t{1});
-          }
+      case ReadLineOptions::Newline::kAny: {
+        const char* const newline =
+            FindLfOrCr(src.cursor() + length, src.limit());
+        if (ABSL_PREDICT_TRUE(newline != nullptr)) {
+          length = PtrDistance(src.cursor(), newline);
+          return FoundNewline(src, dest, options, length,
+                              NewlineLength(src, length));
         }
         goto continue_reading;
+      }
     }
     RIEGELI_ASSERT_UNREACHABLE()
         << "Unknown newline: " << static_cast<int>(options.newline());
@@ -212,6 +233,42 @@ bool ReadLine(Reader& src, absl::Cord& dest, ReadLineOptions options) {
   return ReadLineInternal(src, dest, options);
 }
 
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               size_t max_lines, ReadLineOptions options) {
+  RIEGELI_ASSERT_GT(max_lines, 0u)
+      << "Failed precondition of ReadLines(): no lines to read";
+  dest.clear();
+  absl::string_view line;
+  if (ABSL_PREDICT_FALSE(!ReadLine(src, line, options))) {
+    if (!line.empty()) dest.push_back(line);
+    return false;
+  }
+  dest.push_back(line);
+  // Further lines are taken only if their terminators are in the buffer,
+  // without pulling which would invalidate `dest`. A CR at the end of the
+  // buffer, and a line exceeding `max_length()`, are left for `ReadLine()`.
+  while (dest.size() < max_lines) {
+    const char* const newline =
+        options.newline() == ReadLineOptions::Newline::kLf
+            ? static_cast<const char*>(
+                  std::memchr(src.cursor(), '\n', src.available()))
+            : FindLfOrCr(src.cursor(), src.limit());
+    if (newline == nullptr) break;
+    size_t newline_length = 1;
+    if (*newline == '\r') {
+      if (newline + 1 == src.limit()) break;
+      if (newline[1] == '\n') newline_length = 2;
+    }
+    const size_t length = PtrDistance(src.cursor(), newline);
+    const size_t line_length =
+        options.keep_newline() ? length + newline_length : length;
+    if (ABSL_PREDICT_FALSE(line_length > options.max_length())) break;
+    dest.emplace_back(src.cursor(), line_length);
+    src.move_cursor(length + newline_length);
+  }
+  return true;
+}
+
 void SkipBOM(Reader& src) {
   if (src.pos() != 0) return;
   src.Pull(3);
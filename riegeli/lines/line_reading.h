@@ -20,6 +20,7 @@
 #include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
@@ -111,11 +112,43 @@ bool ReadLine(Reader& src, Chain& dest,
 bool ReadLine(Reader& src, absl::Cord& dest,
               ReadLineOptions options = ReadLineOptions());
 
+// Reads lines, at least one line unless the source ends, followed by lines
+// which are already complete in the buffer of `src`, at most `max_lines` in
+// total. Replaces `dest` with them.
+//
+// This amortizes the overhead of `ReadLine()` over many short lines, e.g. when
+// splitting a large file into lines.
+//
+// `dest` points into the buffer of `src`. It is valid until the next non-const
+// operation on `src`. Only the first line can cross a boundary of the buffer;
+// it is then copied to a scratch buffer of `src` like by `ReadLine()`.
+//
+// Precondition: `max_lines > 0`
+//
+// Return values:
+//  * `true`                          - success (`dest` is not empty)
+//  * `false` (when `src.healthy()`)  - source ends (`dest` is empty)
+//  * `false` (when `!src.healthy()`) - failure (`dest` contains the partial
+//                                               line read before the failure
+//                                               if it is not empty)
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               size_t max_lines, ReadLineOptions options = ReadLineOptions());
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               ReadLineOptions options = ReadLineOptions());
+
 // Skips an initial UTF-8 BOM if it is present.
 //
 // Does nothing unless `src.pos() == 0`.
 void SkipBOM(Reader& src);
 
+// Implementation details follow.
+
+inline bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+                      ReadLineOptions options) {
+  return ReadLines(src, dest, std::numeric_limits<size_t>::max(),
+                   std::move(options));
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_LINES_LINE_READING_H_
@@ -0,0 +1,95 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/lines/line_reading.h"
+
+namespace riegeli {
+namespace {
+
+// The amount of data read by one iteration.
+constexpr size_t kTotalSize = size_t{1} << 20;
+
+// Returns lines with pseudo-random lengths averaging `average_length`,
+// terminated with `newline`.
+std::string SampleLines(size_t average_length, absl::string_view newline) {
+  std::mt19937 random(static_cast<uint32_t>(average_length));
+  std::uniform_int_distribution<size_t> length_distribution(
+      0, 2 * average_length);
+  std::string lines;
+  while (lines.size() < kTotalSize) {
+    lines.append(length_distribution(random), 'x');
+    lines.append(newline.data(), newline.size());
+  }
+  return lines;
+}
+
+// Reads lines averaging `state.range(0)` bytes, terminated with LF, as
+// `absl::string_view`.
+void BM_ReadLineLf(benchmark::State& state) {
+  const std::string lines =
+      SampleLines(static_cast<size_t>(state.range(0)), "\n");
+  for (auto _ : state) {
+    StringReader<> reader(lines);
+    absl::string_view line;
+    while (ReadLine(reader, line)) benchmark::DoNotOptimize(line.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(lines.size()));
+}
+BENCHMARK(BM_ReadLineLf)->RangeMultiplier(8)->Range(8, 4 << 10);
+
+// Like `BM_ReadLineLf`, but lines are terminated with CR LF and any line
+// terminator is recognized.
+void BM_ReadLineAny(benchmark::State& state) {
+  const std::string lines =
+      SampleLines(static_cast<size_t>(state.range(0)), "\r\n");
+  for (auto _ : state) {
+    StringReader<> reader(lines);
+    absl::string_view line;
+    while (ReadLine(reader, line,
+                    ReadLineOptions().set_newline(
+                        ReadLineOptions::Newline::kAny))) {
+      benchmark::DoNotOptimize(line.data());
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(lines.size()));
+}
+BENCHMARK(BM_ReadLineAny)->RangeMultiplier(8)->Range(8, 4 << 10);
+
+// Like `BM_ReadLineLf`, but lines are copied to `std::string`.
+void BM_ReadLineToString(benchmark::State& state) {
+  const std::string lines =
+      SampleLines(static_cast<size_t>(state.range(0)), "\n");
+  for (auto _ : state) {
+    StringReader<> reader(lines);
+    std::string line;
+    while (ReadLine(reader, line)) benchmark::DoNotOptimize(line.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(lines.size()));
+}
+BENCHMARK(BM_ReadLineToString)->RangeMultiplier(8)->Range(8, 4 << 10);
+
+}  // namespace
+}  // namespace riegeli
@@ -0,0 +1,220 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/lz4/lz4_writer.h"
+
+#include <stddef.h>
+
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "lz4frame.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/recycling_pool.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/buffered_writer.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr int Lz4WriterBase::Options::kMinCompressionLevel;
+constexpr int Lz4WriterBase::Options::kMaxCompressionLevel;
+constexpr int Lz4WriterBase::Options::kDefaultCompressionLevel;
+constexpr size_t Lz4WriterBase::Options::kDefaultBufferSize;
+#endif
+
+void Lz4WriterBase::Initialize(Writer* dest, int compression_level,
+                               bool store_checksum,
+                               size_t recycling_pool_max_size) {
+  RIEGELI_ASSERT(dest != nullptr)
+      << "Failed precondition of Lz4Writer: null Writer pointer";
+  if (ABSL_PREDICT_FALSE(!dest->healthy())) {
+    FailWithoutAnnotation(AnnotateOverDest(dest->status()));
+    return;
+  }
+  RecyclingPool<LZ4F_cctx, LZ4F_cctxDeleter>& pool =
+      RecyclingPool<LZ4F_cctx, LZ4F_cctxDeleter>::global(
+          recycling_pool_max_size);
+  compressor_ = pool.Get([] {
+    LZ4F_cctx* compressor = nullptr;
+    if (ABSL_PREDICT_FALSE(LZ4F_isError(
+            LZ4F_createCompressionContext(&compressor, LZ4F_VERSION)))) {
+      compressor = nullptr;
+    }
+    return std::unique_ptr<LZ4F_cctx, LZ4F_cctxDeleter>(compressor);
+  });
+  if (ABSL_PREDICT_FALSE(compressor_ == nullptr)) {
+    Fail(absl::InternalError("LZ4F_createCompressionContext() failed"));
+    return;
+  }
+  preferences_.frameInfo.blockSizeID = LZ4F_max64KB;
+  preferences_.frameInfo.blockMode = LZ4F_blockLinked;
+  preferences_.frameInfo.contentChecksumFlag =
+      store_checksum ? LZ4F_contentChecksumEnabled : LZ4F_noContentChecksum;
+  if (pledged_size_ != absl::nullopt) {
+    preferences_.frameInfo.contentSize =
+        IntCast<unsigned long long>(*pledged_size_);
+  }
+  preferences_.compressionLevel = compression_level;
+  // `LZ4F_compressBegin()` resets `compressor_` if it was recycled.
+  if (ABSL_PREDICT_FALSE(!dest->Push(LZ4F_HEADER_SIZE_MAX))) {
+    FailWithoutAnnotation(AnnotateOverDest(dest->status()));
+    return;
+  }
+  const size_t result = LZ4F_compressBegin(compressor_.get(), dest->cursor(),
+                                           dest->available(), &preferences_);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+    Fail(absl::InternalError(absl::StrCat("LZ4F_compressBegin() failed: ",
+                                          LZ4F_getErrorName(result))));
+    return;
+  }
+  dest->move_cursor(result);
+}
+
+void Lz4WriterBase::DoneBehindBuffer(absl::string_view src) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedWriter::DoneBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Writer& dest = *dest_writer();
+  if (!src.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteInternal(src, dest))) return;
+  }
+  if (pledged_size_ != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(start_pos() < *pledged_size_)) {
+      Fail(absl::FailedPreconditionError(
+          absl::StrCat("Actual size does not match pledged size: ",
+                       start_pos(), " < ", *pledged_size_)));
+      return;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Push(LZ4F_compressBound(0, &preferences_)))) {
+    FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    return;
+  }
+  const size_t result = LZ4F_compressEnd(compressor_.get(), dest.cursor(),
+                                         dest.available(), nullptr);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+    Fail(absl::InternalError(absl::StrCat("LZ4F_compressEnd() failed: ",
+                                          LZ4F_getErrorName(result))));
+    return;
+  }
+  dest.move_cursor(result);
+}
+
+void Lz4WriterBase::Done() {
+  BufferedWriter::Done();
+  compressor_.reset();
+}
+
+absl::Status Lz4WriterBase::AnnotateStatusImpl(absl::Status status) {
+  if (is_open()) {
+    Writer& dest = *dest_writer();
+    status = dest.AnnotateStatus(std::move(status));
+  }
+  // The status might have been annotated by `*dest->writer()` with the
+  // compressed position. Clarify that the current position is the uncompressed
+  // position instead of delegating to `BufferedWriter::AnnotateStatusImpl()`.
+  return AnnotateOverDest(std::move(status));
+}
+
+absl::Status Lz4WriterBase::AnnotateOverDest(absl::Status status) {
+  if (is_open()) {
+    return Annotate(status, absl::StrCat("at uncompressed byte ", pos()));
+  }
+  return status;
+}
+
+bool Lz4WriterBase::WriteInternal(absl::string_view src) {
+  RIEGELI_ASSERT(!src.empty())
+      << "Failed precondition of BufferedWriter::WriteInternal(): "
+         "nothing to write";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of BufferedWriter::WriteInternal(): " << status();
+  Writer& dest = *dest_writer();
+  return WriteInternal(src, dest);
+}
+
+bool Lz4WriterBase::WriteInternal(absl::string_view src, Writer& dest) {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of Lz4WriterBase::WriteInternal(): " << status();
+  if (ABSL_PREDICT_FALSE(src.size() >
+                         std::numeric_limits<Position>::max() - start_pos())) {
+    return FailOverflow();
+  }
+  if (pledged_size_ != absl::nullopt) {
+    const Position next_pos = start_pos() + src.size();
+    if (ABSL_PREDICT_FALSE(next_pos > *pledged_size_)) {
+      return Fail(absl::FailedPreconditionError(
+          absl::StrCat("Actual size does not match pledged size: ", next_pos,
+                       " > ", *pledged_size_)));
+    }
+  }
+  do {
+    // Compress in fragments of bounded size, so that the space requested from
+    // `dest` for the compressed fragment stays bounded too.
+    const absl::string_view fragment =
+        src.substr(0, UnsignedMin(src.size(), buffer_size()));
+    if (ABSL_PREDICT_FALSE(
+            !dest.Push(LZ4F_compressBound(fragment.size(), &preferences_)))) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
+    const size_t result = LZ4F_compressUpdate(
+        compressor_.get(), dest.cursor(), dest.available(), fragment.data(),
+        fragment.size(), nullptr);
+    if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+      return Fail(absl::InternalError(absl::StrCat(
+          "LZ4F_compressUpdate() failed: ", LZ4F_getErrorName(result))));
+    }
+    dest.move_cursor(result);
+    move_start_pos(fragment.size());
+    src.remove_prefix(fragment.size());
+  } while (!src.empty());
+  return true;
+}
+
+bool Lz4WriterBase::FlushBehindBuffer(absl::string_view src,
+                                      FlushType flush_type) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedWriter::FlushBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Writer& dest = *dest_writer();
+  if (!src.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteInternal(src, dest))) return false;
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Push(LZ4F_compressBound(0, &preferences_)))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
+  const size_t result =
+      LZ4F_flush(compressor_.get(), dest.cursor(), dest.available(), nullptr);
+  if (ABSL_PREDICT_FALSE(LZ4F_isError(result))) {
+    return Fail(absl::InternalError(
+        absl::StrCat("LZ4F_flush() failed: ", LZ4F_getErrorName(result))));
+  }
+  dest.move_cursor(result);
+  return true;
+}
+
+}  // namespace riegeli
@@ -113,6 +113,10 @@ absl::Status ParseFromCord(const absl::Cord& src,
                            ParseOptions options = ParseOptions());
 
 // Adapts a `Reader` to a `google::protobuf::io::ZeroCopyInputStream`.
+//
+// `Next()` returns the whole buffer of the `Reader`. For `ChainReader` and
+// `CordReader` this is the rest of the current `Chain` block or `absl::Cord`
+// chunk, hence parsing from them does not copy the data.
 class ReaderInputStream : public google::protobuf::io::ZeroCopyInputStream {
  public:
   explicit ReaderInputStream(Reader* src)
@@ -14,14 +14,330 @@
 
 #include "riegeli/ordered_varint/ordered_varint_reading.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+#include <limits>
+
 #include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/port.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_reading.h"
+#include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
+
+namespace {
+
+// Returns the length of an ordered varint given its first byte: the number of
+// its highest order one bits, plus 1.
+inline size_t LengthFromFirstByte(uint8_t first_byte) {
+#if RIEGELI_INTERNAL_HAS_BUILTIN(__builtin_clz) || \
+    RIEGELI_INTERNAL_IS_GCC_VERSION(3, 4)
+  // The argument has the lowest 24 bits set, hence it is not 0.
+  return IntCast<size_t>(
+             __builtin_clz(~(static_cast<unsigned>(first_byte) << 24))) +
+         1;
+#else
+  size_t length = 1;
+  while ((first_byte & 0x80) != 0) {
+    ++length;
+    first_byte <<= 1;
+  }
+  return length;
+#endif
+}
+
+// Reads an ordered varint with all bytes XORed with `mask`, which is 0 or all
+// ones.
+//
+// Precondition: `src != limit`
+inline absl::optional<const char*> ReadOrderedVarintMasked(const char* src,
+                                                           const char* limit,
+                                                           uint64_t mask,
+                                                           uint64_t& dest) {
+  const size_t length = LengthFromFirstByte(static_cast<uint8_t>(*src) ^
+                                            static_cast<uint8_t>(mask));
+  const size_t available = PtrDistance(src, limit);
+  if (ABSL_PREDICT_FALSE(available < length)) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(length == kMaxLengthOrderedVarint64)) {
+    dest = ReadBigEndian64(src + 1) ^ mask;
+    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (8 * 7))) return absl::nullopt;
+    return src + kMaxLengthOrderedVarint64;
+  }
+  // `length` is in [1..8]. The value is aligned to the end of `length` bytes,
+  // and has `7 * length` bits.
+  uint64_t word;
+  if (ABSL_PREDICT_TRUE(available >= sizeof(uint64_t))) {
+    word = ReadBigEndian64(src);
+  } else {
+    char buffer[sizeof(uint64_t)] = {};
+    std::memcpy(buffer, src, available);
+    word = ReadBigEndian64(buffer);
+  }
+  dest = ((word ^ mask) >> (8 * (8 - length))) &
+         ((uint64_t{1} << (7 * length)) - 1);
+  // Only the canonical representation is accepted. This is a no-op for
+  // `length == 1`.
+  if (ABSL_PREDICT_FALSE(dest < ((uint64_t{1} << (7 * (length - 1))) &
+                                 ~uint64_t{1}))) {
+    return absl::nullopt;
+  }
+  return src + length;
+}
+
+// Pulls an ordered varint with all bytes XORed with `mask`, which is 0 or all
+// ones, beginning at the cursor.
+//
+// Precondition: `src.available() > 0`
+template <size_t max_length>
+inline bool PullOrderedVarint(Reader& src, uint8_t mask) {
+  return src.Pull(
+      LengthFromFirstByte(static_cast<uint8_t>(*src.cursor()) ^ mask),
+      max_length);
+}
+
+inline absl::optional<const char*> ReadOrderedVarint(const char* src,
+                                                     const char* limit,
+                                                     uint32_t& dest) {
+  return ReadOrderedVarint32(src, limit, dest);
+}
+
+inline absl::optional<const char*> ReadOrderedVarint(const char* src,
+                                                     const char* limit,
+                                                     uint64_t& dest) {
+  return ReadOrderedVarint64(src, limit, dest);
+}
+
+inline bool ReadOrderedVarint(Reader& src, uint32_t& dest) {
+  return ReadOrderedVarint32(src, dest);
+}
+
+inline bool ReadOrderedVarint(Reader& src, uint64_t& dest) {
+  return ReadOrderedVarint64(src, dest);
+}
+
+// Returns the number of leading bytes below 0x80, given their highest bits of
+// 8 bytes read as a little endian number.
+inline size_t NumShortOrderedVarints(uint64_t high_bits) {
+#if RIEGELI_INTERNAL_HAS_BUILTIN(__builtin_ctzll) || \
+    RIEGELI_INTERNAL_IS_GCC_VERSION(3, 4)
+  return IntCast<size_t>(__builtin_ctzll(high_bits)) / 8;
+#else
+  size_t length = 0;
+  while ((high_bits & 0x80) == 0) {
+    high_bits >>= 8;
+    ++length;
+  }
+  return length;
+#endif
+}
+
+// Reads single-byte ordered varints 8 bytes at a time, as long as they continue
+// and both `src[]` and `dest[]` have room for 8 of them.
+template <typename T>
+inline void ReadShortOrderedVarints(const char*& src, const char* limit,
+                                    T*& dest, T* dest_limit) {
+  while (PtrDistance(src, limit) >= 8 && PtrDistance(dest, dest_limit) >= 8) {
+    const uint64_t high_bits =
+        ReadLittleEndian64(src) & uint64_t{0x8080808080808080};
+    const size_t length =
+        high_bits == 0 ? 8 : NumShortOrderedVarints(high_bits);
+    for (size_t i = 0; i < length; ++i) {
+      dest[i] = T{static_cast<uint8_t>(src[i])};
+    }
+    src += length;
+    dest += length;
+    if (length < 8) return;
+  }
+}
+
+template <typename T>
+inline absl::optional<const char*> ReadOrderedVarintsImpl(const char* src,
+                                                          const char* limit,
+                                                          absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_limit = dest_ptr + dest.size();
+  while (dest_ptr != dest_limit) {
+    ReadShortOrderedVarints(src, limit, dest_ptr, dest_limit);
+    if (dest_ptr == dest_limit) break;
+    const absl::optional<const char*> next =
+        ReadOrderedVarint(src, limit, *dest_ptr);
+    if (ABSL_PREDICT_FALSE(next == absl::nullopt)) return absl::nullopt;
+    src = *next;
+    ++dest_ptr;
+  }
+  return src;
+}
+
+template <typename T, size_t max_length>
+inline bool ReadOrderedVarintsImpl(Reader& src, absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_limit = dest_ptr + dest.size();
+  while (dest_ptr != dest_limit) {
+    if (src.available() < max_length) {
+      src.Pull(max_length,
+               UnsignedMin(PtrDistance(dest_ptr, dest_limit),
+                           std::numeric_limits<size_t>::max() / max_length) *
+                   max_length);
+      if (src.available() < max_length) {
+        // Near the end of the source.
+        if (ABSL_PREDICT_FALSE(!ReadOrderedVarint(src, *dest_ptr))) {
+          return false;
+        }
+        ++dest_ptr;
+        continue;
+      }
+    }
+    // An ordered varint which begins before `safe_limit` ends before
+    // `src.limit()`.
+    const char* cursor = src.cursor();
+    const char* const safe_limit = src.limit() - (max_length - 1);
+    do {
+      ReadShortOrderedVarints(cursor, src.limit(), dest_ptr, dest_limit);
+      if (dest_ptr == dest_limit || cursor >= safe_limit) break;
+      const absl::optional<const char*> next =
+          ReadOrderedVarint(cursor, src.limit(), *dest_ptr);
+      if (ABSL_PREDICT_FALSE(next == absl::nullopt)) return false;
+      cursor = *next;
+      ++dest_ptr;
+    } while (dest_ptr != dest_limit && cursor < safe_limit);
+    src.set_cursor(cursor);
+  }
+  return true;
+}
+
+}  // namespace
+
+absl::optional<const char*> ReadOrderedVarint32(const char* src,
+                                                const char* limit,
+                                                uint32_t& dest) {
+  if (ABSL_PREDICT_FALSE(src == limit)) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(static_cast<uint8_t>(*src) > 0xf0)) {
+    // The length is above `kMaxLengthOrderedVarint32`, or the value does not
+    // fit in `uint32_t`.
+    return absl::nullopt;
+  }
+  uint64_t value;
+  const absl::optional<const char*> cursor =
+      ReadOrderedVarintMasked(src, limit, 0, value);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+  RIEGELI_ASSERT_LE(value, std::numeric_limits<uint32_t>::max())
+      << "An ordered varint with the first byte at most 0xf0 "
+         "should fit in uint32_t";
+  dest = static_cast<uint32_t>(value);
+  return cursor;
+}
+
+absl::optional<const char*> ReadOrderedVarint64(const char* src,
+                                                const char* limit,
+                                                uint64_t& dest) {
+  if (ABSL_PREDICT_FALSE(src == limit)) return absl::nullopt;
+  return ReadOrderedVarintMasked(src, limit, 0, dest);
+}
+
+bool ReadOrderedVarints32(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadOrderedVarintsImpl<uint32_t, kMaxLengthOrderedVarint32>(src, dest);
+}
+
+bool ReadOrderedVarints64(Reader& src, absl::Span<uint64_t> dest) {
+  return ReadOrderedVarintsImpl<uint64_t, kMaxLengthOrderedVarint64>(src, dest);
+}
+
+absl::optional<const char*> ReadOrderedVarints32(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint32_t> dest) {
+  return ReadOrderedVarintsImpl(src, limit, dest);
+}
+
+absl::optional<const char*> ReadOrderedVarints64(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint64_t> dest) {
+  return ReadOrderedVarintsImpl(src, limit, dest);
+}
+
+bool ReadOrderedSignedVarint32(Reader& src, int32_t& dest) {
+  if (ABSL_PREDICT_FALSE(!src.Pull(1, kMaxLengthOrderedVarint32))) {
+    return false;
+  }
+  // A negative value has the first byte below 0x80.
+  const uint8_t mask =
+      static_cast<uint8_t>(*src.cursor()) < 0x80 ? uint8_t{0xff} : uint8_t{0};
+  if (ABSL_PREDICT_FALSE(
+          !PullOrderedVarint<kMaxLengthOrderedVarint32>(src, mask))) {
+    return false;
+  }
+  const absl::optional<const char*> cursor =
+      ReadOrderedSignedVarint32(src.cursor(), src.limit(), dest);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return false;
+  src.set_cursor(*cursor);
+  return true;
+}
+
+bool ReadOrderedSignedVarint64(Reader& src, int64_t& dest) {
+  if (ABSL_PREDICT_FALSE(!src.Pull(1, kMaxLengthOrderedVarint64))) {
+    return false;
+  }
+  // A negative value has the first byte below 0x80.
+  const uint8_t mask =
+      static_cast<uint8_t>(*src.cursor()) < 0x80 ? uint8_t{0xff} : uint8_t{0};
+  if (ABSL_PREDICT_FALSE(
+          !PullOrderedVarint<kMaxLengthOrderedVarint64>(src, mask))) {
+    return false;
+  }
+  const absl::optional<const char*> cursor =
+      ReadOrderedSignedVarint64(src.cursor(), src.limit(), dest);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return false;
+  src.set_cursor(*cursor);
+  return true;
+}
+
+absl::optional<const char*> ReadOrderedSignedVarint32(const char* src,
+                                                      const char* limit,
+                                                      int32_t& dest) {
+  if (ABSL_PREDICT_FALSE(src == limit)) return absl::nullopt;
+  // A negative value has the first byte below 0x80.
+  const uint64_t mask =
+      static_cast<uint8_t>(*src) < 0x80 ? ~uint64_t{0} : uint64_t{0};
+  uint64_t value;
+  const absl::optional<const char*> cursor =
+      ReadOrderedVarintMasked(src, limit, mask, value);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+  // `value >= 1 << 7` because its first byte is at least 0x80.
+  value -= uint64_t{1} << 7;
+  if (ABSL_PREDICT_FALSE(value >
+                         uint64_t{std::numeric_limits<int32_t>::max()})) {
+    return absl::nullopt;
+  }
+  dest = static_cast<int32_t>(static_cast<uint32_t>(value ^ mask));
+  return cursor;
+}
+
+absl::optional<const char*> ReadOrderedSignedVarint64(const char* src,
+                                                      const char* limit,
+                                                      int64_t& dest) {
+  if (ABSL_PREDICT_FALSE(src == limit)) return absl::nullopt;
+  // A negative value has the first byte below 0x80.
+  const uint64_t mask =
+      static_cast<uint8_t>(*src) < 0x80 ? ~uint64_t{0} : uint64_t{0};
+  uint64_t value;
+  const absl::optional<const char*> cursor =
+      ReadOrderedVarintMasked(src, limit, mask, value);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+  // `value >= 1 << 7` because its first byte is at least 0x80.
+  value -= uint64_t{1} << 7;
+  if (ABSL_PREDICT_FALSE(value >
+                         uint64_t{std::numeric_limits<int64_t>::max()})) {
+    return absl::nullopt;
+  }
+  dest = static_cast<int64_t>(value ^ mask);
+  return cursor;
+}
+
 namespace internal {
 
 bool ReadOrderedVarint32Slow(Reader& src, uint32_t& dest) {
@@ -30,104 +346,32 @@ bool ReadOrderedVarint32Slow(Reader& src, uint32_t& dest) {
   const uint8_t first_byte = static_cast<uint8_t>(*src.cursor());
   RIEGELI_ASSERT_GE(first_byte, 0x80)
       << "Failed precondition of ReadOrderedVarint32Slow(): length is 1";
-  if (first_byte < 0xc0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(2))) return false;
-    dest = ReadBigEndian16(src.cursor()) & ~(uint16_t{0x80} << 8);
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << 7)) return false;
-    src.move_cursor(2);
-    return true;
-  } else if (first_byte < 0xe0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(3))) return false;
-    dest = (static_cast<uint32_t>(static_cast<uint8_t>(src.cursor()[0]) &
-                                  ~uint8_t{0xc0})
-            << (2 * 8)) |
-           ReadBigEndian16(src.cursor() + 1);
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << (2 * 7))) return false;
-    src.move_cursor(3);
-    return true;
-  } else if (first_byte < 0xf0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(4))) return false;
-    dest = ReadBigEndian32(src.cursor()) & ~(uint32_t{0xe0} << (3 * 8));
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << (3 * 7))) return false;
-    src.move_cursor(4);
-    return true;
-  } else {
-    if (ABSL_PREDICT_FALSE(first_byte > 0xf0)) return false;
-    if (ABSL_PREDICT_FALSE(!src.Pull(5))) return false;
-    dest = ReadBigEndian32(src.cursor() + 1);
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << (4 * 7))) return false;
-    src.move_cursor(5);
-    return true;
+  if (ABSL_PREDICT_FALSE(first_byte > 0xf0)) return false;
+  if (ABSL_PREDICT_FALSE(
+          !PullOrderedVarint<kMaxLengthOrderedVarint32>(src, 0))) {
+    return false;
   }
+  const absl::optional<const char*> cursor =
+      ReadOrderedVarint32(src.cursor(), src.limit(), dest);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return false;
+  src.set_cursor(*cursor);
+  return true;
 }
 
 bool ReadOrderedVarint64Slow(Reader& src, uint64_t& dest) {
   RIEGELI_ASSERT_GT(src.available(), 0u)
       << "Failed precondition of ReadOrderedVarint64Slow(): no data available";
-  const uint8_t first_byte = static_cast<uint8_t>(*src.cursor());
-  RIEGELI_ASSERT_GE(first_byte, 0x80)
+  RIEGELI_ASSERT_GE(static_cast<uint8_t>(*src.cursor()), 0x80)
       << "Failed precondition of ReadOrderedVarint64Slow(): length is 1";
-  if (first_byte < 0xc0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(2))) return false;
-    dest = ReadBigEndian16(src.cursor()) & ~(uint16_t{0x80} << 8);
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << 7)) return false;
-    src.move_cursor(2);
-    return true;
-  } else if (first_byte < 0xe0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(3))) return false;
-    dest = (static_cast<uint32_t>(static_cast<uint8_t>(src.cursor()[0]) &
-                                  ~uint8_t{0xc0})
-            << (2 * 8)) |
-           ReadBigEndian16(src.cursor() + 1);
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << (2 * 7))) return false;
-    src.move_cursor(3);
-    return true;
-  } else if (first_byte < 0xf0) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(4))) return false;
-    dest = ReadBigEndian32(src.cursor()) & ~(uint32_t{0xe0} << (3 * 8));
-    if (ABSL_PREDICT_FALSE(dest < uint32_t{1} << (3 * 7))) return false;
-    src.move_cursor(4);
-    return true;
-  } else if (first_byte < 0xf8) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(5))) return false;
-    dest = (static_cast<uint64_t>(static_cast<uint8_t>(src.cursor()[0]) &
-                                  ~uint8_t{0xf0})
-            << (4 * 8)) |
-           ReadBigEndian32(src.cursor() + 1);
-    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (4 * 7))) return false;
-    src.move_cursor(5);
-    return true;
-  } else if (first_byte < 0xfc) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(6))) return false;
-    dest = (static_cast<uint64_t>(ReadBigEndian16(src.cursor()) &
-                                  ~(uint16_t{0xf8} << 8))
-            << (4 * 8)) |
-           ReadBigEndian32(src.cursor() + 2);
-    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (5 * 7))) return false;
-    src.move_cursor(6);
-    return true;
-  } else if (first_byte < 0xfe) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(7))) return false;
-    dest = (static_cast<uint64_t>(ReadBigEndian32(src.cursor()) &
-                                  ~(uint32_t{0xfc} << (3 * 8)))
-            << (3 * 8)) |
-           ReadBigEndian32(src.cursor() + 3);
-    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (6 * 7))) return false;
-    src.move_cursor(7);
-    return true;
-  } else if (first_byte < 0xff) {
-    if (ABSL_PREDICT_FALSE(!src.Pull(8))) return false;
-    dest = ReadBigEndian64(src.cursor()) & ~(uint64_t{0xfe} << (7 * 8));
-    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (7 * 7))) return false;
-    src.move_cursor(8);
-    return true;
-  } else {
-    if (ABSL_PREDICT_FALSE(!src.Pull(9))) return false;
-    dest = ReadBigEndian64(src.cursor() + 1);
-    if (ABSL_PREDICT_FALSE(dest < uint64_t{1} << (8 * 7))) return false;
-    src.move_cursor(9);
-    return true;
+  if (ABSL_PREDICT_FALSE(
+          !PullOrderedVarint<kMaxLengthOrderedVarint64>(src, 0))) {
+    return false;
   }
+  const absl::optional<const char*> cursor =
+      ReadOrderedVarint64(src.cursor(), src.limit(), dest);
+  if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return false;
+  src.set_cursor(*cursor);
+  return true;
 }
 
 }  // namespace internal
@@ -17,8 +17,12 @@
 
 #include <stdint.h>
 
+#include "absl/base/casts.h"
 #include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
 #include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
@@ -54,6 +58,89 @@ namespace riegeli {
 bool ReadOrderedVarint32(Reader& src, uint32_t& dest);
 bool ReadOrderedVarint64(Reader& src, uint64_t& dest);
 
+// Reads an ordered varint from an array, without branching on its length
+// except for the longest one.
+//
+// Return values:
+//  * updated `src`   - success (`dest` is set)
+//  * `absl::nullopt` - source ends or the ordered varint is invalid
+//                      (`dest` is undefined)
+absl::optional<const char*> ReadOrderedVarint32(const char* src,
+                                                const char* limit,
+                                                uint32_t& dest);
+absl::optional<const char*> ReadOrderedVarint64(const char* src,
+                                                const char* limit,
+                                                uint64_t& dest);
+
+// Reads an array of ordered varints.
+//
+// This is faster than reading them individually, especially if many of them
+// are short.
+//
+// Return values:
+//  * `true`                          - success (`dest[]` is filled)
+//  * `false` (when `src.healthy()`)  - source ends too early
+//                                      or an ordered varint is invalid
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+bool ReadOrderedVarints32(Reader& src, absl::Span<uint32_t> dest);
+bool ReadOrderedVarints64(Reader& src, absl::Span<uint64_t> dest);
+
+// Reads an array of ordered varints from an array.
+//
+// Return values:
+//  * updated `src`   - success (`dest[]` is filled)
+//  * `absl::nullopt` - source ends or an ordered varint is invalid
+//                      (`dest[]` is undefined)
+absl::optional<const char*> ReadOrderedVarints32(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint32_t> dest);
+absl::optional<const char*> ReadOrderedVarints64(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint64_t> dest);
+
+// Reads an ordered signed varint.
+//
+// Return values:
+//  * `true`                          - success (`dest` is set)
+//  * `false` (when `src.healthy()`)  - source ends
+//                                      or the ordered signed varint is invalid
+//                                      (`src` position is unchanged,
+//                                      `dest` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is unchanged,
+//                                      `dest` is undefined)
+bool ReadOrderedSignedVarint32(Reader& src, int32_t& dest);
+bool ReadOrderedSignedVarint64(Reader& src, int64_t& dest);
+
+// Reads an ordered signed varint from an array.
+//
+// Return values:
+//  * updated `src`   - success (`dest` is set)
+//  * `absl::nullopt` - source ends or the ordered signed varint is invalid
+//                      (`dest` is undefined)
+absl::optional<const char*> ReadOrderedSignedVarint32(const char* src,
+                                                      const char* limit,
+                                                      int32_t& dest);
+absl::optional<const char*> ReadOrderedSignedVarint64(const char* src,
+                                                      const char* limit,
+                                                      int64_t& dest);
+
+// Reads a `double` written by `WriteOrderedDouble()`.
+//
+// Return values:
+//  * `true`                          - success (`dest` is set)
+//  * `false` (when `src.healthy()`)  - source ends
+//                                      (`src` position is unchanged,
+//                                      `dest` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is unchanged,
+//                                      `dest` is undefined)
+bool ReadOrderedDouble(Reader& src, double& dest);
+
 // Implementation details follow.
 
 namespace internal {
@@ -89,6 +176,14 @@ inline bool ReadOrderedVarint64(Reader& src, uint64_t& dest) {
   return internal::ReadOrderedVarint64Slow(src, dest);
 }
 
+inline bool ReadOrderedDouble(Reader& src, double& dest) {
+  uint64_t bits;
+  if (ABSL_PREDICT_FALSE(!ReadBigEndian64(src, bits))) return false;
+  dest = absl::bit_cast<double>(
+      bits ^ ((bits >> 63) != 0 ? uint64_t{1} << 63 : ~uint64_t{0}));
+  return true;
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_ORDERED_VARINT_ORDERED_VARINT_READING_H_
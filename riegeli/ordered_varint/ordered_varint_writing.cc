@@ -14,12 +14,15 @@
 
 #include "riegeli/ordered_varint/ordered_varint_writing.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+
 #include "absl/base/optimization.h"
 #include "riegeli/base/base.h"
 #include "riegeli/bytes/writer.h"
-#include "riegeli/endian/endian_writing.h"
+#include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
 namespace internal {
@@ -27,90 +30,39 @@ namespace internal {
 bool WriteOrderedVarint32Slow(uint32_t data, Writer& dest) {
   RIEGELI_ASSERT_GE(data, uint32_t{1} << 7)
       << "Failed precondition of WriteOrderedVarint32Slow(): data too small";
-  if (data < uint32_t{1} << (2 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(2))) return false;
-    WriteBigEndian16(IntCast<uint16_t>(data) | uint16_t{0x80} << 8,
-                     dest.cursor());
-    dest.move_cursor(2);
-    return true;
-  } else if (data < uint32_t{1} << (3 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(3))) return false;
-    dest.cursor()[0] = static_cast<char>(static_cast<uint8_t>(data >> (2 * 8)) |
-                                         uint8_t{0xc0});
-    WriteBigEndian16(static_cast<uint16_t>(data), dest.cursor() + 1);
-    dest.move_cursor(3);
-    return true;
-  } else if (data < uint32_t{1} << (4 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(4))) return false;
-    WriteBigEndian32(data | uint32_t{0xe0} << (3 * 8), dest.cursor());
-    dest.move_cursor(4);
-    return true;
-  } else {
-    if (ABSL_PREDICT_FALSE(!dest.Push(5))) return false;
-    dest.cursor()[0] = static_cast<char>(0xf0);
-    WriteBigEndian32(data, dest.cursor() + 1);
-    dest.move_cursor(5);
+  const size_t length = LengthOrderedVarint32(data);
+  if (ABSL_PREDICT_FALSE(!dest.Push(length, kMaxLengthOrderedVarint32))) {
+    return false;
+  }
+  if (ABSL_PREDICT_TRUE(dest.available() >= kMaxLengthOrderedVarint32)) {
+    dest.set_cursor(WriteOrderedVarint32(data, dest.cursor()));
     return true;
   }
+  // `WriteOrderedVarint32()` may overwrite more than `length` bytes.
+  char buffer[kMaxLengthOrderedVarint32];
+  WriteOrderedVarint32(data, buffer);
+  std::memcpy(dest.cursor(), buffer, length);
+  dest.move_cursor(length);
+  return true;
 }
 
 bool WriteOrderedVarint64Slow(uint64_t data, Writer& dest) {
   RIEGELI_ASSERT_GE(data, uint64_t{1} << 7)
       << "Failed precondition of WriteOrderedVarint64Slow(): data too small";
-  if (data < uint64_t{1} << (2 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(2))) return false;
-    WriteBigEndian16(IntCast<uint16_t>(data) | uint16_t{0x80} << 8,
-                     dest.cursor());
-    dest.move_cursor(2);
-    return true;
-  } else if (data < uint64_t{1} << (3 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(3))) return false;
-    dest.cursor()[0] = static_cast<char>(static_cast<uint8_t>(data >> (2 * 8)) |
-                                         uint8_t{0xc0});
-    WriteBigEndian16(static_cast<uint16_t>(data), dest.cursor() + 1);
-    dest.move_cursor(3);
-    return true;
-  } else if (data < uint64_t{1} << (4 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(4))) return false;
-    WriteBigEndian32(IntCast<uint32_t>(data) | uint32_t{0xe0} << (3 * 8),
-                     dest.cursor());
-    dest.move_cursor(4);
-    return true;
-  } else if (data < uint64_t{1} << (5 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(5))) return false;
-    dest.cursor()[0] = static_cast<char>(static_cast<uint8_t>(data >> (4 * 8)) |
-                                         uint8_t{0xf0});
-    WriteBigEndian32(static_cast<uint32_t>(data), dest.cursor() + 1);
-    dest.move_cursor(5);
-    return true;
-  } else if (data < uint64_t{1} << (6 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(6))) return false;
-    WriteBigEndian16(
-        static_cast<uint16_t>(data >> (4 * 8)) | uint16_t{0xf8} << 8,
-        dest.cursor());
-    WriteBigEndian32(static_cast<uint32_t>(data), dest.cursor() + 2);
-    dest.move_cursor(6);
-    return true;
-  } else if (data < uint64_t{1} << (7 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(7))) return false;
-    WriteBigEndian32(
-        static_cast<uint32_t>(data >> (3 * 8)) | uint32_t{0xfc} << (3 * 8),
-        dest.cursor());
-    WriteBigEndian32(static_cast<uint32_t>(data), dest.cursor() + 3);
-    dest.move_cursor(7);
-    return true;
-  } else if (data < uint64_t{1} << (8 * 7)) {
-    if (ABSL_PREDICT_FALSE(!dest.Push(8))) return false;
-    WriteBigEndian64(data | uint64_t{0xfe} << (7 * 8), dest.cursor());
-    dest.move_cursor(8);
-    return true;
-  } else {
-    if (ABSL_PREDICT_FALSE(!dest.Push(9))) return false;
-    dest.cursor()[0] = static_cast<char>(0xff);
-    WriteBigEndian64(data, dest.cursor() + 1);
-    dest.move_cursor(9);
+  const size_t length = LengthOrderedVarint64(data);
+  if (ABSL_PREDICT_FALSE(!dest.Push(length, kMaxLengthOrderedVarint64))) {
+    return false;
+  }
+  if (ABSL_PREDICT_TRUE(dest.available() >= kMaxLengthOrderedVarint64)) {
+    dest.set_cursor(WriteOrderedVarint64(data, dest.cursor()));
     return true;
   }
+  // `WriteOrderedVarint64()` may overwrite more than `length` bytes.
+  char buffer[kMaxLengthOrderedVarint64];
+  WriteOrderedVarint64(data, buffer);
+  std::memcpy(dest.cursor(), buffer, length);
+  dest.move_cursor(length);
+  return true;
 }
 
 }  // namespace internal
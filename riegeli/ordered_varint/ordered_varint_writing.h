@@ -18,10 +18,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
+
+#include "absl/base/casts.h"
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/port.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
 #include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
@@ -54,11 +59,84 @@ namespace riegeli {
 bool WriteOrderedVarint32(uint32_t data, Writer& dest);
 bool WriteOrderedVarint64(uint64_t data, Writer& dest);
 
+// Writes an array of ordered varints.
+//
+// This is faster than writing them individually, because space is requested
+// from `dest` for many ordered varints at once.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteOrderedVarints32(absl::Span<const uint32_t> data, Writer& dest);
+bool WriteOrderedVarints64(absl::Span<const uint64_t> data, Writer& dest);
+
 // Returns the length needed to write a given value as an ordered varint, which
 // is at most `kMaxLengthOrderedVarint{32,64}`.
 size_t LengthOrderedVarint32(uint32_t data);
 size_t LengthOrderedVarint64(uint64_t data);
 
+// Writes an ordered varint, without branching on its length except for the
+// longest one.
+//
+// Writes `LengthOrderedVarint{32,64}(data)` bytes to `dest[]`, but may
+// overwrite up to `kMaxLengthOrderedVarint{32,64}` bytes.
+//
+// Returns the updated `dest` after the written value.
+char* WriteOrderedVarint32(uint32_t data, char* dest);
+char* WriteOrderedVarint64(uint64_t data, char* dest);
+
+// An ordered signed varint represents a signed integer in a variable number of
+// bytes, such that smaller values are represented by lexicographically smaller
+// strings, and also values with a smaller magnitude tend to be represented by
+// shorter strings.
+//
+// Encoding a value X:
+//
+// If X >= 0, then X + 128 is encoded as an ordered varint. Its first byte is at
+// least 0x80.
+//
+// If X < 0, then ~X + 128 is encoded as an ordered varint, and all bytes of the
+// encoding are complemented. Its first byte is at most 0x7f. Since the length
+// of an ordered varint is determined by its first byte, complementing reverses
+// the lexicographic order.
+//
+// Values in [-16256..16255] are encoded in 2 bytes.
+
+// Writes an ordered signed varint.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteOrderedSignedVarint32(int32_t data, Writer& dest);
+bool WriteOrderedSignedVarint64(int64_t data, Writer& dest);
+
+// Returns the length needed to write a given value as an ordered signed varint,
+// which is at most `kMaxLengthOrderedVarint{32,64}`.
+size_t LengthOrderedSignedVarint32(int32_t data);
+size_t LengthOrderedSignedVarint64(int64_t data);
+
+// Writes an ordered signed varint.
+//
+// Writes `LengthOrderedSignedVarint{32,64}(data)` bytes to `dest[]`, but may
+// overwrite up to `kMaxLengthOrderedVarint{32,64}` bytes.
+//
+// Returns the updated `dest` after the written value.
+char* WriteOrderedSignedVarint32(int32_t data, char* dest);
+char* WriteOrderedSignedVarint64(int64_t data, char* dest);
+
+// Writes a `double` in 8 bytes, such that smaller values are represented by
+// lexicographically smaller strings.
+//
+// The sign bit is flipped for non-negative values, and all bits are flipped
+// for negative values, and the result is written in big endian. Hence -0.0
+// sorts before 0.0, and NaNs with the sign bit set sort before -infinity, and
+// other NaNs sort after infinity.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteOrderedDouble(double data, Writer& dest);
+
 // Implementation details follow.
 
 namespace internal {
@@ -66,6 +144,88 @@ namespace internal {
 bool WriteOrderedVarint32Slow(uint32_t data, Writer& dest);
 bool WriteOrderedVarint64Slow(uint64_t data, Writer& dest);
 
+// Writes an ordered varint with all bytes XORed with `mask`, which is 0 or all
+// ones.
+inline char* WriteOrderedVarint32Masked(uint32_t data, uint32_t mask,
+                                        char* dest) {
+  const size_t length = LengthOrderedVarint32(data);
+  if (ABSL_PREDICT_FALSE(length == kMaxLengthOrderedVarint32)) {
+    dest[0] = static_cast<char>(uint8_t{0xf0} ^ static_cast<uint8_t>(mask));
+    WriteBigEndian32(data ^ mask, dest + 1);
+    return dest + kMaxLengthOrderedVarint32;
+  }
+  // `length` is in [1..4]. The first byte begins with `length - 1` one bits
+  // followed by a zero bit, and the value is aligned to the end of `length`
+  // bytes.
+  const uint32_t prefix = uint32_t{(0xffu << (9 - length)) & 0xff} << (3 * 8);
+  WriteBigEndian32(((data << (8 * (4 - length))) | prefix) ^ mask, dest);
+  return dest + length;
+}
+
+inline char* WriteOrderedVarint64Masked(uint64_t data, uint64_t mask,
+                                        char* dest) {
+  const size_t length = LengthOrderedVarint64(data);
+  if (ABSL_PREDICT_FALSE(length == kMaxLengthOrderedVarint64)) {
+    dest[0] = static_cast<char>(uint8_t{0xff} ^ static_cast<uint8_t>(mask));
+    WriteBigEndian64(data ^ mask, dest + 1);
+    return dest + kMaxLengthOrderedVarint64;
+  }
+  // `length` is in [1..8]. The first byte begins with `length - 1` one bits
+  // followed by a zero bit, and the value is aligned to the end of `length`
+  // bytes.
+  const uint64_t prefix = uint64_t{(0xffu << (9 - length)) & 0xff} << (7 * 8);
+  WriteBigEndian64(((data << (8 * (8 - length))) | prefix) ^ mask, dest);
+  return dest + length;
+}
+
+// Mapping of ordered signed varints to ordered varints, and the mask to XOR
+// the encoding with.
+inline uint32_t OrderedSignedVarint32Mask(int32_t data) {
+  return data < 0 ? ~uint32_t{0} : uint32_t{0};
+}
+inline uint64_t OrderedSignedVarint64Mask(int64_t data) {
+  return data < 0 ? ~uint64_t{0} : uint64_t{0};
+}
+inline uint32_t OrderedSignedVarint32Value(int32_t data) {
+  return (static_cast<uint32_t>(data) ^ OrderedSignedVarint32Mask(data)) +
+         (uint32_t{1} << 7);
+}
+inline uint64_t OrderedSignedVarint64Value(int64_t data) {
+  return (static_cast<uint64_t>(data) ^ OrderedSignedVarint64Mask(data)) +
+         (uint64_t{1} << 7);
+}
+
+inline char* WriteOrderedVarint(uint32_t data, char* dest) {
+  return WriteOrderedVarint32(data, dest);
+}
+inline char* WriteOrderedVarint(uint64_t data, char* dest) {
+  return WriteOrderedVarint64(data, dest);
+}
+
+template <typename T, size_t max_length>
+inline bool WriteOrderedVarints(absl::Span<const T> data, Writer& dest) {
+  const T* iter = data.data();
+  const T* const end = iter + data.size();
+  while (iter != end) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            max_length,
+            UnsignedMin(PtrDistance(iter, end),
+                        std::numeric_limits<size_t>::max() / max_length) *
+                max_length))) {
+      return false;
+    }
+    // Write as many ordered varints as certainly fit in the buffer, including
+    // bytes which they may overwrite.
+    char* cursor = dest.cursor();
+    const char* const safe_limit = dest.limit() - (max_length - 1);
+    do {
+      cursor = WriteOrderedVarint(*iter++, cursor);
+    } while (iter != end && cursor < safe_limit);
+    dest.set_cursor(cursor);
+  }
+  return true;
+}
+
 }  // namespace internal
 
 inline bool WriteOrderedVarint32(uint32_t data, Writer& dest) {
@@ -82,6 +242,18 @@ inline bool WriteOrderedVarint64(uint64_t data, Writer& dest) {
   return internal::WriteOrderedVarint64Slow(data, dest);
 }
 
+inline bool WriteOrderedVarints32(absl::Span<const uint32_t> data,
+                                  Writer& dest) {
+  return internal::WriteOrderedVarints<uint32_t, kMaxLengthOrderedVarint32>(
+      data, dest);
+}
+
+inline bool WriteOrderedVarints64(absl::Span<const uint64_t> data,
+                                  Writer& dest) {
+  return internal::WriteOrderedVarints<uint64_t, kMaxLengthOrderedVarint64>(
+      data, dest);
+}
+
 inline size_t LengthOrderedVarint32(uint32_t data) {
 #if RIEGELI_INTERNAL_HAS_BUILTIN(__builtin_clz) || \
     RIEGELI_INTERNAL_IS_GCC_VERSION(3, 4)
@@ -120,6 +292,52 @@ inline size_t LengthOrderedVarint64(uint64_t data) {
 #endif
 }
 
+inline char* WriteOrderedVarint32(uint32_t data, char* dest) {
+  return internal::WriteOrderedVarint32Masked(data, 0, dest);
+}
+
+inline char* WriteOrderedVarint64(uint64_t data, char* dest) {
+  return internal::WriteOrderedVarint64Masked(data, 0, dest);
+}
+
+inline bool WriteOrderedSignedVarint32(int32_t data, Writer& dest) {
+  if (ABSL_PREDICT_FALSE(!dest.Push(kMaxLengthOrderedVarint32))) return false;
+  dest.set_cursor(WriteOrderedSignedVarint32(data, dest.cursor()));
+  return true;
+}
+
+inline bool WriteOrderedSignedVarint64(int64_t data, Writer& dest) {
+  if (ABSL_PREDICT_FALSE(!dest.Push(kMaxLengthOrderedVarint64))) return false;
+  dest.set_cursor(WriteOrderedSignedVarint64(data, dest.cursor()));
+  return true;
+}
+
+inline size_t LengthOrderedSignedVarint32(int32_t data) {
+  return LengthOrderedVarint32(internal::OrderedSignedVarint32Value(data));
+}
+
+inline size_t LengthOrderedSignedVarint64(int64_t data) {
+  return LengthOrderedVarint64(internal::OrderedSignedVarint64Value(data));
+}
+
+inline char* WriteOrderedSignedVarint32(int32_t data, char* dest) {
+  return internal::WriteOrderedVarint32Masked(
+      internal::OrderedSignedVarint32Value(data),
+      internal::OrderedSignedVarint32Mask(data), dest);
+}
+
+inline char* WriteOrderedSignedVarint64(int64_t data, char* dest) {
+  return internal::WriteOrderedVarint64Masked(
+      internal::OrderedSignedVarint64Value(data),
+      internal::OrderedSignedVarint64Mask(data), dest);
+}
+
+inline bool WriteOrderedDouble(double data, Writer& dest) {
+  const uint64_t bits = absl::bit_cast<uint64_t>(data);
+  return WriteBigEndian64(
+      bits ^ ((bits >> 63) != 0 ? ~uint64_t{0} : uint64_t{1} << 63), dest);
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_ORDERED_VARINT_ORDERED_VARINT_WRITING_H_
@@ -18,9 +18,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "absl/base/optimization.h"
 #include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/hash.h"
 #include "riegeli/endian/endian_reading.h"
 #include "riegeli/endian/endian_writing.h"
@@ -73,70 +76,120 @@ class BlockHeader {
   char bytes_[3 * sizeof(uint64_t)];
 };
 
+// The default block size, and the only block size of files with a file
+// signature which does not declare a block size.
 RIEGELI_INTERNAL_INLINE_CONSTEXPR(Position, kBlockSize, Position{1} << 16);
 
-RIEGELI_INTERNAL_INLINE_CONSTEXPR(Position, kUsableBlockSize,
-                                  kBlockSize - BlockHeader::size());
+// The maximum block size which a file signature can declare.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(Position, kMaxBlockSize, Position{1} << 24);
+
+// Whether `block_size` can be declared by a file signature: a power of 2 in
+// the range [`kBlockSize`..`kMaxBlockSize`].
+inline bool IsValidBlockSize(Position block_size) {
+  return block_size >= kBlockSize && block_size <= kMaxBlockSize &&
+         (block_size & (block_size - 1)) == 0;
+}
+
+// The header of the file signature declaring `block_size`.
+//
+// A file with the default block size has all the fields except `chunk_type`
+// zero, so that it is readable by readers which do not support other block
+// sizes. Otherwise `decoded_data_size` is the block size.
+inline ChunkHeader FileSignatureHeader(Position block_size) {
+  RIEGELI_ASSERT(IsValidBlockSize(block_size))
+      << "Failed precondition of FileSignatureHeader(): invalid block size";
+  return ChunkHeader(Chain(), ChunkType::kFileSignature, 0,
+                     block_size == kBlockSize ? 0 : block_size);
+}
+
+// The block size declared by the header of a file signature, or 0 if it is not
+// a valid block size.
+inline Position BlockSizeFromFileSignature(const ChunkHeader& header) {
+  if (header.decoded_data_size() == 0) return kBlockSize;
+  if (ABSL_PREDICT_FALSE(header.decoded_data_size() == kBlockSize ||
+                         !IsValidBlockSize(header.decoded_data_size()))) {
+    return 0;
+  }
+  return header.decoded_data_size();
+}
+
+// The usable part of a block, after its block header.
+inline Position UsableBlockSize(Position block_size) {
+  return block_size - BlockHeader::size();
+}
 
 // Whether `pos` is a block boundary (immediately before a block header).
-inline bool IsBlockBoundary(Position pos) { return pos % kBlockSize == 0; }
+inline bool IsBlockBoundary(Position pos, Position block_size) {
+  return pos % block_size == 0;
+}
 
 // The nearest block boundary at or before `pos`.
-inline Position RoundDownToBlockBoundary(Position pos) {
-  return pos - pos % kBlockSize;
+inline Position RoundDownToBlockBoundary(Position pos, Position block_size) {
+  return pos - pos % block_size;
 }
 
 // How many bytes remain until the end of the block (0 at a block boundary).
-inline Position RemainingInBlock(Position pos) { return (-pos) % kBlockSize; }
+inline Position RemainingInBlock(Position pos, Position block_size) {
+  return (-pos) % block_size;
+}
 
 // Whether `pos` is a possible chunk boundary (not inside nor immediately after
 // a block header).
-inline bool IsPossibleChunkBoundary(Position pos) {
-  return RemainingInBlock(pos) < kUsableBlockSize;
+inline bool IsPossibleChunkBoundary(Position pos, Position block_size) {
+  return RemainingInBlock(pos, block_size) < UsableBlockSize(block_size);
 }
 
 // The nearest possible chunk boundary at or after `pos` (chunk boundaries are
 // not valid inside or immediately after a block header).
-inline Position RoundUpToPossibleChunkBoundary(Position pos) {
-  return pos + SaturatingSub(RemainingInBlock(pos), kUsableBlockSize - 1);
+inline Position RoundUpToPossibleChunkBoundary(Position pos,
+                                               Position block_size) {
+  return pos + SaturatingSub(RemainingInBlock(pos, block_size),
+                             UsableBlockSize(block_size) - 1);
 }
 
 // If `pos` is immediately before or inside a block header, how many bytes
 // remain until the end of the block header, otherwise 0.
-inline size_t RemainingInBlockHeader(Position pos) {
-  return SaturatingSub(BlockHeader::size(), IntCast<size_t>(pos % kBlockSize));
+inline size_t RemainingInBlockHeader(Position pos, Position block_size) {
+  return SaturatingSub(BlockHeader::size(), IntCast<size_t>(pos % block_size));
 }
 
 // For a chunk beginning at `chunk_begin`, the position after `length`, adding
 // intervening block headers.
-inline Position AddWithOverhead(Position chunk_begin, Position length) {
-  RIEGELI_ASSERT_LT(RemainingInBlock(chunk_begin), kUsableBlockSize)
+inline Position AddWithOverhead(Position chunk_begin, Position length,
+                                Position block_size) {
+  const Position usable_block_size = UsableBlockSize(block_size);
+  RIEGELI_ASSERT_LT(RemainingInBlock(chunk_begin, block_size),
+                    usable_block_size)
       << "Failed precondition of AddWithOverhead(): invalid chunk boundary";
   const Position num_overhead_blocks =
-      (length + (chunk_begin + kUsableBlockSize - 1) % kBlockSize) /
-      kUsableBlockSize;
+      (length + (chunk_begin + usable_block_size - 1) % block_size) /
+      usable_block_size;
   return chunk_begin + length + num_overhead_blocks * BlockHeader::size();
 }
 
 // For a chunk beginning at `chunk_begin`, the length until `pos`, subtracting
 // intervening block headers.
-inline Position DistanceWithoutOverhead(Position chunk_begin, Position pos) {
+inline Position DistanceWithoutOverhead(Position chunk_begin, Position pos,
+                                        Position block_size) {
   RIEGELI_ASSERT_LE(chunk_begin, pos)
       << "Failed precondition of DistanceWithoutOverhead(): "
          "positions in the wrong order";
   const Position num_overhead_blocks =
-      pos / kBlockSize - chunk_begin / kBlockSize;
-  return (pos - UnsignedMin(pos % kBlockSize, BlockHeader::size())) -
+      pos / block_size - chunk_begin / block_size;
+  return (pos - UnsignedMin(pos % block_size, BlockHeader::size())) -
          (chunk_begin -
-          UnsignedMin(chunk_begin % kBlockSize, BlockHeader::size())) -
+          UnsignedMin(chunk_begin % block_size, BlockHeader::size())) -
          num_overhead_blocks * BlockHeader::size();
 }
 
 // The position after a chunk which begins at `chunk_begin`.
-inline Position ChunkEnd(const ChunkHeader& header, Position chunk_begin) {
+inline Position ChunkEnd(const ChunkHeader& header, Position chunk_begin,
+                         Position block_size) {
   return UnsignedMax(
-      AddWithOverhead(chunk_begin, header.size() + header.data_size()),
-      RoundUpToPossibleChunkBoundary(chunk_begin + header.num_records()));
+      AddWithOverhead(chunk_begin, header.size() + header.data_size(),
+                      block_size),
+      RoundUpToPossibleChunkBoundary(chunk_begin + header.num_records(),
+                                     block_size));
 }
 
 }  // namespace internal
@@ -0,0 +1,104 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/records/chunk_cache.h"
+
+#include <stddef.h>
+
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+ChunkCache::ChunkCache(size_t max_size, size_t num_shards)
+    : max_size_(max_size),
+      num_shards_(num_shards),
+      max_shard_size_(max_size / num_shards),
+      shards_(std::make_unique<Shard[]>(num_shards)) {
+  RIEGELI_ASSERT_GT(num_shards, 0u)
+      << "Failed precondition of ChunkCache::ChunkCache(): zero shards";
+}
+
+inline ChunkCache::Shard& ChunkCache::GetShard(Key key) const {
+  return shards_[absl::Hash<Key>()(key) % num_shards_];
+}
+
+inline void ChunkCache::Shard::Erase(std::list<Node>::iterator iter) {
+  size -= iter->size;
+  index.erase(Key(iter->file_id, iter->chunk_begin));
+  lru.erase(iter);
+}
+
+size_t ChunkCache::size() const {
+  size_t size = 0;
+  for (size_t i = 0; i < num_shards_; ++i) {
+    absl::MutexLock lock(&shards_[i].mutex);
+    size += shards_[i].size;
+  }
+  return size;
+}
+
+std::shared_ptr<const ChunkCache::Entry> ChunkCache::Find(
+    absl::string_view file_id, Position chunk_begin) {
+  const Key key(file_id, chunk_begin);
+  Shard& shard = GetShard(key);
+  absl::MutexLock lock(&shard.mutex);
+  const auto found = shard.index.find(key);
+  if (found == shard.index.end()) return nullptr;
+  shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+  return found->second->entry;
+}
+
+void ChunkCache::Insert(absl::string_view file_id, Position chunk_begin,
+                        Entry entry) {
+  const size_t size =
+      sizeof(Node) + file_id.size() + sizeof(Entry) +
+      entry.records.MemoryUsage();
+  if (size > max_shard_size_) return;
+  std::shared_ptr<const Entry> shared_entry =
+      std::make_shared<const Entry>(std::move(entry));
+  Shard& shard = GetShard(Key(file_id, chunk_begin));
+  absl::MutexLock lock(&shard.mutex);
+  const auto found = shard.index.find(Key(file_id, chunk_begin));
+  if (found != shard.index.end()) shard.Erase(found->second);
+  while (shard.size > max_shard_size_ - size) {
+    shard.Erase(std::prev(shard.lru.end()));
+  }
+  shard.lru.push_front(
+      Node{std::string(file_id), chunk_begin, size, std::move(shared_entry)});
+  shard.index.emplace(Key(shard.lru.front().file_id, chunk_begin),
+                      shard.lru.begin());
+  shard.size += size;
+}
+
+void ChunkCache::Clear() {
+  for (size_t i = 0; i < num_shards_; ++i) {
+    Shard& shard = shards_[i];
+    absl::MutexLock lock(&shard.mutex);
+    shard.index.clear();
+    shard.lru.clear();
+    shard.size = 0;
+  }
+}
+
+}  // namespace riegeli
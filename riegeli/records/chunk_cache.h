@@ -0,0 +1,129 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_RECORDS_CHUNK_CACHE_H_
+#define RIEGELI_RECORDS_CHUNK_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+
+namespace riegeli {
+
+// Caches decoded chunks of Riegeli/records files, keyed by file identity and
+// chunk begin position, so that repeated `RecordReader::Seek()` or `Search()`
+// near the same records decodes the chunk once. The least recently used chunks
+// are evicted when the memory usage exceeds `max_size()`.
+//
+// A `ChunkCache` can be shared by all `RecordReader`s of a process, see
+// `RecordReaderBase::Options::set_chunk_cache()`. Readers of the same file
+// with the same field projection and record filter must use the same file
+// identity, and other readers must use different file identities.
+//
+// Chunks are distributed among shards by their key. Each shard has its own
+// lock and keeps up to `max_size() / num_shards()` bytes, so that concurrent
+// readers rarely contend.
+//
+// `ChunkCache` is thread-safe.
+class ChunkCache {
+ public:
+  // A cached chunk.
+  struct Entry {
+    // Records of the chunk.
+    ChunkDecoder::DecodedRecords records;
+    // Position of the chunk following this chunk and its statistics, if any.
+    Position next_chunk_begin = 0;
+  };
+
+  // Creates a `ChunkCache` keeping up to `max_size` bytes of decoded chunks
+  // in `num_shards` shards.
+  //
+  // Precondition: `num_shards > 0`
+  explicit ChunkCache(size_t max_size, size_t num_shards = 16);
+
+  ChunkCache(const ChunkCache&) = delete;
+  ChunkCache& operator=(const ChunkCache&) = delete;
+
+  // Returns the maximum memory usage, as given to the constructor.
+  size_t max_size() const { return max_size_; }
+
+  // Returns the number of shards, as given to the constructor.
+  size_t num_shards() const { return num_shards_; }
+
+  // Returns the current memory usage.
+  size_t size() const;
+
+  // Returns the cached chunk of the file identified by `file_id` beginning at
+  // `chunk_begin` and marks it as the most recently used, or returns `nullptr`
+  // if it is not cached.
+  //
+  // The returned `Entry` remains valid after it is evicted.
+  std::shared_ptr<const Entry> Find(absl::string_view file_id,
+                                    Position chunk_begin);
+
+  // Caches the chunk of the file identified by `file_id` beginning at
+  // `chunk_begin`, replacing the entry with the same key if any, and evicts
+  // the least recently used chunks of its shard to fit. A chunk larger than
+  // `max_size() / num_shards()` is not cached.
+  void Insert(absl::string_view file_id, Position chunk_begin, Entry entry);
+
+  // Removes all cached chunks.
+  void Clear();
+
+ private:
+  struct Node {
+    std::string file_id;
+    Position chunk_begin;
+    size_t size;
+    std::shared_ptr<const Entry> entry;
+  };
+
+  // The key of `index`, where `absl::string_view` points to `Node::file_id`.
+  using Key = std::pair<absl::string_view, Position>;
+
+  struct Shard {
+    void Erase(std::list<Node>::iterator iter)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+
+    mutable absl::Mutex mutex;
+    // Most recently used first.
+    std::list<Node> lru ABSL_GUARDED_BY(mutex);
+    absl::flat_hash_map<Key, std::list<Node>::iterator> index
+        ABSL_GUARDED_BY(mutex);
+    size_t size ABSL_GUARDED_BY(mutex) = 0;
+  };
+
+  Shard& GetShard(Key key) const;
+
+  size_t max_size_;
+  size_t num_shards_;
+  size_t max_shard_size_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_CHUNK_CACHE_H_
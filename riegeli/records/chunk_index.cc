@@ -0,0 +1,134 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/chunk_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+void ChunkIndex::Add(Position chunk_begin, uint64_t num_records) {
+  RIEGELI_ASSERT_GT(num_records, 0u)
+      << "Failed precondition of ChunkIndex::Add(): no records";
+  RIEGELI_ASSERT(empty() || chunk_begin > chunk_begins_.back())
+      << "Failed precondition of ChunkIndex::Add(): "
+         "chunks added in the wrong order";
+  RIEGELI_ASSERT_LE(num_records, kMaxNumRecords - this->num_records())
+      << "Failed precondition of ChunkIndex::Add(): too many records";
+  records_ends_.push_back(this->num_records() + num_records);
+  chunk_begins_.push_back(chunk_begin);
+}
+
+absl::optional<size_t> ChunkIndex::ChunkBefore(Position pos) const {
+  const std::vector<Position>::const_iterator next =
+      std::upper_bound(chunk_begins_.begin(), chunk_begins_.end(), pos);
+  if (next == chunk_begins_.begin()) return absl::nullopt;
+  return IntCast<size_t>(std::distance(chunk_begins_.begin(), next) - 1);
+}
+
+absl::optional<size_t> ChunkIndex::ChunkContainingRecord(
+    uint64_t record_number) const {
+  const std::vector<uint64_t>::const_iterator found = std::upper_bound(
+      records_ends_.begin(), records_ends_.end(), record_number);
+  if (found == records_ends_.end()) return absl::nullopt;
+  return IntCast<size_t>(std::distance(records_ends_.begin(), found));
+}
+
+// Format of chunk index chunk data, all integers are varint64:
+//  * `index_pos`  - position of the chunk index chunk itself
+//  * `num_chunks` - number of chunks with records
+//  * for each chunk with records:
+//    * distance from the beginning of the previous chunk with records (from 0
+//      for the first chunk)
+//    * number of records in the chunk
+void ChunkIndex::Encode(Position index_pos, Chunk& chunk) const {
+  RIEGELI_ASSERT(empty() || index_pos > chunk_begins_.back())
+      << "Failed precondition of ChunkIndex::Encode(): "
+         "index position before indexed chunks";
+  chunk.Clear();
+  ChainWriter<> data_writer(&chunk.data);
+  WriteVarint64(index_pos, data_writer);
+  WriteVarint64(IntCast<uint64_t>(size()), data_writer);
+  Position prev_chunk_begin = 0;
+  for (size_t i = 0; i < size(); ++i) {
+    WriteVarint64(chunk_begins_[i] - prev_chunk_begin, data_writer);
+    WriteVarint64(num_records(i), data_writer);
+    prev_chunk_begin = chunk_begins_[i];
+  }
+  if (!data_writer.Close()) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << data_writer.status();
+  }
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kChunkIndex, 0, 0);
+}
+
+bool ChunkIndex::Decode(const Chunk& chunk, Position index_pos) {
+  Clear();
+  if (ABSL_PREDICT_FALSE(chunk.header.chunk_type() != ChunkType::kChunkIndex ||
+                         chunk.header.num_records() != 0)) {
+    return false;
+  }
+  ChainReader<> data_reader(&chunk.data);
+  uint64_t stored_index_pos;
+  uint64_t num_chunks;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, stored_index_pos) ||
+                         stored_index_pos != index_pos ||
+                         !ReadVarint64(data_reader, num_chunks))) {
+    return false;
+  }
+  if (ABSL_PREDICT_FALSE(num_chunks > data_reader.Size().value_or(0) / 2)) {
+    // Each chunk is encoded by at least two bytes.
+    return false;
+  }
+  chunk_begins_.reserve(IntCast<size_t>(num_chunks));
+  records_ends_.reserve(IntCast<size_t>(num_chunks));
+  Position chunk_begin = 0;
+  for (uint64_t i = 0; i < num_chunks; ++i) {
+    uint64_t distance;
+    uint64_t num_records;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, distance) ||
+                           !ReadVarint64(data_reader, num_records) ||
+                           (i > 0 && distance == 0) ||
+                           distance >= index_pos - chunk_begin ||
+                           num_records == 0 ||
+                           num_records >
+                               kMaxNumRecords - this->num_records())) {
+      Clear();
+      return false;
+    }
+    chunk_begin += distance;
+    Add(chunk_begin, num_records);
+  }
+  if (ABSL_PREDICT_FALSE(!data_reader.VerifyEndAndClose())) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace riegeli
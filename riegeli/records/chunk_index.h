@@ -0,0 +1,167 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_CHUNK_INDEX_H_
+#define RIEGELI_RECORDS_CHUNK_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk.h"
+
+namespace riegeli {
+
+// Positions of chunks containing records of a Riegeli/records file, together
+// with numbers of records they contain.
+//
+// `RecordWriter` writes a chunk index chunk at the end of the file if
+// `RecordWriterBase::Options::chunk_index()` is `true`. `RecordReader` loads it
+// lazily to locate chunks without searching for them.
+class ChunkIndex {
+ public:
+  // Creates an empty `ChunkIndex`.
+  ChunkIndex() noexcept {}
+
+  ChunkIndex(const ChunkIndex& that);
+  ChunkIndex& operator=(const ChunkIndex& that);
+
+  ChunkIndex(ChunkIndex&& that) noexcept;
+  ChunkIndex& operator=(ChunkIndex&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `ChunkIndex`.
+  void Clear();
+
+  // Adds a chunk with records.
+  //
+  // Preconditions:
+  //   `num_records > 0`
+  //   `empty() || chunk_begin > this->chunk_begin(size() - 1)`
+  void Add(Position chunk_begin, uint64_t num_records);
+
+  // Returns the number of chunks.
+  size_t size() const { return chunk_begins_.size(); }
+  bool empty() const { return chunk_begins_.empty(); }
+
+  // Returns the position of the `chunk_index`-th chunk.
+  //
+  // Precondition: `chunk_index < size()`
+  Position chunk_begin(size_t chunk_index) const;
+
+  // Returns the number of records in chunks before the `chunk_index`-th chunk.
+  //
+  // Precondition: `chunk_index <= size()`
+  uint64_t records_before(size_t chunk_index) const;
+
+  // Returns the number of records in the `chunk_index`-th chunk.
+  //
+  // Precondition: `chunk_index < size()`
+  uint64_t num_records(size_t chunk_index) const;
+
+  // Returns the number of records in all chunks.
+  uint64_t num_records() const { return records_before(size()); }
+
+  // Returns the index of the last chunk which begins at or before `pos`, or
+  // `absl::nullopt` if there is no such chunk.
+  absl::optional<size_t> ChunkBefore(Position pos) const;
+
+  // Returns the index of the chunk containing the record with the given number
+  // (counting records in all chunks from 0), or `absl::nullopt` if
+  // `record_number >= num_records()`.
+  absl::optional<size_t> ChunkContainingRecord(uint64_t record_number) const;
+
+  // Encodes the index as a chunk index chunk which will be written at
+  // `index_pos`.
+  //
+  // Precondition: `empty() || index_pos > chunk_begin(size() - 1)`
+  void Encode(Position index_pos, Chunk& chunk) const;
+
+  // Decodes the index from a chunk index chunk which was read from
+  // `index_pos`.
+  //
+  // The index is rejected if it was written for a different position, e.g.
+  // if files were concatenated.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - the chunk is not a valid chunk index chunk for this position
+  //              (`*this` is cleared)
+  bool Decode(const Chunk& chunk, Position index_pos);
+
+ private:
+  // Invariant: `chunk_begins_` are sorted and unique
+  std::vector<Position> chunk_begins_;
+  // `records_ends_[i]` is the number of records in chunks up to and
+  // including the `i`-th chunk.
+  //
+  // Invariants:
+  //   `records_ends_.size() == chunk_begins_.size()`
+  //   `records_ends_` are sorted and unique, and positive
+  std::vector<uint64_t> records_ends_;
+};
+
+// Implementation details follow.
+
+inline ChunkIndex::ChunkIndex(const ChunkIndex& that)
+    : chunk_begins_(that.chunk_begins_), records_ends_(that.records_ends_) {}
+
+inline ChunkIndex& ChunkIndex::operator=(const ChunkIndex& that) {
+  chunk_begins_ = that.chunk_begins_;
+  records_ends_ = that.records_ends_;
+  return *this;
+}
+
+inline ChunkIndex::ChunkIndex(ChunkIndex&& that) noexcept
+    : chunk_begins_(std::move(that.chunk_begins_)),
+      records_ends_(std::move(that.records_ends_)) {}
+
+inline ChunkIndex& ChunkIndex::operator=(ChunkIndex&& that) noexcept {
+  chunk_begins_ = std::move(that.chunk_begins_);
+  records_ends_ = std::move(that.records_ends_);
+  return *this;
+}
+
+inline void ChunkIndex::Clear() {
+  chunk_begins_.clear();
+  records_ends_.clear();
+}
+
+inline Position ChunkIndex::chunk_begin(size_t chunk_index) const {
+  RIEGELI_ASSERT_LT(chunk_index, size())
+      << "Failed precondition of ChunkIndex::chunk_begin(): "
+         "chunk index out of range";
+  return chunk_begins_[chunk_index];
+}
+
+inline uint64_t ChunkIndex::records_before(size_t chunk_index) const {
+  RIEGELI_ASSERT_LE(chunk_index, size())
+      << "Failed precondition of ChunkIndex::records_before(): "
+         "chunk index out of range";
+  return chunk_index == 0 ? 0 : records_ends_[chunk_index - 1];
+}
+
+inline uint64_t ChunkIndex::num_records(size_t chunk_index) const {
+  RIEGELI_ASSERT_LT(chunk_index, size())
+      << "Failed precondition of ChunkIndex::num_records(): "
+         "chunk index out of range";
+  return records_ends_[chunk_index] - records_before(chunk_index);
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_CHUNK_INDEX_H_
@@ -17,16 +17,24 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/constants.h"
@@ -36,15 +44,287 @@
 
 namespace riegeli {
 
-void DefaultChunkReaderBase::Initialize(Reader* src) {
+namespace {
+
+// The buffer of `ChunkDataReader` is small because reading regions of a chunk
+// separately is the point. Longer reads bypass the buffer.
+constexpr size_t kChunkDataBufferSize = size_t{4} << 10;
+
+// Reads data of the chunk beginning at `chunk_begin` from `src`, skipping
+// intervening block headers. Data are read from `src` when requested, so that
+// regions which are skipped are not read at all.
+class ChunkDataReader : public BufferedReader {
+ public:
+  explicit ChunkDataReader(Reader* src, Position chunk_begin,
+                           const ChunkHeader& chunk_header,
+                           Position block_size)
+      : BufferedReader(kChunkDataBufferSize, chunk_header.data_size()),
+        src_(src),
+        chunk_begin_(chunk_begin),
+        data_size_(chunk_header.data_size()),
+        block_size_(block_size) {}
+
+  bool SupportsRandomAccess() override { return true; }
+
+ protected:
+  bool ReadInternal(size_t min_length, size_t max_length,
+                    char* dest) override;
+  using BufferedReader::ReadSlow;
+  bool ReadSlow(size_t length, Chain& dest) override;
+  bool SeekBehindBuffer(Position new_pos) override;
+  absl::optional<Position> SizeImpl() override;
+
+ private:
+  // Returns the position in `*src_` of the byte at `limit_pos()` in the data.
+  Position SrcPos() const;
+
+  Reader* src_;
+  Position chunk_begin_;
+  Position data_size_;
+  Position block_size_;
+};
+
+bool ChunkDataReader::ReadInternal(size_t min_length, size_t max_length,
+                                   char* dest) {
+  RIEGELI_ASSERT_GT(min_length, 0u)
+      << "Failed precondition of BufferedReader::ReadInternal(): "
+         "nothing to read";
+  RIEGELI_ASSERT_LE(min_length, max_length)
+      << "Failed precondition of BufferedReader::ReadInternal(): "
+         "min_length > max_length";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of BufferedReader::ReadInternal(): " << status();
+  max_length = UnsignedMin(max_length, SaturatingSub(data_size_, limit_pos()));
+  while (max_length > 0) {
+    const Position src_pos = SrcPos();
+    const size_t length = IntCast<size_t>(UnsignedMin(
+        max_length, internal::RemainingInBlock(src_pos, block_size_)));
+    if (ABSL_PREDICT_FALSE(!src_->Seek(src_pos) ||
+                           !src_->Read(length, dest))) {
+      if (ABSL_PREDICT_FALSE(!src_->healthy())) {
+        return FailWithoutAnnotation(src_->status());
+      }
+      return Fail(absl::InvalidArgumentError(absl::StrCat(
+          "Truncated Riegeli/records file, incomplete chunk at ",
+          chunk_begin_)));
+    }
+    move_limit_pos(length);
+    if (length >= min_length) return true;
+    dest += length;
+    min_length -= length;
+    max_length -= length;
+  }
+  return false;
+}
+
+// Appends fragments of `*src_` between block headers directly to `dest`
+// instead of copying them through the buffer. If `*src_` is a `ChainReader`,
+// e.g. `FdMMapReader`, fragments of its `Chain` are shared.
+bool ChunkDataReader::ReadSlow(size_t length, Chain& dest) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), length)
+      << "Failed precondition of Reader::ReadSlow(Chain&): "
+         "enough data available, use Read(Chain&) instead";
+  RIEGELI_ASSERT_LE(length, std::numeric_limits<size_t>::max() - dest.size())
+      << "Failed precondition of Reader::ReadSlow(Chain&): "
+         "Chain size overflow";
+  if (length <= available()) return BufferedReader::ReadSlow(length, dest);
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  length -= available();
+  dest.Append(absl::string_view(cursor(), available()));
+  SyncBuffer();
+  while (length > 0) {
+    if (ABSL_PREDICT_FALSE(limit_pos() >= data_size_)) return false;
+    const Position src_pos = SrcPos();
+    const size_t fragment_length = IntCast<size_t>(
+        UnsignedMin(length, data_size_ - limit_pos(),
+                    internal::RemainingInBlock(src_pos, block_size_)));
+    if (ABSL_PREDICT_FALSE(!src_->Seek(src_pos) ||
+                           !src_->ReadAndAppend(fragment_length, dest))) {
+      if (ABSL_PREDICT_FALSE(!src_->healthy())) {
+        return FailWithoutAnnotation(src_->status());
+      }
+      return Fail(absl::InvalidArgumentError(absl::StrCat(
+          "Truncated Riegeli/records file, incomplete chunk at ",
+          chunk_begin_)));
+    }
+    move_limit_pos(fragment_length);
+    length -= fragment_length;
+  }
+  return true;
+}
+
+bool ChunkDataReader::SeekBehindBuffer(Position new_pos) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(new_pos > data_size_)) {
+    set_limit_pos(data_size_);
+    return false;
+  }
+  set_limit_pos(new_pos);
+  return true;
+}
+
+inline Position ChunkDataReader::SrcPos() const {
+  return internal::AddWithOverhead(
+             chunk_begin_, ChunkHeader::size() + limit_pos() + 1,
+             block_size_) -
+         1;
+}
+
+absl::optional<Position> ChunkDataReader::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  return data_size_;
+}
+
+}  // namespace
+
+// Pulls data from a byte `Reader` in background.
+class DefaultChunkReaderBase::Prefetcher {
+ public:
+  Prefetcher() noexcept {}
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  ~Prefetcher() { Wait(); }
+
+  // Starts pulling `length` bytes from `src` in background.
+  //
+  // `src` must not be accessed until `Wait()` returns.
+  void Schedule(Reader* src, size_t length);
+
+  // Waits until pulling started by `Schedule()` finishes, if any.
+  void Wait();
+
+ private:
+  absl::Mutex mutex_;
+  bool running_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+void DefaultChunkReaderBase::Prefetcher::Schedule(Reader* src, size_t length) {
+  {
+    absl::MutexLock lock(&mutex_);
+    RIEGELI_ASSERT(!running_)
+        << "Failed precondition of "
+           "DefaultChunkReaderBase::Prefetcher::Schedule(): "
+           "prefetching already running";
+    running_ = true;
+  }
+  // Pulling blocks on I/O, hence it does not use the pool used for decoding.
+  internal::ThreadPool::global().ScheduleBlocking([this, src, length] {
+    // A failure or the end of the source is reported when the data are read.
+    src->Pull(length);
+    absl::MutexLock lock(&mutex_);
+    running_ = false;
+  });
+}
+
+void DefaultChunkReaderBase::Prefetcher::Wait() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(+[](bool* running) { return !*running; },
+                               &running_));
+}
+
+DefaultChunkReaderBase::DefaultChunkReaderBase(Closed) noexcept
+    : Object(kClosed) {}
+
+DefaultChunkReaderBase::DefaultChunkReaderBase() noexcept {}
+
+DefaultChunkReaderBase::DefaultChunkReaderBase(
+    DefaultChunkReaderBase&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      truncated_(that.truncated_),
+      pos_(that.pos_),
+      chunk_(std::move(that.chunk_)),
+      block_header_(that.block_header_),
+      block_size_(that.block_size_),
+      block_size_known_(that.block_size_known_),
+      recoverable_(std::exchange(that.recoverable_, Recoverable::kNo)),
+      recoverable_pos_(that.recoverable_pos_),
+      prefetch_size_(that.prefetch_size_),
+      verify_data_hash_every_(that.verify_data_hash_every_),
+      num_chunks_read_(that.num_chunks_read_),
+      prefetcher_(std::move(that.prefetcher_)) {
+  // The derived class moves `src_reader()` after this.
+  WaitForPrefetch();
+}
+
+DefaultChunkReaderBase& DefaultChunkReaderBase::operator=(
+    DefaultChunkReaderBase&& that) noexcept {
+  // The derived class moves `src_reader()` after this.
+  WaitForPrefetch();
+  that.WaitForPrefetch();
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  truncated_ = that.truncated_;
+  pos_ = that.pos_;
+  chunk_ = that.chunk_;
+  block_header_ = that.block_header_;
+  block_size_ = that.block_size_;
+  block_size_known_ = that.block_size_known_;
+  recoverable_ = std::exchange(that.recoverable_, Recoverable::kNo);
+  recoverable_pos_ = that.recoverable_pos_;
+  prefetch_size_ = that.prefetch_size_;
+  verify_data_hash_every_ = that.verify_data_hash_every_;
+  num_chunks_read_ = that.num_chunks_read_;
+  prefetcher_ = std::move(that.prefetcher_);
+  return *this;
+}
+
+void DefaultChunkReaderBase::Reset(Closed) {
+  Object::Reset(kClosed);
+  truncated_ = false;
+  pos_ = 0;
+  chunk_.Reset();
+  block_size_ = internal::kBlockSize;
+  block_size_known_ = false;
+  recoverable_ = Recoverable::kNo;
+  recoverable_pos_ = 0;
+  prefetch_size_ = 0;
+  verify_data_hash_every_ = 1;
+  num_chunks_read_ = 0;
+  prefetcher_.reset();
+}
+
+void DefaultChunkReaderBase::Reset() {
+  Object::Reset();
+  truncated_ = false;
+  pos_ = 0;
+  chunk_.Clear();
+  block_size_ = internal::kBlockSize;
+  block_size_known_ = false;
+  recoverable_ = Recoverable::kNo;
+  recoverable_pos_ = 0;
+  prefetch_size_ = 0;
+  verify_data_hash_every_ = 1;
+  num_chunks_read_ = 0;
+  prefetcher_.reset();
+}
+
+DefaultChunkReaderBase::~DefaultChunkReaderBase() {}
+
+void DefaultChunkReaderBase::Initialize(Reader* src, Options&& options) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of DefaultChunkReader: null Reader pointer";
   pos_ = src->pos();
+  prefetch_size_ = options.prefetch_size();
+  verify_data_hash_every_ = options.verify_data_hash_every();
+  if (prefetch_size_ > 0) prefetcher_ = std::make_unique<Prefetcher>();
   if (ABSL_PREDICT_FALSE(!src->healthy()) && src->available() == 0) {
     FailWithoutAnnotation(src->status());
     return;
   }
-  if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos_))) {
+  if (pos_ != 0) {
+    // The file signature is not read together with the first chunk.
+    if (ABSL_PREDICT_FALSE(!EnsureBlockSize())) return;
+  }
+  if (ABSL_PREDICT_FALSE(
+          !internal::IsPossibleChunkBoundary(pos_, block_size_))) {
     recoverable_ = Recoverable::kFindChunk;
     recoverable_pos_ = pos_;
     Fail(absl::InvalidArgumentError(
@@ -52,7 +332,12 @@ void DefaultChunkReaderBase::Initialize(Reader* src) {
   }
 }
 
+void DefaultChunkReaderBase::WaitForPrefetch() {
+  if (prefetcher_ != nullptr) prefetcher_->Wait();
+}
+
 void DefaultChunkReaderBase::Done() {
+  WaitForPrefetch();
   recoverable_ = Recoverable::kNo;
   recoverable_pos_ = 0;
   if (ABSL_PREDICT_FALSE(truncated_)) {
@@ -89,6 +374,7 @@ inline bool DefaultChunkReaderBase::FailSeeking(const Reader& src,
 }
 
 absl::Status DefaultChunkReaderBase::AnnotateStatusImpl(absl::Status status) {
+  WaitForPrefetch();
   if (is_open()) {
     Reader& src = *src_reader();
     return src.AnnotateStatus(std::move(status));
@@ -101,20 +387,32 @@ bool DefaultChunkReaderBase::CheckFileFormat() {
 }
 
 bool DefaultChunkReaderBase::ReadChunk(Chunk& chunk) {
+  return ReadChunkImpl(chunk, nullptr);
+}
+
+bool DefaultChunkReaderBase::ReadChunkWithoutDataHash(Chunk& chunk,
+                                                      bool& verify_data_hash) {
+  return ReadChunkImpl(chunk, &verify_data_hash);
+}
+
+inline bool DefaultChunkReaderBase::ReadChunkImpl(Chunk& chunk,
+                                                  bool* verify_data_hash) {
   if (ABSL_PREDICT_FALSE(!PullChunkHeader(nullptr))) return false;
   Reader& src = *src_reader();
-  const Position chunk_end = internal::ChunkEnd(chunk_.header, pos_);
+  const Position chunk_end =
+      internal::ChunkEnd(chunk_.header, pos_, block_size_);
   src.ReadHint(SaturatingIntCast<size_t>(
-      internal::AddWithOverhead(chunk_end, ChunkHeader::size()) - src.pos()));
+      internal::AddWithOverhead(chunk_end, ChunkHeader::size(), block_size_) -
+      src.pos()));
 
   while (chunk_.data.size() < chunk_.header.data_size()) {
-    if (internal::RemainingInBlockHeader(src.pos()) > 0) {
+    if (internal::RemainingInBlockHeader(src.pos(), block_size_) > 0) {
       const Position block_begin =
-          internal::RoundDownToBlockBoundary(src.pos());
+          internal::RoundDownToBlockBoundary(src.pos(), block_size_);
       if (ABSL_PREDICT_FALSE(!ReadBlockHeader())) return false;
       if (ABSL_PREDICT_FALSE(block_header_.previous_chunk() !=
                              block_begin - pos_)) {
-        if (block_header_.next_chunk() <= internal::kBlockSize) {
+        if (block_header_.next_chunk() <= block_size_) {
           // Trust the rest of the block header: skip to the next chunk.
           recoverable_ = Recoverable::kHaveChunk;
           recoverable_pos_ = block_begin + block_header_.next_chunk();
@@ -144,9 +442,9 @@ bool DefaultChunkReaderBase::ReadChunk(Chunk& chunk) {
       }
     }
     if (ABSL_PREDICT_FALSE(!src.ReadAndAppend(
-            IntCast<size_t>(
-                UnsignedMin(chunk_.header.data_size() - chunk_.data.size(),
-                            internal::RemainingInBlock(src.pos()))),
+            IntCast<size_t>(UnsignedMin(
+                chunk_.header.data_size() - chunk_.data.size(),
+                internal::RemainingInBlock(src.pos(), block_size_))),
             chunk_.data))) {
       return FailReading(src);
     }
@@ -154,27 +452,68 @@ bool DefaultChunkReaderBase::ReadChunk(Chunk& chunk) {
 
   if (ABSL_PREDICT_FALSE(!src.Seek(chunk_end))) return FailReading(src);
 
-  const uint64_t computed_data_hash = internal::Hash(chunk_.data);
-  if (ABSL_PREDICT_FALSE(computed_data_hash != chunk_.header.data_hash())) {
-    // `Recoverable::kHaveChunk`, not `Recoverable::kFindChunk`, because while
-    // chunk data are invalid, chunk header has a correct hash, and thus the
-    // next chunk is believed to be present after this chunk.
-    recoverable_ = Recoverable::kHaveChunk;
-    recoverable_pos_ = chunk_end;
-    return Fail(absl::InvalidArgumentError(absl::StrCat(
-        "Corrupted Riegeli/records file: chunk data hash mismatch (computed 0x",
-        absl::Hex(computed_data_hash, absl::PadSpec::kZeroPad16), ", stored 0x",
-        absl::Hex(chunk_.header.data_hash(), absl::PadSpec::kZeroPad16),
-        "), chunk at ", pos_, " with length ", chunk_end - pos_)));
+  const bool should_verify_data_hash = VerifiesNextDataHash();
+  ++num_chunks_read_;
+  if (verify_data_hash != nullptr) {
+    *verify_data_hash = should_verify_data_hash;
+  } else if (should_verify_data_hash) {
+    const uint64_t computed_data_hash = internal::Hash(chunk_.data);
+    if (ABSL_PREDICT_FALSE(computed_data_hash != chunk_.header.data_hash())) {
+      // `Recoverable::kHaveChunk`, not `Recoverable::kFindChunk`, because
+      // while chunk data are invalid, chunk header has a correct hash, and thus
+      // the next chunk is believed to be present after this chunk.
+      recoverable_ = Recoverable::kHaveChunk;
+      recoverable_pos_ = chunk_end;
+      return Fail(absl::InvalidArgumentError(absl::StrCat(
+          "Corrupted Riegeli/records file: chunk data hash mismatch "
+          "(computed 0x",
+          absl::Hex(computed_data_hash, absl::PadSpec::kZeroPad16),
+          ", stored 0x",
+          absl::Hex(chunk_.header.data_hash(), absl::PadSpec::kZeroPad16),
+          "), chunk at ", pos_, " with length ", chunk_end - pos_)));
+    }
   }
 
   chunk = std::move(chunk_);
   pos_ = chunk_end;
   chunk_.Clear();
+  if (prefetcher_ != nullptr) {
+    // Fetch the following chunks while the caller is processing this chunk.
+    prefetcher_->Schedule(&src, prefetch_size_);
+  }
+  return true;
+}
+
+bool DefaultChunkReaderBase::ReadChunkOnDemand(
+    absl::FunctionRef<void(const ChunkHeader& chunk_header, Reader& data)>
+        read_data) {
+  RIEGELI_ASSERT(!VerifiesNextDataHash())
+      << "Failed precondition of DefaultChunkReaderBase::ReadChunkOnDemand(): "
+         "the data hash of the next chunk is going to be verified";
+  if (ABSL_PREDICT_FALSE(!PullChunkHeader(nullptr))) return false;
+  Reader& src = *src_reader();
+  const Position chunk_end =
+      internal::ChunkEnd(chunk_.header, pos_, block_size_);
+  // Check that the whole chunk is present before reading its parts.
+  const Position pos_before = src.pos();
+  if (ABSL_PREDICT_FALSE(!src.Seek(chunk_end))) {
+    // Keep the part of the chunk read so far consistent with `src.pos()`.
+    if (src.healthy()) src.Seek(pos_before);
+    return FailReading(src);
+  }
+  {
+    ChunkDataReader data(&src, pos_, chunk_.header, block_size_);
+    read_data(chunk_.header, data);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(chunk_end))) return FailReading(src);
+  ++num_chunks_read_;
+  pos_ = chunk_end;
+  chunk_.Clear();
   return true;
 }
 
 bool DefaultChunkReaderBase::PullChunkHeader(const ChunkHeader** chunk_header) {
+  WaitForPrefetch();
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Reader& src = *src_reader();
   truncated_ = false;
@@ -198,7 +537,7 @@ bool DefaultChunkReaderBase::PullChunkHeader(const ChunkHeader** chunk_header) {
   }
 
   const Position chunk_header_read =
-      internal::DistanceWithoutOverhead(pos_, src.pos());
+      internal::DistanceWithoutOverhead(pos_, src.pos(), block_size_);
   if (chunk_header_read < chunk_.header.size()) {
     if (ABSL_PREDICT_FALSE(!ReadChunkHeader())) return false;
   }
@@ -211,20 +550,21 @@ inline bool DefaultChunkReaderBase::ReadChunkHeader() {
       << "Failed precondition of DefaultChunkReaderBase::ReadChunkHeader(): "
       << status();
   Reader& src = *src_reader();
-  RIEGELI_ASSERT_LT(internal::DistanceWithoutOverhead(pos_, src.pos()),
-                    chunk_.header.size())
+  RIEGELI_ASSERT_LT(
+      internal::DistanceWithoutOverhead(pos_, src.pos(), block_size_),
+      chunk_.header.size())
       << "Failed precondition of DefaultChunkReaderBase::ReadChunkHeader(): "
          "chunk header already read";
   size_t remaining_length;
   size_t length_to_read;
   do {
-    if (internal::RemainingInBlockHeader(src.pos()) > 0) {
+    if (internal::RemainingInBlockHeader(src.pos(), block_size_) > 0) {
       const Position block_begin =
-          internal::RoundDownToBlockBoundary(src.pos());
+          internal::RoundDownToBlockBoundary(src.pos(), block_size_);
       if (ABSL_PREDICT_FALSE(!ReadBlockHeader())) return false;
       if (ABSL_PREDICT_FALSE(block_header_.previous_chunk() !=
                              block_begin - pos_)) {
-        if (block_header_.next_chunk() <= internal::kBlockSize) {
+        if (block_header_.next_chunk() <= block_size_) {
           // Trust the rest of the block header: skip to the next chunk.
           recoverable_ = Recoverable::kHaveChunk;
           recoverable_pos_ = block_begin + block_header_.next_chunk();
@@ -243,11 +583,12 @@ inline bool DefaultChunkReaderBase::ReadChunkHeader() {
                                block_header_.previous_chunk() - block_begin))));
       }
     }
-    const size_t chunk_header_read =
-        IntCast<size_t>(internal::DistanceWithoutOverhead(pos_, src.pos()));
+    const size_t chunk_header_read = IntCast<size_t>(
+        internal::DistanceWithoutOverhead(pos_, src.pos(), block_size_));
     remaining_length = chunk_.header.size() - chunk_header_read;
     length_to_read =
-        UnsignedMin(remaining_length, internal::RemainingInBlock(src.pos()));
+        UnsignedMin(remaining_length,
+                    internal::RemainingInBlock(src.pos(), block_size_));
     if (ABSL_PREDICT_FALSE(!src.Read(
             length_to_read, chunk_.header.bytes() + chunk_header_read))) {
       return FailReading(src);
@@ -268,11 +609,13 @@ inline bool DefaultChunkReaderBase::ReadChunkHeader() {
                   absl::PadSpec::kZeroPad16),
         "), chunk at ", pos_)));
   }
-  if (internal::RemainingInBlock(pos_) < chunk_.header.size()) {
+  if (internal::RemainingInBlock(pos_, block_size_) < chunk_.header.size()) {
     // The chunk header was interrupted by a block header. Both headers have
     // been read so verify that they agree.
-    const Position block_begin = pos_ + internal::RemainingInBlock(pos_);
-    const Position chunk_end = internal::ChunkEnd(chunk_.header, pos_);
+    const Position block_begin =
+        pos_ + internal::RemainingInBlock(pos_, block_size_);
+    const Position chunk_end =
+        internal::ChunkEnd(chunk_.header, pos_, block_size_);
     if (ABSL_PREDICT_FALSE(block_header_.next_chunk() !=
                            chunk_end - block_begin)) {
       recoverable_ = Recoverable::kFindChunk;
@@ -289,13 +632,25 @@ inline bool DefaultChunkReaderBase::ReadChunkHeader() {
     if (ABSL_PREDICT_FALSE(chunk_.header.data_size() != 0 ||
                            chunk_.header.chunk_type() !=
                                ChunkType::kFileSignature ||
-                           chunk_.header.num_records() != 0 ||
-                           chunk_.header.decoded_data_size() != 0)) {
+                           chunk_.header.num_records() != 0)) {
       recoverable_ = Recoverable::kFindChunk;
       recoverable_pos_ = src.pos();
       return Fail(absl::InvalidArgumentError(
           "Invalid Riegeli/records file: missing file signature"));
     }
+    // The end of the file signature does not depend on the block size, so
+    // changing the block size after reading the file signature is consistent.
+    const Position block_size =
+        internal::BlockSizeFromFileSignature(chunk_.header);
+    if (ABSL_PREDICT_FALSE(block_size == 0)) {
+      recoverable_ = Recoverable::kFindChunk;
+      recoverable_pos_ = src.pos();
+      return Fail(absl::InvalidArgumentError(absl::StrCat(
+          "Invalid Riegeli/records file: unsupported block size: ",
+          chunk_.header.decoded_data_size())));
+    }
+    block_size_ = block_size;
+    block_size_known_ = true;
   }
   return true;
 }
@@ -305,7 +660,8 @@ inline bool DefaultChunkReaderBase::ReadBlockHeader() {
       << "Failed precondition of DefaultChunkReaderBase::ReadBlockHeader(): "
       << status();
   Reader& src = *src_reader();
-  const size_t remaining_length = internal::RemainingInBlockHeader(src.pos());
+  const size_t remaining_length =
+      internal::RemainingInBlockHeader(src.pos(), block_size_);
   RIEGELI_ASSERT_GT(remaining_length, 0u)
       << "Failed precondition of DefaultChunkReaderBase::ReadBlockHeader(): "
          "not before nor inside a block header";
@@ -326,12 +682,41 @@ inline bool DefaultChunkReaderBase::ReadBlockHeader() {
         ", stored 0x",
         absl::Hex(block_header_.stored_header_hash(),
                   absl::PadSpec::kZeroPad16),
-        "), block at ", internal::RoundDownToBlockBoundary(recoverable_pos_))));
+        "), block at ",
+        internal::RoundDownToBlockBoundary(recoverable_pos_, block_size_))));
+  }
+  return true;
+}
+
+inline bool DefaultChunkReaderBase::EnsureBlockSize() {
+  if (ABSL_PREDICT_TRUE(block_size_known_)) return true;
+  block_size_known_ = true;
+  Reader& src = *src_reader();
+  if (!src.SupportsRandomAccess()) return true;
+  const Position pos_before = src.pos();
+  char signature[internal::BlockHeader::size() + ChunkHeader::size()];
+  if (src.Seek(0) && src.Read(sizeof(signature), signature)) {
+    ChunkHeader chunk_header;
+    std::memcpy(chunk_header.bytes(), signature + internal::BlockHeader::size(),
+                chunk_header.size());
+    // If the file signature is invalid, this is detected when reading it, so
+    // only a valid file signature is interpreted here.
+    if (chunk_header.computed_header_hash() ==
+            chunk_header.stored_header_hash() &&
+        chunk_header.chunk_type() == ChunkType::kFileSignature) {
+      const Position block_size =
+          internal::BlockSizeFromFileSignature(chunk_header);
+      if (block_size != 0) block_size_ = block_size;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(pos_before))) {
+    return FailSeeking(src, pos_before);
   }
   return true;
 }
 
 bool DefaultChunkReaderBase::Recover(SkippedRegion* skipped_region) {
+  WaitForPrefetch();
   if (recoverable_ == Recoverable::kNo) return false;
   Reader& src = *src_reader();
   const Position region_begin = pos_;
@@ -343,7 +728,11 @@ again:
   recoverable_ = Recoverable::kNo;
   Position recoverable_pos = recoverable_pos_;
   recoverable_pos_ = 0;
-  std::string saved_message(status().message());
+  // The message is needed only for `*skipped_region`.
+  std::string saved_message;
+  if (skipped_region != nullptr) {
+    saved_message = std::string(status().message());
+  }
   MarkNotFailed();
   chunk_.Clear();
   if (recoverable == Recoverable::kHaveChunk) {
@@ -359,7 +748,8 @@ again:
         }
         return true;
       }
-      if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos_))) {
+      if (ABSL_PREDICT_FALSE(
+              !internal::IsPossibleChunkBoundary(pos_, block_size_))) {
         recoverable_ = Recoverable::kFindChunk;
         recoverable_pos_ = pos_;
         goto again;
@@ -377,7 +767,7 @@ again:
   pos_ = recoverable_pos;
 
 find_chunk:
-  pos_ += internal::RemainingInBlock(pos_);
+  pos_ += internal::RemainingInBlock(pos_, block_size_);
   if (ABSL_PREDICT_FALSE(!src.Seek(pos_))) {
     if (ABSL_PREDICT_FALSE(!src.healthy())) {
       return FailWithoutAnnotation(src.status());
@@ -397,7 +787,8 @@ find_chunk:
     // A chunk boundary coincides with block boundary. Recovery is done.
   } else {
     pos_ += block_header_.next_chunk();
-    if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos_))) {
+    if (ABSL_PREDICT_FALSE(
+            !internal::IsPossibleChunkBoundary(pos_, block_size_))) {
       goto find_chunk;
     }
     if (ABSL_PREDICT_FALSE(!src.Seek(pos_))) {
@@ -419,19 +810,49 @@ find_chunk:
 }
 
 bool DefaultChunkReaderBase::SupportsRandomAccess() {
+  WaitForPrefetch();
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRandomAccess();
 }
 
+void DefaultChunkReaderBase::SetAccessPattern(AccessPattern access_pattern) {
+  WaitForPrefetch();
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  src.SetAccessPattern(access_pattern);
+}
+
+void DefaultChunkReaderBase::WillNeed(Position length) {
+  WaitForPrefetch();
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  src.WillNeed(length);
+}
+
+void DefaultChunkReaderBase::WillNeedAt(Position pos, Position length) {
+  WaitForPrefetch();
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Reader& src = *src_reader();
+  if (!src.SupportsRandomAccess()) return;
+  const Position pos_before = src.pos();
+  if (src.Seek(pos)) src.WillNeed(length);
+  if (ABSL_PREDICT_FALSE(!src.Seek(pos_before))) {
+    FailSeeking(src, pos_before);
+  }
+}
+
 bool DefaultChunkReaderBase::Seek(Position new_pos) {
+  WaitForPrefetch();
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   if (pos_ == new_pos) return true;
+  if (ABSL_PREDICT_FALSE(!EnsureBlockSize())) return false;
   Reader& src = *src_reader();
   truncated_ = false;
   pos_ = new_pos;
   chunk_.Clear();
   if (ABSL_PREDICT_FALSE(!src.Seek(pos_))) return FailSeeking(src, pos_);
-  if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos_))) {
+  if (ABSL_PREDICT_FALSE(
+          !internal::IsPossibleChunkBoundary(pos_, block_size_))) {
     recoverable_ = Recoverable::kFindChunk;
     recoverable_pos_ = pos_;
     return Fail(absl::InvalidArgumentError(
@@ -454,11 +875,14 @@ bool DefaultChunkReaderBase::SeekToChunkAfter(Position new_pos) {
 
 template <DefaultChunkReaderBase::WhichChunk which_chunk>
 bool DefaultChunkReaderBase::SeekToChunk(Position new_pos) {
+  WaitForPrefetch();
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   if (pos_ == new_pos) return true;
+  if (ABSL_PREDICT_FALSE(!EnsureBlockSize())) return false;
   Reader& src = *src_reader();
   truncated_ = false;
-  const Position block_begin = internal::RoundDownToBlockBoundary(new_pos);
+  const Position block_begin =
+      internal::RoundDownToBlockBoundary(new_pos, block_size_);
   Position chunk_begin;
   if (pos_ < new_pos) {
     // The current chunk begins before `new_pos`. If it also ends at or after
@@ -473,7 +897,8 @@ bool DefaultChunkReaderBase::SeekToChunk(Position new_pos) {
         pos_ + chunk_.header.num_records() > new_pos) {
       return true;
     }
-    const Position chunk_end = internal::ChunkEnd(chunk_.header, pos_);
+    const Position chunk_end =
+        internal::ChunkEnd(chunk_.header, pos_, block_size_);
     if (which_chunk == WhichChunk::kBefore && chunk_end > new_pos) return true;
     if (chunk_end < block_begin) {
       // The current chunk ends too early. Skip to `block_begin`.
@@ -515,7 +940,8 @@ bool DefaultChunkReaderBase::SeekToChunk(Position new_pos) {
       }
       chunk_begin = block_begin - block_header_.previous_chunk();
     }
-    if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(chunk_begin))) {
+    if (ABSL_PREDICT_FALSE(
+            !internal::IsPossibleChunkBoundary(chunk_begin, block_size_))) {
       recoverable_ = Recoverable::kFindChunk;
       recoverable_pos_ = src.pos();
       return Fail(absl::InvalidArgumentError(absl::StrCat(
@@ -525,8 +951,13 @@ bool DefaultChunkReaderBase::SeekToChunk(Position new_pos) {
   }
 
   for (;;) {
+    // `pos_` is updated after seeking, so that if the file ends inside the
+    // previous chunk, recovery skips the region from its beginning rather than
+    // from its nominal end beyond the file.
+    if (ABSL_PREDICT_FALSE(!src.Seek(chunk_begin))) {
+      return FailSeeking(src, new_pos);
+    }
     pos_ = chunk_begin;
-    if (ABSL_PREDICT_FALSE(!src.Seek(pos_))) return FailSeeking(src, new_pos);
   check_current_chunk:
     if (pos_ >= new_pos) return true;
     if (ABSL_PREDICT_FALSE(!ReadChunkHeader())) {
@@ -538,13 +969,15 @@ bool DefaultChunkReaderBase::SeekToChunk(Position new_pos) {
         pos_ + chunk_.header.num_records() > new_pos) {
       return true;
     }
-    const Position chunk_end = internal::ChunkEnd(chunk_.header, pos_);
+    const Position chunk_end =
+        internal::ChunkEnd(chunk_.header, pos_, block_size_);
     if (which_chunk == WhichChunk::kBefore && chunk_end > new_pos) return true;
     chunk_begin = chunk_end;
   }
 }
 
 absl::optional<Position> DefaultChunkReaderBase::Size() {
+  WaitForPrefetch();
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
   Reader& src = *src_reader();
   const absl::optional<Position> size = src.Size();
@@ -15,12 +15,17 @@
 #ifndef RIEGELI_RECORDS_CHUNK_READER_H_
 #define RIEGELI_RECORDS_CHUNK_READER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/functional/function_ref.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/dependency.h"
@@ -35,6 +40,55 @@ namespace riegeli {
 // Template parameter independent part of `DefaultChunkReader`.
 class DefaultChunkReaderBase : public Object {
  public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `prefetch_size > 0`, after a chunk is read, up to `prefetch_size`
+    // following bytes are fetched from the byte `Reader` in background, while
+    // the caller is processing the chunk. This hides latency of the byte
+    // `Reader`, e.g. of remote storage, at the cost of buffering that many
+    // bytes.
+    //
+    // Prefetching is effective with a byte `Reader` which keeps the data being
+    // pulled in its buffer, e.g. `FdReader`.
+    //
+    // Default: 0.
+    Options& set_prefetch_size(size_t prefetch_size) & {
+      prefetch_size_ = prefetch_size;
+      return *this;
+    }
+    Options&& set_prefetch_size(size_t prefetch_size) && {
+      return std::move(set_prefetch_size(prefetch_size));
+    }
+    size_t prefetch_size() const { return prefetch_size_; }
+
+    // Specifies how often chunk data hashes are verified:
+    //  * 1 - the data hash of every chunk is verified
+    //  * N - the data hash of one of every N chunks read is verified
+    //  * 0 - data hashes are not verified
+    //
+    // Skipping verification saves time when the storage already guarantees
+    // integrity. Chunk header hashes and block header hashes are always
+    // verified, because chunk boundaries are derived from headers.
+    //
+    // Default: 1.
+    Options& set_verify_data_hash_every(uint64_t verify_data_hash_every) & {
+      verify_data_hash_every_ = verify_data_hash_every;
+      return *this;
+    }
+    Options&& set_verify_data_hash_every(uint64_t verify_data_hash_every) && {
+      return std::move(set_verify_data_hash_every(verify_data_hash_every));
+    }
+    uint64_t verify_data_hash_every() const { return verify_data_hash_every_; }
+
+   private:
+    size_t prefetch_size_ = 0;
+    uint64_t verify_data_hash_every_ = 1;
+  };
+
+  ~DefaultChunkReaderBase();
+
   // Returns the Riegeli/records file being read from. Unchanged by `Close()`.
   virtual Reader* src_reader() = 0;
   virtual const Reader* src_reader() const = 0;
@@ -52,12 +106,30 @@ class DefaultChunkReaderBase : public Object {
 
   // Reads the next chunk.
   //
+  // Chunk data are appended to `chunk.data` by fragments between block
+  // headers, so if `src_reader()` holds data in a `Chain`, e.g.
+  // `FdMMapReader`, they are shared rather than copied.
+  //
   // Return values:
   //  * `true`                      - success (`chunk` is set)
   //  * `false` (when `healthy()`)  - source ends
   //  * `false` (when `!healthy()`) - failure
   bool ReadChunk(Chunk& chunk);
 
+  // Reads the next chunk, like `ReadChunk()`, but leaves verifying the chunk
+  // data hash to the caller, which can then hash chunk data while decoding
+  // them instead of in a separate pass, e.g. with `internal::HashDigester`.
+  //
+  // `verify_data_hash` is set to whether the chunk data hash should be
+  // verified, according to `verify_data_hash_every()`.
+  //
+  // Return values:
+  //  * `true`                      - success (`chunk` and `verify_data_hash`
+  //                                  are set)
+  //  * `false` (when `healthy()`)  - source ends
+  //  * `false` (when `!healthy()`) - failure
+  bool ReadChunkWithoutDataHash(Chunk& chunk, bool& verify_data_hash);
+
   // Reads the next chunk header, from same chunk which will be read by an
   // immediately following `ReadChunk()`.
   //
@@ -70,6 +142,40 @@ class DefaultChunkReaderBase : public Object {
   //  * `false` (when `!healthy()`) - failure
   bool PullChunkHeader(const ChunkHeader** chunk_header);
 
+  // Reads the next chunk, like `ReadChunk()`, but instead of reading all chunk
+  // data, calls `read_data` with the chunk header and a `Reader` of chunk data
+  // which reads regions of data from `src_reader()` when they are requested.
+  // This saves I/O if `read_data` skips over parts of chunk data.
+  //
+  // The `Reader` supports random access. It is valid only during the call.
+  // Reading from it into a `Chain` appends data from `src_reader()` without
+  // copying them through a buffer, so if `src_reader()` holds data in a
+  // `Chain`, e.g. `FdMMapReader`, chunk data are shared rather than copied.
+  //
+  // Chunk data hash is not verified, and block headers inside the chunk are
+  // not verified, because not all data are read. Hence this may be used only
+  // for a chunk whose data hash is not going to be verified anyway. The chunk
+  // counts as read for sampling data hash verification.
+  //
+  // Preconditions:
+  //   `SupportsRandomAccess()`
+  //   `!VerifiesNextDataHash()`
+  //
+  // Return values:
+  //  * `true`                      - success (`read_data` was called)
+  //  * `false` (when `healthy()`)  - source ends
+  //  * `false` (when `!healthy()`) - failure
+  bool ReadChunkOnDemand(
+      absl::FunctionRef<void(const ChunkHeader& chunk_header, Reader& data)>
+          read_data);
+
+  // Returns `true` if the data hash of the next chunk is going to be verified
+  // when it is read, according to `Options::verify_data_hash_every()`.
+  bool VerifiesNextDataHash() const {
+    return verify_data_hash_every_ > 0 &&
+           num_chunks_read_ % verify_data_hash_every_ == 0;
+  }
+
   // If `!healthy()` and the failure was caused by invalid file contents, then
   // `Recover()` tries to recover from the failure and allow reading again by
   // skipping over the invalid region.
@@ -98,6 +204,17 @@ class DefaultChunkReaderBase : public Object {
   // `pos()` is unchanged by `Close()`.
   Position pos() const { return pos_; }
 
+  // Returns the block size of the file, declared by its file signature.
+  //
+  // The file signature is read together with the first chunk when reading
+  // from the beginning of the file. When starting reading elsewhere or seeking
+  // first, it is read beforehand if the byte `Reader` supports random access.
+  // Until then, and if it cannot be read, this is `internal::kBlockSize`
+  // (64KB).
+  //
+  // `block_size()` is unchanged by `Close()`.
+  Position block_size() const { return block_size_; }
+
   // Returns `true` if this `ChunkReader` supports `Seek()`,
   // `SeekToChunkContaining()`, `SeekToChunkAfter()`, and `Size()`.
   bool SupportsRandomAccess();
@@ -138,21 +255,50 @@ class DefaultChunkReaderBase : public Object {
   // Returns `absl::nullopt` on failure (`!healthy()`).
   absl::optional<Position> Size();
 
+  // Hints `src_reader()` with the expected pattern of subsequent reading.
+  //
+  // See `Reader::SetAccessPattern()`.
+  void SetAccessPattern(AccessPattern access_pattern);
+
+  // Hints `src_reader()` that about `length` bytes following `pos()` will be
+  // needed soon.
+  //
+  // See `Reader::WillNeed()`.
+  void WillNeed(Position length);
+
+  // Hints `src_reader()` that about `length` bytes following `pos` will be
+  // needed soon, without changing `pos()`. Several such hints let the byte
+  // `Reader` fetch several regions concurrently.
+  //
+  // This is effective if `SupportsRandomAccess()`, and does nothing otherwise.
+  //
+  // See `Reader::WillNeed()`.
+  void WillNeedAt(Position pos, Position length);
+
  protected:
-  using Object::Object;
+  explicit DefaultChunkReaderBase(Closed) noexcept;
+
+  DefaultChunkReaderBase() noexcept;
 
   DefaultChunkReaderBase(DefaultChunkReaderBase&& that) noexcept;
   DefaultChunkReaderBase& operator=(DefaultChunkReaderBase&& that) noexcept;
 
   void Reset(Closed);
   void Reset();
-  void Initialize(Reader* src);
+  void Initialize(Reader* src, Options&& options);
+
+  // Waits until background prefetching from `src_reader()` finishes.
+  //
+  // This must be called before `src_reader()` is moved or destroyed.
+  void WaitForPrefetch();
 
   void Done() override;
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
       absl::Status status) override;
 
  private:
+  class Prefetcher;
+
   enum class Recoverable { kNo, kHaveChunk, kFindChunk };
   enum class WhichChunk { kContaining, kBefore, kAfter };
 
@@ -172,15 +318,22 @@ class DefaultChunkReaderBase : public Object {
   bool FailSeeking(const Reader& src, Position new_pos);
 
   // Reads or continues reading `chunk_.header`.
+  // If `verify_data_hash != nullptr`, `*verify_data_hash` is set instead of
+  // verifying the chunk data hash.
+  bool ReadChunkImpl(Chunk& chunk, bool* verify_data_hash);
   bool ReadChunkHeader();
 
   // Reads or continues reading `block_header_`.
   //
   // Preconditions:
   //   `healthy()`
-  //   `internal::RemainingInBlockHeader(src_reader()->pos()) > 0`
+  //   `internal::RemainingInBlockHeader(src_reader()->pos(), block_size_) > 0`
   bool ReadBlockHeader();
 
+  // If `block_size_` is not known yet, reads it from the file signature in
+  // the beginning of the file, if `src_reader()` supports random access.
+  bool EnsureBlockSize();
+
   // Shared implementation of `SeekToChunkContaining()`, `SeekToChunkBefore()`,
   // and `SeekToChunkAfter()`.
   //
@@ -207,6 +360,13 @@ class DefaultChunkReaderBase : public Object {
   // Block header, filled to the point derived from `src_reader()->pos()`.
   internal::BlockHeader block_header_;
 
+  // The block size of the file.
+  Position block_size_ = internal::kBlockSize;
+
+  // If `true`, `block_size_` was read from the file signature, or it was
+  // determined that it cannot be read.
+  bool block_size_known_ = false;
+
   // Whether `Recover()` is applicable, and if so, how it should be performed:
   //
   //  * `Recoverable::kNo`        - `Recover()` is not applicable
@@ -227,6 +387,20 @@ class DefaultChunkReaderBase : public Object {
   // Invariant:
   //   if `recoverable_ != Recoverable::kNo` then `recoverable_pos_ >= pos_`
   Position recoverable_pos_ = 0;
+
+  // If `prefetch_size_ > 0`, the number of bytes to prefetch after a chunk.
+  size_t prefetch_size_ = 0;
+
+  // If `verify_data_hash_every_ > 0`, the data hash of one of every
+  // `verify_data_hash_every_` chunks is verified.
+  uint64_t verify_data_hash_every_ = 1;
+
+  // The number of chunks read, used for sampling data hash verification.
+  uint64_t num_chunks_read_ = 0;
+
+  // Fetches data from `src_reader()` in background if `prefetch_size_ > 0`,
+  // otherwise `nullptr`.
+  std::unique_ptr<Prefetcher> prefetcher_;
 };
 
 // A `ChunkReader` reads chunks of a Riegeli/records file (rather than
@@ -261,25 +435,28 @@ class DefaultChunkReader : public DefaultChunkReaderBase {
   explicit DefaultChunkReader(Closed) : DefaultChunkReaderBase(kClosed) {}
 
   // Will read from the byte `Reader` provided by `src`.
-  explicit DefaultChunkReader(const Src& src);
-  explicit DefaultChunkReader(Src&& src);
+  explicit DefaultChunkReader(const Src& src, Options options = Options());
+  explicit DefaultChunkReader(Src&& src, Options options = Options());
 
   // Will read from the byte `Reader` provided by a `Src` constructed from
   // elements of `src_args`. This avoids constructing a temporary `Src` and
   // moving from it.
   template <typename... SrcArgs>
-  explicit DefaultChunkReader(std::tuple<SrcArgs...> src_args);
+  explicit DefaultChunkReader(std::tuple<SrcArgs...> src_args,
+                              Options options = Options());
 
   DefaultChunkReader(DefaultChunkReader&& that) noexcept;
   DefaultChunkReader& operator=(DefaultChunkReader&& that) noexcept;
 
+  ~DefaultChunkReader();
+
   // Makes `*this` equivalent to a newly constructed `DefaultChunkReader`. This
   // avoids constructing a temporary `DefaultChunkReader` and moving from it.
   void Reset(Closed);
-  void Reset(const Src& src);
-  void Reset(Src&& src);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
   template <typename... SrcArgs>
-  void Reset(std::tuple<SrcArgs...> src_args);
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
 
   // Returns the object providing and possibly owning the byte `Reader`.
   // Unchanged by `Close()`.
@@ -301,78 +478,43 @@ class DefaultChunkReader : public DefaultChunkReaderBase {
 #if __cpp_deduction_guides
 explicit DefaultChunkReader(Closed)->DefaultChunkReader<DeleteCtad<Closed>>;
 template <typename Src>
-explicit DefaultChunkReader(const Src& src)
+explicit DefaultChunkReader(
+    const Src& src,
+    DefaultChunkReaderBase::Options options = DefaultChunkReaderBase::Options())
     -> DefaultChunkReader<std::decay_t<Src>>;
 template <typename Src>
-explicit DefaultChunkReader(Src&& src) -> DefaultChunkReader<std::decay_t<Src>>;
+explicit DefaultChunkReader(
+    Src&& src,
+    DefaultChunkReaderBase::Options options = DefaultChunkReaderBase::Options())
+    -> DefaultChunkReader<std::decay_t<Src>>;
 template <typename... SrcArgs>
-explicit DefaultChunkReader(std::tuple<SrcArgs...> src_args)
+explicit DefaultChunkReader(
+    std::tuple<SrcArgs...> src_args,
+    DefaultChunkReaderBase::Options options = DefaultChunkReaderBase::Options())
     -> DefaultChunkReader<DeleteCtad<std::tuple<SrcArgs...>>>;
 #endif
 
 // Implementation details follow.
 
-inline DefaultChunkReaderBase::DefaultChunkReaderBase(
-    DefaultChunkReaderBase&& that) noexcept
-    : Object(std::move(that)),
-      // Using `that` after it was moved is correct because only the base class
-      // part was moved.
-      truncated_(that.truncated_),
-      pos_(that.pos_),
-      chunk_(std::move(that.chunk_)),
-      block_header_(that.block_header_),
-      recoverable_(std::exchange(that.recoverable_, Recoverable::kNo)),
-      recoverable_pos_(that.recoverable_pos_) {}
-
-inline DefaultChunkReaderBase& DefaultChunkReaderBase::operator=(
-    DefaultChunkReaderBase&& that) noexcept {
-  Object::operator=(std::move(that));
-  // Using `that` after it was moved is correct because only the base class part
-  // was moved.
-  truncated_ = that.truncated_;
-  pos_ = that.pos_;
-  chunk_ = that.chunk_;
-  block_header_ = that.block_header_;
-  recoverable_ = std::exchange(that.recoverable_, Recoverable::kNo);
-  recoverable_pos_ = that.recoverable_pos_;
-  return *this;
-}
-
-inline void DefaultChunkReaderBase::Reset(Closed) {
-  Object::Reset(kClosed);
-  truncated_ = false;
-  pos_ = 0;
-  chunk_.Reset();
-  recoverable_ = Recoverable::kNo;
-  recoverable_pos_ = 0;
-}
-
-inline void DefaultChunkReaderBase::Reset() {
-  Object::Reset();
-  truncated_ = false;
-  pos_ = 0;
-  chunk_.Clear();
-  recoverable_ = Recoverable::kNo;
-  recoverable_pos_ = 0;
-}
-
 template <typename Src>
-inline DefaultChunkReader<Src>::DefaultChunkReader(const Src& src) : src_(src) {
-  Initialize(src_.get());
+inline DefaultChunkReader<Src>::DefaultChunkReader(const Src& src,
+                                                  Options options)
+    : src_(src) {
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
-inline DefaultChunkReader<Src>::DefaultChunkReader(Src&& src)
+inline DefaultChunkReader<Src>::DefaultChunkReader(Src&& src, Options options)
     : src_(std::move(src)) {
-  Initialize(src_.get());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
 template <typename... SrcArgs>
 inline DefaultChunkReader<Src>::DefaultChunkReader(
-    std::tuple<SrcArgs...> src_args)
+    std::tuple<SrcArgs...> src_args, Options options)
     : src_(std::move(src_args)) {
-  Initialize(src_.get());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -393,6 +535,12 @@ inline DefaultChunkReader<Src>& DefaultChunkReader<Src>::operator=(
   return *this;
 }
 
+template <typename Src>
+inline DefaultChunkReader<Src>::~DefaultChunkReader() {
+  // Background prefetching must not outlive `src_`.
+  WaitForPrefetch();
+}
+
 template <typename Src>
 inline void DefaultChunkReader<Src>::Reset(Closed) {
   DefaultChunkReaderBase::Reset(kClosed);
@@ -400,25 +548,26 @@ inline void DefaultChunkReader<Src>::Reset(Closed) {
 }
 
 template <typename Src>
-inline void DefaultChunkReader<Src>::Reset(const Src& src) {
+inline void DefaultChunkReader<Src>::Reset(const Src& src, Options options) {
   DefaultChunkReaderBase::Reset();
   src_.Reset(src);
-  Initialize(src_.get());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
-inline void DefaultChunkReader<Src>::Reset(Src&& src) {
+inline void DefaultChunkReader<Src>::Reset(Src&& src, Options options) {
   DefaultChunkReaderBase::Reset();
   src_.Reset(std::move(src));
-  Initialize(src_.get());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
 template <typename... SrcArgs>
-inline void DefaultChunkReader<Src>::Reset(std::tuple<SrcArgs...> src_args) {
+inline void DefaultChunkReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                           Options options) {
   DefaultChunkReaderBase::Reset();
   src_.Reset(std::move(src_args));
-  Initialize(src_.get());
+  Initialize(src_.get(), std::move(options));
 }
 
 template <typename Src>
@@ -30,25 +30,88 @@
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/hash.h"
 #include "riegeli/records/block.h"
+#include "riegeli/records/chunk_reader.h"
 
 namespace riegeli {
 
 ChunkWriter::~ChunkWriter() {}
 
-void DefaultChunkWriterBase::Initialize(Writer* dest, Position pos) {
+void DefaultChunkWriterBase::Initialize(Writer* dest,
+                                        const Options& options) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of DefaultChunkWriter: null Writer pointer";
-  if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos))) {
-    const Position length = internal::RemainingInBlock(pos);
+  RIEGELI_ASSERT(!options.append() || options.assumed_pos() == absl::nullopt)
+      << "Failed precondition of DefaultChunkWriter: "
+         "Options::set_append(true) with Options::set_assumed_pos()";
+  Position block_size = options.block_size();
+  if (options.append()) {
+    if (ABSL_PREDICT_FALSE(!TruncateIncompleteTail(*dest, block_size))) return;
+  }
+  Position pos = options.assumed_pos().value_or(dest->pos());
+  if (ABSL_PREDICT_FALSE(!internal::IsPossibleChunkBoundary(pos, block_size))) {
+    const Position length = internal::RemainingInBlock(pos, block_size);
     dest->WriteZeros(length);
     pos += length;
   }
-  ChunkWriter::Initialize(pos);
+  ChunkWriter::Initialize(pos, block_size);
   if (ABSL_PREDICT_FALSE(!dest->healthy())) {
     FailWithoutAnnotation(dest->status());
   }
 }
 
+bool DefaultChunkWriterBase::TruncateIncompleteTail(Writer& dest,
+                                                    Position& block_size) {
+  if (ABSL_PREDICT_FALSE(!dest.SupportsReadMode() ||
+                         !dest.SupportsTruncate())) {
+    return Fail(absl::UnimplementedError(
+        "Appending to a Riegeli/records file requires a Writer supporting "
+        "ReadMode() and Truncate()"));
+  }
+  Reader* const src = dest.ReadMode(0);
+  if (ABSL_PREDICT_FALSE(src == nullptr)) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  const absl::optional<Position> size = src->Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
+    return FailWithoutAnnotation(src->status());
+  }
+  Position valid_end = 0;
+  if (*size > 0) {
+    DefaultChunkReader<> chunk_reader(src);
+    // Verify the beginning of the file, so that a file which is not a
+    // Riegeli/records file is not truncated. If the file ends inside its first
+    // chunk, it is truncated to 0.
+    if (chunk_reader.CheckFileFormat()) {
+      block_size = chunk_reader.block_size();
+      const bool seek_ok = chunk_reader.SeekToChunkBefore(*size);
+      // If seeking failed, `pos()` is where invalid contents begin.
+      valid_end = chunk_reader.pos();
+      if (ABSL_PREDICT_FALSE(!seek_ok) &&
+          ABSL_PREDICT_FALSE(!chunk_reader.Recover())) {
+        return FailWithoutAnnotation(chunk_reader.status());
+      }
+      Chunk chunk;
+      for (;;) {
+        if (chunk_reader.ReadChunk(chunk)) {
+          valid_end = chunk_reader.pos();
+          continue;
+        }
+        if (chunk_reader.healthy()) break;
+        if (ABSL_PREDICT_FALSE(!chunk_reader.Recover())) {
+          return FailWithoutAnnotation(chunk_reader.status());
+        }
+      }
+    } else if (ABSL_PREDICT_FALSE(!chunk_reader.healthy())) {
+      return FailWithoutAnnotation(chunk_reader.status());
+    }
+    valid_end = UnsignedMin(valid_end, *size);
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Truncate(valid_end))) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  return true;
+}
+
 absl::Status DefaultChunkWriterBase::AnnotateStatusImpl(absl::Status status) {
   if (is_open()) {
     Writer& dest = *dest_writer();
@@ -66,8 +129,10 @@ bool DefaultChunkWriterBase::WriteChunk(const Chunk& chunk) {
   Writer& dest = *dest_writer();
   StringReader<> header_reader(chunk.header.bytes(), chunk.header.size());
   ChainReader<> data_reader(&chunk.data);
+  UpdateBlockSize(chunk.header);
   const Position chunk_begin = pos_;
-  const Position chunk_end = internal::ChunkEnd(chunk.header, chunk_begin);
+  const Position chunk_end =
+      internal::ChunkEnd(chunk.header, chunk_begin, block_size_);
   if (ABSL_PREDICT_FALSE(
           !WriteSection(header_reader, chunk_begin, chunk_end, dest))) {
     return false;
@@ -95,7 +160,7 @@ inline bool DefaultChunkWriterBase::WriteSection(Reader& src,
   }
   RIEGELI_ASSERT_EQ(src.pos(), 0u) << "Non-zero section reader position";
   while (src.pos() < *size) {
-    if (internal::IsBlockBoundary(pos_)) {
+    if (internal::IsBlockBoundary(pos_, block_size_)) {
       internal::BlockHeader block_header(IntCast<uint64_t>(pos_ - chunk_begin),
                                          IntCast<uint64_t>(chunk_end - pos_));
       if (ABSL_PREDICT_FALSE(
@@ -105,7 +170,8 @@ inline bool DefaultChunkWriterBase::WriteSection(Reader& src,
       pos_ += block_header.size();
     }
     const Position length =
-        UnsignedMin(*size - src.pos(), internal::RemainingInBlock(pos_));
+        UnsignedMin(*size - src.pos(),
+                    internal::RemainingInBlock(pos_, block_size_));
     if (ABSL_PREDICT_FALSE(!src.Copy(length, dest))) {
       return FailWithoutAnnotation(dest.status());
     }
@@ -122,7 +188,7 @@ inline bool DefaultChunkWriterBase::WritePadding(Position chunk_begin,
                                                  Position chunk_end,
                                                  Writer& dest) {
   while (pos_ < chunk_end) {
-    if (internal::IsBlockBoundary(pos_)) {
+    if (internal::IsBlockBoundary(pos_, block_size_)) {
       internal::BlockHeader block_header(IntCast<uint64_t>(pos_ - chunk_begin),
                                          IntCast<uint64_t>(chunk_end - pos_));
       if (ABSL_PREDICT_FALSE(
@@ -132,7 +198,8 @@ inline bool DefaultChunkWriterBase::WritePadding(Position chunk_begin,
       pos_ += block_header.size();
     }
     const Position length =
-        UnsignedMin(chunk_end - pos_, internal::RemainingInBlock(pos_));
+        UnsignedMin(chunk_end - pos_,
+                    internal::RemainingInBlock(pos_, block_size_));
     if (ABSL_PREDICT_FALSE(!dest.WriteZeros(length))) {
       return FailWithoutAnnotation(dest.status());
     }
@@ -144,11 +211,12 @@ inline bool DefaultChunkWriterBase::WritePadding(Position chunk_begin,
 bool DefaultChunkWriterBase::PadToBlockBoundary() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   // Matches `FutureRecordPosition::FutureChunkBegin::Resolve()`.
-  size_t length = IntCast<size_t>(internal::RemainingInBlock(pos_));
+  size_t length =
+      IntCast<size_t>(internal::RemainingInBlock(pos_, block_size_));
   if (length == 0) return true;
   if (length < ChunkHeader::size()) {
     // Not enough space for a padding chunk in this block. Write one more block.
-    length += size_t{internal::kUsableBlockSize};
+    length += IntCast<size_t>(internal::UsableBlockSize(block_size_));
   }
   length -= ChunkHeader::size();
   Chunk chunk;
@@ -28,6 +28,8 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/records/block.h"
 
 namespace riegeli {
 
@@ -48,7 +50,7 @@ class ChunkWriter : public Object {
   //  * `false` - failure (`!healthy()`)
   virtual bool WriteChunk(const Chunk& chunk) = 0;
 
-  // Writes padding to reach a 64KB block boundary.
+  // Writes padding to reach a block boundary.
   //
   // Return values:
   //  * `true`  - success (`healthy()`)
@@ -83,6 +85,14 @@ class ChunkWriter : public Object {
   // Returns the current byte position. Unchanged by `Close()`.
   Position pos() const { return pos_; }
 
+  // Returns the block size of the file being written. Unchanged by `Close()`.
+  //
+  // This is the block size declared by the file signature, which is written
+  // as the first chunk of a file written from the beginning, or found in the
+  // existing file when appending to it. Otherwise this depends on the
+  // `ChunkWriter`, by default `internal::kBlockSize` (64KB).
+  Position block_size() const { return block_size_; }
+
  protected:
   using Object::Object;
 
@@ -91,10 +101,15 @@ class ChunkWriter : public Object {
 
   void Reset(Closed);
   void Reset();
-  void Initialize(Position pos) { pos_ = pos; }
+  void Initialize(Position pos, Position block_size = internal::kBlockSize);
   virtual bool FlushImpl(FlushType flush_type) = 0;
 
+  // If `chunk_header` is the header of the file signature about to be written
+  // at position 0, sets `block_size()` to the block size declared by it.
+  void UpdateBlockSize(const ChunkHeader& chunk_header);
+
   Position pos_ = 0;
+  Position block_size_ = internal::kBlockSize;
 };
 
 // Template parameter independent part of `DefaultChunkWriter`.
@@ -119,8 +134,60 @@ class DefaultChunkWriterBase : public ChunkWriter {
     }
     absl::optional<Position> assumed_pos() const { return assumed_pos_; }
 
+    // Sets the block size of the file, used unless the file signature is
+    // written from position 0 (which declares the block size) or the existing
+    // file is appended to (where the block size is read from the file).
+    //
+    // This can be used together with `set_assumed_pos()` to prepare a fragment
+    // of a file with a block size different from the default.
+    //
+    // `block_size` must be a power of 2 between `internal::kBlockSize` (64KB)
+    // and `internal::kMaxBlockSize` (16MB).
+    //
+    // Default: `internal::kBlockSize` (64KB).
+    Options& set_block_size(Position block_size) & {
+      RIEGELI_ASSERT(internal::IsValidBlockSize(block_size))
+          << "Failed precondition of "
+             "DefaultChunkWriterBase::Options::set_block_size(): "
+             "block size out of range or not a power of 2";
+      block_size_ = block_size;
+      return *this;
+    }
+    Options&& set_block_size(Position block_size) && {
+      return std::move(set_block_size(block_size));
+    }
+    Position block_size() const { return block_size_; }
+
+    // If `true`, existing contents of the destination are kept and chunks are
+    // appended after them.
+    //
+    // The existing file is validated from its last complete chunk: contents
+    // after the end of the last complete chunk, e.g. a chunk torn by a crash
+    // while it was being written, are truncated. Corrupted regions followed by
+    // valid chunks are kept, so that no valid chunk is lost; readers skip them
+    // with recovery. Writing continues at the end, after padding to a position
+    // where a chunk can begin.
+    //
+    // This requires the byte `Writer` to support `ReadMode()` and
+    // `Truncate()`, e.g. `FdWriter` opened with `O_RDWR | O_CREAT` (without
+    // `O_APPEND` and `O_TRUNC`).
+    //
+    // `set_append(true)` is incompatible with `set_assumed_pos()`.
+    //
+    // Default: `false`.
+    Options& set_append(bool append) & {
+      append_ = append;
+      return *this;
+    }
+    Options&& set_append(bool append) && {
+      return std::move(set_append(append));
+    }
+    bool append() const { return append_; }
+
    private:
     absl::optional<Position> assumed_pos_;
+    Position block_size_ = internal::kBlockSize;
+    bool append_ = false;
   };
 
   // Returns the Riegeli/records file being written to. Unchanged by `Close()`.
@@ -136,7 +203,7 @@ class DefaultChunkWriterBase : public ChunkWriter {
   DefaultChunkWriterBase(DefaultChunkWriterBase&& that) noexcept;
   DefaultChunkWriterBase& operator=(DefaultChunkWriterBase&& that) noexcept;
 
-  void Initialize(Writer* dest, Position pos);
+  void Initialize(Writer* dest, const Options& options);
 
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
       absl::Status status) override;
@@ -145,6 +212,10 @@ class DefaultChunkWriterBase : public ChunkWriter {
   bool WriteSection(Reader& src, Position chunk_begin, Position chunk_end,
                     Writer& dest);
   bool WritePadding(Position chunk_begin, Position chunk_end, Writer& dest);
+
+  // Truncates `dest` after the last complete chunk, for `Options::append()`.
+  // Sets `block_size` to the block size of the existing file, if any.
+  bool TruncateIncompleteTail(Writer& dest, Position& block_size);
 };
 
 // The default `ChunkWriter`. Writes chunks to a byte `Writer`, interleaving
@@ -233,24 +304,41 @@ inline ChunkWriter::ChunkWriter(ChunkWriter&& that) noexcept
     : Object(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
-      pos_(that.pos_) {}
+      pos_(that.pos_),
+      block_size_(that.block_size_) {}
 
 inline ChunkWriter& ChunkWriter::operator=(ChunkWriter&& that) noexcept {
   Object::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   pos_ = that.pos_;
+  block_size_ = that.block_size_;
   return *this;
 }
 
 inline void ChunkWriter::Reset(Closed) {
   Object::Reset(kClosed);
   pos_ = 0;
+  block_size_ = internal::kBlockSize;
 }
 
 inline void ChunkWriter::Reset() {
   Object::Reset();
   pos_ = 0;
+  block_size_ = internal::kBlockSize;
+}
+
+inline void ChunkWriter::Initialize(Position pos, Position block_size) {
+  pos_ = pos;
+  block_size_ = block_size;
+}
+
+inline void ChunkWriter::UpdateBlockSize(const ChunkHeader& chunk_header) {
+  if (pos_ == 0 && chunk_header.chunk_type() == ChunkType::kFileSignature) {
+    const Position block_size =
+        internal::BlockSizeFromFileSignature(chunk_header);
+    if (ABSL_PREDICT_TRUE(block_size != 0)) block_size_ = block_size;
+  }
 }
 
 inline bool ChunkWriter::Flush(FlushType flush_type) {
@@ -271,14 +359,14 @@ template <typename Dest>
 inline DefaultChunkWriter<Dest>::DefaultChunkWriter(const Dest& dest,
                                                     Options options)
     : dest_(dest) {
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
 inline DefaultChunkWriter<Dest>::DefaultChunkWriter(Dest&& dest,
                                                     Options options)
     : dest_(std::move(dest)) {
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
@@ -286,7 +374,7 @@ template <typename... DestArgs>
 inline DefaultChunkWriter<Dest>::DefaultChunkWriter(
     std::tuple<DestArgs...> dest_args, Options options)
     : dest_(std::move(dest_args)) {
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
@@ -317,14 +405,14 @@ template <typename Dest>
 inline void DefaultChunkWriter<Dest>::Reset(const Dest& dest, Options options) {
   DefaultChunkWriterBase::Reset();
   dest_.Reset(dest);
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
 inline void DefaultChunkWriter<Dest>::Reset(Dest&& dest, Options options) {
   DefaultChunkWriterBase::Reset();
   dest_.Reset(std::move(dest));
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
@@ -333,7 +421,7 @@ inline void DefaultChunkWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                             Options options) {
   DefaultChunkWriterBase::Reset();
   dest_.Reset(std::move(dest_args));
-  Initialize(dest_.get(), options.assumed_pos().value_or(dest_->pos()));
+  Initialize(dest_.get(), options);
 }
 
 template <typename Dest>
@@ -0,0 +1,128 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/records/key_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+void KeyIndex::Add(absl::string_view first_key) {
+  RIEGELI_ASSERT(empty() || first_key > absl::string_view(first_keys_.back()))
+      << "Failed precondition of KeyIndex::Add(): "
+         "keys added in the wrong order";
+  first_keys_.emplace_back(first_key.data(), first_key.size());
+}
+
+absl::optional<size_t> KeyIndex::ChunkBefore(absl::string_view key) const {
+  const std::vector<std::string>::const_iterator next = std::upper_bound(
+      first_keys_.begin(), first_keys_.end(), key,
+      [](absl::string_view a, absl::string_view b) { return a < b; });
+  if (next == first_keys_.begin()) return absl::nullopt;
+  return IntCast<size_t>(std::distance(first_keys_.begin(), next) - 1);
+}
+
+// Format of key index chunk data, all integers are varint64:
+//  * `num_chunks` - number of chunks with records
+//  * for each chunk with records:
+//    * length of the prefix shared with the first key of the previous chunk
+//      (0 for the first chunk)
+//    * length of the remaining suffix
+//    * the suffix
+void KeyIndex::Encode(Chunk& chunk) const {
+  chunk.Clear();
+  ChainWriter<> data_writer(&chunk.data);
+  WriteVarint64(IntCast<uint64_t>(size()), data_writer);
+  absl::string_view prev_key;
+  for (const std::string& key : first_keys_) {
+    const size_t max_shared = UnsignedMin(prev_key.size(), key.size());
+    size_t shared = 0;
+    while (shared < max_shared && prev_key[shared] == key[shared]) ++shared;
+    WriteVarint64(IntCast<uint64_t>(shared), data_writer);
+    WriteVarint64(IntCast<uint64_t>(key.size() - shared), data_writer);
+    data_writer.Write(absl::string_view(key).substr(shared));
+    prev_key = key;
+  }
+  if (!data_writer.Close()) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << data_writer.status();
+  }
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kKeyIndex, 0, 0);
+}
+
+bool KeyIndex::Decode(const Chunk& chunk) {
+  Clear();
+  if (ABSL_PREDICT_FALSE(chunk.header.chunk_type() != ChunkType::kKeyIndex ||
+                         chunk.header.num_records() != 0)) {
+    return false;
+  }
+  ChainReader<> data_reader(&chunk.data);
+  uint64_t num_chunks;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, num_chunks))) return false;
+  if (ABSL_PREDICT_FALSE(num_chunks > data_reader.Size().value_or(0) / 2)) {
+    // Each chunk is encoded by at least two bytes.
+    return false;
+  }
+  first_keys_.reserve(IntCast<size_t>(num_chunks));
+  std::string key;
+  for (uint64_t i = 0; i < num_chunks; ++i) {
+    uint64_t shared;
+    uint64_t suffix_length;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, shared) ||
+                           shared > key.size() ||
+                           !ReadVarint64(data_reader, suffix_length) ||
+                           suffix_length > data_reader.Size().value_or(0) -
+                                               data_reader.pos())) {
+      Clear();
+      return false;
+    }
+    key.resize(IntCast<size_t>(shared));
+    if (ABSL_PREDICT_FALSE(!data_reader.ReadAndAppend(
+            IntCast<size_t>(suffix_length), key))) {
+      Clear();
+      return false;
+    }
+    if (ABSL_PREDICT_FALSE(!empty() &&
+                           absl::string_view(key) <= first_keys_.back())) {
+      Clear();
+      return false;
+    }
+    first_keys_.push_back(key);
+  }
+  if (ABSL_PREDICT_FALSE(!data_reader.VerifyEndAndClose())) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace riegeli
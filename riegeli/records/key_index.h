@@ -0,0 +1,118 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_RECORDS_KEY_INDEX_H_
+#define RIEGELI_RECORDS_KEY_INDEX_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk.h"
+
+namespace riegeli {
+
+// Computes the key of a serialized record for a key index. The result may
+// point into `record`.
+//
+// If `nullptr` is used in place of a `RecordKeyFunction`, the key is the whole
+// record.
+using RecordKeyFunction =
+    std::function<absl::string_view(absl::string_view record)>;
+
+// Returns the key of `record` computed by `record_key`, or `record` itself if
+// `record_key` is `nullptr`.
+absl::string_view RecordKey(const RecordKeyFunction& record_key,
+                            absl::string_view record);
+
+// First keys of chunks containing records of a Riegeli/records file whose
+// records are sorted by their keys.
+//
+// `RecordWriter` writes a key index chunk just before the chunk index chunk
+// if `RecordWriterBase::Options::key_index()` is `true`. The `i`-th key
+// corresponds to the `i`-th chunk of the `ChunkIndex`. `RecordReader` loads
+// it lazily in `Lookup()` to find the only chunk which can contain a key.
+class KeyIndex {
+ public:
+  // Creates an empty `KeyIndex`.
+  KeyIndex() noexcept {}
+
+  KeyIndex(const KeyIndex& that) = default;
+  KeyIndex& operator=(const KeyIndex& that) = default;
+
+  KeyIndex(KeyIndex&& that) noexcept = default;
+  KeyIndex& operator=(KeyIndex&& that) noexcept = default;
+
+  // Makes `*this` equivalent to a newly constructed `KeyIndex`.
+  void Clear() { first_keys_.clear(); }
+
+  // Adds the first key of the next chunk with records.
+  //
+  // Precondition: `empty() || first_key > this->first_key(size() - 1)`
+  void Add(absl::string_view first_key);
+
+  // Returns the number of chunks.
+  size_t size() const { return first_keys_.size(); }
+  bool empty() const { return first_keys_.empty(); }
+
+  // Returns the first key of the `chunk_index`-th chunk.
+  //
+  // Precondition: `chunk_index < size()`
+  absl::string_view first_key(size_t chunk_index) const;
+
+  // Returns the index of the last chunk whose first key is at most `key`, or
+  // `absl::nullopt` if there is no such chunk.
+  absl::optional<size_t> ChunkBefore(absl::string_view key) const;
+
+  // Encodes the index as a key index chunk.
+  //
+  // Keys are prefix-compressed: each key is stored as the length of the prefix
+  // shared with the previous key, followed by the remaining suffix.
+  void Encode(Chunk& chunk) const;
+
+  // Decodes the index from a key index chunk.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - the chunk is not a valid key index chunk (`*this` is cleared)
+  bool Decode(const Chunk& chunk);
+
+ private:
+  // Invariant: `first_keys_` are sorted and unique
+  std::vector<std::string> first_keys_;
+};
+
+// Implementation details follow.
+
+inline absl::string_view RecordKey(const RecordKeyFunction& record_key,
+                                   absl::string_view record) {
+  return record_key == nullptr ? record : record_key(record);
+}
+
+inline absl::string_view KeyIndex::first_key(size_t chunk_index) const {
+  RIEGELI_ASSERT_LT(chunk_index, size())
+      << "Failed precondition of KeyIndex::first_key(): "
+         "chunk index out of range";
+  return first_keys_[chunk_index];
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_KEY_INDEX_H_
@@ -0,0 +1,201 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/record_dataset_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/records/record_reader.h"
+
+namespace riegeli {
+
+void RecordDatasetReader::Done() {
+  if (reader_.is_open()) {
+    if (ABSL_PREDICT_FALSE(!reader_.Close())) FailShard(reader_, shard_);
+  }
+  // A failure of a shard opened in advance but not read is not reported.
+  if (next_reader_.is_open()) next_reader_.Close();
+}
+
+bool RecordDatasetReader::FailShard(const RecordReaderBase& reader,
+                                    size_t shard) {
+  return FailWithoutAnnotation(
+      Annotate(reader.status(), absl::StrCat("reading shard ", shard)));
+}
+
+bool RecordDatasetReader::NextShard() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (reader_.is_open()) {
+    if (ABSL_PREDICT_FALSE(!reader_.healthy())) {
+      return FailShard(reader_, shard_);
+    }
+    if (ABSL_PREDICT_FALSE(!OpenShard(shard_ + 1))) return false;
+  } else {
+    if (ABSL_PREDICT_FALSE(!OpenShard(shard_))) return false;
+  }
+  if (!reader_.is_open()) return false;
+  return PrefetchNextShard();
+}
+
+bool RecordDatasetReader::OpenShard(size_t shard) {
+  RIEGELI_ASSERT_LE(shard, num_shards_)
+      << "Failed precondition of RecordDatasetReader::OpenShard(): "
+         "shard index out of range";
+  if (reader_.is_open()) {
+    if (ABSL_PREDICT_FALSE(!reader_.Close())) {
+      return FailShard(reader_, shard_);
+    }
+  }
+  const size_t prefetched_shard = shard_ + 1;
+  shard_ = shard;
+  if (next_reader_.is_open()) {
+    if (shard == prefetched_shard) {
+      reader_ = std::move(next_reader_);
+      next_reader_.Reset(kClosed);
+      return true;
+    }
+    // The shard opened in advance is not needed.
+    next_reader_.Close();
+  }
+  if (shard == num_shards_) return true;
+  std::unique_ptr<Reader> src = NewShardReader(shard);
+  if (ABSL_PREDICT_FALSE(src == nullptr)) {
+    RIEGELI_ASSERT(!healthy())
+        << "Failed postcondition of RecordDatasetReader::NewShardReader(): "
+           "nullptr returned but RecordDatasetReader healthy";
+    return false;
+  }
+  reader_.Reset(std::move(src), options_.record_reader_options());
+  if (ABSL_PREDICT_FALSE(!reader_.healthy())) return FailShard(reader_, shard);
+  return true;
+}
+
+bool RecordDatasetReader::PrefetchNextShard() {
+  if (!options_.prefetch_next_shard() || next_reader_.is_open() ||
+      shard_ + 1 >= num_shards_) {
+    return true;
+  }
+  std::unique_ptr<Reader> src = NewShardReader(shard_ + 1);
+  if (ABSL_PREDICT_FALSE(src == nullptr)) {
+    RIEGELI_ASSERT(!healthy())
+        << "Failed postcondition of RecordDatasetReader::NewShardReader(): "
+           "nullptr returned but RecordDatasetReader healthy";
+    return false;
+  }
+  next_reader_.Reset(std::move(src), options_.record_reader_options());
+  // Reading the file signature opens the shard. A failure is reported when the
+  // shard is read.
+  next_reader_.CheckFileFormat();
+  return true;
+}
+
+bool RecordDatasetReader::Seek(RecordDatasetPosition new_pos) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (new_pos.shard >= num_shards_) return OpenShard(num_shards_);
+  if (new_pos.shard != shard_ || !reader_.is_open()) {
+    if (ABSL_PREDICT_FALSE(!OpenShard(new_pos.shard))) return false;
+  }
+  if (ABSL_PREDICT_FALSE(!reader_.Seek(new_pos.pos))) {
+    return FailShard(reader_, shard_);
+  }
+  return true;
+}
+
+bool RecordDatasetReader::SeekToRecordNumber(uint64_t record_number) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!LoadRecordCounts())) return false;
+  const size_t shard = IntCast<size_t>(
+      std::upper_bound(records_ends_.begin(), records_ends_.end(),
+                       record_number) -
+      records_ends_.begin());
+  if (shard == num_shards_) return OpenShard(num_shards_);
+  if (shard != shard_ || !reader_.is_open()) {
+    if (ABSL_PREDICT_FALSE(!OpenShard(shard))) return false;
+  }
+  const uint64_t records_before = shard == 0 ? 0 : records_ends_[shard - 1];
+  if (ABSL_PREDICT_FALSE(
+          !reader_.SeekToRecordNumber(record_number - records_before))) {
+    return FailShard(reader_, shard_);
+  }
+  return true;
+}
+
+absl::optional<uint64_t> RecordDatasetReader::NumRecords() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!LoadRecordCounts())) return absl::nullopt;
+  return records_ends_.empty() ? 0 : records_ends_.back();
+}
+
+absl::optional<uint64_t> RecordDatasetReader::RecordsBeforeShard(
+    size_t shard) {
+  RIEGELI_ASSERT_LE(shard, num_shards_)
+      << "Failed precondition of RecordDatasetReader::RecordsBeforeShard(): "
+         "shard index out of range";
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!LoadRecordCounts())) return absl::nullopt;
+  return shard == 0 ? 0 : records_ends_[shard - 1];
+}
+
+bool RecordDatasetReader::LoadRecordCounts() {
+  if (records_ends_.size() == num_shards_) return true;
+  // Shards which are not already open are opened only to count their records,
+  // so chunks are not read ahead.
+  RecordReaderBase::Options reader_options = options_.record_reader_options();
+  reader_options.set_parallelism(0);
+  std::vector<uint64_t> records_ends;
+  records_ends.reserve(num_shards_);
+  uint64_t num_records = 0;
+  for (size_t shard = 0; shard < num_shards_; ++shard) {
+    absl::optional<uint64_t> shard_records;
+    if (reader_.is_open() && shard == shard_) {
+      shard_records = reader_.NumRecords();
+      if (ABSL_PREDICT_FALSE(shard_records == absl::nullopt)) {
+        return FailShard(reader_, shard);
+      }
+    } else {
+      std::unique_ptr<Reader> src = NewShardReader(shard);
+      if (ABSL_PREDICT_FALSE(src == nullptr)) {
+        RIEGELI_ASSERT(!healthy())
+            << "Failed postcondition of RecordDatasetReader::NewShardReader(): "
+               "nullptr returned but RecordDatasetReader healthy";
+        return false;
+      }
+      RecordReader<std::unique_ptr<Reader>> reader(std::move(src),
+                                                   reader_options);
+      shard_records = reader.NumRecords();
+      if (ABSL_PREDICT_FALSE(shard_records == absl::nullopt ||
+                             !reader.Close())) {
+        return FailShard(reader, shard);
+      }
+    }
+    num_records += *shard_records;
+    records_ends.push_back(num_records);
+  }
+  records_ends_ = std::move(records_ends);
+  return true;
+}
+
+}  // namespace riegeli
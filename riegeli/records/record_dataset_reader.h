@@ -0,0 +1,283 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORD_DATASET_READER_H_
+#define RIEGELI_RECORDS_RECORD_DATASET_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+
+namespace riegeli {
+
+// A position of a record in a dataset, i.e. the index of its shard and its
+// position in the shard.
+//
+// The end of the dataset is represented by `shard == num_shards()`.
+struct RecordDatasetPosition {
+  RecordDatasetPosition() noexcept {}
+  explicit RecordDatasetPosition(size_t shard,
+                                 RecordPosition pos = RecordPosition()) noexcept
+      : shard(shard), pos(pos) {}
+
+  size_t shard = 0;
+  RecordPosition pos;
+};
+
+// Abstract class of an object which reads records from a dataset consisting of
+// a sequence of Riegeli/records files called shards, as if they were
+// concatenated.
+//
+// Shards are opened lazily, when reading or seeking reaches them. Record
+// numbers are global across the dataset: numbers of records in shards are
+// taken from their chunk indices if present, or from their chunk headers, and
+// they are loaded once, when a record number is needed.
+//
+// A derived class provides the source of each shard, e.g. a file from a list
+// of file names, by overriding `NewShardReader()`.
+class RecordDatasetReader : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Options for `RecordReader`s of shards.
+    //
+    // Default: `RecordReaderBase::Options()`.
+    Options& set_record_reader_options(
+        RecordReaderBase::Options record_reader_options) & {
+      record_reader_options_ = std::move(record_reader_options);
+      return *this;
+    }
+    Options&& set_record_reader_options(
+        RecordReaderBase::Options record_reader_options) && {
+      return std::move(
+          set_record_reader_options(std::move(record_reader_options)));
+    }
+    RecordReaderBase::Options& record_reader_options() {
+      return record_reader_options_;
+    }
+    const RecordReaderBase::Options& record_reader_options() const {
+      return record_reader_options_;
+    }
+
+    // If `true`, when reading sequentially moves to the next shard, the shard
+    // after it is opened in advance and its beginning is read, so that the
+    // latency of opening it is hidden behind reading the current shard.
+    //
+    // Default: `false`.
+    Options& set_prefetch_next_shard(bool prefetch_next_shard) & {
+      prefetch_next_shard_ = prefetch_next_shard;
+      return *this;
+    }
+    Options&& set_prefetch_next_shard(bool prefetch_next_shard) && {
+      return std::move(set_prefetch_next_shard(prefetch_next_shard));
+    }
+    bool prefetch_next_shard() const { return prefetch_next_shard_; }
+
+   private:
+    RecordReaderBase::Options record_reader_options_;
+    bool prefetch_next_shard_ = false;
+  };
+
+  // Returns the number of shards.
+  size_t num_shards() const { return num_shards_; }
+
+  // Reads the next record, moving to next shards when the current shard ends.
+  //
+  // `record` is anything accepted by `RecordReaderBase::ReadRecord()`.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - end of the dataset
+  //  * `false` (when `!healthy()`) - failure
+  template <typename Record>
+  bool ReadRecord(Record& record);
+
+  // Returns the position of the next record, or the end of the dataset.
+  RecordDatasetPosition pos() const;
+
+  // Seeks to a position, which should have been obtained by `pos()`.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Seek(RecordDatasetPosition new_pos);
+
+  // Seeks to the record with the given number, counting records in the
+  // dataset from 0. If `record_number` is not smaller than the number of
+  // records, seeks to the end of the dataset.
+  //
+  // Afterwards `pos()` is the position of that record, which maps a record
+  // number to a shard and a `RecordPosition` in it.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool SeekToRecordNumber(uint64_t record_number);
+
+  // Returns the number of records in the dataset.
+  //
+  // Returns `absl::nullopt` on failure (`!healthy()`).
+  absl::optional<uint64_t> NumRecords();
+
+  // Returns the number of records in shards before `shard`.
+  //
+  // Precondition: `shard <= num_shards()`
+  //
+  // Returns `absl::nullopt` on failure (`!healthy()`).
+  absl::optional<uint64_t> RecordsBeforeShard(size_t shard);
+
+ protected:
+  explicit RecordDatasetReader(Closed) noexcept : Object(kClosed) {}
+
+  explicit RecordDatasetReader(size_t num_shards, Options options = Options());
+
+  RecordDatasetReader(RecordDatasetReader&& that) noexcept;
+  RecordDatasetReader& operator=(RecordDatasetReader&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `RecordDatasetReader`.
+  // This avoids constructing a temporary `RecordDatasetReader` and moving from
+  // it. Derived classes which redefine `Reset()` should include a call to
+  // `RecordDatasetReader::Reset()`.
+  void Reset(Closed);
+  void Reset(size_t num_shards, Options options = Options());
+
+  // Closes open shards. Derived classes which override `Done()` should call
+  // `RecordDatasetReader::Done()` before releasing resources used by
+  // `NewShardReader()`.
+  void Done() override;
+
+  // Returns the source of the shard with index `shard` (counting from 0).
+  //
+  // Return values:
+  //  * non-null  - success
+  //  * `nullptr` - failure (`!healthy()`)
+  virtual std::unique_ptr<Reader> NewShardReader(size_t shard) = 0;
+
+ private:
+  // Called when `reader_` could not read a record. Moves to the next shard.
+  //
+  // Return values:
+  //  * `true`                      - a next shard is open
+  //  * `false` (when `healthy()`)  - end of the dataset
+  //  * `false` (when `!healthy()`) - failure
+  bool NextShard();
+  // Makes `reader_` read `shard` from its beginning, or closes it if
+  // `shard == num_shards_`.
+  bool OpenShard(size_t shard);
+  // Opens `next_reader_` for the shard after `shard_` if applicable.
+  bool PrefetchNextShard();
+  bool LoadRecordCounts();
+  ABSL_ATTRIBUTE_COLD bool FailShard(const RecordReaderBase& reader,
+                                     size_t shard);
+
+  Options options_;
+  size_t num_shards_ = 0;
+  // The index of the shard read by `reader_` if it is open. Otherwise the
+  // index of the shard to open when reading, or `num_shards_` at the end of
+  // the dataset.
+  size_t shard_ = 0;
+  RecordReader<std::unique_ptr<Reader>> reader_{kClosed};
+  // If open, reads the shard with index `shard_ + 1` opened in advance, not
+  // yet used.
+  RecordReader<std::unique_ptr<Reader>> next_reader_{kClosed};
+  // `records_ends_[i]` is the number of records in shards `[0..i]`, or
+  // `records_ends_` is empty if they have not been loaded yet.
+  std::vector<uint64_t> records_ends_;
+};
+
+// Implementation details follow.
+
+inline RecordDatasetReader::RecordDatasetReader(size_t num_shards,
+                                                Options options)
+    : options_(std::move(options)), num_shards_(num_shards) {}
+
+inline RecordDatasetReader::RecordDatasetReader(
+    RecordDatasetReader&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      options_(std::move(that.options_)),
+      num_shards_(that.num_shards_),
+      shard_(that.shard_),
+      reader_(std::move(that.reader_)),
+      next_reader_(std::move(that.next_reader_)),
+      records_ends_(std::move(that.records_ends_)) {}
+
+inline RecordDatasetReader& RecordDatasetReader::operator=(
+    RecordDatasetReader&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  options_ = std::move(that.options_);
+  num_shards_ = that.num_shards_;
+  shard_ = that.shard_;
+  reader_ = std::move(that.reader_);
+  next_reader_ = std::move(that.next_reader_);
+  records_ends_ = std::move(that.records_ends_);
+  return *this;
+}
+
+inline void RecordDatasetReader::Reset(Closed) {
+  Object::Reset(kClosed);
+  options_ = Options();
+  num_shards_ = 0;
+  shard_ = 0;
+  reader_.Reset(kClosed);
+  next_reader_.Reset(kClosed);
+  records_ends_.clear();
+}
+
+inline void RecordDatasetReader::Reset(size_t num_shards, Options options) {
+  Object::Reset();
+  options_ = std::move(options);
+  num_shards_ = num_shards;
+  shard_ = 0;
+  reader_.Reset(kClosed);
+  next_reader_.Reset(kClosed);
+  records_ends_.clear();
+}
+
+inline RecordDatasetPosition RecordDatasetReader::pos() const {
+  if (reader_.is_open()) return RecordDatasetPosition(shard_, reader_.pos());
+  return RecordDatasetPosition(shard_);
+}
+
+template <typename Record>
+inline bool RecordDatasetReader::ReadRecord(Record& record) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  do {
+    if (ABSL_PREDICT_TRUE(reader_.is_open()) && reader_.ReadRecord(record)) {
+      return true;
+    }
+  } while (NextShard());
+  return false;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORD_DATASET_READER_H_
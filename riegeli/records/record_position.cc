@@ -116,26 +116,30 @@ std::ostream& operator<<(std::ostream& out, RecordPosition pos) {
 namespace internal {
 
 inline FutureChunkBegin::Unresolved::Unresolved(Position pos_before_chunks,
-                                                std::vector<Action> actions)
-    : pos_before_chunks_(pos_before_chunks), actions_(std::move(actions)) {}
+                                                std::vector<Action> actions,
+                                                Position block_size)
+    : pos_before_chunks_(pos_before_chunks),
+      actions_(std::move(actions)),
+      block_size_(block_size) {}
 
 void FutureChunkBegin::Unresolved::Resolve() const {
   struct Visitor {
     void operator()(const std::shared_future<ChunkHeader>& chunk_header) {
       // Matches `DefaultChunkWriterBase::WriteChunk()`.
-      pos = internal::ChunkEnd(chunk_header.get(), pos);
+      pos = internal::ChunkEnd(chunk_header.get(), pos, block_size);
     }
     void operator()(const PadToBlockBoundary&) {
       // Matches `DefaultChunkWriterBase::PadToBlockBoundary()`.
-      Position length = internal::RemainingInBlock(pos);
+      Position length = internal::RemainingInBlock(pos, block_size);
       if (length == 0) return;
-      if (length < ChunkHeader::size()) length += internal::kBlockSize;
+      if (length < ChunkHeader::size()) length += block_size;
       pos += length;
     }
 
     Position pos;
+    Position block_size;
   };
-  Visitor visitor{pos_before_chunks_};
+  Visitor visitor{pos_before_chunks_, block_size_};
   for (const Action& action : actions_) {
     absl::visit(visitor, action);
   }
@@ -144,10 +148,12 @@ void FutureChunkBegin::Unresolved::Resolve() const {
 }
 
 FutureChunkBegin::FutureChunkBegin(Position pos_before_chunks,
-                                   std::vector<Action> actions)
-    : unresolved_(actions.empty()
-                      ? nullptr
-                      : new Unresolved(pos_before_chunks, std::move(actions))),
+                                   std::vector<Action> actions,
+                                   Position block_size)
+    : unresolved_(actions.empty() ? nullptr
+                                  : new Unresolved(pos_before_chunks,
+                                                   std::move(actions),
+                                                   block_size)),
       resolved_(pos_before_chunks) {}
 
 }  // namespace internal
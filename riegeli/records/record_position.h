@@ -114,8 +114,10 @@ class FutureChunkBegin {
 
   /*implicit*/ FutureChunkBegin(Position chunk_begin) noexcept;
 
+  // Will be resolved by applying `actions` to `pos_before_chunks` in a file
+  // with the given block size.
   explicit FutureChunkBegin(Position pos_before_chunks,
-                            std::vector<Action> actions);
+                            std::vector<Action> actions, Position block_size);
 
   FutureChunkBegin(const FutureChunkBegin& that) noexcept;
   FutureChunkBegin& operator=(const FutureChunkBegin& that) noexcept;
@@ -229,7 +231,8 @@ namespace internal {
 
 class FutureChunkBegin::Unresolved : public RefCountedBase<Unresolved> {
  public:
-  explicit Unresolved(Position pos_before_chunks, std::vector<Action> actions);
+  explicit Unresolved(Position pos_before_chunks, std::vector<Action> actions,
+                      Position block_size);
 
   Unresolved(const Unresolved&) = delete;
   Unresolved& operator=(const Unresolved&) = delete;
@@ -244,6 +247,7 @@ class FutureChunkBegin::Unresolved : public RefCountedBase<Unresolved> {
   mutable Position pos_before_chunks_ = 0;
   // Headers of chunks to be written after `pos_before_chunks_`.
   mutable std::vector<Action> actions_;
+  Position block_size_;
 };
 
 inline Position FutureChunkBegin::Unresolved::get() const {
@@ -17,44 +17,107 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
 #include <functional>
+#include <future>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/compare.h"
 #include "absl/types/optional.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/dynamic_message.h"
 #include "google/protobuf/message.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/binary_search.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/memory.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/field_predicate.h"
 #include "riegeli/chunk_encoding/field_projection.h"
 #include "riegeli/chunk_encoding/transpose_decoder.h"
 #include "riegeli/messages/message_parse.h"
+#include "riegeli/records/block.h"
 #include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/records_metadata.pb.h"
+#include "riegeli/records/records_stats.h"
 #include "riegeli/records/skipped_region.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
+namespace {
+
+// Returns `true` if `chunk` is compressed with the Zstd dictionary of the file.
+inline bool UsesZstdDictionary(const Chunk& chunk) {
+  if (chunk.header.chunk_type() != ChunkType::kSimple &&
+      chunk.header.chunk_type() != ChunkType::kTransposed &&
+      chunk.header.chunk_type() != ChunkType::kTuples) {
+    return false;
+  }
+  // The first byte of chunk data is the compression type.
+  return !chunk.data.empty() &&
+         static_cast<CompressionType>(chunk.data.blocks().front()[0]) ==
+             CompressionType::kZstdWithDictionary;
+}
+
+// Reads column statistics if the next chunk is a column statistics chunk,
+// which follows the chunk with records they describe.
+//
+// If reading fails, the failure is reported when reading the next chunk.
+absl::optional<ChunkStatistics> ReadChunkStatistics(ChunkReader& src) {
+  const ChunkHeader* chunk_header;
+  if (!src.PullChunkHeader(&chunk_header) ||
+      chunk_header->chunk_type() != ChunkType::kColumnStatistics) {
+    return absl::nullopt;
+  }
+  Chunk chunk;
+  ChunkStatistics statistics;
+  if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk) || !statistics.Decode(chunk))) {
+    return absl::nullopt;
+  }
+  return statistics;
+}
+
+// Compares record keys for `RecordReaderBase::Lookup()`.
+inline absl::partial_ordering CompareKeys(absl::string_view a,
+                                          absl::string_view b) {
+  const int result = a.compare(b);
+  if (result < 0) return absl::partial_ordering::less;
+  if (result > 0) return absl::partial_ordering::greater;
+  return absl::partial_ordering::equivalent;
+}
+
+}  // namespace
+
 class RecordsMetadataDescriptors::ErrorCollector
     : public google::protobuf::DescriptorPool::ErrorCollector {
  public:
@@ -101,6 +164,299 @@ const google::protobuf::Descriptor* RecordsMetadataDescriptors::descriptor()
   return pool_->FindMessageTypeByName(record_type_name_);
 }
 
+namespace {
+
+// Process-wide cache of `SharedRecordsMetadata`, keyed by serialized metadata.
+//
+// Entries are held weakly. Expired entries are removed when the number of
+// entries doubles since the last removal, which bounds the memory used by them.
+class SharedRecordsMetadataCache {
+ public:
+  static SharedRecordsMetadataCache& global() {
+    static NoDestructor<SharedRecordsMetadataCache> kGlobal;
+    return *kGlobal;
+  }
+
+  std::shared_ptr<const SharedRecordsMetadata> Find(absl::string_view key) {
+    absl::MutexLock lock(&mutex_);
+    const auto iter = entries_.find(key);
+    if (iter == entries_.end()) return nullptr;
+    return iter->second.lock();
+  }
+
+  // If another thread inserted a live entry for `key` in the meantime, returns
+  // that entry instead of `value`.
+  std::shared_ptr<const SharedRecordsMetadata> Insert(
+      std::string key, std::shared_ptr<const SharedRecordsMetadata> value) {
+    absl::MutexLock lock(&mutex_);
+    std::weak_ptr<const SharedRecordsMetadata>& entry = entries_[key];
+    if (std::shared_ptr<const SharedRecordsMetadata> existing = entry.lock()) {
+      return existing;
+    }
+    entry = value;
+    if (entries_.size() >= 2 * size_after_cleanup_) {
+      for (auto iter = entries_.begin(); iter != entries_.end();) {
+        if (iter->second.expired()) {
+          entries_.erase(iter++);
+        } else {
+          ++iter;
+        }
+      }
+      size_after_cleanup_ = UnsignedMax(entries_.size(), size_t{16});
+    }
+    return value;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::weak_ptr<const SharedRecordsMetadata>>
+      entries_ ABSL_GUARDED_BY(mutex_);
+  size_t size_after_cleanup_ ABSL_GUARDED_BY(mutex_) = 16;
+};
+
+}  // namespace
+
+SharedRecordsMetadata::SharedRecordsMetadata(RecordsMetadata&& metadata)
+    : metadata_(std::move(metadata)), descriptors_(metadata_) {
+  const google::protobuf::Descriptor* const descriptor =
+      descriptors_.descriptor();
+  if (descriptor != nullptr) {
+    factory_ = std::make_unique<google::protobuf::DynamicMessageFactory>();
+    prototype_ = factory_->GetPrototype(descriptor);
+  }
+}
+
+absl::Status SharedRecordsMetadata::Get(
+    const Chain& serialized_metadata,
+    std::shared_ptr<const SharedRecordsMetadata>& result) {
+  std::string key(serialized_metadata);
+  SharedRecordsMetadataCache& cache = SharedRecordsMetadataCache::global();
+  result = cache.Find(key);
+  if (result != nullptr) return absl::OkStatus();
+  RecordsMetadata metadata;
+  {
+    absl::Status status = ParseFromChain(serialized_metadata, metadata);
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+  // Parsing and building descriptors is done without holding the lock, so
+  // concurrent calls for the same metadata may do it more than once.
+  result = cache.Insert(std::move(key),
+                        std::shared_ptr<const SharedRecordsMetadata>(
+                            new SharedRecordsMetadata(std::move(metadata))));
+  return absl::OkStatus();
+}
+
+// Reads chunks ahead of the current chunk and decodes them in background.
+//
+// Chunks read ahead are valid only as long as the `ChunkReader` stays at the
+// position after them. If it was moved by other means, they are discarded.
+class RecordReaderBase::ParallelDecoder {
+ public:
+  explicit ParallelDecoder(int parallelism,
+                           absl::optional<uint64_t> max_decoded_bytes,
+                           FieldProjection field_projection,
+                           Executor* bucket_executor,
+                           absl::optional<uint64_t> streaming_min_size,
+                           absl::optional<FieldPredicate> record_filter,
+                           RecordsStats* stats)
+      : parallelism_(IntCast<size_t>(parallelism)),
+        max_decoded_bytes_(max_decoded_bytes),
+        field_projection_(std::move(field_projection)),
+        bucket_executor_(bucket_executor),
+        streaming_min_size_(streaming_min_size),
+        record_filter_(std::move(record_filter)),
+        stats_(stats) {}
+
+  ParallelDecoder(const ParallelDecoder&) = delete;
+  ParallelDecoder& operator=(const ParallelDecoder&) = delete;
+
+  ~ParallelDecoder() { Clear(); }
+
+  // Changes the field projection for chunks read ahead later.
+  void set_field_projection(FieldProjection field_projection) {
+    field_projection_ = std::move(field_projection);
+  }
+
+  // Discards chunks read ahead. If `stats != nullptr`, waits until they are
+  // decoded.
+  void Clear();
+
+  // Returns the beginning of the first chunk read ahead, or `absl::nullopt` if
+  // there are no valid chunks read ahead.
+  absl::optional<Position> pending_begin(const ChunkReader& src) const {
+    if (decoded_chunks_.empty() || src.pos() != pending_end_) {
+      return absl::nullopt;
+    }
+    return decoded_chunks_.front().chunk_begin;
+  }
+
+  // Reads chunks from `src` and schedules decoding them, until `parallelism`
+  // chunks are read ahead, or the next chunk would exceed `max_decoded_bytes`,
+  // or `src` ends or fails.
+  //
+  // Takes `zstd_dictionary` from the Zstd dictionary chunk if it is read ahead
+  // and `zstd_dictionary` is empty. Stops before a chunk which needs
+  // `zstd_dictionary` if it is empty, so that `ReadChunk()` can load it.
+  void ReadAhead(ChunkReader& src, ZstdDictionary& zstd_dictionary);
+
+  // Takes the first chunk read ahead, waiting for it to be decoded if needed.
+  // Returns the beginning of the chunk.
+  //
+  // Precondition: `pending_begin(src) != absl::nullopt`
+  Position TakeChunk(ChunkDecoder& chunk_decoder);
+
+ private:
+  struct DecodedChunk {
+    Position chunk_begin;
+    uint64_t decoded_size;
+    std::future<ChunkDecoder> chunk_decoder;
+  };
+
+  // Removes the first chunk read ahead from the accounting of queued chunks.
+  void PopChunk();
+
+  struct DecodingTask {
+    Chunk chunk;
+    absl::optional<ChunkStatistics> statistics;
+    FieldProjection field_projection;
+    ZstdDictionary zstd_dictionary;
+    std::promise<ChunkDecoder> chunk_decoder;
+  };
+
+  size_t parallelism_;
+  absl::optional<uint64_t> max_decoded_bytes_;
+  FieldProjection field_projection_;
+  Executor* bucket_executor_;
+  absl::optional<uint64_t> streaming_min_size_;
+  absl::optional<FieldPredicate> record_filter_;
+  RecordsStats* stats_;
+  std::deque<DecodedChunk> decoded_chunks_;
+  // The sum of `decoded_size` in `decoded_chunks_`.
+  uint64_t pending_decoded_bytes_ = 0;
+  // Position of `src` after the last chunk read ahead.
+  //
+  // Invariant: if `!decoded_chunks_.empty()` then
+  //            `pending_end_ >= decoded_chunks_.back().chunk_begin`
+  Position pending_end_ = 0;
+};
+
+void RecordReaderBase::ParallelDecoder::ReadAhead(
+    ChunkReader& src, ZstdDictionary& zstd_dictionary) {
+  if (!decoded_chunks_.empty() && src.pos() != pending_end_) Clear();
+  while (decoded_chunks_.size() < parallelism_) {
+    if (max_decoded_bytes_ != absl::nullopt && !decoded_chunks_.empty()) {
+      // If reading the header fails, the failure is reported by `ReadChunk()`
+      // after the preceding chunks are taken.
+      const ChunkHeader* chunk_header;
+      if (ABSL_PREDICT_FALSE(!src.PullChunkHeader(&chunk_header))) return;
+      if (pending_decoded_bytes_ > *max_decoded_bytes_ ||
+          chunk_header->decoded_data_size() >
+              *max_decoded_bytes_ - pending_decoded_bytes_) {
+        if (stats_ != nullptr) stats_->AddReadAheadStall();
+        return;
+      }
+    }
+    const Position chunk_begin = src.pos();
+    std::unique_ptr<DecodingTask> task = std::make_unique<DecodingTask>();
+    // If reading fails, `src.pos()` stays at `pending_end_`, so the failure is
+    // reported by `ReadChunk()` after the preceding chunks are taken.
+    {
+      internal::StageTimer timer(stats_, RecordsStats::Stage::kIo,
+                                 chunk_begin);
+      if (ABSL_PREDICT_FALSE(!src.ReadChunk(task->chunk))) return;
+      timer.set_chunk_size(ChunkHeader::size() +
+                           task->chunk.header.data_size());
+    }
+    if (ABSL_PREDICT_FALSE(zstd_dictionary.empty())) {
+      if (task->chunk.header.chunk_type() == ChunkType::kZstdDictionary) {
+        zstd_dictionary.set_data(std::string(task->chunk.data));
+      } else if (UsesZstdDictionary(task->chunk) &&
+                 src.SupportsRandomAccess()) {
+        // Leave the chunk to `ReadChunk()`, which loads the dictionary. If
+        // seeking back fails, the failure is reported by `ReadChunk()`.
+        src.Seek(chunk_begin);
+        return;
+      }
+    }
+    if (record_filter_ != absl::nullopt &&
+        task->chunk.header.num_records() > 0) {
+      task->statistics = ReadChunkStatistics(src);
+    }
+    task->field_projection = field_projection_;
+    task->zstd_dictionary = zstd_dictionary;
+    const uint64_t decoded_size = task->chunk.header.decoded_data_size();
+    decoded_chunks_.push_back(DecodedChunk{chunk_begin, decoded_size,
+                                           task->chunk_decoder.get_future()});
+    pending_decoded_bytes_ += decoded_size;
+    if (stats_ != nullptr) stats_->AddQueuedChunk(decoded_size);
+    pending_end_ = src.pos();
+    internal::ThreadPool::global().Schedule([bucket_executor = bucket_executor_,
+                                             streaming_min_size =
+                                                 streaming_min_size_,
+                                             record_filter = record_filter_,
+                                             stats = stats_, chunk_begin,
+                                             task = task.release()] {
+      ChunkDecoder chunk_decoder(
+          ChunkDecoder::Options()
+              .set_field_projection(std::move(task->field_projection))
+              .set_executor(bucket_executor)
+              .set_zstd_dictionary(std::move(task->zstd_dictionary))
+              .set_streaming_min_size(streaming_min_size)
+              .set_record_filter(record_filter));
+      {
+        internal::StageTimer timer(
+            stats, RecordsStats::Stage::kDecode, chunk_begin,
+            ChunkHeader::size() + task->chunk.header.data_size());
+        if (chunk_decoder.Decode(task->chunk,
+                                 task->statistics == absl::nullopt
+                                     ? nullptr
+                                     : &*task->statistics) &&
+            stats != nullptr && task->chunk.header.num_records() > 0) {
+          stats->AddChunk(
+              task->chunk.header.num_records(),
+              ChunkHeader::size() + task->chunk.header.data_size(),
+              task->chunk.header.decoded_data_size());
+        }
+      }
+      task->chunk_decoder.set_value(std::move(chunk_decoder));
+      delete task;
+    });
+  }
+}
+
+void RecordReaderBase::ParallelDecoder::Clear() {
+  while (!decoded_chunks_.empty()) {
+    // Decoding in background reports to `stats_`, which must not be used after
+    // `Close()`, so discarded chunks are waited for.
+    if (stats_ != nullptr) decoded_chunks_.front().chunk_decoder.wait();
+    PopChunk();
+  }
+}
+
+inline void RecordReaderBase::ParallelDecoder::PopChunk() {
+  const uint64_t decoded_size = decoded_chunks_.front().decoded_size;
+  pending_decoded_bytes_ -= decoded_size;
+  if (stats_ != nullptr) stats_->RemoveQueuedChunk(decoded_size);
+  decoded_chunks_.pop_front();
+}
+
+inline Position RecordReaderBase::ParallelDecoder::TakeChunk(
+    ChunkDecoder& chunk_decoder) {
+  RIEGELI_ASSERT(!decoded_chunks_.empty())
+      << "Failed precondition of "
+         "RecordReaderBase::ParallelDecoder::TakeChunk(): "
+         "no chunks read ahead";
+  DecodedChunk& decoded_chunk = decoded_chunks_.front();
+  const Position chunk_begin = decoded_chunk.chunk_begin;
+  {
+    internal::StageTimer timer(stats_, RecordsStats::Stage::kQueueWait,
+                               chunk_begin);
+    chunk_decoder = decoded_chunk.chunk_decoder.get();
+  }
+  PopChunk();
+  return chunk_begin;
+}
+
 RecordReaderBase::RecordReaderBase(Closed) noexcept : Object(kClosed) {}
 
 RecordReaderBase::RecordReaderBase() noexcept {}
@@ -111,9 +467,33 @@ RecordReaderBase::RecordReaderBase(RecordReaderBase&& that) noexcept
       // part was moved.
       chunk_begin_(that.chunk_begin_),
       chunk_decoder_(std::move(that.chunk_decoder_)),
+      bucket_executor_(std::exchange(that.bucket_executor_, nullptr)),
       last_record_is_valid_(std::exchange(that.last_record_is_valid_, false)),
       recoverable_(std::exchange(that.recoverable_, Recoverable::kNo)),
-      recovery_(std::move(that.recovery_)) {}
+      recovery_(std::move(that.recovery_)),
+      parallel_decoder_(std::move(that.parallel_decoder_)),
+      chunk_index_searched_(std::exchange(that.chunk_index_searched_, false)),
+      chunk_index_(std::exchange(that.chunk_index_, absl::nullopt)),
+      chunk_index_pos_(that.chunk_index_pos_),
+      key_index_searched_(std::exchange(that.key_index_searched_, false)),
+      key_index_(std::exchange(that.key_index_, absl::nullopt)),
+      record_key_(std::move(that.record_key_)),
+      time_index_searched_(std::exchange(that.time_index_searched_, false)),
+      time_index_(std::exchange(that.time_index_, absl::nullopt)),
+      record_timestamp_(std::move(that.record_timestamp_)),
+      zstd_dictionary_(std::move(that.zstd_dictionary_)),
+      zstd_dictionary_searched_(
+          std::exchange(that.zstd_dictionary_searched_, false)),
+      projected_range_reads_(that.projected_range_reads_),
+      hash_while_decoding_(that.hash_while_decoding_),
+      readahead_chunks_(that.readahead_chunks_),
+      search_fanout_(that.search_fanout_),
+      chunk_block_pool_(std::move(that.chunk_block_pool_)),
+      access_pattern_(
+          std::exchange(that.access_pattern_, AccessPattern::kNormal)),
+      stats_(std::exchange(that.stats_, nullptr)),
+      chunk_cache_(std::exchange(that.chunk_cache_, nullptr)),
+      chunk_cache_file_id_(std::move(that.chunk_cache_file_id_)) {}
 
 RecordReaderBase& RecordReaderBase::operator=(
     RecordReaderBase&& that) noexcept {
@@ -122,28 +502,98 @@ RecordReaderBase& RecordReaderBase::operator=(
   // was moved.
   chunk_begin_ = that.chunk_begin_;
   chunk_decoder_ = std::move(that.chunk_decoder_);
+  bucket_executor_ = std::exchange(that.bucket_executor_, nullptr);
   last_record_is_valid_ = std::exchange(that.last_record_is_valid_, false);
   recoverable_ = std::exchange(that.recoverable_, Recoverable::kNo);
   recovery_ = std::move(that.recovery_);
+  parallel_decoder_ = std::move(that.parallel_decoder_);
+  chunk_index_searched_ = std::exchange(that.chunk_index_searched_, false);
+  chunk_index_ = std::exchange(that.chunk_index_, absl::nullopt);
+  chunk_index_pos_ = that.chunk_index_pos_;
+  key_index_searched_ = std::exchange(that.key_index_searched_, false);
+  key_index_ = std::exchange(that.key_index_, absl::nullopt);
+  record_key_ = std::move(that.record_key_);
+  time_index_searched_ = std::exchange(that.time_index_searched_, false);
+  time_index_ = std::exchange(that.time_index_, absl::nullopt);
+  record_timestamp_ = std::move(that.record_timestamp_);
+  zstd_dictionary_ = std::move(that.zstd_dictionary_);
+  zstd_dictionary_searched_ =
+      std::exchange(that.zstd_dictionary_searched_, false);
+  projected_range_reads_ = that.projected_range_reads_;
+  hash_while_decoding_ = that.hash_while_decoding_;
+  readahead_chunks_ = that.readahead_chunks_;
+  search_fanout_ = that.search_fanout_;
+  chunk_block_pool_ = std::move(that.chunk_block_pool_);
+  access_pattern_ = std::exchange(that.access_pattern_, AccessPattern::kNormal);
+  stats_ = std::exchange(that.stats_, nullptr);
+  chunk_cache_ = std::exchange(that.chunk_cache_, nullptr);
+  chunk_cache_file_id_ = std::move(that.chunk_cache_file_id_);
   return *this;
 }
 
+RecordReaderBase::~RecordReaderBase() {}
+
 void RecordReaderBase::Reset(Closed) {
   Object::Reset(kClosed);
   chunk_begin_ = 0;
   chunk_decoder_.Reset();
+  bucket_executor_ = nullptr;
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
   recovery_ = nullptr;
+  parallel_decoder_.reset();
+  chunk_index_searched_ = false;
+  chunk_index_ = absl::nullopt;
+  chunk_index_pos_ = 0;
+  key_index_searched_ = false;
+  key_index_ = absl::nullopt;
+  record_key_ = nullptr;
+  time_index_searched_ = false;
+  time_index_ = absl::nullopt;
+  record_timestamp_ = nullptr;
+  zstd_dictionary_ = ZstdDictionary();
+  zstd_dictionary_searched_ = false;
+  projected_range_reads_ = false;
+  hash_while_decoding_ = false;
+  readahead_chunks_ = 0;
+  search_fanout_ = 1;
+  chunk_block_pool_.reset();
+  access_pattern_ = AccessPattern::kNormal;
+  stats_ = nullptr;
+  chunk_cache_ = nullptr;
+  chunk_cache_file_id_.clear();
 }
 
 void RecordReaderBase::Reset() {
   Object::Reset();
   chunk_begin_ = 0;
   chunk_decoder_.Clear();
+  bucket_executor_ = nullptr;
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
   recovery_ = nullptr;
+  parallel_decoder_.reset();
+  chunk_index_searched_ = false;
+  chunk_index_ = absl::nullopt;
+  chunk_index_pos_ = 0;
+  key_index_searched_ = false;
+  key_index_ = absl::nullopt;
+  record_key_ = nullptr;
+  time_index_searched_ = false;
+  time_index_ = absl::nullopt;
+  record_timestamp_ = nullptr;
+  zstd_dictionary_ = ZstdDictionary();
+  zstd_dictionary_searched_ = false;
+  projected_range_reads_ = false;
+  hash_while_decoding_ = false;
+  readahead_chunks_ = 0;
+  search_fanout_ = 1;
+  // `chunk_block_pool_` is kept so that blocks cached while reading the
+  // previous source are reused if `Initialize()` keeps the same pool size.
+  access_pattern_ = AccessPattern::kNormal;
+  stats_ = nullptr;
+  chunk_cache_ = nullptr;
+  chunk_cache_file_id_.clear();
 }
 
 void RecordReaderBase::Initialize(ChunkReader* src, Options&& options) {
@@ -154,17 +604,58 @@ void RecordReaderBase::Initialize(ChunkReader* src, Options&& options) {
     return;
   }
   chunk_begin_ = src->pos();
-  chunk_decoder_.Reset(ChunkDecoder::Options().set_field_projection(
-      std::move(options.field_projection())));
+  stats_ = options.stats();
+  chunk_cache_ = options.chunk_cache();
+  chunk_cache_file_id_ = std::move(options.chunk_cache_file_id());
+  record_key_ = std::move(options.record_key());
+  record_timestamp_ = std::move(options.record_timestamp());
+  if (options.parallel_buckets()) {
+    bucket_executor_ = &internal::ThreadPool::global();
+  }
+  if (options.parallelism() > 0) {
+    parallel_decoder_ = std::make_unique<ParallelDecoder>(
+        options.parallelism(), options.max_decoded_bytes(),
+        options.field_projection(), bucket_executor_,
+        options.streaming_min_size(), options.record_filter(), stats_);
+  }
+  chunk_decoder_.Reset(
+      ChunkDecoder::Options()
+          .set_field_projection(std::move(options.field_projection()))
+          .set_executor(bucket_executor_)
+          .set_streaming_min_size(options.streaming_min_size())
+          .set_record_filter(std::move(options.record_filter())));
   recovery_ = std::move(options.recovery());
+  projected_range_reads_ = options.projected_range_reads();
+  hash_while_decoding_ = options.hash_while_decoding();
+  readahead_chunks_ = options.readahead_chunks();
+  search_fanout_ = options.search_fanout();
+  if (options.chunk_block_pool_size() == 0) {
+    chunk_block_pool_.reset();
+  } else if (chunk_block_pool_ == nullptr ||
+             chunk_block_pool_->max_cached_bytes() !=
+                 options.chunk_block_pool_size()) {
+    chunk_block_pool_ =
+        std::make_unique<ChainBlockPool>(options.chunk_block_pool_size());
+  }
 }
 
 void RecordReaderBase::Done() {
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
+  if (parallel_decoder_ != nullptr && healthy()) {
+    // Move the `ChunkReader` back to the position corresponding to `pos()`.
+    CancelReadAhead();
+  }
+  if (access_pattern_ != AccessPattern::kNormal) {
+    // The byte `Reader` may outlive the `RecordReader`.
+    ChunkReader& src = *src_chunk_reader();
+    src.SetAccessPattern(AccessPattern::kNormal);
+    access_pattern_ = AccessPattern::kNormal;
+  }
   if (ABSL_PREDICT_FALSE(!chunk_decoder_.Close())) {
     Fail(chunk_decoder_.status());
   }
+  if (stats_ != nullptr) stats_->Report();
 }
 
 inline bool RecordReaderBase::FailReading(const ChunkReader& src) {
@@ -190,13 +681,20 @@ absl::Status RecordReaderBase::AnnotateStatusImpl(absl::Status status) {
 }
 
 absl::Status RecordReaderBase::AnnotateOverSrc(absl::Status status) {
-  return Annotate(status, absl::StrCat("at record ", pos().ToString()));
+  const RecordPosition record_pos = pos();
+  return Annotate(status, absl::StrCat("at record ", record_pos.chunk_begin(),
+                                       "/", record_pos.record_index()));
 }
 
 bool RecordReaderBase::CheckFileFormat() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   if (chunk_decoder_.num_records() > 0) return true;
   ChunkReader& src = *src_chunk_reader();
+  if (parallel_decoder_ != nullptr &&
+      parallel_decoder_->pending_begin(src) != absl::nullopt) {
+    // Chunks have been read ahead successfully.
+    return true;
+  }
   if (ABSL_PREDICT_FALSE(!src.CheckFileFormat())) {
     chunk_decoder_.Clear();
     if (ABSL_PREDICT_FALSE(!src.healthy())) {
@@ -223,6 +721,23 @@ bool RecordReaderBase::ReadMetadata(RecordsMetadata& metadata) {
   return true;
 }
 
+bool RecordReaderBase::ReadSharedMetadata(
+    std::shared_ptr<const SharedRecordsMetadata>& metadata) {
+  metadata.reset();
+  Chain serialized_metadata;
+  if (ABSL_PREDICT_FALSE(!ReadSerializedMetadata(serialized_metadata))) {
+    return false;
+  }
+  {
+    absl::Status status =
+        SharedRecordsMetadata::Get(serialized_metadata, metadata);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      return Fail(std::move(status));
+    }
+  }
+  return true;
+}
+
 bool RecordReaderBase::ReadSerializedMetadata(Chain& metadata) {
   metadata.Clear();
   if (ABSL_PREDICT_FALSE(!healthy())) return TryRecovery();
@@ -317,6 +832,51 @@ bool RecordReaderBase::ReadRecord(absl::Cord& record) {
   return ReadRecordImpl(record);
 }
 
+bool RecordReaderBase::ReadRecord(std::unique_ptr<Reader>& record) {
+  return ReadRecordImpl(record);
+}
+
+bool RecordReaderBase::ReadRecords(std::vector<absl::string_view>& records) {
+  last_record_is_valid_ = false;
+  for (;;) {
+    if (ABSL_PREDICT_TRUE(chunk_decoder_.ReadRecords(records))) {
+      RIEGELI_ASSERT_GT(chunk_decoder_.index(), 0u)
+          << "ChunkDecoder::ReadRecords() left record index at 0";
+      last_record_is_valid_ = true;
+      return true;
+    }
+    if (ABSL_PREDICT_FALSE(!healthy())) {
+      if (!TryRecovery()) return false;
+      continue;
+    }
+    if (ABSL_PREDICT_FALSE(!chunk_decoder_.healthy())) {
+      recoverable_ = Recoverable::kRecoverChunkDecoder;
+      Fail(chunk_decoder_.status());
+      if (!TryRecovery()) return false;
+      continue;
+    }
+    if (ABSL_PREDICT_FALSE(!ReadNextChunk())) {
+      if (!TryRecovery()) return false;
+    }
+  }
+}
+
+bool RecordReaderBase::ReadRecords(
+    const google::protobuf::MessageLite& prototype,
+    google::protobuf::Arena& arena, size_t max_num_records,
+    std::vector<google::protobuf::MessageLite*>& records) {
+  RIEGELI_ASSERT_GT(max_num_records, 0u)
+      << "Failed precondition of RecordReaderBase::ReadRecords(): "
+         "zero max_num_records";
+  records.clear();
+  while (records.size() < max_num_records) {
+    google::protobuf::MessageLite* const record = prototype.New(&arena);
+    if (ABSL_PREDICT_FALSE(!ReadRecordImpl(*record))) break;
+    records.push_back(record);
+  }
+  return !records.empty();
+}
+
 template <typename Record>
 inline bool RecordReaderBase::ReadRecordImpl(Record& record) {
   last_record_is_valid_ = false;
@@ -337,22 +897,52 @@ inline bool RecordReaderBase::ReadRecordImpl(Record& record) {
       if (!TryRecovery()) return false;
       continue;
     }
-    if (ABSL_PREDICT_FALSE(!ReadChunk())) {
+    if (ABSL_PREDICT_FALSE(!ReadNextChunk())) {
       if (!TryRecovery()) return false;
     }
   }
 }
 
+bool RecordReaderBase::WaitForNewData(absl::Duration timeout,
+                                      absl::Duration max_poll_interval) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const absl::Time deadline = absl::Now() + timeout;
+  absl::Duration poll_interval = absl::Milliseconds(1);
+  for (;;) {
+    if (chunk_decoder_.index() < chunk_decoder_.num_records()) return true;
+    if (ReadNextChunk()) continue;
+    if (ABSL_PREDICT_FALSE(!healthy())) {
+      if (!TryRecovery()) return false;
+      continue;
+    }
+    // The source ends here. Wait before polling it again.
+    const absl::Time now = absl::Now();
+    if (now >= deadline) return false;
+    absl::SleepFor(
+        std::min({poll_interval, max_poll_interval, deadline - now}));
+    poll_interval = std::min(poll_interval * 2, max_poll_interval);
+  }
+}
+
 bool RecordReaderBase::SetFieldProjection(FieldProjection field_projection) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return false;
   ChunkReader& src = *src_chunk_reader();
   const uint64_t record_index = chunk_decoder_.index();
-  chunk_decoder_.Reset(ChunkDecoder::Options().set_field_projection(
-      std::move(field_projection)));
+  if (parallel_decoder_ != nullptr) {
+    parallel_decoder_->set_field_projection(field_projection);
+  }
+  chunk_decoder_.Reset(
+      ChunkDecoder::Options()
+          .set_field_projection(std::move(field_projection))
+          .set_executor(bucket_executor_)
+          .set_streaming_min_size(chunk_decoder_.streaming_min_size())
+          .set_record_filter(chunk_decoder_.record_filter()));
+  // Chunks in the cache were decoded with the previous field projection.
+  chunk_cache_ = nullptr;
   if (ABSL_PREDICT_FALSE(!src.Seek(chunk_begin_))) return FailSeeking(src);
   if (record_index > 0) {
-    if (ABSL_PREDICT_FALSE(!ReadChunk())) return TryRecovery();
-    chunk_decoder_.SetIndex(record_index);
+    if (ABSL_PREDICT_FALSE(!ReadChunk(record_index))) return TryRecovery();
   }
   return true;
 }
@@ -369,7 +959,13 @@ bool RecordReaderBase::Recover(SkippedRegion* skipped_region) {
                                  "recovery does not apply to chunk reader "
                                  "but RecordReader is closed";
   }
-  std::string saved_message(status().message());
+  // The message is needed only for `*skipped_region` when recovering the chunk
+  // decoder. `ChunkReader::Recover()` reports its own message.
+  std::string saved_message;
+  if (skipped_region != nullptr &&
+      recoverable == Recoverable::kRecoverChunkDecoder) {
+    saved_message = std::string(status().message());
+  }
   MarkNotFailed();
   switch (recoverable) {
     case Recoverable::kNo:
@@ -403,6 +999,8 @@ bool RecordReaderBase::SupportsRandomAccess() {
 bool RecordReaderBase::Seek(RecordPosition new_pos) {
   last_record_is_valid_ = false;
   if (ABSL_PREDICT_FALSE(!healthy())) return TryRecovery();
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return false;
+  AdviseRandomReading();
   ChunkReader& src = *src_chunk_reader();
   if (new_pos.chunk_begin() == chunk_begin_) {
     if (new_pos.record_index() == 0 || src.pos() > chunk_begin_) {
@@ -424,23 +1022,47 @@ bool RecordReaderBase::Seek(RecordPosition new_pos) {
       return true;
     }
   }
-  if (ABSL_PREDICT_FALSE(!ReadChunk())) return TryRecovery();
-skip_reading_chunk:
-  chunk_decoder_.SetIndex(new_pos.record_index());
+  if (ABSL_PREDICT_FALSE(!ReadChunk(new_pos.record_index()))) {
+    return TryRecovery();
+  }
   return true;
+skip_reading_chunk:
+  return SetChunkIndex(new_pos.record_index());
 }
 
 bool RecordReaderBase::Seek(Position new_pos) {
   last_record_is_valid_ = false;
   if (ABSL_PREDICT_FALSE(!healthy())) return TryRecovery();
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return false;
+  AdviseRandomReading();
   ChunkReader& src = *src_chunk_reader();
   if (new_pos >= chunk_begin_ && new_pos <= src.pos()) {
     // Seeking inside or just after the current chunk which has been read,
     // or to the beginning of the current chunk which has been located,
     // or to the end of file which has been reached.
   } else {
-    if (ABSL_PREDICT_FALSE(!src.SeekToChunkContaining(new_pos))) {
-      return FailSeeking(src);
+    if (ABSL_PREDICT_FALSE(!LoadChunkIndex())) return false;
+    if (chunk_index_ != absl::nullopt && new_pos < chunk_index_pos_) {
+      // Locate the chunk using the chunk index. If no chunk with records
+      // contains `new_pos`, this seeks to the next chunk with records rather
+      // than to the next chunk, which is equivalent.
+      const absl::optional<size_t> chunk = chunk_index_->ChunkBefore(new_pos);
+      Position chunk_pos;
+      if (chunk != absl::nullopt &&
+          new_pos - chunk_index_->chunk_begin(*chunk) <
+              chunk_index_->num_records(*chunk)) {
+        chunk_pos = chunk_index_->chunk_begin(*chunk);
+      } else {
+        const size_t next_chunk = chunk == absl::nullopt ? 0 : *chunk + 1;
+        chunk_pos = next_chunk < chunk_index_->size()
+                        ? chunk_index_->chunk_begin(next_chunk)
+                        : chunk_index_pos_;
+      }
+      if (ABSL_PREDICT_FALSE(!src.Seek(chunk_pos))) return FailSeeking(src);
+    } else {
+      if (ABSL_PREDICT_FALSE(!src.SeekToChunkContaining(new_pos))) {
+        return FailSeeking(src);
+      }
     }
     if (src.pos() >= new_pos) {
       // Seeking to the beginning of a chunk does not need reading the chunk,
@@ -453,9 +1075,363 @@ bool RecordReaderBase::Seek(Position new_pos) {
       chunk_decoder_.Clear();
       return true;
     }
-    if (ABSL_PREDICT_FALSE(!ReadChunk())) return TryRecovery();
+    if (ABSL_PREDICT_FALSE(
+            !ReadChunk(IntCast<uint64_t>(new_pos - src.pos())))) {
+      return TryRecovery();
+    }
+    return true;
+  }
+  return SetChunkIndex(IntCast<uint64_t>(new_pos - chunk_begin_));
+}
+
+bool RecordReaderBase::SeekToRecordNumber(uint64_t record_number) {
+  last_record_is_valid_ = false;
+  if (ABSL_PREDICT_FALSE(!healthy())) return TryRecovery();
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return false;
+  AdviseRandomReading();
+  if (ABSL_PREDICT_FALSE(!LoadChunkIndex())) return false;
+  if (chunk_index_ != absl::nullopt) {
+    const absl::optional<size_t> chunk =
+        chunk_index_->ChunkContainingRecord(record_number);
+    if (chunk == absl::nullopt) {
+      return Seek(RecordPosition(chunk_index_pos_, 0));
+    }
+    return Seek(
+        RecordPosition(chunk_index_->chunk_begin(*chunk),
+                       record_number - chunk_index_->records_before(*chunk)));
+  }
+  ChunkReader& src = *src_chunk_reader();
+  if (ABSL_PREDICT_FALSE(!src.Seek(0))) return FailSeeking(src);
+  for (;;) {
+    const ChunkHeader* chunk_header;
+    if (ABSL_PREDICT_FALSE(!src.PullChunkHeader(&chunk_header))) {
+      chunk_begin_ = src.pos();
+      chunk_decoder_.Clear();
+      // End of file.
+      if (ABSL_PREDICT_TRUE(src.healthy())) return true;
+      // If recovery succeeds, continue counting records after the skipped
+      // region.
+      if (!FailReading(src)) return false;
+      continue;
+    }
+    if (record_number < chunk_header->num_records()) {
+      if (ABSL_PREDICT_FALSE(!ReadChunk(record_number))) return TryRecovery();
+      return true;
+    }
+    // Skip the chunk without reading its data.
+    record_number -= chunk_header->num_records();
+    if (ABSL_PREDICT_FALSE(
+            !src.Seek(internal::ChunkEnd(*chunk_header, src.pos(),
+                                         src.block_size())))) {
+      // If recovery succeeds, continue counting records after the skipped
+      // region.
+      if (!FailSeeking(src)) return false;
+    }
+  }
+}
+
+absl::optional<uint64_t> RecordReaderBase::NumRecords() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  const RecordPosition saved_pos = pos();
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!LoadChunkIndex())) return absl::nullopt;
+  if (chunk_index_ != absl::nullopt) return chunk_index_->num_records();
+  ChunkReader& src = *src_chunk_reader();
+  const Position src_pos = src.pos();
+  if (ABSL_PREDICT_FALSE(!src.Seek(0))) {
+    FailSeeking(src);
+    return absl::nullopt;
+  }
+  uint64_t num_records = 0;
+  for (;;) {
+    const ChunkHeader* chunk_header;
+    if (ABSL_PREDICT_FALSE(!src.PullChunkHeader(&chunk_header))) {
+      // End of file.
+      if (ABSL_PREDICT_TRUE(src.healthy())) break;
+      // If recovery succeeds, continue counting records after the skipped
+      // region.
+      if (!FailReading(src)) return absl::nullopt;
+      continue;
+    }
+    num_records += chunk_header->num_records();
+    if (ABSL_PREDICT_FALSE(
+            !src.Seek(internal::ChunkEnd(*chunk_header, src.pos(),
+                                         src.block_size())))) {
+      // If recovery succeeds, continue counting records after the skipped
+      // region.
+      if (!FailSeeking(src)) return absl::nullopt;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(src_pos))) {
+    FailSeeking(src);
+    return absl::nullopt;
+  }
+  // If recovery skipped a region, the current chunk might need to be read
+  // again.
+  if (ABSL_PREDICT_FALSE(!Seek(saved_pos))) return absl::nullopt;
+  return num_records;
+}
+
+bool RecordReaderBase::LoadChunkIndex() {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::LoadChunkIndex(): "
+      << status();
+  if (chunk_index_searched_) return true;
+  chunk_index_searched_ = true;
+  ChunkReader& src = *src_chunk_reader();
+  if (!src.SupportsRandomAccess()) return true;
+  // `src` is moved back afterwards, because `Seek()` within the current chunk
+  // relies on `src` being positioned after it.
+  const Position src_pos = src.pos();
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
+    return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+  }
+  // The chunk index chunk is the last chunk, possibly followed by a padding
+  // chunk.
+  Position chunk_end = *size;
+  Chunk chunk;
+  for (int i = 0; i < 2 && chunk_end > 0; ++i) {
+    if (ABSL_PREDICT_FALSE(!src.SeekToChunkBefore(chunk_end - 1))) break;
+    const Position chunk_begin = src.pos();
+    if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk))) break;
+    if (chunk.header.chunk_type() == ChunkType::kChunkIndex) {
+      ChunkIndex chunk_index;
+      if (chunk_index.Decode(chunk, chunk_begin)) {
+        chunk_index_ = std::move(chunk_index);
+        chunk_index_pos_ = chunk_begin;
+      }
+      break;
+    }
+    if (chunk.header.chunk_type() != ChunkType::kPadding) break;
+    chunk_end = chunk_begin;
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    // The end of the file is invalid, so there is no usable chunk index.
+    if (ABSL_PREDICT_FALSE(!src.Recover())) return FailSeeking(src);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(src_pos))) return FailSeeking(src);
+  return true;
+}
+
+bool RecordReaderBase::LoadKeyIndex() {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::LoadKeyIndex(): "
+      << status();
+  if (key_index_searched_) return true;
+  key_index_searched_ = true;
+  if (ABSL_PREDICT_FALSE(!LoadChunkIndex())) return false;
+  if (chunk_index_ == absl::nullopt || chunk_index_pos_ == 0) return true;
+  ChunkReader& src = *src_chunk_reader();
+  const Position src_pos = src.pos();
+  // The key index chunk immediately precedes the chunk index chunk.
+  if (src.SeekToChunkBefore(chunk_index_pos_ - 1)) {
+    Chunk chunk;
+    if (src.ReadChunk(chunk) && src.pos() == chunk_index_pos_ &&
+        chunk.header.chunk_type() == ChunkType::kKeyIndex) {
+      KeyIndex key_index;
+      if (key_index.Decode(chunk) && key_index.size() == chunk_index_->size()) {
+        key_index_ = std::move(key_index);
+      }
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    // The chunk before the chunk index is invalid, so there is no usable key
+    // index.
+    if (ABSL_PREDICT_FALSE(!src.Recover())) return FailSeeking(src);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(src_pos))) return FailSeeking(src);
+  return true;
+}
+
+bool RecordReaderBase::Lookup(absl::string_view key) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!LoadKeyIndex())) return false;
+  if (key_index_ == absl::nullopt) {
+    const absl::optional<absl::partial_ordering> ordering =
+        Search<absl::string_view>(
+            [&](absl::string_view record)
+                -> absl::optional<absl::partial_ordering> {
+              return CompareKeys(RecordKey(record_key_, record), key);
+            });
+    return ordering == absl::partial_ordering::equivalent;
+  }
+  const absl::optional<size_t> chunk = key_index_->ChunkBefore(key);
+  if (chunk == absl::nullopt) {
+    // `key` is less than all keys.
+    Seek(RecordPosition(chunk_index_->empty() ? chunk_index_pos_
+                                              : chunk_index_->chunk_begin(0),
+                        0));
+    return false;
+  }
+  const Position chunk_begin = chunk_index_->chunk_begin(*chunk);
+  if (ABSL_PREDICT_FALSE(!Seek(RecordPosition(chunk_begin, 0)))) return false;
+  // Records of this chunk have keys less than keys of the next chunk, so `key`
+  // is either in this chunk, or it would be just after it.
+  absl::string_view record;
+  for (;;) {
+    const RecordPosition record_pos = pos();
+    if (record_pos.chunk_begin() != chunk_begin) return false;
+    if (!ReadRecord(record)) return false;
+    const absl::partial_ordering ordering =
+        CompareKeys(RecordKey(record_key_, record), key);
+    if (ordering >= 0) {
+      if (ABSL_PREDICT_FALSE(!Seek(record_pos))) return false;
+      return ordering == 0;
+    }
+  }
+}
+
+bool RecordReaderBase::LoadTimeIndex() {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::LoadTimeIndex(): "
+      << status();
+  if (time_index_searched_) return true;
+  time_index_searched_ = true;
+  if (ABSL_PREDICT_FALSE(!LoadChunkIndex())) return false;
+  if (chunk_index_ == absl::nullopt || chunk_index_pos_ == 0) return true;
+  ChunkReader& src = *src_chunk_reader();
+  const Position src_pos = src.pos();
+  // The time index chunk immediately precedes the key index chunk if any,
+  // otherwise the chunk index chunk.
+  Position chunk_end = chunk_index_pos_;
+  Chunk chunk;
+  for (int i = 0; i < 2 && chunk_end > 0; ++i) {
+    if (ABSL_PREDICT_FALSE(!src.SeekToChunkBefore(chunk_end - 1))) break;
+    const Position chunk_begin = src.pos();
+    if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk)) || src.pos() != chunk_end) {
+      break;
+    }
+    if (chunk.header.chunk_type() == ChunkType::kTimeIndex) {
+      TimeIndex time_index;
+      if (time_index.Decode(chunk) &&
+          time_index.size() == chunk_index_->size()) {
+        time_index_ = std::move(time_index);
+      }
+      break;
+    }
+    if (chunk.header.chunk_type() != ChunkType::kKeyIndex) break;
+    chunk_end = chunk_begin;
   }
-  chunk_decoder_.SetIndex(IntCast<uint64_t>(new_pos - chunk_begin_));
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    // The chunks before the chunk index are invalid, so there is no usable
+    // time index.
+    if (ABSL_PREDICT_FALSE(!src.Recover())) return FailSeeking(src);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(src_pos))) return FailSeeking(src);
+  return true;
+}
+
+bool RecordReaderBase::SeekToTime(int64_t time) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!LoadTimeIndex())) return false;
+  if (time_index_ == absl::nullopt) {
+    if (record_timestamp_ == nullptr) return Seek(RecordPosition(0, 0));
+    const absl::optional<absl::partial_ordering> ordering =
+        Search<absl::string_view>(
+            [&](absl::string_view record) -> absl::partial_ordering {
+              return record_timestamp_(record) < time
+                         ? absl::partial_ordering::less
+                         : absl::partial_ordering::greater;
+            });
+    return ordering != absl::nullopt;
+  }
+  const absl::optional<size_t> chunk = time_index_->NextOverlapping(
+      0, time, std::numeric_limits<int64_t>::max());
+  if (chunk == absl::nullopt) {
+    // All timestamps are less than `time`.
+    return Seek(RecordPosition(chunk_index_pos_, 0));
+  }
+  const Position chunk_begin = chunk_index_->chunk_begin(*chunk);
+  if (ABSL_PREDICT_FALSE(!Seek(RecordPosition(chunk_begin, 0)))) return false;
+  if (record_timestamp_ == nullptr ||
+      time_index_->min_timestamp(*chunk) >= time) {
+    return true;
+  }
+  absl::string_view record;
+  for (;;) {
+    const RecordPosition record_pos = pos();
+    if (record_pos.chunk_begin() != chunk_begin) return true;
+    if (!ReadRecord(record)) return healthy();
+    if (record_timestamp_(record) >= time) return Seek(record_pos);
+  }
+}
+
+bool RecordReaderBase::SkipToTimeRange(int64_t begin, int64_t end) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!LoadTimeIndex())) return false;
+  if (time_index_ == absl::nullopt) return true;
+  const RecordPosition record_pos = pos();
+  if (record_pos.chunk_begin() >= chunk_index_pos_) return false;
+  const absl::optional<size_t> current =
+      chunk_index_->ChunkBefore(record_pos.chunk_begin());
+  size_t chunk = 0;
+  if (current != absl::nullopt) {
+    chunk = *current;
+    if (chunk_index_->chunk_begin(chunk) != record_pos.chunk_begin() ||
+        record_pos.record_index() >= chunk_index_->num_records(chunk)) {
+      // The current position is after the chunk.
+      ++chunk;
+    }
+  }
+  const absl::optional<size_t> next =
+      time_index_->NextOverlapping(chunk, begin, end);
+  if (next == absl::nullopt) {
+    Seek(RecordPosition(chunk_index_pos_, 0));
+    return false;
+  }
+  if (*next == chunk && current != absl::nullopt && *current == chunk) {
+    // The current chunk can contain records in the range.
+    return true;
+  }
+  return Seek(RecordPosition(chunk_index_->chunk_begin(*next), 0));
+}
+
+inline bool RecordReaderBase::PrepareZstdDictionary(const Chunk& chunk) {
+  if (ABSL_PREDICT_TRUE(!zstd_dictionary_.empty())) return true;
+  if (chunk.header.chunk_type() == ChunkType::kZstdDictionary) {
+    zstd_dictionary_.set_data(std::string(chunk.data));
+    return true;
+  }
+  if (ABSL_PREDICT_TRUE(!UsesZstdDictionary(chunk))) return true;
+  return LoadZstdDictionary();
+}
+
+bool RecordReaderBase::LoadZstdDictionary() {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::LoadZstdDictionary(): "
+      << status();
+  if (zstd_dictionary_searched_) return true;
+  zstd_dictionary_searched_ = true;
+  ChunkReader& src = *src_chunk_reader();
+  // If the dictionary cannot be loaded, decoding the chunk fails with an
+  // explanation.
+  if (!src.SupportsRandomAccess()) return true;
+  const Position pos_before = src.pos();
+  if (ABSL_PREDICT_FALSE(!src.Seek(0))) return FailSeeking(src);
+  // The Zstd dictionary chunk precedes chunks with records.
+  for (;;) {
+    const ChunkHeader* chunk_header;
+    if (ABSL_PREDICT_FALSE(!src.PullChunkHeader(&chunk_header))) break;
+    if (chunk_header->chunk_type() == ChunkType::kZstdDictionary) {
+      Chunk chunk;
+      if (ABSL_PREDICT_TRUE(src.ReadChunk(chunk))) {
+        zstd_dictionary_.set_data(std::string(chunk.data));
+      }
+      break;
+    }
+    if (chunk_header->num_records() > 0) break;
+    if (ABSL_PREDICT_FALSE(
+            !src.Seek(internal::ChunkEnd(*chunk_header, src.pos(),
+                                         src.block_size())))) {
+      break;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    // The beginning of the file is invalid, so there is no usable dictionary.
+    if (ABSL_PREDICT_FALSE(!src.Recover())) return FailSeeking(src);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(pos_before))) return FailSeeking(src);
   return true;
 }
 
@@ -463,9 +1439,10 @@ bool RecordReaderBase::SeekBack() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   last_record_is_valid_ = false;
   if (ABSL_PREDICT_TRUE(chunk_decoder_.index() > 0)) {
-    chunk_decoder_.SetIndex(chunk_decoder_.index() - 1);
-    return true;
+    return SetChunkIndex(chunk_decoder_.index() - 1);
   }
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return false;
+  AdviseRandomReading();
   ChunkReader& src = *src_chunk_reader();
   Position chunk_pos = chunk_begin_;
   while (chunk_pos > 0) {
@@ -507,16 +1484,60 @@ absl::optional<Position> RecordReaderBase::Size() {
 class RecordReaderBase::ChunkSearchTraits {
  public:
   explicit ChunkSearchTraits(RecordReaderBase* self)
-      : self_(RIEGELI_ASSERT_NOTNULL(self)) {}
+      : self_(RIEGELI_ASSERT_NOTNULL(self)) {
+    const size_t steps =
+        IntCast<size_t>(absl::bit_width(self->search_fanout_)) - 1;
+    // Hinting only the next probe does not save round trips.
+    if (steps > 1 && self->src_chunk_reader()->SupportsRandomAccess()) {
+      hinted_steps_ = steps;
+    }
+  }
 
   using Pos = Position;
 
+  // Records the size of a chunk which has been read, to estimate the size of
+  // regions to hint.
+  void set_chunk_size(Position chunk_size) { chunk_size_ = chunk_size; }
+
+  // Makes `Middle()` interpolate between chunks passed to `AddProbe()`.
+  // Probes are then not hinted, because they are not known in advance.
+  void EnableInterpolation() {
+    interpolate_ = true;
+    hinted_steps_ = 0;
+  }
+
+  // Records the distance from the desired position estimated for the chunk
+  // beginning at `chunk_begin`, for interpolation.
+  void AddProbe(Position chunk_begin, double distance) {
+    if (!std::isfinite(distance)) return;
+    const Probe probe{chunk_begin, distance};
+    if (distance < 0.0) {
+      less_probe_ = probe;
+    } else if (distance > 0.0) {
+      greater_probe_ = probe;
+    }
+    if (last_probe_ == absl::nullopt ||
+        last_probe_->chunk_begin != chunk_begin) {
+      previous_probe_ = last_probe_;
+    }
+    last_probe_ = probe;
+  }
+
   bool Empty(Position low, Position high) const { return low >= high; }
 
   absl::optional<Position> Middle(Position low, Position high) const {
     if (low >= high) return absl::nullopt;
     ChunkReader& src = *self_->src_chunk_reader();
-    if (ABSL_PREDICT_FALSE(!src.SeekToChunkBefore(low + (high - low) / 2))) {
+    if (hinted_steps_ > 0) {
+      if (steps_until_hint_ == 0) {
+        HintProbes(low, high, hinted_steps_);
+        steps_until_hint_ = hinted_steps_;
+      }
+      --steps_until_hint_;
+    }
+    const Position probe =
+        interpolate_ ? InterpolatedMiddle(low, high) : low + (high - low) / 2;
+    if (ABSL_PREDICT_FALSE(!src.SeekToChunkBefore(probe))) {
       if (!self_->FailSeeking(src)) {
         // There was a failure or unexpected end of file. Cancel the search.
         return absl::nullopt;
@@ -537,15 +1558,139 @@ class RecordReaderBase::ChunkSearchTraits {
   }
 
  private:
+  // Hints regions around middles which `Middle()` returns for `steps` steps of
+  // the binary search starting from the range between `low` and `high`.
+  //
+  // This assumes that the range is split at the middle, while it is split at a
+  // nearby chunk boundary. Regions are wide enough for the difference not to
+  // matter much.
+  struct Probe {
+    Position chunk_begin;
+    double distance;
+  };
+
+  // Returns the position between `low` (inclusive) and `high` (exclusive)
+  // where the desired position is expected by linear interpolation between
+  // `less_probe_` and `greater_probe_`, or by linear extrapolation from the
+  // last two probes if the desired position is not bracketed yet. Returns the
+  // middle if there are not enough probes or if two interpolations in a row
+  // did not halve the range.
+  //
+  // An interpolation which hits the desired chunk usually does not halve the
+  // range, because it leaves the range on the other side of the chunk, but
+  // the next interpolation then finishes the search.
+  //
+  // Precondition: `low < high`
+  Position InterpolatedMiddle(Position low, Position high) const {
+    const Position range = high - low;
+    if (last_interpolated_) {
+      if (range > last_range_ / 2) {
+        ++slow_interpolations_;
+      } else {
+        slow_interpolations_ = 0;
+      }
+    }
+    const Probe* a = nullptr;
+    const Probe* b = nullptr;
+    if (less_probe_ != absl::nullopt && greater_probe_ != absl::nullopt) {
+      a = &*less_probe_;
+      b = &*greater_probe_;
+    } else if (previous_probe_ != absl::nullopt &&
+               previous_probe_->distance != last_probe_->distance) {
+      a = &*previous_probe_;
+      b = &*last_probe_;
+    }
+    const bool interpolate = a != nullptr && slow_interpolations_ < 2;
+    if (!interpolate) slow_interpolations_ = 0;
+    last_range_ = range;
+    last_interpolated_ = interpolate;
+    if (!interpolate) return low + range / 2;
+    const double expected =
+        static_cast<double>(a->chunk_begin) +
+        a->distance / (a->distance - b->distance) *
+            (static_cast<double>(b->chunk_begin) -
+             static_cast<double>(a->chunk_begin));
+    if (!(expected > static_cast<double>(low))) return low;
+    if (!(expected < static_cast<double>(high - 1))) return high - 1;
+    return static_cast<Position>(expected);
+  }
+
+  void HintProbes(Position low, Position high, size_t steps) const {
+    if (steps == 0 || low >= high) return;
+    const Position middle = low + (high - low) / 2;
+    // The chunk containing `middle` is found using the block header preceding
+    // it, and it can begin before `middle`.
+    const Position block_size = self_->src_chunk_reader()->block_size();
+    const Position margin = UnsignedMax(chunk_size_, block_size);
+    const Position begin = internal::RoundDownToBlockBoundary(
+        SaturatingSub(middle, margin), block_size);
+    self_->src_chunk_reader()->WillNeedAt(
+        begin, SaturatingAdd(middle, margin) - begin);
+    HintProbes(low, middle, steps - 1);
+    HintProbes(middle, high, steps - 1);
+  }
+
   RecordReaderBase* self_;
+  // The number of steps of the binary search whose probes are hinted at once,
+  // or 0 if probes are not hinted.
+  size_t hinted_steps_ = 0;
+  // The size of the last chunk read, or 0 if none was read yet.
+  Position chunk_size_ = 0;
+  // The number of steps of the binary search until the next hint.
+  mutable size_t steps_until_hint_ = 0;
+  // Whether `Middle()` interpolates.
+  bool interpolate_ = false;
+  // The last probed chunks judged `less` and `greater`, and the last two
+  // probed chunks, if any, for interpolation.
+  absl::optional<Probe> less_probe_;
+  absl::optional<Probe> greater_probe_;
+  absl::optional<Probe> previous_probe_;
+  absl::optional<Probe> last_probe_;
+  // The size of the range given to the last `InterpolatedMiddle()`, whether
+  // it interpolated, and the number of interpolations in a row which did not
+  // halve the range.
+  mutable Position last_range_ = 0;
+  mutable bool last_interpolated_ = false;
+  mutable int slow_interpolations_ = 0;
 };
 
 absl::optional<absl::partial_ordering> RecordReaderBase::Search(
     absl::FunctionRef<
         absl::optional<absl::partial_ordering>(RecordReaderBase& reader)>
         test) {
+  ChunkSearchTraits traits(this);
+  return SearchChunks(test, traits);
+}
+
+absl::optional<absl::partial_ordering> RecordReaderBase::InterpolationSearch(
+    absl::FunctionRef<absl::optional<double>(RecordReaderBase& reader)> test) {
+  ChunkSearchTraits traits(this);
+  traits.EnableInterpolation();
+  return SearchChunks(
+      [&](RecordReaderBase& self) -> absl::optional<absl::partial_ordering> {
+        const Position chunk_begin = self.pos().chunk_begin();
+        const absl::optional<double> distance = test(self);
+        if (ABSL_PREDICT_FALSE(distance == absl::nullopt)) {
+          return absl::nullopt;
+        }
+        traits.AddProbe(chunk_begin, *distance);
+        if (*distance < 0.0) return absl::partial_ordering::less;
+        if (*distance > 0.0) return absl::partial_ordering::greater;
+        if (*distance == 0.0) return absl::partial_ordering::equivalent;
+        return absl::partial_ordering::unordered;
+      },
+      traits);
+}
+
+absl::optional<absl::partial_ordering> RecordReaderBase::SearchChunks(
+    absl::FunctionRef<
+        absl::optional<absl::partial_ordering>(RecordReaderBase& reader)>
+        test,
+    ChunkSearchTraits& traits) {
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
   last_record_is_valid_ = false;
+  if (ABSL_PREDICT_FALSE(!CancelReadAhead())) return absl::nullopt;
+  AdviseRandomReading();
   ChunkReader& src = *src_chunk_reader();
   const absl::optional<Position> size = src.Size();
   if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
@@ -584,6 +1729,7 @@ absl::optional<absl::partial_ordering> RecordReaderBase::Search(
         // `src.pos()` points to the next chunk. Adjust `chunk_begin` in case
         // recovery moved it forwards.
         chunk_begin = chunk_begin_;
+        traits.set_chunk_size(src.pos() - chunk_begin);
         const uint64_t num_records = chunk_decoder_.num_records();
         // Judge the chunk by its earliest record which is not unordered.
         for (uint64_t record_index = 0; record_index < num_records;
@@ -619,7 +1765,7 @@ absl::optional<absl::partial_ordering> RecordReaderBase::Search(
         return SearchGuide<Position>{absl::partial_ordering::unordered,
                                      src.pos()};
       },
-      ChunkSearchTraits(this));
+      traits);
 
   if (ABSL_PREDICT_FALSE(greater_chunk_begin == absl::nullopt)) {
     return absl::nullopt;
@@ -662,13 +1808,60 @@ absl::optional<absl::partial_ordering> RecordReaderBase::Search(
   return greater_chunk_begin->ordering;
 }
 
-inline bool RecordReaderBase::ReadChunk() {
+inline bool RecordReaderBase::ReadChunk(uint64_t index) {
   RIEGELI_ASSERT(healthy())
       << "Failed precondition of RecordReaderBase::ReadChunk(): " << status();
   ChunkReader& src = *src_chunk_reader();
   chunk_begin_ = src.pos();
+  if (chunk_cache_ != nullptr) {
+    const std::shared_ptr<const ChunkCache::Entry> cached =
+        chunk_cache_->Find(chunk_cache_file_id_, chunk_begin_);
+    if (cached != nullptr) {
+      if (ABSL_PREDICT_FALSE(!src.Seek(cached->next_chunk_begin))) {
+        return FailSeeking(src);
+      }
+      chunk_decoder_.ImportRecords(cached->records, index);
+      return true;
+    }
+  }
+  if (projected_range_reads_ &&
+      chunk_decoder_.record_filter() == absl::nullopt &&
+      !chunk_decoder_.field_projection().includes_all() &&
+      src.SupportsRandomAccess() && !src.VerifiesNextDataHash()) {
+    const ChunkHeader* chunk_header;
+    // If pulling the chunk header fails, `src.ReadChunk()` below fails too.
+    if (src.PullChunkHeader(&chunk_header) &&
+        chunk_header->chunk_type() == ChunkType::kTransposed) {
+      return ReadChunkOnDemand(index);
+    }
+  }
+  // Declared before `chunk` so that its blocks are returned to the pool.
+  absl::optional<ScopedChainBlockPool> scoped_chunk_block_pool;
+  if (chunk_block_pool_ != nullptr) {
+    scoped_chunk_block_pool.emplace(chunk_block_pool_.get());
+  }
   Chunk chunk;
-  if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk))) {
+  bool chunk_read;
+  bool verify_data_hash = false;
+  {
+    internal::StageTimer timer(stats_, RecordsStats::Stage::kIo, chunk_begin_);
+    // Only chunks with records are decoded by `chunk_decoder_`. Other chunks,
+    // e.g. a Zstd dictionary, are used directly, so their data hash is
+    // verified by `src`. If pulling the chunk header fails, `src.ReadChunk()`
+    // fails too.
+    const ChunkHeader* chunk_header;
+    if (hash_while_decoding_ && src.PullChunkHeader(&chunk_header) &&
+        (chunk_header->chunk_type() == ChunkType::kSimple ||
+         chunk_header->chunk_type() == ChunkType::kTransposed)) {
+      chunk_read = src.ReadChunkWithoutDataHash(chunk, verify_data_hash);
+    } else {
+      chunk_read = src.ReadChunk(chunk);
+    }
+    if (chunk_read) {
+      timer.set_chunk_size(ChunkHeader::size() + chunk.header.data_size());
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_read)) {
     chunk_decoder_.Clear();
     if (ABSL_PREDICT_FALSE(!src.healthy())) {
       recoverable_ = Recoverable::kRecoverChunkReader;
@@ -676,11 +1869,186 @@ inline bool RecordReaderBase::ReadChunk() {
     }
     return false;
   }
-  if (ABSL_PREDICT_FALSE(!chunk_decoder_.Decode(chunk))) {
+  if (ABSL_PREDICT_FALSE(!PrepareZstdDictionary(chunk))) return false;
+  absl::optional<ChunkStatistics> statistics;
+  if (chunk_decoder_.record_filter() != absl::nullopt &&
+      chunk.header.num_records() > 0) {
+    statistics = ReadChunkStatistics(src);
+  }
+  chunk_decoder_.set_zstd_dictionary(zstd_dictionary_);
+  bool chunk_decoded;
+  {
+    internal::StageTimer timer(stats_, RecordsStats::Stage::kDecode,
+                               chunk_begin_,
+                               ChunkHeader::size() + chunk.header.data_size());
+    // With a chunk cache, all records are reconstructed so that the chunk
+    // can be cached.
+    chunk_decoded = chunk_decoder_.Decode(
+        chunk, statistics == absl::nullopt ? nullptr : &*statistics,
+        chunk_cache_ == nullptr ? index : uint64_t{0}, verify_data_hash);
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_decoded)) {
     recoverable_ = Recoverable::kRecoverChunkDecoder;
     return Fail(chunk_decoder_.status());
   }
+  if (chunk_cache_ != nullptr) {
+    ChunkCache::Entry entry;
+    if (chunk_decoder_.ExportRecords(entry.records)) {
+      entry.next_chunk_begin = src.pos();
+      chunk_cache_->Insert(chunk_cache_file_id_, chunk_begin_,
+                           std::move(entry));
+    }
+    chunk_decoder_.SetIndex(index);
+  }
+  if (stats_ != nullptr && chunk.header.num_records() > 0) {
+    stats_->AddChunk(chunk.header.num_records(),
+                     ChunkHeader::size() + chunk.header.data_size(),
+                     chunk.header.decoded_data_size());
+  }
   return true;
 }
 
+bool RecordReaderBase::ReadChunkOnDemand(uint64_t index) {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::ReadChunkOnDemand(): "
+      << status();
+  ChunkReader& src = *src_chunk_reader();
+  RIEGELI_ASSERT(src.SupportsRandomAccess())
+      << "Failed precondition of RecordReaderBase::ReadChunkOnDemand(): "
+         "ChunkReader does not support random access";
+  // The compression type is not known before reading chunk data, so the
+  // dictionary is loaded in case the chunk needs it.
+  if (zstd_dictionary_.empty()) {
+    if (ABSL_PREDICT_FALSE(!LoadZstdDictionary())) return false;
+  }
+  chunk_decoder_.set_zstd_dictionary(zstd_dictionary_);
+  ChunkHeader chunk_header;
+  bool chunk_decoded = false;
+  bool chunk_read;
+  {
+    // Reading and decoding are interleaved, so they are measured together.
+    internal::StageTimer timer(stats_, RecordsStats::Stage::kDecode,
+                               chunk_begin_);
+    chunk_read = src.ReadChunkOnDemand(
+        [&](const ChunkHeader& header, Reader& data) {
+          timer.set_chunk_size(ChunkHeader::size() + header.data_size());
+          chunk_header = header;
+          // With a chunk cache, the index is set after caching the chunk.
+          chunk_decoded = chunk_decoder_.Decode(
+              header, data, chunk_cache_ == nullptr ? index : uint64_t{0});
+        });
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_read)) {
+    chunk_decoder_.Clear();
+    if (ABSL_PREDICT_FALSE(!src.healthy())) {
+      recoverable_ = Recoverable::kRecoverChunkReader;
+      return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+    }
+    return false;
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_decoded)) {
+    recoverable_ = Recoverable::kRecoverChunkDecoder;
+    return Fail(chunk_decoder_.status());
+  }
+  if (chunk_cache_ != nullptr) {
+    ChunkCache::Entry entry;
+    if (chunk_decoder_.ExportRecords(entry.records)) {
+      entry.next_chunk_begin = src.pos();
+      chunk_cache_->Insert(chunk_cache_file_id_, chunk_begin_,
+                           std::move(entry));
+    }
+    chunk_decoder_.SetIndex(index);
+  }
+  if (stats_ != nullptr && chunk_header.num_records() > 0) {
+    stats_->AddChunk(chunk_header.num_records(),
+                     ChunkHeader::size() + chunk_header.data_size(),
+                     chunk_header.decoded_data_size());
+  }
+  return true;
+}
+
+inline bool RecordReaderBase::SetChunkIndex(uint64_t index) {
+  chunk_decoder_.SetIndex(index);
+  if (ABSL_PREDICT_FALSE(!chunk_decoder_.healthy())) {
+    recoverable_ = Recoverable::kRecoverChunkDecoder;
+    return Fail(chunk_decoder_.status());
+  }
+  return true;
+}
+
+inline bool RecordReaderBase::ReadNextChunk() {
+  AdviseSequentialReading();
+  if (parallel_decoder_ == nullptr) return ReadChunk();
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of RecordReaderBase::ReadNextChunk(): "
+      << status();
+  ChunkReader& src = *src_chunk_reader();
+  parallel_decoder_->ReadAhead(src, zstd_dictionary_);
+  if (parallel_decoder_->pending_begin(src) == absl::nullopt) {
+    // Nothing was read ahead: the source ends or fails here.
+    return ReadChunk();
+  }
+  chunk_begin_ = parallel_decoder_->TakeChunk(chunk_decoder_);
+  if (ABSL_PREDICT_FALSE(!chunk_decoder_.healthy())) {
+    recoverable_ = Recoverable::kRecoverChunkDecoder;
+    return Fail(chunk_decoder_.status());
+  }
+  return true;
+}
+
+inline void RecordReaderBase::AdviseSequentialReading() {
+  ChunkReader& src = *src_chunk_reader();
+  if (access_pattern_ != AccessPattern::kSequential) {
+    src.SetAccessPattern(AccessPattern::kSequential);
+    access_pattern_ = AccessPattern::kSequential;
+  }
+  if (readahead_chunks_ > 0) {
+    // Estimate the size of following chunks by the size of the current chunk,
+    // which ends where the next chunk to be read begins.
+    const absl::optional<Position> next_chunk_begin =
+        parallel_decoder_ == nullptr ? absl::make_optional(src.pos())
+                                     : parallel_decoder_->pending_begin(src);
+    if (next_chunk_begin != absl::nullopt &&
+        *next_chunk_begin > chunk_begin_) {
+      const Position chunk_size = *next_chunk_begin - chunk_begin_;
+      src.WillNeed(
+          chunk_size > std::numeric_limits<Position>::max() / readahead_chunks_
+              ? std::numeric_limits<Position>::max()
+              : chunk_size * readahead_chunks_);
+    }
+  }
+}
+
+inline void RecordReaderBase::AdviseRandomReading() {
+  if (access_pattern_ == AccessPattern::kRandom) return;
+  ChunkReader& src = *src_chunk_reader();
+  src.SetAccessPattern(AccessPattern::kRandom);
+  access_pattern_ = AccessPattern::kRandom;
+}
+
+bool RecordReaderBase::CancelReadAhead() {
+  if (ABSL_PREDICT_TRUE(parallel_decoder_ == nullptr)) return true;
+  ChunkReader& src = *src_chunk_reader();
+  const absl::optional<Position> pending_begin =
+      parallel_decoder_->pending_begin(src);
+  parallel_decoder_->Clear();
+  if (pending_begin == absl::nullopt) return true;
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    // Reading ahead failed after the chunks read ahead. The failure will be
+    // encountered again if reading reaches that position.
+    if (ABSL_PREDICT_FALSE(!src.Recover())) return FailSeeking(src);
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(*pending_begin))) return FailSeeking(src);
+  return true;
+}
+
+RecordPosition RecordReaderBase::ParallelPos() const {
+  const ChunkReader& src = *src_chunk_reader();
+  const absl::optional<Position> pending_begin =
+      parallel_decoder_->pending_begin(src);
+  return RecordPosition(pending_begin == absl::nullopt ? src.pos()
+                                                       : *pending_begin,
+                        0);
+}
+
 }  // namespace riegeli
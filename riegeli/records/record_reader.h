@@ -15,21 +15,30 @@
 #ifndef RIEGELI_RECORDS_RECORD_READER_H_
 #define RIEGELI_RECORDS_RECORD_READER_H_
 
+#include <stdint.h>
+
 #include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/compare.h"
 #include "absl/types/optional.h"
+#include "google/protobuf/arena.h"
 #include "google/protobuf/descriptor.h"
+#include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/message.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
@@ -38,12 +47,19 @@
 #include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/chunk_encoding/field_predicate.h"
 #include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/records/chunk_cache.h"
+#include "riegeli/records/chunk_index.h"
 #include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/chunk_reader_dependency.h"
+#include "riegeli/records/key_index.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/records_metadata.pb.h"
+#include "riegeli/records/records_stats.h"
 #include "riegeli/records/skipped_region.h"
+#include "riegeli/records/time_index.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -72,6 +88,55 @@ class RecordsMetadataDescriptors : public Object {
   std::unique_ptr<google::protobuf::DescriptorPool> pool_;
 };
 
+// Metadata of a Riegeli/records file parsed together with descriptors
+// interpreting them, shared by files with the same serialized metadata.
+//
+// Parsing metadata and building a `DescriptorPool` from their file descriptors
+// is slow for large schemas. `SharedRecordsMetadata::Get()` does this once per
+// process for each distinct serialized metadata, as long as some result for it
+// is alive.
+//
+// `SharedRecordsMetadata` is immutable and thread-safe.
+class SharedRecordsMetadata {
+ public:
+  // Returns `SharedRecordsMetadata` for `serialized_metadata`, parsing it or
+  // reusing an earlier result.
+  //
+  // Return values:
+  //  * `absl::OkStatus()` - success (`result` is set)
+  //  * other status       - failure to parse `serialized_metadata`
+  static absl::Status Get(const Chain& serialized_metadata,
+                          std::shared_ptr<const SharedRecordsMetadata>& result);
+
+  SharedRecordsMetadata(const SharedRecordsMetadata&) = delete;
+  SharedRecordsMetadata& operator=(const SharedRecordsMetadata&) = delete;
+
+  // Returns the parsed metadata.
+  const RecordsMetadata& metadata() const { return metadata_; }
+
+  // Returns descriptors interpreting `record_type_name` and `file_descriptor`
+  // of the metadata. If some file descriptor was invalid, then
+  // `!descriptors().healthy()`.
+  const RecordsMetadataDescriptors& descriptors() const {
+    return descriptors_;
+  }
+
+  // Returns the prototype of the record type from a `DynamicMessageFactory`,
+  // or `nullptr` if the record type is not available. `prototype()->New()`
+  // creates a message to parse records into.
+  //
+  // The prototype is valid as long as the `SharedRecordsMetadata` is valid.
+  const google::protobuf::Message* prototype() const { return prototype_; }
+
+ private:
+  explicit SharedRecordsMetadata(RecordsMetadata&& metadata);
+
+  RecordsMetadata metadata_;
+  RecordsMetadataDescriptors descriptors_;
+  std::unique_ptr<google::protobuf::DynamicMessageFactory> factory_;
+  const google::protobuf::Message* prototype_ = nullptr;
+};
+
 // Template parameter independent part of `RecordReader`.
 class RecordReaderBase : public Object {
  public:
@@ -159,11 +224,411 @@ class RecordReaderBase : public Object {
       return recovery_;
     }
 
+    // Sets the maximum number of chunks being read ahead and decoded in
+    // parallel in background. Larger parallelism can increase throughput, up
+    // to a point where it no longer matters; smaller parallelism reduces memory
+    // usage.
+    //
+    // If `parallelism > 0`, chunks are read from the byte `Reader` ahead of the
+    // records being returned, so the byte `Reader` can be positioned further
+    // than `pos()` implies. Reading ahead is stopped by `Seek()`, `SeekBack()`,
+    // `Search()`, `SetFieldProjection()`, and `Close()`, which move the byte
+    // `Reader` back to the chunk following the current one.
+    //
+    // Default: 0.
+    Options& set_parallelism(int parallelism) & {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "RecordReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+    // If `parallelism() > 0`, limits the total decoded size of chunks read
+    // ahead and not taken yet, so that a consumer slower than decoding does
+    // not make the reader hold up to `parallelism()` large chunks. Reading
+    // ahead waits until enough chunks are taken, and then resumes.
+    //
+    // At least one chunk is read ahead even if it is larger than the limit.
+    //
+    // Decoded sizes are known from chunk headers before chunks are read, so
+    // they are not exceeded by chunks read ahead as a whole. Chunk data being
+    // decompressed and record boundaries are not included.
+    //
+    // `absl::nullopt` means no limit besides `parallelism()`.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_max_decoded_bytes(
+        absl::optional<uint64_t> max_decoded_bytes) & {
+      max_decoded_bytes_ = max_decoded_bytes;
+      return *this;
+    }
+    Options&& set_max_decoded_bytes(
+        absl::optional<uint64_t> max_decoded_bytes) && {
+      return std::move(set_max_decoded_bytes(max_decoded_bytes));
+    }
+    absl::optional<uint64_t> max_decoded_bytes() const {
+      return max_decoded_bytes_;
+    }
+
+    // If `true`, buckets of a transposed chunk are decompressed in parallel,
+    // using the thread pool shared by Riegeli. This reduces the latency of
+    // decoding a single large chunk, especially with a field projection which
+    // needs several buckets. Buckets which are not needed for the field
+    // projection are skipped.
+    //
+    // This is meaningful if the file has been written with
+    // `set_transpose(true)` and `set_bucket_fraction()` small enough to
+    // produce several buckets.
+    //
+    // Default: `false`.
+    Options& set_parallel_buckets(bool parallel_buckets) & {
+      parallel_buckets_ = parallel_buckets;
+      return *this;
+    }
+    Options&& set_parallel_buckets(bool parallel_buckets) && {
+      return std::move(set_parallel_buckets(parallel_buckets));
+    }
+    bool parallel_buckets() const { return parallel_buckets_; }
+
+    // If `true` and `field_projection()` does not include all fields, chunk
+    // data of transposed chunks are read from the byte `Reader` on demand, so
+    // that only buckets needed for the field projection are read. This saves
+    // I/O if the file has been written with `set_bucket_fraction()` small
+    // enough to produce several buckets, especially when reading over a
+    // network, where each bucket is fetched with a separate range read.
+    //
+    // This requires the byte `Reader` to support random access, and is
+    // ignored otherwise. It is also ignored with `record_filter()` and for
+    // chunks decoded in background if `parallelism() > 0`.
+    //
+    // Important: a chunk data hash covers all chunk data, so it cannot be
+    // verified when only some buckets are read. Hence this applies only to
+    // chunks whose data hash the `ChunkReader` is not going to verify anyway,
+    // and other chunks are read and verified fully. By default the
+    // `ChunkReader` verifies every chunk (see
+    // `DefaultChunkReaderBase::Options::set_verify_data_hash_every()`), so
+    // this has no effect unless verification is also explicitly disabled or
+    // sampled. Doing so gives up detection of corruption of chunk data, which
+    // is left to the storage. Chunk headers are still verified.
+    //
+    // Default: `false`.
+    Options& set_projected_range_reads(bool projected_range_reads) & {
+      projected_range_reads_ = projected_range_reads;
+      return *this;
+    }
+    Options&& set_projected_range_reads(bool projected_range_reads) && {
+      return std::move(set_projected_range_reads(projected_range_reads));
+    }
+    bool projected_range_reads() const { return projected_range_reads_; }
+
+    // If `true`, chunk data hashes which the `ChunkReader` would verify (see
+    // `DefaultChunkReaderBase::Options::set_verify_data_hash_every()`) are
+    // verified while chunk data are decompressed instead of right after a
+    // chunk is read, so that compressed data are read from memory once rather
+    // than twice. This pays off for chunks larger than CPU caches. Records of
+    // a chunk are available only after its hash is verified either way.
+    //
+    // The hash computed this way uses instructions chosen at compile time, so
+    // this is faster only if the code is compiled for a CPU supporting vector
+    // instructions, e.g. with `-mavx2`.
+    //
+    // This is ignored for chunks decoded in background if `parallelism() > 0`.
+    //
+    // Default: `false`.
+    Options& set_hash_while_decoding(bool hash_while_decoding) & {
+      hash_while_decoding_ = hash_while_decoding;
+      return *this;
+    }
+    Options&& set_hash_while_decoding(bool hash_while_decoding) && {
+      return std::move(set_hash_while_decoding(hash_while_decoding));
+    }
+    bool hash_while_decoding() const { return hash_while_decoding_; }
+
+    // While records are read sequentially, the byte `Reader` is hinted with
+    // `Reader::WillNeed()` that about `readahead_chunks` chunks following the
+    // current one will be needed soon, estimating their size by the size of
+    // the current chunk. With `FdReader` this lets the kernel fetch them in
+    // background.
+    //
+    // Independently of this option, the byte `Reader` is hinted with
+    // `Reader::SetAccessPattern()` whether records are being read sequentially
+    // or after seeking.
+    //
+    // Default: 0.
+    Options& set_readahead_chunks(size_t readahead_chunks) & {
+      readahead_chunks_ = readahead_chunks;
+      return *this;
+    }
+    Options&& set_readahead_chunks(size_t readahead_chunks) && {
+      return std::move(set_readahead_chunks(readahead_chunks));
+    }
+    size_t readahead_chunks() const { return readahead_chunks_; }
+
+    // If at least 4, `Search()` (and `Lookup()` without a key index) hints
+    // the byte `Reader` with `Reader::WillNeed()` about regions around the
+    // positions which the next log2(`search_fanout`) steps of the binary
+    // search can probe, i.e. `search_fanout - 1` evenly spaced positions in
+    // the range being searched, before probing the first of them. A byte
+    // `Reader` which fetches hinted regions concurrently, e.g. `FdReader` with
+    // the kernel reading ahead, then serves the following steps from fetched
+    // data, which reduces the number of dependent round trips by about
+    // log2(`search_fanout`) times on high-latency storage, at the cost of
+    // reading more data.
+    //
+    // `search_fanout` is rounded down to a power of 2. Smaller values do not
+    // save round trips and are treated as 1. The size of hinted regions is
+    // estimated by the size of the last chunk read.
+    //
+    // This requires the byte `Reader` to support random access, and is
+    // ignored otherwise. `InterpolationSearch()` does not hint probes, because
+    // they depend on results of earlier probes.
+    //
+    // Default: 1.
+    Options& set_search_fanout(size_t search_fanout) & {
+      RIEGELI_ASSERT_GT(search_fanout, 0u)
+          << "Failed precondition of "
+             "RecordReaderBase::Options::set_search_fanout(): "
+             "zero search fanout";
+      search_fanout_ = search_fanout;
+      return *this;
+    }
+    Options&& set_search_fanout(size_t search_fanout) && {
+      return std::move(set_search_fanout(search_fanout));
+    }
+    size_t search_fanout() const { return search_fanout_; }
+
+    // If not `absl::nullopt`, values of chunks written with
+    // `set_transpose(false)` whose decoded size is at least
+    // `*streaming_min_size` are decompressed incrementally while their records
+    // are read, instead of all at once when the chunk is read. This bounds
+    // memory usage by the record size rather than by the chunk size, which
+    // matters for files written with a large `set_chunk_size()`.
+    //
+    // In this mode corruption of record values is detected when reading the
+    // affected record, and seeking backwards within such a chunk decompresses
+    // it again from the beginning. `ReadRecords()` still buffers the remaining
+    // records of the chunk.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_streaming_min_size(
+        absl::optional<uint64_t> streaming_min_size) & {
+      streaming_min_size_ = streaming_min_size;
+      return *this;
+    }
+    Options&& set_streaming_min_size(
+        absl::optional<uint64_t> streaming_min_size) && {
+      return std::move(set_streaming_min_size(streaming_min_size));
+    }
+    absl::optional<uint64_t> streaming_min_size() const {
+      return streaming_min_size_;
+    }
+
+    // If positive, blocks of chunk data and of decompressed chunk values freed
+    // while reading a chunk, e.g. those of the previous chunk no longer
+    // referenced by records, are kept in a `ChainBlockPool` caching up to
+    // `chunk_block_pool_size` bytes, and reused for the following chunks.
+    // Sequential reading then does not allocate large blocks in steady state.
+    //
+    // Blocks shared with records returned by `ReadRecord(Chain&)` or
+    // `ReadRecord(absl::Cord&)` are reused only if these records are dropped
+    // before reading the chunk which could reuse them.
+    //
+    // This applies to chunks decoded by the calling thread, i.e. it has no
+    // effect if `parallelism() > 0`.
+    //
+    // The pool is kept by `Reset()` with the same `chunk_block_pool_size`, so a
+    // `RecordReader` reused for many sources keeps reusing its blocks.
+    //
+    // Default: 0.
+    Options& set_chunk_block_pool_size(size_t chunk_block_pool_size) & {
+      chunk_block_pool_size_ = chunk_block_pool_size;
+      return *this;
+    }
+    Options&& set_chunk_block_pool_size(size_t chunk_block_pool_size) && {
+      return std::move(set_chunk_block_pool_size(chunk_block_pool_size));
+    }
+    size_t chunk_block_pool_size() const { return chunk_block_pool_size_; }
+
+    // If not `absl::nullopt`, only records matching `*record_filter` are
+    // returned by `ReadRecord()` and `ReadRecords()`. This is useful for
+    // selective reading, e.g. of records with a particular value of a field.
+    //
+    // The filter is effective if the file has been written with
+    // `set_transpose(true)`: the filter is evaluated on records decoded with
+    // only the field it tests, and chunks with no matching records are not
+    // decoded further. Otherwise the filter is evaluated on decoded records.
+    //
+    // If the file has been written with `set_column_statistics()` including
+    // the column tested by the filter, chunks whose statistics show that no
+    // record matches are skipped without decoding them. This is most
+    // effective with `FieldPredicate::Int64Range()` and similar, and with
+    // records sorted by the tested field.
+    //
+    // If the file has been written with `set_bloom_filter_columns()` including
+    // the column tested by `FieldPredicate::Int64Equals()` or
+    // `FieldPredicate::BytesEquals()`, chunks which do not contain the key
+    // are skipped, except for Bloom filter false positives. A point lookup
+    // then decodes about one chunk, reading only statistics of others.
+    //
+    // Records which do not match are still counted by positions and by
+    // `SeekToRecordNumber()`. `Seek()`, `SeekBack()`, and `Search()` may
+    // position at a record which does not match, which is then skipped by the
+    // next `ReadRecord()`.
+    //
+    // If `parallelism() > 0`, the filter is called concurrently from several
+    // threads.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_record_filter(absl::optional<FieldPredicate> record_filter) & {
+      record_filter_ = std::move(record_filter);
+      return *this;
+    }
+    Options&& set_record_filter(
+        absl::optional<FieldPredicate> record_filter) && {
+      return std::move(set_record_filter(std::move(record_filter)));
+    }
+    absl::optional<FieldPredicate>& record_filter() { return record_filter_; }
+    const absl::optional<FieldPredicate>& record_filter() const {
+      return record_filter_;
+    }
+
+    // If not `nullptr`, counts chunks, records, and bytes read, and measures
+    // time spent in stages of reading: reading chunks from the `ChunkReader`,
+    // decoding them, and waiting for chunks decoded in background if
+    // `parallelism() > 0`. `stats->Report()` is called by `Close()`.
+    //
+    // If `parallelism() > 0`, this also tracks chunks queued after reading
+    // ahead, and stalls of reading ahead caused by `max_decoded_bytes()`.
+    //
+    // If `stats->tracer()` is not `nullptr`, it receives a span of each stage,
+    // tagged with the chunk position and size where known.
+    //
+    // If `nullptr`, nothing is measured and the clock is not read.
+    //
+    // The `RecordsStats` is not owned and must be valid until `Close()`
+    // returns.
+    //
+    // Default: `nullptr`.
+    Options& set_stats(RecordsStats* stats) & {
+      stats_ = stats;
+      return *this;
+    }
+    Options&& set_stats(RecordsStats* stats) && {
+      return std::move(set_stats(stats));
+    }
+    RecordsStats* stats() const { return stats_; }
+
+    // If not `nullptr`, chunks decoded by the calling thread are kept in
+    // `*chunk_cache`, and a chunk found there is not read and decoded again.
+    // This makes repeated `Seek()` or `Search()` near the same records cheap.
+    //
+    // A `ChunkCache` can be shared by `RecordReader`s of different files,
+    // distinguished by `chunk_cache_file_id()`. After `SetFieldProjection()`
+    // the cache is no longer used by this reader.
+    //
+    // Chunks decoded in background if `parallelism() > 0` are not cached.
+    //
+    // The `ChunkCache` is not owned and must outlive the `RecordReader`.
+    //
+    // Default: `nullptr`.
+    Options& set_chunk_cache(ChunkCache* chunk_cache) & {
+      chunk_cache_ = chunk_cache;
+      return *this;
+    }
+    Options&& set_chunk_cache(ChunkCache* chunk_cache) && {
+      return std::move(set_chunk_cache(chunk_cache));
+    }
+    ChunkCache* chunk_cache() const { return chunk_cache_; }
+
+    // Identifies the file and the way its chunks are decoded in
+    // `chunk_cache()`. Readers sharing a `ChunkCache` must use the same
+    // identity for the same file read with the same `field_projection()` and
+    // `record_filter()`, and different identities otherwise, e.g. the
+    // filename followed by a description of the field projection.
+    //
+    // Default: "".
+    Options& set_chunk_cache_file_id(absl::string_view chunk_cache_file_id) & {
+      // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+      // `chunk_cache_file_id_ = chunk_cache_file_id;`
+      chunk_cache_file_id_.assign(chunk_cache_file_id.data(),
+                                  chunk_cache_file_id.size());
+      return *this;
+    }
+    Options&& set_chunk_cache_file_id(
+        absl::string_view chunk_cache_file_id) && {
+      return std::move(set_chunk_cache_file_id(chunk_cache_file_id));
+    }
+    std::string& chunk_cache_file_id() { return chunk_cache_file_id_; }
+    const std::string& chunk_cache_file_id() const {
+      return chunk_cache_file_id_;
+    }
+
+    // Computes keys of serialized records for `Lookup()`. This must compute
+    // the same keys as `RecordWriterBase::Options::set_record_key()` used for
+    // writing the file.
+    //
+    // If `nullptr`, the key is the whole record.
+    //
+    // Default: `nullptr`.
+    Options& set_record_key(RecordKeyFunction record_key) & {
+      record_key_ = std::move(record_key);
+      return *this;
+    }
+    Options&& set_record_key(RecordKeyFunction record_key) && {
+      return std::move(set_record_key(std::move(record_key)));
+    }
+    RecordKeyFunction& record_key() { return record_key_; }
+    const RecordKeyFunction& record_key() const { return record_key_; }
+
+    // Computes timestamps of serialized records for `SeekToTime()`. This must
+    // compute the same timestamps as
+    // `RecordWriterBase::Options::set_record_timestamp()` used for writing the
+    // file.
+    //
+    // If `nullptr`, `SeekToTime()` has only the precision of chunks.
+    //
+    // Default: `nullptr`.
+    Options& set_record_timestamp(RecordTimestampFunction record_timestamp) & {
+      record_timestamp_ = std::move(record_timestamp);
+      return *this;
+    }
+    Options&& set_record_timestamp(
+        RecordTimestampFunction record_timestamp) && {
+      return std::move(set_record_timestamp(std::move(record_timestamp)));
+    }
+    RecordTimestampFunction& record_timestamp() { return record_timestamp_; }
+    const RecordTimestampFunction& record_timestamp() const {
+      return record_timestamp_;
+    }
+
    private:
     FieldProjection field_projection_ = FieldProjection::All();
     std::function<bool(const SkippedRegion&)> recovery_;
+    int parallelism_ = 0;
+    absl::optional<uint64_t> max_decoded_bytes_;
+    bool parallel_buckets_ = false;
+    bool projected_range_reads_ = false;
+    bool hash_while_decoding_ = false;
+    size_t readahead_chunks_ = 0;
+    size_t search_fanout_ = 1;
+    absl::optional<uint64_t> streaming_min_size_;
+    size_t chunk_block_pool_size_ = 0;
+    absl::optional<FieldPredicate> record_filter_;
+    RecordsStats* stats_ = nullptr;
+    ChunkCache* chunk_cache_ = nullptr;
+    std::string chunk_cache_file_id_;
+    RecordKeyFunction record_key_;
+    RecordTimestampFunction record_timestamp_;
   };
 
+  ~RecordReaderBase();
+
   // Returns the Riegeli/records file being read from. Unchanged by `Close()`.
   virtual ChunkReader* src_chunk_reader() = 0;
   virtual const ChunkReader* src_chunk_reader() const = 0;
@@ -196,6 +661,18 @@ class RecordReaderBase : public Object {
   //  * `false` (when `!healthy()`) - failure
   bool ReadMetadata(RecordsMetadata& metadata);
 
+  // Like `ReadMetadata()`, but returns metadata shared with other files having
+  // the same serialized metadata, together with their descriptors. This avoids
+  // repeated parsing and building of descriptors when many files with the same
+  // large schema are opened.
+  //
+  // Return values:
+  //  * `true`                      - success (`metadata` is set)
+  //  * `false` (when `healthy()`)  - source ends
+  //  * `false` (when `!healthy()`) - failure
+  bool ReadSharedMetadata(
+      std::shared_ptr<const SharedRecordsMetadata>& metadata);
+
   // Like `ReadMetadata()`, but metadata is returned in the serialized form.
   //
   // This is faster if the caller needs metadata already serialized.
@@ -206,7 +683,11 @@ class RecordReaderBase : public Object {
   // `ReadRecord(google::protobuf::MessageLite&)` parses raw bytes to a proto
   // message after reading. The remaining overloads read raw bytes. For
   // `ReadRecord(absl::string_view&)` the `absl::string_view` is valid until the
-  // next non-const operation on this `RecordReader`.
+  // next non-const operation on this `RecordReader`. `ReadRecord(Chain&)` and
+  // `ReadRecord(absl::Cord&)` share memory with the decoded chunk instead of
+  // copying it, except for short records which are copied because this is
+  // cheaper. Passing the same `Chain` to consecutive calls lets short records
+  // be copied to its existing block instead of allocating a new one.
   //
   // Return values:
   //  * `true`                      - success (`record` is set)
@@ -218,6 +699,92 @@ class RecordReaderBase : public Object {
   bool ReadRecord(Chain& record);
   bool ReadRecord(absl::Cord& record);
 
+  // Reads the next record as a `Reader` of its value, for records too large to
+  // be materialized, e.g. written with `RecordWriterBase::NewRecordWriter()`.
+  //
+  // If `Options::streaming_min_size()` applies to the chunk of the record, its
+  // value is decompressed while it is being read from the `Reader`, so memory
+  // usage is bounded by the compressed chunk rather than by the record size.
+  // Otherwise the `Reader` shares memory with the decoded chunk.
+  //
+  // The `Reader` is valid until the next non-const operation on this
+  // `RecordReader`. It does not need to be read until its end. Failures of
+  // reading the value are reported by the `Reader`, and they also make the
+  // next operation on this `RecordReader` fail.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends
+  //  * `false` (when `!healthy()`) - failure
+  bool ReadRecord(std::unique_ptr<Reader>& record);
+
+  // Reads all remaining records of the current chunk at once, reading the next
+  // chunk first if there are none. This avoids per-record overhead of
+  // `ReadRecord()`, which is significant for small records.
+  //
+  // `records` is replaced by the records read. The `absl::string_view`s are
+  // valid until the next non-const operation on this `RecordReader`.
+  //
+  // After a successful `ReadRecords()`, `last_pos()` is the position of the
+  // last record read.
+  //
+  // Return values:
+  //  * `true`                      - success (`records` is non-empty)
+  //  * `false` (when `healthy()`)  - source ends (`records` is empty)
+  //  * `false` (when `!healthy()`) - failure (`records` is empty)
+  bool ReadRecords(std::vector<absl::string_view>& records);
+
+  // Reads up to `max_num_records` next records, parsing them into messages
+  // allocated on `arena` by `prototype.New(&arena)`.
+  //
+  // Fields of messages allocated on an arena are allocated on the arena too,
+  // and resetting the arena between batches frees them all at once. When
+  // records of a batch must be alive at the same time, this is faster than
+  // `ReadRecord(google::protobuf::MessageLite&)` into separately allocated
+  // messages. When each record can be processed before reading the next one,
+  // reusing a single message with `ReadRecord()` remains faster.
+  //
+  // `records` is replaced by pointers to the messages read. They are owned by
+  // `arena`.
+  //
+  // If reading fails after some records were read, `ReadRecords()` returns
+  // them, and the next call reports the failure.
+  //
+  // Precondition: `max_num_records > 0`
+  //
+  // Return values:
+  //  * `true`                      - success (`records` is non-empty)
+  //  * `false` (when `healthy()`)  - source ends (`records` is empty)
+  //  * `false` (when `!healthy()`) - failure (`records` is empty)
+  bool ReadRecords(const google::protobuf::MessageLite& prototype,
+                   google::protobuf::Arena& arena, size_t max_num_records,
+                   std::vector<google::protobuf::MessageLite*>& records);
+
+  // For a source which is being appended to, e.g. a file still being written
+  // by a `RecordWriter` which flushes it: after `ReadRecord()` or
+  // `ReadRecords()` returned `false` with `healthy()`, waits until a complete
+  // chunk follows, so that reading can continue.
+  //
+  // This polls the source, with intervals growing exponentially from 1ms to
+  // `max_poll_interval`. Each poll tries to continue reading at the current
+  // position: a chunk whose beginning has already been read is completed
+  // without reading the beginning again, and the file is not reopened or
+  // scanned. For a `FdReader`, an unsuccessful poll costs a `read()`.
+  //
+  // Records become visible to the reader when the writer flushes them, e.g.
+  // with `RecordWriterBase::Flush()`.
+  //
+  // Return values:
+  //  * `true`                      - a chunk is available, reading can
+  //                                  continue (records of the chunk might
+  //                                  still be filtered out by
+  //                                  `Options::record_filter()`)
+  //  * `false` (when `healthy()`)  - `timeout` passed
+  //  * `false` (when `!healthy()`) - failure
+  bool WaitForNewData(absl::Duration timeout = absl::InfiniteDuration(),
+                      absl::Duration max_poll_interval = absl::Milliseconds(
+                          100));
+
   // Like `Options::set_field_projection()`, but can be done at any time.
   //
   // This may cause reading the current chunk again.
@@ -284,8 +851,8 @@ class RecordReaderBase : public Object {
   // `pos()` is unchanged by `Close()`.
   RecordPosition pos() const;
 
-  // Returns `true` if this `RecordReader` supports `Seek()`, `SeekBack()`,
-  // `Size()`, and `Search()`.
+  // Returns `true` if this `RecordReader` supports `Seek()`,
+  // `SeekToRecordNumber()`, `SeekBack()`, `Size()`, and `Search()`.
   bool SupportsRandomAccess();
 
   // Seeks to a position.
@@ -302,6 +869,35 @@ class RecordReaderBase : public Object {
   bool Seek(RecordPosition new_pos);
   bool Seek(Position new_pos);
 
+  // Seeks to the record with the given number, counting records in the file
+  // from 0. If `record_number` is not smaller than the number of records, seeks
+  // to the end of file.
+  //
+  // If the file has a chunk index (see
+  // `RecordWriterBase::Options::set_chunk_index()`), the chunk is located by a
+  // lookup. Otherwise chunks before it are skipped by their headers, without
+  // reading or decoding their contents.
+  //
+  // If recovery skips a region of the file, records in that region are not
+  // counted.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool SeekToRecordNumber(uint64_t record_number);
+
+  // Returns the number of records in the file.
+  //
+  // If the file has a chunk index, it is taken from the chunk index. Otherwise
+  // chunk headers are read, without reading or decoding their contents, and
+  // then the reader seeks back to the current position.
+  //
+  // If recovery skips a region of the file, records in that region are not
+  // counted.
+  //
+  // Returns `absl::nullopt` on failure (`!healthy()`).
+  absl::optional<uint64_t> NumRecords();
+
   // Seeks back by one record.
   //
   // Return values:
@@ -385,9 +981,107 @@ class RecordReaderBase : public Object {
   template <typename Record, typename Test>
   absl::optional<absl::partial_ordering> Search(Test test);
 
+  // A variant of `Search()` for a file whose records are sorted by a numeric
+  // key, e.g. a timestamp, which chooses chunks to probe by interpolating
+  // between chunks probed so far instead of by bisection. With uniformly
+  // distributed keys this needs about log(log(n)) probes instead of log(n).
+  // To bound the worst case, two steps in a row which did not halve the range
+  // being searched are followed by a bisection step.
+  //
+  // The `test` function takes `*this` as a parameter, seeked to some record,
+  // and returns `absl::optional<double>`, an estimate of the distance from the
+  // current record to the desired position, e.g. the key of the record minus
+  // the desired key:
+  //  * `absl::nullopt` - Cancel the search.
+  //  * negative        - The current record is before the desired position.
+  //  * 0               - The current record is desired, searching can stop.
+  //  * positive        - The current record is after the desired position.
+  //  * NaN             - It could not be determined which is the case.
+  //                      The current record will be skipped.
+  //
+  // The result depends only on signs of distances. Their magnitudes can be
+  // approximate, but interpolation is effective if they are roughly linear in
+  // keys.
+  //
+  // Preconditions, return values, and further guarantees are as for
+  // `Search()`, with negative, 0, positive, and NaN distances corresponding
+  // to `less`, `equivalent`, `greater`, and `unordered`.
+  absl::optional<absl::partial_ordering> InterpolationSearch(
+      absl::FunctionRef<absl::optional<double>(RecordReaderBase& reader)>
+          test);
+
+  // A variant of `InterpolationSearch()` which reads a record before calling
+  // `test()`, instead of letting `test()` read the record.
+  //
+  // The `Record` type must be supported by `ReadRecord()`, and `test` must be
+  // callable with an argument of type `Record&` or `const Record&`, returning
+  // `absl::optional<double>`.
+  template <typename Record, typename Test>
+  absl::optional<absl::partial_ordering> InterpolationSearch(Test test);
+
+  // Seeks to the record whose key computed by `Options::record_key()` is
+  // `key`, in a file whose records are sorted by strictly increasing keys.
+  //
+  // If the file has a key index (see
+  // `RecordWriterBase::Options::set_key_index()`), the only chunk which can
+  // contain `key` is found by a binary search in the index, which is loaded
+  // once, and only that chunk is read. Otherwise this uses `Search()`.
+  //
+  // Return values:
+  //  * `true`                      - success (`key` found,
+  //                                  the next `ReadRecord()` reads its record)
+  //  * `false` (when `healthy()`)  - `key` not found (points to the earliest
+  //                                  record with a greater key, or to the end
+  //                                  of file)
+  //  * `false` (when `!healthy()`) - failure
+  bool Lookup(absl::string_view key);
+
+  // Seeks to the earliest record whose timestamp computed by
+  // `Options::record_timestamp()` is at least `time`, in a file whose records
+  // are roughly ordered by time.
+  //
+  // If the file has a time index (see
+  // `RecordWriterBase::Options::set_record_timestamp()`), this seeks to the
+  // first chunk which can contain such records, found in the index, which is
+  // loaded once. Then, if `Options::record_timestamp()` is not `nullptr`,
+  // records of that chunk with smaller timestamps are skipped. Earlier chunks
+  // are not read.
+  //
+  // Without a time index, if `Options::record_timestamp()` is not `nullptr`,
+  // this uses `Search()`, which requires timestamps to be non-decreasing,
+  // otherwise this seeks to the beginning of the file.
+  //
+  // Return values:
+  //  * `true`  - success (possibly at the end of file)
+  //  * `false` - failure (`!healthy()`)
+  bool SeekToTime(int64_t time);
+
+  // Prepares for reading records with timestamps in the range [`begin`, `end`)
+  // by skipping chunks which cannot contain such records according to the
+  // time index, without reading them. Records of a chunk which can contain
+  // such records may still be outside of the range, so the caller should
+  // filter them.
+  //
+  // This is meant to be called before each `ReadRecord()` of a range scan,
+  // e.g. after `SeekToTime(begin)`. It is cheap if the current chunk does not
+  // change.
+  //
+  // Without a time index this does not change the position.
+  //
+  // Return values:
+  //  * `true`                      - success (the current chunk can contain
+  //                                  records in the range, or the file has no
+  //                                  time index)
+  //  * `false` (when `healthy()`)  - no more chunks can contain records in the
+  //                                  range (points to the end of records)
+  //  * `false` (when `!healthy()`) - failure
+  bool SkipToTimeRange(int64_t begin, int64_t end);
+
  protected:
   enum class Recoverable { kNo, kRecoverChunkReader, kRecoverChunkDecoder };
 
+  class ParallelDecoder;
+
   explicit RecordReaderBase(Closed) noexcept;
 
   RecordReaderBase() noexcept;
@@ -406,6 +1100,10 @@ class RecordReaderBase : public Object {
 
   bool TryRecovery();
 
+  // Implementation of `pos()` after the current chunk when
+  // `parallel_decoder_ != nullptr`.
+  RecordPosition ParallelPos() const;
+
   // Position of the beginning of the current chunk or end of file, except when
   // `Seek(Position)` failed to locate the chunk containing the position, in
   // which case this is that position.
@@ -420,6 +1118,10 @@ class RecordReaderBase : public Object {
   //        chunk_decoder_.index() == chunk_decoder_.num_records()`
   ChunkDecoder chunk_decoder_;
 
+  // Decompresses buckets of transposed chunks in parallel if
+  // `Options::parallel_buckets()`, otherwise `nullptr`.
+  Executor* bucket_executor_ = nullptr;
+
   bool last_record_is_valid_ = false;
 
   // Whether `Recover()` is applicable, and if so, how it should be performed:
@@ -439,9 +1141,91 @@ class RecordReaderBase : public Object {
 
   std::function<bool(const SkippedRegion&)> recovery_;
 
+  // Reads chunks ahead and decodes them in background if
+  // `Options::parallelism() > 0`, otherwise `nullptr`.
+  std::unique_ptr<ParallelDecoder> parallel_decoder_;
+
+  // Whether `LoadChunkIndex()` has been called.
+  bool chunk_index_searched_ = false;
+
+  // The chunk index written by `RecordWriter` if
+  // `RecordWriterBase::Options::chunk_index()`, if it has been loaded and it
+  // applies to this file.
+  absl::optional<ChunkIndex> chunk_index_;
+
+  // If `chunk_index_ != absl::nullopt`, the position of the chunk index chunk.
+  // Chunks before this position are covered by the index.
+  Position chunk_index_pos_ = 0;
+
+  // Whether `LoadKeyIndex()` has been called.
+  bool key_index_searched_ = false;
+
+  // The key index written by `RecordWriter` if
+  // `RecordWriterBase::Options::key_index()`, if it has been loaded and it
+  // corresponds to `chunk_index_`.
+  absl::optional<KeyIndex> key_index_;
+
+  // Computes keys of records for `Lookup()`.
+  RecordKeyFunction record_key_;
+
+  // Whether `LoadTimeIndex()` has been called.
+  bool time_index_searched_ = false;
+
+  // The time index written by `RecordWriter` if
+  // `RecordWriterBase::Options::record_timestamp() != nullptr`, if it has been
+  // loaded and it corresponds to `chunk_index_`.
+  absl::optional<TimeIndex> time_index_;
+
+  // Computes timestamps of records for `SeekToTime()`.
+  RecordTimestampFunction record_timestamp_;
+
+  // The Zstd dictionary from the `ChunkType::kZstdDictionary` chunk of the
+  // file, or empty if it has not been read.
+  ZstdDictionary zstd_dictionary_;
+
+  // Whether `LoadZstdDictionary()` has been called.
+  bool zstd_dictionary_searched_ = false;
+
+  // If `true`, transposed chunks are read on demand with a field projection.
+  bool projected_range_reads_ = false;
+
+  // If `true`, chunk data hashes are verified while chunks are decoded.
+  bool hash_while_decoding_ = false;
+
+  // The number of chunks hinted as needed soon while reading sequentially.
+  size_t readahead_chunks_ = 0;
+
+  // The number of probes of the binary search in `Search()` hinted at once,
+  // as given by `Options::set_search_fanout()`.
+  size_t search_fanout_ = 1;
+
+  // Caches blocks freed while reading chunks if
+  // `Options::chunk_block_pool_size() > 0`, otherwise `nullptr`.
+  std::unique_ptr<ChainBlockPool> chunk_block_pool_;
+
+  // The access pattern last hinted to `src_chunk_reader()`.
+  AccessPattern access_pattern_ = AccessPattern::kNormal;
+
+  // If not `nullptr`, collects counters of reading.
+  RecordsStats* stats_ = nullptr;
+
+  // If not `nullptr`, caches chunks decoded by `ReadChunk()`.
+  ChunkCache* chunk_cache_ = nullptr;
+
+  // Identifies this file in `chunk_cache_`.
+  std::string chunk_cache_file_id_;
+
  private:
   class ChunkSearchTraits;
 
+  // Implementation of `Search()` and `InterpolationSearch()`, choosing chunks
+  // to probe with `traits`.
+  absl::optional<absl::partial_ordering> SearchChunks(
+      absl::FunctionRef<
+          absl::optional<absl::partial_ordering>(RecordReaderBase& reader)>
+          test,
+      ChunkSearchTraits& traits);
+
   bool FailReading(const ChunkReader& src);
   bool FailSeeking(const ChunkReader& src);
 
@@ -451,10 +1235,96 @@ class RecordReaderBase : public Object {
   bool ReadRecordImpl(Record& record);
 
   // Reads the next chunk from `chunk_reader_` and decodes it into
-  // `chunk_decoder_` and `chunk_begin_`. On failure resets `chunk_decoder_`.
+  // `chunk_decoder_` and `chunk_begin_`, setting the record index to `index`.
+  // Records before `index` of a transposed chunk are reconstructed only if
+  // seeking moves back to them. On failure resets `chunk_decoder_`.
   //
   // Precondition: `healthy()`
-  bool ReadChunk();
+  bool ReadChunk(uint64_t index = 0);
+
+  // Like `ReadChunk()`, but reads a transposed chunk with
+  // `ChunkReader::ReadChunkOnDemand()`, so that only buckets needed for the
+  // field projection are read.
+  //
+  // Precondition: `healthy()`, `src_chunk_reader()->SupportsRandomAccess()`
+  bool ReadChunkOnDemand(uint64_t index);
+
+  // Sets the record index of `chunk_decoder_`, which can require decoding the
+  // current chunk again.
+  //
+  // Precondition: `healthy()`
+  bool SetChunkIndex(uint64_t index);
+
+  // Like `ReadChunk()`, but if `parallel_decoder_ != nullptr`, takes the chunk
+  // from chunks read ahead, and reads further chunks ahead.
+  //
+  // Precondition: `healthy()`
+  bool ReadNextChunk();
+
+  // Hints to `src_chunk_reader()` that reading continues sequentially, or
+  // after seeking.
+  void AdviseSequentialReading();
+  void AdviseRandomReading();
+
+  // Loads `chunk_index_` from the end of the file, unless this has already
+  // been attempted. Moves `chunk_reader_` to an unspecified position.
+  //
+  // Return values:
+  //  * `true`  - success (`chunk_index_` is loaded or absent)
+  //  * `false` - failure (`!healthy()`)
+  //
+  // Precondition: `healthy()`
+  bool LoadChunkIndex();
+
+  // Loads `chunk_index_` and `key_index_` from the end of the file, unless this
+  // has already been attempted. Moves `chunk_reader_` to an unspecified
+  // position.
+  //
+  // Return values:
+  //  * `true`  - success (`key_index_` is loaded or absent)
+  //  * `false` - failure (`!healthy()`)
+  //
+  // Precondition: `healthy()`
+  bool LoadKeyIndex();
+
+  // Loads `chunk_index_` and `time_index_` from the end of the file, unless
+  // this has already been attempted. Moves `chunk_reader_` to an unspecified
+  // position.
+  //
+  // Return values:
+  //  * `true`  - success (`time_index_` is loaded or absent)
+  //  * `false` - failure (`!healthy()`)
+  //
+  // Precondition: `healthy()`
+  bool LoadTimeIndex();
+
+  // Takes `zstd_dictionary_` from `chunk` if this is the Zstd dictionary chunk,
+  // or loads it with `LoadZstdDictionary()` if `chunk` needs it.
+  //
+  // Return values:
+  //  * `true`  - success (`zstd_dictionary_` is loaded, absent, or not needed)
+  //  * `false` - failure (`!healthy()`)
+  //
+  // Precondition: `healthy()`
+  bool PrepareZstdDictionary(const Chunk& chunk);
+
+  // Loads `zstd_dictionary_` from the beginning of the file, unless this has
+  // already been attempted. Moves `chunk_reader_` back to its position.
+  //
+  // Return values:
+  //  * `true`  - success (`zstd_dictionary_` is loaded or absent)
+  //  * `false` - failure (`!healthy()`)
+  //
+  // Precondition: `healthy()`
+  bool LoadZstdDictionary();
+
+  // If chunks have been read ahead, discards them and seeks `chunk_reader_`
+  // back to the first of them.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool CancelReadAhead();
 };
 
 // `RecordReader` reads records of a Riegeli/records file. A record is
@@ -630,6 +1500,7 @@ inline RecordPosition RecordReaderBase::pos() const {
       ABSL_PREDICT_FALSE(recoverable_ == Recoverable::kRecoverChunkDecoder)) {
     return RecordPosition(chunk_begin_, chunk_decoder_.index());
   }
+  if (ABSL_PREDICT_FALSE(parallel_decoder_ != nullptr)) return ParallelPos();
   return RecordPosition(src_chunk_reader()->pos(), 0);
 }
 
@@ -645,6 +1516,19 @@ absl::optional<absl::partial_ordering> RecordReaderBase::Search(Test test) {
       });
 }
 
+template <typename Record, typename Test>
+absl::optional<absl::partial_ordering> RecordReaderBase::InterpolationSearch(
+    Test test) {
+  Record record;
+  return InterpolationSearch(
+      [&](RecordReaderBase& self) -> absl::optional<double> {
+        if (ABSL_PREDICT_FALSE(!self.ReadRecord(record))) {
+          return std::numeric_limits<double>::quiet_NaN();
+        }
+        return test(record);
+      });
+}
+
 template <typename Src>
 inline RecordReader<Src>::RecordReader(const Src& src, Options options)
     : src_(src) {
@@ -730,6 +1614,7 @@ inline RecordPosition RecordReader<Src>::pos() const {
       ABSL_PREDICT_FALSE(recoverable_ == Recoverable::kRecoverChunkDecoder)) {
     return RecordPosition(chunk_begin_, chunk_decoder_.index());
   }
+  if (ABSL_PREDICT_FALSE(parallel_decoder_ != nullptr)) return ParallelPos();
   return RecordPosition(src_->pos(), 0);
 }
 
@@ -0,0 +1,87 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/record_reader_factory.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/limiting_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/reader_factory.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_splits.h"
+
+namespace riegeli {
+
+void RecordReaderFactoryBase::Initialize(Options&& options) {
+  ReaderFactoryBase& factory = *reader_factory();
+  if (ABSL_PREDICT_FALSE(!factory.healthy())) {
+    FailWithoutAnnotation(factory.status());
+    return;
+  }
+  record_reader_options_ = std::move(options.record_reader_options());
+  const std::unique_ptr<Reader> reader = factory.NewReader(0);
+  if (ABSL_PREDICT_FALSE(reader == nullptr)) {
+    FailWithoutAnnotation(factory.status());
+    return;
+  }
+  DefaultChunkReader<> chunk_reader(reader.get());
+  std::vector<RecordRange> splits;
+  if (ABSL_PREDICT_FALSE(
+          !SplitRecords(chunk_reader, options.num_ranges(), splits))) {
+    FailWithoutAnnotation(chunk_reader.status());
+    return;
+  }
+  boundaries_.reserve(splits.size() + 1);
+  for (const RecordRange& split : splits) {
+    boundaries_.push_back(split.begin.chunk_begin());
+  }
+  boundaries_.push_back(splits.back().end.chunk_begin());
+}
+
+absl::Status RecordReaderFactoryBase::AnnotateStatusImpl(absl::Status status) {
+  if (is_open()) return reader_factory()->AnnotateStatus(std::move(status));
+  return status;
+}
+
+std::unique_ptr<RecordReaderBase> RecordReaderFactoryBase::NewRecordReader(
+    size_t index) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  RIEGELI_ASSERT_LT(index, num_ranges())
+      << "Failed precondition of RecordReaderFactoryBase::NewRecordReader(): "
+         "range index out of range";
+  ReaderFactoryBase& factory = *reader_factory();
+  std::unique_ptr<Reader> reader = factory.NewReader(range_begin(index));
+  if (ABSL_PREDICT_FALSE(reader == nullptr)) {
+    FailWithoutAnnotation(factory.status());
+    return nullptr;
+  }
+  return std::make_unique<
+      RecordReader<LimitingReader<std::unique_ptr<Reader>>>>(
+      std::forward_as_tuple(
+          std::move(reader),
+          LimitingReaderBase::Options().set_max_pos(range_end(index))),
+      record_reader_options_);
+}
+
+}  // namespace riegeli
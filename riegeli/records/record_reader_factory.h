@@ -0,0 +1,371 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORD_READER_FACTORY_H_
+#define RIEGELI_RECORDS_RECORD_READER_FACTORY_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/reader_factory.h"
+#include "riegeli/records/record_reader.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `RecordReaderFactory`.
+class RecordReaderFactoryBase : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // The number of ranges which the file is split into.
+    //
+    // Ranges have similar sizes, but they are aligned to chunk boundaries, so
+    // some of them can be empty if chunks are large.
+    //
+    // Default: 1.
+    Options& set_num_ranges(size_t num_ranges) & {
+      RIEGELI_ASSERT_GT(num_ranges, 0u)
+          << "Failed precondition of "
+             "RecordReaderFactoryBase::Options::set_num_ranges(): "
+             "zero number of ranges";
+      num_ranges_ = num_ranges;
+      return *this;
+    }
+    Options&& set_num_ranges(size_t num_ranges) && {
+      return std::move(set_num_ranges(num_ranges));
+    }
+    size_t num_ranges() const { return num_ranges_; }
+
+    // Options for `ReaderFactory` which provides byte `Reader`s for ranges.
+    //
+    // Default: `ReaderFactoryBase::Options()`.
+    Options& set_reader_factory_options(
+        ReaderFactoryBase::Options reader_factory_options) & {
+      reader_factory_options_ = std::move(reader_factory_options);
+      return *this;
+    }
+    Options&& set_reader_factory_options(
+        ReaderFactoryBase::Options reader_factory_options) && {
+      return std::move(
+          set_reader_factory_options(std::move(reader_factory_options)));
+    }
+    ReaderFactoryBase::Options& reader_factory_options() {
+      return reader_factory_options_;
+    }
+    const ReaderFactoryBase::Options& reader_factory_options() const {
+      return reader_factory_options_;
+    }
+
+    // Options for `RecordReader`s returned by `NewRecordReader()`.
+    //
+    // Default: `RecordReaderBase::Options()`.
+    Options& set_record_reader_options(
+        RecordReaderBase::Options record_reader_options) & {
+      record_reader_options_ = std::move(record_reader_options);
+      return *this;
+    }
+    Options&& set_record_reader_options(
+        RecordReaderBase::Options record_reader_options) && {
+      return std::move(
+          set_record_reader_options(std::move(record_reader_options)));
+    }
+    RecordReaderBase::Options& record_reader_options() {
+      return record_reader_options_;
+    }
+    const RecordReaderBase::Options& record_reader_options() const {
+      return record_reader_options_;
+    }
+
+   private:
+    size_t num_ranges_ = 1;
+    ReaderFactoryBase::Options reader_factory_options_;
+    RecordReaderBase::Options record_reader_options_;
+  };
+
+  // Returns the `ReaderFactory` sharing the original `Reader`.
+  virtual ReaderFactoryBase* reader_factory() = 0;
+  virtual const ReaderFactoryBase* reader_factory() const = 0;
+
+  // Returns the number of ranges.
+  size_t num_ranges() const { return boundaries_.size() - 1; }
+
+  // Returns the beginning and end positions of the range with the given index.
+  //
+  // Both positions are chunk boundaries, and ranges cover the whole file
+  // without overlapping. They are computed by `SplitRecords()`.
+  //
+  // Precondition: `index < num_ranges()`
+  Position range_begin(size_t index) const;
+  Position range_end(size_t index) const;
+
+  // Returns a `RecordReader` which reads records of chunks in the range with
+  // the given index. The range ends like the end of file.
+  //
+  // `RecordReader`s of different ranges can be used concurrently. They do not
+  // own the source, and the original `Reader` must not be accessed until they
+  // are closed or no longer used.
+  //
+  // Like `ReaderFactoryBase::NewReader()`, `NewRecordReader()` must not be
+  // called concurrently with other member functions.
+  //
+  // Returns `nullptr` on failure (`!healthy()`).
+  //
+  // Precondition: `index < num_ranges()`
+  std::unique_ptr<RecordReaderBase> NewRecordReader(size_t index);
+
+ protected:
+  explicit RecordReaderFactoryBase(Closed) noexcept : Object(kClosed) {}
+
+  RecordReaderFactoryBase() noexcept {}
+
+  RecordReaderFactoryBase(RecordReaderFactoryBase&& that) noexcept;
+  RecordReaderFactoryBase& operator=(RecordReaderFactoryBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset();
+  void Initialize(Options&& options);
+
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
+      absl::Status status) override;
+
+ private:
+  RecordReaderBase::Options record_reader_options_;
+  // Range boundaries: `boundaries_[index]` and `boundaries_[index + 1]` are
+  // the beginning and end of the range with the given index.
+  //
+  // Invariant: if `healthy()` then `boundaries_.size() >= 2`
+  std::vector<Position> boundaries_;
+};
+
+// `RecordReaderFactory` splits a Riegeli/records file into ranges aligned to
+// chunk boundaries, and provides a `RecordReader` for each range. This allows
+// to read ranges in parallel while opening the file once.
+//
+// The original `Reader` must support random access. It is shared between
+// ranges with `ReaderFactory`.
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the original `Reader`. `Src` must support
+// `Dependency<Reader*, Src>`, e.g. `Reader*` (not owned, default),
+// `std::unique_ptr<Reader>` (owned), `FdReader<>` (owned).
+//
+// By relying on CTAD the template argument can be deduced as the value type of
+// the first constructor argument. This requires C++17.
+//
+// The original `Reader` must not be accessed until the `RecordReaderFactory`
+// is closed or no longer used.
+template <typename Src = Reader*>
+class RecordReaderFactory : public RecordReaderFactoryBase {
+ public:
+  // Creates a closed `RecordReaderFactory`.
+  explicit RecordReaderFactory(Closed) noexcept
+      : RecordReaderFactoryBase(kClosed) {}
+
+  // Will read from the original `Reader` provided by `src`.
+  explicit RecordReaderFactory(const Src& src, Options options = Options());
+  explicit RecordReaderFactory(Src&& src, Options options = Options());
+
+  // Will read from the original `Reader` provided by a `Src` constructed from
+  // elements of `src_args`. This avoids constructing a temporary `Src` and
+  // moving from it.
+  template <typename... SrcArgs>
+  explicit RecordReaderFactory(std::tuple<SrcArgs...> src_args,
+                               Options options = Options());
+
+  RecordReaderFactory(RecordReaderFactory&& that) noexcept;
+  RecordReaderFactory& operator=(RecordReaderFactory&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `RecordReaderFactory`. This
+  // avoids constructing a temporary `RecordReaderFactory` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the original `Reader`.
+  // Unchanged by `Close()`.
+  Src& src() { return reader_factory_.src(); }
+  const Src& src() const { return reader_factory_.src(); }
+  ReaderFactoryBase* reader_factory() override { return &reader_factory_; }
+  const ReaderFactoryBase* reader_factory() const override {
+    return &reader_factory_;
+  }
+
+ protected:
+  void Done() override;
+
+ private:
+  ReaderFactory<Src> reader_factory_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit RecordReaderFactory(Closed)->RecordReaderFactory<DeleteCtad<Closed>>;
+template <typename Src>
+explicit RecordReaderFactory(const Src& src,
+                             RecordReaderFactoryBase::Options options =
+                                 RecordReaderFactoryBase::Options())
+    -> RecordReaderFactory<std::decay_t<Src>>;
+template <typename Src>
+explicit RecordReaderFactory(Src&& src,
+                             RecordReaderFactoryBase::Options options =
+                                 RecordReaderFactoryBase::Options())
+    -> RecordReaderFactory<std::decay_t<Src>>;
+template <typename... SrcArgs>
+explicit RecordReaderFactory(std::tuple<SrcArgs...> src_args,
+                             RecordReaderFactoryBase::Options options =
+                                 RecordReaderFactoryBase::Options())
+    -> RecordReaderFactory<DeleteCtad<std::tuple<SrcArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline RecordReaderFactoryBase::RecordReaderFactoryBase(
+    RecordReaderFactoryBase&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      record_reader_options_(std::move(that.record_reader_options_)),
+      boundaries_(std::move(that.boundaries_)) {}
+
+inline RecordReaderFactoryBase& RecordReaderFactoryBase::operator=(
+    RecordReaderFactoryBase&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  record_reader_options_ = std::move(that.record_reader_options_);
+  boundaries_ = std::move(that.boundaries_);
+  return *this;
+}
+
+inline void RecordReaderFactoryBase::Reset(Closed) {
+  Object::Reset(kClosed);
+  record_reader_options_ = RecordReaderBase::Options();
+  boundaries_.clear();
+}
+
+inline void RecordReaderFactoryBase::Reset() {
+  Object::Reset();
+  record_reader_options_ = RecordReaderBase::Options();
+  boundaries_.clear();
+}
+
+inline Position RecordReaderFactoryBase::range_begin(size_t index) const {
+  RIEGELI_ASSERT_LT(index, num_ranges())
+      << "Failed precondition of RecordReaderFactoryBase::range_begin(): "
+         "range index out of range";
+  return boundaries_[index];
+}
+
+inline Position RecordReaderFactoryBase::range_end(size_t index) const {
+  RIEGELI_ASSERT_LT(index, num_ranges())
+      << "Failed precondition of RecordReaderFactoryBase::range_end(): "
+         "range index out of range";
+  return boundaries_[index + 1];
+}
+
+template <typename Src>
+inline RecordReaderFactory<Src>::RecordReaderFactory(const Src& src,
+                                                     Options options)
+    : reader_factory_(src, options.reader_factory_options()) {
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+inline RecordReaderFactory<Src>::RecordReaderFactory(Src&& src,
+                                                     Options options)
+    : reader_factory_(std::move(src), options.reader_factory_options()) {
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline RecordReaderFactory<Src>::RecordReaderFactory(
+    std::tuple<SrcArgs...> src_args, Options options)
+    : reader_factory_(std::move(src_args), options.reader_factory_options()) {
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+inline RecordReaderFactory<Src>::RecordReaderFactory(
+    RecordReaderFactory&& that) noexcept
+    : RecordReaderFactoryBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      reader_factory_(std::move(that.reader_factory_)) {}
+
+template <typename Src>
+inline RecordReaderFactory<Src>& RecordReaderFactory<Src>::operator=(
+    RecordReaderFactory&& that) noexcept {
+  RecordReaderFactoryBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  reader_factory_ = std::move(that.reader_factory_);
+  return *this;
+}
+
+template <typename Src>
+inline void RecordReaderFactory<Src>::Reset(Closed) {
+  RecordReaderFactoryBase::Reset(kClosed);
+  reader_factory_.Reset(kClosed);
+}
+
+template <typename Src>
+inline void RecordReaderFactory<Src>::Reset(const Src& src, Options options) {
+  RecordReaderFactoryBase::Reset();
+  reader_factory_.Reset(src, options.reader_factory_options());
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+inline void RecordReaderFactory<Src>::Reset(Src&& src, Options options) {
+  RecordReaderFactoryBase::Reset();
+  reader_factory_.Reset(std::move(src), options.reader_factory_options());
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void RecordReaderFactory<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                            Options options) {
+  RecordReaderFactoryBase::Reset();
+  reader_factory_.Reset(std::move(src_args), options.reader_factory_options());
+  Initialize(std::move(options));
+}
+
+template <typename Src>
+void RecordReaderFactory<Src>::Done() {
+  RecordReaderFactoryBase::Done();
+  if (ABSL_PREDICT_FALSE(!reader_factory_.Close())) {
+    FailWithoutAnnotation(reader_factory_.status());
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORD_READER_FACTORY_H_
@@ -0,0 +1,156 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/record_size_estimator.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/message_lite.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/null_writer.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+RecordSizeEstimator::RecordSizeEstimator(
+    RecordWriterBase::Options writer_options, Options options)
+    : sample_period_(options.sample_period()),
+      // Group records into chunks like `RecordWriterBase` does.
+      desired_chunk_size_(UnsignedMin(writer_options.effective_chunk_size(),
+                                      kMaxNumRecords * sizeof(uint64_t))),
+      writer_(std::forward_as_tuple(), std::move(writer_options)) {
+  if (ABSL_PREDICT_FALSE(!writer_.healthy())) {
+    FailWithoutAnnotation(writer_.status());
+    return;
+  }
+  chunk_start_pos_ = writer_.dest().pos();
+}
+
+bool RecordSizeEstimator::StartRecord(size_t size) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  // Matches `RecordWriterBase::AddedChunkSize()` and
+  // `RecordWriterBase::ShouldCloseChunk()`.
+  const uint64_t added_size =
+      SaturatingAdd(IntCast<uint64_t>(size), uint64_t{sizeof(uint64_t)});
+  if ((chunk_size_so_far_ > desired_chunk_size_ ||
+       added_size > desired_chunk_size_ - chunk_size_so_far_) &&
+      chunk_size_so_far_ > 0) {
+    if (ABSL_PREDICT_FALSE(!CloseChunk())) return false;
+  }
+  chunk_size_so_far_ += added_size;
+  ++chunk_num_records_;
+  chunk_decoded_size_ += IntCast<uint64_t>(size);
+  ++num_records_;
+  return true;
+}
+
+bool RecordSizeEstimator::CloseChunk() {
+  if (chunk_sampled_) {
+    // `writer_` owns its `NullWriter`, so this also makes everything written
+    // so far visible in `writer_.dest().pos()`.
+    if (ABSL_PREDICT_FALSE(!writer_.Flush(FlushType::kFromObject))) {
+      return FailWithoutAnnotation(writer_.status());
+    }
+    const Position pos = writer_.dest().pos();
+    ChunkSize chunk_size;
+    chunk_size.num_records = chunk_num_records_;
+    chunk_size.decoded_size = chunk_decoded_size_;
+    chunk_size.encoded_size = pos - chunk_start_pos_;
+    sampled_chunks_.push_back(chunk_size);
+    sampled_decoded_size_ += chunk_size.decoded_size;
+    sampled_encoded_size_ += chunk_size.encoded_size;
+    chunk_start_pos_ = pos;
+  } else {
+    unsampled_decoded_size_ += chunk_decoded_size_;
+  }
+  chunk_size_so_far_ = 0;
+  chunk_num_records_ = 0;
+  chunk_decoded_size_ = 0;
+  ++num_chunks_;
+  chunk_sampled_ = num_chunks_ % sample_period_ == 0;
+  return true;
+}
+
+void RecordSizeEstimator::Done() {
+  if (chunk_size_so_far_ > 0) CloseChunk();
+  if (ABSL_PREDICT_FALSE(!writer_.Close())) {
+    FailWithoutAnnotation(writer_.status());
+  }
+  final_pos_ = writer_.dest().pos();
+}
+
+bool RecordSizeEstimator::AddRecord(
+    const google::protobuf::MessageLite& record) {
+  if (ABSL_PREDICT_FALSE(!StartRecord(record.ByteSizeLong()))) return false;
+  if (!chunk_sampled_) return true;
+  if (ABSL_PREDICT_FALSE(!writer_.WriteRecord(record))) {
+    return FailWithoutAnnotation(writer_.status());
+  }
+  return true;
+}
+
+bool RecordSizeEstimator::AddRecord(absl::string_view record) {
+  if (ABSL_PREDICT_FALSE(!StartRecord(record.size()))) return false;
+  if (!chunk_sampled_) return true;
+  if (ABSL_PREDICT_FALSE(!writer_.WriteRecord(record))) {
+    return FailWithoutAnnotation(writer_.status());
+  }
+  return true;
+}
+
+bool RecordSizeEstimator::AddRecord(const Chain& record) {
+  if (ABSL_PREDICT_FALSE(!StartRecord(record.size()))) return false;
+  if (!chunk_sampled_) return true;
+  if (ABSL_PREDICT_FALSE(!writer_.WriteRecord(record))) {
+    return FailWithoutAnnotation(writer_.status());
+  }
+  return true;
+}
+
+bool RecordSizeEstimator::AddRecord(const absl::Cord& record) {
+  if (ABSL_PREDICT_FALSE(!StartRecord(record.size()))) return false;
+  if (!chunk_sampled_) return true;
+  if (ABSL_PREDICT_FALSE(!writer_.WriteRecord(record))) {
+    return FailWithoutAnnotation(writer_.status());
+  }
+  return true;
+}
+
+double RecordSizeEstimator::compression_ratio() const {
+  if (sampled_decoded_size_ == 0) return 1.0;
+  return static_cast<double>(sampled_encoded_size_) /
+         static_cast<double>(sampled_decoded_size_);
+}
+
+Position RecordSizeEstimator::estimated_file_size() const {
+  RIEGELI_ASSERT(!is_open())
+      << "Failed precondition of RecordSizeEstimator::estimated_file_size(): "
+         "RecordSizeEstimator not closed";
+  return SaturatingAdd(
+      final_pos_,
+      static_cast<Position>(std::llround(
+          static_cast<double>(unsampled_decoded_size_) * compression_ratio())));
+}
+
+}  // namespace riegeli
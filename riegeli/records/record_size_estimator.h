@@ -0,0 +1,175 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORD_SIZE_ESTIMATOR_H_
+#define RIEGELI_RECORDS_RECORD_SIZE_ESTIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/message_lite.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/null_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// Predicts the size of a file which `RecordWriter` with given options would
+// write from given records, without keeping the encoded data.
+//
+// Records are grouped into chunks like `RecordWriter` does. Every
+// `sample_period()`-th chunk is encoded and compressed by a
+// `RecordWriter<NullWriter>`, which counts encoded bytes and discards them.
+// Other chunks are only measured, and their encoded size is extrapolated from
+// the compression ratio of sampled chunks. This makes it cheap to compare
+// compression options, or to plan storage, before writing the real file.
+//
+// The estimate is exact (except for `RecordWriterBase::Options` which tune
+// chunk sizes from the encoded size of earlier chunks) if every chunk is
+// sampled. With `RecordWriterBase::Options::pad_to_block_boundary()`, each
+// sampled chunk is padded as if the file was flushed after it, which
+// overestimates the size of a file which is not flushed that often.
+class RecordSizeEstimator : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Every `sample_period()`-th chunk is encoded, starting from the first
+    // chunk. 1 encodes all chunks.
+    //
+    // Default: 1.
+    Options& set_sample_period(uint64_t sample_period) & {
+      RIEGELI_ASSERT_GT(sample_period, 0u)
+          << "Failed precondition of "
+             "RecordSizeEstimator::Options::set_sample_period(): "
+             "zero sample period";
+      sample_period_ = sample_period;
+      return *this;
+    }
+    Options&& set_sample_period(uint64_t sample_period) && {
+      return std::move(set_sample_period(sample_period));
+    }
+    uint64_t sample_period() const { return sample_period_; }
+
+   private:
+    uint64_t sample_period_ = 1;
+  };
+
+  // Sizes of a sampled chunk.
+  struct ChunkSize {
+    // The number of records in the chunk.
+    uint64_t num_records = 0;
+    // The total size of records in the chunk.
+    uint64_t decoded_size = 0;
+    // The number of bytes the chunk occupies in the file, including its header
+    // and block headers interrupting it.
+    Position encoded_size = 0;
+
+    // Returns `encoded_size / decoded_size`, or 0 for a chunk of empty
+    // records.
+    double compression_ratio() const {
+      return decoded_size == 0 ? 0.0
+                               : static_cast<double>(encoded_size) /
+                                     static_cast<double>(decoded_size);
+    }
+  };
+
+  // Creates a closed `RecordSizeEstimator`.
+  explicit RecordSizeEstimator(Closed) noexcept : Object(kClosed) {}
+
+  // Will estimate the size of a file written with `writer_options`.
+  explicit RecordSizeEstimator(
+      RecordWriterBase::Options writer_options = RecordWriterBase::Options(),
+      Options options = Options());
+
+  RecordSizeEstimator(RecordSizeEstimator&& that) noexcept = default;
+  RecordSizeEstimator& operator=(RecordSizeEstimator&& that) noexcept =
+      default;
+
+  // Adds the next record.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool AddRecord(const google::protobuf::MessageLite& record);
+  bool AddRecord(absl::string_view record);
+  bool AddRecord(const Chain& record);
+  bool AddRecord(const absl::Cord& record);
+
+  // Returns the number of records added so far.
+  uint64_t num_records() const { return num_records_; }
+
+  // Returns the number of chunks completed so far, including chunks which were
+  // not sampled. After `Close()`, includes the last chunk.
+  uint64_t num_chunks() const { return num_chunks_; }
+
+  // Returns sizes of sampled chunks completed so far.
+  const std::vector<ChunkSize>& sampled_chunks() const {
+    return sampled_chunks_;
+  }
+
+  // Returns `encoded_size / decoded_size` of sampled chunks together, or 1 if
+  // no chunk with records of a positive size was sampled.
+  double compression_ratio() const;
+
+  // Returns the projected size of the file.
+  //
+  // Precondition: `Close()` was called successfully. The estimate includes
+  // the file signature, metadata, and everything written when the file is
+  // closed.
+  Position estimated_file_size() const;
+
+ protected:
+  void Done() override;
+
+ private:
+  // Starts a record of the given size, possibly completing the current chunk.
+  //
+  // Returns `false` on failure.
+  bool StartRecord(size_t size);
+  // Completes the current chunk.
+  bool CloseChunk();
+
+  uint64_t sample_period_ = 1;
+  uint64_t desired_chunk_size_ = 0;
+  RecordWriter<NullWriter> writer_{kClosed};
+  // Invariant: if `is_open()` then `chunk_sampled_ == (num_chunks_ %
+  // sample_period_ == 0)`.
+  bool chunk_sampled_ = true;
+  uint64_t chunk_size_so_far_ = 0;
+  uint64_t chunk_num_records_ = 0;
+  uint64_t chunk_decoded_size_ = 0;
+  // Position of `writer_.dest()` before the current chunk.
+  Position chunk_start_pos_ = 0;
+  uint64_t num_records_ = 0;
+  uint64_t num_chunks_ = 0;
+  std::vector<ChunkSize> sampled_chunks_;
+  uint64_t sampled_decoded_size_ = 0;
+  Position sampled_encoded_size_ = 0;
+  uint64_t unsampled_decoded_size_ = 0;
+  // The size of data written by `writer_` when it was closed.
+  Position final_pos_ = 0;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORD_SIZE_ESTIMATOR_H_
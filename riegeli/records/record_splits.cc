@@ -0,0 +1,61 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/record_splits.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_position.h"
+
+namespace riegeli {
+
+bool SplitRecords(ChunkReader& src, size_t num_splits,
+                  std::vector<RecordRange>& splits) {
+  RIEGELI_ASSERT_GT(num_splits, 0u)
+      << "Failed precondition of SplitRecords(): zero number of splits";
+  splits.clear();
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return false;
+  splits.reserve(num_splits);
+  Position begin = 0;
+  for (size_t index = 1; index < num_splits; ++index) {
+    // `*size * index / num_splits`, avoiding overflow.
+    const Position split = *size / num_splits * index +
+                           *size % num_splits * index / num_splits;
+    Position end = begin;
+    if (split > begin) {
+      // This reads the block header before `split`, and headers of chunks
+      // beginning between that block boundary and `split`.
+      if (ABSL_PREDICT_FALSE(!src.SeekToChunkAfter(split))) {
+        splits.clear();
+        return false;
+      }
+      end = src.pos();
+    }
+    splits.push_back(
+        RecordRange{RecordPosition(begin, 0), RecordPosition(end, 0)});
+    begin = end;
+  }
+  splits.push_back(
+      RecordRange{RecordPosition(begin, 0), RecordPosition(*size, 0)});
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,56 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORD_SPLITS_H_
+#define RIEGELI_RECORDS_RECORD_SPLITS_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_position.h"
+
+namespace riegeli {
+
+// A range of records of a Riegeli/records file, from `begin` inclusive to
+// `end` exclusive.
+struct RecordRange {
+  RecordPosition begin;
+  RecordPosition end;
+};
+
+// Splits the Riegeli/records file read by `src` into `num_splits` ranges of
+// similar sizes, each beginning at a chunk boundary, so that they can be read
+// in parallel. Ranges cover the whole file without overlapping, in order. Some
+// of them can be empty if chunks are large.
+//
+// The file is not scanned: each range begins at the first chunk beginning at
+// or after an evenly spaced position, which is found by
+// `src.SeekToChunkAfter()` from the block header before that position, reading
+// headers of chunks only within that block.
+//
+// `src.pos()` is changed.
+//
+// Precondition: `num_splits > 0`
+//
+// Return values:
+//  * `true`  - success (`splits` is set to `num_splits` ranges)
+//  * `false` - failure (`!src.healthy()`)
+bool SplitRecords(ChunkReader& src, size_t num_splits,
+                  std::vector<RecordRange>& splits);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORD_SPLITS_H_
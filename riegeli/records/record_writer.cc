@@ -17,8 +17,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <deque>
 #include <future>
 #include <limits>
 #include <memory>
@@ -31,33 +32,49 @@
 #include "absl/base/optimization.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "absl/types/variant.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/memory_budget.h"
 #include "riegeli/base/object.h"
 #include "riegeli/base/options_parser.h"
 #include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
+#include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/wrapped_writer.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/chunk_encoder.h"
+#include "riegeli/chunk_encoding/chunk_statistics.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
 #include "riegeli/chunk_encoding/deferred_encoder.h"
 #include "riegeli/chunk_encoding/simple_encoder.h"
 #include "riegeli/chunk_encoding/transpose_encoder.h"
+#include "riegeli/chunk_encoding/tuple_encoder.h"
 #include "riegeli/messages/message_serialize.h"
+#include "riegeli/records/block.h"
+#include "riegeli/records/chunk_index.h"
+#include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/chunk_writer.h"
+#include "riegeli/records/key_index.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/records_metadata.pb.h"
+#include "riegeli/records/records_stats.h"
+#include "riegeli/records/time_index.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -71,6 +88,12 @@ constexpr int RecordWriterBase::Options::kDefaultBrotli;
 constexpr int RecordWriterBase::Options::kMinZstd;
 constexpr int RecordWriterBase::Options::kMaxZstd;
 constexpr int RecordWriterBase::Options::kDefaultZstd;
+constexpr int RecordWriterBase::Options::kMinLz4;
+constexpr int RecordWriterBase::Options::kMaxLz4;
+constexpr int RecordWriterBase::Options::kDefaultLz4;
+constexpr int RecordWriterBase::Options::kMinZlib;
+constexpr int RecordWriterBase::Options::kMaxZlib;
+constexpr int RecordWriterBase::Options::kDefaultZlib;
 constexpr int RecordWriterBase::Options::kMinWindowLog;
 constexpr int RecordWriterBase::Options::kMaxWindowLog;
 #endif
@@ -98,6 +121,30 @@ class FileDescriptorCollector {
   absl::flat_hash_set<std::string> files_seen_;
 };
 
+// Returns the contents of `record`, flattening them to `scratch` if needed.
+inline absl::string_view RecordContents(absl::string_view record,
+                                        std::string& scratch) {
+  return record;
+}
+
+inline absl::string_view RecordContents(const Chain& record,
+                                        std::string& scratch) {
+  if (const absl::optional<absl::string_view> flat = record.TryFlat()) {
+    return *flat;
+  }
+  scratch = std::string(record);
+  return scratch;
+}
+
+inline absl::string_view RecordContents(const absl::Cord& record,
+                                        std::string& scratch) {
+  if (const absl::optional<absl::string_view> flat = record.TryFlat()) {
+    return *flat;
+  }
+  scratch = std::string(record);
+  return scratch;
+}
+
 }  // namespace
 
 void SetRecordType(const google::protobuf::Descriptor& descriptor,
@@ -111,6 +158,12 @@ void SetRecordType(const google::protobuf::Descriptor& descriptor,
 absl::Status RecordWriterBase::Options::FromString(absl::string_view text) {
   std::string compressor_text;
   uint64_t chunk_size;
+  uint64_t target_encoded_chunk_size;
+  int target_chunk_records;
+  int transpose_max_transition;
+  int transpose_min_count_for_state;
+  uint64_t max_pending_bytes;
+  uint64_t block_size;
   OptionsParser options_parser;
   options_parser.AddOption("default", ValueParser::FailIfAnySeen());
   options_parser.AddOption(
@@ -122,7 +175,17 @@ absl::Status RecordWriterBase::Options::FromString(absl::string_view text) {
   options_parser.AddOption("brotli", ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption("zstd", ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption("snappy", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("lz4", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("zlib", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("adaptive", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("min_gain", ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption("window_log", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("long_distance_matching",
+                           ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("zstd_workers",
+                           ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("brotli_recycling",
+                           ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption(
       "chunk_size",
       ValueParser::Or(
@@ -134,15 +197,103 @@ absl::Status RecordWriterBase::Options::FromString(absl::string_view text) {
                 chunk_size_ = chunk_size;
                 return true;
               })));
+  options_parser.AddOption(
+      "target_encoded_chunk_size",
+      ValueParser::And(
+          ValueParser::Bytes(1, std::numeric_limits<uint64_t>::max(),
+                             &target_encoded_chunk_size),
+          [this, &target_encoded_chunk_size](ValueParser& value_parser) {
+            target_encoded_chunk_size_ = target_encoded_chunk_size;
+            return true;
+          }));
+  options_parser.AddOption(
+      "target_chunk_records",
+      ValueParser::And(
+          ValueParser::Int(1, std::numeric_limits<int>::max(),
+                           &target_chunk_records),
+          [this, &target_chunk_records](ValueParser& value_parser) {
+            target_chunk_records_ = IntCast<uint64_t>(target_chunk_records);
+            return true;
+          }));
   options_parser.AddOption("bucket_fraction",
                            ValueParser::Real(0.0, 1.0, &bucket_fraction_));
+  options_parser.AddOption(
+      "parallel_buckets",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &parallel_buckets_));
+  options_parser.AddOption(
+      "delta_encoding",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &delta_encoding_));
+  options_parser.AddOption(
+      "dictionary_encoding",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &dictionary_encoding_));
+  options_parser.AddOption(
+      "transpose_max_transition",
+      ValueParser::And(
+          ValueParser::Int(1, 63, &transpose_max_transition),
+          [this, &transpose_max_transition](ValueParser& value_parser) {
+            transpose_max_transition_ =
+                IntCast<uint32_t>(transpose_max_transition);
+            return true;
+          }));
+  options_parser.AddOption(
+      "transpose_min_count_for_state",
+      ValueParser::Or(
+          ValueParser::Enum({{"auto", absl::nullopt}},
+                            &transpose_min_count_for_state_),
+          ValueParser::And(
+              ValueParser::Int(0, std::numeric_limits<int>::max(),
+                               &transpose_min_count_for_state),
+              [this, &transpose_min_count_for_state](
+                  ValueParser& value_parser) {
+                transpose_min_count_for_state_ =
+                    IntCast<uint32_t>(transpose_min_count_for_state);
+                return true;
+              })));
   options_parser.AddOption(
       "pad_to_block_boundary",
       ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
                         &pad_to_block_boundary_));
+  options_parser.AddOption(
+      "block_size",
+      ValueParser::And(
+          ValueParser::Bytes(internal::kBlockSize, internal::kMaxBlockSize,
+                             &block_size),
+          [this, &block_size](ValueParser& value_parser) {
+            if (ABSL_PREDICT_FALSE(!internal::IsValidBlockSize(block_size))) {
+              return value_parser.InvalidValue("power of 2 in [64K..16M]");
+            }
+            block_size_ = block_size;
+            return true;
+          }));
+  options_parser.AddOption(
+      "chunk_index",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &chunk_index_));
+  options_parser.AddOption(
+      "key_index",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &key_index_));
   options_parser.AddOption(
       "parallelism",
       ValueParser::Int(0, std::numeric_limits<int>::max(), &parallelism_));
+  options_parser.AddOption(
+      "max_pending_bytes",
+      ValueParser::Or(
+          ValueParser::Enum({{"auto", absl::nullopt}}, &max_pending_bytes_),
+          ValueParser::And(
+              ValueParser::Bytes(1, std::numeric_limits<uint64_t>::max(),
+                                 &max_pending_bytes),
+              [this, &max_pending_bytes](ValueParser& value_parser) {
+                max_pending_bytes_ = max_pending_bytes;
+                return true;
+              })));
+  options_parser.AddOption(
+      "pipelined_io",
+      ValueParser::Enum({{"", true}, {"true", true}, {"false", false}},
+                        &pipelined_io_));
   if (ABSL_PREDICT_FALSE(!options_parser.FromString(text))) {
     return options_parser.status();
   }
@@ -167,9 +318,23 @@ class RecordWriterBase::Worker {
   // Precondition: chunk is open.
   template <typename Record>
   bool AddRecord(Record&& record);
+  bool AddRecords(Chain&& records, std::vector<size_t>&& limits);
   bool AddRecord(const google::protobuf::MessageLite& record,
                  SerializeOptions serialize_options);
 
+  // Replaces the current chunk encoder with a `SimpleEncoder` and begins a
+  // record there, returning the `Writer` of its value, or `nullptr` on
+  // failure.
+  //
+  // Precondition: chunk is open and has no records.
+  Writer* BeginStreamingRecord();
+
+  // Finishes the record begun by `BeginStreamingRecord()`, closes its chunk,
+  // and restores the previous chunk encoder as the open chunk.
+  //
+  // Precondition: `BeginStreamingRecord()` succeeded.
+  bool EndStreamingRecord();
+
   // Precondition: chunk is open.
   //
   // If the result is `false` then `!healthy()`.
@@ -177,6 +342,15 @@ class RecordWriterBase::Worker {
 
   bool MaybePadToBlockBoundary();
 
+  // Precondition: chunk is not open.
+  bool MaybeWriteChunkIndex();
+
+  // Writes a chunk read from another Riegeli/records file without decoding
+  // it, or skips it if it pertains to the other file rather than to records.
+  //
+  // Precondition: chunk is not open.
+  bool CopyChunk(Chunk&& chunk);
+
   // Precondition: chunk is not open.
   virtual bool Flush(FlushType flush_type) = 0;
 
@@ -189,6 +363,11 @@ class RecordWriterBase::Worker {
 
   virtual Position EstimatedSize() const = 0;
 
+  // Returns the chunk size tuned for `Options::target_encoded_chunk_size()` and
+  // `Options::target_chunk_records()` from chunks encoded so far, or
+  // `absl::nullopt` if neither is set or no chunk with records was encoded yet.
+  absl::optional<uint64_t> TunedChunkSize() const;
+
  protected:
   void Initialize(Position initial_pos);
 
@@ -199,25 +378,96 @@ class RecordWriterBase::Worker {
 
   virtual bool WriteSignature() = 0;
   virtual bool WriteMetadata() = 0;
+  virtual bool WriteZstdDictionary() = 0;
   virtual bool PadToBlockBoundary() = 0;
+  virtual bool WriteChunkIndex() = 0;
+  // Writes an already encoded chunk.
+  virtual bool WriteChunk(Chunk&& chunk) = 0;
 
   std::unique_ptr<ChunkEncoder> MakeChunkEncoder();
+  std::unique_ptr<ChunkEncoder> MakeChunkEncoder(
+      const CompressorOptions& compressor_options);
   void EncodeSignature(Chunk& chunk);
   bool EncodeMetadata(Chunk& chunk);
-  bool EncodeChunk(ChunkEncoder& chunk_encoder, Chunk& chunk);
+  void EncodeZstdDictionary(Chunk& chunk);
+  // Sets `statistics_chunk` to a column statistics chunk if `chunk_encoder`
+  // computes statistics.
+  bool EncodeChunk(ChunkEncoder& chunk_encoder, Chunk& chunk,
+                   absl::optional<Chunk>& statistics_chunk);
+  void EncodeChunkIndex(Chunk& chunk);
+
+  // Registers a chunk written at `chunk_begin` in `chunk_index_`.
+  void AddToChunkIndex(Position chunk_begin, const ChunkHeader& chunk_header);
+
+  // Verifies that the key of `record` is greater than the previous key, and
+  // registers it in `key_index_` if `record` begins a chunk.
+  //
+  // Precondition: `options_.key_index()`
+  bool AddKey(absl::string_view record, bool begins_chunk);
+
+  // Registers keys and timestamps of `record` in `key_index_` and in
+  // `time_index_` if they are written. `record` begins a chunk if
+  // `begins_chunk`.
+  //
+  // Precondition: `WritesRecordIndex()`
+  bool AddToRecordIndex(absl::string_view record, bool begins_chunk);
+
+  // Returns `true` if `key_index_` or `time_index_` are written, which
+  // requires computing them from serialized records.
+  bool WritesRecordIndex() const {
+    return options_.key_index() || options_.record_timestamp() != nullptr;
+  }
+
+  // Returns `true` if `chunk_index_` is written.
+  bool WritesChunkIndex() const {
+    return options_.chunk_index() || WritesRecordIndex();
+  }
 
   ObjectState state_;
   Options options_;
   // Invariant: `chunk_writer_ != nullptr`
   ChunkWriter* chunk_writer_;
+  // The block size of the file, which `chunk_writer_->block_size()` has or
+  // will have after writing the file signature.
+  Position block_size_;
   // Invariant: if chunk is open then `chunk_encoder_ != nullptr`
   std::unique_ptr<ChunkEncoder> chunk_encoder_;
+  // During `BeginStreamingRecord()` and `EndStreamingRecord()`, the encoder of
+  // the streamed record, owned by `chunk_encoder_`, and the replaced encoder.
+  SimpleEncoder* streaming_encoder_ = nullptr;
+  std::unique_ptr<ChunkEncoder> saved_chunk_encoder_;
+  // If `false`, the chunk index is not written because the file is not written
+  // from the beginning.
+  bool writing_from_beginning_ = false;
+  // Chunks written so far, if `options_.chunk_index()`.
+  //
+  // If `options_.parallelism() > 0`, this is accessed by the chunk writer
+  // thread.
+  ChunkIndex chunk_index_;
+  // First keys of chunks written so far, if `options_.key_index()`.
+  KeyIndex key_index_;
+  // The key of the last record, if `!key_index_.empty()`.
+  std::string last_key_;
+  // Timestamp ranges of chunks written so far, if
+  // `options_.record_timestamp() != nullptr`.
+  TimeIndex time_index_;
+  // Totals over chunks with records encoded so far, for `TunedChunkSize()`.
+  //
+  // If `options_.parallelism() > 0`, these are updated by the encoding
+  // threads.
+  std::atomic<uint64_t> encoded_num_records_{0};
+  std::atomic<uint64_t> encoded_decoded_size_{0};
+  std::atomic<uint64_t> encoded_size_{0};
 };
 
 inline RecordWriterBase::Worker::Worker(ChunkWriter* chunk_writer,
                                         Options&& options)
     : options_(std::move(options)),
       chunk_writer_(RIEGELI_ASSERT_NOTNULL(chunk_writer)),
+      // A file written from the beginning gets the block size from
+      // `EncodeSignature()`.
+      block_size_(chunk_writer_->pos() == 0 ? options_.block_size()
+                                            : chunk_writer_->block_size()),
       chunk_encoder_(MakeChunkEncoder()) {
   if (ABSL_PREDICT_FALSE(!chunk_writer_->healthy())) {
     // `FailWithoutAnnotation()` is pure virtual and must not be called from the
@@ -231,6 +481,7 @@ RecordWriterBase::Worker::~Worker() {}
 bool RecordWriterBase::Worker::Close() {
   if (ABSL_PREDICT_FALSE(!state_.is_open())) return state_.not_failed();
   Done();
+  if (options_.stats() != nullptr) options_.stats()->Report();
   return state_.MarkClosed();
 }
 
@@ -239,9 +490,14 @@ inline bool RecordWriterBase::Worker::Fail(absl::Status status) {
 }
 
 inline void RecordWriterBase::Worker::Initialize(Position initial_pos) {
+  writing_from_beginning_ = initial_pos == 0;
   if (initial_pos == 0) {
     if (ABSL_PREDICT_FALSE(!WriteSignature())) return;
     if (ABSL_PREDICT_FALSE(!WriteMetadata())) return;
+    if (options_.compressor_options().stored_compression_type() ==
+        CompressionType::kZstdWithDictionary) {
+      if (ABSL_PREDICT_FALSE(!WriteZstdDictionary())) return;
+    }
   } else {
     MaybePadToBlockBoundary();
   }
@@ -255,10 +511,81 @@ inline bool RecordWriterBase::Worker::MaybePadToBlockBoundary() {
   }
 }
 
+inline bool RecordWriterBase::Worker::MaybeWriteChunkIndex() {
+  if (WritesChunkIndex() && writing_from_beginning_) {
+    if (options_.record_timestamp() != nullptr) {
+      // The time index chunk precedes the key index chunk if any, otherwise
+      // the chunk index chunk.
+      Chunk chunk;
+      time_index_.Encode(chunk);
+      if (ABSL_PREDICT_FALSE(!WriteChunk(std::move(chunk)))) return false;
+    }
+    if (options_.key_index()) {
+      // The key index chunk immediately precedes the chunk index chunk.
+      Chunk chunk;
+      key_index_.Encode(chunk);
+      if (ABSL_PREDICT_FALSE(!WriteChunk(std::move(chunk)))) return false;
+    }
+    return WriteChunkIndex();
+  } else {
+    return true;
+  }
+}
+
+bool RecordWriterBase::Worker::CopyChunk(Chunk&& chunk) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  switch (chunk.header.chunk_type()) {
+    case ChunkType::kFileSignature:
+    case ChunkType::kFileMetadata:
+    case ChunkType::kPadding:
+    case ChunkType::kChunkIndex:
+    case ChunkType::kKeyIndex:
+    case ChunkType::kTimeIndex:
+      // The destination file has its own chunks of these types, written
+      // according to `options_`.
+      return true;
+    case ChunkType::kZstdDictionary:
+      // Chunks which follow can be decoded only with this dictionary, and
+      // `RecordReader` uses the first dictionary of a file.
+      if (ABSL_PREDICT_FALSE(
+              options_.compressor_options().stored_compression_type() !=
+                  CompressionType::kZstdWithDictionary ||
+              chunk.data !=
+                  options_.compressor_options().zstd_dictionary().data())) {
+        return Fail(absl::UnimplementedError(
+            "Copying chunks compressed with a Zstd dictionary requires "
+            "writing with the same dictionary"));
+      }
+      return true;
+    default:
+      if (ABSL_PREDICT_FALSE(WritesRecordIndex() &&
+                             chunk.header.num_records() > 0)) {
+        return Fail(absl::UnimplementedError(
+            "Copying chunks with records is not supported with a key index "
+            "or a time index"));
+      }
+      if (options_.stats() != nullptr && chunk.header.num_records() > 0) {
+        options_.stats()->AddChunk(
+            chunk.header.num_records(),
+            ChunkHeader::size() + chunk.header.data_size(),
+            chunk.header.decoded_data_size());
+      }
+      return WriteChunk(std::move(chunk));
+  }
+}
+
 inline std::unique_ptr<ChunkEncoder>
 RecordWriterBase::Worker::MakeChunkEncoder() {
+  return MakeChunkEncoder(options_.compressor_options());
+}
+
+inline std::unique_ptr<ChunkEncoder> RecordWriterBase::Worker::MakeChunkEncoder(
+    const CompressorOptions& compressor_options) {
   std::unique_ptr<ChunkEncoder> chunk_encoder;
-  if (options_.transpose()) {
+  if (options_.tuple_layout() != absl::nullopt) {
+    chunk_encoder = std::make_unique<TupleEncoder>(compressor_options,
+                                                   *options_.tuple_layout());
+  } else if (options_.transpose()) {
     const long double long_double_bucket_size =
         std::round(static_cast<long double>(options_.effective_chunk_size()) *
                    static_cast<long double>(options_.bucket_fraction()));
@@ -270,26 +597,41 @@ RecordWriterBase::Worker::MakeChunkEncoder() {
         : ABSL_PREDICT_TRUE(long_double_bucket_size >= 1.0L)
             ? static_cast<uint64_t>(long_double_bucket_size)
             : uint64_t{1};
+    Executor* executor = nullptr;
+    if (options_.parallel_buckets()) {
+      executor = options_.executor();
+      if (executor == nullptr) executor = &internal::ThreadPool::global();
+    }
     chunk_encoder = std::make_unique<TransposeEncoder>(
-        options_.compressor_options(), bucket_size);
+        compressor_options, bucket_size, executor,
+        options_.column_statistics(), options_.bloom_filter_columns(),
+        options_.transpose_descriptor(), options_.delta_encoding(),
+        options_.dictionary_encoding(), options_.transpose_max_transition(),
+        options_.transpose_min_count_for_state());
   } else {
     chunk_encoder = std::make_unique<SimpleEncoder>(
-        options_.compressor_options(), options_.effective_chunk_size());
+        compressor_options, options_.effective_chunk_size());
   }
-  if (options_.parallelism() == 0) {
+  if (options_.parallelism() == 0 && options_.reorder_key() == nullptr) {
     return chunk_encoder;
   } else {
-    return std::make_unique<DeferredEncoder>(std::move(chunk_encoder));
+    return std::make_unique<DeferredEncoder>(std::move(chunk_encoder),
+                                             options_.effective_chunk_size(),
+                                             options_.reorder_key());
   }
 }
 
 inline void RecordWriterBase::Worker::EncodeSignature(Chunk& chunk) {
-  chunk.header = ChunkHeader(chunk.data, ChunkType::kFileSignature, 0, 0);
+  chunk.header = internal::FileSignatureHeader(options_.block_size());
 }
 
 inline bool RecordWriterBase::Worker::EncodeMetadata(Chunk& chunk) {
-  TransposeEncoder transpose_encoder(options_.compressor_options(),
-                                     std::numeric_limits<uint64_t>::max());
+  // Metadata are written before the Zstd dictionary and must be readable
+  // without it.
+  TransposeEncoder transpose_encoder(
+      CompressorOptions(options_.compressor_options())
+          .set_zstd_dictionary(ZstdDictionary()),
+      std::numeric_limits<uint64_t>::max());
   if (ABSL_PREDICT_FALSE(
           options_.metadata() != absl::nullopt
               ? !transpose_encoder.AddRecord(*options_.metadata())
@@ -313,9 +655,25 @@ inline bool RecordWriterBase::Worker::EncodeMetadata(Chunk& chunk) {
   return true;
 }
 
+inline void RecordWriterBase::Worker::EncodeZstdDictionary(Chunk& chunk) {
+  const absl::string_view dictionary =
+      options_.compressor_options().zstd_dictionary().data();
+  chunk.data.Append(dictionary);
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kZstdDictionary, 0,
+                             IntCast<uint64_t>(dictionary.size()));
+}
+
 template <typename Record>
 inline bool RecordWriterBase::Worker::AddRecord(Record&& record) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (WritesRecordIndex()) {
+    std::string scratch;
+    if (ABSL_PREDICT_FALSE(
+            !AddToRecordIndex(RecordContents(record, scratch),
+                              chunk_encoder_->num_records() == 0))) {
+      return false;
+    }
+  }
   if (ABSL_PREDICT_FALSE(
           !chunk_encoder_->AddRecord(std::forward<Record>(record)))) {
     return Fail(chunk_encoder_->status());
@@ -323,10 +681,47 @@ inline bool RecordWriterBase::Worker::AddRecord(Record&& record) {
   return true;
 }
 
+inline bool RecordWriterBase::Worker::AddRecords(
+    Chain&& records, std::vector<size_t>&& limits) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (WritesRecordIndex()) {
+    ChainReader<> records_reader(&records);
+    size_t start = 0;
+    for (size_t i = 0; i < limits.size(); ++i) {
+      absl::string_view record;
+      if (!records_reader.Read(limits[i] - start, record)) {
+        RIEGELI_ASSERT_UNREACHABLE()
+            << "Failed reading record from ChainReader: "
+            << records_reader.status();
+      }
+      if (ABSL_PREDICT_FALSE(!AddToRecordIndex(
+              record, i == 0 && chunk_encoder_->num_records() == 0))) {
+        return false;
+      }
+      start = limits[i];
+    }
+  }
+  if (ABSL_PREDICT_FALSE(
+          !chunk_encoder_->AddRecords(std::move(records), std::move(limits)))) {
+    return Fail(chunk_encoder_->status());
+  }
+  return true;
+}
+
 inline bool RecordWriterBase::Worker::AddRecord(
     const google::protobuf::MessageLite& record,
     SerializeOptions serialize_options) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (WritesRecordIndex()) {
+    // The key and the timestamp are computed from the serialized record.
+    Chain serialized;
+    {
+      const absl::Status status =
+          SerializeToChain(record, serialized, std::move(serialize_options));
+      if (ABSL_PREDICT_FALSE(!status.ok())) return Fail(status);
+    }
+    return AddRecord(std::move(serialized));
+  }
   if (ABSL_PREDICT_FALSE(
           !chunk_encoder_->AddRecord(record, std::move(serialize_options)))) {
     return Fail(chunk_encoder_->status());
@@ -334,22 +729,158 @@ inline bool RecordWriterBase::Worker::AddRecord(
   return true;
 }
 
-inline bool RecordWriterBase::Worker::EncodeChunk(ChunkEncoder& chunk_encoder,
-                                                  Chunk& chunk) {
+Writer* RecordWriterBase::Worker::BeginStreamingRecord() {
+  RIEGELI_ASSERT_EQ(chunk_encoder_->num_records(), 0u)
+      << "Failed precondition of "
+         "RecordWriterBase::Worker::BeginStreamingRecord(): "
+         "chunk has records";
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  if (ABSL_PREDICT_FALSE(WritesRecordIndex())) {
+    Fail(absl::UnimplementedError(
+        "Streaming records is not supported with a key index "
+        "or a time index"));
+    return nullptr;
+  }
+  std::unique_ptr<SimpleEncoder> encoder =
+      std::make_unique<SimpleEncoder>(options_.compressor_options(), 0);
+  Writer* const writer = encoder->BeginRecord();
+  if (ABSL_PREDICT_FALSE(writer == nullptr)) {
+    Fail(encoder->status());
+    return nullptr;
+  }
+  streaming_encoder_ = encoder.get();
+  saved_chunk_encoder_ = std::exchange(chunk_encoder_, std::move(encoder));
+  return writer;
+}
+
+bool RecordWriterBase::Worker::EndStreamingRecord() {
+  RIEGELI_ASSERT(streaming_encoder_ != nullptr)
+      << "Failed precondition of "
+         "RecordWriterBase::Worker::EndStreamingRecord(): "
+         "no streaming record";
+  SimpleEncoder& encoder = *std::exchange(streaming_encoder_, nullptr);
+  if (ABSL_PREDICT_FALSE(!encoder.EndRecord())) return Fail(encoder.status());
+  const bool ok = CloseChunk();
+  // `CloseChunk()` took the encoder if it encodes in background, otherwise the
+  // chunk is encoded and the encoder is no longer needed.
+  chunk_encoder_ = std::move(saved_chunk_encoder_);
+  return ok;
+}
+
+inline bool RecordWriterBase::Worker::EncodeChunk(
+    ChunkEncoder& chunk_encoder, Chunk& chunk,
+    absl::optional<Chunk>& statistics_chunk) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   ChunkType chunk_type;
   uint64_t num_records;
   uint64_t decoded_data_size;
-  ChainWriter<> data_writer(&chunk.data);
-  if (ABSL_PREDICT_FALSE(!chunk_encoder.EncodeAndClose(
-          data_writer, chunk_type, num_records, decoded_data_size))) {
-    return Fail(chunk_encoder.status());
+  {
+    internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kEncode);
+    ChainWriter<> data_writer(&chunk.data);
+    if (ABSL_PREDICT_FALSE(!chunk_encoder.EncodeAndClose(
+            data_writer, chunk_type, num_records, decoded_data_size))) {
+      return Fail(chunk_encoder.status());
+    }
+    if (ABSL_PREDICT_FALSE(!data_writer.Close())) {
+      return Fail(data_writer.status());
+    }
+    timer.set_chunk_size(ChunkHeader::size() + chunk.data.size());
   }
-  if (ABSL_PREDICT_FALSE(!data_writer.Close())) {
-    return Fail(data_writer.status());
+  {
+    internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kHash,
+                               absl::nullopt,
+                               ChunkHeader::size() + chunk.data.size());
+    chunk.header =
+        ChunkHeader(chunk.data, chunk_type, num_records, decoded_data_size);
+  }
+  if (options_.stats() != nullptr) {
+    options_.stats()->AddChunk(
+        num_records, ChunkHeader::size() + chunk.header.data_size(),
+        decoded_data_size);
+  }
+  if ((options_.target_encoded_chunk_size() != absl::nullopt ||
+       options_.target_chunk_records() != absl::nullopt) &&
+      num_records > 0) {
+    encoded_size_.fetch_add(ChunkHeader::size() + chunk.header.data_size(),
+                            std::memory_order_relaxed);
+    encoded_decoded_size_.fetch_add(decoded_data_size,
+                                    std::memory_order_relaxed);
+    encoded_num_records_.fetch_add(num_records, std::memory_order_relaxed);
+  }
+  if (const ChunkStatistics* const statistics = chunk_encoder.statistics()) {
+    statistics_chunk.emplace();
+    statistics->Encode(*statistics_chunk);
+  }
+  return true;
+}
+
+inline void RecordWriterBase::Worker::EncodeChunkIndex(Chunk& chunk) {
+  chunk_index_.Encode(chunk_writer_->pos(), chunk);
+}
+
+inline void RecordWriterBase::Worker::AddToChunkIndex(
+    Position chunk_begin, const ChunkHeader& chunk_header) {
+  if (WritesChunkIndex() && chunk_header.num_records() > 0) {
+    chunk_index_.Add(chunk_begin, chunk_header.num_records());
+  }
+}
+
+absl::optional<uint64_t> RecordWriterBase::Worker::TunedChunkSize() const {
+  const uint64_t num_records =
+      encoded_num_records_.load(std::memory_order_relaxed);
+  if (num_records == 0) return absl::nullopt;
+  // Measure chunks in units of `AddedChunkSize()`, which is what
+  // `desired_chunk_size_` is compared against.
+  const uint64_t decoded_size =
+      encoded_decoded_size_.load(std::memory_order_relaxed);
+  const double added_size = static_cast<double>(decoded_size) +
+                            static_cast<double>(num_records) * sizeof(uint64_t);
+  const uint64_t max_chunk_size = UnsignedMin(
+      options_.chunk_size().value_or(std::numeric_limits<uint64_t>::max()),
+      kMaxNumRecords * sizeof(uint64_t));
+  double tuned_chunk_size = static_cast<double>(max_chunk_size);
+  if (options_.target_encoded_chunk_size() != absl::nullopt) {
+    const uint64_t encoded_size = encoded_size_.load(std::memory_order_relaxed);
+    if (encoded_size > 0) {
+      tuned_chunk_size = std::min(
+          tuned_chunk_size,
+          static_cast<double>(*options_.target_encoded_chunk_size()) *
+              added_size / static_cast<double>(encoded_size));
+    }
+  }
+  if (options_.target_chunk_records() != absl::nullopt) {
+    tuned_chunk_size =
+        std::min(tuned_chunk_size,
+                 static_cast<double>(*options_.target_chunk_records()) *
+                     added_size / static_cast<double>(num_records));
+  }
+  if (tuned_chunk_size >= static_cast<double>(max_chunk_size)) {
+    return max_chunk_size;
+  }
+  return UnsignedMax(static_cast<uint64_t>(tuned_chunk_size), uint64_t{1});
+}
+
+inline bool RecordWriterBase::Worker::AddKey(absl::string_view record,
+                                             bool begins_chunk) {
+  const absl::string_view key = RecordKey(options_.record_key(), record);
+  if (ABSL_PREDICT_FALSE(!key_index_.empty() &&
+                         key <= absl::string_view(last_key_))) {
+    return Fail(absl::InvalidArgumentError(
+        "Record keys are not strictly increasing"));
+  }
+  if (begins_chunk) key_index_.Add(key);
+  last_key_.assign(key.data(), key.size());
+  return true;
+}
+
+inline bool RecordWriterBase::Worker::AddToRecordIndex(
+    absl::string_view record, bool begins_chunk) {
+  if (options_.key_index()) {
+    if (ABSL_PREDICT_FALSE(!AddKey(record, begins_chunk))) return false;
+  }
+  if (options_.record_timestamp() != nullptr) {
+    time_index_.AddRecord(options_.record_timestamp()(record), begins_chunk);
   }
-  chunk.header =
-      ChunkHeader(chunk.data, chunk_type, num_records, decoded_data_size);
   return true;
 }
 
@@ -357,6 +888,8 @@ class RecordWriterBase::SerialWorker : public Worker {
  public:
   explicit SerialWorker(ChunkWriter* chunk_writer, Options&& options);
 
+  ~SerialWorker();
+
   absl::Status status() const override;
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatus(absl::Status status) override;
 
@@ -369,12 +902,35 @@ class RecordWriterBase::SerialWorker : public Worker {
   Position EstimatedSize() const override;
 
  protected:
+  void Done() override;
   bool healthy() const override;
   ABSL_ATTRIBUTE_COLD bool FailWithoutAnnotation(absl::Status status) override;
 
   bool WriteSignature() override;
   bool WriteMetadata() override;
+  bool WriteZstdDictionary() override;
   bool PadToBlockBoundary() override;
+  bool WriteChunkIndex() override;
+  bool WriteChunk(Chunk&& chunk) override;
+
+ private:
+  // Returns the position of `chunk_writer_` after the pending write if any.
+  Position ChunkWriterPos() const;
+
+  // Waits for `pending_write_` if any, failing `*this` if it failed.
+  //
+  // Return values:
+  //  * `true`  - success (`chunk_writer_` may be used)
+  //  * `false` - failure (`!healthy()`)
+  bool WaitForPendingWrite();
+
+  // If `options_.pipelined_io()`, the result of writing the last encoded
+  // chunk, which may still be in progress in background. `chunk_writer_` must
+  // not be used until it is ready.
+  std::future<bool> pending_write_;
+  // If `pending_write_.valid()`, the position of `chunk_writer_` after the
+  // pending write.
+  Position pending_pos_ = 0;
 };
 
 inline RecordWriterBase::SerialWorker::SerialWorker(ChunkWriter* chunk_writer,
@@ -383,6 +939,25 @@ inline RecordWriterBase::SerialWorker::SerialWorker(ChunkWriter* chunk_writer,
   Initialize(chunk_writer_->pos());
 }
 
+RecordWriterBase::SerialWorker::~SerialWorker() {
+  // The pending write refers to `*this`.
+  if (pending_write_.valid()) pending_write_.wait();
+}
+
+void RecordWriterBase::SerialWorker::Done() { WaitForPendingWrite(); }
+
+inline Position RecordWriterBase::SerialWorker::ChunkWriterPos() const {
+  return pending_write_.valid() ? pending_pos_ : chunk_writer_->pos();
+}
+
+inline bool RecordWriterBase::SerialWorker::WaitForPendingWrite() {
+  if (pending_write_.valid() &&
+      ABSL_PREDICT_FALSE(!std::exchange(pending_write_, {}).get())) {
+    return FailWithoutAnnotation(chunk_writer_->status());
+  }
+  return healthy();
+}
+
 inline bool RecordWriterBase::SerialWorker::healthy() const {
   return state_.healthy();
 }
@@ -398,6 +973,7 @@ bool RecordWriterBase::SerialWorker::FailWithoutAnnotation(
 
 absl::Status RecordWriterBase::SerialWorker::AnnotateStatus(
     absl::Status status) {
+  if (pending_write_.valid()) pending_write_.wait();
   return chunk_writer_->AnnotateStatus(std::move(status));
 }
 
@@ -425,28 +1001,106 @@ bool RecordWriterBase::SerialWorker::WriteMetadata() {
   return true;
 }
 
+bool RecordWriterBase::SerialWorker::WriteZstdDictionary() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Chunk chunk;
+  EncodeZstdDictionary(chunk);
+  if (ABSL_PREDICT_FALSE(!chunk_writer_->WriteChunk(chunk))) {
+    return FailWithoutAnnotation(chunk_writer_->status());
+  }
+  return true;
+}
+
 bool RecordWriterBase::SerialWorker::CloseChunk() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Chunk chunk;
-  if (ABSL_PREDICT_FALSE(!EncodeChunk(*chunk_encoder_, chunk))) {
+  absl::optional<Chunk> statistics_chunk;
+  if (ABSL_PREDICT_FALSE(
+          !EncodeChunk(*chunk_encoder_, chunk, statistics_chunk))) {
     return false;
   }
+  if (options_.pipelined_io()) {
+    // Encoding the chunk overlapped with the pending write of the previous
+    // chunk. Wait for it, then write this chunk in background.
+    if (ABSL_PREDICT_FALSE(!WaitForPendingWrite())) return false;
+    const Position chunk_begin = chunk_writer_->pos();
+    // Matches `DefaultChunkWriterBase::WriteChunk()`.
+    pending_pos_ = internal::ChunkEnd(chunk.header, chunk_begin, block_size_);
+    if (statistics_chunk != absl::nullopt) {
+      pending_pos_ = internal::ChunkEnd(statistics_chunk->header, pending_pos_,
+                                        block_size_);
+    }
+    AddToChunkIndex(chunk_begin, chunk.header);
+    // `std::function` requires a copyable callable.
+    std::shared_ptr<std::promise<bool>> promise =
+        std::make_shared<std::promise<bool>>();
+    pending_write_ = promise->get_future();
+    internal::ThreadPool::global().ScheduleBlocking(
+        [this, promise = std::move(promise), chunk_begin,
+         chunk = std::make_shared<Chunk>(std::move(chunk)),
+         statistics_chunk = std::make_shared<absl::optional<Chunk>>(
+             std::move(statistics_chunk))] {
+          internal::StageTimer timer(
+              options_.stats(), RecordsStats::Stage::kIo, chunk_begin,
+              ChunkHeader::size() + chunk->header.data_size());
+          promise->set_value(chunk_writer_->WriteChunk(*chunk) &&
+                             (*statistics_chunk == absl::nullopt ||
+                              chunk_writer_->WriteChunk(**statistics_chunk)));
+        });
+    return true;
+  }
+  const Position chunk_begin = chunk_writer_->pos();
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kIo,
+                             chunk_begin,
+                             ChunkHeader::size() + chunk.header.data_size());
   if (ABSL_PREDICT_FALSE(!chunk_writer_->WriteChunk(chunk))) {
     return FailWithoutAnnotation(chunk_writer_->status());
   }
+  AddToChunkIndex(chunk_begin, chunk.header);
+  if (statistics_chunk != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(!chunk_writer_->WriteChunk(*statistics_chunk))) {
+      return FailWithoutAnnotation(chunk_writer_->status());
+    }
+  }
   return true;
 }
 
 bool RecordWriterBase::SerialWorker::PadToBlockBoundary() {
-  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!WaitForPendingWrite())) return false;
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kPad);
   if (ABSL_PREDICT_FALSE(!chunk_writer_->PadToBlockBoundary())) {
     return FailWithoutAnnotation(chunk_writer_->status());
   }
   return true;
 }
 
+bool RecordWriterBase::SerialWorker::WriteChunkIndex() {
+  if (ABSL_PREDICT_FALSE(!WaitForPendingWrite())) return false;
+  Chunk chunk;
+  EncodeChunkIndex(chunk);
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kIo);
+  if (ABSL_PREDICT_FALSE(!chunk_writer_->WriteChunk(chunk))) {
+    return FailWithoutAnnotation(chunk_writer_->status());
+  }
+  return true;
+}
+
+bool RecordWriterBase::SerialWorker::WriteChunk(Chunk&& chunk) {
+  if (ABSL_PREDICT_FALSE(!WaitForPendingWrite())) return false;
+  const Position chunk_begin = chunk_writer_->pos();
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kIo,
+                             chunk_begin,
+                             ChunkHeader::size() + chunk.header.data_size());
+  if (ABSL_PREDICT_FALSE(!chunk_writer_->WriteChunk(chunk))) {
+    return FailWithoutAnnotation(chunk_writer_->status());
+  }
+  AddToChunkIndex(chunk_begin, chunk.header);
+  return true;
+}
+
 bool RecordWriterBase::SerialWorker::Flush(FlushType flush_type) {
-  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(!WaitForPendingWrite())) return false;
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kIo);
   if (ABSL_PREDICT_FALSE(!chunk_writer_->Flush(flush_type))) {
     return FailWithoutAnnotation(chunk_writer_->status());
   }
@@ -464,16 +1118,15 @@ FutureRecordPosition RecordWriterBase::SerialWorker::LastPos() const {
   RIEGELI_ASSERT_GT(chunk_encoder_->num_records(), 0u)
       << "Failed invariant of RecordWriterBase::SerialWorker: "
          "last position should be valid but no record was encoded";
-  return RecordPosition(chunk_writer_->pos(),
-                        chunk_encoder_->num_records() - 1);
+  return RecordPosition(ChunkWriterPos(), chunk_encoder_->num_records() - 1);
 }
 
 FutureRecordPosition RecordWriterBase::SerialWorker::Pos() const {
-  return RecordPosition(chunk_writer_->pos(), chunk_encoder_->num_records());
+  return RecordPosition(ChunkWriterPos(), chunk_encoder_->num_records());
 }
 
 Position RecordWriterBase::SerialWorker::EstimatedSize() const {
-  return chunk_writer_->pos();
+  return ChunkWriterPos();
 }
 
 // `ParallelWorker` uses parallelism internally, but the class is still only
@@ -487,7 +1140,7 @@ class RecordWriterBase::ParallelWorker : public Worker {
   absl::Status status() const override;
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatus(absl::Status status) override;
 
-  void OpenChunk() override { chunk_encoder_ = MakeChunkEncoder(); }
+  void OpenChunk() override;
   bool CloseChunk() override;
   bool Flush(FlushType flush_type) override;
   std::future<bool> FutureFlush(FlushType flush_type) override;
@@ -502,7 +1155,10 @@ class RecordWriterBase::ParallelWorker : public Worker {
 
   bool WriteSignature() override;
   bool WriteMetadata() override;
+  bool WriteZstdDictionary() override;
   bool PadToBlockBoundary() override;
+  bool WriteChunkIndex() override;
+  bool WriteChunk(Chunk&& chunk) override;
 
  private:
   struct ChunkPromises {
@@ -521,31 +1177,134 @@ class RecordWriterBase::ParallelWorker : public Worker {
   struct WriteChunkRequest {
     std::shared_future<ChunkHeader> chunk_header;
     std::future<Chunk> chunk;
+    // The size of the chunk before encoding, counted in `pending_bytes_`.
+    uint64_t pending_bytes = 0;
   };
   struct PadToBlockBoundaryRequest {};
+  struct WriteChunkIndexRequest {
+    std::promise<ChunkHeader> chunk_header_promise;
+    std::shared_future<ChunkHeader> chunk_header;
+  };
   struct FlushRequest {
     FlushType flush_type;
     std::promise<bool> done;
   };
+  // `absl::monostate` marks a slot of `requests_` without a request.
   using ChunkWriterRequest =
-      absl::variant<DoneRequest, AnnotateStatusRequest, WriteChunkRequest,
-                    PadToBlockBoundaryRequest, FlushRequest>;
+      absl::variant<absl::monostate, DoneRequest, AnnotateStatusRequest,
+                    WriteChunkRequest, PadToBlockBoundaryRequest,
+                    WriteChunkIndexRequest, FlushRequest>;
 
-  bool HasCapacityForRequest() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // The minimal size of `requests_`.
+  static constexpr size_t kMinRequestsSize = 64;
+
+  // Returns the `Executor` for encoding chunks.
+  Executor& executor() const;
+
+  // Parameters of `HasCapacityForChunk()` for `absl::Condition`.
+  struct ChunkCapacityQuery {
+    const ParallelWorker* self;
+    uint64_t pending_bytes;
+    size_t num_requests;
+  };
+
+  // Returns `true` if a request fits in `requests_`.
+  bool HasFreeSlot() const;
+  // Returns `true` if a request can be added to `requests_` without exceeding
+  // `Options::parallelism()` or, if set, `Options::max_pending_bytes()`.
+  bool HasCapacityForRequest() const;
+  // Like `HasCapacityForRequest()`, but for a `WriteChunkRequest` with the
+  // given `pending_bytes`, followed by other requests, `num_requests` in
+  // total.
+  bool HasCapacityForChunk(uint64_t pending_bytes, size_t num_requests) const;
+  // Returns `true` if `GlobalMemoryBudget()` is installed and exceeded. Then
+  // only one request is accepted at a time.
+  static bool MemoryBudgetExceeded();
+  // Waits until `HasCapacityForRequest()`.
+  void WaitForCapacityForRequest();
+  // Waits until `HasCapacityForChunk(pending_bytes, num_requests)`.
+  void WaitForCapacityForChunk(uint64_t pending_bytes,
+                               size_t num_requests = 1);
+  // Blocks the calling thread until `condition` holds. `condition` must depend
+  // only on state changed by the chunk writer thread when it finishes a
+  // request.
+  void WaitForChunkWriter(const absl::Condition& condition);
+  // Adds `request` to `requests_`.
+  //
+  // Precondition: `HasFreeSlot()`
+  void PushRequest(ChunkWriterRequest&& request);
+  // Wakes up the chunk writer thread if it waits for requests.
+  void NotifyChunkWriter();
+  // If `CompressorOptions::adaptive_min_level()` is set, lowers or raises the
+  // compression level of `adapted_compressor_options_` by one step depending
+  // on how full the backlog of requests is.
+  void AdaptCompressionLevel();
   internal::FutureChunkBegin ChunkBegin() const;
 
+  // Compressor options for the next chunk, with the compression level adapted
+  // to the backlog.
+  CompressorOptions adapted_compressor_options_;
+
+  // Requests to the chunk writer thread are kept in a ring buffer, indexed by
+  // consecutive request numbers modulo its size, which is a power of 2.
+  //
+  // Requests in `[head_, tail_)` are pending. Only the thread calling `Worker`
+  // functions (which `RecordWriterBase` serializes) adds requests and changes
+  // `tail_`; only the chunk writer thread handles requests and changes
+  // `head_`. This does not need locking in the common case. A slot is reused,
+  // and its old request is destroyed, only when a request is added there, so
+  // that `ChunkBegin()` can look at requests which were just handled.
+  //
+  // `mutex_` is used only to block when the ring buffer is empty or full, and
+  // to guard `state_`. A thread about to block sets `chunk_writer_waiting_` or
+  // `producer_waiting_`, and the other thread locks and unlocks `mutex_` after
+  // changing `tail_` or `head_` only if the flag is set, which makes the
+  // waiting thread reevaluate its condition.
+  std::unique_ptr<ChunkWriterRequest[]> requests_;
+  size_t requests_mask_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  // Position before handling requests from `head_`.
+  std::atomic<Position> pos_before_chunks_;
+  // Odd while the chunk writer thread changes `head_` together with
+  // `pos_before_chunks_`. Incremented by 2 by each change, so that they can be
+  // read consistently by `ChunkBegin()`.
+  std::atomic<uint64_t> head_sequence_{0};
+  // Sum of `WriteChunkRequest::pending_bytes` in pending requests.
+  std::atomic<uint64_t> pending_bytes_{0};
+  std::atomic<bool> chunk_writer_waiting_{false};
+  std::atomic<bool> producer_waiting_{false};
   mutable absl::Mutex mutex_;
-  std::deque<ChunkWriterRequest> chunk_writer_requests_ ABSL_GUARDED_BY(mutex_);
-  // Position before handling `chunk_writer_requests_`.
-  Position pos_before_chunks_ ABSL_GUARDED_BY(mutex_);
 };
 
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t RecordWriterBase::ParallelWorker::kMinRequestsSize;
+#endif
+
 inline RecordWriterBase::ParallelWorker::ParallelWorker(
     ChunkWriter* chunk_writer, Options&& options)
     : Worker(chunk_writer, std::move(options)),
+      adapted_compressor_options_(options_.compressor_options()),
       pos_before_chunks_(chunk_writer_->pos()) {
-  internal::ThreadPool::global().Schedule([this] {
+  // `CloseChunk()` can add a chunk and its statistics when
+  // `Options::parallelism()` requests are pending, and then `Done()` adds one
+  // more request. With `Options::max_pending_bytes()`, the size of `requests_`
+  // also limits the number of pending requests.
+  const size_t requests_size = absl::bit_ceil(UnsignedMax(
+      kMinRequestsSize, IntCast<size_t>(options_.parallelism()) + 2));
+  requests_.reset(new ChunkWriterRequest[requests_size]);
+  requests_mask_ = requests_size - 1;
+  internal::ThreadPool::global().ScheduleBlocking([this] {
     struct Visitor {
+      bool operator()(absl::monostate&) const {
+        RIEGELI_ASSERT_UNREACHABLE()
+            << "Failed invariant of RecordWriterBase::ParallelWorker: "
+               "pending request missing";
+      }
+
       bool operator()(DoneRequest& request) const {
         request.done.set_value();
         return false;
@@ -563,25 +1322,50 @@ inline RecordWriterBase::ParallelWorker::ParallelWorker(
         // responds to `DoneRequest`.
         const Chunk chunk = request.chunk.get();
         if (ABSL_PREDICT_FALSE(!self->healthy())) return true;
+        const Position chunk_begin = self->chunk_writer_->pos();
+        internal::StageTimer timer(
+            self->options_.stats(), RecordsStats::Stage::kIo, chunk_begin,
+            ChunkHeader::size() + chunk.header.data_size());
         if (ABSL_PREDICT_FALSE(!self->chunk_writer_->WriteChunk(chunk))) {
           self->FailWithoutAnnotation(self->chunk_writer_->status());
+          return true;
         }
+        self->AddToChunkIndex(chunk_begin, chunk.header);
         return true;
       }
 
       bool operator()(PadToBlockBoundaryRequest& request) const {
         if (ABSL_PREDICT_FALSE(!self->healthy())) return true;
+        internal::StageTimer timer(self->options_.stats(),
+                                   RecordsStats::Stage::kPad);
         if (ABSL_PREDICT_FALSE(!self->chunk_writer_->PadToBlockBoundary())) {
           self->FailWithoutAnnotation(self->chunk_writer_->status());
         }
         return true;
       }
 
+      bool operator()(WriteChunkIndexRequest& request) const {
+        // The chunk header must be provided even if `!healthy()`, because
+        // `ChunkBegin()` can wait for it.
+        Chunk chunk;
+        self->EncodeChunkIndex(chunk);
+        request.chunk_header_promise.set_value(chunk.header);
+        if (ABSL_PREDICT_FALSE(!self->healthy())) return true;
+        internal::StageTimer timer(self->options_.stats(),
+                                   RecordsStats::Stage::kIo);
+        if (ABSL_PREDICT_FALSE(!self->chunk_writer_->WriteChunk(chunk))) {
+          self->FailWithoutAnnotation(self->chunk_writer_->status());
+        }
+        return true;
+      }
+
       bool operator()(FlushRequest& request) const {
         if (ABSL_PREDICT_FALSE(!self->healthy())) {
           request.done.set_value(false);
           return true;
         }
+        internal::StageTimer timer(self->options_.stats(),
+                                   RecordsStats::Stage::kIo);
         if (ABSL_PREDICT_FALSE(
                 !self->chunk_writer_->Flush(request.flush_type))) {
           self->FailWithoutAnnotation(self->chunk_writer_->status());
@@ -595,22 +1379,41 @@ inline RecordWriterBase::ParallelWorker::ParallelWorker(
       ParallelWorker* self;
     };
 
-    mutex_.Lock();
     for (;;) {
-      mutex_.Await(absl::Condition(
-          +[](std::deque<ChunkWriterRequest>* chunk_writer_requests) {
-            return !chunk_writer_requests->empty();
-          },
-          &chunk_writer_requests_));
-      ChunkWriterRequest& request = chunk_writer_requests_.front();
-      mutex_.Unlock();
+      const uint64_t head = head_.load(std::memory_order_relaxed);
+      if (tail_.load() == head) {
+        chunk_writer_waiting_.store(true);
+        mutex_.LockWhen(absl::Condition(
+            +[](ParallelWorker* self) {
+              return self->tail_.load() !=
+                     self->head_.load(std::memory_order_relaxed);
+            },
+            this));
+        chunk_writer_waiting_.store(false, std::memory_order_relaxed);
+        mutex_.Unlock();
+      }
+      ChunkWriterRequest& request = requests_[head & requests_mask_];
       if (ABSL_PREDICT_FALSE(!absl::visit(Visitor{this}, request))) return;
-      mutex_.Lock();
-      chunk_writer_requests_.pop_front();
-      pos_before_chunks_ = chunk_writer_->pos();
+      const WriteChunkRequest* const write_chunk_request =
+          absl::get_if<WriteChunkRequest>(&request);
+      if (write_chunk_request != nullptr) {
+        pending_bytes_.fetch_sub(write_chunk_request->pending_bytes);
+      }
+      const uint64_t sequence =
+          head_sequence_.load(std::memory_order_relaxed);
+      head_sequence_.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      pos_before_chunks_.store(chunk_writer_->pos(),
+                               std::memory_order_relaxed);
+      head_.store(head + 1);
+      head_sequence_.store(sequence + 2, std::memory_order_release);
+      if (producer_waiting_.load()) {
+        // Make the producer reevaluate its condition.
+        absl::MutexLock l(&mutex_);
+      }
     }
   });
-  Initialize(pos_before_chunks_);
+  Initialize(pos_before_chunks_.load(std::memory_order_relaxed));
 }
 
 RecordWriterBase::ParallelWorker::~ParallelWorker() {
@@ -624,10 +1427,11 @@ RecordWriterBase::ParallelWorker::~ParallelWorker() {
 void RecordWriterBase::ParallelWorker::Done() {
   std::promise<void> done_promise;
   std::future<void> done_future = done_promise.get_future();
-  {
-    absl::MutexLock lock(&mutex_);
-    chunk_writer_requests_.emplace_back(DoneRequest{std::move(done_promise)});
+  if (ABSL_PREDICT_FALSE(!HasFreeSlot())) {
+    WaitForChunkWriter(absl::Condition(this, &ParallelWorker::HasFreeSlot));
   }
+  PushRequest(DoneRequest{std::move(done_promise)});
+  NotifyChunkWriter();
   done_future.get();
 }
 
@@ -651,17 +1455,132 @@ absl::Status RecordWriterBase::ParallelWorker::AnnotateStatus(
     absl::Status status) {
   std::promise<absl::Status> done_promise;
   std::future<absl::Status> done_future = done_promise.get_future();
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(
+  WaitForCapacityForRequest();
+  PushRequest(
       AnnotateStatusRequest{std::move(status), std::move(done_promise)});
-  mutex_.Unlock();
+  NotifyChunkWriter();
   return done_future.get();
 }
 
+inline Executor& RecordWriterBase::ParallelWorker::executor() const {
+  return options_.executor() != nullptr ? *options_.executor()
+                                        : internal::ThreadPool::global();
+}
+
+inline bool RecordWriterBase::ParallelWorker::HasFreeSlot() const {
+  return tail_.load(std::memory_order_relaxed) - head_.load() <=
+         requests_mask_;
+}
+
 bool RecordWriterBase::ParallelWorker::HasCapacityForRequest() const {
-  return chunk_writer_requests_.size() <
-         IntCast<size_t>(options_.parallelism());
+  return HasCapacityForChunk(0, 1);
+}
+
+bool RecordWriterBase::ParallelWorker::HasCapacityForChunk(
+    uint64_t pending_bytes, size_t num_requests) const {
+  const uint64_t num_pending =
+      tail_.load(std::memory_order_relaxed) - head_.load();
+  if (num_pending + num_requests > requests_mask_ + 1) return false;
+  if (options_.max_pending_bytes() == absl::nullopt) {
+    if (num_pending == 0) return true;
+    if (MemoryBudgetExceeded()) return false;
+    return num_pending < IntCast<uint64_t>(options_.parallelism());
+  }
+  const uint64_t max_pending_bytes = *options_.max_pending_bytes();
+  const uint64_t pending_bytes_before = pending_bytes_.load();
+  return pending_bytes_before == 0 ||
+         (!MemoryBudgetExceeded() &&
+          pending_bytes_before <= max_pending_bytes &&
+          pending_bytes <= max_pending_bytes - pending_bytes_before);
+}
+
+inline bool RecordWriterBase::ParallelWorker::MemoryBudgetExceeded() {
+  const MemoryBudget* const memory_budget = GlobalMemoryBudget();
+  return memory_budget != nullptr && memory_budget->exceeded();
+}
+
+inline void RecordWriterBase::ParallelWorker::WaitForCapacityForRequest() {
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kQueueWait);
+  if (ABSL_PREDICT_TRUE(HasCapacityForRequest())) return;
+  WaitForChunkWriter(
+      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
+}
+
+inline void RecordWriterBase::ParallelWorker::WaitForCapacityForChunk(
+    uint64_t pending_bytes, size_t num_requests) {
+  internal::StageTimer timer(options_.stats(), RecordsStats::Stage::kQueueWait);
+  if (ABSL_PREDICT_TRUE(HasCapacityForChunk(pending_bytes, num_requests))) {
+    return;
+  }
+  const ChunkCapacityQuery query{this, pending_bytes, num_requests};
+  WaitForChunkWriter(absl::Condition(
+      +[](const ChunkCapacityQuery* query) {
+        return query->self->HasCapacityForChunk(query->pending_bytes,
+                                                query->num_requests);
+      },
+      &query));
+}
+
+void RecordWriterBase::ParallelWorker::WaitForChunkWriter(
+    const absl::Condition& condition) {
+  producer_waiting_.store(true);
+  mutex_.LockWhen(condition);
+  producer_waiting_.store(false, std::memory_order_relaxed);
+  mutex_.Unlock();
+}
+
+inline void RecordWriterBase::ParallelWorker::PushRequest(
+    ChunkWriterRequest&& request) {
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  RIEGELI_ASSERT_LE(tail - head_.load(), requests_mask_)
+      << "Failed precondition of RecordWriterBase::ParallelWorker::"
+         "PushRequest(): no free slot";
+  requests_[tail & requests_mask_] = std::move(request);
+  tail_.store(tail + 1);
+}
+
+inline void RecordWriterBase::ParallelWorker::NotifyChunkWriter() {
+  if (chunk_writer_waiting_.load()) {
+    // Make the chunk writer thread reevaluate its condition.
+    absl::MutexLock l(&mutex_);
+  }
+}
+
+void RecordWriterBase::ParallelWorker::AdaptCompressionLevel() {
+  const absl::optional<int> min_level =
+      options_.compressor_options().adaptive_min_level();
+  const int max_level = options_.compressor_options().compression_level();
+  if (min_level == absl::nullopt || *min_level >= max_level) return;
+  bool nearly_full;
+  bool nearly_empty;
+  if (options_.max_pending_bytes() == absl::nullopt) {
+    const uint64_t backlog =
+        tail_.load(std::memory_order_relaxed) - head_.load();
+    const uint64_t capacity = IntCast<uint64_t>(options_.parallelism());
+    nearly_full = backlog * 4 >= capacity * 3;
+    nearly_empty = backlog * 4 <= capacity;
+  } else {
+    const uint64_t max_pending_bytes = *options_.max_pending_bytes();
+    const uint64_t pending_bytes = pending_bytes_.load();
+    nearly_full = pending_bytes >= max_pending_bytes - max_pending_bytes / 4;
+    nearly_empty = pending_bytes <= max_pending_bytes / 4;
+  }
+  const int step = nearly_full ? -1 : nearly_empty ? 1 : 0;
+  if (step == 0) return;
+  int level = adapted_compressor_options_.compression_level() + step;
+  // Zstd level 0 means the default level, which does not fit between its
+  // neighbors.
+  if (level == 0 && adapted_compressor_options_.compression_type() ==
+                        CompressionType::kZstd) {
+    level += step;
+  }
+  adapted_compressor_options_.set_compression_level(
+      SignedMax(*min_level, SignedMin(level, max_level)));
+}
+
+void RecordWriterBase::ParallelWorker::OpenChunk() {
+  AdaptCompressionLevel();
+  chunk_encoder_ = MakeChunkEncoder(adapted_compressor_options_);
 }
 
 bool RecordWriterBase::ParallelWorker::WriteSignature() {
@@ -671,12 +1590,10 @@ bool RecordWriterBase::ParallelWorker::WriteSignature() {
   ChunkPromises chunk_promises;
   chunk_promises.chunk_header.set_value(chunk.header);
   chunk_promises.chunk.set_value(std::move(chunk));
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(
-      WriteChunkRequest{chunk_promises.chunk_header.get_future(),
-                        chunk_promises.chunk.get_future()});
-  mutex_.Unlock();
+  WaitForCapacityForRequest();
+  PushRequest(WriteChunkRequest{chunk_promises.chunk_header.get_future(),
+                                chunk_promises.chunk.get_future()});
+  NotifyChunkWriter();
   return true;
 }
 
@@ -687,13 +1604,11 @@ bool RecordWriterBase::ParallelWorker::WriteMetadata() {
     return true;
   }
   ChunkPromises* const chunk_promises = new ChunkPromises();
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(
-      WriteChunkRequest{chunk_promises->chunk_header.get_future(),
-                        chunk_promises->chunk.get_future()});
-  mutex_.Unlock();
-  internal::ThreadPool::global().Schedule([this, chunk_promises] {
+  WaitForCapacityForRequest();
+  PushRequest(WriteChunkRequest{chunk_promises->chunk_header.get_future(),
+                                chunk_promises->chunk.get_future()});
+  NotifyChunkWriter();
+  executor().Schedule([this, chunk_promises] {
     Chunk chunk;
     EncodeMetadata(chunk);
     chunk_promises->chunk_header.set_value(chunk.header);
@@ -703,34 +1618,97 @@ bool RecordWriterBase::ParallelWorker::WriteMetadata() {
   return true;
 }
 
+bool RecordWriterBase::ParallelWorker::WriteZstdDictionary() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Chunk chunk;
+  EncodeZstdDictionary(chunk);
+  ChunkPromises chunk_promises;
+  chunk_promises.chunk_header.set_value(chunk.header);
+  chunk_promises.chunk.set_value(std::move(chunk));
+  WaitForCapacityForRequest();
+  PushRequest(WriteChunkRequest{chunk_promises.chunk_header.get_future(),
+                                chunk_promises.chunk.get_future()});
+  NotifyChunkWriter();
+  return true;
+}
+
 bool RecordWriterBase::ParallelWorker::CloseChunk() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   ChunkEncoder* const chunk_encoder = chunk_encoder_.release();
   ChunkPromises* const chunk_promises = new ChunkPromises();
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(
-      WriteChunkRequest{chunk_promises->chunk_header.get_future(),
-                        chunk_promises->chunk.get_future()});
-  mutex_.Unlock();
-  internal::ThreadPool::global().Schedule(
-      [this, chunk_encoder, chunk_promises] {
+  // The column statistics chunk is written by a separate request, so that
+  // positions of following chunks account for it.
+  ChunkPromises* const statistics_promises =
+      chunk_encoder->statistics() != nullptr ? new ChunkPromises() : nullptr;
+  const uint64_t pending_bytes = chunk_encoder->decoded_data_size();
+  WaitForCapacityForChunk(pending_bytes,
+                          statistics_promises != nullptr ? 2 : 1);
+  // `pending_bytes_` is increased before the chunk writer thread can see the
+  // request and decrease it.
+  pending_bytes_.fetch_add(pending_bytes);
+  PushRequest(WriteChunkRequest{chunk_promises->chunk_header.get_future(),
+                                chunk_promises->chunk.get_future(),
+                                pending_bytes});
+  if (statistics_promises != nullptr) {
+    PushRequest(
+        WriteChunkRequest{statistics_promises->chunk_header.get_future(),
+                          statistics_promises->chunk.get_future()});
+  }
+  NotifyChunkWriter();
+  executor().Schedule(
+      [this, chunk_encoder, chunk_promises, statistics_promises] {
         Chunk chunk;
-        EncodeChunk(*chunk_encoder, chunk);
+        absl::optional<Chunk> statistics_chunk;
+        EncodeChunk(*chunk_encoder, chunk, statistics_chunk);
         delete chunk_encoder;
         chunk_promises->chunk_header.set_value(chunk.header);
         chunk_promises->chunk.set_value(std::move(chunk));
         delete chunk_promises;
+        if (statistics_promises != nullptr) {
+          // If encoding failed, an empty chunk is provided, which is not
+          // written because the worker is no longer healthy.
+          if (statistics_chunk == absl::nullopt) statistics_chunk.emplace();
+          statistics_promises->chunk_header.set_value(
+              statistics_chunk->header);
+          statistics_promises->chunk.set_value(std::move(*statistics_chunk));
+          delete statistics_promises;
+        }
       });
   return true;
 }
 
 bool RecordWriterBase::ParallelWorker::PadToBlockBoundary() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(PadToBlockBoundaryRequest());
-  mutex_.Unlock();
+  WaitForCapacityForRequest();
+  PushRequest(PadToBlockBoundaryRequest());
+  NotifyChunkWriter();
+  return true;
+}
+
+bool RecordWriterBase::ParallelWorker::WriteChunkIndex() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  std::promise<ChunkHeader> chunk_header_promise;
+  std::shared_future<ChunkHeader> chunk_header =
+      chunk_header_promise.get_future();
+  WaitForCapacityForRequest();
+  PushRequest(WriteChunkIndexRequest{std::move(chunk_header_promise),
+                                     std::move(chunk_header)});
+  NotifyChunkWriter();
+  return true;
+}
+
+bool RecordWriterBase::ParallelWorker::WriteChunk(Chunk&& chunk) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const uint64_t pending_bytes = chunk.data.size();
+  ChunkPromises chunk_promises;
+  chunk_promises.chunk_header.set_value(chunk.header);
+  chunk_promises.chunk.set_value(std::move(chunk));
+  WaitForCapacityForChunk(pending_bytes);
+  pending_bytes_.fetch_add(pending_bytes);
+  PushRequest(WriteChunkRequest{chunk_promises.chunk_header.get_future(),
+                                chunk_promises.chunk.get_future(),
+                                pending_bytes});
+  NotifyChunkWriter();
   return true;
 }
 
@@ -742,17 +1720,16 @@ std::future<bool> RecordWriterBase::ParallelWorker::FutureFlush(
     FlushType flush_type) {
   std::promise<bool> done_promise;
   std::future<bool> done_future = done_promise.get_future();
-  mutex_.LockWhen(
-      absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
-  chunk_writer_requests_.emplace_back(
-      FlushRequest{flush_type, std::move(done_promise)});
-  mutex_.Unlock();
+  WaitForCapacityForRequest();
+  PushRequest(FlushRequest{flush_type, std::move(done_promise)});
+  NotifyChunkWriter();
   return done_future;
 }
 
 internal::FutureChunkBegin RecordWriterBase::ParallelWorker::ChunkBegin()
     const {
   struct Visitor {
+    void operator()(const absl::monostate&) {}
     void operator()(const DoneRequest&) {}
     void operator()(const AnnotateStatusRequest&) {}
     void operator()(const WriteChunkRequest& request) {
@@ -761,18 +1738,36 @@ internal::FutureChunkBegin RecordWriterBase::ParallelWorker::ChunkBegin()
     void operator()(const PadToBlockBoundaryRequest&) {
       actions.emplace_back(internal::FutureChunkBegin::PadToBlockBoundary());
     }
+    void operator()(const WriteChunkIndexRequest& request) {
+      actions.emplace_back(request.chunk_header);
+    }
     void operator()(const FlushRequest&) {}
 
     std::vector<internal::FutureChunkBegin::Action> actions;
   };
+  // Read `head_` and `pos_before_chunks_` consistently. Requests before
+  // `tail_` are not overwritten meanwhile because only this thread adds them.
+  uint64_t head;
+  Position pos_before_chunks;
+  for (;;) {
+    const uint64_t sequence = head_sequence_.load(std::memory_order_acquire);
+    head = head_.load(std::memory_order_relaxed);
+    pos_before_chunks = pos_before_chunks_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (ABSL_PREDICT_TRUE(
+            sequence % 2 == 0 &&
+            head_sequence_.load(std::memory_order_relaxed) == sequence)) {
+      break;
+    }
+  }
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
   Visitor visitor;
-  absl::MutexLock lock(&mutex_);
-  visitor.actions.reserve(chunk_writer_requests_.size());
-  for (const ChunkWriterRequest& request : chunk_writer_requests_) {
-    absl::visit(visitor, request);
+  visitor.actions.reserve(IntCast<size_t>(tail - head));
+  for (uint64_t index = head; index != tail; ++index) {
+    absl::visit(visitor, requests_[index & requests_mask_]);
   }
-  return internal::FutureChunkBegin(pos_before_chunks_,
-                                    std::move(visitor.actions));
+  return internal::FutureChunkBegin(pos_before_chunks,
+                                    std::move(visitor.actions), block_size_);
 }
 
 FutureRecordPosition RecordWriterBase::ParallelWorker::LastPos() const {
@@ -797,10 +1792,208 @@ FutureRecordPosition RecordWriterBase::ParallelWorker::Pos() const {
 }
 
 Position RecordWriterBase::ParallelWorker::EstimatedSize() const {
-  absl::MutexLock lock(&mutex_);
-  return pos_before_chunks_;
+  return pos_before_chunks_.load();
 }
 
+// Flushes the current chunk in background when `Options::max_chunk_delay()`
+// passed since records were added to it.
+//
+// The background thread uses only the `Worker` and the state of the
+// `ChunkDelayTimer`, not the `RecordWriterBase`, which can be moved meanwhile.
+// `RecordWriterBase` learns what happened in `SyncWithChunkDelayTimer()`.
+class RecordWriterBase::ChunkDelayTimer {
+ public:
+  explicit ChunkDelayTimer(Worker* worker, absl::Duration max_chunk_delay);
+
+  ChunkDelayTimer(const ChunkDelayTimer&) = delete;
+  ChunkDelayTimer& operator=(const ChunkDelayTimer&) = delete;
+
+  ~ChunkDelayTimer() { Stop(); }
+
+  absl::Mutex& mutex() const { return state_->mutex; }
+
+  // Stops the background thread and waits until it stops using the `Worker`.
+  void Stop();
+
+  // Returns `true` if the current chunk was flushed since the last
+  // `clear_flushed()`. The current chunk is empty then.
+  bool flushed() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex()) {
+    return state_->flushed;
+  }
+  void clear_flushed() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex()) {
+    state_->flushed = false;
+  }
+  // The position of the last record written before the chunk was flushed.
+  //
+  // Precondition: `flushed()`
+  const FutureRecordPosition& last_pos() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex()) {
+    return state_->last_pos;
+  }
+  // A failure of flushing, or `absl::OkStatus()`.
+  const absl::Status& status() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex()) {
+    return state_->status;
+  }
+
+  // Called at the end of an operation of `RecordWriterBase`, with whether the
+  // current chunk has records. Starts or cancels waiting for the deadline.
+  void ChunkUpdated(bool has_records) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex());
+
+ private:
+  struct State {
+    explicit State(Worker* worker, absl::Duration max_chunk_delay)
+        : worker(worker), max_chunk_delay(max_chunk_delay) {}
+
+    mutable absl::Mutex mutex;
+    Worker* const worker;
+    const absl::Duration max_chunk_delay;
+    bool stop ABSL_GUARDED_BY(mutex) = false;
+    bool stopped ABSL_GUARDED_BY(mutex) = false;
+    // When the current chunk should be flushed, or `absl::InfiniteFuture()`
+    // if it has no records.
+    absl::Time deadline ABSL_GUARDED_BY(mutex) = absl::InfiniteFuture();
+    bool flushed ABSL_GUARDED_BY(mutex) = false;
+    FutureRecordPosition last_pos ABSL_GUARDED_BY(mutex);
+    absl::Status status ABSL_GUARDED_BY(mutex);
+  };
+
+  // Parameters of the wake up condition of `Run()` for `absl::Condition`.
+  struct WakeQuery {
+    const State* state;
+    absl::Time deadline;
+  };
+
+  static void Run(State& state);
+
+  // Shared with the background thread, which can still be unlocking the mutex
+  // after `Stop()` returns.
+  std::shared_ptr<State> state_;
+};
+
+RecordWriterBase::ChunkDelayTimer::ChunkDelayTimer(
+    Worker* worker, absl::Duration max_chunk_delay)
+    : state_(std::make_shared<State>(worker, max_chunk_delay)) {
+  internal::ThreadPool::global().ScheduleBlocking(
+      [state = state_] { Run(*state); });
+}
+
+void RecordWriterBase::ChunkDelayTimer::Stop() {
+  absl::MutexLock lock(&state_->mutex);
+  state_->stop = true;
+  state_->mutex.Await(absl::Condition(&state_->stopped));
+}
+
+void RecordWriterBase::ChunkDelayTimer::ChunkUpdated(bool has_records) {
+  if (!has_records) {
+    state_->deadline = absl::InfiniteFuture();
+  } else if (state_->deadline == absl::InfiniteFuture()) {
+    state_->deadline = absl::Now() + state_->max_chunk_delay;
+  }
+}
+
+void RecordWriterBase::ChunkDelayTimer::Run(State& state) {
+  absl::MutexLock lock(&state.mutex);
+  for (;;) {
+    const WakeQuery query{&state, state.deadline};
+    const bool woken = state.mutex.AwaitWithDeadline(
+        absl::Condition(
+            +[](const WakeQuery* query) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+              return query->state->stop ||
+                     query->state->deadline != query->deadline;
+            },
+            &query),
+        query.deadline);
+    if (state.stop) break;
+    // If `woken`, the deadline changed.
+    if (woken) continue;
+    state.deadline = absl::InfiniteFuture();
+    if (ABSL_PREDICT_FALSE(!state.status.ok())) continue;
+    Worker& worker = *state.worker;
+    if (ABSL_PREDICT_FALSE(!worker.status().ok())) {
+      state.status = worker.status();
+      continue;
+    }
+    state.last_pos = worker.LastPos();
+    if (ABSL_PREDICT_FALSE(!worker.CloseChunk() ||
+                           !worker.MaybePadToBlockBoundary() ||
+                           !worker.Flush(FlushType::kFromProcess))) {
+      state.status = worker.status();
+      continue;
+    }
+    worker.OpenChunk();
+    state.flushed = true;
+  }
+  state.stopped = true;
+}
+
+// Holds the mutex of `RecordWriterBase::chunk_delay_timer_`, if any, during an
+// operation which uses `worker_` or `chunk_size_so_far_`.
+class RecordWriterBase::ChunkDelayLock {
+ public:
+  explicit ChunkDelayLock(RecordWriterBase* self) ABSL_NO_THREAD_SAFETY_ANALYSIS
+      : self_(self) {
+    if (ABSL_PREDICT_TRUE(self_->chunk_delay_timer_ == nullptr)) return;
+    self_->chunk_delay_timer_->mutex().Lock();
+    self_->SyncWithChunkDelayTimer();
+  }
+
+  ChunkDelayLock(const ChunkDelayLock&) = delete;
+  ChunkDelayLock& operator=(const ChunkDelayLock&) = delete;
+
+  ~ChunkDelayLock() ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    if (ABSL_PREDICT_TRUE(self_->chunk_delay_timer_ == nullptr)) return;
+    self_->chunk_delay_timer_->ChunkUpdated(self_->chunk_size_so_far_ > 0);
+    self_->chunk_delay_timer_->mutex().Unlock();
+  }
+
+ private:
+  RecordWriterBase* self_;
+};
+
+// The `Writer` returned by `RecordWriterBase::NewRecordWriter()`. It writes the
+// value of the streamed record to the chunk encoder, and finishes the record
+// when closed.
+class RecordWriterBase::StreamingRecordWriter : public WrappedWriterBase {
+ public:
+  explicit StreamingRecordWriter(RecordWriterBase* record_writer, Writer* dest)
+      : record_writer_(record_writer), dest_(dest) {
+    Initialize(dest_);
+  }
+
+  StreamingRecordWriter(const StreamingRecordWriter&) = delete;
+  StreamingRecordWriter& operator=(const StreamingRecordWriter&) = delete;
+
+  void Reset(RecordWriterBase* record_writer, Writer* dest) {
+    WrappedWriterBase::Reset();
+    record_writer_ = record_writer;
+    dest_ = dest;
+    Initialize(dest_);
+  }
+
+  void set_record_writer(RecordWriterBase* record_writer) {
+    record_writer_ = record_writer;
+  }
+
+  Writer* dest_writer() override { return dest_; }
+  const Writer* dest_writer() const override { return dest_; }
+
+  // Seeking, truncation, and reading back would change the value of the
+  // record behind the back of the size computed by the chunk encoder.
+  bool SupportsRandomAccess() override { return false; }
+  bool SupportsTruncate() override { return false; }
+  bool SupportsReadMode() override { return false; }
+
+ protected:
+  void Done() override {
+    WrappedWriterBase::Done();
+    record_writer_->FinishStreamingRecord(*this);
+  }
+
+ private:
+  RecordWriterBase* record_writer_;
+  Writer* dest_;
+};
+
 RecordWriterBase::RecordWriterBase(Closed) noexcept : Object(kClosed) {}
 
 RecordWriterBase::RecordWriterBase() noexcept {}
@@ -810,6 +2003,8 @@ void RecordWriterBase::Reset(Closed) {
   desired_chunk_size_ = 0;
   chunk_size_so_far_ = 0;
   last_record_is_valid_ = false;
+  streaming_record_.reset();
+  chunk_delay_timer_.reset();
   worker_.reset();
 }
 
@@ -818,6 +2013,8 @@ void RecordWriterBase::Reset() {
   desired_chunk_size_ = 0;
   chunk_size_so_far_ = 0;
   last_record_is_valid_ = false;
+  streaming_record_.reset();
+  chunk_delay_timer_.reset();
   worker_.reset();
 }
 
@@ -828,7 +2025,11 @@ RecordWriterBase::RecordWriterBase(RecordWriterBase&& that) noexcept
       desired_chunk_size_(that.desired_chunk_size_),
       chunk_size_so_far_(that.chunk_size_so_far_),
       last_record_is_valid_(std::exchange(that.last_record_is_valid_, false)),
-      worker_(std::move(that.worker_)) {}
+      worker_(std::move(that.worker_)),
+      chunk_delay_timer_(std::move(that.chunk_delay_timer_)),
+      streaming_record_(std::move(that.streaming_record_)) {
+  if (streaming_record_ != nullptr) streaming_record_->set_record_writer(this);
+}
 
 RecordWriterBase& RecordWriterBase::operator=(
     RecordWriterBase&& that) noexcept {
@@ -838,6 +2039,11 @@ RecordWriterBase& RecordWriterBase::operator=(
   desired_chunk_size_ = that.desired_chunk_size_;
   chunk_size_so_far_ = that.chunk_size_so_far_;
   last_record_is_valid_ = std::exchange(that.last_record_is_valid_, false);
+  // `chunk_delay_timer_` must stop using the old `worker_` before it is
+  // destroyed.
+  streaming_record_ = std::move(that.streaming_record_);
+  if (streaming_record_ != nullptr) streaming_record_->set_record_writer(this);
+  chunk_delay_timer_ = std::move(that.chunk_delay_timer_);
   worker_ = std::move(that.worker_);
   return *this;
 }
@@ -851,6 +2057,7 @@ void RecordWriterBase::Initialize(ChunkWriter* dest, Options&& options) {
   // `num_records * sizeof(uint64_t)` under `desired_chunk_size_`.
   desired_chunk_size_ = UnsignedMin(options.effective_chunk_size(),
                                     kMaxNumRecords * sizeof(uint64_t));
+  const absl::Duration max_chunk_delay = options.max_chunk_delay();
   if (options.parallelism() == 0) {
     worker_ = std::make_unique<SerialWorker>(dest, std::move(options));
   } else {
@@ -860,8 +2067,13 @@ void RecordWriterBase::Initialize(ChunkWriter* dest, Options&& options) {
     absl::Status status = worker_->status();
     if (ABSL_PREDICT_FALSE(!status.ok())) {
       FailWithoutAnnotation(std::move(status));
+      return;
     }
   }
+  if (max_chunk_delay < absl::InfiniteDuration()) {
+    chunk_delay_timer_ =
+        std::make_unique<ChunkDelayTimer>(worker_.get(), max_chunk_delay);
+  }
 }
 
 void RecordWriterBase::Done() {
@@ -871,12 +2083,21 @@ void RecordWriterBase::Done() {
     return;
   }
   last_record_is_valid_ = false;
+  if (streaming_record_ != nullptr) streaming_record_->Close();
+  if (chunk_delay_timer_ != nullptr) {
+    chunk_delay_timer_->Stop();
+    SyncWithChunkDelayTimer();
+    chunk_delay_timer_.reset();
+  }
   if (chunk_size_so_far_ != 0) {
     if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
       FailWithoutAnnotation(worker_->status());
     }
     chunk_size_so_far_ = 0;
   }
+  if (ABSL_PREDICT_FALSE(!worker_->MaybeWriteChunkIndex())) {
+    FailWithoutAnnotation(worker_->status());
+  }
   if (ABSL_PREDICT_FALSE(!worker_->MaybePadToBlockBoundary())) {
     FailWithoutAnnotation(worker_->status());
   }
@@ -885,13 +2106,31 @@ void RecordWriterBase::Done() {
   }
 }
 
-void RecordWriterBase::DoneBackground() { worker_.reset(); }
+void RecordWriterBase::DoneBackground() {
+  chunk_delay_timer_.reset();
+  worker_.reset();
+}
+
+void RecordWriterBase::SyncWithChunkDelayTimer()
+    ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  if (chunk_delay_timer_->flushed()) {
+    chunk_delay_timer_->clear_flushed();
+    chunk_size_so_far_ = 0;
+    TuneChunkSize();
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_delay_timer_->status().ok()) && healthy()) {
+    FailWithoutAnnotation(chunk_delay_timer_->status());
+  }
+}
 
 absl::Status RecordWriterBase::AnnotateStatusImpl(absl::Status status) {
   if (is_open()) {
     RIEGELI_ASSERT(worker_ != nullptr)
         << "Failed invariant of RecordWriterBase: "
            "null worker_ but RecordWriterBase is_open()";
+    absl::MutexLockMaybe lock(chunk_delay_timer_ == nullptr
+                                  ? nullptr
+                                  : &chunk_delay_timer_->mutex());
     status = worker_->AnnotateStatus(std::move(status));
   }
   return AnnotateOverDest(std::move(status));
@@ -901,25 +2140,40 @@ absl::Status RecordWriterBase::AnnotateOverDest(absl::Status status) {
   return Annotate(status, absl::StrCat("at record ", Pos().get().ToString()));
 }
 
+inline uint64_t RecordWriterBase::AddedChunkSize(size_t size) {
+  // Decoding a chunk writes records to one array, and their positions to
+  // another array. We limit the size of both arrays together, to include
+  // attempts to accumulate an unbounded number of empty records.
+  return SaturatingAdd(IntCast<uint64_t>(size), uint64_t{sizeof(uint64_t)});
+}
+
+inline void RecordWriterBase::TuneChunkSize() {
+  if (const absl::optional<uint64_t> tuned_chunk_size =
+          worker_->TunedChunkSize()) {
+    desired_chunk_size_ = *tuned_chunk_size;
+  }
+}
+
+inline bool RecordWriterBase::ShouldCloseChunk(uint64_t added_size) const {
+  return (chunk_size_so_far_ > desired_chunk_size_ ||
+          added_size > desired_chunk_size_ - chunk_size_so_far_) &&
+         chunk_size_so_far_ > 0;
+}
+
 bool RecordWriterBase::WriteRecord(const google::protobuf::MessageLite& record,
                                    SerializeOptions serialize_options) {
+  ChunkDelayLock lock(this);
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   last_record_is_valid_ = false;
-  // Decoding a chunk writes records to one array, and their positions to
-  // another array. We limit the size of both arrays together, to include
-  // attempts to accumulate an unbounded number of empty records.
-  const size_t size = serialize_options.GetByteSize(record);
   const uint64_t added_size =
-      SaturatingAdd(IntCast<uint64_t>(size), uint64_t{sizeof(uint64_t)});
-  if (ABSL_PREDICT_FALSE(chunk_size_so_far_ > desired_chunk_size_ ||
-                         added_size >
-                             desired_chunk_size_ - chunk_size_so_far_) &&
-      chunk_size_so_far_ > 0) {
+      AddedChunkSize(serialize_options.GetByteSize(record));
+  if (ABSL_PREDICT_FALSE(ShouldCloseChunk(added_size))) {
     if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
       return FailWithoutAnnotation(worker_->status());
     }
     worker_->OpenChunk();
     chunk_size_so_far_ = 0;
+    TuneChunkSize();
   }
   chunk_size_so_far_ += added_size;
   if (ABSL_PREDICT_FALSE(!worker_->AddRecord(record, serialize_options))) {
@@ -961,22 +2215,17 @@ bool RecordWriterBase::WriteRecord(absl::Cord&& record) {
 
 template <typename Record>
 inline bool RecordWriterBase::WriteRecordImpl(Record&& record) {
+  ChunkDelayLock lock(this);
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   last_record_is_valid_ = false;
-  // Decoding a chunk writes records to one array, and their positions to
-  // another array. We limit the size of both arrays together, to include
-  // attempts to accumulate an unbounded number of empty records.
-  const uint64_t added_size = SaturatingAdd(IntCast<uint64_t>(record.size()),
-                                            uint64_t{sizeof(uint64_t)});
-  if (ABSL_PREDICT_FALSE(chunk_size_so_far_ > desired_chunk_size_ ||
-                         added_size >
-                             desired_chunk_size_ - chunk_size_so_far_) &&
-      chunk_size_so_far_ > 0) {
+  const uint64_t added_size = AddedChunkSize(record.size());
+  if (ABSL_PREDICT_FALSE(ShouldCloseChunk(added_size))) {
     if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
       return FailWithoutAnnotation(worker_->status());
     }
     worker_->OpenChunk();
     chunk_size_so_far_ = 0;
+    TuneChunkSize();
   }
   chunk_size_so_far_ += added_size;
   if (ABSL_PREDICT_FALSE(!worker_->AddRecord(std::forward<Record>(record)))) {
@@ -986,7 +2235,154 @@ inline bool RecordWriterBase::WriteRecordImpl(Record&& record) {
   return true;
 }
 
+bool RecordWriterBase::WriteRecords(Chain records,
+                                    std::vector<size_t> limits) {
+  RIEGELI_ASSERT_EQ(limits.empty() ? size_t{0} : limits.back(), records.size())
+      << "Failed precondition of RecordWriterBase::WriteRecords(): "
+         "record end positions do not match concatenated record values";
+  ChunkDelayLock lock(this);
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  last_record_is_valid_ = false;
+  if (limits.empty()) return true;
+  ChainReader<const Chain*> records_reader(&records);
+  size_t begin_index = 0;
+  while (begin_index < limits.size()) {
+    const size_t begin_pos = begin_index == 0 ? 0 : limits[begin_index - 1];
+    // Find how many records fit in the current chunk.
+    size_t end_index = begin_index;
+    do {
+      const size_t record_begin = end_index == 0 ? 0 : limits[end_index - 1];
+      RIEGELI_ASSERT_LE(record_begin, limits[end_index])
+          << "Failed precondition of RecordWriterBase::WriteRecords(): "
+             "record end positions not sorted";
+      const uint64_t added_size =
+          AddedChunkSize(limits[end_index] - record_begin);
+      if (ABSL_PREDICT_FALSE(ShouldCloseChunk(added_size))) break;
+      chunk_size_so_far_ += added_size;
+    } while (++end_index < limits.size());
+    if (end_index == begin_index) {
+      if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
+        return FailWithoutAnnotation(worker_->status());
+      }
+      worker_->OpenChunk();
+      chunk_size_so_far_ = 0;
+      TuneChunkSize();
+      continue;
+    }
+    if (begin_index == 0 && end_index == limits.size()) {
+      // All records fit in the current chunk.
+      if (ABSL_PREDICT_FALSE(
+              !worker_->AddRecords(std::move(records), std::move(limits)))) {
+        return FailWithoutAnnotation(worker_->status());
+      }
+      break;
+    }
+    const size_t end_pos = limits[end_index - 1];
+    Chain chunk_records;
+    if (!records_reader.Read(end_pos - begin_pos, chunk_records)) {
+      RIEGELI_ASSERT_UNREACHABLE()
+          << "Failed reading records from ChainReader: "
+          << records_reader.status();
+    }
+    std::vector<size_t> chunk_limits;
+    chunk_limits.reserve(end_index - begin_index);
+    for (size_t i = begin_index; i < end_index; ++i) {
+      chunk_limits.push_back(limits[i] - begin_pos);
+    }
+    if (ABSL_PREDICT_FALSE(!worker_->AddRecords(std::move(chunk_records),
+                                                std::move(chunk_limits)))) {
+      return FailWithoutAnnotation(worker_->status());
+    }
+    begin_index = end_index;
+  }
+  last_record_is_valid_ = true;
+  return true;
+}
+
+bool RecordWriterBase::WriteRecords(
+    absl::Span<const absl::string_view> records) {
+  size_t total_size = 0;
+  for (const absl::string_view record : records) total_size += record.size();
+  Chain concatenated;
+  std::vector<size_t> limits;
+  limits.reserve(records.size());
+  const Chain::Options options = Chain::Options().set_size_hint(total_size);
+  for (const absl::string_view record : records) {
+    concatenated.Append(record, options);
+    limits.push_back(concatenated.size());
+  }
+  return WriteRecords(std::move(concatenated), std::move(limits));
+}
+
+Writer* RecordWriterBase::NewRecordWriter() {
+  ChunkDelayLock lock(this);
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  last_record_is_valid_ = false;
+  if (chunk_size_so_far_ != 0) {
+    if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
+      FailWithoutAnnotation(worker_->status());
+      return nullptr;
+    }
+    worker_->OpenChunk();
+    chunk_size_so_far_ = 0;
+    TuneChunkSize();
+  }
+  Writer* const dest = worker_->BeginStreamingRecord();
+  if (ABSL_PREDICT_FALSE(dest == nullptr)) {
+    FailWithoutAnnotation(worker_->status());
+    return nullptr;
+  }
+  if (streaming_record_ == nullptr) {
+    streaming_record_ = std::make_unique<StreamingRecordWriter>(this, dest);
+  } else {
+    streaming_record_->Reset(this, dest);
+  }
+  return streaming_record_.get();
+}
+
+void RecordWriterBase::FinishStreamingRecord(const Writer& record_writer) {
+  // The current chunk stays empty while the record is streamed, so
+  // `chunk_delay_timer_` does not touch `worker_`, but its mutex still guards
+  // `worker_`.
+  absl::MutexLockMaybe lock(
+      chunk_delay_timer_ == nullptr ? nullptr : &chunk_delay_timer_->mutex());
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  if (ABSL_PREDICT_FALSE(!record_writer.healthy())) {
+    FailWithoutAnnotation(record_writer.status());
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(!worker_->EndStreamingRecord())) {
+    FailWithoutAnnotation(worker_->status());
+  }
+}
+
+bool RecordWriterBase::WriteChunksFrom(DefaultChunkReaderBase& src) {
+  ChunkDelayLock lock(this);
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  last_record_is_valid_ = false;
+  if (chunk_size_so_far_ != 0) {
+    if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
+      return FailWithoutAnnotation(worker_->status());
+    }
+    worker_->OpenChunk();
+    chunk_size_so_far_ = 0;
+    TuneChunkSize();
+  }
+  for (;;) {
+    Chunk chunk;
+    if (!src.ReadChunk(chunk)) break;
+    if (ABSL_PREDICT_FALSE(!worker_->CopyChunk(std::move(chunk)))) {
+      return FailWithoutAnnotation(worker_->status());
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) {
+    return FailWithoutAnnotation(src.status());
+  }
+  return true;
+}
+
 bool RecordWriterBase::Flush(FlushType flush_type) {
+  ChunkDelayLock lock(this);
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   last_record_is_valid_ = false;
   if (chunk_size_so_far_ != 0) {
@@ -1005,12 +2401,14 @@ bool RecordWriterBase::Flush(FlushType flush_type) {
   if (chunk_size_so_far_ != 0) {
     worker_->OpenChunk();
     chunk_size_so_far_ = 0;
+    TuneChunkSize();
   }
   return true;
 }
 
 RecordWriterBase::FutureBool RecordWriterBase::FutureFlush(
     FlushType flush_type) {
+  ChunkDelayLock lock(this);
   if (ABSL_PREDICT_FALSE(!healthy())) {
     std::promise<bool> promise;
     promise.set_value(false);
@@ -1042,6 +2440,7 @@ RecordWriterBase::FutureBool RecordWriterBase::FutureFlush(
   if (chunk_size_so_far_ != 0) {
     worker_->OpenChunk();
     chunk_size_so_far_ = 0;
+    TuneChunkSize();
   }
   return result;
 }
@@ -1053,16 +2452,27 @@ FutureRecordPosition RecordWriterBase::LastPos() const {
   RIEGELI_ASSERT(worker_ != nullptr)
       << "Failed invariant of RecordWriterBase: "
          "last position should be valid but worker is null";
+  absl::MutexLockMaybe lock(
+      chunk_delay_timer_ == nullptr ? nullptr : &chunk_delay_timer_->mutex());
+  // If `chunk_delay_timer_` flushed the chunk, `worker_` no longer knows the
+  // position of the last record.
+  if (chunk_delay_timer_ != nullptr && chunk_delay_timer_->flushed()) {
+    return chunk_delay_timer_->last_pos();
+  }
   return worker_->LastPos();
 }
 
 FutureRecordPosition RecordWriterBase::Pos() const {
   if (ABSL_PREDICT_FALSE(worker_ == nullptr)) return FutureRecordPosition();
+  absl::MutexLockMaybe lock(
+      chunk_delay_timer_ == nullptr ? nullptr : &chunk_delay_timer_->mutex());
   return worker_->Pos();
 }
 
 Position RecordWriterBase::EstimatedSize() const {
   if (ABSL_PREDICT_FALSE(worker_ == nullptr)) return 0;
+  absl::MutexLockMaybe lock(
+      chunk_delay_timer_ == nullptr ? nullptr : &chunk_delay_timer_->mutex());
   return worker_->EstimatedSize();
 }
 
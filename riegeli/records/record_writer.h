@@ -23,28 +23,41 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/stable_dependency.h"
+#include "riegeli/brotli/brotli_allocator.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/column_type.h"
 #include "riegeli/chunk_encoding/compressor_options.h"
 #include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/tuple_encoder.h"
 #include "riegeli/messages/message_serialize.h"
+#include "riegeli/records/block.h"
+#include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/chunk_writer.h"
 #include "riegeli/records/chunk_writer_dependency.h"
+#include "riegeli/records/key_index.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/records_metadata.pb.h"
+#include "riegeli/records/records_stats.h"
+#include "riegeli/records/time_index.h"
+#include "riegeli/zstd/zstd_dictionary.h"
 
 namespace riegeli {
 
@@ -73,18 +86,53 @@ class RecordWriterBase : public Object {
     //     "brotli" (":" brotli_level)? |
     //     "zstd" (":" zstd_level)? |
     //     "snappy" |
+    //     "lz4" (":" lz4_level)? |
+    //     "zlib" (":" zlib_level)? |
+    //     "adaptive" (":" adaptive_min_level)? |
+    //     "min_gain" ":" min_gain |
     //     "window_log" ":" window_log |
+    //     "long_distance_matching" (":" ("true" | "false"))? |
+    //     "zstd_workers" ":" zstd_workers |
+    //     "brotli_recycling" (":" ("true" | "false"))? |
     //     "chunk_size" ":" chunk_size |
+    //     "target_encoded_chunk_size" ":" target_encoded_chunk_size |
+    //     "target_chunk_records" ":" target_chunk_records |
     //     "bucket_fraction" ":" bucket_fraction |
+    //     "parallel_buckets" (":" ("true" | "false"))? |
+    //     "delta_encoding" (":" ("true" | "false"))? |
+    //     "dictionary_encoding" (":" ("true" | "false"))? |
+    //     "transpose_max_transition" ":" transpose_max_transition |
+    //     "transpose_min_count_for_state" ":" transpose_min_count_for_state |
     //     "pad_to_block_boundary" (":" ("true" | "false"))? |
-    //     "parallelism" ":" parallelism
+    //     "block_size" ":" block_size |
+    //     "chunk_index" (":" ("true" | "false"))? |
+    //     "key_index" (":" ("true" | "false"))? |
+    //     "parallelism" ":" parallelism |
+    //     "max_pending_bytes" ":" max_pending_bytes |
+    //     "pipelined_io" (":" ("true" | "false"))?
     //   brotli_level ::= integer in the range [0..11] (default 6)
     //   zstd_level ::= integer in the range [-131072..22] (default 3)
-    //   window_log ::= "auto" or integer in the range [10..31]
+    //   lz4_level ::= integer in the range [-65537..12] (default 0)
+    //   zlib_level ::= integer in the range [0..9] (default 6)
+    //   adaptive_min_level ::= brotli_level (default 0) or zstd_level
+    //     (default 1) or lz4_level (default 0) or zlib_level (default 1),
+    //     depending on the algorithm
+    //   min_gain ::= real in the range [0..1]
+    //   window_log ::= "auto" or integer in the range [9..31]
+    //   zstd_workers ::= integer in the range [0..256]
     //   chunk_size ::= "auto" or positive integer expressed as real with
     //     optional suffix [BkKMGTPE]
+    //   target_encoded_chunk_size ::= positive integer expressed as real with
+    //     optional suffix [BkKMGTPE]
+    //   target_chunk_records ::= positive integer
     //   bucket_fraction ::= real in the range [0..1]
+    //   transpose_max_transition ::= integer in the range [1..63]
+    //   transpose_min_count_for_state ::= "auto" or non-negative integer
+    //   block_size ::= power of 2 in the range [64K..16M] expressed as real
+    //     with optional suffix [BkKMGTPE]
     //   parallelism ::= non-negative integer
+    //   max_pending_bytes ::= "auto" or positive integer expressed as real
+    //     with optional suffix [BkKMGTPE]
     // ```
     //
     // An empty string is the same as "default".
@@ -114,6 +162,29 @@ class RecordWriterBase : public Object {
     }
     bool transpose() const { return transpose_; }
 
+    // If not `nullptr` and `transpose()` is `true`, the expected type of
+    // records, which speeds up their processing: fields declared as neither
+    // submessages nor groups are not checked whether they could be parsed as
+    // submessages.
+    //
+    // This does not set the record type in metadata, see `SetRecordType()`.
+    //
+    // The `Descriptor` is not owned and must outlive the `RecordWriter`.
+    //
+    // Default: `nullptr`.
+    Options& set_transpose_descriptor(
+        const google::protobuf::Descriptor* transpose_descriptor) & {
+      transpose_descriptor_ = transpose_descriptor;
+      return *this;
+    }
+    Options&& set_transpose_descriptor(
+        const google::protobuf::Descriptor* transpose_descriptor) && {
+      return std::move(set_transpose_descriptor(transpose_descriptor));
+    }
+    const google::protobuf::Descriptor* transpose_descriptor() const {
+      return transpose_descriptor_;
+    }
+
     // Changes compression algorithm to Uncompressed (turns compression off).
     Options& set_uncompressed() & {
       compressor_options_.set_uncompressed();
@@ -167,6 +238,47 @@ class RecordWriterBase : public Object {
     }
     Options&& set_snappy() && { return std::move(set_snappy()); }
 
+    // Changes compression algorithm to LZ4. Sets compression level which tunes
+    // the tradeoff between compression density and compression speed (higher
+    // = better density but slower).
+    //
+    // LZ4 decompresses faster than Snappy, at similar compression density.
+    //
+    // `compression_level` must be between `kMinLz4` (-65537) and `kMaxLz4`
+    // (12). Levels below 3 use the fast LZ4 compressor, with negative levels
+    // trading density for more speed. Levels from 3 use the LZ4HC compressor.
+    // Default: `kDefaultLz4` (0).
+    static constexpr int kMinLz4 = CompressorOptions::kMinLz4;
+    static constexpr int kMaxLz4 = CompressorOptions::kMaxLz4;
+    static constexpr int kDefaultLz4 = CompressorOptions::kDefaultLz4;
+    Options& set_lz4(int compression_level = kDefaultLz4) & {
+      compressor_options_.set_lz4(compression_level);
+      return *this;
+    }
+    Options&& set_lz4(int compression_level = kDefaultLz4) && {
+      return std::move(set_lz4(compression_level));
+    }
+
+    // Changes compression algorithm to Zlib (Deflate with the zlib header).
+    // Sets compression level which tunes the tradeoff between compression
+    // density and compression speed (higher = better density but slower).
+    //
+    // Zlib is less dense and slower than Brotli and Zstd, but its decoders are
+    // widely available, including hardware accelerated ones.
+    //
+    // `compression_level` must be between `kMinZlib` (0) and `kMaxZlib` (9).
+    // Default: `kDefaultZlib` (6).
+    static constexpr int kMinZlib = CompressorOptions::kMinZlib;
+    static constexpr int kMaxZlib = CompressorOptions::kMaxZlib;
+    static constexpr int kDefaultZlib = CompressorOptions::kDefaultZlib;
+    Options& set_zlib(int compression_level = kDefaultZlib) & {
+      compressor_options_.set_zlib(compression_level);
+      return *this;
+    }
+    Options&& set_zlib(int compression_level = kDefaultZlib) && {
+      return std::move(set_zlib(compression_level));
+    }
+
     CompressionType compression_type() const {
       return compressor_options_.compression_type();
     }
@@ -175,24 +287,81 @@ class RecordWriterBase : public Object {
       return compressor_options_.compression_level();
     }
 
+    // Makes the compression level adaptive. If not `absl::nullopt` and
+    // `parallelism() > 0`, each chunk is compressed with a level between
+    // `*adaptive_min_level()` and `compression_level()`: the level is lowered
+    // one step at a time while chunks waiting to be encoded and written nearly
+    // reach the limit of `parallelism()` or `max_pending_bytes()`, and raised
+    // back while the backlog is nearly empty. This keeps write throughput
+    // during bursts and density when the writer is idle. Readers are not
+    // affected.
+    //
+    // `adaptive_min_level` applies only to Brotli, Zstd, LZ4, and Zlib, and
+    // must be in the range valid for the compression algorithm. If it is
+    // greater than `compression_level()`, the level is not adapted.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_adaptive_min_level(absl::optional<int> adaptive_min_level) & {
+      compressor_options_.set_adaptive_min_level(adaptive_min_level);
+      return *this;
+    }
+    Options&& set_adaptive_min_level(
+        absl::optional<int> adaptive_min_level) && {
+      return std::move(set_adaptive_min_level(adaptive_min_level));
+    }
+    absl::optional<int> adaptive_min_level() const {
+      return compressor_options_.adaptive_min_level();
+    }
+
+    // Stores incompressible chunks uncompressed. If not `absl::nullopt`, the
+    // fraction of the size of a chunk which compression would save is
+    // estimated from a sample of its data before compressing it. If the
+    // estimate is less than `*min_compression_gain()`, the chunk is stored
+    // uncompressed, which saves CPU time spent on already compressed data
+    // when writing and reading.
+    //
+    // `min_compression_gain` applies to all compression algorithms except
+    // Uncompressed, and must be between 0 and 1.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_min_compression_gain(
+        absl::optional<double> min_compression_gain) & {
+      compressor_options_.set_min_compression_gain(min_compression_gain);
+      return *this;
+    }
+    Options&& set_min_compression_gain(
+        absl::optional<double> min_compression_gain) && {
+      return std::move(set_min_compression_gain(min_compression_gain));
+    }
+    absl::optional<double> min_compression_gain() const {
+      return compressor_options_.min_compression_gain();
+    }
+
     // Logarithm of the LZ77 sliding window size. This tunes the tradeoff
     // between compression density and memory usage (higher = better density but
     // more memory).
     //
     // Special value `absl::nullopt` means to keep the default (Brotli: 22,
-    // Zstd: derived from compression level and chunk size).
+    // Zstd: derived from compression level and chunk size, Zlib: 15).
     //
-    // For Uncompressed and Snappy, `window_log` must be `absl::nullopt`.
+    // For Uncompressed, Snappy, and LZ4, `window_log` must be
+    // `absl::nullopt`.
     //
     // For Brotli, `window_log` must be `absl::nullopt` or between
     // `BrotliWriterBase::Options::kMinWindowLog` (10) and
     // `BrotliWriterBase::Options::kMaxWindowLog` (30).
+    // Above `BrotliWriterBase::Options::kMaxStandardWindowLog` (24) the
+    // large-window mode of Brotli is used, unless the chunk is small enough.
     //
     // For Zstd, `window_log` must be `absl::nullopt` or between
     // `ZstdWriterBase::Options::kMinWindowLog` (10) and
     // `ZstdWriterBase::Options::kMaxWindowLog` (30 in 32-bit build,
     // 31 in 64-bit build).
     //
+    // For Zlib, `window_log` must be `absl::nullopt` or between
+    // `ZlibWriterBase::Options::kMinWindowLog` (9) and
+    // `ZlibWriterBase::Options::kMaxWindowLog` (15).
+    //
     // Default: `absl::nullopt`.
     static constexpr int kMinWindowLog = CompressorOptions::kMinWindowLog;
     static constexpr int kMaxWindowLog = CompressorOptions::kMaxWindowLog;
@@ -207,6 +376,109 @@ class RecordWriterBase : public Object {
       return compressor_options_.window_log();
     }
 
+    // If `true`, Zstd finds matches further than the usual window, which
+    // improves density of large chunks with long repetitions, at the cost of
+    // memory usage and compression speed.
+    //
+    // For compression algorithms other than Zstd, this is ignored.
+    //
+    // Default: `false`.
+    Options& set_zstd_long_distance_matching(
+        bool zstd_long_distance_matching) & {
+      compressor_options_.set_zstd_long_distance_matching(
+          zstd_long_distance_matching);
+      return *this;
+    }
+    Options&& set_zstd_long_distance_matching(
+        bool zstd_long_distance_matching) && {
+      return std::move(
+          set_zstd_long_distance_matching(zstd_long_distance_matching));
+    }
+    bool zstd_long_distance_matching() const {
+      return compressor_options_.zstd_long_distance_matching();
+    }
+
+    // Number of background threads which Zstd uses to compress parts of a
+    // chunk in parallel. Unlike `parallelism()`, which needs several chunks in
+    // flight, this speeds up compression of a single large chunk. 0
+    // compresses in the thread which encodes the chunk.
+    //
+    // For compression algorithms other than Zstd, this is ignored.
+    //
+    // `zstd_num_workers` must be between 0 and
+    // `ZstdWriterBase::Options::kMaxNumWorkers` (64 in 32-bit build, 256 in
+    // 64-bit build). Default: 0.
+    Options& set_zstd_num_workers(int zstd_num_workers) & {
+      compressor_options_.set_zstd_num_workers(zstd_num_workers);
+      return *this;
+    }
+    Options&& set_zstd_num_workers(int zstd_num_workers) && {
+      return std::move(set_zstd_num_workers(zstd_num_workers));
+    }
+    int zstd_num_workers() const {
+      return compressor_options_.zstd_num_workers();
+    }
+
+    // Zstd dictionary. This makes small chunks denser, which allows to use a
+    // smaller chunk size for finer seeking granularity and lower memory usage.
+    //
+    // If Zstd is used with a non-empty dictionary, the dictionary is stored in
+    // the file in a `ChunkType::kZstdDictionary` chunk after file metadata, and
+    // `RecordReader` uses it automatically. File metadata are compressed
+    // without the dictionary.
+    //
+    // When appending to an existing file, the dictionary must be the same as
+    // the one stored in the file when it was written from the beginning.
+    //
+    // For compression algorithms other than Zstd, the dictionary is ignored.
+    //
+    // Default: `ZstdDictionary()`.
+    Options& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) & {
+      compressor_options_.set_zstd_dictionary(zstd_dictionary);
+      return *this;
+    }
+    Options& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) & {
+      compressor_options_.set_zstd_dictionary(std::move(zstd_dictionary));
+      return *this;
+    }
+    Options&& set_zstd_dictionary(const ZstdDictionary& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(zstd_dictionary));
+    }
+    Options&& set_zstd_dictionary(ZstdDictionary&& zstd_dictionary) && {
+      return std::move(set_zstd_dictionary(std::move(zstd_dictionary)));
+    }
+    const ZstdDictionary& zstd_dictionary() const {
+      return compressor_options_.zstd_dictionary();
+    }
+
+    // Memory allocator used by the Brotli engine, shared by all chunks.
+    //
+    // The Brotli encoder allocates large hash tables and ring buffers for each
+    // chunk. With `BrotliAllocator::Recycling()` they are reused by later
+    // chunks, which speeds up writing small chunks at high compression levels.
+    //
+    // For compression algorithms other than Brotli, this is ignored.
+    //
+    // Default: `BrotliAllocator()`.
+    Options& set_brotli_allocator(const BrotliAllocator& brotli_allocator) & {
+      compressor_options_.set_brotli_allocator(brotli_allocator);
+      return *this;
+    }
+    Options& set_brotli_allocator(BrotliAllocator&& brotli_allocator) & {
+      compressor_options_.set_brotli_allocator(std::move(brotli_allocator));
+      return *this;
+    }
+    Options&& set_brotli_allocator(
+        const BrotliAllocator& brotli_allocator) && {
+      return std::move(set_brotli_allocator(brotli_allocator));
+    }
+    Options&& set_brotli_allocator(BrotliAllocator&& brotli_allocator) && {
+      return std::move(set_brotli_allocator(std::move(brotli_allocator)));
+    }
+    const BrotliAllocator& brotli_allocator() const {
+      return compressor_options_.brotli_allocator();
+    }
+
     // Returns grouped compression options.
     CompressorOptions& compressor_options() { return compressor_options_; }
     const CompressorOptions& compressor_options() const {
@@ -246,6 +518,92 @@ class RecordWriterBase : public Object {
       return *chunk_size_;
     }
 
+    // If not `absl::nullopt`, the chunk size is tuned while writing, so that
+    // encoded chunks (as stored in the file, i.e. after compression) have
+    // about `target_encoded_chunk_size` bytes. This bounds the amount of data
+    // read to access a record at a random position.
+    //
+    // The chunk size is derived from the compression ratio and record sizes
+    // observed in chunks encoded so far. The first chunk uses `chunk_size()`.
+    // If `chunk_size()` is not `absl::nullopt`, it remains an upper bound.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_target_encoded_chunk_size(
+        absl::optional<uint64_t> target_encoded_chunk_size) & {
+      if (target_encoded_chunk_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*target_encoded_chunk_size, 0u)
+            << "Failed precondition of "
+               "RecordWriterBase::Options::set_target_encoded_chunk_size(): "
+               "zero target size";
+      }
+      target_encoded_chunk_size_ = target_encoded_chunk_size;
+      return *this;
+    }
+    Options&& set_target_encoded_chunk_size(
+        absl::optional<uint64_t> target_encoded_chunk_size) && {
+      return std::move(
+          set_target_encoded_chunk_size(target_encoded_chunk_size));
+    }
+    absl::optional<uint64_t> target_encoded_chunk_size() const {
+      return target_encoded_chunk_size_;
+    }
+
+    // If not `absl::nullopt`, the chunk size is tuned while writing, so that
+    // chunks have about `target_chunk_records` records. This bounds the number
+    // of records decoded to access a record at a random position.
+    //
+    // The chunk size is derived from record sizes observed in chunks encoded so
+    // far. The first chunk uses `chunk_size()`. If `chunk_size()` is not
+    // `absl::nullopt`, it remains an upper bound. If this is combined with
+    // `target_encoded_chunk_size()`, the smaller tuned chunk size wins.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_target_chunk_records(
+        absl::optional<uint64_t> target_chunk_records) & {
+      if (target_chunk_records != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*target_chunk_records, 0u)
+            << "Failed precondition of "
+               "RecordWriterBase::Options::set_target_chunk_records(): "
+               "zero target number of records";
+      }
+      target_chunk_records_ = target_chunk_records;
+      return *this;
+    }
+    Options&& set_target_chunk_records(
+        absl::optional<uint64_t> target_chunk_records) && {
+      return std::move(set_target_chunk_records(target_chunk_records));
+    }
+    absl::optional<uint64_t> target_chunk_records() const {
+      return target_chunk_records_;
+    }
+
+    // If not `absl::InfiniteDuration()`, the current chunk is closed and
+    // flushed with `FlushType::kFromProcess` by a background thread when
+    // `max_chunk_delay` passed since its first record was written, even if no
+    // more records are written.
+    //
+    // This bounds the latency until written records are visible to readers of
+    // the file while keeping chunks as large as the rate of writing allows,
+    // unlike calling `Flush()` after each record.
+    //
+    // In this mode each operation of the `RecordWriter` locks a mutex shared
+    // with the background thread. The `RecordWriter` is still only
+    // thread-compatible, not thread-safe.
+    //
+    // Default: `absl::InfiniteDuration()`.
+    Options& set_max_chunk_delay(absl::Duration max_chunk_delay) & {
+      RIEGELI_ASSERT_GT(max_chunk_delay, absl::ZeroDuration())
+          << "Failed precondition of "
+             "RecordWriterBase::Options::set_max_chunk_delay(): "
+             "non-positive delay";
+      max_chunk_delay_ = max_chunk_delay;
+      return *this;
+    }
+    Options&& set_max_chunk_delay(absl::Duration max_chunk_delay) && {
+      return std::move(set_max_chunk_delay(max_chunk_delay));
+    }
+    absl::Duration max_chunk_delay() const { return max_chunk_delay_; }
+
     // Sets the desired uncompressed size of a bucket which groups values of
     // several fields of the given wire type to be compressed together,
     // relative to the desired chunk size, on the scale between 0.0 (compress
@@ -275,6 +633,165 @@ class RecordWriterBase : public Object {
     }
     double bucket_fraction() const { return bucket_fraction_; }
 
+    // If `true`, buckets of a transposed chunk are compressed in parallel,
+    // using tasks scheduled on `executor()` (or the thread pool shared by
+    // Riegeli). This reduces the latency of encoding a single large chunk,
+    // which matters especially if `parallelism() == 0`.
+    //
+    // This is meaningful if transpose and compression are enabled and
+    // `bucket_fraction()` is small enough to produce several buckets. The
+    // encoded chunk is the same as without parallel compression.
+    //
+    // Default: `false`.
+    Options& set_parallel_buckets(bool parallel_buckets) & {
+      parallel_buckets_ = parallel_buckets;
+      return *this;
+    }
+    Options&& set_parallel_buckets(bool parallel_buckets) && {
+      return std::move(set_parallel_buckets(parallel_buckets));
+    }
+    bool parallel_buckets() const { return parallel_buckets_; }
+
+    // If `true`, varint fields of transposed chunks may be stored as
+    // differences of consecutive values (or differences of differences),
+    // chosen for each field where this makes the data smaller before
+    // compression. This helps with monotonic fields, e.g. timestamps and
+    // sequence numbers.
+    //
+    // This is meaningful if transpose is enabled. Chunks using this can be read
+    // only by readers which support it.
+    //
+    // Default: `false`.
+    Options& set_delta_encoding(bool delta_encoding) & {
+      delta_encoding_ = delta_encoding;
+      return *this;
+    }
+    Options&& set_delta_encoding(bool delta_encoding) && {
+      return std::move(set_delta_encoding(delta_encoding));
+    }
+    bool delta_encoding() const { return delta_encoding_; }
+
+    // If `true`, string and bytes fields of transposed chunks with few
+    // distinct values, e.g. country codes or enum names, may be stored as a
+    // dictionary of distinct values and indices into it, chosen for each field
+    // where this makes the data smaller before compression.
+    //
+    // This is meaningful if transpose is enabled. Chunks using this can be read
+    // only by readers which support it.
+    //
+    // Default: `false`.
+    Options& set_dictionary_encoding(bool dictionary_encoding) & {
+      dictionary_encoding_ = dictionary_encoding;
+      return *this;
+    }
+    Options&& set_dictionary_encoding(bool dictionary_encoding) && {
+      return std::move(set_dictionary_encoding(dictionary_encoding));
+    }
+    bool dictionary_encoding() const { return dictionary_encoding_; }
+
+    // The largest transition of the state machine of transposed chunks, in the
+    // range [1..63]. A smaller value needs more `kNoOp` states for fields
+    // followed by many different fields.
+    //
+    // This is meaningful if transpose is enabled.
+    //
+    // Default: 63.
+    Options& set_transpose_max_transition(uint32_t transpose_max_transition) & {
+      RIEGELI_ASSERT_GT(transpose_max_transition, 0u)
+          << "Failed precondition of "
+             "RecordWriterBase::Options::set_transpose_max_transition(): "
+             "zero maximum transition";
+      RIEGELI_ASSERT_LE(transpose_max_transition, 63u)
+          << "Failed precondition of "
+             "RecordWriterBase::Options::set_transpose_max_transition(): "
+             "maximum transition out of range";
+      transpose_max_transition_ = transpose_max_transition;
+      return *this;
+    }
+    Options&& set_transpose_max_transition(
+        uint32_t transpose_max_transition) && {
+      return std::move(set_transpose_max_transition(transpose_max_transition));
+    }
+    uint32_t transpose_max_transition() const {
+      return transpose_max_transition_;
+    }
+
+    // The minimum number of times field B follows field A in a transposed
+    // chunk for the state machine to have a state for B specific to A. Rarer
+    // transitions go through a shared list of states, costing an additional
+    // transition each. A larger value makes the state machine smaller, which
+    // makes the chunk header smaller and decoding faster for records with many
+    // rare fields, at the cost of a longer transition stream.
+    //
+    // If `absl::nullopt`, this is chosen for each chunk from its transition
+    // statistics: the largest count such that states are still created for
+    // transitions covering 99% of all transitions, but at least 10.
+    //
+    // This is meaningful if transpose is enabled.
+    //
+    // Default: 10.
+    Options& set_transpose_min_count_for_state(
+        absl::optional<uint32_t> transpose_min_count_for_state) & {
+      transpose_min_count_for_state_ = transpose_min_count_for_state;
+      return *this;
+    }
+    Options&& set_transpose_min_count_for_state(
+        absl::optional<uint32_t> transpose_min_count_for_state) && {
+      return std::move(
+          set_transpose_min_count_for_state(transpose_min_count_for_state));
+    }
+    absl::optional<uint32_t> transpose_min_count_for_state() const {
+      return transpose_min_count_for_state_;
+    }
+
+    // If not `nullptr`, records of each chunk are buffered and stably sorted by
+    // keys computed by `reorder_key()` before the chunk is encoded, so that
+    // records sharing structure are adjacent. With transpose this makes
+    // transitions between fields more regular, which gives a smaller chunk that
+    // is faster to decode. A key can be e.g. a message type, or tags of fields
+    // present in the record.
+    //
+    // The original order of records within a chunk is not stored: readers see
+    // records of each chunk in the sorted order. This is meaningful only if the
+    // order of records does not matter within groups of `chunk_size()`.
+    // Positions from `LastPos()` and `Pos()` within a chunk then do not
+    // identify the records written. This should not be combined with
+    // `key_index()` unless the same key is used.
+    //
+    // Default: `nullptr`.
+    Options& set_reorder_key(RecordKeyFunction reorder_key) & {
+      reorder_key_ = std::move(reorder_key);
+      return *this;
+    }
+    Options&& set_reorder_key(RecordKeyFunction reorder_key) && {
+      return std::move(set_reorder_key(std::move(reorder_key)));
+    }
+    const RecordKeyFunction& reorder_key() const { return reorder_key_; }
+
+    // If not `absl::nullopt`, records are split into fields as specified by
+    // `*tuple_layout`, and a chunk of records is stored column-wise: the field
+    // at each position is stored in a separate column, compressed separately.
+    // This allows for better compression of records with a fixed structure
+    // which are not proto messages, e.g. CSV lines without quoting or fixed
+    // layout structs, and for skipping columns not selected by
+    // `RecordReaderBase::Options::field_projection()`, where field number
+    // `i + 1` selects column `i`.
+    //
+    // This takes precedence over `transpose()`. Chunks using this can be read
+    // only by readers which support it.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_tuple_layout(absl::optional<TupleLayout> tuple_layout) & {
+      tuple_layout_ = std::move(tuple_layout);
+      return *this;
+    }
+    Options&& set_tuple_layout(absl::optional<TupleLayout> tuple_layout) && {
+      return std::move(set_tuple_layout(std::move(tuple_layout)));
+    }
+    const absl::optional<TupleLayout>& tuple_layout() const {
+      return tuple_layout_;
+    }
+
     // Sets file metadata to be written at the beginning (unless
     // `absl::nullopt`).
     //
@@ -367,7 +884,7 @@ class RecordWriterBase : public Object {
       return serialized_metadata_;
     }
 
-    // If `true`, padding is written to reach a 64KB block boundary when the
+    // If `true`, padding is written to reach a block boundary when the
     // `RecordWriter` is created, before `Close()`, and before `Flush()`.
     //
     // Consequences:
@@ -378,7 +895,11 @@ class RecordWriterBase : public Object {
     //  * Physical concatenation of separately written files yields a valid file
     //    (setting metadata in subsequent files is wasteful but harmless).
     //
-    //  * Up to 64KB is wasted when padding is written.
+    //  * Up to `block_size()` (64KB by default) is wasted when padding is
+    //    written.
+    //
+    //  * With `FdWriterBase::Options::set_direct_io(true)`, a file written from
+    //    the beginning is written wholly with `O_DIRECT`.
     //
     // Default: `false`.
     Options& set_pad_to_block_boundary(bool pad_to_block_boundary) & {
@@ -390,6 +911,197 @@ class RecordWriterBase : public Object {
     }
     bool pad_to_block_boundary() const { return pad_to_block_boundary_; }
 
+    // Sets the block size of the file, declared by the file signature.
+    //
+    // The file is divided into blocks, each beginning with a block header
+    // which lets readers find chunk boundaries after seeking or skipping
+    // corrupted regions. A chunk larger than a block is interrupted by block
+    // headers, which readers must skip while reassembling chunk data.
+    //
+    // A larger block size makes this rarer for large chunks, so that more
+    // chunks can be read as contiguous data. On the other hand, seeking and
+    // recovery need to read up to a block to find a chunk boundary, and
+    // padding to a block boundary wastes up to a block.
+    //
+    // A file with a block size other than 64KB cannot be read by readers
+    // which do not support block sizes other than 64KB.
+    //
+    // This is used only when the file is written from the beginning. When
+    // appending to an existing file, its block size is kept.
+    //
+    // `block_size` must be a power of 2 between `internal::kBlockSize` (64KB)
+    // and `internal::kMaxBlockSize` (16MB).
+    //
+    // Default: `internal::kBlockSize` (64KB).
+    Options& set_block_size(Position block_size) & {
+      RIEGELI_ASSERT(internal::IsValidBlockSize(block_size))
+          << "Failed precondition of "
+             "RecordWriterBase::Options::set_block_size(): "
+             "block size out of range or not a power of 2";
+      block_size_ = block_size;
+      return *this;
+    }
+    Options&& set_block_size(Position block_size) && {
+      return std::move(set_block_size(block_size));
+    }
+    Position block_size() const { return block_size_; }
+
+    // If `true`, a chunk index is written before `Close()`: positions of
+    // chunks containing records together with numbers of their records. This
+    // lets `RecordReader` locate chunks by a single lookup instead of searching
+    // for them.
+    //
+    // The chunk index is written only if the file is written from the
+    // beginning, i.e. if the initial position is 0. It is used only if it is
+    // the last chunk of the file (except for padding), so it is ignored after
+    // appending to the file or concatenating files.
+    //
+    // Default: `false`.
+    Options& set_chunk_index(bool chunk_index) & {
+      chunk_index_ = chunk_index;
+      return *this;
+    }
+    Options&& set_chunk_index(bool chunk_index) && {
+      return std::move(set_chunk_index(chunk_index));
+    }
+    bool chunk_index() const { return chunk_index_; }
+
+    // If `true`, records must be written in strictly increasing order of their
+    // keys computed by `record_key()`, which is verified, and a key index is
+    // written before `Close()`: the key of the first record of each chunk
+    // with records. This lets `RecordReader::Lookup()` find the only chunk
+    // which can contain a key by a binary search in memory, and read only that
+    // chunk, which makes a file usable as an immutable key-value table.
+    //
+    // `key_index()` implies `chunk_index()`, and the key index is written and
+    // used under the same conditions. `WriteChunksFrom()` cannot copy chunks
+    // with records to a file with a key index.
+    //
+    // Default: `false`.
+    Options& set_key_index(bool key_index) & {
+      key_index_ = key_index;
+      return *this;
+    }
+    Options&& set_key_index(bool key_index) && {
+      return std::move(set_key_index(key_index));
+    }
+    bool key_index() const { return key_index_; }
+
+    // Computes keys of serialized records for `key_index()`.
+    //
+    // `RecordReaderBase::Options::set_record_key()` of readers using
+    // `Lookup()` must compute the same keys.
+    //
+    // If `nullptr`, the key is the whole record.
+    //
+    // Default: `nullptr`.
+    Options& set_record_key(RecordKeyFunction record_key) & {
+      record_key_ = std::move(record_key);
+      return *this;
+    }
+    Options&& set_record_key(RecordKeyFunction record_key) && {
+      return std::move(set_record_key(std::move(record_key)));
+    }
+    const RecordKeyFunction& record_key() const { return record_key_; }
+
+    // If not `nullptr`, computes timestamps of serialized records, and a time
+    // index is written before `Close()`: the minimum and maximum timestamp of
+    // records of each chunk with records. This lets
+    // `RecordReader::SeekToTime()` and `RecordReader::SkipToTimeRange()` skip
+    // chunks whose records are all outside of a range of timestamps without
+    // reading them.
+    //
+    // Records need not be sorted by timestamps, but the index is effective if
+    // they are roughly sorted, as in logs.
+    //
+    // A time index implies `chunk_index()`, and the time index is written and
+    // used under the same conditions. `WriteChunksFrom()` cannot copy chunks
+    // with records to a file with a time index.
+    //
+    // Default: `nullptr`.
+    Options& set_record_timestamp(RecordTimestampFunction record_timestamp) & {
+      record_timestamp_ = std::move(record_timestamp);
+      return *this;
+    }
+    Options&& set_record_timestamp(
+        RecordTimestampFunction record_timestamp) && {
+      return std::move(set_record_timestamp(std::move(record_timestamp)));
+    }
+    const RecordTimestampFunction& record_timestamp() const {
+      return record_timestamp_;
+    }
+
+    // Columns whose statistics are written in a column statistics chunk
+    // following each chunk with records: the number of values, the number of
+    // records without values, and the minimum and maximum value. This lets
+    // `RecordReader` with a record filter skip chunks with no matching
+    // records without decoding them.
+    //
+    // Statistics are computed if `transpose()` is `true`. Readers without a
+    // record filter skip column statistics chunks.
+    //
+    // Default: no columns.
+    Options& set_column_statistics(
+        const std::vector<ColumnSpec>& column_statistics) & {
+      column_statistics_ = column_statistics;
+      return *this;
+    }
+    Options& set_column_statistics(
+        std::vector<ColumnSpec>&& column_statistics) & {
+      column_statistics_ = std::move(column_statistics);
+      return *this;
+    }
+    Options&& set_column_statistics(
+        const std::vector<ColumnSpec>& column_statistics) && {
+      return std::move(set_column_statistics(column_statistics));
+    }
+    Options&& set_column_statistics(
+        std::vector<ColumnSpec>&& column_statistics) && {
+      return std::move(set_column_statistics(std::move(column_statistics)));
+    }
+    std::vector<ColumnSpec>& column_statistics() { return column_statistics_; }
+    const std::vector<ColumnSpec>& column_statistics() const {
+      return column_statistics_;
+    }
+
+    // Columns whose values are added to a Bloom filter in the column
+    // statistics chunk following each chunk with records, together with their
+    // other statistics. This lets `RecordReader` with
+    // `FieldPredicate::Int64Equals()` or `FieldPredicate::BytesEquals()` as
+    // the record filter skip most chunks which do not contain the key, even if
+    // the keys are not sorted, which makes point lookups cheap.
+    //
+    // A Bloom filter takes about 10 bits per distinct value of the chunk.
+    //
+    // Bloom filters are computed if `transpose()` is `true`.
+    //
+    // Default: no columns.
+    Options& set_bloom_filter_columns(
+        const std::vector<ColumnSpec>& bloom_filter_columns) & {
+      bloom_filter_columns_ = bloom_filter_columns;
+      return *this;
+    }
+    Options& set_bloom_filter_columns(
+        std::vector<ColumnSpec>&& bloom_filter_columns) & {
+      bloom_filter_columns_ = std::move(bloom_filter_columns);
+      return *this;
+    }
+    Options&& set_bloom_filter_columns(
+        const std::vector<ColumnSpec>& bloom_filter_columns) && {
+      return std::move(set_bloom_filter_columns(bloom_filter_columns));
+    }
+    Options&& set_bloom_filter_columns(
+        std::vector<ColumnSpec>&& bloom_filter_columns) && {
+      return std::move(
+          set_bloom_filter_columns(std::move(bloom_filter_columns)));
+    }
+    std::vector<ColumnSpec>& bloom_filter_columns() {
+      return bloom_filter_columns_;
+    }
+    const std::vector<ColumnSpec>& bloom_filter_columns() const {
+      return bloom_filter_columns_;
+    }
+
     // Sets the maximum number of chunks being encoded in parallel in
     // background. Larger parallelism can increase throughput, up to a point
     // where it no longer matters; smaller parallelism reduces memory usage.
@@ -411,15 +1123,130 @@ class RecordWriterBase : public Object {
     }
     int parallelism() const { return parallelism_; }
 
+    // If `parallelism() > 0` and `max_pending_bytes != absl::nullopt`, the
+    // number of chunks being encoded or waiting to be written in background is
+    // not limited by `parallelism()`. Instead, their total size before encoding
+    // is limited to `max_pending_bytes`, except that one chunk is always
+    // accepted.
+    //
+    // This keeps memory usage predictable when chunk sizes vary, while letting
+    // more small chunks be encoded concurrently.
+    //
+    // `absl::nullopt` means that the number of chunks is limited by
+    // `parallelism()`.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_max_pending_bytes(
+        absl::optional<uint64_t> max_pending_bytes) & {
+      if (max_pending_bytes != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*max_pending_bytes, 0u)
+            << "Failed precondition of "
+               "RecordWriterBase::Options::set_max_pending_bytes(): "
+               "zero max pending bytes";
+      }
+      max_pending_bytes_ = max_pending_bytes;
+      return *this;
+    }
+    Options&& set_max_pending_bytes(
+        absl::optional<uint64_t> max_pending_bytes) && {
+      return std::move(set_max_pending_bytes(max_pending_bytes));
+    }
+    absl::optional<uint64_t> max_pending_bytes() const {
+      return max_pending_bytes_;
+    }
+
+    // If `true` and `parallelism() == 0`, chunks are still encoded by the
+    // thread writing records, but writing an encoded chunk to the byte
+    // `Writer` is handed to a background thread while the next chunk is being
+    // filled and encoded. At most one encoded chunk waits for being written,
+    // so this hides I/O latency behind encoding at the cost of buffering one
+    // more chunk, without the memory and overhead of `parallelism()`.
+    //
+    // Like with `parallelism() > 0`, reporting writing errors is delayed.
+    //
+    // Default: `false`.
+    Options& set_pipelined_io(bool pipelined_io) & {
+      pipelined_io_ = pipelined_io;
+      return *this;
+    }
+    Options&& set_pipelined_io(bool pipelined_io) && {
+      return std::move(set_pipelined_io(pipelined_io));
+    }
+    bool pipelined_io() const { return pipelined_io_; }
+
+    // Sets the `Executor` which runs tasks encoding chunks in background if
+    // `parallelism() > 0`, and tasks compressing buckets if
+    // `parallel_buckets()`. `nullptr` means the thread pool shared by Riegeli.
+    //
+    // The `Executor` is not owned and must be valid until `Close()` returns.
+    //
+    // Chunks are still written to the byte `Writer` by a separate thread,
+    // which waits for encoded chunks and does not compete for CPU otherwise.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+    // If not `nullptr`, counts chunks, records, and bytes written, and
+    // measures time spent in stages of writing: waiting for capacity if
+    // `parallelism() > 0`, encoding, hashing, padding, and writing to the
+    // `ChunkWriter`. `stats->Report()` is called by `Close()`.
+    //
+    // If `stats->tracer()` is not `nullptr`, it receives a span of each stage,
+    // tagged with the chunk position and size where known.
+    //
+    // If `nullptr`, nothing is measured and the clock is not read.
+    //
+    // The `RecordsStats` is not owned and must be valid until `Close()`
+    // returns.
+    //
+    // Default: `nullptr`.
+    Options& set_stats(RecordsStats* stats) & {
+      stats_ = stats;
+      return *this;
+    }
+    Options&& set_stats(RecordsStats* stats) && {
+      return std::move(set_stats(stats));
+    }
+    RecordsStats* stats() const { return stats_; }
+
    private:
     bool transpose_ = false;
+    const google::protobuf::Descriptor* transpose_descriptor_ = nullptr;
     CompressorOptions compressor_options_;
     absl::optional<uint64_t> chunk_size_;
+    absl::optional<uint64_t> target_encoded_chunk_size_;
+    absl::optional<uint64_t> target_chunk_records_;
+    absl::Duration max_chunk_delay_ = absl::InfiniteDuration();
     double bucket_fraction_ = 1.0;
+    bool parallel_buckets_ = false;
+    bool delta_encoding_ = false;
+    bool dictionary_encoding_ = false;
+    uint32_t transpose_max_transition_ = 63;
+    absl::optional<uint32_t> transpose_min_count_for_state_ = 10;
+    RecordKeyFunction reorder_key_;
+    absl::optional<TupleLayout> tuple_layout_;
     absl::optional<RecordsMetadata> metadata_;
     absl::optional<Chain> serialized_metadata_;
     bool pad_to_block_boundary_ = false;
+    Position block_size_ = internal::kBlockSize;
+    bool chunk_index_ = false;
+    bool key_index_ = false;
+    RecordKeyFunction record_key_;
+    RecordTimestampFunction record_timestamp_;
+    std::vector<ColumnSpec> column_statistics_;
+    std::vector<ColumnSpec> bloom_filter_columns_;
     int parallelism_ = 0;
+    absl::optional<uint64_t> max_pending_bytes_;
+    bool pipelined_io_ = false;
+    Executor* executor_ = nullptr;
+    RecordsStats* stats_ = nullptr;
   };
 
   // `get()` returns the resolved value. Can block.
@@ -436,6 +1263,10 @@ class RecordWriterBase : public Object {
   // `WriteRecord(google::protobuf::MessageLite)` serializes a proto message to
   // raw bytes beforehand. The remaining overloads accept raw bytes.
   //
+  // Without compression, a large record given as `Chain` or `absl::Cord` is
+  // not copied: its memory is shared with the chunk and passed by reference to
+  // the destination `Writer`, which can share it further (e.g. `ChainWriter`).
+  //
   // `std::string&&` is accepted with a template to avoid implicit conversions
   // to `std::string` which can be ambiguous against `absl::string_view`
   // (e.g. `const char*`).
@@ -455,6 +1286,70 @@ class RecordWriterBase : public Object {
   bool WriteRecord(const absl::Cord& record);
   bool WriteRecord(absl::Cord&& record);
 
+  // Writes multiple records, expressed as concatenated record values and
+  // sorted record end positions, or as an array of record values.
+  //
+  // This is equivalent to writing records one by one, but avoids per-record
+  // overhead. Records are split across chunk boundaries as needed.
+  //
+  // After a successful `WriteRecords()` with at least one record, `LastPos()`
+  // is the position of the last record written.
+  //
+  // Preconditions for `WriteRecords(Chain, std::vector<size_t>)`:
+  //   `limits` are sorted
+  //   `(limits.empty() ? 0 : limits.back()) == records.size()`
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool WriteRecords(Chain records, std::vector<size_t> limits);
+  bool WriteRecords(absl::Span<const absl::string_view> records);
+
+  // Begins writing the next record incrementally, for records too large to be
+  // materialized as a whole, e.g. model checkpoints. The record value is
+  // written to the returned `Writer`, and the record is finished when that
+  // `Writer` is closed, which fails the `RecordWriter` if the `Writer` failed.
+  //
+  // The currently open chunk is closed first, and the record gets a dedicated
+  // simple chunk, regardless of `Options::transpose()`. Its value is compressed
+  // while it is being written, so only the compressed value is buffered, unless
+  // `Options::compressor_options().min_compression_gain()` is set, because
+  // then the decision whether to compress requires the uncompressed value.
+  //
+  // Until the returned `Writer` is closed, the `RecordWriter` must not be used
+  // except by `Close()`, which closes the `Writer` first. `LastPos()` is not
+  // valid after a record written this way; `Pos()` called before
+  // `NewRecordWriter()` returns its position.
+  //
+  // Streaming records is not supported together with `Options::key_index()`
+  // or `Options::record_timestamp()`, because they need the whole record.
+  //
+  // Returns `nullptr` on failure (`!healthy()`).
+  Writer* NewRecordWriter();
+
+  // Copies chunks of records from `src`, from its current position until its
+  // end, without decoding and encoding them again. This is much faster than
+  // reading and writing records, e.g. for concatenating files.
+  //
+  // The currently open chunk is closed first. Block headers are written anew
+  // for the destination. Chunks which pertain to the source file rather than
+  // to records (signature, metadata, padding, and chunk index) are skipped:
+  // the destination has its own, written according to `Options`. Records keep
+  // the encoding, compression, and chunk size they have in `src`, regardless of
+  // `Options`.
+  //
+  // If `src` contains a Zstd dictionary, `Options::compressor_options()` must
+  // specify the same dictionary, otherwise `WriteChunksFrom()` fails, because
+  // chunks which use the dictionary cannot be decoded with another one.
+  //
+  // If reading from `src` fails, the `RecordWriter` fails with the status of
+  // `src`.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool WriteChunksFrom(DefaultChunkReaderBase& src);
+
   // Finalizes any open chunk and pushes buffered data to the destination.
   // If `Options::parallelism() > 0`, waits for any background writing to
   // complete.
@@ -488,6 +1383,13 @@ class RecordWriterBase : public Object {
   // background writing to complete. Returns a `FutureBool` which can be used to
   // wait for background writing to complete.
   //
+  // In this case flushing the destination, including `fsync()` for
+  // `FlushType::kFromMachine`, happens in the background thread which writes
+  // chunks, so a latency-sensitive caller can continue writing records while
+  // data are being made durable. Subsequent chunks are written after the flush
+  // completes, and writing blocks only when `Options::parallelism()` or
+  // `Options::max_pending_bytes()` is exceeded.
+  //
   // Like any member function, `FutureFlush()` must not be called concurrently
   // with other member functions, but there are no concurrency restrictions on
   // calling `get()` on the result.
@@ -564,15 +1466,45 @@ class RecordWriterBase : public Object {
   class Worker;
   class SerialWorker;
   class ParallelWorker;
+  class ChunkDelayTimer;
+  class ChunkDelayLock;
+  class StreamingRecordWriter;
 
   template <typename Record>
   bool WriteRecordImpl(Record&& record);
 
+  // Returns the size which writing a record of `size` bytes adds to the current
+  // chunk for the purpose of `desired_chunk_size_`.
+  static uint64_t AddedChunkSize(size_t size);
+  // Returns `true` if a record with `added_size` computed by `AddedChunkSize()`
+  // should begin a new chunk.
+  bool ShouldCloseChunk(uint64_t added_size) const;
+  // Updates `desired_chunk_size_` from chunks encoded so far, if
+  // `Options::target_encoded_chunk_size()` or `Options::target_chunk_records()`
+  // is set. Called when a new chunk is opened.
+  void TuneChunkSize();
+  // Takes into account that `chunk_delay_timer_` could have flushed the
+  // current chunk or failed.
+  //
+  // Precondition: `chunk_delay_timer_ != nullptr`, and its mutex is held or
+  // it is stopped.
+  void SyncWithChunkDelayTimer();
+  // Finishes the record begun by `NewRecordWriter()`, after `record_writer`
+  // is closed.
+  void FinishStreamingRecord(const Writer& record_writer);
+
   uint64_t desired_chunk_size_ = 0;
   uint64_t chunk_size_so_far_ = 0;
   bool last_record_is_valid_ = false;
   // Invariant: if `is_open()` then `worker_ != nullptr`.
   std::unique_ptr<Worker> worker_;
+  // If not `nullptr`, flushes the current chunk after
+  // `Options::max_chunk_delay()`. Operations using `worker_` or
+  // `chunk_size_so_far_` hold its mutex. Destroyed before `worker_`.
+  std::unique_ptr<ChunkDelayTimer> chunk_delay_timer_;
+  // The `Writer` returned by `NewRecordWriter()`, if any. It is open while the
+  // record is being written.
+  std::unique_ptr<StreamingRecordWriter> streaming_record_;
 };
 
 // `RecordWriter` writes records to a Riegeli/records file. A record is
@@ -603,6 +1535,14 @@ class RecordWriterBase : public Object {
 // `ChunkWriter*` (not owned), `std::unique_ptr<ChunkWriter>` (owned),
 // `DefaultChunkWriter<>` (owned).
 //
+// To append to an existing file, validating its end and truncating a chunk
+// torn by an interrupted writer, use `DefaultChunkWriterBase::Options` with
+// `set_append(true)`, e.g.
+// `RecordWriter<DefaultChunkWriter<FdWriter<>>>(std::forward_as_tuple(
+//     std::forward_as_tuple(filename, O_RDWR | O_CREAT),
+//     DefaultChunkWriterBase::Options().set_append(true)))`.
+// File signature and metadata are written only if the file is empty.
+//
 // By relying on CTAD the template argument can be deduced as the value type of
 // the first constructor argument. This requires C++17.
 //
@@ -0,0 +1,81 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "riegeli/bytes/null_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+namespace {
+
+constexpr size_t kNumRecords = 20000;
+
+// Returns records of about 1K of pseudo-random text from a small vocabulary.
+std::vector<std::string> SampleRecords() {
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> word_distribution(0, 999);
+  std::uniform_int_distribution<size_t> length_distribution(512, 1536);
+  std::vector<std::string> records;
+  records.reserve(kNumRecords);
+  for (size_t i = 0; i < kNumRecords; ++i) {
+    const size_t length = length_distribution(random);
+    std::string record;
+    while (record.size() < length) {
+      record.append(std::to_string(word_distribution(random)));
+      record.push_back(' ');
+    }
+    records.push_back(std::move(record));
+  }
+  return records;
+}
+
+// Writes the sample records with `RecordWriter` using `state.range(0)`
+// threads of the parallel worker for encoding and compressing chunks, with
+// transposition if `state.range(1)` is 1. Parallelism 0 encodes in the calling
+// thread.
+void BM_RecordWriterParallelism(benchmark::State& state) {
+  const std::vector<std::string> records = SampleRecords();
+  size_t total_size = 0;
+  for (const std::string& record : records) total_size += record.size();
+  for (auto _ : state) {
+    RecordWriter<NullWriter> writer(
+        std::forward_as_tuple(),
+        RecordWriterBase::Options()
+            .set_zstd(3)
+            .set_transpose(state.range(1) != 0)
+            .set_chunk_size(uint64_t{256} << 10)
+            .set_parallelism(static_cast<int>(state.range(0))));
+    for (const std::string& record : records) writer.WriteRecord(record);
+    if (!writer.Close()) {
+      state.SkipWithError("RecordWriter failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(total_size));
+}
+BENCHMARK(BM_RecordWriterParallelism)
+    ->ArgsProduct({{0, 1, 2, 4, 8, 16, 32}, {0, 1}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace riegeli
@@ -0,0 +1,137 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/records_stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <limits>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t RecordsStats::kNumStages;
+constexpr size_t RecordsStats::Histogram::kNumBuckets;
+#endif
+
+absl::string_view RecordsStats::StageName(Stage stage) {
+  switch (stage) {
+    case Stage::kQueueWait:
+      return "queue_wait";
+    case Stage::kEncode:
+      return "encode";
+    case Stage::kHash:
+      return "hash";
+    case Stage::kPad:
+      return "pad";
+    case Stage::kIo:
+      return "io";
+    case Stage::kDecode:
+      return "decode";
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown stage: " << static_cast<int>(stage);
+}
+
+uint64_t RecordsStats::Histogram::UpperBound(size_t index) {
+  RIEGELI_ASSERT_LT(index, kNumBuckets)
+      << "Failed precondition of RecordsStats::Histogram::UpperBound(): "
+         "bucket index out of range";
+  if (index == kNumBuckets - 1) return std::numeric_limits<uint64_t>::max();
+  return uint64_t{1} << index;
+}
+
+void RecordsStats::AddChunk(uint64_t num_records, uint64_t encoded_bytes,
+                            uint64_t decoded_bytes) {
+  chunks_.fetch_add(1, std::memory_order_relaxed);
+  records_.fetch_add(num_records, std::memory_order_relaxed);
+  encoded_bytes_.fetch_add(encoded_bytes, std::memory_order_relaxed);
+  decoded_bytes_.fetch_add(decoded_bytes, std::memory_order_relaxed);
+}
+
+void RecordsStats::AddTime(Stage stage, uint64_t nanos) {
+  AtomicHistogram& histogram = stages_[static_cast<size_t>(stage)];
+  // The bucket of `nanos` is the number of bits needed to represent it, so
+  // that bucket `i` holds values below `2^i`.
+  const size_t bucket =
+      UnsignedMin(IntCast<size_t>(absl::bit_width(nanos)),
+                  Histogram::kNumBuckets - 1);
+  histogram.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+  histogram.sum_nanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void RecordsStats::AddQueuedChunk(uint64_t decoded_bytes) {
+  queued_chunks_.fetch_add(1, std::memory_order_relaxed);
+  const uint64_t queued_decoded_bytes =
+      queued_decoded_bytes_.fetch_add(decoded_bytes,
+                                      std::memory_order_relaxed) +
+      decoded_bytes;
+  uint64_t peak = peak_queued_decoded_bytes_.load(std::memory_order_relaxed);
+  while (peak < queued_decoded_bytes &&
+         !peak_queued_decoded_bytes_.compare_exchange_weak(
+             peak, queued_decoded_bytes, std::memory_order_relaxed)) {
+  }
+}
+
+void RecordsStats::RemoveQueuedChunk(uint64_t decoded_bytes) {
+  queued_chunks_.fetch_sub(1, std::memory_order_relaxed);
+  queued_decoded_bytes_.fetch_sub(decoded_bytes, std::memory_order_relaxed);
+}
+
+void RecordsStats::AddReadAheadStall() {
+  read_ahead_stalls_.fetch_add(1, std::memory_order_relaxed);
+}
+
+RecordsStats::Snapshot RecordsStats::snapshot() const {
+  Snapshot snapshot;
+  snapshot.chunks = chunks_.load(std::memory_order_relaxed);
+  snapshot.records = records_.load(std::memory_order_relaxed);
+  snapshot.encoded_bytes = encoded_bytes_.load(std::memory_order_relaxed);
+  snapshot.decoded_bytes = decoded_bytes_.load(std::memory_order_relaxed);
+  for (size_t stage = 0; stage < kNumStages; ++stage) {
+    const AtomicHistogram& src = stages_[stage];
+    Histogram& dest = snapshot.stages[stage];
+    for (size_t bucket = 0; bucket < Histogram::kNumBuckets; ++bucket) {
+      dest.counts[bucket] = src.counts[bucket].load(std::memory_order_relaxed);
+    }
+    dest.count = src.count.load(std::memory_order_relaxed);
+    dest.sum_nanos = src.sum_nanos.load(std::memory_order_relaxed);
+  }
+  snapshot.queued_chunks = queued_chunks_.load(std::memory_order_relaxed);
+  snapshot.queued_decoded_bytes =
+      queued_decoded_bytes_.load(std::memory_order_relaxed);
+  snapshot.peak_queued_decoded_bytes =
+      peak_queued_decoded_bytes_.load(std::memory_order_relaxed);
+  snapshot.read_ahead_stalls =
+      read_ahead_stalls_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void RecordsStats::Report() const {
+  if (report_ != nullptr) report_(snapshot());
+}
+
+RecordsTracer::~RecordsTracer() {}
+
+}  // namespace riegeli
@@ -0,0 +1,291 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORDS_STATS_H_
+#define RIEGELI_RECORDS_RECORDS_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+class RecordsTracer;
+
+// Counters and histograms of time spent in stages of writing or reading
+// records, collected by `RecordWriter` and `RecordReader` given a
+// `RecordsStats` in their options.
+//
+// Several writers and readers can share a `RecordsStats`, which then sums
+// their counters. It is usually better to share one per kind of work, so that
+// times of writing and of reading are not mixed.
+//
+// `RecordsStats` is thread-safe.
+class RecordsStats {
+ public:
+  // A stage whose time is measured.
+  enum class Stage {
+    // `RecordWriter` with `parallelism() > 0`: waiting until fewer chunks are
+    // being encoded or written in background.
+    //
+    // `RecordReader` with `parallelism() > 0`: waiting until the next chunk is
+    // decoded in background.
+    kQueueWait,
+    // `RecordWriter`: encoding a chunk, including compression.
+    kEncode,
+    // `RecordWriter`: hashing chunk data for the chunk header.
+    kHash,
+    // `RecordWriter`: padding to a block boundary.
+    kPad,
+    // `RecordWriter`: writing chunks to the `ChunkWriter` and flushing it.
+    //
+    // `RecordReader`: reading chunks from the `ChunkReader`, including
+    // verifying their hashes.
+    kIo,
+    // `RecordReader`: decoding a chunk, including decompression.
+    kDecode,
+  };
+  static constexpr size_t kNumStages = 6;
+
+  // Returns a name of `stage` suitable as a metric label, e.g. "queue_wait".
+  static absl::string_view StageName(Stage stage);
+
+  // A histogram of durations in nanoseconds, on a logarithmic scale.
+  //
+  // `counts[i]` is the number of durations in [`UpperBound(i - 1)`..
+  // `UpperBound(i)`), with `UpperBound(-1)` taken as 0. Cumulative sums of
+  // `counts` give buckets of a Prometheus histogram with these upper bounds.
+  struct Histogram {
+    static constexpr size_t kNumBuckets = 40;
+
+    // Returns the exclusive upper bound of bucket `index`, in nanoseconds:
+    // `2^index`, except that the last bucket is unbounded and returns
+    // `UINT64_MAX`.
+    static uint64_t UpperBound(size_t index);
+
+    std::array<uint64_t, kNumBuckets> counts{};
+    uint64_t count = 0;
+    uint64_t sum_nanos = 0;
+  };
+
+  // Values of all counters at some point in time.
+  struct Snapshot {
+    // Returns `encoded_bytes / decoded_bytes`, or 0 if nothing was counted.
+    double compression_ratio() const {
+      return decoded_bytes == 0 ? 0.0
+                                : static_cast<double>(encoded_bytes) /
+                                      static_cast<double>(decoded_bytes);
+    }
+
+    const Histogram& stage(Stage stage) const {
+      return stages[static_cast<size_t>(stage)];
+    }
+
+    // Chunks with records, excluding e.g. file metadata.
+    uint64_t chunks = 0;
+    uint64_t records = 0;
+    // The size of chunks as stored (compressed, including chunk headers), and
+    // the size of their records (uncompressed).
+    //
+    // For `RecordWriter`, `decoded_bytes` are bytes in and `encoded_bytes` are
+    // bytes out. For `RecordReader`, the other way around.
+    uint64_t encoded_bytes = 0;
+    uint64_t decoded_bytes = 0;
+    std::array<Histogram, kNumStages> stages;
+
+    // `RecordReader` with `parallelism() > 0`: chunks read ahead and not
+    // taken yet (either being decoded in background or waiting to be read),
+    // and their decoded size. These are gauges: they go down again when
+    // chunks are taken or discarded.
+    uint64_t queued_chunks = 0;
+    uint64_t queued_decoded_bytes = 0;
+    // `RecordReader` with `parallelism() > 0`: the maximum of
+    // `queued_decoded_bytes` so far.
+    uint64_t peak_queued_decoded_bytes = 0;
+    // `RecordReader` with `parallelism() > 0`: the number of times reading
+    // ahead stopped before `parallelism()` chunks because the next chunk would
+    // exceed `max_decoded_bytes()`, i.e. records were consumed slower than
+    // they could be decoded.
+    uint64_t read_ahead_stalls = 0;
+  };
+
+  // Creates a `RecordsStats` which does not report by itself. Use `snapshot()`
+  // to read it.
+  RecordsStats() noexcept {}
+
+  // Creates a `RecordsStats` which calls `report` from `Report()`, e.g. to
+  // export counters to a monitoring system.
+  //
+  // `report` can be called concurrently from several threads if the
+  // `RecordsStats` is shared.
+  explicit RecordsStats(std::function<void(const Snapshot&)> report)
+      : report_(std::move(report)) {}
+
+  // Creates a `RecordsStats` which also passes spans of stages to `tracer`,
+  // and calls `report` from `Report()` unless it is `nullptr`.
+  //
+  // The `RecordsTracer` is not owned and must outlive the `RecordsStats`.
+  explicit RecordsStats(RecordsTracer* tracer,
+                        std::function<void(const Snapshot&)> report = nullptr)
+      : report_(std::move(report)), tracer_(tracer) {}
+
+  RecordsStats(const RecordsStats&) = delete;
+  RecordsStats& operator=(const RecordsStats&) = delete;
+
+  // Records a chunk with `num_records` records.
+  void AddChunk(uint64_t num_records, uint64_t encoded_bytes,
+                uint64_t decoded_bytes);
+
+  // Records time spent in `stage`.
+  void AddTime(Stage stage, uint64_t nanos);
+
+  // Records a chunk with the given decoded size being read ahead, or being
+  // taken or discarded after it was read ahead.
+  void AddQueuedChunk(uint64_t decoded_bytes);
+  void RemoveQueuedChunk(uint64_t decoded_bytes);
+
+  // Records that reading ahead stopped because of `max_decoded_bytes()`.
+  void AddReadAheadStall();
+
+  // Returns current values of counters. Values added concurrently with taking
+  // the snapshot may be partially included.
+  Snapshot snapshot() const;
+
+  // Calls the function given to the constructor, if any, with `snapshot()`.
+  //
+  // This is called by `Close()` of `RecordWriter` and `RecordReader`, and can
+  // be called at any time, e.g. periodically.
+  void Report() const;
+
+  // Returns the `RecordsTracer` given to the constructor, or `nullptr`.
+  RecordsTracer* tracer() const { return tracer_; }
+
+ private:
+  struct AtomicHistogram {
+    std::array<std::atomic<uint64_t>, Histogram::kNumBuckets> counts{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_nanos{0};
+  };
+
+  std::function<void(const Snapshot&)> report_;
+  RecordsTracer* tracer_ = nullptr;
+  std::atomic<uint64_t> chunks_{0};
+  std::atomic<uint64_t> records_{0};
+  std::atomic<uint64_t> encoded_bytes_{0};
+  std::atomic<uint64_t> decoded_bytes_{0};
+  std::array<AtomicHistogram, kNumStages> stages_;
+  std::atomic<uint64_t> queued_chunks_{0};
+  std::atomic<uint64_t> queued_decoded_bytes_{0};
+  std::atomic<uint64_t> peak_queued_decoded_bytes_{0};
+  std::atomic<uint64_t> read_ahead_stalls_{0};
+};
+
+// Receives spans of stages of writing or reading records, e.g. to emit them
+// as trace events to Perfetto or to the Chrome trace event format, which shows
+// whether background threads of `RecordWriter` and `RecordReader` with
+// `parallelism() > 0` are kept busy.
+//
+// `Begin()` and `End()` of a span are called on the thread which does the
+// work, with nothing else between them on that thread, so they can be mapped
+// directly to nested begin/end events of a thread track. Different threads
+// call them concurrently, so they must be thread-safe.
+//
+// A `RecordsTracer` is attached to a `RecordsStats` with its constructor.
+class RecordsTracer {
+ public:
+  // A span of time spent in a stage.
+  struct Span {
+    RecordsStats::Stage stage;
+    // The position of the chunk being processed, if the stage processes a
+    // chunk with a known position. `RecordWriter` learns the position only
+    // when the chunk is written, so encoding and hashing have no position.
+    absl::optional<Position> chunk_begin;
+    // The size of the chunk as stored (compressed, including the chunk
+    // header), or 0 if unknown. This can be known only in `End()`, e.g. after
+    // encoding or reading.
+    uint64_t chunk_size = 0;
+  };
+
+  RecordsTracer() noexcept {}
+
+  RecordsTracer(const RecordsTracer&) = delete;
+  RecordsTracer& operator=(const RecordsTracer&) = delete;
+
+  virtual ~RecordsTracer();
+
+  // Called when a span begins.
+  virtual void Begin(const Span& span) = 0;
+
+  // Called when a span ends. `span` has the same `stage` and `chunk_begin` as
+  // in `Begin()`, and possibly a `chunk_size` filled in.
+  virtual void End(const Span& span) = 0;
+};
+
+// Implementation details follow.
+
+namespace internal {
+
+// Adds the time spent in its scope to `stats`, and passes it as a span to
+// `stats->tracer()` if any, unless `stats == nullptr`, in which case the clock
+// is not read.
+class StageTimer {
+ public:
+  explicit StageTimer(RecordsStats* stats, RecordsStats::Stage stage,
+                      absl::optional<Position> chunk_begin = absl::nullopt,
+                      uint64_t chunk_size = 0)
+      : stats_(stats), span_{stage, chunk_begin, chunk_size} {
+    if (stats_ != nullptr) {
+      if (stats_->tracer() != nullptr) stats_->tracer()->Begin(span_);
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  StageTimer(const StageTimer&) = delete;
+  StageTimer& operator=(const StageTimer&) = delete;
+
+  ~StageTimer() {
+    if (stats_ != nullptr) {
+      stats_->AddTime(
+          span_.stage,
+          static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start_)
+                  .count()));
+      if (stats_->tracer() != nullptr) stats_->tracer()->End(span_);
+    }
+  }
+
+  // Sets the size of the chunk, passed to `RecordsTracer::End()`.
+  void set_chunk_size(uint64_t chunk_size) { span_.chunk_size = chunk_size; }
+
+ private:
+  RecordsStats* stats_;
+  RecordsTracer::Span span_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace internal
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORDS_STATS_H_
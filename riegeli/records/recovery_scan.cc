@@ -0,0 +1,184 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/records/recovery_scan.h"
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/records/block.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/skipped_region.h"
+
+namespace riegeli {
+
+namespace {
+
+// Verifies chunks beginning in [`range_begin`..`range_end`), appending skipped
+// regions to `skipped_regions`.
+//
+// A chunk beginning in the range is read until its end even if it crosses
+// `range_end`, and so is a skipped region beginning in the range.
+//
+// Precondition: `src.pos() == 0`, so that `DefaultChunkReader` starts at a
+// chunk boundary.
+absl::Status ScanRange(Reader& src, Position range_begin, Position range_end,
+                       bool verify_data_hashes,
+                       std::vector<SkippedRegion>& skipped_regions) {
+  DefaultChunkReader<> chunk_reader(
+      &src, DefaultChunkReaderBase::Options().set_verify_data_hash_every(
+                verify_data_hashes ? 1 : 0));
+  if (range_begin > 0) chunk_reader.SeekToChunkAfter(range_begin);
+  Chunk chunk;
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!chunk_reader.healthy())) {
+      SkippedRegion skipped_region;
+      if (ABSL_PREDICT_FALSE(!chunk_reader.Recover(&skipped_region))) {
+        return chunk_reader.status();
+      }
+      skipped_regions.push_back(std::move(skipped_region));
+      continue;
+    }
+    if (chunk_reader.pos() >= range_end) break;
+    if (!chunk_reader.ReadChunk(chunk) && chunk_reader.healthy()) break;
+  }
+  // `Close()` fails if the file ends inside a chunk.
+  if (ABSL_PREDICT_FALSE(!chunk_reader.Close())) {
+    SkippedRegion skipped_region;
+    if (ABSL_PREDICT_FALSE(!chunk_reader.Recover(&skipped_region))) {
+      return chunk_reader.status();
+    }
+    skipped_regions.push_back(std::move(skipped_region));
+  }
+  return absl::OkStatus();
+}
+
+// Sorts `skipped_regions` and merges overlapping or adjacent regions, keeping
+// the message of the first region.
+void MergeSkippedRegions(std::vector<SkippedRegion>& skipped_regions) {
+  std::sort(skipped_regions.begin(), skipped_regions.end(),
+            [](const SkippedRegion& a, const SkippedRegion& b) {
+              return a.begin() < b.begin();
+            });
+  std::vector<SkippedRegion> merged;
+  for (SkippedRegion& skipped_region : skipped_regions) {
+    if (!merged.empty() && skipped_region.begin() <= merged.back().end()) {
+      if (skipped_region.end() > merged.back().end()) {
+        merged.back() =
+            SkippedRegion(merged.back().begin(), skipped_region.end(),
+                          merged.back().message());
+      }
+      continue;
+    }
+    merged.push_back(std::move(skipped_region));
+  }
+  skipped_regions = std::move(merged);
+}
+
+}  // namespace
+
+absl::Status ScanForSkippedRegions(Reader& src,
+                                   std::vector<SkippedRegion>& skipped_regions,
+                                   const RecoveryScanOptions& options) {
+  skipped_regions.clear();
+  if (options.parallelism() == 0 || !src.SupportsNewReader()) {
+    if (src.pos() != 0 && ABSL_PREDICT_FALSE(!src.Seek(0))) {
+      return src.status();
+    }
+    const absl::Status status =
+        ScanRange(src, 0, std::numeric_limits<Position>::max(),
+                  options.verify_data_hashes(), skipped_regions);
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+    MergeSkippedRegions(skipped_regions);
+    return absl::OkStatus();
+  }
+
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return src.status();
+  const Position range_size = UnsignedMax(
+      options.range_size() - options.range_size() % internal::kBlockSize,
+      internal::kBlockSize);
+  const size_t num_ranges = IntCast<size_t>(
+      UnsignedMax((*size + range_size - 1) / range_size, Position{1}));
+  const size_t num_tasks =
+      UnsignedMin(IntCast<size_t>(options.parallelism()), num_ranges);
+
+  struct RangeResult {
+    absl::Status status;
+    std::vector<SkippedRegion> skipped_regions;
+  };
+  std::vector<RangeResult> results(num_ranges);
+  // Each task has its own `Reader`, created here because `NewReader()` of the
+  // same `Reader` must not be called concurrently. Siblings can be used
+  // concurrently.
+  std::vector<std::unique_ptr<Reader>> readers(num_tasks);
+  for (std::unique_ptr<Reader>& reader : readers) {
+    reader = src.NewReader(0);
+    if (ABSL_PREDICT_FALSE(reader == nullptr)) return src.status();
+  }
+  // Scanning blocks on I/O, hence it does not use the pool used for
+  // computation. The current thread takes part in the work.
+  std::atomic<size_t> next_range(0);
+  internal::ParallelFor(
+      internal::BlockingExecutor::global(), num_tasks, num_tasks,
+      [&](size_t task_index) {
+        Reader& reader = *readers[task_index];
+        for (;;) {
+          const size_t index =
+              next_range.fetch_add(1, std::memory_order_relaxed);
+          if (index >= num_ranges) break;
+          const Position range_begin = IntCast<Position>(index) * range_size;
+          const Position range_end = index == num_ranges - 1
+                                         ? std::numeric_limits<Position>::max()
+                                         : range_begin + range_size;
+          RangeResult& result = results[index];
+          if (ABSL_PREDICT_FALSE(!reader.Seek(0))) {
+            result.status = reader.status();
+            continue;
+          }
+          result.status =
+              ScanRange(reader, range_begin, range_end,
+                        options.verify_data_hashes(), result.skipped_regions);
+        }
+      });
+
+  for (RangeResult& result : results) {
+    if (ABSL_PREDICT_FALSE(!result.status.ok())) {
+      skipped_regions.clear();
+      return result.status;
+    }
+    skipped_regions.insert(
+        skipped_regions.end(),
+        std::make_move_iterator(result.skipped_regions.begin()),
+        std::make_move_iterator(result.skipped_regions.end()));
+  }
+  MergeSkippedRegions(skipped_regions);
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
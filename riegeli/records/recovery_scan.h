@@ -0,0 +1,117 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_RECORDS_RECOVERY_SCAN_H_
+#define RIEGELI_RECORDS_RECOVERY_SCAN_H_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/records/skipped_region.h"
+
+namespace riegeli {
+
+class RecoveryScanOptions {
+ public:
+  RecoveryScanOptions() noexcept {}
+
+  // Maximum number of threads verifying ranges of the file concurrently.
+  //
+  // If 0, the file is verified in the calling thread. Otherwise the source
+  // must support `Reader::NewReader()`, e.g. `FdReader`, and ranges are
+  // verified in the thread pool shared by parallel operations of Riegeli.
+  //
+  // Default: 0.
+  RecoveryScanOptions& set_parallelism(int parallelism) & {
+    RIEGELI_ASSERT_GE(parallelism, 0)
+        << "Failed precondition of "
+           "RecoveryScanOptions::set_parallelism(): "
+           "negative parallelism";
+    parallelism_ = parallelism;
+    return *this;
+  }
+  RecoveryScanOptions&& set_parallelism(int parallelism) && {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+  // If `true`, chunk data hashes are verified. If `false`, only chunk header
+  // hashes and block header hashes are verified, which finds damaged chunk
+  // boundaries faster but misses damage inside chunk data.
+  //
+  // Default: `true`.
+  RecoveryScanOptions& set_verify_data_hashes(bool verify_data_hashes) & {
+    verify_data_hashes_ = verify_data_hashes;
+    return *this;
+  }
+  RecoveryScanOptions&& set_verify_data_hashes(bool verify_data_hashes) && {
+    return std::move(set_verify_data_hashes(verify_data_hashes));
+  }
+  bool verify_data_hashes() const { return verify_data_hashes_; }
+
+  // The file is split into ranges of about `range_size` bytes, each verified
+  // by one thread. Rounded down to a multiple of the 64KB block size.
+  //
+  // Default: `Position{16} << 20` (16M).
+  RecoveryScanOptions& set_range_size(Position range_size) & {
+    RIEGELI_ASSERT_GT(range_size, 0u)
+        << "Failed precondition of "
+           "RecoveryScanOptions::set_range_size(): "
+           "zero range size";
+    range_size_ = range_size;
+    return *this;
+  }
+  RecoveryScanOptions&& set_range_size(Position range_size) && {
+    return std::move(set_range_size(range_size));
+  }
+  Position range_size() const { return range_size_; }
+
+ private:
+  int parallelism_ = 0;
+  bool verify_data_hashes_ = true;
+  Position range_size_ = Position{16} << 20;
+};
+
+// Verifies a whole Riegeli/records file and finds all regions of invalid
+// contents: the regions which `RecordReaderBase::Options::set_recovery()` or
+// `DefaultChunkReaderBase::Recover()` would skip, including an incomplete
+// chunk at the end of the file.
+//
+// The file is split into ranges at block boundaries, which are verified
+// concurrently if `RecoveryScanOptions::parallelism() > 0`: each range starts
+// from the block header at its beginning, so it does not depend on reading
+// preceding ranges. Recovery from damage in one range does not delay other
+// ranges.
+//
+// `skipped_regions` is set to the skipped regions in the order of positions,
+// with overlapping or adjacent regions found by neighboring ranges merged.
+//
+// Return values:
+//  * `absl::OkStatus()` - success (`skipped_regions` is set, empty if the file
+//                         is valid)
+//  * other status       - failure of reading `src`, or of
+//                         `Reader::NewReader()`
+absl::Status ScanForSkippedRegions(
+    Reader& src, std::vector<SkippedRegion>& skipped_regions,
+    const RecoveryScanOptions& options = RecoveryScanOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECOVERY_SCAN_H_
@@ -0,0 +1,376 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/remote_chunk_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/hash.h"
+#include "riegeli/records/block.h"
+#include "riegeli/records/chunk_writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+// Protocol:
+//
+// The receiver first sends the position and the block size of its
+// `ChunkWriter`, each as a varint.
+//
+// Then the sender sends messages, each beginning with a message type:
+//  * `kChunkMessage`: followed by a chunk header and chunk data.
+//  * `kPadMessage`: `PadToBlockBoundary()`.
+//  * `kFlushMessage`: followed by `FlushType` as a byte.
+//  * `kCloseMessage`: the last message.
+//
+// The receiver acknowledges processed messages by sending their number as a
+// positive varint. A failure is sent as varint 0, followed by the status code
+// as a varint, and the status message as a varint length and contents, after
+// which the receiver stops.
+
+namespace {
+
+constexpr char kChunkMessage = 'c';
+constexpr char kPadMessage = 'p';
+constexpr char kFlushMessage = 'f';
+constexpr char kCloseMessage = 'e';
+
+}  // namespace
+
+void RemoteChunkWriterBase::Initialize(Writer* dest, Reader* acks) {
+  RIEGELI_ASSERT(dest != nullptr)
+      << "Failed precondition of RemoteChunkWriter: null Writer pointer";
+  RIEGELI_ASSERT(acks != nullptr)
+      << "Failed precondition of RemoteChunkWriter: null Reader pointer";
+  if (ABSL_PREDICT_FALSE(!dest->healthy())) {
+    FailWithoutAnnotation(dest->status());
+    return;
+  }
+  uint64_t pos;
+  if (ABSL_PREDICT_FALSE(!StreamingReadVarint64(*acks, pos))) {
+    if (ABSL_PREDICT_FALSE(!acks->healthy())) {
+      FailWithoutAnnotation(acks->status());
+      return;
+    }
+    Fail(absl::DataLossError(
+        "Acknowledgements ended before chunk writer position"));
+    return;
+  }
+  uint64_t block_size;
+  if (ABSL_PREDICT_FALSE(!StreamingReadVarint64(*acks, block_size))) {
+    if (ABSL_PREDICT_FALSE(!acks->healthy())) {
+      FailWithoutAnnotation(acks->status());
+      return;
+    }
+    Fail(absl::DataLossError(
+        "Acknowledgements ended before chunk writer block size"));
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(!internal::IsValidBlockSize(block_size))) {
+    Fail(absl::DataLossError(
+        absl::StrCat("Invalid chunk writer block size: ", block_size)));
+    return;
+  }
+  ChunkWriter::Initialize(pos, block_size);
+}
+
+void RemoteChunkWriterBase::Done() {
+  if (ABSL_PREDICT_TRUE(healthy())) {
+    Writer& dest = *dest_writer();
+    Reader& acks = *ack_reader();
+    if (ABSL_PREDICT_TRUE(BeginMessage(dest, acks))) {
+      if (ABSL_PREDICT_FALSE(!dest.WriteChar(kCloseMessage))) {
+        FailWithoutAnnotation(dest.status());
+      } else {
+        ++num_in_flight_;
+        WaitForAcks(0, dest, acks);
+      }
+    }
+  }
+  ChunkWriter::Done();
+}
+
+bool RemoteChunkWriterBase::WriteChunk(const Chunk& chunk) {
+  RIEGELI_ASSERT_EQ(chunk.header.data_hash(), internal::Hash(chunk.data))
+      << "Failed precondition of ChunkWriter::WriteChunk(): "
+         "Wrong chunk data hash";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Writer& dest = *dest_writer();
+  Reader& acks = *ack_reader();
+  if (ABSL_PREDICT_FALSE(!BeginMessage(dest, acks))) return false;
+  if (ABSL_PREDICT_FALSE(!dest.WriteChar(kChunkMessage) ||
+                         !chunk.WriteTo(dest))) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  ++num_in_flight_;
+  // Matches `DefaultChunkWriterBase::WriteChunk()`.
+  UpdateBlockSize(chunk.header);
+  pos_ = internal::ChunkEnd(chunk.header, pos_, block_size_);
+  return ReadAvailableAcks(acks);
+}
+
+bool RemoteChunkWriterBase::PadToBlockBoundary() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  // Matches `DefaultChunkWriterBase::PadToBlockBoundary()`: a padding chunk of
+  // `length` bytes including its header.
+  Position length = internal::RemainingInBlock(pos_, block_size_);
+  if (length == 0) return true;
+  if (length < ChunkHeader::size()) {
+    length += internal::UsableBlockSize(block_size_);
+  }
+  Writer& dest = *dest_writer();
+  Reader& acks = *ack_reader();
+  if (ABSL_PREDICT_FALSE(!BeginMessage(dest, acks))) return false;
+  if (ABSL_PREDICT_FALSE(!dest.WriteChar(kPadMessage))) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  ++num_in_flight_;
+  pos_ = internal::AddWithOverhead(pos_, length, block_size_);
+  return ReadAvailableAcks(acks);
+}
+
+bool RemoteChunkWriterBase::FlushImpl(FlushType flush_type) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Writer& dest = *dest_writer();
+  Reader& acks = *ack_reader();
+  if (ABSL_PREDICT_FALSE(!BeginMessage(dest, acks))) return false;
+  if (ABSL_PREDICT_FALSE(
+          !dest.WriteChar(kFlushMessage) ||
+          !dest.WriteByte(IntCast<uint8_t>(static_cast<int>(flush_type))))) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  ++num_in_flight_;
+  return WaitForAcks(0, dest, acks);
+}
+
+inline bool RemoteChunkWriterBase::BeginMessage(Writer& dest, Reader& acks) {
+  if (num_in_flight_ < max_chunks_in_flight_) return true;
+  return WaitForAcks(max_chunks_in_flight_ - 1, dest, acks);
+}
+
+bool RemoteChunkWriterBase::WaitForAcks(uint64_t max_in_flight, Writer& dest,
+                                        Reader& acks) {
+  if (num_in_flight_ <= max_in_flight) return true;
+  // The receiver acknowledges only messages it has received.
+  if (ABSL_PREDICT_FALSE(!dest.Flush(FlushType::kFromProcess))) {
+    return FailWithoutAnnotation(dest.status());
+  }
+  while (num_in_flight_ > max_in_flight) {
+    if (ABSL_PREDICT_FALSE(!ReadAck(acks))) return false;
+  }
+  return true;
+}
+
+inline bool RemoteChunkWriterBase::ReadAvailableAcks(Reader& acks) {
+  while (acks.available() > 0) {
+    if (ABSL_PREDICT_FALSE(!ReadAck(acks))) return false;
+  }
+  return true;
+}
+
+bool RemoteChunkWriterBase::ReadAck(Reader& acks) {
+  uint64_t num_acknowledged;
+  if (ABSL_PREDICT_FALSE(!StreamingReadVarint64(acks, num_acknowledged))) {
+    if (ABSL_PREDICT_FALSE(!acks.healthy())) {
+      return FailWithoutAnnotation(acks.status());
+    }
+    return Fail(absl::DataLossError(
+        absl::StrCat("Acknowledgements ended with ", num_in_flight_,
+                     " messages in flight")));
+  }
+  if (ABSL_PREDICT_FALSE(num_acknowledged == 0)) {
+    uint64_t code;
+    uint64_t message_size;
+    std::string message;
+    if (ABSL_PREDICT_FALSE(
+            !StreamingReadVarint64(acks, code) ||
+            !StreamingReadVarint64(acks, message_size) ||
+            !acks.Read(IntCast<size_t>(message_size), message))) {
+      if (ABSL_PREDICT_FALSE(!acks.healthy())) {
+        return FailWithoutAnnotation(acks.status());
+      }
+      return Fail(absl::DataLossError("Truncated failure from the receiver"));
+    }
+    return Fail(absl::Status(static_cast<absl::StatusCode>(code),
+                             absl::StrCat("Receiver failed: ", message)));
+  }
+  if (ABSL_PREDICT_FALSE(num_acknowledged > num_in_flight_)) {
+    return Fail(absl::DataLossError(
+        absl::StrCat("Receiver acknowledged ", num_acknowledged,
+                     " messages but only ", num_in_flight_, " are in flight")));
+  }
+  num_in_flight_ -= num_acknowledged;
+  return true;
+}
+
+namespace {
+
+// Reports `status` to the sender, and closes `dest`.
+absl::Status ReceiveFailed(absl::Status status, Writer& acks,
+                           ChunkWriter& dest) {
+  RIEGELI_ASSERT(!status.ok())
+      << "Failed precondition of ReceiveFailed(): status not failed";
+  const absl::string_view message = status.message();
+  if (acks.healthy() && WriteVarint64(0, acks) &&
+      WriteVarint64(static_cast<uint64_t>(status.code()), acks) &&
+      WriteVarint64(message.size(), acks) && acks.Write(message)) {
+    acks.Flush(FlushType::kFromProcess);
+  }
+  dest.Close();
+  return status;
+}
+
+// Sends an acknowledgement of `num_processed` messages.
+inline bool SendAck(uint64_t& num_processed, Writer& acks) {
+  if (ABSL_PREDICT_FALSE(!WriteVarint64(num_processed, acks) ||
+                         !acks.Flush(FlushType::kFromProcess))) {
+    return false;
+  }
+  num_processed = 0;
+  return true;
+}
+
+}  // namespace
+
+absl::Status ReceiveChunks(Reader& src, Writer& acks, ChunkWriter& dest) {
+  if (ABSL_PREDICT_FALSE(!dest.healthy())) {
+    return ReceiveFailed(dest.status(), acks, dest);
+  }
+  if (ABSL_PREDICT_FALSE(!WriteVarint64(dest.pos(), acks) ||
+                         !WriteVarint64(dest.block_size(), acks) ||
+                         !acks.Flush(FlushType::kFromProcess))) {
+    dest.Close();
+    return acks.status();
+  }
+  uint64_t num_processed = 0;
+  Chunk chunk;
+  for (;;) {
+    // Acknowledge before the next read would wait for the sender, so that the
+    // sender is not kept waiting in turn.
+    if (num_processed > 0 && src.available() == 0) {
+      if (ABSL_PREDICT_FALSE(!SendAck(num_processed, acks))) {
+        dest.Close();
+        return acks.status();
+      }
+    }
+    char message_type;
+    if (ABSL_PREDICT_FALSE(!src.ReadChar(message_type))) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) {
+        return ReceiveFailed(src.status(), acks, dest);
+      }
+      // The sender went away without closing. Chunks written so far are
+      // complete.
+      if (ABSL_PREDICT_FALSE(!dest.Close())) return dest.status();
+      return absl::OkStatus();
+    }
+    switch (message_type) {
+      case kChunkMessage: {
+        if (ABSL_PREDICT_FALSE(
+                !src.Read(chunk.header.size(), chunk.header.bytes()))) {
+          return ReceiveFailed(
+              src.healthy() ? absl::DataLossError("Truncated chunk header")
+                            : src.status(),
+              acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(chunk.header.computed_header_hash() !=
+                               chunk.header.stored_header_hash())) {
+          return ReceiveFailed(absl::DataLossError(absl::StrCat(
+                                   "Corrupted chunk header at position ",
+                                   dest.pos(), ": header hash mismatch")),
+                               acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(!src.Read(
+                IntCast<size_t>(chunk.header.data_size()), chunk.data))) {
+          return ReceiveFailed(
+              src.healthy() ? absl::DataLossError("Truncated chunk data")
+                            : src.status(),
+              acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(internal::Hash(chunk.data) !=
+                               chunk.header.data_hash())) {
+          return ReceiveFailed(absl::DataLossError(absl::StrCat(
+                                   "Corrupted chunk data at position ",
+                                   dest.pos(), ": data hash mismatch")),
+                               acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(!dest.WriteChunk(chunk))) {
+          return ReceiveFailed(dest.status(), acks, dest);
+        }
+        break;
+      }
+      case kPadMessage:
+        if (ABSL_PREDICT_FALSE(!dest.PadToBlockBoundary())) {
+          return ReceiveFailed(dest.status(), acks, dest);
+        }
+        break;
+      case kFlushMessage: {
+        uint8_t flush_type;
+        if (ABSL_PREDICT_FALSE(!src.ReadByte(flush_type))) {
+          return ReceiveFailed(
+              src.healthy() ? absl::DataLossError("Truncated flush message")
+                            : src.status(),
+              acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(
+                flush_type >
+                static_cast<int>(FlushType::kFromMachine))) {
+          return ReceiveFailed(
+              absl::DataLossError(
+                  absl::StrCat("Invalid flush type: ", flush_type)),
+              acks, dest);
+        }
+        if (ABSL_PREDICT_FALSE(
+                !dest.Flush(static_cast<FlushType>(flush_type)))) {
+          return ReceiveFailed(dest.status(), acks, dest);
+        }
+        // The sender waits for this acknowledgement.
+        ++num_processed;
+        if (ABSL_PREDICT_FALSE(!SendAck(num_processed, acks))) {
+          dest.Close();
+          return acks.status();
+        }
+        continue;
+      }
+      case kCloseMessage:
+        if (ABSL_PREDICT_FALSE(!dest.Close())) {
+          return ReceiveFailed(dest.status(), acks, dest);
+        }
+        ++num_processed;
+        if (ABSL_PREDICT_FALSE(!SendAck(num_processed, acks))) {
+          return acks.status();
+        }
+        return absl::OkStatus();
+      default:
+        return ReceiveFailed(
+            absl::DataLossError(absl::StrCat(
+                "Invalid message type: ", static_cast<int>(message_type))),
+            acks, dest);
+    }
+    ++num_processed;
+  }
+}
+
+}  // namespace riegeli
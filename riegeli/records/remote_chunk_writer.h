@@ -0,0 +1,389 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_REMOTE_CHUNK_WRITER_H_
+#define RIEGELI_RECORDS_REMOTE_CHUNK_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/records/chunk_writer.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `RemoteChunkWriter`.
+class RemoteChunkWriterBase : public ChunkWriter {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // The maximum number of messages sent but not yet acknowledged by the
+    // receiver. When it is reached, `WriteChunk()` waits for an
+    // acknowledgement.
+    //
+    // A larger value keeps the connection busy despite its latency, at the
+    // cost of more data which are written but not known to be received.
+    //
+    // Default: 64.
+    Options& set_max_chunks_in_flight(size_t max_chunks_in_flight) & {
+      RIEGELI_ASSERT_GT(max_chunks_in_flight, 0u)
+          << "Failed precondition of "
+             "RemoteChunkWriterBase::Options::set_max_chunks_in_flight(): "
+             "zero chunks";
+      max_chunks_in_flight_ = max_chunks_in_flight;
+      return *this;
+    }
+    Options&& set_max_chunks_in_flight(size_t max_chunks_in_flight) && {
+      return std::move(set_max_chunks_in_flight(max_chunks_in_flight));
+    }
+    size_t max_chunks_in_flight() const { return max_chunks_in_flight_; }
+
+   private:
+    size_t max_chunks_in_flight_ = 64;
+  };
+
+  // Returns the byte `Writer` which messages are sent to. Unchanged by
+  // `Close()`.
+  virtual Writer* dest_writer() = 0;
+  virtual const Writer* dest_writer() const = 0;
+
+  // Returns the byte `Reader` which acknowledgements are received from.
+  // Unchanged by `Close()`.
+  virtual Reader* ack_reader() = 0;
+  virtual const Reader* ack_reader() const = 0;
+
+  bool WriteChunk(const Chunk& chunk) override;
+  bool PadToBlockBoundary() override;
+
+ protected:
+  explicit RemoteChunkWriterBase(Closed) noexcept : ChunkWriter(kClosed) {}
+
+  explicit RemoteChunkWriterBase(size_t max_chunks_in_flight);
+
+  RemoteChunkWriterBase(RemoteChunkWriterBase&& that) noexcept;
+  RemoteChunkWriterBase& operator=(RemoteChunkWriterBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(size_t max_chunks_in_flight);
+  void Initialize(Writer* dest, Reader* acks);
+
+  void Done() override;
+  bool FlushImpl(FlushType flush_type) override;
+
+ private:
+  // Makes room for one more message in flight.
+  bool BeginMessage(Writer& dest, Reader& acks);
+
+  // Sends buffered messages and processes acknowledgements until at most
+  // `max_in_flight` messages are in flight.
+  bool WaitForAcks(uint64_t max_in_flight, Writer& dest, Reader& acks);
+
+  // Processes acknowledgements which were already received, without waiting.
+  bool ReadAvailableAcks(Reader& acks);
+
+  // Reads and processes one acknowledgement.
+  bool ReadAck(Reader& acks);
+
+  size_t max_chunks_in_flight_ = 0;
+  uint64_t num_in_flight_ = 0;
+};
+
+// A `ChunkWriter` which sends encoded chunks to a remote `ChunkWriter`, e.g.
+// over a connection made of a `SocketWriter` and a `SocketReader`. The remote
+// side runs `ReceiveChunks()`, which writes the chunks to its `ChunkWriter`,
+// typically a `DefaultChunkWriter`, after verifying their hashes.
+//
+// This replicates a Riegeli/records file without encoding or decoding records
+// on the receiving side: `RecordWriter` can write to a `RemoteChunkWriter`
+// (see `chunk_writer_dependency.h`), and `RecordReader` can read the file
+// written by the remote side.
+//
+// Many chunks are kept in flight: `WriteChunk()` does not wait for the chunk to
+// be written remotely. `Flush()` and `Close()` wait until all chunks are
+// written remotely and the remote `ChunkWriter` is flushed or closed.
+// A failure reported by the receiver fails the `RemoteChunkWriter`.
+//
+// `pos()` tracks the position of the remote `ChunkWriter`, which is received
+// when the `RemoteChunkWriter` is opened.
+//
+// The `Dest` template parameter specifies the type of the object providing and
+// possibly owning the byte `Writer` which messages are sent to. `Dest` must
+// support `Dependency<Writer*, Dest>`, e.g. `Writer*` (not owned, default),
+// `std::unique_ptr<Writer>` (owned), `SocketWriter<>` (owned).
+//
+// The `AckSrc` template parameter specifies the type of the object providing
+// and possibly owning the byte `Reader` which acknowledgements are received
+// from. `AckSrc` must support `Dependency<Reader*, AckSrc>`, e.g. `Reader*`
+// (not owned, default), `std::unique_ptr<Reader>` (owned), `SocketReader<>`
+// (owned).
+//
+// By relying on CTAD the template arguments can be deduced as the value types
+// of the first two constructor arguments. This requires C++17.
+//
+// The byte `Writer` and `Reader` must not be accessed until the
+// `RemoteChunkWriter` is closed or no longer used.
+template <typename Dest = Writer*, typename AckSrc = Reader*>
+class RemoteChunkWriter : public RemoteChunkWriterBase {
+ public:
+  // Creates a closed `RemoteChunkWriter`.
+  explicit RemoteChunkWriter(Closed) noexcept
+      : RemoteChunkWriterBase(kClosed) {}
+
+  // Will send messages to the byte `Writer` provided by `dest`, and receive
+  // acknowledgements from the byte `Reader` provided by `acks`.
+  //
+  // Waits for the receiver to report the position and the block size of its
+  // `ChunkWriter`.
+  explicit RemoteChunkWriter(const Dest& dest, const AckSrc& acks,
+                             Options options = Options());
+  explicit RemoteChunkWriter(Dest&& dest, AckSrc&& acks,
+                             Options options = Options());
+
+  // Will send messages to the byte `Writer` provided by a `Dest` constructed
+  // from elements of `dest_args`, and receive acknowledgements from the byte
+  // `Reader` provided by an `AckSrc` constructed from elements of `ack_args`.
+  // This avoids constructing temporaries and moving from them.
+  template <typename... DestArgs, typename... AckSrcArgs>
+  explicit RemoteChunkWriter(std::tuple<DestArgs...> dest_args,
+                             std::tuple<AckSrcArgs...> ack_args,
+                             Options options = Options());
+
+  RemoteChunkWriter(RemoteChunkWriter&& that) noexcept;
+  RemoteChunkWriter& operator=(RemoteChunkWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `RemoteChunkWriter`. This
+  // avoids constructing a temporary `RemoteChunkWriter` and moving from it.
+  void Reset(Closed);
+  void Reset(const Dest& dest, const AckSrc& acks, Options options = Options());
+  void Reset(Dest&& dest, AckSrc&& acks, Options options = Options());
+  template <typename... DestArgs, typename... AckSrcArgs>
+  void Reset(std::tuple<DestArgs...> dest_args,
+             std::tuple<AckSrcArgs...> ack_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the byte `Writer` which
+  // messages are sent to. Unchanged by `Close()`.
+  Dest& dest() { return dest_.manager(); }
+  const Dest& dest() const { return dest_.manager(); }
+  Writer* dest_writer() override { return dest_.get(); }
+  const Writer* dest_writer() const override { return dest_.get(); }
+
+  // Returns the object providing and possibly owning the byte `Reader` which
+  // acknowledgements are received from. Unchanged by `Close()`.
+  AckSrc& acks() { return acks_.manager(); }
+  const AckSrc& acks() const { return acks_.manager(); }
+  Reader* ack_reader() override { return acks_.get(); }
+  const Reader* ack_reader() const override { return acks_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  Dependency<Writer*, Dest> dest_;
+  Dependency<Reader*, AckSrc> acks_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit RemoteChunkWriter(Closed)
+    ->RemoteChunkWriter<DeleteCtad<Closed>, DeleteCtad<Closed>>;
+template <typename Dest, typename AckSrc>
+explicit RemoteChunkWriter(const Dest& dest, const AckSrc& acks,
+                           RemoteChunkWriterBase::Options options =
+                               RemoteChunkWriterBase::Options())
+    -> RemoteChunkWriter<std::decay_t<Dest>, std::decay_t<AckSrc>>;
+template <typename Dest, typename AckSrc>
+explicit RemoteChunkWriter(Dest&& dest, AckSrc&& acks,
+                           RemoteChunkWriterBase::Options options =
+                               RemoteChunkWriterBase::Options())
+    -> RemoteChunkWriter<std::decay_t<Dest>, std::decay_t<AckSrc>>;
+template <typename... DestArgs, typename... AckSrcArgs>
+explicit RemoteChunkWriter(std::tuple<DestArgs...> dest_args,
+                           std::tuple<AckSrcArgs...> ack_args,
+                           RemoteChunkWriterBase::Options options =
+                               RemoteChunkWriterBase::Options())
+    -> RemoteChunkWriter<DeleteCtad<std::tuple<DestArgs...>>,
+                         DeleteCtad<std::tuple<AckSrcArgs...>>>;
+#endif
+
+// The receiving side of `RemoteChunkWriter`: reads messages from `src`, writes
+// chunks to `dest`, and sends acknowledgements to `acks`.
+//
+// The header hash and the data hash of each chunk are verified before it is
+// written. Chunks are not decoded.
+//
+// Acknowledgements are sent whenever all received messages have been
+// processed, so that the sender can keep many chunks in flight without an
+// acknowledgement per chunk.
+//
+// Returns when the `RemoteChunkWriter` is closed, when `src` ends, or on
+// failure, which is reported to the sender if possible. `dest` is closed in
+// any case. `src` and `acks` are not closed.
+absl::Status ReceiveChunks(Reader& src, Writer& acks, ChunkWriter& dest);
+
+// Implementation details follow.
+
+inline RemoteChunkWriterBase::RemoteChunkWriterBase(
+    size_t max_chunks_in_flight)
+    : max_chunks_in_flight_(max_chunks_in_flight) {}
+
+inline RemoteChunkWriterBase::RemoteChunkWriterBase(
+    RemoteChunkWriterBase&& that) noexcept
+    : ChunkWriter(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      max_chunks_in_flight_(that.max_chunks_in_flight_),
+      num_in_flight_(std::exchange(that.num_in_flight_, 0)) {}
+
+inline RemoteChunkWriterBase& RemoteChunkWriterBase::operator=(
+    RemoteChunkWriterBase&& that) noexcept {
+  ChunkWriter::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  max_chunks_in_flight_ = that.max_chunks_in_flight_;
+  num_in_flight_ = std::exchange(that.num_in_flight_, 0);
+  return *this;
+}
+
+inline void RemoteChunkWriterBase::Reset(Closed) {
+  ChunkWriter::Reset(kClosed);
+  max_chunks_in_flight_ = 0;
+  num_in_flight_ = 0;
+}
+
+inline void RemoteChunkWriterBase::Reset(size_t max_chunks_in_flight) {
+  ChunkWriter::Reset();
+  max_chunks_in_flight_ = max_chunks_in_flight;
+  num_in_flight_ = 0;
+}
+
+template <typename Dest, typename AckSrc>
+inline RemoteChunkWriter<Dest, AckSrc>::RemoteChunkWriter(const Dest& dest,
+                                                          const AckSrc& acks,
+                                                          Options options)
+    : RemoteChunkWriterBase(options.max_chunks_in_flight()),
+      dest_(dest),
+      acks_(acks) {
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+inline RemoteChunkWriter<Dest, AckSrc>::RemoteChunkWriter(Dest&& dest,
+                                                          AckSrc&& acks,
+                                                          Options options)
+    : RemoteChunkWriterBase(options.max_chunks_in_flight()),
+      dest_(std::move(dest)),
+      acks_(std::move(acks)) {
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+template <typename... DestArgs, typename... AckSrcArgs>
+inline RemoteChunkWriter<Dest, AckSrc>::RemoteChunkWriter(
+    std::tuple<DestArgs...> dest_args, std::tuple<AckSrcArgs...> ack_args,
+    Options options)
+    : RemoteChunkWriterBase(options.max_chunks_in_flight()),
+      dest_(std::move(dest_args)),
+      acks_(std::move(ack_args)) {
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+inline RemoteChunkWriter<Dest, AckSrc>::RemoteChunkWriter(
+    RemoteChunkWriter&& that) noexcept
+    : RemoteChunkWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      dest_(std::move(that.dest_)),
+      acks_(std::move(that.acks_)) {}
+
+template <typename Dest, typename AckSrc>
+inline RemoteChunkWriter<Dest, AckSrc>&
+RemoteChunkWriter<Dest, AckSrc>::operator=(RemoteChunkWriter&& that) noexcept {
+  RemoteChunkWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  dest_ = std::move(that.dest_);
+  acks_ = std::move(that.acks_);
+  return *this;
+}
+
+template <typename Dest, typename AckSrc>
+inline void RemoteChunkWriter<Dest, AckSrc>::Reset(Closed) {
+  RemoteChunkWriterBase::Reset(kClosed);
+  dest_.Reset();
+  acks_.Reset();
+}
+
+template <typename Dest, typename AckSrc>
+inline void RemoteChunkWriter<Dest, AckSrc>::Reset(const Dest& dest,
+                                                   const AckSrc& acks,
+                                                   Options options) {
+  RemoteChunkWriterBase::Reset(options.max_chunks_in_flight());
+  dest_.Reset(dest);
+  acks_.Reset(acks);
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+inline void RemoteChunkWriter<Dest, AckSrc>::Reset(Dest&& dest, AckSrc&& acks,
+                                                   Options options) {
+  RemoteChunkWriterBase::Reset(options.max_chunks_in_flight());
+  dest_.Reset(std::move(dest));
+  acks_.Reset(std::move(acks));
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+template <typename... DestArgs, typename... AckSrcArgs>
+inline void RemoteChunkWriter<Dest, AckSrc>::Reset(
+    std::tuple<DestArgs...> dest_args, std::tuple<AckSrcArgs...> ack_args,
+    Options options) {
+  RemoteChunkWriterBase::Reset(options.max_chunks_in_flight());
+  dest_.Reset(std::move(dest_args));
+  acks_.Reset(std::move(ack_args));
+  Initialize(dest_.get(), acks_.get());
+}
+
+template <typename Dest, typename AckSrc>
+void RemoteChunkWriter<Dest, AckSrc>::Done() {
+  RemoteChunkWriterBase::Done();
+  if (dest_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!dest_->Close())) {
+      FailWithoutAnnotation(dest_->status());
+    }
+  }
+  if (acks_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!acks_->Close())) {
+      FailWithoutAnnotation(acks_->status());
+    }
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_REMOTE_CHUNK_WRITER_H_
@@ -0,0 +1,136 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/sharded_record_writer.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/hash.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+void ShardedRecordWriter::Done() {
+  // Finish pending work of all streams before waiting for any of them, so that
+  // with `parallelism() > 0` shards are closed in parallel.
+  std::vector<RecordWriterBase::FutureBool> flushed;
+  flushed.reserve(streams_.size());
+  for (Stream& stream : streams_) {
+    if (stream.writer.is_open()) {
+      flushed.push_back(stream.writer.FutureFlush(FlushType::kFromObject));
+    }
+  }
+  for (const RecordWriterBase::FutureBool& flush_ok : flushed) flush_ok.wait();
+  for (size_t stream = 0; stream < streams_.size(); ++stream) {
+    if (streams_[stream].writer.is_open()) CloseShard(stream);
+  }
+}
+
+size_t ShardedRecordWriter::StreamForKey(absl::string_view key) const {
+  if (streams_.size() == 1) return 0;
+  return IntCast<size_t>(internal::Hash(key) % streams_.size());
+}
+
+RecordWriterBase* ShardedRecordWriter::ShardForRecord(size_t stream) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
+  RIEGELI_ASSERT_LT(stream, streams_.size())
+      << "Failed precondition of ShardedRecordWriter::ShardForRecord(): "
+         "stream index out of range";
+  if (streams_[stream].writer.is_open() &&
+      ShouldCloseShard(streams_[stream])) {
+    if (ABSL_PREDICT_FALSE(!CloseShard(stream))) return nullptr;
+  }
+  if (!streams_[stream].writer.is_open()) {
+    if (ABSL_PREDICT_FALSE(!OpenShard(stream))) return nullptr;
+  }
+  return &streams_[stream].writer;
+}
+
+inline bool ShardedRecordWriter::ShouldCloseShard(const Stream& stream) const {
+  return stream.num_records >= options_.max_shard_records() ||
+         stream.writer.EstimatedSize() >= options_.max_shard_size() ||
+         (options_.max_shard_duration() < absl::InfiniteDuration() &&
+          absl::Now() - stream.shard_start >= options_.max_shard_duration());
+}
+
+bool ShardedRecordWriter::OpenShard(size_t stream) {
+  Stream& shard = streams_[stream];
+  std::unique_ptr<Writer> dest = NewShardWriter(stream, shard.shard_index);
+  if (ABSL_PREDICT_FALSE(dest == nullptr)) {
+    RIEGELI_ASSERT(!healthy())
+        << "Failed postcondition of ShardedRecordWriter::NewShardWriter(): "
+           "nullptr returned but ShardedRecordWriter healthy";
+    return false;
+  }
+  shard.writer.Reset(std::move(dest), options_.record_writer_options());
+  shard.num_records = 0;
+  if (options_.max_shard_duration() < absl::InfiniteDuration()) {
+    shard.shard_start = absl::Now();
+  }
+  if (ABSL_PREDICT_FALSE(!shard.writer.healthy())) {
+    return FailWithoutAnnotation(shard.writer.status());
+  }
+  return true;
+}
+
+bool ShardedRecordWriter::CloseShard(size_t stream) {
+  Stream& shard = streams_[stream];
+  ++shard.shard_index;
+  if (ABSL_PREDICT_FALSE(!shard.writer.Close())) {
+    return FailWithoutAnnotation(shard.writer.status());
+  }
+  return true;
+}
+
+bool ShardedRecordWriter::RecordWritten(size_t stream, bool write_ok) {
+  Stream& shard = streams_[stream];
+  if (ABSL_PREDICT_FALSE(!write_ok)) {
+    return FailWithoutAnnotation(shard.writer.status());
+  }
+  ++shard.num_records;
+  return true;
+}
+
+bool ShardedRecordWriter::Flush(FlushType flush_type) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  std::vector<std::pair<size_t, RecordWriterBase::FutureBool>> flushed;
+  flushed.reserve(streams_.size());
+  for (size_t stream = 0; stream < streams_.size(); ++stream) {
+    if (streams_[stream].writer.is_open()) {
+      flushed.emplace_back(stream,
+                           streams_[stream].writer.FutureFlush(flush_type));
+    }
+  }
+  bool flush_ok = true;
+  for (const std::pair<size_t, RecordWriterBase::FutureBool>& stream_flushed :
+       flushed) {
+    if (ABSL_PREDICT_FALSE(!stream_flushed.second.get()) && flush_ok) {
+      flush_ok = FailWithoutAnnotation(
+          streams_[stream_flushed.first].writer.status());
+    }
+  }
+  return flush_ok;
+}
+
+}  // namespace riegeli
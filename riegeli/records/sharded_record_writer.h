@@ -0,0 +1,302 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_SHARDED_RECORD_WRITER_H_
+#define RIEGELI_RECORDS_SHARDED_RECORD_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// Abstract class of an object which writes records to a sequence of
+// Riegeli/records files called shards. A shard is closed and the next shard is
+// opened when the current shard reaches a limit of its size, its number of
+// records, or its age.
+//
+// Each shard is a complete Riegeli/records file written by a `RecordWriter`
+// with `Options::record_writer_options()`, beginning with the file signature
+// and metadata.
+//
+// Records can be routed by key to one of `Options::num_streams()` streams,
+// each with its own sequence of shards. Records with the same key are written
+// to the same stream in the order of writing. If
+// `Options::record_writer_options().parallelism() > 0`, streams are encoded and
+// written in parallel.
+//
+// A derived class provides the destination of each shard by overriding
+// `NewShardWriter()`.
+class ShardedRecordWriter : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // The number of streams which records are routed to by key.
+    //
+    // Default: 1.
+    Options& set_num_streams(size_t num_streams) & {
+      RIEGELI_ASSERT_GT(num_streams, 0u)
+          << "Failed precondition of "
+             "ShardedRecordWriter::Options::set_num_streams(): "
+             "zero number of streams";
+      num_streams_ = num_streams;
+      return *this;
+    }
+    Options&& set_num_streams(size_t num_streams) && {
+      return std::move(set_num_streams(num_streams));
+    }
+    size_t num_streams() const { return num_streams_; }
+
+    // The shard is closed before writing a record when
+    // `RecordWriterBase::EstimatedSize()` reaches `max_shard_size`.
+    //
+    // This is an underestimation of the shard size, so the shard can exceed
+    // `max_shard_size` by about a chunk.
+    //
+    // Default: `std::numeric_limits<Position>::max()`.
+    Options& set_max_shard_size(Position max_shard_size) & {
+      RIEGELI_ASSERT_GT(max_shard_size, 0u)
+          << "Failed precondition of "
+             "ShardedRecordWriter::Options::set_max_shard_size(): "
+             "zero shard size";
+      max_shard_size_ = max_shard_size;
+      return *this;
+    }
+    Options&& set_max_shard_size(Position max_shard_size) && {
+      return std::move(set_max_shard_size(max_shard_size));
+    }
+    Position max_shard_size() const { return max_shard_size_; }
+
+    // The shard is closed before writing a record when it already has
+    // `max_shard_records` records.
+    //
+    // Default: `std::numeric_limits<uint64_t>::max()`.
+    Options& set_max_shard_records(uint64_t max_shard_records) & {
+      RIEGELI_ASSERT_GT(max_shard_records, 0u)
+          << "Failed precondition of "
+             "ShardedRecordWriter::Options::set_max_shard_records(): "
+             "zero number of records";
+      max_shard_records_ = max_shard_records;
+      return *this;
+    }
+    Options&& set_max_shard_records(uint64_t max_shard_records) && {
+      return std::move(set_max_shard_records(max_shard_records));
+    }
+    uint64_t max_shard_records() const { return max_shard_records_; }
+
+    // The shard is closed before writing a record when `max_shard_duration`
+    // passed since the shard was opened.
+    //
+    // Default: `absl::InfiniteDuration()`.
+    Options& set_max_shard_duration(absl::Duration max_shard_duration) & {
+      max_shard_duration_ = max_shard_duration;
+      return *this;
+    }
+    Options&& set_max_shard_duration(absl::Duration max_shard_duration) && {
+      return std::move(set_max_shard_duration(max_shard_duration));
+    }
+    absl::Duration max_shard_duration() const { return max_shard_duration_; }
+
+    // Options for `RecordWriter`s of shards, including metadata written to
+    // each shard.
+    //
+    // Default: `RecordWriterBase::Options()`.
+    Options& set_record_writer_options(
+        RecordWriterBase::Options record_writer_options) & {
+      record_writer_options_ = std::move(record_writer_options);
+      return *this;
+    }
+    Options&& set_record_writer_options(
+        RecordWriterBase::Options record_writer_options) && {
+      return std::move(
+          set_record_writer_options(std::move(record_writer_options)));
+    }
+    RecordWriterBase::Options& record_writer_options() {
+      return record_writer_options_;
+    }
+    const RecordWriterBase::Options& record_writer_options() const {
+      return record_writer_options_;
+    }
+
+   private:
+    size_t num_streams_ = 1;
+    Position max_shard_size_ = std::numeric_limits<Position>::max();
+    uint64_t max_shard_records_ = std::numeric_limits<uint64_t>::max();
+    absl::Duration max_shard_duration_ = absl::InfiniteDuration();
+    RecordWriterBase::Options record_writer_options_;
+  };
+
+  // Returns the number of streams.
+  size_t num_streams() const { return streams_.size(); }
+
+  // Writes the next record to stream 0, or to the stream selected by `key`.
+  //
+  // The stream of a key is determined by a hash of the key which is stable
+  // across processes, so the same key is written to the same stream as long as
+  // `Options::num_streams()` is the same.
+  //
+  // `record` is anything accepted by `RecordWriterBase::WriteRecord()`.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  template <typename Record>
+  bool WriteRecord(Record&& record);
+  template <typename Record>
+  bool WriteRecordWithKey(absl::string_view key, Record&& record);
+
+  // Flushes open shards of all streams, like `RecordWriterBase::Flush()`.
+  //
+  // If `Options::record_writer_options().parallelism() > 0`, shards are
+  // flushed in parallel.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Flush(FlushType flush_type = FlushType::kFromProcess);
+
+ protected:
+  explicit ShardedRecordWriter(Closed) noexcept : Object(kClosed) {}
+
+  explicit ShardedRecordWriter(Options options = Options());
+
+  ShardedRecordWriter(ShardedRecordWriter&& that) noexcept;
+  ShardedRecordWriter& operator=(ShardedRecordWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `ShardedRecordWriter`.
+  // This avoids constructing a temporary `ShardedRecordWriter` and moving from
+  // it. Derived classes which redefine `Reset()` should include a call to
+  // `ShardedRecordWriter::Reset()`.
+  void Reset(Closed);
+  void Reset(Options options = Options());
+
+  // Closes open shards. Derived classes which override `Done()` should call
+  // `ShardedRecordWriter::Done()` before releasing resources used by
+  // `NewShardWriter()`.
+  void Done() override;
+
+  // Returns the destination of the shard with index `shard_index` (counting
+  // from 0) of `stream`. It is called when the first record of the shard is
+  // written.
+  //
+  // Return values:
+  //  * non-null  - success
+  //  * `nullptr` - failure (`!healthy()`)
+  virtual std::unique_ptr<Writer> NewShardWriter(size_t stream,
+                                                 uint64_t shard_index) = 0;
+
+ private:
+  struct Stream {
+    Stream() noexcept : writer(kClosed) {}
+
+    // The `RecordWriter` of the current shard, reused between shards.
+    RecordWriter<std::unique_ptr<Writer>> writer;
+    // The index of the current shard if `writer.is_open()`, or of the next
+    // shard otherwise.
+    uint64_t shard_index = 0;
+    // The number of records written to the current shard.
+    uint64_t num_records = 0;
+    // When the current shard was opened, if
+    // `options_.max_shard_duration() < absl::InfiniteDuration()`.
+    absl::Time shard_start;
+  };
+
+  // Returns the index of the stream selected by `key`.
+  size_t StreamForKey(absl::string_view key) const;
+  // Returns the `RecordWriter` of an open shard of the stream with the given
+  // index, which can accept the next record, or `nullptr` on failure
+  // (`!healthy()`).
+  RecordWriterBase* ShardForRecord(size_t stream);
+  bool ShouldCloseShard(const Stream& stream) const;
+  bool OpenShard(size_t stream);
+  bool CloseShard(size_t stream);
+  // Called after writing a record to the stream with the given index.
+  bool RecordWritten(size_t stream, bool write_ok);
+
+  Options options_;
+  std::vector<Stream> streams_;
+};
+
+// Implementation details follow.
+
+inline ShardedRecordWriter::ShardedRecordWriter(Options options)
+    : options_(std::move(options)), streams_(options_.num_streams()) {}
+
+inline ShardedRecordWriter::ShardedRecordWriter(
+    ShardedRecordWriter&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      options_(std::move(that.options_)),
+      streams_(std::move(that.streams_)) {}
+
+inline ShardedRecordWriter& ShardedRecordWriter::operator=(
+    ShardedRecordWriter&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  options_ = std::move(that.options_);
+  streams_ = std::move(that.streams_);
+  return *this;
+}
+
+inline void ShardedRecordWriter::Reset(Closed) {
+  Object::Reset(kClosed);
+  options_ = Options();
+  streams_.clear();
+}
+
+inline void ShardedRecordWriter::Reset(Options options) {
+  Object::Reset();
+  options_ = std::move(options);
+  streams_.clear();
+  streams_.resize(options_.num_streams());
+}
+
+template <typename Record>
+inline bool ShardedRecordWriter::WriteRecord(Record&& record) {
+  RecordWriterBase* const writer = ShardForRecord(0);
+  if (ABSL_PREDICT_FALSE(writer == nullptr)) return false;
+  return RecordWritten(0, writer->WriteRecord(std::forward<Record>(record)));
+}
+
+template <typename Record>
+inline bool ShardedRecordWriter::WriteRecordWithKey(absl::string_view key,
+                                                    Record&& record) {
+  const size_t stream = StreamForKey(key);
+  RecordWriterBase* const writer = ShardForRecord(stream);
+  if (ABSL_PREDICT_FALSE(writer == nullptr)) return false;
+  return RecordWritten(stream,
+                       writer->WriteRecord(std::forward<Record>(record)));
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_SHARDED_RECORD_WRITER_H_
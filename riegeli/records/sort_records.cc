@@ -0,0 +1,212 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/sort_records.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/records/key_index.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+SortRunStorage::~SortRunStorage() {}
+
+void SortRunStorage::DeleteRun(ABSL_ATTRIBUTE_UNUSED uint64_t run) {}
+
+namespace {
+
+// Returns indices of `records` in the order of their keys. Records with equal
+// keys are ordered by their indices.
+std::vector<size_t> SortedOrder(const RecordKeyFunction& record_key,
+                                const std::vector<std::string>& records) {
+  std::vector<std::pair<absl::string_view, size_t>> keys;
+  keys.reserve(records.size());
+  for (size_t index = 0; index < records.size(); ++index) {
+    keys.emplace_back(RecordKey(record_key, records[index]), index);
+  }
+  std::sort(keys.begin(), keys.end());
+  std::vector<size_t> order;
+  order.reserve(keys.size());
+  for (const std::pair<absl::string_view, size_t>& key : keys) {
+    order.push_back(key.second);
+  }
+  return order;
+}
+
+absl::Status WriteSorted(const std::vector<size_t>& order,
+                         const std::vector<std::string>& records,
+                         RecordWriterBase& dest) {
+  for (const size_t index : order) {
+    if (ABSL_PREDICT_FALSE(
+            !dest.WriteRecord(absl::string_view(records[index])))) {
+      return dest.status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+// A run being merged, with its current record.
+struct MergeSource {
+  explicit MergeSource(std::unique_ptr<Reader> src,
+                       RecordReaderBase::Options options)
+      : reader(std::move(src), std::move(options)) {}
+
+  RecordReader<std::unique_ptr<Reader>> reader;
+  // Valid until the next record is read from `reader`.
+  absl::string_view record;
+  absl::string_view key;
+};
+
+// Merges runs `[begin, end)` and writes their records to `dest`, then deletes
+// the runs.
+absl::Status MergeRuns(SortRunStorage& runs, uint64_t begin, uint64_t end,
+                       RecordWriterBase& dest,
+                       const SortRecordsOptions& options) {
+  std::vector<std::unique_ptr<MergeSource>> sources;
+  sources.reserve(IntCast<size_t>(end - begin));
+  // A heap of indices of `sources` which have a current record, with the
+  // smallest key at the front. Equal keys are ordered by the index, so that
+  // records from earlier runs come first.
+  std::vector<size_t> heap;
+  heap.reserve(IntCast<size_t>(end - begin));
+  const auto greater = [&sources](size_t a, size_t b) {
+    const int ordering = sources[a]->key.compare(sources[b]->key);
+    return ordering > 0 || (ordering == 0 && a > b);
+  };
+  for (uint64_t run = begin; run < end; ++run) {
+    sources.push_back(absl::make_unique<MergeSource>(
+        runs.NewRunReader(run), options.run_reader_options()));
+    MergeSource& source = *sources.back();
+    if (source.reader.ReadRecord(source.record)) {
+      source.key = RecordKey(options.record_key(), source.record);
+      heap.push_back(sources.size() - 1);
+    } else if (ABSL_PREDICT_FALSE(!source.reader.Close())) {
+      return source.reader.status();
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    MergeSource& source = *sources[heap.back()];
+    if (ABSL_PREDICT_FALSE(!dest.WriteRecord(source.record))) {
+      return dest.status();
+    }
+    if (source.reader.ReadRecord(source.record)) {
+      source.key = RecordKey(options.record_key(), source.record);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    } else {
+      heap.pop_back();
+      if (ABSL_PREDICT_FALSE(!source.reader.Close())) {
+        return source.reader.status();
+      }
+    }
+  }
+  sources.clear();
+  for (uint64_t run = begin; run < end; ++run) runs.DeleteRun(run);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status SortRecords(RecordReaderBase& src, RecordWriterBase& dest,
+                         SortRunStorage& runs,
+                         const SortRecordsOptions& options) {
+  uint64_t num_runs = 0;
+  {
+    std::vector<std::string> records;
+    size_t records_size = 0;
+    std::string record;
+    // The previous run is kept open while the next run is read and sorted, so
+    // that with `run_writer_options().parallelism() > 0` it is being encoded
+    // and written in background.
+    RecordWriter<std::unique_ptr<Writer>> run_writer(kClosed);
+    for (;;) {
+      const bool read_ok = src.ReadRecord(record);
+      if (read_ok) {
+        records_size += record.size();
+        records.push_back(std::move(record));
+        if (records_size < options.max_run_size()) continue;
+      } else {
+        if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+        if (num_runs == 0) {
+          // All records fit in one run, there is no need to merge.
+          return WriteSorted(SortedOrder(options.record_key(), records),
+                             records, dest);
+        }
+        if (records.empty()) break;
+      }
+      const std::vector<size_t> order =
+          SortedOrder(options.record_key(), records);
+      if (run_writer.is_open()) {
+        if (ABSL_PREDICT_FALSE(!run_writer.Close())) {
+          return run_writer.status();
+        }
+      }
+      run_writer.Reset(runs.NewRunWriter(num_runs++),
+                       options.run_writer_options());
+      {
+        const absl::Status status = WriteSorted(order, records, run_writer);
+        if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      }
+      records.clear();
+      records_size = 0;
+      if (!read_ok) break;
+    }
+    if (run_writer.is_open()) {
+      if (ABSL_PREDICT_FALSE(!run_writer.Close())) return run_writer.status();
+    }
+  }
+  // Each pass merges groups of consecutive runs into new runs, preserving the
+  // order of records with equal keys.
+  uint64_t first_run = 0;
+  while (num_runs - first_run > options.max_merge_width()) {
+    const uint64_t pass_end = num_runs;
+    for (uint64_t begin = first_run; begin < pass_end;
+         begin += options.max_merge_width()) {
+      const uint64_t end =
+          UnsignedMin(begin + options.max_merge_width(), pass_end);
+      RecordWriter<std::unique_ptr<Writer>> merged_writer(
+          runs.NewRunWriter(num_runs++), options.run_writer_options());
+      {
+        const absl::Status status =
+            MergeRuns(runs, begin, end, merged_writer, options);
+        if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+      }
+      if (ABSL_PREDICT_FALSE(!merged_writer.Close())) {
+        return merged_writer.status();
+      }
+    }
+    first_run = pass_end;
+  }
+  return MergeRuns(runs, first_run, num_runs, dest, options);
+}
+
+}  // namespace riegeli
@@ -0,0 +1,200 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_SORT_RECORDS_H_
+#define RIEGELI_RECORDS_SORT_RECORDS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/records/key_index.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// Storage of temporary sorted runs written and read by `SortRecords()`, e.g.
+// files in a temporary directory.
+//
+// Runs are identified by indices counting from 0. Each run is written once,
+// then read at most once.
+class SortRunStorage {
+ public:
+  virtual ~SortRunStorage();
+
+  // Returns the destination of the run with index `run`. It is not closed by
+  // the caller; it is destroyed after the run is written.
+  //
+  // Failure is reported by returning a `Writer` which is not healthy.
+  virtual std::unique_ptr<Writer> NewRunWriter(uint64_t run) = 0;
+
+  // Returns the source of the run with index `run`, which has been written by
+  // a `Writer` returned by `NewRunWriter(run)` and destroyed.
+  //
+  // Failure is reported by returning a `Reader` which is not healthy.
+  virtual std::unique_ptr<Reader> NewRunReader(uint64_t run) = 0;
+
+  // Called after the run with index `run` has been fully read, so that its
+  // storage can be released.
+  //
+  // By default does nothing.
+  virtual void DeleteRun(uint64_t run);
+};
+
+class SortRecordsOptions {
+ public:
+  SortRecordsOptions() noexcept {}
+
+  // Computes keys of records to sort by. Records are ordered by their keys
+  // compared as byte strings. Records with equal keys keep their order.
+  //
+  // To sort by an unsigned integer, express it as an ordered varint (see
+  // `riegeli/ordered_varint/ordered_varint_writing.h`), whose lexicographic
+  // order agrees with the numeric order.
+  //
+  // If `nullptr`, the key is the whole record.
+  //
+  // Default: `nullptr`.
+  SortRecordsOptions& set_record_key(RecordKeyFunction record_key) & {
+    record_key_ = std::move(record_key);
+    return *this;
+  }
+  SortRecordsOptions&& set_record_key(RecordKeyFunction record_key) && {
+    return std::move(set_record_key(std::move(record_key)));
+  }
+  const RecordKeyFunction& record_key() const { return record_key_; }
+
+  // The total size of records which are sorted in memory and written as one
+  // run. Memory usage is somewhat larger, because of overheads of each record.
+  //
+  // Default: `size_t{256} << 20` (256M).
+  SortRecordsOptions& set_max_run_size(size_t max_run_size) & {
+    RIEGELI_ASSERT_GT(max_run_size, 0u)
+        << "Failed precondition of SortRecordsOptions::set_max_run_size(): "
+           "zero run size";
+    max_run_size_ = max_run_size;
+    return *this;
+  }
+  SortRecordsOptions&& set_max_run_size(size_t max_run_size) && {
+    return std::move(set_max_run_size(max_run_size));
+  }
+  size_t max_run_size() const { return max_run_size_; }
+
+  // The maximum number of runs merged at once. If there are more runs,
+  // consecutive groups of `max_merge_width` runs are first merged into longer
+  // runs, until at most `max_merge_width` runs remain.
+  //
+  // Runs being merged are open at the same time, each buffering some chunks
+  // according to `run_reader_options()`.
+  //
+  // Default: 64.
+  SortRecordsOptions& set_max_merge_width(size_t max_merge_width) & {
+    RIEGELI_ASSERT_GT(max_merge_width, 1u)
+        << "Failed precondition of SortRecordsOptions::set_max_merge_width(): "
+           "merge width too small";
+    max_merge_width_ = max_merge_width;
+    return *this;
+  }
+  SortRecordsOptions&& set_max_merge_width(size_t max_merge_width) && {
+    return std::move(set_max_merge_width(max_merge_width));
+  }
+  size_t max_merge_width() const { return max_merge_width_; }
+
+  // Options for `RecordWriter`s of runs.
+  //
+  // With `parallelism() > 0`, a run is encoded and written in background while
+  // the next run is being read and sorted.
+  //
+  // Default: `RecordWriterBase::Options().set_parallelism(1)`.
+  SortRecordsOptions& set_run_writer_options(
+      RecordWriterBase::Options run_writer_options) & {
+    run_writer_options_ = std::move(run_writer_options);
+    return *this;
+  }
+  SortRecordsOptions&& set_run_writer_options(
+      RecordWriterBase::Options run_writer_options) && {
+    return std::move(set_run_writer_options(std::move(run_writer_options)));
+  }
+  RecordWriterBase::Options& run_writer_options() {
+    return run_writer_options_;
+  }
+  const RecordWriterBase::Options& run_writer_options() const {
+    return run_writer_options_;
+  }
+
+  // Options for `RecordReader`s of runs.
+  //
+  // With `parallelism() > 0`, chunks of each run are read and decoded in
+  // background while records are being merged.
+  //
+  // Default: `RecordReaderBase::Options().set_parallelism(1)`.
+  SortRecordsOptions& set_run_reader_options(
+      RecordReaderBase::Options run_reader_options) & {
+    run_reader_options_ = std::move(run_reader_options);
+    return *this;
+  }
+  SortRecordsOptions&& set_run_reader_options(
+      RecordReaderBase::Options run_reader_options) && {
+    return std::move(set_run_reader_options(std::move(run_reader_options)));
+  }
+  RecordReaderBase::Options& run_reader_options() {
+    return run_reader_options_;
+  }
+  const RecordReaderBase::Options& run_reader_options() const {
+    return run_reader_options_;
+  }
+
+ private:
+  RecordKeyFunction record_key_;
+  size_t max_run_size_ = size_t{256} << 20;
+  size_t max_merge_width_ = 64;
+  RecordWriterBase::Options run_writer_options_ =
+      RecordWriterBase::Options().set_parallelism(1);
+  RecordReaderBase::Options run_reader_options_ =
+      RecordReaderBase::Options().set_parallelism(1);
+};
+
+// Reads records from `src` from its current position until its end, and writes
+// them to `dest` sorted by their keys.
+//
+// Records are sorted in memory in runs of `SortRecordsOptions::max_run_size()`,
+// which are written to `runs` as Riegeli/records files, and then merged. If all
+// records fit in one run, they are written directly to `dest` and `runs` are
+// not used.
+//
+// If `dest` has `RecordWriterBase::Options::key_index()`, then
+// `RecordWriterBase::Options::record_key()` of `dest` should compute the same
+// keys as `SortRecordsOptions::record_key()`, and records should have distinct
+// keys.
+//
+// `src` and `dest` are not closed. After a failure, some runs might not have
+// been deleted from `runs`.
+//
+// Return values:
+//  * `absl::OkStatus()` - success
+//  * other status       - failure of `src`, `dest`, or a run
+absl::Status SortRecords(
+    RecordReaderBase& src, RecordWriterBase& dest, SortRunStorage& runs,
+    const SortRecordsOptions& options = SortRecordsOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_SORT_RECORDS_H_
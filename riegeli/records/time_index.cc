@@ -0,0 +1,148 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/time_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+namespace {
+
+// Differences of timestamps are computed modulo 2^64, so that they do not
+// overflow, and signed differences are zigzag-encoded, so that small negative
+// differences are encoded in few bytes.
+
+inline uint64_t EncodeDelta(int64_t from, int64_t to) {
+  const uint64_t delta =
+      static_cast<uint64_t>(to) - static_cast<uint64_t>(from);
+  return (delta << 1) ^ (delta >> 63 != 0 ? ~uint64_t{0} : uint64_t{0});
+}
+
+inline int64_t DecodeDelta(int64_t from, uint64_t encoded) {
+  const uint64_t delta =
+      (encoded >> 1) ^ ((encoded & 1) != 0 ? ~uint64_t{0} : uint64_t{0});
+  return static_cast<int64_t>(static_cast<uint64_t>(from) + delta);
+}
+
+}  // namespace
+
+void TimeIndex::AddRecord(int64_t timestamp, bool begins_chunk) {
+  RIEGELI_ASSERT(!empty() || begins_chunk)
+      << "Failed precondition of TimeIndex::AddRecord(): "
+         "no chunk to add the record to";
+  if (begins_chunk) {
+    min_timestamps_.push_back(timestamp);
+    max_timestamps_.push_back(timestamp);
+    return;
+  }
+  min_timestamps_.back() = std::min(min_timestamps_.back(), timestamp);
+  max_timestamps_.back() = std::max(max_timestamps_.back(), timestamp);
+}
+
+absl::optional<size_t> TimeIndex::NextOverlapping(size_t chunk_index,
+                                                  int64_t begin,
+                                                  int64_t end) const {
+  for (; chunk_index < size(); ++chunk_index) {
+    if (max_timestamps_[chunk_index] >= begin &&
+        min_timestamps_[chunk_index] < end) {
+      return chunk_index;
+    }
+  }
+  return absl::nullopt;
+}
+
+// Format of time index chunk data, all integers are varint64:
+//  * `num_chunks` - number of chunks with records
+//  * for each chunk with records:
+//    * the minimum timestamp minus the minimum timestamp of the previous chunk
+//      (0 for the first chunk), zigzag-encoded
+//    * the maximum timestamp minus the minimum timestamp
+void TimeIndex::Encode(Chunk& chunk) const {
+  chunk.Clear();
+  ChainWriter<> data_writer(&chunk.data);
+  WriteVarint64(IntCast<uint64_t>(size()), data_writer);
+  int64_t prev_min_timestamp = 0;
+  for (size_t i = 0; i < size(); ++i) {
+    WriteVarint64(EncodeDelta(prev_min_timestamp, min_timestamps_[i]),
+                  data_writer);
+    WriteVarint64(static_cast<uint64_t>(max_timestamps_[i]) -
+                      static_cast<uint64_t>(min_timestamps_[i]),
+                  data_writer);
+    prev_min_timestamp = min_timestamps_[i];
+  }
+  if (!data_writer.Close()) {
+    RIEGELI_ASSERT_UNREACHABLE()
+        << "A ChainWriter has no reason to fail: " << data_writer.status();
+  }
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kTimeIndex, 0, 0);
+}
+
+bool TimeIndex::Decode(const Chunk& chunk) {
+  Clear();
+  if (ABSL_PREDICT_FALSE(chunk.header.chunk_type() != ChunkType::kTimeIndex ||
+                         chunk.header.num_records() != 0)) {
+    return false;
+  }
+  ChainReader<> data_reader(&chunk.data);
+  uint64_t num_chunks;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, num_chunks))) return false;
+  if (ABSL_PREDICT_FALSE(num_chunks > data_reader.Size().value_or(0) / 2)) {
+    // Each chunk is encoded by at least two bytes.
+    return false;
+  }
+  min_timestamps_.reserve(IntCast<size_t>(num_chunks));
+  max_timestamps_.reserve(IntCast<size_t>(num_chunks));
+  int64_t min_timestamp = 0;
+  for (uint64_t i = 0; i < num_chunks; ++i) {
+    uint64_t encoded_delta;
+    uint64_t range;
+    if (ABSL_PREDICT_FALSE(!ReadVarint64(data_reader, encoded_delta) ||
+                           !ReadVarint64(data_reader, range))) {
+      Clear();
+      return false;
+    }
+    min_timestamp = DecodeDelta(min_timestamp, encoded_delta);
+    if (ABSL_PREDICT_FALSE(
+            range > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) -
+                        static_cast<uint64_t>(min_timestamp))) {
+      Clear();
+      return false;
+    }
+    min_timestamps_.push_back(min_timestamp);
+    max_timestamps_.push_back(static_cast<int64_t>(
+        static_cast<uint64_t>(min_timestamp) + range));
+  }
+  if (ABSL_PREDICT_FALSE(!data_reader.VerifyEndAndClose())) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,126 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_TIME_INDEX_H_
+#define RIEGELI_RECORDS_TIME_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/chunk.h"
+
+namespace riegeli {
+
+// Computes the timestamp of a serialized record for a time index, in units
+// defined by the application, e.g. microseconds since the Unix epoch.
+using RecordTimestampFunction =
+    std::function<int64_t(absl::string_view record)>;
+
+// Ranges of timestamps of records of chunks containing records of a
+// Riegeli/records file.
+//
+// `RecordWriter` writes a time index chunk before the key index chunk if any,
+// otherwise before the chunk index chunk, if
+// `RecordWriterBase::Options::record_timestamp()` is not `nullptr`. The `i`-th
+// range corresponds to the `i`-th chunk of the `ChunkIndex`. `RecordReader`
+// loads it lazily in `SeekToTime()` and `SkipToTimeRange()` to skip chunks
+// whose records are all outside of a range of timestamps without reading them.
+class TimeIndex {
+ public:
+  // Creates an empty `TimeIndex`.
+  TimeIndex() noexcept {}
+
+  TimeIndex(const TimeIndex& that) = default;
+  TimeIndex& operator=(const TimeIndex& that) = default;
+
+  TimeIndex(TimeIndex&& that) noexcept = default;
+  TimeIndex& operator=(TimeIndex&& that) noexcept = default;
+
+  // Makes `*this` equivalent to a newly constructed `TimeIndex`.
+  void Clear() {
+    min_timestamps_.clear();
+    max_timestamps_.clear();
+  }
+
+  // Adds the timestamp of the next record. If `begins_chunk`, the record
+  // begins the next chunk with records, otherwise it belongs to the last
+  // chunk.
+  //
+  // Precondition: `!empty() || begins_chunk`
+  void AddRecord(int64_t timestamp, bool begins_chunk);
+
+  // Returns the number of chunks.
+  size_t size() const { return min_timestamps_.size(); }
+  bool empty() const { return min_timestamps_.empty(); }
+
+  // Returns the minimum and maximum timestamp of records of the
+  // `chunk_index`-th chunk.
+  //
+  // Precondition: `chunk_index < size()`
+  int64_t min_timestamp(size_t chunk_index) const;
+  int64_t max_timestamp(size_t chunk_index) const;
+
+  // Returns the index of the first chunk at or after `chunk_index` which can
+  // contain records with timestamps at least `begin` and less than `end`, or
+  // `absl::nullopt` if there is no such chunk.
+  absl::optional<size_t> NextOverlapping(size_t chunk_index, int64_t begin,
+                                         int64_t end) const;
+
+  // Encodes the index as a time index chunk.
+  //
+  // Minimum timestamps are delta-encoded, and maximum timestamps are encoded
+  // relative to minimum timestamps of the same chunk.
+  void Encode(Chunk& chunk) const;
+
+  // Decodes the index from a time index chunk.
+  //
+  // Return values:
+  //  * `true`  - success
+  //  * `false` - the chunk is not a valid time index chunk (`*this` is
+  //              cleared)
+  bool Decode(const Chunk& chunk);
+
+ private:
+  // Invariants:
+  //   `max_timestamps_.size() == min_timestamps_.size()`
+  //   `min_timestamps_[i] <= max_timestamps_[i]`
+  std::vector<int64_t> min_timestamps_;
+  std::vector<int64_t> max_timestamps_;
+};
+
+// Implementation details follow.
+
+inline int64_t TimeIndex::min_timestamp(size_t chunk_index) const {
+  RIEGELI_ASSERT_LT(chunk_index, size())
+      << "Failed precondition of TimeIndex::min_timestamp(): "
+         "chunk index out of range";
+  return min_timestamps_[chunk_index];
+}
+
+inline int64_t TimeIndex::max_timestamp(size_t chunk_index) const {
+  RIEGELI_ASSERT_LT(chunk_index, size())
+      << "Failed precondition of TimeIndex::max_timestamp(): "
+         "chunk index out of range";
+  return max_timestamps_[chunk_index];
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_TIME_INDEX_H_
@@ -17,6 +17,7 @@
 #include <stdint.h>
 
 #include <limits>
+#include <map>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -30,19 +31,23 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
 #include "absl/types/optional.h"
 #include "google/protobuf/text_format.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/chain_writer.h"
 #include "riegeli/bytes/fd_reader.h"
 #include "riegeli/bytes/limiting_reader.h"
 #include "riegeli/bytes/null_backward_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/std_io.h"
+#include "riegeli/bytes/string_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/constants.h"
@@ -51,6 +56,7 @@
 #include "riegeli/chunk_encoding/transpose_decoder.h"
 #include "riegeli/messages/message_parse.h"
 #include "riegeli/messages/message_serialize.h"
+#include "riegeli/records/block.h"
 #include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/records_metadata.pb.h"
 #include "riegeli/records/skipped_region.h"
@@ -63,11 +69,27 @@ ABSL_FLAG(bool, show_record_sizes, false,
           "If true, show the list of record sizes in each chunk.");
 ABSL_FLAG(bool, show_records, false,
           "If true, show contents of records in each chunk.");
+ABSL_FLAG(bool, show_chunks, true,
+          "If true, show each chunk. If false, show only totals per chunk "
+          "type.");
+ABSL_FLAG(bool, header_only, false,
+          "If true, read only chunk headers and skip chunk data, which shows "
+          "only sizes and numbers of records of chunks but is much faster; "
+          "show_records_metadata, show_record_sizes, and show_records are "
+          "then ignored.");
+ABSL_FLAG(int, parallelism, 0,
+          "If positive, split the file into ranges of chunks and describe "
+          "them on this many threads. Output is the same as with 0, except "
+          "that errors are shown after the chunks of their range.");
 
 namespace riegeli {
 namespace tools {
 namespace {
 
+// The minimum size of a range of a file described by one task with
+// `--parallelism`.
+constexpr Position kMinRangeSize = Position{1} << 20;
+
 absl::Status DescribeFileMetadataChunk(const Chunk& chunk,
                                        RecordsMetadata& records_metadata) {
   // Based on `RecordReaderBase::ParseMetadata()`.
@@ -218,8 +240,11 @@ absl::Status DescribeTransposedChunk(
   if (ABSL_PREDICT_FALSE(!src.ReadByte(compression_type_byte))) {
     return absl::InvalidArgumentError("Reading compression type failed");
   }
+  // The highest bit marks transformed buffers, see `TransposeEncoder`.
+  transposed_chunk.set_has_buffer_transforms(
+      (compression_type_byte & 0x80) != 0);
   transposed_chunk.set_compression_type(
-      static_cast<summary::CompressionType>(compression_type_byte));
+      static_cast<summary::CompressionType>(compression_type_byte & 0x7f));
 
   if (show_record_sizes || show_records) {
     // Based on `ChunkDecoder::Parse()`.
@@ -279,35 +304,78 @@ absl::Status DescribeTransposedChunk(
   return absl::OkStatus();
 }
 
-void DescribeFile(absl::string_view filename, Writer& report) {
-  absl::Format(&report,
-               "file {\n"
-               "  filename: \"%s\"\n",
-               absl::Utf8SafeCEscape(filename));
-  DefaultChunkReader<FdReader<>> chunk_reader(
-      std::forward_as_tuple(filename, O_RDONLY));
-  if (chunk_reader.SupportsRandomAccess()) {
-    const absl::optional<Position> size = chunk_reader.Size();
-    if (size != absl::nullopt) {
-      absl::Format(&report, "  file_size: %u\n", *size);
-    }
+// Totals of chunks, by chunk type.
+using Totals = std::map<ChunkType, summary::ChunkTypeTotals>;
+
+void AddChunkToTotals(const ChunkHeader& chunk_header, Totals& totals) {
+  summary::ChunkTypeTotals& chunk_type_totals =
+      totals[chunk_header.chunk_type()];
+  chunk_type_totals.set_num_chunks(chunk_type_totals.num_chunks() + 1);
+  chunk_type_totals.set_num_records(chunk_type_totals.num_records() +
+                                    chunk_header.num_records());
+  chunk_type_totals.set_data_size(chunk_type_totals.data_size() +
+                                  chunk_header.data_size());
+  chunk_type_totals.set_decoded_data_size(
+      chunk_type_totals.decoded_data_size() +
+      chunk_header.decoded_data_size());
+}
+
+void MergeTotals(const Totals& src, Totals& dest) {
+  for (const auto& entry : src) {
+    summary::ChunkTypeTotals& chunk_type_totals = dest[entry.first];
+    chunk_type_totals.set_num_chunks(chunk_type_totals.num_chunks() +
+                                     entry.second.num_chunks());
+    chunk_type_totals.set_num_records(chunk_type_totals.num_records() +
+                                      entry.second.num_records());
+    chunk_type_totals.set_data_size(chunk_type_totals.data_size() +
+                                    entry.second.data_size());
+    chunk_type_totals.set_decoded_data_size(
+        chunk_type_totals.decoded_data_size() +
+        entry.second.decoded_data_size());
   }
+}
+
+// Describes chunks beginning before `range_end`, starting from the current
+// position of `chunk_reader`.
+//
+// Chunks are written to `report` if `show_chunks`, errors are written to
+// `errors`, and chunks are added to `totals`.
+void DescribeChunks(DefaultChunkReaderBase& chunk_reader, Position range_end,
+                    Writer& report, Writer& errors, Totals& totals) {
+  const bool header_only = absl::GetFlag(FLAGS_header_only);
+  const bool show_chunks = absl::GetFlag(FLAGS_show_chunks);
   google::protobuf::TextFormat::Printer printer;
   printer.SetInitialIndentLevel(2);
   printer.SetUseShortRepeatedPrimitives(true);
   printer.SetUseUtf8StringEscaping(true);
-  for (;;) {
+  while (chunk_reader.pos() < range_end) {
     report.Flush();
     const Position chunk_begin = chunk_reader.pos();
     Chunk chunk;
-    if (ABSL_PREDICT_FALSE(!chunk_reader.ReadChunk(chunk))) {
+    bool chunk_read;
+    if (header_only) {
+      const ChunkHeader* chunk_header;
+      chunk_read = chunk_reader.PullChunkHeader(&chunk_header);
+      if (chunk_read) {
+        chunk.header = *chunk_header;
+        // Skip chunk data. If the chunk is truncated, this is detected by
+        // reading the next chunk header.
+        chunk_read = chunk_reader.Seek(internal::ChunkEnd(
+            chunk.header, chunk_begin, chunk_reader.block_size()));
+      }
+    } else {
+      chunk_read = chunk_reader.ReadChunk(chunk);
+    }
+    if (ABSL_PREDICT_FALSE(!chunk_read)) {
       SkippedRegion skipped_region;
       if (chunk_reader.Recover(&skipped_region)) {
-        absl::Format(&StdErr(), "%s\n", skipped_region.message());
+        absl::Format(&errors, "%s\n", skipped_region.message());
         continue;
       }
       break;
     }
+    AddChunkToTotals(chunk.header, totals);
+    if (!show_chunks) continue;
     summary::Chunk chunk_summary;
     chunk_summary.set_chunk_begin(chunk_begin);
     chunk_summary.set_chunk_type(
@@ -315,7 +383,7 @@ void DescribeFile(absl::string_view filename, Writer& report) {
     chunk_summary.set_data_size(chunk.header.data_size());
     chunk_summary.set_num_records(chunk.header.num_records());
     chunk_summary.set_decoded_data_size(chunk.header.decoded_data_size());
-    {
+    if (!header_only) {
       absl::Status status;
       switch (chunk.header.chunk_type()) {
         case ChunkType::kFileMetadata:
@@ -336,7 +404,7 @@ void DescribeFile(absl::string_view filename, Writer& report) {
           break;
       }
       if (ABSL_PREDICT_FALSE(!status.ok())) {
-        absl::Format(&StdErr(), "%s\n", status.message());
+        absl::Format(&errors, "%s\n", status.message());
       }
     }
     absl::Format(&report, "  chunk {\n");
@@ -344,6 +412,99 @@ void DescribeFile(absl::string_view filename, Writer& report) {
     printer.Print(chunk_summary, &proto_out);
     absl::Format(&report, "  }\n");
   }
+}
+
+// The output of describing one range of a file in parallel.
+struct RangeOutput {
+  Chain report;
+  std::string errors;
+  Totals totals;
+  absl::Notification done;
+};
+
+// Describes chunks beginning in [`range_begin`, `range_end`) of `filename`
+// with a separate `ChunkReader`.
+void DescribeRange(absl::string_view filename, Position range_begin,
+                   Position range_end, RangeOutput& output) {
+  ChainWriter<> report(&output.report);
+  StringWriter<> errors(&output.errors);
+  DefaultChunkReader<FdReader<>> chunk_reader(
+      std::forward_as_tuple(filename, O_RDONLY));
+  if (ABSL_PREDICT_FALSE(!chunk_reader.SeekToChunkAfter(range_begin))) {
+    absl::Format(&errors, "%s\n", chunk_reader.status().message());
+  } else {
+    DescribeChunks(chunk_reader, range_end, report, errors, output.totals);
+    if (!chunk_reader.Close()) {
+      absl::Format(&errors, "%s\n", chunk_reader.status().message());
+    }
+  }
+  report.Close();
+  errors.Close();
+}
+
+void DescribeFile(absl::string_view filename, Writer& report) {
+  absl::Format(&report,
+               "file {\n"
+               "  filename: \"%s\"\n",
+               absl::Utf8SafeCEscape(filename));
+  DefaultChunkReader<FdReader<>> chunk_reader(
+      std::forward_as_tuple(filename, O_RDONLY));
+  absl::optional<Position> size;
+  if (chunk_reader.SupportsRandomAccess()) {
+    size = chunk_reader.Size();
+    if (size != absl::nullopt) {
+      absl::Format(&report, "  file_size: %u\n", *size);
+    }
+  }
+  Totals totals;
+  const int parallelism = absl::GetFlag(FLAGS_parallelism);
+  if (parallelism > 0 && size != absl::nullopt) {
+    // Split the file into more ranges than threads, so that threads which
+    // finish early take further ranges. Each range covers chunks beginning in
+    // it, so a chunk crossing a range boundary is described once.
+    const Position num_ranges = UnsignedMax(
+        UnsignedMin(IntCast<Position>(parallelism) * 4, *size / kMinRangeSize),
+        Position{1});
+    const Position range_size = (*size + num_ranges - 1) / num_ranges;
+    std::vector<RangeOutput> outputs(IntCast<size_t>(num_ranges));
+    internal::ThreadPool thread_pool(IntCast<size_t>(parallelism));
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      thread_pool.Schedule([filename, range_begin = i * range_size,
+                            range_end = (i + 1) * range_size,
+                            output = &outputs[i]] {
+        DescribeRange(filename, range_begin, range_end, *output);
+        output->done.Notify();
+      });
+    }
+    // Show ranges in order as they become ready.
+    for (RangeOutput& output : outputs) {
+      output.done.WaitForNotification();
+      report.Write(output.report);
+      report.Flush();
+      StdErr().Write(output.errors);
+      StdErr().Flush();
+      MergeTotals(output.totals, totals);
+    }
+  } else {
+    DescribeChunks(chunk_reader, std::numeric_limits<Position>::max(), report,
+                   StdErr(), totals);
+  }
+  google::protobuf::TextFormat::Printer printer;
+  printer.SetInitialIndentLevel(2);
+  for (auto& entry : totals) {
+    summary::ChunkTypeTotals& chunk_type_totals = entry.second;
+    chunk_type_totals.set_chunk_type(
+        static_cast<summary::ChunkType>(entry.first));
+    if (chunk_type_totals.decoded_data_size() > 0) {
+      chunk_type_totals.set_compression_ratio(
+          static_cast<double>(chunk_type_totals.data_size()) /
+          static_cast<double>(chunk_type_totals.decoded_data_size()));
+    }
+    absl::Format(&report, "  totals {\n");
+    WriterOutputStream proto_out(&report);
+    printer.Print(chunk_type_totals, &proto_out);
+    absl::Format(&report, "  }\n");
+  }
   absl::Format(&report, "}\n");
   report.Flush();
   if (!chunk_reader.Close()) {
@@ -0,0 +1,331 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make file offsets 64-bit even on 32-bit systems.
+#undef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/options_parser.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/messages/message_wire_format.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/records_metadata.pb.h"
+
+ABSL_FLAG(std::string, schema,
+          "int_fields:4,fixed_fields:2,string_fields:2,string_size:16,"
+          "nested_fields:1,depth:2,repeated:2",
+          "Shape of generated messages, as comma-separated options: "
+          "int_fields (varint fields), fixed_fields (fixed64 fields), "
+          "string_fields (length-delimited fields), string_size (mean size "
+          "of a string), nested_fields (submessage fields of the same shape), "
+          "depth (levels of nesting below the record), repeated (mean number "
+          "of values of each field)");
+ABSL_FLAG(std::string, distribution, "exponential",
+          "Distribution of string sizes and numbers of field values around "
+          "their means: fixed, uniform (between 0 and twice the mean), or "
+          "exponential");
+ABSL_FLAG(double, entropy, 0.5,
+          "Fraction of values drawn uniformly at random, between 0 and 1; the "
+          "rest are drawn from a small vocabulary and compress well");
+ABSL_FLAG(uint64_t, num_records, 100000, "Number of records to generate");
+ABSL_FLAG(uint64_t, seed, 1, "Seed of the pseudo-random generator");
+ABSL_FLAG(std::string, riegeli_options, "uncompressed",
+          "Riegeli RecordWriter options of the generated file");
+
+namespace {
+
+enum class Distribution { kFixed, kUniform, kExponential };
+
+struct Schema {
+  int int_fields = 0;
+  int fixed_fields = 0;
+  int string_fields = 0;
+  uint64_t string_size = 0;
+  int nested_fields = 0;
+  int depth = 0;
+  int repeated = 1;
+};
+
+bool ParseSchema(absl::string_view text, Schema& schema) {
+  riegeli::OptionsParser options_parser;
+  options_parser.AddOption(
+      "int_fields", riegeli::ValueParser::Int(0, 1000, &schema.int_fields));
+  options_parser.AddOption(
+      "fixed_fields", riegeli::ValueParser::Int(0, 1000, &schema.fixed_fields));
+  options_parser.AddOption(
+      "string_fields",
+      riegeli::ValueParser::Int(0, 1000, &schema.string_fields));
+  options_parser.AddOption(
+      "string_size", riegeli::ValueParser::Bytes(0, uint64_t{1} << 30,
+                                                 &schema.string_size));
+  options_parser.AddOption(
+      "nested_fields",
+      riegeli::ValueParser::Int(0, 1000, &schema.nested_fields));
+  options_parser.AddOption("depth",
+                           riegeli::ValueParser::Int(0, 100, &schema.depth));
+  options_parser.AddOption(
+      "repeated", riegeli::ValueParser::Int(1, 1000000, &schema.repeated));
+  if (!options_parser.FromString(text)) {
+    absl::Format(&riegeli::StdErr(), "Invalid --schema: %s\n",
+                 options_parser.status().message());
+    return false;
+  }
+  return true;
+}
+
+// Generates protocol buffer messages in the wire format, without a `.proto`
+// definition.
+//
+// Field numbers are assigned in the order: varint fields, fixed64 fields,
+// string fields, submessage fields.
+//
+// Values are derived only from the raw output of `std::mt19937_64`, whose
+// sequence is specified by the standard, rather than from standard
+// distributions, whose results differ between implementations. This makes the
+// generated records the same on every platform for a given seed.
+class RecordGenerator {
+ public:
+  explicit RecordGenerator(const Schema& schema, Distribution distribution,
+                           double entropy, uint64_t seed);
+
+  // Returns the next record.
+  std::string Next();
+
+ private:
+  void WriteMessage(int depth, riegeli::Writer& dest);
+
+  // Returns a number whose mean is `mean`, according to `distribution_`.
+  uint64_t Count(uint64_t mean);
+  // Returns `true` with probability `entropy_`.
+  bool Random();
+  // Returns a uniform random number in [0..1).
+  double UniformReal();
+
+  uint64_t Varint();
+  uint64_t Fixed64();
+  void AppendString(std::string& dest);
+
+  // Words which compressible strings are made of.
+  static constexpr std::array<absl::string_view, 16> kVocabulary = {
+      {"the ", "of ", "and ", "record ", "riegeli ", "chunk ", "value ",
+       "field ", "message ", "data ", "file ", "transposed ", "compressed ",
+       "string ", "number ", "id "}};
+
+  Schema schema_;
+  Distribution distribution_;
+  double entropy_;
+  std::mt19937_64 random_;
+};
+
+constexpr std::array<absl::string_view, 16> RecordGenerator::kVocabulary;
+
+RecordGenerator::RecordGenerator(const Schema& schema,
+                                 Distribution distribution, double entropy,
+                                 uint64_t seed)
+    : schema_(schema),
+      distribution_(distribution),
+      entropy_(entropy),
+      random_(seed) {}
+
+std::string RecordGenerator::Next() {
+  std::string record;
+  riegeli::StringWriter<> writer(&record);
+  WriteMessage(schema_.depth, writer);
+  RIEGELI_CHECK(writer.Close()) << writer.status();
+  return record;
+}
+
+void RecordGenerator::WriteMessage(int depth, riegeli::Writer& dest) {
+  const uint64_t repeated = riegeli::IntCast<uint64_t>(schema_.repeated);
+  int field_number = 0;
+  for (int i = 0; i < schema_.int_fields; ++i) {
+    ++field_number;
+    for (uint64_t count = Count(repeated); count > 0; --count) {
+      riegeli::WriteVarint64WithTag(field_number, Varint(), dest);
+    }
+  }
+  for (int i = 0; i < schema_.fixed_fields; ++i) {
+    ++field_number;
+    for (uint64_t count = Count(repeated); count > 0; --count) {
+      riegeli::WriteFixed64WithTag(field_number, Fixed64(), dest);
+    }
+  }
+  std::string value;
+  for (int i = 0; i < schema_.string_fields; ++i) {
+    ++field_number;
+    for (uint64_t count = Count(repeated); count > 0; --count) {
+      value.clear();
+      AppendString(value);
+      riegeli::WriteLengthWithTag(field_number, value.size(), dest);
+      dest.Write(value);
+    }
+  }
+  if (depth == 0) return;
+  for (int i = 0; i < schema_.nested_fields; ++i) {
+    ++field_number;
+    for (uint64_t count = Count(repeated); count > 0; --count) {
+      value.clear();
+      riegeli::StringWriter<> writer(&value);
+      WriteMessage(depth - 1, writer);
+      RIEGELI_CHECK(writer.Close()) << writer.status();
+      riegeli::WriteLengthWithTag(field_number, value.size(), dest);
+      dest.Write(value);
+    }
+  }
+}
+
+uint64_t RecordGenerator::Count(uint64_t mean) {
+  switch (distribution_) {
+    case Distribution::kFixed:
+      return mean;
+    case Distribution::kUniform:
+      return random_() % (2 * mean + 1);
+    case Distribution::kExponential:
+      return static_cast<uint64_t>(
+          std::floor(-static_cast<double>(mean) * std::log1p(-UniformReal()) +
+                     0.5));
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown distribution: " << static_cast<int>(distribution_);
+}
+
+bool RecordGenerator::Random() { return UniformReal() < entropy_; }
+
+double RecordGenerator::UniformReal() {
+  return static_cast<double>(random_() >> 11) * 0x1p-53;
+}
+
+uint64_t RecordGenerator::Varint() {
+  if (Random()) {
+    // Spread lengths of varints evenly.
+    return random_() >> (random_() % 64);
+  }
+  return random_() % 16;
+}
+
+uint64_t RecordGenerator::Fixed64() {
+  if (Random()) return random_();
+  return random_() % 16;
+}
+
+void RecordGenerator::AppendString(std::string& dest) {
+  const size_t size = riegeli::IntCast<size_t>(Count(schema_.string_size));
+  while (dest.size() < size) {
+    if (Random()) {
+      dest.push_back(static_cast<char>(random_()));
+    } else {
+      const absl::string_view word =
+          kVocabulary[random_() % kVocabulary.size()];
+      dest.append(word.data(), word.size());
+    }
+  }
+  dest.resize(size);
+}
+
+const char kUsage[] =
+    "Usage: generate_benchmark_records (OPTION)... FILE\n"
+    "\n"
+    "Writes synthetic records in the protocol buffer wire format to a\n"
+    "Riegeli/records FILE, to be read by records_benchmark. The records\n"
+    "depend only on the options, so the same corpus can be recreated on\n"
+    "another machine.\n";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (args.size() != 2) {
+    absl::Format(&riegeli::StdErr(), "%s\n", kUsage);
+    return 1;
+  }
+  Schema schema;
+  if (!ParseSchema(absl::GetFlag(FLAGS_schema), schema)) return 1;
+  Distribution distribution;
+  const std::string distribution_name = absl::GetFlag(FLAGS_distribution);
+  if (distribution_name == "fixed") {
+    distribution = Distribution::kFixed;
+  } else if (distribution_name == "uniform") {
+    distribution = Distribution::kUniform;
+  } else if (distribution_name == "exponential") {
+    distribution = Distribution::kExponential;
+  } else {
+    absl::Format(&riegeli::StdErr(), "Invalid --distribution: %s\n",
+                 distribution_name);
+    return 1;
+  }
+  const double entropy = absl::GetFlag(FLAGS_entropy);
+  if (!(entropy >= 0.0 && entropy <= 1.0)) {
+    absl::Format(&riegeli::StdErr(), "Invalid --entropy: %g\n", entropy);
+    return 1;
+  }
+  const uint64_t num_records = absl::GetFlag(FLAGS_num_records);
+  const uint64_t seed = absl::GetFlag(FLAGS_seed);
+
+  riegeli::RecordWriterBase::Options record_writer_options;
+  {
+    const absl::Status status =
+        record_writer_options.FromString(absl::GetFlag(FLAGS_riegeli_options));
+    if (!status.ok()) {
+      absl::Format(&riegeli::StdErr(), "Invalid --riegeli_options: %s\n",
+                   status.message());
+      return 1;
+    }
+  }
+  // Record the parameters, so that the corpus can be recreated.
+  riegeli::RecordsMetadata metadata;
+  metadata.set_file_comment(absl::StrFormat(
+      "generate_benchmark_records --schema=%s --distribution=%s "
+      "--entropy=%g --num_records=%u --seed=%u",
+      absl::GetFlag(FLAGS_schema), distribution_name, entropy, num_records,
+      seed));
+  record_writer_options.set_metadata(std::move(metadata));
+
+  riegeli::RecordWriter<riegeli::FdWriter<>> record_writer(
+      std::forward_as_tuple(args[1], O_WRONLY | O_CREAT | O_TRUNC),
+      std::move(record_writer_options));
+  RecordGenerator generator(schema, distribution, entropy, seed);
+  for (uint64_t i = 0; i < num_records; ++i) {
+    if (!record_writer.WriteRecord(generator.Next())) break;
+  }
+  if (!record_writer.Close()) {
+    absl::Format(&riegeli::StdErr(), "Could not write %s: %s\n", args[1],
+                 record_writer.status().message());
+    return 1;
+  }
+}
@@ -19,14 +19,17 @@
 #include <fcntl.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <array>
 #include <cerrno>
+#include <cmath>
 #include <cstdlib>
 #include <iterator>
 #include <memory>
@@ -41,10 +44,13 @@
 #include "absl/flags/usage.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/errno_mapping.h"
 #include "riegeli/base/options_parser.h"
@@ -53,6 +59,7 @@
 #include "riegeli/bytes/std_io.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_position.h"
 #include "riegeli/records/record_reader.h"
 #include "riegeli/records/record_writer.h"
 #include "riegeli/records/tools/tfrecord_recognizer.h"
@@ -89,6 +96,12 @@ ABSL_FLAG(uint64_t, max_size, uint64_t{100} * 1000 * 1000,
 ABSL_FLAG(std::string, output_dir, "/tmp",
           "Directory to write files to (files are named record_benchmark_*)");
 ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+ABSL_FLAG(std::string, parallelism_sweep, "",
+          "Whitespace-separated values of parallelism to run each Riegeli "
+          "benchmark with, replacing its own parallelism option; if empty, "
+          "each Riegeli benchmark runs once as given");
+ABSL_FLAG(std::string, json_output, "",
+          "If not empty, a file to write results to in JSON format");
 
 namespace {
 
@@ -139,12 +152,65 @@ uint64_t RealTimeNow_ns() {
          riegeli::IntCast<uint64_t>(time_info.tv_nsec);
 }
 
+// Resets the peak resident set size of the process to its current size, so
+// that `PeakRss()` reflects only what happens afterwards.
+//
+// This is supported only by Linux. Elsewhere `PeakRss()` stays the peak since
+// the process started.
+void ResetPeakRss() {
+  const int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) return;
+  // Writing "5" resets the peak resident set size.
+  ssize_t result;
+  do {
+    result = write(fd, "5", 1);
+  } while (result < 0 && errno == EINTR);
+  close(fd);
+}
+
+// Returns the peak resident set size of the process, in bytes.
+uint64_t PeakRss() {
+  const int fd = open("/proc/self/status", O_RDONLY);
+  if (fd >= 0) {
+    std::string status;
+    char buffer[4096];
+    for (;;) {
+      const ssize_t length_read = read(fd, buffer, sizeof(buffer));
+      if (length_read < 0 && errno == EINTR) continue;
+      if (length_read <= 0) break;
+      status.append(buffer, riegeli::IntCast<size_t>(length_read));
+    }
+    close(fd);
+    for (absl::string_view line : absl::StrSplit(status, '\n')) {
+      if (!absl::ConsumePrefix(&line, "VmHWM:")) continue;
+      line = absl::StripAsciiWhitespace(line);
+      uint64_t peak_rss_kb;
+      if (absl::ConsumeSuffix(&line, " kB") &&
+          absl::SimpleAtoi(line, &peak_rss_kb)) {
+        return peak_rss_kb * 1024;
+      }
+    }
+  }
+  struct rusage usage;
+  RIEGELI_CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  // `ru_maxrss` is in kilobytes.
+  return riegeli::IntCast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
 class Stats {
  public:
   void Add(double value);
 
+  bool empty() const { return samples_.empty(); }
+
   double Median();
 
+  // Returns the smallest sample such that at least `fraction` of samples are
+  // not greater.
+  //
+  // Precondition: `fraction >= 0.0 && fraction <= 1.0`
+  double Percentile(double fraction);
+
  private:
   std::vector<double> samples_;
 };
@@ -160,6 +226,62 @@ double Stats::Median() {
   return samples_[middle];
 }
 
+double Stats::Percentile(double fraction) {
+  RIEGELI_CHECK(!samples_.empty()) << "No data";
+  RIEGELI_CHECK(fraction >= 0.0 && fraction <= 1.0)
+      << "Fraction out of range: " << fraction;
+  size_t index = static_cast<size_t>(
+      std::ceil(fraction * static_cast<double>(samples_.size())));
+  if (index > 0) --index;
+  std::nth_element(samples_.begin(),
+                   samples_.begin() + riegeli::IntCast<ptrdiff_t>(index),
+                   samples_.end());
+  return samples_[index];
+}
+
+// Results of a single benchmark, after taking medians of repetitions.
+struct Result {
+  std::string name;
+  double compression;
+  double writing_cpu_speed;
+  double writing_real_speed;
+  double reading_cpu_speed;
+  double reading_real_speed;
+  // Latencies of writing a record, in microseconds.
+  double write_latency_p50;
+  double write_latency_p99;
+  // Latencies of reading the first record of a chunk, which includes reading
+  // and decoding the chunk, in microseconds. Not applicable to TFRecord.
+  bool has_chunk_latency;
+  double chunk_latency_p50;
+  double chunk_latency_p99;
+  // Peak resident set size during the benchmark, in bytes.
+  uint64_t peak_rss;
+};
+
+// Appends `src` as a JSON string literal to `dest`.
+void AppendJsonString(absl::string_view src, std::string& dest) {
+  dest.push_back('"');
+  for (const char ch : src) {
+    switch (ch) {
+      case '"':
+        dest.append("\\\"");
+        break;
+      case '\\':
+        dest.append("\\\\");
+        break;
+      default:
+        if (static_cast<unsigned char>(ch) < 0x20) {
+          absl::StrAppendFormat(&dest, "\\u%04x",
+                                static_cast<unsigned char>(ch));
+        } else {
+          dest.push_back(ch);
+        }
+    }
+  }
+  dest.push_back('"');
+}
+
 class Benchmarks {
  public:
   static bool ReadFile(absl::string_view filename,
@@ -170,35 +292,52 @@ class Benchmarks {
                       int repetitions);
 
   void RegisterTFRecord(absl::string_view tfrecord_options);
-  void RegisterRiegeli(absl::string_view riegeli_options);
+  // If `parallelism_sweep` is not empty, registers a benchmark for each of its
+  // values, replacing the parallelism given in `riegeli_options`.
+  void RegisterRiegeli(absl::string_view riegeli_options,
+                       const std::vector<int>& parallelism_sweep = {});
 
   void RunAll(riegeli::Writer& report);
 
+  // Writes results of `RunAll()` in JSON format.
+  void WriteJson(riegeli::Writer& dest) const;
+
  private:
+  // If `write_latency != nullptr`, adds to it latencies of writing each
+  // record, in microseconds.
   static void WriteTFRecord(
       absl::string_view filename,
       const tensorflow::io::RecordWriterOptions& record_writer_options,
-      const std::vector<std::string>& records);
+      const std::vector<std::string>& records, Stats* write_latency = nullptr);
   static bool ReadTFRecord(
       absl::string_view filename,
       const tensorflow::io::RecordReaderOptions& record_reader_options,
       std::vector<std::string>* records, SizeLimiter* size_limiter = nullptr);
 
+  // If `write_latency != nullptr`, adds to it latencies of writing each
+  // record, in microseconds.
   static void WriteRiegeli(
       absl::string_view filename,
       riegeli::RecordWriterBase::Options record_writer_options,
-      const std::vector<std::string>& records);
+      const std::vector<std::string>& records, Stats* write_latency = nullptr);
+  // If `chunk_latency != nullptr`, adds to it latencies of reading the first
+  // record of each chunk, in microseconds.
   static bool ReadRiegeli(
       absl::string_view filename,
       riegeli::RecordReaderBase::Options record_reader_options,
-      std::vector<std::string>* records, SizeLimiter* size_limiter = nullptr);
+      std::vector<std::string>* records, SizeLimiter* size_limiter = nullptr,
+      Stats* chunk_latency = nullptr);
 
+  // `write_records()` and `read_records()` measure latencies if their last
+  // argument is not `nullptr`. `read_records()` can leave it empty if the
+  // format has no chunks.
   void RunOne(
       absl::string_view name,
-      absl::FunctionRef<void(absl::string_view,
-                             const std::vector<std::string>&)>
+      absl::FunctionRef<void(absl::string_view, const std::vector<std::string>&,
+                             Stats*)>
           write_records,
-      absl::FunctionRef<void(absl::string_view, std::vector<std::string>*)>
+      absl::FunctionRef<void(absl::string_view, std::vector<std::string>*,
+                             Stats*)>
           read_records,
       riegeli::Writer& report);
 
@@ -212,6 +351,7 @@ class Benchmarks {
   std::vector<std::pair<std::string, riegeli::RecordWriterBase::Options>>
       riegeli_benchmarks_;
   int max_name_width_ = 0;
+  std::vector<Result> results_;
 };
 
 bool Benchmarks::ReadFile(absl::string_view filename,
@@ -255,7 +395,7 @@ bool Benchmarks::ReadFile(absl::string_view filename,
 void Benchmarks::WriteTFRecord(
     absl::string_view filename,
     const tensorflow::io::RecordWriterOptions& record_writer_options,
-    const std::vector<std::string>& records) {
+    const std::vector<std::string>& records, Stats* write_latency) {
   tensorflow::Env* const env = tensorflow::Env::Default();
   std::unique_ptr<tensorflow::WritableFile> file_writer;
   {
@@ -266,8 +406,14 @@ void Benchmarks::WriteTFRecord(
   tensorflow::io::RecordWriter record_writer(file_writer.get(),
                                              record_writer_options);
   for (absl::string_view record : records) {
+    const uint64_t time_before_ns =
+        write_latency == nullptr ? 0 : RealTimeNow_ns();
     const tensorflow::Status status = record_writer.WriteRecord(record);
     RIEGELI_CHECK(status.ok()) << status;
+    if (write_latency != nullptr) {
+      write_latency->Add(
+          static_cast<double>(RealTimeNow_ns() - time_before_ns) / 1000.0);
+    }
   }
   const tensorflow::Status status = record_writer.Close();
   RIEGELI_CHECK(status.ok()) << status;
@@ -306,12 +452,18 @@ bool Benchmarks::ReadTFRecord(
 void Benchmarks::WriteRiegeli(
     absl::string_view filename,
     riegeli::RecordWriterBase::Options record_writer_options,
-    const std::vector<std::string>& records) {
+    const std::vector<std::string>& records, Stats* write_latency) {
   riegeli::RecordWriter<riegeli::FdWriter<>> record_writer(
       std::forward_as_tuple(filename, O_WRONLY | O_CREAT | O_TRUNC),
       std::move(record_writer_options));
   for (const std::string& record : records) {
+    const uint64_t time_before_ns =
+        write_latency == nullptr ? 0 : RealTimeNow_ns();
     RIEGELI_CHECK(record_writer.WriteRecord(record)) << record_writer.status();
+    if (write_latency != nullptr) {
+      write_latency->Add(
+          static_cast<double>(RealTimeNow_ns() - time_before_ns) / 1000.0);
+    }
   }
   RIEGELI_CHECK(record_writer.Close()) << record_writer.status();
 }
@@ -319,12 +471,28 @@ void Benchmarks::WriteRiegeli(
 bool Benchmarks::ReadRiegeli(
     absl::string_view filename,
     riegeli::RecordReaderBase::Options record_reader_options,
-    std::vector<std::string>* records, SizeLimiter* size_limiter) {
+    std::vector<std::string>* records, SizeLimiter* size_limiter,
+    Stats* chunk_latency) {
   riegeli::RecordReader<riegeli::FdReader<>> record_reader(
       std::forward_as_tuple(filename, O_RDONLY),
       std::move(record_reader_options));
   std::string record;
-  while (record_reader.ReadRecord(record)) {
+  bool is_first_record = true;
+  uint64_t last_chunk_begin = 0;
+  for (;;) {
+    const uint64_t time_before_ns =
+        chunk_latency == nullptr ? 0 : RealTimeNow_ns();
+    if (!record_reader.ReadRecord(record)) break;
+    if (chunk_latency != nullptr) {
+      const uint64_t time_after_ns = RealTimeNow_ns();
+      const uint64_t chunk_begin = record_reader.last_pos().chunk_begin();
+      if (is_first_record || chunk_begin != last_chunk_begin) {
+        chunk_latency->Add(
+            static_cast<double>(time_after_ns - time_before_ns) / 1000.0);
+        is_first_record = false;
+        last_chunk_begin = chunk_begin;
+      }
+    }
     if (size_limiter != nullptr &&
         ABSL_PREDICT_FALSE(!size_limiter->Accept(
             riegeli::LengthVarint64(record.size()) + record.size()))) {
@@ -381,43 +549,85 @@ void Benchmarks::RegisterTFRecord(absl::string_view tfrecord_options) {
   tfrecord_benchmarks_.emplace_back(tfrecord_options, compression);
 }
 
-void Benchmarks::RegisterRiegeli(absl::string_view riegeli_options) {
-  max_name_width_ =
-      std::max(max_name_width_,
-               riegeli::IntCast<int>(absl::string_view("riegeli ").size() +
-                                     riegeli_options.size()));
+void Benchmarks::RegisterRiegeli(absl::string_view riegeli_options,
+                                 const std::vector<int>& parallelism_sweep) {
   riegeli::RecordWriterBase::Options options;
   RIEGELI_CHECK_EQ(options.FromString(riegeli_options), absl::OkStatus());
-  riegeli_benchmarks_.emplace_back(riegeli_options, std::move(options));
+  std::vector<std::pair<std::string, riegeli::RecordWriterBase::Options>>
+      benchmarks;
+  if (parallelism_sweep.empty()) {
+    benchmarks.emplace_back(riegeli_options, std::move(options));
+  } else {
+    std::string base_name;
+    for (const absl::string_view option :
+         absl::StrSplit(riegeli_options, ',', absl::SkipEmpty())) {
+      if (option == "parallelism" || absl::StartsWith(option, "parallelism:")) {
+        continue;
+      }
+      absl::StrAppend(&base_name, base_name.empty() ? "" : ",", option);
+    }
+    for (const int parallelism : parallelism_sweep) {
+      benchmarks.emplace_back(
+          absl::StrCat(base_name, base_name.empty() ? "" : ",", "parallelism:",
+                       parallelism),
+          riegeli::RecordWriterBase::Options(options).set_parallelism(
+              parallelism));
+    }
+  }
+  for (std::pair<std::string, riegeli::RecordWriterBase::Options>& benchmark :
+       benchmarks) {
+    // Options differing only in parallelism lead to the same benchmarks when
+    // parallelism is swept.
+    if (std::any_of(
+            riegeli_benchmarks_.begin(), riegeli_benchmarks_.end(),
+            [&](const std::pair<std::string,
+                                riegeli::RecordWriterBase::Options>& existing) {
+              return existing.first == benchmark.first;
+            })) {
+      continue;
+    }
+    max_name_width_ =
+        std::max(max_name_width_,
+                 riegeli::IntCast<int>(absl::string_view("riegeli ").size() +
+                                       benchmark.first.size()));
+    riegeli_benchmarks_.push_back(std::move(benchmark));
+  }
 }
 
 void Benchmarks::RunAll(riegeli::Writer& report) {
   absl::Format(&report, "Original uncompressed size: %.3f MB\n",
                static_cast<double>(original_size_) / 1000000.0);
   absl::Format(&report, "Creating files %s/record_benchmark_*\n", output_dir_);
-  absl::Format(&report, "%-*s  Compr.    Write       Read\n", max_name_width_,
-               "");
-  absl::Format(&report, "%-*s  ratio    CPU Real   CPU Real\n", max_name_width_,
-               "");
-  absl::Format(&report, "%-*s    %%     MB/s MB/s  MB/s MB/s\n",
+  absl::Format(&report,
+               "%-*s  Compr.    Write       Read"
+               "    Write lat. us      Chunk read us    Peak\n",
+               max_name_width_, "");
+  absl::Format(&report,
+               "%-*s  ratio    CPU Real   CPU Real"
+               "      p50     p99       p50      p99     RSS\n",
+               max_name_width_, "");
+  absl::Format(&report,
+               "%-*s    %%     MB/s MB/s  MB/s MB/s"
+               "                                          MB\n",
                max_name_width_, "Format");
   absl::Format(
       &report, "%s\n",
-      std::string(riegeli::IntCast<size_t>(max_name_width_ + 30), '-'));
+      std::string(riegeli::IntCast<size_t>(max_name_width_ + 74), '-'));
 
   for (const std::pair<std::string, const char*>& tfrecord_options :
        tfrecord_benchmarks_) {
     RunOne(
         absl::StrCat("tfrecord ", tfrecord_options.first),
-        [&](absl::string_view filename,
-            const std::vector<std::string>& records) {
+        [&](absl::string_view filename, const std::vector<std::string>& records,
+            Stats* write_latency) {
           WriteTFRecord(
               filename,
               tensorflow::io::RecordWriterOptions::CreateRecordWriterOptions(
                   tfrecord_options.second),
-              records);
+              records, write_latency);
         },
-        [&](absl::string_view filename, std::vector<std::string>* records) {
+        [&](absl::string_view filename, std::vector<std::string>* records,
+            Stats* chunk_latency) {
           return ReadTFRecord(
               filename,
               tensorflow::io::RecordReaderOptions::CreateRecordReaderOptions(
@@ -430,13 +640,15 @@ void Benchmarks::RunAll(riegeli::Writer& report) {
            riegeli_options : riegeli_benchmarks_) {
     RunOne(
         absl::StrCat("riegeli ", riegeli_options.first),
-        [&](absl::string_view filename,
-            const std::vector<std::string>& records) {
-          WriteRiegeli(filename, riegeli_options.second, records);
+        [&](absl::string_view filename, const std::vector<std::string>& records,
+            Stats* write_latency) {
+          WriteRiegeli(filename, riegeli_options.second, records,
+                       write_latency);
         },
-        [&](absl::string_view filename, std::vector<std::string>* records) {
+        [&](absl::string_view filename, std::vector<std::string>* records,
+            Stats* chunk_latency) {
           return ReadRiegeli(filename, riegeli::RecordReaderBase::Options(),
-                             records);
+                             records, nullptr, chunk_latency);
         },
         report);
   }
@@ -444,15 +656,18 @@ void Benchmarks::RunAll(riegeli::Writer& report) {
 
 void Benchmarks::RunOne(
     absl::string_view name,
-    absl::FunctionRef<void(absl::string_view, const std::vector<std::string>&)>
+    absl::FunctionRef<void(absl::string_view, const std::vector<std::string>&,
+                           Stats*)>
         write_records,
-    absl::FunctionRef<void(absl::string_view, std::vector<std::string>*)>
+    absl::FunctionRef<void(absl::string_view, std::vector<std::string>*,
+                           Stats*)>
         read_records,
     riegeli::Writer& report) {
   absl::Format(&report, "%-*s ", max_name_width_, name);
   report.Flush();
   const std::string filename =
       absl::StrCat(output_dir_, "/record_benchmark_", Filename(name));
+  ResetPeakRss();
 
   Stats compression;
   Stats writing_cpu_speed;
@@ -462,7 +677,7 @@ void Benchmarks::RunOne(
   for (int i = 0; i < repetitions_ + 1; ++i) {
     const uint64_t cpu_time_before_ns = CpuTimeNow_ns();
     const uint64_t real_time_before_ns = RealTimeNow_ns();
-    write_records(filename, records_);
+    write_records(filename, records_, nullptr);
     const uint64_t cpu_time_after_ns = CpuTimeNow_ns();
     const uint64_t real_time_after_ns = RealTimeNow_ns();
     if (i == 0) {
@@ -479,11 +694,15 @@ void Benchmarks::RunOne(
           1000.0);
     }
   }
+  // Latencies are measured in a separate pass, so that reading the clock for
+  // each record does not affect throughput.
+  Stats write_latency;
+  write_records(filename, records_, &write_latency);
   for (int i = 0; i < repetitions_ + 1; ++i) {
     std::vector<std::string> decoded_records;
     const uint64_t cpu_time_before_ns = CpuTimeNow_ns();
     const uint64_t real_time_before_ns = RealTimeNow_ns();
-    read_records(filename, &decoded_records);
+    read_records(filename, &decoded_records, nullptr);
     const uint64_t cpu_time_after_ns = CpuTimeNow_ns();
     const uint64_t real_time_after_ns = RealTimeNow_ns();
     if (i == 0) {
@@ -500,17 +719,79 @@ void Benchmarks::RunOne(
           1000.0);
     }
   }
+  Stats chunk_latency;
+  {
+    std::vector<std::string> decoded_records;
+    read_records(filename, &decoded_records, &chunk_latency);
+  }
 
-  absl::Format(&report, "%7.3f", compression.Median());
-  for (const std::array<Stats*, 2>& stats_cpu_real :
-       {std::array<Stats*, 2>{{&writing_cpu_speed, &writing_real_speed}},
-        std::array<Stats*, 2>{{&reading_cpu_speed, &reading_real_speed}}}) {
-    absl::Format(&report, " ");
-    for (Stats* const stats : stats_cpu_real) {
-      absl::Format(&report, " %4.0f", stats->Median());
+  Result result;
+  result.name = std::string(name);
+  result.compression = compression.Median();
+  result.writing_cpu_speed = writing_cpu_speed.Median();
+  result.writing_real_speed = writing_real_speed.Median();
+  result.reading_cpu_speed = reading_cpu_speed.Median();
+  result.reading_real_speed = reading_real_speed.Median();
+  result.write_latency_p50 = write_latency.Percentile(0.5);
+  result.write_latency_p99 = write_latency.Percentile(0.99);
+  result.has_chunk_latency = !chunk_latency.empty();
+  result.chunk_latency_p50 =
+      result.has_chunk_latency ? chunk_latency.Percentile(0.5) : 0.0;
+  result.chunk_latency_p99 =
+      result.has_chunk_latency ? chunk_latency.Percentile(0.99) : 0.0;
+  result.peak_rss = PeakRss();
+
+  absl::Format(&report, "%7.3f", result.compression);
+  absl::Format(&report, "  %4.0f %4.0f  %4.0f %4.0f", result.writing_cpu_speed,
+               result.writing_real_speed, result.reading_cpu_speed,
+               result.reading_real_speed);
+  absl::Format(&report, "  %7.2f %7.2f", result.write_latency_p50,
+               result.write_latency_p99);
+  if (result.has_chunk_latency) {
+    absl::Format(&report, "  %8.1f %8.1f", result.chunk_latency_p50,
+                 result.chunk_latency_p99);
+  } else {
+    absl::Format(&report, "  %8s %8s", "-", "-");
+  }
+  absl::Format(&report, "  %6.0f\n",
+               static_cast<double>(result.peak_rss) / 1000000.0);
+  results_.push_back(std::move(result));
+}
+
+void Benchmarks::WriteJson(riegeli::Writer& dest) const {
+  std::string json;
+  absl::StrAppendFormat(&json,
+                        "{\n  \"original_size_bytes\": %u,\n"
+                        "  \"repetitions\": %d,\n  \"benchmarks\": [",
+                        original_size_, repetitions_);
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const Result& result = results_[i];
+    absl::StrAppend(&json, i == 0 ? "" : ",", "\n    {\"name\": ");
+    AppendJsonString(result.name, json);
+    absl::StrAppendFormat(
+        &json,
+        ",\n     \"compression_ratio_percent\": %.3f,"
+        "\n     \"write_cpu_mb_per_s\": %.3f,"
+        "\n     \"write_real_mb_per_s\": %.3f,"
+        "\n     \"read_cpu_mb_per_s\": %.3f,"
+        "\n     \"read_real_mb_per_s\": %.3f,"
+        "\n     \"write_latency_us\": {\"p50\": %.3f, \"p99\": %.3f},",
+        result.compression, result.writing_cpu_speed, result.writing_real_speed,
+        result.reading_cpu_speed, result.reading_real_speed,
+        result.write_latency_p50, result.write_latency_p99);
+    if (result.has_chunk_latency) {
+      absl::StrAppendFormat(
+          &json, "\n     \"chunk_read_latency_us\": {\"p50\": %.3f, \"p99\": "
+                 "%.3f},",
+          result.chunk_latency_p50, result.chunk_latency_p99);
+    } else {
+      absl::StrAppend(&json, "\n     \"chunk_read_latency_us\": null,");
     }
+    absl::StrAppendFormat(&json, "\n     \"peak_rss_bytes\": %u}",
+                          result.peak_rss);
   }
-  absl::Format(&report, "\n");
+  absl::StrAppend(&json, "\n  ]\n}\n");
+  dest.Write(json);
 }
 
 const char kUsage[] =
@@ -550,9 +831,27 @@ int main(int argc, char** argv) {
               [&](absl::string_view tfrecord_options) {
                 benchmarks.RegisterTFRecord(tfrecord_options);
               });
+  std::vector<int> parallelism_sweep;
+  ForEachWord(absl::GetFlag(FLAGS_parallelism_sweep),
+              [&](absl::string_view parallelism_text) {
+                int parallelism;
+                if (!absl::SimpleAtoi(parallelism_text, &parallelism) ||
+                    parallelism < 0) {
+                  absl::Format(&riegeli::StdErr(), "Invalid parallelism: %s\n",
+                               parallelism_text);
+                  std::exit(1);
+                }
+                parallelism_sweep.push_back(parallelism);
+              });
   ForEachWord(absl::GetFlag(FLAGS_riegeli_benchmarks),
               [&](absl::string_view riegeli_options) {
-                benchmarks.RegisterRiegeli(riegeli_options);
+                benchmarks.RegisterRiegeli(riegeli_options, parallelism_sweep);
               });
   benchmarks.RunAll(riegeli::StdOut());
+  const std::string json_output = absl::GetFlag(FLAGS_json_output);
+  if (!json_output.empty()) {
+    riegeli::FdWriter<> json_writer(json_output, O_WRONLY | O_CREAT | O_TRUNC);
+    benchmarks.WriteJson(json_writer);
+    RIEGELI_CHECK(json_writer.Close()) << json_writer.status();
+  }
 }
@@ -0,0 +1,140 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make file offsets 64-bit even on 32-bit systems.
+#undef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stddef.h>
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/records_metadata.pb.h"
+
+ABSL_FLAG(std::string, output, "", "Riegeli/records file to write.");
+ABSL_FLAG(std::string, metadata, "first",
+          "File metadata of the output: first (metadata of the first input), "
+          "merge (metadata of all inputs merged as protocol buffers, later "
+          "inputs overriding singular fields), or none");
+ABSL_FLAG(std::string, riegeli_options, "",
+          "Riegeli RecordWriter options of the output. Options of encoding and "
+          "compression matter only for metadata, because chunks of records "
+          "are copied as they are.");
+
+namespace riegeli {
+namespace tools {
+namespace {
+
+enum class MetadataMode { kFirst, kMerge, kNone };
+
+bool ReadMetadata(const char* filename, RecordsMetadata& metadata) {
+  RecordReader<FdReader<>> record_reader(
+      std::forward_as_tuple(filename, O_RDONLY));
+  if (!record_reader.ReadMetadata(metadata) || !record_reader.Close()) {
+    absl::Format(&StdErr(), "Could not read metadata of %s: %s\n", filename,
+                 record_reader.status().message());
+    return false;
+  }
+  return true;
+}
+
+const char kUsage[] =
+    "Usage: riegeli_cat --output=OUTPUT (OPTION)... INPUT...\n"
+    "\n"
+    "Concatenates Riegeli/records files. Chunks of records are copied without\n"
+    "decoding them, so this runs at the speed of reading and writing files.\n";
+
+}  // namespace
+}  // namespace tools
+}  // namespace riegeli
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(riegeli::tools::kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output = absl::GetFlag(FLAGS_output);
+  if (output.empty() || args.size() < 2) {
+    absl::Format(&riegeli::StdErr(), "%s\n", riegeli::tools::kUsage);
+    return 1;
+  }
+  riegeli::tools::MetadataMode metadata_mode;
+  const std::string metadata_name = absl::GetFlag(FLAGS_metadata);
+  if (metadata_name == "first") {
+    metadata_mode = riegeli::tools::MetadataMode::kFirst;
+  } else if (metadata_name == "merge") {
+    metadata_mode = riegeli::tools::MetadataMode::kMerge;
+  } else if (metadata_name == "none") {
+    metadata_mode = riegeli::tools::MetadataMode::kNone;
+  } else {
+    absl::Format(&riegeli::StdErr(), "Invalid --metadata: %s\n",
+                 metadata_name);
+    return 1;
+  }
+
+  riegeli::RecordWriterBase::Options record_writer_options;
+  {
+    const absl::Status status =
+        record_writer_options.FromString(absl::GetFlag(FLAGS_riegeli_options));
+    if (!status.ok()) {
+      absl::Format(&riegeli::StdErr(), "Invalid --riegeli_options: %s\n",
+                   status.message());
+      return 1;
+    }
+  }
+  if (metadata_mode != riegeli::tools::MetadataMode::kNone) {
+    riegeli::RecordsMetadata metadata;
+    const size_t num_inputs =
+        metadata_mode == riegeli::tools::MetadataMode::kFirst ? 1
+                                                              : args.size() - 1;
+    for (size_t i = 1; i <= num_inputs; ++i) {
+      riegeli::RecordsMetadata input_metadata;
+      if (!riegeli::tools::ReadMetadata(args[i], input_metadata)) return 1;
+      metadata.MergeFrom(input_metadata);
+    }
+    record_writer_options.set_metadata(std::move(metadata));
+  }
+
+  riegeli::RecordWriter<riegeli::FdWriter<>> record_writer(
+      std::forward_as_tuple(output, O_WRONLY | O_CREAT | O_TRUNC),
+      std::move(record_writer_options));
+  for (size_t i = 1; i < args.size(); ++i) {
+    riegeli::DefaultChunkReader<riegeli::FdReader<>> chunk_reader(
+        std::forward_as_tuple(args[i], O_RDONLY));
+    if (!record_writer.WriteChunksFrom(chunk_reader)) break;
+    if (!chunk_reader.Close()) {
+      absl::Format(&riegeli::StdErr(), "Could not read %s: %s\n", args[i],
+                   chunk_reader.status().message());
+      return 1;
+    }
+  }
+  if (!record_writer.Close()) {
+    absl::Format(&riegeli::StdErr(), "Could not write %s: %s\n", output,
+                 record_writer.status().message());
+    return 1;
+  }
+}
@@ -0,0 +1,189 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Make file offsets 64-bit even on 32-bit systems.
+#undef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stdint.h>
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/records_metadata.pb.h"
+#include "riegeli/records/transcode_records.h"
+
+ABSL_FLAG(std::string, output, "", "Riegeli/records file to write.");
+ABSL_FLAG(std::string, riegeli_options, "",
+          "Riegeli RecordWriter options of the output, e.g. "
+          "\"brotli:9,transpose,parallelism:8\".");
+ABSL_FLAG(int, reader_parallelism, 0,
+          "Maximum number of threads decoding chunks of the input.");
+ABSL_FLAG(uint64_t, checkpoint_interval, uint64_t{1} << 30,
+          "Total size of records between checkpoints printed to stderr, or 0 "
+          "for no checkpoints.");
+ABSL_FLAG(std::string, start_position, "",
+          "Resume from a checkpoint: position in the input of the next record "
+          "to transcode, as printed in the checkpoint.");
+ABSL_FLAG(int64_t, output_size, -1,
+          "Resume from a checkpoint: size of the output to keep, as printed "
+          "in the checkpoint.");
+
+namespace riegeli {
+namespace tools {
+namespace {
+
+void PrintCheckpoint(const TranscodeCheckpoint& checkpoint) {
+  absl::Format(&StdErr(),
+               "Checkpoint after %u records: --start_position=%s "
+               "--output_size=%u\n",
+               checkpoint.num_records, checkpoint.src_pos.ToString(),
+               checkpoint.dest_size);
+  StdErr().Flush();
+}
+
+const char kUsage[] =
+    "Usage: riegeli_transcode --output=OUTPUT (OPTION)... INPUT\n"
+    "\n"
+    "Re-encodes a Riegeli/records file with different options, e.g. with\n"
+    "different compression or chunk size. Chunks are decoded and encoded in\n"
+    "parallel with --reader_parallelism and parallelism in --riegeli_options.\n"
+    "\n"
+    "Checkpoints are printed to stderr. After an interruption, transcoding\n"
+    "can be resumed by passing flags printed by the last checkpoint.\n";
+
+}  // namespace
+}  // namespace tools
+}  // namespace riegeli
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(riegeli::tools::kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output = absl::GetFlag(FLAGS_output);
+  if (output.empty() || args.size() != 2) {
+    absl::Format(&riegeli::StdErr(), "%s\n", riegeli::tools::kUsage);
+    return 1;
+  }
+  riegeli::RecordWriterBase::Options record_writer_options;
+  {
+    const absl::Status status =
+        record_writer_options.FromString(absl::GetFlag(FLAGS_riegeli_options));
+    if (!status.ok()) {
+      absl::Format(&riegeli::StdErr(), "Invalid --riegeli_options: %s\n",
+                   status.message());
+      return 1;
+    }
+  }
+  const int reader_parallelism = absl::GetFlag(FLAGS_reader_parallelism);
+  if (reader_parallelism < 0) {
+    absl::Format(&riegeli::StdErr(), "Invalid --reader_parallelism: %d\n",
+                 reader_parallelism);
+    return 1;
+  }
+  const std::string start_position_text = absl::GetFlag(FLAGS_start_position);
+  const int64_t output_size = absl::GetFlag(FLAGS_output_size);
+  const bool resume = !start_position_text.empty();
+  riegeli::RecordPosition start_position;
+  if (resume) {
+    if (!start_position.FromString(start_position_text)) {
+      absl::Format(&riegeli::StdErr(), "Invalid --start_position: %s\n",
+                   start_position_text);
+      return 1;
+    }
+    if (output_size < 0) {
+      absl::Format(&riegeli::StdErr(),
+                   "--start_position requires --output_size\n");
+      return 1;
+    }
+  } else if (output_size >= 0) {
+    absl::Format(&riegeli::StdErr(),
+                 "--output_size requires --start_position\n");
+    return 1;
+  }
+
+  riegeli::RecordReader<riegeli::FdReader<>> record_reader(
+      std::forward_as_tuple(args[1], O_RDONLY),
+      riegeli::RecordReaderBase::Options().set_parallelism(
+          reader_parallelism));
+  if (resume) {
+    record_reader.Seek(start_position);
+  } else {
+    riegeli::RecordsMetadata metadata;
+    if (record_reader.ReadMetadata(metadata)) {
+      record_writer_options.set_metadata(std::move(metadata));
+    }
+  }
+  if (!record_reader.healthy()) {
+    absl::Format(&riegeli::StdErr(), "Could not read %s: %s\n", args[1],
+                 record_reader.status().message());
+    return 1;
+  }
+
+  riegeli::FdWriter<> fd_writer(
+      output, O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC));
+  if (resume && !fd_writer.Truncate(riegeli::IntCast<riegeli::Position>(
+                    output_size))) {
+    absl::Format(&riegeli::StdErr(), "Could not truncate %s to %d: %s\n",
+                 output, output_size,
+                 fd_writer.healthy()
+                     ? absl::string_view("file is smaller")
+                     : fd_writer.status().message());
+    return 1;
+  }
+  riegeli::RecordWriter<riegeli::FdWriter<>> record_writer(
+      std::move(fd_writer), std::move(record_writer_options));
+
+  riegeli::TranscodeRecordsOptions transcode_options;
+  const uint64_t checkpoint_interval = absl::GetFlag(FLAGS_checkpoint_interval);
+  if (checkpoint_interval > 0) {
+    transcode_options.set_checkpoint(riegeli::tools::PrintCheckpoint)
+        .set_checkpoint_interval(checkpoint_interval);
+  }
+  {
+    const absl::Status status = riegeli::TranscodeRecords(
+        record_reader, record_writer, transcode_options);
+    if (!status.ok()) {
+      absl::Format(&riegeli::StdErr(), "Could not transcode %s to %s: %s\n",
+                   args[1], output, status.message());
+      return 1;
+    }
+  }
+  if (!record_reader.Close()) {
+    absl::Format(&riegeli::StdErr(), "Could not read %s: %s\n", args[1],
+                 record_reader.status().message());
+    return 1;
+  }
+  if (!record_writer.Close()) {
+    absl::Format(&riegeli::StdErr(), "Could not write %s: %s\n", output,
+                 record_writer.status().message());
+    return 1;
+  }
+}
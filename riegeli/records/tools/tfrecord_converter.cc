@@ -0,0 +1,149 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/records/tools/tfrecord_converter.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/bytes/crc32c_digester.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/tools/tfrecord_recognizer.h"
+#include "riegeli/zlib/zlib_reader.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+
+namespace riegeli {
+
+namespace {
+
+// TFRecord stores CRC32Cs masked, to avoid problems with computing CRC32Cs of
+// data containing embedded CRC32Cs.
+inline uint32_t UnmaskCrc32c(uint32_t masked_crc) {
+  const uint32_t rotated = masked_crc - uint32_t{0xa282ead8};
+  return (rotated >> 17) | (rotated << 15);
+}
+
+absl::Status Truncated(uint64_t record_index) {
+  return absl::DataLossError(
+      absl::StrCat("Truncated TFRecord file at record ", record_index));
+}
+
+absl::Status CrcMismatch(absl::string_view what, uint64_t record_index) {
+  return absl::DataLossError(absl::StrCat("Corrupted TFRecord file: ", what,
+                                          " CRC32C mismatch at record ",
+                                          record_index));
+}
+
+// Reads uncompressed TFRecord records from `src`.
+absl::Status CopyRecords(Reader& src, RecordWriterBase& dest,
+                         uint64_t& num_records) {
+  // Each record consists of:
+  //  - `uint64_t`: length
+  //  - `uint32_t`: masked CRC32C of length
+  //  - `char[length]`: data
+  //  - `uint32_t`: masked CRC32C of data
+  static constexpr size_t kHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+  Chain record;
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(kHeaderSize))) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+      if (ABSL_PREDICT_FALSE(src.available() > 0)) {
+        return src.AnnotateStatus(Truncated(num_records));
+      }
+      return absl::OkStatus();
+    }
+    const uint64_t length = ReadLittleEndian64(src.cursor());
+    const uint32_t masked_length_crc =
+        ReadLittleEndian32(src.cursor() + sizeof(uint64_t));
+    Crc32cDigester crc32c_digester;
+    crc32c_digester.Write(absl::string_view(src.cursor(), sizeof(uint64_t)));
+    if (ABSL_PREDICT_FALSE(crc32c_digester.Digest() !=
+                           UnmaskCrc32c(masked_length_crc))) {
+      return src.AnnotateStatus(CrcMismatch("length", num_records));
+    }
+    src.move_cursor(kHeaderSize);
+    if (ABSL_PREDICT_FALSE(length > std::numeric_limits<size_t>::max())) {
+      return src.AnnotateStatus(absl::ResourceExhaustedError(
+          absl::StrCat("TFRecord record too large: ", length)));
+    }
+    uint32_t masked_data_crc;
+    if (ABSL_PREDICT_FALSE(!src.Read(IntCast<size_t>(length), record) ||
+                           !ReadLittleEndian32(src, masked_data_crc))) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+      return src.AnnotateStatus(Truncated(num_records));
+    }
+    crc32c_digester.Reset();
+    for (const absl::string_view fragment : record.blocks()) {
+      crc32c_digester.Write(fragment);
+    }
+    if (ABSL_PREDICT_FALSE(crc32c_digester.Digest() !=
+                           UnmaskCrc32c(masked_data_crc))) {
+      return src.AnnotateStatus(CrcMismatch("data", num_records));
+    }
+    if (ABSL_PREDICT_FALSE(!dest.WriteRecord(std::move(record)))) {
+      return dest.status();
+    }
+    ++num_records;
+  }
+}
+
+}  // namespace
+
+absl::Status ConvertTFRecordToRiegeli(Reader& src, RecordWriterBase& dest,
+                                      uint64_t* num_records) {
+  uint64_t num_records_written = 0;
+  if (num_records != nullptr) *num_records = 0;
+  const Position initial_pos = src.pos();
+  tensorflow::io::RecordReaderOptions record_reader_options;
+  {
+    TFRecordRecognizer tfrecord_recognizer(&src);
+    if (!tfrecord_recognizer.CheckFileFormat(record_reader_options)) {
+      if (ABSL_PREDICT_FALSE(!tfrecord_recognizer.healthy())) {
+        return tfrecord_recognizer.status();
+      }
+      return absl::OkStatus();  // Empty file.
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_pos))) {
+    return src.StatusOrAnnotate(
+        absl::InvalidArgumentError("Seeking back to the beginning failed"));
+  }
+  absl::Status status;
+  if (record_reader_options.compression_type ==
+      tensorflow::io::RecordReaderOptions::ZLIB_COMPRESSION) {
+    ZlibReader<> decompressor(&src);
+    status = CopyRecords(decompressor, dest, num_records_written);
+    if (status.ok() && ABSL_PREDICT_FALSE(!decompressor.Close())) {
+      status = decompressor.status();
+    }
+  } else {
+    status = CopyRecords(src, dest, num_records_written);
+  }
+  if (num_records != nullptr) *num_records = num_records_written;
+  return status;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,54 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_RECORDS_TOOLS_TFRECORD_CONVERTER_H_
+#define RIEGELI_RECORDS_TOOLS_TFRECORD_CONVERTER_H_
+
+#include <stdint.h>
+
+#include "absl/status/status.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// Reads records of a TFRecord file from `src` and writes them to `dest`.
+//
+// Compression of the TFRecord file (none, or zlib or gzip) is detected by
+// `TFRecordRecognizer`. Records are read without TensorFlow: CRC32Cs of
+// lengths and data are verified with `Crc32cDigester`, which uses CRC
+// instructions of the CPU when available, and records are passed to `dest` as
+// `Chain`s sharing memory with the buffer of `src` where possible.
+//
+// Records are encoded in parallel if
+// `RecordWriterBase::Options::parallelism() > 0` of `dest`.
+//
+// `src` must support `Seek()` back to its initial position, because detecting
+// compression reads the beginning of the file. `src` and `dest` are not
+// closed.
+//
+// If `num_records != nullptr`, `*num_records` is set to the number of records
+// written to `dest`, also on failure.
+//
+// Return values:
+//  * `absl::OkStatus()` - success
+//  * other status       - failure of `src` or `dest`, or invalid TFRecord
+//                         contents
+absl::Status ConvertTFRecordToRiegeli(Reader& src, RecordWriterBase& dest,
+                                      uint64_t* num_records = nullptr);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_TOOLS_TFRECORD_CONVERTER_H_
@@ -0,0 +1,163 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Make file offsets 64-bit even on 32-bit systems.
+#undef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/bytes/std_io.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/tools/tfrecord_converter.h"
+
+ABSL_FLAG(std::string, output_dir, "",
+          "Directory of output files, or empty for the directory of each "
+          "input file.");
+ABSL_FLAG(std::string, output_suffix, ".riegeli",
+          "Suffix appended to the name of each input file to form the name of "
+          "its output file.");
+ABSL_FLAG(std::string, riegeli_options, "",
+          "Riegeli RecordWriter options of output files, e.g. "
+          "\"brotli:6,transpose,parallelism:4\".");
+ABSL_FLAG(int, parallelism, 0,
+          "Maximum number of files converted concurrently, or 0 for the "
+          "number of CPUs.");
+
+namespace riegeli {
+namespace tools {
+namespace {
+
+std::string OutputFilename(absl::string_view input,
+                           absl::string_view output_dir,
+                           absl::string_view output_suffix) {
+  if (output_dir.empty()) return absl::StrCat(input, output_suffix);
+  const size_t slash = input.rfind('/');
+  const absl::string_view basename =
+      slash == absl::string_view::npos ? input : input.substr(slash + 1);
+  return absl::StrCat(output_dir, absl::EndsWith(output_dir, "/") ? "" : "/",
+                      basename, output_suffix);
+}
+
+absl::Status ConvertFile(const std::string& input, const std::string& output,
+                         RecordWriterBase::Options record_writer_options,
+                         uint64_t& num_records) {
+  FdReader<> reader(input, O_RDONLY);
+  RecordWriter<FdWriter<>> record_writer(
+      std::forward_as_tuple(output, O_WRONLY | O_CREAT | O_TRUNC),
+      std::move(record_writer_options));
+  {
+    absl::Status status =
+        ConvertTFRecordToRiegeli(reader, record_writer, &num_records);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      record_writer.Close();
+      return status;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!record_writer.Close())) return record_writer.status();
+  if (ABSL_PREDICT_FALSE(!reader.Close())) return reader.status();
+  return absl::OkStatus();
+}
+
+const char kUsage[] =
+    "Usage: tfrecord_to_riegeli (OPTION)... INPUT...\n"
+    "\n"
+    "Converts TFRecord files (uncompressed, zlib, or gzip) to Riegeli/records\n"
+    "files. CRC32Cs of TFRecord files are verified. Files are converted\n"
+    "concurrently, and records of each file are encoded in parallel if\n"
+    "--riegeli_options include parallelism.\n";
+
+}  // namespace
+}  // namespace tools
+}  // namespace riegeli
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(riegeli::tools::kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (args.size() < 2) {
+    absl::Format(&riegeli::StdErr(), "%s\n", riegeli::tools::kUsage);
+    return 1;
+  }
+  riegeli::RecordWriterBase::Options record_writer_options;
+  {
+    const absl::Status status =
+        record_writer_options.FromString(absl::GetFlag(FLAGS_riegeli_options));
+    if (!status.ok()) {
+      absl::Format(&riegeli::StdErr(), "Invalid --riegeli_options: %s\n",
+                   status.message());
+      return 1;
+    }
+  }
+  const int parallelism = absl::GetFlag(FLAGS_parallelism);
+  if (parallelism < 0) {
+    absl::Format(&riegeli::StdErr(), "Invalid --parallelism: %d\n",
+                 parallelism);
+    return 1;
+  }
+  const std::string output_dir = absl::GetFlag(FLAGS_output_dir);
+  const std::string output_suffix = absl::GetFlag(FLAGS_output_suffix);
+
+  absl::Mutex mutex;
+  std::atomic<bool> ok(true);
+  absl::BlockingCounter pending(riegeli::IntCast<int>(args.size() - 1));
+  riegeli::internal::ThreadPool thread_pool(
+      riegeli::IntCast<size_t>(parallelism));
+  for (size_t i = 1; i < args.size(); ++i) {
+    thread_pool.Schedule([&, input = std::string(args[i])] {
+      const std::string output =
+          riegeli::tools::OutputFilename(input, output_dir, output_suffix);
+      uint64_t num_records;
+      const absl::Status status = riegeli::tools::ConvertFile(
+          input, output, record_writer_options, num_records);
+      {
+        absl::MutexLock lock(&mutex);
+        if (status.ok()) {
+          absl::Format(&riegeli::StdOut(), "%s: %u records\n", output,
+                       num_records);
+          riegeli::StdOut().Flush();
+        } else {
+          absl::Format(&riegeli::StdErr(), "Could not convert %s: %s\n", input,
+                       status.message());
+          riegeli::StdErr().Flush();
+          ok.store(false, std::memory_order_relaxed);
+        }
+      }
+      pending.DecrementCount();
+    });
+  }
+  pending.Wait();
+  return ok.load(std::memory_order_relaxed) ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "riegeli/records/transcode_records.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+absl::Status TranscodeRecords(RecordReaderBase& src, RecordWriterBase& dest,
+                              const TranscodeRecordsOptions& options) {
+  TranscodeCheckpoint checkpoint;
+  uint64_t size_since_checkpoint = 0;
+  Chain record;
+  while (src.ReadRecord(record)) {
+    const size_t record_size = record.size();
+    // `Chain&&` lets the record share memory with the decoded chunk.
+    if (ABSL_PREDICT_FALSE(!dest.WriteRecord(std::move(record)))) {
+      return dest.status();
+    }
+    ++checkpoint.num_records;
+    size_since_checkpoint += record_size;
+    if (options.checkpoint() != nullptr &&
+        size_since_checkpoint >= options.checkpoint_interval()) {
+      if (ABSL_PREDICT_FALSE(!dest.Flush(options.checkpoint_flush_type()))) {
+        return dest.status();
+      }
+      checkpoint.src_pos = src.pos();
+      checkpoint.dest_size = dest.Pos().get().chunk_begin();
+      options.checkpoint()(checkpoint);
+      size_since_checkpoint = 0;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
@@ -0,0 +1,137 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RIEGELI_RECORDS_TRANSCODE_RECORDS_H_
+#define RIEGELI_RECORDS_TRANSCODE_RECORDS_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// A point from which `TranscodeRecords()` can be resumed after an interruption.
+struct TranscodeCheckpoint {
+  // The position in the source of the next record to transcode.
+  RecordPosition src_pos;
+  // The size of the destination file up to which records before `src_pos`
+  // have been written and flushed.
+  Position dest_size = 0;
+  // The number of records transcoded so far by this `TranscodeRecords()`.
+  uint64_t num_records = 0;
+};
+
+class TranscodeRecordsOptions {
+ public:
+  TranscodeRecordsOptions() noexcept {}
+
+  // If not `nullptr`, a checkpoint is reported after records of total size
+  // at least `checkpoint_interval()` have been transcoded since the previous
+  // checkpoint.
+  //
+  // Before reporting a checkpoint, the destination is flushed with
+  // `checkpoint_flush_type()`. This closes the current chunk early, so
+  // checkpoints should be rare compared to `RecordWriterBase::chunk_size()`.
+  //
+  // Default: `nullptr`.
+  TranscodeRecordsOptions& set_checkpoint(
+      std::function<void(const TranscodeCheckpoint&)> checkpoint) & {
+    checkpoint_ = std::move(checkpoint);
+    return *this;
+  }
+  TranscodeRecordsOptions&& set_checkpoint(
+      std::function<void(const TranscodeCheckpoint&)> checkpoint) && {
+    return std::move(set_checkpoint(std::move(checkpoint)));
+  }
+  const std::function<void(const TranscodeCheckpoint&)>& checkpoint() const {
+    return checkpoint_;
+  }
+
+  // The total size of records between checkpoints.
+  //
+  // Default: `uint64_t{1} << 30` (1G).
+  TranscodeRecordsOptions& set_checkpoint_interval(
+      uint64_t checkpoint_interval) & {
+    RIEGELI_ASSERT_GT(checkpoint_interval, 0u)
+        << "Failed precondition of "
+           "TranscodeRecordsOptions::set_checkpoint_interval(): "
+           "zero interval";
+    checkpoint_interval_ = checkpoint_interval;
+    return *this;
+  }
+  TranscodeRecordsOptions&& set_checkpoint_interval(
+      uint64_t checkpoint_interval) && {
+    return std::move(set_checkpoint_interval(checkpoint_interval));
+  }
+  uint64_t checkpoint_interval() const { return checkpoint_interval_; }
+
+  // How durable the destination is when a checkpoint is reported.
+  //
+  // Default: `FlushType::kFromMachine`.
+  TranscodeRecordsOptions& set_checkpoint_flush_type(
+      FlushType checkpoint_flush_type) & {
+    checkpoint_flush_type_ = checkpoint_flush_type;
+    return *this;
+  }
+  TranscodeRecordsOptions&& set_checkpoint_flush_type(
+      FlushType checkpoint_flush_type) && {
+    return std::move(set_checkpoint_flush_type(checkpoint_flush_type));
+  }
+  FlushType checkpoint_flush_type() const { return checkpoint_flush_type_; }
+
+ private:
+  std::function<void(const TranscodeCheckpoint&)> checkpoint_;
+  uint64_t checkpoint_interval_ = uint64_t{1} << 30;
+  FlushType checkpoint_flush_type_ = FlushType::kFromMachine;
+};
+
+// Reads records from `src` from its current position until its end, and writes
+// them to `dest`, which re-encodes them with its own options.
+//
+// Chunk boundaries of the destination are determined by
+// `RecordWriterBase::Options::chunk_size()` of `dest` independently from chunk
+// boundaries of the source, so this rebalances chunk sizes too.
+//
+// Records are decoded in parallel if
+// `RecordReaderBase::Options::parallelism() > 0` of `src`, and encoded in
+// parallel if `RecordWriterBase::Options::parallelism() > 0` of `dest`. File
+// metadata are not copied: if they should be, set
+// `RecordWriterBase::Options::set_metadata()` of `dest` from
+// `RecordReaderBase::ReadMetadata()` of `src`.
+//
+// To resume after an interruption from a `TranscodeCheckpoint` reported by
+// `TranscodeRecordsOptions::checkpoint()`, truncate the destination file to
+// `dest_size`, open `dest` appending to it, seek `src` to `src_pos`, and call
+// `TranscodeRecords()` again.
+//
+// `src` and `dest` are not closed.
+//
+// Return values:
+//  * `absl::OkStatus()` - success
+//  * other status       - failure of `src` or `dest`
+absl::Status TranscodeRecords(
+    RecordReaderBase& src, RecordWriterBase& dest,
+    const TranscodeRecordsOptions& options = TranscodeRecordsOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_TRANSCODE_RECORDS_H_
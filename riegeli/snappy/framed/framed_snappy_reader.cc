@@ -17,9 +17,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+#include <future>
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
@@ -28,6 +31,7 @@
 #include "crc32c/crc32c.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
@@ -62,11 +66,20 @@ void FramedSnappyReaderBase::Done() {
   }
   PullableReader::Done();
   uncompressed_ = Buffer();
+  // Pending batches are abandoned. Their tasks still run to completion, but
+  // they do not refer to `*this`.
+  batches_.clear();
+  batch_status_ = absl::OkStatus();
+}
+
+absl::Status FramedSnappyReaderBase::InvalidStreamError(
+    absl::string_view message) {
+  return absl::InvalidArgumentError(
+      absl::StrCat("Invalid FramedSnappy-compressed stream: ", message));
 }
 
 bool FramedSnappyReaderBase::FailInvalidStream(absl::string_view message) {
-  return Fail(absl::InvalidArgumentError(
-      absl::StrCat("Invalid FramedSnappy-compressed stream: ", message)));
+  return Fail(InvalidStreamError(message));
 }
 
 absl::Status FramedSnappyReaderBase::AnnotateStatusImpl(absl::Status status) {
@@ -97,6 +110,11 @@ bool FramedSnappyReaderBase::PullBehindScratch() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Reader& src = *src_reader();
   truncated_ = false;
+  if (parallelism_ > 1) return PullFromBatches(src);
+  return PullSerially(src);
+}
+
+inline bool FramedSnappyReaderBase::PullSerially(Reader& src) {
   while (src.Pull(sizeof(uint32_t))) {
     const uint32_t chunk_header = ReadLittleEndian32(src.cursor());
     const uint8_t chunk_type = static_cast<uint8_t>(chunk_header);
@@ -140,12 +158,12 @@ bool FramedSnappyReaderBase::PullBehindScratch() {
           set_buffer();
           return FailInvalidStream("invalid compressed data");
         }
-        if (ABSL_PREDICT_FALSE(
+        if (verify_checksum_ &&
+            ABSL_PREDICT_FALSE(
                 MaskChecksum(crc32c::Crc32c(
                     uncompressed_.data(), uncompressed_length)) != checksum)) {
           set_buffer();
-          return FailInvalidStream(
-              "Invalid FramedSnappy-compressed stream: wrong checksum");
+          return FailInvalidStream("wrong checksum");
         }
         src.move_cursor(sizeof(uint32_t) + chunk_length);
         if (ABSL_PREDICT_FALSE(uncompressed_length == 0)) continue;
@@ -173,7 +191,8 @@ bool FramedSnappyReaderBase::PullBehindScratch() {
           set_buffer();
           return FailInvalidStream("uncompressed length too large");
         }
-        if (ABSL_PREDICT_FALSE(MaskChecksum(crc32c::Crc32c(
+        if (verify_checksum_ &&
+            ABSL_PREDICT_FALSE(MaskChecksum(crc32c::Crc32c(
                                    uncompressed_data, uncompressed_length)) !=
                                checksum)) {
           set_buffer();
@@ -218,6 +237,133 @@ bool FramedSnappyReaderBase::PullBehindScratch() {
   return false;
 }
 
+bool FramedSnappyReaderBase::PullFromBatches(Reader& src) {
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!batch_status_.ok())) {
+      set_buffer();
+      return Fail(std::exchange(batch_status_, absl::OkStatus()));
+    }
+    ScheduleBatches(src);
+    if (batches_.empty()) {
+      // No complete frame is available. Let `PullSerially()` handle the end of
+      // the source or an invalid frame, or decode a frame which appeared if the
+      // source is growing.
+      return PullSerially(src);
+    }
+    DecodedBatch batch = batches_.front().get();
+    batches_.pop_front();
+    batch_status_ = std::move(batch.status);
+    if (batch.size == 0) continue;
+    if (ABSL_PREDICT_FALSE(batch.size > std::numeric_limits<Position>::max() -
+                                            limit_pos())) {
+      set_buffer();
+      batch_status_ = absl::OkStatus();
+      return FailOverflow();
+    }
+    // Keep the pipeline full while the current batch is being read.
+    ScheduleBatches(src);
+    uncompressed_ = std::move(batch.data);
+    set_buffer(uncompressed_.data(), batch.size);
+    move_limit_pos(available());
+    return true;
+  }
+}
+
+void FramedSnappyReaderBase::ScheduleBatches(Reader& src) {
+  while (batches_.size() < parallelism_) {
+    BatchSource batch;
+    if (!ReadBatch(src, batch)) return;
+    std::promise<DecodedBatch>* const batch_promise =
+        new std::promise<DecodedBatch>();
+    batches_.push_back(batch_promise->get_future());
+    Executor& executor = executor_ == nullptr ? internal::ThreadPool::global()
+                                              : *executor_;
+    executor.Schedule([batch_promise, batch = std::move(batch),
+                       verify_checksum = verify_checksum_] {
+      batch_promise->set_value(DecodeBatch(batch, verify_checksum));
+      delete batch_promise;
+    });
+  }
+}
+
+bool FramedSnappyReaderBase::ReadBatch(Reader& src, BatchSource& batch) {
+  // Enough frames to amortize scheduling a task. Frames of at most
+  // `snappy::kBlockSize` (64K) make batches of at most 1M.
+  constexpr size_t kMaxFramesPerBatch = 16;
+  // This validates frames like `PullSerially()` does, except for decoding and
+  // checksums. Frames which would fail validation, and a truncated frame, are
+  // left in `src` for `PullSerially()`.
+  while (batch.frames.size() < kMaxFramesPerBatch &&
+         src.Pull(sizeof(uint32_t))) {
+    const uint32_t chunk_header = ReadLittleEndian32(src.cursor());
+    const uint8_t chunk_type = static_cast<uint8_t>(chunk_header);
+    const size_t chunk_length = IntCast<size_t>(chunk_header >> 8);
+    if (!src.Pull(sizeof(uint32_t) + chunk_length)) break;
+    if (src.pos() == 0 && chunk_type != 0xff /* Stream identifier */) break;
+    if (chunk_type == 0x00 || chunk_type == 0x01) {
+      // Compressed or uncompressed data.
+      if (chunk_length < sizeof(uint32_t)) break;
+      Frame frame;
+      frame.compressed = chunk_type == 0x00;
+      frame.checksum = ReadLittleEndian32(src.cursor() + sizeof(uint32_t));
+      const char* const data = src.cursor() + 2 * sizeof(uint32_t);
+      frame.data_length = chunk_length - sizeof(uint32_t);
+      if (frame.compressed) {
+        if (!snappy::GetUncompressedLength(data, frame.data_length,
+                                           &frame.uncompressed_length)) {
+          break;
+        }
+      } else {
+        frame.uncompressed_length = frame.data_length;
+      }
+      if (frame.uncompressed_length > snappy::kBlockSize) break;
+      frame.data_begin = batch.data.size();
+      batch.data.append(data, frame.data_length);
+      batch.uncompressed_size += frame.uncompressed_length;
+      batch.frames.push_back(frame);
+    } else if (chunk_type == 0xff) {
+      // Stream identifier.
+      if (absl::string_view(src.cursor() + sizeof(uint32_t), chunk_length) !=
+          absl::string_view("sNaPpY", 6)) {
+        break;
+      }
+    } else if (chunk_type < 0x80) {
+      // Reserved unskippable chunk.
+      break;
+    }
+    src.move_cursor(sizeof(uint32_t) + chunk_length);
+  }
+  return !batch.frames.empty();
+}
+
+FramedSnappyReaderBase::DecodedBatch FramedSnappyReaderBase::DecodeBatch(
+    const BatchSource& batch, bool verify_checksum) {
+  DecodedBatch decoded;
+  decoded.data.Reset(batch.uncompressed_size);
+  for (const Frame& frame : batch.frames) {
+    const char* const data = batch.data.data() + frame.data_begin;
+    char* const uncompressed_data = decoded.data.data() + decoded.size;
+    if (frame.compressed) {
+      if (ABSL_PREDICT_FALSE(!snappy::RawUncompress(data, frame.data_length,
+                                                    uncompressed_data))) {
+        decoded.status = InvalidStreamError("invalid compressed data");
+        return decoded;
+      }
+    } else {
+      std::memcpy(uncompressed_data, data, frame.data_length);
+    }
+    if (verify_checksum &&
+        ABSL_PREDICT_FALSE(MaskChecksum(crc32c::Crc32c(
+                               uncompressed_data, frame.uncompressed_length)) !=
+                           frame.checksum)) {
+      decoded.status = InvalidStreamError("wrong checksum");
+      return decoded;
+    }
+    decoded.size += frame.uncompressed_length;
+  }
+  return decoded;
+}
+
 bool FramedSnappyReaderBase::SupportsRewind() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRewind();
@@ -237,6 +383,8 @@ bool FramedSnappyReaderBase::SeekBehindScratch(Position new_pos) {
     truncated_ = false;
     set_buffer();
     set_limit_pos(0);
+    batches_.clear();
+    batch_status_ = absl::OkStatus();
     if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
       return FailWithoutAnnotation(
           AnnotateOverSrc(src.StatusOrAnnotate(absl::DataLossError(
@@ -265,7 +413,11 @@ std::unique_ptr<Reader> FramedSnappyReaderBase::NewReaderImpl(
   }
   std::unique_ptr<Reader> reader =
       std::make_unique<FramedSnappyReader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader));
+          std::move(compressed_reader),
+          FramedSnappyReaderBase::Options()
+              .set_verify_checksum(verify_checksum_)
+              .set_parallelism(parallelism_)
+              .set_executor(executor_));
   reader->Seek(initial_pos);
   return reader;
 }
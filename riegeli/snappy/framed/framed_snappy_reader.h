@@ -16,11 +16,16 @@
 #define RIEGELI_SNAPPY_FRAMED_FRAMED_SNAPPY_READER_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <deque>
+#include <future>
 #include <memory>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -29,6 +34,7 @@
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
 
@@ -37,7 +43,70 @@ namespace riegeli {
 // Template parameter independent part of `FramedSnappyReader`.
 class FramedSnappyReaderBase : public PullableReader {
  public:
-  class Options {};
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `true`, the masked CRC32C of each frame is verified.
+    //
+    // If `false`, checksums are ignored. This is faster, but corrupted data
+    // are not detected unless they also break decompression, so this should
+    // be used only for trusted data.
+    //
+    // Default: `true`.
+    Options& set_verify_checksum(bool verify_checksum) & {
+      verify_checksum_ = verify_checksum;
+      return *this;
+    }
+    Options&& set_verify_checksum(bool verify_checksum) && {
+      return std::move(set_verify_checksum(verify_checksum));
+    }
+    bool verify_checksum() const { return verify_checksum_; }
+
+    // Maximum number of batches of frames being decoded at a time.
+    //
+    // If 1, frames are decoded in the current thread when they are read.
+    //
+    // If greater than 1, consecutive frames are grouped into batches which are
+    // decoded ahead using tasks scheduled on `executor()`, since each frame is
+    // independent. This uses more memory for the compressed and uncompressed
+    // data of pending batches.
+    //
+    // Default: 1.
+    Options& set_parallelism(size_t parallelism) & {
+      RIEGELI_ASSERT_GT(parallelism, 0u)
+          << "Failed precondition of "
+             "FramedSnappyReaderBase::Options::set_parallelism(): "
+             "zero parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(size_t parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    size_t parallelism() const { return parallelism_; }
+
+    // The `Executor` running the decoding of batches if `parallelism() > 1`,
+    // or `nullptr` for the thread pool shared by all parallel operations of
+    // Riegeli.
+    //
+    // The `Executor` must outlive the `FramedSnappyReader`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+   private:
+    bool verify_checksum_ = true;
+    size_t parallelism_ = 1;
+    Executor* executor_ = nullptr;
+  };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
   virtual Reader* src_reader() = 0;
@@ -47,13 +116,15 @@ class FramedSnappyReaderBase : public PullableReader {
   bool SupportsNewReader() override;
 
  protected:
-  using PullableReader::PullableReader;
+  explicit FramedSnappyReaderBase(Closed) noexcept : PullableReader(kClosed) {}
+
+  explicit FramedSnappyReaderBase(const Options& options);
 
   FramedSnappyReaderBase(FramedSnappyReaderBase&& that) noexcept;
   FramedSnappyReaderBase& operator=(FramedSnappyReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset();
+  void Reset(const Options& options);
   void Initialize(Reader* src);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
@@ -65,8 +136,53 @@ class FramedSnappyReaderBase : public PullableReader {
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
+  // A compressed or uncompressed data frame of a batch.
+  struct Frame {
+    bool compressed;
+    uint32_t checksum;
+    // Location of frame data in `BatchSource::data`.
+    size_t data_begin;
+    size_t data_length;
+    size_t uncompressed_length;
+  };
+
+  struct BatchSource {
+    std::string data;
+    std::vector<Frame> frames;
+    size_t uncompressed_size = 0;
+  };
+
+  struct DecodedBatch {
+    // Uncompressed data of frames decoded successfully.
+    Buffer data;
+    size_t size = 0;
+    // Failure to report after `size` bytes of `data` are read.
+    absl::Status status;
+  };
+
+  ABSL_ATTRIBUTE_COLD static absl::Status InvalidStreamError(
+      absl::string_view message);
   ABSL_ATTRIBUTE_COLD bool FailInvalidStream(absl::string_view message);
 
+  // Implementations of `PullBehindScratch()` for `parallelism_ == 1` and
+  // `parallelism_ > 1` respectively.
+  bool PullSerially(Reader& src);
+  bool PullFromBatches(Reader& src);
+
+  // Reads complete frames from `src` and schedules decoding them, until
+  // `parallelism_` batches are pending, or no frame can be taken at the
+  // current position. In the latter case `PullSerially()` handles the end of
+  // the source or an invalid frame.
+  void ScheduleBatches(Reader& src);
+  // Reads complete frames from `src` into `batch`. Returns `false` if no frame
+  // can be taken at the current position.
+  bool ReadBatch(Reader& src, BatchSource& batch);
+  static DecodedBatch DecodeBatch(const BatchSource& batch,
+                                  bool verify_checksum);
+
+  bool verify_checksum_ = true;
+  size_t parallelism_ = 1;
+  Executor* executor_ = nullptr;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
@@ -74,6 +190,11 @@ class FramedSnappyReaderBase : public PullableReader {
   Position initial_compressed_pos_ = 0;
   // Buffered uncompressed data.
   Buffer uncompressed_;
+  // Batches being decoded or waiting to be read, in order, if
+  // `parallelism_ > 1`.
+  std::deque<std::future<DecodedBatch>> batches_;
+  // Failure to report after buffered uncompressed data are read.
+  absl::Status batch_status_;
 
   // Invariant if scratch is not used:
   //   `start() == nullptr` or `start() == uncompressed_.data()` or
@@ -168,44 +289,69 @@ inline FramedSnappyReaderBase::FramedSnappyReaderBase(
     : PullableReader(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
+      verify_checksum_(that.verify_checksum_),
+      parallelism_(that.parallelism_),
+      executor_(that.executor_),
       truncated_(that.truncated_),
       initial_compressed_pos_(that.initial_compressed_pos_),
-      uncompressed_(std::move(that.uncompressed_)) {}
+      uncompressed_(std::move(that.uncompressed_)),
+      batches_(std::move(that.batches_)),
+      batch_status_(std::move(that.batch_status_)) {}
 
 inline FramedSnappyReaderBase& FramedSnappyReaderBase::operator=(
     FramedSnappyReaderBase&& that) noexcept {
   PullableReader::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
+  verify_checksum_ = that.verify_checksum_;
+  parallelism_ = that.parallelism_;
+  executor_ = that.executor_;
   truncated_ = that.truncated_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   uncompressed_ = std::move(that.uncompressed_);
+  batches_ = std::move(that.batches_);
+  batch_status_ = std::move(that.batch_status_);
   return *this;
 }
 
+inline FramedSnappyReaderBase::FramedSnappyReaderBase(const Options& options)
+    : verify_checksum_(options.verify_checksum()),
+      parallelism_(options.parallelism()),
+      executor_(options.executor()) {}
+
 inline void FramedSnappyReaderBase::Reset(Closed) {
   PullableReader::Reset(kClosed);
+  verify_checksum_ = true;
+  parallelism_ = 1;
+  executor_ = nullptr;
   truncated_ = false;
   initial_compressed_pos_ = 0;
   uncompressed_ = Buffer();
+  batches_.clear();
+  batch_status_ = absl::OkStatus();
 }
 
-inline void FramedSnappyReaderBase::Reset() {
+inline void FramedSnappyReaderBase::Reset(const Options& options) {
   PullableReader::Reset();
+  verify_checksum_ = options.verify_checksum();
+  parallelism_ = options.parallelism();
+  executor_ = options.executor();
   truncated_ = false;
   initial_compressed_pos_ = 0;
+  batches_.clear();
+  batch_status_ = absl::OkStatus();
 }
 
 template <typename Src>
 inline FramedSnappyReader<Src>::FramedSnappyReader(const Src& src,
                                                    Options options)
-    : src_(src) {
+    : FramedSnappyReaderBase(options), src_(src) {
   Initialize(src_.get());
 }
 
 template <typename Src>
 inline FramedSnappyReader<Src>::FramedSnappyReader(Src&& src, Options options)
-    : src_(std::move(src)) {
+    : FramedSnappyReaderBase(options), src_(std::move(src)) {
   Initialize(src_.get());
 }
 
@@ -213,7 +359,7 @@ template <typename Src>
 template <typename... SrcArgs>
 inline FramedSnappyReader<Src>::FramedSnappyReader(
     std::tuple<SrcArgs...> src_args, Options options)
-    : src_(std::move(src_args)) {
+    : FramedSnappyReaderBase(options), src_(std::move(src_args)) {
   Initialize(src_.get());
 }
 
@@ -244,14 +390,14 @@ inline void FramedSnappyReader<Src>::Reset(Closed) {
 
 template <typename Src>
 inline void FramedSnappyReader<Src>::Reset(const Src& src, Options options) {
-  FramedSnappyReaderBase::Reset();
+  FramedSnappyReaderBase::Reset(options);
   src_.Reset(src);
   Initialize(src_.get());
 }
 
 template <typename Src>
 inline void FramedSnappyReader<Src>::Reset(Src&& src, Options options) {
-  FramedSnappyReaderBase::Reset();
+  FramedSnappyReaderBase::Reset(options);
   src_.Reset(std::move(src));
   Initialize(src_.get());
 }
@@ -260,7 +406,7 @@ template <typename Src>
 template <typename... SrcArgs>
 inline void FramedSnappyReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                            Options options) {
-  FramedSnappyReaderBase::Reset();
+  FramedSnappyReaderBase::Reset(options);
   src_.Reset(std::move(src_args));
   Initialize(src_.get());
 }
@@ -18,15 +18,20 @@
 #include <stdint.h>
 
 #include <cstring>
+#include <future>
 #include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "crc32c/crc32c.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -43,8 +48,18 @@ inline uint32_t MaskChecksum(uint32_t x) {
   return ((x >> 15) | (x << 17)) + 0xa282ead8;
 }
 
+// Enough frames to amortize scheduling a task if `parallelism() > 1`. Frames
+// of at most `snappy::kBlockSize` (64K) make batches of at most 1M.
+constexpr size_t kMaxFramesPerBatch = 16;
+
 }  // namespace
 
+struct FramedSnappyWriterBase::BatchTask {
+  Buffer uncompressed;
+  std::vector<size_t> frame_lengths;
+  std::promise<EncodedBatch> batch;
+};
+
 void FramedSnappyWriterBase::Initialize(Writer* dest) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of FramedSnappyWriter: null Writer pointer";
@@ -66,6 +81,11 @@ void FramedSnappyWriterBase::Initialize(Writer* dest) {
 void FramedSnappyWriterBase::Done() {
   PushableWriter::Done();
   uncompressed_ = Buffer();
+  batch_frame_lengths_ = std::vector<size_t>();
+  batch_size_ = 0;
+  // Pending batches are abandoned if writing failed. Their tasks still run to
+  // completion, but they do not refer to `*this`.
+  batches_.clear();
   associated_reader_.Reset();
 }
 
@@ -103,6 +123,20 @@ bool FramedSnappyWriterBase::PushBehindScratch() {
   const size_t length =
       UnsignedMin(BufferLength(1, snappy::kBlockSize, size_hint_, start_pos()),
                   std::numeric_limits<Position>::max() - start_pos());
+  if (parallelism_ > 1) {
+    if (uncompressed_.capacity() - batch_size_ < length) {
+      if (!batch_frame_lengths_.empty()) {
+        if (ABSL_PREDICT_FALSE(!ScheduleBatch(dest))) return false;
+      }
+      size_t batch_capacity = kMaxFramesPerBatch * snappy::kBlockSize;
+      if (size_hint_ > start_pos()) {
+        batch_capacity = UnsignedMin(batch_capacity, size_hint_ - start_pos());
+      }
+      uncompressed_.Reset(UnsignedMax(batch_capacity, length));
+    }
+    set_buffer(uncompressed_.data() + batch_size_, length);
+    return true;
+  }
   uncompressed_.Reset(length);
   set_buffer(uncompressed_.data(), length);
   return true;
@@ -113,37 +147,115 @@ inline bool FramedSnappyWriterBase::PushInternal(Writer& dest) {
   RIEGELI_ASSERT_LE(uncompressed_length, snappy::kBlockSize)
       << "Failed invariant of FramedSnappyWriterBase: buffer too large";
   if (uncompressed_length == 0) return true;
+  if (parallelism_ > 1) {
+    // The frame stays in `uncompressed_` until its batch is compressed, so the
+    // next frame is buffered after it.
+    set_buffer();
+    batch_frame_lengths_.push_back(uncompressed_length);
+    batch_size_ += uncompressed_length;
+    move_start_pos(uncompressed_length);
+    if (batch_frame_lengths_.size() == kMaxFramesPerBatch) {
+      return ScheduleBatch(dest);
+    }
+    return true;
+  }
   set_cursor(start());
-  const char* const uncompressed_data = cursor();
-  if (ABSL_PREDICT_FALSE(
-          !dest.Push(2 * sizeof(uint32_t) +
-                     snappy::MaxCompressedLength(uncompressed_length)))) {
+  if (ABSL_PREDICT_FALSE(!dest.Push(MaxFrameLength(uncompressed_length)))) {
     return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
   }
-  char* const compressed_chunk = dest.cursor();
+  dest.move_cursor(EncodeFrame(cursor(), uncompressed_length, dest.cursor()));
+  move_start_pos(uncompressed_length);
+  return true;
+}
+
+inline size_t FramedSnappyWriterBase::MaxFrameLength(size_t length) {
+  return 2 * sizeof(uint32_t) + snappy::MaxCompressedLength(length);
+}
+
+size_t FramedSnappyWriterBase::EncodeFrame(const char* src, size_t length,
+                                           char* dest) {
   size_t compressed_length;
-  snappy::RawCompress(uncompressed_data, uncompressed_length,
-                      compressed_chunk + 2 * sizeof(uint32_t),
+  snappy::RawCompress(src, length, dest + 2 * sizeof(uint32_t),
                       &compressed_length);
-  if (compressed_length < uncompressed_length) {
+  if (compressed_length < length) {
     WriteLittleEndian32(
         IntCast<uint32_t>(0x00 /* Compressed data */ |
                           ((sizeof(uint32_t) + compressed_length) << 8)),
-        compressed_chunk);
+        dest);
   } else {
-    std::memcpy(compressed_chunk + 2 * sizeof(uint32_t), uncompressed_data,
-                uncompressed_length);
-    compressed_length = uncompressed_length;
+    std::memcpy(dest + 2 * sizeof(uint32_t), src, length);
+    compressed_length = length;
     WriteLittleEndian32(
         IntCast<uint32_t>(0x01 /* Uncompressed data */ |
                           ((sizeof(uint32_t) + compressed_length) << 8)),
-        compressed_chunk);
+        dest);
+  }
+  WriteLittleEndian32(MaskChecksum(crc32c::Crc32c(src, length)),
+                      dest + sizeof(uint32_t));
+  return 2 * sizeof(uint32_t) + compressed_length;
+}
+
+FramedSnappyWriterBase::EncodedBatch FramedSnappyWriterBase::EncodeBatch(
+    const Buffer& uncompressed, const std::vector<size_t>& frame_lengths) {
+  size_t max_size = 0;
+  for (const size_t frame_length : frame_lengths) {
+    max_size += MaxFrameLength(frame_length);
+  }
+  EncodedBatch batch;
+  batch.data.Reset(max_size);
+  const char* src = uncompressed.data();
+  char* dest = batch.data.data();
+  for (const size_t frame_length : frame_lengths) {
+    dest += EncodeFrame(src, frame_length, dest);
+    src += frame_length;
+  }
+  batch.size = PtrDistance(batch.data.data(), dest);
+  return batch;
+}
+
+bool FramedSnappyWriterBase::ScheduleBatch(Writer& dest) {
+  RIEGELI_ASSERT(!batch_frame_lengths_.empty())
+      << "Failed precondition of FramedSnappyWriterBase::ScheduleBatch(): "
+         "no frames";
+  if (batches_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteBatch(dest))) return false;
+  }
+  BatchTask* const task = new BatchTask();
+  task->uncompressed = std::move(uncompressed_);
+  task->frame_lengths = std::move(batch_frame_lengths_);
+  batches_.push_back(task->batch.get_future());
+  Executor& executor = executor_ == nullptr ? internal::ThreadPool::global()
+                                            : *executor_;
+  executor.Schedule([task] {
+    task->batch.set_value(EncodeBatch(task->uncompressed, task->frame_lengths));
+    delete task;
+  });
+  uncompressed_ = Buffer();
+  batch_frame_lengths_.clear();
+  batch_size_ = 0;
+  return true;
+}
+
+bool FramedSnappyWriterBase::WriteBatch(Writer& dest) {
+  RIEGELI_ASSERT(!batches_.empty())
+      << "Failed precondition of FramedSnappyWriterBase::WriteBatch(): "
+         "no pending batches";
+  const EncodedBatch batch = batches_.front().get();
+  batches_.pop_front();
+  if (ABSL_PREDICT_FALSE(
+          !dest.Write(absl::string_view(batch.data.data(), batch.size)))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
+  return true;
+}
+
+bool FramedSnappyWriterBase::WriteAllBatches(Writer& dest) {
+  if (!batch_frame_lengths_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBatch(dest))) return false;
+  }
+  while (!batches_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteBatch(dest))) return false;
   }
-  WriteLittleEndian32(
-      MaskChecksum(crc32c::Crc32c(uncompressed_data, uncompressed_length)),
-      compressed_chunk + sizeof(uint32_t));
-  dest.move_cursor(2 * sizeof(uint32_t) + compressed_length);
-  move_start_pos(uncompressed_length);
   return true;
 }
 
@@ -153,7 +265,9 @@ bool FramedSnappyWriterBase::FlushBehindScratch(FlushType flush_type) {
          "scratch used";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Writer& dest = *dest_writer();
-  return PushInternal(dest);
+  if (ABSL_PREDICT_FALSE(!PushInternal(dest))) return false;
+  if (parallelism_ > 1) return WriteAllBatches(dest);
+  return true;
 }
 
 bool FramedSnappyWriterBase::SupportsReadMode() {
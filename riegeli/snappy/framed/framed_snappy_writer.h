@@ -15,9 +15,14 @@
 #ifndef RIEGELI_SNAPPY_FRAMED_FRAMED_SNAPPY_WRITER_H_
 #define RIEGELI_SNAPPY_FRAMED_FRAMED_SNAPPY_WRITER_H_
 
+#include <stddef.h>
+
+#include <deque>
+#include <future>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -27,6 +32,7 @@
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/pushable_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -58,8 +64,50 @@ class FramedSnappyWriterBase : public PushableWriter {
     }
     absl::optional<Position> size_hint() const { return size_hint_; }
 
+    // Maximum number of batches of frames being compressed at a time.
+    //
+    // If 1, frames are compressed in the current thread when they are written.
+    //
+    // If greater than 1, consecutive frames are grouped into batches which are
+    // compressed using tasks scheduled on `executor()`, since each frame is
+    // independent, and written in order. The compressed stream is the same.
+    // This uses more memory for the uncompressed and compressed data of
+    // pending batches.
+    //
+    // Default: 1.
+    Options& set_parallelism(size_t parallelism) & {
+      RIEGELI_ASSERT_GT(parallelism, 0u)
+          << "Failed precondition of "
+             "FramedSnappyWriterBase::Options::set_parallelism(): "
+             "zero parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(size_t parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    size_t parallelism() const { return parallelism_; }
+
+    // The `Executor` running the compression of batches if `parallelism() > 1`,
+    // or `nullptr` for the thread pool shared by all parallel operations of
+    // Riegeli.
+    //
+    // The `Executor` must outlive the `FramedSnappyWriter`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
    private:
     absl::optional<Position> size_hint_;
+    size_t parallelism_ = 1;
+    Executor* executor_ = nullptr;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -71,13 +119,13 @@ class FramedSnappyWriterBase : public PushableWriter {
  protected:
   explicit FramedSnappyWriterBase(Closed) noexcept : PushableWriter(kClosed) {}
 
-  explicit FramedSnappyWriterBase(absl::optional<Position> size_hint);
+  explicit FramedSnappyWriterBase(const Options& options);
 
   FramedSnappyWriterBase(FramedSnappyWriterBase&& that) noexcept;
   FramedSnappyWriterBase& operator=(FramedSnappyWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(absl::optional<Position> size_hint);
+  void Reset(const Options& options);
   void Initialize(Writer* dest);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
@@ -97,15 +145,49 @@ class FramedSnappyWriterBase : public PushableWriter {
   // Postcondition: `start_to_cursor() == 0`
   bool PushInternal(Writer& dest);
 
+  struct EncodedBatch {
+    Buffer data;
+    size_t size = 0;
+  };
+  struct BatchTask;
+
+  // Encodes a data frame of `length` bytes from `src` to `dest`, which must
+  // have room for `MaxFrameLength(length)` bytes. Returns the frame length.
+  static size_t MaxFrameLength(size_t length);
+  static size_t EncodeFrame(const char* src, size_t length, char* dest);
+  static EncodedBatch EncodeBatch(const Buffer& uncompressed,
+                                  const std::vector<size_t>& frame_lengths);
+
+  // Schedules compressing the current batch, after writing the oldest batch
+  // if `parallelism_` batches are pending.
+  //
+  // Precondition: `!batch_frame_lengths_.empty()`
+  bool ScheduleBatch(Writer& dest);
+  // Waits for the oldest pending batch and writes it to `dest`.
+  bool WriteBatch(Writer& dest);
+  // Schedules compressing the current batch if it is not empty, and writes all
+  // pending batches to `dest`.
+  bool WriteAllBatches(Writer& dest);
+
   Position size_hint_ = 0;
+  size_t parallelism_ = 1;
+  Executor* executor_ = nullptr;
   Position initial_compressed_pos_ = 0;
-  // Buffered uncompressed data.
+  // Buffered uncompressed data. If `parallelism_ > 1`, frames of the current
+  // batch are buffered consecutively, followed by the current frame.
   Buffer uncompressed_;
+  // Lengths of frames of the current batch, if `parallelism_ > 1`.
+  std::vector<size_t> batch_frame_lengths_;
+  // Total length of frames of the current batch, if `parallelism_ > 1`.
+  size_t batch_size_ = 0;
+  // Batches being compressed or waiting to be written, in order, if
+  // `parallelism_ > 1`.
+  std::deque<std::future<EncodedBatch>> batches_;
 
   AssociatedReader<FramedSnappyReader<Reader*>> associated_reader_;
 
   // Invariants if scratch is not used:
-  //   `start() == nullptr` or `start() == uncompressed_.data()`
+  //   `start() == nullptr` or `start() == uncompressed_.data() + batch_size_`
   //   `start_to_limit() <= snappy::kBlockSize`
 };
 
@@ -190,9 +272,10 @@ explicit FramedSnappyWriter(
 
 // Implementation details follow.
 
-inline FramedSnappyWriterBase::FramedSnappyWriterBase(
-    absl::optional<Position> size_hint)
-    : size_hint_(size_hint.value_or(0)) {}
+inline FramedSnappyWriterBase::FramedSnappyWriterBase(const Options& options)
+    : size_hint_(options.size_hint().value_or(0)),
+      parallelism_(options.parallelism()),
+      executor_(options.executor()) {}
 
 inline FramedSnappyWriterBase::FramedSnappyWriterBase(
     FramedSnappyWriterBase&& that) noexcept
@@ -200,8 +283,13 @@ inline FramedSnappyWriterBase::FramedSnappyWriterBase(
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       size_hint_(that.size_hint_),
+      parallelism_(that.parallelism_),
+      executor_(that.executor_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       uncompressed_(std::move(that.uncompressed_)),
+      batch_frame_lengths_(std::move(that.batch_frame_lengths_)),
+      batch_size_(std::exchange(that.batch_size_, 0)),
+      batches_(std::move(that.batches_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline FramedSnappyWriterBase& FramedSnappyWriterBase::operator=(
@@ -210,8 +298,13 @@ inline FramedSnappyWriterBase& FramedSnappyWriterBase::operator=(
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   size_hint_ = that.size_hint_;
+  parallelism_ = that.parallelism_;
+  executor_ = that.executor_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   uncompressed_ = std::move(that.uncompressed_);
+  batch_frame_lengths_ = std::move(that.batch_frame_lengths_);
+  batch_size_ = std::exchange(that.batch_size_, 0);
+  batches_ = std::move(that.batches_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
@@ -219,29 +312,39 @@ inline FramedSnappyWriterBase& FramedSnappyWriterBase::operator=(
 inline void FramedSnappyWriterBase::Reset(Closed) {
   PushableWriter::Reset(kClosed);
   size_hint_ = 0;
+  parallelism_ = 1;
+  executor_ = nullptr;
   initial_compressed_pos_ = 0;
   uncompressed_ = Buffer();
+  batch_frame_lengths_ = std::vector<size_t>();
+  batch_size_ = 0;
+  batches_.clear();
   associated_reader_.Reset();
 }
 
-inline void FramedSnappyWriterBase::Reset(absl::optional<Position> size_hint) {
+inline void FramedSnappyWriterBase::Reset(const Options& options) {
   PushableWriter::Reset();
-  size_hint_ = size_hint.value_or(0);
+  size_hint_ = options.size_hint().value_or(0);
+  parallelism_ = options.parallelism();
+  executor_ = options.executor();
   initial_compressed_pos_ = 0;
+  batch_frame_lengths_.clear();
+  batch_size_ = 0;
+  batches_.clear();
   associated_reader_.Reset();
 }
 
 template <typename Dest>
 inline FramedSnappyWriter<Dest>::FramedSnappyWriter(const Dest& dest,
                                                     Options options)
-    : FramedSnappyWriterBase(options.size_hint()), dest_(dest) {
+    : FramedSnappyWriterBase(options), dest_(dest) {
   Initialize(dest_.get());
 }
 
 template <typename Dest>
 inline FramedSnappyWriter<Dest>::FramedSnappyWriter(Dest&& dest,
                                                     Options options)
-    : FramedSnappyWriterBase(options.size_hint()), dest_(std::move(dest)) {
+    : FramedSnappyWriterBase(options), dest_(std::move(dest)) {
   Initialize(dest_.get());
 }
 
@@ -249,7 +352,7 @@ template <typename Dest>
 template <typename... DestArgs>
 inline FramedSnappyWriter<Dest>::FramedSnappyWriter(
     std::tuple<DestArgs...> dest_args, Options options)
-    : FramedSnappyWriterBase(options.size_hint()), dest_(std::move(dest_args)) {
+    : FramedSnappyWriterBase(options), dest_(std::move(dest_args)) {
   Initialize(dest_.get());
 }
 
@@ -279,14 +382,14 @@ inline void FramedSnappyWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void FramedSnappyWriter<Dest>::Reset(const Dest& dest, Options options) {
-  FramedSnappyWriterBase::Reset(options.size_hint());
+  FramedSnappyWriterBase::Reset(options);
   dest_.Reset(dest);
   Initialize(dest_.get());
 }
 
 template <typename Dest>
 inline void FramedSnappyWriter<Dest>::Reset(Dest&& dest, Options options) {
-  FramedSnappyWriterBase::Reset(options.size_hint());
+  FramedSnappyWriterBase::Reset(options);
   dest_.Reset(std::move(dest));
   Initialize(dest_.get());
 }
@@ -295,7 +398,7 @@ template <typename Dest>
 template <typename... DestArgs>
 inline void FramedSnappyWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                             Options options) {
-  FramedSnappyWriterBase::Reset(options.size_hint());
+  FramedSnappyWriterBase::Reset(options);
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get());
 }
@@ -17,14 +17,19 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <future>
 #include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -34,6 +39,20 @@
 
 namespace riegeli {
 
+namespace {
+
+// Enough blocks to amortize scheduling a task if `parallelism() > 1`. Blocks
+// of at most `snappy::kBlockSize` (64K) make batches of at most 1M.
+constexpr size_t kMaxBlocksPerBatch = 16;
+
+}  // namespace
+
+struct HadoopSnappyWriterBase::BatchTask {
+  Buffer uncompressed;
+  std::vector<size_t> block_lengths;
+  std::promise<EncodedBatch> batch;
+};
+
 void HadoopSnappyWriterBase::Initialize(Writer* dest) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of HadoopSnappyWriter: null Writer pointer";
@@ -45,6 +64,11 @@ void HadoopSnappyWriterBase::Initialize(Writer* dest) {
 void HadoopSnappyWriterBase::Done() {
   PushableWriter::Done();
   uncompressed_ = Buffer();
+  batch_block_lengths_ = std::vector<size_t>();
+  batch_size_ = 0;
+  // Pending batches are abandoned if writing failed. Their tasks still run to
+  // completion, but they do not refer to `*this`.
+  batches_.clear();
   associated_reader_.Reset();
 }
 
@@ -82,6 +106,20 @@ bool HadoopSnappyWriterBase::PushBehindScratch() {
   const size_t length =
       UnsignedMin(BufferLength(1, snappy::kBlockSize, size_hint_, start_pos()),
                   std::numeric_limits<Position>::max() - start_pos());
+  if (parallelism_ > 1) {
+    if (uncompressed_.capacity() - batch_size_ < length) {
+      if (!batch_block_lengths_.empty()) {
+        if (ABSL_PREDICT_FALSE(!ScheduleBatch(dest))) return false;
+      }
+      size_t batch_capacity = kMaxBlocksPerBatch * snappy::kBlockSize;
+      if (size_hint_ > start_pos()) {
+        batch_capacity = UnsignedMin(batch_capacity, size_hint_ - start_pos());
+      }
+      uncompressed_.Reset(UnsignedMax(batch_capacity, length));
+    }
+    set_buffer(uncompressed_.data() + batch_size_, length);
+    return true;
+  }
   uncompressed_.Reset(length);
   set_buffer(uncompressed_.data(), length);
   return true;
@@ -92,23 +130,103 @@ inline bool HadoopSnappyWriterBase::PushInternal(Writer& dest) {
   RIEGELI_ASSERT_LE(uncompressed_length, snappy::kBlockSize)
       << "Failed invariant of HadoopSnappyWriterBase: buffer too large";
   if (uncompressed_length == 0) return true;
+  if (parallelism_ > 1) {
+    // The block stays in `uncompressed_` until its batch is compressed, so the
+    // next block is buffered after it.
+    set_buffer();
+    batch_block_lengths_.push_back(uncompressed_length);
+    batch_size_ += uncompressed_length;
+    move_start_pos(uncompressed_length);
+    if (batch_block_lengths_.size() == kMaxBlocksPerBatch) {
+      return ScheduleBatch(dest);
+    }
+    return true;
+  }
   set_cursor(start());
-  const char* const uncompressed_data = cursor();
-  if (ABSL_PREDICT_FALSE(
-          !dest.Push(2 * sizeof(uint32_t) +
-                     snappy::MaxCompressedLength(uncompressed_length)))) {
+  if (ABSL_PREDICT_FALSE(!dest.Push(MaxBlockLength(uncompressed_length)))) {
     return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
   }
-  char* const compressed_chunk = dest.cursor();
-  WriteBigEndian32(IntCast<uint32_t>(uncompressed_length), compressed_chunk);
+  dest.move_cursor(EncodeBlock(cursor(), uncompressed_length, dest.cursor()));
+  move_start_pos(uncompressed_length);
+  return true;
+}
+
+inline size_t HadoopSnappyWriterBase::MaxBlockLength(size_t length) {
+  return 2 * sizeof(uint32_t) + snappy::MaxCompressedLength(length);
+}
+
+size_t HadoopSnappyWriterBase::EncodeBlock(const char* src, size_t length,
+                                           char* dest) {
+  WriteBigEndian32(IntCast<uint32_t>(length), dest);
   size_t compressed_length;
-  snappy::RawCompress(uncompressed_data, uncompressed_length,
-                      compressed_chunk + 2 * sizeof(uint32_t),
+  snappy::RawCompress(src, length, dest + 2 * sizeof(uint32_t),
                       &compressed_length);
   WriteBigEndian32(IntCast<uint32_t>(compressed_length),
-                   compressed_chunk + sizeof(uint32_t));
-  dest.move_cursor(2 * sizeof(uint32_t) + compressed_length);
-  move_start_pos(uncompressed_length);
+                   dest + sizeof(uint32_t));
+  return 2 * sizeof(uint32_t) + compressed_length;
+}
+
+HadoopSnappyWriterBase::EncodedBatch HadoopSnappyWriterBase::EncodeBatch(
+    const Buffer& uncompressed, const std::vector<size_t>& block_lengths) {
+  size_t max_size = 0;
+  for (const size_t block_length : block_lengths) {
+    max_size += MaxBlockLength(block_length);
+  }
+  EncodedBatch batch;
+  batch.data.Reset(max_size);
+  const char* src = uncompressed.data();
+  char* dest = batch.data.data();
+  for (const size_t block_length : block_lengths) {
+    dest += EncodeBlock(src, block_length, dest);
+    src += block_length;
+  }
+  batch.size = PtrDistance(batch.data.data(), dest);
+  return batch;
+}
+
+bool HadoopSnappyWriterBase::ScheduleBatch(Writer& dest) {
+  RIEGELI_ASSERT(!batch_block_lengths_.empty())
+      << "Failed precondition of HadoopSnappyWriterBase::ScheduleBatch(): "
+         "no blocks";
+  if (batches_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteBatch(dest))) return false;
+  }
+  BatchTask* const task = new BatchTask();
+  task->uncompressed = std::move(uncompressed_);
+  task->block_lengths = std::move(batch_block_lengths_);
+  batches_.push_back(task->batch.get_future());
+  Executor& executor = executor_ == nullptr ? internal::ThreadPool::global()
+                                            : *executor_;
+  executor.Schedule([task] {
+    task->batch.set_value(EncodeBatch(task->uncompressed, task->block_lengths));
+    delete task;
+  });
+  uncompressed_ = Buffer();
+  batch_block_lengths_.clear();
+  batch_size_ = 0;
+  return true;
+}
+
+bool HadoopSnappyWriterBase::WriteBatch(Writer& dest) {
+  RIEGELI_ASSERT(!batches_.empty())
+      << "Failed precondition of HadoopSnappyWriterBase::WriteBatch(): "
+         "no pending batches";
+  const EncodedBatch batch = batches_.front().get();
+  batches_.pop_front();
+  if (ABSL_PREDICT_FALSE(
+          !dest.Write(absl::string_view(batch.data.data(), batch.size)))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
+  return true;
+}
+
+bool HadoopSnappyWriterBase::WriteAllBatches(Writer& dest) {
+  if (!batch_block_lengths_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBatch(dest))) return false;
+  }
+  while (!batches_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteBatch(dest))) return false;
+  }
   return true;
 }
 
@@ -118,7 +236,9 @@ bool HadoopSnappyWriterBase::FlushBehindScratch(FlushType flush_type) {
          "scratch used";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Writer& dest = *dest_writer();
-  return PushInternal(dest);
+  if (ABSL_PREDICT_FALSE(!PushInternal(dest))) return false;
+  if (parallelism_ > 1) return WriteAllBatches(dest);
+  return true;
 }
 
 bool HadoopSnappyWriterBase::SupportsReadMode() {
@@ -204,6 +204,14 @@ bool SnappyWriterBase::WriteSlow(absl::Cord&& src) {
   return true;
 }
 
+void SnappyWriterBase::SetWriteSizeHintImpl(
+    absl::optional<Position> write_size_hint) {
+  options_.set_size_hint(
+      write_size_hint == absl::nullopt
+          ? 0
+          : SaturatingIntCast<size_t>(SaturatingAdd(pos(), *write_size_hint)));
+}
+
 Reader* SnappyWriterBase::ReadModeImpl(Position initial_pos) {
   if (ABSL_PREDICT_FALSE(!healthy())) return nullptr;
   SyncBuffer();
@@ -93,6 +93,7 @@ class SnappyWriterBase : public Writer {
   bool WriteSlow(const absl::Cord& src) override;
   bool WriteSlow(absl::Cord&& src) override;
   bool WriteZerosSlow(Position length) override;
+  void SetWriteSizeHintImpl(absl::optional<Position> write_size_hint) override;
   Reader* ReadModeImpl(Position initial_pos) override;
 
  private:
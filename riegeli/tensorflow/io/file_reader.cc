@@ -23,15 +23,18 @@
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/reader.h"
@@ -45,6 +48,22 @@
 namespace riegeli {
 namespace tensorflow {
 
+struct FileReaderBase::ParallelBlock {
+  explicit ParallelBlock(Position pos, size_t length)
+      : pos(pos), length(length) {}
+
+  // The range being read, fixed at construction.
+  const Position pos;
+  const size_t length;
+
+  absl::Mutex mutex;
+  // Set by the task after filling `data` and `status`, which are then
+  // immutable.
+  bool done ABSL_GUARDED_BY(mutex) = false;
+  ChainBlock data;
+  ::tensorflow::Status status;
+};
+
 bool FileReaderBase::InitializeFilename(::tensorflow::RandomAccessFile* src) {
   absl::string_view filename;
   {
@@ -117,6 +136,10 @@ absl::Status FileReaderBase::AnnotateStatusImpl(absl::Status status) {
 void FileReaderBase::Done() {
   Reader::Done();
   buffer_ = ChainBlock();
+  // Pending tasks keep their blocks and `parallel_file_` alive until they
+  // finish.
+  parallel_blocks_.clear();
+  parallel_file_.reset();
 }
 
 inline void FileReaderBase::SyncBuffer() {
@@ -136,6 +159,15 @@ bool FileReaderBase::PullSlow(size_t min_length, size_t recommended_length) {
       << "Failed precondition of Reader::PullSlow(): "
          "enough data available, use Pull() instead";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ParallelReading()) {
+    if (ABSL_PREDICT_FALSE(!PullParallel(min_length))) {
+      return available() >= min_length;
+    }
+    if (available() >= min_length) return true;
+    // The file size observed when parallel reading started was reached.
+    // Continue sequentially, which detects the end of file or reads data
+    // appended since then.
+  }
   ::tensorflow::RandomAccessFile* const src = src_file();
   const size_t buffer_length = UnsignedMax(buffer_size_, min_length);
   const size_t available_length = available();
@@ -176,6 +208,111 @@ bool FileReaderBase::PullSlow(size_t min_length, size_t recommended_length) {
   return true;
 }
 
+bool FileReaderBase::PullParallel(size_t min_length) {
+  if (parallel_file_ == nullptr) {
+    std::unique_ptr<::tensorflow::RandomAccessFile> file;
+    {
+      const ::tensorflow::Status status =
+          file_system_->NewRandomAccessFile(filename_, &file);
+      if (ABSL_PREDICT_FALSE(!status.ok())) {
+        return FailOperation(status, "FileSystem::NewRandomAccessFile()");
+      }
+    }
+    ::tensorflow::uint64 file_size;
+    {
+      const ::tensorflow::Status status =
+          file_system_->GetFileSize(filename_, &file_size);
+      if (ABSL_PREDICT_FALSE(!status.ok())) {
+        return FailOperation(status, "FileSystem::GetFileSize()");
+      }
+    }
+    parallel_file_ = std::move(file);
+    parallel_file_size_ = Position{file_size};
+    parallel_blocks_pos_ = limit_pos();
+  }
+  while (available() < min_length && limit_pos() < parallel_file_size_) {
+    if (parallel_blocks_pos_ != limit_pos()) {
+      // Blocks were read ahead of a different position, which means that the
+      // position was changed by seeking. Abandon them.
+      parallel_blocks_.clear();
+      parallel_blocks_pos_ = limit_pos();
+    }
+    ScheduleParallelBlocks();
+    const std::shared_ptr<ParallelBlock> block =
+        std::move(parallel_blocks_.front());
+    parallel_blocks_.pop_front();
+    parallel_blocks_pos_ += block->length;
+    block->mutex.LockWhen(absl::Condition(&block->done));
+    block->mutex.Unlock();
+    const size_t length_read = block->data.size();
+    if (length_read > 0) {
+      if (available() == 0) {
+        buffer_ = std::move(block->data);
+      } else {
+        // Copy available data and newly read data to a new buffer so that
+        // they are adjacent.
+        ChainBlock merged;
+        const size_t merged_length = available() + length_read;
+        const absl::Span<char> flat_buffer =
+            merged.AppendBuffer(merged_length, merged_length, merged_length);
+        std::memcpy(flat_buffer.data(), cursor(), available());
+        std::memcpy(flat_buffer.data() + available(), block->data.data(),
+                    length_read);
+        buffer_ = std::move(merged);
+      }
+      set_buffer(buffer_.data(), buffer_.size());
+      move_limit_pos(length_read);
+    }
+    if (ABSL_PREDICT_FALSE(!block->status.ok() &&
+                           !::tensorflow::errors::IsOutOfRange(
+                               block->status))) {
+      return FailOperation(block->status, "RandomAccessFile::Read()");
+    }
+    if (ABSL_PREDICT_FALSE(length_read < block->length)) {
+      // The file is shorter than it was. Let sequential reading handle this.
+      parallel_blocks_.clear();
+      parallel_file_size_ = limit_pos();
+      parallel_blocks_pos_ = limit_pos();
+    }
+  }
+  return true;
+}
+
+void FileReaderBase::ScheduleParallelBlocks() {
+  Position pos = parallel_blocks_.empty()
+                     ? parallel_blocks_pos_
+                     : parallel_blocks_.back()->pos +
+                           parallel_blocks_.back()->length;
+  while (parallel_blocks_.size() < parallelism_ && pos < parallel_file_size_) {
+    const size_t length =
+        UnsignedMin(parallel_block_size_, parallel_file_size_ - pos);
+    std::shared_ptr<ParallelBlock> block =
+        std::make_shared<ParallelBlock>(pos, length);
+    // Reading blocks on I/O, hence it does not run on a thread counted against
+    // the parallelism of CPU-bound tasks.
+    internal::ThreadPool::global().ScheduleBlocking([file = parallel_file_,
+                                                     block] {
+      const absl::Span<char> flat_buffer =
+          block->data.AppendBuffer(block->length, block->length, block->length);
+      absl::string_view result;
+      ::tensorflow::Status status =
+          file->Read(IntCast<::tensorflow::uint64>(block->pos),
+                     flat_buffer.size(), &result, flat_buffer.data());
+      RIEGELI_ASSERT_LE(result.size(), flat_buffer.size())
+          << "RandomAccessFile::Read() read more than requested";
+      if (result.data() != flat_buffer.data()) {
+        std::memmove(flat_buffer.data(), result.data(), result.size());
+      }
+      block->data.RemoveSuffix(flat_buffer.size() - result.size());
+      block->status = std::move(status);
+      absl::MutexLock lock(&block->mutex);
+      block->done = true;
+    });
+    parallel_blocks_.push_back(std::move(block));
+    pos += length;
+  }
+}
+
 inline bool FileReaderBase::ReadToDest(size_t length,
                                        ::tensorflow::RandomAccessFile* src,
                                        char* dest, size_t& length_read) {
@@ -250,7 +387,7 @@ bool FileReaderBase::ReadSlow(size_t length, char* dest) {
   RIEGELI_ASSERT_LT(available(), length)
       << "Failed precondition of Reader::ReadSlow(char*): "
          "enough data available, use Read(char*) instead";
-  if (length >= LengthToReadDirectly()) {
+  if (!ParallelReading() && length >= LengthToReadDirectly()) {
     ::tensorflow::RandomAccessFile* const src = src_file();
     const size_t available_length = available();
     if (
@@ -277,6 +414,7 @@ bool FileReaderBase::ReadSlow(size_t length, Chain& dest) {
   RIEGELI_ASSERT_LE(length, std::numeric_limits<size_t>::max() - dest.size())
       << "Failed precondition of Reader::ReadSlow(Chain&): "
          "Chain size overflow";
+  if (ParallelReading()) return Reader::ReadSlow(length, dest);
   ::tensorflow::RandomAccessFile* const src = src_file();
   bool enough_read = true;
   bool ok = true;
@@ -333,6 +471,7 @@ bool FileReaderBase::ReadSlow(size_t length, absl::Cord& dest) {
   RIEGELI_ASSERT_LE(length, std::numeric_limits<size_t>::max() - dest.size())
       << "Failed precondition of Reader::ReadSlow(Cord&): "
          "Cord size overflow";
+  if (ParallelReading()) return Reader::ReadSlow(length, dest);
   ::tensorflow::RandomAccessFile* const src = src_file();
   bool enough_read = true;
   bool ok = true;
@@ -386,6 +525,7 @@ bool FileReaderBase::CopySlow(Position length, Writer& dest) {
   RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), length)
       << "Failed precondition of Reader::CopySlow(Writer&): "
          "enough data available, use Copy(Writer&) instead";
+  if (ParallelReading()) return Reader::CopySlow(length, dest);
   ::tensorflow::RandomAccessFile* const src = src_file();
   bool enough_read = true;
   bool read_ok = true;
@@ -543,7 +683,9 @@ std::unique_ptr<Reader> FileReaderBase::NewReaderImpl(Position initial_pos) {
       src, FileReaderBase::Options()
                .set_env(env_)
                .set_initial_pos(initial_pos)
-               .set_buffer_size(buffer_size_));
+               .set_buffer_size(buffer_size_)
+               .set_parallelism(parallelism_)
+               .set_parallel_block_size(parallel_block_size_));
 }
 
 }  // namespace tensorflow
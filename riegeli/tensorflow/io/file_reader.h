@@ -17,6 +17,7 @@
 
 #include <stddef.h>
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -93,10 +94,52 @@ class FileReaderBase : public Reader {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // If positive, reading keeps up to `parallelism` `RandomAccessFile::Read()`
+    // calls in flight on adjacent blocks ahead of the current position, each
+    // running in a background thread.
+    //
+    // This hides the latency of a single request, which dominates sequential
+    // reading from object storage like GCS or S3. Memory usage is about
+    // `parallelism * parallel_block_size()`.
+    //
+    // Parallel reading requires the file to have a name, like random access.
+    // Otherwise, or if `parallelism == 0`, reading is sequential.
+    //
+    // Default: 0.
+    Options& set_parallelism(size_t parallelism) & {
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(size_t parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    size_t parallelism() const { return parallelism_; }
+
+    // The length of a block read by one `RandomAccessFile::Read()` call during
+    // parallel reading.
+    //
+    // Default: `kDefaultParallelBlockSize` (4M).
+    Options& set_parallel_block_size(size_t parallel_block_size) & {
+      RIEGELI_ASSERT_GT(parallel_block_size, 0u)
+          << "Failed precondition of "
+             "FileReaderBase::Options::set_parallel_block_size(): "
+             "zero block size";
+      parallel_block_size_ = parallel_block_size;
+      return *this;
+    }
+    Options&& set_parallel_block_size(size_t parallel_block_size) && {
+      return std::move(set_parallel_block_size(parallel_block_size));
+    }
+    size_t parallel_block_size() const { return parallel_block_size_; }
+
    private:
+    static constexpr size_t kDefaultParallelBlockSize = size_t{4} << 20;
+
     ::tensorflow::Env* env_ = nullptr;
     Position initial_pos_ = 0;
     size_t buffer_size_ = kDefaultBufferSize;
+    size_t parallelism_ = 0;
+    size_t parallel_block_size_ = kDefaultParallelBlockSize;
   };
 
   // Returns the `::tensorflow::RandomAccessFile` being read from. If the
@@ -114,13 +157,15 @@ class FileReaderBase : public Reader {
  protected:
   explicit FileReaderBase(Closed) noexcept : Reader(kClosed) {}
 
-  explicit FileReaderBase(::tensorflow::Env* env, size_t buffer_size);
+  explicit FileReaderBase(::tensorflow::Env* env, size_t buffer_size,
+                          size_t parallelism, size_t parallel_block_size);
 
   FileReaderBase(FileReaderBase&& that) noexcept;
   FileReaderBase& operator=(FileReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(::tensorflow::Env* env, size_t buffer_size);
+  void Reset(::tensorflow::Env* env, size_t buffer_size, size_t parallelism,
+             size_t parallel_block_size);
   void Initialize(::tensorflow::RandomAccessFile* src, Position initial_pos);
   bool InitializeFilename(::tensorflow::RandomAccessFile* src);
   bool InitializeFilename(absl::string_view filename, ::tensorflow::Env* env);
@@ -144,9 +189,26 @@ class FileReaderBase : public Reader {
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
+  // A block being read by a task during parallel reading.
+  struct ParallelBlock;
+
   // Discards buffer contents.
   void SyncBuffer();
 
+  // Returns `true` if reading uses `parallel_blocks_`.
+  bool ParallelReading() const {
+    return parallelism_ > 0 && !filename_.empty();
+  }
+
+  // Reads blocks from `parallel_blocks_` until `available() >= min_length` or
+  // the file size observed when parallel reading started is reached.
+  //
+  // Returns `false` on failure or if the file was shorter than expected.
+  bool PullParallel(size_t min_length);
+
+  // Schedules reading more blocks until `parallelism_` blocks are in flight.
+  void ScheduleParallelBlocks();
+
   // Minimum length for which it is better to append current contents of
   // `buffer_` and read the remaining data directly than to read the data
   // through `buffer_`.
@@ -188,6 +250,19 @@ class FileReaderBase : public Reader {
   // data are in memory managed by the `::tensorflow::RandomAccessFile`. In any
   // case `start()` points to them.
   ChainBlock buffer_;
+  size_t parallelism_ = 0;
+  size_t parallel_block_size_ = 0;
+  // An independent handle of the file, shared with tasks reading blocks, so
+  // that tasks abandoned by seeking or closing do not need to be waited for.
+  // Opened when parallel reading starts.
+  std::shared_ptr<::tensorflow::RandomAccessFile> parallel_file_;
+  // The file size when `parallel_file_` was opened. Blocks are scheduled only
+  // below this position, further data are read sequentially.
+  Position parallel_file_size_ = 0;
+  // Blocks in flight, adjacent, the first one beginning at
+  // `parallel_blocks_pos_`.
+  std::deque<std::shared_ptr<ParallelBlock>> parallel_blocks_;
+  Position parallel_blocks_pos_ = 0;
 
   // Invariants if `!buffer_.empty()`:
   //   `start() == buffer_.data()`
@@ -290,9 +365,12 @@ explicit FileReader(absl::string_view filename,
 // Implementation details follow.
 
 inline FileReaderBase::FileReaderBase(::tensorflow::Env* env,
-                                      size_t buffer_size)
+                                      size_t buffer_size, size_t parallelism,
+                                      size_t parallel_block_size)
     : env_(env != nullptr ? env : ::tensorflow::Env::Default()),
-      buffer_size_(buffer_size) {}
+      buffer_size_(buffer_size),
+      parallelism_(parallelism),
+      parallel_block_size_(parallel_block_size) {}
 
 inline FileReaderBase::FileReaderBase(FileReaderBase&& that) noexcept
     : Reader(std::move(that)),
@@ -302,7 +380,13 @@ inline FileReaderBase::FileReaderBase(FileReaderBase&& that) noexcept
       env_(that.env_),
       file_system_(that.file_system_),
       buffer_size_(that.buffer_size_),
-      buffer_(std::move(that.buffer_)) {}
+      buffer_(std::move(that.buffer_)),
+      parallelism_(that.parallelism_),
+      parallel_block_size_(that.parallel_block_size_),
+      parallel_file_(std::move(that.parallel_file_)),
+      parallel_file_size_(that.parallel_file_size_),
+      parallel_blocks_(std::move(that.parallel_blocks_)),
+      parallel_blocks_pos_(that.parallel_blocks_pos_) {}
 
 inline FileReaderBase& FileReaderBase::operator=(
     FileReaderBase&& that) noexcept {
@@ -314,6 +398,12 @@ inline FileReaderBase& FileReaderBase::operator=(
   file_system_ = that.file_system_;
   buffer_size_ = that.buffer_size_;
   buffer_ = std::move(that.buffer_);
+  parallelism_ = that.parallelism_;
+  parallel_block_size_ = that.parallel_block_size_;
+  parallel_file_ = std::move(that.parallel_file_);
+  parallel_file_size_ = that.parallel_file_size_;
+  parallel_blocks_ = std::move(that.parallel_blocks_);
+  parallel_blocks_pos_ = that.parallel_blocks_pos_;
   return *this;
 }
 
@@ -324,15 +414,29 @@ inline void FileReaderBase::Reset(Closed) {
   file_system_ = nullptr;
   buffer_size_ = 0;
   buffer_ = ChainBlock();
+  parallelism_ = 0;
+  parallel_block_size_ = 0;
+  parallel_file_.reset();
+  parallel_file_size_ = 0;
+  parallel_blocks_.clear();
+  parallel_blocks_pos_ = 0;
 }
 
-inline void FileReaderBase::Reset(::tensorflow::Env* env, size_t buffer_size) {
+inline void FileReaderBase::Reset(::tensorflow::Env* env, size_t buffer_size,
+                                  size_t parallelism,
+                                  size_t parallel_block_size) {
   Reader::Reset();
   env_ = env != nullptr ? env : ::tensorflow::Env::Default();
   // `filename_` and `file_system_` will be or were set by
   // `InitializeFilename()`.
   buffer_size_ = buffer_size;
   buffer_.Clear();
+  parallelism_ = parallelism;
+  parallel_block_size_ = parallel_block_size;
+  parallel_file_.reset();
+  parallel_file_size_ = 0;
+  parallel_blocks_.clear();
+  parallel_blocks_pos_ = 0;
 }
 
 inline void FileReaderBase::Initialize(::tensorflow::RandomAccessFile* src,
@@ -345,13 +449,16 @@ inline void FileReaderBase::Initialize(::tensorflow::RandomAccessFile* src,
 
 template <typename Src>
 inline FileReader<Src>::FileReader(const Src& src, Options options)
-    : FileReaderBase(options.env(), options.buffer_size()), src_(src) {
+    : FileReaderBase(options.env(), options.buffer_size(),
+                     options.parallelism(), options.parallel_block_size()),
+      src_(src) {
   Initialize(src_.get(), options.initial_pos());
 }
 
 template <typename Src>
 inline FileReader<Src>::FileReader(Src&& src, Options options)
-    : FileReaderBase(options.env(), options.buffer_size()),
+    : FileReaderBase(options.env(), options.buffer_size(),
+                     options.parallelism(), options.parallel_block_size()),
       src_(std::move(src)) {
   Initialize(src_.get(), options.initial_pos());
 }
@@ -360,7 +467,8 @@ template <typename Src>
 template <typename... SrcArgs>
 inline FileReader<Src>::FileReader(std::tuple<SrcArgs...> src_args,
                                    Options options)
-    : FileReaderBase(options.env(), options.buffer_size()),
+    : FileReaderBase(options.env(), options.buffer_size(),
+                     options.parallelism(), options.parallel_block_size()),
       src_(std::move(src_args)) {
   Initialize(src_.get(), options.initial_pos());
 }
@@ -379,14 +487,16 @@ inline void FileReader<Src>::Reset(Closed) {
 
 template <typename Src>
 inline void FileReader<Src>::Reset(const Src& src, Options options) {
-  FileReaderBase::Reset(options.env(), options.buffer_size());
+  FileReaderBase::Reset(options.env(), options.buffer_size(),
+                        options.parallelism(), options.parallel_block_size());
   src_.Reset(src);
   Initialize(src_.get(), options.initial_pos());
 }
 
 template <typename Src>
 inline void FileReader<Src>::Reset(Src&& src, Options options) {
-  FileReaderBase::Reset(options.env(), options.buffer_size());
+  FileReaderBase::Reset(options.env(), options.buffer_size(),
+                        options.parallelism(), options.parallel_block_size());
   src_.Reset(std::move(src));
   Initialize(src_.get(), options.initial_pos());
 }
@@ -395,7 +505,8 @@ template <typename Src>
 template <typename... SrcArgs>
 inline void FileReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                    Options options) {
-  FileReaderBase::Reset(options.env(), options.buffer_size());
+  FileReaderBase::Reset(options.env(), options.buffer_size(),
+                        options.parallelism(), options.parallel_block_size());
   src_.Reset(std::move(src_args));
   Initialize(src_.get(), options.initial_pos());
 }
@@ -417,7 +528,8 @@ inline void FileReader<Src>::Initialize(absl::string_view filename,
   }
   std::unique_ptr<::tensorflow::RandomAccessFile> src = OpenFile();
   if (ABSL_PREDICT_FALSE(src == nullptr)) return;
-  FileReaderBase::Reset(options.env(), options.buffer_size());
+  FileReaderBase::Reset(options.env(), options.buffer_size(),
+                        options.parallelism(), options.parallel_block_size());
   src_.Reset(std::forward_as_tuple(src.release()));
   InitializePos(options.initial_pos());
 }
@@ -17,21 +17,26 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <cstring>
+#include <deque>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/buffer.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/memory.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -45,6 +50,41 @@
 namespace riegeli {
 namespace tensorflow {
 
+struct FileWriterBase::BackgroundWrites {
+  struct PendingWrite {
+    Buffer buffer;
+    size_t length;
+  };
+
+  explicit BackgroundWrites(size_t max_pending_size)
+      : max_pending_size(max_pending_size) {}
+
+  // Returns `true` if `length_to_queue` more bytes fit in the queue, or if
+  // waiting is pointless because of a failure. A write longer than
+  // `max_pending_size` is accepted when nothing else is pending.
+  bool CanQueue() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    return pending_size == 0 ||
+           pending_size <= SaturatingSub(max_pending_size, length_to_queue) ||
+           !status.ok();
+  }
+
+  bool Idle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) { return !running; }
+
+  const size_t max_pending_size;
+  absl::Mutex mutex;
+  // The length of data waiting for `CanQueue()`.
+  size_t length_to_queue ABSL_GUARDED_BY(mutex) = 0;
+  // Data to append, in order.
+  std::deque<PendingWrite> queue ABSL_GUARDED_BY(mutex);
+  // The total length of data in `queue` and being appended.
+  size_t pending_size ABSL_GUARDED_BY(mutex) = 0;
+  // Whether a task running `AppendInBackground()` is active.
+  bool running ABSL_GUARDED_BY(mutex) = false;
+  // The first failure of `WritableFile::Append()`. Further queued data are
+  // dropped after a failure.
+  ::tensorflow::Status status ABSL_GUARDED_BY(mutex);
+};
+
 bool FileWriterBase::InitializeFilename(::tensorflow::WritableFile* dest) {
   absl::string_view filename;
   {
@@ -105,8 +145,10 @@ void FileWriterBase::InitializePos(::tensorflow::WritableFile* dest) {
 
 void FileWriterBase::Done() {
   SyncBuffer();
+  SyncBackgroundWrites();
   Writer::Done();
   buffer_ = Buffer();
+  background_writes_.reset();
 }
 
 bool FileWriterBase::FailOperation(const ::tensorflow::Status& status,
@@ -132,9 +174,106 @@ bool FileWriterBase::SyncBuffer() {
   set_buffer();
   if (data.empty()) return true;
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (max_pending_size_ > 0) {
+    // `data` is a prefix of `buffer_`, which is moved to the queue.
+    // `PushSlow()` will allocate a new buffer.
+    return WriteInBackground(std::move(buffer_), data.size());
+  }
   return WriteInternal(data);
 }
 
+bool FileWriterBase::WriteInBackground(Buffer buffer, size_t length) {
+  RIEGELI_ASSERT_GT(length, 0u)
+      << "Failed precondition of FileWriterBase::WriteInBackground(): "
+         "nothing to write";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of FileWriterBase::WriteInBackground(): "
+      << status();
+  if (ABSL_PREDICT_FALSE(length >
+                         std::numeric_limits<Position>::max() - start_pos())) {
+    return FailOverflow();
+  }
+  if (background_writes_ == nullptr) {
+    background_writes_ = std::make_shared<BackgroundWrites>(max_pending_size_);
+  }
+  BackgroundWrites& background_writes = *background_writes_;
+  ::tensorflow::Status failure;
+  bool start_task = false;
+  {
+    absl::MutexLock lock(&background_writes.mutex);
+    background_writes.length_to_queue = length;
+    background_writes.mutex.Await(
+        absl::Condition(&background_writes, &BackgroundWrites::CanQueue));
+    if (ABSL_PREDICT_FALSE(!background_writes.status.ok())) {
+      failure = background_writes.status;
+    } else {
+      background_writes.queue.push_back(
+          BackgroundWrites::PendingWrite{std::move(buffer), length});
+      background_writes.pending_size += length;
+      if (!background_writes.running) {
+        background_writes.running = true;
+        start_task = true;
+      }
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!failure.ok())) {
+    return FailOperation(failure, "WritableFile::Append(string_view)");
+  }
+  if (start_task) {
+    // Appending blocks on I/O, hence it does not run on a thread counted
+    // against the parallelism of CPU-bound tasks.
+    internal::ThreadPool::global().ScheduleBlocking(
+        [background_writes = background_writes_, dest = dest_file()] {
+          AppendInBackground(*background_writes, dest);
+        });
+  }
+  move_start_pos(length);
+  return true;
+}
+
+void FileWriterBase::AppendInBackground(BackgroundWrites& background_writes,
+                                        ::tensorflow::WritableFile* dest) {
+  absl::MutexLock lock(&background_writes.mutex);
+  while (!background_writes.queue.empty()) {
+    BackgroundWrites::PendingWrite pending_write =
+        std::move(background_writes.queue.front());
+    background_writes.queue.pop_front();
+    background_writes.mutex.Unlock();
+    const ::tensorflow::Status status = dest->Append(
+        absl::string_view(pending_write.buffer.data(), pending_write.length));
+    pending_write.buffer = Buffer();
+    background_writes.mutex.Lock();
+    background_writes.pending_size -= pending_write.length;
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      background_writes.status = status;
+      background_writes.queue.clear();
+      background_writes.pending_size = 0;
+    }
+  }
+  background_writes.running = false;
+}
+
+void FileWriterBase::WaitForBackgroundWrites() {
+  if (background_writes_ == nullptr) return;
+  absl::MutexLock lock(
+      &background_writes_->mutex,
+      absl::Condition(background_writes_.get(), &BackgroundWrites::Idle));
+}
+
+bool FileWriterBase::SyncBackgroundWrites() {
+  if (background_writes_ == nullptr) return true;
+  WaitForBackgroundWrites();
+  ::tensorflow::Status failure;
+  {
+    absl::MutexLock lock(&background_writes_->mutex);
+    failure = background_writes_->status;
+  }
+  if (ABSL_PREDICT_FALSE(!failure.ok())) {
+    return FailOperation(failure, "WritableFile::Append(string_view)");
+  }
+  return true;
+}
+
 inline size_t FileWriterBase::LengthToWriteDirectly() const {
   // Write directly at least `buffer_size_` of data. Even if the buffer is
   // partially full, this ensures that at least every other write has length at
@@ -189,6 +328,12 @@ bool FileWriterBase::WriteSlow(absl::string_view src) {
   if (src.size() >= LengthToWriteDirectly()) {
     if (ABSL_PREDICT_FALSE(!SyncBuffer())) return false;
     if (ABSL_PREDICT_FALSE(!healthy())) return false;
+    if (max_pending_size_ > 0) {
+      // `src` is not owned, hence it is copied before returning.
+      Buffer buffer(src.size());
+      std::memcpy(buffer.data(), src.data(), src.size());
+      return WriteInBackground(std::move(buffer), src.size());
+    }
     return WriteInternal(src);
   }
   return Writer::WriteSlow(src);
@@ -196,6 +341,7 @@ bool FileWriterBase::WriteSlow(absl::string_view src) {
 
 bool FileWriterBase::FlushImpl(FlushType flush_type) {
   if (ABSL_PREDICT_FALSE(!SyncBuffer())) return false;
+  if (ABSL_PREDICT_FALSE(!SyncBackgroundWrites())) return false;
   return healthy();
 }
 
@@ -206,6 +352,7 @@ absl::optional<Position> FileWriterBase::SizeImpl() {
     return Writer::SizeImpl();
   }
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!SyncBackgroundWrites())) return absl::nullopt;
   ::tensorflow::uint64 file_size;
   {
     const ::tensorflow::Status status =
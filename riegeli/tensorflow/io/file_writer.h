@@ -100,10 +100,33 @@ class FileWriterBase : public Writer {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // If positive, `WritableFile::Append()` is called by a background thread,
+    // overlapping writing to the file with producing further data, e.g. with
+    // encoding chunks by `RecordWriter`. This helps when appending has a high
+    // latency, like for object storage.
+    //
+    // At most about `max_pending_size` bytes are queued. Writing waits when the
+    // queue is full. `Flush()`, `Close()`, `Size()`, and `ReadMode()` wait for
+    // queued data. A failure of a background write is reported by a later
+    // operation.
+    //
+    // `0` means writing synchronously.
+    //
+    // Default: 0.
+    Options& set_max_pending_size(size_t max_pending_size) & {
+      max_pending_size_ = max_pending_size;
+      return *this;
+    }
+    Options&& set_max_pending_size(size_t max_pending_size) && {
+      return std::move(set_max_pending_size(max_pending_size));
+    }
+    size_t max_pending_size() const { return max_pending_size_; }
+
    private:
     ::tensorflow::Env* env_ = nullptr;
     bool append_ = false;
     size_t buffer_size_ = kDefaultBufferSize;
+    size_t max_pending_size_ = 0;
   };
 
   // Returns the `::tensorflow::WritableFile` being written to. Unchanged by
@@ -120,13 +143,15 @@ class FileWriterBase : public Writer {
  protected:
   explicit FileWriterBase(Closed) noexcept : Writer(kClosed) {}
 
-  explicit FileWriterBase(::tensorflow::Env* env, size_t buffer_size);
+  explicit FileWriterBase(::tensorflow::Env* env, size_t buffer_size,
+                          size_t max_pending_size);
 
   FileWriterBase(FileWriterBase&& that) noexcept;
   FileWriterBase& operator=(FileWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(::tensorflow::Env* env, size_t buffer_size);
+  void Reset(::tensorflow::Env* env, size_t buffer_size,
+             size_t max_pending_size);
   void Initialize(::tensorflow::WritableFile* dest);
   bool InitializeFilename(::tensorflow::WritableFile* dest);
   bool InitializeFilename(absl::string_view filename, ::tensorflow::Env* env);
@@ -134,6 +159,9 @@ class FileWriterBase : public Writer {
   void InitializePos(::tensorflow::WritableFile* dest);
   ABSL_ATTRIBUTE_COLD bool FailOperation(const ::tensorflow::Status& status,
                                          absl::string_view operation);
+  // Waits until background writes, if any, are finished. The caller must not
+  // access `dest_file()` in the meantime, nor destroy it before.
+  void WaitForBackgroundWrites();
 
   void Done() override;
   absl::Status AnnotateStatusImpl(absl::Status status) override;
@@ -145,8 +173,28 @@ class FileWriterBase : public Writer {
   Reader* ReadModeImpl(Position initial_pos) override;
 
  private:
+  // Data queued for background writes, and the state of the background task.
+  struct BackgroundWrites;
+
   bool SyncBuffer();
 
+  // Queues `buffer[0..length)` to be written in background.
+  //
+  // Increments `start_pos()` by `length`. Returns `true` on success.
+  //
+  // Preconditions:
+  //   `length > 0`
+  //   `healthy()`
+  bool WriteInBackground(Buffer buffer, size_t length);
+
+  // Waits until background writes are finished, and fails if one of them
+  // failed. Returns `true` on success.
+  bool SyncBackgroundWrites();
+
+  // Appends data from the queue until it becomes empty.
+  static void AppendInBackground(BackgroundWrites& background_writes,
+                                 ::tensorflow::WritableFile* dest);
+
   // Minimum length for which it is better to push current contents of `buffer_`
   // and write the data directly than to write the data through `buffer_`.
   size_t LengthToWriteDirectly() const;
@@ -172,6 +220,9 @@ class FileWriterBase : public Writer {
   size_t buffer_size_ = 0;
   // Buffered data to be written.
   Buffer buffer_;
+  size_t max_pending_size_ = 0;
+  // Created by the first background write.
+  std::shared_ptr<BackgroundWrites> background_writes_;
 
   AssociatedReader<FileReader<std::unique_ptr<::tensorflow::RandomAccessFile>>>
       associated_reader_;
@@ -221,6 +272,8 @@ class FileWriter : public FileWriterBase {
   FileWriter(FileWriter&& that) noexcept;
   FileWriter& operator=(FileWriter&& that) noexcept;
 
+  ~FileWriter();
+
   // Makes `*this` equivalent to a newly constructed `FileWriter`. This avoids
   // constructing a temporary `FileWriter` and moving from it.
   void Reset(Closed);
@@ -272,9 +325,11 @@ explicit FileWriter(absl::string_view filename,
 // Implementation details follow.
 
 inline FileWriterBase::FileWriterBase(::tensorflow::Env* env,
-                                      size_t buffer_size)
+                                      size_t buffer_size,
+                                      size_t max_pending_size)
     : env_(env != nullptr ? env : ::tensorflow::Env::Default()),
-      buffer_size_(buffer_size) {}
+      buffer_size_(buffer_size),
+      max_pending_size_(max_pending_size) {}
 
 inline FileWriterBase::FileWriterBase(FileWriterBase&& that) noexcept
     : Writer(std::move(that)),
@@ -285,10 +340,13 @@ inline FileWriterBase::FileWriterBase(FileWriterBase&& that) noexcept
       file_system_(that.file_system_),
       buffer_size_(that.buffer_size_),
       buffer_(std::move(that.buffer_)),
+      max_pending_size_(that.max_pending_size_),
+      background_writes_(std::move(that.background_writes_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline FileWriterBase& FileWriterBase::operator=(
     FileWriterBase&& that) noexcept {
+  WaitForBackgroundWrites();
   Writer::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
@@ -297,26 +355,35 @@ inline FileWriterBase& FileWriterBase::operator=(
   file_system_ = that.file_system_;
   env_ = that.env_, buffer_size_ = that.buffer_size_;
   buffer_ = std::move(that.buffer_);
+  max_pending_size_ = that.max_pending_size_;
+  background_writes_ = std::move(that.background_writes_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
 
 inline void FileWriterBase::Reset(Closed) {
+  WaitForBackgroundWrites();
   Writer::Reset(kClosed);
   filename_ = std::string();
   env_ = nullptr;
   file_system_ = nullptr;
   buffer_size_ = 0;
   buffer_ = Buffer();
+  max_pending_size_ = 0;
+  background_writes_.reset();
   associated_reader_.Reset();
 }
 
-inline void FileWriterBase::Reset(::tensorflow::Env* env, size_t buffer_size) {
+inline void FileWriterBase::Reset(::tensorflow::Env* env, size_t buffer_size,
+                                  size_t max_pending_size) {
+  WaitForBackgroundWrites();
   Writer::Reset();
   env_ = env != nullptr ? env : ::tensorflow::Env::Default();
   // `filename_` and `file_system_` will be or were set by
   // `InitializeFilename()`.
   buffer_size_ = buffer_size;
+  max_pending_size_ = max_pending_size;
+  background_writes_.reset();
   associated_reader_.Reset();
 }
 
@@ -329,13 +396,16 @@ inline void FileWriterBase::Initialize(::tensorflow::WritableFile* dest) {
 
 template <typename Dest>
 inline FileWriter<Dest>::FileWriter(const Dest& dest, Options options)
-    : FileWriterBase(options.env(), options.buffer_size()), dest_(dest) {
+    : FileWriterBase(options.env(), options.buffer_size(),
+                     options.max_pending_size()),
+      dest_(dest) {
   Initialize(dest_.get());
 }
 
 template <typename Dest>
 inline FileWriter<Dest>::FileWriter(Dest&& dest, Options options)
-    : FileWriterBase(options.env(), options.buffer_size()),
+    : FileWriterBase(options.env(), options.buffer_size(),
+                     options.max_pending_size()),
       dest_(std::move(dest)) {
   Initialize(dest_.get());
 }
@@ -344,7 +414,8 @@ template <typename Dest>
 template <typename... DestArgs>
 inline FileWriter<Dest>::FileWriter(std::tuple<DestArgs...> dest_args,
                                     Options options)
-    : FileWriterBase(options.env(), options.buffer_size()),
+    : FileWriterBase(options.env(), options.buffer_size(),
+                     options.max_pending_size()),
       dest_(std::move(dest_args)) {
   Initialize(dest_.get());
 }
@@ -372,6 +443,12 @@ inline FileWriter<Dest>& FileWriter<Dest>::operator=(
   return *this;
 }
 
+template <typename Dest>
+inline FileWriter<Dest>::~FileWriter() {
+  // Background writes use `dest_`.
+  WaitForBackgroundWrites();
+}
+
 template <typename Dest>
 inline void FileWriter<Dest>::Reset(Closed) {
   FileWriterBase::Reset(kClosed);
@@ -381,14 +458,16 @@ inline void FileWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void FileWriter<Dest>::Reset(const Dest& dest, Options options) {
-  FileWriterBase::Reset(options.env(), options.buffer_size());
+  FileWriterBase::Reset(options.env(), options.buffer_size(),
+                        options.max_pending_size());
   dest_.Reset(dest);
   Initialize(dest_.get());
 }
 
 template <typename Dest>
 inline void FileWriter<Dest>::Reset(Dest&& dest, Options options) {
-  FileWriterBase::Reset(options.env(), options.buffer_size());
+  FileWriterBase::Reset(options.env(), options.buffer_size(),
+                        options.max_pending_size());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get());
 }
@@ -397,7 +476,8 @@ template <typename Dest>
 template <typename... DestArgs>
 inline void FileWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                     Options options) {
-  FileWriterBase::Reset(options.env(), options.buffer_size());
+  FileWriterBase::Reset(options.env(), options.buffer_size(),
+                        options.max_pending_size());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get());
 }
@@ -419,7 +499,8 @@ inline void FileWriter<Dest>::Initialize(absl::string_view filename,
   }
   std::unique_ptr<::tensorflow::WritableFile> dest = OpenFile(options.append());
   if (ABSL_PREDICT_FALSE(dest == nullptr)) return;
-  FileWriterBase::Reset(options.env(), options.buffer_size());
+  FileWriterBase::Reset(options.env(), options.buffer_size(),
+                        options.max_pending_size());
   dest_.Reset(std::forward_as_tuple(dest.release()));
   InitializePos(dest_.get());
 }
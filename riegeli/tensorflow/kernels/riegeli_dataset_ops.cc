@@ -13,7 +13,9 @@
 // limitations under the License.
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -22,16 +24,20 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/chunk_encoding/field_projection.h"
 #include "riegeli/records/record_position.h"
 #include "riegeli/records/record_reader.h"
 #include "riegeli/records/skipped_region.h"
 #include "riegeli/tensorflow/io/file_reader.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -52,9 +58,48 @@ namespace riegeli {
 namespace tensorflow {
 namespace {
 
+// Parses a field path of the `field_projection` attr: proto field numbers
+// separated by '.', descending from the root message, e.g. "2.1". An empty
+// path denotes the root message.
+bool ParseFieldPath(absl::string_view path, Field& field) {
+  field = Field();
+  if (path.empty()) return true;
+  for (const absl::string_view field_number_string :
+       absl::StrSplit(path, '.')) {
+    int field_number;
+    if (!absl::SimpleAtoi(field_number_string, &field_number) ||
+        field_number < 0 || field_number > (1 << 29) - 1) {
+      return false;
+    }
+    field.AddFieldNumber(field_number);
+  }
+  return true;
+}
+
 class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
  public:
-  using DatasetOpKernel::DatasetOpKernel;
+  explicit RiegeliDatasetOp(::tensorflow::OpKernelConstruction* ctx,
+                            bool batched = false)
+      : DatasetOpKernel(ctx), batched_(batched) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("field_projection", &field_paths_));
+    if (!field_paths_.empty()) {
+      FieldProjection field_projection;
+      for (const std::string& path : field_paths_) {
+        Field field;
+        OP_REQUIRES(ctx, ParseFieldPath(path, field),
+                    ::tensorflow::errors::InvalidArgument(
+                        "Invalid field path in `field_projection`: ", path));
+        field_projection.AddField(std::move(field));
+      }
+      field_projection_ = std::move(field_projection);
+    }
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("parallelism", &parallelism_));
+    OP_REQUIRES(ctx, parallelism_ <= std::numeric_limits<int>::max(),
+                ::tensorflow::errors::InvalidArgument(
+                    "`parallelism` out of range: ", parallelism_));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("max_decoded_bytes", &max_decoded_bytes_));
+  }
 
   void MakeDataset(::tensorflow::OpKernelContext* ctx,
                    ::tensorflow::data::DatasetBase** output) override {
@@ -78,17 +123,39 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
         ctx, buffer_size > 0,
         ::tensorflow::errors::InvalidArgument("`buffer_size` must be > 0"));
 
-    *output = new Dataset(ctx, std::move(filenames), buffer_size);
+    absl::optional<int64_t> batch_size;
+    if (batched_) {
+      int64_t batch_size_value;
+      OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                              ctx, "batch_size", &batch_size_value));
+      OP_REQUIRES(
+          ctx, batch_size_value > 0,
+          ::tensorflow::errors::InvalidArgument("`batch_size` must be > 0"));
+      batch_size = batch_size_value;
+    }
+
+    *output = new Dataset(ctx, std::move(filenames), buffer_size, batch_size,
+                          field_paths_, field_projection_, parallelism_,
+                          max_decoded_bytes_);
   }
 
  private:
   class Dataset : public ::tensorflow::data::DatasetBase {
    public:
     explicit Dataset(::tensorflow::OpKernelContext* ctx,
-                     std::vector<std::string> filenames, int64_t buffer_size)
+                     std::vector<std::string> filenames, int64_t buffer_size,
+                     absl::optional<int64_t> batch_size,
+                     std::vector<std::string> field_paths,
+                     absl::optional<FieldProjection> field_projection,
+                     int64_t parallelism, int64_t max_decoded_bytes)
         : DatasetBase(::tensorflow::data::DatasetContext(ctx)),
           filenames_(std::move(filenames)),
-          buffer_size_(buffer_size) {}
+          buffer_size_(buffer_size),
+          batch_size_(batch_size),
+          field_paths_(std::move(field_paths)),
+          field_projection_(std::move(field_projection)),
+          parallelism_(parallelism),
+          max_decoded_bytes_(max_decoded_bytes) {}
 
     std::unique_ptr<::tensorflow::data::IteratorBase> MakeIteratorInternal(
         const std::string& prefix) const override {
@@ -104,6 +171,12 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
 
     const std::vector<::tensorflow::PartialTensorShape>& output_shapes()
         const override {
+      if (batch_size_ != absl::nullopt) {
+        static const std::vector<::tensorflow::PartialTensorShape>* const
+            batch_shapes =
+                new std::vector<::tensorflow::PartialTensorShape>({{-1}});
+        return *batch_shapes;
+      }
       static const std::vector<::tensorflow::PartialTensorShape>* const shapes =
           new std::vector<::tensorflow::PartialTensorShape>({{}});
       return *shapes;
@@ -132,7 +205,24 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
       ::tensorflow::Node* buffer_size = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
-      TF_RETURN_IF_ERROR(b->AddDataset(this, {filenames, buffer_size}, output));
+      std::vector<::tensorflow::Node*> inputs = {filenames, buffer_size};
+      if (batch_size_ != absl::nullopt) {
+        ::tensorflow::Node* batch_size = nullptr;
+        TF_RETURN_IF_ERROR(b->AddScalar(*batch_size_, &batch_size));
+        inputs.push_back(batch_size);
+      }
+      ::tensorflow::AttrValue field_projection;
+      b->BuildAttrValue(field_paths_, &field_projection);
+      ::tensorflow::AttrValue parallelism;
+      b->BuildAttrValue(parallelism_, &parallelism);
+      ::tensorflow::AttrValue max_decoded_bytes;
+      b->BuildAttrValue(max_decoded_bytes_, &max_decoded_bytes);
+      TF_RETURN_IF_ERROR(
+          b->AddDataset(this, inputs,
+                        {{"field_projection", field_projection},
+                         {"parallelism", parallelism},
+                         {"max_decoded_bytes", max_decoded_bytes}},
+                        output));
       return ::tensorflow::Status::OK();
     }
 
@@ -150,16 +240,24 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
         for (;;) {
           if (reader_ != absl::nullopt) {
             // We are currently processing a file, so try to read the next
-            // record.
-            ::tensorflow::Tensor result_tensor(::tensorflow::cpu_allocator(),
-                                               ::tensorflow::DT_STRING, {});
-            absl::string_view value;
-            if (TF_PREDICT_TRUE(reader_->ReadRecord(value))) {
-              result_tensor.scalar<::tensorflow::tstring>()().assign(
-                  value.data(), value.size());
-              out_tensors->push_back(std::move(result_tensor));
-              *end_of_sequence = false;
-              return ::tensorflow::Status::OK();
+            // record or batch of records.
+            if (dataset()->batch_size_ != absl::nullopt) {
+              if (TF_PREDICT_TRUE(ReadBatch(
+                      IntCast<size_t>(*dataset()->batch_size_), out_tensors))) {
+                *end_of_sequence = false;
+                return ::tensorflow::Status::OK();
+              }
+            } else {
+              ::tensorflow::Tensor result_tensor(
+                  ::tensorflow::cpu_allocator(), ::tensorflow::DT_STRING, {});
+              absl::string_view value;
+              if (TF_PREDICT_TRUE(reader_->ReadRecord(value))) {
+                result_tensor.scalar<::tensorflow::tstring>()().assign(
+                    value.data(), value.size());
+                out_tensors->push_back(std::move(result_tensor));
+                *end_of_sequence = false;
+                return ::tensorflow::Status::OK();
+              }
             }
             SkippedRegion skipped_region;
             if (reader_->Recover(&skipped_region)) {
@@ -257,13 +355,54 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
       }
 
      private:
+      // Reads up to `batch_size` next records of the current file into a
+      // vector tensor appended to `out_tensors`. A batch ends early at the end
+      // of the file or before a failure, which is then reported by the next
+      // call.
+      //
+      // Returns `false` if no record could be read.
+      bool ReadBatch(size_t batch_size,
+                     std::vector<::tensorflow::Tensor>* out_tensors)
+          ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        ::tensorflow::Tensor result_tensor(
+            ::tensorflow::cpu_allocator(), ::tensorflow::DT_STRING,
+            {IntCast<int64_t>(batch_size)});
+        auto values = result_tensor.vec<::tensorflow::tstring>();
+        size_t num_records = 0;
+        absl::string_view value;
+        while (num_records < batch_size && reader_->ReadRecord(value)) {
+          values(IntCast<int64_t>(num_records)).assign(value.data(),
+                                                       value.size());
+          ++num_records;
+        }
+        if (num_records == 0) return false;
+        if (num_records < batch_size) {
+          result_tensor = result_tensor.Slice(0, IntCast<int64_t>(num_records));
+        }
+        out_tensors->push_back(std::move(result_tensor));
+        return true;
+      }
+
       void OpenFile(::tensorflow::data::IteratorContext* ctx)
           ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-        reader_.emplace(std::forward_as_tuple(
-            dataset()->filenames_[current_file_index_],
-            tensorflow::FileReaderBase::Options()
-                .set_env(ctx->env())
-                .set_buffer_size(IntCast<size_t>(dataset()->buffer_size_))));
+        RecordReaderBase::Options options;
+        if (dataset()->field_projection_ != absl::nullopt) {
+          options.set_field_projection(*dataset()->field_projection_);
+        }
+        if (dataset()->parallelism_ > 0) {
+          options.set_parallelism(IntCast<int>(dataset()->parallelism_));
+          if (dataset()->max_decoded_bytes_ >= 0) {
+            options.set_max_decoded_bytes(
+                IntCast<uint64_t>(dataset()->max_decoded_bytes_));
+          }
+        }
+        reader_.emplace(
+            std::forward_as_tuple(
+                dataset()->filenames_[current_file_index_],
+                tensorflow::FileReaderBase::Options()
+                    .set_env(ctx->env())
+                    .set_buffer_size(IntCast<size_t>(dataset()->buffer_size_))),
+            std::move(options));
       }
 
       // Invariants:
@@ -280,11 +419,35 @@ class RiegeliDatasetOp : public ::tensorflow::data::DatasetOpKernel {
 
     const std::vector<std::string> filenames_;
     const int64_t buffer_size_;
+    // `absl::nullopt` means that records are emitted one at a time.
+    const absl::optional<int64_t> batch_size_;
+    // The `field_projection` attr, kept for `AsGraphDefInternal()`.
+    const std::vector<std::string> field_paths_;
+    // `absl::nullopt` means all fields.
+    const absl::optional<FieldProjection> field_projection_;
+    const int64_t parallelism_;
+    // Negative means no limit.
+    const int64_t max_decoded_bytes_;
   };
+
+  const bool batched_;
+  std::vector<std::string> field_paths_;
+  absl::optional<FieldProjection> field_projection_;
+  int64_t parallelism_ = 0;
+  int64_t max_decoded_bytes_ = -1;
+};
+
+class RiegeliBatchDatasetOp : public RiegeliDatasetOp {
+ public:
+  explicit RiegeliBatchDatasetOp(::tensorflow::OpKernelConstruction* ctx)
+      : RiegeliDatasetOp(ctx, true) {}
 };
 
 REGISTER_KERNEL_BUILDER(Name("RiegeliDataset").Device(::tensorflow::DEVICE_CPU),
                         RiegeliDatasetOp);
+REGISTER_KERNEL_BUILDER(
+    Name("RiegeliBatchDataset").Device(::tensorflow::DEVICE_CPU),
+    RiegeliBatchDatasetOp);
 
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,186 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/tensorflow/io/file_writer.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/function_handle_cache.h"
+#include "tensorflow/core/framework/kernel_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/tstring.h"
+#include "tensorflow/core/protobuf/error_codes.pb.h"
+
+namespace riegeli {
+namespace tensorflow {
+namespace {
+
+::tensorflow::Status ToTensorflowStatus(const absl::Status& status) {
+  return ::tensorflow::Status(
+      static_cast<::tensorflow::error::Code>(status.code()), status.message());
+}
+
+// Returns the name of shard `shard_index` of `num_shards`, e.g.
+// "file-00001-of-00004", or `filename` itself if there is one shard.
+std::string ShardFilename(absl::string_view filename, int64_t shard_index,
+                          int64_t num_shards) {
+  if (num_shards == 1) return std::string(filename);
+  return absl::StrFormat("%s-%05d-of-%05d", filename, shard_index, num_shards);
+}
+
+class WriteRiegeliDatasetOp : public ::tensorflow::AsyncOpKernel {
+ public:
+  using AsyncOpKernel::AsyncOpKernel;
+
+  void ComputeAsync(::tensorflow::OpKernelContext* ctx,
+                    DoneCallback done) override {
+    // Iterating over the dataset blocks until all records are written, so it
+    // is done in its own thread rather than in an inter-op thread.
+    internal::ThreadPool::global().ScheduleBlocking([ctx, done] {
+      OP_REQUIRES_OK_ASYNC(ctx, WriteDataset(ctx), done);
+      done();
+    });
+  }
+
+ private:
+  static ::tensorflow::Status WriteDataset(::tensorflow::OpKernelContext* ctx);
+};
+
+::tensorflow::Status WriteRiegeliDatasetOp::WriteDataset(
+    ::tensorflow::OpKernelContext* ctx) {
+  ::tensorflow::data::DatasetBase* dataset;
+  TF_RETURN_IF_ERROR(
+      ::tensorflow::data::GetDatasetFromVariantTensor(ctx->input(0), &dataset));
+  if (TF_PREDICT_FALSE(
+          dataset->output_dtypes() !=
+              ::tensorflow::DataTypeVector({::tensorflow::DT_STRING}) ||
+          dataset->output_shapes().size() != 1 ||
+          !dataset->output_shapes()[0].IsCompatibleWith(
+              ::tensorflow::PartialTensorShape({})))) {
+    return ::tensorflow::errors::InvalidArgument(
+        "`input_dataset` must be a dataset of scalar strings");
+  }
+
+  ::tensorflow::tstring filename;
+  TF_RETURN_IF_ERROR(
+      ::tensorflow::data::ParseScalarArgument<::tensorflow::tstring>(
+          ctx, "filename", &filename));
+  ::tensorflow::tstring options_text;
+  TF_RETURN_IF_ERROR(
+      ::tensorflow::data::ParseScalarArgument<::tensorflow::tstring>(
+          ctx, "options", &options_text));
+  int64_t num_shards;
+  TF_RETURN_IF_ERROR(::tensorflow::data::ParseScalarArgument<int64_t>(
+      ctx, "num_shards", &num_shards));
+  if (TF_PREDICT_FALSE(num_shards <= 0)) {
+    return ::tensorflow::errors::InvalidArgument("`num_shards` must be > 0");
+  }
+  RecordWriterBase::Options options;
+  {
+    const absl::Status status = options.FromString(options_text);
+    if (TF_PREDICT_FALSE(!status.ok())) {
+      return ::tensorflow::errors::InvalidArgument(
+          "Invalid RecordWriter options: ", status.message());
+    }
+  }
+
+  // Encoding with `parallelism() > 0` in each shard happens in background
+  // while the next records are taken from the dataset.
+  std::vector<RecordWriter<tensorflow::FileWriter<>>> writers;
+  writers.reserve(IntCast<size_t>(num_shards));
+  for (int64_t shard_index = 0; shard_index < num_shards; ++shard_index) {
+    writers.emplace_back(
+        std::forward_as_tuple(
+            ShardFilename(filename, shard_index, num_shards),
+            tensorflow::FileWriterBase::Options().set_env(ctx->env())),
+        options);
+  }
+  // Closes all writers, and returns the first failure of a writer, or `status`
+  // if it is already a failure.
+  const auto close_writers = [&writers](::tensorflow::Status status) {
+    for (RecordWriter<tensorflow::FileWriter<>>& writer : writers) {
+      if (TF_PREDICT_FALSE(!writer.Close()) && status.ok()) {
+        status = ToTensorflowStatus(writer.status());
+      }
+    }
+    return status;
+  };
+
+  ::tensorflow::data::IteratorContext::Params params(ctx);
+  ::tensorflow::data::FunctionHandleCache function_handle_cache(params.flr);
+  params.function_handle_cache = &function_handle_cache;
+  ::tensorflow::ResourceMgr resource_mgr;
+  params.resource_mgr = &resource_mgr;
+  ::tensorflow::CancellationManager cancellation_manager(
+      ctx->cancellation_manager());
+  params.cancellation_manager = &cancellation_manager;
+  ::tensorflow::data::IteratorContext iter_ctx(std::move(params));
+  std::unique_ptr<::tensorflow::data::IteratorBase> iterator;
+  {
+    const ::tensorflow::Status status = dataset->MakeIterator(
+        &iter_ctx, /*parent=*/nullptr, "WriteRiegeliDataset", &iterator);
+    if (TF_PREDICT_FALSE(!status.ok())) return close_writers(status);
+  }
+
+  std::vector<::tensorflow::Tensor> components;
+  size_t shard_index = 0;
+  for (;;) {
+    components.clear();
+    bool end_of_sequence;
+    {
+      const ::tensorflow::Status status =
+          iterator->GetNext(&iter_ctx, &components, &end_of_sequence);
+      if (TF_PREDICT_FALSE(!status.ok())) return close_writers(status);
+    }
+    if (end_of_sequence) break;
+    const ::tensorflow::tstring& record =
+        components[0].scalar<::tensorflow::tstring>()();
+    RecordWriter<tensorflow::FileWriter<>>& writer = writers[shard_index];
+    if (TF_PREDICT_FALSE(!writer.WriteRecord(
+            absl::string_view(record.data(), record.size())))) {
+      return close_writers(ToTensorflowStatus(writer.status()));
+    }
+    if (++shard_index == writers.size()) shard_index = 0;
+  }
+  return close_writers(::tensorflow::Status::OK());
+}
+
+}  // namespace
+
+REGISTER_KERNEL_BUILDER(
+    Name("WriteRiegeliDataset").Device(::tensorflow::DEVICE_CPU),
+    WriteRiegeliDatasetOp);
+
+}  // namespace tensorflow
+}  // namespace riegeli
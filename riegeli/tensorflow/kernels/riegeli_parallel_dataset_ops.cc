@@ -0,0 +1,539 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/skipped_region.h"
+#include "riegeli/tensorflow/io/file_reader.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/kernel_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/tstring.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/error_codes.pb.h"
+
+namespace riegeli {
+namespace tensorflow {
+namespace {
+
+class RiegeliParallelDatasetOp : public ::tensorflow::data::DatasetOpKernel {
+ public:
+  using DatasetOpKernel::DatasetOpKernel;
+
+  void MakeDataset(::tensorflow::OpKernelContext* ctx,
+                   ::tensorflow::data::DatasetBase** output) override {
+    const ::tensorflow::Tensor* filenames_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("filenames", &filenames_tensor));
+    OP_REQUIRES(ctx, filenames_tensor->dims() <= 1,
+                ::tensorflow::errors::InvalidArgument(
+                    "`filenames` must be a scalar or a vector."));
+
+    std::vector<std::string> filenames;
+    filenames.reserve(IntCast<size_t>(filenames_tensor->NumElements()));
+    for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
+      filenames.emplace_back(
+          filenames_tensor->flat<::tensorflow::tstring>()(i));
+    }
+
+    int64_t buffer_size;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "buffer_size", &buffer_size));
+    OP_REQUIRES(
+        ctx, buffer_size > 0,
+        ::tensorflow::errors::InvalidArgument("`buffer_size` must be > 0"));
+
+    int64_t cycle_length;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "cycle_length", &cycle_length));
+    OP_REQUIRES(
+        ctx, cycle_length > 0,
+        ::tensorflow::errors::InvalidArgument("`cycle_length` must be > 0"));
+
+    int64_t prefetch_size;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "prefetch_size", &prefetch_size));
+    OP_REQUIRES(
+        ctx, prefetch_size > 0,
+        ::tensorflow::errors::InvalidArgument("`prefetch_size` must be > 0"));
+
+    bool deterministic;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<bool>(
+                            ctx, "deterministic", &deterministic));
+
+    *output = new Dataset(ctx, std::move(filenames), buffer_size, cycle_length,
+                          prefetch_size, deterministic);
+  }
+
+ private:
+  class Dataset : public ::tensorflow::data::DatasetBase {
+   public:
+    explicit Dataset(::tensorflow::OpKernelContext* ctx,
+                     std::vector<std::string> filenames, int64_t buffer_size,
+                     int64_t cycle_length, int64_t prefetch_size,
+                     bool deterministic)
+        : DatasetBase(::tensorflow::data::DatasetContext(ctx)),
+          filenames_(std::move(filenames)),
+          buffer_size_(buffer_size),
+          cycle_length_(cycle_length),
+          prefetch_size_(prefetch_size),
+          deterministic_(deterministic) {}
+
+    std::unique_ptr<::tensorflow::data::IteratorBase> MakeIteratorInternal(
+        const std::string& prefix) const override {
+      return std::unique_ptr<::tensorflow::data::IteratorBase>(
+          new Iterator({this, absl::StrCat(prefix, "::RiegeliParallel")}));
+    }
+
+    const ::tensorflow::DataTypeVector& output_dtypes() const override {
+      static const ::tensorflow::DataTypeVector* const dtypes =
+          new ::tensorflow::DataTypeVector({::tensorflow::DT_STRING});
+      return *dtypes;
+    }
+
+    const std::vector<::tensorflow::PartialTensorShape>& output_shapes()
+        const override {
+      static const std::vector<::tensorflow::PartialTensorShape>* const shapes =
+          new std::vector<::tensorflow::PartialTensorShape>({{}});
+      return *shapes;
+    }
+
+    std::string DebugString() const override {
+      return "RiegeliParallelDatasetOp::Dataset";
+    }
+
+    ::tensorflow::Status CheckExternalState() const override {
+      return ::tensorflow::Status::OK();
+    }
+
+    ::tensorflow::Status InputDatasets(
+        std::vector<const ::tensorflow::data::DatasetBase*>* inputs)
+        const override {
+      inputs->clear();
+      return ::tensorflow::Status::OK();
+    }
+
+   protected:
+    ::tensorflow::Status AsGraphDefInternal(
+        ::tensorflow::data::SerializationContext* ctx,
+        DatasetGraphDefBuilder* b, ::tensorflow::Node** output) const override {
+      ::tensorflow::Node* filenames = nullptr;
+      TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
+      ::tensorflow::Node* buffer_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
+      ::tensorflow::Node* cycle_length = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(cycle_length_, &cycle_length));
+      ::tensorflow::Node* prefetch_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(prefetch_size_, &prefetch_size));
+      ::tensorflow::Node* deterministic = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(deterministic_, &deterministic));
+      TF_RETURN_IF_ERROR(b->AddDataset(this,
+                                       {filenames, buffer_size, cycle_length,
+                                        prefetch_size, deterministic},
+                                       output));
+      return ::tensorflow::Status::OK();
+    }
+
+   private:
+    // Files are assigned to `cycle_length_` slots in order, each slot reading
+    // its file in tasks on the thread pool shared by all parallel operations
+    // of Riegeli. A task reads records until `prefetch_size_` records of the
+    // slot are waiting to be returned, or until the end of the file. It is
+    // rescheduled as records are taken from the slot.
+    //
+    // If `deterministic_`, records are taken from slots in turn, and a
+    // missing record is waited for. Otherwise records are taken from the
+    // next slot which has one available.
+    //
+    // `SaveInternal()` stores the `RecordPosition` following the last record
+    // returned from each slot, hence records read ahead are read again after
+    // `RestoreInternal()`.
+    class Iterator : public ::tensorflow::data::DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params),
+            slots_(IntCast<size_t>(dataset()->cycle_length_)) {}
+
+      ~Iterator() override ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        CancelFills();
+      }
+
+      ::tensorflow::Status GetNextInternal(
+          ::tensorflow::data::IteratorContext* ctx,
+          std::vector<::tensorflow::Tensor>* out_tensors,
+          bool* end_of_sequence) override ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        env_ = ctx->env();
+        for (;;) {
+          // Iteration ends when there are no more files to process.
+          if (!FillSlots()) {
+            *end_of_sequence = true;
+            return ::tensorflow::Status::OK();
+          }
+          const absl::optional<size_t> slot_index = ReadySlot();
+          if (slot_index == absl::nullopt) {
+            mu_.Await(absl::Condition(this, &Iterator::HasReadySlot));
+            continue;
+          }
+          Slot& slot = slots_[*slot_index];
+          if (slot.items.empty()) {
+            // We have reached the end of the file of this slot, so move on to
+            // the next file, if any.
+            CloseSlot(slot);
+            continue;
+          }
+          Item item = std::move(slot.items.front());
+          slot.items.pop_front();
+          slot.pos = item.next_pos;
+          cursor_ = (*slot_index + 1) % slots_.size();
+          if (slot.end && slot.items.empty()) {
+            CloseSlot(slot);
+          } else {
+            ScheduleFill(slot);
+          }
+          *end_of_sequence = false;
+          if (!item.status.ok()) {
+            // File has invalid contents or failed to be read: return an error.
+            // Further iteration will resume reading the file after the invalid
+            // region has been skipped, or will move on to the next file.
+            return ::tensorflow::Status(
+                static_cast<::tensorflow::error::Code>(item.status.code()),
+                item.status.message());
+          }
+          ::tensorflow::Tensor result_tensor(::tensorflow::cpu_allocator(),
+                                             ::tensorflow::DT_STRING, {});
+          result_tensor.scalar<::tensorflow::tstring>()() =
+              std::move(item.value);
+          out_tensors->push_back(std::move(result_tensor));
+          return ::tensorflow::Status::OK();
+        }
+      }
+
+     protected:
+      ::tensorflow::Status SaveInternal(
+          ::tensorflow::data::SerializationContext* ctx,
+          ::tensorflow::data::IteratorStateWriter* writer) override
+          ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name("next_file_index"),
+                                IntCast<int64_t>(next_file_index_)));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name("cursor"),
+                                               IntCast<int64_t>(cursor_)));
+        for (size_t index = 0; index < slots_.size(); ++index) {
+          const Slot& slot = slots_[index];
+          if (!slot.active) continue;
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name(absl::StrCat("slot_", index, "_file_index")),
+              IntCast<int64_t>(slot.file_index)));
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name(absl::StrCat("slot_", index, "_pos")),
+              slot.pos.ToBytes()));
+        }
+        return ::tensorflow::Status::OK();
+      }
+
+      ::tensorflow::Status RestoreInternal(
+          ::tensorflow::data::IteratorContext* ctx,
+          ::tensorflow::data::IteratorStateReader* reader) override
+          ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        CancelFills();
+        env_ = ctx->env();
+        next_file_index_ = 0;
+        cursor_ = 0;
+        for (Slot& slot : slots_) CloseSlot(slot);
+
+        int64_t next_file_index;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("next_file_index"),
+                                              &next_file_index));
+        if (TF_PREDICT_FALSE(next_file_index < 0 ||
+                             IntCast<::tensorflow::uint64>(next_file_index) >
+                                 dataset()->filenames_.size())) {
+          return ::tensorflow::errors::Internal(
+              "next_file_index out of range");
+        }
+        int64_t cursor;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("cursor"), &cursor));
+        if (TF_PREDICT_FALSE(cursor < 0 ||
+                             IntCast<::tensorflow::uint64>(cursor) >=
+                                 slots_.size())) {
+          return ::tensorflow::errors::Internal("cursor out of range");
+        }
+
+        for (size_t index = 0; index < slots_.size(); ++index) {
+          const std::string file_index_name =
+              full_name(absl::StrCat("slot_", index, "_file_index"));
+          if (!reader->Contains(file_index_name)) continue;
+          int64_t file_index;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(file_index_name, &file_index));
+          if (TF_PREDICT_FALSE(file_index < 0 ||
+                               file_index >= next_file_index)) {
+            return ::tensorflow::errors::Internal("file_index out of range");
+          }
+          ::tensorflow::tstring pos_bytes;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name(absl::StrCat("slot_", index, "_pos")), &pos_bytes));
+          RecordPosition pos;
+          if (TF_PREDICT_FALSE(!pos.FromBytes(pos_bytes))) {
+            return ::tensorflow::errors::Internal(
+                "slot position is not a valid RecordPosition");
+          }
+          Slot& slot = slots_[index];
+          slot.active = true;
+          slot.file_index = IntCast<size_t>(file_index);
+          // The file will be opened and seeked to `pos` by its first fill.
+          // Any errors from seeking will be reported during reading.
+          slot.pos = pos;
+        }
+        next_file_index_ = IntCast<size_t>(next_file_index);
+        cursor_ = IntCast<size_t>(cursor);
+        return ::tensorflow::Status::OK();
+      }
+
+     private:
+      // A record, or a failure to be returned in its place.
+      struct Item {
+        // The record if `status.ok()`.
+        ::tensorflow::tstring value;
+        absl::Status status;
+        // The position following this item.
+        RecordPosition next_pos;
+      };
+
+      // A file being read.
+      struct Slot {
+        // Whether `file_index` is assigned to this slot.
+        bool active = false;
+        size_t file_index = 0;
+        // The position following the last item returned from this slot. The
+        // file is opened at this position by the first fill.
+        RecordPosition pos;
+        // Whether a fill task is scheduled. While it is, `reader` is accessed
+        // only by that task, without holding `mu_`.
+        bool filling = false;
+        // Whether `reader` finished reading, remaining records being all in
+        // `items`.
+        bool end = false;
+        // `nullptr` means not open yet.
+        std::unique_ptr<RecordReader<tensorflow::FileReader<>>> reader;
+        // Records read ahead.
+        std::deque<Item> items;
+      };
+
+      // Assigns remaining files to inactive slots, and schedules fills of
+      // active slots which need them.
+      //
+      // Returns `false` if there are no active slots, i.e. iteration ends.
+      bool FillSlots() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        bool any_active = false;
+        for (Slot& slot : slots_) {
+          if (!slot.active &&
+              next_file_index_ < dataset()->filenames_.size()) {
+            slot.active = true;
+            slot.file_index = next_file_index_++;
+          }
+          if (slot.active) {
+            any_active = true;
+            ScheduleFill(slot);
+          }
+        }
+        return any_active;
+      }
+
+      // Returns the index of the slot from which the next item should be
+      // taken, if its items are available or its file ended, otherwise
+      // `absl::nullopt`.
+      absl::optional<size_t> ReadySlot() const
+          ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+          const size_t index = (cursor_ + i) % slots_.size();
+          const Slot& slot = slots_[index];
+          if (!slot.active) continue;
+          if (!slot.items.empty() || slot.end) return index;
+          if (dataset()->deterministic_) break;
+        }
+        return absl::nullopt;
+      }
+
+      bool HasReadySlot() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return ReadySlot() != absl::nullopt;
+      }
+
+      // Makes `slot` inactive, closing its file.
+      //
+      // Precondition: `!slot.filling`
+      void CloseSlot(Slot& slot) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        RIEGELI_ASSERT(!slot.filling)
+            << "Failed precondition of CloseSlot(): slot is being filled";
+        slot.active = false;
+        slot.pos = RecordPosition();
+        slot.end = false;
+        slot.reader.reset();
+        slot.items.clear();
+      }
+
+      // Schedules a fill of `slot` if it is active, not being filled, its file
+      // did not end, and it has space for more items.
+      void ScheduleFill(Slot& slot) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const size_t prefetch_size = IntCast<size_t>(dataset()->prefetch_size_);
+        if (cancelled_ || !slot.active || slot.filling || slot.end ||
+            slot.items.size() >= prefetch_size) {
+          return;
+        }
+        slot.filling = true;
+        ++num_fills_;
+        Slot* const slot_ptr = &slot;
+        const size_t max_num_items = prefetch_size - slot.items.size();
+        const std::string* const filename =
+            &dataset()->filenames_[slot.file_index];
+        const RecordPosition initial_pos = slot.pos;
+        ::tensorflow::Env* const env = env_;
+        // Filling blocks on I/O, hence it does not use the pool used for
+        // decoding. At most `cycle_length` fills are in flight.
+        internal::ThreadPool::global().ScheduleBlocking(
+            [this, slot_ptr, max_num_items, filename, initial_pos, env] {
+              Fill(*slot_ptr, max_num_items, *filename, initial_pos, env);
+            });
+      }
+
+      // Reads up to `max_num_items` items of `slot`, opening its file at
+      // `initial_pos` if needed.
+      void Fill(Slot& slot, size_t max_num_items, const std::string& filename,
+                RecordPosition initial_pos, ::tensorflow::Env* env)
+          ABSL_LOCKS_EXCLUDED(mu_) {
+        if (slot.reader == nullptr) {
+          slot.reader =
+              std::make_unique<RecordReader<tensorflow::FileReader<>>>(
+                  std::forward_as_tuple(
+                      filename,
+                      tensorflow::FileReaderBase::Options()
+                          .set_env(env)
+                          .set_buffer_size(
+                              IntCast<size_t>(dataset()->buffer_size_))));
+          if (initial_pos != RecordPosition()) slot.reader->Seek(initial_pos);
+        }
+        RecordReader<tensorflow::FileReader<>>& reader = *slot.reader;
+        std::vector<Item> items;
+        items.reserve(max_num_items);
+        bool end = false;
+        absl::string_view value;
+        while (items.size() < max_num_items) {
+          if (TF_PREDICT_TRUE(reader.ReadRecord(value))) {
+            items.push_back(Item{::tensorflow::tstring(value.data(),
+                                                       value.size()),
+                                 absl::OkStatus(), reader.pos()});
+            continue;
+          }
+          SkippedRegion skipped_region;
+          if (reader.Recover(&skipped_region)) {
+            items.push_back(Item{
+                ::tensorflow::tstring(),
+                absl::InvalidArgumentError(absl::StrCat(
+                    "Skipping invalid region of a Riegeli/records file: ",
+                    skipped_region.ToString())),
+                reader.pos()});
+            continue;
+          }
+          const RecordPosition end_pos = reader.pos();
+          if (TF_PREDICT_FALSE(!reader.Close())) {
+            items.push_back(
+                Item{::tensorflow::tstring(), reader.status(), end_pos});
+          }
+          end = true;
+          break;
+        }
+
+        absl::MutexLock l(&mu_);
+        for (Item& item : items) slot.items.push_back(std::move(item));
+        slot.filling = false;
+        slot.end = end;
+        --num_fills_;
+        ScheduleFill(slot);
+      }
+
+      // Waits until no fills are running, and prevents scheduling them until
+      // `CancelFills()` returns.
+      void CancelFills() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        cancelled_ = true;
+        mu_.Await(absl::Condition(
+            +[](size_t* num_fills) { return *num_fills == 0; }, &num_fills_));
+        cancelled_ = false;
+      }
+
+      // Invariants:
+      //   `next_file_index_ <= dataset()->filenames_.size()`
+      //   `cursor_ < slots_.size()`
+      //   active slots have `file_index < next_file_index_`
+
+      absl::Mutex mu_;
+      // The `::tensorflow::Env` of the last `GetNextInternal()` or
+      // `RestoreInternal()`.
+      ::tensorflow::Env* env_ ABSL_GUARDED_BY(mu_) = nullptr;
+      // The index of the next file to assign to a slot.
+      size_t next_file_index_ ABSL_GUARDED_BY(mu_) = 0;
+      // The index of the slot to take the next item from.
+      size_t cursor_ ABSL_GUARDED_BY(mu_) = 0;
+      // The size is `dataset()->cycle_length_`, constant after construction,
+      // hence pointers to elements are stable.
+      std::vector<Slot> slots_ ABSL_GUARDED_BY(mu_);
+      // The number of fill tasks scheduled and not finished.
+      size_t num_fills_ ABSL_GUARDED_BY(mu_) = 0;
+      bool cancelled_ ABSL_GUARDED_BY(mu_) = false;
+    };
+
+    const std::vector<std::string> filenames_;
+    const int64_t buffer_size_;
+    const int64_t cycle_length_;
+    const int64_t prefetch_size_;
+    const bool deterministic_;
+  };
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("RiegeliParallelDataset").Device(::tensorflow::DEVICE_CPU),
+    RiegeliParallelDatasetOp);
+
+}  // namespace
+}  // namespace tensorflow
+}  // namespace riegeli
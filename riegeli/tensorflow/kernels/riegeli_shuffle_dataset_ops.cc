@@ -0,0 +1,561 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/record_reader.h"
+#include "riegeli/records/record_splits.h"
+#include "riegeli/records/skipped_region.h"
+#include "riegeli/tensorflow/io/file_reader.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/kernel_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/tstring.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/error_codes.pb.h"
+
+namespace riegeli {
+namespace tensorflow {
+namespace {
+
+::tensorflow::Status ToTfStatus(const absl::Status& status) {
+  return ::tensorflow::Status(
+      static_cast<::tensorflow::error::Code>(status.code()), status.message());
+}
+
+class RiegeliShuffleDatasetOp : public ::tensorflow::data::DatasetOpKernel {
+ public:
+  using DatasetOpKernel::DatasetOpKernel;
+
+  void MakeDataset(::tensorflow::OpKernelContext* ctx,
+                   ::tensorflow::data::DatasetBase** output) override {
+    const ::tensorflow::Tensor* filenames_tensor;
+    OP_REQUIRES_OK(ctx, ctx->input("filenames", &filenames_tensor));
+    OP_REQUIRES(ctx, filenames_tensor->dims() <= 1,
+                ::tensorflow::errors::InvalidArgument(
+                    "`filenames` must be a scalar or a vector."));
+
+    std::vector<std::string> filenames;
+    filenames.reserve(IntCast<size_t>(filenames_tensor->NumElements()));
+    for (int i = 0; i < filenames_tensor->NumElements(); ++i) {
+      filenames.emplace_back(
+          filenames_tensor->flat<::tensorflow::tstring>()(i));
+    }
+
+    int64_t buffer_size;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "buffer_size", &buffer_size));
+    OP_REQUIRES(
+        ctx, buffer_size > 0,
+        ::tensorflow::errors::InvalidArgument("`buffer_size` must be > 0"));
+
+    int64_t range_size;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "range_size", &range_size));
+    OP_REQUIRES(
+        ctx, range_size > 0,
+        ::tensorflow::errors::InvalidArgument("`range_size` must be > 0"));
+
+    int64_t window_size;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "window_size", &window_size));
+    OP_REQUIRES(
+        ctx, window_size > 0,
+        ::tensorflow::errors::InvalidArgument("`window_size` must be > 0"));
+
+    int64_t num_parallel_reads;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "num_parallel_reads", &num_parallel_reads));
+    OP_REQUIRES(ctx, num_parallel_reads > 0,
+                ::tensorflow::errors::InvalidArgument(
+                    "`num_parallel_reads` must be > 0"));
+
+    int64_t seed;
+    OP_REQUIRES_OK(ctx, ::tensorflow::data::ParseScalarArgument<int64_t>(
+                            ctx, "seed", &seed));
+
+    *output = new Dataset(ctx, std::move(filenames), buffer_size, range_size,
+                          window_size, num_parallel_reads, seed);
+  }
+
+ private:
+  class Dataset : public ::tensorflow::data::DatasetBase {
+   public:
+    explicit Dataset(::tensorflow::OpKernelContext* ctx,
+                     std::vector<std::string> filenames, int64_t buffer_size,
+                     int64_t range_size, int64_t window_size,
+                     int64_t num_parallel_reads, int64_t seed)
+        : DatasetBase(::tensorflow::data::DatasetContext(ctx)),
+          filenames_(std::move(filenames)),
+          buffer_size_(buffer_size),
+          range_size_(range_size),
+          window_size_(window_size),
+          num_parallel_reads_(num_parallel_reads),
+          seed_(seed) {}
+
+    std::unique_ptr<::tensorflow::data::IteratorBase> MakeIteratorInternal(
+        const std::string& prefix) const override {
+      return std::unique_ptr<::tensorflow::data::IteratorBase>(
+          new Iterator({this, absl::StrCat(prefix, "::RiegeliShuffle")}));
+    }
+
+    const ::tensorflow::DataTypeVector& output_dtypes() const override {
+      static const ::tensorflow::DataTypeVector* const dtypes =
+          new ::tensorflow::DataTypeVector({::tensorflow::DT_STRING});
+      return *dtypes;
+    }
+
+    const std::vector<::tensorflow::PartialTensorShape>& output_shapes()
+        const override {
+      static const std::vector<::tensorflow::PartialTensorShape>* const shapes =
+          new std::vector<::tensorflow::PartialTensorShape>({{}});
+      return *shapes;
+    }
+
+    std::string DebugString() const override {
+      return "RiegeliShuffleDatasetOp::Dataset";
+    }
+
+    ::tensorflow::Status CheckExternalState() const override {
+      return ::tensorflow::Status::OK();
+    }
+
+    ::tensorflow::Status InputDatasets(
+        std::vector<const ::tensorflow::data::DatasetBase*>* inputs)
+        const override {
+      inputs->clear();
+      return ::tensorflow::Status::OK();
+    }
+
+   protected:
+    ::tensorflow::Status AsGraphDefInternal(
+        ::tensorflow::data::SerializationContext* ctx,
+        DatasetGraphDefBuilder* b, ::tensorflow::Node** output) const override {
+      ::tensorflow::Node* filenames = nullptr;
+      TF_RETURN_IF_ERROR(b->AddVector(filenames_, &filenames));
+      ::tensorflow::Node* buffer_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
+      ::tensorflow::Node* range_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(range_size_, &range_size));
+      ::tensorflow::Node* window_size = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(window_size_, &window_size));
+      ::tensorflow::Node* num_parallel_reads = nullptr;
+      TF_RETURN_IF_ERROR(
+          b->AddScalar(num_parallel_reads_, &num_parallel_reads));
+      ::tensorflow::Node* seed = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(seed_, &seed));
+      TF_RETURN_IF_ERROR(b->AddDataset(this,
+                                       {filenames, buffer_size, range_size,
+                                        window_size, num_parallel_reads, seed},
+                                       output));
+      return ::tensorflow::Status::OK();
+    }
+
+   private:
+    // Each file is split into ranges of about `range_size_` bytes by
+    // `SplitRecords()`, which reads only a few block and chunk headers per
+    // range. Ranges of all files are visited in a random permutation, and up
+    // to `num_parallel_reads_` next ranges are read in tasks on the thread
+    // pool shared by all parallel operations of Riegeli.
+    //
+    // Records of ranges, in the order of the permutation, are added to a
+    // window of `window_size_` records, from which a random record is
+    // returned. Memory is thus bounded by `window_size_` records and
+    // `num_parallel_reads_` ranges, while records from anywhere in the files
+    // can be adjacent.
+    //
+    // The order depends only on `seed_`.
+    class Iterator : public ::tensorflow::data::DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params) {}
+
+      ~Iterator() override ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        AwaitReads();
+      }
+
+      ::tensorflow::Status GetNextInternal(
+          ::tensorflow::data::IteratorContext* ctx,
+          std::vector<::tensorflow::Tensor>* out_tensors,
+          bool* end_of_sequence) override ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        if (ranges_ == absl::nullopt) TF_RETURN_IF_ERROR(Plan(ctx->env()));
+        // Fill the window.
+        const size_t window_size = IntCast<size_t>(dataset()->window_size_);
+        while (window_.size() < window_size) {
+          ScheduleReads(ctx->env());
+          if (reads_.empty()) break;
+          RangeRead& read = *reads_.front();
+          mu_.Await(absl::Condition(&read.done));
+          if (read.offset >= read.items.size()) {
+            reads_.pop_front();
+            ++next_range_;
+            continue;
+          }
+          Item& item = read.items[read.offset++];
+          if (!item.status.ok()) {
+            // A range has invalid contents or failed to be read: return an
+            // error. Further iteration will continue after that.
+            *end_of_sequence = false;
+            return ToTfStatus(item.status);
+          }
+          window_.push_back(std::move(item.value));
+        }
+        // Iteration ends when the window is empty after reading all ranges.
+        if (window_.empty()) {
+          *end_of_sequence = true;
+          return ::tensorflow::Status::OK();
+        }
+        const size_t index = IntCast<size_t>(random_() % window_.size());
+        ++num_random_draws_;
+        ::tensorflow::Tensor result_tensor(::tensorflow::cpu_allocator(),
+                                           ::tensorflow::DT_STRING, {});
+        result_tensor.scalar<::tensorflow::tstring>()() =
+            std::move(window_[index]);
+        if (index != window_.size() - 1) {
+          window_[index] = std::move(window_.back());
+        }
+        window_.pop_back();
+        out_tensors->push_back(std::move(result_tensor));
+        *end_of_sequence = false;
+        return ::tensorflow::Status::OK();
+      }
+
+     protected:
+      ::tensorflow::Status SaveInternal(
+          ::tensorflow::data::SerializationContext* ctx,
+          ::tensorflow::data::IteratorStateWriter* writer) override
+          ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        if (ranges_ == absl::nullopt) return ::tensorflow::Status::OK();
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name("next_range"),
+                                               IntCast<int64_t>(next_range_)));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name("range_offset"),
+            IntCast<int64_t>(reads_.empty() ? 0 : reads_.front()->offset)));
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name("num_random_draws"),
+                                IntCast<int64_t>(num_random_draws_)));
+        TF_RETURN_IF_ERROR(writer->WriteScalar(
+            full_name("window_size"), IntCast<int64_t>(window_.size())));
+        for (size_t index = 0; index < window_.size(); ++index) {
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name(absl::StrCat("window_", index)), window_[index]));
+        }
+        return ::tensorflow::Status::OK();
+      }
+
+      ::tensorflow::Status RestoreInternal(
+          ::tensorflow::data::IteratorContext* ctx,
+          ::tensorflow::data::IteratorStateReader* reader) override
+          ABSL_LOCKS_EXCLUDED(mu_) {
+        absl::MutexLock l(&mu_);
+        AwaitReads();
+        ranges_ = absl::nullopt;
+        reads_.clear();
+        next_range_ = 0;
+        window_.clear();
+        num_random_draws_ = 0;
+        if (!reader->Contains(full_name("next_range"))) {
+          return ::tensorflow::Status::OK();
+        }
+        TF_RETURN_IF_ERROR(Plan(ctx->env()));
+
+        int64_t next_range;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name("next_range"), &next_range));
+        if (TF_PREDICT_FALSE(next_range < 0 ||
+                             IntCast<::tensorflow::uint64>(next_range) >
+                                 ranges_->size())) {
+          return ::tensorflow::errors::Internal("next_range out of range");
+        }
+        int64_t range_offset;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name("range_offset"), &range_offset));
+        if (TF_PREDICT_FALSE(range_offset < 0)) {
+          return ::tensorflow::errors::Internal("range_offset out of range");
+        }
+        int64_t num_random_draws;
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("num_random_draws"),
+                                              &num_random_draws));
+        if (TF_PREDICT_FALSE(num_random_draws < 0)) {
+          return ::tensorflow::errors::Internal(
+              "num_random_draws out of range");
+        }
+        int64_t window_size;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name("window_size"), &window_size));
+        if (TF_PREDICT_FALSE(window_size < 0 ||
+                             window_size > dataset()->window_size_)) {
+          return ::tensorflow::errors::Internal("window_size out of range");
+        }
+        window_.resize(IntCast<size_t>(window_size));
+        for (size_t index = 0; index < window_.size(); ++index) {
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name(absl::StrCat("window_", index)), &window_[index]));
+        }
+
+        next_range_ = IntCast<size_t>(next_range);
+        random_.discard(IntCast<unsigned long long>(num_random_draws));
+        num_random_draws_ = IntCast<uint64_t>(num_random_draws);
+        ScheduleReads(ctx->env());
+        if (!reads_.empty()) {
+          // Records of the range before `range_offset` are already in the
+          // window or were returned.
+          reads_.front()->offset = IntCast<size_t>(range_offset);
+        }
+        return ::tensorflow::Status::OK();
+      }
+
+     private:
+      // A range of records of a file.
+      struct Range {
+        size_t file_index;
+        RecordRange records;
+      };
+
+      // A record, or a failure to be returned in its place.
+      struct Item {
+        // The record if `status.ok()`.
+        ::tensorflow::tstring value;
+        absl::Status status;
+      };
+
+      // A range being read by a task, or read already.
+      struct RangeRead {
+        // Whether the task finished. Before that, `items` are accessed only by
+        // the task, without holding `mu_`.
+        bool done = false;
+        std::vector<Item> items;
+        // The number of `items` added to the window, or returned before a
+        // checkpoint was saved.
+        size_t offset = 0;
+      };
+
+      // Splits files into ranges, and permutes the ranges.
+      ::tensorflow::Status Plan(::tensorflow::Env* env)
+          ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        const std::vector<std::string>& filenames = dataset()->filenames_;
+        std::vector<std::vector<RecordRange>> file_splits(filenames.size());
+        std::vector<absl::Status> file_statuses(filenames.size());
+        {
+          // Splitting reads a few headers per range, which has latency
+          // dominated by the file system, hence files are split in parallel,
+          // by up to `dataset()->num_parallel_reads_` threads blocking on I/O
+          // outside of the pool used for decoding.
+          const size_t num_threads = UnsignedMin(
+              filenames.size(),
+              IntCast<size_t>(dataset()->num_parallel_reads_));
+          std::atomic<size_t> next_index(0);
+          absl::BlockingCounter pending(IntCast<int>(num_threads));
+          for (size_t i = 0; i < num_threads; ++i) {
+            internal::ThreadPool::global().ScheduleBlocking([&, env] {
+              for (size_t index = next_index.fetch_add(1);
+                   index < filenames.size(); index = next_index.fetch_add(1)) {
+                file_statuses[index] =
+                    SplitFile(filenames[index], env, file_splits[index]);
+              }
+              pending.DecrementCount();
+            });
+          }
+          pending.Wait();
+        }
+        std::vector<Range> ranges;
+        for (size_t index = 0; index < filenames.size(); ++index) {
+          if (TF_PREDICT_FALSE(!file_statuses[index].ok())) {
+            return ToTfStatus(file_statuses[index]);
+          }
+          for (const RecordRange& split : file_splits[index]) {
+            if (split.begin < split.end) ranges.push_back(Range{index, split});
+          }
+        }
+        // Fisher-Yates shuffle, not `std::shuffle()`, so that the order does
+        // not depend on the standard library implementation.
+        std::mt19937_64 random(static_cast<uint64_t>(dataset()->seed_));
+        for (size_t index = ranges.size(); index > 1; --index) {
+          std::swap(ranges[index - 1],
+                    ranges[IntCast<size_t>(random() % index)]);
+        }
+        ranges_ = std::move(ranges);
+        // The window uses a generator independent from the permutation.
+        random_.seed(static_cast<uint64_t>(dataset()->seed_) ^
+                     uint64_t{0x9e3779b97f4a7c15});
+        num_random_draws_ = 0;
+        return ::tensorflow::Status::OK();
+      }
+
+      absl::Status SplitFile(const std::string& filename,
+                             ::tensorflow::Env* env,
+                             std::vector<RecordRange>& splits) const {
+        DefaultChunkReader<tensorflow::FileReader<>> chunk_reader(
+            std::forward_as_tuple(
+                filename,
+                tensorflow::FileReaderBase::Options()
+                    .set_env(env)
+                    .set_buffer_size(
+                        IntCast<size_t>(dataset()->buffer_size_))));
+        const absl::optional<Position> size = chunk_reader.Size();
+        if (TF_PREDICT_FALSE(size == absl::nullopt)) {
+          return chunk_reader.status();
+        }
+        const Position range_size = IntCast<Position>(dataset()->range_size_);
+        const Position num_splits =
+            UnsignedMax(*size / range_size + (*size % range_size != 0 ? 1 : 0),
+                        Position{1});
+        if (TF_PREDICT_FALSE(!SplitRecords(
+                chunk_reader, SaturatingIntCast<size_t>(num_splits), splits))) {
+          return chunk_reader.status();
+        }
+        if (TF_PREDICT_FALSE(!chunk_reader.Close())) {
+          return chunk_reader.status();
+        }
+        return absl::OkStatus();
+      }
+
+      // Schedules reading ranges following `next_range_`, up to
+      // `dataset()->num_parallel_reads_` at a time.
+      void ScheduleReads(::tensorflow::Env* env)
+          ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        while (reads_.size() <
+                   IntCast<size_t>(dataset()->num_parallel_reads_) &&
+               next_range_ + reads_.size() < ranges_->size()) {
+          const Range& range = (*ranges_)[next_range_ + reads_.size()];
+          const std::shared_ptr<RangeRead> read =
+              std::make_shared<RangeRead>();
+          reads_.push_back(read);
+          ++num_reads_;
+          // Reading blocks on I/O, hence it does not use the pool used for
+          // decoding.
+          internal::ThreadPool::global().ScheduleBlocking(
+              [this, range, read, env] {
+                ReadRange(range, env, *read);
+                absl::MutexLock l(&mu_);
+                read->done = true;
+                --num_reads_;
+              });
+        }
+      }
+
+      void ReadRange(const Range& range, ::tensorflow::Env* env,
+                     RangeRead& read) const ABSL_LOCKS_EXCLUDED(mu_) {
+        RecordReader<tensorflow::FileReader<>> reader(std::forward_as_tuple(
+            dataset()->filenames_[range.file_index],
+            tensorflow::FileReaderBase::Options()
+                .set_env(env)
+                .set_buffer_size(IntCast<size_t>(dataset()->buffer_size_))));
+        reader.Seek(range.records.begin);
+        // Any errors from seeking will be reported during reading.
+        absl::string_view value;
+        while (reader.pos() < range.records.end) {
+          if (TF_PREDICT_TRUE(reader.ReadRecord(value))) {
+            read.items.push_back(Item{
+                ::tensorflow::tstring(value.data(), value.size()),
+                absl::OkStatus()});
+            continue;
+          }
+          SkippedRegion skipped_region;
+          if (reader.Recover(&skipped_region)) {
+            read.items.push_back(
+                Item{::tensorflow::tstring(),
+                     absl::InvalidArgumentError(absl::StrCat(
+                         "Skipping invalid region of a Riegeli/records file: ",
+                         skipped_region.ToString()))});
+            continue;
+          }
+          break;
+        }
+        if (TF_PREDICT_FALSE(!reader.Close())) {
+          read.items.push_back(
+              Item{::tensorflow::tstring(), reader.status()});
+        }
+      }
+
+      // Waits until no range reads are running.
+      void AwaitReads() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        mu_.Await(absl::Condition(
+            +[](size_t* num_reads) { return *num_reads == 0; }, &num_reads_));
+      }
+
+      // Invariants:
+      //   if `ranges_ != absl::nullopt` then
+      //       `next_range_ + reads_.size() <= ranges_->size()`
+      //   `window_.size() <= dataset()->window_size_`
+
+      absl::Mutex mu_;
+      // Ranges of all files, in the order of reading. `absl::nullopt` means not
+      // planned yet.
+      absl::optional<std::vector<Range>> ranges_ ABSL_GUARDED_BY(mu_);
+      // The index in `*ranges_` of the range which is added to the window.
+      size_t next_range_ ABSL_GUARDED_BY(mu_) = 0;
+      // Reads of `(*ranges_)[next_range_]` and following ranges.
+      std::deque<std::shared_ptr<RangeRead>> reads_ ABSL_GUARDED_BY(mu_);
+      // The number of range reads scheduled and not finished.
+      size_t num_reads_ ABSL_GUARDED_BY(mu_) = 0;
+      // Records to choose the next record from.
+      std::vector<::tensorflow::tstring> window_ ABSL_GUARDED_BY(mu_);
+      // Chooses records from `window_`. `num_random_draws_` allows to restore
+      // its state.
+      std::mt19937_64 random_ ABSL_GUARDED_BY(mu_);
+      uint64_t num_random_draws_ ABSL_GUARDED_BY(mu_) = 0;
+    };
+
+    const std::vector<std::string> filenames_;
+    const int64_t buffer_size_;
+    const int64_t range_size_;
+    const int64_t window_size_;
+    const int64_t num_parallel_reads_;
+    const int64_t seed_;
+  };
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("RiegeliShuffleDataset").Device(::tensorflow::DEVICE_CPU),
+    RiegeliShuffleDatasetOp);
+
+}  // namespace
+}  // namespace tensorflow
+}  // namespace riegeli
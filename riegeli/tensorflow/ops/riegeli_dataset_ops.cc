@@ -22,6 +22,9 @@ namespace tensorflow {
 REGISTER_OP("RiegeliDataset")
     .Input("filenames: string")
     .Input("buffer_size: int64")
+    .Attr("field_projection: list(string) = []")
+    .Attr("parallelism: int >= 0 = 0")
+    .Attr("max_decoded_bytes: int = -1")
     .Output("handle: variant")
     .SetIsStateful()
     .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
@@ -38,6 +41,174 @@ Creates a dataset that emits the records from one or more Riegeli/records files.
 filenames: A scalar or vector containing the name(s) of the file(s) to be
   read.
 buffer_size: Tunes how much data is buffered after reading from the file.
+field_projection: If not empty, the set of fields to be included in returned
+  records, allowing to exclude the remaining fields (but does not guarantee
+  that they will be excluded). Projection is effective if the file has been
+  written with "transpose" in RecordWriter options. A field path consists of
+  proto field numbers separated by ".", descending from the root message. A
+  field number 0 includes only the existence of the field.
+parallelism: If positive, the maximum number of chunks of each file read ahead
+  and decoded in parallel in background.
+max_decoded_bytes: If non-negative and `parallelism` is positive, the maximum
+  total decoded size of chunks read ahead and not emitted yet. Reading ahead
+  waits for records to be emitted rather than exceeding it, which bounds memory
+  usage when the consumer is slower than decoding. At least one chunk is read
+  ahead even if it is larger.
+)doc");
+
+REGISTER_OP("RiegeliBatchDataset")
+    .Input("filenames: string")
+    .Input("buffer_size: int64")
+    .Input("batch_size: int64")
+    .Attr("field_projection: list(string) = []")
+    .Attr("parallelism: int >= 0 = 0")
+    .Attr("max_decoded_bytes: int = -1")
+    .Output("handle: variant")
+    .SetIsStateful()
+    .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
+      ::tensorflow::shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // `buffer_size` could only be a scalar.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      // `batch_size` could only be a scalar.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      return ::tensorflow::shape_inference::ScalarShape(c);
+    })
+    .Doc(R"doc(
+Creates a dataset that emits batches of records from one or more
+Riegeli/records files, as vectors of strings.
+
+This is equivalent to batching the records of `RiegeliDataset`, except that a
+batch does not span files: the last batch of each file can be smaller. Reading
+a batch in one call avoids per-record overhead of the dataset iterator.
+
+filenames: A scalar or vector containing the name(s) of the file(s) to be
+  read.
+buffer_size: Tunes how much data is buffered after reading from the file.
+batch_size: The maximum number of records in a batch.
+field_projection: If not empty, the set of fields to be included in returned
+  records, allowing to exclude the remaining fields (but does not guarantee
+  that they will be excluded). Projection is effective if the file has been
+  written with "transpose" in RecordWriter options. A field path consists of
+  proto field numbers separated by ".", descending from the root message. A
+  field number 0 includes only the existence of the field.
+parallelism: If positive, the maximum number of chunks of each file read ahead
+  and decoded in parallel in background.
+max_decoded_bytes: If non-negative and `parallelism` is positive, the maximum
+  total decoded size of chunks read ahead and not emitted yet. Reading ahead
+  waits for records to be emitted rather than exceeding it, which bounds memory
+  usage when the consumer is slower than decoding. At least one chunk is read
+  ahead even if it is larger.
+)doc");
+
+REGISTER_OP("RiegeliParallelDataset")
+    .Input("filenames: string")
+    .Input("buffer_size: int64")
+    .Input("cycle_length: int64")
+    .Input("prefetch_size: int64")
+    .Input("deterministic: bool")
+    .Output("handle: variant")
+    .SetIsStateful()
+    .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
+      ::tensorflow::shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // `buffer_size`, `cycle_length`, `prefetch_size`, and `deterministic`
+      // could only be scalars.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+      return ::tensorflow::shape_inference::ScalarShape(c);
+    })
+    .Doc(R"doc(
+Creates a dataset that emits the records from Riegeli/records files, reading
+several files in parallel.
+
+Up to `cycle_length` files are open at a time. Each one is read ahead in the
+background by up to `prefetch_size` records. When a file ends, the next file
+takes its place.
+
+If `deterministic`, records are interleaved like by
+`Dataset.interleave(RiegeliDataset, cycle_length, block_length=1)`. Otherwise
+the next available record is emitted, which avoids waiting for a slow file.
+
+filenames: A scalar or vector containing the name(s) of the file(s) to be
+  read.
+buffer_size: Tunes how much data is buffered after reading from the file.
+cycle_length: The number of files read concurrently.
+prefetch_size: The maximum number of records read ahead from each file.
+deterministic: Whether records are emitted in a deterministic order.
+)doc");
+
+REGISTER_OP("RiegeliShuffleDataset")
+    .Input("filenames: string")
+    .Input("buffer_size: int64")
+    .Input("range_size: int64")
+    .Input("window_size: int64")
+    .Input("num_parallel_reads: int64")
+    .Input("seed: int64")
+    .Output("handle: variant")
+    .SetIsStateful()
+    .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
+      ::tensorflow::shape_inference::ShapeHandle unused;
+      // `filenames` must be a scalar or a vector.
+      TF_RETURN_IF_ERROR(c->WithRankAtMost(c->input(0), 1, &unused));
+      // Other inputs could only be scalars.
+      for (int i = 1; i < 6; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      return ::tensorflow::shape_inference::ScalarShape(c);
+    })
+    .Doc(R"doc(
+Creates a dataset that emits the records from Riegeli/records files in an
+approximately random order, without buffering the whole dataset.
+
+Files are split into ranges of about `range_size` bytes at chunk boundaries,
+which reads only a few headers per range. Ranges of all files are read in a
+random permutation, up to `num_parallel_reads` at a time, and their records
+are shuffled within a window of `window_size` records.
+
+The result is closer to a global shuffle when ranges are small relative to
+the window, at the cost of more seeks. The order depends only on `seed`.
+
+filenames: A scalar or vector containing the name(s) of the file(s) to be
+  read.
+buffer_size: Tunes how much data is buffered after reading from the file.
+range_size: The approximate size of a range in bytes.
+window_size: The number of records to choose the next record from.
+num_parallel_reads: The number of ranges read ahead concurrently.
+seed: The seed of the random order.
+)doc");
+
+REGISTER_OP("WriteRiegeliDataset")
+    .Input("input_dataset: variant")
+    .Input("filename: string")
+    .Input("options: string")
+    .Input("num_shards: int64")
+    .SetIsStateful()
+    .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
+      ::tensorflow::shape_inference::ShapeHandle unused;
+      // All inputs could only be scalars.
+      for (int i = 0; i < 4; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      return ::tensorflow::Status::OK();
+    })
+    .Doc(R"doc(
+Writes the records of a dataset of scalar strings to Riegeli/records files.
+
+Records are written in C++ as they are produced by the dataset. If
+`num_shards > 1`, they are distributed in turn among `num_shards` files named
+`filename-SSSSS-of-NNNNN`, each written by its own `RecordWriter`.
+
+input_dataset: A dataset of scalar strings.
+filename: The name of the file to be written, or the prefix of shard names.
+options: RecordWriter options in the text format, e.g.
+  "transpose,parallelism:4". Parallelism makes each shard encode chunks in
+  the background while the next records are taken from the dataset.
+num_shards: The number of files to write.
 )doc");
 
 }  // namespace tensorflow
@@ -0,0 +1,127 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "benchmark/benchmark.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+namespace {
+
+constexpr size_t kNumValues = 4096;
+
+// Returns `kNumValues` pseudo-random values below `2^bits`.
+std::vector<uint64_t> SampleValues(int bits) {
+  std::mt19937_64 random(bits);
+  std::vector<uint64_t> values(kNumValues);
+  for (uint64_t& value : values) {
+    value = bits >= 64 ? random() : random() & ((uint64_t{1} << bits) - 1);
+  }
+  return values;
+}
+
+// Benchmarks values of several bit widths.
+void BitWidths(benchmark::internal::Benchmark* benchmark) {
+  for (const int bits : {7, 14, 28, 56, 64}) benchmark->Arg(bits);
+}
+
+std::string Encode(const std::vector<uint64_t>& values) {
+  std::string encoded;
+  StringWriter<> writer(&encoded);
+  for (const uint64_t value : values) WriteVarint64(value, writer);
+  writer.Close();
+  return encoded;
+}
+
+// Writes values below `2^state.range(0)` to a flat array.
+void BM_WriteVarint64ToArray(benchmark::State& state) {
+  const std::vector<uint64_t> values =
+      SampleValues(static_cast<int>(state.range(0)));
+  std::vector<char> buffer(kNumValues * kMaxLengthVarint64);
+  for (auto _ : state) {
+    char* cursor = buffer.data();
+    for (const uint64_t value : values) {
+      cursor = WriteVarint64(value, cursor);
+    }
+    benchmark::DoNotOptimize(cursor);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kNumValues));
+}
+BENCHMARK(BM_WriteVarint64ToArray)->Apply(BitWidths);
+
+// Writes values below `2^state.range(0)` to a `StringWriter`.
+void BM_WriteVarint64ToWriter(benchmark::State& state) {
+  const std::vector<uint64_t> values =
+      SampleValues(static_cast<int>(state.range(0)));
+  std::string encoded;
+  for (auto _ : state) {
+    encoded.clear();
+    StringWriter<> writer(&encoded);
+    for (const uint64_t value : values) WriteVarint64(value, writer);
+    writer.Close();
+    benchmark::DoNotOptimize(encoded.data());
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kNumValues));
+}
+BENCHMARK(BM_WriteVarint64ToWriter)->Apply(BitWidths);
+
+// Reads values below `2^state.range(0)` from a flat array.
+void BM_ReadVarint64FromArray(benchmark::State& state) {
+  const std::string encoded =
+      Encode(SampleValues(static_cast<int>(state.range(0))));
+  for (auto _ : state) {
+    const char* cursor = encoded.data();
+    const char* const limit = encoded.data() + encoded.size();
+    uint64_t value;
+    while (cursor < limit) {
+      const absl::optional<const char*> next =
+          ReadVarint64(cursor, limit, value);
+      if (next == absl::nullopt) break;
+      benchmark::DoNotOptimize(value);
+      cursor = *next;
+    }
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kNumValues));
+}
+BENCHMARK(BM_ReadVarint64FromArray)->Apply(BitWidths);
+
+// Reads values below `2^state.range(0)` from a `StringReader`.
+void BM_ReadVarint64FromReader(benchmark::State& state) {
+  const std::string encoded =
+      Encode(SampleValues(static_cast<int>(state.range(0))));
+  for (auto _ : state) {
+    StringReader<> reader(encoded);
+    uint64_t value;
+    while (ReadVarint64(reader, value)) benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(kNumValues));
+}
+BENCHMARK(BM_ReadVarint64FromReader)->Apply(BitWidths);
+
+}  // namespace
+}  // namespace riegeli
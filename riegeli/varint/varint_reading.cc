@@ -17,11 +17,145 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
+
 #include "absl/base/optimization.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
 
 namespace riegeli {
+
+namespace {
+
+// Returns the number of leading bytes without the continuation bit, given
+// continuation bits of 8 bytes read as a little endian number.
+inline size_t NumShortVarints(uint64_t high_bits) {
+#if RIEGELI_INTERNAL_HAS_BUILTIN(__builtin_ctzll) || \
+    RIEGELI_INTERNAL_IS_GCC_VERSION(3, 4)
+  return IntCast<size_t>(__builtin_ctzll(high_bits)) / 8;
+#else
+  size_t length = 0;
+  while ((high_bits & 0x80) == 0) {
+    high_bits >>= 8;
+    ++length;
+  }
+  return length;
+#endif
+}
+
+// Reads single-byte varints 8 bytes at a time, as long as they continue and
+// both `src[]` and `dest[]` have room for 8 of them.
+template <typename T>
+inline void ReadShortVarints(const char*& src, const char* limit, T*& dest,
+                             T* dest_limit) {
+  while (PtrDistance(src, limit) >= 8 && PtrDistance(dest, dest_limit) >= 8) {
+    const uint64_t high_bits =
+        ReadLittleEndian64(src) & uint64_t{0x8080808080808080};
+    const size_t length = high_bits == 0 ? 8 : NumShortVarints(high_bits);
+    for (size_t i = 0; i < length; ++i) {
+      dest[i] = T{static_cast<uint8_t>(src[i])};
+    }
+    src += length;
+    dest += length;
+    if (length < 8) return;
+  }
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint32_t& dest) {
+  return ReadVarint32(src, limit, dest);
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint64_t& dest) {
+  return ReadVarint64(src, limit, dest);
+}
+
+inline bool ReadVarint(Reader& src, uint32_t& dest) {
+  return ReadVarint32(src, dest);
+}
+
+inline bool ReadVarint(Reader& src, uint64_t& dest) {
+  return ReadVarint64(src, dest);
+}
+
+template <typename T>
+inline absl::optional<const char*> ReadVarintsImpl(const char* src,
+                                                   const char* limit,
+                                                   absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_limit = dest_ptr + dest.size();
+  while (dest_ptr != dest_limit) {
+    ReadShortVarints(src, limit, dest_ptr, dest_limit);
+    if (dest_ptr == dest_limit) break;
+    const absl::optional<const char*> next = ReadVarint(src, limit, *dest_ptr);
+    if (ABSL_PREDICT_FALSE(next == absl::nullopt)) return absl::nullopt;
+    src = *next;
+    ++dest_ptr;
+  }
+  return src;
+}
+
+template <typename T, size_t max_length>
+inline bool ReadVarintsImpl(Reader& src, absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_limit = dest_ptr + dest.size();
+  while (dest_ptr != dest_limit) {
+    if (src.available() < max_length) {
+      src.Pull(max_length,
+               UnsignedMin(PtrDistance(dest_ptr, dest_limit),
+                           std::numeric_limits<size_t>::max() / max_length) *
+                   max_length);
+      if (src.available() < max_length) {
+        // Near the end of the source.
+        if (ABSL_PREDICT_FALSE(!ReadVarint(src, *dest_ptr))) return false;
+        ++dest_ptr;
+        continue;
+      }
+    }
+    // A varint which begins before `safe_limit` ends before `src.limit()`
+    // unless it is invalid.
+    const char* cursor = src.cursor();
+    const char* const safe_limit = src.limit() - (max_length - 1);
+    do {
+      ReadShortVarints(cursor, src.limit(), dest_ptr, dest_limit);
+      if (dest_ptr == dest_limit || cursor >= safe_limit) break;
+      const absl::optional<const char*> next =
+          ReadVarint(cursor, src.limit(), *dest_ptr);
+      if (ABSL_PREDICT_FALSE(next == absl::nullopt)) return false;
+      cursor = *next;
+      ++dest_ptr;
+    } while (dest_ptr != dest_limit && cursor < safe_limit);
+    src.set_cursor(cursor);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadVarints32(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadVarintsImpl<uint32_t, kMaxLengthVarint32>(src, dest);
+}
+
+bool ReadVarints64(Reader& src, absl::Span<uint64_t> dest) {
+  return ReadVarintsImpl<uint64_t, kMaxLengthVarint64>(src, dest);
+}
+
+absl::optional<const char*> ReadVarints32(const char* src, const char* limit,
+                                          absl::Span<uint32_t> dest) {
+  return ReadVarintsImpl(src, limit, dest);
+}
+
+absl::optional<const char*> ReadVarints64(const char* src, const char* limit,
+                                          absl::Span<uint64_t> dest) {
+  return ReadVarintsImpl(src, limit, dest);
+}
+
 namespace internal {
 
 absl::optional<const char*> ReadVarint32Slow(const char* src, const char* limit,
@@ -22,6 +22,7 @@
 
 #include "absl/base/optimization.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/varint/varint_internal.h"
 
@@ -98,6 +99,35 @@ absl::optional<const char*> ReadVarint32(const char* src, const char* limit,
 absl::optional<const char*> ReadVarint64(const char* src, const char* limit,
                                          uint64_t& dest);
 
+// Reads an array of varints.
+//
+// This is faster than reading them individually, especially if many of them
+// are short.
+//
+// Return values:
+//  * `true`                          - success (`dest[]` is filled)
+//  * `false` (when `src.healthy()`)  - source ends too early
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+bool ReadVarints32(Reader& src, absl::Span<uint32_t> dest);
+bool ReadVarints64(Reader& src, absl::Span<uint64_t> dest);
+
+// Reads an array of varints from an array.
+//
+// This is faster than reading them individually, especially if many of them
+// are short.
+//
+// Return values:
+//  * updated `src`   - success (`dest[]` is filled)
+//  * `absl::nullopt` - source ends (`dest[]` is undefined)
+absl::optional<const char*> ReadVarints32(const char* src, const char* limit,
+                                          absl::Span<uint32_t> dest);
+absl::optional<const char*> ReadVarints64(const char* src, const char* limit,
+                                          absl::Span<uint64_t> dest);
+
 // Copies a varint to an array.
 //
 // Writes up to `kMaxLengthVarint{32,64}` bytes to `dest[]`.
@@ -18,7 +18,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
+
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/port.h"
 #include "riegeli/bytes/backward_writer.h"
@@ -37,6 +40,22 @@ bool WriteVarint64(uint64_t data, Writer& dest);
 bool WriteVarint32(uint32_t data, BackwardWriter& dest);
 bool WriteVarint64(uint64_t data, BackwardWriter& dest);
 
+// Writes an array of varints.
+//
+// This is faster than writing them individually, because space is requested
+// from `dest` for many varints at once.
+//
+// For `BackwardWriter`, the varints are written so that they are read in the
+// order of `data[]`.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteVarints32(absl::Span<const uint32_t> data, Writer& dest);
+bool WriteVarints64(absl::Span<const uint64_t> data, Writer& dest);
+bool WriteVarints32(absl::Span<const uint32_t> data, BackwardWriter& dest);
+bool WriteVarints64(absl::Span<const uint64_t> data, BackwardWriter& dest);
+
 // Returns the length needed to write a given value as a varint, which is at
 // most `kMaxLengthVarint{32,64}`.
 size_t LengthVarint32(uint32_t data);
@@ -90,6 +109,93 @@ inline bool WriteVarint64(uint64_t data, BackwardWriter& dest) {
   return true;
 }
 
+namespace internal {
+
+inline size_t LengthVarint(uint32_t data) { return LengthVarint32(data); }
+inline size_t LengthVarint(uint64_t data) { return LengthVarint64(data); }
+
+inline char* WriteVarint(uint32_t data, char* dest) {
+  return WriteVarint32(data, dest);
+}
+inline char* WriteVarint(uint64_t data, char* dest) {
+  return WriteVarint64(data, dest);
+}
+
+template <size_t max_length>
+inline size_t RecommendedLengthVarints(size_t num_values) {
+  return UnsignedMin(num_values,
+                     std::numeric_limits<size_t>::max() / max_length) *
+         max_length;
+}
+
+template <typename T, size_t max_length>
+inline bool WriteVarints(absl::Span<const T> data, Writer& dest) {
+  const T* iter = data.data();
+  const T* const end = iter + data.size();
+  while (iter != end) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            max_length,
+            RecommendedLengthVarints<max_length>(PtrDistance(iter, end))))) {
+      return false;
+    }
+    // Write as many varints as certainly fit in the buffer.
+    char* cursor = dest.cursor();
+    const char* const safe_limit = dest.limit() - (max_length - 1);
+    do {
+      cursor = WriteVarint(*iter++, cursor);
+    } while (iter != end && cursor < safe_limit);
+    dest.set_cursor(cursor);
+  }
+  return true;
+}
+
+template <typename T, size_t max_length>
+inline bool WriteVarints(absl::Span<const T> data, BackwardWriter& dest) {
+  // Varints are written in batches from the end of `data[]`.
+  while (!data.empty()) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            max_length, RecommendedLengthVarints<max_length>(data.size())))) {
+      return false;
+    }
+    size_t length = 0;
+    size_t num_values = 0;
+    while (num_values < data.size()) {
+      const size_t value_length =
+          LengthVarint(data[data.size() - 1 - num_values]);
+      if (length + value_length > dest.available()) break;
+      length += value_length;
+      ++num_values;
+    }
+    dest.move_cursor(length);
+    char* cursor = dest.cursor();
+    for (const T value : data.subspan(data.size() - num_values)) {
+      cursor = WriteVarint(value, cursor);
+    }
+    data.remove_suffix(num_values);
+  }
+  return true;
+}
+
+}  // namespace internal
+
+inline bool WriteVarints32(absl::Span<const uint32_t> data, Writer& dest) {
+  return internal::WriteVarints<uint32_t, kMaxLengthVarint32>(data, dest);
+}
+
+inline bool WriteVarints64(absl::Span<const uint64_t> data, Writer& dest) {
+  return internal::WriteVarints<uint64_t, kMaxLengthVarint64>(data, dest);
+}
+
+inline bool WriteVarints32(absl::Span<const uint32_t> data,
+                           BackwardWriter& dest) {
+  return internal::WriteVarints<uint32_t, kMaxLengthVarint32>(data, dest);
+}
+
+inline bool WriteVarints64(absl::Span<const uint64_t> data,
+                           BackwardWriter& dest) {
+  return internal::WriteVarints<uint64_t, kMaxLengthVarint64>(data, dest);
+}
+
 inline size_t LengthVarint32(uint32_t data) {
 #if RIEGELI_INTERNAL_HAS_BUILTIN(__builtin_clz) || \
     RIEGELI_INTERNAL_IS_GCC_VERSION(3, 4)
@@ -0,0 +1,46 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZLIB_PARALLEL_GZIP_INTERNAL_H_
+#define RIEGELI_ZLIB_PARALLEL_GZIP_INTERNAL_H_
+
+#include <stddef.h>
+
+namespace riegeli {
+namespace internal {
+
+// Each member written by `ParallelGzipWriter` has a fixed size header:
+//
+//  * ID1, ID2, CM, FLG (`FEXTRA`), MTIME (4 bytes), XFL, OS
+//  * XLEN (2 bytes, little endian)
+//  * the extra subfield: SI1, SI2, LEN (2 bytes, little endian), and the size
+//    of the whole member as 4 bytes little endian
+//
+// followed by raw deflate data and the standard trailer: CRC32 and ISIZE
+// (4 bytes little endian each).
+//
+// The member size lets `ParallelGzipReader` find member boundaries without
+// decompressing.
+constexpr char kGzipMemberHeaderPrefix[] = {
+    '\x1f', '\x8b', '\x08', '\x04', '\x00', '\x00', '\x00', '\x00',
+    '\x00', '\xff', '\x08', '\x00', 'R',    'g',    '\x04', '\x00'};
+constexpr size_t kGzipMemberHeaderPrefixSize = sizeof(kGzipMemberHeaderPrefix);
+constexpr size_t kGzipMemberSizeOffset = kGzipMemberHeaderPrefixSize;
+constexpr size_t kGzipMemberHeaderSize = kGzipMemberHeaderPrefixSize + 4;
+constexpr size_t kGzipMemberTrailerSize = 8;
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZLIB_PARALLEL_GZIP_INTERNAL_H_
@@ -0,0 +1,233 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/zlib/parallel_gzip_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+#include <future>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/buffer.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/pullable_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/zlib/parallel_gzip_internal.h"
+#include "riegeli/zlib/zlib_reader.h"
+
+namespace riegeli {
+
+namespace {
+
+size_t EffectiveParallelism(size_t parallelism) {
+  if (parallelism == 0) {
+    parallelism = std::thread::hardware_concurrency();
+    if (ABSL_PREDICT_FALSE(parallelism == 0)) parallelism = 1;
+  }
+  return parallelism;
+}
+
+}  // namespace
+
+ParallelGzipReaderBase::ParallelGzipReaderBase(const Options& options)
+    : parallelism_(EffectiveParallelism(options.parallelism())),
+      executor_(options.executor()) {}
+
+void ParallelGzipReaderBase::Reset(const Options& options) {
+  PullableReader::Reset();
+  parallelism_ = EffectiveParallelism(options.parallelism());
+  executor_ = options.executor();
+  src_exhausted_ = false;
+  members_.clear();
+  current_ = Buffer();
+}
+
+void ParallelGzipReaderBase::Initialize(Reader* src) {
+  RIEGELI_ASSERT(src != nullptr)
+      << "Failed precondition of ParallelGzipReader: null Reader pointer";
+  if (ABSL_PREDICT_FALSE(!src->healthy()) && src->available() == 0) {
+    FailWithoutAnnotation(AnnotateOverSrc(src->status()));
+  }
+}
+
+void ParallelGzipReaderBase::Done() {
+  PullableReader::Done();
+  // Pending members are abandoned. Their tasks still run to completion, but
+  // they do not refer to `*this`.
+  members_.clear();
+  current_ = Buffer();
+}
+
+absl::Status ParallelGzipReaderBase::AnnotateStatusImpl(absl::Status status) {
+  if (is_open()) {
+    Reader& src = *src_reader();
+    status = src.AnnotateStatus(std::move(status));
+  }
+  // The status might have been annotated by `*src->reader()` with the
+  // compressed position. Clarify that the current position is the uncompressed
+  // position instead of delegating to `PullableReader::AnnotateStatusImpl()`.
+  return AnnotateOverSrc(std::move(status));
+}
+
+absl::Status ParallelGzipReaderBase::AnnotateOverSrc(absl::Status status) {
+  if (is_open()) {
+    return Annotate(status, absl::StrCat("at uncompressed byte ", pos()));
+  }
+  return status;
+}
+
+bool ParallelGzipReaderBase::PullBehindScratch() {
+  RIEGELI_ASSERT_EQ(available(), 0u)
+      << "Failed precondition of PullableReader::PullBehindScratch(): "
+         "some data available, use Pull() instead";
+  RIEGELI_ASSERT(!scratch_used())
+      << "Failed precondition of PullableReader::PullBehindScratch(): "
+         "scratch used";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Reader& src = *src_reader();
+  set_buffer();
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!ScheduleMembers(src))) return false;
+    if (members_.empty()) return false;
+    Member member = members_.front().get();
+    members_.pop_front();
+    if (ABSL_PREDICT_FALSE(!member.status.ok())) {
+      return FailWithoutAnnotation(AnnotateOverSrc(std::move(member.status)));
+    }
+    if (member.size == 0) continue;
+    if (ABSL_PREDICT_FALSE(member.size > std::numeric_limits<Position>::max() -
+                                             limit_pos())) {
+      return FailOverflow();
+    }
+    // Keep the pipeline full while the current member is being read.
+    if (ABSL_PREDICT_FALSE(!ScheduleMembers(src))) return false;
+    current_ = std::move(member.data);
+    set_buffer(current_.data(), member.size);
+    move_limit_pos(member.size);
+    return true;
+  }
+}
+
+bool ParallelGzipReaderBase::ScheduleMembers(Reader& src) {
+  while (!src_exhausted_ && members_.size() < parallelism_) {
+    if (!src.Pull(internal::kGzipMemberHeaderSize)) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+      }
+      if (ABSL_PREDICT_FALSE(src.available() > 0)) {
+        return Fail(absl::InvalidArgumentError(
+            "Truncated gzip-compressed stream"));
+      }
+      src_exhausted_ = true;
+      break;
+    }
+    // MTIME, XFL, and OS are not checked.
+    constexpr size_t kMtimeOffset = 4;
+    constexpr size_t kExtraOffset = 10;
+    if (ABSL_PREDICT_FALSE(
+            std::memcmp(src.cursor(), internal::kGzipMemberHeaderPrefix,
+                        kMtimeOffset) != 0 ||
+            std::memcmp(src.cursor() + kExtraOffset,
+                        internal::kGzipMemberHeaderPrefix + kExtraOffset,
+                        internal::kGzipMemberHeaderPrefixSize -
+                            kExtraOffset) != 0)) {
+      return Fail(absl::InvalidArgumentError(
+          "Gzip member does not store its size, "
+          "it was not written by ParallelGzipWriter"));
+    }
+    const uint32_t member_size =
+        ReadLittleEndian32(src.cursor() + internal::kGzipMemberSizeOffset);
+    constexpr size_t kMinMemberSize =
+        internal::kGzipMemberHeaderSize + internal::kGzipMemberTrailerSize;
+    if (ABSL_PREDICT_FALSE(member_size < kMinMemberSize)) {
+      return Fail(absl::InvalidArgumentError(
+          absl::StrCat("Invalid gzip member size: ", member_size)));
+    }
+    Chain compressed;
+    if (ABSL_PREDICT_FALSE(
+            !src.Read(member_size - sizeof(uint32_t), compressed))) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+      }
+      return Fail(
+          absl::InvalidArgumentError("Truncated gzip-compressed stream"));
+    }
+    // The last 4 bytes of the member are ISIZE: the uncompressed size modulo
+    // 2^32, which is exact for members written by `ParallelGzipWriter`.
+    uint32_t size;
+    if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, size))) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+      }
+      return Fail(
+          absl::InvalidArgumentError("Truncated gzip-compressed stream"));
+    }
+    char isize[sizeof(uint32_t)];
+    WriteLittleEndian32(size, isize);
+    compressed.Append(absl::string_view(isize, sizeof(isize)));
+    std::promise<Member>* const member_promise = new std::promise<Member>();
+    members_.push_back(member_promise->get_future());
+    Executor& executor = executor_ == nullptr ? internal::ThreadPool::global()
+                                              : *executor_;
+    executor.Schedule([member_promise, compressed = std::move(compressed),
+                       size = IntCast<size_t>(size)] {
+      member_promise->set_value(DecompressMember(compressed, size));
+      delete member_promise;
+    });
+  }
+  return true;
+}
+
+ParallelGzipReaderBase::Member ParallelGzipReaderBase::DecompressMember(
+    const Chain& compressed, size_t size) {
+  Member member;
+  ZlibReader<ChainReader<>> decompressor(
+      std::forward_as_tuple(&compressed),
+      ZlibReaderBase::Options()
+          .set_header(ZlibReaderBase::Header::kGzip)
+          .set_size_hint(size));
+  member.data.Reset(size);
+  if (ABSL_PREDICT_FALSE(!decompressor.Read(size, member.data.data()))) {
+    member.status =
+        decompressor.healthy()
+            ? absl::InvalidArgumentError(
+                  "Gzip member is shorter than its stored size")
+            : decompressor.status();
+    return member;
+  }
+  decompressor.VerifyEnd();
+  if (ABSL_PREDICT_FALSE(!decompressor.Close())) {
+    member.status = decompressor.status();
+    return member;
+  }
+  member.size = size;
+  return member;
+}
+
+}  // namespace riegeli
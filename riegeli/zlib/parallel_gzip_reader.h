@@ -0,0 +1,338 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZLIB_PARALLEL_GZIP_READER_H_
+#define RIEGELI_ZLIB_PARALLEL_GZIP_READER_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <future>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/buffer.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/pullable_reader.h"
+#include "riegeli/bytes/reader.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `ParallelGzipReader`.
+class ParallelGzipReaderBase : public PullableReader {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Maximum number of members being decompressed at a time. Decompressed
+    // members are returned in order, so this also bounds the memory used for
+    // members decompressed ahead.
+    //
+    // Special value 0 means `std::thread::hardware_concurrency()`.
+    //
+    // Default: 0.
+    Options& set_parallelism(size_t parallelism) & {
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(size_t parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    size_t parallelism() const { return parallelism_; }
+
+    // The `Executor` running the decompression of members, or `nullptr` for the
+    // thread pool shared by all parallel operations of Riegeli.
+    //
+    // The `Executor` must outlive the `ParallelGzipReader`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+   private:
+    size_t parallelism_ = 0;
+    Executor* executor_ = nullptr;
+  };
+
+  // Returns the compressed `Reader`. Unchanged by `Close()`.
+  virtual Reader* src_reader() = 0;
+  virtual const Reader* src_reader() const = 0;
+
+ protected:
+  explicit ParallelGzipReaderBase(Closed) noexcept : PullableReader(kClosed) {}
+
+  explicit ParallelGzipReaderBase(const Options& options);
+
+  ParallelGzipReaderBase(ParallelGzipReaderBase&& that) noexcept;
+  ParallelGzipReaderBase& operator=(ParallelGzipReaderBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(const Options& options);
+  void Initialize(Reader* src);
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
+
+  void Done() override;
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
+      absl::Status status) override;
+  bool PullBehindScratch() override;
+
+ private:
+  struct Member {
+    absl::Status status;
+    Buffer data;
+    size_t size = 0;
+  };
+
+  // Decompresses a complete gzip member with the given uncompressed size.
+  static Member DecompressMember(const Chain& compressed, size_t size);
+
+  // Reads members from `src` and schedules their decompression, until
+  // `parallelism_` members are pending or the source ends.
+  bool ScheduleMembers(Reader& src);
+
+  size_t parallelism_ = 0;
+  Executor* executor_ = nullptr;
+  // If `true`, all members were read from the source.
+  bool src_exhausted_ = false;
+  // Members being decompressed or waiting to be read, in order.
+  std::deque<std::future<Member>> members_;
+  // Decompressed data of the current member.
+  Buffer current_;
+
+  // Invariant if `!scratch_used()`:
+  //   buffer pointers are either null or point into `current_`
+};
+
+// A `Reader` which decompresses data in the gzip format written by
+// `ParallelGzipWriter` after getting it from another `Reader`, decompressing
+// several members in parallel.
+//
+// The size of each member must be stored in its header as written by
+// `ParallelGzipWriter`. Other gzip streams, e.g. written by `ZlibWriter` or
+// standard gzip tools, are not supported; use `ZlibReader` with
+// `set_concatenate(true)` for them.
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the compressed `Reader`. `Src` must support
+// `Dependency<Reader*, Src>`, e.g. `Reader*` (not owned, default),
+// `std::unique_ptr<Reader>` (owned), `ChainReader<>` (owned).
+//
+// By relying on CTAD the template argument can be deduced as the value type of
+// the first constructor argument. This requires C++17.
+//
+// The compressed `Reader` must not be accessed until the `ParallelGzipReader`
+// is closed or no longer used.
+template <typename Src = Reader*>
+class ParallelGzipReader : public ParallelGzipReaderBase {
+ public:
+  // Creates a closed `ParallelGzipReader`.
+  explicit ParallelGzipReader(Closed) noexcept
+      : ParallelGzipReaderBase(kClosed) {}
+
+  // Will read from the compressed `Reader` provided by `src`.
+  explicit ParallelGzipReader(const Src& src, Options options = Options());
+  explicit ParallelGzipReader(Src&& src, Options options = Options());
+
+  // Will read from the compressed `Reader` provided by a `Src` constructed from
+  // elements of `src_args`. This avoids constructing a temporary `Src` and
+  // moving from it.
+  template <typename... SrcArgs>
+  explicit ParallelGzipReader(std::tuple<SrcArgs...> src_args,
+                              Options options = Options());
+
+  ParallelGzipReader(ParallelGzipReader&&) noexcept;
+  ParallelGzipReader& operator=(ParallelGzipReader&&) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `ParallelGzipReader`. This
+  // avoids constructing a temporary `ParallelGzipReader` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the compressed `Reader`.
+  // Unchanged by `Close()`.
+  Src& src() { return src_.manager(); }
+  const Src& src() const { return src_.manager(); }
+  Reader* src_reader() override { return src_.get(); }
+  const Reader* src_reader() const override { return src_.get(); }
+
+  void VerifyEnd() override;
+
+ protected:
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the compressed `Reader`.
+  Dependency<Reader*, Src> src_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit ParallelGzipReader(Closed)->ParallelGzipReader<DeleteCtad<Closed>>;
+template <typename Src>
+explicit ParallelGzipReader(const Src& src,
+                            ParallelGzipReaderBase::Options options =
+                                ParallelGzipReaderBase::Options())
+    -> ParallelGzipReader<std::decay_t<Src>>;
+template <typename Src>
+explicit ParallelGzipReader(Src&& src,
+                            ParallelGzipReaderBase::Options options =
+                                ParallelGzipReaderBase::Options())
+    -> ParallelGzipReader<std::decay_t<Src>>;
+template <typename... SrcArgs>
+explicit ParallelGzipReader(std::tuple<SrcArgs...> src_args,
+                            ParallelGzipReaderBase::Options options =
+                                ParallelGzipReaderBase::Options())
+    -> ParallelGzipReader<DeleteCtad<std::tuple<SrcArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline ParallelGzipReaderBase::ParallelGzipReaderBase(
+    ParallelGzipReaderBase&& that) noexcept
+    : PullableReader(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      parallelism_(that.parallelism_),
+      executor_(that.executor_),
+      src_exhausted_(that.src_exhausted_),
+      members_(std::move(that.members_)),
+      current_(std::move(that.current_)) {}
+
+inline ParallelGzipReaderBase& ParallelGzipReaderBase::operator=(
+    ParallelGzipReaderBase&& that) noexcept {
+  PullableReader::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  parallelism_ = that.parallelism_;
+  executor_ = that.executor_;
+  src_exhausted_ = that.src_exhausted_;
+  members_ = std::move(that.members_);
+  current_ = std::move(that.current_);
+  return *this;
+}
+
+inline void ParallelGzipReaderBase::Reset(Closed) {
+  PullableReader::Reset(kClosed);
+  parallelism_ = 0;
+  executor_ = nullptr;
+  src_exhausted_ = false;
+  members_.clear();
+  current_ = Buffer();
+}
+
+template <typename Src>
+inline ParallelGzipReader<Src>::ParallelGzipReader(const Src& src,
+                                                   Options options)
+    : ParallelGzipReaderBase(options), src_(src) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline ParallelGzipReader<Src>::ParallelGzipReader(Src&& src, Options options)
+    : ParallelGzipReaderBase(options), src_(std::move(src)) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline ParallelGzipReader<Src>::ParallelGzipReader(
+    std::tuple<SrcArgs...> src_args, Options options)
+    : ParallelGzipReaderBase(options), src_(std::move(src_args)) {
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline ParallelGzipReader<Src>::ParallelGzipReader(
+    ParallelGzipReader&& that) noexcept
+    : ParallelGzipReaderBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      src_(std::move(that.src_)) {}
+
+template <typename Src>
+inline ParallelGzipReader<Src>& ParallelGzipReader<Src>::operator=(
+    ParallelGzipReader&& that) noexcept {
+  ParallelGzipReaderBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  src_ = std::move(that.src_);
+  return *this;
+}
+
+template <typename Src>
+inline void ParallelGzipReader<Src>::Reset(Closed) {
+  ParallelGzipReaderBase::Reset(kClosed);
+  src_.Reset();
+}
+
+template <typename Src>
+inline void ParallelGzipReader<Src>::Reset(const Src& src, Options options) {
+  ParallelGzipReaderBase::Reset(options);
+  src_.Reset(src);
+  Initialize(src_.get());
+}
+
+template <typename Src>
+inline void ParallelGzipReader<Src>::Reset(Src&& src, Options options) {
+  ParallelGzipReaderBase::Reset(options);
+  src_.Reset(std::move(src));
+  Initialize(src_.get());
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void ParallelGzipReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                           Options options) {
+  ParallelGzipReaderBase::Reset(options);
+  src_.Reset(std::move(src_args));
+  Initialize(src_.get());
+}
+
+template <typename Src>
+void ParallelGzipReader<Src>::Done() {
+  ParallelGzipReaderBase::Done();
+  if (src_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!src_->Close())) {
+      FailWithoutAnnotation(AnnotateOverSrc(src_->status()));
+    }
+  }
+}
+
+template <typename Src>
+void ParallelGzipReader<Src>::VerifyEnd() {
+  ParallelGzipReaderBase::VerifyEnd();
+  if (src_.is_owning() && ABSL_PREDICT_TRUE(healthy())) src_->VerifyEnd();
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZLIB_PARALLEL_GZIP_READER_H_
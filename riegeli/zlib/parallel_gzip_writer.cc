@@ -0,0 +1,243 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/zlib/parallel_gzip_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+#include <future>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/buffered_writer.h"
+#include "riegeli/bytes/chain_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/zlib/parallel_gzip_internal.h"
+#include "riegeli/zlib/zlib_writer.h"
+#include "zconf.h"
+#include "zlib.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr int ParallelGzipWriterBase::Options::kMinCompressionLevel;
+constexpr int ParallelGzipWriterBase::Options::kMaxCompressionLevel;
+constexpr int ParallelGzipWriterBase::Options::kDefaultCompressionLevel;
+constexpr int ParallelGzipWriterBase::Options::kMinWindowLog;
+constexpr int ParallelGzipWriterBase::Options::kMaxWindowLog;
+constexpr int ParallelGzipWriterBase::Options::kDefaultWindowLog;
+constexpr size_t ParallelGzipWriterBase::Options::kMaxBlockSize;
+constexpr size_t ParallelGzipWriterBase::Options::kDefaultBlockSize;
+#endif
+
+size_t ParallelGzipWriterBase::EffectiveParallelism(size_t parallelism) {
+  if (parallelism == 0) {
+    parallelism = std::thread::hardware_concurrency();
+    if (ABSL_PREDICT_FALSE(parallelism == 0)) parallelism = 1;
+  }
+  return parallelism;
+}
+
+void ParallelGzipWriterBase::Initialize(Writer* dest) {
+  RIEGELI_ASSERT(dest != nullptr)
+      << "Failed precondition of ParallelGzipWriter: null Writer pointer";
+  if (ABSL_PREDICT_FALSE(!dest->healthy())) {
+    FailWithoutAnnotation(AnnotateOverDest(dest->status()));
+  }
+}
+
+void ParallelGzipWriterBase::DoneBehindBuffer(absl::string_view src) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedWriter::DoneBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Writer& dest = *dest_writer();
+  if (!src.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteInternal(src))) return;
+  }
+  if (!member_scheduled_) {
+    // Write an empty member.
+    if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest))) return;
+  }
+  WriteAllMembers(dest);
+}
+
+void ParallelGzipWriterBase::Done() {
+  BufferedWriter::Done();
+  block_ = Chain();
+  // Pending members are abandoned if writing failed. Their tasks still run to
+  // completion, but they do not refer to `*this`.
+  members_.clear();
+}
+
+absl::Status ParallelGzipWriterBase::AnnotateStatusImpl(absl::Status status) {
+  if (is_open()) {
+    Writer& dest = *dest_writer();
+    status = dest.AnnotateStatus(std::move(status));
+  }
+  // The status might have been annotated by `*dest->writer()` with the
+  // compressed position. Clarify that the current position is the uncompressed
+  // position instead of delegating to `BufferedWriter::AnnotateStatusImpl()`.
+  return AnnotateOverDest(std::move(status));
+}
+
+absl::Status ParallelGzipWriterBase::AnnotateOverDest(absl::Status status) {
+  if (is_open()) {
+    return Annotate(status, absl::StrCat("at uncompressed byte ", pos()));
+  }
+  return status;
+}
+
+bool ParallelGzipWriterBase::WriteInternal(absl::string_view src) {
+  RIEGELI_ASSERT(!src.empty())
+      << "Failed precondition of BufferedWriter::WriteInternal(): "
+         "nothing to write";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of BufferedWriter::WriteInternal(): " << status();
+  if (ABSL_PREDICT_FALSE(src.size() >
+                         std::numeric_limits<Position>::max() - start_pos())) {
+    return FailOverflow();
+  }
+  Writer& dest = *dest_writer();
+  do {
+    const size_t length =
+        UnsignedMin(src.size(), block_size_ - block_.size());
+    block_.Append(src.substr(0, length));
+    move_start_pos(length);
+    src.remove_prefix(length);
+    if (block_.size() == block_size_) {
+      if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest))) return false;
+    }
+  } while (!src.empty());
+  return true;
+}
+
+bool ParallelGzipWriterBase::FlushBehindBuffer(absl::string_view src,
+                                               FlushType flush_type) {
+  RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
+      << "Failed precondition of BufferedWriter::FlushBehindBuffer(): "
+         "buffer not empty";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  Writer& dest = *dest_writer();
+  if (!src.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteInternal(src))) return false;
+  }
+  return WriteAllMembers(dest);
+}
+
+ParallelGzipWriterBase::Member ParallelGzipWriterBase::CompressMember(
+    const Chain& block, int compression_level, int window_log) {
+  Member member;
+  Chain deflated;
+  ZlibWriter<ChainWriter<>> compressor(
+      std::forward_as_tuple(&deflated),
+      ZlibWriterBase::Options()
+          .set_header(ZlibWriterBase::Header::kRaw)
+          .set_compression_level(compression_level)
+          .set_window_log(window_log)
+          .set_size_hint(block.size()));
+  compressor.Write(block);
+  if (ABSL_PREDICT_FALSE(!compressor.Close())) {
+    member.status = compressor.status();
+    return member;
+  }
+  const size_t member_size = internal::kGzipMemberHeaderSize +
+                             deflated.size() +
+                             internal::kGzipMemberTrailerSize;
+  if (ABSL_PREDICT_FALSE(member_size > std::numeric_limits<uint32_t>::max())) {
+    member.status = absl::ResourceExhaustedError(
+        absl::StrCat("Compressed gzip member too large: ", member_size));
+    return member;
+  }
+  uLong crc = crc32(0, nullptr, 0);
+  for (const absl::string_view fragment : block.blocks()) {
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(fragment.data()),
+                IntCast<uInt>(fragment.size()));
+  }
+  char header[internal::kGzipMemberHeaderSize];
+  std::memcpy(header, internal::kGzipMemberHeaderPrefix,
+              internal::kGzipMemberHeaderPrefixSize);
+  WriteLittleEndian32(IntCast<uint32_t>(member_size),
+                      header + internal::kGzipMemberSizeOffset);
+  char trailer[internal::kGzipMemberTrailerSize];
+  WriteLittleEndian32(static_cast<uint32_t>(crc), trailer);
+  WriteLittleEndian32(IntCast<uint32_t>(block.size()), trailer + 4);
+  member.data.Append(absl::string_view(header, sizeof(header)));
+  member.data.Append(std::move(deflated));
+  member.data.Append(absl::string_view(trailer, sizeof(trailer)));
+  return member;
+}
+
+bool ParallelGzipWriterBase::ScheduleBlock(Writer& dest) {
+  if (members_.size() >= parallelism_) {
+    if (ABSL_PREDICT_FALSE(!WriteMember(dest))) return false;
+  }
+  std::promise<Member>* const member_promise = new std::promise<Member>();
+  members_.push_back(member_promise->get_future());
+  member_scheduled_ = true;
+  Executor& executor = executor_ == nullptr ? internal::ThreadPool::global()
+                                            : *executor_;
+  executor.Schedule([member_promise, block = std::move(block_),
+                     compression_level = compression_level_,
+                     window_log = window_log_] {
+    member_promise->set_value(
+        CompressMember(block, compression_level, window_log));
+    delete member_promise;
+  });
+  block_ = Chain();
+  return true;
+}
+
+bool ParallelGzipWriterBase::WriteMember(Writer& dest) {
+  RIEGELI_ASSERT(!members_.empty())
+      << "Failed precondition of ParallelGzipWriterBase::WriteMember(): "
+         "no pending members";
+  Member member = members_.front().get();
+  members_.pop_front();
+  if (ABSL_PREDICT_FALSE(!member.status.ok())) {
+    return Fail(std::move(member.status));
+  }
+  if (ABSL_PREDICT_FALSE(!dest.Write(std::move(member.data)))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
+  return true;
+}
+
+bool ParallelGzipWriterBase::WriteAllMembers(Writer& dest) {
+  if (!block_.empty()) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBlock(dest))) return false;
+  }
+  while (!members_.empty()) {
+    if (ABSL_PREDICT_FALSE(!WriteMember(dest))) return false;
+  }
+  return true;
+}
+
+}  // namespace riegeli
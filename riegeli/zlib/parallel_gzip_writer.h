@@ -0,0 +1,509 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZLIB_PARALLEL_GZIP_WRITER_H_
+#define RIEGELI_ZLIB_PARALLEL_GZIP_WRITER_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <future>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/buffered_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/zlib/zlib_writer.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `ParallelGzipWriter`.
+class ParallelGzipWriterBase : public BufferedWriter {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Tunes the tradeoff between compression density and compression speed
+    // (higher = better density but slower).
+    //
+    // `compression_level` must be between `kMinCompressionLevel` (0) and
+    // `kMaxCompressionLevel` (9). Default: `kDefaultCompressionLevel` (6).
+    static constexpr int kMinCompressionLevel =
+        ZlibWriterBase::Options::kMinCompressionLevel;
+    static constexpr int kMaxCompressionLevel =
+        ZlibWriterBase::Options::kMaxCompressionLevel;
+    static constexpr int kDefaultCompressionLevel =
+        ZlibWriterBase::Options::kDefaultCompressionLevel;
+    Options& set_compression_level(int compression_level) & {
+      RIEGELI_ASSERT_GE(compression_level, kMinCompressionLevel)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_compression_level(): "
+             "compression level out of range";
+      RIEGELI_ASSERT_LE(compression_level, kMaxCompressionLevel)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_compression_level(): "
+             "compression level out of range";
+      compression_level_ = compression_level;
+      return *this;
+    }
+    Options&& set_compression_level(int compression_level) && {
+      return std::move(set_compression_level(compression_level));
+    }
+    int compression_level() const { return compression_level_; }
+
+    // Logarithm of the LZ77 sliding window size. This tunes the tradeoff
+    // between compression density and memory usage (higher = better density but
+    // more memory).
+    //
+    // `window_log` must be between `kMinWindowLog` (9) and
+    // `kMaxWindowLog` (15). Default: `kDefaultWindowLog` (15).
+    static constexpr int kMinWindowLog = ZlibWriterBase::Options::kMinWindowLog;
+    static constexpr int kMaxWindowLog = ZlibWriterBase::Options::kMaxWindowLog;
+    static constexpr int kDefaultWindowLog =
+        ZlibWriterBase::Options::kDefaultWindowLog;
+    Options& set_window_log(int window_log) & {
+      RIEGELI_ASSERT_GE(window_log, kMinWindowLog)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_window_log(): "
+             "window log out of range";
+      RIEGELI_ASSERT_LE(window_log, kMaxWindowLog)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_window_log(): "
+             "window log out of range";
+      window_log_ = window_log;
+      return *this;
+    }
+    Options&& set_window_log(int window_log) && {
+      return std::move(set_window_log(window_log));
+    }
+    int window_log() const { return window_log_; }
+
+    // The amount of uncompressed data compressed independently into each gzip
+    // member. Larger blocks compress better, smaller blocks allow more
+    // parallelism for short streams and use less memory.
+    //
+    // `Flush()` ends the current block early.
+    //
+    // `block_size` must be between 1 and `kMaxBlockSize` (1G).
+    // Default: `kDefaultBlockSize` (1M).
+    static constexpr size_t kMaxBlockSize = size_t{1} << 30;
+    static constexpr size_t kDefaultBlockSize = size_t{1} << 20;
+    Options& set_block_size(size_t block_size) & {
+      RIEGELI_ASSERT_GT(block_size, 0u)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_block_size(): "
+             "zero block size";
+      RIEGELI_ASSERT_LE(block_size, kMaxBlockSize)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_block_size(): "
+             "block size out of range";
+      block_size_ = block_size;
+      return *this;
+    }
+    Options&& set_block_size(size_t block_size) && {
+      return std::move(set_block_size(block_size));
+    }
+    size_t block_size() const { return block_size_; }
+
+    // Maximum number of blocks being compressed at a time. Compressed blocks
+    // are written in order, so this also bounds the memory used for blocks
+    // waiting to be written.
+    //
+    // Special value 0 means `std::thread::hardware_concurrency()`.
+    //
+    // Default: 0.
+    Options& set_parallelism(size_t parallelism) & {
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(size_t parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    size_t parallelism() const { return parallelism_; }
+
+    // The `Executor` running the compression of blocks, or `nullptr` for the
+    // thread pool shared by all parallel operations of Riegeli.
+    //
+    // The `Executor` must outlive the `ParallelGzipWriter`.
+    //
+    // Default: `nullptr`.
+    Options& set_executor(Executor* executor) & {
+      executor_ = executor;
+      return *this;
+    }
+    Options&& set_executor(Executor* executor) && {
+      return std::move(set_executor(executor));
+    }
+    Executor* executor() const { return executor_; }
+
+    // Expected uncompressed size, or `absl::nullopt` if unknown. This may
+    // improve performance.
+    //
+    // If the size hint turns out to not match reality, nothing breaks.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_size_hint(absl::optional<Position> size_hint) & {
+      size_hint_ = size_hint;
+      return *this;
+    }
+    Options&& set_size_hint(absl::optional<Position> size_hint) && {
+      return std::move(set_size_hint(size_hint));
+    }
+    absl::optional<Position> size_hint() const { return size_hint_; }
+
+    // Tunes how much data is buffered before being appended to the current
+    // block.
+    //
+    // Default: `kDefaultBufferSize` (64K).
+    Options& set_buffer_size(size_t buffer_size) & {
+      RIEGELI_ASSERT_GT(buffer_size, 0u)
+          << "Failed precondition of "
+             "ParallelGzipWriterBase::Options::set_buffer_size(): "
+             "zero buffer size";
+      buffer_size_ = buffer_size;
+      return *this;
+    }
+    Options&& set_buffer_size(size_t buffer_size) && {
+      return std::move(set_buffer_size(buffer_size));
+    }
+    size_t buffer_size() const { return buffer_size_; }
+
+   private:
+    int compression_level_ = kDefaultCompressionLevel;
+    int window_log_ = kDefaultWindowLog;
+    size_t block_size_ = kDefaultBlockSize;
+    size_t parallelism_ = 0;
+    Executor* executor_ = nullptr;
+    absl::optional<Position> size_hint_;
+    size_t buffer_size_ = kDefaultBufferSize;
+  };
+
+  // Returns the compressed `Writer`. Unchanged by `Close()`.
+  virtual Writer* dest_writer() = 0;
+  virtual const Writer* dest_writer() const = 0;
+
+ protected:
+  explicit ParallelGzipWriterBase(Closed) noexcept : BufferedWriter(kClosed) {}
+
+  explicit ParallelGzipWriterBase(const Options& options);
+
+  ParallelGzipWriterBase(ParallelGzipWriterBase&& that) noexcept;
+  ParallelGzipWriterBase& operator=(ParallelGzipWriterBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(const Options& options);
+  void Initialize(Writer* dest);
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
+
+  void DoneBehindBuffer(absl::string_view src) override;
+  void Done() override;
+  ABSL_ATTRIBUTE_COLD absl::Status AnnotateStatusImpl(
+      absl::Status status) override;
+  bool WriteInternal(absl::string_view src) override;
+  bool FlushBehindBuffer(absl::string_view src, FlushType flush_type) override;
+
+ private:
+  struct Member {
+    absl::Status status;
+    Chain data;
+  };
+
+  static size_t EffectiveParallelism(size_t parallelism);
+  // Compresses `block` into a complete gzip member.
+  static Member CompressMember(const Chain& block, int compression_level,
+                               int window_log);
+
+  // Schedules compressing the current block, after writing the oldest member
+  // if `parallelism_` members are pending.
+  bool ScheduleBlock(Writer& dest);
+  // Waits for the oldest pending member and writes it to `dest`.
+  bool WriteMember(Writer& dest);
+  // Schedules compressing the current block if it is not empty, and writes all
+  // pending members to `dest`.
+  bool WriteAllMembers(Writer& dest);
+
+  int compression_level_ = 0;
+  int window_log_ = 0;
+  size_t block_size_ = 0;
+  size_t parallelism_ = 0;
+  Executor* executor_ = nullptr;
+  // Uncompressed data of the current block.
+  Chain block_;
+  // If `true`, at least one member was scheduled. An empty stream is written as
+  // a single empty member, because a gzip file must have at least one member.
+  bool member_scheduled_ = false;
+  // Members being compressed or waiting to be written, in order.
+  std::deque<std::future<Member>> members_;
+};
+
+// A `Writer` which compresses data in the gzip format before passing it to
+// another `Writer`, compressing blocks of `Options::block_size()` in parallel.
+//
+// Each block becomes an independent gzip member. The output is a valid
+// multi-member gzip stream, readable by `ZlibReader` with
+// `set_concatenate(true)` and by standard gzip tools. Additionally, the header
+// of each member stores the size of the member in an extra subfield, which lets
+// `ParallelGzipReader` decompress members in parallel.
+//
+// Compression density is slightly worse than with `ZlibWriter`, because each
+// block is compressed without the history of previous blocks.
+//
+// The `Dest` template parameter specifies the type of the object providing and
+// possibly owning the compressed `Writer`. `Dest` must support
+// `Dependency<Writer*, Dest>`, e.g. `Writer*` (not owned, default),
+// `std::unique_ptr<Writer>` (owned), `ChainWriter<>` (owned).
+//
+// By relying on CTAD the template argument can be deduced as the value type of
+// the first constructor argument. This requires C++17.
+//
+// The compressed `Writer` must not be accessed until the `ParallelGzipWriter`
+// is closed or no longer used, except that it is allowed to read the
+// destination of the compressed `Writer` immediately after `Flush()`.
+template <typename Dest = Writer*>
+class ParallelGzipWriter : public ParallelGzipWriterBase {
+ public:
+  // Creates a closed `ParallelGzipWriter`.
+  explicit ParallelGzipWriter(Closed) noexcept
+      : ParallelGzipWriterBase(kClosed) {}
+
+  // Will write to the compressed `Writer` provided by `dest`.
+  explicit ParallelGzipWriter(const Dest& dest, Options options = Options());
+  explicit ParallelGzipWriter(Dest&& dest, Options options = Options());
+
+  // Will write to the compressed `Writer` provided by a `Dest` constructed from
+  // elements of `dest_args`. This avoids constructing a temporary `Dest` and
+  // moving from it.
+  template <typename... DestArgs>
+  explicit ParallelGzipWriter(std::tuple<DestArgs...> dest_args,
+                              Options options = Options());
+
+  ParallelGzipWriter(ParallelGzipWriter&& that) noexcept;
+  ParallelGzipWriter& operator=(ParallelGzipWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `ParallelGzipWriter`. This
+  // avoids constructing a temporary `ParallelGzipWriter` and moving from it.
+  void Reset(Closed);
+  void Reset(const Dest& dest, Options options = Options());
+  void Reset(Dest&& dest, Options options = Options());
+  template <typename... DestArgs>
+  void Reset(std::tuple<DestArgs...> dest_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the compressed `Writer`.
+  // Unchanged by `Close()`.
+  Dest& dest() { return dest_.manager(); }
+  const Dest& dest() const { return dest_.manager(); }
+  Writer* dest_writer() override { return dest_.get(); }
+  const Writer* dest_writer() const override { return dest_.get(); }
+
+ protected:
+  void Done() override;
+  bool FlushImpl(FlushType flush_type) override;
+
+ private:
+  // The object providing and possibly owning the compressed `Writer`.
+  Dependency<Writer*, Dest> dest_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit ParallelGzipWriter(Closed)->ParallelGzipWriter<DeleteCtad<Closed>>;
+template <typename Dest>
+explicit ParallelGzipWriter(const Dest& dest,
+                            ParallelGzipWriterBase::Options options =
+                                ParallelGzipWriterBase::Options())
+    -> ParallelGzipWriter<std::decay_t<Dest>>;
+template <typename Dest>
+explicit ParallelGzipWriter(Dest&& dest,
+                            ParallelGzipWriterBase::Options options =
+                                ParallelGzipWriterBase::Options())
+    -> ParallelGzipWriter<std::decay_t<Dest>>;
+template <typename... DestArgs>
+explicit ParallelGzipWriter(std::tuple<DestArgs...> dest_args,
+                            ParallelGzipWriterBase::Options options =
+                                ParallelGzipWriterBase::Options())
+    -> ParallelGzipWriter<DeleteCtad<std::tuple<DestArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline ParallelGzipWriterBase::ParallelGzipWriterBase(const Options& options)
+    : BufferedWriter(options.buffer_size(), options.size_hint()),
+      compression_level_(options.compression_level()),
+      window_log_(options.window_log()),
+      block_size_(options.block_size()),
+      parallelism_(EffectiveParallelism(options.parallelism())),
+      executor_(options.executor()) {}
+
+inline ParallelGzipWriterBase::ParallelGzipWriterBase(
+    ParallelGzipWriterBase&& that) noexcept
+    : BufferedWriter(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      compression_level_(that.compression_level_),
+      window_log_(that.window_log_),
+      block_size_(that.block_size_),
+      parallelism_(that.parallelism_),
+      executor_(that.executor_),
+      block_(std::move(that.block_)),
+      member_scheduled_(that.member_scheduled_),
+      members_(std::move(that.members_)) {}
+
+inline ParallelGzipWriterBase& ParallelGzipWriterBase::operator=(
+    ParallelGzipWriterBase&& that) noexcept {
+  BufferedWriter::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  compression_level_ = that.compression_level_;
+  window_log_ = that.window_log_;
+  block_size_ = that.block_size_;
+  parallelism_ = that.parallelism_;
+  executor_ = that.executor_;
+  block_ = std::move(that.block_);
+  member_scheduled_ = that.member_scheduled_;
+  members_ = std::move(that.members_);
+  return *this;
+}
+
+inline void ParallelGzipWriterBase::Reset(Closed) {
+  BufferedWriter::Reset(kClosed);
+  compression_level_ = 0;
+  window_log_ = 0;
+  block_size_ = 0;
+  parallelism_ = 0;
+  executor_ = nullptr;
+  block_.Clear();
+  member_scheduled_ = false;
+  members_.clear();
+}
+
+inline void ParallelGzipWriterBase::Reset(const Options& options) {
+  BufferedWriter::Reset(options.buffer_size(), options.size_hint());
+  compression_level_ = options.compression_level();
+  window_log_ = options.window_log();
+  block_size_ = options.block_size();
+  parallelism_ = EffectiveParallelism(options.parallelism());
+  executor_ = options.executor();
+  block_.Clear();
+  member_scheduled_ = false;
+  members_.clear();
+}
+
+template <typename Dest>
+inline ParallelGzipWriter<Dest>::ParallelGzipWriter(const Dest& dest,
+                                                    Options options)
+    : ParallelGzipWriterBase(options), dest_(dest) {
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+inline ParallelGzipWriter<Dest>::ParallelGzipWriter(Dest&& dest,
+                                                    Options options)
+    : ParallelGzipWriterBase(options), dest_(std::move(dest)) {
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline ParallelGzipWriter<Dest>::ParallelGzipWriter(
+    std::tuple<DestArgs...> dest_args, Options options)
+    : ParallelGzipWriterBase(options), dest_(std::move(dest_args)) {
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+inline ParallelGzipWriter<Dest>::ParallelGzipWriter(
+    ParallelGzipWriter&& that) noexcept
+    : ParallelGzipWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      dest_(std::move(that.dest_)) {}
+
+template <typename Dest>
+inline ParallelGzipWriter<Dest>& ParallelGzipWriter<Dest>::operator=(
+    ParallelGzipWriter&& that) noexcept {
+  ParallelGzipWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  dest_ = std::move(that.dest_);
+  return *this;
+}
+
+template <typename Dest>
+inline void ParallelGzipWriter<Dest>::Reset(Closed) {
+  ParallelGzipWriterBase::Reset(kClosed);
+  dest_.Reset();
+}
+
+template <typename Dest>
+inline void ParallelGzipWriter<Dest>::Reset(const Dest& dest,
+                                            Options options) {
+  ParallelGzipWriterBase::Reset(options);
+  dest_.Reset(dest);
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+inline void ParallelGzipWriter<Dest>::Reset(Dest&& dest, Options options) {
+  ParallelGzipWriterBase::Reset(options);
+  dest_.Reset(std::move(dest));
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline void ParallelGzipWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
+                                            Options options) {
+  ParallelGzipWriterBase::Reset(options);
+  dest_.Reset(std::move(dest_args));
+  Initialize(dest_.get());
+}
+
+template <typename Dest>
+void ParallelGzipWriter<Dest>::Done() {
+  ParallelGzipWriterBase::Done();
+  if (dest_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!dest_->Close())) {
+      FailWithoutAnnotation(AnnotateOverDest(dest_->status()));
+    }
+  }
+}
+
+template <typename Dest>
+bool ParallelGzipWriter<Dest>::FlushImpl(FlushType flush_type) {
+  if (ABSL_PREDICT_FALSE(!ParallelGzipWriterBase::FlushImpl(flush_type))) {
+    return false;
+  }
+  if (flush_type != FlushType::kFromObject || dest_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!dest_->Flush(flush_type))) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest_->status()));
+    }
+  }
+  return true;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZLIB_PARALLEL_GZIP_WRITER_H_
@@ -169,6 +169,14 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
   if (ABSL_PREDICT_FALSE(decompressor_ == nullptr)) return false;
   Reader& src = *src_reader();
   truncated_ = false;
+  // If the rest of the stream is expected to fit in `dest`, let `inflate()`
+  // decompress it in one step, without filling its sliding window. If the
+  // expectation turns out to be wrong, `inflate()` continues as with
+  // `Z_NO_FLUSH`.
+  const int flush =
+      size_hint() > limit_pos() && max_length >= size_hint() - limit_pos()
+          ? Z_FINISH
+          : Z_NO_FLUSH;
   decompressor_->next_out = reinterpret_cast<Bytef*>(dest);
   for (;;) {
     decompressor_->avail_out = SaturatingIntCast<uInt>(PtrDistance(
@@ -177,15 +185,17 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
         reinterpret_cast<const Bytef*>(src.cursor()));
     decompressor_->avail_in = SaturatingIntCast<uInt>(src.available());
     if (decompressor_->avail_in > 0) stream_had_data_ = true;
-    const int result = inflate(decompressor_.get(), Z_NO_FLUSH);
+    const int result = inflate(decompressor_.get(), flush);
     src.set_cursor(reinterpret_cast<const char*>(decompressor_->next_in));
     const size_t length_read =
         PtrDistance(dest, reinterpret_cast<char*>(decompressor_->next_out));
     switch (result) {
+      case Z_BUF_ERROR:
+        // With `Z_FINISH`, `Z_BUF_ERROR` is returned also if `dest` is full.
+        if (decompressor_->avail_out == 0) break;
+        ABSL_FALLTHROUGH_INTENDED;
       case Z_OK:
         if (length_read >= min_length) break;
-        ABSL_FALLTHROUGH_INTENDED;
-      case Z_BUF_ERROR:
         RIEGELI_ASSERT_EQ(decompressor_->avail_in, 0u)
             << "inflate() returned but there are still input data";
         if (ABSL_PREDICT_FALSE(!src.Pull())) {
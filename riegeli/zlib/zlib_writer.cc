@@ -185,11 +185,6 @@ inline bool ZlibWriterBase::WriteInternal(absl::string_view src, Writer& dest,
   compressor_->next_in =
       const_cast<z_const Bytef*>(reinterpret_cast<const Bytef*>(src.data()));
   for (;;) {
-    // If `compressor_->avail_out == 0` then `deflate()` returns `Z_BUF_ERROR`,
-    // so `dest.Push()` first.
-    if (ABSL_PREDICT_FALSE(!dest.Push())) {
-      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
-    }
     size_t avail_in =
         PtrDistance(reinterpret_cast<const char*>(compressor_->next_in),
                     src.data() + src.size());
@@ -198,6 +193,18 @@ inline bool ZlibWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       avail_in = size_t{std::numeric_limits<uInt>::max()};
       op = Z_NO_FLUSH;
     }
+    // If `compressor_->avail_out == 0` then `deflate()` returns `Z_BUF_ERROR`,
+    // so `dest.Push()` first.
+    //
+    // When finishing, ask for enough space to let `deflate()` compress the
+    // rest of the stream in one step.
+    if (ABSL_PREDICT_FALSE(!dest.Push(
+            1, op == Z_FINISH
+                   ? SaturatingIntCast<size_t>(
+                         deflateBound(compressor_.get(), avail_in))
+                   : size_t{0}))) {
+      return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+    }
     compressor_->avail_in = IntCast<uInt>(avail_in);
     compressor_->next_out = reinterpret_cast<Bytef*>(dest.cursor());
     compressor_->avail_out = SaturatingIntCast<uInt>(dest.available());
@@ -23,11 +23,15 @@
 
 #include <limits>
 #include <memory>
+#include <string>
+#include <utility>
 
 #include "absl/base/call_once.h"
+#include "absl/base/optimization.h"
 #include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/intrusive_ref_count.h"
+#include "riegeli/base/shared_cache.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -54,6 +58,74 @@ struct ZSTD_DDictDeleter {
   void operator()(ZSTD_DDict* ptr) const { ZSTD_freeDDict(ptr); }
 };
 
+// Identifies a prepared dictionary in the process-wide cache. The dictionary
+// ID is a function of `data`, so it does not need to be a separate field.
+struct DictionaryKey {
+  friend bool operator==(const DictionaryKey& a, const DictionaryKey& b) {
+    return a.type == b.type && a.compression_level == b.compression_level &&
+           a.data == b.data;
+  }
+
+  template <typename HashState>
+  friend HashState AbslHashValue(HashState hash_state,
+                                 const DictionaryKey& self) {
+    return HashState::combine(std::move(hash_state), self.type,
+                              self.compression_level, self.data);
+  }
+
+  ZSTD_dictContentType_e type;
+  // 0 for a decompression dictionary.
+  int compression_level;
+  absl::string_view data;
+};
+
+// A prepared dictionary shared by all `ZstdDictionary` objects with the same
+// contents. It owns a copy of the data it was prepared from, because the
+// prepared form refers to the data and may outlive the `ZstdDictionary` which
+// requested it.
+template <typename Prepared, typename Deleter>
+class SharedPreparedDictionary {
+ public:
+  explicit SharedPreparedDictionary(ZSTD_dictContentType_e type,
+                                    int compression_level,
+                                    absl::string_view data)
+      : type_(type), compression_level_(compression_level), data_(data) {}
+
+  SharedPreparedDictionary(const SharedPreparedDictionary&) = delete;
+  SharedPreparedDictionary& operator=(const SharedPreparedDictionary&) =
+      delete;
+
+  DictionaryKey key() const {
+    return DictionaryKey{type_, compression_level_, data_};
+  }
+
+  absl::string_view data() const { return data_; }
+
+  void set_prepared(Prepared* prepared) { prepared_.reset(prepared); }
+  const Prepared* prepared() const { return prepared_.get(); }
+
+ private:
+  ZSTD_dictContentType_e type_;
+  int compression_level_;
+  std::string data_;
+  std::unique_ptr<Prepared, Deleter> prepared_;
+};
+
+using SharedCompressionDictionary =
+    SharedPreparedDictionary<ZSTD_CDict, ZSTD_CDictDeleter>;
+using SharedDecompressionDictionary =
+    SharedPreparedDictionary<ZSTD_DDict, ZSTD_DDictDeleter>;
+
+// Returns `prepared()` of `shared`, keeping `shared` alive, or `nullptr` if
+// `shared` is `nullptr`.
+template <typename Prepared, typename Deleter>
+std::shared_ptr<const Prepared> AliasPrepared(
+    const std::shared_ptr<const SharedPreparedDictionary<Prepared, Deleter>>&
+        shared) {
+  if (ABSL_PREDICT_FALSE(shared == nullptr)) return nullptr;
+  return std::shared_ptr<const Prepared>(shared, shared->prepared());
+}
+
 }  // namespace
 
 inline std::shared_ptr<const ZSTD_CDict>
@@ -67,13 +139,25 @@ ZstdDictionary::Repr::PrepareCompressionDictionary(
     compression_cache_.store(compression_cache, std::memory_order_release);
   }
   absl::call_once(compression_cache->compression_once, [&] {
-    compression_cache->compression_dictionary =
-        std::unique_ptr<ZSTD_CDict, ZSTD_CDictDeleter>(
-            ZSTD_createCDict_advanced(
-                data_.data(), data_.size(), ZSTD_dlm_byRef,
-                static_cast<ZSTD_dictContentType_e>(type_),
-                ZSTD_getCParams(compression_level, 0, data_.size()),
-                ZSTD_defaultCMem));
+    const ZSTD_dictContentType_e type =
+        static_cast<ZSTD_dictContentType_e>(type_);
+    compression_cache->compression_dictionary = AliasPrepared(
+        SharedCache<DictionaryKey, SharedCompressionDictionary>::global().Get(
+            DictionaryKey{type, compression_level, data_},
+            [&]() -> std::unique_ptr<SharedCompressionDictionary> {
+              std::unique_ptr<SharedCompressionDictionary> shared =
+                  std::make_unique<SharedCompressionDictionary>(
+                      type, compression_level, data_);
+              shared->set_prepared(ZSTD_createCDict_advanced(
+                  shared->data().data(), shared->data().size(),
+                  ZSTD_dlm_byRef, type,
+                  ZSTD_getCParams(compression_level, 0, data_.size()),
+                  ZSTD_defaultCMem));
+              if (ABSL_PREDICT_FALSE(shared->prepared() == nullptr)) {
+                return nullptr;
+              }
+              return shared;
+            }));
   });
   return compression_cache->compression_dictionary;
 }
@@ -81,10 +165,23 @@ ZstdDictionary::Repr::PrepareCompressionDictionary(
 inline std::shared_ptr<const ZSTD_DDict>
 ZstdDictionary::Repr::PrepareDecompressionDictionary() const {
   absl::call_once(decompression_once_, [&] {
-    decompression_dictionary_ = std::unique_ptr<ZSTD_DDict, ZSTD_DDictDeleter>(
-        ZSTD_createDDict_advanced(data_.data(), data_.size(), ZSTD_dlm_byRef,
-                                  static_cast<ZSTD_dictContentType_e>(type_),
-                                  ZSTD_defaultCMem));
+    const ZSTD_dictContentType_e type =
+        static_cast<ZSTD_dictContentType_e>(type_);
+    decompression_dictionary_ = AliasPrepared(
+        SharedCache<DictionaryKey, SharedDecompressionDictionary>::global()
+            .Get(DictionaryKey{type, 0, data_},
+                 [&]() -> std::unique_ptr<SharedDecompressionDictionary> {
+                   std::unique_ptr<SharedDecompressionDictionary> shared =
+                       std::make_unique<SharedDecompressionDictionary>(
+                           type, 0, data_);
+                   shared->set_prepared(ZSTD_createDDict_advanced(
+                       shared->data().data(), shared->data().size(),
+                       ZSTD_dlm_byRef, type, ZSTD_defaultCMem));
+                   if (ABSL_PREDICT_FALSE(shared->prepared() == nullptr)) {
+                     return nullptr;
+                   }
+                   return shared;
+                 }));
   });
   return decompression_dictionary_;
 }
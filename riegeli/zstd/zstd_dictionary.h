@@ -44,6 +44,11 @@ namespace riegeli {
 // most one prepared dictionary is cached, corresponding to the last compression
 // level used.
 //
+// Prepared dictionaries are also shared process-wide between `ZstdDictionary`
+// objects with the same contents, as long as any of them is in use. This avoids
+// preparing them again when many files using the same dictionary are opened
+// independently.
+//
 // Copying a `ZstdDictionary` object is cheap, sharing the actual dictionary.
 class ZstdDictionary {
  public:
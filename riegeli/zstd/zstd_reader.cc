@@ -19,11 +19,14 @@
 #include "riegeli/zstd/zstd_reader.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
@@ -34,11 +37,13 @@
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/zstd/zstd_seekable_internal.h"
 #include "zstd.h"
 
 namespace riegeli {
 
-void ZstdReaderBase::Initialize(Reader* src) {
+void ZstdReaderBase::Initialize(Reader* src, size_t recycling_pool_max_size) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of ZstdReader: null Reader pointer";
   if (ABSL_PREDICT_FALSE(!src->healthy()) && src->available() == 0) {
@@ -46,11 +51,119 @@ void ZstdReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  recycling_pool_max_size_ = recycling_pool_max_size;
+  if (seekable_ && src->SupportsRandomAccess()) {
+    ReadSeekTable(*src);
+    if (ABSL_PREDICT_FALSE(!healthy())) return;
+  }
   InitializeDecompressor(*src);
 }
 
+void ZstdReaderBase::ReadSeekTable(Reader& src) {
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
+    FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+    return;
+  }
+  if (*size - initial_compressed_pos_ <
+      internal::kZstdSkippableHeaderSize + internal::kZstdSeekTableFooterSize) {
+    return;
+  }
+  uint32_t num_frames;
+  uint8_t descriptor;
+  uint32_t seekable_magic;
+  if (ABSL_PREDICT_FALSE(
+          !src.Seek(*size - internal::kZstdSeekTableFooterSize) ||
+          !ReadLittleEndian32(src, num_frames) || !src.ReadByte(descriptor) ||
+          !ReadLittleEndian32(src, seekable_magic))) {
+    FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Zstd-compressed stream got truncated"))));
+    return;
+  }
+  if (seekable_magic != internal::kZstdSeekableMagic) {
+    // Not the seekable format. Frames are decompressed sequentially.
+    if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
+      FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+          absl::DataLossError("Zstd-compressed stream got truncated"))));
+    }
+    return;
+  }
+  if (ABSL_PREDICT_FALSE((descriptor & internal::kZstdSeekTableReservedBits) !=
+                         0)) {
+    Fail(absl::InvalidArgumentError(
+        "Invalid zstd seek table: reserved descriptor bits set"));
+    return;
+  }
+  const size_t entry_size =
+      (descriptor & internal::kZstdSeekTableChecksumFlag) != 0
+          ? internal::kZstdSeekTableEntryWithChecksumSize
+          : internal::kZstdSeekTableEntrySize;
+  const Position frame_size =
+      Position{num_frames} * entry_size + internal::kZstdSeekTableFooterSize;
+  const Position table_size = internal::kZstdSkippableHeaderSize + frame_size;
+  if (ABSL_PREDICT_FALSE(num_frames > internal::kZstdSeekableMaxFrames ||
+                         table_size > *size - initial_compressed_pos_)) {
+    Fail(absl::InvalidArgumentError(
+        absl::StrCat("Invalid zstd seek table: too many frames: ",
+                     num_frames)));
+    return;
+  }
+  uint32_t skippable_magic;
+  uint32_t skippable_size;
+  if (ABSL_PREDICT_FALSE(!src.Seek(*size - table_size) ||
+                         !ReadLittleEndian32(src, skippable_magic) ||
+                         !ReadLittleEndian32(src, skippable_size))) {
+    FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Zstd-compressed stream got truncated"))));
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(skippable_magic != internal::kZstdSkippableMagic ||
+                         skippable_size != frame_size)) {
+    Fail(absl::InvalidArgumentError(
+        "Invalid zstd seek table: wrong skippable frame header"));
+    return;
+  }
+  frames_.reserve(size_t{num_frames} + 1);
+  FramePosition frame = {0, 0};
+  frames_.push_back(frame);
+  for (uint32_t i = 0; i < num_frames; ++i) {
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+    if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, compressed_size) ||
+                           !ReadLittleEndian32(src, decompressed_size) ||
+                           !src.Skip(entry_size -
+                                     internal::kZstdSeekTableEntrySize))) {
+      frames_.clear();
+      FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+          absl::DataLossError("Zstd-compressed stream got truncated"))));
+      return;
+    }
+    // Checksums are not verified.
+    frame.compressed += compressed_size;
+    frame.uncompressed += decompressed_size;
+    frames_.push_back(frame);
+  }
+  if (ABSL_PREDICT_FALSE(frame.compressed !=
+                         *size - initial_compressed_pos_ - table_size)) {
+    frames_.clear();
+    Fail(absl::InvalidArgumentError(
+        "Invalid zstd seek table: frame sizes do not match the stream size"));
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
+    frames_.clear();
+    FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+        absl::DataLossError("Zstd-compressed stream got truncated"))));
+    return;
+  }
+  uncompressed_size_ = frame.uncompressed;
+}
+
 inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
-  decompressor_ = RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global().Get(
+  RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>& pool =
+      RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global(
+          recycling_pool_max_size_);
+  decompressor_ = pool.Get(
       [] {
         return std::unique_ptr<ZSTD_DCtx, ZSTD_DCtxDeleter>(ZSTD_createDCtx());
       },
@@ -104,7 +217,9 @@ inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
       return;
     }
   }
-  uncompressed_size_ = ZstdUncompressedSize(src);
+  // In the seekable format the size of the first frame is not the size of the
+  // whole stream. The size comes from the seek table instead, if present.
+  if (!seekable_) uncompressed_size_ = ZstdUncompressedSize(src);
   if (uncompressed_size_ != absl::nullopt) {
     // If `uncompressed_size_` is 0, set `size_hint` to 1, because the first
     // `Pull()` call will need a non-empty destination buffer before calling the
@@ -169,7 +284,11 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
     return FailOverflow();
   }
   size_t effective_min_length = min_length;
-  if (just_initialized_ && !growing_source_ &&
+  if (!frames_.empty() && limit_pos() >= frames_.back().uncompressed) {
+    decompressor_.reset();
+    return false;
+  }
+  if (just_initialized_ && !growing_source_ && !seekable_ &&
       uncompressed_size_ != absl::nullopt &&
       max_length >= *uncompressed_size_) {
     // Avoid a memory copy from an internal buffer of the Zstd engine to `dest`
@@ -191,6 +310,21 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
         ZSTD_decompressStream(decompressor_.get(), &output, &input);
     src.set_cursor(static_cast<const char*>(input.src) + input.pos);
     if (ABSL_PREDICT_FALSE(result == 0)) {
+      if (seekable_ &&
+          (frames_.empty() ||
+           limit_pos() + output.pos < frames_.back().uncompressed)) {
+        // A frame ended. Continue with the next frame if there is one.
+        if (src.Pull()) {
+          if (output.pos >= min_length) {
+            move_limit_pos(output.pos);
+            return true;
+          }
+          continue;
+        }
+        if (ABSL_PREDICT_FALSE(!src.healthy())) {
+          FailWithoutAnnotation(AnnotateOverSrc(src.status()));
+        }
+      }
       decompressor_.reset();
       move_limit_pos(output.pos);
       return output.pos >= min_length;
@@ -222,6 +356,12 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+bool ZstdReaderBase::SupportsRandomAccess() {
+  if (frames_.empty()) return false;
+  Reader* const src = src_reader();
+  return src != nullptr && src->SupportsRandomAccess();
+}
+
 bool ZstdReaderBase::SupportsRewind() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRewind();
@@ -234,6 +374,47 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  if (!frames_.empty()) {
+    // Jump to the frame containing `new_pos` unless it is reached by
+    // decompressing forwards from the current frame.
+    if (ABSL_PREDICT_FALSE(!healthy())) return false;
+    const Position target = UnsignedMin(new_pos, frames_.back().uncompressed);
+    const FramePosition& frame =
+        *(std::upper_bound(frames_.begin(), frames_.end(), target,
+                           [](Position pos, const FramePosition& frame) {
+                             return pos < frame.uncompressed;
+                           }) -
+          1);
+    if (new_pos < limit_pos() || frame.uncompressed > limit_pos()) {
+      Reader& src = *src_reader();
+      truncated_ = false;
+      set_buffer();
+      set_limit_pos(frame.uncompressed);
+      if (ABSL_PREDICT_FALSE(
+              !src.Seek(initial_compressed_pos_ + frame.compressed))) {
+        return FailWithoutAnnotation(AnnotateOverSrc(src.StatusOrAnnotate(
+            absl::DataLossError("Zstd-compressed stream got truncated"))));
+      }
+      if (frame.uncompressed == frames_.back().uncompressed) {
+        // The end of data.
+        decompressor_.reset();
+        return new_pos == limit_pos();
+      }
+      if (decompressor_ == nullptr) {
+        InitializeDecompressor(src);
+        if (ABSL_PREDICT_FALSE(!healthy())) return false;
+      } else {
+        const size_t result =
+            ZSTD_DCtx_reset(decompressor_.get(), ZSTD_reset_session_only);
+        if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+          return Fail(absl::InternalError(absl::StrCat(
+              "ZSTD_DCtx_reset() failed: ", ZSTD_getErrorName(result))));
+        }
+      }
+      if (new_pos == limit_pos()) return true;
+    }
+    return BufferedReader::SeekBehindBuffer(new_pos);
+  }
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!healthy())) return false;
@@ -283,7 +464,10 @@ std::unique_ptr<Reader> ZstdReaderBase::NewReaderImpl(Position initial_pos) {
                                             .set_growing_source(growing_source_)
                                             .set_dictionary(dictionary_)
                                             .set_size_hint(size_hint())
-                                            .set_buffer_size(buffer_size()));
+                                            .set_buffer_size(buffer_size())
+                                            .set_recycling_pool_max_size(
+                                                recycling_pool_max_size_)
+                                            .set_seekable(seekable_));
   reader->Seek(initial_pos);
   return reader;
 }
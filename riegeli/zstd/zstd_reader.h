@@ -21,6 +21,7 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -109,11 +110,47 @@ class ZstdReaderBase : public BufferedReader {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // Maximum number of idle Zstd decompression contexts kept for reuse by
+    // `ZstdReader` objects. The pool is shared by all `ZstdReader` objects in
+    // the process, and the value used by the most recently opened one is in
+    // effect.
+    //
+    // Default: `kDefaultRecyclingPoolMaxSize` (16).
+    Options& set_recycling_pool_max_size(size_t recycling_pool_max_size) & {
+      recycling_pool_max_size_ = recycling_pool_max_size;
+      return *this;
+    }
+    Options&& set_recycling_pool_max_size(size_t recycling_pool_max_size) && {
+      return std::move(set_recycling_pool_max_size(recycling_pool_max_size));
+    }
+    size_t recycling_pool_max_size() const { return recycling_pool_max_size_; }
+
+    // If `true`, reads the zstd seekable format written by `ZstdWriter` with
+    // `set_seekable_frame_size()`: decompresses all frames instead of only the
+    // first one, and if the source supports random access, reads the seek
+    // table, which makes `Size()` available and lets `Seek()` decompress at
+    // most one frame.
+    //
+    // If the source supports random access but does not end with a seek table,
+    // frames are decompressed sequentially.
+    //
+    // Default: `false`.
+    Options& set_seekable(bool seekable) & {
+      seekable_ = seekable;
+      return *this;
+    }
+    Options&& set_seekable(bool seekable) && {
+      return std::move(set_seekable(seekable));
+    }
+    bool seekable() const { return seekable_; }
+
    private:
     bool growing_source_ = false;
     ZstdDictionary dictionary_;
     absl::optional<Position> size_hint_;
     size_t buffer_size_ = DefaultBufferSize();
+    size_t recycling_pool_max_size_ = kDefaultRecyclingPoolMaxSize;
+    bool seekable_ = false;
   };
 
   // Returns the compressed `Reader`. Unchanged by `Close()`.
@@ -125,6 +162,7 @@ class ZstdReaderBase : public BufferedReader {
   // does not grow, `Close()` will fail.
   bool truncated() const { return truncated_; }
 
+  bool SupportsRandomAccess() override;
   bool SupportsRewind() override;
   bool SupportsSize() override { return uncompressed_size_ != absl::nullopt; }
   bool SupportsNewReader() override;
@@ -132,17 +170,17 @@ class ZstdReaderBase : public BufferedReader {
  protected:
   explicit ZstdReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
-  explicit ZstdReaderBase(bool growing_source, ZstdDictionary&& dictionary,
-                          size_t buffer_size,
+  explicit ZstdReaderBase(bool growing_source, bool seekable,
+                          ZstdDictionary&& dictionary, size_t buffer_size,
                           absl::optional<Position> size_hint);
 
   ZstdReaderBase(ZstdReaderBase&& that) noexcept;
   ZstdReaderBase& operator=(ZstdReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(bool growing_source, ZstdDictionary&& dictionary,
+  void Reset(bool growing_source, bool seekable, ZstdDictionary&& dictionary,
              size_t buffer_size, absl::optional<Position> size_hint);
-  void Initialize(Reader* src);
+  void Initialize(Reader* src, size_t recycling_pool_max_size);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverSrc(absl::Status status);
 
   void Done() override;
@@ -159,11 +197,22 @@ class ZstdReaderBase : public BufferedReader {
     void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); }
   };
 
+  // Positions in the zstd seekable format where a frame begins.
+  struct FramePosition {
+    Position compressed;
+    Position uncompressed;
+  };
+
   void InitializeDecompressor(Reader& src);
+  // Reads the seek table of the zstd seekable format into `frames_`, if the
+  // source ends with one.
+  void ReadSeekTable(Reader& src);
 
   // If `true`, supports decompressing as much as possible from a truncated
   // source, then retrying when the source has grown.
   bool growing_source_ = false;
+  // If `true`, reads all frames in the zstd seekable format.
+  bool seekable_ = false;
   // If `true`, calling `ZSTD_DCtx_setParameter()` is valid.
   bool just_initialized_ = false;
   // If `true`, the source is truncated (without a clean end of the compressed
@@ -172,12 +221,17 @@ class ZstdReaderBase : public BufferedReader {
   bool truncated_ = false;
   ZstdDictionary dictionary_;
   Position initial_compressed_pos_ = 0;
+  size_t recycling_pool_max_size_ = kDefaultRecyclingPoolMaxSize;
   // If `healthy()` but `decompressor_ == nullptr` then all data have been
   // decompressed. In this case `ZSTD_decompressStream()` must not be called
   // again.
   RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle decompressor_;
   // Uncompressed size, if known.
   absl::optional<Position> uncompressed_size_;
+  // If the seek table was read: positions where each frame begins, relative to
+  // `initial_compressed_pos_`, followed by positions of the end of data.
+  // Otherwise empty.
+  std::vector<FramePosition> frames_;
 };
 
 // A `Reader` which decompresses data with Zstd after getting it from another
@@ -265,12 +319,13 @@ absl::optional<Position> ZstdUncompressedSize(Reader& src);
 
 // Implementation details follow.
 
-inline ZstdReaderBase::ZstdReaderBase(bool growing_source,
+inline ZstdReaderBase::ZstdReaderBase(bool growing_source, bool seekable,
                                       ZstdDictionary&& dictionary,
                                       size_t buffer_size,
                                       absl::optional<Position> size_hint)
     : BufferedReader(buffer_size, size_hint),
       growing_source_(growing_source),
+      seekable_(seekable),
       dictionary_(std::move(dictionary)) {}
 
 inline ZstdReaderBase::ZstdReaderBase(ZstdReaderBase&& that) noexcept
@@ -278,12 +333,15 @@ inline ZstdReaderBase::ZstdReaderBase(ZstdReaderBase&& that) noexcept
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       growing_source_(that.growing_source_),
+      seekable_(that.seekable_),
       just_initialized_(that.just_initialized_),
       truncated_(that.truncated_),
       dictionary_(std::move(that.dictionary_)),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      recycling_pool_max_size_(that.recycling_pool_max_size_),
       decompressor_(std::move(that.decompressor_)),
-      uncompressed_size_(that.uncompressed_size_) {}
+      uncompressed_size_(that.uncompressed_size_),
+      frames_(std::move(that.frames_)) {}
 
 inline ZstdReaderBase& ZstdReaderBase::operator=(
     ZstdReaderBase&& that) noexcept {
@@ -291,64 +349,76 @@ inline ZstdReaderBase& ZstdReaderBase::operator=(
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
   growing_source_ = that.growing_source_;
+  seekable_ = that.seekable_;
   just_initialized_ = that.just_initialized_;
   truncated_ = that.truncated_;
   dictionary_ = std::move(that.dictionary_);
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  recycling_pool_max_size_ = that.recycling_pool_max_size_;
   decompressor_ = std::move(that.decompressor_);
   uncompressed_size_ = that.uncompressed_size_;
+  frames_ = std::move(that.frames_);
   return *this;
 }
 
 inline void ZstdReaderBase::Reset(Closed) {
   BufferedReader::Reset(kClosed);
   growing_source_ = false;
+  seekable_ = false;
   just_initialized_ = false;
   truncated_ = false;
   initial_compressed_pos_ = 0;
+  recycling_pool_max_size_ = kDefaultRecyclingPoolMaxSize;
   decompressor_.reset();
   dictionary_ = ZstdDictionary();
   uncompressed_size_ = absl::nullopt;
+  frames_ = std::vector<FramePosition>();
 }
 
-inline void ZstdReaderBase::Reset(bool growing_source,
+inline void ZstdReaderBase::Reset(bool growing_source, bool seekable,
                                   ZstdDictionary&& dictionary,
                                   size_t buffer_size,
                                   absl::optional<Position> size_hint) {
   BufferedReader::Reset(buffer_size, size_hint);
   growing_source_ = growing_source;
+  seekable_ = seekable;
   just_initialized_ = false;
   truncated_ = false;
   initial_compressed_pos_ = 0;
+  recycling_pool_max_size_ = kDefaultRecyclingPoolMaxSize;
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
   uncompressed_size_ = absl::nullopt;
+  frames_.clear();
 }
 
 template <typename Src>
 inline ZstdReader<Src>::ZstdReader(const Src& src, Options options)
-    : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
-                     options.buffer_size(), options.size_hint()),
+    : ZstdReaderBase(options.growing_source(), options.seekable(),
+                     std::move(options.dictionary()), options.buffer_size(),
+                     options.size_hint()),
       src_(src) {
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
 inline ZstdReader<Src>::ZstdReader(Src&& src, Options options)
-    : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
-                     options.buffer_size(), options.size_hint()),
+    : ZstdReaderBase(options.growing_source(), options.seekable(),
+                     std::move(options.dictionary()), options.buffer_size(),
+                     options.size_hint()),
       src_(std::move(src)) {
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
 template <typename... SrcArgs>
 inline ZstdReader<Src>::ZstdReader(std::tuple<SrcArgs...> src_args,
                                    Options options)
-    : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
-                     options.buffer_size(), options.size_hint()),
+    : ZstdReaderBase(options.growing_source(), options.seekable(),
+                     std::move(options.dictionary()), options.buffer_size(),
+                     options.size_hint()),
       src_(std::move(src_args)) {
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
@@ -375,31 +445,31 @@ inline void ZstdReader<Src>::Reset(Closed) {
 
 template <typename Src>
 inline void ZstdReader<Src>::Reset(const Src& src, Options options) {
-  ZstdReaderBase::Reset(options.growing_source(),
+  ZstdReaderBase::Reset(options.growing_source(), options.seekable(),
                         std::move(options.dictionary()), options.buffer_size(),
                         options.size_hint());
   src_.Reset(src);
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
 inline void ZstdReader<Src>::Reset(Src&& src, Options options) {
-  ZstdReaderBase::Reset(options.growing_source(),
+  ZstdReaderBase::Reset(options.growing_source(), options.seekable(),
                         std::move(options.dictionary()), options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src));
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
 template <typename... SrcArgs>
 inline void ZstdReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                    Options options) {
-  ZstdReaderBase::Reset(options.growing_source(),
+  ZstdReaderBase::Reset(options.growing_source(), options.seekable(),
                         std::move(options.dictionary()), options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src_args));
-  Initialize(src_.get());
+  Initialize(src_.get(), options.recycling_pool_max_size());
 }
 
 template <typename Src>
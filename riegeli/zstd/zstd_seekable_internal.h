@@ -0,0 +1,52 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
+#define RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace riegeli {
+namespace internal {
+
+// The zstd seekable format consists of independent Zstd frames followed by a
+// seek table stored in a skippable frame:
+//
+//  * the skippable frame header: `kZstdSkippableMagic` and the size of the
+//    rest of the frame (4 bytes little endian each)
+//  * for each Zstd frame: its compressed size and its decompressed size
+//    (4 bytes little endian each), optionally followed by a checksum
+//    (4 bytes little endian)
+//  * the footer: the number of frames (4 bytes little endian), the descriptor
+//    byte, and `kZstdSeekableMagic` (4 bytes little endian)
+//
+// See
+// https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+constexpr uint32_t kZstdSkippableMagic = 0x184d2a5e;
+constexpr uint32_t kZstdSeekableMagic = 0x8f92eab1;
+constexpr size_t kZstdSkippableHeaderSize = 8;
+constexpr size_t kZstdSeekTableEntrySize = 8;
+constexpr size_t kZstdSeekTableEntryWithChecksumSize = 12;
+constexpr size_t kZstdSeekTableFooterSize = 9;
+// Descriptor bits.
+constexpr uint8_t kZstdSeekTableChecksumFlag = 0x80;
+constexpr uint8_t kZstdSeekTableReservedBits = 0x7c;
+// The maximum number of frames allowed by the format.
+constexpr uint32_t kZstdSeekableMaxFrames = 0x8000000;
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
@@ -19,6 +19,7 @@
 #include "riegeli/zstd/zstd_writer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <limits>
 #include <memory>
@@ -35,7 +36,9 @@
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
 #include "riegeli/zstd/zstd_reader.h"
+#include "riegeli/zstd/zstd_seekable_internal.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -49,12 +52,16 @@ constexpr int ZstdWriterBase::Options::kMaxCompressionLevel;
 constexpr int ZstdWriterBase::Options::kDefaultCompressionLevel;
 constexpr int ZstdWriterBase::Options::kMinWindowLog;
 constexpr int ZstdWriterBase::Options::kMaxWindowLog;
+constexpr int ZstdWriterBase::Options::kMaxNumWorkers;
+constexpr size_t ZstdWriterBase::Options::kMaxSeekableFrameSize;
 #endif
 
 void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
                                 absl::optional<int> window_log,
+                                bool long_distance_matching, int num_workers,
                                 bool store_checksum,
-                                absl::optional<Position> size_hint) {
+                                absl::optional<Position> size_hint,
+                                size_t recycling_pool_max_size) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of ZstdWriter: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->healthy())) {
@@ -62,7 +69,22 @@ void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
     return;
   }
   initial_compressed_pos_ = dest->pos();
-  compressor_ = RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::global().Get(
+  if (seekable_frame_size_ != absl::nullopt) {
+    if (ABSL_PREDICT_FALSE(pledged_size_ != absl::nullopt)) {
+      Fail(absl::InvalidArgumentError(
+          "Pledged size is not supported in the zstd seekable format"));
+      return;
+    }
+    frame_compressed_start_pos_ = initial_compressed_pos_;
+    // Each frame is at most `*seekable_frame_size_` long.
+    if (size_hint != absl::nullopt) {
+      size_hint = UnsignedMin(*size_hint, Position{*seekable_frame_size_});
+    }
+  }
+  RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>& pool =
+      RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::global(
+          recycling_pool_max_size);
+  compressor_ = pool.Get(
       [] {
         return std::unique_ptr<ZSTD_CCtx, ZSTD_CCtxDeleter>(ZSTD_createCCtx());
       },
@@ -96,6 +118,31 @@ void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
       return;
     }
   }
+  if (long_distance_matching) {
+    const size_t result = ZSTD_CCtx_setParameter(
+        compressor_.get(), ZSTD_c_enableLongDistanceMatching, 1);
+    if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+      Fail(absl::InternalError(absl::StrCat(
+          "ZSTD_CCtx_setParameter(ZSTD_c_enableLongDistanceMatching) failed: ",
+          ZSTD_getErrorName(result))));
+      return;
+    }
+  }
+  if (num_workers > 0) {
+    // If Zstd was built without multithreading support, the upper bound is 0.
+    const ZSTD_bounds bounds = ZSTD_cParam_getBounds(ZSTD_c_nbWorkers);
+    if (!ZSTD_isError(bounds.error) && bounds.upperBound > 0) {
+      const size_t result =
+          ZSTD_CCtx_setParameter(compressor_.get(), ZSTD_c_nbWorkers,
+                                 SignedMin(num_workers, bounds.upperBound));
+      if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+        Fail(absl::InternalError(
+            absl::StrCat("ZSTD_CCtx_setParameter(ZSTD_c_nbWorkers) failed: ",
+                         ZSTD_getErrorName(result))));
+        return;
+      }
+    }
+  }
   {
     const size_t result = ZSTD_CCtx_setParameter(
         compressor_.get(), ZSTD_c_checksumFlag, store_checksum ? 1 : 0);
@@ -148,6 +195,17 @@ void ZstdWriterBase::DoneBehindBuffer(absl::string_view src) {
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!healthy())) return;
   Writer& dest = *dest_writer();
+  if (seekable_frame_size_ != absl::nullopt) {
+    if (!src.empty()) {
+      if (ABSL_PREDICT_FALSE(!WriteSeekable(src, dest))) return;
+    }
+    if (start_pos() > frame_start_pos_ ||
+        dest.pos() > frame_compressed_start_pos_) {
+      if (ABSL_PREDICT_FALSE(!EndFrame(dest))) return;
+    }
+    WriteSeekTable(dest);
+    return;
+  }
   WriteInternal(src, dest, ZSTD_e_end);
 }
 
@@ -183,6 +241,7 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src) {
   RIEGELI_ASSERT(healthy())
       << "Failed precondition of BufferedWriter::WriteInternal(): " << status();
   Writer& dest = *dest_writer();
+  if (seekable_frame_size_ != absl::nullopt) return WriteSeekable(src, dest);
   return WriteInternal(src, dest, ZSTD_e_continue);
 }
 
@@ -231,7 +290,10 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       RIEGELI_ASSERT_EQ(input.pos, input.size)
           << "ZSTD_compressStream2() returned 0 but there are still input data";
       move_start_pos(input.pos);
-      if (end_op == ZSTD_e_end) compressor_.reset();
+      // In the seekable format `compressor_` continues with the next frame.
+      if (end_op == ZSTD_e_end && seekable_frame_size_ == absl::nullopt) {
+        compressor_.reset();
+      }
       return true;
     }
     if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
@@ -239,9 +301,9 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
           "ZSTD_compressStream2() failed: ", ZSTD_getErrorName(result))));
     }
     if (output.pos < output.size) {
-      RIEGELI_ASSERT_EQ(input.pos, input.size)
-          << "ZSTD_compressStream2() returned but there are still input data "
-             "and output space";
+      // With workers, `ZSTD_compressStream2()` may return before consuming
+      // all input data even if there is output space.
+      if (input.pos < input.size) continue;
       move_start_pos(input.pos);
       return true;
     }
@@ -258,10 +320,85 @@ bool ZstdWriterBase::FlushBehindBuffer(absl::string_view src,
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Writer& dest = *dest_writer();
+  if (seekable_frame_size_ != absl::nullopt) {
+    if (!src.empty()) {
+      if (ABSL_PREDICT_FALSE(!WriteSeekable(src, dest))) return false;
+    }
+    return WriteInternal(absl::string_view(), dest, ZSTD_e_flush);
+  }
   return WriteInternal(src, dest, ZSTD_e_flush);
 }
 
+bool ZstdWriterBase::WriteSeekable(absl::string_view src, Writer& dest) {
+  RIEGELI_ASSERT(seekable_frame_size_ != absl::nullopt)
+      << "Failed precondition of ZstdWriterBase::WriteSeekable(): "
+         "not the seekable format";
+  for (;;) {
+    const Position remaining =
+        *seekable_frame_size_ - (start_pos() - frame_start_pos_);
+    if (src.size() < remaining) {
+      return src.empty() || WriteInternal(src, dest, ZSTD_e_continue);
+    }
+    const absl::string_view fragment =
+        src.substr(0, IntCast<size_t>(remaining));
+    if (ABSL_PREDICT_FALSE(!WriteInternal(fragment, dest, ZSTD_e_continue))) {
+      return false;
+    }
+    src.remove_prefix(fragment.size());
+    if (ABSL_PREDICT_FALSE(!EndFrame(dest))) return false;
+  }
+}
+
+bool ZstdWriterBase::EndFrame(Writer& dest) {
+  if (ABSL_PREDICT_FALSE(
+          !WriteInternal(absl::string_view(), dest, ZSTD_e_end))) {
+    return false;
+  }
+  const Position compressed_size = dest.pos() - frame_compressed_start_pos_;
+  const Position decompressed_size = start_pos() - frame_start_pos_;
+  if (ABSL_PREDICT_FALSE(compressed_size >
+                         std::numeric_limits<uint32_t>::max())) {
+    return Fail(absl::ResourceExhaustedError(
+        absl::StrCat("Compressed Zstd frame too large: ", compressed_size)));
+  }
+  if (ABSL_PREDICT_FALSE(seek_table_.size() >=
+                         internal::kZstdSeekableMaxFrames *
+                             internal::kZstdSeekTableEntrySize)) {
+    return Fail(absl::ResourceExhaustedError(
+        "Too many frames for the zstd seekable format"));
+  }
+  char entry[internal::kZstdSeekTableEntrySize];
+  WriteLittleEndian32(IntCast<uint32_t>(compressed_size), entry);
+  WriteLittleEndian32(IntCast<uint32_t>(decompressed_size), entry + 4);
+  seek_table_.append(entry, sizeof(entry));
+  frame_start_pos_ = start_pos();
+  frame_compressed_start_pos_ = dest.pos();
+  return true;
+}
+
+bool ZstdWriterBase::WriteSeekTable(Writer& dest) {
+  const uint32_t num_frames =
+      IntCast<uint32_t>(seek_table_.size() / internal::kZstdSeekTableEntrySize);
+  if (ABSL_PREDICT_FALSE(
+          !WriteLittleEndian32(internal::kZstdSkippableMagic, dest) ||
+          !WriteLittleEndian32(
+              IntCast<uint32_t>(seek_table_.size() +
+                                internal::kZstdSeekTableFooterSize),
+              dest) ||
+          !dest.Write(seek_table_) ||
+          !WriteLittleEndian32(num_frames, dest) ||
+          // Descriptor: no checksums.
+          !dest.WriteByte(0) ||
+          !WriteLittleEndian32(internal::kZstdSeekableMagic, dest))) {
+    return FailWithoutAnnotation(AnnotateOverDest(dest.status()));
+  }
+  return true;
+}
+
 bool ZstdWriterBase::SupportsReadMode() {
+  // Reading back is not supported in the seekable format, because the seek
+  // table is written only when closing.
+  if (seekable_frame_size_ != absl::nullopt) return false;
   Writer* const dest = dest_writer();
   return dest != nullptr && dest->SupportsReadMode();
 }
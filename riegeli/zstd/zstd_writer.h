@@ -17,6 +17,7 @@
 
 #include <stddef.h>
 
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -106,6 +107,50 @@ class ZstdWriterBase : public BufferedWriter {
     }
     absl::optional<int> window_log() const { return window_log_; }
 
+    // If `true`, enables long distance matching, which finds matches further
+    // than the usual window, up to the window given by `window_log()` (at
+    // least 27 if `window_log()` is `absl::nullopt`). This improves density of
+    // large inputs with long repetitions, at the cost of memory usage and
+    // compression speed. The compressed format is unchanged.
+    //
+    // Default: `false`.
+    Options& set_long_distance_matching(bool long_distance_matching) & {
+      long_distance_matching_ = long_distance_matching;
+      return *this;
+    }
+    Options&& set_long_distance_matching(bool long_distance_matching) && {
+      return std::move(set_long_distance_matching(long_distance_matching));
+    }
+    bool long_distance_matching() const { return long_distance_matching_; }
+
+    // Number of background threads which Zstd uses to compress parts of the
+    // data in parallel. This speeds up compression of large inputs without
+    // changing the compressed format. 0 compresses in the calling thread.
+    //
+    // If Zstd was built without multithreading support, `num_workers` is
+    // ignored, and data are compressed in the calling thread.
+    //
+    // `num_workers` must be between 0 and `kMaxNumWorkers` (64 in 32-bit
+    // build, 256 in 64-bit build). Default: 0.
+    static constexpr int kMaxNumWorkers =
+        sizeof(size_t) == 4 ? 64 : 256;  // `ZSTDMT_NBWORKERS_MAX`
+    Options& set_num_workers(int num_workers) & {
+      RIEGELI_ASSERT_GE(num_workers, 0)
+          << "Failed precondition of "
+             "ZstdWriterBase::Options::set_num_workers(): "
+             "number of workers out of range";
+      RIEGELI_ASSERT_LE(num_workers, kMaxNumWorkers)
+          << "Failed precondition of "
+             "ZstdWriterBase::Options::set_num_workers(): "
+             "number of workers out of range";
+      num_workers_ = num_workers;
+      return *this;
+    }
+    Options&& set_num_workers(int num_workers) && {
+      return std::move(set_num_workers(num_workers));
+    }
+    int num_workers() const { return num_workers_; }
+
     // Zstd dictionary. The same dictionary must be used for decompression.
     //
     // Default: `ZstdDictionary()`.
@@ -225,15 +270,70 @@ class ZstdWriterBase : public BufferedWriter {
       return buffer_size();
     }
 
+    // Maximum number of idle Zstd compression contexts kept for reuse by
+    // `ZstdWriter` objects. The pool is shared by all `ZstdWriter` objects in
+    // the process, and the value used by the most recently opened one is in
+    // effect.
+    //
+    // Default: `kDefaultRecyclingPoolMaxSize` (16).
+    Options& set_recycling_pool_max_size(size_t recycling_pool_max_size) & {
+      recycling_pool_max_size_ = recycling_pool_max_size;
+      return *this;
+    }
+    Options&& set_recycling_pool_max_size(size_t recycling_pool_max_size) && {
+      return std::move(set_recycling_pool_max_size(recycling_pool_max_size));
+    }
+    size_t recycling_pool_max_size() const { return recycling_pool_max_size_; }
+
+    // If not `absl::nullopt`, writes the zstd seekable format: data are split
+    // into independent Zstd frames of this uncompressed size (the last frame
+    // can be shorter), followed by a seek table in a skippable frame. This lets
+    // `ZstdReader` with `set_seekable(true)` seek by decompressing at most one
+    // frame, at the cost of compression density.
+    //
+    // The result is readable by any Zstd decompressor which supports multiple
+    // frames and skippable frames.
+    //
+    // `seekable_frame_size()` must not be used together with `pledged_size()`.
+    //
+    // Default: `absl::nullopt`.
+    static constexpr size_t kMaxSeekableFrameSize = size_t{1} << 30;
+    Options& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) & {
+      if (seekable_frame_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*seekable_frame_size, 0u)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "zero frame size";
+        RIEGELI_ASSERT_LE(*seekable_frame_size, kMaxSeekableFrameSize)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "frame size out of range";
+      }
+      seekable_frame_size_ = seekable_frame_size;
+      return *this;
+    }
+    Options&& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) && {
+      return std::move(set_seekable_frame_size(seekable_frame_size));
+    }
+    absl::optional<size_t> seekable_frame_size() const {
+      return seekable_frame_size_;
+    }
+
    private:
     int compression_level_ = kDefaultCompressionLevel;
     absl::optional<int> window_log_;
+    bool long_distance_matching_ = false;
+    int num_workers_ = 0;
     ZstdDictionary dictionary_;
     bool store_checksum_ = false;
     absl::optional<Position> pledged_size_;
     absl::optional<Position> size_hint_;
     bool reserve_max_size_ = false;
     size_t buffer_size_ = DefaultBufferSize();
+    size_t recycling_pool_max_size_ = kDefaultRecyclingPoolMaxSize;
+    absl::optional<size_t> seekable_frame_size_;
   };
 
   // Returns the compressed `Writer`. Unchanged by `Close()`.
@@ -248,7 +348,8 @@ class ZstdWriterBase : public BufferedWriter {
   explicit ZstdWriterBase(ZstdDictionary&& dictionary, size_t buffer_size,
                           absl::optional<Position> pledged_size,
                           absl::optional<Position> size_hint,
-                          bool reserve_max_size);
+                          bool reserve_max_size,
+                          absl::optional<size_t> seekable_frame_size);
 
   ZstdWriterBase(ZstdWriterBase&& that) noexcept;
   ZstdWriterBase& operator=(ZstdWriterBase&& that) noexcept;
@@ -256,10 +357,13 @@ class ZstdWriterBase : public BufferedWriter {
   void Reset(Closed);
   void Reset(ZstdDictionary&& dictionary, size_t buffer_size,
              absl::optional<Position> pledged_size,
-             absl::optional<Position> size_hint, bool reserve_max_size);
+             absl::optional<Position> size_hint, bool reserve_max_size,
+             absl::optional<size_t> seekable_frame_size);
   void Initialize(Writer* dest, int compression_level,
-                  absl::optional<int> window_log, bool store_checksum,
-                  absl::optional<Position> size_hint);
+                  absl::optional<int> window_log, bool long_distance_matching,
+                  int num_workers, bool store_checksum,
+                  absl::optional<Position> size_hint,
+                  size_t recycling_pool_max_size);
   ABSL_ATTRIBUTE_COLD absl::Status AnnotateOverDest(absl::Status status);
 
   void DoneBehindBuffer(absl::string_view src) override;
@@ -277,11 +381,25 @@ class ZstdWriterBase : public BufferedWriter {
 
   bool WriteInternal(absl::string_view src, Writer& dest,
                      ZSTD_EndDirective end_op);
+  // Like `WriteInternal(src, dest, ZSTD_e_continue)`, but ends a frame
+  // whenever it reaches `*seekable_frame_size_`.
+  bool WriteSeekable(absl::string_view src, Writer& dest);
+  // Ends the current frame and records it in `seek_table_`.
+  bool EndFrame(Writer& dest);
+  bool WriteSeekTable(Writer& dest);
 
   ZstdDictionary dictionary_;
   absl::optional<Position> pledged_size_;
   bool reserve_max_size_ = false;
   Position initial_compressed_pos_ = 0;
+  absl::optional<size_t> seekable_frame_size_;
+  // If `seekable_frame_size_ != absl::nullopt`, the uncompressed and compressed
+  // positions where the current frame begins.
+  Position frame_start_pos_ = 0;
+  Position frame_compressed_start_pos_ = 0;
+  // If `seekable_frame_size_ != absl::nullopt`, seek table entries of frames
+  // written so far.
+  std::string seek_table_;
   // If `healthy()` but `compressor_ == nullptr` then `*pledged_size_` has been
   // reached. In this case `ZSTD_compressStream()` must not be called again.
   RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::Handle compressor_;
@@ -366,15 +484,15 @@ explicit ZstdWriter(std::tuple<DestArgs...> dest_args,
 
 // Implementation details follow.
 
-inline ZstdWriterBase::ZstdWriterBase(ZstdDictionary&& dictionary,
-                                      size_t buffer_size,
-                                      absl::optional<Position> pledged_size,
-                                      absl::optional<Position> size_hint,
-                                      bool reserve_max_size)
+inline ZstdWriterBase::ZstdWriterBase(
+    ZstdDictionary&& dictionary, size_t buffer_size,
+    absl::optional<Position> pledged_size, absl::optional<Position> size_hint,
+    bool reserve_max_size, absl::optional<size_t> seekable_frame_size)
     : BufferedWriter(buffer_size, size_hint),
       dictionary_(std::move(dictionary)),
       pledged_size_(pledged_size),
-      reserve_max_size_(reserve_max_size) {}
+      reserve_max_size_(reserve_max_size),
+      seekable_frame_size_(seekable_frame_size) {}
 
 inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
     : BufferedWriter(std::move(that)),
@@ -384,6 +502,10 @@ inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
       pledged_size_(that.pledged_size_),
       reserve_max_size_(that.reserve_max_size_),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      seekable_frame_size_(that.seekable_frame_size_),
+      frame_start_pos_(that.frame_start_pos_),
+      frame_compressed_start_pos_(that.frame_compressed_start_pos_),
+      seek_table_(std::move(that.seek_table_)),
       compressor_(std::move(that.compressor_)),
       associated_reader_(std::move(that.associated_reader_)) {}
 
@@ -396,6 +518,10 @@ inline ZstdWriterBase& ZstdWriterBase::operator=(
   pledged_size_ = std::move(that.pledged_size_);
   reserve_max_size_ = that.reserve_max_size_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  seekable_frame_size_ = that.seekable_frame_size_;
+  frame_start_pos_ = that.frame_start_pos_;
+  frame_compressed_start_pos_ = that.frame_compressed_start_pos_;
+  seek_table_ = std::move(that.seek_table_);
   compressor_ = std::move(that.compressor_);
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
@@ -406,6 +532,10 @@ inline void ZstdWriterBase::Reset(Closed) {
   pledged_size_ = absl::nullopt;
   reserve_max_size_ = false;
   initial_compressed_pos_ = 0;
+  seekable_frame_size_ = absl::nullopt;
+  frame_start_pos_ = 0;
+  frame_compressed_start_pos_ = 0;
+  seek_table_ = std::string();
   compressor_.reset();
   dictionary_ = ZstdDictionary();
   associated_reader_.Reset();
@@ -415,13 +545,18 @@ inline void ZstdWriterBase::Reset(ZstdDictionary&& dictionary,
                                   size_t buffer_size,
                                   absl::optional<Position> pledged_size,
                                   absl::optional<Position> size_hint,
-                                  bool reserve_max_size) {
+                                  bool reserve_max_size,
+                                  absl::optional<size_t> seekable_frame_size) {
   BufferedWriter::Reset(buffer_size, size_hint);
   pledged_size_ = pledged_size;
   reserve_max_size_ = reserve_max_size;
   initial_compressed_pos_ = 0;
+  seekable_frame_size_ = seekable_frame_size;
+  frame_start_pos_ = 0;
+  frame_compressed_start_pos_ = 0;
+  seek_table_.clear();
   compressor_.reset();
-  dictionary_ = ZstdDictionary();
+  dictionary_ = std::move(dictionary);
   associated_reader_.Reset();
 }
 
@@ -429,20 +564,26 @@ template <typename Dest>
 inline ZstdWriter<Dest>::ZstdWriter(const Dest& dest, Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(dest) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>
 inline ZstdWriter<Dest>::ZstdWriter(Dest&& dest, Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>
@@ -451,10 +592,13 @@ inline ZstdWriter<Dest>::ZstdWriter(std::tuple<DestArgs...> dest_args,
                                     Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(std::move(dest_args)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>
@@ -485,10 +629,13 @@ inline void ZstdWriter<Dest>::Reset(const Dest& dest, Options options) {
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(dest);
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>
@@ -496,10 +643,13 @@ inline void ZstdWriter<Dest>::Reset(Dest&& dest, Options options) {
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>
@@ -509,10 +659,13 @@ inline void ZstdWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.long_distance_matching(), options.num_workers(),
+             options.store_checksum(), options.effective_size_hint(),
+             options.recycling_pool_max_size());
 }
 
 template <typename Dest>